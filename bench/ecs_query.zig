@@ -0,0 +1,119 @@
+// bench/ecs_query.zig - Query.next and CachedQuery.next over N entities with 1 to 4 components
+//
+// Run with: zig build bench-ecs_query -Doptimize=ReleaseFast
+
+const std = @import("std");
+const zune = @import("zune");
+const Report = @import("report.zig").Report;
+
+const Registry = zune.ecs.Registry;
+
+const entity_count = 100_000;
+const passes = 20;
+
+const A = struct { value: f32 };
+const B = struct { value: f32 };
+const C = struct { value: f32 };
+const D = struct { value: f32 };
+
+
+
+// ============================================================
+// Workloads
+// ============================================================
+
+/// Query of the first `count` of A, B, C and D
+fn Components(comptime count: usize) type {
+    return switch (count) {
+        1 => struct { a: *A },
+        2 => struct { a: *A, b: *B },
+        3 => struct { a: *A, b: *B, c: *C },
+        4 => struct { a: *A, b: *B, c: *C, d: *D },
+        else => unreachable,
+    };
+}
+
+
+/// Add up every matched component, so none of the lookups can be skipped
+fn sum(components: anytype) f32 {
+    var total: f32 = 0;
+    inline for (std.meta.fields(@TypeOf(components))) |field| {
+        total += @field(components, field.name).value;
+    }
+    return total;
+}
+
+
+fn runQuery(registry: *Registry, comptime count: usize) !u64 {
+    var timer = try std.time.Timer.start();
+    var total: f32 = 0;
+    for (0..passes) |_| {
+        var query = try registry.query(Components(count));
+        while (try query.next()) |components| total += sum(components);
+    }
+    std.mem.doNotOptimizeAway(total);
+    return timer.read();
+}
+
+
+fn runCached(registry: *Registry, comptime count: usize) !u64 {
+    const query = try registry.cachedQuery(Components(count));
+    var timer = try std.time.Timer.start();
+    var total: f32 = 0;
+    for (0..passes) |_| {
+        query.reset();
+        while (query.next()) |components| total += sum(components);
+    }
+    std.mem.doNotOptimizeAway(total);
+    return timer.read();
+}
+
+
+
+
+// ============================================================
+// Harness
+// ============================================================
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    var registry = try Registry.create(allocator);
+    defer registry.release();
+    try registry.registerComponent(A);
+    try registry.registerComponent(B);
+    try registry.registerComponent(C);
+    try registry.registerComponent(D);
+
+    // Every entity has A, the others thin out so later lookups miss like they do in a real scene
+    for (0..entity_count) |i| {
+        const entity = try registry.createEntity();
+        try registry.addComponent(entity, A{ .value = 1 });
+        if (i % 8 != 0) try registry.addComponent(entity, B{ .value = 1 });
+        if (i % 4 != 0) try registry.addComponent(entity, C{ .value = 1 });
+        if (i % 2 != 0) try registry.addComponent(entity, D{ .value = 1 });
+    }
+
+    var results = try Report.init(allocator, "ecs_query");
+    defer results.deinit();
+    const text = results.text();
+    try text.print("queries: {d} entities x {d} passes\n", .{ entity_count, passes });
+
+    const ops = entity_count * passes;
+    inline for (1..5) |count| {
+        const query_ns = try runQuery(registry, count);
+        const cached_ns = try runCached(registry, count);
+        const name = std.fmt.comptimePrint("{d} components", .{count});
+        try results.add(name ++ "/query", ops, query_ns);
+        try results.add(name ++ "/cached", ops, cached_ns);
+
+        try text.print("{s:<14} Query {d:>8.2} ns/entity   CachedQuery {d:>8.2} ns/entity\n", .{
+            name,
+            @as(f64, @floatFromInt(query_ns)) / ops,
+            @as(f64, @floatFromInt(cached_ns)) / ops,
+        });
+    }
+    try results.finish();
+}
@@ -0,0 +1,199 @@
+// bench/ecs_storage.zig - compare the paged sparse set ComponentStorage with the old hash map version
+//
+// Run with: zig build bench-ecs_storage -Doptimize=ReleaseFast
+
+const std = @import("std");
+const zune = @import("zune");
+const Report = @import("report.zig").Report;
+
+const EntityId = zune.ecs.EntityId;
+
+const entity_count = 200_000;
+const query_passes = 20;
+
+const Position = struct { x: f32, y: f32, z: f32 };
+const Velocity = struct { x: f32, y: f32, z: f32 };
+const Health = struct { value: f32 };
+
+
+
+// ============================================================
+// Legacy Storage
+// ============================================================
+
+/// The previous ComponentStorage, an AutoHashMap from entity index to dense slot
+fn LegacyStorage(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        const ComponentData = struct {
+            entity: EntityId,
+            component: T,
+        };
+
+        entity_to_index: std.AutoHashMap(u32, usize),
+        components: std.ArrayList(ComponentData),
+
+        pub fn init(allocator: std.mem.Allocator) Self {
+            return .{
+                .entity_to_index = std.AutoHashMap(u32, usize).init(allocator),
+                .components = std.ArrayList(ComponentData).init(allocator),
+            };
+        }
+
+        pub fn add(self: *Self, entity: EntityId, component: T) !void {
+            if (self.entity_to_index.get(entity.index)) |_| return error.DuplicateComponent;
+            try self.entity_to_index.put(entity.index, self.components.items.len);
+            try self.components.append(.{ .entity = entity, .component = component });
+        }
+
+        pub fn remove(self: *Self, entity: EntityId) !void {
+            const index = self.entity_to_index.get(entity.index) orelse return error.ComponentNotFound;
+            _ = self.entity_to_index.remove(entity.index);
+            if (index != self.components.items.len - 1) {
+                const last = self.components.items[self.components.items.len - 1];
+                self.components.items[index] = last;
+                try self.entity_to_index.put(last.entity.index, index);
+            }
+            _ = self.components.pop();
+        }
+
+        pub fn get(self: *Self, entity: EntityId) ?*T {
+            const index = self.entity_to_index.get(entity.index) orelse return null;
+            return &self.components.items[index].component;
+        }
+
+        pub fn iter(self: *Self) []ComponentData {
+            return self.components.items;
+        }
+
+        pub fn deinit(self: *Self) void {
+            self.entity_to_index.deinit();
+            self.components.deinit();
+        }
+    };
+}
+
+
+
+
+// ============================================================
+// Workloads
+// ============================================================
+
+const Timings = struct {
+    add_ns: u64,
+    get_ns: u64,
+    query_ns: u64,
+    remove_ns: u64,
+};
+
+fn run(comptime Storage: fn (type) type, allocator: std.mem.Allocator, shuffled: []const EntityId) !Timings {
+    var positions = Storage(Position).init(allocator);
+    defer positions.deinit();
+    var velocities = Storage(Velocity).init(allocator);
+    defer velocities.deinit();
+    var healths = Storage(Health).init(allocator);
+    defer healths.deinit();
+
+    var timer = try std.time.Timer.start();
+
+    // Add: every entity gets a position, most get velocity, some get health
+    for (shuffled, 0..) |entity, i| {
+        try positions.add(entity, .{ .x = 0, .y = 0, .z = 0 });
+        if (i % 4 != 0) try velocities.add(entity, .{ .x = 1, .y = 1, .z = 1 });
+        if (i % 2 == 0) try healths.add(entity, .{ .value = 100 });
+    }
+    const add_ns = timer.lap();
+
+    // Random access
+    var sum: f32 = 0;
+    for (shuffled) |entity| {
+        if (healths.get(entity)) |health| sum += health.value;
+    }
+    std.mem.doNotOptimizeAway(sum);
+    const get_ns = timer.lap();
+
+    // Three component query the way Query.next() does it: lead with one storage, look up the rest
+    for (0..query_passes) |_| {
+        queryPass(&positions, &velocities, &healths);
+    }
+    std.mem.doNotOptimizeAway(positions.get(shuffled[0]).?.x);
+    const query_ns = timer.lap();
+
+    // Remove half of the entities' positions
+    for (shuffled[0 .. shuffled.len / 2]) |entity| {
+        try positions.remove(entity);
+    }
+    const remove_ns = timer.lap();
+
+    return .{ .add_ns = add_ns, .get_ns = get_ns, .query_ns = query_ns, .remove_ns = remove_ns };
+}
+
+
+
+
+fn queryPass(positions: anytype, velocities: anytype, healths: anytype) void {
+    if (@hasDecl(@TypeOf(positions.*), "entitySlice")) {
+        for (positions.entitySlice(), positions.componentSlice()) |entity, *position| {
+            const velocity = velocities.get(entity) orelse continue;
+            const health = healths.get(entity) orelse continue;
+            position.x += velocity.x * health.value;
+        }
+    } else {
+        for (positions.iter()) |*data| {
+            const velocity = velocities.get(data.entity) orelse continue;
+            const health = healths.get(data.entity) orelse continue;
+            data.component.x += velocity.x * health.value;
+        }
+    }
+}
+
+
+
+
+// ============================================================
+// Harness
+// ============================================================
+
+fn report(results: *Report, comptime name: []const u8, ops: usize, legacy_ns: u64, paged_ns: u64) !void {
+    const n: f64 = @floatFromInt(ops);
+    const legacy: f64 = @floatFromInt(legacy_ns);
+    const paged: f64 = @floatFromInt(paged_ns);
+
+    try results.add(name ++ "/hash_map", ops, legacy_ns);
+    try results.add(name ++ "/sparse_set", ops, paged_ns);
+    try results.text().print("{s:<8} hash map {d:>8.2} ns/op   sparse set {d:>8.2} ns/op   speedup {d:.2}x\n", .{
+        name,
+        legacy / n,
+        paged / n,
+        legacy / paged,
+    });
+}
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    // Entities arrive in a random order, like they would after churn in a real registry
+    const shuffled = try allocator.alloc(EntityId, entity_count);
+    defer allocator.free(shuffled);
+    for (shuffled, 0..) |*entity, i| {
+        entity.* = .{ .index = @intCast(i), .generation = 1 };
+    }
+    var prng = std.Random.DefaultPrng.init(0x5eed);
+    prng.random().shuffle(EntityId, shuffled);
+
+    const legacy = try run(LegacyStorage, allocator, shuffled);
+    const paged = try run(zune.ecs.ComponentStorage, allocator, shuffled);
+
+    var results = try Report.init(allocator, "ecs_storage");
+    defer results.deinit();
+    try results.text().print("component storage: {d} entities\n", .{entity_count});
+    try report(&results, "add", entity_count, legacy.add_ns, paged.add_ns);
+    try report(&results, "get", entity_count, legacy.get_ns, paged.get_ns);
+    try report(&results, "query", entity_count * query_passes, legacy.query_ns, paged.query_ns);
+    try report(&results, "remove", entity_count / 2, legacy.remove_ns, paged.remove_ns);
+    try results.finish();
+}
@@ -0,0 +1,128 @@
+// bench/math_backends.zig - compare the native @Vector and Eigen math backends
+//
+// Run with: zig build bench-math_backends -Doptimize=ReleaseFast
+
+const std = @import("std");
+const zune = @import("zune");
+const Report = @import("report.zig").Report;
+
+const Vec3f = zune.math.Vec3f;
+const Vec4f = zune.math.Vec4f;
+const Mat4f = zune.math.Mat4f;
+const backends = zune.math.backends;
+
+const element_count = 4096;
+const iterations = 2000;
+
+
+
+// ============================================================
+// Workloads
+// ============================================================
+
+const Data = struct {
+    a: [element_count]Vec3f,
+    b: [element_count]Vec3f,
+    q: [element_count]Vec4f,
+    m: [element_count]Mat4f,
+
+    fn fill(self: *Data, random: std.Random) void {
+        for (&self.a, &self.b, &self.q, &self.m) |*a, *b, *q, *m| {
+            a.* = .{ .x = random.float(f32), .y = random.float(f32), .z = random.float(f32) };
+            b.* = .{ .x = random.float(f32), .y = random.float(f32), .z = random.float(f32) };
+            q.* = .{ .x = random.float(f32), .y = random.float(f32), .z = random.float(f32), .w = random.float(f32) };
+            for (&m.data) |*v| v.* = random.float(f32);
+        }
+    }
+};
+
+fn vec3Mix(comptime B: type, data: *const Data) f32 {
+    var acc: f32 = 0;
+    for (data.a, data.b) |a, b| {
+        const c = B.vec3Cross(B.vec3Add(a, b), B.vec3Subtract(a, b));
+        acc += B.vec3Dot(B.vec3Normalize(c), a);
+    }
+    return acc;
+}
+
+fn vec4Mix(comptime B: type, data: *const Data) f32 {
+    var acc: f32 = 0;
+    for (data.q) |q| {
+        acc += B.vec4Length(B.vec4Scale(B.vec4Add(q, q), 0.5));
+    }
+    return acc;
+}
+
+fn mat4Chain(comptime B: type, data: *const Data) f32 {
+    var acc: Mat4f = undefined;
+    B.mat4Identity(&acc);
+    for (&data.m) |*m| {
+        B.mat4Multiply(&acc, m, &acc);
+        // Keep the values bounded so the chain doesn't overflow to inf
+        acc.data[15] = 1;
+    }
+    return acc.data[0];
+}
+
+fn mat4Points(comptime B: type, data: *const Data) f32 {
+    var acc: f32 = 0;
+    for (&data.m, data.a) |*m, p| {
+        acc += B.mat4TransformPoint(m, p).x;
+    }
+    return acc;
+}
+
+
+
+
+// ============================================================
+// Harness
+// ============================================================
+
+fn run(comptime B: type, comptime workload: anytype, data: *const Data) u64 {
+    var timer = std.time.Timer.start() catch unreachable;
+    for (0..iterations) |_| {
+        std.mem.doNotOptimizeAway(workload(B, data));
+    }
+    return timer.read();
+}
+
+fn report(results: *Report, comptime name: []const u8, comptime workload: anytype, data: *const Data) !void {
+    const ops: f64 = @floatFromInt(element_count * iterations);
+    const native_raw = run(backends.native, workload, data);
+    const eigen_raw = run(backends.eigen, workload, data);
+    const native_ns: f64 = @floatFromInt(native_raw);
+    const eigen_ns: f64 = @floatFromInt(eigen_raw);
+
+    try results.add(name ++ "/native", element_count * iterations, native_raw);
+    try results.add(name ++ "/eigen", element_count * iterations, eigen_raw);
+    try results.text().print("{s:<14} native {d:>8.3} ns/op   eigen {d:>8.3} ns/op   speedup {d:.2}x\n", .{
+        name,
+        native_ns / ops,
+        eigen_ns / ops,
+        eigen_ns / native_ns,
+    });
+}
+
+pub fn main() !void {
+    const data = try std.heap.page_allocator.create(Data);
+    defer std.heap.page_allocator.destroy(data);
+
+    var prng = std.Random.DefaultPrng.init(0x5eed);
+    data.fill(prng.random());
+
+    var results = try Report.init(std.heap.page_allocator, "math_backends");
+    defer results.deinit();
+    try results.text().print("math backends: {d} elements x {d} iterations (active: {s}, batched kernels: {s})\n", .{
+        element_count,
+        iterations,
+        @tagName(backends.selected),
+        @tagName(zune.math.batchKernelLevel()),
+    });
+
+    try report(&results, "vec3 mix", vec3Mix, data);
+    try report(&results, "vec4 mix", vec4Mix, data);
+    try report(&results, "mat4 multiply", mat4Chain, data);
+    try report(&results, "mat4 point", mat4Points, data);
+    try results.finish();
+}
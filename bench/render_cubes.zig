@@ -0,0 +1,127 @@
+// bench/render_cubes.zig - frame time of K instanced cubes, drawn headless into an offscreen framebuffer
+//
+// Run with: zig build bench-render_cubes -Doptimize=ReleaseFast
+
+const std = @import("std");
+const zune = @import("zune");
+const Report = @import("report.zig").Report;
+
+const Mat4f = zune.math.Mat4f;
+const Affine3x4 = zune.math.Affine3x4;
+const Vec3f = zune.math.Vec3f;
+const Quatf = zune.math.Quatf;
+
+const width = 1280;
+const height = 720;
+const warmup_frames = 30;
+const measured_frames = 300;
+const cube_counts = [_]usize{ 1_000, 10_000, 100_000 };
+/// Frame time budget of each cube count, soft unless run with `--enforce-budgets`
+const frame_budgets_ms = [_]f64{ 2.0, 4.0, 16.0 };
+
+
+
+// ============================================================
+// Workloads
+// ============================================================
+
+/// Cubes on a square grid in the XZ plane, centered on the origin
+fn fillGrid(matrices: []Affine3x4) void {
+    const side: usize = std.math.sqrt(matrices.len) + 1;
+    const offset: f32 = @as(f32, @floatFromInt(side)) * 1.5;
+    for (matrices, 0..) |*matrix, i| {
+        const position = Vec3f{
+            .x = @as(f32, @floatFromInt(i % side)) * 3.0 - offset,
+            .y = 0.0,
+            .z = @as(f32, @floatFromInt(i / side)) * 3.0 - offset,
+        };
+        matrix.* = Affine3x4.compose(position, Quatf.identity(), .{ .x = 1.0, .y = 1.0, .z = 1.0 });
+    }
+}
+
+
+/// Time `measured_frames` frames, each finished on the GPU before the next starts
+/// Each measured frame is also a sample of `budget`
+fn runFrames(window: *zune.core.Window, renderer: *zune.graphics.Renderer, model: *zune.graphics.Model, matrices: []const Affine3x4, view: *Mat4f, projection: *Mat4f,
+    budgets: *zune.core.PerfBudgets, budget: *zune.core.Budget) !u64 {
+    var timer = try std.time.Timer.start();
+    var frame_timer = try std.time.Timer.start();
+    for (0..warmup_frames + measured_frames) |frame| {
+        if (frame == warmup_frames) timer.reset();
+        frame_timer.reset();
+        renderer.clear();
+        try renderer.drawModelInstanced(model, matrices, view, projection);
+        window.swapBuffers();
+        renderer.endFrame();
+        // Measure the whole frame, not just how fast commands are queued
+        zune.c.glFinish();
+        if (frame >= warmup_frames) {
+            budgets.record(budget, frame_timer.read());
+            budgets.endFrame();
+        }
+    }
+    return timer.read();
+}
+
+
+
+
+// ============================================================
+// Harness
+// ============================================================
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const window = try zune.core.Window.create(allocator, .{
+        .title = "bench render_cubes",
+        .width = width,
+        .height = height,
+        .headless = true,
+        .with_input_system = false,
+    });
+    defer window.release();
+
+    const renderer = try zune.graphics.Renderer.create(allocator, .{});
+    defer renderer.release();
+
+    const shader = try zune.graphics.Shader.createColorShader(allocator);
+    defer _ = shader.release();
+    const material = try zune.graphics.Material.create(allocator, shader, .{ 0.8, 0.5, 0.2, 1.0 }, null);
+    defer _ = material.release();
+    const mesh = try zune.graphics.Mesh.createCube(allocator);
+    defer _ = mesh.release();
+    const model = try zune.graphics.Model.create(allocator);
+    defer _ = model.release();
+    try model.addMeshMaterial(mesh, material);
+
+    var view = Mat4f.lookAt(.{ .x = 0.0, .y = 150.0, .z = 300.0 }, .{ .x = 0.0, .y = 0.0, .z = 0.0 }, .{ .x = 0.0, .y = 1.0, .z = 0.0 });
+    var projection = Mat4f.perspective(std.math.degreesToRadians(45.0), @as(f32, width) / @as(f32, height), 0.1, 2000.0);
+
+    var results = try Report.init(allocator, "render_cubes");
+    defer results.deinit();
+    const text = results.text();
+    try text.print("instanced cubes: {d}x{d} offscreen, {d} frames each\n", .{ width, height, measured_frames });
+
+    // The warmup frames aren't recorded, every measured frame is judged
+    var budgets = zune.core.PerfBudgets.init(allocator, .{ .warmup = 1, .action = results.budgetAction() });
+    defer budgets.deinit();
+
+    inline for (cube_counts, frame_budgets_ms) |count, budget_ms| {
+        const budget = try budgets.declare(std.fmt.comptimePrint("{d} cubes", .{count}), @intFromFloat(budget_ms * std.time.ns_per_ms));
+
+        const matrices = try allocator.alloc(Affine3x4, count);
+        defer allocator.free(matrices);
+        fillGrid(matrices);
+
+        const total_ns = try runFrames(window, renderer, model, matrices, &view, &projection, &budgets, budget);
+        try results.add(std.fmt.comptimePrint("{d} cubes", .{count}), measured_frames, total_ns);
+
+        const frame_ms = @as(f64, @floatFromInt(total_ns)) / measured_frames / std.time.ns_per_ms;
+        try text.print("{d:>7} cubes {d:>8.3} ms/frame\n", .{ count, frame_ms });
+    }
+    try results.finish();
+    try results.checkBudgets(&budgets);
+}
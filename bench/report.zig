@@ -0,0 +1,116 @@
+// bench/report.zig - shared result collection for the benchmarks
+//
+// Every benchmark prints its human readable table, or with `--json` one JSON document per run on a
+// single line instead, e.g. `zig build bench -Doptimize=ReleaseFast -- --json > results.jsonl`.
+// Each document names the suite, the optimize mode and every case with its operation count and time,
+// so results of two commits can be diffed case by case. Benchmarks with PerfBudgets only warn about
+// budgets they exceed, unless `--enforce-budgets` makes them exit with an error, e.g. to fail a CI run
+
+const std = @import("std");
+const builtin = @import("builtin");
+const zune = @import("zune");
+
+const PerfBudgets = zune.core.PerfBudgets;
+const BudgetAction = zune.core.BudgetAction;
+
+
+pub const Result = struct {
+    name: []const u8,
+    ops: u64,
+    total_ns: u64,
+};
+
+
+pub const Report = struct {
+    const Self = @This();
+
+    suite: []const u8,
+    json: bool,
+    enforce_budgets: bool,
+    results: std.ArrayList(Result),
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Reads `--json` and `--enforce-budgets` from the process arguments
+    pub fn init(allocator: std.mem.Allocator, suite: []const u8) !Self {
+        var json = false;
+        var enforce_budgets = false;
+        var args = try std.process.argsWithAllocator(allocator);
+        defer args.deinit();
+        while (args.next()) |arg| {
+            if (std.mem.eql(u8, arg, "--json")) json = true;
+            if (std.mem.eql(u8, arg, "--enforce-budgets")) enforce_budgets = true;
+        }
+
+        return .{
+            .suite = suite,
+            .json = json,
+            .enforce_budgets = enforce_budgets,
+            .results = std.ArrayList(Result).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Where the human readable table goes, discarded in JSON mode
+    pub fn text(self: *const Self) std.io.AnyWriter {
+        if (self.json) return std.io.null_writer.any();
+        return std.io.getStdOut().writer().any();
+    }
+
+
+    /// Record one case, `name` must outlive finish
+    pub fn add(self: *Self, name: []const u8, ops: u64, total_ns: u64) !void {
+        try self.results.append(.{ .name = name, .ops = ops, .total_ns = total_ns });
+    }
+
+
+    /// What PerfBudgets of this run do about a budget that is over
+    pub fn budgetAction(self: *const Self) BudgetAction {
+        return if (self.enforce_budgets) .fail else .warn;
+    }
+
+
+    /// Print the budget table, error once finish wrote the results if a budget failed
+    pub fn checkBudgets(self: *const Self, budgets: *PerfBudgets) !void {
+        try budgets.writeReport(self.text());
+        if (budgets.failed()) {
+            std.log.err("{s}: over budget in {d} of {d} frames", .{ self.suite, budgets.failed_frames, budgets.frame });
+            return error.BudgetExceeded;
+        }
+    }
+
+
+    /// Write the JSON document in JSON mode
+    pub fn finish(self: *const Self) !void {
+        if (!self.json) return;
+
+        const stdout = std.io.getStdOut().writer();
+        try stdout.writeAll("{\"suite\":");
+        try std.json.stringify(self.suite, .{}, stdout);
+        try stdout.print(",\"optimize\":\"{s}\",\"results\":[", .{@tagName(builtin.mode)});
+        for (self.results.items, 0..) |result, i| {
+            if (i > 0) try stdout.writeAll(",");
+            try stdout.writeAll("{\"name\":");
+            try std.json.stringify(result.name, .{}, stdout);
+            const per_op = @as(f64, @floatFromInt(result.total_ns)) / @as(f64, @floatFromInt(@max(result.ops, 1)));
+            try stdout.print(",\"ops\":{d},\"total_ns\":{d},\"ns_per_op\":{d:.3}}}", .{ result.ops, result.total_ns, per_op });
+        }
+        try stdout.writeAll("]}\n");
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.results.deinit();
+    }
+};
@@ -1,5 +1,11 @@
 const std = @import("std");
 
+/// OpenGL error reporting, see ErrorMode in src/core/gl.zig
+const GlChecks = enum { auto, poll, debug_output, off };
+
+/// CPU zone recording, see ProfilerMode in src/core/profiler.zig
+const Profiler = enum { off, on, detailed };
+
 pub fn build(b: *std.Build) void {
     // Set target and optimization
     const target = b.standardTargetOptions(.{ .default_target = .{
@@ -9,6 +15,27 @@ pub fn build(b: *std.Build) void {
     } });
     const optimize = b.standardOptimizeOption(.{});
 
+    // Math backend selection, the native @Vector backend is the default
+    const eigen_math = b.option(bool, "eigen-math", "Route Vec/Mat math through the Eigen C++ wrapper instead of native Zig SIMD") orelse false;
+    const build_options = b.addOptions();
+    build_options.addOption(bool, "eigen_math", eigen_math);
+
+    // GL error checks, `auto` polls glGetError in Debug and ReleaseSafe and compiles it out otherwise
+    const gl_checks = b.option(GlChecks, "gl-checks", "OpenGL error reporting: auto, poll, debug_output (KHR_debug callback) or off") orelse .auto;
+    build_options.addOption(GlChecks, "gl_checks", gl_checks);
+
+    // CPU profiler zones, compiled out entirely unless enabled
+    const profiler = b.option(Profiler, "profiler", "CPU profiler zones: off, on, or detailed (also per-entity hot paths)") orelse .off;
+    build_options.addOption(Profiler, "profiler", profiler);
+
+    // Per-frame draw, bind and upload counters, compiled out entirely unless enabled
+    const render_stats = b.option(bool, "render-stats", "Count draw calls, binds and buffer uploads per frame, see Renderer.frameStats") orelse false;
+    build_options.addOption(bool, "render_stats", render_stats);
+
+    // Immediate-mode debug lines and shapes, compiled out of release builds unless asked for
+    const debug_draw = b.option(bool, "debug-draw", "Keep DebugDraw lines, boxes and spheres, defaults to on in Debug builds only") orelse (optimize == .Debug);
+    build_options.addOption(bool, "debug_draw", debug_draw);
+
     // Create the zune module that will be shared across all examples
     const libzune = b.addModule("zune", .{
         .root_source_file = b.path("src/root.zig"),
@@ -16,13 +43,15 @@ pub fn build(b: *std.Build) void {
         .target = target,
     });
     
+    libzune.addOptions("build_options", build_options);
+
     // Add include paths for all C libraries
     libzune.addIncludePath(b.path("dependencies/include/"));
 
     // Add object files and C source files
     libzune.addObjectFile(b.path("dependencies/lib/libglfw3.a"));
     libzune.addCSourceFile(.{ .file = b.path("dependencies/lib/glad.c") });
-    libzune.addCSourceFile(.{ .file = b.path("dependencies/lib/stb_image.c") });
+    libzune.addCSourceFile(.{ .file = b.path("dependencies/lib/stb_image.c"), .flags = &.{"-DZUNE_STBI_SCRATCH"} });
     libzune.addCSourceFile(.{ 
         .file = b.path("dependencies/lib/eigen_wrapper.cpp"),
         .flags = &[_][]const u8{
@@ -38,6 +67,7 @@ pub fn build(b: *std.Build) void {
         "camera-controller",
         "resource-manager",
         "game-example",
+        "stress-test",
     };
 
     // create example executable
@@ -75,4 +105,140 @@ pub fn build(b: *std.Build) void {
         run_step.dependOn(&install_step.step);
         run_step.dependOn(&run_cmd.step);
     }
+
+    // Offline texture converter, `zig build texconv -- input.png output.dds`
+    const texconv = b.addExecutable(.{
+        .name = "texconv",
+        .root_source_file = b.path("tools/texconv.zig"),
+        .target = b.graph.host,
+        .optimize = .ReleaseFast,
+    });
+    texconv.addIncludePath(b.path("dependencies/include/"));
+    texconv.addCSourceFile(.{ .file = b.path("dependencies/lib/stb_image.c") });
+    texconv.linkLibC();
+
+    const run_texconv = b.addRunArtifact(texconv);
+    if (b.args) |args| {
+        run_texconv.addArgs(args);
+    }
+    const texconv_step = b.step("texconv", "Convert an image into a BC1/BC3 DDS file with mipmaps");
+    texconv_step.dependOn(&run_texconv.step);
+
+    // Telemetry viewer, `zig build telemetry-view -- [port]` prints what a running Telemetry endpoint sends
+    // It only needs the sample layout, so it builds against core/telemetry.zig alone
+    const telemetry_view = b.addExecutable(.{
+        .name = "telemetry-view",
+        .root_source_file = b.path("tools/telemetry_view.zig"),
+        .target = b.graph.host,
+        .optimize = .ReleaseFast,
+    });
+    telemetry_view.root_module.addImport("telemetry", b.createModule(.{
+        .root_source_file = b.path("src/core/telemetry.zig"),
+        .target = b.graph.host,
+    }));
+
+    const run_telemetry_view = b.addRunArtifact(telemetry_view);
+    if (b.args) |args| {
+        run_telemetry_view.addArgs(args);
+    }
+    const telemetry_view_step = b.step("telemetry-view", "Print the metrics a Telemetry endpoint streams");
+    telemetry_view_step.dependOn(&run_telemetry_view.step);
+
+    // Offline asset cooker, `zig build cook` turns assets/ into zig-out/assets.zpak
+    // It links the engine for the host, only its CPU-side mesh, texture and archive code runs
+    const cook_zune = b.createModule(.{
+        .root_source_file = b.path("src/root.zig"),
+        .target = b.graph.host,
+        .optimize = .ReleaseFast,
+    });
+    cook_zune.addOptions("build_options", build_options);
+    cook_zune.addIncludePath(b.path("dependencies/include/"));
+    cook_zune.addCSourceFile(.{ .file = b.path("dependencies/lib/glad.c") });
+    cook_zune.addCSourceFile(.{ .file = b.path("dependencies/lib/stb_image.c"), .flags = &.{"-DZUNE_STBI_SCRATCH"} });
+    cook_zune.addCSourceFile(.{
+        .file = b.path("dependencies/lib/eigen_wrapper.cpp"),
+        .flags = &[_][]const u8{ "-std=c++17", "-fno-exceptions" },
+    });
+
+    const cook = b.addExecutable(.{
+        .name = "cook",
+        .root_source_file = b.path("tools/cook.zig"),
+        .target = b.graph.host,
+        .optimize = .ReleaseFast,
+    });
+    cook.root_module.addImport("zune", cook_zune);
+    cook.addIncludePath(b.path("dependencies/include/"));
+    cook.linkLibC();
+    cook.linkLibCpp();
+
+    const run_cook = b.addRunArtifact(cook);
+    if (b.args) |args| {
+        run_cook.addArgs(args);
+    } else {
+        run_cook.addArgs(&.{ "assets", b.getInstallPath(.prefix, "assets.zpak"), b.cache_root.join(b.allocator, &.{"cook"}) catch @panic("OOM") });
+    }
+    const cook_step = b.step("cook", "Cook assets/ into an AssetArchive, only re-cooking changed sources");
+    cook_step.dependOn(&run_cook.step);
+
+    // Static lighting bake, `zig build bake-lighting` turns assets/lighting.zon into zig-out/lighting.zpak
+    // Same host build of the engine as the cooker, the bake itself runs on the CPU
+    const bake_lighting = b.addExecutable(.{
+        .name = "bake-lighting",
+        .root_source_file = b.path("tools/bake_lighting.zig"),
+        .target = b.graph.host,
+        .optimize = .ReleaseFast,
+    });
+    bake_lighting.root_module.addImport("zune", cook_zune);
+    bake_lighting.addIncludePath(b.path("dependencies/include/"));
+    bake_lighting.linkLibC();
+    bake_lighting.linkLibCpp();
+
+    const run_bake_lighting = b.addRunArtifact(bake_lighting);
+    if (b.args) |args| {
+        run_bake_lighting.addArgs(args);
+    } else {
+        run_bake_lighting.addArgs(&.{ "assets/lighting.zon", b.getInstallPath(.prefix, "lighting.zpak") });
+    }
+    const bake_lighting_step = b.step("bake-lighting", "Bake the static lights of a scene into a lightmap and irradiance probes");
+    bake_lighting_step.dependOn(&run_bake_lighting.step);
+
+    // Define the benchmarks, `zig build bench` runs all of them
+    // `zig build bench -- --json` prints one JSON document per benchmark instead, see bench/report.zig
+    const benches = .{
+        "math_backends",
+        "ecs_storage",
+        "ecs_query",
+        "render_cubes",
+    };
+    const bench_step = b.step("bench", "Run all benchmarks (use -Doptimize=ReleaseFast)");
+
+    inline for (benches) |bench_name| {
+        const bench = b.addExecutable(.{
+            .name = "bench-" ++ bench_name,
+            .root_source_file = b.path("bench/" ++ bench_name ++ ".zig"),
+            .target = target,
+            .optimize = optimize,
+        });
+        bench.root_module.addImport("zune", libzune);
+        bench.linkLibC();
+
+        // The zune module always pulls in glfw and glad, so the same libraries are needed
+        bench.linkSystemLibrary("gdi32");
+        bench.linkSystemLibrary("user32");
+        bench.linkSystemLibrary("kernel32");
+        bench.linkSystemLibrary("opengl32");
+        bench.linkSystemLibrary("stdc++");
+
+        const install_bench = b.addInstallArtifact(bench, .{});
+        const run_bench = b.addRunArtifact(bench);
+        run_bench.step.dependOn(&install_bench.step);
+        if (b.args) |args| {
+            run_bench.addArgs(args);
+        }
+
+        // Create a specialized run step for this benchmark
+        const run_step = b.step("bench-" ++ bench_name, "Run the " ++ bench_name ++ " benchmark");
+        run_step.dependOn(&run_bench.step);
+        bench_step.dependOn(&run_bench.step);
+    }
 }
\ No newline at end of file
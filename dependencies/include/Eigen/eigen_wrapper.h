@@ -1,6 +1,9 @@
 #ifndef EIGEN_WRAPPER_H
 #define EIGEN_WRAPPER_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -71,18 +74,96 @@ float vec4fLengthSquared(Vec4f v);
 // Public API: Mat4 (Column-Major) Defenitions
 // ============================================================
 
+// Matrices are passed as pointers to 16 column-major floats. All matrix pointers must be
+// 16-byte aligned (the Zig Mat4f guarantees this) so they can be mapped without copies.
 typedef struct {
     float data[16];
 } Mat4f;
 
-Mat4f mat4fIdentity();
-Mat4f mat4fMultiply(Mat4f a, Mat4f b);
+void mat4fIdentity(float* out);
+void mat4fMultiply(const float* a, const float* b, float* out);
+
+void mat4fLookAt(Vec3f eye, Vec3f center, Vec3f up, float* out);
+void mat4fPerspective(float fov, float aspect, float near, float far, float* out);
+void mat4fOrtho(float left, float right, float bottom, float top, float near, float far, float* out);
+Vec3f mat4fTransformPoint(const float* mat, Vec3f point);
+Vec3f mat4fTransformDirection(const float* mat, Vec3f dir);
+
+// Inverses return non-zero on success and leave `out` untouched when the matrix is singular.
+// mat4fAffineInverse assumes the bottom row is (0, 0, 0, 1) and only inverts the upper 3x3.
+int mat4fInverse(const float* mat, float* out);
+int mat4fAffineInverse(const float* mat, float* out);
+
+// Inverse-transpose of the upper 3x3, written as 9 column-major floats to `out`.
+// A singular input produces the cofactor matrix, which still maps normals to the right direction.
+void mat4fNormalMatrix(const float* mat, float* out);
+
+
+
+
+// ============================================================
+// Public API: Batched Mat4 Kernels (Structure of Arrays)
+// ============================================================
+
+// The batched kernels exist once per instruction set level and are picked by CPUID on first use.
+// Baseline is the Eigen code as compiled, the others are built with target attributes for x86-64.
+typedef enum {
+    MATH_KERNELS_BASELINE = 0,
+    MATH_KERNELS_AVX2 = 1,
+    MATH_KERNELS_AVX512 = 2,
+} MathKernelLevel;
+
+MathKernelLevel mathKernelLevel(void);
+
+// Force a level, e.g. to benchmark them against each other. Clamped to what the CPU supports, returns the level used.
+MathKernelLevel mathSetKernelLevel(MathKernelLevel level);
+
+// Transform `count` points given as separate x/y/z arrays. Output arrays may alias the inputs.
+// Performs perspective division per point when the matrix is not affine.
+void mat4fTransformPoints(const float* mat, const float* xs, const float* ys, const float* zs,
+                          float* out_xs, float* out_ys, float* out_zs, size_t count);
+
+// Transform `count` directions (w=0) given as separate x/y/z arrays. Output arrays may alias the inputs.
+void mat4fTransformDirections(const float* mat, const float* xs, const float* ys, const float* zs,
+                              float* out_xs, float* out_ys, float* out_zs, size_t count);
+
+// Array of Structures variants for tightly packed Vec3f arrays. `out` may alias `points`.
+void mat4fTransformPointsAoS(const float* mat, const Vec3f* points, Vec3f* out, size_t count);
+void mat4fTransformDirectionsAoS(const float* mat, const Vec3f* dirs, Vec3f* out, size_t count);
+
+// Normal matrices for `count` consecutive matrices, 9 floats per output. `mats` must be 16-byte aligned.
+void mat4fNormalMatrices(const float* mats, float* out, size_t count);
+
+// out[i] = a[i] * b[i] for `count` consecutive matrix pairs. All arrays must be 16-byte aligned, `out` must not alias.
+void mat4fMultiplyBatch(const float* a, const float* b, float* out, size_t count);
+
+// Scene graph propagation: worlds[i] = worlds[parents[i]] * locals[i], or locals[i] where parents[i] < 0.
+// Parents must come before their children. All arrays must be 16-byte aligned, `worlds` must not alias `locals`.
+void mat4fMultiplyHierarchy(const float* locals, const int32_t* parents, float* worlds, size_t count);
+
+
+
+
+// ============================================================
+// Public API: Affine 3x4 (Row-Major) Definitions
+// ============================================================
+
+// Affine matrices are the top three rows of a 4x4 whose bottom row is (0, 0, 0, 1), stored as
+// 12 row-major floats so each row is one vec4. Pointers must be 16-byte aligned like Mat4f.
+void affine3x4Multiply(const float* a, const float* b, float* out);
+
+// Returns non-zero on success and leaves `out` untouched when the upper 3x3 is singular.
+int affine3x4Inverse(const float* mat, float* out);
+
+// out[i] = a[i] * b[i] for `count` consecutive pairs. All arrays must be 16-byte aligned, `out` must not alias.
+void affine3x4MultiplyBatch(const float* a, const float* b, float* out, size_t count);
+
+// Same as mat4fMultiplyHierarchy for affine matrices
+void affine3x4MultiplyHierarchy(const float* locals, const int32_t* parents, float* worlds, size_t count);
 
-Mat4f mat4fLookAt(Vec3f eye, Vec3f center, Vec3f up);
-Mat4f mat4fPerspective(float fov, float aspect, float near, float far);
-Mat4f mat4fOrtho(float left, float right, float bottom, float top, float near, float far);
-Vec3f mat4fTransformPoint(Mat4f mat, Vec3f point);
-Vec3f mat4fTransformDirection(Mat4f mat, Vec3f dir);
+// Only elements begin..end, whose parents have to be final already, e.g. one level of a breadth-first order split
+// across threads. Indices in `parents` are into the whole arrays.
+void affine3x4MultiplyHierarchyRange(const float* locals, const int32_t* parents, float* worlds, size_t begin, size_t end);
 
 
 
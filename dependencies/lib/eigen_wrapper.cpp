@@ -1,6 +1,331 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define ZUNE_X86 1
+#else
+#define ZUNE_X86 0
+#endif
+
+#include "Eigen/eigen_wrapper.h"
+
+
+// ============================================================
+// Private Helpers: Batched Kernels
+// ============================================================
+
+namespace {
+
+    // Elements per block in the batched kernels. Keeps the temporaries on the stack (and in L1)
+    // while still giving Eigen long enough runs to use full packets.
+    constexpr Eigen::Index kBatchBlock = 256;
+
+    using BlockArray = Eigen::Array<float, Eigen::Dynamic, 1, Eigen::ColMajor, kBatchBlock, 1>;
+
+    // Zero-copy views over the caller's 16-byte aligned column-major matrices
+    using ConstMat4Map = Eigen::Map<const Eigen::Matrix4f, Eigen::Aligned16>;
+    using Mat4Map = Eigen::Map<Eigen::Matrix4f, Eigen::Aligned16>;
+
+    using Mat3Map = Eigen::Map<Eigen::Matrix3f>;
+
+    // Row-major 3x4 affine matrices, each row one 16-byte aligned vec4
+    using Affine3x4 = Eigen::Matrix<float, 3, 4, Eigen::RowMajor>;
+    using ConstAffineMap = Eigen::Map<const Affine3x4, Eigen::Aligned16>;
+    using AffineMap = Eigen::Map<Affine3x4, Eigen::Aligned16>;
+
+    static_assert(sizeof(Vec3f) == 3 * sizeof(float), "Vec3f must be tightly packed for the AoS kernels");
+
+    inline bool isAffine(const float* m) {
+        return m[3] == 0.0f && m[7] == 0.0f && m[11] == 0.0f && m[15] == 1.0f;
+    }
+
+    // Cofactor matrix of the upper 3x3, which equals det * inverse-transpose.
+    // Columns are the cross products of the other two columns.
+    inline Eigen::Matrix3f upperCofactor(const ConstMat4Map& m, float& det) {
+        const Eigen::Vector3f c0 = m.block<3, 1>(0, 0);
+        const Eigen::Vector3f c1 = m.block<3, 1>(0, 1);
+        const Eigen::Vector3f c2 = m.block<3, 1>(0, 2);
+
+        Eigen::Matrix3f cof;
+        cof.col(0) = c1.cross(c2);
+        cof.col(1) = c2.cross(c0);
+        cof.col(2) = c0.cross(c1);
+
+        det = c0.dot(cof.col(0));
+        return cof;
+    }
+
+    // a * b with the implicit (0, 0, 0, 1) bottom rows, the rotation part multiplies as 3x3
+    inline Affine3x4 affineProduct(const ConstAffineMap& a, const ConstAffineMap& b) {
+        Affine3x4 result;
+        result.leftCols<3>().noalias() = a.leftCols<3>() * b.leftCols<3>();
+        result.col(3).noalias() = a.leftCols<3>() * b.col(3) + a.col(3);
+        return result;
+    }
+
+    inline void normalMatrix(const float* mat, float* out) {
+        float det;
+        Eigen::Matrix3f cof = upperCofactor(ConstMat4Map(mat), det);
+        Mat3Map result(out);
+        result = (det != 0.0f) ? Eigen::Matrix3f(cof / det) : cof;
+    }
+
+    // Shared kernel for points (w=1) and directions (w=0).
+    // Stride is 1 for SoA input and 3 for packed Vec3f arrays.
+    template <int Stride, bool IsPoint>
+    void transformBatch(const float* m, const float* xs, const float* ys, const float* zs,
+                        float* out_xs, float* out_ys, float* out_zs, size_t count) {
+        using InMap = Eigen::Map<const Eigen::ArrayXf, Eigen::Unaligned, Eigen::InnerStride<Stride>>;
+        using OutMap = Eigen::Map<Eigen::ArrayXf, Eigen::Unaligned, Eigen::InnerStride<Stride>>;
+
+        // Only projective matrices need the per-point divide
+        const bool project = IsPoint && !isAffine(m);
+
+        for (size_t start = 0; start < count; start += kBatchBlock) {
+            const Eigen::Index len = static_cast<Eigen::Index>(std::min<size_t>(kBatchBlock, count - start));
+            const size_t offset = start * Stride;
+
+            InMap x(xs + offset, len);
+            InMap y(ys + offset, len);
+            InMap z(zs + offset, len);
+
+            // Evaluate into block temporaries first so the outputs may alias the inputs
+            BlockArray rx = m[0] * x + m[4] * y + m[8] * z;
+            BlockArray ry = m[1] * x + m[5] * y + m[9] * z;
+            BlockArray rz = m[2] * x + m[6] * y + m[10] * z;
+
+            if (IsPoint) {
+                rx += m[12];
+                ry += m[13];
+                rz += m[14];
+            }
+
+            if (project) {
+                BlockArray rw = m[3] * x + m[7] * y + m[11] * z + m[15];
+                BlockArray inv_w = (rw != 0.0f).select(rw.inverse(), 1.0f);
+                rx *= inv_w;
+                ry *= inv_w;
+                rz *= inv_w;
+            }
+
+            OutMap(out_xs + offset, len) = rx;
+            OutMap(out_ys + offset, len) = ry;
+            OutMap(out_zs + offset, len) = rz;
+        }
+    }
+}
+
+
+
+
+// ============================================================
+// Private Helpers: CPU Dispatch of the Batched Kernels
+// ============================================================
+
+namespace {
+
+    using TransformFn = void (*)(const float*, const float*, const float*, const float*, float*, float*, float*, size_t);
+    using MultiplyFn = void (*)(const float*, const float*, float*, size_t);
+
+    // One implementation of every batched kernel, picked once per process
+    struct BatchKernels {
+        MathKernelLevel level;
+        TransformFn points;
+        TransformFn directions;
+        TransformFn points_aos;
+        TransformFn directions_aos;
+        MultiplyFn mat4_multiply;
+        MultiplyFn affine_multiply;
+    };
+
+    // Baseline: the Eigen kernels, vectorized for whatever the translation unit is compiled for (SSE2 by default)
+    template <int Stride, bool IsPoint>
+    void eigenTransform(const float* m, const float* xs, const float* ys, const float* zs,
+                        float* out_xs, float* out_ys, float* out_zs, size_t count) {
+        transformBatch<Stride, IsPoint>(m, xs, ys, zs, out_xs, out_ys, out_zs, count);
+    }
+
+    void eigenMat4Multiply(const float* a, const float* b, float* out, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            Mat4Map(out + i * 16).noalias() = ConstMat4Map(a + i * 16) * ConstMat4Map(b + i * 16);
+        }
+    }
+
+    void eigenAffineMultiply(const float* a, const float* b, float* out, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            AffineMap(out + i * 12) = affineProduct(ConstAffineMap(a + i * 12), ConstAffineMap(b + i * 12));
+        }
+    }
+
+#if ZUNE_X86
+    // Eigen chooses its packets from the compile flags, not from target attributes, so the wider
+    // variants are plain loops that get inlined into target-attributed entry points and vectorized there
+    #define ZUNE_ALWAYS_INLINE inline __attribute__((always_inline))
+
+    template <int Stride, bool IsPoint>
+    ZUNE_ALWAYS_INLINE void transformLoop(const float* m, const float* xs, const float* ys, const float* zs,
+                                          float* out_xs, float* out_ys, float* out_zs, size_t count) {
+        const float m0 = m[0], m1 = m[1], m2 = m[2], m3 = m[3];
+        const float m4 = m[4], m5 = m[5], m6 = m[6], m7 = m[7];
+        const float m8 = m[8], m9 = m[9], m10 = m[10], m11 = m[11];
+        const float t0 = IsPoint ? m[12] : 0.0f, t1 = IsPoint ? m[13] : 0.0f, t2 = IsPoint ? m[14] : 0.0f;
+
+        // Every element is read before its outputs are written, so outputs may alias the inputs
+        if (!IsPoint || isAffine(m)) {
+            for (size_t i = 0; i < count; i++) {
+                const size_t k = i * Stride;
+                const float x = xs[k], y = ys[k], z = zs[k];
+                out_xs[k] = m0 * x + m4 * y + m8 * z + t0;
+                out_ys[k] = m1 * x + m5 * y + m9 * z + t1;
+                out_zs[k] = m2 * x + m6 * y + m10 * z + t2;
+            }
+            return;
+        }
+
+        const float m15 = m[15];
+        for (size_t i = 0; i < count; i++) {
+            const size_t k = i * Stride;
+            const float x = xs[k], y = ys[k], z = zs[k];
+            const float w = m3 * x + m7 * y + m11 * z + m15;
+            const float inv_w = w != 0.0f ? 1.0f / w : 1.0f;
+            out_xs[k] = (m0 * x + m4 * y + m8 * z + t0) * inv_w;
+            out_ys[k] = (m1 * x + m5 * y + m9 * z + t1) * inv_w;
+            out_zs[k] = (m2 * x + m6 * y + m10 * z + t2) * inv_w;
+        }
+    }
+
+    ZUNE_ALWAYS_INLINE void mat4MultiplyLoop(const float* a, const float* b, float* out, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            const float* ma = a + i * 16;
+            const float* mb = b + i * 16;
+            float* mo = out + i * 16;
+            for (int col = 0; col < 4; col++) {
+                for (int r = 0; r < 4; r++) {
+                    mo[col * 4 + r] = ma[r] * mb[col * 4] + ma[4 + r] * mb[col * 4 + 1] +
+                                      ma[8 + r] * mb[col * 4 + 2] + ma[12 + r] * mb[col * 4 + 3];
+                }
+            }
+        }
+    }
+
+    ZUNE_ALWAYS_INLINE void affineMultiplyLoop(const float* a, const float* b, float* out, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            const float* ma = a + i * 12;
+            const float* mb = b + i * 12;
+            float* mo = out + i * 12;
+            for (int r = 0; r < 3; r++) {
+                const float* ra = ma + r * 4;
+                for (int col = 0; col < 4; col++) {
+                    mo[r * 4 + col] = ra[0] * mb[col] + ra[1] * mb[4 + col] + ra[2] * mb[8 + col] + (col == 3 ? ra[3] : 0.0f);
+                }
+            }
+        }
+    }
+
+    // Entry points of one instruction set level, the loops above are compiled once per level
+    #define ZUNE_BATCH_VARIANT(PREFIX, TARGET)                                                                 \
+        template <int Stride, bool IsPoint>                                                                   \
+        __attribute__((target(TARGET))) void PREFIX##Transform(const float* m, const float* xs,              \
+                const float* ys, const float* zs, float* out_xs, float* out_ys, float* out_zs, size_t count) { \
+            transformLoop<Stride, IsPoint>(m, xs, ys, zs, out_xs, out_ys, out_zs, count);                     \
+        }                                                                                                     \
+        __attribute__((target(TARGET))) void PREFIX##Mat4Multiply(const float* a, const float* b,            \
+                                                                  float* out, size_t count) {                \
+            mat4MultiplyLoop(a, b, out, count);                                                               \
+        }                                                                                                     \
+        __attribute__((target(TARGET))) void PREFIX##AffineMultiply(const float* a, const float* b,          \
+                                                                    float* out, size_t count) {              \
+            affineMultiplyLoop(a, b, out, count);                                                             \
+        }
+
+    ZUNE_BATCH_VARIANT(avx2, "avx2,fma")
+    ZUNE_BATCH_VARIANT(avx512, "avx512f,avx512vl,avx2,fma")
+
+    #undef ZUNE_BATCH_VARIANT
+
+    inline uint64_t readXcr0() {
+        uint32_t lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return (static_cast<uint64_t>(hi) << 32) | lo;
+    }
+
+    // Highest level both the CPU and the OS (saving the wide registers on context switches) support
+    MathKernelLevel detectLevel() {
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return MATH_KERNELS_BASELINE;
+        const bool fma = ecx & (1u << 12);
+        const bool osxsave = ecx & (1u << 27);
+        const bool avx = ecx & (1u << 28);
+        if (!fma || !osxsave || !avx) return MATH_KERNELS_BASELINE;
+
+        const uint64_t xcr0 = readXcr0();
+        if ((xcr0 & 0x6) != 0x6) return MATH_KERNELS_BASELINE;
+
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return MATH_KERNELS_BASELINE;
+        const bool avx2 = ebx & (1u << 5);
+        const bool avx512f = ebx & (1u << 16);
+        const bool avx512vl = ebx & (1u << 31);
+        if (!avx2) return MATH_KERNELS_BASELINE;
+
+        // Opmask and both halves of the ZMM registers
+        if (avx512f && avx512vl && (xcr0 & 0xE0) == 0xE0) return MATH_KERNELS_AVX512;
+        return MATH_KERNELS_AVX2;
+    }
+#else
+    MathKernelLevel detectLevel() {
+        return MATH_KERNELS_BASELINE;
+    }
+#endif
+
+    constexpr BatchKernels baseline_kernels = {
+        MATH_KERNELS_BASELINE,
+        eigenTransform<1, true>, eigenTransform<1, false>, eigenTransform<3, true>, eigenTransform<3, false>,
+        eigenMat4Multiply, eigenAffineMultiply,
+    };
+
+#if ZUNE_X86
+    constexpr BatchKernels avx2_kernels = {
+        MATH_KERNELS_AVX2,
+        avx2Transform<1, true>, avx2Transform<1, false>, avx2Transform<3, true>, avx2Transform<3, false>,
+        avx2Mat4Multiply, avx2AffineMultiply,
+    };
+
+    constexpr BatchKernels avx512_kernels = {
+        MATH_KERNELS_AVX512,
+        avx512Transform<1, true>, avx512Transform<1, false>, avx512Transform<3, true>, avx512Transform<3, false>,
+        avx512Mat4Multiply, avx512AffineMultiply,
+    };
+#endif
+
+    const BatchKernels* kernelsFor(MathKernelLevel level) {
+        switch (level) {
+#if ZUNE_X86
+            case MATH_KERNELS_AVX512: return &avx512_kernels;
+            case MATH_KERNELS_AVX2: return &avx2_kernels;
+#endif
+            default: return &baseline_kernels;
+        }
+    }
+
+    // Null until the first batched call or mathKernelLevel, then the detected table
+    std::atomic<const BatchKernels*> active_kernels{nullptr};
+
+    const BatchKernels& kernels() {
+        const BatchKernels* table = active_kernels.load(std::memory_order_acquire);
+        if (table == nullptr) {
+            // Racing threads detect the same level, whichever store lands is fine
+            table = kernelsFor(detectLevel());
+            active_kernels.store(table, std::memory_order_release);
+        }
+        return *table;
+    }
+}
+
 
 extern "C" {
     #include "Eigen/eigen_wrapper.h"    
@@ -213,23 +538,25 @@ extern "C" {
     // Public API: Mat4 Implementations
     // ============================================================
 
-    Mat4f mat4fIdentity() {
-        Eigen::Matrix4f m = Eigen::Matrix4f::Identity();
-        Mat4f result;
-        std::memcpy(result.data, m.data(), 16 * sizeof(float)); // Copy the data
-        return result;
+    void mat4fIdentity(float* out) {
+        Mat4Map result(out);
+        result.setIdentity();
     }
     
-    Mat4f mat4fMultiply(Mat4f a, Mat4f b) {
-        Eigen::Map<Eigen::Matrix4f> ea(a.data);  // Map the data directly
-        Eigen::Map<Eigen::Matrix4f> eb(b.data);
-        Eigen::Matrix4f result_eigen = ea * eb;
-        Mat4f result;
-        std::memcpy(result.data, result_eigen.data(), 16 * sizeof(float));
-        return result;
+    void mat4fMultiply(const float* a, const float* b, float* out) {
+        ConstMat4Map ea(a);
+        ConstMat4Map eb(b);
+        Mat4Map result(out);
+
+        // noalias() skips the temporary, which is only safe when out does not overlap an input
+        if (out == a || out == b) {
+            result = ea * eb;
+        } else {
+            result.noalias() = ea * eb;
+        }
     }
 
-    Mat4f mat4fLookAt(Vec3f eye, Vec3f center, Vec3f up) {
+    void mat4fLookAt(Vec3f eye, Vec3f center, Vec3f up, float* out) {
         // Create Eigen vectors directly from Vec3f data
         Eigen::Map<const Eigen::Vector3f> eyeVec(&eye.x);
         Eigen::Map<const Eigen::Vector3f> centerVec(&center.x);
@@ -240,32 +567,23 @@ extern "C" {
         Eigen::Vector3f s = f.cross(upVec).normalized();        // right
         Eigen::Vector3f u = s.cross(f);                         // up
         
-        // Create the result matrix directly
-        Mat4f result = mat4fIdentity();
+        // Write the result matrix directly
+        Mat4Map result(out);
+        result.setIdentity();
         
-        // Fill in the rotation part (sum black magic shit)
-        result.data[0] = s.x();  
-        result.data[1] = u.x();  
-        result.data[2] = -f.x();  
-
-        result.data[4] = s.y();
-        result.data[5] = u.y();
-        result.data[6] = -f.y();
-
-        result.data[8] = s.z();  
-        result.data[9] = u.z();  
-        result.data[10] = -f.z();
+        // Fill in the rotation part (rows are the camera basis)
+        result.block<1, 3>(0, 0) = s.transpose();
+        result.block<1, 3>(1, 0) = u.transpose();
+        result.block<1, 3>(2, 0) = -f.transpose();
         
         // Fill in the translation part
-        result.data[12] = -s.dot(eyeVec);
-        result.data[13] = -u.dot(eyeVec);
-        result.data[14] = f.dot(eyeVec);
-        
-        return result;
+        result(0, 3) = -s.dot(eyeVec);
+        result(1, 3) = -u.dot(eyeVec);
+        result(2, 3) = f.dot(eyeVec);
     }
 
-    Mat4f mat4fPerspective(float fov, float aspect, float near, float far) {
-        Eigen::Matrix4f result = Eigen::Matrix4f::Identity();
+    void mat4fPerspective(float fov, float aspect, float near, float far, float* out) {
+        Mat4Map result(out);
         
         // Calculate perspective matrix
         float tanHalfFov = tan(fov / 2.0f);
@@ -274,29 +592,18 @@ extern "C" {
         // Zero out the matrix first
         result.setZero();
         
-        // Set perspective transformation values for column-major
+        // Set perspective transformation values (storage is column-major like OpenGL)
         result(0, 0) = 1.0f / (aspect * tanHalfFov);
         result(1, 1) = 1.0f / tanHalfFov;
         result(2, 2) = -(far + near) / range;
         result(3, 2) = -1.0f;
         result(2, 3) = -(2.0f * far * near) / range;
-        result(3, 3) = 0.0f;
-    
-        // Convert to our format (also column-major)
-        Mat4f mat;
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < 4; j++) {
-                // Direct copy without transposition since column-major
-                mat.data[j * 4 + i] = result(i, j);
-            }
-        }
-    
-        return mat;
     }
 
     // Orthographic projection matrix
-    Mat4f mat4fOrtho(float left, float right, float bottom, float top, float near, float far) {
-        Eigen::Matrix4f result = Eigen::Matrix4f::Identity();
+    void mat4fOrtho(float left, float right, float bottom, float top, float near, float far, float* out) {
+        Mat4Map result(out);
+        result.setIdentity();
         
         float width = right - left;
         float height = top - bottom;
@@ -305,70 +612,173 @@ extern "C" {
         result(0, 0) = 2.0f / width;
         result(1, 1) = 2.0f / height;
         result(2, 2) = -2.0f / depth;
-        result(3, 0) = -(right + left) / width;
-        result(3, 1) = -(top + bottom) / height;
-        result(3, 2) = -(far + near) / depth;
-        
-        // Convert to our format
-        Mat4f mat;
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < 4; j++) {
-                mat.data[i * 4 + j] = result(j, i);
-            }
-        }
-        return mat;
+        result(0, 3) = -(right + left) / width;
+        result(1, 3) = -(top + bottom) / height;
+        result(2, 3) = -(far + near) / depth;
+    }
+
+    int mat4fInverse(const float* mat, float* out) {
+        Eigen::Matrix4f inverse;
+        bool invertible = false;
+        ConstMat4Map(mat).computeInverseWithCheck(inverse, invertible, 0.0f);
+        if (!invertible) return 0;
+
+        Mat4Map result(out);
+        result = inverse;
+        return 1;
+    }
+
+    int mat4fAffineInverse(const float* mat, float* out) {
+        ConstMat4Map m(mat);
+        float det;
+        Eigen::Matrix3f cof = upperCofactor(m, det);
+        if (det == 0.0f) return 0;
+
+        // inverse(A) = transpose(cofactor(A)) / det, translation is moved into the new space
+        const Eigen::Matrix3f inv = cof.transpose() / det;
+        const Eigen::Vector3f t = -(inv * m.block<3, 1>(0, 3));
+
+        Mat4Map result(out);
+        result.setIdentity();
+        result.topLeftCorner<3, 3>() = inv;
+        result.block<3, 1>(0, 3) = t;
+        return 1;
+    }
+
+    void mat4fNormalMatrix(const float* mat, float* out) {
+        normalMatrix(mat, out);
     }
 
     // Transform a point by a matrix
-    Vec3f mat4fTransformPoint(Mat4f mat, Vec3f point) {
-        // Create Eigen matrix from our matrix format
-        Eigen::Matrix4f matrix;
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < 4; j++) {
-                matrix(j, i) = mat.data[i * 4 + j];
-            }
-        }
-        
-        // Create Eigen vector and extend to homogeneous coordinates
-        Eigen::Vector4f vec(point.x, point.y, point.z, 1.0f);
-        
-        // Transform
-        Eigen::Vector4f result = matrix * vec;
+    Vec3f mat4fTransformPoint(const float* mat, Vec3f point) {
+        // Extend to homogeneous coordinates and transform
+        Eigen::Vector4f result = ConstMat4Map(mat) * Eigen::Vector4f(point.x, point.y, point.z, 1.0f);
         
         // Perspective division if needed
         if (result(3) != 1.0f && result(3) != 0.0f) {
             result = result / result(3);
         }
         
-        // Return result as our vector type
-        Vec3f returnVec;
-        returnVec.x = result(0);
-        returnVec.y = result(1);
-        returnVec.z = result(2);
-        return returnVec;
+        return {result(0), result(1), result(2)};
     }
 
     // Transform a direction by a matrix
-    Vec3f mat4fTransformDirection(Mat4f mat, Vec3f dir) {
-        // Create Eigen matrix from our matrix format
-        Eigen::Matrix4f matrix;
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < 4; j++) {
-                matrix(j, i) = mat.data[i * 4 + j];
+    Vec3f mat4fTransformDirection(const float* mat, Vec3f dir) {
+        // Directions ignore the translation, so only the upper 3x3 is needed
+        Eigen::Vector3f result = ConstMat4Map(mat).topLeftCorner<3, 3>() * Eigen::Vector3f(dir.x, dir.y, dir.z);
+        return {result.x(), result.y(), result.z()};
+    }
+
+
+
+
+    // ============================================================
+    // Public API: Batched Mat4 Kernels (Structure of Arrays)
+    // ============================================================
+
+    MathKernelLevel mathKernelLevel(void) {
+        return kernels().level;
+    }
+
+    MathKernelLevel mathSetKernelLevel(MathKernelLevel level) {
+        const MathKernelLevel supported = std::min(level, detectLevel());
+        active_kernels.store(kernelsFor(supported), std::memory_order_release);
+        return supported;
+    }
+
+    void mat4fTransformPoints(const float* mat, const float* xs, const float* ys, const float* zs,
+                              float* out_xs, float* out_ys, float* out_zs, size_t count) {
+        kernels().points(mat, xs, ys, zs, out_xs, out_ys, out_zs, count);
+    }
+
+    void mat4fTransformDirections(const float* mat, const float* xs, const float* ys, const float* zs,
+                                  float* out_xs, float* out_ys, float* out_zs, size_t count) {
+        kernels().directions(mat, xs, ys, zs, out_xs, out_ys, out_zs, count);
+    }
+
+    void mat4fTransformPointsAoS(const float* mat, const Vec3f* points, Vec3f* out, size_t count) {
+        const float* in = &points->x;
+        float* dst = &out->x;
+        kernels().points_aos(mat, in, in + 1, in + 2, dst, dst + 1, dst + 2, count);
+    }
+
+    void mat4fTransformDirectionsAoS(const float* mat, const Vec3f* dirs, Vec3f* out, size_t count) {
+        const float* in = &dirs->x;
+        float* dst = &out->x;
+        kernels().directions_aos(mat, in, in + 1, in + 2, dst, dst + 1, dst + 2, count);
+    }
+
+    void mat4fNormalMatrices(const float* mats, float* out, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            normalMatrix(mats + i * 16, out + i * 9);
+        }
+    }
+
+    void mat4fMultiplyBatch(const float* a, const float* b, float* out, size_t count) {
+        kernels().mat4_multiply(a, b, out, count);
+    }
+
+    void mat4fMultiplyHierarchy(const float* locals, const int32_t* parents, float* worlds, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            Mat4Map world(worlds + i * 16);
+            if (parents[i] < 0) {
+                world = ConstMat4Map(locals + i * 16);
+            } else {
+                world.noalias() = ConstMat4Map(worlds + static_cast<size_t>(parents[i]) * 16) * ConstMat4Map(locals + i * 16);
             }
         }
-        
-        // Create Eigen vector with w=0 for direction
-        Eigen::Vector4f vec(dir.x, dir.y, dir.z, 0.0f);
-        
-        // Transform
-        Eigen::Vector4f result = matrix * vec;
-        
-        // Return result as our vector type
-        Vec3f returnVec;
-        returnVec.x = result(0);
-        returnVec.y = result(1);
-        returnVec.z = result(2);
-        return returnVec;
-    }
-}
\ No newline at end of file
+    }
+
+
+
+
+    // ============================================================
+    // Public API: Affine 3x4 Implementations
+    // ============================================================
+
+    void affine3x4Multiply(const float* a, const float* b, float* out) {
+        // Built into a temporary first so `out` may alias either input
+        AffineMap result(out);
+        result = affineProduct(ConstAffineMap(a), ConstAffineMap(b));
+    }
+
+    int affine3x4Inverse(const float* mat, float* out) {
+        ConstAffineMap m(mat);
+        const Eigen::Matrix3f r = m.leftCols<3>();
+
+        // inverse(R) = transpose(cofactor(R)) / det, the cofactor columns are crosses of the other two
+        Eigen::Matrix3f cof;
+        cof.col(0) = r.col(1).cross(r.col(2));
+        cof.col(1) = r.col(2).cross(r.col(0));
+        cof.col(2) = r.col(0).cross(r.col(1));
+        const float det = r.col(0).dot(cof.col(0));
+        if (det == 0.0f) return 0;
+
+        const Eigen::Matrix3f inv = cof.transpose() / det;
+        const Eigen::Vector3f t = -(inv * m.col(3));
+
+        AffineMap result(out);
+        result.leftCols<3>() = inv;
+        result.col(3) = t;
+        return 1;
+    }
+
+    void affine3x4MultiplyBatch(const float* a, const float* b, float* out, size_t count) {
+        kernels().affine_multiply(a, b, out, count);
+    }
+
+    void affine3x4MultiplyHierarchy(const float* locals, const int32_t* parents, float* worlds, size_t count) {
+        affine3x4MultiplyHierarchyRange(locals, parents, worlds, 0, count);
+    }
+
+    void affine3x4MultiplyHierarchyRange(const float* locals, const int32_t* parents, float* worlds, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            AffineMap world(worlds + i * 12);
+            if (parents[i] < 0) {
+                world = ConstAffineMap(locals + i * 12);
+            } else {
+                world = affineProduct(ConstAffineMap(worlds + static_cast<size_t>(parents[i]) * 12), ConstAffineMap(locals + i * 12));
+            }
+        }
+    }
+}
@@ -1,2 +1,13 @@
+#ifdef ZUNE_STBI_SCRATCH
+// Allocations go through src/renderer/image_decode.zig, into a per-thread scratch arena while it decodes
+#include <stddef.h>
+void *zune_stbi_malloc(size_t size);
+void *zune_stbi_realloc(void *ptr, size_t new_size);
+void zune_stbi_free(void *ptr);
+#define STBI_MALLOC(sz) zune_stbi_malloc(sz)
+#define STBI_REALLOC(p, newsz) zune_stbi_realloc(p, newsz)
+#define STBI_FREE(p) zune_stbi_free(p)
+#endif
+
 #define STB_IMAGE_IMPLEMENTATION
-#include "stb_image/stb_image.h"
\ No newline at end of file
+#include "stb_image/stb_image.h"
@@ -132,8 +132,10 @@ pub fn main() !void {
         transform_1.updateMatrices();
         transform_2.updateMatrices();
 
-        try perspective_camera.drawModel(cube_model_1, &transform_1.world_matrix);
-        try perspective_camera.drawModel(cube_model_2, &transform_2.world_matrix);
+        var world_1 = transform_1.world_matrix.toMat4();
+        var world_2 = transform_2.world_matrix.toMat4();
+        try perspective_camera.drawModel(cube_model_1, &world_1);
+        try perspective_camera.drawModel(cube_model_2, &world_2);
     
         try window.pollEvents();
         window.swapBuffers();
@@ -126,40 +126,47 @@ pub fn main() !void {
     //try registry.registerComponent(Lifetime);
     try registry.registerDeferedComponent(Lifetime, "customCleanup");
 
+    // Keeps world matrices up to date, including parent/child hierarchies
+    var transform_system = try zune.ecs.systems.TransformSystem.init(allocator, registry);
+    defer transform_system.deinit();
+
 
     // Create random generater
     var prng = std.Random.DefaultPrng.init(0);
     var random = prng.random();
 
 
+    // Build a particle once, then stamp out copies of it storage by storage
+    const template = try registry.createEntity();
+    try registry.addComponent(template, zune.ecs.components.TransformComponent.identity());
+    try registry.addComponent(template, Velocity{ .x = 0, .y = 0 });
+    try registry.addComponent(template, Lifetime{ .remaining = 0 });
+    try registry.addComponent(template, zune.ecs.components.ModelComponent.init(cube_model));
+
+    var particle = try zune.ecs.Prefab.fromEntity(allocator, registry, template);
+    defer particle.deinit();
+    try registry.destroyEntity(template);
+
     // Spawn 100 particle entities
-    var i: usize = 0;
-    while (i < 100) : (i += 1) {
-        const entity = try registry.createEntity();
+    var particles: [100]zune.ecs.EntityId = undefined;
+    try particle.instantiate(registry, &particles);
 
-        var transform = zune.ecs.components.TransformComponent.identity();
-        transform.setPosition(
+    for (particles) |entity| {
+        // Random position
+        registry.getComponent(entity, zune.ecs.components.TransformComponent).?.setPosition(
             random.float(f32),
             random.float(f32),
             0.0,
         );
 
-        // Random position
-        try registry.addComponent(entity, transform);
-
         // Random velocity
-        try registry.addComponent(entity, Velocity{
+        registry.getComponent(entity, Velocity).?.* = .{
             .x = (random.float(f32) - 0.5) * 0.2,
             .y = (random.float(f32) - 0.5) * 0.2,
-        });
-        
-        // Random lifetime
-        try registry.addComponent(entity, Lifetime{
-            .remaining = random.float(f32) * 10.0,
-        });
+        };
 
-        // Set Model to render
-        try registry.addComponent(entity, zune.ecs.components.ModelComponent.init(cube_model));
+        // Random lifetime
+        registry.getComponent(entity, Lifetime).?.remaining = random.float(f32) * 10.0;
     }
 
     const dynamic = try registry.createEntity();
@@ -197,6 +204,8 @@ pub fn main() !void {
 
 
         // ==== Drawing to the screen ==== //
+        try transform_system.update();
+
         renderer.clear();
         try render(&perspective_camera, registry);
 
@@ -220,6 +229,11 @@ const Lifetime = struct {
     pub fn customCleanup(self: *Lifetime) void {
         std.debug.print("Deinit: {any}\n", .{self});
     }
+
+    /// Lets prefabs copy it, every copy gets cleaned up on its own
+    pub fn clone(self: *const Lifetime) Lifetime {
+        return self.*;
+    }
 };
 
 
@@ -237,8 +251,7 @@ fn updatePhysics(registry: *zune.ecs.Registry) !void {
     while (try query.next()) |components| {
 
         // Update position
-        components.transform.position.x += components.velocity.x;
-        components.transform.position.y += components.velocity.y;
+        components.transform.translate(components.velocity.x, components.velocity.y, 0);
 
         // Update lifetime
         components.life.remaining -= 1.0 / 60.0;
@@ -260,13 +273,8 @@ pub fn render(camera: *zune.graphics.Camera, registry: *zune.ecs.Registry) !void
         // Skip if not visible
         if (!components.model.visible) continue;
 
-        // Update transform matrices
-        components.transform.updateMatrices();
-
         // Draw the model using current transform
-        try camera.drawModel(
-            components.model.model,
-            &components.transform.world_matrix,
-        );
+        var world = components.transform.world_matrix.toMat4();
+        try camera.drawModel(components.model.model, &world);
     }
 }
\ No newline at end of file
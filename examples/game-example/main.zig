@@ -29,6 +29,22 @@ pub fn main() !void {
     window.setCursorMode(.disabled);
 
 
+    // map movement to actions, evaluated by every input update
+    const actions = try zune.core.ActionMap.create(allocator, &.{
+        .{ .name = "move_x", .bindings = &.{.{ .axis = .{ .negative = .KEY_A, .positive = .KEY_D } }} },
+        .{ .name = "move_z", .bindings = &.{.{ .axis = .{ .negative = .KEY_W, .positive = .KEY_S } }} },
+        .{ .name = "inspect", .bindings = &.{.{ .key = .KEY_K }} },
+    });
+    defer actions.release();
+    window.input.?.setActionMap(actions);
+    const controls = PlayerControls{
+        .actions = actions,
+        .move_x = actions.find("move_x").?,
+        .move_z = actions.find("move_z").?,
+        .inspect = actions.find("inspect").?,
+    };
+
+
     // create a Renderer
     var renderer = try zune.graphics.Renderer.create(allocator, .{});
     defer renderer.release();
@@ -83,6 +99,10 @@ pub fn main() !void {
     try registry.registerComponent(zune.ecs.components.ModelComponent);
     try registry.registerComponent(Velocity);
 
+    // Keeps world matrices up to date, including parent/child hierarchies
+    var transform_system = try zune.ecs.systems.TransformSystem.init(allocator, registry);
+    defer transform_system.deinit();
+
     // Spawn 1 entity
     const entity = try registry.createEntity();
 
@@ -118,10 +138,12 @@ pub fn main() !void {
 
 
         // ==== Update Program ==== //
-        try playerMovementSystem(registry, window.input.?);
+        try playerMovementSystem(registry, controls);
 
 
         // ==== Drawing to the screen ==== //
+        try transform_system.update();
+
         renderer.clear();
         try render(&perspective_camera, registry);
 
@@ -138,40 +160,34 @@ const Velocity = struct {
 };
 
 
-fn playerMovementSystem(registry: *zune.ecs.Registry, input: *zune.core.Input) !void {
+/// Action ids resolved once when the map is created
+const PlayerControls = struct {
+    actions: *zune.core.ActionMap,
+    move_x: zune.core.ActionId,
+    move_z: zune.core.ActionId,
+    inspect: zune.core.ActionId,
+};
+
+
+fn playerMovementSystem(registry: *zune.ecs.Registry, controls: PlayerControls) !void {
     var query = try registry.query(struct {
         transform: *zune.ecs.components.TransformComponent,
         velocity: *Velocity,
     });
 
+    const actions = controls.actions;
     while (try query.next()) |components| {
 
         // Update position
-        if (input.isKeyHeld(.KEY_W)) {
-            components.velocity.z = -0.05;
-            components.transform.position.z += components.velocity.z;
-        }
-
-        if (input.isKeyHeld(.KEY_S)) {
-            components.velocity.z = 0.05;
-            components.transform.position.z += components.velocity.z;
-        }
-
-        if (input.isKeyHeld(.KEY_D)) {
-            components.velocity.x = 0.05;
-            components.transform.position.x += components.velocity.x;
-        }
-
-        if (input.isKeyHeld(.KEY_A)) {
-            components.velocity.x = -0.05;
-            components.transform.position.x += components.velocity.x;
-        }
+        components.velocity.x = actions.value(controls.move_x) * 0.05;
+        components.velocity.z = actions.value(controls.move_z) * 0.05;
+        components.transform.translate(components.velocity.x, 0, components.velocity.z);
 
-        if (input.wasKeyJustPressed(.KEY_K, 60)) {
+        if (actions.isPressed(controls.inspect)) {
             std.debug.print("K +++\n", .{});
         }
 
-        if (input.wasKeyJustReleased(.KEY_K, 60)) {
+        if (actions.isReleased(controls.inspect)) {
             std.debug.print("K ---\n", .{});
         }
     }
@@ -189,13 +205,8 @@ pub fn render(camera: *zune.graphics.Camera, registry: *zune.ecs.Registry) !void
         // Skip if not visible
         if (!components.model.visible) continue;
 
-        // Update transform matrices
-        components.transform.updateMatrices();
-
         // Draw the model using current transform
-        try camera.drawModel(
-            components.model.model,
-            &components.transform.world_matrix,
-        );
+        var world = components.transform.world_matrix.toMat4();
+        try camera.drawModel(components.model.model, &world);
     }
 }
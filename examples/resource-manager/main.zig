@@ -118,7 +118,8 @@ pub fn main() !void {
 
         main_cube_transform.updateMatrices();
 
-        try perspective_camera.drawModel(main_cube_model, &main_cube_transform.world_matrix);
+        var main_cube_world = main_cube_transform.world_matrix.toMat4();
+        try perspective_camera.drawModel(main_cube_model, &main_cube_world);
     
         try window.pollEvents();
         window.swapBuffers();
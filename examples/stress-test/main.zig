@@ -0,0 +1,369 @@
+const std = @import("std");
+const zune = @import("zune");
+
+const WINDOW_WIDTH = 1600;
+const WINDOW_HEIGHT = 900;
+
+/// Entities spawned without an argument, `zig build run-stress-test -- 1000000` spawns a million
+const DEFAULT_ENTITY_COUNT = 100_000;
+/// Half the edge of the cube the entities bounce around in
+const WORLD_EXTENT: f32 = 200.0;
+/// Entities per job when movement runs in parallel
+const MOVEMENT_CHUNK = 4096;
+
+const TransformComponent = zune.ecs.components.TransformComponent;
+const ModelComponent = zune.ecs.components.ModelComponent;
+
+
+/// How the movement system walks the entities
+/// The registry stores every component type in its own dense array, there is no separate SoA mode
+/// to switch to, so this compares the query path against iterating those arrays directly
+const MovementMode = enum {
+    /// Query.next, one lookup per component per entity
+    query,
+    /// The dense Velocity array, looking up each transform by entity
+    dense,
+    /// `dense`, split into chunks across the job system
+    parallel,
+
+    fn next(self: MovementMode) MovementMode {
+        return switch (self) {
+            .query => .dense,
+            .dense => .parallel,
+            .parallel => .query,
+        };
+    }
+};
+
+
+/// Everything toggled at runtime
+const Features = struct {
+    /// One instanced draw per model through RenderSystem, or one drawModel per entity
+    instancing: bool = true,
+    /// Cull through the SpatialSystem tree instead of testing every entity
+    spatial_culling: bool = false,
+    movement: MovementMode = .dense,
+};
+
+
+const Velocity = struct {
+    x: f32,
+    y: f32,
+    z: f32,
+};
+
+
+pub fn main() !void {
+
+    // ==== Initializing Everything ==== //
+
+    // Initialize allocator
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    const allocator = gpa.allocator();
+    defer _ = gpa.deinit();
+
+    const entity_count = try entityCountFromArgs(allocator);
+
+
+    // create a window
+    const window = try zune.core.Window.create(allocator, .{
+        .title = "zune stress-test",
+        .width = WINDOW_WIDTH,
+        .height = WINDOW_HEIGHT,
+        .vsync = false,
+    });
+    defer window.release();
+    window.centerWindow();
+
+
+    // toggles and stats keys
+    const actions = try zune.core.ActionMap.create(allocator, &.{
+        .{ .name = "toggle_instancing", .bindings = &.{.{ .key = .KEY_F1 }} },
+        .{ .name = "toggle_culling", .bindings = &.{.{ .key = .KEY_F2 }} },
+        .{ .name = "cycle_movement", .bindings = &.{.{ .key = .KEY_F3 }} },
+        .{ .name = "save_trace", .bindings = &.{.{ .key = .KEY_F5 }} },
+        .{ .name = "quit", .bindings = &.{.{ .key = .KEY_ESCAPE }} },
+    });
+    defer actions.release();
+    window.input.?.setActionMap(actions);
+    const toggle_instancing = actions.find("toggle_instancing").?;
+    const toggle_culling = actions.find("toggle_culling").?;
+    const cycle_movement = actions.find("cycle_movement").?;
+    const save_trace = actions.find("save_trace").?;
+    const quit = actions.find("quit").?;
+
+
+    // Charge the renderer, the registry and the workers separately, the report at exit shows who allocates per frame
+    var tracker: zune.core.TrackingAllocator = undefined;
+    tracker.init(allocator, .{});
+    defer tracker.deinit();
+    defer tracker.writeReport(std.io.getStdErr().writer(), 0) catch {};
+
+
+    // create a Renderer
+    const renderer = try zune.graphics.Renderer.create(tracker.allocator(.renderer), .{
+        .clear_color = .{ 0.05, 0.05, 0.08, 1.0 },
+        .initial_viewport = .{ .x = 0, .y = 0, .width = WINDOW_WIDTH, .height = WINDOW_HEIGHT },
+    });
+    defer renderer.release();
+
+
+    // worker threads for parallel movement
+    var jobs: zune.core.JobSystem = undefined;
+    try jobs.init(tracker.allocator(.jobs), .{});
+    defer jobs.deinit();
+
+
+    // Initialize ECS registry, its component lists grow in reserved address space instead of being copied
+    var dense_memory = zune.core.VirtualAllocator.init(tracker.allocator(.ecs), .{ .reserve_bytes = 256 << 20 });
+    const registry = try zune.ecs.Registry.create(tracker.allocator(.ecs));
+    defer registry.release();
+    registry.setDenseAllocator(dense_memory.allocator());
+
+    var time = try zune.core.Time.init(.{ .target_fps = 0 });
+    defer time.deinit();
+
+
+
+    // ==== Set Variables ==== //
+
+    // create a camera looking at the whole field
+    var camera = zune.graphics.Camera.initPerspective(renderer, std.math.degreesToRadians(60.0), @as(f32, WINDOW_WIDTH) / WINDOW_HEIGHT, 0.5, 2000.0);
+    camera.setPosition(.{ .x = 0.0, .y = WORLD_EXTENT, .z = WORLD_EXTENT * 2.5 });
+    camera.lookAt(.{ .x = 0.0, .y = 0.0, .z = 0.0 });
+
+
+    // Create the model
+    const shader = try zune.graphics.Shader.createColorShader(allocator);
+    defer _ = shader.release();
+    const material = try zune.graphics.Material.create(allocator, shader, .{ 0.9, 0.6, 0.2, 1.0 }, null);
+    defer _ = material.release();
+    const cube_mesh = try zune.graphics.Mesh.createCube(allocator);
+    defer _ = cube_mesh.release();
+    const cube_model = try zune.graphics.Model.create(allocator);
+    defer _ = cube_model.release();
+
+    try cube_model.addMeshMaterial(cube_mesh, material);
+
+
+
+    // ==== Setup ECS ==== //
+
+    // Register components
+    try registry.registerComponent(ModelComponent);
+    try registry.registerComponent(Velocity);
+
+    var transform_system = try zune.ecs.systems.TransformSystem.init(allocator, registry);
+    defer transform_system.deinit();
+    var spatial_system = try zune.ecs.systems.SpatialSystem.init(allocator, registry, zune.ecs.systems.SpatialSystem.default_margin);
+    defer spatial_system.deinit();
+    var render_system = zune.ecs.systems.RenderSystem.init(allocator, registry, &camera);
+    defer render_system.deinit();
+    render_system.viewport_height = WINDOW_HEIGHT;
+
+
+    // Spawn the entities at random positions and velocities
+    var prng = std.Random.DefaultPrng.init(0x5eed);
+    const random = prng.random();
+    for (0..entity_count) |_| {
+        const entity = try registry.createEntity();
+
+        var transform = TransformComponent.identity();
+        transform.setPosition(randomRange(random, WORLD_EXTENT), randomRange(random, WORLD_EXTENT), randomRange(random, WORLD_EXTENT));
+        try registry.addComponent(entity, transform);
+        try registry.addComponent(entity, ModelComponent.init(cube_model));
+        try registry.addComponent(entity, Velocity{
+            .x = randomRange(random, 20.0),
+            .y = randomRange(random, 20.0),
+            .z = randomRange(random, 20.0),
+        });
+    }
+    std.debug.print("stress-test: {d} entities, F1 instancing, F2 spatial culling, F3 movement mode, F5 save trace\n", .{entity_count});
+
+
+
+    // Stream frame times, renderer and ECS counters, watch them with `zig build telemetry-view`
+    var telemetry = zune.core.Telemetry{};
+    telemetry.start(.{}) catch |e| std.debug.print("telemetry disabled: {s}\n", .{@errorName(e)});
+    defer telemetry.stop();
+
+
+
+    // ==== Main Loop ==== //
+
+    var features = Features{};
+    var stats_timer: f32 = 0.0;
+    var title_buffer: [256]u8 = undefined;
+
+    while (!window.shouldClose()) {
+        const frame_zone = zune.core.profiler.zone("Frame");
+        defer frame_zone.end();
+
+        // ==== Update Variables ==== //
+        time.update();
+        const delta = time.getDelta();
+
+
+        // ==== Process Input ==== //
+        if (actions.isPressed(quit)) break;
+        if (actions.isPressed(toggle_instancing)) features.instancing = !features.instancing;
+        if (actions.isPressed(toggle_culling)) {
+            features.spatial_culling = !features.spatial_culling;
+            render_system.spatial = if (features.spatial_culling) &spatial_system else null;
+        }
+        if (actions.isPressed(cycle_movement)) features.movement = features.movement.next();
+        if (actions.isPressed(save_trace)) {
+            zune.core.profiler.saveChromeTrace(allocator, "stress-test-trace.json") catch |e| {
+                std.debug.print("could not save the trace: {s}\n", .{@errorName(e)});
+            };
+        }
+
+
+        // ==== Update Program ==== //
+        try moveEntities(registry, &jobs, features.movement, delta);
+        try transform_system.update();
+        if (features.spatial_culling) try spatial_system.update();
+
+
+        // ==== Drawing to the screen ==== //
+        renderer.clear();
+        if (features.instancing) {
+            try render_system.update();
+        } else {
+            try drawEachEntity(registry, &camera);
+        }
+        renderer.endFrame();
+
+        try window.pollEvents();
+        window.swapBuffers();
+        zune.core.profiler.frameMark();
+        tracker.endFrame();
+
+        if (telemetry.wantsSample()) {
+            var sample = zune.core.TelemetrySample{};
+            sample.setTime(&time);
+            sample.setRenderStats(renderer.stats);
+            sample.setRegistryStats(registry.stats());
+            if (window.getInput()) |input| sample.setInputLatency(input.getInputLatencyStats());
+            telemetry.publish(sample);
+        }
+
+
+        // ==== Live Stats ==== //
+        stats_timer += delta;
+        if (stats_timer >= 0.5) {
+            stats_timer = 0.0;
+            const title = try std.fmt.bufPrintZ(&title_buffer, "zune stress-test | {d} entities | {d:.0} fps {d:.2} ms | instancing {s} | culling {s} | movement {s}", .{
+                entity_count,
+                time.getFPS(),
+                @as(f32, @floatFromInt(time.getDeltaNs())) / std.time.ns_per_ms,
+                if (features.instancing) "on" else "off",
+                if (features.spatial_culling) "tree" else "linear",
+                @tagName(features.movement),
+            });
+            window.setTitle(title);
+            if (zune.graphics.render_stats.enabled) std.debug.print("{}\n", .{renderer.frameStats()});
+        }
+    }
+}
+
+
+fn entityCountFromArgs(allocator: std.mem.Allocator) !usize {
+    var args = try std.process.argsWithAllocator(allocator);
+    defer args.deinit();
+    _ = args.skip();
+    const arg = args.next() orelse return DEFAULT_ENTITY_COUNT;
+    return std.fmt.parseInt(usize, arg, 10) catch DEFAULT_ENTITY_COUNT;
+}
+
+
+fn randomRange(random: std.Random, extent: f32) f32 {
+    return (random.float(f32) * 2.0 - 1.0) * extent;
+}
+
+
+/// Step `transform` along `velocity` and bounce it off the walls of the world
+fn step(transform: *TransformComponent, velocity: *Velocity, delta: f32) void {
+    const position = transform.position;
+    var x = position.x + velocity.x * delta;
+    var y = position.y + velocity.y * delta;
+    var z = position.z + velocity.z * delta;
+    if (@abs(x) > WORLD_EXTENT) {
+        velocity.x = -velocity.x;
+        x = std.math.clamp(x, -WORLD_EXTENT, WORLD_EXTENT);
+    }
+    if (@abs(y) > WORLD_EXTENT) {
+        velocity.y = -velocity.y;
+        y = std.math.clamp(y, -WORLD_EXTENT, WORLD_EXTENT);
+    }
+    if (@abs(z) > WORLD_EXTENT) {
+        velocity.z = -velocity.z;
+        z = std.math.clamp(z, -WORLD_EXTENT, WORLD_EXTENT);
+    }
+    transform.setPosition(x, y, z);
+}
+
+
+const MovementChunk = struct {
+    velocities: *zune.ecs.ComponentStorage(Velocity),
+    transforms: *zune.ecs.ComponentStorage(TransformComponent),
+    delta: f32,
+
+    fn run(self: *const MovementChunk, start: usize, end: usize) void {
+        const entities = self.velocities.entitySlice()[start..end];
+        for (entities, self.velocities.componentSlice()[start..end]) |entity, *velocity| {
+            const transform = self.transforms.get(entity) orelse continue;
+            step(transform, velocity, self.delta);
+        }
+    }
+};
+
+
+fn moveEntities(registry: *zune.ecs.Registry, jobs: *zune.core.JobSystem, mode: MovementMode, delta: f32) !void {
+    const zone = zune.core.profiler.zone("moveEntities");
+    defer zone.end();
+
+    switch (mode) {
+        .query => {
+            var query = try registry.query(struct {
+                transform: *TransformComponent,
+                velocity: *Velocity,
+            });
+            while (try query.next()) |components| step(components.transform, components.velocity, delta);
+        },
+        .dense, .parallel => {
+            const chunk = MovementChunk{
+                .velocities = try registry.getComponentStorage(Velocity),
+                .transforms = try registry.getComponentStorage(TransformComponent),
+                .delta = delta,
+            };
+            const count = chunk.velocities.entitySlice().len;
+            if (mode == .dense) {
+                chunk.run(0, count);
+            } else {
+                jobs.parallelFor(count, MOVEMENT_CHUNK, &chunk, MovementChunk.run);
+            }
+        },
+    }
+}
+
+
+/// The path without instancing or batching, one draw call per visible entity
+fn drawEachEntity(registry: *zune.ecs.Registry, camera: *zune.graphics.Camera) !void {
+    const zone = zune.core.profiler.zone("drawEachEntity");
+    defer zone.end();
+
+    const frustum = camera.getFrustum();
+    var query = try registry.query(struct {
+        transform: *TransformComponent,
+        model: *ModelComponent,
+    });
+    while (try query.next()) |components| {
+        if (!components.model.visible) continue;
+        const bounds = components.model.model.bounds.transformedAffine(&components.transform.render_matrix);
+        if (!frustum.intersectsBox(bounds)) continue;
+
+        var model_matrix = components.transform.render_matrix.toMat4();
+        try camera.drawModel(components.model.model, &model_matrix);
+    }
+}
@@ -0,0 +1,418 @@
+// audio/mixer.zig - voices mixed on a real-time thread of their own, controlled through lock-free queues
+const std = @import("std");
+
+const SpscQueue = @import("../core/spsc_queue.zig").SpscQueue;
+const Sound = @import("sound.zig").Sound;
+
+
+/// Names a playing sound, 0 is never a voice
+pub const VoiceId = u32;
+
+
+pub const AudioMixerConfig = struct {
+    /// Output rate, sounds at other rates are resampled
+    sample_rate: u32 = 48000,
+    /// Frames per mixed block, rounded up to a multiple of 4. The output holds one or two of them,
+    /// so this is most of the latency: 256 frames are 5.3ms at 48kHz
+    block_frames: u32 = 256,
+    /// Voices mixed at once, plays beyond it are dropped and reported finished right away
+    max_voices: u32 = 512,
+};
+
+
+/// Where the mix thread hands each block, e.g. a thin layer over WASAPI or ALSA
+/// `func` is called on the mix thread with interleaved stereo samples and should block until the
+/// device has room for them, which paces the mix. It must not lock or allocate either
+pub const AudioOutput = struct {
+    func: *const fn (context: ?*anyopaque, samples: []const f32) void,
+    context: ?*anyopaque = null,
+};
+
+
+/// Discards the mix at the pace a device would play it, for servers and tests without sound
+pub const NullOutput = struct {
+    sample_rate: u32 = 48000,
+    /// When the device would run out of the blocks written so far
+    due_ns: i128 = 0,
+
+    pub fn output(self: *NullOutput) AudioOutput {
+        return .{ .func = write, .context = self };
+    }
+
+
+    fn write(context: ?*anyopaque, samples: []const f32) void {
+        const self: *NullOutput = @alignCast(@ptrCast(context.?));
+        const now = std.time.nanoTimestamp();
+        const block_ns = @divTrunc(@as(i128, samples.len / 2) * std.time.ns_per_s, self.sample_rate);
+        if (self.due_ns < now) self.due_ns = now;
+        self.due_ns += block_ns;
+        // Keep one block ahead, as a device buffer would
+        const wait = self.due_ns - block_ns - now;
+        if (wait > 0) std.time.sleep(@intCast(wait));
+    }
+};
+
+
+pub const PlayOptions = struct {
+    gain: f32 = 1.0,
+    /// -1 is left, 1 is right, at equal power in between
+    pan: f32 = 0.0,
+    /// Playback rate, 2 is an octave up
+    pitch: f32 = 1.0,
+    looping: bool = false,
+};
+
+
+pub const AudioStats = struct {
+    active_voices: u32,
+    blocks_mixed: u64,
+    /// Time to mix the last block and the longest one, a block's duration is the budget
+    last_mix_ns: u64,
+    max_mix_ns: u64,
+    /// Plays past max_voices
+    voices_dropped: u64,
+    /// Commands lost to a full queue, call from the game thread more sparingly or drain faster
+    commands_dropped: u64,
+};
+
+
+/// Mixes hundreds of voices on a thread that never locks or allocates: the game thread sends plays
+/// and changes through a single-producer queue, and gets finished voices back through another, so
+/// it knows when a Sound is free to release. Each block resamples every voice linearly into a
+/// scratch buffer and adds it to the mix with 8-wide vectors, ramping gains across the block so
+/// changes and stops don't click. Only one thread may call the control functions
+pub const AudioMixer = struct {
+    const Self = @This();
+
+    const command_capacity = 1024;
+    const finished_capacity = 1024;
+    const lanes = 8;
+    const Lanes = @Vector(lanes, f32);
+    /// Positions are 32.32 fixed point frames of the voice's sound
+    const fraction_bits = 32;
+    const max_pitch = 16.0;
+
+    const Command = struct {
+        kind: enum { play, stop, set_gain, set_pan, set_pitch, set_master, stop_all },
+        voice: VoiceId = 0,
+        sound: ?*const Sound = null,
+        options: PlayOptions = .{},
+        value: f32 = 0.0,
+    };
+
+    const Voice = struct {
+        id: VoiceId,
+        sound: *const Sound,
+        options: PlayOptions,
+        position: u64 = 0,
+        step: u64 = 0,
+        /// Gains reached by the end of the last block, ramped towards the targets in the next
+        left: f32 = 0.0,
+        right: f32 = 0.0,
+        /// Fades out over the next block and ends
+        stopping: bool = false,
+    };
+
+    allocator: std.mem.Allocator,
+    config: AudioMixerConfig,
+    output: AudioOutput,
+
+    commands: SpscQueue(Command, command_capacity) = .{},
+    /// Filled by the mix thread, drained by pollFinished
+    finished: SpscQueue(VoiceId, finished_capacity) = .{},
+
+    /// Game thread only
+    next_voice: VoiceId = 1,
+    commands_dropped: u64 = 0,
+
+    /// Mix thread only, the live voices are voices[0..active]
+    voices: []Voice,
+    active: usize = 0,
+    master_gain: f32 = 1.0,
+    mix_buffer: []f32,
+    voice_buffer: []f32,
+
+    running: std.atomic.Value(bool) = std.atomic.Value(bool).init(true),
+    active_voices: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    blocks_mixed: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    last_mix_ns: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    max_mix_ns: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    voices_dropped: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+
+    thread: std.Thread = undefined,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Allocate every voice and buffer up front and start the mix thread writing to `output`
+    pub fn create(allocator: std.mem.Allocator, output: AudioOutput, config: AudioMixerConfig) !*Self {
+        var actual = config;
+        actual.block_frames = std.mem.alignForward(u32, @max(config.block_frames, 4), 4);
+
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+        const voices = try allocator.alloc(Voice, actual.max_voices);
+        errdefer allocator.free(voices);
+        const mix_buffer = try allocator.alloc(f32, actual.block_frames * 2);
+        errdefer allocator.free(mix_buffer);
+        const voice_buffer = try allocator.alloc(f32, actual.block_frames * 2);
+        errdefer allocator.free(voice_buffer);
+
+        self.* = .{
+            .allocator = allocator,
+            .config = actual,
+            .output = output,
+            .voices = voices,
+            .mix_buffer = mix_buffer,
+            .voice_buffer = voice_buffer,
+        };
+        self.thread = try std.Thread.spawn(.{}, mixMain, .{self});
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Start `sound` on a new voice, 0 when the command queue is full
+    /// The sound must stay alive until pollFinished returns the voice
+    pub fn play(self: *Self, sound: *const Sound, options: PlayOptions) VoiceId {
+        const voice = self.next_voice;
+        if (!self.send(.{ .kind = .play, .voice = voice, .sound = sound, .options = options })) return 0;
+        self.next_voice +%= 1;
+        if (self.next_voice == 0) self.next_voice = 1;
+        return voice;
+    }
+
+
+    /// Fade the voice out over one block, it is reported finished after
+    pub fn stop(self: *Self, voice: VoiceId) void {
+        _ = self.send(.{ .kind = .stop, .voice = voice });
+    }
+
+
+    pub fn stopAll(self: *Self) void {
+        _ = self.send(.{ .kind = .stop_all });
+    }
+
+
+    pub fn setGain(self: *Self, voice: VoiceId, gain: f32) void {
+        _ = self.send(.{ .kind = .set_gain, .voice = voice, .value = gain });
+    }
+
+
+    pub fn setPan(self: *Self, voice: VoiceId, pan: f32) void {
+        _ = self.send(.{ .kind = .set_pan, .voice = voice, .value = pan });
+    }
+
+
+    pub fn setPitch(self: *Self, voice: VoiceId, pitch: f32) void {
+        _ = self.send(.{ .kind = .set_pitch, .voice = voice, .value = pitch });
+    }
+
+
+    /// Gain of the whole mix, applied before the output is clamped to [-1, 1]
+    pub fn setMasterGain(self: *Self, gain: f32) void {
+        _ = self.send(.{ .kind = .set_master, .value = gain });
+    }
+
+
+    /// A voice that ended, was stopped or was dropped, null once there is none
+    /// Finished voices are lost when this isn't called for more than a thousand of them
+    pub fn pollFinished(self: *Self) ?VoiceId {
+        return self.finished.pop();
+    }
+
+
+    pub fn getStats(self: *const Self) AudioStats {
+        return .{
+            .active_voices = self.active_voices.load(.monotonic),
+            .blocks_mixed = self.blocks_mixed.load(.monotonic),
+            .last_mix_ns = self.last_mix_ns.load(.monotonic),
+            .max_mix_ns = self.max_mix_ns.load(.monotonic),
+            .voices_dropped = self.voices_dropped.load(.monotonic),
+            .commands_dropped = self.commands_dropped,
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Stop the mix thread, every voice ends and every sound is free afterwards
+    pub fn release(self: *Self) void {
+        self.running.store(false, .release);
+        self.thread.join();
+        self.allocator.free(self.voices);
+        self.allocator.free(self.mix_buffer);
+        self.allocator.free(self.voice_buffer);
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn send(self: *Self, command: Command) bool {
+        if (self.commands.push(command)) return true;
+        self.commands_dropped += 1;
+        return false;
+    }
+
+
+    fn mixMain(self: *Self) void {
+        while (self.running.load(.acquire)) {
+            const start = std.time.nanoTimestamp();
+            self.applyCommands();
+            self.mixBlock();
+
+            const mix_ns: u64 = @intCast(@max(0, std.time.nanoTimestamp() - start));
+            self.last_mix_ns.store(mix_ns, .monotonic);
+            if (mix_ns > self.max_mix_ns.load(.monotonic)) self.max_mix_ns.store(mix_ns, .monotonic);
+            self.blocks_mixed.store(self.blocks_mixed.load(.monotonic) + 1, .monotonic);
+            self.active_voices.store(@intCast(self.active), .monotonic);
+
+            self.output.func(self.output.context, self.mix_buffer);
+        }
+    }
+
+
+    fn applyCommands(self: *Self) void {
+        while (self.commands.pop()) |command| {
+            switch (command.kind) {
+                .play => {
+                    if (self.active == self.voices.len) {
+                        _ = self.voices_dropped.fetchAdd(1, .monotonic);
+                        _ = self.finished.push(command.voice);
+                        continue;
+                    }
+                    const voice = &self.voices[self.active];
+                    voice.* = .{ .id = command.voice, .sound = command.sound.?, .options = command.options };
+                    self.updateStep(voice);
+                    self.active += 1;
+                },
+                .stop_all => for (self.voices[0..self.active]) |*voice| {
+                    voice.stopping = true;
+                },
+                .set_master => self.master_gain = command.value,
+                else => {
+                    const voice = self.findVoice(command.voice) orelse continue;
+                    switch (command.kind) {
+                        .stop => voice.stopping = true,
+                        .set_gain => voice.options.gain = command.value,
+                        .set_pan => voice.options.pan = command.value,
+                        .set_pitch => {
+                            voice.options.pitch = command.value;
+                            self.updateStep(voice);
+                        },
+                        else => unreachable,
+                    }
+                },
+            }
+        }
+    }
+
+
+    fn findVoice(self: *Self, id: VoiceId) ?*Voice {
+        for (self.voices[0..self.active]) |*voice| {
+            if (voice.id == id) return voice;
+        }
+        return null;
+    }
+
+
+    fn updateStep(self: *const Self, voice: *Voice) void {
+        const pitch = std.math.clamp(voice.options.pitch, 0.0, max_pitch);
+        const ratio = @as(f64, pitch) * @as(f64, @floatFromInt(voice.sound.sample_rate)) / @as(f64, @floatFromInt(self.config.sample_rate));
+        voice.step = @intFromFloat(ratio * (1 << fraction_bits));
+    }
+
+
+    fn mixBlock(self: *Self) void {
+        @memset(self.mix_buffer, 0.0);
+
+        var index: usize = 0;
+        while (index < self.active) {
+            const voice = &self.voices[index];
+            if (self.mixVoice(voice)) {
+                index += 1;
+                continue;
+            }
+            _ = self.finished.push(voice.id);
+            self.active -= 1;
+            self.voices[index] = self.voices[self.active];
+        }
+
+        const low: Lanes = @splat(-1.0);
+        const high: Lanes = @splat(1.0);
+        var offset: usize = 0;
+        while (offset < self.mix_buffer.len) : (offset += lanes) {
+            const mixed: Lanes = self.mix_buffer[offset..][0..lanes].*;
+            self.mix_buffer[offset..][0..lanes].* = @min(@max(mixed, low), high);
+        }
+    }
+
+
+    /// Add one block of the voice to the mix, false once it ended
+    fn mixVoice(self: *Self, voice: *Voice) bool {
+        const sound = voice.sound;
+        const frames = self.config.block_frames;
+        const end = @as(u64, sound.frame_count) << fraction_bits;
+        const scratch = self.voice_buffer;
+
+        var played: usize = 0;
+        while (played < frames) : (played += 1) {
+            if (voice.position >= end) {
+                if (!voice.options.looping or end == 0) break;
+                voice.position %= end;
+            }
+            const frame: usize = @intCast(voice.position >> fraction_bits);
+            const t = @as(f32, @floatFromInt(voice.position & ((1 << fraction_bits) - 1))) * (1.0 / (1 << fraction_bits));
+            const a = sound.frame(frame);
+            const b = if (frame + 1 < sound.frame_count) sound.frame(frame + 1) else if (voice.options.looping) sound.frame(0) else [2]f32{ 0.0, 0.0 };
+            scratch[played * 2] = a[0] + (b[0] - a[0]) * t;
+            scratch[played * 2 + 1] = a[1] + (b[1] - a[1]) * t;
+            voice.position += voice.step;
+        }
+        @memset(scratch[played * 2 ..], 0.0);
+
+        // Equal power pan, a stopping voice ramps to silence within this block
+        const angle = (std.math.clamp(voice.options.pan, -1.0, 1.0) + 1.0) * (std.math.pi / 4.0);
+        const gain = if (voice.stopping) 0.0 else voice.options.gain * self.master_gain;
+        const left = gain * @cos(angle);
+        const right = gain * @sin(angle);
+        accumulate(self.mix_buffer, scratch, voice.left, voice.right, left, right, frames);
+        voice.left = left;
+        voice.right = right;
+
+        return played == frames and !voice.stopping;
+    }
+
+
+    /// mix += voice * gain, the gains moving linearly from the start ones to the end ones across the block
+    fn accumulate(mix: []f32, voice: []const f32, left_start: f32, right_start: f32, left_end: f32, right_end: f32, frames: usize) void {
+        const inverse = 1.0 / @as(f32, @floatFromInt(frames));
+        const left_delta = (left_end - left_start) * inverse;
+        const right_delta = (right_end - right_start) * inverse;
+
+        // Lanes hold 4 interleaved frames, the left gains in the even lanes and the right ones in the odd
+        const frame_offsets: Lanes = .{ 0, 0, 1, 1, 2, 2, 3, 3 };
+        const start: Lanes = .{ left_start, right_start, left_start, right_start, left_start, right_start, left_start, right_start };
+        const delta: Lanes = .{ left_delta, right_delta, left_delta, right_delta, left_delta, right_delta, left_delta, right_delta };
+
+        var offset: usize = 0;
+        var frame: f32 = 0.0;
+        while (offset < frames * 2) : (offset += lanes) {
+            const gains = start + delta * (frame_offsets + @as(Lanes, @splat(frame)));
+            const samples: Lanes = voice[offset..][0..lanes].*;
+            const current: Lanes = mix[offset..][0..lanes].*;
+            mix[offset..][0..lanes].* = current + samples * gains;
+            frame += lanes / 2;
+        }
+    }
+};
@@ -0,0 +1,221 @@
+// audio/sound.zig - PCM sounds from WAV files, decoded a frame at a time while they are mixed
+const std = @import("std");
+
+const async_io = @import("../core/async_io.zig");
+const AsyncIo = async_io.AsyncIo;
+const ReadBuffer = async_io.ReadBuffer;
+
+
+pub const SoundError = error{
+    /// No RIFF WAVE header
+    NotWav,
+    /// Only 16 bit integer and 32 bit float PCM are read
+    UnsupportedFormat,
+    /// A chunk runs past the end of the file, or there is no fmt or data chunk
+    Truncated,
+};
+
+
+pub const SampleFormat = enum {
+    pcm16,
+    float32,
+
+    pub fn size(self: SampleFormat) usize {
+        return switch (self) {
+            .pcm16 => 2,
+            .float32 => 4,
+        };
+    }
+};
+
+
+/// Called on the I/O thread once Sound.loadAsync's file is read and parsed, or failed to
+pub const SoundCallback = struct {
+    func: *const fn (context: ?*anyopaque, user_data: usize, result: anyerror!*Sound) void,
+    context: ?*anyopaque = null,
+};
+
+
+/// Samples of a sound as the file stores them, 16 bit ones are half the memory of floats
+/// Nothing is decoded up front: the mixer converts the frames it plays, so a long track costs its
+/// file size and no decode time before it starts. Read only once created, any thread may mix it
+pub const Sound = struct {
+    const Self = @This();
+
+    const Storage = union(enum) {
+        owned: []u8,
+        /// A buffer of an AsyncIo read, handed back on release
+        read: struct { io: *AsyncIo, buffer: ReadBuffer },
+    };
+
+    allocator: std.mem.Allocator,
+    storage: Storage,
+    format: SampleFormat,
+    channels: u16,
+    sample_rate: u32,
+    frame_count: u32,
+    /// The data chunk, interleaved, little endian and not necessarily aligned
+    data: []const u8,
+
+
+    const PendingLoad = struct {
+        allocator: std.mem.Allocator,
+        io: *AsyncIo,
+        user_data: usize,
+        callback: SoundCallback,
+    };
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Copy the WAV file in `bytes`
+    pub fn fromWav(allocator: std.mem.Allocator, bytes: []const u8) !*Self {
+        const copy = try allocator.dupe(u8, bytes);
+        errdefer allocator.free(copy);
+        return create(allocator, .{ .owned = copy }, copy);
+    }
+
+
+    /// Read and parse the WAV file at `path`
+    pub fn load(allocator: std.mem.Allocator, path: []const u8) !*Self {
+        const bytes = try std.fs.cwd().readFileAlloc(allocator, path, std.math.maxInt(u32));
+        errdefer allocator.free(bytes);
+        return create(allocator, .{ .owned = bytes }, bytes);
+    }
+
+
+    /// Read the WAV file at `path` through `io` and keep its read buffer as the sound's memory
+    /// `callback` runs on the I/O thread, with the sound or the error of the read or the parse
+    pub fn loadAsync(allocator: std.mem.Allocator, io: *AsyncIo, path: []const u8, user_data: usize, callback: SoundCallback) !void {
+        const pending = try allocator.create(PendingLoad);
+        errdefer allocator.destroy(pending);
+        pending.* = .{ .allocator = allocator, .io = io, .user_data = user_data, .callback = callback };
+        try io.read(path, @intFromPtr(pending), .{ .func = onRead });
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Frame `index` as left and right, mono sounds play on both and channels past the second are dropped
+    pub fn frame(self: *const Self, index: usize) [2]f32 {
+        const sample_size = self.format.size();
+        const offset = index * self.channels * sample_size;
+        const left = self.sample(offset);
+        const right = if (self.channels > 1) self.sample(offset + sample_size) else left;
+        return .{ left, right };
+    }
+
+
+    /// Length in seconds at the sound's own rate
+    pub fn duration(self: *const Self) f32 {
+        return @as(f32, @floatFromInt(self.frame_count)) / @as(f32, @floatFromInt(self.sample_rate));
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// No voice may play the sound anymore, see AudioMixer.pollFinished
+    pub fn release(self: *Self) void {
+        switch (self.storage) {
+            .owned => |bytes| self.allocator.free(bytes),
+            .read => |read| read.io.release(read.buffer),
+        }
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Takes `storage` on success, the caller keeps it on errors
+    fn create(allocator: std.mem.Allocator, storage: Storage, bytes: []const u8) !*Self {
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+        self.* = .{
+            .allocator = allocator,
+            .storage = storage,
+            .format = undefined,
+            .channels = 0,
+            .sample_rate = 0,
+            .frame_count = 0,
+            .data = &.{},
+        };
+        try self.parseWav(bytes);
+        return self;
+    }
+
+
+    fn parseWav(self: *Self, bytes: []const u8) !void {
+        if (bytes.len < 12 or !std.mem.eql(u8, bytes[0..4], "RIFF") or !std.mem.eql(u8, bytes[8..12], "WAVE")) {
+            return SoundError.NotWav;
+        }
+
+        var has_format = false;
+        var offset: usize = 12;
+        while (offset + 8 <= bytes.len) {
+            const id = bytes[offset..][0..4];
+            const size = std.mem.readInt(u32, bytes[offset + 4 ..][0..4], .little);
+            const body_start = offset + 8;
+            if (size > bytes.len - body_start) return SoundError.Truncated;
+            const body = bytes[body_start..][0..size];
+            // Chunks are padded to an even size
+            offset = body_start + size + (size & 1);
+
+            if (std.mem.eql(u8, id, "fmt ")) {
+                if (body.len < 16) return SoundError.Truncated;
+                var tag = std.mem.readInt(u16, body[0..2], .little);
+                self.channels = std.mem.readInt(u16, body[2..4], .little);
+                self.sample_rate = std.mem.readInt(u32, body[4..8], .little);
+                const bits = std.mem.readInt(u16, body[14..16], .little);
+                // WAVE_FORMAT_EXTENSIBLE names the real format in the first two bytes of its sub-format GUID
+                if (tag == 0xFFFE) {
+                    if (body.len < 26) return SoundError.Truncated;
+                    tag = std.mem.readInt(u16, body[24..26], .little);
+                }
+                self.format = switch (tag) {
+                    1 => if (bits == 16) .pcm16 else return SoundError.UnsupportedFormat,
+                    3 => if (bits == 32) .float32 else return SoundError.UnsupportedFormat,
+                    else => return SoundError.UnsupportedFormat,
+                };
+                if (self.channels == 0 or self.sample_rate == 0) return SoundError.UnsupportedFormat;
+                has_format = true;
+            } else if (std.mem.eql(u8, id, "data")) {
+                if (!has_format) return SoundError.Truncated;
+                const frame_size = self.channels * self.format.size();
+                self.frame_count = @intCast(body.len / frame_size);
+                self.data = body[0 .. self.frame_count * frame_size];
+                return;
+            }
+        }
+        return SoundError.Truncated;
+    }
+
+
+    fn sample(self: *const Self, offset: usize) f32 {
+        return switch (self.format) {
+            .pcm16 => @as(f32, @floatFromInt(std.mem.readInt(i16, self.data[offset..][0..2], .little))) * (1.0 / 32768.0),
+            .float32 => @bitCast(std.mem.readInt(u32, self.data[offset..][0..4], .little)),
+        };
+    }
+
+
+    fn onRead(_: ?*anyopaque, user_data: usize, result: anyerror!ReadBuffer) void {
+        const pending: *PendingLoad = @ptrFromInt(user_data);
+        defer pending.allocator.destroy(pending);
+        const callback = pending.callback;
+
+        const buffer = result catch |read_error| return callback.func(callback.context, pending.user_data, read_error);
+        const sound = create(pending.allocator, .{ .read = .{ .io = pending.io, .buffer = buffer } }, buffer.bytes) catch |parse_error| {
+            pending.io.release(buffer);
+            return callback.func(callback.context, pending.user_data, parse_error);
+        };
+        callback.func(callback.context, pending.user_data, sound);
+    }
+};
@@ -0,0 +1,286 @@
+// action_map.zig - Named actions bound to keys and mouse buttons
+const std = @import("std");
+
+const input_module = @import("input.zig");
+const Input = input_module.Input;
+const KeyCode = input_module.KeyCode;
+const MouseButton = input_module.MouseButton;
+
+
+/// Index of an action in its map, look it up once with ActionMap.find
+pub const ActionId = u16;
+
+
+/// Keys of a chord, more are rejected when the map is compiled
+pub const max_chord_keys = 4;
+
+
+/// One way to trigger an action
+pub const Binding = union(enum) {
+    key: KeyCode,
+    mouse_button: MouseButton,
+    /// Every key held at once, e.g. .{ .KEY_LEFT_CONTROL, .KEY_S }
+    chord: []const KeyCode,
+    /// -1 while `negative` is held, 1 while `positive` is, 0 for both or neither
+    axis: struct {
+        negative: KeyCode,
+        positive: KeyCode,
+    },
+};
+
+
+/// An action and everything bound to it, any binding triggers it
+pub const ActionDefinition = struct {
+    name: []const u8,
+    bindings: []const Binding,
+};
+
+
+/// Evaluated state of one action
+pub const ActionState = struct {
+    /// Any binding is active
+    down: bool = false,
+    /// Went down this frame
+    pressed: bool = false,
+    /// Went up this frame
+    released: bool = false,
+    /// Summed axis bindings clamped to [-1, 1], 1 or 0 for buttons
+    value: f32 = 0.0,
+};
+
+
+/// Actions compiled into flat binding tables
+/// The definitions are turned into one table per binding kind when the map is created, and
+/// evaluate walks each table once per frame, called from Input.update once the map is attached with
+/// Input.setActionMap. Queries are then array reads by ActionId
+pub const ActionMap = struct {
+    const Self = @This();
+
+    const ButtonBinding = struct {
+        index: u16,
+        action: ActionId,
+    };
+
+    const ChordBinding = struct {
+        keys: [max_chord_keys]u16,
+        count: u8,
+        action: ActionId,
+    };
+
+    const AxisBinding = struct {
+        negative: u16,
+        positive: u16,
+        action: ActionId,
+    };
+
+    allocator: std.mem.Allocator,
+    /// Owned action names, indexed by ActionId
+    names: [][]u8,
+    ids: std.StringHashMapUnmanaged(ActionId) = .{},
+    states: []ActionState,
+    /// States being evaluated, value holds the axis sum only
+    scratch: []ActionState,
+
+    key_bindings: []ButtonBinding,
+    mouse_bindings: []ButtonBinding,
+    chord_bindings: []ChordBinding,
+    axis_bindings: []AxisBinding,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Compile `definitions` into binding tables, actions get ids in definition order
+    pub fn create(allocator: std.mem.Allocator, definitions: []const ActionDefinition) !*Self {
+        if (definitions.len > std.math.maxInt(ActionId)) return error.TooManyActions;
+
+        var key_count: usize = 0;
+        var mouse_count: usize = 0;
+        var chord_count: usize = 0;
+        var axis_count: usize = 0;
+        for (definitions) |definition| {
+            for (definition.bindings) |binding| switch (binding) {
+                .key => key_count += 1,
+                .mouse_button => mouse_count += 1,
+                .chord => |keys| {
+                    if (keys.len == 0 or keys.len > max_chord_keys) return error.InvalidChord;
+                    chord_count += 1;
+                },
+                .axis => axis_count += 1,
+            };
+        }
+
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+        self.* = .{
+            .allocator = allocator,
+            .names = try allocator.alloc([]u8, definitions.len),
+            .states = &.{},
+            .scratch = &.{},
+            .key_bindings = &.{},
+            .mouse_bindings = &.{},
+            .chord_bindings = &.{},
+            .axis_bindings = &.{},
+        };
+        var names_filled: usize = 0;
+        errdefer self.freeTables(names_filled);
+
+        self.states = try allocator.alloc(ActionState, definitions.len);
+        @memset(self.states, .{});
+        self.scratch = try allocator.alloc(ActionState, definitions.len);
+        self.key_bindings = try allocator.alloc(ButtonBinding, key_count);
+        self.mouse_bindings = try allocator.alloc(ButtonBinding, mouse_count);
+        self.chord_bindings = try allocator.alloc(ChordBinding, chord_count);
+        self.axis_bindings = try allocator.alloc(AxisBinding, axis_count);
+        try self.ids.ensureTotalCapacity(allocator, @intCast(definitions.len));
+
+        key_count = 0;
+        mouse_count = 0;
+        chord_count = 0;
+        axis_count = 0;
+        for (definitions, 0..) |definition, i| {
+            const action: ActionId = @intCast(i);
+            self.names[i] = try allocator.dupe(u8, definition.name);
+            names_filled += 1;
+            const entry = self.ids.getOrPutAssumeCapacity(self.names[i]);
+            if (entry.found_existing) return error.DuplicateAction;
+            entry.value_ptr.* = action;
+
+            for (definition.bindings) |binding| switch (binding) {
+                .key => |key| {
+                    self.key_bindings[key_count] = .{ .index = keyIndex(key), .action = action };
+                    key_count += 1;
+                },
+                .mouse_button => |button| {
+                    self.mouse_bindings[mouse_count] = .{ .index = @intCast(@intFromEnum(button)), .action = action };
+                    mouse_count += 1;
+                },
+                .chord => |keys| {
+                    var chord = ChordBinding{ .keys = undefined, .count = @intCast(keys.len), .action = action };
+                    for (keys, 0..) |key, k| chord.keys[k] = keyIndex(key);
+                    self.chord_bindings[chord_count] = chord;
+                    chord_count += 1;
+                },
+                .axis => |axis| {
+                    self.axis_bindings[axis_count] = .{ .negative = keyIndex(axis.negative), .positive = keyIndex(axis.positive), .action = action };
+                    axis_count += 1;
+                },
+            };
+        }
+
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Id of the action called `action_name`, resolve it once and keep it
+    pub fn find(self: *const Self, action_name: []const u8) ?ActionId {
+        return self.ids.get(action_name);
+    }
+
+
+    /// Recompute every action from the current input state
+    /// Input.update calls this after processing its events when the map is attached
+    pub fn evaluate(self: *Self, input: *const Input) void {
+        @memset(self.scratch, .{});
+
+        for (self.key_bindings) |binding| {
+            if (input.keys.down.isSet(binding.index)) self.scratch[binding.action].down = true;
+        }
+
+        for (self.mouse_bindings) |binding| {
+            if (input.mouse_buttons.down.isSet(binding.index)) self.scratch[binding.action].down = true;
+        }
+
+        for (self.chord_bindings) |binding| {
+            const all_down = for (binding.keys[0..binding.count]) |key| {
+                if (!input.keys.down.isSet(key)) break false;
+            } else true;
+            if (all_down) self.scratch[binding.action].down = true;
+        }
+
+        for (self.axis_bindings) |binding| {
+            const negative: f32 = if (input.keys.down.isSet(binding.negative)) 1.0 else 0.0;
+            const positive: f32 = if (input.keys.down.isSet(binding.positive)) 1.0 else 0.0;
+            self.scratch[binding.action].value += positive - negative;
+        }
+
+        for (self.states, self.scratch) |*current, fresh| {
+            const axis = std.math.clamp(fresh.value, -1.0, 1.0);
+            const down = fresh.down or axis != 0.0;
+            current.pressed = down and !current.down;
+            current.released = !down and current.down;
+            current.down = down;
+            // Axes win over buttons bound to the same action, buttons alone count as fully pushed
+            current.value = if (axis != 0.0) axis else if (down) 1.0 else 0.0;
+        }
+    }
+
+
+    pub fn state(self: *const Self, action: ActionId) ActionState {
+        return self.states[action];
+    }
+
+
+    pub fn isDown(self: *const Self, action: ActionId) bool {
+        return self.states[action].down;
+    }
+
+
+    pub fn isPressed(self: *const Self, action: ActionId) bool {
+        return self.states[action].pressed;
+    }
+
+
+    pub fn isReleased(self: *const Self, action: ActionId) bool {
+        return self.states[action].released;
+    }
+
+
+    pub fn value(self: *const Self, action: ActionId) f32 {
+        return self.states[action].value;
+    }
+
+
+    /// Name an action was defined with
+    pub fn name(self: *const Self, action: ActionId) []const u8 {
+        return self.names[action];
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn release(self: *Self) void {
+        self.freeTables(self.names.len);
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn keyIndex(key: KeyCode) u16 {
+        // KEY_UNKNOWN is -1, slot 0 is no GLFW key and never reads as down
+        return @intCast(@max(@intFromEnum(key), 0));
+    }
+
+
+    fn freeTables(self: *Self, names_filled: usize) void {
+        for (self.names[0..names_filled]) |owned| self.allocator.free(owned);
+        self.allocator.free(self.names);
+        self.ids.deinit(self.allocator);
+        self.allocator.free(self.states);
+        self.allocator.free(self.scratch);
+        self.allocator.free(self.key_bindings);
+        self.allocator.free(self.mouse_bindings);
+        self.allocator.free(self.chord_bindings);
+        self.allocator.free(self.axis_bindings);
+    }
+};
@@ -0,0 +1,529 @@
+// core/async_io.zig - overlapped whole-file reads through IOCP or io_uring
+const std = @import("std");
+const builtin = @import("builtin");
+const posix = std.posix;
+const linux = std.os.linux;
+const windows = std.os.windows;
+
+
+pub const AsyncIoError = error{
+    /// start was called on a running reader
+    AlreadyRunning,
+    /// The reader stopped before the read was issued
+    Cancelled,
+};
+
+
+pub const AsyncIoConfig = struct {
+    /// Reads in flight at once, more requests wait their turn in submission order
+    queue_depth: u16 = 64,
+    /// Bytes of released buffers kept for reuse, beyond it they are freed
+    pooled_bytes: usize = 64 << 20,
+};
+
+
+/// The bytes of a file, pooled, hand it back with AsyncIo.release once decoded
+pub const ReadBuffer = struct {
+    bytes: []const u8,
+    memory: []align(AsyncIo.buffer_alignment) u8,
+};
+
+
+/// Called on the I/O thread once a read completes, fails or is cancelled
+/// Meant to spawn the decode job and return, a slow callback holds up every other completion
+pub const ReadCallback = struct {
+    func: *const fn (context: ?*anyopaque, user_data: usize, result: anyerror!ReadBuffer) void,
+    context: ?*anyopaque = null,
+};
+
+
+/// Reads whole files with many requests in flight at once, so thousands of small assets don't pay
+/// a blocking open-read-close round trip each. Files are opened and sized on the I/O thread, which
+/// then keeps up to queue_depth reads queued with the OS: io_uring on Linux, an I/O completion port
+/// on Windows, plain reads elsewhere or where io_uring is unavailable
+/// read may be called from any thread. A request submitted while reads are in flight is picked up
+/// with the next completion, the I/O thread only sleeps when there is nothing to wait for
+pub const AsyncIo = struct {
+    const Self = @This();
+
+    pub const buffer_alignment = 16;
+    /// Completions taken from the OS per wait
+    const completion_batch = 32;
+    /// Largest single read, longer files are read in several
+    const max_read = 1 << 30;
+
+    const Request = struct {
+        path: [:0]u8,
+        user_data: usize,
+        callback: ReadCallback,
+        /// Link in the queue
+        next: ?*Request = null,
+
+        file: Backend.File = undefined,
+        opened: bool = false,
+        memory: []align(buffer_alignment) u8 = &.{},
+        size: usize = 0,
+        /// Bytes read so far
+        done: usize = 0,
+        overlapped: if (builtin.os.tag == .windows) windows.OVERLAPPED else void = undefined,
+    };
+
+    const Completion = struct {
+        request: *Request,
+        result: anyerror!usize,
+    };
+
+    allocator: std.mem.Allocator = undefined,
+    config: AsyncIoConfig = .{},
+    backend: Backend = undefined,
+    thread: ?std.Thread = null,
+
+    /// Guards the queue, the allocator and the buffer pool, so any allocator will do
+    mutex: std.Thread.Mutex = .{},
+    condition: std.Thread.Condition = .{},
+    head: ?*Request = null,
+    tail: ?*Request = null,
+    stopping: bool = false,
+    free_buffers: std.ArrayListUnmanaged([]align(buffer_alignment) u8) = .{},
+    free_bytes: usize = 0,
+
+    /// Reads the OS holds, I/O thread only
+    in_flight: usize = 0,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Start the I/O thread, `self` must stay where it is until stop
+    pub fn start(self: *Self, allocator: std.mem.Allocator, config: AsyncIoConfig) !void {
+        if (self.thread != null) return AsyncIoError.AlreadyRunning;
+        self.allocator = allocator;
+        self.config = config;
+        self.config.queue_depth = @max(config.queue_depth, 1);
+        self.stopping = false;
+        self.backend = Backend.init(self.config.queue_depth);
+        errdefer self.backend.deinit();
+        self.thread = try std.Thread.spawn(.{}, run, .{self});
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Read the whole file at `path` in the background, `callback` receives `user_data` and the bytes
+    pub fn read(self: *Self, path: []const u8, user_data: usize, callback: ReadCallback) !void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.thread == null or self.stopping) return AsyncIoError.Cancelled;
+
+        const owned_path = try self.allocator.dupeZ(u8, path);
+        errdefer self.allocator.free(owned_path);
+        const request = try self.allocator.create(Request);
+        request.* = .{ .path = owned_path, .user_data = user_data, .callback = callback };
+
+        if (self.tail) |tail| tail.next = request else self.head = request;
+        self.tail = request;
+        self.condition.signal();
+    }
+
+
+    /// Return a buffer from a completed read, from any thread
+    pub fn release(self: *Self, buffer: ReadBuffer) void {
+        if (buffer.memory.len == 0) return;
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.free_bytes + buffer.memory.len <= self.config.pooled_bytes and !self.stopping) {
+            if (self.free_buffers.append(self.allocator, buffer.memory)) |_| {
+                self.free_bytes += buffer.memory.len;
+                return;
+            } else |_| {}
+        }
+        self.allocator.free(buffer.memory);
+    }
+
+
+    /// Which OS facility the reads go through, io_uring falls back to plain reads when the kernel refuses it
+    pub fn backendName(self: *const Self) []const u8 {
+        return self.backend.name();
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Let the reads in flight complete, cancel the queued ones and stop the I/O thread
+    /// Cancelled requests report AsyncIoError.Cancelled to their callbacks on the calling thread
+    pub fn stop(self: *Self) void {
+        const thread = self.thread orelse return;
+        const cancelled = blk: {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            self.stopping = true;
+            const queued = self.head;
+            self.head = null;
+            self.tail = null;
+            break :blk queued;
+        };
+        self.condition.signal();
+        thread.join();
+        self.thread = null;
+
+        var next = cancelled;
+        while (next) |request| {
+            next = request.next;
+            request.callback.func(request.callback.context, request.user_data, AsyncIoError.Cancelled);
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            self.freeRequest(request);
+        }
+
+        self.backend.deinit();
+        for (self.free_buffers.items) |memory| self.allocator.free(memory);
+        self.free_buffers.deinit(self.allocator);
+        self.free_buffers = .{};
+        self.free_bytes = 0;
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn run(self: *Self) void {
+        var starting: [completion_batch]*Request = undefined;
+        var completions: [completion_batch]Completion = undefined;
+        while (true) {
+            var count: usize = 0;
+            {
+                self.mutex.lock();
+                defer self.mutex.unlock();
+                while (self.head == null and self.in_flight == 0 and !self.stopping) self.condition.wait(&self.mutex);
+                if (self.stopping and self.in_flight == 0) return;
+
+                const room = @min(self.config.queue_depth - self.in_flight, starting.len);
+                while (count < room) : (count += 1) {
+                    const request = self.head orelse break;
+                    self.head = request.next;
+                    if (self.head == null) self.tail = null;
+                    starting[count] = request;
+                }
+            }
+
+            for (starting[0..count]) |request| {
+                self.issue(request) catch |e| self.complete(request, e);
+            }
+            if (self.in_flight == 0) continue;
+
+            const completed = self.backend.wait(&completions) catch |e| {
+                std.log.err("AsyncIo: waiting for completions failed: {s}", .{@errorName(e)});
+                std.time.sleep(std.time.ns_per_ms);
+                continue;
+            };
+            for (completions[0..completed]) |completion| {
+                self.in_flight -= 1;
+                const request = completion.request;
+                const transferred = completion.result catch |e| {
+                    self.complete(request, e);
+                    continue;
+                };
+                request.done += transferred;
+                // Short reads continue where they stopped, a read of nothing means the file got shorter
+                if (request.done < request.size and transferred > 0) {
+                    self.submitRead(request) catch |e| self.complete(request, e);
+                    continue;
+                }
+                self.complete(request, {});
+            }
+        }
+    }
+
+
+    /// Open and size the file and queue its first read, requests that finish at once are completed here
+    fn issue(self: *Self, request: *Request) !void {
+        request.file = try self.backend.open(self.allocator, request.path);
+        request.opened = true;
+        request.size = try self.backend.size(request.file);
+        if (request.size == 0) return self.complete(request, {});
+        request.memory = try self.acquireBuffer(request.size);
+        try self.submitRead(request);
+    }
+
+
+    fn submitRead(self: *Self, request: *Request) !void {
+        const length = @min(request.size - request.done, max_read);
+        const target = request.memory[request.done..][0..length];
+        if (try self.backend.submit(request, target, request.done)) |transferred| {
+            // Backends without overlapped reads finish at once, the completion goes through the same path
+            request.done += transferred;
+            if (request.done < request.size and transferred > 0) return self.submitRead(request);
+            self.complete(request, {});
+            return;
+        }
+        self.in_flight += 1;
+    }
+
+
+    /// Report the outcome of a request whose file is open, or failed to open, and free it
+    fn complete(self: *Self, request: *Request, outcome: anyerror!void) void {
+        if (request.opened) self.backend.close(request.file);
+        if (outcome) |_| {
+            request.callback.func(request.callback.context, request.user_data, ReadBuffer{ .bytes = request.memory[0..request.done], .memory = request.memory });
+        } else |e| {
+            if (request.memory.len > 0) self.release(.{ .bytes = &.{}, .memory = request.memory });
+            request.callback.func(request.callback.context, request.user_data, e);
+        }
+        self.lockedFree(request);
+    }
+
+
+    fn lockedFree(self: *Self, request: *Request) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.freeRequest(request);
+    }
+
+
+    fn freeRequest(self: *Self, request: *Request) void {
+        self.allocator.free(request.path);
+        self.allocator.destroy(request);
+    }
+
+
+    /// The smallest pooled buffer holding `size` bytes without wasting more than as much again, or a new one
+    fn acquireBuffer(self: *Self, size: usize) ![]align(buffer_alignment) u8 {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        var best: ?usize = null;
+        for (self.free_buffers.items, 0..) |memory, i| {
+            if (memory.len < size or memory.len > size * 2) continue;
+            if (best == null or memory.len < self.free_buffers.items[best.?].len) best = i;
+        }
+        if (best) |i| {
+            const memory = self.free_buffers.swapRemove(i);
+            self.free_bytes -= memory.len;
+            return memory;
+        }
+        return self.allocator.alignedAlloc(u8, buffer_alignment, std.mem.alignForward(usize, size, 4096));
+    }
+};
+
+
+/// The OS side of AsyncIo, picked at compile time, with io_uring checked once at start on Linux
+const Backend = switch (builtin.os.tag) {
+    .windows => IocpBackend,
+    .linux => UringBackend,
+    else => BlockingBackend,
+};
+
+
+/// Reads on the I/O thread itself, where no completion based I/O is available
+const BlockingBackend = struct {
+    const File = std.fs.File;
+
+    fn init(_: u16) BlockingBackend {
+        return .{};
+    }
+
+
+    fn name(_: *const BlockingBackend) []const u8 {
+        return "blocking";
+    }
+
+
+    fn open(_: *BlockingBackend, _: std.mem.Allocator, path: [:0]const u8) !File {
+        return std.fs.cwd().openFileZ(path, .{});
+    }
+
+
+    fn size(_: *BlockingBackend, file: File) !usize {
+        return @intCast(try file.getEndPos());
+    }
+
+
+    /// Bytes read, there is never anything in flight
+    fn submit(_: *BlockingBackend, request: *AsyncIo.Request, target: []u8, offset: usize) !?usize {
+        return try request.file.pread(target, offset);
+    }
+
+
+    fn wait(_: *BlockingBackend, _: []AsyncIo.Completion) !usize {
+        return 0;
+    }
+
+
+    fn close(_: *BlockingBackend, file: File) void {
+        file.close();
+    }
+
+
+    fn deinit(_: *BlockingBackend) void {}
+};
+
+
+/// io_uring, reads queued in the submission ring and reaped in batches from the completion ring
+const UringBackend = struct {
+    const File = std.fs.File;
+
+    /// Null when the kernel refused a ring, e.g. too old or blocked by a sandbox
+    ring: ?linux.IoUring,
+    blocking: BlockingBackend = .{},
+
+    fn init(queue_depth: u16) UringBackend {
+        const entries = std.math.ceilPowerOfTwoAssert(u16, @max(queue_depth, 2));
+        const ring = linux.IoUring.init(entries, 0) catch |e| blk: {
+            std.log.warn("AsyncIo: io_uring unavailable ({s}), reading files one by one", .{@errorName(e)});
+            break :blk null;
+        };
+        return .{ .ring = ring };
+    }
+
+
+    fn name(self: *const UringBackend) []const u8 {
+        return if (self.ring != null) "io_uring" else "blocking";
+    }
+
+
+    fn open(_: *UringBackend, _: std.mem.Allocator, path: [:0]const u8) !File {
+        return std.fs.cwd().openFileZ(path, .{});
+    }
+
+
+    fn size(_: *UringBackend, file: File) !usize {
+        return @intCast(try file.getEndPos());
+    }
+
+
+    /// Null once the read is queued, the completion arrives through wait
+    fn submit(self: *UringBackend, request: *AsyncIo.Request, target: []u8, offset: usize) !?usize {
+        const ring = if (self.ring) |*active| active else return self.blocking.submit(request, target, offset);
+        _ = try ring.read(@intFromPtr(request), request.file.handle, .{ .buffer = target }, offset);
+        _ = try ring.submit();
+        return null;
+    }
+
+
+    fn wait(self: *UringBackend, completions: []AsyncIo.Completion) !usize {
+        const ring = if (self.ring) |*active| active else return 0;
+        var cqes: [AsyncIo.completion_batch]linux.io_uring_cqe = undefined;
+        const count = try ring.copy_cqes(cqes[0..@min(completions.len, cqes.len)], 1);
+        for (cqes[0..count], completions[0..count]) |cqe, *completion| {
+            completion.* = .{
+                .request = @ptrFromInt(cqe.user_data),
+                .result = switch (cqe.err()) {
+                    .SUCCESS => @as(usize, @intCast(cqe.res)),
+                    else => |errno| posix.unexpectedErrno(errno),
+                },
+            };
+        }
+        return count;
+    }
+
+
+    fn close(_: *UringBackend, file: File) void {
+        file.close();
+    }
+
+
+    fn deinit(self: *UringBackend) void {
+        if (self.ring) |*ring| ring.deinit();
+        self.ring = null;
+    }
+};
+
+
+/// An I/O completion port, files opened for overlapped reads and associated with it
+const IocpBackend = struct {
+    const File = windows.HANDLE;
+
+    port: ?windows.HANDLE,
+
+    fn init(_: u16) IocpBackend {
+        const port = windows.CreateIoCompletionPort(windows.INVALID_HANDLE_VALUE, null, 0, 1) catch |e| blk: {
+            std.log.warn("AsyncIo: no completion port ({s})", .{@errorName(e)});
+            break :blk null;
+        };
+        return .{ .port = port };
+    }
+
+
+    fn name(_: *const IocpBackend) []const u8 {
+        return "iocp";
+    }
+
+
+    fn open(self: *IocpBackend, allocator: std.mem.Allocator, path: [:0]const u8) !File {
+        const port = self.port orelse return error.Unexpected;
+        const wide_path = try std.unicode.wtf8ToWtf16LeAllocZ(allocator, path);
+        defer allocator.free(wide_path);
+
+        const handle = windows.kernel32.CreateFileW(
+            wide_path.ptr,
+            windows.GENERIC_READ,
+            windows.FILE_SHARE_READ,
+            null,
+            windows.OPEN_EXISTING,
+            windows.FILE_FLAG_OVERLAPPED,
+            null,
+        );
+        if (handle == windows.INVALID_HANDLE_VALUE) {
+            return switch (windows.kernel32.GetLastError()) {
+                .FILE_NOT_FOUND, .PATH_NOT_FOUND => error.FileNotFound,
+                .ACCESS_DENIED => error.AccessDenied,
+                else => |code| windows.unexpectedError(code),
+            };
+        }
+        errdefer windows.CloseHandle(handle);
+        _ = try windows.CreateIoCompletionPort(handle, port, 0, 0);
+        return handle;
+    }
+
+
+    fn size(_: *IocpBackend, file: File) !usize {
+        return @intCast(try windows.GetFileSizeEx(file));
+    }
+
+
+    fn submit(_: *IocpBackend, request: *AsyncIo.Request, target: []u8, offset: usize) !?usize {
+        request.overlapped = std.mem.zeroes(windows.OVERLAPPED);
+        request.overlapped.DUMMYUNIONNAME.DUMMYSTRUCTNAME.Offset = @truncate(offset);
+        request.overlapped.DUMMYUNIONNAME.DUMMYSTRUCTNAME.OffsetHigh = @truncate(offset >> 32);
+        // Reads that finish at once still post their completion to the port
+        if (windows.kernel32.ReadFile(request.file, target.ptr, @intCast(target.len), null, &request.overlapped) == 0) {
+            switch (windows.kernel32.GetLastError()) {
+                .IO_PENDING => {},
+                else => |code| return windows.unexpectedError(code),
+            }
+        }
+        return null;
+    }
+
+
+    fn wait(self: *IocpBackend, completions: []AsyncIo.Completion) !usize {
+        if (self.port == null) return 0;
+        var entries: [AsyncIo.completion_batch]windows.OVERLAPPED_ENTRY = undefined;
+        const count = try windows.GetQueuedCompletionStatusEx(self.port.?, entries[0..@min(completions.len, entries.len)], null, false);
+        for (entries[0..count], completions[0..count]) |entry, *completion| {
+            const request: *AsyncIo.Request = @fieldParentPtr("overlapped", entry.lpOverlapped);
+            // Internal holds the NTSTATUS of the read
+            completion.* = .{
+                .request = request,
+                .result = if (entry.lpOverlapped.Internal == 0) entry.dwNumberOfBytesTransferred else error.InputOutput,
+            };
+        }
+        return count;
+    }
+
+
+    fn close(_: *IocpBackend, file: File) void {
+        windows.CloseHandle(file);
+    }
+
+
+    fn deinit(self: *IocpBackend) void {
+        if (self.port) |port| windows.CloseHandle(port);
+        self.port = null;
+    }
+};
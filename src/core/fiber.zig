@@ -0,0 +1,196 @@
+// core/fiber.zig - stacks and context switches of stackful fibers, scheduled by the job system
+const std = @import("std");
+const builtin = @import("builtin");
+
+
+/// Switches are written for the System V x86_64 and the AArch64 procedure call standards
+/// Windows saves more registers and keeps stack bounds in its thread block, fibers aren't used there
+pub const supported = (builtin.os.tag == .linux or builtin.os.tag.isDarwin() or builtin.os.tag.isBSD()) and
+    (builtin.cpu.arch == .x86_64 or builtin.cpu.arch == .aarch64);
+
+/// Function a context starts in, it must never return but switch away for good instead
+pub const Entry = *const fn (argument: *anyopaque) callconv(.C) noreturn;
+
+
+/// Fiber stack mapped with an inaccessible page below it, so an overflow faults instead of writing over memory
+pub const Stack = struct {
+    memory: []align(std.heap.page_size_min) u8,
+
+
+    /// At least `size` usable bytes, rounded up to whole pages
+    pub fn create(size: usize) !Stack {
+        const page_size = std.heap.pageSize();
+        const length = std.mem.alignForward(usize, size, page_size) + page_size;
+        const memory = try std.posix.mmap(
+            null,
+            length,
+            std.posix.PROT.READ | std.posix.PROT.WRITE,
+            .{ .TYPE = .PRIVATE, .ANONYMOUS = true },
+            -1,
+            0,
+        );
+        errdefer std.posix.munmap(memory);
+        try std.posix.mprotect(memory[0..page_size], std.posix.PROT.NONE);
+        return .{ .memory = memory };
+    }
+
+
+    pub fn destroy(self: Stack) void {
+        std.posix.munmap(self.memory);
+    }
+};
+
+
+/// Stack pointer of a suspended context, its callee-saved registers are pushed below it
+pub const Context = struct {
+    sp: usize = 0,
+
+
+    /// Context that calls `entry(argument)` on `stack` when first switched to
+    /// The initial frame is the one a switch away would have left, returning into the start stub
+    pub fn init(stack: Stack, entry: Entry, argument: *anyopaque) Context {
+        const top = std.mem.alignBackward(usize, @intFromPtr(stack.memory.ptr) + stack.memory.len, 16);
+        const start = @intFromPtr(&zge_fiber_start);
+        switch (builtin.cpu.arch) {
+            .x86_64 => {
+                // Control words, r15, r14, r13, r12, rbx, rbp, return address. The stub's call then
+                // enters `entry` with the stack 8 past a 16 byte boundary, as a call instruction would
+                const frame: [*]usize = @ptrFromInt(top - 10 * @sizeOf(usize));
+                // MXCSR with every exception masked and the x87 control word as set at process start
+                frame[0] = 0x1F80 | (0x037F << 32);
+                frame[1] = 0;
+                frame[2] = 0;
+                frame[3] = @intFromPtr(entry);
+                frame[4] = @intFromPtr(argument);
+                frame[5] = 0;
+                frame[6] = 0;
+                frame[7] = start;
+                return .{ .sp = @intFromPtr(frame) };
+            },
+            .aarch64 => {
+                // x19 to x28, x29, x30, then d8 to d15
+                const frame: [*]usize = @ptrFromInt(top - 20 * @sizeOf(usize));
+                @memset(frame[0..20], 0);
+                frame[0] = @intFromPtr(argument);
+                frame[1] = @intFromPtr(entry);
+                frame[11] = start;
+                return .{ .sp = @intFromPtr(frame) };
+            },
+            else => @compileError("fibers are not supported on this target"),
+        }
+    }
+
+
+    /// Save the running context into `from` and continue `to`, returns once something switches back to `from`
+    pub inline fn swap(from: *Context, to: *const Context) void {
+        zge_fiber_switch(&from.sp, to.sp);
+    }
+};
+
+
+// ============================================================
+// Private: Context Switch
+// ============================================================
+
+extern fn zge_fiber_switch(from_sp: *usize, to_sp: usize) callconv(.C) void;
+extern fn zge_fiber_start() callconv(.C) void;
+
+const symbol_prefix = if (builtin.os.tag.isDarwin()) "_" else "";
+
+const switch_source = if (!supported) "" else switch (builtin.cpu.arch) {
+    .x86_64 =>
+    \\  .text
+    \\  .p2align 4
+    \\  .globl SYM(zge_fiber_switch)
+    \\SYM(zge_fiber_switch):
+    \\  pushq %rbp
+    \\  pushq %rbx
+    \\  pushq %r12
+    \\  pushq %r13
+    \\  pushq %r14
+    \\  pushq %r15
+    \\  subq $8, %rsp
+    \\  stmxcsr (%rsp)
+    \\  fnstcw 4(%rsp)
+    \\  movq %rsp, (%rdi)
+    \\  movq %rsi, %rsp
+    \\  ldmxcsr (%rsp)
+    \\  fldcw 4(%rsp)
+    \\  addq $8, %rsp
+    \\  popq %r15
+    \\  popq %r14
+    \\  popq %r13
+    \\  popq %r12
+    \\  popq %rbx
+    \\  popq %rbp
+    \\  retq
+    \\
+    \\  .p2align 4
+    \\  .globl SYM(zge_fiber_start)
+    \\SYM(zge_fiber_start):
+    \\  movq %r12, %rdi
+    \\  callq *%r13
+    \\  ud2
+    \\
+    ,
+    .aarch64 =>
+    \\  .text
+    \\  .p2align 4
+    \\  .globl SYM(zge_fiber_switch)
+    \\SYM(zge_fiber_switch):
+    \\  sub sp, sp, #0xa0
+    \\  stp x19, x20, [sp, #0x00]
+    \\  stp x21, x22, [sp, #0x10]
+    \\  stp x23, x24, [sp, #0x20]
+    \\  stp x25, x26, [sp, #0x30]
+    \\  stp x27, x28, [sp, #0x40]
+    \\  stp x29, x30, [sp, #0x50]
+    \\  stp d8, d9, [sp, #0x60]
+    \\  stp d10, d11, [sp, #0x70]
+    \\  stp d12, d13, [sp, #0x80]
+    \\  stp d14, d15, [sp, #0x90]
+    \\  mov x9, sp
+    \\  str x9, [x0]
+    \\  mov sp, x1
+    \\  ldp x19, x20, [sp, #0x00]
+    \\  ldp x21, x22, [sp, #0x10]
+    \\  ldp x23, x24, [sp, #0x20]
+    \\  ldp x25, x26, [sp, #0x30]
+    \\  ldp x27, x28, [sp, #0x40]
+    \\  ldp x29, x30, [sp, #0x50]
+    \\  ldp d8, d9, [sp, #0x60]
+    \\  ldp d10, d11, [sp, #0x70]
+    \\  ldp d12, d13, [sp, #0x80]
+    \\  ldp d14, d15, [sp, #0x90]
+    \\  add sp, sp, #0xa0
+    \\  ret
+    \\
+    \\  .p2align 4
+    \\  .globl SYM(zge_fiber_start)
+    \\SYM(zge_fiber_start):
+    \\  mov x0, x19
+    \\  blr x20
+    \\  brk #0
+    \\
+    ,
+    else => "",
+};
+
+comptime {
+    asm (expandSymbols(switch_source));
+}
+
+
+/// Replace SYM(name) with the platform's symbol name, Mach-O prefixes C symbols with an underscore
+fn expandSymbols(comptime source: []const u8) []const u8 {
+    comptime {
+        var result: []const u8 = "";
+        var rest = source;
+        while (std.mem.indexOf(u8, rest, "SYM(")) |index| {
+            const close = std.mem.indexOfScalarPos(u8, rest, index, ')').?;
+            result = result ++ rest[0..index] ++ symbol_prefix ++ rest[index + 4 .. close];
+            rest = rest[close + 1 ..];
+        }
+        return result ++ rest;
+    }
+}
@@ -0,0 +1,63 @@
+// frame_arena.zig - Per-frame transient allocation
+const std = @import("std");
+
+
+/// Two arenas that take turns, for data that only lives for a frame or two
+/// Allocations of frame N stay valid through frame N+1, so anything consumed one frame late
+/// (e.g. a command list recorded at the end of one frame and submitted in the next) needs no copy,
+/// and are freed in bulk at the end of frame N+1 while the arena keeps its pages
+/// Not thread safe, allocate from the thread that calls endFrame
+pub const FrameArena = struct {
+    const Self = @This();
+
+    arenas: [2]std.heap.ArenaAllocator,
+    /// Arena the current frame allocates from
+    current: u1 = 0,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(child_allocator: std.mem.Allocator) Self {
+        return .{
+            .arenas = .{
+                std.heap.ArenaAllocator.init(child_allocator),
+                std.heap.ArenaAllocator.init(child_allocator),
+            },
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Allocator of the current frame, frees are ignored until the bulk reset
+    pub fn allocator(self: *Self) std.mem.Allocator {
+        return self.arenas[self.current].allocator();
+    }
+
+
+    /// Switch arenas: the frame that just ended stays readable, the one before it is freed
+    pub fn endFrame(self: *Self) void {
+        self.current +%= 1;
+        _ = self.arenas[self.current].reset(.retain_capacity);
+    }
+
+
+    /// Bytes held by both arenas, including capacity retained from earlier frames
+    pub fn capacity(self: *const Self) usize {
+        return self.arenas[0].queryCapacity() + self.arenas[1].queryCapacity();
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.arenas[0].deinit();
+        self.arenas[1].deinit();
+    }
+};
@@ -1,8 +1,42 @@
 // err/gl.zig
 const std = @import("std");
+const builtin = @import("builtin");
+const build_options = @import("build_options");
 const c = @import("../bindings/c.zig");
+const gl_ext = @import("gl_ext.zig");
+
+
+/// How OpenGL errors are reported, picked with `-Dgl-checks`
+pub const ErrorMode = enum {
+    /// glGetError after every checked call, panics on the first error
+    poll,
+    /// Driver reports errors through a KHR_debug callback, checkGLError compiles to nothing
+    debug_output,
+    /// No error reporting at all
+    off,
+};
+
+
+/// `auto` polls in Debug and ReleaseSafe and compiles the checks out in ReleaseFast and ReleaseSmall
+pub const error_mode: ErrorMode = switch (build_options.gl_checks) {
+    .auto => switch (builtin.mode) {
+        .Debug, .ReleaseSafe => .poll,
+        .ReleaseFast, .ReleaseSmall => .off,
+    },
+    .poll => .poll,
+    .debug_output => .debug_output,
+    .off => .off,
+};
+
+
+/// Framebuffer frames are drawn into: 0 for the window's own, the offscreen target of a headless Window
+/// Passes that render elsewhere bind this again when they are done
+pub var default_framebuffer: c.GLuint = 0;
+
 
 pub fn checkGLError(context: []const u8) void {
+    if (comptime error_mode != .poll) return;
+
     const error_code = c.glGetError();
     if (error_code != c.GL_NO_ERROR) {
         const error_str = errorString(error_code);
@@ -12,6 +46,40 @@ pub fn checkGLError(context: []const u8) void {
 }
 
 
+/// Install the KHR_debug message callback on the current context, returns false if the driver lacks it
+/// Requires gl_ext.load, which Window.create runs
+/// Messages arrive asynchronously, so the reported call is not necessarily the last one made
+pub fn enableDebugOutput() bool {
+    const debugMessageCallback = gl_ext.debugMessageCallback orelse return false;
+
+    c.glEnable(gl_ext.GL_DEBUG_OUTPUT);
+    debugMessageCallback(debugMessageHandler, null);
+    return true;
+}
+
+
+fn debugMessageHandler(source: c.GLenum, message_type: c.GLenum, id: c.GLuint, severity: c.GLenum, length: c.GLsizei, message: [*c]const c.GLchar, user_param: ?*const anyopaque) callconv(.C) void {
+    _ = source;
+    _ = user_param;
+
+    if (severity == gl_ext.GL_DEBUG_SEVERITY_NOTIFICATION) return;
+
+    const text = message[0..@intCast(length)];
+    const severity_str = switch (severity) {
+        gl_ext.GL_DEBUG_SEVERITY_HIGH => "high",
+        gl_ext.GL_DEBUG_SEVERITY_MEDIUM => "medium",
+        gl_ext.GL_DEBUG_SEVERITY_LOW => "low",
+        else => "unknown",
+    };
+
+    if (message_type == gl_ext.GL_DEBUG_TYPE_ERROR) {
+        std.log.err("OpenGL Error {d} ({s}): {s}", .{ id, severity_str, text });
+    } else {
+        std.log.warn("OpenGL {d} ({s}): {s}", .{ id, severity_str, text });
+    }
+}
+
+
 fn errorString(error_code: c.GLenum) []const u8 {
     return switch (error_code) {
         c.GL_NO_ERROR => "GL_NO_ERROR",
@@ -0,0 +1,319 @@
+// core/gl_ext.zig - GL entry points outside the GL 3.3 core loader
+// Every feature is taken from the core version when the context is new enough, from its extension otherwise
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+
+
+// KHR_debug
+pub const GL_DEBUG_OUTPUT = 0x92E0;
+pub const GL_DEBUG_TYPE_ERROR = 0x824C;
+pub const GL_DEBUG_SEVERITY_HIGH = 0x9146;
+pub const GL_DEBUG_SEVERITY_MEDIUM = 0x9147;
+pub const GL_DEBUG_SEVERITY_LOW = 0x9148;
+pub const GL_DEBUG_SEVERITY_NOTIFICATION = 0x826B;
+
+// ARB_get_program_binary
+pub const GL_PROGRAM_BINARY_RETRIEVABLE_HINT = 0x8257;
+pub const GL_PROGRAM_BINARY_LENGTH = 0x8741;
+
+// ARB_buffer_storage
+pub const GL_MAP_PERSISTENT_BIT = 0x0040;
+pub const GL_MAP_COHERENT_BIT = 0x0080;
+
+// ARB_compute_shader, ARB_shader_storage_buffer_object, ARB_draw_indirect, ARB_shader_image_load_store
+pub const GL_COMPUTE_SHADER = 0x91B9;
+pub const GL_SHADER_STORAGE_BUFFER = 0x90D2;
+pub const GL_DRAW_INDIRECT_BUFFER = 0x8F3F;
+pub const GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT = 0x00000001;
+pub const GL_COMMAND_BARRIER_BIT = 0x00000040;
+pub const GL_BUFFER_UPDATE_BARRIER_BIT = 0x00000200;
+pub const GL_SHADER_STORAGE_BARRIER_BIT = 0x00002000;
+pub const GL_TEXTURE_FETCH_BARRIER_BIT = 0x00000008;
+pub const GL_SHADER_IMAGE_ACCESS_BARRIER_BIT = 0x00000020;
+pub const GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS = 0x90D6;
+
+// ARB_ES3_compatibility
+pub const GL_ANY_SAMPLES_PASSED_CONSERVATIVE = 0x8D6A;
+
+// KHR_parallel_shader_compile, same values as the ARB version
+pub const GL_MAX_SHADER_COMPILER_THREADS = 0x91B0;
+pub const GL_COMPLETION_STATUS = 0x91B1;
+
+// ARB_texture_filter_anisotropic, same values as the EXT version
+pub const GL_TEXTURE_MAX_ANISOTROPY = 0x84FE;
+pub const GL_MAX_TEXTURE_MAX_ANISOTROPY = 0x84FF;
+
+// EXT_texture_compression_s3tc, EXT_texture_sRGB, ARB_texture_compression_rgtc (core), ARB_texture_compression_bptc
+pub const GL_COMPRESSED_RGBA_S3TC_DXT1_EXT = 0x83F1;
+pub const GL_COMPRESSED_RGBA_S3TC_DXT3_EXT = 0x83F2;
+pub const GL_COMPRESSED_RGBA_S3TC_DXT5_EXT = 0x83F3;
+pub const GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT = 0x8C4D;
+pub const GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT = 0x8C4E;
+pub const GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT = 0x8C4F;
+pub const GL_COMPRESSED_RED_RGTC1 = 0x8DBB;
+pub const GL_COMPRESSED_RG_RGTC2 = 0x8DBD;
+pub const GL_COMPRESSED_RGBA_BPTC_UNORM = 0x8E8C;
+pub const GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM = 0x8E8D;
+
+// KHR_texture_compression_astc_ldr
+pub const GL_COMPRESSED_RGBA_ASTC_4x4_KHR = 0x93B0;
+pub const GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR = 0x93D0;
+
+// ARB_sparse_texture
+pub const GL_TEXTURE_SPARSE_ARB = 0x91A6;
+pub const GL_VIRTUAL_PAGE_SIZE_X_ARB = 0x9195;
+pub const GL_VIRTUAL_PAGE_SIZE_Y_ARB = 0x9196;
+pub const GL_NUM_VIRTUAL_PAGE_SIZES_ARB = 0x91A8;
+
+
+pub const DebugMessageCallbackFn = *const fn (callback: c.GLDEBUGPROC, user_param: ?*const anyopaque) callconv(.C) void;
+pub const GetProgramBinaryFn = *const fn (program: c.GLuint, buf_size: c.GLsizei, length: ?*c.GLsizei, binary_format: *c.GLenum, binary: ?*anyopaque) callconv(.C) void;
+pub const ProgramBinaryFn = *const fn (program: c.GLuint, binary_format: c.GLenum, binary: ?*const anyopaque, length: c.GLsizei) callconv(.C) void;
+pub const ProgramParameteriFn = *const fn (program: c.GLuint, pname: c.GLenum, value: c.GLint) callconv(.C) void;
+pub const BufferStorageFn = *const fn (target: c.GLenum, size: c.GLsizeiptr, data: ?*const anyopaque, flags: c.GLbitfield) callconv(.C) void;
+pub const DispatchComputeFn = *const fn (groups_x: c.GLuint, groups_y: c.GLuint, groups_z: c.GLuint) callconv(.C) void;
+pub const MemoryBarrierFn = *const fn (barriers: c.GLbitfield) callconv(.C) void;
+pub const MultiDrawElementsIndirectFn = *const fn (mode: c.GLenum, index_type: c.GLenum, indirect: ?*const anyopaque, draw_count: c.GLsizei, stride: c.GLsizei) callconv(.C) void;
+pub const MultiDrawArraysIndirectFn = *const fn (mode: c.GLenum, indirect: ?*const anyopaque, draw_count: c.GLsizei, stride: c.GLsizei) callconv(.C) void;
+pub const DrawArraysIndirectFn = *const fn (mode: c.GLenum, indirect: ?*const anyopaque) callconv(.C) void;
+pub const BindImageTextureFn = *const fn (unit: c.GLuint, texture: c.GLuint, level: c.GLint, layered: c.GLboolean, layer: c.GLint, access: c.GLenum, format: c.GLenum) callconv(.C) void;
+pub const TexStorage2DFn = *const fn (target: c.GLenum, levels: c.GLsizei, internal_format: c.GLenum, width: c.GLsizei, height: c.GLsizei) callconv(.C) void;
+pub const MaxShaderCompilerThreadsFn = *const fn (count: c.GLuint) callconv(.C) void;
+pub const GetTextureHandleFn = *const fn (texture: c.GLuint) callconv(.C) c.GLuint64;
+pub const GetTextureSamplerHandleFn = *const fn (texture: c.GLuint, sampler: c.GLuint) callconv(.C) c.GLuint64;
+pub const MakeTextureHandleResidentFn = *const fn (handle: c.GLuint64) callconv(.C) void;
+pub const MakeTextureHandleNonResidentFn = *const fn (handle: c.GLuint64) callconv(.C) void;
+pub const TexStorage3DFn = *const fn (target: c.GLenum, levels: c.GLsizei, internal_format: c.GLenum, width: c.GLsizei, height: c.GLsizei, depth: c.GLsizei) callconv(.C) void;
+
+// ARB_direct_state_access
+pub const NamedBufferSubDataFn = *const fn (buffer: c.GLuint, offset: c.GLintptr, size: c.GLsizeiptr, data: ?*const anyopaque) callconv(.C) void;
+pub const CreateTexturesFn = *const fn (target: c.GLenum, count: c.GLsizei, textures: [*]c.GLuint) callconv(.C) void;
+pub const TextureStorage2DFn = *const fn (texture: c.GLuint, levels: c.GLsizei, internal_format: c.GLenum, width: c.GLsizei, height: c.GLsizei) callconv(.C) void;
+pub const TextureSubImage2DFn = *const fn (texture: c.GLuint, level: c.GLint, x: c.GLint, y: c.GLint, width: c.GLsizei, height: c.GLsizei, format: c.GLenum, data_type: c.GLenum, pixels: ?*const anyopaque) callconv(.C) void;
+pub const GenerateTextureMipmapFn = *const fn (texture: c.GLuint) callconv(.C) void;
+
+// ARB_separate_shader_objects
+pub const TexPageCommitmentFn = *const fn (target: c.GLenum, level: c.GLint, x: c.GLint, y: c.GLint, z: c.GLint, width: c.GLsizei, height: c.GLsizei, depth: c.GLsizei, commit: c.GLboolean) callconv(.C) void;
+pub const GetInternalformativFn = *const fn (target: c.GLenum, internal_format: c.GLenum, pname: c.GLenum, count: c.GLsizei, params: [*]c.GLint) callconv(.C) void;
+pub const ProgramUniform1iFn = *const fn (program: c.GLuint, location: c.GLint, value: c.GLint) callconv(.C) void;
+pub const ProgramUniform4fvFn = *const fn (program: c.GLuint, location: c.GLint, count: c.GLsizei, value: [*]const f32) callconv(.C) void;
+pub const ProgramUniformMatrixfvFn = *const fn (program: c.GLuint, location: c.GLint, count: c.GLsizei, transpose: c.GLboolean, value: [*]const f32) callconv(.C) void;
+
+
+/// Null when the driver lacks the extension, filled by load
+pub var debugMessageCallback: ?DebugMessageCallbackFn = null;
+pub var getProgramBinary: ?GetProgramBinaryFn = null;
+pub var programBinary: ?ProgramBinaryFn = null;
+pub var programParameteri: ?ProgramParameteriFn = null;
+pub var bufferStorage: ?BufferStorageFn = null;
+pub var dispatchCompute: ?DispatchComputeFn = null;
+pub var memoryBarrier: ?MemoryBarrierFn = null;
+pub var multiDrawElementsIndirect: ?MultiDrawElementsIndirectFn = null;
+pub var multiDrawArraysIndirect: ?MultiDrawArraysIndirectFn = null;
+pub var drawArraysIndirect: ?DrawArraysIndirectFn = null;
+pub var bindImageTexture: ?BindImageTextureFn = null;
+pub var texStorage2D: ?TexStorage2DFn = null;
+pub var texStorage3D: ?TexStorage3DFn = null;
+pub var getTextureHandle: ?GetTextureHandleFn = null;
+pub var maxShaderCompilerThreads: ?MaxShaderCompilerThreadsFn = null;
+pub var getTextureSamplerHandle: ?GetTextureSamplerHandleFn = null;
+pub var makeTextureHandleResident: ?MakeTextureHandleResidentFn = null;
+pub var makeTextureHandleNonResident: ?MakeTextureHandleNonResidentFn = null;
+pub var namedBufferSubData: ?NamedBufferSubDataFn = null;
+pub var createTextures: ?CreateTexturesFn = null;
+pub var textureStorage2D: ?TextureStorage2DFn = null;
+pub var textureSubImage2D: ?TextureSubImage2DFn = null;
+pub var generateTextureMipmap: ?GenerateTextureMipmapFn = null;
+pub var texPageCommitment: ?TexPageCommitmentFn = null;
+pub var getInternalformativ: ?GetInternalformativFn = null;
+pub var programUniform1i: ?ProgramUniform1iFn = null;
+pub var programUniform4fv: ?ProgramUniform4fvFn = null;
+pub var programUniformMatrix3fv: ?ProgramUniformMatrixfvFn = null;
+pub var programUniformMatrix4fv: ?ProgramUniformMatrixfvFn = null;
+
+/// Version of the current context, filled by load
+pub var version_major: i32 = 3;
+pub var version_minor: i32 = 3;
+
+/// Compressed texture families beyond the core RGTC formats, filled by load
+pub var has_s3tc = false;
+pub var has_bptc = false;
+pub var has_astc = false;
+/// Occlusion query target, the conservative one may skip the exact test where the driver has it
+pub var occlusion_query_target: c.GLenum = c.GL_ANY_SAMPLES_PASSED;
+/// Largest anisotropy samplers accept, 1 without anisotropic filtering
+pub var max_anisotropy: f32 = 1.0;
+
+
+/// Resolve every supported extension entry point, call once after the context is current and glad is loaded
+pub fn load() void {
+    c.glGetIntegerv(c.GL_MAJOR_VERSION, &version_major);
+    c.glGetIntegerv(c.GL_MINOR_VERSION, &version_minor);
+
+    if (available("GL_KHR_debug", 4, 3)) {
+        debugMessageCallback = proc(DebugMessageCallbackFn, "glDebugMessageCallback");
+    }
+
+    if (available("GL_ARB_get_program_binary", 4, 1)) {
+        getProgramBinary = proc(GetProgramBinaryFn, "glGetProgramBinary");
+        programBinary = proc(ProgramBinaryFn, "glProgramBinary");
+        programParameteri = proc(ProgramParameteriFn, "glProgramParameteri");
+    }
+
+    if (available("GL_ARB_buffer_storage", 4, 4)) {
+        bufferStorage = proc(BufferStorageFn, "glBufferStorage");
+    }
+
+    // Storage buffers are only usable from compute shaders here, so both have to be present
+    if (available("GL_ARB_compute_shader", 4, 3) and available("GL_ARB_shader_storage_buffer_object", 4, 3)) {
+        dispatchCompute = proc(DispatchComputeFn, "glDispatchCompute");
+        memoryBarrier = proc(MemoryBarrierFn, "glMemoryBarrier");
+    }
+
+    if (available("GL_ARB_multi_draw_indirect", 4, 3)) {
+        multiDrawElementsIndirect = proc(MultiDrawElementsIndirectFn, "glMultiDrawElementsIndirect");
+        multiDrawArraysIndirect = proc(MultiDrawArraysIndirectFn, "glMultiDrawArraysIndirect");
+    }
+
+    if (available("GL_ARB_shader_image_load_store", 4, 2)) {
+        bindImageTexture = proc(BindImageTextureFn, "glBindImageTexture");
+    }
+
+    if (available("GL_ARB_draw_indirect", 4, 0)) {
+        drawArraysIndirect = proc(DrawArraysIndirectFn, "glDrawArraysIndirect");
+    }
+
+    if (available("GL_ARB_texture_storage", 4, 2)) {
+        texStorage2D = proc(TexStorage2DFn, "glTexStorage2D");
+        texStorage3D = proc(TexStorage3DFn, "glTexStorage3D");
+    }
+
+    if (supported("GL_KHR_parallel_shader_compile")) {
+        maxShaderCompilerThreads = proc(MaxShaderCompilerThreadsFn, "glMaxShaderCompilerThreadsKHR");
+    } else if (supported("GL_ARB_parallel_shader_compile")) {
+        maxShaderCompilerThreads = proc(MaxShaderCompilerThreadsFn, "glMaxShaderCompilerThreadsARB");
+    }
+
+    if (supported("GL_ARB_bindless_texture")) {
+        getTextureHandle = proc(GetTextureHandleFn, "glGetTextureHandleARB");
+        getTextureSamplerHandle = proc(GetTextureSamplerHandleFn, "glGetTextureSamplerHandleARB");
+        makeTextureHandleResident = proc(MakeTextureHandleResidentFn, "glMakeTextureHandleResidentARB");
+        makeTextureHandleNonResident = proc(MakeTextureHandleNonResidentFn, "glMakeTextureHandleNonResidentARB");
+    }
+
+    if (available("GL_ARB_direct_state_access", 4, 5)) {
+        namedBufferSubData = proc(NamedBufferSubDataFn, "glNamedBufferSubData");
+        createTextures = proc(CreateTexturesFn, "glCreateTextures");
+        textureStorage2D = proc(TextureStorage2DFn, "glTextureStorage2D");
+        textureSubImage2D = proc(TextureSubImage2DFn, "glTextureSubImage2D");
+        generateTextureMipmap = proc(GenerateTextureMipmapFn, "glGenerateTextureMipmap");
+    }
+
+    // Page sizes are queried per format, sparse storage is immutable storage with a flag set first
+    if (supported("GL_ARB_sparse_texture") and available("GL_ARB_internalformat_query", 4, 2) and texStorage2D != null) {
+        texPageCommitment = proc(TexPageCommitmentFn, "glTexPageCommitmentARB");
+        getInternalformativ = proc(GetInternalformativFn, "glGetInternalformativ");
+    }
+
+    if (available("GL_ARB_separate_shader_objects", 4, 1)) {
+        programUniform1i = proc(ProgramUniform1iFn, "glProgramUniform1i");
+        programUniform4fv = proc(ProgramUniform4fvFn, "glProgramUniform4fv");
+        programUniformMatrix3fv = proc(ProgramUniformMatrixfvFn, "glProgramUniformMatrix3fv");
+        programUniformMatrix4fv = proc(ProgramUniformMatrixfvFn, "glProgramUniformMatrix4fv");
+    }
+
+    if (available("GL_ARB_texture_filter_anisotropic", 4, 6) or supported("GL_EXT_texture_filter_anisotropic")) {
+        c.glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &max_anisotropy);
+    }
+
+    if (available("GL_ARB_ES3_compatibility", 4, 3)) occlusion_query_target = GL_ANY_SAMPLES_PASSED_CONSERVATIVE;
+    has_s3tc = supported("GL_EXT_texture_compression_s3tc");
+    has_bptc = available("GL_ARB_texture_compression_bptc", 4, 2);
+    has_astc = supported("GL_KHR_texture_compression_astc_ldr");
+}
+
+
+/// True when compute shaders, storage buffers and multi-draw indirect are all available
+pub fn hasGpuCulling() bool {
+    return dispatchCompute != null and memoryBarrier != null and multiDrawElementsIndirect != null;
+}
+
+
+/// True when compiles and links run on driver threads and GL_COMPLETION_STATUS can be polled
+pub fn hasParallelShaderCompile() bool {
+    return maxShaderCompilerThreads != null;
+}
+
+
+/// True when textures can be sampled through resident 64-bit handles
+pub fn hasBindlessTextures() bool {
+    return getTextureHandle != null and getTextureSamplerHandle != null and
+        makeTextureHandleResident != null and makeTextureHandleNonResident != null;
+}
+
+
+/// True when the driver can sample textures of compressed `format`
+pub fn supportsCompressedFormat(format: c.GLenum) bool {
+    return switch (format) {
+        GL_COMPRESSED_RED_RGTC1, GL_COMPRESSED_RG_RGTC2 => true,
+        GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,
+        GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,
+        GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+        GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT,
+        GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT,
+        GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT,
+        => has_s3tc,
+        GL_COMPRESSED_RGBA_BPTC_UNORM, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM => has_bptc,
+        GL_COMPRESSED_RGBA_ASTC_4x4_KHR, GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR => has_astc,
+        else => false,
+    };
+}
+
+
+/// True when textures can be allocated sparse and their pages committed one by one
+pub fn hasSparseTextures() bool {
+    return texPageCommitment != null and getInternalformativ != null and texStorage2D != null;
+}
+
+
+/// True when buffers and textures can be written by name, without binding them first
+pub fn hasDirectStateAccess() bool {
+    return namedBufferSubData != null and createTextures != null and textureStorage2D != null and
+        textureSubImage2D != null and generateTextureMipmap != null;
+}
+
+
+/// True when uniforms can be set on a program that is not in use
+pub fn hasProgramUniforms() bool {
+    return programUniform1i != null and programUniform4fv != null and
+        programUniformMatrix3fv != null and programUniformMatrix4fv != null;
+}
+
+
+/// True when the context is at least version `major`.`minor`
+pub fn atLeast(major: i32, minor: i32) bool {
+    return version_major > major or (version_major == major and version_minor >= minor);
+}
+
+
+/// True when glGetProgramBinary, glProgramBinary and glProgramParameteri are all available
+pub fn hasProgramBinary() bool {
+    return getProgramBinary != null and programBinary != null and programParameteri != null;
+}
+
+
+fn supported(comptime extension: [:0]const u8) bool {
+    return c.glfwExtensionSupported(extension) == c.GLFW_TRUE;
+}
+
+
+/// Core since `major`.`minor` or exposed as `extension`, both share the entry point names
+fn available(comptime extension: [:0]const u8, major: i32, minor: i32) bool {
+    return atLeast(major, minor) or supported(extension);
+}
+
+
+fn proc(comptime T: type, comptime name: [:0]const u8) ?T {
+    const address = c.glfwGetProcAddress(name) orelse return null;
+    return @ptrCast(address);
+}
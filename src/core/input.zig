@@ -3,6 +3,13 @@ const c = @import("../bindings/c.zig");
 
 const Window = @import("window.zig").Window;
 const CallbackContext = @import("window.zig").CallbackContext;
+const profiler = @import("profiler.zig");
+const time = @import("time.zig");
+const monotonicNs = time.monotonicNs;
+const FrameTimes = time.FrameTimes;
+const FrameTimeStats = time.FrameTimeStats;
+const ActionMap = @import("action_map.zig").ActionMap;
+const InputRecorder = @import("input_replay.zig").InputRecorder;
 
 pub const MousePosition = struct {
     x: f64,
@@ -133,17 +140,59 @@ pub const InputState = enum(u2) {
 
 
 /// Event type to track raw input events from GLFW
-const InputEvent = struct {
-    event_type: enum {
+pub const InputEvent = struct {
+    pub const EventType = enum(u8) {
         key_press,
         key_release,
         mouse_press,
         mouse_release,
         cursor_move,
-    },
+    };
+
+    event_type: EventType,
     key_or_button: c_int,
     cursor_x: f64 = 0,
     cursor_y: f64 = 0,
+    /// When the callback ran, on the clock of time.monotonicNs
+    timestamp_ns: u64 = 0,
+};
+
+
+/// Bounded single-producer single-consumer queue of input events
+/// The GLFW callbacks push from the thread polling events and update pops, without locks or allocation
+const EventRing = struct {
+    const capacity = 1024;
+
+    events: [capacity]InputEvent = undefined,
+    /// Next slot to read, written by the consumer only
+    head: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+    /// Next slot to write, written by the producer only
+    tail: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+
+    /// False when the ring is full and the event was dropped
+    fn push(self: *EventRing, event: InputEvent) bool {
+        const tail = self.tail.load(.monotonic);
+        if (tail - self.head.load(.acquire) == capacity) return false;
+        self.events[tail % capacity] = event;
+        self.tail.store(tail + 1, .release);
+        return true;
+    }
+
+
+    fn peek(self: *EventRing) ?InputEvent {
+        const head = self.head.load(.monotonic);
+        if (head == self.tail.load(.acquire)) return null;
+        return self.events[head % capacity];
+    }
+
+
+    fn pop(self: *EventRing) ?InputEvent {
+        const head = self.head.load(.monotonic);
+        if (head == self.tail.load(.acquire)) return null;
+        const event = self.events[head % capacity];
+        self.head.store(head + 1, .release);
+        return event;
+    }
 };
 
 // Constants for array sizes
@@ -155,19 +204,70 @@ const RECENT_INPUT_FRAMES = 10; // Number of frames to track for "recent" input
 const FRAME_INIT_VALUE = std.math.maxInt(u32);
 
 
+/// Up, pressed, held and released of `count` buttons as packed bitsets
+/// A new frame clears the two edge sets a word at a time, only buttons with events are touched individually
+fn ButtonStates(comptime count: usize) type {
+    return struct {
+        const Self = @This();
+        const BitSet = std.StaticBitSet(count);
+
+        /// Pressed or held
+        down: BitSet = BitSet.initEmpty(),
+        /// Went down this frame
+        pressed: BitSet = BitSet.initEmpty(),
+        /// Went up this frame
+        released: BitSet = BitSet.initEmpty(),
+
+        /// Pressed becomes held and released becomes up
+        fn beginFrame(self: *Self) void {
+            self.pressed = BitSet.initEmpty();
+            self.released = BitSet.initEmpty();
+        }
+
+
+        /// The last event of a frame decides its state, like a press and release in one frame reads released
+        fn press(self: *Self, index: usize) void {
+            self.down.set(index);
+            self.pressed.set(index);
+            self.released.unset(index);
+        }
+
+
+        fn release(self: *Self, index: usize) void {
+            self.down.unset(index);
+            self.released.set(index);
+            self.pressed.unset(index);
+        }
+
+
+        fn state(self: *const Self, index: usize) InputState {
+            if (self.pressed.isSet(index)) return .pressed;
+            if (self.released.isSet(index)) return .released;
+            return if (self.down.isSet(index)) .held else .up;
+        }
+    };
+}
+
+
 // Input system main struct
 pub const Input = struct {
     allocator: std.mem.Allocator,
     window: ?*Window,
 
     // State tracking
-    current_keys: [KEY_ARRAY_SIZE]InputState = [_]InputState{.up} ** KEY_ARRAY_SIZE,
-    previous_keys: [KEY_ARRAY_SIZE]InputState = [_]InputState{.up} ** KEY_ARRAY_SIZE,
-    current_mouse: [MOUSE_BUTTON_ARRAY_SIZE]InputState = [_]InputState{.up} ** MOUSE_BUTTON_ARRAY_SIZE,
-    previous_mouse: [MOUSE_BUTTON_ARRAY_SIZE]InputState = [_]InputState{.up} ** MOUSE_BUTTON_ARRAY_SIZE,
+    keys: ButtonStates(KEY_ARRAY_SIZE) = .{},
+    mouse_buttons: ButtonStates(MOUSE_BUTTON_ARRAY_SIZE) = .{},
 
     // Event queue for raw input events
-    event_queue: std.ArrayList(InputEvent),
+    event_ring: EventRing = .{},
+    /// Events lost because update didn't drain the ring in time
+    dropped_events: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    /// Timestamp of the newest event processed by update, 0 before the first
+    last_event_ns: u64 = 0,
+    /// Timestamp of the oldest event the current frame consumed, 0 in frames without input
+    frame_input_ns: u64 = 0,
+    /// Callback to present times of the frames that had input, filled by framePresented
+    input_latencies: FrameTimes = .{},
 
     // Recent input frame tracking
     frame_count: u32 = 0,
@@ -178,9 +278,15 @@ pub const Input = struct {
 
     // Mouse position tracking
     mouse_pos: MousePosition = .{ .x = 0, .y = 0 },
+    /// Motion of every cursor event since the last update, including those latchMotion took
     mouse_delta: MousePosition = .{ .x = 0, .y = 0 },
     previous_mouse_pos: MousePosition = .{ .x = 0, .y = 0 },
 
+    /// Evaluated at the end of every update, not owned
+    action_map: ?*ActionMap = null,
+    /// Gets every event update processes, not owned
+    recorder: ?*InputRecorder = null,
+
 
     // ============================================================
     // Public API: Creation Functions
@@ -193,7 +299,6 @@ pub const Input = struct {
         self.* = .{
             .allocator = allocator,
             .window = window,
-            .event_queue = std.ArrayList(InputEvent).init(allocator),
         };
 
         // Only set up callbacks if a window is provided
@@ -218,74 +323,102 @@ pub const Input = struct {
 
     /// Process all input events and update input state
     pub fn update(self: *Input) !void {
+        const zone = profiler.zone("Input.update");
+        defer zone.end();
+
         // Increment frame counter
         self.frame_count += 1;
 
-        // Save previous state
-        std.mem.copyForwards(InputState, &self.previous_keys, &self.current_keys);
-        std.mem.copyForwards(InputState, &self.previous_mouse, &self.current_mouse);
-
         // Update states: transition all pressed -> held and released -> up
-        for (0..KEY_ARRAY_SIZE) |i| {
-            switch (self.current_keys[i]) {
-                .pressed => self.current_keys[i] = .held,
-                .released => self.current_keys[i] = .up,
-                else => {}, // Leave held and up as they are
-            }
-        }
-
-        for (0..MOUSE_BUTTON_ARRAY_SIZE) |i| {
-            switch (self.current_mouse[i]) {
-                .pressed => self.current_mouse[i] = .held,
-                .released => self.current_mouse[i] = .up,
-                else => {}, // Leave held and up as they are
-            }
-        }
+        self.keys.beginFrame();
+        self.mouse_buttons.beginFrame();
+        self.mouse_delta = .{ .x = 0, .y = 0 };
+        self.frame_input_ns = 0;
 
         // Process all queued events
-        for (self.event_queue.items) |event| {
+        while (self.event_ring.pop()) |event| {
+            self.last_event_ns = event.timestamp_ns;
+            if (self.frame_input_ns == 0) self.frame_input_ns = event.timestamp_ns;
+            if (self.recorder) |recorder| try recorder.record(self.frame_count, event);
             switch (event.event_type) {
                 .key_press => {
                     const key_index = @as(usize, @intCast(event.key_or_button));
                     if (key_index < KEY_ARRAY_SIZE) {
-                        self.current_keys[key_index] = .pressed;
+                        self.keys.press(key_index);
                         self.key_press_frames[key_index] = self.frame_count;
                     }
                 },
                 .key_release => {
                     const key_index = @as(usize, @intCast(event.key_or_button));
                     if (key_index < KEY_ARRAY_SIZE) {
-                        self.current_keys[key_index] = .released;
+                        self.keys.release(key_index);
                         self.key_release_frames[key_index] = self.frame_count;
                     }
                 },
                 .mouse_press => {
                     const button_index = @as(usize, @intCast(event.key_or_button));
                     if (button_index < MOUSE_BUTTON_ARRAY_SIZE) {
-                        self.current_mouse[button_index] = .pressed;
+                        self.mouse_buttons.press(button_index);
                         self.mouse_press_frames[button_index] = self.frame_count;
                     }
                 },
                 .mouse_release => {
                     const button_index = @as(usize, @intCast(event.key_or_button));
                     if (button_index < MOUSE_BUTTON_ARRAY_SIZE) {
-                        self.current_mouse[button_index] = .released;
+                        self.mouse_buttons.release(button_index);
                         self.mouse_release_frames[button_index] = self.frame_count;
                     }
                 },
-                .cursor_move => {
-                    self.previous_mouse_pos = self.mouse_pos;
-                    self.mouse_pos = .{ .x = event.cursor_x, .y = event.cursor_y };
-                    self.mouse_delta = .{
-                        .x = self.mouse_pos.x - self.previous_mouse_pos.x,
-                        .y = self.mouse_pos.y - self.previous_mouse_pos.y,
-                    };
-                },
+                .cursor_move => _ = self.moveCursor(event),
             }
         }
 
-        // Clear event queue for next frame
-        self.event_queue.clearRetainingCapacity();
+        if (self.action_map) |action_map| action_map.evaluate(self);
+    }
+
+
+    /// Poll the window again right before rendering and take the cursor motion that arrived since update,
+    /// returning it so a camera can turn by it, see CameraMouseController.applyMouseDelta. Call from the
+    /// thread polling events. Motion queued behind a key or button event waits for the next update,
+    /// which keeps the order of events, the delta of the frame still counts everything latched
+    pub fn latchMotion(self: *Input) !MousePosition {
+        const zone = profiler.zone("Input.latchMotion");
+        defer zone.end();
+
+        if (self.window != null) c.glfwPollEvents();
+        var latched: MousePosition = .{ .x = 0, .y = 0 };
+        while (self.event_ring.peek()) |event| {
+            if (event.event_type != .cursor_move) break;
+            _ = self.event_ring.pop();
+            self.last_event_ns = event.timestamp_ns;
+            if (self.frame_input_ns == 0) self.frame_input_ns = event.timestamp_ns;
+            if (self.recorder) |recorder| try recorder.record(self.frame_count, event);
+            const motion = self.moveCursor(event);
+            latched.x += motion.x;
+            latched.y += motion.y;
+        }
+        return latched;
+    }
+
+
+    /// Evaluate `action_map` at the end of every update from now on, null detaches it
+    pub fn setActionMap(self: *Input, action_map: ?*ActionMap) void {
+        self.action_map = action_map;
+        if (action_map) |map| map.evaluate(self);
+    }
+
+
+    /// Record every event from the next update on into `recorder`, null stops recording
+    pub fn setRecorder(self: *Input, recorder: ?*InputRecorder) void {
+        self.recorder = recorder;
+        if (recorder) |attached| attached.start_frame = self.frame_count;
+    }
+
+
+    /// Queue an event as if a callback had received it, keeping its timestamp, e.g. from InputReplay
+    /// Must come from the thread polling events. False when the ring is full and the event was dropped
+    pub fn injectEvent(self: *Input, event: InputEvent) bool {
+        return self.event_ring.push(event);
     }
 
 
@@ -293,28 +426,35 @@ pub const Input = struct {
     pub fn isKeyPressed(self: *const Input, key: KeyCode) bool {
         const key_index = @as(usize, @intCast(@intFromEnum(key)));
         if (key_index >= KEY_ARRAY_SIZE) return false;
-        return self.current_keys[key_index] == .pressed;
+        return self.keys.pressed.isSet(key_index);
     }
 
 
     pub fn isKeyHeld(self: *const Input, key: KeyCode) bool {
         const key_index = @as(usize, @intCast(@intFromEnum(key)));
         if (key_index >= KEY_ARRAY_SIZE) return false;
-        return self.current_keys[key_index] == .held or self.current_keys[key_index] == .pressed;
+        return self.keys.down.isSet(key_index);
     }
 
 
     pub fn isKeyReleased(self: *const Input, key: KeyCode) bool {
         const key_index = @as(usize, @intCast(@intFromEnum(key)));
         if (key_index >= KEY_ARRAY_SIZE) return false;
-        return self.current_keys[key_index] == .released;
+        return self.keys.released.isSet(key_index);
     }
 
 
     pub fn isKeyUp(self: *const Input, key: KeyCode) bool {
         const key_index = @as(usize, @intCast(@intFromEnum(key)));
         if (key_index >= KEY_ARRAY_SIZE) return true; // Consider out-of-range as up
-        return self.current_keys[key_index] == .up;
+        return self.keys.state(key_index) == .up;
+    }
+
+
+    pub fn getKeyState(self: *const Input, key: KeyCode) InputState {
+        const key_index = @as(usize, @intCast(@intFromEnum(key)));
+        if (key_index >= KEY_ARRAY_SIZE) return .up;
+        return self.keys.state(key_index);
     }
 
 
@@ -348,28 +488,35 @@ pub const Input = struct {
     pub fn isMouseButtonPressed(self: *const Input, button: MouseButton) bool {
         const button_index = @as(usize, @intCast(@intFromEnum(button)));
         if (button_index >= MOUSE_BUTTON_ARRAY_SIZE) return false;
-        return self.current_mouse[button_index] == .pressed;
+        return self.mouse_buttons.pressed.isSet(button_index);
     }
 
 
     pub fn isMouseButtonHeld(self: *const Input, button: MouseButton) bool {
         const button_index = @as(usize, @intCast(@intFromEnum(button)));
         if (button_index >= MOUSE_BUTTON_ARRAY_SIZE) return false;
-        return self.current_mouse[button_index] == .held or self.current_mouse[button_index] == .pressed;
+        return self.mouse_buttons.down.isSet(button_index);
     }
 
 
     pub fn isMouseButtonReleased(self: *const Input, button: MouseButton) bool {
         const button_index = @as(usize, @intCast(@intFromEnum(button)));
         if (button_index >= MOUSE_BUTTON_ARRAY_SIZE) return false;
-        return self.current_mouse[button_index] == .released;
+        return self.mouse_buttons.released.isSet(button_index);
     }
 
 
     pub fn isMouseButtonUp(self: *const Input, button: MouseButton) bool {
         const button_index = @as(usize, @intCast(@intFromEnum(button)));
         if (button_index >= MOUSE_BUTTON_ARRAY_SIZE) return true; // Consider out-of-range as up
-        return self.current_mouse[button_index] == .up;
+        return self.mouse_buttons.state(button_index) == .up;
+    }
+
+
+    pub fn getMouseButtonState(self: *const Input, button: MouseButton) InputState {
+        const button_index = @as(usize, @intCast(@intFromEnum(button)));
+        if (button_index >= MOUSE_BUTTON_ARRAY_SIZE) return .up;
+        return self.mouse_buttons.state(button_index);
     }
 
 
@@ -409,16 +556,62 @@ pub const Input = struct {
     }
 
 
+    /// Time the newest processed event happened, for measuring input latency
+    pub fn getLastEventTime(self: *const Input) u64 {
+        return self.last_event_ns;
+    }
+
+
+    /// Close the latency measurement of the frame's input, Window.swapBuffers calls it once the frame is queued
+    /// Replayed events carry the timestamps of their recording and are not measured
+    pub fn framePresented(self: *Input) void {
+        if (self.frame_input_ns == 0) return;
+        const now = monotonicNs();
+        if (now > self.frame_input_ns) self.input_latencies.push(now - self.frame_input_ns);
+        self.frame_input_ns = 0;
+    }
+
+
+    /// Distribution of the time from the oldest event of a frame to that frame's present, over the last
+    /// FrameTimes.capacity frames with input
+    pub fn getInputLatencyStats(self: *const Input) FrameTimeStats {
+        return self.input_latencies.stats();
+    }
+
+
+    /// Events dropped so far because the ring was full
+    pub fn getDroppedEvents(self: *const Input) u32 {
+        return self.dropped_events.load(.monotonic);
+    }
+
+
     // ============================================================
     // Public API: Destruction Function
     // ============================================================
 
     pub fn release(self: *Input) void {
-        self.event_queue.deinit();
         self.allocator.destroy(self);
     }
 
 
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Motion of one cursor event, added to the frame's delta
+    fn moveCursor(self: *Input, event: InputEvent) MousePosition {
+        self.previous_mouse_pos = self.mouse_pos;
+        self.mouse_pos = .{ .x = event.cursor_x, .y = event.cursor_y };
+        const motion: MousePosition = .{
+            .x = self.mouse_pos.x - self.previous_mouse_pos.x,
+            .y = self.mouse_pos.y - self.previous_mouse_pos.y,
+        };
+        self.mouse_delta.x += motion.x;
+        self.mouse_delta.y += motion.y;
+        return motion;
+    }
+
+
     // ============================================================
     // Private Functions: Callbacks 
     // ============================================================
@@ -440,6 +633,14 @@ pub const Input = struct {
     }
 
 
+    /// Stamp and push an event from a callback, dropping it when the ring is full
+    fn queueEvent(self: *Input, event: InputEvent) void {
+        var stamped = event;
+        stamped.timestamp_ns = monotonicNs();
+        if (!self.event_ring.push(stamped)) _ = self.dropped_events.fetchAdd(1, .monotonic);
+    }
+
+
     // Callback implementations
     fn keyCallback(window: ?*c.GLFWwindow, key: c_int, scancode: c_int, action: c_int, mods: c_int) callconv(.C) void {
         _ = scancode;
@@ -465,7 +666,7 @@ pub const Input = struct {
             };
 
             // Add to event queue
-            input.event_queue.append(event) catch return;
+            input.queueEvent(event);
         }
     }
 
@@ -493,7 +694,7 @@ pub const Input = struct {
             };
 
             // Add to event queue
-            input.event_queue.append(event) catch return;
+            input.queueEvent(event);
         }
     }
 
@@ -514,7 +715,7 @@ pub const Input = struct {
             };  
 
             // Add to event queue
-            input.event_queue.append(event) catch return;
+            input.queueEvent(event);
         }
     }
 };
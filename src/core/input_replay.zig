@@ -0,0 +1,208 @@
+// input_replay.zig - Recording input sessions and replaying them deterministically
+const std = @import("std");
+
+const input_module = @import("input.zig");
+const Input = input_module.Input;
+const InputEvent = input_module.InputEvent;
+
+
+pub const InputReplayError = error{
+    /// Wrong magic or version, or an unknown event type
+    InvalidRecording,
+};
+
+
+const recording_magic = "ZINP";
+const recording_version: u32 = 1;
+
+
+/// One event and the Input frame that processed it
+pub const RecordedEvent = struct {
+    /// Counted from 1, the first update after the recorder was attached
+    frame: u32,
+    event: InputEvent,
+};
+
+
+/// Collects every event Input.update processes, attach it with Input.setRecorder
+/// The log holds the frame number of each event and its original timestamp, save writes it as a
+/// compact little endian stream: a magic and version, then per event its frame, type, the key or
+/// button or the cursor position, and the timestamp
+pub const InputRecorder = struct {
+    const Self = @This();
+
+    events: std.ArrayList(RecordedEvent),
+    /// Input frame before the first recorded one, set by Input.setRecorder
+    start_frame: u32 = 0,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator) Self {
+        return .{ .events = std.ArrayList(RecordedEvent).init(allocator) };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Called by Input.update for every event it processes in `frame`
+    pub fn record(self: *Self, frame: u32, event: InputEvent) !void {
+        try self.events.append(.{ .frame = frame -% self.start_frame, .event = event });
+    }
+
+
+    /// Forget everything recorded so far
+    pub fn clear(self: *Self) void {
+        self.events.clearRetainingCapacity();
+    }
+
+
+    /// Pass any writer through `.any()`, e.g. `buffered.writer().any()`
+    pub fn save(self: *const Self, writer: std.io.AnyWriter) !void {
+        try writer.writeAll(recording_magic);
+        try writer.writeInt(u32, recording_version, .little);
+        try writer.writeInt(u32, @intCast(self.events.items.len), .little);
+
+        for (self.events.items) |recorded| {
+            const event = recorded.event;
+            try writer.writeInt(u32, recorded.frame, .little);
+            try writer.writeByte(@intFromEnum(event.event_type));
+            switch (event.event_type) {
+                .cursor_move => {
+                    try writer.writeInt(u64, @bitCast(event.cursor_x), .little);
+                    try writer.writeInt(u64, @bitCast(event.cursor_y), .little);
+                },
+                else => try writer.writeInt(i32, event.key_or_button, .little),
+            }
+            try writer.writeInt(u64, event.timestamp_ns, .little);
+        }
+    }
+
+
+    /// save into the file at `path`
+    pub fn saveToFile(self: *const Self, path: []const u8) !void {
+        const file = try std.fs.cwd().createFile(path, .{});
+        defer file.close();
+        var buffered = std.io.bufferedWriter(file.writer());
+        try self.save(buffered.writer().any());
+        try buffered.flush();
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.events.deinit();
+    }
+};
+
+
+/// Feeds a recording back into an Input, frame by frame
+/// Call feed before every Input.update, which then sees exactly the events it saw in the recorded
+/// frame with their original timestamps. With an Input created without a window, a fixed timestep
+/// and no frame limit (`target_fps = 0`), a session replays headless as fast as the simulation runs
+pub const InputReplay = struct {
+    const Self = @This();
+
+    allocator: std.mem.Allocator,
+    events: []RecordedEvent,
+    /// Next event to feed
+    cursor: usize = 0,
+    /// Input frame before the first replayed one, taken by the first feed
+    start_frame: ?u32 = null,
+    /// Events that didn't fit into the input ring, nonzero means the replay diverged
+    dropped_events: usize = 0,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Read a recording written by InputRecorder.save
+    pub fn load(allocator: std.mem.Allocator, reader: std.io.AnyReader) !Self {
+        var magic: [recording_magic.len]u8 = undefined;
+        try reader.readNoEof(&magic);
+        if (!std.mem.eql(u8, &magic, recording_magic)) return InputReplayError.InvalidRecording;
+        if (try reader.readInt(u32, .little) != recording_version) return InputReplayError.InvalidRecording;
+
+        const count = try reader.readInt(u32, .little);
+        const events = try allocator.alloc(RecordedEvent, count);
+        errdefer allocator.free(events);
+
+        for (events) |*recorded| {
+            recorded.frame = try reader.readInt(u32, .little);
+            const event_type = std.meta.intToEnum(InputEvent.EventType, try reader.readByte()) catch return InputReplayError.InvalidRecording;
+            recorded.event = .{ .event_type = event_type, .key_or_button = 0 };
+            switch (event_type) {
+                .cursor_move => {
+                    recorded.event.cursor_x = @bitCast(try reader.readInt(u64, .little));
+                    recorded.event.cursor_y = @bitCast(try reader.readInt(u64, .little));
+                },
+                else => recorded.event.key_or_button = try reader.readInt(i32, .little),
+            }
+            recorded.event.timestamp_ns = try reader.readInt(u64, .little);
+        }
+
+        return .{ .allocator = allocator, .events = events };
+    }
+
+
+    /// load from the file at `path`
+    pub fn loadFromFile(allocator: std.mem.Allocator, path: []const u8) !Self {
+        const file = try std.fs.cwd().openFile(path, .{});
+        defer file.close();
+        var buffered = std.io.bufferedReader(file.reader());
+        return load(allocator, buffered.reader().any());
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Queue the events of the frame the next `input.update` processes
+    pub fn feed(self: *Self, input: *Input) void {
+        const start_frame = self.start_frame orelse input.frame_count;
+        self.start_frame = start_frame;
+        const frame = input.frame_count +% 1 -% start_frame;
+        while (self.cursor < self.events.len and self.events[self.cursor].frame <= frame) : (self.cursor += 1) {
+            if (!input.injectEvent(self.events[self.cursor].event)) self.dropped_events += 1;
+        }
+    }
+
+
+    /// Every recorded event has been fed
+    pub fn isFinished(self: *const Self) bool {
+        return self.cursor == self.events.len;
+    }
+
+
+    /// Frame of the last recorded event, the length of the session in frames
+    pub fn frameCount(self: *const Self) u32 {
+        if (self.events.len == 0) return 0;
+        return self.events[self.events.len - 1].frame;
+    }
+
+
+    /// Start over from the first event, at the next feed
+    pub fn rewind(self: *Self) void {
+        self.cursor = 0;
+        self.start_frame = null;
+        self.dropped_events = 0;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.allocator.free(self.events);
+    }
+};
@@ -0,0 +1,637 @@
+// jobs.zig - Work-stealing job system
+const std = @import("std");
+const fiber = @import("fiber.zig");
+
+
+/// Number of jobs still running in a group, jobs spawned after it start once it reaches zero
+/// Lives with the caller, and must stay alive until every job counted on it finished
+pub const Counter = struct {
+    value: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    /// Guards `waiting` against the job that brings the count to zero
+    mutex: std.Thread.Mutex = .{},
+    /// Jobs from spawnAfter, submitted once the count reaches zero
+    waiting: ?*Job = null,
+
+    pub fn isDone(self: *const Counter) bool {
+        return self.value.load(.acquire) == 0;
+    }
+};
+
+
+pub const JobSystemOptions = struct {
+    /// Worker threads besides the main thread, one less than the logical CPUs by default
+    worker_count: ?usize = null,
+    /// Usable stack of each fiber from spawnFiber, idle fibers keep theirs for the next one
+    fiber_stack_size: usize = 256 * 1024,
+};
+
+
+/// A queued function call, the start of the closure that holds its arguments
+const Job = struct {
+    run_fn: *const fn (*Job) void,
+    /// Finished once the job ran
+    counter: ?*Counter,
+    /// Link in the injector, main thread and waiting lists
+    next: ?*Job = null,
+};
+
+
+/// Lock-protected FIFO of jobs, for threads without a deque and for jobs bound to the main thread
+const JobList = struct {
+    mutex: std.Thread.Mutex = .{},
+    head: ?*Job = null,
+    tail: ?*Job = null,
+
+    fn push(self: *JobList, job: *Job) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        job.next = null;
+        if (self.tail) |tail| tail.next = job else self.head = job;
+        self.tail = job;
+    }
+
+
+    fn pop(self: *JobList) ?*Job {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        const job = self.head orelse return null;
+        self.head = job.next;
+        if (self.head == null) self.tail = null;
+        return job;
+    }
+};
+
+
+/// Chase-Lev work-stealing deque of a fixed capacity
+/// The owning worker pushes and pops at the bottom, every other thread steals from the top
+const Deque = struct {
+    const capacity = 1024;
+    const mask = capacity - 1;
+
+    top: std.atomic.Value(isize) = std.atomic.Value(isize).init(0),
+    bottom: std.atomic.Value(isize) = std.atomic.Value(isize).init(0),
+    /// Job pointers, atomic so a steal racing the owner reads a whole value
+    buffer: [capacity]std.atomic.Value(usize) = [_]std.atomic.Value(usize){std.atomic.Value(usize).init(0)} ** capacity,
+
+
+    /// Owner only, false when the deque is full
+    fn push(self: *Deque, job: *Job) bool {
+        const b = self.bottom.load(.monotonic);
+        const t = self.top.load(.acquire);
+        if (b - t >= capacity) return false;
+
+        self.buffer[@intCast(b & mask)].store(@intFromPtr(job), .monotonic);
+        self.bottom.store(b + 1, .release);
+        return true;
+    }
+
+
+    /// Owner only, newest job first
+    fn pop(self: *Deque) ?*Job {
+        const b = self.bottom.load(.monotonic) - 1;
+        // Sequentially consistent so a thief can't read the old bottom after we read top
+        self.bottom.store(b, .seq_cst);
+        const t = self.top.load(.seq_cst);
+
+        if (t > b) {
+            self.bottom.store(b + 1, .monotonic);
+            return null;
+        }
+
+        const job: *Job = @ptrFromInt(self.buffer[@intCast(b & mask)].load(.monotonic));
+        if (t == b) {
+            // Last job, a thief may be taking it at the same time
+            const won = self.top.cmpxchgStrong(t, t + 1, .seq_cst, .monotonic) == null;
+            self.bottom.store(b + 1, .monotonic);
+            return if (won) job else null;
+        }
+        return job;
+    }
+
+
+    /// Any thread, oldest job first, null when empty or when another thread won the race
+    fn steal(self: *Deque) ?*Job {
+        const t = self.top.load(.seq_cst);
+        const b = self.bottom.load(.seq_cst);
+        if (t >= b) return null;
+
+        const job: *Job = @ptrFromInt(self.buffer[@intCast(t & mask)].load(.monotonic));
+        if (self.top.cmpxchgStrong(t, t + 1, .seq_cst, .monotonic) != null) return null;
+        return job;
+    }
+};
+
+
+const Worker = struct {
+    system: *JobSystem,
+    deque: Deque = .{},
+    thread: ?std.Thread = null,
+    /// xorshift state picking the first victim to steal from
+    rng: u32,
+};
+
+
+/// Job running on a stack of its own, so a wait inside it suspends it instead of holding up its worker
+const Fiber = struct {
+    /// Resumes the fiber, queued like any other job and never counted
+    job: Job,
+    system: *JobSystem,
+    stack: fiber.Stack,
+    context: fiber.Context = .{},
+    /// Context of the thread that resumed the fiber, switched back to when it suspends or returns
+    caller: fiber.Context = .{},
+    /// The call the fiber makes and the counter finished once it returned
+    task: ?*Job = null,
+    counter: ?*Counter = null,
+    /// Why the fiber last switched away, acted on by resumeFiber on the worker's own stack
+    state: State = .running,
+    waiting_on: ?*Counter = null,
+    /// Link in the list of idle fibers
+    next_free: ?*Fiber = null,
+
+    const State = enum { running, waiting, yielded, finished };
+};
+
+
+/// Worker of the calling thread, null on threads the job system didn't start
+threadlocal var current_worker: ?*Worker = null;
+/// Fiber running on the calling thread, null while it runs on its own stack
+threadlocal var current_fiber: ?*Fiber = null;
+
+
+/// Work-stealing scheduler shared by the engine's parallel work: ECS iteration, asset decoding,
+/// culling and terrain builds. Every worker owns a Chase-Lev deque, pushes the jobs it spawns
+/// onto it and pops them newest first, and steals the oldest jobs of others when it runs dry.
+/// Other threads submit through a shared injector queue. Waiting on a Counter or WaitGroup runs
+/// jobs instead of blocking, and jobs that need the GL context go to a queue that only
+/// runMainThreadJobs drains. spawnWg and waitAndWork match std.Thread.Pool so callers can switch
+/// Jobs from spawnFiber run on stacks of their own, so gameplay code waiting on loads or on other
+/// systems suspends and hands its worker to other jobs instead of running them on top of itself
+/// The allocator must be thread safe, closures are allocated on whichever thread spawns them
+pub const JobSystem = struct {
+    const Self = @This();
+
+    /// Attempts to find a job before an idle worker goes to sleep
+    const idle_spins = 64;
+
+    allocator: std.mem.Allocator,
+    workers: []Worker,
+    /// Jobs from threads without a deque and overflow of full deques
+    injector: JobList = .{},
+    /// Jobs only runMainThreadJobs runs
+    main_queue: JobList = .{},
+
+    /// Jobs submitted and not taken yet, read by idle workers before sleeping
+    queued: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+    sleeping: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+    sleep_mutex: std.Thread.Mutex = .{},
+    wake: std.Thread.Condition = .{},
+    running: std.atomic.Value(bool) = std.atomic.Value(bool).init(true),
+
+    fiber_stack_size: usize,
+    /// Fibers whose call returned, reused with their stacks
+    free_fibers: ?*Fiber = null,
+    fiber_mutex: std.Thread.Mutex = .{},
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Start the workers, the job system must not move until deinit
+    pub fn init(self: *Self, allocator: std.mem.Allocator, options: JobSystemOptions) !void {
+        const cpu_count = std.Thread.getCpuCount() catch 2;
+        const worker_count = options.worker_count orelse @max(cpu_count, 2) - 1;
+
+        self.* = .{
+            .allocator = allocator,
+            .workers = try allocator.alloc(Worker, worker_count),
+            .fiber_stack_size = options.fiber_stack_size,
+        };
+        errdefer allocator.free(self.workers);
+
+        for (self.workers, 0..) |*worker, i| {
+            worker.* = .{ .system = self, .rng = @as(u32, @intCast(i)) *% 0x9E3779B9 +% 1 };
+        }
+
+        var started: usize = 0;
+        errdefer {
+            self.running.store(false, .release);
+            self.wakeAll();
+            for (self.workers[0..started]) |*worker| worker.thread.?.join();
+        }
+        for (self.workers) |*worker| {
+            worker.thread = try std.Thread.spawn(.{}, workerMain, .{worker});
+            started += 1;
+        }
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Run `func` with `args` on some worker, counted on `counter` if given
+    pub fn spawn(self: *Self, counter: ?*Counter, comptime func: anytype, args: anytype) !void {
+        const job = try self.createJob(counter, func, args);
+        self.submit(job);
+    }
+
+
+    /// Run `func` with `args` on a fiber, counted on `counter` if given
+    /// wait and yield inside it suspend the fiber and free its worker, and once the counter it waits on
+    /// reaches zero it resumes on whichever worker takes it. So it must not hold a lock, or pointers to
+    /// thread-local state, across a wait. Where fibers aren't supported it runs as a plain job
+    pub fn spawnFiber(self: *Self, counter: ?*Counter, comptime func: anytype, args: anytype) !void {
+        if (comptime !fiber.supported) {
+            return self.spawn(counter, func, args);
+        } else {
+            const f = try self.acquireFiber();
+            errdefer self.releaseFiber(f);
+            f.task = try self.createJob(null, func, args);
+            f.counter = counter;
+            if (counter) |group| _ = group.value.fetchAdd(1, .monotonic);
+            self.submit(&f.job);
+        }
+    }
+
+
+    /// Run `func` once `dependency` reaches zero, right away if it already has
+    pub fn spawnAfter(self: *Self, dependency: *Counter, counter: ?*Counter, comptime func: anytype, args: anytype) !void {
+        const job = try self.createJob(counter, func, args);
+
+        dependency.mutex.lock();
+        if (!dependency.isDone()) {
+            job.next = dependency.waiting;
+            dependency.waiting = job;
+            dependency.mutex.unlock();
+            return;
+        }
+        dependency.mutex.unlock();
+        self.submit(job);
+    }
+
+
+    /// Queue `func` for the next runMainThreadJobs, for work that needs the GL context
+    pub fn spawnMain(self: *Self, counter: ?*Counter, comptime func: anytype, args: anytype) !void {
+        const job = try self.createJob(counter, func, args);
+        self.main_queue.push(job);
+    }
+
+
+    /// Run main thread jobs until `budget_ns` nanoseconds have passed, at least one if any is queued
+    /// Call from the thread owning the GL context, returns the number of jobs run
+    pub fn runMainThreadJobs(self: *Self, budget_ns: u64) usize {
+        const start = std.time.nanoTimestamp();
+        var ran: usize = 0;
+        while (self.main_queue.pop()) |job| {
+            self.execute(job);
+            ran += 1;
+            if (std.time.nanoTimestamp() - start >= budget_ns) break;
+        }
+        return ran;
+    }
+
+
+    /// Block until `counter` reaches zero, running other jobs meanwhile
+    /// A fiber of this job system is suspended instead and resumes once the count reached zero
+    pub fn wait(self: *Self, counter: *Counter) void {
+        if (counter.isDone()) return;
+        if (self.runningFiber()) |f| {
+            f.waiting_on = counter;
+            suspendFiber(f, .waiting);
+            return;
+        }
+        while (!counter.isDone()) {
+            if (!self.runOne()) std.Thread.yield() catch {};
+        }
+    }
+
+
+    /// Let queued jobs go first: a fiber is suspended behind them, other threads run one of them
+    pub fn yield(self: *Self) void {
+        if (self.runningFiber()) |f| return suspendFiber(f, .yielded);
+        if (!self.runOne()) std.Thread.yield() catch {};
+    }
+
+
+    /// std.Thread.Pool.spawnWg, runs `func` inline if the job can't be allocated
+    pub fn spawnWg(self: *Self, wait_group: *std.Thread.WaitGroup, comptime func: anytype, args: anytype) void {
+        const Wrapper = struct {
+            fn call(group: *std.Thread.WaitGroup, arguments: @TypeOf(args)) void {
+                @call(.auto, func, arguments);
+                group.finish();
+            }
+        };
+
+        wait_group.start();
+        self.spawn(null, Wrapper.call, .{ wait_group, args }) catch Wrapper.call(wait_group, args);
+    }
+
+
+    /// std.Thread.Pool.waitAndWork, runs jobs until `wait_group` is done
+    pub fn waitAndWork(self: *Self, wait_group: *std.Thread.WaitGroup) void {
+        while (!wait_group.isDone()) {
+            if (!self.runOne()) std.Thread.yield() catch {};
+        }
+    }
+
+
+    /// Call `func(context, start, end)` for chunks of `chunk_size` covering 0..count and wait for all
+    /// The calling thread takes the last chunk itself
+    pub fn parallelFor(self: *Self, count: usize, chunk_size: usize, context: anytype, comptime func: fn (@TypeOf(context), usize, usize) void) void {
+        if (count == 0) return;
+        const step = @max(chunk_size, 1);
+
+        var counter = Counter{};
+        var start: usize = 0;
+        while (start + step < count) : (start += step) {
+            self.spawn(&counter, func, .{ context, start, start + step }) catch func(context, start, start + step);
+        }
+        func(context, start, count);
+        self.wait(&counter);
+    }
+
+
+    pub fn workerCount(self: *const Self) usize {
+        return self.workers.len;
+    }
+
+
+    /// Index of the calling worker below workerCount, null on threads this job system didn't start
+    pub fn currentWorkerIndex(self: *const Self) ?usize {
+        const worker = current_worker orelse return null;
+        if (worker.system != self) return null;
+        return (@intFromPtr(worker) - @intFromPtr(self.workers.ptr)) / @sizeOf(Worker);
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Stop the workers, then run whatever is still queued on the calling thread, main thread jobs included
+    pub fn deinit(self: *Self) void {
+        self.running.store(false, .release);
+        self.wakeAll();
+        for (self.workers) |*worker| {
+            if (worker.thread) |thread| thread.join();
+        }
+
+        while (self.runOne()) {}
+        while (self.main_queue.pop()) |job| self.execute(job);
+        self.allocator.free(self.workers);
+
+        // Fibers still waiting on a counter that never reaches zero are lost with their stacks
+        while (self.free_fibers) |f| {
+            self.free_fibers = f.next_free;
+            f.stack.destroy();
+            self.allocator.destroy(f);
+        }
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn createJob(self: *Self, counter: ?*Counter, comptime func: anytype, args: anytype) !*Job {
+        const Args = @TypeOf(args);
+        const Closure = struct {
+            job: Job,
+            arguments: Args,
+            allocator: std.mem.Allocator,
+
+            fn run(job: *Job) void {
+                const closure: *@This() = @alignCast(@fieldParentPtr("job", job));
+                @call(.auto, func, closure.arguments);
+                closure.allocator.destroy(closure);
+            }
+        };
+
+        const closure = try self.allocator.create(Closure);
+        closure.* = .{
+            .job = .{ .run_fn = Closure.run, .counter = counter },
+            .arguments = args,
+            .allocator = self.allocator,
+        };
+        if (counter) |group| _ = group.value.fetchAdd(1, .monotonic);
+        return &closure.job;
+    }
+
+
+    /// Onto the calling worker's deque, the injector from other threads or when the deque is full
+    fn submit(self: *Self, job: *Job) void {
+        // Counted first, so a thread taking the job never brings the count below zero
+        _ = self.queued.fetchAdd(1, .seq_cst);
+
+        const pushed = if (current_worker) |worker| worker.system == self and worker.deque.push(job) else false;
+        if (!pushed) self.injector.push(job);
+        self.wakeOne();
+    }
+
+
+    /// Onto the injector behind everything queued, which the workers look at last
+    fn submitShared(self: *Self, job: *Job) void {
+        _ = self.queued.fetchAdd(1, .seq_cst);
+        self.injector.push(job);
+        self.wakeOne();
+    }
+
+
+    fn wakeOne(self: *Self) void {
+        if (self.sleeping.load(.seq_cst) > 0) {
+            self.sleep_mutex.lock();
+            defer self.sleep_mutex.unlock();
+            self.wake.signal();
+        }
+    }
+
+
+    /// Run one job from anywhere, false when none was found
+    fn runOne(self: *Self) bool {
+        const job = self.findJob() orelse return false;
+        _ = self.queued.fetchSub(1, .monotonic);
+        self.execute(job);
+        return true;
+    }
+
+
+    /// The calling worker's own deque first, then the others from a random start, then the injector
+    fn findJob(self: *Self) ?*Job {
+        var start: usize = 0;
+        if (current_worker) |worker| {
+            if (worker.system == self) {
+                if (worker.deque.pop()) |job| return job;
+                worker.rng ^= worker.rng << 13;
+                worker.rng ^= worker.rng >> 17;
+                worker.rng ^= worker.rng << 5;
+                start = worker.rng;
+            }
+        }
+
+        for (0..self.workers.len) |i| {
+            const victim = &self.workers[(start + i) % self.workers.len];
+            if (victim.deque.steal()) |job| return job;
+        }
+        return self.injector.pop();
+    }
+
+
+    /// Run the job and count it as finished, the closure is gone once run_fn returns
+    /// Dependents released by it go to the workers, also for jobs from the main thread queue
+    fn execute(self: *Self, job: *Job) void {
+        const counter = job.counter;
+        job.run_fn(job);
+        if (counter) |group| self.finish(group);
+    }
+
+
+    /// Count one job of `counter` as done and release its dependents on the last one
+    fn finish(self: *Self, counter: *Counter) void {
+        if (counter.value.fetchSub(1, .acq_rel) != 1) return;
+
+        counter.mutex.lock();
+        var waiting = counter.waiting;
+        counter.waiting = null;
+        counter.mutex.unlock();
+
+        while (waiting) |job| {
+            waiting = job.next;
+            self.submit(job);
+        }
+    }
+
+
+    /// An idle fiber with a fresh context, from the free list or newly mapped
+    fn acquireFiber(self: *Self) !*Fiber {
+        self.fiber_mutex.lock();
+        const pooled = self.free_fibers;
+        if (pooled) |f| self.free_fibers = f.next_free;
+        self.fiber_mutex.unlock();
+
+        const f = pooled orelse created: {
+            const created = try self.allocator.create(Fiber);
+            errdefer self.allocator.destroy(created);
+            created.* = .{
+                .job = .{ .run_fn = resumeFiber, .counter = null },
+                .system = self,
+                .stack = try fiber.Stack.create(self.fiber_stack_size),
+            };
+            break :created created;
+        };
+        f.context = fiber.Context.init(f.stack, fiberMain, f);
+        f.state = .running;
+        return f;
+    }
+
+
+    fn releaseFiber(self: *Self, f: *Fiber) void {
+        self.fiber_mutex.lock();
+        defer self.fiber_mutex.unlock();
+        f.task = null;
+        f.counter = null;
+        f.next_free = self.free_fibers;
+        self.free_fibers = f;
+    }
+
+
+    /// Fiber of this job system running on the calling thread
+    /// Not inlined, so the thread-local read can't be reused past a switch that moved the fiber to another thread
+    noinline fn runningFiber(self: *Self) ?*Fiber {
+        if (!fiber.supported) return null;
+        const f = current_fiber orelse return null;
+        return if (f.system == self) f else null;
+    }
+
+
+    /// Switch from the running fiber back to the thread that resumed it, returns once it is resumed again
+    noinline fn suspendFiber(f: *Fiber, state: Fiber.State) void {
+        f.state = state;
+        f.context.swap(&f.caller);
+    }
+
+
+    /// Run job of a fiber: switch into it until it suspends or returns, then act on why it stopped
+    /// This runs on the worker's stack, so the fiber is only queued again once nothing runs on its own
+    fn resumeFiber(job: *Job) void {
+        const f: *Fiber = @alignCast(@fieldParentPtr("job", job));
+        const self = f.system;
+
+        const outer = current_fiber;
+        current_fiber = f;
+        f.caller.swap(&f.context);
+        current_fiber = outer;
+
+        switch (f.state) {
+            .running => unreachable,
+            .finished => {
+                const counter = f.counter;
+                self.releaseFiber(f);
+                if (counter) |group| self.finish(group);
+            },
+            .yielded => self.submitShared(&f.job),
+            // Same handoff as spawnAfter, the last finish of the counter takes the fiber's job if queued here
+            .waiting => {
+                const counter = f.waiting_on.?;
+                f.waiting_on = null;
+                counter.mutex.lock();
+                if (!counter.isDone()) {
+                    f.job.next = counter.waiting;
+                    counter.waiting = &f.job;
+                    counter.mutex.unlock();
+                    return;
+                }
+                counter.mutex.unlock();
+                self.submit(&f.job);
+            },
+        }
+    }
+
+
+    /// First function on a fiber's stack, runs its call and switches away for good
+    fn fiberMain(argument: *anyopaque) callconv(.C) noreturn {
+        const f: *Fiber = @alignCast(@ptrCast(argument));
+        const task = f.task.?;
+        task.run_fn(task);
+        f.state = .finished;
+        f.context.swap(&f.caller);
+        unreachable;
+    }
+
+
+    fn wakeAll(self: *Self) void {
+        self.sleep_mutex.lock();
+        defer self.sleep_mutex.unlock();
+        self.wake.broadcast();
+    }
+
+
+    fn workerMain(worker: *Worker) void {
+        const self = worker.system;
+        current_worker = worker;
+        defer current_worker = null;
+
+        var idle: usize = 0;
+        while (self.running.load(.acquire)) {
+            if (self.runOne()) {
+                idle = 0;
+                continue;
+            }
+
+            idle += 1;
+            if (idle < idle_spins) {
+                std.atomic.spinLoopHint();
+                continue;
+            }
+
+            // Registered as sleeping before the last look, so a submit either sees us or we see its job
+            self.sleep_mutex.lock();
+            _ = self.sleeping.fetchAdd(1, .seq_cst);
+            if (self.queued.load(.seq_cst) == 0 and self.running.load(.acquire)) self.wake.wait(&self.sleep_mutex);
+            _ = self.sleeping.fetchSub(1, .seq_cst);
+            self.sleep_mutex.unlock();
+            idle = 0;
+        }
+    }
+};
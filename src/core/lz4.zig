@@ -0,0 +1,499 @@
+// core/lz4.zig - LZ4 blocks and block streams, decoded in parallel on the job system
+const std = @import("std");
+const jobs = @import("jobs.zig");
+const JobSystem = jobs.JobSystem;
+const Counter = jobs.Counter;
+
+
+pub const Lz4Error = error{
+    /// A block that doesn't decode to exactly its raw size, or reads outside itself
+    CorruptBlock,
+    /// Wrong magic or version, or a block index that doesn't add up
+    InvalidStream,
+};
+
+
+/// Bytes of source each stream block holds, the last block may be shorter
+pub const default_block_size = 256 * 1024;
+
+/// Compressed bytes StreamReader reads at once, the next window is read while one decodes
+pub const default_window_size = 4 * 1024 * 1024;
+
+// Block format limits: matches are at least 4 bytes, the last match starts 12 bytes before the end
+// and the last 5 bytes are always literals, so a decoder never copies a match past the end
+const min_match = 4;
+const match_limit_margin = 12;
+const last_literals = 5;
+const max_offset = 65535;
+const hash_bits = 13;
+
+
+// ============================================================
+// Public API: Blocks
+// ============================================================
+
+/// Largest compressed size of `size` source bytes, all literals
+pub fn compressBound(size: usize) usize {
+    return size + size / 255 + 16;
+}
+
+
+/// Compress `src` into `dst`, which holds at least compressBound(src.len) bytes, returns the bytes written
+/// Greedy matching through a hash of the last 4 byte sequences, the LZ4 block format without a frame
+pub fn compressBlock(src: []const u8, dst: []u8) usize {
+    std.debug.assert(dst.len >= compressBound(src.len));
+    var table = [_]u32{0} ** (1 << hash_bits);
+
+    var out: usize = 0;
+    var anchor: usize = 0;
+    var i: usize = 1;
+    if (src.len > match_limit_margin) {
+        const match_limit = src.len - match_limit_margin;
+        const end_limit = src.len - last_literals;
+        while (i < match_limit) {
+            const sequence = read32(src, i);
+            const slot = &table[hash(sequence)];
+            const candidate: usize = slot.*;
+            slot.* = @intCast(i);
+
+            if (i - candidate > max_offset or read32(src, candidate) != sequence) {
+                // Step faster through data that keeps missing, incompressible runs cost little
+                i += 1 + ((i - anchor) >> 6);
+                continue;
+            }
+
+            var start = i;
+            var reference = candidate;
+            while (start > anchor and reference > 0 and src[start - 1] == src[reference - 1]) {
+                start -= 1;
+                reference -= 1;
+            }
+            var length: usize = min_match;
+            while (start + length < end_limit and src[reference + length] == src[start + length]) length += 1;
+
+            out = writeSequence(dst, out, src[anchor..start], start - reference, length);
+            i = start + length;
+            anchor = i;
+        }
+    }
+    return writeLastLiterals(dst, out, src[anchor..]);
+}
+
+
+/// Decode one block written by compressBlock, or any LZ4 block, into exactly `dst.len` bytes
+pub fn decompressBlock(src: []const u8, dst: []u8) !void {
+    var in: usize = 0;
+    var out: usize = 0;
+    while (true) {
+        if (in >= src.len) return Lz4Error.CorruptBlock;
+        const token = src[in];
+        in += 1;
+
+        var literal_length: usize = token >> 4;
+        if (literal_length == 15) literal_length += try readLength(src, &in);
+        if (literal_length > src.len - in or literal_length > dst.len - out) return Lz4Error.CorruptBlock;
+        @memcpy(dst[out..][0..literal_length], src[in..][0..literal_length]);
+        in += literal_length;
+        out += literal_length;
+
+        // The last sequence is literals only
+        if (in == src.len) break;
+
+        if (src.len - in < 2) return Lz4Error.CorruptBlock;
+        const offset: usize = std.mem.readInt(u16, src[in..][0..2], .little);
+        in += 2;
+        if (offset == 0 or offset > out) return Lz4Error.CorruptBlock;
+
+        var length: usize = (token & 15) + min_match;
+        if ((token & 15) == 15) length += try readLength(src, &in);
+        if (length > dst.len - out) return Lz4Error.CorruptBlock;
+        copyMatch(dst, out, offset, length);
+        out += length;
+    }
+    if (out != dst.len) return Lz4Error.CorruptBlock;
+}
+
+
+// ============================================================
+// Public API: Streams
+// ============================================================
+
+/// Stream layout: this header, one BlockEntry per block, then the blocks back to back
+/// Blocks are compressed on their own, so any subset decodes in parallel straight into its place
+pub const StreamHeader = extern struct {
+    pub const magic = [4]u8{ 'Z', 'L', 'Z', '4' };
+    pub const version = 1;
+
+    magic: [4]u8 = magic,
+    version: u32 = version,
+    block_size: u32,
+    block_count: u32,
+    raw_size: u64,
+};
+
+
+pub const BlockEntry = extern struct {
+    /// From the end of the block index
+    offset: u64,
+    /// Equal to raw_size for a block stored as is, one that didn't compress
+    compressed_size: u32,
+    raw_size: u32,
+};
+
+
+/// True when `bytes` start like a stream, e.g. to read both compressed and plain files
+pub fn isStream(bytes: []const u8) bool {
+    return bytes.len >= StreamHeader.magic.len and std.mem.eql(u8, bytes[0..StreamHeader.magic.len], &StreamHeader.magic);
+}
+
+
+/// Compress `bytes` into a stream of independent blocks, on `job_system` when given
+/// The caller owns the returned bytes
+pub fn compressStream(allocator: std.mem.Allocator, bytes: []const u8, job_system: ?*JobSystem) ![]u8 {
+    const block_count = std.math.divCeil(usize, bytes.len, default_block_size) catch unreachable;
+    const data_offset = @sizeOf(StreamHeader) + block_count * @sizeOf(BlockEntry);
+    const slot_size = compressBound(default_block_size);
+
+    // Every block compresses into a slot of its own, then the slots are packed front to back
+    const buffer = try allocator.alloc(u8, data_offset + block_count * slot_size);
+    errdefer allocator.free(buffer);
+    const entries = try allocator.alloc(BlockEntry, block_count);
+    defer allocator.free(entries);
+
+    const context = CompressContext{ .source = bytes, .slots = buffer[data_offset..], .slot_size = slot_size, .entries = entries };
+    if (job_system) |system| {
+        system.parallelFor(block_count, 1, &context, CompressContext.run);
+    } else {
+        context.run(0, block_count);
+    }
+
+    var end: usize = 0;
+    for (entries, 0..) |*entry, i| {
+        const slot = buffer[data_offset + i * slot_size ..][0..entry.compressed_size];
+        std.mem.copyForwards(u8, buffer[data_offset + end ..][0..slot.len], slot);
+        entry.offset = end;
+        end += slot.len;
+    }
+
+    const header = StreamHeader{
+        .block_size = default_block_size,
+        .block_count = @intCast(block_count),
+        .raw_size = bytes.len,
+    };
+    @memcpy(buffer[0..@sizeOf(StreamHeader)], std.mem.asBytes(&header));
+    @memcpy(buffer[@sizeOf(StreamHeader)..data_offset], std.mem.sliceAsBytes(entries));
+    return allocator.realloc(buffer, data_offset + end);
+}
+
+
+/// Bytes `stream` decodes to, for sizing the destination of decompressStream
+pub fn streamRawSize(stream: []const u8) !u64 {
+    return (try parseStream(stream)).header.raw_size;
+}
+
+
+/// Decode a whole stream held in memory, e.g. a slice of a mapped file, into `dest` of its raw size
+/// Blocks decode on `job_system` when given, `dest` may be mapped GPU memory
+pub fn decompressStream(stream: []const u8, dest: []u8, job_system: ?*JobSystem) !void {
+    const parsed = try parseStream(stream);
+    if (dest.len != parsed.header.raw_size) return Lz4Error.InvalidStream;
+
+    var context = DecodeContext{ .blocks = parsed.blocks, .data = parsed.data, .dest = dest, .block_size = parsed.header.block_size };
+    if (job_system) |system| {
+        system.parallelFor(parsed.blocks.len, 1, &context, DecodeContext.run);
+    } else {
+        context.run(0, parsed.blocks.len);
+    }
+    if (context.failed.load(.acquire)) return Lz4Error.CorruptBlock;
+}
+
+
+/// Reads a stream from a file window by window, decoding one window's blocks on the job system while
+/// the next window is read, so a load takes about as long as the slower of the disk and the decode
+pub const StreamReader = struct {
+    const Self = @This();
+
+    allocator: std.mem.Allocator,
+    file: std.fs.File,
+    header: StreamHeader,
+    blocks: []BlockEntry,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Read the header and block index at the current position of `file`, which must stay open
+    pub fn open(allocator: std.mem.Allocator, file: std.fs.File) !Self {
+        var header: StreamHeader = undefined;
+        try readExact(file, std.mem.asBytes(&header));
+        try checkHeader(header);
+
+        const blocks = try allocator.alloc(BlockEntry, header.block_count);
+        errdefer allocator.free(blocks);
+        try readExact(file, std.mem.sliceAsBytes(blocks));
+        _ = try checkBlocks(header, blocks);
+
+        return .{ .allocator = allocator, .file = file, .header = header, .blocks = blocks };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Read the blocks and decode them into `dest` of header.raw_size bytes, in parallel on `job_system`
+    /// when given. `dest` is written only by the decode jobs, so it may be a mapped staging buffer
+    pub fn readInto(self: *Self, dest: []u8, job_system: ?*JobSystem, window_size: usize) !void {
+        if (dest.len != self.header.raw_size) return Lz4Error.InvalidStream;
+        if (self.blocks.len == 0) return;
+
+        var largest: usize = 0;
+        for (self.blocks) |block| largest = @max(largest, block.compressed_size);
+        const capacity = @max(window_size, largest);
+        const front = try self.allocator.alloc(u8, capacity);
+        defer self.allocator.free(front);
+        const back = try self.allocator.alloc(u8, capacity);
+        defer self.allocator.free(back);
+        const windows = [2][]u8{ front, back };
+
+        var counters = [2]Counter{ .{}, .{} };
+        var failed = std.atomic.Value(bool).init(false);
+        // Decode jobs hold pointers into the windows, none may outlive this call
+        defer if (job_system) |system| {
+            for (&counters) |*counter| system.wait(counter);
+        };
+
+        var first: usize = 0;
+        var last = try self.readWindow(windows[0], first);
+        var turn: usize = 0;
+        while (first < self.blocks.len) : (turn ^= 1) {
+            const window = windows[turn];
+            const base = self.blocks[first].offset;
+            for (self.blocks[first..last], first..) |block, index| {
+                const args = .{ window[block.offset - base ..][0..block.compressed_size], self.blockDest(dest, index), &failed };
+                if (job_system) |system| {
+                    system.spawn(&counters[turn], decodeBlock, args) catch @call(.auto, decodeBlock, args);
+                } else {
+                    @call(.auto, decodeBlock, args);
+                }
+            }
+
+            // The other window is free once its blocks decoded, read the next one into it meanwhile
+            if (job_system) |system| system.wait(&counters[turn ^ 1]);
+            if (failed.load(.acquire)) return Lz4Error.CorruptBlock;
+            first = last;
+            if (first < self.blocks.len) last = try self.readWindow(windows[turn ^ 1], first);
+        }
+
+        if (job_system) |system| {
+            for (&counters) |*counter| system.wait(counter);
+        }
+        if (failed.load(.acquire)) return Lz4Error.CorruptBlock;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.allocator.free(self.blocks);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Read the blocks from `first` that fit in `window`, returns the end of the range read
+    fn readWindow(self: *Self, window: []u8, first: usize) !usize {
+        const base = self.blocks[first].offset;
+        var last = first + 1;
+        while (last < self.blocks.len and self.blocks[last].offset + self.blocks[last].compressed_size - base <= window.len) last += 1;
+
+        const end = self.blocks[last - 1].offset + self.blocks[last - 1].compressed_size;
+        try readExact(self.file, window[0 .. end - base]);
+        return last;
+    }
+
+
+    fn blockDest(self: *const Self, dest: []u8, index: usize) []u8 {
+        return dest[index * @as(usize, self.header.block_size)..][0..self.blocks[index].raw_size];
+    }
+};
+
+
+// ============================================================
+// Private: Helper Functions
+// ============================================================
+
+const ParsedStream = struct {
+    header: StreamHeader,
+    blocks: []align(1) const BlockEntry,
+    data: []const u8,
+};
+
+
+const CompressContext = struct {
+    source: []const u8,
+    slots: []u8,
+    slot_size: usize,
+    entries: []BlockEntry,
+
+    fn run(self: *const CompressContext, start: usize, end: usize) void {
+        for (start..end) |i| {
+            const raw = self.source[i * default_block_size ..][0..@min(default_block_size, self.source.len - i * default_block_size)];
+            const slot = self.slots[i * self.slot_size ..][0..self.slot_size];
+            var size = compressBlock(raw, slot);
+            // A block that didn't shrink is stored, the decoder copies it
+            if (size >= raw.len) {
+                @memcpy(slot[0..raw.len], raw);
+                size = raw.len;
+            }
+            self.entries[i] = .{ .offset = 0, .compressed_size = @intCast(size), .raw_size = @intCast(raw.len) };
+        }
+    }
+};
+
+
+const DecodeContext = struct {
+    blocks: []align(1) const BlockEntry,
+    data: []const u8,
+    dest: []u8,
+    block_size: usize,
+    failed: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+
+    fn run(self: *DecodeContext, start: usize, end: usize) void {
+        for (self.blocks[start..end], start..) |block, i| {
+            decodeBlock(self.data[block.offset..][0..block.compressed_size], self.dest[i * self.block_size ..][0..block.raw_size], &self.failed);
+        }
+    }
+};
+
+
+fn decodeBlock(src: []const u8, dst: []u8, failed: *std.atomic.Value(bool)) void {
+    if (src.len == dst.len) {
+        @memcpy(dst, src);
+    } else {
+        decompressBlock(src, dst) catch failed.store(true, .release);
+    }
+}
+
+
+fn parseStream(stream: []const u8) !ParsedStream {
+    if (stream.len < @sizeOf(StreamHeader)) return Lz4Error.InvalidStream;
+    const header = std.mem.bytesToValue(StreamHeader, stream[0..@sizeOf(StreamHeader)]);
+    try checkHeader(header);
+
+    const data_offset = @sizeOf(StreamHeader) + @as(usize, header.block_count) * @sizeOf(BlockEntry);
+    if (data_offset > stream.len) return Lz4Error.InvalidStream;
+    const blocks = std.mem.bytesAsSlice(BlockEntry, stream[@sizeOf(StreamHeader)..data_offset]);
+    const data_size = try checkBlocks(header, blocks);
+    if (data_offset + data_size > stream.len) return Lz4Error.InvalidStream;
+
+    return .{ .header = header, .blocks = blocks, .data = stream[data_offset..][0..data_size] };
+}
+
+
+/// Magic, version and a block count that matches the raw size, checked before the index is read
+fn checkHeader(header: StreamHeader) !void {
+    if (!std.mem.eql(u8, &header.magic, &StreamHeader.magic) or header.version != StreamHeader.version) {
+        return Lz4Error.InvalidStream;
+    }
+    if (header.block_size == 0) return Lz4Error.InvalidStream;
+    if (std.math.divCeil(u64, header.raw_size, header.block_size) catch unreachable != header.block_count) {
+        return Lz4Error.InvalidStream;
+    }
+}
+
+
+/// Check the index covers the raw size in order with packed blocks, returns the bytes of block data
+fn checkBlocks(header: StreamHeader, blocks: anytype) !u64 {
+    var offset: u64 = 0;
+    for (blocks, 0..) |block, i| {
+        const raw_size: u64 = @min(header.block_size, header.raw_size - i * header.block_size);
+        if (block.offset != offset or block.raw_size != raw_size or block.compressed_size > compressBound(@intCast(raw_size))) {
+            return Lz4Error.InvalidStream;
+        }
+        offset += block.compressed_size;
+    }
+    return offset;
+}
+
+
+fn readExact(file: std.fs.File, buffer: []u8) !void {
+    if (try file.readAll(buffer) != buffer.len) return Lz4Error.InvalidStream;
+}
+
+
+inline fn read32(bytes: []const u8, index: usize) u32 {
+    return std.mem.readInt(u32, bytes[index..][0..4], .little);
+}
+
+
+inline fn hash(sequence: u32) usize {
+    return (sequence *% 2654435761) >> (32 - hash_bits);
+}
+
+
+/// Length continuation bytes, 255 means another byte follows
+fn readLength(src: []const u8, in: *usize) !usize {
+    var length: usize = 0;
+    while (true) {
+        if (in.* >= src.len) return Lz4Error.CorruptBlock;
+        const byte = src[in.*];
+        in.* += 1;
+        length += byte;
+        if (byte != 255) return length;
+    }
+}
+
+
+fn writeLength(dst: []u8, start: usize, length: usize) usize {
+    var out = start;
+    var rest = length;
+    while (rest >= 255) : (rest -= 255) {
+        dst[out] = 255;
+        out += 1;
+    }
+    dst[out] = @intCast(rest);
+    return out + 1;
+}
+
+
+fn writeLiterals(dst: []u8, start: usize, token: u8, literals: []const u8) usize {
+    dst[start] = token | @as(u8, @intCast(@min(literals.len, 15))) << 4;
+    var out = start + 1;
+    if (literals.len >= 15) out = writeLength(dst, out, literals.len - 15);
+    @memcpy(dst[out..][0..literals.len], literals);
+    return out + literals.len;
+}
+
+
+fn writeSequence(dst: []u8, start: usize, literals: []const u8, offset: usize, length: usize) usize {
+    const extra = length - min_match;
+    var out = writeLiterals(dst, start, @intCast(@min(extra, 15)), literals);
+    std.mem.writeInt(u16, dst[out..][0..2], @intCast(offset), .little);
+    out += 2;
+    if (extra >= 15) out = writeLength(dst, out, extra - 15);
+    return out;
+}
+
+
+fn writeLastLiterals(dst: []u8, start: usize, literals: []const u8) usize {
+    return writeLiterals(dst, start, 0, literals);
+}
+
+
+/// Copy a match that may overlap what it writes, in pieces no longer than the offset
+fn copyMatch(dst: []u8, out: usize, offset: usize, length: usize) void {
+    if (offset == 1) return @memset(dst[out..][0..length], dst[out - 1]);
+    var copied: usize = 0;
+    while (copied < length) {
+        const n = @min(offset, length - copied);
+        const at = out + copied;
+        @memcpy(dst[at..][0..n], dst[at - offset ..][0..n]);
+        copied += n;
+    }
+}
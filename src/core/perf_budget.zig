@@ -0,0 +1,221 @@
+// core/perf_budget.zig - soft time budgets checked against rolling averages, for systems, queries and frames
+const std = @import("std");
+const monotonicNs = @import("time.zig").monotonicNs;
+
+
+/// What endFrame does about a budget whose average is over
+pub const BudgetAction = enum {
+    /// Log a warning, every warn_interval frames while it stays over
+    warn,
+    /// Also count the frame as failed, for benchmarks and soak tests that should exit non-zero
+    fail,
+};
+
+
+pub const PerfBudgetConfig = struct {
+    /// Samples the rolling average spans, it is an exponential average weighting each new sample 1/window
+    window: u32 = 120,
+    /// Samples a budget needs before it is judged, so loading hitches on the first frames don't count
+    warmup: u32 = 60,
+    /// Frames between two warnings about the same budget
+    warn_interval: u32 = 600,
+    action: BudgetAction = .warn,
+};
+
+
+/// One declared budget and the rolling statistics of what it measures
+pub const Budget = struct {
+    name: []const u8,
+    budget_ns: u64,
+    /// Rolling average of the samples in nanoseconds
+    average_ns: f64 = 0.0,
+    peak_ns: u64 = 0,
+    samples: u64 = 0,
+    /// Frames ended with the average over budget
+    over_frames: u64 = 0,
+    /// Samples at the last endFrame, a budget without new ones isn't judged again
+    judged_samples: u64 = 0,
+    /// Frame of the last warning, null before the first
+    warned_frame: ?u64 = null,
+
+
+    pub fn isOver(self: *const Budget, config: PerfBudgetConfig) bool {
+        return self.samples >= config.warmup and self.average_ns > @as(f64, @floatFromInt(self.budget_ns));
+    }
+};
+
+
+/// A running measurement for one budget, close it with end, usually `defer scope.end()`
+pub const BudgetScope = struct {
+    budgets: *PerfBudgets,
+    budget: *Budget,
+    start_ns: u64,
+
+    pub fn end(self: BudgetScope) void {
+        self.budgets.record(self.budget, monotonicNs() - self.start_ns);
+    }
+};
+
+
+/// Soft time budgets by name, for the scheduler's systems, named queries or whole frames
+/// Samples come in through record or a scope from any thread. endFrame, once per frame, compares each
+/// rolling average against its budget and warns or fails, so a regression surfaces without anyone
+/// reading traces. Budgets live until deinit, the pointers declare returns stay valid
+pub const PerfBudgets = struct {
+    const Self = @This();
+
+    allocator: std.mem.Allocator,
+    config: PerfBudgetConfig,
+    /// Guards the budgets, samples of parallel systems arrive at the same time
+    mutex: std.Thread.Mutex = .{},
+    budgets: std.ArrayList(*Budget),
+    /// Frames ended so far
+    frame: u64 = 0,
+    /// Frames that ended with a budget over in fail mode
+    failed_frames: u64 = 0,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, config: PerfBudgetConfig) Self {
+        return .{
+            .allocator = allocator,
+            .config = config,
+            .budgets = std.ArrayList(*Budget).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// The budget `name`, created on the first call, a later call with another limit replaces it
+    /// `name` must outlive the budgets
+    pub fn declare(self: *Self, name: []const u8, budget_ns: u64) !*Budget {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        if (self.findLocked(name)) |budget| {
+            budget.budget_ns = budget_ns;
+            return budget;
+        }
+        const budget = try self.allocator.create(Budget);
+        errdefer self.allocator.destroy(budget);
+        budget.* = .{ .name = name, .budget_ns = budget_ns };
+        try self.budgets.append(budget);
+        return budget;
+    }
+
+
+    pub fn find(self: *Self, name: []const u8) ?*Budget {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        return self.findLocked(name);
+    }
+
+
+    /// Add one sample, e.g. a system's run time or a frame time
+    pub fn record(self: *Self, budget: *Budget, elapsed_ns: u64) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const sample: f64 = @floatFromInt(elapsed_ns);
+        if (budget.samples == 0) {
+            budget.average_ns = sample;
+        } else {
+            budget.average_ns += (sample - budget.average_ns) / @as(f64, @floatFromInt(@max(self.config.window, 1)));
+        }
+        budget.peak_ns = @max(budget.peak_ns, elapsed_ns);
+        budget.samples += 1;
+    }
+
+
+    /// Time a scope against `budget`, e.g. the loop over a named query
+    pub fn begin(self: *Self, budget: *Budget) BudgetScope {
+        return .{ .budgets = self, .budget = budget, .start_ns = monotonicNs() };
+    }
+
+
+    /// Judge every budget that got samples this frame, once they are all in
+    pub fn endFrame(self: *Self) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        var any_over = false;
+        for (self.budgets.items) |budget| {
+            if (budget.samples == budget.judged_samples) continue;
+            budget.judged_samples = budget.samples;
+            if (!budget.isOver(self.config)) continue;
+            any_over = true;
+            budget.over_frames += 1;
+
+            if (budget.warned_frame) |frame| {
+                if (self.frame - frame < self.config.warn_interval) continue;
+            }
+            budget.warned_frame = self.frame;
+            std.log.warn("PerfBudgets: {s} averages {d:.3} ms, over its budget of {d:.3} ms (peak {d:.3} ms)", .{
+                budget.name,
+                budget.average_ns / std.time.ns_per_ms,
+                nsToMs(budget.budget_ns),
+                nsToMs(budget.peak_ns),
+            });
+        }
+        if (any_over and self.config.action == .fail) self.failed_frames += 1;
+        self.frame += 1;
+    }
+
+
+    /// True once any frame ended over budget in fail mode
+    pub fn failed(self: *const Self) bool {
+        return self.failed_frames > 0;
+    }
+
+
+    /// One line per budget: average, peak and limit, and how many frames it was over
+    pub fn writeReport(self: *Self, writer: anytype) !void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        try writer.print("budgets after {d} frames\n", .{self.frame});
+        for (self.budgets.items) |budget| {
+            try writer.print("  {s:<24} avg {d:>8.3} ms  peak {d:>8.3} ms  budget {d:>8.3} ms  over {d} frames{s}\n", .{
+                budget.name,
+                budget.average_ns / std.time.ns_per_ms,
+                nsToMs(budget.peak_ns),
+                nsToMs(budget.budget_ns),
+                budget.over_frames,
+                if (budget.isOver(self.config)) "  OVER" else "",
+            });
+        }
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        for (self.budgets.items) |budget| self.allocator.destroy(budget);
+        self.budgets.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn findLocked(self: *const Self, name: []const u8) ?*Budget {
+        for (self.budgets.items) |budget| {
+            if (std.mem.eql(u8, budget.name, name)) return budget;
+        }
+        return null;
+    }
+
+
+    fn nsToMs(ns: u64) f64 {
+        return @as(f64, @floatFromInt(ns)) / std.time.ns_per_ms;
+    }
+};
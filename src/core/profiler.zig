@@ -0,0 +1,302 @@
+// profiler.zig - CPU frame profiling with scoped zones
+const std = @import("std");
+const build_options = @import("build_options");
+const monotonicNs = @import("time.zig").monotonicNs;
+
+
+/// How much is recorded, picked with `-Dprofiler`
+pub const ProfilerMode = enum {
+    /// Every zone compiles to nothing
+    off,
+    /// Engine and user zones, a handful per system per frame
+    on,
+    /// Also zones of per-entity hot paths like Query.next, expect tens of nanoseconds per zone
+    detailed,
+};
+
+
+pub const mode: ProfilerMode = switch (build_options.profiler) {
+    .off => .off,
+    .on => .on,
+    .detailed => .detailed,
+};
+
+pub const enabled = mode != .off;
+
+
+/// Events each thread keeps, older ones are overwritten once the ring is full
+pub const events_per_thread = 1 << 16;
+
+/// Frame marks are told apart from other instants by this pointer
+const frame_mark_name: [*:0]const u8 = "Frame";
+
+
+/// One finished zone, or a frame mark when start == end
+const Event = struct {
+    name: [*:0]const u8,
+    start_ns: u64,
+    end_ns: u64,
+};
+
+
+/// Events of one thread, written lock free by that thread only
+/// Exports read behind `written` and drop whatever the thread overwrote while they copied
+const ThreadBuffer = struct {
+    events: [events_per_thread]Event,
+    /// Events ever recorded, the next one goes to written % events_per_thread
+    written: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+    thread_id: u32,
+    name: ?[]const u8 = null,
+    next: ?*ThreadBuffer = null,
+
+    fn record(self: *ThreadBuffer, event: Event) void {
+        const index = self.written.load(.monotonic);
+        self.events[index % events_per_thread] = event;
+        self.written.store(index + 1, .release);
+    }
+};
+
+
+/// Registered buffers, only touched when a thread records its first event and by exports
+var registry_mutex: std.Thread.Mutex = .{};
+var buffers: ?*ThreadBuffer = null;
+var next_thread_id: u32 = 0;
+/// Exported timestamps are relative to it, set when the first thread registers
+var epoch_ns: u64 = 0;
+
+threadlocal var thread_buffer: ?*ThreadBuffer = null;
+/// Track of GPU scopes, written by the thread owning the GL context
+var gpu_buffer: ?*ThreadBuffer = null;
+
+
+/// A running zone, close it with end, usually `defer zone.end()` right after opening it
+pub const Zone = if (enabled) struct {
+    name: [*:0]const u8,
+    start_ns: u64,
+
+    pub inline fn end(self: Zone) void {
+        const buffer = currentBuffer() orelse return;
+        buffer.record(.{ .name = self.name, .start_ns = self.start_ns, .end_ns = now() });
+    }
+} else NoZone;
+
+
+/// Zone of detailZone, nothing unless in detailed mode
+pub const DetailZone = if (mode == .detailed) Zone else NoZone;
+
+
+const NoZone = struct {
+    pub inline fn end(_: NoZone) void {}
+};
+
+
+// ============================================================
+// Public API: Operational Functions
+// ============================================================
+
+/// Open a zone named `name`, it shows up as one slice on the recording thread's track
+pub inline fn zone(comptime name: [:0]const u8) Zone {
+    if (!enabled) return .{};
+    return .{ .name = name.ptr, .start_ns = now() };
+}
+
+
+/// Zone for per-entity hot paths, only recorded in detailed mode
+pub inline fn detailZone(comptime name: [:0]const u8) DetailZone {
+    if (mode != .detailed) return .{};
+    return zone(name);
+}
+
+
+/// Mark the end of a frame, drawn as an instant event on the calling thread's track
+pub inline fn frameMark() void {
+    if (!enabled) return;
+    const buffer = currentBuffer() orelse return;
+    const timestamp = now();
+    buffer.record(.{ .name = frame_mark_name, .start_ns = timestamp, .end_ns = timestamp });
+}
+
+
+/// Add a finished GPU scope to the GPU track, timestamps on the CPU clock in nanoseconds
+/// GpuTimer calls this from the GL thread when a frame's queries are read back
+pub fn recordGpuZone(name: [*:0]const u8, start_ns: u64, end_ns: u64) void {
+    if (!enabled) return;
+    if (gpu_buffer == null) {
+        gpu_buffer = registerBuffer() orelse return;
+        gpu_buffer.?.name = "GPU";
+    }
+    gpu_buffer.?.record(.{ .name = name, .start_ns = start_ns, .end_ns = @max(end_ns, start_ns + 1) });
+}
+
+
+/// Name the calling thread's track, `name` must outlive the profiler
+pub fn setThreadName(name: []const u8) void {
+    if (!enabled) return;
+    const buffer = currentBuffer() orelse return;
+    buffer.name = name;
+}
+
+
+/// Write every recorded event in Chrome trace_event JSON, loadable in Perfetto, chrome://tracing
+/// and Tracy's import-chrome converter. Safe while other threads keep recording
+pub fn writeChromeTrace(allocator: std.mem.Allocator, writer: anytype) !void {
+    return writeEventsSince(allocator, writer, 0);
+}
+
+
+/// writeChromeTrace of only the last `frames` frames, counted by the frame marks of the calling thread
+/// Events of every thread ending after the mark that precedes those frames are written, everything when
+/// the calling thread holds fewer marks
+pub fn writeRecentFrames(allocator: std.mem.Allocator, writer: anytype, frames: u32) !void {
+    if (!enabled) return writeEventsSince(allocator, writer, 0);
+
+    const snapshot = try allocator.alloc(Event, events_per_thread);
+    defer allocator.free(snapshot);
+    var since_ns: u64 = 0;
+    if (thread_buffer) |buffer| {
+        var marks: u32 = 0;
+        const events = copyEvents(buffer, snapshot);
+        var i = events.len;
+        while (i > 0 and marks <= frames) {
+            i -= 1;
+            if (events[i].name != frame_mark_name) continue;
+            marks += 1;
+            since_ns = events[i].start_ns;
+        }
+        // Fewer marks than frames were asked for, the ring holds less than that
+        if (marks <= frames) since_ns = 0;
+    }
+    return writeEventsSince(allocator, writer, since_ns);
+}
+
+
+/// writeChromeTrace into the file at `path`
+pub fn saveChromeTrace(allocator: std.mem.Allocator, path: []const u8) !void {
+    const file = try std.fs.cwd().createFile(path, .{});
+    defer file.close();
+    var buffered = std.io.bufferedWriter(file.writer());
+    try writeChromeTrace(allocator, buffered.writer());
+    try buffered.flush();
+}
+
+
+/// writeRecentFrames into the file at `path`
+pub fn saveRecentFrames(allocator: std.mem.Allocator, path: []const u8, frames: u32) !void {
+    const file = try std.fs.cwd().createFile(path, .{});
+    defer file.close();
+    var buffered = std.io.bufferedWriter(file.writer());
+    try writeRecentFrames(allocator, buffered.writer(), frames);
+    try buffered.flush();
+}
+
+
+// ============================================================
+// Public API: Destruction Function
+// ============================================================
+
+/// Free every thread's events, no thread may record during or after this
+pub fn deinit() void {
+    if (!enabled) return;
+    registry_mutex.lock();
+    defer registry_mutex.unlock();
+
+    while (buffers) |buffer| {
+        buffers = buffer.next;
+        std.heap.page_allocator.destroy(buffer);
+    }
+    thread_buffer = null;
+    gpu_buffer = null;
+}
+
+
+// ============================================================
+// Private: Helper Functions
+// ============================================================
+
+/// Chrome trace of the events ending at or after `since_ns`
+fn writeEventsSince(allocator: std.mem.Allocator, writer: anytype, since_ns: u64) !void {
+    try writer.writeAll("{\"traceEvents\":[\n");
+    if (!enabled) return writer.writeAll("]}\n");
+
+    const snapshot = try allocator.alloc(Event, events_per_thread);
+    defer allocator.free(snapshot);
+
+    registry_mutex.lock();
+    defer registry_mutex.unlock();
+
+    var first = true;
+    var iter = buffers;
+    while (iter) |buffer| : (iter = buffer.next) {
+        if (buffer.name) |name| {
+            try writeSeparator(writer, &first);
+            try writer.print("{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{d},\"args\":{{\"name\":", .{buffer.thread_id});
+            try std.json.stringify(name, .{}, writer);
+            try writer.writeAll("}}");
+        }
+
+        for (copyEvents(buffer, snapshot)) |event| {
+            if (event.end_ns < since_ns) continue;
+            try writeSeparator(writer, &first);
+            try writer.writeAll("{\"name\":");
+            try std.json.stringify(std.mem.span(event.name), .{}, writer);
+            if (event.start_ns == event.end_ns) {
+                try writer.print(",\"ph\":\"i\",\"s\":\"t\",\"ts\":{d:.3},\"pid\":0,\"tid\":{d}}}", .{ micros(event.start_ns -| epoch_ns), buffer.thread_id });
+            } else {
+                try writer.print(",\"ph\":\"X\",\"ts\":{d:.3},\"dur\":{d:.3},\"pid\":0,\"tid\":{d}}}", .{ micros(event.start_ns -| epoch_ns), micros(event.end_ns -| event.start_ns), buffer.thread_id });
+            }
+        }
+    }
+    try writer.writeAll("\n]}\n");
+}
+
+
+/// Same clock as Time's System source, so zones line up with frame times
+fn now() u64 {
+    return monotonicNs();
+}
+
+
+fn micros(ns: u64) f64 {
+    return @as(f64, @floatFromInt(ns)) / std.time.ns_per_us;
+}
+
+
+/// The calling thread's buffer, registered on first use, null if it couldn't be allocated
+fn currentBuffer() ?*ThreadBuffer {
+    if (thread_buffer) |buffer| return buffer;
+    thread_buffer = registerBuffer();
+    return thread_buffer;
+}
+
+
+/// New empty buffer in the export list
+fn registerBuffer() ?*ThreadBuffer {
+    const buffer = std.heap.page_allocator.create(ThreadBuffer) catch return null;
+    registry_mutex.lock();
+    defer registry_mutex.unlock();
+
+    if (buffers == null) epoch_ns = now();
+    buffer.* = .{ .events = undefined, .thread_id = next_thread_id, .next = buffers };
+    next_thread_id += 1;
+    buffers = buffer;
+    return buffer;
+}
+
+
+/// Copy the events of `buffer` oldest first, without the ones overwritten during the copy
+fn copyEvents(buffer: *ThreadBuffer, snapshot: []Event) []const Event {
+    const end = buffer.written.load(.acquire);
+    const start = end -| events_per_thread;
+    for (start..end, 0..) |index, i| snapshot[i] = buffer.events[index % events_per_thread];
+
+    // Slots the writer reached during the copy may be torn, including the one it is writing now
+    const after = buffer.written.load(.acquire);
+    const valid_start = @min(@max(start, (after + 1) -| events_per_thread), end);
+    return snapshot[valid_start - start .. end - start];
+}
+
+
+fn writeSeparator(writer: anytype, first: *bool) !void {
+    if (!first.*) try writer.writeAll(",\n");
+    first.* = false;
+}
@@ -0,0 +1,51 @@
+// core/spsc_queue.zig - bounded lock-free queue between exactly one producer and one consumer thread
+const std = @import("std");
+
+
+/// A ring of `capacity` values, push on one thread and pop on one other, neither ever blocks or allocates
+/// Meant for threads that must not wait on a lock, such as the audio mix thread. Head and tail sit on
+/// cache lines of their own so the two sides don't invalidate each other's line on every operation
+pub fn SpscQueue(comptime T: type, comptime capacity: usize) type {
+    comptime std.debug.assert(std.math.isPowerOfTwo(capacity));
+
+    return struct {
+        const Self = @This();
+        const mask = capacity - 1;
+
+        /// Next slot to pop, written by the consumer only
+        head: std.atomic.Value(usize) align(std.atomic.cache_line) = std.atomic.Value(usize).init(0),
+        /// Next slot to push, written by the producer only
+        tail: std.atomic.Value(usize) align(std.atomic.cache_line) = std.atomic.Value(usize).init(0),
+        items: [capacity]T align(std.atomic.cache_line) = undefined,
+
+
+        // ============================================================
+        // Public API: Operational Functions
+        // ============================================================
+
+        /// Producer only, false when the queue is full
+        pub fn push(self: *Self, value: T) bool {
+            const tail = self.tail.load(.monotonic);
+            if (tail -% self.head.load(.acquire) >= capacity) return false;
+            self.items[tail & mask] = value;
+            self.tail.store(tail +% 1, .release);
+            return true;
+        }
+
+
+        /// Consumer only, null when the queue is empty
+        pub fn pop(self: *Self) ?T {
+            const head = self.head.load(.monotonic);
+            if (head == self.tail.load(.acquire)) return null;
+            const value = self.items[head & mask];
+            self.head.store(head +% 1, .release);
+            return value;
+        }
+
+
+        /// Values queued, only a hint unless called from one of the two sides while the other is idle
+        pub fn count(self: *const Self) usize {
+            return self.tail.load(.acquire) -% self.head.load(.acquire);
+        }
+    };
+}
@@ -0,0 +1,262 @@
+// core/telemetry.zig - engine metrics streamed as UDP datagrams for external viewers
+// Imports nothing of the engine, so tools/telemetry_view.zig builds against this file alone
+const std = @import("std");
+const builtin = @import("builtin");
+
+
+pub const TelemetryError = error{
+    /// start was called on a running endpoint
+    AlreadyRunning,
+};
+
+
+/// Where and how often samples are sent
+pub const TelemetryConfig = struct {
+    /// Datagrams go to this IPv4 or IPv6 address, where a viewer listens
+    address: []const u8 = "127.0.0.1",
+    port: u16 = default_port,
+    /// Milliseconds between datagrams, frames published in between are skipped
+    interval_ms: u32 = 250,
+};
+
+pub const default_port = 47800;
+
+
+/// One datagram, the struct's bytes as they are in memory, little endian
+/// Viewers check magic and version and read `size` bytes, fields are only ever appended
+pub const TelemetrySample = extern struct {
+    pub const magic_value = [4]u8{ 'Z', 'T', 'E', 'L' };
+    pub const current_version = 2;
+
+    magic: [4]u8 = magic_value,
+    version: u16 = current_version,
+    size: u16 = @sizeOf(TelemetrySample),
+
+    /// Numbered by publish, gaps are frames the sender skipped
+    frame: u64 = 0,
+    /// Nanoseconds since the first publish, on a monotonic clock
+    timestamp_ns: u64 = 0,
+
+    // Frame times of Time's ring, in nanoseconds
+    frame_mean_ns: u64 = 0,
+    frame_p50_ns: u64 = 0,
+    frame_p95_ns: u64 = 0,
+    frame_p99_ns: u64 = 0,
+    frame_max_ns: u64 = 0,
+
+    // Renderer counters of the last frame
+    instances: u64 = 0,
+    triangles: u64 = 0,
+    upload_bytes: u64 = 0,
+    draw_calls: u32 = 0,
+    program_binds: u32 = 0,
+    vertex_array_binds: u32 = 0,
+    texture_binds: u32 = 0,
+    uniform_uploads: u32 = 0,
+
+    // Registry
+    entities: u32 = 0,
+    components: u64 = 0,
+    storages: u32 = 0,
+    hitches: u32 = 0,
+
+    // ResourceManager
+    gpu_bytes: u64 = 0,
+    cpu_bytes: u64 = 0,
+    texture_bytes: u64 = 0,
+    mesh_bytes: u64 = 0,
+
+    // Input, since version 2
+    input_latency_p50_ns: u64 = 0,
+    input_latency_p99_ns: u64 = 0,
+
+    comptime {
+        // Every u64 sits at a multiple of 8, so there is no padding for the wire format to depend on
+        std.debug.assert(@sizeOf(TelemetrySample) == @offsetOf(TelemetrySample, "input_latency_p99_ns") + 8);
+        std.debug.assert(builtin.cpu.arch.endian() == .little);
+    }
+
+
+    /// Copy the frame time statistics and hitch count of a Time
+    pub fn setTime(self: *TelemetrySample, time: anytype) void {
+        const stats = time.getFrameTimeStats();
+        self.hitches = time.hitch_count;
+        self.frame_mean_ns = stats.mean_ns;
+        self.frame_p50_ns = stats.p50_ns;
+        self.frame_p95_ns = stats.p95_ns;
+        self.frame_p99_ns = stats.p99_ns;
+        self.frame_max_ns = stats.max_ns;
+    }
+
+
+    /// Copy a RenderStats, e.g. Renderer.stats after endFrame
+    pub fn setRenderStats(self: *TelemetrySample, stats: anytype) void {
+        self.draw_calls = stats.draw_calls;
+        self.instances = stats.instances;
+        self.triangles = stats.triangles;
+        self.program_binds = stats.program_binds;
+        self.vertex_array_binds = stats.vertex_array_binds;
+        self.texture_binds = stats.texture_binds;
+        self.uniform_uploads = stats.uniform_uploads;
+        self.upload_bytes = stats.upload_bytes;
+    }
+
+
+    /// Copy an Input.getInputLatencyStats result
+    pub fn setInputLatency(self: *TelemetrySample, stats: anytype) void {
+        self.input_latency_p50_ns = stats.p50_ns;
+        self.input_latency_p99_ns = stats.p99_ns;
+    }
+
+
+    /// Copy a Registry.stats result
+    pub fn setRegistryStats(self: *TelemetrySample, stats: anytype) void {
+        self.entities = stats.entities;
+        self.components = stats.components;
+        self.storages = stats.storages;
+    }
+
+
+    /// Copy a ResourceManager.memoryStats result
+    pub fn setMemoryStats(self: *TelemetrySample, stats: anytype) void {
+        self.gpu_bytes = stats.totalGpuBytes();
+        self.cpu_bytes = stats.totalCpuBytes();
+        self.texture_bytes = stats.textures.gpu_bytes;
+        self.mesh_bytes = stats.meshes.gpu_bytes;
+    }
+
+
+    /// The sample in `bytes`, null unless it is a datagram of this version or a later one
+    pub fn decode(bytes: []const u8) ?TelemetrySample {
+        if (bytes.len < @sizeOf(TelemetrySample)) return null;
+        var sample: TelemetrySample = undefined;
+        @memcpy(std.mem.asBytes(&sample), bytes[0..@sizeOf(TelemetrySample)]);
+        if (!std.mem.eql(u8, &sample.magic, &magic_value) or sample.version < current_version) return null;
+        return sample;
+    }
+};
+
+
+/// Sends the latest published sample to a UDP address at a fixed interval, from a thread of its own
+/// publish only copies the sample into a lock-free triple buffer, the main loop never waits on the network,
+/// the sender or a viewer. Samples nobody receives are lost, there is no connection to keep up
+pub const Telemetry = struct {
+    const Self = @This();
+
+    /// Set in `middle` while it holds a sample the sender hasn't taken
+    const fresh_bit: u8 = 4;
+
+    config: TelemetryConfig = .{},
+    buffers: [3]TelemetrySample = .{ .{}, .{}, .{} },
+    /// Buffer passed between the threads, swapped by both
+    middle: std.atomic.Value(u8) = std.atomic.Value(u8).init(1),
+    /// Written by publish only
+    back: u8 = 0,
+    frame: u64 = 0,
+    /// Set by the first publish
+    epoch: ?std.time.Instant = null,
+    /// Read by the sender only
+    front: u8 = 2,
+
+    running: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+    thread: ?std.Thread = null,
+    socket: ?std.posix.socket_t = null,
+    destination: std.net.Address = undefined,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Open the socket and start the sender, `self` must stay where it is until stop
+    pub fn start(self: *Self, config: TelemetryConfig) !void {
+        if (self.thread != null) return TelemetryError.AlreadyRunning;
+        self.config = config;
+        self.destination = try std.net.Address.parseIp(config.address, config.port);
+
+        const socket = try std.posix.socket(self.destination.any.family, std.posix.SOCK.DGRAM, std.posix.IPPROTO.UDP);
+        errdefer std.posix.close(socket);
+        self.socket = socket;
+        errdefer self.socket = null;
+
+        self.running.store(true, .release);
+        errdefer self.running.store(false, .release);
+        self.thread = try std.Thread.spawn(.{}, run, .{self});
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Hand `sample` to the sender, numbering and stamping it, call from one thread only
+    /// Costs a copy of the sample and one atomic swap
+    pub fn publish(self: *Self, sample: TelemetrySample) void {
+        self.frame += 1;
+        const slot = &self.buffers[self.back];
+        slot.* = sample;
+        slot.frame = self.frame;
+        slot.timestamp_ns = self.elapsedNs();
+        self.back = self.middle.swap(self.back | fresh_bit, .acq_rel) & ~fresh_bit;
+    }
+
+
+    pub fn isRunning(self: *const Self) bool {
+        return self.thread != null;
+    }
+
+
+    /// Running, and the sender took the last published sample, so gathering a new one isn't wasted
+    /// Check it before collecting statistics that cost more than their copy, it is one atomic load
+    pub fn wantsSample(self: *const Self) bool {
+        return self.thread != null and self.middle.load(.monotonic) & fresh_bit == 0;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Stop the sender within one interval and close the socket
+    pub fn stop(self: *Self) void {
+        const thread = self.thread orelse return;
+        self.running.store(false, .release);
+        thread.join();
+        self.thread = null;
+        if (self.socket) |socket| std.posix.close(socket);
+        self.socket = null;
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn run(self: *Self) void {
+        const interval_ns = @as(u64, @max(self.config.interval_ms, 1)) * std.time.ns_per_ms;
+        while (self.running.load(.acquire)) {
+            std.time.sleep(interval_ns);
+            const sample = self.take() orelse continue;
+            // Unreachable viewers are not an error worth stopping for, the next datagram tries again
+            _ = std.posix.sendto(self.socket.?, std.mem.asBytes(sample), 0, &self.destination.any, self.destination.getOsSockLen()) catch {};
+        }
+    }
+
+
+    /// Newest sample published since the last take
+    fn take(self: *Self) ?*const TelemetrySample {
+        if (self.middle.load(.acquire) & fresh_bit == 0) return null;
+        self.front = self.middle.swap(self.front, .acq_rel) & ~fresh_bit;
+        return &self.buffers[self.front];
+    }
+
+
+    fn elapsedNs(self: *Self) u64 {
+        const instant = std.time.Instant.now() catch return 0;
+        const epoch = self.epoch orelse {
+            self.epoch = instant;
+            return 0;
+        };
+        return instant.since(epoch);
+    }
+};
@@ -1,6 +1,8 @@
 // time.zig - Time management module
 const std = @import("std");
+const builtin = @import("builtin");
 const c = @import("../bindings/c.zig");
+const profiler = @import("profiler.zig");
 
 
 /// Error type for time operations
@@ -26,6 +28,27 @@ pub const TimeConfig = struct {
 
     /// Custom time source function (only used when time_source is .Custom)
     custom_time_source: ?*const fn () f64 = null,
+
+    /// How the frame limiter waits for the next frame's deadline
+    pacing: FramePacing = .precise_timer,
+
+    /// Frames longer than this count as hitches, in seconds (0 disables detection)
+    hitch_threshold: f32 = 0.0,
+    /// With a prefix, every hitch writes the profiler's last hitch_trace_frames frames to <prefix><hitch number>.json
+    hitch_trace_prefix: ?[]const u8 = null,
+    hitch_trace_frames: u32 = 8,
+    /// Seconds after a trace during which hitches are counted but not written, writing one takes a while itself
+    hitch_trace_interval: f32 = 5.0,
+};
+
+
+/// Waiting strategies of the frame limiter
+pub const FramePacing = enum {
+    /// std.time.sleep until 1 ms before the deadline, then spin
+    sleep_spin,
+    /// High resolution waitable timer on Windows, clock_nanosleep on Linux and the BSDs, spinning only
+    /// the last fraction of a millisecond. Falls back to sleep_spin margins where neither exists
+    precise_timer,
 };
 
 
@@ -48,50 +71,123 @@ pub const FrameStats = struct {
 };
 
 
+/// Ring of the most recent frame times, measured before max_frame_time clamps them
+pub const FrameTimes = struct {
+    pub const capacity = 512;
+
+    samples: [capacity]u64 = undefined,
+    /// Frames ever recorded, the next one goes to count % capacity
+    count: u64 = 0,
+
+    pub fn push(self: *FrameTimes, ns: u64) void {
+        self.samples[self.count % capacity] = ns;
+        self.count += 1;
+    }
+
+
+    /// Recorded frame times in nanoseconds, in ring order
+    pub fn slice(self: *const FrameTimes) []const u64 {
+        return self.samples[0..@intCast(@min(self.count, capacity))];
+    }
+
+
+    /// Mean, percentiles and maximum of the recorded samples
+    pub fn stats(self: *const FrameTimes) FrameTimeStats {
+        const samples = self.slice();
+        if (samples.len == 0) return .{};
+
+        var sorted: [capacity]u64 = undefined;
+        @memcpy(sorted[0..samples.len], samples);
+        std.mem.sort(u64, sorted[0..samples.len], {}, std.sort.asc(u64));
+
+        var sum: u64 = 0;
+        for (samples) |sample| sum += sample;
+        return .{
+            .frames = @intCast(samples.len),
+            .mean_ns = sum / samples.len,
+            .p50_ns = percentile(sorted[0..samples.len], 50),
+            .p95_ns = percentile(sorted[0..samples.len], 95),
+            .p99_ns = percentile(sorted[0..samples.len], 99),
+            .max_ns = sorted[samples.len - 1],
+        };
+    }
+};
+
+
+/// Distribution of the frame times in the ring, all in nanoseconds, zero before the first frame
+pub const FrameTimeStats = struct {
+    frames: u32 = 0,
+    mean_ns: u64 = 0,
+    p50_ns: u64 = 0,
+    p95_ns: u64 = 0,
+    /// The 1% low frame rate is 1 / p99
+    p99_ns: u64 = 0,
+    max_ns: u64 = 0,
+};
+
+
 /// Time system that tracks various timing metrics
+/// Everything is counted in integer nanoseconds of a monotonic clock, the float fields are views of
+/// those counts for convenience, so long runs neither drift nor lose precision
 pub const Time = struct {
     config: TimeConfig,
 
-    /// Current frame's delta time
+    /// Current frame's delta time in seconds
     delta: f32,
-    /// Time accumulated for fixed timestep updates
-    accumulated: f32,
-    /// Last frame's timestamp
-    last_frame: f64,
-    /// Time since startup
+    /// Time since initialization in seconds
     total: f64,
 
+    delta_ns: u64,
+    /// Time accumulated for fixed timestep updates
+    accumulated_ns: u64,
+    /// Clock reading at init and at the last update
+    start_ns: u64,
+    last_frame_ns: u64,
+    fixed_timestep_ns: u64,
+
     /// FPS tracking
     fps: FrameStats,
+    frame_times: FrameTimes = .{},
+    /// Frames over hitch_threshold so far
+    hitch_count: u32 = 0,
+    /// Clock reading when the last hitch trace was written
+    last_trace_ns: ?u64 = null,
 
-    /// Time source function pointer
-    getTime: *const fn () f64,
+    /// Absolute deadline of the current frame on the time source's clock, 0 before the first limited frame
+    /// Each deadline follows the previous one, so time spent waking up never accumulates into drift
+    next_deadline_ns: u64 = 0,
+    sleeper: PreciseSleeper,
 
 
     // ============================================================
-    // Public API: Destruction Function
+    // Public API: Creation Functions
     // ============================================================
 
     /// Creates a new Time instance with the given configuration
     pub fn init(config: TimeConfig) TimeError!Time {
         // Validate configuration
-        const time_source_fn = try getTimeSource(config);
-        
+        if (config.time_source == .Custom and config.custom_time_source == null) {
+            return TimeError.InvalidTimeSource;
+        }
+
         // Get initial time
-        const initial_time = time_source_fn();
-        
+        const initial_time = readClock(config);
+
         return .{
             .config = config,
             .delta = 0.0,
-            .accumulated = 0.0,
-            .last_frame = initial_time,
             .total = 0.0,
+            .delta_ns = 0,
+            .accumulated_ns = 0,
+            .start_ns = initial_time,
+            .last_frame_ns = initial_time,
+            .fixed_timestep_ns = secondsToNs(config.fixed_timestep),
             .fps = .{
                 .current = 0.0,
                 .frames = 0,
                 .timer = 0.0,
             },
-            .getTime = time_source_fn,
+            .sleeper = PreciseSleeper.init(),
         };
     }
 
@@ -108,18 +204,23 @@ pub const Time = struct {
 
     /// Updates timing information for the current frame
     pub fn update(self: *Time) void {
-        const current_time = self.getTime();
-        const frame_time = current_time - self.last_frame;
+        const current_time = self.now();
+        const frame_time = current_time -| self.last_frame_ns;
 
         // Update delta time with clamping to prevent spiral of death
-        self.delta = @floatCast(@min(frame_time, @as(f64, self.config.max_frame_time)));
-        self.last_frame = current_time;
+        self.delta_ns = @min(frame_time, secondsToNs(self.config.max_frame_time));
+        self.delta = nsToSeconds(f32, self.delta_ns);
+        self.last_frame_ns = current_time;
+        self.frame_times.push(frame_time);
+        if (self.config.hitch_threshold > 0.0 and frame_time > secondsToNs(self.config.hitch_threshold)) {
+            self.onHitch(current_time);
+        }
 
         // Update accumulated time for fixed timestep
-        self.accumulated += self.delta;
+        self.accumulated_ns += self.delta_ns;
 
         // Update total time
-        self.total = current_time;
+        self.total = nsToSeconds(f64, current_time -| self.start_ns);
 
         // Update FPS counter
         self.fps.frames += 1;
@@ -133,32 +234,36 @@ pub const Time = struct {
 
         // Frame limiting if target FPS is set
         if (self.config.target_fps > 0) {
-            frameLimiter(self.getTime, current_time, self.config.target_fps);
+            self.frameLimiter();
         }
     }
 
 
     /// Checks if it's time for a fixed update and returns number of updates needed
     pub fn getFixedUpdateCount(self: *Time) u32 {
-        var count: u32 = 0;
-        while (self.accumulated >= self.config.fixed_timestep) {
-            self.accumulated -= self.config.fixed_timestep;
-            count += 1;
-        }
-        return count;
+        if (self.fixed_timestep_ns == 0) return 0;
+        const count = self.accumulated_ns / self.fixed_timestep_ns;
+        self.accumulated_ns -= count * self.fixed_timestep_ns;
+        return @intCast(count);
     }
 
 
     /// Performs a single fixed update check
     pub fn shouldFixedUpdate(self: *Time) bool {
-        if (self.accumulated >= self.config.fixed_timestep) {
-            self.accumulated -= self.config.fixed_timestep;
+        if (self.fixed_timestep_ns > 0 and self.accumulated_ns >= self.fixed_timestep_ns) {
+            self.accumulated_ns -= self.fixed_timestep_ns;
             return true;
         }
         return false;
     }
 
 
+    /// Current reading of the configured clock, in nanoseconds
+    pub fn now(self: *const Time) u64 {
+        return readClock(self.config);
+    }
+
+
     // ============================================================
     // Public API: Accessor Functions
     // ============================================================
@@ -169,6 +274,23 @@ pub const Time = struct {
     }
 
 
+    /// Mean, percentiles and maximum of the last FrameTimes.capacity frame times
+    pub fn getFrameTimeStats(self: *const Time) FrameTimeStats {
+        return self.frame_times.stats();
+    }
+
+
+    /// Count the frame times of the ring into `counts`, bucket i holding [i, i + 1) * bucket_ns
+    /// The last bucket also takes every longer frame
+    pub fn getFrameTimeHistogram(self: *const Time, bucket_ns: u64, counts: []u32) void {
+        @memset(counts, 0);
+        if (counts.len == 0 or bucket_ns == 0) return;
+        for (self.frame_times.slice()) |sample| {
+            counts[@intCast(@min(sample / bucket_ns, counts.len - 1))] += 1;
+        }
+    }
+
+
     /// Gets the target FPS
     pub fn getTargetFPS(self: Time) u32 {
         return self.config.target_fps;
@@ -193,67 +315,230 @@ pub const Time = struct {
     }
 
 
+    pub fn getDeltaNs(self: Time) u64 {
+        return self.delta_ns;
+    }
+
+
     /// Gets total time since initialization
     pub fn getTotal(self: Time) f64 {
         return self.total;
     }
 
 
+    pub fn getTotalNs(self: Time) u64 {
+        return self.last_frame_ns -| self.start_ns;
+    }
+
+
+    /// Fraction of a fixed timestep left in the accumulator, for interpolating between fixed updates
+    pub fn getFixedAlpha(self: Time) f32 {
+        if (self.fixed_timestep_ns == 0) return 0.0;
+        return @floatCast(@as(f64, @floatFromInt(self.accumulated_ns)) / @as(f64, @floatFromInt(self.fixed_timestep_ns)));
+    }
+
+
     /// Sets a new fixed timestep value
     pub fn setFixedTimestep(self: *Time, timestep: f32) void {
         self.config.fixed_timestep = timestep;
+        self.fixed_timestep_ns = secondsToNs(timestep);
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Frees the waitable timer, if the platform needed one
+    pub fn deinit(self: *Time) void {
+        self.sleeper.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Count a hitch and write the frames leading up to it when traces are configured
+    fn onHitch(self: *Time, current_time: u64) void {
+        self.hitch_count += 1;
+        const prefix = self.config.hitch_trace_prefix orelse return;
+        if (!profiler.enabled) return;
+        if (self.last_trace_ns) |last| {
+            if (current_time -| last < secondsToNs(self.config.hitch_trace_interval)) return;
+        }
+        self.last_trace_ns = current_time;
+
+        var path_buffer: [std.fs.max_path_bytes]u8 = undefined;
+        const path = std.fmt.bufPrint(&path_buffer, "{s}{d}.json", .{ prefix, self.hitch_count }) catch return;
+        profiler.saveRecentFrames(std.heap.page_allocator, path, self.config.hitch_trace_frames) catch |e| {
+            std.debug.print("Time: failed to write hitch trace {s}: {s}\n", .{ path, @errorName(e) });
+        };
+    }
+
+
+    /// Wait for the absolute deadline of this frame, one period after the previous one
+    fn frameLimiter(self: *Time) void {
+        const period = std.time.ns_per_s / @as(u64, self.config.target_fps);
+        const current = self.now();
+
+        var deadline = self.next_deadline_ns + period;
+        // Start over after a stall or a target change instead of rushing frames to catch up
+        if (self.next_deadline_ns == 0 or deadline + period < current or deadline > current + period) {
+            deadline = current + period;
+        }
+        self.next_deadline_ns = deadline;
+
+        // Sleeping ends late by up to the slack, the rest is spun for precision
+        const slack: u64 = switch (self.config.pacing) {
+            .sleep_spin => std.time.ns_per_ms,
+            .precise_timer => if (PreciseSleeper.is_precise) 200 * std.time.ns_per_us else std.time.ns_per_ms,
+        };
+
+        const remaining = deadline -| current;
+        if (remaining > 2 * slack) {
+            switch (self.config.pacing) {
+                .sleep_spin => std.time.sleep(remaining - slack),
+                .precise_timer => self.sleeper.sleep(remaining - slack),
+            }
+        }
+
+        while (self.now() < deadline) {
+            std.atomic.spinLoopHint();
+        }
     }
 };
 
 
-/// Helper function to get the appropriate time source function
-fn getTimeSource(config: TimeConfig) TimeError!*const fn () f64 {
+/// Sleeps with sub-millisecond precision where the OS offers it
+const PreciseSleeper = struct {
+    const uses_waitable_timer = builtin.os.tag == .windows;
+    const uses_clock_nanosleep = switch (builtin.os.tag) {
+        .linux, .freebsd, .netbsd, .openbsd, .dragonfly => true,
+        else => false,
+    };
+    const is_precise = uses_waitable_timer or uses_clock_nanosleep;
+
+    /// High resolution waitable timer, null when the system predates Windows 10 1803
+    timer: if (uses_waitable_timer) ?std.os.windows.HANDLE else void,
+
+    fn init() PreciseSleeper {
+        if (!uses_waitable_timer) return .{ .timer = {} };
+        return .{ .timer = win32.CreateWaitableTimerExW(null, null, win32.CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, win32.TIMER_ALL_ACCESS) };
+    }
+
+
+    fn sleep(self: *PreciseSleeper, ns: u64) void {
+        if (uses_waitable_timer) {
+            const timer = self.timer orelse return std.time.sleep(ns);
+            // Negative due times are relative, in 100 ns units
+            const due_time: i64 = -@as(i64, @intCast(ns / 100));
+            if (win32.SetWaitableTimer(timer, &due_time, 0, null, null, 0) == 0) return std.time.sleep(ns);
+            _ = std.os.windows.kernel32.WaitForSingleObject(timer, std.os.windows.INFINITE);
+        } else if (uses_clock_nanosleep) {
+            // An absolute wake up time keeps interrupted sleeps from stretching the wait
+            var deadline = std.posix.clock_gettime(std.posix.CLOCK.MONOTONIC) catch return std.time.sleep(ns);
+            const total_ns = @as(u64, @intCast(deadline.nsec)) + ns;
+            deadline.sec += @intCast(total_ns / std.time.ns_per_s);
+            deadline.nsec = @intCast(total_ns % std.time.ns_per_s);
+            while (posix_time.clock_nanosleep(std.posix.CLOCK.MONOTONIC, posix_time.TIMER_ABSTIME, &deadline, null) == @intFromEnum(std.posix.E.INTR)) {}
+        } else {
+            std.time.sleep(ns);
+        }
+    }
+
+
+    fn deinit(self: *PreciseSleeper) void {
+        if (!uses_waitable_timer) return;
+        if (self.timer) |timer| std.os.windows.CloseHandle(timer);
+        self.timer = null;
+    }
+};
+
+
+const win32 = struct {
+    const CREATE_WAITABLE_TIMER_HIGH_RESOLUTION: u32 = 0x00000002;
+    const TIMER_ALL_ACCESS: u32 = 0x001F0003;
+
+    extern "kernel32" fn CreateWaitableTimerExW(
+        attributes: ?*anyopaque,
+        name: ?[*:0]const u16,
+        flags: u32,
+        desired_access: u32,
+    ) callconv(std.os.windows.WINAPI) ?std.os.windows.HANDLE;
+
+    extern "kernel32" fn SetWaitableTimer(
+        timer: std.os.windows.HANDLE,
+        due_time: *const i64,
+        period: i32,
+        completion_routine: ?*anyopaque,
+        completion_arg: ?*anyopaque,
+        resume_system: i32,
+    ) callconv(std.os.windows.WINAPI) i32;
+};
+
+
+const posix_time = struct {
+    const TIMER_ABSTIME: c_int = 1;
+
+    extern "c" fn clock_nanosleep(
+        clock: std.posix.clockid_t,
+        flags: c_int,
+        request: *const std.posix.timespec,
+        remain: ?*std.posix.timespec,
+    ) c_int;
+};
+
+
+/// Nanoseconds of a monotonic clock shared by Time's System source and the profiler, 0 at its first use
+pub fn monotonicNs() u64 {
+    clock_origin_once.call();
+    const instant = std.time.Instant.now() catch return 0;
+    return instant.since(clock_origin);
+}
+
+
+var clock_origin: std.time.Instant = undefined;
+var clock_origin_once = std.once(initClockOrigin);
+
+fn initClockOrigin() void {
+    clock_origin = std.time.Instant.now() catch @panic("no monotonic clock available");
+}
+
+
+/// Reading of the clock `config` selects, in nanoseconds
+fn readClock(config: TimeConfig) u64 {
     return switch (config.time_source) {
-        .GLFW => glfwTimeSource,
-        .System => systemTimeSource,
-        .Custom => if (config.custom_time_source) |source| 
-                      source 
-                   else 
-                      return TimeError.InvalidTimeSource,
+        .GLFW => glfwTimeSource(),
+        .System => monotonicNs(),
+        .Custom => secondsToNs(config.custom_time_source.?()),
     };
 }
 
 
-/// GLFW time source implementation
-fn glfwTimeSource() f64 {
-    return c.glfwGetTime();
+/// GLFW's raw timer counter, its time in seconds as a double would lose precision over long runs
+fn glfwTimeSource() u64 {
+    const frequency = c.glfwGetTimerFrequency();
+    if (frequency == 0) return 0;
+    return @intCast(@as(u128, c.glfwGetTimerValue()) * std.time.ns_per_s / frequency);
 }
 
 
-/// System time source implementation
-fn systemTimeSource() f64 {
-    return @as(f64, @floatFromInt(std.time.milliTimestamp())) / 1000.0;
+fn secondsToNs(seconds: anytype) u64 {
+    if (seconds <= 0) return 0;
+    return @intFromFloat(@as(f64, seconds) * std.time.ns_per_s);
 }
 
 
-/// Efficient frame limiter
-fn frameLimiter(timeFunc: *const fn () f64, frame_start: f64, target_fps: u32) void {
-    const target_frame_time = 1.0 / @as(f64, @floatFromInt(target_fps));
-    const end_time = frame_start + target_frame_time;
-    
-    // Time remaining until next frame should start
-    const remaining = end_time - timeFunc();
-    
-    // If we have time to wait
-    if (remaining > 0) {
-        // For longer waits, sleep in chunks to save CPU
-        if (remaining > 0.002) { // 2ms threshold for sleep
-
-            // Sleep a bit less than the full time to account for sleep inaccuracy
-            const sleep_time = @as(u64, @intFromFloat((remaining - 0.001) * std.time.ns_per_s));
-            std.time.sleep(sleep_time);
-        }
-        
-        // Spin for the remainder to get precise timing
-        while (timeFunc() < end_time) {
-            std.atomic.spinLoopHint();
-        }
-    }
+/// Nearest rank percentile of ascending `sorted`
+fn percentile(sorted: []const u64, comptime p: u64) u64 {
+    const rank = (sorted.len * p + 99) / 100;
+    return sorted[@max(rank, 1) - 1];
+}
+
+
+fn nsToSeconds(comptime T: type, ns: u64) T {
+    return @floatCast(@as(f64, @floatFromInt(ns)) / std.time.ns_per_s);
 }
 
 
@@ -0,0 +1,323 @@
+// core/tracking_allocator.zig - allocation statistics per engine subsystem
+const std = @import("std");
+
+
+/// Subsystem an allocation is charged to
+pub const AllocationTag = enum {
+    ecs,
+    renderer,
+    resources,
+    input,
+    jobs,
+    other,
+};
+
+const tag_count = std.meta.fields(AllocationTag).len;
+
+
+/// Counters of one tag, as taken by TrackingAllocator.stats
+pub const TagStats = struct {
+    /// Bytes allocated and not freed
+    live_bytes: usize = 0,
+    /// Highest live_bytes since init or resetPeaks
+    peak_bytes: usize = 0,
+    /// Allocations and frees since init, resizes and remaps that moved memory count as both
+    allocations: u64 = 0,
+    frees: u64 = 0,
+    /// Allocations between the last two endFrame calls
+    frame_allocations: u64 = 0,
+    frame_bytes: u64 = 0,
+};
+
+
+pub const TrackingConfig = struct {
+    /// Record the call stack of every Nth allocation for hotSites, 0 records none
+    /// Stack walks cost microseconds, keep this in the hundreds for a running game
+    sample_interval: u32 = 0,
+};
+
+
+/// Call stack that allocated often, from TrackingAllocator.hotSites
+pub const HotSite = struct {
+    pub const depth = 6;
+
+    tag: AllocationTag,
+    /// Return addresses, innermost first, 0 past the end of the stack
+    addresses: [depth]usize,
+    /// Sampled allocations from this stack, multiply by sample_interval for an estimate
+    samples: u64,
+    bytes: u64,
+};
+
+
+/// Wraps an allocator and counts bytes, allocations and peaks per AllocationTag
+/// allocator(tag) hands out a std.mem.Allocator charged to one tag, so every create and init that takes an
+/// allocator is tracked without changing. Pass the renderer's to the Renderer, the registry's to the Registry
+/// and so on, call endFrame once per frame and watch frame_allocations of each tag go to zero
+/// Counters are atomics, any thread may allocate; the hot site table takes a mutex on sampled allocations only
+pub const TrackingAllocator = struct {
+    const Self = @This();
+
+    const max_hot_sites = 256;
+
+    const Counters = struct {
+        live_bytes: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+        peak_bytes: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+        allocations: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+        frees: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+        /// Allocations counted at the last endFrame, and what the frame before that took
+        frame_start_allocations: u64 = 0,
+        frame_start_bytes: u64 = 0,
+        frame_allocations: u64 = 0,
+        frame_bytes: u64 = 0,
+        /// Bytes ever allocated
+        total_bytes: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    };
+
+    /// Target of one tag's allocator, the vtable functions find the tracker through it
+    const Tagged = struct {
+        owner: *Self,
+        tag: AllocationTag,
+    };
+
+    child_allocator: std.mem.Allocator,
+    config: TrackingConfig,
+    counters: [tag_count]Counters = [_]Counters{.{}} ** tag_count,
+    tagged: [tag_count]Tagged,
+    /// Allocations of every tag, picks the sampled ones
+    sample_counter: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    hot_sites_mutex: std.Thread.Mutex = .{},
+    hot_sites: [max_hot_sites]HotSite = undefined,
+    hot_site_count: usize = 0,
+
+    const vtable = std.mem.Allocator.VTable{
+        .alloc = alloc,
+        .resize = resize,
+        .remap = remap,
+        .free = free,
+    };
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Tracker in place, it holds pointers to itself and must not move while its allocators are in use
+    pub fn init(self: *Self, child_allocator: std.mem.Allocator, config: TrackingConfig) void {
+        self.* = .{ .child_allocator = child_allocator, .config = config, .tagged = undefined };
+        for (&self.tagged, 0..) |*tagged, index| tagged.* = .{ .owner = self, .tag = @enumFromInt(index) };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Allocator charging everything to `tag`
+    pub fn allocator(self: *Self, tag: AllocationTag) std.mem.Allocator {
+        return .{ .ptr = &self.tagged[@intFromEnum(tag)], .vtable = &vtable };
+    }
+
+
+    /// Close the frame, frame_allocations and frame_bytes then count what happened since the last call
+    /// Call from one thread, the main loop
+    pub fn endFrame(self: *Self) void {
+        for (&self.counters) |*counters| {
+            const allocations = counters.allocations.load(.monotonic);
+            const bytes = counters.total_bytes.load(.monotonic);
+            counters.frame_allocations = allocations - counters.frame_start_allocations;
+            counters.frame_bytes = bytes - counters.frame_start_bytes;
+            counters.frame_start_allocations = allocations;
+            counters.frame_start_bytes = bytes;
+        }
+    }
+
+
+    pub fn stats(self: *const Self, tag: AllocationTag) TagStats {
+        const counters = &self.counters[@intFromEnum(tag)];
+        return .{
+            .live_bytes = counters.live_bytes.load(.monotonic),
+            .peak_bytes = counters.peak_bytes.load(.monotonic),
+            .allocations = counters.allocations.load(.monotonic),
+            .frees = counters.frees.load(.monotonic),
+            .frame_allocations = counters.frame_allocations,
+            .frame_bytes = counters.frame_bytes,
+        };
+    }
+
+
+    /// Start the peaks over from the current live bytes, e.g. after loading a level
+    pub fn resetPeaks(self: *Self) void {
+        for (&self.counters) |*counters| counters.peak_bytes.store(counters.live_bytes.load(.monotonic), .monotonic);
+    }
+
+
+    /// Copy up to `out.len` sampled call stacks into `out`, most samples first, returns the filled part
+    pub fn hotSites(self: *Self, out: []HotSite) []HotSite {
+        self.hot_sites_mutex.lock();
+        defer self.hot_sites_mutex.unlock();
+
+        const sites = self.hot_sites[0..self.hot_site_count];
+        std.mem.sort(HotSite, sites, {}, struct {
+            fn moreSamples(_: void, a: HotSite, b: HotSite) bool {
+                return a.samples > b.samples;
+            }
+        }.moreSamples);
+        const count = @min(out.len, sites.len);
+        @memcpy(out[0..count], sites[0..count]);
+        return out[0..count];
+    }
+
+
+    /// Print every tag's counters, then the `max_sites` hottest call stacks with source locations when debug
+    /// info is available
+    pub fn writeReport(self: *Self, writer: anytype, max_sites: usize) !void {
+        for (0..tag_count) |index| {
+            const tag: AllocationTag = @enumFromInt(index);
+            const tag_stats = self.stats(tag);
+            try writer.print("{s:<10} live {d:>10} B  peak {d:>10} B  allocs {d:>9}  frees {d:>9}  last frame {d} allocs, {d} B\n", .{
+                @tagName(tag),
+                tag_stats.live_bytes,
+                tag_stats.peak_bytes,
+                tag_stats.allocations,
+                tag_stats.frees,
+                tag_stats.frame_allocations,
+                tag_stats.frame_bytes,
+            });
+        }
+        if (self.config.sample_interval == 0 or max_sites == 0) return;
+
+        var sites: [max_hot_sites]HotSite = undefined;
+        const hot = self.hotSites(sites[0..@min(max_sites, max_hot_sites)]);
+        const debug_info = std.debug.getSelfDebugInfo() catch null;
+        for (hot, 1..) |site, rank| {
+            try writer.print("\n#{d} {s}: {d} samples, ~{d} allocations, {d} B sampled\n", .{
+                rank,
+                @tagName(site.tag),
+                site.samples,
+                site.samples * self.config.sample_interval,
+                site.bytes,
+            });
+            for (site.addresses) |address| {
+                if (address == 0) break;
+                if (debug_info) |info| {
+                    std.debug.printSourceAtAddress(info, writer, address, .no_color) catch try writer.print("    0x{x}\n", .{address});
+                } else {
+                    try writer.print("    0x{x}\n", .{address});
+                }
+            }
+        }
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Warns about tags that still hold memory, the child allocator owns it and its own leak checks still apply
+    pub fn deinit(self: *Self) void {
+        for (&self.counters, 0..) |*counters, index| {
+            const live = counters.live_bytes.load(.monotonic);
+            if (live > 0) std.log.warn("TrackingAllocator: {s} still holds {d} bytes", .{ @tagName(@as(AllocationTag, @enumFromInt(index))), live });
+        }
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn onAlloc(self: *Self, tag: AllocationTag, len: usize, ret_addr: usize) void {
+        const counters = &self.counters[@intFromEnum(tag)];
+        _ = counters.allocations.fetchAdd(1, .monotonic);
+        _ = counters.total_bytes.fetchAdd(len, .monotonic);
+        const live = counters.live_bytes.fetchAdd(len, .monotonic) + len;
+        _ = counters.peak_bytes.fetchMax(live, .monotonic);
+
+        const interval = self.config.sample_interval;
+        if (interval != 0 and self.sample_counter.fetchAdd(1, .monotonic) % interval == 0) {
+            self.sample(tag, len, ret_addr);
+        }
+    }
+
+
+    fn onFree(self: *Self, tag: AllocationTag, len: usize) void {
+        const counters = &self.counters[@intFromEnum(tag)];
+        _ = counters.frees.fetchAdd(1, .monotonic);
+        _ = counters.live_bytes.fetchSub(len, .monotonic);
+    }
+
+
+    /// Resizes in place change the live bytes only, they are no new allocation
+    fn onResize(self: *Self, tag: AllocationTag, old_len: usize, new_len: usize) void {
+        const counters = &self.counters[@intFromEnum(tag)];
+        if (new_len > old_len) {
+            _ = counters.total_bytes.fetchAdd(new_len - old_len, .monotonic);
+            const live = counters.live_bytes.fetchAdd(new_len - old_len, .monotonic) + (new_len - old_len);
+            _ = counters.peak_bytes.fetchMax(live, .monotonic);
+        } else {
+            _ = counters.live_bytes.fetchSub(old_len - new_len, .monotonic);
+        }
+    }
+
+
+    /// Add the stack above `ret_addr` to the hot sites, a full table drops new stacks
+    fn sample(self: *Self, tag: AllocationTag, len: usize, ret_addr: usize) void {
+        var addresses = [_]usize{0} ** HotSite.depth;
+        var trace = std.builtin.StackTrace{ .instruction_addresses = &addresses, .index = 0 };
+        std.debug.captureStackTrace(ret_addr, &trace);
+
+        self.hot_sites_mutex.lock();
+        defer self.hot_sites_mutex.unlock();
+        for (self.hot_sites[0..self.hot_site_count]) |*site| {
+            if (site.tag == tag and std.mem.eql(usize, &site.addresses, &addresses)) {
+                site.samples += 1;
+                site.bytes += len;
+                return;
+            }
+        }
+        if (self.hot_site_count == max_hot_sites) return;
+        self.hot_sites[self.hot_site_count] = .{ .tag = tag, .addresses = addresses, .samples = 1, .bytes = len };
+        self.hot_site_count += 1;
+    }
+
+
+    fn alloc(ctx: *anyopaque, len: usize, alignment: std.mem.Alignment, ret_addr: usize) ?[*]u8 {
+        const tagged: *Tagged = @alignCast(@ptrCast(ctx));
+        const self = tagged.owner;
+        const memory = self.child_allocator.rawAlloc(len, alignment, ret_addr) orelse return null;
+        self.onAlloc(tagged.tag, len, ret_addr);
+        return memory;
+    }
+
+
+    fn resize(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) bool {
+        const tagged: *Tagged = @alignCast(@ptrCast(ctx));
+        const self = tagged.owner;
+        if (!self.child_allocator.rawResize(memory, alignment, new_len, ret_addr)) return false;
+        self.onResize(tagged.tag, memory.len, new_len);
+        return true;
+    }
+
+
+    fn remap(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) ?[*]u8 {
+        const tagged: *Tagged = @alignCast(@ptrCast(ctx));
+        const self = tagged.owner;
+        const new_memory = self.child_allocator.rawRemap(memory, alignment, new_len, ret_addr) orelse return null;
+        if (new_memory == memory.ptr) {
+            self.onResize(tagged.tag, memory.len, new_len);
+        } else {
+            self.onFree(tagged.tag, memory.len);
+            self.onAlloc(tagged.tag, new_len, ret_addr);
+        }
+        return new_memory;
+    }
+
+
+    fn free(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, ret_addr: usize) void {
+        const tagged: *Tagged = @alignCast(@ptrCast(ctx));
+        const self = tagged.owner;
+        self.child_allocator.rawFree(memory, alignment, ret_addr);
+        self.onFree(tagged.tag, memory.len);
+    }
+};
@@ -0,0 +1,170 @@
+// core/virtual_allocator.zig - allocations that grow in place inside reserved address space
+const std = @import("std");
+const builtin = @import("builtin");
+const windows = std.os.windows;
+
+
+pub const VirtualAllocatorConfig = struct {
+    /// Address space reserved per allocation, it grows in place up to this size and moves to the child beyond
+    /// Reserving costs no memory, 64-bit processes have terabytes of address space to spend
+    reserve_bytes: usize = 1 << 30,
+    /// Pages are committed in steps of this many bytes, rounded up to the page size
+    commit_granularity: usize = 64 * 1024,
+    /// Back reservations with transparent huge pages on Linux, cutting TLB misses of scans over big lists
+    /// Windows large pages can only be committed whole, up front, so the flag is ignored there
+    large_pages: bool = false,
+};
+
+
+/// Allocator reserving `reserve_bytes` of address space per allocation and committing pages as it grows
+/// Growing an ArrayList then remaps in place: nothing is copied and pointers into it stay valid, as long as
+/// it stays below `reserve_bytes`. Meant for a handful of big, growing lists like ECS dense storages, every
+/// allocation holds at least one commit step of memory. Larger or over-aligned allocations, and every
+/// allocation on targets without virtual memory, go to the child allocator. Thread safe
+pub const VirtualAllocator = struct {
+    const Self = @This();
+
+    pub const supported = builtin.os.tag == .windows or builtin.os.tag == .linux or builtin.os.tag.isDarwin() or builtin.os.tag.isBSD();
+
+    child_allocator: std.mem.Allocator,
+    config: VirtualAllocatorConfig,
+    /// Committed bytes of all live reservations
+    committed_bytes: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+    reservations: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+
+    const vtable = std.mem.Allocator.VTable{
+        .alloc = alloc,
+        .resize = resize,
+        .remap = remap,
+        .free = free,
+    };
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(child_allocator: std.mem.Allocator, config: VirtualAllocatorConfig) Self {
+        var adjusted = config;
+        const page_size = std.heap.pageSize();
+        // Huge pages are 2 MiB, committing less of one at a time would split it again
+        const granularity = if (config.large_pages and builtin.os.tag == .linux) @max(config.commit_granularity, 2 << 20) else config.commit_granularity;
+        adjusted.commit_granularity = std.mem.alignForward(usize, @max(granularity, page_size), page_size);
+        adjusted.reserve_bytes = std.mem.alignForward(usize, config.reserve_bytes, adjusted.commit_granularity);
+        return .{ .child_allocator = child_allocator, .config = adjusted };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Allocator backed by reservations, it must not move while anything allocated from it lives
+    pub fn allocator(self: *Self) std.mem.Allocator {
+        return .{ .ptr = self, .vtable = &vtable };
+    }
+
+
+    pub fn committedBytes(self: *const Self) usize {
+        return self.committed_bytes.load(.monotonic);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn isReserved(self: *const Self, len: usize, alignment: std.mem.Alignment) bool {
+        return supported and len <= self.config.reserve_bytes and alignment.toByteUnits() <= std.heap.pageSize();
+    }
+
+
+    fn committedFor(self: *const Self, len: usize) usize {
+        return std.mem.alignForward(usize, @max(len, 1), self.config.commit_granularity);
+    }
+
+
+    fn alloc(ctx: *anyopaque, len: usize, alignment: std.mem.Alignment, ret_addr: usize) ?[*]u8 {
+        const self: *Self = @alignCast(@ptrCast(ctx));
+        if (!self.isReserved(len, alignment)) return self.child_allocator.rawAlloc(len, alignment, ret_addr);
+
+        const base = reserve(self.config.reserve_bytes) orelse return null;
+        if (self.config.large_pages and builtin.os.tag == .linux) {
+            std.posix.madvise(base, self.config.reserve_bytes, std.os.linux.MADV.HUGEPAGE) catch {};
+        }
+        const committed = self.committedFor(len);
+        if (!commit(base, committed)) {
+            release(base, self.config.reserve_bytes);
+            return null;
+        }
+        _ = self.committed_bytes.fetchAdd(committed, .monotonic);
+        _ = self.reservations.fetchAdd(1, .monotonic);
+        return base;
+    }
+
+
+    /// Commits what a larger size needs, shrinking keeps the pages committed until free
+    /// Nothing moves between the reservations and the child, the free would go to the wrong one
+    fn resize(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) bool {
+        const self: *Self = @alignCast(@ptrCast(ctx));
+        const reserved = self.isReserved(memory.len, alignment);
+        if (reserved != self.isReserved(new_len, alignment)) return false;
+        if (!reserved) return self.child_allocator.rawResize(memory, alignment, new_len, ret_addr);
+
+        const old_committed = self.committedFor(memory.len);
+        const new_committed = self.committedFor(new_len);
+        if (new_committed <= old_committed) return true;
+        if (!commit(@alignCast(memory.ptr + old_committed), new_committed - old_committed)) return false;
+        _ = self.committed_bytes.fetchAdd(new_committed - old_committed, .monotonic);
+        return true;
+    }
+
+
+    fn remap(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) ?[*]u8 {
+        const self: *Self = @alignCast(@ptrCast(ctx));
+        if (!self.isReserved(memory.len, alignment) and !self.isReserved(new_len, alignment)) {
+            return self.child_allocator.rawRemap(memory, alignment, new_len, ret_addr);
+        }
+        return if (resize(ctx, memory, alignment, new_len, ret_addr)) memory.ptr else null;
+    }
+
+
+    fn free(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, ret_addr: usize) void {
+        const self: *Self = @alignCast(@ptrCast(ctx));
+        if (!self.isReserved(memory.len, alignment)) return self.child_allocator.rawFree(memory, alignment, ret_addr);
+
+        release(@alignCast(memory.ptr), self.config.reserve_bytes);
+        _ = self.committed_bytes.fetchSub(self.committedFor(memory.len), .monotonic);
+        _ = self.reservations.fetchSub(1, .monotonic);
+    }
+
+
+    /// Inaccessible address range of `size` bytes, page aligned
+    fn reserve(size: usize) ?[*]align(std.heap.page_size_min) u8 {
+        if (builtin.os.tag == .windows) {
+            const base = windows.VirtualAlloc(null, size, windows.MEM_RESERVE, windows.PAGE_NOACCESS) catch return null;
+            return @alignCast(@ptrCast(base));
+        }
+        const range = std.posix.mmap(null, size, std.posix.PROT.NONE, .{ .TYPE = .PRIVATE, .ANONYMOUS = true }, -1, 0) catch return null;
+        return range.ptr;
+    }
+
+
+    fn commit(start: [*]align(std.heap.page_size_min) u8, size: usize) bool {
+        if (builtin.os.tag == .windows) {
+            _ = windows.VirtualAlloc(start, size, windows.MEM_COMMIT, windows.PAGE_READWRITE) catch return false;
+            return true;
+        }
+        std.posix.mprotect(start[0..size], std.posix.PROT.READ | std.posix.PROT.WRITE) catch return false;
+        return true;
+    }
+
+
+    fn release(base: [*]align(std.heap.page_size_min) u8, size: usize) void {
+        if (builtin.os.tag == .windows) {
+            windows.VirtualFree(base, 0, windows.MEM_RELEASE);
+        } else {
+            std.posix.munmap(base[0..size]);
+        }
+    }
+};
@@ -2,6 +2,8 @@ const std = @import("std");
 const c = @import("../bindings/c.zig");
 
 const Input = @import("input.zig").Input;
+const gl = @import("gl.zig");
+const gl_ext = @import("gl_ext.zig");
 
 
 fn errorCallback(err: c_int, description: [*c]const u8) callconv(.C) void {
@@ -9,19 +11,116 @@ fn errorCallback(err: c_int, description: [*c]const u8) callconv(.C) void {
 }
 
 
+/// Windows and shared contexts alive, GLFW is initialized with the first and terminated with the last
+/// Created and released on the main thread only, as GLFW requires
+var glfw_users: u32 = 0;
+
+
+fn acquireGlfw() !void {
+    if (glfw_users == 0) {
+        if (c.glfwInit() != c.GLFW_TRUE) {
+            std.debug.print("could not init glfw\n", .{});
+            return Window.Error.GLFWInitFailed;
+        }
+        _ = c.glfwSetErrorCallback(errorCallback);
+    }
+    glfw_users += 1;
+}
+
+
+fn releaseGlfw() void {
+    glfw_users -= 1;
+    if (glfw_users == 0) c.glfwTerminate();
+}
+
+
+fn setContextHints(version: GLVersion) void {
+    c.glfwWindowHint(c.GLFW_CONTEXT_VERSION_MAJOR, version.major);
+    c.glfwWindowHint(c.GLFW_CONTEXT_VERSION_MINOR, version.minor);
+    c.glfwWindowHint(c.GLFW_OPENGL_PROFILE, c.GLFW_OPENGL_CORE_PROFILE);
+    c.glfwWindowHint(c.GLFW_OPENGL_FORWARD_COMPAT, c.GLFW_TRUE);
+    c.glfwWindowHint(c.GLFW_OPENGL_DEBUG_CONTEXT, if (gl.error_mode == .debug_output) c.GLFW_TRUE else c.GLFW_FALSE);
+}
+
+
+pub const GLVersion = struct {
+    major: c_int,
+    minor: c_int,
+
+    /// Core profile versions create tries, newest first
+    pub const candidates = [_]GLVersion{
+        .{ .major = 4, .minor = 6 }, .{ .major = 4, .minor = 5 }, .{ .major = 4, .minor = 4 },
+        .{ .major = 4, .minor = 3 }, .{ .major = 4, .minor = 2 }, .{ .major = 4, .minor = 1 },
+        .{ .major = 4, .minor = 0 }, .{ .major = 3, .minor = 3 },
+    };
+
+    pub fn atLeast(self: GLVersion, other: GLVersion) bool {
+        return self.major > other.major or (self.major == other.major and self.minor >= other.minor);
+    }
+};
+
+
 pub const WindowConfig = struct {
     title: [:0]const u8,
     width: u32 = 800,
     height: u32 = 600,
     vsync: bool = true,
+    /// With vsync, frames that miss a refresh swap right away and tear instead of waiting a whole interval,
+    /// where the driver has WGL/GLX_EXT_swap_control_tear, plain vsync elsewhere
+    adaptive_vsync: bool = false,
+    /// Frames the GPU may still be working on when swapBuffers queues another, 0 leaves it to the driver
+    /// 1 gives the lowest input to photon latency, at most Window.max_queued_frames
+    max_queued_frames: u32 = 0,
     resizable: bool = true,
     decorated: bool = true,
     fullscreen: bool = false,
     msaa_samples: u32 = 0,
     cursor_visible: bool = true,
+    /// Unscaled, unaccelerated mouse motion while the cursor is disabled, where the platform has it
+    raw_mouse_motion: bool = false,
+    /// Measure input latency up to the GPU finishing the frame, not just swapBuffers returning
+    /// Waits for the GPU after every frame with input, so only for measuring
+    fence_input_latency: bool = false,
     transparent: bool = false,
     floating: bool = false,
     with_input_system: bool = true,
+    /// Invisible window drawing into an offscreen framebuffer of width x height, with vsync off and
+    /// swapBuffers presenting nothing, so CI agents and servers can run benchmarks and soak tests
+    headless: bool = false,
+    /// Window whose GL objects this one shares, so meshes, textures and shaders are created once
+    /// Buffers, textures, renderbuffers, samplers and programs are shared, vertex arrays and framebuffers are not
+    share: ?*Window = null,
+    /// Newest context version asked for, create falls back version by version down to min_gl_version
+    /// The 3.3 paths stay in place, newer contexts only turn on what gl_ext finds in them
+    max_gl_version: GLVersion = GLVersion.candidates[0],
+    min_gl_version: GLVersion = .{ .major = 3, .minor = 3 },
+};
+
+
+/// Hidden context sharing the objects of a window, e.g. for a loader thread uploading textures
+/// Made current on one other thread at a time, objects it creates are ready for the window once
+/// their fence has signaled, see ResourceLoader.enableUploadContext
+pub const SharedContext = struct {
+    handle: *c.GLFWwindow,
+
+    /// Make the context current on the calling thread
+    pub fn makeCurrent(self: *const SharedContext) void {
+        c.glfwMakeContextCurrent(self.handle);
+    }
+
+
+    /// Detach the context from the calling thread
+    pub fn releaseCurrent(self: *const SharedContext) void {
+        _ = self;
+        c.glfwMakeContextCurrent(null);
+    }
+
+
+    /// Destroy the context on the main thread, it must not be current anywhere
+    pub fn destroy(self: *SharedContext) void {
+        c.glfwDestroyWindow(self.handle);
+        releaseGlfw();
+    }
 };
 
 
@@ -48,6 +147,8 @@ pub const Window = struct {
     allocator: std.mem.Allocator,
     config: WindowConfig,
     framebuffer_size: FramebufferSize,
+    /// Version of the context create got, shared contexts ask for the same
+    gl_version: GLVersion,
 
     // Window state
     is_minimized: bool,
@@ -60,12 +161,27 @@ pub const Window = struct {
     // Add a callback data field to store in user pointer
     callback_context: CallbackContext,
 
+    /// Offscreen target of a headless window, 0 otherwise
+    offscreen_fbo: c.GLuint = 0,
+    /// Color and depth-stencil renderbuffers of offscreen_fbo
+    offscreen_renderbuffers: [2]c.GLuint = .{ 0, 0 },
+
+    /// Interval last passed to glfwSwapInterval, -1 for adaptive vsync
+    swap_interval: c_int = 0,
+    /// Fences of the frames swapped last, a ring of config.max_queued_frames entries
+    frame_fences: [max_queued_frames]c.GLsync = .{null} ** max_queued_frames,
+    frame_fence_index: usize = 0,
+
+    /// Upper bound of WindowConfig.max_queued_frames
+    pub const max_queued_frames = 4;
+
     // TODO: move error system to err module
     pub const Error = error{
         GLFWInitFailed,
         WindowCreationFailed,
         GLADInitFailed,
         GLContextCreationFailed,
+        OffscreenTargetIncomplete,
     };
 
 
@@ -76,35 +192,41 @@ pub const Window = struct {
     // Initialize GLFW and create window
     pub fn create(allocator: std.mem.Allocator, config: WindowConfig) !*Window {
 
-        // Initialize GLFW
-        if (c.glfwInit() != c.GLFW_TRUE) {
-            std.debug.print("could not init glfw\n", .{});
-            return Error.GLFWInitFailed;
-        }
-        errdefer c.glfwTerminate();
-
-        _ = c.glfwSetErrorCallback(errorCallback);
+        // Initialize GLFW, once for every window
+        try acquireGlfw();
+        errdefer releaseGlfw();
 
         // Set window hints
-        c.glfwWindowHint(c.GLFW_CONTEXT_VERSION_MAJOR, 3);
-        c.glfwWindowHint(c.GLFW_CONTEXT_VERSION_MINOR, 3);
-        c.glfwWindowHint(c.GLFW_OPENGL_PROFILE, c.GLFW_OPENGL_CORE_PROFILE);
+        c.glfwDefaultWindowHints();
         c.glfwWindowHint(c.GLFW_RESIZABLE, if (config.resizable) c.GLFW_TRUE else c.GLFW_FALSE); // Resizability
         c.glfwWindowHint(c.GLFW_DECORATED, if (config.decorated) c.GLFW_TRUE else c.GLFW_FALSE); // Decoration
         c.glfwWindowHint(c.GLFW_TRANSPARENT_FRAMEBUFFER, if (config.transparent) c.GLFW_TRUE else c.GLFW_FALSE); //Transparency
         c.glfwWindowHint(c.GLFW_FLOATING, if (config.floating) c.GLFW_TRUE else c.GLFW_FALSE); //floating
         c.glfwWindowHint(c.GLFW_SAMPLES, @intCast(config.msaa_samples));
-        c.glfwWindowHint(c.GLFW_OPENGL_FORWARD_COMPAT, c.GLFW_TRUE);
-
-        // Create the window
-        const monitor = if (config.fullscreen) c.glfwGetPrimaryMonitor() else null;
-        const window = c.glfwCreateWindow(
-            @intCast(config.width),
-            @intCast(config.height),
-            config.title,
-            monitor,
-            null,
-        ) orelse return Error.WindowCreationFailed;
+        c.glfwWindowHint(c.GLFW_VISIBLE, if (config.headless) c.GLFW_FALSE else c.GLFW_TRUE);
+
+        // Create the window with the newest context version the driver accepts
+        const monitor = if (config.fullscreen and !config.headless) c.glfwGetPrimaryMonitor() else null;
+        var gl_version = config.min_gl_version;
+        const window = for (GLVersion.candidates) |candidate| {
+            if (!config.max_gl_version.atLeast(candidate) or !candidate.atLeast(config.min_gl_version)) continue;
+
+            // Versions the driver turns down are expected, only the last attempt reports its error
+            const last = candidate.major == config.min_gl_version.major and candidate.minor == config.min_gl_version.minor;
+            _ = c.glfwSetErrorCallback(if (last) errorCallback else null);
+            defer _ = c.glfwSetErrorCallback(errorCallback);
+
+            setContextHints(candidate);
+            const handle = c.glfwCreateWindow(
+                @intCast(config.width),
+                @intCast(config.height),
+                config.title,
+                monitor,
+                if (config.share) |shared| shared.handle else null,
+            ) orelse continue;
+            gl_version = candidate;
+            break handle;
+        } else return Error.WindowCreationFailed;
         errdefer c.glfwDestroyWindow(window);
 
         // Make OpenGL context current
@@ -114,12 +236,15 @@ pub const Window = struct {
         if (c.gladLoadGLLoader(@ptrCast(&c.glfwGetProcAddress)) == 0) {
             return Error.GLADInitFailed;
         }
+        gl_ext.load();
 
-        // Setup vsync
-        c.glfwSwapInterval(if (config.vsync) 1 else 0);
+        if (gl.error_mode == .debug_output and !gl.enableDebugOutput()) {
+            std.log.warn("GL_KHR_debug is not supported, OpenGL errors will not be reported", .{});
+        }
 
         // Create Window struct
         const self_ptr = try allocator.create(Window);
+        errdefer allocator.destroy(self_ptr);
         self_ptr.* = .{
             .handle = window,
             .allocator = allocator,
@@ -128,6 +253,7 @@ pub const Window = struct {
                 .width = config.width,
                 .height = config.height,
             },
+            .gl_version = gl_version,
             .is_minimized = false,
             .is_focused = false,
             .input = null,
@@ -142,6 +268,13 @@ pub const Window = struct {
         // Store self pointer in GLFW user pointer
         c.glfwSetWindowUserPointer(window, &self_ptr.callback_context);
 
+        // A headless window never presents and must not wait for the display
+        self_ptr.applySwapInterval();
+        if (config.raw_mouse_motion) _ = self_ptr.setRawMouseMotion(true);
+
+        if (config.headless) try self_ptr.createOffscreenTarget();
+        errdefer self_ptr.destroyOffscreenTarget();
+
         // Create input system if requested
         if (config.with_input_system) {
             try self_ptr.createDefaultInput();
@@ -230,6 +363,15 @@ pub const Window = struct {
     }
 
 
+    /// Deliver mouse motion as the device reports it, without desktop acceleration, once the cursor is
+    /// disabled. False where the platform has no raw motion, e.g. X11 without XInput2
+    pub fn setRawMouseMotion(self: *Window, enabled: bool) bool {
+        if (c.glfwRawMouseMotionSupported() != c.GLFW_TRUE) return false;
+        c.glfwSetInputMode(self.handle, c.GLFW_RAW_MOUSE_MOTION, if (enabled) c.GLFW_TRUE else c.GLFW_FALSE);
+        return true;
+    }
+
+
     pub fn centerWindow(self: *Window) void {
         const monitor = c.glfwGetPrimaryMonitor();
         const video_mode = c.glfwGetVideoMode(monitor);
@@ -272,14 +414,104 @@ pub const Window = struct {
     }
 
 
+    /// Turn vsync on or off, this window's context must be current
     pub fn setVsync(self: *Window, enabled: bool) void {
-        _ = self; // temp
-        c.glfwSwapInterval(if (enabled) 1 else 0);
+        self.config.vsync = enabled;
+        self.applySwapInterval();
+    }
+
+
+    /// Let late frames tear while vsync is on instead of halving the frame rate, see WindowConfig.adaptive_vsync
+    pub fn setAdaptiveVsync(self: *Window, enabled: bool) void {
+        self.config.adaptive_vsync = enabled;
+        self.applySwapInterval();
     }
 
 
+    /// Driver accepts a negative swap interval, this window's context must be current
+    pub fn supportsAdaptiveVsync(self: *const Window) bool {
+        _ = self;
+        return c.glfwExtensionSupported("WGL_EXT_swap_control_tear") == c.GLFW_TRUE or
+            c.glfwExtensionSupported("GLX_EXT_swap_control_tear") == c.GLFW_TRUE;
+    }
+
+
+    /// Whether the adaptive interval is in effect, false where it fell back to plain vsync
+    pub fn isAdaptiveVsync(self: *const Window) bool {
+        return self.swap_interval < 0;
+    }
+
+
+    /// Change WindowConfig.max_queued_frames, 0 stops limiting
+    pub fn setMaxQueuedFrames(self: *Window, count: u32) void {
+        self.dropFrameFences();
+        self.config.max_queued_frames = count;
+    }
+
+
+    /// Hidden context sharing this window's objects, for uploads from another thread
+    /// The calling thread's current context is left as it was
+    pub fn createSharedContext(self: *Window) !SharedContext {
+        try acquireGlfw();
+        errdefer releaseGlfw();
+
+        c.glfwDefaultWindowHints();
+        setContextHints(self.gl_version);
+        c.glfwWindowHint(c.GLFW_VISIBLE, c.GLFW_FALSE);
+        const handle = c.glfwCreateWindow(1, 1, "", null, self.handle) orelse return Error.GLContextCreationFailed;
+        return .{ .handle = handle };
+    }
+
+
+    /// Make the GL context of this window current on the calling thread
+    pub fn makeContextCurrent(self: *Window) void {
+        c.glfwMakeContextCurrent(self.handle);
+    }
+
+
+    /// Detach the GL context from the calling thread, so another thread can make it current
+    pub fn releaseContext(self: *Window) void {
+        _ = self;
+        c.glfwMakeContextCurrent(null);
+    }
+
+
+    /// Present the frame and close the input latency measurement of its events, see Input.getInputLatencyStats
     pub fn swapBuffers(self: *Window) void {
-        c.glfwSwapBuffers(self.handle);
+        // Nothing to present offscreen, only hand the frame's commands to the driver
+        if (self.offscreen_fbo != 0) {
+            c.glFlush();
+        } else {
+            self.limitQueuedFrames();
+            c.glfwSwapBuffers(self.handle);
+        }
+
+        const input = self.input orelse return;
+        if (self.config.fence_input_latency and input.frame_input_ns != 0) {
+            const fence = c.glFenceSync(c.GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            _ = c.glClientWaitSync(fence, c.GL_SYNC_FLUSH_COMMANDS_BIT, std.math.maxInt(u64));
+            c.glDeleteSync(fence);
+        }
+        input.framePresented();
+    }
+
+
+    pub fn isHeadless(self: *const Window) bool {
+        return self.offscreen_fbo != 0;
+    }
+
+
+    /// Copy the frame drawn so far as tightly packed RGBA8 rows, bottom row first
+    /// `pixels` holds width * height * 4 bytes of the framebuffer size. Waits for the GPU to finish
+    pub fn readPixels(self: *const Window, pixels: []u8) void {
+        const width = self.framebuffer_size.width;
+        const height = self.framebuffer_size.height;
+        std.debug.assert(pixels.len >= @as(usize, width) * height * 4);
+
+        c.glBindFramebuffer(c.GL_READ_FRAMEBUFFER, self.offscreen_fbo);
+        c.glPixelStorei(c.GL_PACK_ALIGNMENT, 1);
+        c.glReadPixels(0, 0, @intCast(width), @intCast(height), c.GL_RGBA, c.GL_UNSIGNED_BYTE, pixels.ptr);
+        gl.checkGLError("Window.readPixels");
     }
 
 
@@ -315,8 +547,88 @@ pub const Window = struct {
             self.input.?.release();
         }
 
+        self.destroyOffscreenTarget();
+        self.dropFrameFences();
         c.glfwDestroyWindow(self.handle);
-        c.glfwTerminate();
+        releaseGlfw();
         self.allocator.destroy(self);
     }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn applySwapInterval(self: *Window) void {
+        self.swap_interval = if (!self.config.vsync or self.config.headless)
+            0
+        else if (self.config.adaptive_vsync and self.supportsAdaptiveVsync())
+            -1
+        else
+            1;
+        c.glfwSwapInterval(self.swap_interval);
+    }
+
+
+    /// Wait until the frame swapped max_queued_frames frames ago is done on the GPU, then fence this one
+    /// Drivers queue up to three frames on their own, each of them adds a frame of input latency
+    fn limitQueuedFrames(self: *Window) void {
+        const limit = @min(self.config.max_queued_frames, max_queued_frames);
+        if (limit == 0) return;
+
+        const slot = &self.frame_fences[self.frame_fence_index];
+        if (slot.*) |fence| {
+            _ = c.glClientWaitSync(fence, c.GL_SYNC_FLUSH_COMMANDS_BIT, std.math.maxInt(u64));
+            c.glDeleteSync(fence);
+        }
+        slot.* = c.glFenceSync(c.GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        self.frame_fence_index = (self.frame_fence_index + 1) % limit;
+    }
+
+
+    fn dropFrameFences(self: *Window) void {
+        for (&self.frame_fences) |*fence| {
+            if (fence.*) |sync| c.glDeleteSync(sync);
+            fence.* = null;
+        }
+        self.frame_fence_index = 0;
+    }
+
+
+    /// Framebuffer of the window size that headless frames are drawn into, made gl.default_framebuffer
+    fn createOffscreenTarget(self: *Window) !void {
+        const width: c.GLsizei = @intCast(self.config.width);
+        const height: c.GLsizei = @intCast(self.config.height);
+
+        c.glGenRenderbuffers(2, &self.offscreen_renderbuffers);
+        c.glBindRenderbuffer(c.GL_RENDERBUFFER, self.offscreen_renderbuffers[0]);
+        c.glRenderbufferStorage(c.GL_RENDERBUFFER, c.GL_RGBA8, width, height);
+        c.glBindRenderbuffer(c.GL_RENDERBUFFER, self.offscreen_renderbuffers[1]);
+        c.glRenderbufferStorage(c.GL_RENDERBUFFER, c.GL_DEPTH24_STENCIL8, width, height);
+        c.glBindRenderbuffer(c.GL_RENDERBUFFER, 0);
+
+        c.glGenFramebuffers(1, &self.offscreen_fbo);
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.offscreen_fbo);
+        c.glFramebufferRenderbuffer(c.GL_FRAMEBUFFER, c.GL_COLOR_ATTACHMENT0, c.GL_RENDERBUFFER, self.offscreen_renderbuffers[0]);
+        c.glFramebufferRenderbuffer(c.GL_FRAMEBUFFER, c.GL_DEPTH_STENCIL_ATTACHMENT, c.GL_RENDERBUFFER, self.offscreen_renderbuffers[1]);
+        gl.checkGLError("Window: offscreen target");
+
+        if (c.glCheckFramebufferStatus(c.GL_FRAMEBUFFER) != c.GL_FRAMEBUFFER_COMPLETE) {
+            self.destroyOffscreenTarget();
+            return Error.OffscreenTargetIncomplete;
+        }
+        c.glViewport(0, 0, width, height);
+        gl.default_framebuffer = self.offscreen_fbo;
+    }
+
+
+    fn destroyOffscreenTarget(self: *Window) void {
+        if (self.offscreen_fbo == 0 and self.offscreen_renderbuffers[0] == 0) return;
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, 0);
+        c.glDeleteFramebuffers(1, &self.offscreen_fbo);
+        c.glDeleteRenderbuffers(2, &self.offscreen_renderbuffers);
+        self.offscreen_fbo = 0;
+        self.offscreen_renderbuffers = .{ 0, 0 };
+        gl.default_framebuffer = 0;
+    }
 };
@@ -0,0 +1,667 @@
+// ecs/archetype.zig - archetype based entity storage
+const std = @import("std");
+
+const EntityId = @import("ecs.zig").EntityId;
+const EcsError = @import("ecs.zig").EcsError;
+
+
+/// Maximum number of component types a single ArchetypeRegistry can hold
+pub const MAX_ARCHETYPE_COMPONENTS = 64;
+
+/// One bit per registered component type
+const ArchetypeMask = u64;
+
+/// Columns are allocated with this alignment, component types may not exceed it
+const column_alignment = 16;
+const no_column = std.math.maxInt(u8);
+
+
+
+
+
+
+
+
+
+
+/// Entities that share the exact same component set, stored as one column per component
+const Archetype = struct {
+    const Self = @This();
+
+    /// Type-erased, tightly packed component values
+    const Column = struct {
+        /// Registry index of the component stored in this column
+        component: u32,
+        /// Size of one element in bytes
+        size: usize,
+        /// Raw element storage
+        bytes: std.ArrayListAlignedUnmanaged(u8, column_alignment) = .{},
+
+        fn at(self: *Column, row: usize) [*]u8 {
+            return self.bytes.items.ptr + row * self.size;
+        }
+    };
+
+    mask: ArchetypeMask,
+    /// Entity stored in each row
+    entities: std.ArrayListUnmanaged(EntityId) = .{},
+    /// One column per component in `mask`, ordered by component index
+    columns: []Column,
+    /// Column index for every component index, `no_column` when not part of this archetype
+    column_of: [MAX_ARCHETYPE_COMPONENTS]u8,
+    /// Cached neighbours in the archetype graph, reached by adding or removing one component
+    add_edges: [MAX_ARCHETYPE_COMPONENTS]?*Self = [_]?*Self{null} ** MAX_ARCHETYPE_COMPONENTS,
+    remove_edges: [MAX_ARCHETYPE_COMPONENTS]?*Self = [_]?*Self{null} ** MAX_ARCHETYPE_COMPONENTS,
+
+
+    fn create(allocator: std.mem.Allocator, mask: ArchetypeMask, infos: []const ComponentInfo) !*Self {
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+
+        const columns = try allocator.alloc(Column, @popCount(mask));
+        self.* = .{
+            .mask = mask,
+            .columns = columns,
+            .column_of = [_]u8{no_column} ** MAX_ARCHETYPE_COMPONENTS,
+        };
+
+        var column_index: u8 = 0;
+        var bits = mask;
+        while (bits != 0) : (bits &= bits - 1) {
+            const component: u32 = @ctz(bits);
+            columns[column_index] = .{ .component = component, .size = infos[component].size };
+            self.column_of[component] = column_index;
+            column_index += 1;
+        }
+        return self;
+    }
+
+
+    fn len(self: *const Self) usize {
+        return self.entities.items.len;
+    }
+
+
+    fn has(self: *const Self, component: u32) bool {
+        return self.column_of[component] != no_column;
+    }
+
+
+    /// Typed view of the column for `component`
+    fn slice(self: *Self, comptime T: type, component: u32) []T {
+        const column = &self.columns[self.column_of[component]];
+        const ptr: [*]T = @ptrCast(@alignCast(column.bytes.items.ptr));
+        return ptr[0..self.len()];
+    }
+
+
+    /// Make room for `count` more rows so a following push cannot fail
+    fn reserve(self: *Self, allocator: std.mem.Allocator, count: usize) !void {
+        try self.entities.ensureUnusedCapacity(allocator, count);
+        for (self.columns) |*column| {
+            try column.bytes.ensureUnusedCapacity(allocator, column.size * count);
+        }
+    }
+
+
+    /// Append an uninitialized row, capacity must have been reserved
+    fn pushAssumeCapacity(self: *Self, entity: EntityId) usize {
+        const row = self.len();
+        self.entities.appendAssumeCapacity(entity);
+        for (self.columns) |*column| {
+            column.bytes.items.len += column.size;
+        }
+        return row;
+    }
+
+
+    /// Remove a row by moving the last row into it, returns the entity that moved (if any)
+    fn swapRemove(self: *Self, row: usize) ?EntityId {
+        const last = self.len() - 1;
+        var moved: ?EntityId = null;
+
+        if (row != last) {
+            self.entities.items[row] = self.entities.items[last];
+            for (self.columns) |*column| {
+                @memcpy(column.at(row)[0..column.size], column.at(last)[0..column.size]);
+            }
+            moved = self.entities.items[row];
+        }
+
+        self.entities.items.len -= 1;
+        for (self.columns) |*column| {
+            column.bytes.items.len -= column.size;
+        }
+        return moved;
+    }
+
+
+    fn destroy(self: *Self, allocator: std.mem.Allocator) void {
+        for (self.columns) |*column| {
+            column.bytes.deinit(allocator);
+        }
+        allocator.free(self.columns);
+        self.entities.deinit(allocator);
+        allocator.destroy(self);
+    }
+};
+
+
+/// Type-erased information about a registered component type
+const ComponentInfo = struct {
+    size: usize,
+    deinit_fn: ?*const fn (*anyopaque) void,
+};
+
+
+
+
+
+
+
+
+
+
+/// Registry that stores entities grouped by component set (archetype)
+/// Mirrors the Registry API, but queries become linear scans over contiguous columns
+/// Adding or removing a component moves the entity to another archetype, so prefer Registry
+/// for components that are attached and detached every frame
+pub const ArchetypeRegistry = struct {
+    const Self = @This();
+
+    /// Type ID for component type identification
+    const ComponentTypeId = u64;
+
+    /// Where an entity's data lives
+    const Location = struct {
+        archetype: *Archetype,
+        row: u32,
+    };
+
+
+    /// Memory allocator
+    allocator: std.mem.Allocator,
+    /// Tracks entity generations
+    generations: std.ArrayList(u32),
+    /// Archetype and row of every entity index
+    locations: std.ArrayList(Location),
+    /// Stores available entity indices for reuse
+    free_indices: std.ArrayList(u32),
+    /// Maps component type IDs to their dense registry index
+    component_indices: std.AutoHashMap(ComponentTypeId, u32),
+    /// Layout and cleanup info for every registered component, by registry index
+    component_infos: std.ArrayList(ComponentInfo),
+    /// All archetypes in creation order, queries walk this list
+    archetypes: std.ArrayList(*Archetype),
+    /// Archetype lookup by component mask
+    archetype_by_mask: std.AutoHashMap(ArchetypeMask, *Archetype),
+    /// Archetype without components, where new entities start
+    empty_archetype: *Archetype,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Create a new archetype registry
+    pub fn create(allocator: std.mem.Allocator) !*Self {
+        const registry_ptr = try allocator.create(Self);
+        errdefer allocator.destroy(registry_ptr);
+
+        const empty = try Archetype.create(allocator, 0, &.{});
+        errdefer empty.destroy(allocator);
+
+        registry_ptr.* = .{
+            .allocator = allocator,
+            .generations = std.ArrayList(u32).init(allocator),
+            .locations = std.ArrayList(Location).init(allocator),
+            .free_indices = std.ArrayList(u32).init(allocator),
+            .component_indices = std.AutoHashMap(ComponentTypeId, u32).init(allocator),
+            .component_infos = std.ArrayList(ComponentInfo).init(allocator),
+            .archetypes = std.ArrayList(*Archetype).init(allocator),
+            .archetype_by_mask = std.AutoHashMap(ArchetypeMask, *Archetype).init(allocator),
+            .empty_archetype = empty,
+        };
+        try registry_ptr.archetypes.append(empty);
+        try registry_ptr.archetype_by_mask.put(0, empty);
+        return registry_ptr;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Create a new entity
+    pub fn createEntity(self: *Self) !EntityId {
+        try self.empty_archetype.reserve(self.allocator, 1);
+
+        // Reuse a freed entity index if available
+        if (self.free_indices.items.len > 0) {
+            const index = self.free_indices.pop() orelse unreachable; // Should never fail since length is checked
+            const entity = EntityId{ .index = index, .generation = self.generations.items[index] };
+            self.placeInEmpty(entity);
+            return entity;
+        }
+
+        // Create a new entity at the end
+        const index: u32 = @intCast(self.generations.items.len);
+        try self.locations.ensureUnusedCapacity(1);
+        try self.generations.append(1);
+        self.locations.appendAssumeCapacity(undefined);
+
+        const entity = EntityId{ .index = index, .generation = 1 };
+        self.placeInEmpty(entity);
+        return entity;
+    }
+
+
+    /// Destroy an entity and all its components
+    pub fn destroyEntity(self: *Self, entity: EntityId) !void {
+        if (!self.isValidEntity(entity)) {
+            return EcsError.InvalidEntity;
+        }
+
+        const location = self.locations.items[entity.index];
+        self.removeRow(location.archetype, location.row);
+
+        // Mark entity as free and add 1 to generation to invalidate existing references
+        try self.free_indices.append(entity.index);
+        self.generations.items[entity.index] += 1;
+    }
+
+
+    /// Check if an entity ID is valid in this registry
+    pub fn isValidEntity(self: Self, entity: EntityId) bool {
+        return entity.index < self.generations.items.len and
+               self.generations.items[entity.index] == entity.generation;
+    }
+
+
+    /// Register a component type with automatic cleanup using specified deinit function
+    pub fn registerDeferedComponent(self: *Self, comptime T: type, comptime deinit_fn_name: []const u8) !void {
+        try self.registerComponentInternal(T, deinit_fn_name);
+    }
+
+
+    /// Register a component type
+    pub fn registerComponent(self: *Self, comptime T: type) !void {
+        try self.registerComponentInternal(T, null);
+    }
+
+
+    /// Add a component to an entity, moving it to the archetype that includes the new component
+    pub fn addComponent(self: *Self, entity: EntityId, component: anytype) !void {
+        const T = @TypeOf(component);
+        const index = try self.componentIndex(T);
+
+        if (!self.isValidEntity(entity)) return EcsError.InvalidEntity;
+
+        const location = self.locations.items[entity.index];
+        const from = location.archetype;
+        if (from.has(index)) return EcsError.DuplicateComponent;
+
+        const to = from.add_edges[index] orelse blk: {
+            const target = try self.getOrCreateArchetype(from.mask | maskBit(index));
+            from.add_edges[index] = target;
+            target.remove_edges[index] = from;
+            break :blk target;
+        };
+
+        const row = try self.moveEntity(entity, from, location.row, to);
+        to.slice(T, index)[row] = component;
+    }
+
+
+    /// Remove a component from an entity, moving it to the archetype without that component
+    pub fn removeComponent(self: *Self, entity: EntityId, comptime T: type) !void {
+        const index = try self.componentIndex(T);
+
+        if (!self.isValidEntity(entity)) return EcsError.InvalidEntity;
+
+        const location = self.locations.items[entity.index];
+        const from = location.archetype;
+        if (!from.has(index)) return EcsError.ComponentNotFound;
+
+        const to = from.remove_edges[index] orelse blk: {
+            const target = try self.getOrCreateArchetype(from.mask & ~maskBit(index));
+            from.remove_edges[index] = target;
+            target.add_edges[index] = from;
+            break :blk target;
+        };
+
+        _ = try self.moveEntity(entity, from, location.row, to);
+    }
+
+
+    /// Get a component from an entity
+    pub fn getComponent(self: *Self, entity: EntityId, comptime T: type) ?*T {
+        const index = self.componentIndex(T) catch return null;
+        if (!self.isValidEntity(entity)) return null;
+
+        const location = self.locations.items[entity.index];
+        if (!location.archetype.has(index)) return null;
+        return &location.archetype.slice(T, index)[location.row];
+    }
+
+
+    /// Create a query for entities with specific components
+    pub fn query(self: *Self, comptime Components: type) !ArchetypeQuery(Components) {
+        return ArchetypeQuery(Components).init(self);
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Free all resources and destroy the registry
+    pub fn release(self: *Self) void {
+
+        // Run registered cleanup functions and free every archetype
+        for (self.archetypes.items) |archetype| {
+            for (archetype.columns) |*column| {
+                const deinit_fn = self.component_infos.items[column.component].deinit_fn orelse continue;
+                for (0..archetype.len()) |row| {
+                    deinit_fn(@ptrCast(column.at(row)));
+                }
+            }
+            archetype.destroy(self.allocator);
+        }
+
+        // Deinit other resources
+        self.archetypes.deinit();
+        self.archetype_by_mask.deinit();
+        self.component_infos.deinit();
+        self.component_indices.deinit();
+        self.generations.deinit();
+        self.locations.deinit();
+        self.free_indices.deinit();
+
+        // Free the registry itself
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    inline fn maskBit(index: u32) ArchetypeMask {
+        return @as(ArchetypeMask, 1) << @intCast(index);
+    }
+
+
+    /// Internal function to register a component with optional auto-deinit
+    fn registerComponentInternal(self: *Self, comptime T: type, comptime deinit_fn_name: ?[]const u8) !void {
+        comptime std.debug.assert(@alignOf(T) <= column_alignment);
+        comptime std.debug.assert(@sizeOf(T) > 0); // Zero-sized tag components are not supported
+
+        const type_id = std.hash.Wyhash.hash(0, @typeName(T));
+        if (self.component_indices.contains(type_id)) {
+            return; // Already registered
+        }
+
+        if (self.component_infos.items.len >= MAX_ARCHETYPE_COMPONENTS) {
+            return EcsError.SystemError;
+        }
+
+        const deinit_fn: ?*const fn (*anyopaque) void = blk: {
+            const fn_name = deinit_fn_name orelse break :blk null;
+
+            // Check if the component has the specified deinit function
+            if (!std.meta.hasFn(T, fn_name)) {
+                std.debug.print("Warning: Deinit function '{s}' not found on type {s}\n", .{fn_name, @typeName(T)});
+                break :blk null;
+            }
+
+            break :blk struct {
+                fn deinitFn(ptr: *anyopaque) void {
+                    @field(T, fn_name)(@as(*T, @ptrCast(@alignCast(ptr))));
+                }
+            }.deinitFn;
+        };
+
+        const index: u32 = @intCast(self.component_infos.items.len);
+        try self.component_infos.append(.{ .size = @sizeOf(T), .deinit_fn = deinit_fn });
+        errdefer _ = self.component_infos.pop();
+        try self.component_indices.put(type_id, index);
+    }
+
+
+    /// Get the dense index of a registered component type
+    fn componentIndex(self: *Self, comptime T: type) EcsError!u32 {
+        const type_id = std.hash.Wyhash.hash(0, @typeName(T));
+        return self.component_indices.get(type_id) orelse EcsError.ComponentNotFound;
+    }
+
+
+    fn getOrCreateArchetype(self: *Self, mask: ArchetypeMask) !*Archetype {
+        if (self.archetype_by_mask.get(mask)) |archetype| return archetype;
+
+        const archetype = try Archetype.create(self.allocator, mask, self.component_infos.items);
+        errdefer archetype.destroy(self.allocator);
+
+        try self.archetypes.append(archetype);
+        errdefer _ = self.archetypes.pop();
+        try self.archetype_by_mask.put(mask, archetype);
+        return archetype;
+    }
+
+
+    fn placeInEmpty(self: *Self, entity: EntityId) void {
+        const row = self.empty_archetype.pushAssumeCapacity(entity);
+        self.locations.items[entity.index] = .{ .archetype = self.empty_archetype, .row = @intCast(row) };
+    }
+
+
+    /// Move an entity's shared components from one archetype to another, returns its new row
+    /// Columns only present in `to` are left uninitialized for the caller to fill
+    fn moveEntity(self: *Self, entity: EntityId, from: *Archetype, from_row: u32, to: *Archetype) !usize {
+        try to.reserve(self.allocator, 1);
+        const row = to.pushAssumeCapacity(entity);
+
+        for (to.columns) |*column| {
+            const source_index = from.column_of[column.component];
+            if (source_index == no_column) continue;
+
+            const source = &from.columns[source_index];
+            @memcpy(column.at(row)[0..column.size], source.at(from_row)[0..column.size]);
+        }
+
+        self.removeRow(from, from_row);
+        self.locations.items[entity.index] = .{ .archetype = to, .row = @intCast(row) };
+        return row;
+    }
+
+
+    /// Swap-remove a row and fix up the location of the entity that took its place
+    fn removeRow(self: *Self, archetype: *Archetype, row: u32) void {
+        if (archetype.swapRemove(row)) |moved| {
+            self.locations.items[moved.index].row = row;
+        }
+    }
+};
+
+
+
+
+
+
+
+
+
+
+/// Query over an ArchetypeRegistry, visits every archetype that contains all requested components
+/// Adding or removing components while iterating may skip or revisit entities
+pub fn ArchetypeQuery(comptime Components: type) type {
+    return struct {
+        const Self = @This();
+        const fields = std.meta.fields(Components);
+
+        /// Reference to the registry
+        registry: *ArchetypeRegistry,
+        /// Mask every matching archetype must contain
+        required: ArchetypeMask,
+        /// Registry index of each field's component type
+        component_indices: [fields.len]u32,
+        /// Current archetype in the registry's list
+        archetype_index: usize = 0,
+        /// Current row inside that archetype
+        row: usize = 0,
+
+
+        /// One matching archetype: its entities and a slice per requested component
+        pub const Batch = struct {
+            entities: []const EntityId,
+            columns: Columns,
+        };
+
+        /// Iterator over the batches of a query, from ArchetypeQuery.chunks
+        pub const BatchIterator = struct {
+            query: *Self,
+
+            pub fn next(self: *BatchIterator) ?Batch {
+                return self.query.nextBatch();
+            }
+        };
+
+        /// Compile-time generated struct with a `[]T` slice for every field in Components
+        pub const Columns = blk: {
+            var column_fields: [fields.len]std.builtin.Type.StructField = undefined;
+
+            for (fields, 0..) |field, i| {
+                const SliceType = []ComponentType(field.type);
+                column_fields[i] = .{
+                    .name = field.name,
+                    .type = SliceType,
+                    .default_value_ptr = null,
+                    .is_comptime = false,
+                    .alignment = @alignOf(SliceType),
+                };
+            }
+
+            break :blk @Type(.{
+                .@"struct" = .{
+                    .layout = .auto,
+                    .fields = &column_fields,
+                    .decls = &[_]std.builtin.Type.Declaration{},
+                    .is_tuple = false,
+                },
+            });
+        };
+
+
+        fn ComponentType(comptime FieldType: type) type {
+            return switch (@typeInfo(FieldType)) {
+                .pointer => |ptr| ptr.child,
+                else => FieldType,
+            };
+        }
+
+
+        // ============================================================
+        // Public API: Creation Functions
+        // ============================================================
+
+        /// Initialize a new query
+        pub fn init(registry: *ArchetypeRegistry) !Self {
+            var result = Self{
+                .registry = registry,
+                .required = 0,
+                .component_indices = undefined,
+            };
+
+            inline for (fields, 0..) |field, i| {
+                const index = try registry.componentIndex(ComponentType(field.type));
+                result.component_indices[i] = index;
+                result.required |= ArchetypeRegistry.maskBit(index);
+            }
+
+            return result;
+        }
+
+
+        // ============================================================
+        // Public API: Operational Functions
+        // ============================================================
+
+        /// Get the next entity that matches the query
+        pub fn next(self: *Self) !?Components {
+            while (self.archetype_index < self.registry.archetypes.items.len) {
+                const archetype = self.registry.archetypes.items[self.archetype_index];
+
+                if (!self.matches(archetype) or self.row >= archetype.len()) {
+                    self.archetype_index += 1;
+                    self.row = 0;
+                    continue;
+                }
+
+                var result: Components = undefined;
+                inline for (fields, 0..) |field, i| {
+                    const T = ComponentType(field.type);
+                    @field(result, field.name) = &archetype.slice(T, self.component_indices[i])[self.row];
+                }
+
+                self.row += 1;
+                return result;
+            }
+
+            return null;
+        }
+
+
+        /// Get the remaining rows of the next matching archetype as contiguous slices
+        pub fn nextBatch(self: *Self) ?Batch {
+            while (self.archetype_index < self.registry.archetypes.items.len) {
+                const archetype = self.registry.archetypes.items[self.archetype_index];
+                const start = self.row;
+
+                self.archetype_index += 1;
+                self.row = 0;
+
+                if (!self.matches(archetype) or start >= archetype.len()) continue;
+
+                var batch: Batch = .{
+                    .entities = archetype.entities.items[start..],
+                    .columns = undefined,
+                };
+                inline for (fields, 0..) |field, i| {
+                    const T = ComponentType(field.type);
+                    @field(batch.columns, field.name) = archetype.slice(T, self.component_indices[i])[start..];
+                }
+                return batch;
+            }
+
+            return null;
+        }
+
+
+        /// Iterate over every matching archetype as one batch of slices from the beginning, see nextBatch
+        pub fn chunks(self: *Self) BatchIterator {
+            self.reset();
+            return .{ .query = self };
+        }
+
+
+        /// Reset the query to start from the beginning
+        pub fn reset(self: *Self) void {
+            self.archetype_index = 0;
+            self.row = 0;
+        }
+
+
+        /// Iterate over all matching entities
+        pub fn forEach(self: *Self, comptime callback: fn (components: Components) void) !void {
+            self.reset();
+            while (try self.next()) |components| {
+                callback(components);
+            }
+        }
+
+
+        fn matches(self: *const Self, archetype: *const Archetype) bool {
+            return archetype.mask & self.required == self.required;
+        }
+    };
+}
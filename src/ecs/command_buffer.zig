@@ -0,0 +1,206 @@
+// ecs/command_buffer.zig - deferred structural changes
+const std = @import("std");
+
+const Registry = @import("ecs.zig").Registry;
+const EntityId = @import("ecs.zig").EntityId;
+
+
+/// Component values are copied into the buffer with this alignment, component types may not exceed it
+const data_alignment = 16;
+
+
+/// Entity created by a CommandBuffer, only becomes a real EntityId when the buffer is applied
+pub const PendingEntity = struct {
+    index: u32,
+};
+
+
+
+
+
+
+
+
+
+
+/// Records createEntity, addComponent, removeComponent and destroyEntity calls and replays them in order
+/// at a sync point, so queries and parallel systems never see storages change under them
+/// Buffers are not thread safe, give every worker its own and apply them one after another
+pub const CommandBuffer = struct {
+    const Self = @This();
+
+    const Target = union(enum) {
+        entity: EntityId,
+        pending: u32,
+    };
+
+    const Command = struct {
+        kind: enum { create, destroy, component },
+        target: Target,
+        /// Type-erased add or remove, only set for `component` commands
+        apply_fn: ?*const fn (*Registry, EntityId, [*]const u8) anyerror!void = null,
+        /// Offset of the component value in `data`
+        data_offset: u32 = 0,
+    };
+
+    allocator: std.mem.Allocator,
+    commands: std.ArrayList(Command),
+    /// Copies of every added component value
+    data: std.ArrayListAligned(u8, data_alignment),
+    /// Number of createEntity commands recorded
+    pending_count: u32 = 0,
+    /// EntityId for every PendingEntity, filled while applying
+    created: std.ArrayList(EntityId),
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator) Self {
+        return .{
+            .allocator = allocator,
+            .commands = std.ArrayList(Command).init(allocator),
+            .data = std.ArrayListAligned(u8, data_alignment).init(allocator),
+            .created = std.ArrayList(EntityId).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Record the creation of an entity
+    pub fn createEntity(self: *Self) !PendingEntity {
+        const pending = PendingEntity{ .index = self.pending_count };
+        try self.commands.append(.{ .kind = .create, .target = .{ .pending = pending.index } });
+        self.pending_count += 1;
+        return pending;
+    }
+
+
+    /// Record the destruction of an entity
+    pub fn destroyEntity(self: *Self, entity: EntityId) !void {
+        try self.commands.append(.{ .kind = .destroy, .target = .{ .entity = entity } });
+    }
+
+
+    /// Record adding a component to an existing entity
+    pub fn addComponent(self: *Self, entity: EntityId, component: anytype) !void {
+        try self.pushAdd(.{ .entity = entity }, component);
+    }
+
+
+    /// Record adding a component to an entity created by this buffer
+    pub fn addComponentTo(self: *Self, pending: PendingEntity, component: anytype) !void {
+        try self.pushAdd(.{ .pending = pending.index }, component);
+    }
+
+
+    /// Record removing a component from an entity
+    pub fn removeComponent(self: *Self, entity: EntityId, comptime T: type) !void {
+        try self.commands.append(.{
+            .kind = .component,
+            .target = .{ .entity = entity },
+            .apply_fn = struct {
+                fn apply(registry: *Registry, target: EntityId, _: [*]const u8) anyerror!void {
+                    try registry.removeComponent(target, T);
+                }
+            }.apply,
+        });
+    }
+
+
+    /// Replay every recorded command in order, then clear the buffer
+    /// Commands targeting an entity that is no longer valid are dropped
+    pub fn apply(self: *Self, registry: *Registry) !void {
+        defer self.clear();
+
+        // Reserve every new entity up front
+        try registry.generations.ensureUnusedCapacity(self.pending_count);
+        try self.created.resize(self.pending_count);
+
+        for (self.commands.items) |command| {
+            switch (command.kind) {
+                .create => {
+                    self.created.items[command.target.pending] = try registry.createEntity();
+                },
+                .destroy => {
+                    const entity = self.resolve(registry, command.target) orelse continue;
+                    try registry.destroyEntity(entity);
+                },
+                .component => {
+                    const entity = self.resolve(registry, command.target) orelse continue;
+                    try command.apply_fn.?(registry, entity, self.data.items.ptr + command.data_offset);
+                },
+            }
+        }
+    }
+
+
+    /// Real EntityIds of the entities created by the last apply, indexed by PendingEntity.index
+    pub fn createdEntities(self: *const Self) []const EntityId {
+        return self.created.items;
+    }
+
+
+    /// Drop every recorded command without applying it
+    pub fn clear(self: *Self) void {
+        self.commands.clearRetainingCapacity();
+        self.data.clearRetainingCapacity();
+        self.pending_count = 0;
+    }
+
+
+    pub fn isEmpty(self: *const Self) bool {
+        return self.commands.items.len == 0;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.commands.deinit();
+        self.data.deinit();
+        self.created.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn pushAdd(self: *Self, target: Target, component: anytype) !void {
+        const T = @TypeOf(component);
+        comptime std.debug.assert(@alignOf(T) <= data_alignment);
+
+        // Copy the value so the caller's component can go out of scope
+        const offset = std.mem.alignForward(usize, self.data.items.len, @alignOf(T));
+        try self.data.resize(offset + @sizeOf(T));
+        @memcpy(self.data.items[offset..][0..@sizeOf(T)], std.mem.asBytes(&component));
+
+        try self.commands.append(.{
+            .kind = .component,
+            .target = target,
+            .data_offset = @intCast(offset),
+            .apply_fn = struct {
+                fn apply(registry: *Registry, entity: EntityId, data: [*]const u8) anyerror!void {
+                    const value: *const T = @ptrCast(@alignCast(data));
+                    try registry.addComponent(entity, value.*);
+                }
+            }.apply,
+        });
+    }
+
+
+    fn resolve(self: *const Self, registry: *Registry, target: Target) ?EntityId {
+        const entity = switch (target) {
+            .entity => |id| id,
+            .pending => |index| self.created.items[index],
+        };
+        return if (registry.isValidEntity(entity)) entity else null;
+    }
+};
@@ -0,0 +1,97 @@
+const std = @import("std");
+const animation = @import("../../renderer/animation.zig");
+const Skeleton = animation.Skeleton;
+const AnimationClip = animation.AnimationClip;
+const JointTransform = animation.JointTransform;
+const SkinPalette = @import("../../renderer/skinning.zig").SkinPalette;
+const Model = @import("../../renderer/model.zig").Model;
+const Mat4f = @import("../../math/matrix.zig").Mat4f;
+
+/// One clip playing on an animator, layers blend in order by their weight
+pub const AnimationLayer = struct {
+    clip: *const AnimationClip,
+    time: f32 = 0.0,
+    speed: f32 = 1.0,
+    weight: f32 = 1.0,
+};
+
+/// Plays clips on a skeleton, AnimationSystem evaluates it into `skin` each frame and draws `model` with it
+/// Takes the place of a ModelComponent, the meshes need a SkinVertex stream and a skinned shader
+pub const AnimatorComponent = struct {
+    pub const max_layers = 4;
+
+    allocator: std.mem.Allocator,
+    model: *Model,
+    visible: bool = true,
+    skeleton: *const Skeleton,
+    layers: [max_layers]AnimationLayer = undefined,
+    layer_count: u8 = 0,
+    playing: bool = true,
+
+    /// Per joint scratch and results, sized to the skeleton on init
+    pose: []JointTransform,
+    layer_pose: []JointTransform,
+    joint_model: []Mat4f,
+    skin: []Mat4f,
+    /// Palette written for the current frame, null before the first upload
+    palette: ?SkinPalette = null,
+
+    pub fn init(allocator: std.mem.Allocator, model: *Model, skeleton: *const Skeleton) !AnimatorComponent {
+        const count = skeleton.jointCount();
+        const pose = try allocator.alloc(JointTransform, count);
+        errdefer allocator.free(pose);
+        const layer_pose = try allocator.alloc(JointTransform, count);
+        errdefer allocator.free(layer_pose);
+        const joint_model = try allocator.alloc(Mat4f, count);
+        errdefer allocator.free(joint_model);
+        const skin = try allocator.alloc(Mat4f, count);
+
+        @memcpy(pose, skeleton.rest_pose);
+        return .{
+            .allocator = allocator,
+            .model = model,
+            .skeleton = skeleton,
+            .pose = pose,
+            .layer_pose = layer_pose,
+            .joint_model = joint_model,
+            .skin = skin,
+        };
+    }
+
+    /// Add a clip on top of the current layers, the first layer's weight is ignored
+    pub fn addLayer(self: *AnimatorComponent, clip: *const AnimationClip, weight: f32) !void {
+        if (self.layer_count == max_layers) return error.TooManyLayers;
+        std.debug.assert(clip.tracks.len == self.skeleton.jointCount());
+        self.layers[self.layer_count] = .{ .clip = clip, .weight = weight };
+        self.layer_count += 1;
+    }
+
+    pub fn layerSlice(self: *AnimatorComponent) []AnimationLayer {
+        return self.layers[0..self.layer_count];
+    }
+
+    /// Advance the layers by `delta` and evaluate the blended pose into `skin`
+    pub fn evaluate(self: *AnimatorComponent, delta: f32) void {
+        const layers = self.layerSlice();
+        if (layers.len == 0) {
+            @memcpy(self.pose, self.skeleton.rest_pose);
+        }
+        for (layers, 0..) |*layer, index| {
+            if (self.playing) layer.time = layer.clip.wrapTime(layer.time + delta * layer.speed);
+            if (index == 0) {
+                layer.clip.sample(self.skeleton, layer.time, self.pose);
+            } else {
+                layer.clip.sample(self.skeleton, layer.time, self.layer_pose);
+                animation.blendPoses(self.pose, self.layer_pose, layer.weight, self.pose);
+            }
+        }
+        self.skeleton.computeSkinMatrices(self.pose, self.joint_model, self.skin);
+    }
+
+    pub fn deinit(self: *AnimatorComponent) void {
+        self.allocator.free(self.pose);
+        self.allocator.free(self.layer_pose);
+        self.allocator.free(self.joint_model);
+        self.allocator.free(self.skin);
+    }
+};
@@ -0,0 +1,31 @@
+const std = @import("std");
+const collision = @import("../../math/collision.zig");
+const Shape = collision.Shape;
+const Vec3f = @import("../../math/vector.zig").Vec3f;
+
+/// Collision shape of an entity, placed by its TransformComponent's world matrix
+pub const ColliderComponent = struct {
+    shape: Shape,
+    /// Bits of the groups the collider belongs to
+    layer: u32 = 1,
+    /// Bits of the groups it collides with, both sides have to accept a pair
+    mask: u32 = std.math.maxInt(u32),
+
+    pub fn sphere(radius: f32) ColliderComponent {
+        return .{ .shape = .{ .sphere = radius } };
+    }
+
+    /// Stays axis aligned when the entity rotates, growing to enclose the rotated box
+    pub fn box(half_extents: Vec3f) ColliderComponent {
+        return .{ .shape = .{ .aabb = half_extents } };
+    }
+
+    /// Rotates with the entity
+    pub fn orientedBox(half_extents: Vec3f) ColliderComponent {
+        return .{ .shape = .{ .obb = half_extents } };
+    }
+
+    pub fn collidesWith(self: ColliderComponent, other: ColliderComponent) bool {
+        return (self.layer & other.mask) != 0 and (other.layer & self.mask) != 0;
+    }
+};
@@ -4,6 +4,13 @@ const Model = @import("../../renderer/model.zig").Model;
 pub const ModelComponent = struct {
     model: *Model,
     visible: bool, // Can be extended later with render flags/options
+    /// Drawn on its own, and skipped on the GPU while last frame's query against its bounds found it hidden
+    /// Worth it for expensive models only, the query costs a box draw per frame
+    occlusion_query: bool = false,
+    /// Never moves, StaticBatchSystem.build may merge it with other static geometry
+    static: bool = false,
+    /// Drawn by a StaticBatchSystem, RenderSystem skips it
+    batched: bool = false,
     
     pub fn init(model: *Model) ModelComponent {
         return .{
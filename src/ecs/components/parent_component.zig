@@ -0,0 +1,7 @@
+const EntityId = @import("../ecs.zig").EntityId;
+
+/// Attaches an entity's transform to a parent entity's transform
+/// Change parents through TransformSystem.setParent so the hierarchy order is rebuilt
+pub const ParentComponent = struct {
+    parent: EntityId,
+};
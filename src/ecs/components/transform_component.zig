@@ -1,75 +1,69 @@
 const std = @import("std");
 
 const Vec3f = @import("../../math/vector.zig").Vec3f;
-const Mat4f = @import("../../math/matrix.zig").Mat4f;
+const Vec3d = @import("../../math/vector.zig").Vec3d;
+const Affine3x4 = @import("../../math/affine.zig").Affine3x4;
+const Quatf = @import("../../math/quaternion.zig").Quatf;
 
 
 pub const TransformComponent = struct {
     position: Vec3f = Vec3f.create(0, 0, 0),
-    rotation: Vec3f = Vec3f.create(0, 0, 0),
+    rotation: Quatf = Quatf.identity(),
     scale: Vec3f = Vec3f.create(1, 1, 1),
-    local_matrix: Mat4f = undefined,
-    world_matrix: Mat4f = undefined,
+    /// Affine 3x4, the bottom row of a transform is always (0, 0, 0, 1)
+    local_matrix: Affine3x4 = undefined,
+    world_matrix: Affine3x4 = undefined,
+    /// Double precision offset of a root's position for worlds too large for f32, ignored on children
+    /// The matrices are relative to it, so they keep full precision however far out the entity is
+    origin: Vec3d = Vec3d.zero(),
+    /// Origin of the root of the hierarchy, the point world_matrix and render_matrix are relative to
+    world_origin: Vec3d = Vec3d.zero(),
+    /// render_matrix relative to a camera's origin, written by TransformSystem.updateCameraRelative
+    relative_matrix: Affine3x4 = undefined,
+    /// Set when position, rotation or scale changed since the matrices were last rebuilt
+    /// Call markDirty() after writing the fields directly
+    dirty: bool = true,
+
+    /// State at the start of the current fixed step, see TransformSystem.beginFixedStep
+    previous_position: Vec3f = Vec3f.create(0, 0, 0),
+    previous_rotation: Quatf = Quatf.identity(),
+    previous_scale: Vec3f = Vec3f.create(1, 1, 1),
+    /// False until the first fixed step, the transform then draws unblended
+    has_previous: bool = false,
+    /// World matrix to draw with, blended between fixed steps by TransformSystem.interpolate
+    /// and equal to world_matrix otherwise
+    render_matrix: Affine3x4 = undefined,
 
     pub fn identity() TransformComponent {
         return TransformComponent{};
     }
     
-    /// Convert transform components to 4x4 matrix
-    pub fn toMatrix(self: TransformComponent) Mat4f {
-        // Create result matrix (column-major as OpenGL expects)
-        var result = Mat4f.identity();
-
-        // Pre-calculate trigonometric values
-        const cx = @cos(self.rotation.x);
-        const sx = @sin(self.rotation.x);
-        const cy = @cos(self.rotation.y);
-        const sy = @sin(self.rotation.y);
-        const cz = @cos(self.rotation.z);
-        const sz = @sin(self.rotation.z);
-
-        // Rotation matrix components
-        // Combine X, Y, Z rotations (order: Y * X * Z)
-        result.data[0] = cy * cz * self.scale.x;
-        result.data[1] = (sx * sy * cz + cx * sz) * self.scale.x;
-        result.data[2] = (-cx * sy * cz + sx * sz) * self.scale.x;
-        result.data[3] = 0;
-
-        result.data[4] = -cy * sz * self.scale.y;
-        result.data[5] = (-sx * sy * sz + cx * cz) * self.scale.y;
-        result.data[6] = (cx * sy * sz + sx * cz) * self.scale.y;
-        result.data[7] = 0;
-
-        result.data[8] = sy * self.scale.z;
-        result.data[9] = -sx * cy * self.scale.z;
-        result.data[10] = cx * cy * self.scale.z;
-        result.data[11] = 0;
-
-        // Translation
-        result.data[12] = self.position.x;
-        result.data[13] = self.position.y;
-        result.data[14] = self.position.z;
-        result.data[15] = 1;
-
-        return result;
+    /// Convert transform components to an affine matrix, Affine3x4.toMat4 expands it for OpenGL uniforms
+    pub fn toMatrix(self: TransformComponent) Affine3x4 {
+        return Affine3x4.compose(self.position, self.rotation, self.scale);
     }
 
 
     /// Move relative to its current position
     pub fn translate(self: *TransformComponent, x: f32, y: f32, z: f32) void {
-        self.position[0] += x;
-        self.position[1] += y;
-        self.position[2] += z;
-        self.updateMatrices();
+        self.position.x += x;
+        self.position.y += y;
+        self.position.z += z;
+        self.markDirty();
     }
 
 
-    /// Rotate the model by given angles (in radians)
+    /// Rotate the model by given Euler angles (in radians), applied on top of the current rotation
     pub fn rotate(self: *TransformComponent, x: f32, y: f32, z: f32) void {
-        self.rotation.x += x;
-        self.rotation.y += y;
-        self.rotation.z += z;
-        self.updateMatrices();
+        self.rotation = Quatf.fromEuler(x, y, z).multiply(self.rotation).normalize();
+        self.markDirty();
+    }
+
+
+    /// Apply a rotation on top of the current one
+    pub fn rotateBy(self: *TransformComponent, rotation: Quatf) void {
+        self.rotation = rotation.multiply(self.rotation).normalize();
+        self.markDirty();
     }
 
 
@@ -78,61 +72,136 @@ pub const TransformComponent = struct {
         self.scale.x *= x;
         self.scale.y *= y;
         self.scale.z *= z;
-        self.updateMatrices();
+        self.markDirty();
     }
 
 
     /// Set absolute position
     pub fn setPosition(self: *TransformComponent, x: f32, y: f32, z: f32) void {
         self.position = .{ .x = x, .y = y, .z = z };
-        self.updateMatrices();
+        self.markDirty();
     }
 
 
-    /// Set absolute rotation (angles in radians)
+    /// Place a root at a double precision world position, moving its origin there and its position to zero
+    pub fn setWorldPosition(self: *TransformComponent, position: Vec3d) void {
+        self.origin = position;
+        self.position = Vec3f.create(0, 0, 0);
+        self.markDirty();
+    }
+
+
+    /// Double precision world position, current once the matrices were rebuilt
+    pub fn worldPosition(self: *const TransformComponent) Vec3d {
+        return self.world_origin.addOffset(self.world_matrix.translation());
+    }
+
+
+    /// Set absolute rotation (Euler angles in radians)
     pub fn setRotation(self: *TransformComponent, x: f32, y: f32, z: f32) void {
-        self.rotation = .{ .x = x, .y = y, .z = z };
-        self.updateMatrices();
+        self.rotation = Quatf.fromEuler(x, y, z);
+        self.markDirty();
+    }
+
+
+    /// Set absolute rotation
+    pub fn setOrientation(self: *TransformComponent, rotation: Quatf) void {
+        self.rotation = rotation;
+        self.markDirty();
     }
 
 
     /// Set absolute scale
     pub fn setScale(self: *TransformComponent, x: f32, y: f32, z: f32) void {
         self.scale = .{ .x = x, .y = y, .z = z };
-        self.updateMatrices();
+        self.markDirty();
+    }
+
+
+    /// Flag the matrices for a rebuild on the next updateMatrices()
+    pub inline fn markDirty(self: *TransformComponent) void {
+        self.dirty = true;
     }
 
 
-    /// Update both local and world matrices
+    /// Rebuild local and world matrices if anything changed since the last call
+    /// This treats the transform as a root, TransformSystem handles entities with a ParentComponent
     pub fn updateMatrices(self: *TransformComponent) void {
+        if (!self.dirty) return;
+        self.dirty = false;
+
         self.local_matrix = self.toMatrix();
-        // World matrix will be updated by scene graph if implemented
         self.world_matrix = self.local_matrix;
+        self.render_matrix = self.world_matrix;
+        self.world_origin = self.origin;
+    }
+
+
+    /// Remember the current state as the one the next fixed step starts from
+    pub fn storePrevious(self: *TransformComponent) void {
+        self.previous_position = self.position;
+        self.previous_rotation = self.rotation;
+        self.previous_scale = self.scale;
+        self.has_previous = true;
+    }
+
+
+    /// Drop the blend from the previous state, e.g. after teleporting, so it doesn't streak across the scene
+    pub fn resetInterpolation(self: *TransformComponent) void {
+        self.storePrevious();
+    }
+
+
+    /// True when the state changed since the start of the fixed step
+    pub fn isMoving(self: *const TransformComponent) bool {
+        if (!self.has_previous) return false;
+        return !std.meta.eql(self.position, self.previous_position) or
+            !std.meta.eql(self.rotation, self.previous_rotation) or
+            !std.meta.eql(self.scale, self.previous_scale);
+    }
+
+
+    /// Local matrix `alpha` of the way from the previous state to the current one
+    pub fn interpolatedLocal(self: *const TransformComponent, alpha: f32) Affine3x4 {
+        return Affine3x4.compose(
+            Vec3f.lerp(self.previous_position, self.position, alpha),
+            Quatf.nlerp(self.previous_rotation, self.rotation, alpha),
+            Vec3f.lerp(self.previous_scale, self.scale, alpha),
+        );
+    }
+
+
+    /// Get the world matrix of a root transform, rebuilding it first if needed
+    pub fn getWorldMatrix(self: *TransformComponent) *const Affine3x4 {
+        self.updateMatrices();
+        return &self.world_matrix;
     }
 
 
     /// Reset transform to identity
     pub fn reset(self: *TransformComponent) void {
-        self.position = .{0, 0, 0};
-        self.rotation = .{0, 0, 0};
-        self.scale = .{1, 1, 1};
-        self.updateMatrices();
+        self.position = Vec3f.create(0, 0, 0);
+        self.rotation = Quatf.identity();
+        self.scale = Vec3f.create(1, 1, 1);
+        self.markDirty();
     }
 
 
     /// Make object look at a point (useful for cameras)
     pub fn lookAt(self: *TransformComponent, target_x: f32, target_y: f32, target_z: f32) void {
-        const dx = target_x - self.position[0];
-        const dy = target_y - self.position[1];
-        const dz = target_z - self.position[2];
+        const dx = target_x - self.position.x;
+        const dy = target_y - self.position.y;
+        const dz = target_z - self.position.z;
         
         // Calculate yaw (y-axis rotation)
-        self.rotation[1] = std.math.atan2(dx, dz);
+        const yaw = std.math.atan2(dx, dz);
         
         // Calculate pitch (x-axis rotation)
         const ground_dist = @sqrt(dx * dx + dz * dz);
-        self.rotation[0] = -std.math.atan2(dy, ground_dist);
+        const pitch = -std.math.atan2(dy, ground_dist);
+
+        self.rotation = Quatf.fromEuler(pitch, yaw, 0);
         
-        self.updateMatrices();
+        self.markDirty();
     }
 };
\ No newline at end of file
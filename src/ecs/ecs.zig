@@ -1,4 +1,8 @@
 const std = @import("std");
+const FrameArena = @import("../core/frame_arena.zig").FrameArena;
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+const profiler = @import("../core/profiler.zig");
+const Events = @import("events.zig").Events;
 
 
 /// Possible errors that can occur during ECS operations
@@ -7,6 +11,12 @@ pub const EcsError = error{
     EntityNotFound,
     DuplicateComponent,
     InvalidEntity,
+    TooManyComponents,
+    /// The component has a deinit function and no `clone`, so a prefab can't copy it
+    ComponentNotCloneable,
+    /// The storage belongs to an owning group, which can't share it and keeps its order
+    StorageOwnedByGroup,
+    InvalidSnapshot,
     SystemError,
     OutOfMemory,
     DeinitFunctionNotFound
@@ -50,24 +60,60 @@ pub const EntityId = struct {
 
 
 
-/// Generic component storage using a sparse set approach
-/// This allows O(1) addition, removal, and lookup of components
+/// Generic component storage using a paged sparse set
+/// Entity indices map to dense slots through fixed size pages of a sparse array, so addition,
+/// removal and lookup are O(1) array accesses without hashing
+/// Entity IDs and components live in parallel dense arrays, so component loops stay on a tight stride
 pub fn ComponentStorage(comptime T: type) type {
     return struct {
         const Self = @This();
-        
-        /// Stores entity ID alongside component data
-        const ComponentData = struct {
-            entity: EntityId,
-            component: T,
+
+        /// Entity indices covered by one sparse page
+        const page_size = 1024;
+        /// Sparse value for entities that don't have this component
+        const tombstone = std.math.maxInt(u32);
+        const Page = [page_size]u32;
+
+        /// Batched callbacks of a storage, each gets the affected entities with their components in step
+        pub const Hooks = struct {
+            context: ?*anyopaque = null,
+            /// After components were added, one call per add, addMany, addCopies or snapshot load
+            /// The slices are the newly appended end of the dense lists
+            on_add: ?*const fn (?*anyopaque, []const EntityId, []T) void = null,
+            /// Before removed components are dropped. Removes through the registry are delivered at the end
+            /// of each call, so destroyEntities reports a whole batch at once, direct ones wait for flushRemoved
+            on_remove: ?*const fn (?*anyopaque, []const EntityId, []T) void = null,
+        };
+
+        /// When an entity last lost this component, generation 0 means never
+        const Removal = struct {
+            generation: u32 = 0,
+            tick: u32 = 0,
         };
+        const RemovalPage = [page_size]Removal;
 
         /// Memory allocator
         allocator: std.mem.Allocator,
-        /// Maps entity index to component position
-        entity_to_index: std.AutoHashMap(u32, usize),
-        /// Stores actual component data
-        components: std.ArrayList(ComponentData),
+        /// Maps entity index to component position, pages are allocated on first use
+        sparse: std.ArrayListUnmanaged(?*Page),
+        /// Entity owning each dense slot
+        entities: std.ArrayList(EntityId),
+        /// Component data, parallel to `entities`
+        components: std.ArrayList(T),
+        /// Tick at which each dense slot was added, parallel to `entities`
+        added_ticks: std.ArrayList(u32),
+        /// Tick of the last mutable access to each dense slot, parallel to `entities`
+        changed_ticks: std.ArrayList(u32),
+        /// Removal tick per entity index, paged like `sparse`
+        removals: std.ArrayListUnmanaged(?*RemovalPage),
+        /// Current change tick, owned by the registry
+        change_tick: *const u32 = &untracked_tick,
+        /// Set while a Group keeps the members at the front of the dense lists
+        owned: bool = false,
+        hooks: Hooks = .{},
+        /// Removed components waiting for on_remove, only filled while it is set
+        removed_entities: std.ArrayListUnmanaged(EntityId) = .{},
+        removed_components: std.ArrayListUnmanaged(T) = .{},
 
 
         // ============================================================
@@ -76,10 +122,21 @@ pub fn ComponentStorage(comptime T: type) type {
 
         /// Initialize a new component storage
         pub fn init(allocator: std.mem.Allocator) Self {
+            return initWithDense(allocator, allocator);
+        }
+
+
+        /// Initialize a storage whose dense lists, entities, components and their ticks, come from `dense_allocator`
+        /// e.g. a VirtualAllocator, so they grow in place without copying. Sparse pages stay on `allocator`
+        pub fn initWithDense(allocator: std.mem.Allocator, dense_allocator: std.mem.Allocator) Self {
             return .{
                 .allocator = allocator,
-                .entity_to_index = std.AutoHashMap(u32, usize).init(allocator),
-                .components = std.ArrayList(ComponentData).init(allocator),
+                .sparse = .{},
+                .entities = std.ArrayList(EntityId).init(dense_allocator),
+                .components = std.ArrayList(T).init(dense_allocator),
+                .added_ticks = std.ArrayList(u32).init(dense_allocator),
+                .changed_ticks = std.ArrayList(u32).init(dense_allocator),
+                .removals = .{},
             };
         }
 
@@ -90,381 +147,2218 @@ pub fn ComponentStorage(comptime T: type) type {
 
         /// Add a component to an entity
         pub fn add(self: *Self, entity: EntityId, component: T) !void {
+            const slot = try self.sparseSlot(entity.index);
 
             // Check if entity already has this component
-            if (self.entity_to_index.get(entity.index)) |_| {
+            if (slot.* != tombstone) {
                 return EcsError.DuplicateComponent;
             }
             
-            // Add to the end of the components list
-            const index = self.components.items.len;
-            try self.entity_to_index.put(entity.index, index);
-            try self.components.append(.{
-                .entity = entity,
-                .component = component,
-            });
+            // Add to the end of the dense lists
+            const index = self.entities.items.len;
+            try self.ensureUnusedCapacity(1);
+            self.appendAssumeCapacity(entity, component);
+            slot.* = @intCast(index);
+            self.notifyAdded(index);
+        }
+
+
+        /// Add one component per entity, reserving the dense lists once
+        /// Stops at the first entity that already has this component
+        pub fn addMany(self: *Self, entities: []const EntityId, values: []const T) !void {
+            std.debug.assert(entities.len == values.len);
+            try self.ensureUnusedCapacity(entities.len);
+
+            // Whatever made it in before an error is reported too
+            const first = self.entities.items.len;
+            defer self.notifyAdded(first);
+
+            for (entities, values) |entity, value| {
+                const slot = try self.sparseSlot(entity.index);
+                if (slot.* != tombstone) {
+                    return EcsError.DuplicateComponent;
+                }
+
+                slot.* = @intCast(self.entities.items.len);
+                self.appendAssumeCapacity(entity, value);
+            }
+        }
+
+
+        /// Add the same component to every entity, reserving the dense lists once
+        /// Types with a `clone` method get a fresh clone of `value` per entity, others a plain copy
+        /// Every check and allocation happens first, on error none of the entities got the component
+        pub fn addCopies(self: *Self, entities: []const EntityId, value: T) !void {
+            for (entities) |entity| {
+                const slot = try self.sparseSlot(entity.index);
+                if (slot.* != tombstone) {
+                    return EcsError.DuplicateComponent;
+                }
+            }
+            try self.ensureUnusedCapacity(entities.len);
+
+            const first = self.entities.items.len;
+            for (entities) |entity| {
+                const slot = self.sparseSlot(entity.index) catch unreachable; // Pages were allocated above
+                slot.* = @intCast(self.entities.items.len);
+                self.appendAssumeCapacity(entity, if (comptime std.meta.hasFn(T, "clone")) value.clone() else value);
+            }
+            self.notifyAdded(first);
+        }
+
+
+        /// Reserve room for `count` more components
+        pub fn ensureUnusedCapacity(self: *Self, count: usize) !void {
+            try self.entities.ensureUnusedCapacity(count);
+            try self.components.ensureUnusedCapacity(count);
+            try self.added_ticks.ensureUnusedCapacity(count);
+            try self.changed_ticks.ensureUnusedCapacity(count);
         }
 
 
         /// Remove a component from an entity
         pub fn remove(self: *Self, entity: EntityId) !void {
-            const index = self.entity_to_index.get(entity.index) orelse
+            const index = self.indexOf(entity) orelse
                 return EcsError.ComponentNotFound;
-            
-            // Remove from the index map
-            _ = self.entity_to_index.remove(entity.index);
+
+            if (self.hooks.on_remove != null) {
+                try self.removed_entities.ensureUnusedCapacity(self.allocator, 1);
+                try self.removed_components.ensureUnusedCapacity(self.allocator, 1);
+            }
+
+            // Remember the removal for Removed(T) filters
+            const removal = try self.removalSlot(entity.index);
+            removal.* = .{ .generation = entity.generation, .tick = self.currentTick() };
+
+            if (self.hooks.on_remove != null) {
+                self.removed_entities.appendAssumeCapacity(entity);
+                self.removed_components.appendAssumeCapacity(self.components.items[index]);
+            }
             
             // If not the last element, move the last element to fill the gap
-            if (index != self.components.items.len - 1) {
-                const last = self.components.items[self.components.items.len - 1];
-                self.components.items[index] = last;
+            const last_index = self.entities.items.len - 1;
+            if (index != last_index) {
+                const last_entity = self.entities.items[last_index];
+                self.entities.items[index] = last_entity;
+                self.components.items[index] = self.components.items[last_index];
+                self.added_ticks.items[index] = self.added_ticks.items[last_index];
+                self.changed_ticks.items[index] = self.changed_ticks.items[last_index];
                 
                 // Update the index of the moved component
-                try self.entity_to_index.put(last.entity.index, index);
+                self.setSlot(last_entity.index, index);
             }
             
             // Remove the now-redundant last element
+            self.setSlot(entity.index, tombstone);
+            _ = self.entities.pop();
             _ = self.components.pop();
+            _ = self.added_ticks.pop();
+            _ = self.changed_ticks.pop();
         }
 
 
-        /// Get a component for an entity if it exists
+        /// Get a component for an entity if it exists, without marking it changed
         pub fn get(self: *Self, entity: EntityId) ?*T {
-            if (self.entity_to_index.get(entity.index)) |index| {
-                return &self.components.items[index].component;
-            }
-            return null;
+            const index = self.indexOf(entity) orelse return null;
+            return &self.components.items[index];
         }
 
 
-        /// Get all components for iteration
-        pub fn iter(self: *Self) []ComponentData {
-            return self.components.items;
+        /// Get a component for writing, stamps its changed tick
+        pub fn getMut(self: *Self, entity: EntityId) ?*T {
+            const index = self.indexOf(entity) orelse return null;
+            self.markChanged(index);
+            return &self.components.items[index];
         }
 
 
-        /// Run a function for each component and its entity
-        pub fn forEach(self: *Self, comptime func: fn (entity: EntityId, component: *T) void) void {
-            for (self.components.items) |*data| {
-                func(data.entity, &data.component);
+        /// Stamp the dense slot `index` as changed at the current tick
+        pub fn markChanged(self: *Self, index: u32) void {
+            self.changed_ticks.items[index] = self.currentTick();
+        }
+
+
+        /// Stamp `len` dense slots from `start` as changed at the current tick
+        pub fn markChangedRange(self: *Self, start: u32, len: usize) void {
+            @memset(self.changed_ticks.items[start..][0..len], self.currentTick());
+        }
+
+
+        /// Check an entity against an Added, Changed or Removed filter
+        pub fn passesFilter(self: *const Self, comptime kind: FilterKind, entity: EntityId, since_tick: u32) bool {
+            switch (kind) {
+                .added => {
+                    const index = self.indexOf(entity) orelse return false;
+                    return self.added_ticks.items[index] > since_tick;
+                },
+                .changed => {
+                    const index = self.indexOf(entity) orelse return false;
+                    return self.changed_ticks.items[index] > since_tick;
+                },
+                .removed => {
+                    if (self.contains(entity)) return false;
+                    const removal = self.removalOf(entity.index) orelse return false;
+                    return removal.generation == entity.generation and removal.tick > since_tick;
+                },
             }
         }
 
 
-        // ============================================================
-        // Public API: Destruction Function
-        // ============================================================
+        /// Dense position of an entity's component, null if it has none or the handle is stale
+        pub fn indexOf(self: *const Self, entity: EntityId) ?u32 {
+            const index = self.sparseIndex(entity.index) orelse return null;
 
-        /// Free all allocated resources
-        pub fn deinit(self: *Self) void {
-            self.entity_to_index.deinit();
-            self.components.deinit();
+            // The stored EntityId sits next to the slot we fetch anyway, so this replaces a separate isValidEntity lookup
+            return if (self.entities.items[index].generation == entity.generation) index else null;
         }
-    };
-}
 
 
+        /// Dense position without the generation check, for entities already known to be live
+        /// Stale handles are caught by an assertion in debug builds
+        pub fn indexOfUnchecked(self: *const Self, entity: EntityId) ?u32 {
+            const index = self.sparseIndex(entity.index) orelse return null;
+            std.debug.assert(self.entities.items[index].generation == entity.generation);
+            return index;
+        }
 
 
+        /// Get a component without the generation check, same rules as indexOfUnchecked
+        pub fn getUnchecked(self: *Self, entity: EntityId) ?*T {
+            const index = self.indexOfUnchecked(entity) orelse return null;
+            return &self.components.items[index];
+        }
 
 
+        /// Call `func(context, entity)` for every entity that lost this component after `since_tick`
+        /// and doesn't have it again, in entity index order. Walks the removal pages of every index seen
+        pub fn forEachRemovedSince(self: *const Self, since_tick: u32, context: anytype, comptime func: anytype) !void {
+            for (self.removals.items, 0..) |maybe_page, page_index| {
+                const page = maybe_page orelse continue;
+                for (page, 0..) |removal, i| {
+                    if (removal.generation == 0 or removal.tick <= since_tick) continue;
+                    const entity = EntityId{ .index = @intCast(page_index * page_size + i), .generation = removal.generation };
+                    if (self.contains(entity)) continue;
+                    try func(context, entity);
+                }
+            }
+        }
 
 
+        /// Check if an entity has this component
+        pub fn contains(self: *const Self, entity: EntityId) bool {
+            return self.indexOf(entity) != null;
+        }
 
 
-/// Registry that manages entities, components, and their relationships
-pub const Registry = struct {
-    const Self = @This();
+        /// Number of stored components
+        pub fn len(self: *const Self) usize {
+            return self.entities.items.len;
+        }
 
-     /// Type ID for component type identification
-    const ComponentTypeId = u64;
-    
-    /// Interface for type-erased component storage operations
-    const ComponentStorageInterface = struct {
-        ptr: *anyopaque,
-        deinit_fn: *const fn(*anyopaque, std.mem.Allocator) void,
-        remove_fn: *const fn(*anyopaque, EntityId) EcsError!void,
 
-        /// Create interface to a component storage
-        fn create(comptime T: type, store: *ComponentStorage(T), comptime deinit_fn_name: ?[]const u8) ComponentStorageInterface {
+        /// Bytes held by the dense lists and the sparse and removal pages, see Registry.storageStats
+        pub fn memoryStats(self: *const Self) StorageMemory {
+            var sparse_bytes = (self.sparse.capacity + self.removals.capacity) * @sizeOf(?*Page);
+            for (self.sparse.items) |maybe_page| sparse_bytes += if (maybe_page != null) @sizeOf(Page) else 0;
+            for (self.removals.items) |maybe_page| sparse_bytes += if (maybe_page != null) @sizeOf(RemovalPage) else 0;
             return .{
-                .ptr = store,
+                .count = self.entities.items.len,
+                .capacity = self.entities.capacity,
+                .dense_bytes = self.entities.capacity * @sizeOf(EntityId) +
+                    self.components.capacity * @sizeOf(T) +
+                    (self.added_ticks.capacity + self.changed_ticks.capacity) * @sizeOf(u32),
+                .sparse_bytes = sparse_bytes,
+            };
+        }
 
-                // Deinit function
-                .deinit_fn = struct {
-                    fn deinitFn(ptr: *anyopaque, allocator: std.mem.Allocator) void {
-                        const storage = @as(*ComponentStorage(T), @ptrCast(@alignCast(ptr)));
-                           
-                        // Use custom deinit function name if provided
-                        if (deinit_fn_name) |fn_name| {
-
-                            // Check if the component has the specified deinit function
-                            if(std.meta.hasFn(T, fn_name)) {
-                                const DeinitFn = @field(T, fn_name);
-                                var i:usize = 0;
-
-                                while(i<storage.components.items.len):(i+=1){
-                                    var item = storage.components.items[i];
-                                    DeinitFn(&item.component);
-                                }
-
-                            } else {
-                                // Function not found
-                                std.debug.print("Warning: Deinit function '{s}' not found on type {s}\n", .{fn_name, @typeName(T)});
-                            }
-                        } 
-                        
-                        storage.deinit();
-                        allocator.destroy(storage); // Free the storage struct itself
-                    }
 
-                    // Helper to check if a type is a pointer to T
-                    fn isPointerToT(comptime PtrType: type, comptime TargetType: type) bool {
-                        const type_info = @typeInfo(PtrType);
-                        return switch (type_info) {
-                            .Pointer => |ptr| @typeInfo(ptr.child) == @typeInfo(TargetType),
-                            else => false,
-                        };
-                    }
-                }.deinitFn,
+        /// Dense entity list, `entitySlice()[i]` owns `componentSlice()[i]`
+        pub fn entitySlice(self: *const Self) []const EntityId {
+            return self.entities.items;
+        }
 
-                // Remove function
-                .remove_fn = struct {
-                    fn removeFn(ptr: *anyopaque, entity: EntityId) EcsError!void {
-                        const storage = @as(*ComponentStorage(T), @ptrCast(@alignCast(ptr)));
-                        return storage.remove(entity);
-                    }
-                }.removeFn,
-            };
+
+        /// Dense component list for linear or SIMD passes over `T`
+        pub fn componentSlice(self: *Self) []T {
+            return self.components.items;
         }
-    };
 
 
-    /// Memory allocator
-    allocator: std.mem.Allocator,
-    /// Tracks entity generations
-    generations: std.ArrayList(u32),
-    /// Stores available entity indices for reuse
-    free_indices: std.ArrayList(u32),
-    /// Maps component type IDs to storage instances
-    component_stores: std.AutoHashMap(ComponentTypeId, ComponentStorageInterface),
+        /// Changed tick of every dense slot, scanning it finds recent writes without per-entity lookups
+        pub fn changedTickSlice(self: *const Self) []const u32 {
+            return self.changed_ticks.items;
+        }
 
 
-    // ============================================================
-    // Public API: Creation Functions
-    // ============================================================
+        /// Permute the dense array so that slot `i` holds what was at `order[i]`
+        /// `order` must contain every current slot exactly once, fails on storages owned by a group
+        pub fn reorder(self: *Self, order: []const u32) !void {
+            std.debug.assert(order.len == self.entities.items.len);
+            if (self.owned) return EcsError.StorageOwnedByGroup;
 
-    /// Create a new registry
-    pub fn create(allocator: std.mem.Allocator) !*Self {
-        const registry_ptr = try allocator.create(Self);
-        registry_ptr.* = .{
-            .allocator = allocator,
-            .generations = std.ArrayList(u32).init(allocator),
-            .free_indices = std.ArrayList(u32).init(allocator),
-            .component_stores = std.AutoHashMap(ComponentTypeId, ComponentStorageInterface).init(allocator),
-        };
-        return registry_ptr;
-    }
+            try self.permute(EntityId, self.entities.items, order);
+            try self.permute(T, self.components.items, order);
+            try self.permute(u32, self.added_ticks.items, order);
+            try self.permute(u32, self.changed_ticks.items, order);
 
+            for (self.entities.items, 0..) |entity, index| {
+                self.setSlot(entity.index, @intCast(index));
+            }
+        }
 
-    // ============================================================
-    // Public API: Operational Functions
-    // ============================================================
 
-    /// Create a new entity
-    pub fn createEntity(self: *Self) !EntityId {
-        
-        // Reuse a freed entity index if available
-        if (self.free_indices.items.len > 0) {
-            const index = self.free_indices.pop() orelse unreachable; // Should never fail since length is checked 
-            const generation = self.generations.items[index];
-            return EntityId{ .index = index, .generation = generation };
+        /// Exchange two dense slots, with their ticks and sparse entries
+        pub fn swapSlots(self: *Self, a: u32, b: u32) void {
+            if (a == b) return;
+            std.mem.swap(EntityId, &self.entities.items[a], &self.entities.items[b]);
+            std.mem.swap(T, &self.components.items[a], &self.components.items[b]);
+            std.mem.swap(u32, &self.added_ticks.items[a], &self.added_ticks.items[b]);
+            std.mem.swap(u32, &self.changed_ticks.items[a], &self.changed_ticks.items[b]);
+            self.setSlot(self.entities.items[a].index, a);
+            self.setSlot(self.entities.items[b].index, b);
         }
 
-        // Create a new entity at the end
-        const index: u32 = @intCast(self.generations.items.len);
-        try self.generations.append(1);
-        return EntityId{ .index = index, .generation = 1 };
-    }
 
+        /// Run a function for each component and its entity
+        pub fn forEach(self: *Self, comptime func: fn (entity: EntityId, component: *T) void) void {
+            for (self.entities.items, self.components.items) |entity, *component| {
+                func(entity, component);
+            }
+        }
 
-    /// Destroy an entity and all its components
-    pub fn destroyEntity(self: *Self, entity: EntityId) !void {
 
-        if (!self.isValidEntity(entity)) {
-            return EcsError.InvalidEntity;
+        /// Run a function once over the whole dense entity and component lists
+        pub fn forEachSlice(self: *Self, comptime func: fn (entities: []const EntityId, components: []T) void) void {
+            func(self.entities.items, self.components.items);
         }
 
-        // Remove all components attached to the entity
-        var iter = self.component_stores.iterator();
-        while (iter.next()) |entry| {
-            const interface = entry.value_ptr.*;
-            
-            // Try to remove the component, ignore if not found
-            interface.remove_fn(interface.ptr, entity) catch |err| {
-                if (err != EcsError.ComponentNotFound) {
-                    return err;
-                }
-            };
+
+        /// Split the dense lists into chunks of `parallel_chunk_size` and run `func` on each from `pool`
+        /// Returns once every chunk is done, `func` may only touch the chunk it is given
+        pub fn parallelForEach(self: *Self, pool: *JobSystem, comptime func: fn (entities: []const EntityId, components: []T) void) void {
+            var wait_group: std.Thread.WaitGroup = .{};
+
+            var start: usize = 0;
+            while (start < self.entities.items.len) : (start += parallel_chunk_size) {
+                const end = @min(start + parallel_chunk_size, self.entities.items.len);
+                pool.spawnWg(&wait_group, func, .{ self.entities.items[start..end], self.components.items[start..end] });
+            }
+            pool.waitAndWork(&wait_group);
         }
 
-        // Mark entity as free and add 1 to generation to invalidate existing references
-        try self.free_indices.append(entity.index);
-        self.generations.items[entity.index] += 1;
-    }
 
+        /// Hand the pending removed components to on_remove in one call
+        pub fn flushRemoved(self: *Self) void {
+            if (self.removed_entities.items.len == 0) return;
+            if (self.hooks.on_remove) |on_remove| {
+                on_remove(self.hooks.context, self.removed_entities.items, self.removed_components.items);
+            }
+            self.removed_entities.clearRetainingCapacity();
+            self.removed_components.clearRetainingCapacity();
+        }
 
-    /// Check if an entity ID is valid in this registry
-    pub fn isValidEntity(self: Self, entity: EntityId) bool {
-        return entity.index < self.generations.items.len and
-               self.generations.items[entity.index] == entity.generation;
-    }
 
+        /// Drop every component, keeping the dense capacity, on_remove sees them first
+        pub fn clear(self: *Self) void {
+            self.notifyCleared();
+            self.reset();
+        }
 
-    /// Register a component type with automatic cleanup using specified deinit function
-    pub fn registerDeferedComponent(self: *Self, comptime T: type, comptime deinit_fn_name: []const u8) !void {        
-        try self.registerComponentInternal(T, deinit_fn_name);
-    }
 
+        /// Drop every component without calling hooks
+        fn reset(self: *Self) void {
+            for (self.sparse.items) |maybe_page| {
+                if (maybe_page) |page| @memset(page, tombstone);
+            }
+            for (self.removals.items) |maybe_page| {
+                if (maybe_page) |page| @memset(page, .{});
+            }
+            self.entities.clearRetainingCapacity();
+            self.components.clearRetainingCapacity();
+            self.added_ticks.clearRetainingCapacity();
+            self.changed_ticks.clearRetainingCapacity();
+        }
 
-    /// Register a component type
-    pub fn registerComponent(self: *Self, comptime T: type) !void {
-        try self.registerComponentInternal(T, null);
-    }
 
+        /// Write the dense lists as raw bytes: component size, count, entity IDs, components
+        /// Only meaningful when T holds no pointers
+        pub fn writeSnapshot(self: *const Self, writer: anytype) !void {
+            try writer.writeInt(u32, @sizeOf(T), native_endian);
+            try writer.writeInt(u32, @intCast(self.entities.items.len), native_endian);
+            try writer.writeAll(std.mem.sliceAsBytes(self.entities.items));
+            try writer.writeAll(std.mem.sliceAsBytes(self.components.items));
+        }
 
-    /// Add a component to an entity
-    pub fn addComponent(self: *Self, entity: EntityId, component: anytype) !void {
-        const T = @TypeOf(component);
-        const storage = try self.getComponentStorage(T);
-        try storage.add(entity, component);
-    }
 
+        /// Replace the contents with a block written by writeSnapshot, two bulk reads and a sparse rebuild
+        /// Every loaded component counts as added at the current tick
+        pub fn readSnapshot(self: *Self, reader: anytype) !void {
+            self.clear();
 
-    /// Remove a component from an entity
-    pub fn removeComponent(self: *Self, entity: EntityId, comptime T: type) !void {
-        const storage = try self.getComponentStorage(T);
-        try storage.remove(entity);
-    }
-    
+            // A different size means T changed since the snapshot was written
+            if (try reader.readInt(u32, native_endian) != @sizeOf(T)) return EcsError.InvalidSnapshot;
+            const count = try reader.readInt(u32, native_endian);
+            try self.ensureUnusedCapacity(count);
+            self.entities.items.len = count;
+            self.components.items.len = count;
+            try reader.readNoEof(std.mem.sliceAsBytes(self.entities.items));
+            try reader.readNoEof(std.mem.sliceAsBytes(self.components.items));
 
-    /// Get a component from an entity
-    pub fn getComponent(self: *Self, entity: EntityId, comptime T: type) ?*T {
-        const storage = self.getComponentStorage(T) catch return null;
-        return storage.get(entity);
-    }
+            self.added_ticks.appendNTimesAssumeCapacity(self.currentTick(), count);
+            self.changed_ticks.appendNTimesAssumeCapacity(self.currentTick(), count);
 
+            for (self.entities.items, 0..) |entity, index| {
+                const slot = try self.sparseSlot(entity.index);
+                if (slot.* != tombstone) return EcsError.InvalidSnapshot;
+                slot.* = @intCast(index);
+            }
+            self.notifyAdded(0);
+        }
 
-    /// Create a query for entities with specific components
-    pub fn query(self: *Self, comptime Components: type) !Query(Components) {
-        return Query(Components).init(self);
-    }
 
+        // ============================================================
+        // Public API: Destruction Function
+        // ============================================================
 
-    // ============================================================
-    // Public API: Destruction Function
-    // ============================================================
+        /// Free all allocated resources
+        pub fn deinit(self: *Self) void {
+            for (self.sparse.items) |maybe_page| {
+                if (maybe_page) |page| self.allocator.destroy(page);
+            }
+            self.sparse.deinit(self.allocator);
+            for (self.removals.items) |maybe_page| {
+                if (maybe_page) |page| self.allocator.destroy(page);
+            }
+            self.removals.deinit(self.allocator);
+            self.removed_entities.deinit(self.allocator);
+            self.removed_components.deinit(self.allocator);
+            self.entities.deinit();
+            self.components.deinit();
+            self.added_ticks.deinit();
+            self.changed_ticks.deinit();
+        }
 
-    /// Free all resources and destroy the registry
-    pub fn release(self: *Self) void {
 
-        // Deinit all component storages
-        var iter = self.component_stores.iterator();
-        while (iter.next()) |entry| {
-            const interface = entry.value_ptr.*;
-            interface.deinit_fn(interface.ptr, self.allocator);
+        // ============================================================
+        // Private: Helper Functions
+        // ============================================================
+
+        /// Sparse entry for an entity index, allocating its page if needed
+        /// Report the components appended from dense slot `first` on to on_add
+        fn notifyAdded(self: *Self, first: usize) void {
+            const on_add = self.hooks.on_add orelse return;
+            if (first >= self.entities.items.len) return;
+            on_add(self.hooks.context, self.entities.items[first..], self.components.items[first..]);
         }
 
-        // Deinit other resources
-        self.component_stores.deinit();
-        self.generations.deinit();
-        self.free_indices.deinit();
 
-        // Free the registry itself
-        self.allocator.destroy(self);
-    }
+        /// Report pending removals and then every component still stored to on_remove, before a clear
+        fn notifyCleared(self: *Self) void {
+            self.flushRemoved();
+            const on_remove = self.hooks.on_remove orelse return;
+            if (self.entities.items.len == 0) return;
+            on_remove(self.hooks.context, self.entities.items, self.components.items);
+        }
 
 
-    // ============================================================
-    // Private: Helper Functions
-    // ============================================================
+        fn sparseSlot(self: *Self, entity_index: u32) !*u32 {
+            const page_index = entity_index / page_size;
+            if (page_index >= self.sparse.items.len) {
+                try self.sparse.appendNTimes(self.allocator, null, page_index + 1 - self.sparse.items.len);
+            }
 
-    /// Internal function to register a component with optional auto-deinit
-    fn registerComponentInternal(self: *Self, comptime T: type, comptime deinit_fn_name: ?[]const u8) !void {
-        const type_id = std.hash.Wyhash.hash(0, @typeName(T));
-        if (self.component_stores.contains(type_id)) {
-            return; // Already registered
+            const page = self.sparse.items[page_index] orelse blk: {
+                const new_page = try self.allocator.create(Page);
+                @memset(new_page, tombstone);
+                self.sparse.items[page_index] = new_page;
+                break :blk new_page;
+            };
+            return &page[entity_index % page_size];
         }
-        
-        // Create new component storage
-        const store = try self.allocator.create(ComponentStorage(T));
-        store.* = ComponentStorage(T).init(self.allocator);
-        
-        // Add to component stores
-        try self.component_stores.put(
-            type_id,
-            ComponentStorageInterface.create(T, store, deinit_fn_name)
-        );
-    }
 
 
-    /// Get the storage for a component type
-    fn getComponentStorage(self: *Self, comptime T: type) !*ComponentStorage(T) {
-        const type_id = std.hash.Wyhash.hash(0, @typeName(T));
-        const interface = self.component_stores.get(type_id) orelse
-            return EcsError.ComponentNotFound;
-        return @as(*ComponentStorage(T), @ptrCast(@alignCast(interface.ptr)));
-    }
-};
+        /// Dense position stored for an entity index, ignoring generations
+        inline fn sparseIndex(self: *const Self, entity_index: u32) ?u32 {
+            const page_index = entity_index / page_size;
+            if (page_index >= self.sparse.items.len) return null;
 
+            const page = self.sparse.items[page_index] orelse return null;
+            const index = page[entity_index % page_size];
+            return if (index == tombstone) null else index;
+        }
 
 
+        /// Overwrite the sparse entry of an entity whose page already exists
+        inline fn setSlot(self: *Self, entity_index: u32, index: u32) void {
+            self.sparse.items[entity_index / page_size].?[entity_index % page_size] = index;
+        }
 
 
+        /// Removal entry for an entity index, allocating its page if needed
+        fn removalSlot(self: *Self, entity_index: u32) !*Removal {
+            const page_index = entity_index / page_size;
+            if (page_index >= self.removals.items.len) {
+                try self.removals.appendNTimes(self.allocator, null, page_index + 1 - self.removals.items.len);
+            }
 
+            const page = self.removals.items[page_index] orelse blk: {
+                const new_page = try self.allocator.create(RemovalPage);
+                @memset(new_page, .{});
+                self.removals.items[page_index] = new_page;
+                break :blk new_page;
+            };
+            return &page[entity_index % page_size];
+        }
 
 
+        fn removalOf(self: *const Self, entity_index: u32) ?Removal {
+            const page_index = entity_index / page_size;
+            if (page_index >= self.removals.items.len) return null;
+            const page = self.removals.items[page_index] orelse return null;
+            return page[entity_index % page_size];
+        }
 
 
-/// Query system to efficiently iterate over entities with specific components
-pub fn Query(comptime Components: type) type {
-    return struct {
-        const Self = @This();
-        
-        /// Reference to the registry
-        registry: *Registry,
-        /// Storage for each component type in the query
-        storages: QueryStorages,
-        /// Current index in the iteration
-        current_index: usize = 0,
-        
+        inline fn currentTick(self: *const Self) u32 {
+            return @atomicLoad(u32, self.change_tick, .monotonic);
+        }
 
-        /// Compile-time generated struct that holds references to component storages
+
+        /// Append a new dense slot, stamping it added and changed at the current tick
+        fn appendAssumeCapacity(self: *Self, entity: EntityId, component: T) void {
+            self.entities.appendAssumeCapacity(entity);
+            self.components.appendAssumeCapacity(component);
+            self.added_ticks.appendAssumeCapacity(self.currentTick());
+            self.changed_ticks.appendAssumeCapacity(self.currentTick());
+        }
+
+
+        /// Reorder `items` so that `items[i]` becomes what was at `order[i]`
+        fn permute(self: *Self, comptime E: type, items: []E, order: []const u32) !void {
+            const reordered = try self.allocator.alloc(E, order.len);
+            defer self.allocator.free(reordered);
+
+            for (order, reordered) |old_index, *item| {
+                item.* = items[old_index];
+            }
+            @memcpy(items, reordered);
+        }
+    };
+}
+
+
+
+
+
+
+
+
+
+
+/// Snapshot file header and format version
+const snapshot_magic = "ZUNESNAP";
+const snapshot_version: u32 = 2;
+/// Snapshots store raw arrays and are only portable between machines of the same byte order
+const native_endian = @import("builtin").cpu.arch.endian();
+
+
+/// True when `T` can be saved and restored as raw bytes, i.e. it contains no pointers
+fn isPlainData(comptime T: type) bool {
+    return switch (@typeInfo(T)) {
+        .void, .bool, .int, .float, .@"enum" => true,
+        .array => |info| isPlainData(info.child),
+        .vector => |info| isPlainData(info.child),
+        .optional => |info| isPlainData(info.child),
+        .@"struct" => |info| blk: {
+            for (info.fields) |field| {
+                if (!isPlainData(field.type)) break :blk false;
+            }
+            break :blk true;
+        },
+        else => false,
+    };
+}
+
+
+/// Maximum number of component types across all registries, one bit each in ComponentMask
+pub const MAX_COMPONENTS = 128;
+
+/// One bit per component type an entity has, indexed by Registry.componentIndex
+pub const ComponentMask = std.bit_set.IntegerBitSet(MAX_COMPONENTS);
+
+/// Zero-sized components are tags, which an entity either has or not, so a tag is only its bit in the
+/// entity's ComponentMask. They get no storage and are queried with With(T) and Without(T)
+pub fn isTag(comptime T: type) bool {
+    return @sizeOf(T) == 0;
+}
+
+/// Marks a component type that has not been given a dense index yet
+const unassigned_index = std.math.maxInt(u32);
+/// Next dense index handed out by Registry.componentIndex
+var next_component_index = std.atomic.Value(u32).init(0);
+/// Next dense index handed out to resource types, separate from components so they take no mask bits
+var next_resource_index = std.atomic.Value(u32).init(0);
+
+
+/// Entity and storage counts of a registry, cheap enough to take every frame
+pub const RegistryStats = struct {
+    entities: u32 = 0,
+    /// Destroyed entity slots waiting to be reused
+    free_slots: u32 = 0,
+    /// Component storages registered
+    storages: u32 = 0,
+    /// Components in all storages together, tags not included
+    components: u64 = 0,
+    /// Bytes held by all storages, see StorageMemory
+    storage_bytes: u64 = 0,
+};
+
+
+/// Memory of one ComponentStorage, capacities count what is allocated, not what is used
+pub const StorageMemory = struct {
+    count: usize = 0,
+    /// Slots the dense lists hold before they grow
+    capacity: usize = 0,
+    /// Entities, components and their added and changed ticks
+    dense_bytes: usize = 0,
+    /// Sparse and removal pages and the lists pointing at them, the whole cost of entity lookups
+    sparse_bytes: usize = 0,
+
+    pub fn totalBytes(self: StorageMemory) usize {
+        return self.dense_bytes + self.sparse_bytes;
+    }
+};
+
+
+/// One storage of Registry.storageStats
+pub const StorageStats = struct {
+    type_name: []const u8,
+    /// Bit of the component in ComponentMask
+    component_index: u32,
+    memory: StorageMemory,
+};
+
+
+/// Candidates a Query probed and how many matched, across its next and nextChunk calls
+/// A low hit ratio on a hot query means it leads with a storage holding many non-matches,
+/// a Group or a CachedQuery over the same components skips them
+pub const QueryStats = struct {
+    probed: u64 = 0,
+    matched: u64 = 0,
+
+    /// Matches per probed candidate, 1 when every candidate matched or none was probed
+    pub fn hitRatio(self: QueryStats) f32 {
+        if (self.probed == 0) return 1.0;
+        return @as(f32, @floatFromInt(self.matched)) / @as(f32, @floatFromInt(self.probed));
+    }
+};
+
+
+/// Registry that manages entities, components, and their relationships
+/// Registries share no mutable state, the process-wide type indices above are only ever assigned
+/// atomically. Any number of them can run on different threads, each used by one thread at a time,
+/// and entities move between them with copyEntityTo and moveEntityTo
+pub const Registry = struct {
+    const Self = @This();
+
+     /// Type ID for component type identification
+    pub const ComponentTypeId = u64;
+    
+    /// Interface for type-erased component storage operations
+    const ComponentStorageInterface = struct {
+        ptr: *anyopaque,
+        /// Stable type ID, identifies the storage in snapshots
+        type_id: ComponentTypeId,
+        /// Bit of the component in ComponentMask
+        component_index: u32,
+        deinit_fn: *const fn(*anyopaque, std.mem.Allocator) void,
+        remove_fn: *const fn(*anyopaque, EntityId) EcsError!void,
+        /// Deliver removals buffered for the on_remove hook
+        flush_removed_fn: *const fn(*anyopaque) void,
+        /// Drop every component, running the registered deinit function on each
+        clear_fn: *const fn(*anyopaque) void,
+        entities_fn: *const fn(*anyopaque) []const EntityId,
+        memory_fn: *const fn(*anyopaque) StorageMemory,
+        type_name: []const u8,
+        /// Size and alignment of one component, for prefabs keeping raw copies
+        component_size: u32,
+        component_alignment: u32,
+        /// False for components with a deinit function but no `clone`, copying their bytes would free things twice
+        cloneable: bool,
+        /// Copy the entity's component into `out`, component_size bytes at component_alignment
+        read_fn: *const fn(*anyopaque, EntityId, [*]u8) EcsError!void,
+        /// Add the component stored at `value` to every entity, see ComponentStorage.addCopies
+        add_copies_fn: *const fn(*anyopaque, []const EntityId, [*]const u8) EcsError!void,
+        /// Add the component of the first entity to the second one in another registry, registering it there
+        /// if needed. A move hands over the bytes, a copy clones them when the type can
+        transfer_fn: *const fn(*anyopaque, *Registry, EntityId, EntityId, bool) anyerror!void,
+        /// Bulk add every component to the entities `map` gives for their indices in another registry, then
+        /// empty this storage without deinit functions or hooks, the values belong to the destination now
+        move_all_fn: *const fn(*anyopaque, *Registry, []const EntityId) anyerror!void,
+        /// Snapshot functions, null when the component holds pointers and can't be saved as raw bytes
+        save_fn: ?*const fn(*anyopaque, std.io.AnyWriter) anyerror!void,
+        load_fn: ?*const fn(*anyopaque, std.io.AnyReader) anyerror!void,
+
+        /// Create interface to a component storage
+        fn create(comptime T: type, store: *ComponentStorage(T), comptime deinit_fn_name: ?[]const u8) ComponentStorageInterface {
+            const Ops = struct {
+                fn cast(ptr: *anyopaque) *ComponentStorage(T) {
+                    return @as(*ComponentStorage(T), @ptrCast(@alignCast(ptr)));
+                }
+
+                fn runComponentDeinit(storage: *ComponentStorage(T)) void {
+
+                    // Use custom deinit function name if provided
+                    if (deinit_fn_name) |fn_name| {
+
+                        // Check if the component has the specified deinit function
+                        if(std.meta.hasFn(T, fn_name)) {
+                            const DeinitFn = @field(T, fn_name);
+                            var i:usize = 0;
+
+                            while(i<storage.components.items.len):(i+=1){
+                                DeinitFn(&storage.components.items[i]);
+                            }
+
+                        } else {
+                            // Function not found
+                            std.debug.print("Warning: Deinit function '{s}' not found on type {s}\n", .{fn_name, @typeName(T)});
+                        }
+                    }
+                }
+
+                fn readFn(ptr: *anyopaque, entity: EntityId, out: [*]u8) EcsError!void {
+                    const component = cast(ptr).get(entity) orelse return EcsError.ComponentNotFound;
+                    @memcpy(out[0..@sizeOf(T)], std.mem.asBytes(component));
+                }
+
+                fn addCopiesFn(ptr: *anyopaque, entities: []const EntityId, value: [*]const u8) EcsError!void {
+                    const component: *const T = @ptrCast(@alignCast(value));
+                    try cast(ptr).addCopies(entities, component.*);
+                }
+
+                fn transferFn(ptr: *anyopaque, destination: *Registry, from: EntityId, to: EntityId, move: bool) anyerror!void {
+                    const component = cast(ptr).get(from) orelse return EcsError.ComponentNotFound;
+                    const value = if (comptime std.meta.hasFn(T, "clone")) (if (move) component.* else component.clone()) else component.*;
+                    try destination.registerComponentInternal(T, deinit_fn_name);
+                    try destination.addComponent(to, value);
+                }
+
+                fn moveAllFn(ptr: *anyopaque, destination: *Registry, map: []const EntityId) anyerror!void {
+                    const storage = cast(ptr);
+                    if (storage.len() == 0) return;
+
+                    const mapped = try destination.allocator.alloc(EntityId, storage.len());
+                    defer destination.allocator.free(mapped);
+                    for (storage.entities.items, mapped) |entity, *target| target.* = map[entity.index];
+
+                    try destination.registerComponentInternal(T, deinit_fn_name);
+                    try destination.addComponents(mapped, T, storage.components.items);
+                    storage.reset();
+                }
+
+                fn saveFn(ptr: *anyopaque, writer: std.io.AnyWriter) anyerror!void {
+                    try cast(ptr).writeSnapshot(writer);
+                }
+
+                fn loadFn(ptr: *anyopaque, reader: std.io.AnyReader) anyerror!void {
+                    try cast(ptr).readSnapshot(reader);
+                }
+            };
+
+            const plain = comptime isPlainData(T);
+
+            return .{
+                .ptr = store,
+                .type_id = typeId(T),
+                .component_index = componentIndex(T),
+
+                // Deinit function
+                .deinit_fn = struct {
+                    fn deinitFn(ptr: *anyopaque, allocator: std.mem.Allocator) void {
+                        const storage = Ops.cast(ptr);
+                        Ops.runComponentDeinit(storage);
+                        storage.deinit();
+                        allocator.destroy(storage); // Free the storage struct itself
+                    }
+                }.deinitFn,
+
+                // Remove function
+                .remove_fn = struct {
+                    fn removeFn(ptr: *anyopaque, entity: EntityId) EcsError!void {
+                        return Ops.cast(ptr).remove(entity);
+                    }
+                }.removeFn,
+
+                .flush_removed_fn = struct {
+                    fn flushRemovedFn(ptr: *anyopaque) void {
+                        Ops.cast(ptr).flushRemoved();
+                    }
+                }.flushRemovedFn,
+
+                // Clear function
+                .clear_fn = struct {
+                    fn clearFn(ptr: *anyopaque) void {
+                        const storage = Ops.cast(ptr);
+                        // Hooks see the components before their deinit function runs
+                        storage.notifyCleared();
+                        Ops.runComponentDeinit(storage);
+                        storage.reset();
+                    }
+                }.clearFn,
+
+                // Entities function
+                .entities_fn = struct {
+                    fn entitiesFn(ptr: *anyopaque) []const EntityId {
+                        return Ops.cast(ptr).entitySlice();
+                    }
+                }.entitiesFn,
+
+                .memory_fn = struct {
+                    fn memoryFn(ptr: *anyopaque) StorageMemory {
+                        return Ops.cast(ptr).memoryStats();
+                    }
+                }.memoryFn,
+                .type_name = @typeName(T),
+
+                .component_size = @sizeOf(T),
+                .component_alignment = @alignOf(T),
+                .cloneable = deinit_fn_name == null or std.meta.hasFn(T, "clone"),
+                .read_fn = Ops.readFn,
+                .add_copies_fn = Ops.addCopiesFn,
+                .transfer_fn = Ops.transferFn,
+                .move_all_fn = Ops.moveAllFn,
+
+                .save_fn = if (plain) Ops.saveFn else null,
+                .load_fn = if (plain) Ops.loadFn else null,
+            };
+        }
+    };
+
+    /// Interface for type-erased owning group operations
+    const GroupInterface = struct {
+        ptr: *anyopaque,
+        /// Type ID of the Group type, identifies it in Registry.group
+        type_id: ComponentTypeId,
+        /// Component types the group owns
+        component_ids: [2]ComponentTypeId,
+        /// Take the entity in if it has every owned component now, call after adding one
+        join_fn: *const fn(*anyopaque, EntityId) void,
+        /// Move the entity out before one of its owned components goes
+        leave_fn: *const fn(*anyopaque, EntityId) void,
+        rebuild_fn: *const fn(*anyopaque) void,
+        deinit_fn: *const fn(*anyopaque, std.mem.Allocator) void,
+
+        fn create(comptime A: type, comptime B: type, group_ptr: *Group(A, B)) GroupInterface {
+            const Ops = struct {
+                fn cast(ptr: *anyopaque) *Group(A, B) {
+                    return @as(*Group(A, B), @ptrCast(@alignCast(ptr)));
+                }
+
+                fn join(ptr: *anyopaque, entity: EntityId) void {
+                    cast(ptr).join(entity);
+                }
+
+                fn leave(ptr: *anyopaque, entity: EntityId) void {
+                    cast(ptr).leave(entity);
+                }
+
+                fn rebuild(ptr: *anyopaque) void {
+                    cast(ptr).rebuild();
+                }
+
+                fn deinit(ptr: *anyopaque, allocator: std.mem.Allocator) void {
+                    const group_ref = cast(ptr);
+                    group_ref.deinit();
+                    allocator.destroy(group_ref);
+                }
+            };
+
+            return .{
+                .ptr = group_ptr,
+                .type_id = typeId(Group(A, B)),
+                .component_ids = .{ typeId(A), typeId(B) },
+                .join_fn = Ops.join,
+                .leave_fn = Ops.leave,
+                .rebuild_fn = Ops.rebuild,
+                .deinit_fn = Ops.deinit,
+            };
+        }
+
+        fn owns(self: GroupInterface, type_id: ComponentTypeId) bool {
+            return self.component_ids[0] == type_id or self.component_ids[1] == type_id;
+        }
+    };
+
+    /// A tag type, which has no storage to identify it
+    const TagType = struct {
+        type_id: ComponentTypeId,
+        component_index: u32,
+    };
+
+    /// Type-erased event channel, lets updateEvents and release reach every Events(T)
+    const EventsInterface = struct {
+        ptr: *anyopaque,
+        update_fn: *const fn(*anyopaque) std.mem.Allocator.Error!void,
+        deinit_fn: *const fn(*anyopaque) void,
+
+        fn create(comptime T: type, channel: *Events(T)) EventsInterface {
+            const Ops = struct {
+                fn cast(ptr: *anyopaque) *Events(T) {
+                    return @as(*Events(T), @ptrCast(@alignCast(ptr)));
+                }
+
+                fn update(ptr: *anyopaque) std.mem.Allocator.Error!void {
+                    try cast(ptr).update();
+                }
+
+                fn deinit(ptr: *anyopaque) void {
+                    cast(ptr).deinit();
+                }
+            };
+
+            return .{
+                .ptr = channel,
+                .update_fn = Ops.update,
+                .deinit_fn = Ops.deinit,
+            };
+        }
+    };
+
+    /// Boxed singleton value, see setResource
+    const Resource = struct {
+        ptr: *anyopaque,
+        destroy_fn: *const fn(*anyopaque, std.mem.Allocator) void,
+
+        fn create(comptime T: type, value_ptr: *T) Resource {
+            return .{
+                .ptr = value_ptr,
+                .destroy_fn = struct {
+                    fn destroy(ptr: *anyopaque, allocator: std.mem.Allocator) void {
+                        allocator.destroy(@as(*T, @ptrCast(@alignCast(ptr))));
+                    }
+                }.destroy,
+            };
+        }
+    };
+
+    /// Interface for type-erased cached query operations
+    const CachedQueryInterface = struct {
+        ptr: *anyopaque,
+        /// Component types the query depends on
+        component_ids: []const ComponentTypeId,
+        /// Components every member has, entities without them can't be members
+        required: ComponentMask,
+        sync_fn: *const fn(*anyopaque, EntityId) EcsError!void,
+        rebuild_fn: *const fn(*anyopaque) EcsError!void,
+        deinit_fn: *const fn(*anyopaque, std.mem.Allocator) void,
+
+        /// Create interface to a cached query
+        fn create(comptime Components: type, cached: *CachedQuery(Components)) CachedQueryInterface {
+            return .{
+                .ptr = cached,
+                .component_ids = &CachedQuery(Components).component_ids,
+                .required = cached.required,
+
+                // Sync function
+                .sync_fn = struct {
+                    fn syncFn(ptr: *anyopaque, entity: EntityId) EcsError!void {
+                        const q = @as(*CachedQuery(Components), @ptrCast(@alignCast(ptr)));
+                        return q.sync(entity);
+                    }
+                }.syncFn,
+
+                // Rebuild function
+                .rebuild_fn = struct {
+                    fn rebuildFn(ptr: *anyopaque) EcsError!void {
+                        const q = @as(*CachedQuery(Components), @ptrCast(@alignCast(ptr)));
+                        return q.rebuild();
+                    }
+                }.rebuildFn,
+
+                // Deinit function
+                .deinit_fn = struct {
+                    fn deinitFn(ptr: *anyopaque, allocator: std.mem.Allocator) void {
+                        const q = @as(*CachedQuery(Components), @ptrCast(@alignCast(ptr)));
+                        q.deinit();
+                        allocator.destroy(q);
+                    }
+                }.deinitFn,
+            };
+        }
+
+        /// Check if the query reads components of this type
+        fn dependsOn(self: CachedQueryInterface, type_id: ComponentTypeId) bool {
+            return std.mem.indexOfScalar(ComponentTypeId, self.component_ids, type_id) != null;
+        }
+    };
+
+
+    /// Memory allocator
+    allocator: std.mem.Allocator,
+    /// Dense lists of storages registered from now on, `allocator` when null
+    dense_allocator: ?std.mem.Allocator = null,
+    /// Tracks entity generations
+    generations: std.ArrayList(u32),
+    /// Stores available entity indices for reuse
+    free_indices: std.ArrayList(u32),
+    /// Components each entity has, parallel to `generations`
+    masks: std.ArrayList(ComponentMask),
+    /// Component storage instances indexed by componentIndex(T), null for types this registry never registered
+    component_stores: std.ArrayListUnmanaged(?ComponentStorageInterface),
+    /// Type IDs of the tags this registry has seen, they are written to snapshots from the masks
+    tag_types: std.ArrayListUnmanaged(TagType) = .{},
+    /// Bits of the tags in tag_types
+    tag_mask: ComponentMask = ComponentMask.initEmpty(),
+    /// Owning groups, each keeps its members packed at the front of the storages it owns
+    groups: std.ArrayListUnmanaged(GroupInterface) = .{},
+    /// Singleton values indexed by resourceIndex(T), null for types never set
+    resources: std.ArrayListUnmanaged(?Resource) = .{},
+    /// Event channels, each also stored as the resource Events(T)
+    event_channels: std.ArrayListUnmanaged(EventsInterface) = .{},
+    /// Persistent queries keyed by their Components type, kept in sync on every structural change
+    cached_queries: std.AutoHashMap(ComponentTypeId, CachedQueryInterface),
+    /// Stamped on components as they are added, changed and removed
+    change_tick: u32 = 1,
+    /// Transient query results and scratch lists of systems, freed in bulk by endFrame
+    frame_arena: FrameArena,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Create a new registry
+    pub fn create(allocator: std.mem.Allocator) !*Self {
+        const registry_ptr = try allocator.create(Self);
+        registry_ptr.* = .{
+            .allocator = allocator,
+            .generations = std.ArrayList(u32).init(allocator),
+            .free_indices = std.ArrayList(u32).init(allocator),
+            .masks = std.ArrayList(ComponentMask).init(allocator),
+            .component_stores = .{},
+            .cached_queries = std.AutoHashMap(ComponentTypeId, CachedQueryInterface).init(allocator),
+            .frame_arena = FrameArena.init(allocator),
+        };
+        return registry_ptr;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Allocate the dense lists of components registered after this call from `dense_allocator`
+    /// With a VirtualAllocator they grow in place: component pointers then stay valid as the storage grows,
+    /// though removals still swap the last component into the hole. It has to outlive the registry
+    pub fn setDenseAllocator(self: *Self, dense_allocator: ?std.mem.Allocator) void {
+        self.dense_allocator = dense_allocator;
+    }
+
+
+    /// Create a new entity
+    pub fn createEntity(self: *Self) !EntityId {
+        
+        // Reuse a freed entity index if available
+        if (self.free_indices.items.len > 0) {
+            const index = self.free_indices.pop() orelse unreachable; // Should never fail since length is checked 
+            const generation = self.generations.items[index];
+            return EntityId{ .index = index, .generation = generation };
+        }
+
+        // Create a new entity at the end
+        const index: u32 = @intCast(self.generations.items.len);
+        try self.masks.ensureUnusedCapacity(1);
+        try self.generations.append(1);
+        self.masks.appendAssumeCapacity(ComponentMask.initEmpty());
+        return EntityId{ .index = index, .generation = 1 };
+    }
+
+
+    /// Create `entities.len` entities at once, reusing freed indices first
+    pub fn createEntities(self: *Self, entities: []EntityId) !void {
+        const reused = @min(entities.len, self.free_indices.items.len);
+        try self.generations.ensureUnusedCapacity(entities.len - reused);
+        try self.masks.ensureUnusedCapacity(entities.len - reused);
+
+        for (entities[0..reused]) |*entity| {
+            const index = self.free_indices.pop() orelse unreachable; // Should never fail since length is checked
+            entity.* = .{ .index = index, .generation = self.generations.items[index] };
+        }
+
+        for (entities[reused..]) |*entity| {
+            entity.* = .{ .index = @intCast(self.generations.items.len), .generation = 1 };
+            self.generations.appendAssumeCapacity(1);
+            self.masks.appendAssumeCapacity(ComponentMask.initEmpty());
+        }
+    }
+
+
+    /// Destroy an entity and all its components
+    pub fn destroyEntity(self: *Self, entity: EntityId) !void {
+
+        if (!self.isValidEntity(entity)) {
+            return EcsError.InvalidEntity;
+        }
+
+        // Groups first, so the removals below only ever take slots behind them
+        self.leaveGroups(entity, null);
+
+        const mask = self.masks.items[entity.index];
+        defer self.flushRemoved(mask);
+        try self.removeComponentsOf(entity);
+        try self.syncRequiring(entity, mask);
+
+        // Mark entity as free and add 1 to generation to invalidate existing references
+        try self.free_indices.append(entity.index);
+        self.generations.items[entity.index] += 1;
+    }
+
+
+    /// Destroy many entities, each only visiting the storages its mask names
+    pub fn destroyEntities(self: *Self, entities: []const EntityId) !void {
+        for (entities) |entity| {
+            if (!self.isValidEntity(entity)) {
+                return EcsError.InvalidEntity;
+            }
+        }
+        try self.free_indices.ensureUnusedCapacity(entities.len);
+
+        // on_remove hooks get the whole batch of each storage in one call
+        var removed = ComponentMask.initEmpty();
+        defer self.flushRemoved(removed);
+
+        // Duplicates in the batch find an empty mask the second time
+        for (entities) |entity| {
+            self.leaveGroups(entity, null);
+            const mask = self.masks.items[entity.index];
+            removed.setUnion(mask);
+            try self.removeComponentsOf(entity);
+            try self.syncRequiring(entity, mask);
+        }
+
+        for (entities) |entity| {
+            // Skip duplicates in the batch, their generation was already bumped
+            if (self.generations.items[entity.index] != entity.generation) continue;
+            self.free_indices.appendAssumeCapacity(entity.index);
+            self.generations.items[entity.index] += 1;
+        }
+    }
+
+
+    /// Copy an entity with its components and tags into another registry, returns the new entity there
+    /// Components registered with a deinit function need a `clone` method, see Prefab
+    /// The thread calling this must be the only one using either registry until it returns
+    pub fn copyEntityTo(self: *Self, destination: *Registry, entity: EntityId) !EntityId {
+        return self.transferEntity(destination, entity, false);
+    }
+
+
+    /// Move an entity into another registry and destroy it here, returns the new entity there
+    /// Component values are handed over as they are, so nothing needs to be cloneable
+    pub fn moveEntityTo(self: *Self, destination: *Registry, entity: EntityId) !EntityId {
+        return self.transferEntity(destination, entity, true);
+    }
+
+
+    /// Move every entity into `destination` with one bulk add per storage and leave this registry empty
+    /// The new entities are appended to `out` in entity index order. Meant for staging registries filled
+    /// off the main thread, e.g. a loadSnapshot of one WorldPartitionSystem cell
+    pub fn moveAllTo(self: *Self, destination: *Registry, out: *std.ArrayList(EntityId)) !void {
+        std.debug.assert(self != destination);
+        const count = self.generations.items.len;
+        const live_count = count - self.free_indices.items.len;
+
+        // Destination entity of every index, invalid for free ones, live ones are marked first
+        const map = try self.allocator.alloc(EntityId, count);
+        defer self.allocator.free(map);
+        @memset(map, EntityId{ .index = 0, .generation = 1 });
+        for (self.free_indices.items) |index| map[index] = EntityId.invalid();
+
+        try self.free_indices.ensureUnusedCapacity(live_count);
+        const created = try out.addManyAsSlice(live_count);
+        destination.createEntities(created) catch |e| {
+            out.shrinkRetainingCapacity(out.items.len - live_count);
+            return e;
+        };
+        var next: usize = 0;
+        for (map) |*target| {
+            if (!target.isValid()) continue;
+            target.* = created[next];
+            next += 1;
+        }
+
+        // Groups hand their members back before the storages empty under them
+        for (map, 0..) |target, index| {
+            if (!target.isValid()) continue;
+            self.leaveGroups(.{ .index = @intCast(index), .generation = self.generations.items[index] }, null);
+        }
+
+        for (self.component_stores.items) |maybe_interface| {
+            const interface = maybe_interface orelse continue;
+            try interface.move_all_fn(interface.ptr, destination, map);
+        }
+
+        for (map, 0..) |target, index| {
+            if (!target.isValid()) continue;
+            const entity = EntityId{ .index = @intCast(index), .generation = self.generations.items[index] };
+            const mask = self.masks.items[index];
+
+            var tags = mask.intersectWith(self.tag_mask).iterator(.{});
+            while (tags.next()) |tag_index| {
+                for (self.tag_types.items) |tag| {
+                    if (tag.component_index == tag_index) try destination.adoptTag(tag, target);
+                }
+            }
+
+            self.masks.items[index] = ComponentMask.initEmpty();
+            try self.syncRequiring(entity, mask);
+            self.free_indices.appendAssumeCapacity(entity.index);
+            self.generations.items[index] += 1;
+        }
+    }
+
+
+    /// Check if an entity ID is valid in this registry
+    pub fn isValidEntity(self: Self, entity: EntityId) bool {
+        return entity.index < self.generations.items.len and
+               self.generations.items[entity.index] == entity.generation;
+    }
+
+
+    /// Register a component type with automatic cleanup using specified deinit function
+    pub fn registerDeferedComponent(self: *Self, comptime T: type, comptime deinit_fn_name: []const u8) !void {        
+        try self.registerComponentInternal(T, deinit_fn_name);
+    }
+
+
+    /// Register a component type
+    pub fn registerComponent(self: *Self, comptime T: type) !void {
+        try self.registerComponentInternal(T, null);
+    }
+
+
+    /// Add a component to an entity, tags just set their bit and need no registration
+    pub fn addComponent(self: *Self, entity: EntityId, component: anytype) !void {
+        const T = @TypeOf(component);
+        if (!self.isValidEntity(entity)) {
+            return EcsError.InvalidEntity;
+        }
+
+        if (comptime isTag(T)) {
+            const index = try self.registerTag(T);
+            const mask = &self.masks.items[entity.index];
+            if (mask.isSet(index)) return EcsError.DuplicateComponent;
+            mask.set(index);
+            try self.syncCachedQueries(entity, typeId(T));
+            return;
+        }
+
+        const storage = try self.getComponentStorage(T);
+        try storage.add(entity, component);
+        self.masks.items[entity.index].set(componentIndex(T));
+        self.joinGroups(entity, typeId(T));
+        try self.syncCachedQueries(entity, typeId(T));
+    }
+
+
+    /// Add a component of type `T` to every entity, `values[i]` goes to `entities[i]`
+    /// The storage is looked up once and reserved for the whole batch
+    pub fn addComponents(self: *Self, entities: []const EntityId, comptime T: type, values: []const T) !void {
+        for (entities) |entity| {
+            if (!self.isValidEntity(entity)) {
+                return EcsError.InvalidEntity;
+            }
+        }
+
+        if (comptime isTag(T)) {
+            const index = try self.registerTag(T);
+            var duplicate = false;
+            for (entities) |entity| {
+                const mask = &self.masks.items[entity.index];
+                if (mask.isSet(index)) {
+                    duplicate = true;
+                    continue;
+                }
+                mask.set(index);
+                try self.syncCachedQueries(entity, typeId(T));
+            }
+            if (duplicate) return EcsError.DuplicateComponent;
+            return;
+        }
+
+        const storage = try self.getComponentStorage(T);
+        const added = storage.addMany(entities, values);
+
+        // Keep masks and cached queries in step with whatever made it into the storage, even on error
+        const index = componentIndex(T);
+        const type_id = typeId(T);
+        for (entities) |entity| {
+            if (!storage.contains(entity)) continue;
+            self.masks.items[entity.index].set(index);
+            self.joinGroups(entity, type_id);
+            try self.syncCachedQueries(entity, type_id);
+        }
+        try added;
+    }
+
+
+    /// Give entities whose components went straight into the storages the mask bits, groups and cached
+    /// queries for them, used by Prefab.instantiate after its bulk copies
+    pub fn markAdded(self: *Self, entities: []const EntityId, mask: ComponentMask) !void {
+        for (entities) |entity| {
+            self.masks.items[entity.index].setUnion(mask);
+
+            var bits = mask.iterator(.{});
+            while (bits.next()) |index| {
+                if (index >= self.component_stores.items.len) continue;
+                const interface = self.component_stores.items[index] orelse continue;
+                self.joinGroups(entity, interface.type_id);
+            }
+            try self.syncRequiring(entity, self.masks.items[entity.index]);
+        }
+    }
+
+
+    /// Remove a component from an entity
+    pub fn removeComponent(self: *Self, entity: EntityId, comptime T: type) !void {
+        if (comptime isTag(T)) {
+            if (!self.isValidEntity(entity)) return EcsError.InvalidEntity;
+            const index = componentIndexChecked(T) orelse return EcsError.ComponentNotFound;
+            const mask = &self.masks.items[entity.index];
+            if (!mask.isSet(index)) return EcsError.ComponentNotFound;
+            mask.unset(index);
+            try self.syncCachedQueries(entity, typeId(T));
+            return;
+        }
+
+        const storage = try self.getComponentStorage(T);
+        if (storage.contains(entity)) self.leaveGroups(entity, typeId(T));
+        try storage.remove(entity);
+        storage.flushRemoved();
+        self.masks.items[entity.index].unset(componentIndex(T));
+        try self.syncCachedQueries(entity, typeId(T));
+    }
+    
+
+    /// Install the batched on_add and on_remove callbacks of a component type, replacing the old ones
+    pub fn setHooks(self: *Self, comptime T: type, hooks: ComponentStorage(T).Hooks) !void {
+        const storage = try self.getComponentStorage(T);
+        storage.flushRemoved();
+        storage.hooks = hooks;
+    }
+
+
+    /// Get a component from an entity, marks it changed for Changed(T) filters
+    pub fn getComponent(self: *Self, entity: EntityId, comptime T: type) ?*T {
+        if (comptime isTag(T)) @compileError("tag " ++ @typeName(T) ++ " has no data, use hasComponent");
+        const storage = self.getComponentStorage(T) catch return null;
+        return storage.getMut(entity);
+    }
+
+
+    /// Check if an entity has a component or tag, from its mask alone
+    pub fn hasComponent(self: *const Self, entity: EntityId, comptime T: type) bool {
+        if (!self.isValidEntity(entity)) return false;
+        const index = componentIndexChecked(T) orelse return false;
+        return self.masks.items[entity.index].isSet(index);
+    }
+
+
+    /// Store the one value of type `T` in this registry, replacing the old one, and return where it lives
+    /// Lives until removeResource or release, which free the box but never run anything on the value
+    /// Systems name resources in their scheduler Access struct like components, `*T` writes and `*const T` reads
+    pub fn setResource(self: *Self, value: anytype) !*@TypeOf(value) {
+        const T = @TypeOf(value);
+        if (self.getResource(T)) |existing| {
+            existing.* = value;
+            return existing;
+        }
+
+        const index = resourceIndex(T);
+        if (index >= self.resources.items.len) {
+            try self.resources.appendNTimes(self.allocator, null, index + 1 - self.resources.items.len);
+        }
+
+        const value_ptr = try self.allocator.create(T);
+        value_ptr.* = value;
+        self.resources.items[index] = Resource.create(T, value_ptr);
+        return value_ptr;
+    }
+
+
+    /// The resource of type `T`, one index into the resource list without hashing or querying
+    pub fn getResource(self: *Self, comptime T: type) ?*T {
+        const index = resourceIndex(T);
+        if (index >= self.resources.items.len) return null;
+        const resource = self.resources.items[index] orelse return null;
+        return @as(*T, @ptrCast(@alignCast(resource.ptr)));
+    }
+
+
+    /// Take the resource of type `T` out of the registry, null if it was never set
+    pub fn removeResource(self: *Self, comptime T: type) ?T {
+        const value_ptr = self.getResource(T) orelse return null;
+        const value = value_ptr.*;
+        self.allocator.destroy(value_ptr);
+        self.resources.items[resourceIndex(T)] = null;
+        return value;
+    }
+
+
+    /// Create the event channel of `T`, or return it when it exists already
+    /// Workers of `pool` may send into it concurrently with Events.sendConcurrent
+    pub fn registerEvents(self: *Self, comptime T: type, pool: ?*const JobSystem) !*Events(T) {
+        if (self.getResource(Events(T))) |channel| return channel;
+
+        try self.event_channels.ensureUnusedCapacity(self.allocator, 1);
+        var channel = try Events(T).init(self.allocator, pool);
+        errdefer channel.deinit();
+        const stored = try self.setResource(channel);
+        self.event_channels.appendAssumeCapacity(EventsInterface.create(T, stored));
+        return stored;
+    }
+
+
+    /// The event channel of `T`, null until registerEvents
+    pub fn events(self: *Self, comptime T: type) ?*Events(T) {
+        return self.getResource(Events(T));
+    }
+
+
+    /// Move every channel on to the next update, once per frame at a point no system is sending
+    pub fn updateEvents(self: *Self) !void {
+        for (self.event_channels.items) |interface| {
+            try interface.update_fn(interface.ptr);
+        }
+    }
+
+
+    /// Allocator for data that lives until the end of the next frame, main thread only
+    pub fn frameAllocator(self: *Self) std.mem.Allocator {
+        return self.frame_arena.allocator();
+    }
+
+
+    /// Close the frame, frees what the frame before it took from frameAllocator
+    pub fn endFrame(self: *Self) void {
+        self.frame_arena.endFrame();
+    }
+
+
+    /// Start a new change detection period, returns the tick that just ended
+    /// Changes stamped from now on compare greater than the returned tick
+    pub fn advanceTick(self: *Self) u32 {
+        // Systems on different workers may reset their cached queries at the same time
+        return @atomicRmw(u32, &self.change_tick, .Add, 1, .monotonic);
+    }
+
+
+    /// Live entities and the components they hold
+    pub fn stats(self: *const Self) RegistryStats {
+        var result = RegistryStats{
+            .entities = @intCast(self.generations.items.len - self.free_indices.items.len),
+            .free_slots = @intCast(self.free_indices.items.len),
+        };
+        for (self.component_stores.items) |maybe_interface| {
+            const interface = maybe_interface orelse continue;
+            result.storages += 1;
+            result.components += interface.entities_fn(interface.ptr).len;
+            result.storage_bytes += interface.memory_fn(interface.ptr).totalBytes();
+        }
+        return result;
+    }
+
+
+    /// Count and memory of every storage, caller frees the slice with `allocator`
+    pub fn storageStats(self: *const Self, allocator: std.mem.Allocator) ![]StorageStats {
+        var result = std.ArrayList(StorageStats).init(allocator);
+        errdefer result.deinit();
+        for (self.component_stores.items) |maybe_interface| {
+            const interface = maybe_interface orelse continue;
+            try result.append(.{
+                .type_name = interface.type_name,
+                .component_index = interface.component_index,
+                .memory = interface.memory_fn(interface.ptr),
+            });
+        }
+        return result.toOwnedSlice();
+    }
+
+
+    /// Get the storage for a component type, for systems that walk every component linearly
+    pub fn getComponentStorage(self: *Self, comptime T: type) !*ComponentStorage(T) {
+        if (comptime isTag(T)) @compileError("tag " ++ @typeName(T) ++ " has no storage, query it with With(T) or Without(T)");
+        const index = componentIndex(T);
+        if (index >= self.component_stores.items.len) return EcsError.ComponentNotFound;
+
+        const interface = self.component_stores.items[index] orelse
+            return EcsError.ComponentNotFound;
+        return @as(*ComponentStorage(T), @ptrCast(@alignCast(interface.ptr)));
+    }
+
+
+    /// Stable ID for a component or query type, hashed at compile time
+    /// Also used by schedulers and cached queries to compare access sets
+    pub fn typeId(comptime T: type) ComponentTypeId {
+        return comptime std.hash.Wyhash.hash(0, @typeName(T));
+    }
+
+
+    /// Dense index of a component type, shared by every registry in the process
+    /// Assigned on first use, after that it is a single atomic load
+    pub fn componentIndex(comptime T: type) u32 {
+        const Slot = struct {
+            const Component = T;
+            var index: u32 = unassigned_index;
+        };
+
+        const current = @atomicLoad(u32, &Slot.index, .acquire);
+        if (current != unassigned_index) return current;
+
+        // Another thread may assign the same type first, its index wins and ours stays unused
+        const candidate = next_component_index.fetchAdd(1, .monotonic);
+        return @cmpxchgStrong(u32, &Slot.index, unassigned_index, candidate, .acq_rel, .acquire) orelse candidate;
+    }
+
+
+    /// Create a query for entities with specific components
+    pub fn query(self: *Self, comptime Components: type) !Query(Components) {
+        return Query(Components).init(self);
+    }
+
+
+    /// Get the persistent query for `Components`, creating it on first use
+    /// Its entity list is updated as components are added and removed, so iterating it never probes misses
+    pub fn cachedQuery(self: *Self, comptime Components: type) !*CachedQuery(Components) {
+        const query_id = typeId(Components);
+        if (self.cached_queries.get(query_id)) |interface| {
+            return @as(*CachedQuery(Components), @ptrCast(@alignCast(interface.ptr)));
+        }
+
+        const cached = try self.allocator.create(CachedQuery(Components));
+        errdefer self.allocator.destroy(cached);
+        cached.* = try CachedQuery(Components).init(self);
+        errdefer cached.deinit();
+
+        try self.cached_queries.put(query_id, CachedQueryInterface.create(Components, cached));
+        return cached;
+    }
+
+
+    /// Get the owning group of `A` and `B`, creating it on first use
+    /// From then on entities with both sit at the front of both storages in the same order. Both types have
+    /// to be registered, and a storage can't be owned by two groups or be reordered while it is owned
+    pub fn group(self: *Self, comptime A: type, comptime B: type) !*Group(A, B) {
+        if (self.getGroup(A, B)) |existing| return existing;
+
+        const a = try self.getComponentStorage(A);
+        const b = try self.getComponentStorage(B);
+        if (a.owned or b.owned) return EcsError.StorageOwnedByGroup;
+
+        const group_ptr = try self.allocator.create(Group(A, B));
+        errdefer self.allocator.destroy(group_ptr);
+        group_ptr.* = Group(A, B).init(a, b);
+
+        try self.groups.append(self.allocator, GroupInterface.create(A, B, group_ptr));
+        a.owned = true;
+        b.owned = true;
+        group_ptr.rebuild();
+        return group_ptr;
+    }
+
+
+    /// The owning group of `A` and `B` if one was created, for systems that use it when it is there
+    pub fn getGroup(self: *Self, comptime A: type, comptime B: type) ?*Group(A, B) {
+        const group_id = typeId(Group(A, B));
+        for (self.groups.items) |interface| {
+            if (interface.type_id == group_id) return @as(*Group(A, B), @ptrCast(@alignCast(interface.ptr)));
+        }
+        return null;
+    }
+
+
+    /// Write the entity table and every pointer-free component storage as raw arrays
+    /// Pass any writer through `.any()`, e.g. `buffered.writer().any()`
+    pub fn saveSnapshot(self: *Self, writer: std.io.AnyWriter) !void {
+        try writer.writeAll(snapshot_magic);
+        try writer.writeInt(u32, snapshot_version, native_endian);
+
+        // Entity table
+        try writer.writeInt(u32, @intCast(self.generations.items.len), native_endian);
+        try writer.writeAll(std.mem.sliceAsBytes(self.generations.items));
+        try writer.writeInt(u32, @intCast(self.free_indices.items.len), native_endian);
+        try writer.writeAll(std.mem.sliceAsBytes(self.free_indices.items));
+
+        // Storages, each tagged with its type ID and component size
+        var storage_count: u32 = 0;
+        for (self.component_stores.items) |maybe_interface| {
+            const interface = maybe_interface orelse continue;
+            if (interface.save_fn != null) storage_count += 1;
+        }
+        try writer.writeInt(u32, storage_count, native_endian);
+
+        for (self.component_stores.items) |maybe_interface| {
+            const interface = maybe_interface orelse continue;
+            const save_fn = interface.save_fn orelse continue;
+            try writer.writeInt(u64, interface.type_id, native_endian);
+            try save_fn(interface.ptr, writer);
+        }
+
+        // Tags, as the index of every entity that has them
+        try writer.writeInt(u32, @intCast(self.tag_types.items.len), native_endian);
+        for (self.tag_types.items) |tag| {
+            var count: u32 = 0;
+            for (self.masks.items) |mask| count += @intFromBool(mask.isSet(tag.component_index));
+
+            try writer.writeInt(u64, tag.type_id, native_endian);
+            try writer.writeInt(u32, count, native_endian);
+            for (self.masks.items, 0..) |mask, index| {
+                if (mask.isSet(tag.component_index)) try writer.writeInt(u32, @intCast(index), native_endian);
+            }
+        }
+    }
+
+
+    /// Replace every entity and component with a snapshot written by saveSnapshot
+    /// The same component types and tags must be registered, components that hold pointers come back empty
+    /// Storages in the snapshot that this registry doesn't know are an error, they can't be skipped safely
+    pub fn loadSnapshot(self: *Self, reader: std.io.AnyReader) !void {
+        var magic: [snapshot_magic.len]u8 = undefined;
+        try reader.readNoEof(&magic);
+        if (!std.mem.eql(u8, &magic, snapshot_magic)) return EcsError.InvalidSnapshot;
+        if (try reader.readInt(u32, native_endian) != snapshot_version) return EcsError.InvalidSnapshot;
+
+        // Drop the current world
+        for (self.component_stores.items) |maybe_interface| {
+            const interface = maybe_interface orelse continue;
+            interface.clear_fn(interface.ptr);
+        }
+
+        // Entity table
+        const entity_count = try reader.readInt(u32, native_endian);
+        try self.generations.resize(entity_count);
+        try reader.readNoEof(std.mem.sliceAsBytes(self.generations.items));
+        const free_count = try reader.readInt(u32, native_endian);
+        try self.free_indices.resize(free_count);
+        try reader.readNoEof(std.mem.sliceAsBytes(self.free_indices.items));
+
+        try self.masks.resize(entity_count);
+        @memset(self.masks.items, ComponentMask.initEmpty());
+
+        // Storages
+        const storage_count = try reader.readInt(u32, native_endian);
+        for (0..storage_count) |_| {
+            const type_id = try reader.readInt(u64, native_endian);
+            const interface = self.storageByTypeId(type_id) orelse return EcsError.InvalidSnapshot;
+            const load_fn = interface.load_fn orelse return EcsError.InvalidSnapshot;
+            try load_fn(interface.ptr, reader);
+        }
+
+        // Tags go straight into the masks
+        const tag_count = try reader.readInt(u32, native_endian);
+        for (0..tag_count) |_| {
+            const type_id = try reader.readInt(u64, native_endian);
+            const tag = for (self.tag_types.items) |tag| {
+                if (tag.type_id == type_id) break tag;
+            } else return EcsError.InvalidSnapshot;
+
+            const count = try reader.readInt(u32, native_endian);
+            for (0..count) |_| {
+                const index = try reader.readInt(u32, native_endian);
+                if (index >= entity_count) return EcsError.InvalidSnapshot;
+                self.masks.items[index].set(tag.component_index);
+            }
+        }
+
+        // Component masks are per process, rebuild them from the loaded storages
+        for (self.component_stores.items) |maybe_interface| {
+            const interface = maybe_interface orelse continue;
+            for (interface.entities_fn(interface.ptr)) |entity| {
+                if (!self.isValidEntity(entity)) return EcsError.InvalidSnapshot;
+                self.masks.items[entity.index].set(interface.component_index);
+            }
+        }
+
+        // Groups pack the loaded storages again, and cached queries start over from the new masks
+        for (self.groups.items) |interface| {
+            interface.rebuild_fn(interface.ptr);
+        }
+        var queries = self.cached_queries.valueIterator();
+        while (queries.next()) |interface| {
+            try interface.rebuild_fn(interface.ptr);
+        }
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Free all resources and destroy the registry
+    pub fn release(self: *Self) void {
+
+        // Deinit all cached queries
+        var queries = self.cached_queries.valueIterator();
+        while (queries.next()) |interface| {
+            interface.deinit_fn(interface.ptr, self.allocator);
+        }
+
+        for (self.groups.items) |interface| {
+            interface.deinit_fn(interface.ptr, self.allocator);
+        }
+
+        for (self.event_channels.items) |interface| {
+            interface.deinit_fn(interface.ptr);
+        }
+
+        for (self.resources.items) |maybe_resource| {
+            const resource = maybe_resource orelse continue;
+            resource.destroy_fn(resource.ptr, self.allocator);
+        }
+
+        // Deinit all component storages
+        for (self.component_stores.items) |maybe_interface| {
+            const interface = maybe_interface orelse continue;
+            interface.deinit_fn(interface.ptr, self.allocator);
+        }
+
+        // Deinit other resources
+        self.cached_queries.deinit();
+        self.component_stores.deinit(self.allocator);
+        self.tag_types.deinit(self.allocator);
+        self.groups.deinit(self.allocator);
+        self.resources.deinit(self.allocator);
+        self.event_channels.deinit(self.allocator);
+        self.generations.deinit();
+        self.free_indices.deinit();
+        self.masks.deinit();
+        self.frame_arena.deinit();
+
+        // Free the registry itself
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Internal function to register a component with optional auto-deinit
+    fn registerComponentInternal(self: *Self, comptime T: type, comptime deinit_fn_name: ?[]const u8) !void {
+        if (comptime isTag(T)) {
+            _ = try self.registerTag(T);
+            return;
+        }
+
+        const index = componentIndexChecked(T) orelse return EcsError.TooManyComponents;
+        if (index >= self.component_stores.items.len) {
+            try self.component_stores.appendNTimes(self.allocator, null, index + 1 - self.component_stores.items.len);
+        }
+        if (self.component_stores.items[index] != null) {
+            return; // Already registered
+        }
+        
+        // Create new component storage
+        const store = try self.allocator.create(ComponentStorage(T));
+        store.* = ComponentStorage(T).initWithDense(self.allocator, self.dense_allocator orelse self.allocator);
+        store.change_tick = &self.change_tick;
+        
+        // Add to component stores
+        self.component_stores.items[index] = ComponentStorageInterface.create(T, store, deinit_fn_name);
+    }
+
+
+    /// Dense index of a resource type, assigned on first use like componentIndex
+    fn resourceIndex(comptime T: type) u32 {
+        const Slot = struct {
+            const Value = T;
+            var index: u32 = unassigned_index;
+        };
+
+        const current = @atomicLoad(u32, &Slot.index, .acquire);
+        if (current != unassigned_index) return current;
+
+        const candidate = next_resource_index.fetchAdd(1, .monotonic);
+        return @cmpxchgStrong(u32, &Slot.index, unassigned_index, candidate, .acq_rel, .acquire) orelse candidate;
+    }
+
+
+    fn transferEntity(self: *Self, destination: *Registry, entity: EntityId, move: bool) !EntityId {
+        std.debug.assert(self != destination);
+        if (!self.isValidEntity(entity)) {
+            return EcsError.InvalidEntity;
+        }
+
+        // Check everything up front so a failed copy leaves nothing half done behind
+        const mask = self.masks.items[entity.index];
+        var bits = mask.iterator(.{});
+        while (bits.next()) |index| {
+            if (self.tag_mask.isSet(index)) continue;
+            const interface = self.component_stores.items[index] orelse continue;
+            if (!move and !interface.cloneable) return EcsError.ComponentNotCloneable;
+        }
+
+        const copy = try destination.createEntity();
+        errdefer destination.destroyEntity(copy) catch {};
+
+        bits = mask.iterator(.{});
+        while (bits.next()) |index| {
+            if (self.tag_mask.isSet(index)) {
+                for (self.tag_types.items) |tag| {
+                    if (tag.component_index == index) try destination.adoptTag(tag, copy);
+                }
+                continue;
+            }
+            const interface = self.component_stores.items[index] orelse continue;
+            try interface.transfer_fn(interface.ptr, destination, entity, copy, move);
+        }
+
+        // Removing never runs deinit functions, so the moved values now belong to the copy alone
+        if (move) try self.destroyEntity(entity);
+        return copy;
+    }
+
+
+    /// Give `entity` a tag another registry registered
+    fn adoptTag(self: *Self, tag: TagType, entity: EntityId) !void {
+        if (!self.tag_mask.isSet(tag.component_index)) {
+            try self.tag_types.append(self.allocator, tag);
+            self.tag_mask.set(tag.component_index);
+        }
+        self.masks.items[entity.index].set(tag.component_index);
+        try self.syncCachedQueries(entity, tag.type_id);
+    }
+
+
+    /// Remember a tag type for snapshots, returns its component index
+    fn registerTag(self: *Self, comptime T: type) !u32 {
+        const index = componentIndexChecked(T) orelse return EcsError.TooManyComponents;
+        if (self.tag_mask.isSet(index)) return index;
+
+        try self.tag_types.append(self.allocator, .{ .type_id = typeId(T), .component_index = index });
+        self.tag_mask.set(index);
+        return index;
+    }
+
+
+    fn storageByTypeId(self: *Self, type_id: ComponentTypeId) ?ComponentStorageInterface {
+        for (self.component_stores.items) |maybe_interface| {
+            const interface = maybe_interface orelse continue;
+            if (interface.type_id == type_id) return interface;
+        }
+        return null;
+    }
+
+
+    /// Remove the components named by the entity's mask from their storages and clear the mask
+    /// Tags have no storage, clearing the mask is all they need
+    fn removeComponentsOf(self: *Self, entity: EntityId) !void {
+        var bits = self.masks.items[entity.index].iterator(.{});
+        while (bits.next()) |index| {
+            if (index >= self.component_stores.items.len) continue;
+            const interface = self.component_stores.items[index] orelse continue;
+            try interface.remove_fn(interface.ptr, entity);
+        }
+        self.masks.items[entity.index] = ComponentMask.initEmpty();
+    }
+
+
+    /// Deliver the on_remove batches of the storages in `mask`
+    fn flushRemoved(self: *Self, mask: ComponentMask) void {
+        var bits = mask.iterator(.{});
+        while (bits.next()) |index| {
+            if (index >= self.component_stores.items.len) continue;
+            const interface = self.component_stores.items[index] orelse continue;
+            interface.flush_removed_fn(interface.ptr);
+        }
+    }
+
+
+    /// Re-check `entity` in the cached queries whose required components are all in `mask`
+    /// Covers every query a destroyed entity was in with the mask it had, or a new one may join with its new mask
+    fn syncRequiring(self: *Self, entity: EntityId, mask: ComponentMask) !void {
+        var queries = self.cached_queries.valueIterator();
+        while (queries.next()) |interface| {
+            if (mask.mask & interface.required.mask != interface.required.mask) continue;
+            try interface.sync_fn(interface.ptr, entity);
+        }
+    }
+
+
+    /// Let the groups owning `type_id` take `entity` in
+    fn joinGroups(self: *Self, entity: EntityId, type_id: ComponentTypeId) void {
+        for (self.groups.items) |interface| {
+            if (interface.owns(type_id)) interface.join_fn(interface.ptr, entity);
+        }
+    }
+
+
+    /// Move `entity` out of the groups owning `type_id`, or out of every group when null
+    fn leaveGroups(self: *Self, entity: EntityId, type_id: ?ComponentTypeId) void {
+        for (self.groups.items) |interface| {
+            if (type_id == null or interface.owns(type_id.?)) interface.leave_fn(interface.ptr, entity);
+        }
+    }
+
+
+    /// Re-check membership of `entity` in every cached query that depends on `type_id`
+    fn syncCachedQueries(self: *Self, entity: EntityId, type_id: ComponentTypeId) !void {
+        var queries = self.cached_queries.valueIterator();
+        while (queries.next()) |interface| {
+            if (!interface.dependsOn(type_id)) continue;
+            try interface.sync_fn(interface.ptr, entity);
+        }
+    }
+
+};
+
+
+
+
+
+
+
+
+
+
+// ============================================================
+// Public API: Query Filters
+// ============================================================
+
+/// Conditions a query field can require without fetching the component
+pub const FilterKind = enum {
+    /// Entity has the component
+    with,
+    /// Entity does not have the component
+    without,
+    /// Component was added after the query's since tick
+    added,
+    /// Component was mutably accessed after the query's since tick
+    changed,
+    /// Component was removed after the query's since tick, the entity no longer has it
+    removed,
+};
+
+
+/// Query field that requires `T` without fetching it
+pub fn With(comptime T: type) type {
+    return Filter(T, .with);
+}
+
+
+/// Query field that rejects entities that have `T`
+pub fn Without(comptime T: type) type {
+    return Filter(T, .without);
+}
+
+
+/// Query field that matches entities whose `T` was added since the query last ran
+pub fn Added(comptime T: type) type {
+    return Filter(T, .added);
+}
+
+
+/// Query field that matches entities whose `T` was mutably accessed since the query last ran
+pub fn Changed(comptime T: type) type {
+    return Filter(T, .changed);
+}
+
+
+/// Query field that matches entities that lost `T` since the query last ran
+pub fn Removed(comptime T: type) type {
+    return Filter(T, .removed);
+}
+
+
+fn Filter(comptime T: type, comptime kind: FilterKind) type {
+    return struct {
+        pub const Component = T;
+        pub const query_filter = kind;
+    };
+}
+
+
+/// Change tick for storages that are not owned by a registry
+const untracked_tick: u32 = 0;
+
+
+/// Dense index of `T`, null if it doesn't fit in a ComponentMask
+fn componentIndexChecked(comptime T: type) ?u32 {
+    const index = Registry.componentIndex(T);
+    return if (index < MAX_COMPONENTS) index else null;
+}
+
+
+/// What a query field asks of an entity
+const FieldRole = enum {
+    /// `*T` or `*const T`, entity must have the component
+    required,
+    /// `?*T` or `?*const T`, null when the entity doesn't have the component
+    optional,
+    with,
+    without,
+    added,
+    changed,
+    removed,
+};
+
+
+fn isFilter(comptime Field: type) bool {
+    return @typeInfo(Field) == .@"struct" and @hasDecl(Field, "query_filter");
+}
+
+
+fn fieldRole(comptime Field: type) FieldRole {
+    if (isFilter(Field)) {
+        return switch (Field.query_filter) {
+            .with => .with,
+            .without => .without,
+            .added => .added,
+            .changed => .changed,
+            .removed => .removed,
+        };
+    }
+    return switch (@typeInfo(Field)) {
+        .pointer => .required,
+        .optional => .optional,
+        else => @compileError("query fields must be *T, *const T, ?*T, ?*const T or a query filter, found " ++ @typeName(Field)),
+    };
+}
+
+
+/// Pointer type a `*T` or `?*T` field resolves to
+fn FieldPointer(comptime Field: type) type {
+    return switch (@typeInfo(Field)) {
+        .optional => |opt| opt.child,
+        else => Field,
+    };
+}
+
+
+/// Component type a query field refers to
+fn FieldComponent(comptime Field: type) type {
+    if (isFilter(Field)) return Field.Component;
+    return @typeInfo(FieldPointer(Field)).pointer.child;
+}
+
+
+/// Storage reference a query keeps for a field, With/Without only need the component mask
+fn FieldStorage(comptime Field: type) type {
+    return switch (fieldRole(Field)) {
+        .with, .without => void,
+        .optional => ?*ComponentStorage(FieldComponent(Field)),
+        else => *ComponentStorage(FieldComponent(Field)),
+    };
+}
+
+
+/// True when the entity must currently have the component
+fn requiresComponent(comptime Field: type) bool {
+    return switch (fieldRole(Field)) {
+        .required, .with, .added, .changed => true,
+        else => false,
+    };
+}
+
+
+/// True when the entity must currently not have the component
+fn excludesComponent(comptime Field: type) bool {
+    return switch (fieldRole(Field)) {
+        .without, .removed => true,
+        else => false,
+    };
+}
+
+
+/// True when the field's storage can drive iteration
+fn canLead(comptime Field: type) bool {
+    return switch (fieldRole(Field)) {
+        .required, .added, .changed => true,
+        else => false,
+    };
+}
+
+
+/// Fill the storage references of a query and build its required and excluded masks
+fn initQueryStorages(comptime Components: type, registry: *Registry, storages: anytype, required: *ComponentMask, excluded: *ComponentMask) !void {
+    comptime {
+        var has_lead = false;
+        for (std.meta.fields(Components)) |field| has_lead = has_lead or canLead(field.type);
+        if (!has_lead) @compileError("query " ++ @typeName(Components) ++ " needs at least one *T, Added(T) or Changed(T) field");
+        for (std.meta.fields(Components)) |field| {
+            const role = fieldRole(field.type);
+            if (isTag(FieldComponent(field.type)) and role != .with and role != .without) {
+                @compileError("tag " ++ @typeName(FieldComponent(field.type)) ++ " has no storage, query it with With(T) or Without(T)");
+            }
+        }
+    }
+
+    required.* = ComponentMask.initEmpty();
+    excluded.* = ComponentMask.initEmpty();
+
+    inline for (std.meta.fields(Components)) |field| {
+        const Component = FieldComponent(field.type);
+        const index = componentIndexChecked(Component) orelse return EcsError.TooManyComponents;
+
+        if (comptime requiresComponent(field.type)) required.set(index);
+        if (comptime excludesComponent(field.type)) excluded.set(index);
+
+        @field(storages, field.name) = switch (comptime fieldRole(field.type)) {
+            .with, .without => {},
+            .optional => registry.getComponentStorage(Component) catch null,
+            else => try registry.getComponentStorage(Component),
+        };
+    }
+}
+
+
+/// Check the entity's component mask against a query's required and excluded sets, one AND each
+inline fn maskMatches(registry: *const Registry, entity: EntityId, required: ComponentMask, excluded: ComponentMask) bool {
+    const mask = registry.masks.items[entity.index].mask;
+    return (mask & required.mask) == required.mask and (mask & excluded.mask) == 0;
+}
+
+
+/// Resolve every field of `Components` for `entity`, null if it doesn't match
+/// Mutable pointer fields stamp the component as changed, but only once the whole entity matched
+fn fetchComponents(comptime Components: type, query: anytype, entity: EntityId) ?Components {
+    if (!acceptsEntity(Components, query, entity)) return null;
+
+    const fields = std.meta.fields(Components);
+    var result: Components = undefined;
+    inline for (fields) |field| {
+        const storage = @field(query.storages, field.name);
+        switch (comptime fieldRole(field.type)) {
+            .required => {
+                // The mask guarantees the component is present and the entity came from a live storage
+                @field(result, field.name) = resolveField(FieldPointer(field.type), storage, storage.indexOfUnchecked(entity).?);
+            },
+            .optional => {
+                const present = if (storage) |s| s.indexOf(entity) else null;
+                @field(result, field.name) = if (present) |index| resolveField(FieldPointer(field.type), storage.?, index) else null;
+            },
+            else => {
+                @field(result, field.name) = .{};
+            },
+        }
+    }
+    return result;
+}
+
+
+/// True when `entity` has the query's mask and passes its Added, Changed and Removed filters
+fn acceptsEntity(comptime Components: type, query: anytype, entity: EntityId) bool {
+    if (!maskMatches(query.registry, entity, query.required, query.excluded)) return false;
+
+    inline for (std.meta.fields(Components)) |field| {
+        switch (comptime fieldRole(field.type)) {
+            .added, .changed, .removed => {
+                const storage = @field(query.storages, field.name);
+                if (!storage.passesFilter(field.type.query_filter, entity, query.since_tick)) return false;
+            },
+            else => {},
+        }
+    }
+    return true;
+}
+
+
+/// Pointer to the component at `index`, stamping it as changed when `Pointer` is mutable
+inline fn resolveField(comptime Pointer: type, storage: anytype, index: u32) Pointer {
+    if (comptime !@typeInfo(Pointer).pointer.is_const) storage.markChanged(index);
+    return &storage.components.items[index];
+}
+
+
+
+
+
+
+
+
+
+
+/// Query system to efficiently iterate over entities with specific components
+/// Fields are `*T` for writes, `*const T` for reads, `?*T`/`?*const T` for optional components,
+/// or With(T)/Without(T)/Added(T)/Changed(T)/Removed(T) filters
+pub fn Query(comptime Components: type) type {
+    return struct {
+        const Self = @This();
+
+        /// Reference to the registry
+        registry: *Registry,
+        /// Storage for each component type in the query
+        storages: QueryStorages,
+        /// Current index in the iteration
+        current_index: usize = 0,
+        /// Field whose storage leads iteration, the smallest one when the query started
+        lead: usize = 0,
+        /// Filters only match changes stamped after this tick, 0 matches everything
+        since_tick: u32 = 0,
+        /// Components every match must have
+        required: ComponentMask = ComponentMask.initEmpty(),
+        /// Components no match may have
+        excluded: ComponentMask = ComponentMask.initEmpty(),
+        /// Candidates probed and matched since init or resetStats, parallelForEach doesn't count
+        stats: QueryStats = .{},
+
+
+        /// Compile-time generated struct that holds references to component storages
         const QueryStorages = blk: {
             const fields = std.meta.fields(Components);
             var storage_fields: [fields.len]std.builtin.Type.StructField = undefined;
-            
+
             for (fields, 0..) |field, i| {
 
-                // Get the actual component type (handle both value and pointer types)
-                const FieldType = switch (@typeInfo(field.type)) {
-                    .pointer => |ptr| ptr.child,
-                    else => field.type,
-                };
+                // Storage reference for the field's component (void for With/Without)
+                const StorageType = FieldStorage(field.type);
 
                 storage_fields[i] = .{
                     .name = field.name,
-                    .type = *ComponentStorage(FieldType),
+                    .type = StorageType,
                     .default_value_ptr = null,
                     .is_comptime = false,
-                    .alignment = @alignOf(*ComponentStorage(FieldType)),
+                    .alignment = @alignOf(StorageType),
                 };
             }
-            
+
+            break :blk @Type(.{
+                .@"struct" = .{
+                    .layout = .auto,
+                    .fields = &storage_fields,
+                    .decls = &[_]std.builtin.Type.Declaration{},
+                    .is_tuple = false,
+                },
+            });
+        };
+
+
+        /// Compile-time generated struct with a `[]T` or `[]const T` slice for every `*T` or `*const T` field
+        /// Filter fields are void, optional components can't be sliced and only iterate with next
+        pub const Columns = blk: {
+            const fields = std.meta.fields(Components);
+            var column_fields: [fields.len]std.builtin.Type.StructField = undefined;
+
+            for (fields, 0..) |field, i| {
+                const ColumnType = switch (fieldRole(field.type)) {
+                    .required => if (@typeInfo(field.type).pointer.is_const) []const FieldComponent(field.type) else []FieldComponent(field.type),
+                    .optional => @compileError("chunks can't slice the optional field " ++ field.name ++ ", iterate with next"),
+                    else => void,
+                };
+                column_fields[i] = .{
+                    .name = field.name,
+                    .type = ColumnType,
+                    .default_value_ptr = null,
+                    .is_comptime = false,
+                    .alignment = @alignOf(ColumnType),
+                };
+            }
+
             break :blk @Type(.{
                 .@"struct" = .{
                     .layout = .auto,
-                    .fields = &storage_fields,
+                    .fields = &column_fields,
                     .decls = &[_]std.builtin.Type.Declaration{},
                     .is_tuple = false,
                 },
@@ -472,6 +2366,23 @@ pub fn Query(comptime Components: type) type {
         };
 
 
+        /// Run of matching entities stored contiguously in every storage, entities[i] owns index i of each column
+        pub const Chunk = struct {
+            entities: []const EntityId,
+            columns: Columns,
+        };
+
+
+        /// Iterator over the chunks of a query, from Query.chunks
+        pub const ChunkIterator = struct {
+            query: *Self,
+
+            pub fn next(self: *ChunkIterator) ?Chunk {
+                return self.query.nextChunk();
+            }
+        };
+
+
         // ============================================================
         // Public API: Creation Functions
         // ============================================================
@@ -485,15 +2396,9 @@ pub fn Query(comptime Components: type) type {
             };
 
             // Get storage for each component type
-            inline for (std.meta.fields(Components)) |field| {
-                const FieldType = switch (@typeInfo(field.type)) {
-                    .pointer => |ptr| ptr.child,
-                    else => field.type,
-                };
-                
-                @field(result.storages, field.name) = try registry.getComponentStorage(FieldType);
-            }
-            
+            try initQueryStorages(Components, registry, &result.storages, &result.required, &result.excluded);
+
+            result.lead = result.smallestStorage();
             return result;
         }
 
@@ -504,42 +2409,98 @@ pub fn Query(comptime Components: type) type {
 
         /// Get the next entity that matches the query
         pub fn next(self: *Self) !?Components {
+            const zone = profiler.detailZone("Query.next");
+            defer zone.end();
 
-            // Use the first component's storage to lead iteration
-            const first_field = std.meta.fields(Components)[0];
-            const first_storage = @field(self.storages, first_field.name);
+            // Lead with the smallest storage so the fewest candidates are probed
+            const entities = self.leadEntities();
 
             // Iterate until we find an entity with all components or reach the end
-            while (self.current_index < first_storage.components.items.len) {
-                const entity = first_storage.components.items[self.current_index].entity;
+            while (self.current_index < entities.len) {
+                const entity = entities[self.current_index];
                 self.current_index += 1;
+                self.stats.probed += 1;
+
+                if (self.fetch(entity)) |result| {
+                    self.stats.matched += 1;
+                    return result;
+                }
+            }
+
+            return null;
+        }
 
-                // Check if the entity has all required components
-                var result: Components = undefined;
-                var all_components_present = true;
 
-                inline for (std.meta.fields(Components)) |field| {
-                    const storage = @field(self.storages, field.name);
-                    if (storage.get(entity)) |component| {
-                        @field(result, field.name) = component;
-                    } else {
-                        all_components_present = false;
-                        break;
+        /// Get the next run of matches that sit at consecutive dense indices in every storage, as slices
+        /// Storages filled in the same entity order give long runs, ones reordered independently short runs.
+        /// Mutable columns are stamped as changed, like `*T` fields in next. Each entity comes once
+        pub fn nextChunk(self: *Self) ?Chunk {
+            const zone = profiler.detailZone("Query.nextChunk");
+            defer zone.end();
+
+            const fields = std.meta.fields(Components);
+            const entities = self.leadEntities();
+            while (self.current_index < entities.len) {
+                const start = self.current_index;
+                self.current_index += 1;
+                self.stats.probed += 1;
+                if (!acceptsEntity(Components, self, entities[start])) continue;
+
+                var first: [fields.len]u32 = undefined;
+                inline for (fields, 0..) |field, i| {
+                    if (comptime fieldRole(field.type) == .required) {
+                        first[i] = @field(self.storages, field.name).indexOfUnchecked(entities[start]).?;
                     }
                 }
 
-                if (all_components_present) {
-                    return result;
+                var len: usize = 1;
+                extend: while (start + len < entities.len) : (len += 1) {
+                    const entity = entities[start + len];
+                    if (!acceptsEntity(Components, self, entity)) break;
+                    inline for (fields, 0..) |field, i| {
+                        if (comptime fieldRole(field.type) == .required) {
+                            const index = @field(self.storages, field.name).indexOfUnchecked(entity).?;
+                            if (index != first[i] + len) break :extend;
+                        }
+                    }
+                }
+                self.current_index = start + len;
+                // A run ends at the first candidate that doesn't extend it, that one is probed again next
+                self.stats.probed += len - 1;
+                self.stats.matched += len;
+
+                var chunk: Chunk = .{ .entities = entities[start..][0..len], .columns = undefined };
+                inline for (fields, 0..) |field, i| {
+                    if (comptime fieldRole(field.type) == .required) {
+                        const storage = @field(self.storages, field.name);
+                        if (comptime !@typeInfo(field.type).pointer.is_const) storage.markChangedRange(first[i], len);
+                        @field(chunk.columns, field.name) = storage.components.items[first[i]..][0..len];
+                    } else {
+                        @field(chunk.columns, field.name) = {};
+                    }
                 }
+                return chunk;
             }
-
             return null;
         }
 
-        
+
+        /// Iterate over the matches as contiguous slices from the beginning, see nextChunk
+        pub fn chunks(self: *Self) ChunkIterator {
+            self.reset();
+            return .{ .query = self };
+        }
+
+
         /// Reset the query to start from the beginning
         pub fn reset(self: *Self) void {
             self.current_index = 0;
+            self.lead = self.smallestStorage();
+        }
+
+
+        pub fn resetStats(self: *Self) void {
+            self.stats = .{};
         }
 
 
@@ -550,5 +2511,406 @@ pub fn Query(comptime Components: type) type {
                 callback(components);
             }
         }
+
+
+        /// Iterate over all matching entities in chunks on `pool`, returns when every chunk is done
+        /// Fields declare access: `*T` writes and `*const T` reads, a written type may appear only once
+        pub fn parallelForEach(self: *Self, pool: *JobSystem, comptime callback: fn (components: Components) void) void {
+            comptime checkQueryAccess(Components);
+            self.reset();
+
+            const Chunk = struct {
+                fn run(query: *const Self, entities: []const EntityId) void {
+                    for (entities) |entity| {
+                        if (query.fetch(entity)) |components| callback(components);
+                    }
+                }
+            };
+
+            spawnChunks(pool, self.leadEntities(), Chunk.run, @as(*const Self, self));
+        }
+
+
+        // ============================================================
+        // Private: Helper Functions
+        // ============================================================
+
+        /// Components of `entity`, null if any is missing or a filter rejects it
+        fn fetch(self: *const Self, entity: EntityId) ?Components {
+            return fetchComponents(Components, self, entity);
+        }
+
+
+        /// Index of the field with the fewest stored components, among fields that can lead
+        fn smallestStorage(self: *const Self) usize {
+            var smallest: usize = 0;
+            var smallest_len: usize = std.math.maxInt(usize);
+
+            inline for (std.meta.fields(Components), 0..) |field, i| {
+                if (comptime canLead(field.type)) {
+                    const len = @field(self.storages, field.name).len();
+                    if (len < smallest_len) {
+                        smallest = i;
+                        smallest_len = len;
+                    }
+                }
+            }
+            return smallest;
+        }
+
+
+        /// Dense entity list of the leading storage
+        fn leadEntities(self: *const Self) []const EntityId {
+            inline for (std.meta.fields(Components), 0..) |field, i| {
+                if (comptime canLead(field.type)) {
+                    if (i == self.lead) return @field(self.storages, field.name).entitySlice();
+                }
+            }
+            unreachable;
+        }
+    };
+}
+
+
+
+
+
+
+
+
+
+
+/// Persistent query that keeps a dense list of matching entities
+/// Created through Registry.cachedQuery, the registry updates membership on every add, remove and destroy
+/// Filters are checked while iterating and match changes since the previous reset
+pub fn CachedQuery(comptime Components: type) type {
+    return struct {
+        const Self = @This();
+
+        /// Type IDs of every component in the query, used by the registry to skip unrelated changes
+        const component_ids = blk: {
+            const fields = std.meta.fields(Components);
+            var ids: [fields.len]Registry.ComponentTypeId = undefined;
+            for (fields, 0..) |field, i| {
+                ids[i] = Registry.typeId(FieldComponent(field.type));
+            }
+            break :blk ids;
+        };
+
+        /// Reference to the registry
+        registry: *Registry,
+        /// Storage for each component type in the query
+        storages: Query(Components).QueryStorages,
+        /// Entities that currently have every component, as a sparse set
+        members: ComponentStorage(void),
+        /// Current index in the iteration
+        current_index: usize = 0,
+        /// Filters match changes stamped after this tick
+        since_tick: u32 = 0,
+        /// Tick at which the current iteration started
+        last_run_tick: u32 = 0,
+        /// Components every member must have
+        required: ComponentMask,
+        /// Components no member may have
+        excluded: ComponentMask,
+
+
+        // ============================================================
+        // Public API: Creation Functions
+        // ============================================================
+
+        /// Build the query and collect the entities that already match
+        pub fn init(registry: *Registry) !Self {
+            const query = try Query(Components).init(registry);
+
+            var result = Self{
+                .registry = registry,
+                .storages = query.storages,
+                .members = ComponentStorage(void).init(registry.allocator),
+                .required = query.required,
+                .excluded = query.excluded,
+            };
+            errdefer result.members.deinit();
+
+            for (query.leadEntities()) |entity| {
+                if (result.matches(entity)) try result.members.add(entity, {});
+            }
+            return result;
+        }
+
+
+        // ============================================================
+        // Public API: Operational Functions
+        // ============================================================
+
+        /// Get the next matching entity
+        pub fn next(self: *Self) ?Components {
+            const zone = profiler.detailZone("CachedQuery.next");
+            defer zone.end();
+            const entities = self.members.entitySlice();
+
+            while (self.current_index < entities.len) {
+                const entity = entities[self.current_index];
+                self.current_index += 1;
+
+                if (fetchComponents(Components, self, entity)) |result| {
+                    return result;
+                }
+            }
+            return null;
+        }
+
+
+        /// Every entity that has the query's components, filters are not applied
+        pub fn entitySlice(self: *const Self) []const EntityId {
+            return self.members.entitySlice();
+        }
+
+
+        /// Entity of the components the last next call returned
+        pub fn lastEntity(self: *const Self) EntityId {
+            std.debug.assert(self.current_index > 0);
+            return self.members.entitySlice()[self.current_index - 1];
+        }
+
+
+        /// Start a new iteration, filters will match everything that changed since the previous one
+        pub fn reset(self: *Self) void {
+            self.current_index = 0;
+            self.since_tick = self.last_run_tick;
+            self.last_run_tick = self.registry.advanceTick();
+        }
+
+
+        /// Iterate over all matching entities
+        pub fn forEach(self: *Self, comptime callback: fn (components: Components) void) void {
+            self.reset();
+            while (self.next()) |components| {
+                callback(components);
+            }
+        }
+
+
+        /// Iterate over all matching entities in chunks on `pool`, same access rules as Query.parallelForEach
+        pub fn parallelForEach(self: *Self, pool: *JobSystem, comptime callback: fn (components: Components) void) void {
+            comptime checkQueryAccess(Components);
+            self.reset();
+
+            const Chunk = struct {
+                fn run(query: *const Self, entities: []const EntityId) void {
+                    for (entities) |entity| {
+                        if (fetchComponents(Components, query, entity)) |components| callback(components);
+                    }
+                }
+            };
+
+            spawnChunks(pool, self.members.entitySlice(), Chunk.run, @as(*const Self, self));
+        }
+
+
+        // ============================================================
+        // Public API: Destruction Function
+        // ============================================================
+
+        pub fn deinit(self: *Self) void {
+            self.members.deinit();
+        }
+
+
+        // ============================================================
+        // Private: Helper Functions
+        // ============================================================
+
+        /// Add or drop `entity` after one of its components changed
+        fn sync(self: *Self, entity: EntityId) EcsError!void {
+            const is_member = self.members.contains(entity);
+            if (self.matches(entity)) {
+                if (!is_member) try self.members.add(entity, {});
+            } else if (is_member) {
+                try self.members.remove(entity);
+            }
+        }
+
+
+        /// Recollect every member from scratch, used after the registry's entities were replaced
+        fn rebuild(self: *Self) EcsError!void {
+            self.members.clear();
+            for (self.registry.generations.items, 0..) |generation, index| {
+                const entity = EntityId{ .index = @intCast(index), .generation = generation };
+                if (self.matches(entity)) try self.members.add(entity, {});
+            }
+        }
+
+
+        /// Membership only depends on the component mask, tick filters are checked per iteration
+        fn matches(self: *Self, entity: EntityId) bool {
+            return self.registry.isValidEntity(entity) and maskMatches(self.registry, entity, self.required, self.excluded);
+        }
+    };
+}
+
+
+
+
+
+
+
+
+
+
+/// Owning group of two component types, created through Registry.group
+/// Entities that have both sit in the first `len` slots of both storages in the same order, so slot `i`
+/// of one storage belongs to the same entity as slot `i` of the other and iterating the group is two
+/// parallel array walks. The registry moves entities in and out as components are added and removed
+pub fn Group(comptime A: type, comptime B: type) type {
+    if (A == B) @compileError("a group needs two different component types");
+
+    return struct {
+        const Self = @This();
+
+        a: *ComponentStorage(A),
+        b: *ComponentStorage(B),
+        /// Members, the first `len` slots of both storages
+        len: u32 = 0,
+
+
+        // ============================================================
+        // Public API: Creation Functions
+        // ============================================================
+
+        fn init(a: *ComponentStorage(A), b: *ComponentStorage(B)) Self {
+            return .{ .a = a, .b = b };
+        }
+
+
+        // ============================================================
+        // Public API: Operational Functions
+        // ============================================================
+
+        /// Entities of the group, `entitySlice()[i]` owns `components(A)[i]` and `components(B)[i]`
+        pub fn entitySlice(self: *const Self) []const EntityId {
+            return self.a.entities.items[0..self.len];
+        }
+
+
+        /// Components of type `T` of every member, changed ticks are not stamped
+        pub fn components(self: *const Self, comptime T: type) []T {
+            return if (T == A)
+                self.a.components.items[0..self.len]
+            else if (T == B)
+                self.b.components.items[0..self.len]
+            else
+                @compileError(@typeName(T) ++ " is not owned by this group");
+        }
+
+
+        pub fn contains(self: *const Self, entity: EntityId) bool {
+            const index = self.a.indexOf(entity) orelse return false;
+            return index < self.len;
+        }
+
+
+        /// Run a function for each member and its two components
+        pub fn forEach(self: *const Self, comptime func: fn (entity: EntityId, a: *A, b: *B) void) void {
+            for (self.entitySlice(), self.components(A), self.components(B)) |entity, *a, *b| {
+                func(entity, a, b);
+            }
+        }
+
+
+        // ============================================================
+        // Public API: Destruction Function
+        // ============================================================
+
+        /// The storages stay as they are, only no longer owned
+        fn deinit(self: *Self) void {
+            self.a.owned = false;
+            self.b.owned = false;
+        }
+
+
+        // ============================================================
+        // Private: Helper Functions
+        // ============================================================
+
+        /// Swap `entity` into slot `len` of both storages once it has both components
+        fn join(self: *Self, entity: EntityId) void {
+            const index_a = self.a.indexOf(entity) orelse return;
+            const index_b = self.b.indexOf(entity) orelse return;
+            if (index_a < self.len) return;
+
+            self.a.swapSlots(index_a, self.len);
+            self.b.swapSlots(index_b, self.len);
+            self.len += 1;
+        }
+
+
+        /// Swap a member into the last group slot of both storages and shrink the group past it
+        fn leave(self: *Self, entity: EntityId) void {
+            const index_a = self.a.indexOf(entity) orelse return;
+            if (index_a >= self.len) return;
+            const index_b = self.b.indexOf(entity).?;
+
+            self.len -= 1;
+            self.a.swapSlots(index_a, self.len);
+            self.b.swapSlots(index_b, self.len);
+        }
+
+
+        /// Pack every entity that has both components, e.g. after the storages were loaded
+        fn rebuild(self: *Self) void {
+            self.len = 0;
+            var index: u32 = 0;
+            while (index < self.a.entities.items.len) : (index += 1) {
+                self.join(self.a.entities.items[index]);
+            }
+        }
     };
 }
+
+
+
+
+
+
+
+
+
+
+// ============================================================
+// Private: Parallel Iteration Helpers
+// ============================================================
+
+/// Entities handed to one worker by the parallelForEach functions
+const parallel_chunk_size = 4096;
+
+
+/// Reject queries whose workers could alias a mutable component
+/// Two fields of the same component type are only allowed when both are `*const`, filter fields never write
+fn checkQueryAccess(comptime Components: type) void {
+    const fields = std.meta.fields(Components);
+    for (fields, 0..) |a, i| {
+        if (isFilter(a.type)) continue;
+        for (fields[i + 1 ..]) |b| {
+            if (isFilter(b.type)) continue;
+            const a_info = @typeInfo(FieldPointer(a.type)).pointer;
+            const b_info = @typeInfo(FieldPointer(b.type)).pointer;
+            if (a_info.child == b_info.child and !(a_info.is_const and b_info.is_const)) {
+                @compileError("query fields '" ++ a.name ++ "' and '" ++ b.name ++ "' alias " ++ @typeName(a_info.child) ++ " and one of them writes it");
+            }
+        }
+    }
+}
+
+
+/// Run `func(context, chunk)` on `pool` for every `parallel_chunk_size` slice of `entities` and wait for all of them
+fn spawnChunks(pool: *JobSystem, entities: []const EntityId, comptime func: anytype, context: anytype) void {
+    var wait_group: std.Thread.WaitGroup = .{};
+
+    var start: usize = 0;
+    while (start < entities.len) : (start += parallel_chunk_size) {
+        const end = @min(start + parallel_chunk_size, entities.len);
+        pool.spawnWg(&wait_group, func, .{ context, entities[start..end] });
+    }
+    pool.waitAndWork(&wait_group);
+}
@@ -0,0 +1,156 @@
+// ecs/events.zig - typed event channels between systems
+const std = @import("std");
+
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+
+
+/// Channel of events of type `T`, kept for two updates so every system sees them once whatever its order
+/// Events are written into the current buffer, update swaps it with the previous one and clears that for
+/// reuse, so after the first frames the buffers only grow and sending allocates nothing.
+/// Every reader keeps its own cursor. Workers send into their own sub-buffer, merged at update
+pub fn Events(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        /// Sub-buffer of one thread, a cache line apart from the others
+        const Local = struct {
+            events: std.ArrayListUnmanaged(T) align(std.atomic.cache_line) = .{},
+        };
+
+        /// Cursor of one reader, start it with `.{}` to see every event still in the channel
+        pub const Reader = struct {
+            /// Sequence number of the next unread event
+            next: u64 = 0,
+
+            /// The unread events, oldest first. Events of more than one update ago are gone
+            pub fn read(self: *Reader, channel: *const Self) Iterator {
+                const previous = &channel.buffers[channel.current ^ 1];
+                const current = &channel.buffers[channel.current];
+                const previous_start = channel.start[channel.current ^ 1];
+                const current_start = channel.start[channel.current];
+
+                const from = @max(self.next, previous_start);
+                self.next = current_start + current.items.len;
+
+                const skip_previous: usize = @intCast(@min(from - previous_start, previous.items.len));
+                const skip_current: usize = @intCast(from -| current_start);
+                return .{
+                    .previous = previous.items[skip_previous..],
+                    .current = current.items[@min(skip_current, current.items.len)..],
+                };
+            }
+        };
+
+        pub const Iterator = struct {
+            previous: []const T,
+            current: []const T,
+
+            pub fn next(self: *Iterator) ?*const T {
+                if (self.previous.len > 0) {
+                    defer self.previous = self.previous[1..];
+                    return &self.previous[0];
+                }
+                if (self.current.len > 0) {
+                    defer self.current = self.current[1..];
+                    return &self.current[0];
+                }
+                return null;
+            }
+
+
+            pub fn len(self: *const Iterator) usize {
+                return self.previous.len + self.current.len;
+            }
+        };
+
+        allocator: std.mem.Allocator,
+        /// Events of the current and the previous update
+        buffers: [2]std.ArrayListUnmanaged(T) = .{ .{}, .{} },
+        /// Buffer sent into
+        current: u1 = 0,
+        /// Sequence number of the first event in each buffer
+        start: [2]u64 = .{ 0, 0 },
+        /// Sub-buffers of sendConcurrent, slot 0 for threads outside the pool and one per worker
+        locals: []Local,
+        pool: ?*const JobSystem,
+
+
+        // ============================================================
+        // Public API: Creation Functions
+        // ============================================================
+
+        /// Channel that workers of `pool` may send into concurrently, or only one thread at a time when null
+        pub fn init(allocator: std.mem.Allocator, pool: ?*const JobSystem) !Self {
+            const slot_count = if (pool) |jobs| jobs.workerCount() + 1 else 1;
+            const locals = try allocator.alloc(Local, slot_count);
+            @memset(locals, .{});
+            return .{
+                .allocator = allocator,
+                .locals = locals,
+                .pool = pool,
+            };
+        }
+
+
+        // ============================================================
+        // Public API: Operational Functions
+        // ============================================================
+
+        /// Send an event, not thread safe, readers see it on their next read
+        pub fn send(self: *Self, event: T) !void {
+            try self.buffers[self.current].append(self.allocator, event);
+        }
+
+
+        /// Send an event from a system that may run in parallel with other senders
+        /// It goes to the calling thread's sub-buffer and reaches readers after the next flush or update
+        pub fn sendConcurrent(self: *Self, event: T) !void {
+            const slot = if (self.pool) |jobs| if (jobs.currentWorkerIndex()) |index| index + 1 else 0 else 0;
+            try self.locals[slot].events.append(self.allocator, event);
+        }
+
+
+        /// Move the sub-buffers into the current buffer in slot order, at a sync point between systems
+        pub fn flush(self: *Self) !void {
+            const buffer = &self.buffers[self.current];
+            for (self.locals) |*local| {
+                try buffer.appendSlice(self.allocator, local.events.items);
+                local.events.clearRetainingCapacity();
+            }
+        }
+
+
+        /// Flush and start the next update: the previous buffer's events are dropped and it takes new ones
+        /// Call once per frame, e.g. through Registry.updateEvents
+        pub fn update(self: *Self) !void {
+            try self.flush();
+
+            const next = self.current ^ 1;
+            self.start[next] = self.start[self.current] + self.buffers[self.current].items.len;
+            self.buffers[next].clearRetainingCapacity();
+            self.current = next;
+        }
+
+
+        /// Drop every event, readers skip what they had not read
+        pub fn clear(self: *Self) void {
+            const end = self.start[self.current] + self.buffers[self.current].items.len;
+            for (&self.buffers, &self.start) |*buffer, *start| {
+                buffer.clearRetainingCapacity();
+                start.* = end;
+            }
+            for (self.locals) |*local| local.events.clearRetainingCapacity();
+        }
+
+
+        // ============================================================
+        // Public API: Destruction Function
+        // ============================================================
+
+        pub fn deinit(self: *Self) void {
+            for (&self.buffers) |*buffer| buffer.deinit(self.allocator);
+            for (self.locals) |*local| local.events.deinit(self.allocator);
+            self.allocator.free(self.locals);
+        }
+    };
+}
@@ -0,0 +1,120 @@
+// ecs/prefab.zig - entity templates spawned in bulk
+const std = @import("std");
+
+const ecs = @import("ecs.zig");
+const Registry = ecs.Registry;
+const EntityId = ecs.EntityId;
+const EcsError = ecs.EcsError;
+const ComponentMask = ecs.ComponentMask;
+
+
+/// Component values are copied into the prefab with this alignment, component types may not exceed it
+const data_alignment = 16;
+
+
+
+
+
+
+
+
+
+
+/// Component set and values of a template entity, copied onto new entities one storage at a time
+/// Each storage is reserved once per instantiate and filled with copies, instead of addComponent hashing the
+/// type and looking up the storage for every component of every entity
+/// Components with a deinit function need a `clone` method, which every copy is made with. The recorded
+/// value of such a component still points at what the template owns, so keep the template alive
+pub const Prefab = struct {
+    const Self = @This();
+
+    const Part = struct {
+        /// Storage of the component, see Registry.componentIndex
+        component_index: u32,
+        /// Offset of the component value in `data`
+        offset: u32,
+    };
+
+    allocator: std.mem.Allocator,
+    /// One entry per component with data, tags are only bits in `mask`
+    parts: std.ArrayList(Part),
+    /// Copies of the template's component values
+    data: std.ArrayListAligned(u8, data_alignment),
+    /// Every component and tag of the template
+    mask: ComponentMask,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Record the components of `template` as they are now, later changes to it don't affect the prefab
+    /// Instantiate into the registry the prefab was recorded from, its component indices are that registry's
+    pub fn fromEntity(allocator: std.mem.Allocator, registry: *Registry, template: EntityId) !Self {
+        if (!registry.isValidEntity(template)) {
+            return EcsError.InvalidEntity;
+        }
+
+        var self = Self{
+            .allocator = allocator,
+            .parts = std.ArrayList(Part).init(allocator),
+            .data = std.ArrayListAligned(u8, data_alignment).init(allocator),
+            .mask = registry.masks.items[template.index],
+        };
+        errdefer self.deinit();
+
+        var bits = self.mask.iterator(.{});
+        while (bits.next()) |index| {
+            if (registry.tag_mask.isSet(index)) continue;
+            const interface = registry.component_stores.items[index] orelse return EcsError.ComponentNotFound;
+            if (!interface.cloneable) return EcsError.ComponentNotCloneable;
+            std.debug.assert(interface.component_alignment <= data_alignment);
+
+            const offset = std.mem.alignForward(usize, self.data.items.len, interface.component_alignment);
+            try self.data.resize(offset + interface.component_size);
+            try interface.read_fn(interface.ptr, template, self.data.items[offset..].ptr);
+            try self.parts.append(.{ .component_index = @intCast(index), .offset = @intCast(offset) });
+        }
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Create `entities.len` entities with the prefab's components, like Registry.createEntities
+    /// On error none of the entities are left behind
+    pub fn instantiate(self: *const Self, registry: *Registry, entities: []EntityId) !void {
+        try registry.createEntities(entities);
+
+        var added = ComponentMask.initEmpty();
+        errdefer {
+            // Hand the components already copied to destroyEntities through the masks
+            for (entities) |entity| registry.masks.items[entity.index] = added;
+            registry.destroyEntities(entities) catch {};
+        }
+
+        for (self.parts.items) |part| {
+            if (part.component_index >= registry.component_stores.items.len) return EcsError.ComponentNotFound;
+            const interface = registry.component_stores.items[part.component_index] orelse
+                return EcsError.ComponentNotFound;
+
+            try interface.add_copies_fn(interface.ptr, entities, self.data.items[part.offset..].ptr);
+            added.set(part.component_index);
+        }
+
+        try registry.markAdded(entities, self.mask);
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Free the recorded values, entities instantiated from the prefab keep their own copies
+    pub fn deinit(self: *Self) void {
+        self.parts.deinit();
+        self.data.deinit();
+    }
+};
@@ -0,0 +1,462 @@
+// ecs/replication.zig - delta snapshots of component state for network replication
+const std = @import("std");
+
+const ecs = @import("ecs.zig");
+const Registry = ecs.Registry;
+const EntityId = ecs.EntityId;
+const EcsError = ecs.EcsError;
+const ComponentStorage = ecs.ComponentStorage;
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+
+
+pub const ReplicationError = error{
+    /// A packet ended early or holds a value its types can't have
+    MalformedPacket,
+};
+
+
+/// Range and precision of a float on the wire, values outside min..max are clamped
+/// Components declare them as `pub const quantization = .{ .field = Quantization{ ... } }`, a quantized
+/// struct or array field applies to every float inside it. Floats without one are sent with all their bits
+pub const Quantization = struct {
+    min: f32,
+    max: f32,
+    bits: u6,
+};
+
+
+/// One encoded snapshot, valid until the next encode
+pub const Snapshot = struct {
+    /// Change tick the snapshot is complete up to, what the client acknowledges
+    tick: u32,
+    bytes: []const u8,
+};
+
+
+
+
+
+
+
+
+
+
+/// Little endian bit stream appended to a reused byte list
+pub const BitWriter = struct {
+    const Self = @This();
+
+    allocator: std.mem.Allocator,
+    bytes: *std.ArrayListUnmanaged(u8),
+    /// Bits not yet written out, always fewer than 8 between writes
+    pending: u128 = 0,
+    pending_bits: u7 = 0,
+
+
+    /// Append the low `bits` bits of `value`, at most 64
+    pub fn write(self: *Self, value: u64, bits: u7) !void {
+        std.debug.assert(bits <= 64);
+        const mask = (@as(u128, 1) << bits) - 1;
+        self.pending |= (@as(u128, value) & mask) << self.pending_bits;
+        self.pending_bits += bits;
+
+        while (self.pending_bits >= 8) {
+            try self.bytes.append(self.allocator, @truncate(self.pending));
+            self.pending >>= 8;
+            self.pending_bits -= 8;
+        }
+    }
+
+
+    /// Write out the last partial byte, zero padded
+    pub fn finish(self: *Self) !void {
+        if (self.pending_bits > 0) try self.write(0, 8 - self.pending_bits);
+    }
+};
+
+
+/// Reads what BitWriter wrote
+pub const BitReader = struct {
+    const Self = @This();
+
+    bytes: []const u8,
+    /// Bits read so far
+    position: usize = 0,
+
+
+    pub fn read(self: *Self, bits: u7) !u64 {
+        std.debug.assert(bits <= 64);
+        if (self.position + bits > self.bytes.len * 8) return ReplicationError.MalformedPacket;
+
+        var result: u128 = 0;
+        var done: u7 = 0;
+        while (done < bits) {
+            const offset: u3 = @intCast(self.position % 8);
+            const take: u7 = @min(8 - @as(u7, offset), bits - done);
+            const chunk = (@as(u128, self.bytes[self.position / 8]) >> offset) & ((@as(u128, 1) << take) - 1);
+            result |= chunk << done;
+            done += take;
+            self.position += take;
+        }
+        return @intCast(result);
+    }
+};
+
+
+
+
+
+
+
+
+
+
+/// Encodes the components changed since a client's last acknowledged snapshot and applies them on the client
+/// Each replicated storage is one section: its changed components, found through their added and changed
+/// ticks, then the entities that lost the component. Values are bit-packed field by field with the
+/// component's quantization. Sections are encoded in parallel into buffers kept between ticks
+/// The server calls encode once per client with the tick that client acknowledged last, 0 for a full
+/// snapshot, and the client passes every packet to apply and acknowledges the tick it returns
+/// Deltas are per component, the storages keep one change tick per component and not per field
+pub const Replicator = struct {
+    const Self = @This();
+
+    const Channel = struct {
+        type_id: Registry.ComponentTypeId,
+        storage: *anyopaque,
+        encode_fn: *const fn (*Channel, std.mem.Allocator, u32) anyerror!void,
+        decode_fn: *const fn (*Self, *BitReader) anyerror!void,
+        /// Section written by the last encode
+        bytes: std.ArrayListUnmanaged(u8) = .{},
+        /// Error of the last encode, sections fail on workers and are reported after the wait
+        err: ?anyerror = null,
+    };
+
+    /// Bytes before the first section: tick and section count
+    const header_size = 8;
+    /// Bytes before the data of a section: type ID and length
+    const section_header_size = 12;
+
+    /// Thread safe when encode gets a pool, sections allocate on the workers
+    allocator: std.mem.Allocator,
+    registry: *Registry,
+    channels: std.ArrayListUnmanaged(Channel) = .{},
+    /// Packet of the last encode
+    packet: std.ArrayListUnmanaged(u8) = .{},
+    /// Entity on the server to the entity apply created for it here
+    remote_entities: std.AutoHashMapUnmanaged(EntityId, EntityId) = .{},
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, registry: *Registry) Self {
+        return .{
+            .allocator = allocator,
+            .registry = registry,
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Replicate components of type `T`, registered already, on the server and the client in the same order
+    /// `T` may hold numbers, bools, enums and arrays or structs of them, nothing that points elsewhere
+    pub fn replicate(self: *Self, comptime T: type) !void {
+        const Ops = struct {
+            fn cast(channel: *Channel) *ComponentStorage(T) {
+                return @as(*ComponentStorage(T), @ptrCast(@alignCast(channel.storage)));
+            }
+
+            fn encode(channel: *Channel, allocator: std.mem.Allocator, since_tick: u32) anyerror!void {
+                const storage = cast(channel);
+                channel.bytes.clearRetainingCapacity();
+                var writer = BitWriter{ .allocator = allocator, .bytes = &channel.bytes };
+
+                var changed: u32 = 0;
+                for (storage.added_ticks.items, storage.changed_ticks.items) |added_tick, changed_tick| {
+                    if (added_tick > since_tick or changed_tick > since_tick) changed += 1;
+                }
+                try writer.write(changed, 32);
+
+                const dense = storage.entities.items;
+                for (dense, storage.components.items, storage.added_ticks.items, storage.changed_ticks.items) |entity, *component, added_tick, changed_tick| {
+                    if (added_tick <= since_tick and changed_tick <= since_tick) continue;
+                    try writeEntity(&writer, entity);
+                    try writeValue(T, null, &writer, component);
+                }
+
+                var removed: u32 = 0;
+                try storage.forEachRemovedSince(since_tick, &removed, countEntity);
+                try writer.write(removed, 32);
+                try storage.forEachRemovedSince(since_tick, &writer, writeEntity);
+                try writer.finish();
+            }
+
+            fn countEntity(count: *u32, _: EntityId) !void {
+                count.* += 1;
+            }
+
+            fn decode(replicator: *Self, reader: *BitReader) anyerror!void {
+                const registry = replicator.registry;
+
+                const changed: usize = @intCast(try reader.read(32));
+                for (0..changed) |_| {
+                    const remote = try readEntity(reader);
+                    const value = try readValue(T, null, reader);
+                    const local = try replicator.localEntity(remote);
+                    if (registry.getComponent(local, T)) |component| {
+                        component.* = value;
+                    } else {
+                        try registry.addComponent(local, value);
+                    }
+                }
+
+                const removed: usize = @intCast(try reader.read(32));
+                for (0..removed) |_| {
+                    const remote = try readEntity(reader);
+                    const local = replicator.remote_entities.get(remote) orelse continue;
+                    registry.removeComponent(local, T) catch |e| if (e != EcsError.ComponentNotFound) return e;
+                    try replicator.dropIfEmpty(remote, local);
+                }
+            }
+        };
+
+        const storage = try self.registry.getComponentStorage(T);
+        try self.channels.append(self.allocator, .{
+            .type_id = Registry.typeId(T),
+            .storage = storage,
+            .encode_fn = Ops.encode,
+            .decode_fn = Ops.decode,
+        });
+    }
+
+
+    /// Encode every replicated component changed after `since_tick`, the tick the client acknowledged
+    /// Advances the registry's change tick, so changes made after this land in the next delta
+    /// With a pool the sections are encoded in parallel, nothing may change the registry meanwhile
+    pub fn encode(self: *Self, since_tick: u32, pool: ?*JobSystem) !Snapshot {
+        const tick = self.registry.advanceTick();
+
+        if (pool) |jobs| {
+            var wait_group = std.Thread.WaitGroup{};
+            for (self.channels.items) |*channel| {
+                jobs.spawnWg(&wait_group, encodeChannel, .{ channel, self.allocator, since_tick });
+            }
+            jobs.waitAndWork(&wait_group);
+        } else {
+            for (self.channels.items) |*channel| encodeChannel(channel, self.allocator, since_tick);
+        }
+
+        self.packet.clearRetainingCapacity();
+        var header: [header_size]u8 = undefined;
+        std.mem.writeInt(u32, header[0..4], tick, .little);
+        std.mem.writeInt(u32, header[4..8], @intCast(self.channels.items.len), .little);
+        try self.packet.appendSlice(self.allocator, &header);
+
+        for (self.channels.items) |*channel| {
+            if (channel.err) |e| return e;
+
+            var section: [section_header_size]u8 = undefined;
+            std.mem.writeInt(u64, section[0..8], channel.type_id, .little);
+            std.mem.writeInt(u32, section[8..12], @intCast(channel.bytes.items.len), .little);
+            try self.packet.appendSlice(self.allocator, &section);
+            try self.packet.appendSlice(self.allocator, channel.bytes.items);
+        }
+
+        return .{ .tick = tick, .bytes = self.packet.items };
+    }
+
+
+    /// Apply a packet from encode to this registry, returns the tick to acknowledge
+    /// Entities are created for server entities seen the first time and destroyed once replication
+    /// removed their last component. Sections of types this side doesn't replicate are skipped
+    pub fn apply(self: *Self, packet: []const u8) !u32 {
+        if (packet.len < header_size) return ReplicationError.MalformedPacket;
+        const tick = std.mem.readInt(u32, packet[0..4], .little);
+        const section_count = std.mem.readInt(u32, packet[4..8], .little);
+
+        var offset: usize = header_size;
+        for (0..section_count) |_| {
+            if (packet.len - offset < section_header_size) return ReplicationError.MalformedPacket;
+            const type_id = std.mem.readInt(u64, packet[offset..][0..8], .little);
+            const length = std.mem.readInt(u32, packet[offset + 8 ..][0..4], .little);
+            offset += section_header_size;
+            if (packet.len - offset < length) return ReplicationError.MalformedPacket;
+
+            const bytes = packet[offset..][0..length];
+            offset += length;
+
+            const channel = self.findChannel(type_id) orelse continue;
+            var reader = BitReader{ .bytes = bytes };
+            try channel.decode_fn(self, &reader);
+        }
+        return tick;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        for (self.channels.items) |*channel| channel.bytes.deinit(self.allocator);
+        self.channels.deinit(self.allocator);
+        self.packet.deinit(self.allocator);
+        self.remote_entities.deinit(self.allocator);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn encodeChannel(channel: *Channel, allocator: std.mem.Allocator, since_tick: u32) void {
+        channel.err = null;
+        channel.encode_fn(channel, allocator, since_tick) catch |e| {
+            channel.err = e;
+        };
+    }
+
+
+    fn findChannel(self: *Self, type_id: Registry.ComponentTypeId) ?*Channel {
+        for (self.channels.items) |*channel| {
+            if (channel.type_id == type_id) return channel;
+        }
+        return null;
+    }
+
+
+    fn localEntity(self: *Self, remote: EntityId) !EntityId {
+        const entry = try self.remote_entities.getOrPut(self.allocator, remote);
+        if (!entry.found_existing) {
+            entry.value_ptr.* = self.registry.createEntity() catch |e| {
+                self.remote_entities.removeByPtr(entry.key_ptr);
+                return e;
+            };
+        }
+        return entry.value_ptr.*;
+    }
+
+
+    /// Destroy the entity of `remote` once it has nothing left, client side components keep it alive
+    fn dropIfEmpty(self: *Self, remote: EntityId, local: EntityId) !void {
+        if (self.registry.masks.items[local.index].mask != 0) return;
+        try self.registry.destroyEntity(local);
+        _ = self.remote_entities.remove(remote);
+    }
+};
+
+
+
+
+
+
+
+
+
+
+// ============================================================
+// Private: Value Encoding
+// ============================================================
+
+fn writeEntity(writer: *BitWriter, entity: EntityId) !void {
+    try writer.write(entity.index, 32);
+    try writer.write(entity.generation, 32);
+}
+
+
+fn readEntity(reader: *BitReader) !EntityId {
+    return .{
+        .index = @intCast(try reader.read(32)),
+        .generation = @intCast(try reader.read(32)),
+    };
+}
+
+
+/// Write `value` field by field, `quantization` applies to every float inside it
+fn writeValue(comptime F: type, comptime quantization: ?Quantization, writer: *BitWriter, value: *const F) !void {
+    switch (@typeInfo(F)) {
+        .float => {
+            if (quantization) |q| {
+                try writer.write(quantize(@floatCast(value.*), q), q.bits);
+            } else {
+                const Bits = std.meta.Int(.unsigned, @bitSizeOf(F));
+                try writer.write(@as(Bits, @bitCast(value.*)), @bitSizeOf(F));
+            }
+        },
+        .bool => try writer.write(@intFromBool(value.*), 1),
+        .int => |info| {
+            if (info.bits > 64) @compileError(@typeName(F) ++ " is too wide to replicate");
+            const Bits = std.meta.Int(.unsigned, info.bits);
+            try writer.write(@as(Bits, @bitCast(value.*)), info.bits);
+        },
+        .@"enum" => |info| {
+            const tag = @intFromEnum(value.*);
+            try writeValue(info.tag_type, null, writer, &tag);
+        },
+        .array => |info| for (value) |*item| {
+            try writeValue(info.child, quantization, writer, item);
+        },
+        .@"struct" => |info| inline for (info.fields) |field| {
+            try writeValue(field.type, quantization orelse fieldQuantization(F, field.name), writer, &@field(value.*, field.name));
+        },
+        else => @compileError(@typeName(F) ++ " can't be replicated, only numbers, bools, enums and arrays or structs of them"),
+    }
+}
+
+
+fn readValue(comptime F: type, comptime quantization: ?Quantization, reader: *BitReader) !F {
+    switch (@typeInfo(F)) {
+        .float => {
+            if (quantization) |q| return @floatCast(dequantize(try reader.read(q.bits), q));
+            const Bits = std.meta.Int(.unsigned, @bitSizeOf(F));
+            return @bitCast(@as(Bits, @intCast(try reader.read(@bitSizeOf(F)))));
+        },
+        .bool => return try reader.read(1) != 0,
+        .int => |info| {
+            const Bits = std.meta.Int(.unsigned, info.bits);
+            return @bitCast(@as(Bits, @intCast(try reader.read(info.bits))));
+        },
+        .@"enum" => |info| {
+            const tag = try readValue(info.tag_type, null, reader);
+            return std.meta.intToEnum(F, tag) catch ReplicationError.MalformedPacket;
+        },
+        .array => |info| {
+            var result: F = undefined;
+            for (&result) |*item| item.* = try readValue(info.child, quantization, reader);
+            return result;
+        },
+        .@"struct" => |info| {
+            var result: F = undefined;
+            inline for (info.fields) |field| {
+                @field(result, field.name) = try readValue(field.type, quantization orelse fieldQuantization(F, field.name), reader);
+            }
+            return result;
+        },
+        else => @compileError(@typeName(F) ++ " can't be replicated, only numbers, bools, enums and arrays or structs of them"),
+    }
+}
+
+
+fn fieldQuantization(comptime F: type, comptime name: []const u8) ?Quantization {
+    if (!@hasDecl(F, "quantization")) return null;
+    if (!@hasField(@TypeOf(F.quantization), name)) return null;
+    return @field(F.quantization, name);
+}
+
+
+fn quantize(value: f32, q: Quantization) u64 {
+    const steps: f64 = @floatFromInt((@as(u64, 1) << q.bits) - 1);
+    const t = std.math.clamp((@as(f64, value) - q.min) / (@as(f64, q.max) - q.min), 0.0, 1.0);
+    return @intFromFloat(@round(t * steps));
+}
+
+
+fn dequantize(code: u64, q: Quantization) f32 {
+    const steps: f64 = @floatFromInt((@as(u64, 1) << q.bits) - 1);
+    const t = @as(f64, @floatFromInt(code)) / steps;
+    return @floatCast(q.min + (@as(f64, q.max) - q.min) * t);
+}
@@ -0,0 +1,297 @@
+// ecs/scheduler.zig - runs systems in dependency order, in parallel where their access allows
+const std = @import("std");
+
+const Registry = @import("ecs.zig").Registry;
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+const perf_budget = @import("../core/perf_budget.zig");
+const PerfBudgets = perf_budget.PerfBudgets;
+const Budget = perf_budget.Budget;
+
+
+/// Per-system settings
+pub const SystemOptions = struct {
+    /// Always run on the thread that calls Scheduler.run, required for anything touching OpenGL or the window
+    main_thread: bool = false,
+    /// Soft limit of the run time in nanoseconds, checked by the scheduler's PerfBudgets under the system name
+    budget_ns: ?u64 = null,
+};
+
+
+/// A registered system and its last measured run time
+pub const System = struct {
+    name: []const u8,
+    context: *anyopaque,
+    run_fn: *const fn (*anyopaque, *Registry) anyerror!void,
+    /// Component types the system reads
+    reads: []const Registry.ComponentTypeId,
+    /// Component types the system writes
+    writes: []const Registry.ComponentTypeId,
+    options: SystemOptions,
+    /// Wall time of the last run in nanoseconds
+    elapsed_ns: u64 = 0,
+    /// Error returned by the last run, reported by Scheduler.run after its wave finishes
+    err: ?anyerror = null,
+    /// Declared from options.budget_ns once the scheduler has budgets
+    budget: ?*Budget = null,
+
+
+    /// True when the two systems may not run at the same time
+    fn conflicts(a: *const System, b: *const System) bool {
+        return overlaps(a.writes, b.writes) or overlaps(a.writes, b.reads) or overlaps(a.reads, b.writes);
+    }
+
+
+    fn overlaps(a: []const Registry.ComponentTypeId, b: []const Registry.ComponentTypeId) bool {
+        for (a) |id| {
+            if (std.mem.indexOfScalar(Registry.ComponentTypeId, b, id) != null) return true;
+        }
+        return false;
+    }
+};
+
+
+
+
+
+
+
+
+
+
+/// Systems declare their component access up front. Systems that conflict keep their registration
+/// order, and everything else in the same wave runs concurrently on the worker pool
+/// Systems running in parallel must not make structural changes to the registry
+pub const Scheduler = struct {
+    const Self = @This();
+
+    allocator: std.mem.Allocator,
+    registry: *Registry,
+    pool: *JobSystem,
+    /// Systems in registration order
+    systems: std.ArrayList(System),
+    /// System indices grouped by wave, `wave_ends[i]` is one past the last index of wave `i`
+    order: std.ArrayList(u32),
+    wave_ends: std.ArrayList(u32),
+    /// Set when a system is added so the graph is rebuilt before the next run
+    needs_build: bool = true,
+    /// Wall time of the last run in nanoseconds
+    frame_ns: u64 = 0,
+    /// Where systems with a budget_ns report their run times, see setBudgets
+    budgets: ?*PerfBudgets = null,
+    /// Budget of the whole run, named "frame"
+    frame_budget: ?*Budget = null,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, registry: *Registry, pool: *JobSystem) Self {
+        return .{
+            .allocator = allocator,
+            .registry = registry,
+            .pool = pool,
+            .systems = std.ArrayList(System).init(allocator),
+            .order = std.ArrayList(u32).init(allocator),
+            .wave_ends = std.ArrayList(u32).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Register a system, `Access` lists its components like a query struct: `*T` writes, `*const T` reads
+    /// Registry resources are listed the same way, they conflict by type like components do
+    /// `system_fn` is called as `system_fn(context, registry)`
+    pub fn addSystem(self: *Self, comptime Access: type, name: []const u8, context: anytype, comptime system_fn: anytype, options: SystemOptions) !void {
+        const Context = @TypeOf(context);
+        const access = AccessSet(Access);
+
+        try self.systems.append(.{
+            .name = name,
+            .context = @ptrCast(context),
+            .run_fn = struct {
+                fn runFn(ptr: *anyopaque, registry: *Registry) anyerror!void {
+                    return system_fn(@as(Context, @ptrCast(@alignCast(ptr))), registry);
+                }
+            }.runFn,
+            .reads = &access.reads,
+            .writes = &access.writes,
+            .options = options,
+        });
+        errdefer _ = self.systems.pop();
+        try self.declareBudget(&self.systems.items[self.systems.items.len - 1]);
+        self.needs_build = true;
+    }
+
+
+    /// Check the run times of systems declaring a budget_ns, and of whole runs if `frame_budget_ns` is given
+    /// The caller owns `budgets` and calls its endFrame, after the run and any other budgeted work of the frame
+    pub fn setBudgets(self: *Self, budgets: *PerfBudgets, frame_budget_ns: ?u64) !void {
+        self.budgets = budgets;
+        self.frame_budget = if (frame_budget_ns) |limit| try budgets.declare("frame", limit) else null;
+        for (self.systems.items) |*system| try self.declareBudget(system);
+    }
+
+
+    /// Run every system once, returns the first error any of them produced
+    pub fn run(self: *Self) !void {
+        if (self.needs_build) try self.build();
+
+        const frame_start = std.time.nanoTimestamp();
+
+        var start: usize = 0;
+        for (self.wave_ends.items) |end| {
+            const wave = self.order.items[start..end];
+            start = end;
+
+            if (wave.len == 1) {
+                runSystem(self, wave[0]);
+            } else {
+                var wait_group: std.Thread.WaitGroup = .{};
+                for (wave) |index| {
+                    if (self.systems.items[index].options.main_thread) continue;
+                    self.pool.spawnWg(&wait_group, runSystem, .{ self, index });
+                }
+                for (wave) |index| {
+                    if (self.systems.items[index].options.main_thread) runSystem(self, index);
+                }
+                self.pool.waitAndWork(&wait_group);
+            }
+
+            for (wave) |index| {
+                if (self.systems.items[index].err) |err| return err;
+            }
+        }
+
+        self.frame_ns = elapsedSince(frame_start);
+        if (self.frame_budget) |budget| self.budgets.?.record(budget, self.frame_ns);
+    }
+
+
+    /// Print the last run time of every system
+    pub fn printTimings(self: *const Self, writer: anytype) !void {
+        try writer.print("frame {d:.3} ms\n", .{nsToMs(self.frame_ns)});
+        for (self.systems.items) |system| {
+            try writer.print("  {s:<24} {d:.3} ms\n", .{ system.name, nsToMs(system.elapsed_ns) });
+        }
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.systems.deinit();
+        self.order.deinit();
+        self.wave_ends.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Place every system one wave after the latest earlier system it conflicts with
+    fn build(self: *Self) !void {
+        const count = self.systems.items.len;
+
+        const waves = try self.allocator.alloc(u32, count);
+        defer self.allocator.free(waves);
+
+        var wave_count: u32 = 0;
+        for (self.systems.items, 0..) |*system, i| {
+            var wave: u32 = 0;
+            for (self.systems.items[0..i], waves[0..i]) |*earlier, earlier_wave| {
+                if (system.conflicts(earlier)) wave = @max(wave, earlier_wave + 1);
+            }
+            waves[i] = wave;
+            wave_count = @max(wave_count, wave + 1);
+        }
+
+        // Group indices by wave, registration order within each wave
+        try self.order.resize(count);
+        try self.wave_ends.resize(wave_count);
+
+        var written: u32 = 0;
+        for (0..wave_count) |wave| {
+            for (waves, 0..) |system_wave, i| {
+                if (system_wave != wave) continue;
+                self.order.items[written] = @intCast(i);
+                written += 1;
+            }
+            self.wave_ends.items[wave] = written;
+        }
+
+        self.needs_build = false;
+    }
+
+
+    fn runSystem(self: *Self, index: u32) void {
+        const system = &self.systems.items[index];
+        const start = std.time.nanoTimestamp();
+
+        system.err = null;
+        system.run_fn(system.context, self.registry) catch |err| {
+            system.err = err;
+        };
+        system.elapsed_ns = elapsedSince(start);
+        if (system.budget) |budget| self.budgets.?.record(budget, system.elapsed_ns);
+    }
+
+
+    fn declareBudget(self: *Self, system: *System) !void {
+        const budgets = self.budgets orelse return;
+        const limit = system.options.budget_ns orelse return;
+        system.budget = try budgets.declare(system.name, limit);
+    }
+
+
+    fn elapsedSince(start: i128) u64 {
+        return @intCast(@max(0, std.time.nanoTimestamp() - start));
+    }
+
+
+    fn nsToMs(ns: u64) f64 {
+        return @as(f64, @floatFromInt(ns)) / std.time.ns_per_ms;
+    }
+};
+
+
+
+
+
+
+
+
+
+
+/// Compile-time read and write type ID lists for an access struct
+fn AccessSet(comptime Access: type) type {
+    const fields = std.meta.fields(Access);
+
+    comptime var read_count = 0;
+    inline for (fields) |field| {
+        if (@typeInfo(field.type).pointer.is_const) read_count += 1;
+    }
+
+    return struct {
+        const reads = collect(true, read_count);
+        const writes = collect(false, fields.len - read_count);
+
+        fn collect(comptime read: bool, comptime count: usize) [count]Registry.ComponentTypeId {
+            var ids: [count]Registry.ComponentTypeId = undefined;
+            var i = 0;
+            for (fields) |field| {
+                const info = @typeInfo(field.type).pointer;
+                if (info.is_const != read) continue;
+                ids[i] = Registry.typeId(info.child);
+                i += 1;
+            }
+            return ids;
+        }
+    };
+}
@@ -0,0 +1,95 @@
+// ecs/systems/animation_system.zig
+const std = @import("std");
+
+const Camera = @import("../../renderer/camera.zig").Camera;
+const SkinningBuffer = @import("../../renderer/skinning.zig").SkinningBuffer;
+const JobSystem = @import("../../core/jobs.zig").JobSystem;
+const Registry = @import("../ecs.zig").Registry;
+
+const Frustum = @import("../../math/bounds.zig").Frustum;
+
+const TransformComponent = @import("../components/transform_component.zig").TransformComponent;
+const AnimatorComponent = @import("../components/animator_component.zig").AnimatorComponent;
+
+/// Evaluates every AnimatorComponent's clips into skinning matrices and draws the skinned models
+/// Sampling, blending and the joint matrices run across the job system, one chunk of animators per job
+pub const AnimationSystem = struct {
+    const Animated = struct {
+        transform: *const TransformComponent,
+        animator: *AnimatorComponent,
+    };
+
+    /// Animators one job evaluates
+    pub const default_chunk_size = 16;
+
+    allocator: std.mem.Allocator,
+    registry: *Registry,
+    camera: *Camera,
+    skinning: *SkinningBuffer,
+    chunk_size: usize = default_chunk_size,
+    /// World units bind-pose bounds are grown by for culling, poses reach past them
+    cull_margin: f32 = 0.5,
+
+    const Evaluate = struct {
+        animators: []AnimatorComponent,
+        delta: f32,
+
+        fn run(self: *const Evaluate, start: usize, end: usize) void {
+            for (self.animators[start..end]) |*animator| animator.evaluate(self.delta);
+        }
+    };
+
+    pub fn init(allocator: std.mem.Allocator, registry: *Registry, camera: *Camera, skinning: *SkinningBuffer) !AnimationSystem {
+        try registry.registerDeferedComponent(AnimatorComponent, "deinit");
+        return .{
+            .allocator = allocator,
+            .registry = registry,
+            .camera = camera,
+            .skinning = skinning,
+        };
+    }
+
+    /// Advance and evaluate every animator, across `jobs` when one is given, then upload the palettes
+    /// Call once per frame after SkinningBuffer.beginFrame and before draw
+    pub fn update(self: *AnimationSystem, delta: f32, jobs: ?*JobSystem) !void {
+        const storage = try self.registry.getComponentStorage(AnimatorComponent);
+        const animators = storage.componentSlice();
+
+        const evaluate = Evaluate{ .animators = animators, .delta = delta };
+        if (jobs) |job_system| {
+            job_system.parallelFor(animators.len, self.chunk_size, &evaluate, Evaluate.run);
+        } else {
+            evaluate.run(0, animators.len);
+        }
+
+        // Uploads stay on this thread, the buffer is not shared with the workers
+        for (animators) |*animator| {
+            animator.palette = try self.skinning.write(animator.skin);
+        }
+    }
+
+    /// Draw the visible animated models with their palettes from the camera perspective
+    pub fn draw(self: *AnimationSystem) !void {
+        const frustum: Frustum = self.camera.getFrustum();
+        const query = try self.registry.cachedQuery(Animated);
+
+        query.reset();
+        while (query.next()) |components| {
+            const animator = components.animator;
+            if (!animator.visible) continue;
+            const palette = animator.palette orelse continue;
+
+            const render_matrix = &components.transform.render_matrix;
+            const bounds = animator.model.bounds.expanded(self.cull_margin).transformedAffine(render_matrix);
+            if (!frustum.intersectsBox(bounds)) continue;
+
+            self.skinning.bind(palette);
+            var world = render_matrix.toMat4();
+            try self.camera.drawModel(animator.model, &world);
+        }
+    }
+
+    pub fn deinit(self: *AnimationSystem) void {
+        _ = self;
+    }
+};
@@ -0,0 +1,427 @@
+// ecs/systems/collision_system.zig
+const std = @import("std");
+
+const Registry = @import("../ecs.zig").Registry;
+const EntityId = @import("../ecs.zig").EntityId;
+const ComponentStorage = @import("../ecs.zig").ComponentStorage;
+const JobSystem = @import("../../core/jobs.zig").JobSystem;
+const profiler = @import("../../core/profiler.zig");
+
+const collision = @import("../../math/collision.zig");
+const WorldShape = collision.WorldShape;
+const PairKind = collision.PairKind;
+const Pair = collision.Pair;
+const Hit = collision.Hit;
+const Vec3f = @import("../../math/vector.zig").Vec3f;
+
+const TransformComponent = @import("../components/transform_component.zig").TransformComponent;
+const ColliderComponent = @import("../components/collider_component.zig").ColliderComponent;
+
+pub const CollisionConfig = struct {
+    /// Candidate pairs the broadphase keeps per frame, the rest are counted in `dropped`
+    max_pairs: u32 = 1 << 17,
+    /// Colliders per broadphase job and pairs per narrowphase job
+    chunk_size: u32 = 1024,
+};
+
+/// Two colliders in contact, `normal` points from `a` toward `b`
+pub const Contact = struct {
+    a: EntityId,
+    b: EntityId,
+    normal: Vec3f,
+    depth: f32,
+};
+
+/// Finds the overlapping ColliderComponents every update and lists them in `contacts`
+/// The broadphase sorts the colliders' world bounds along x and sweeps that order, testing y and z a vector of
+/// neighbours at a time. Bodies move little between frames, so the order of the last update is re-sorted by
+/// insertion in close to linear time. Candidate pairs are grouped by shape pair and tested in SIMD batches.
+/// Both phases run across the job system when one is given, every buffer is sized up front and reused.
+/// Contacts are in no particular order
+pub const CollisionSystem = struct {
+    const lanes = collision.lanes;
+    const V = @Vector(lanes, f32);
+
+    /// Broadphase candidate, sorted into `pairs` by kind
+    const Candidate = struct {
+        pair: Pair,
+        kind: PairKind,
+    };
+
+    const Filter = struct {
+        layer: u32,
+        mask: u32,
+    };
+
+    /// World bounds along the sweep order, padded by one vector of bounds that overlap nothing
+    const SortedBounds = struct {
+        min_x: std.ArrayListUnmanaged(f32) = .{},
+        max_x: std.ArrayListUnmanaged(f32) = .{},
+        min_y: std.ArrayListUnmanaged(f32) = .{},
+        max_y: std.ArrayListUnmanaged(f32) = .{},
+        min_z: std.ArrayListUnmanaged(f32) = .{},
+        max_z: std.ArrayListUnmanaged(f32) = .{},
+
+        fn lists(self: *SortedBounds) [6]*std.ArrayListUnmanaged(f32) {
+            return .{ &self.min_x, &self.max_x, &self.min_y, &self.max_y, &self.min_z, &self.max_z };
+        }
+    };
+
+    allocator: std.mem.Allocator,
+    registry: *Registry,
+    config: CollisionConfig,
+
+    /// Per collider slot: world shape, collision filter and the min x sort key
+    shapes: std.ArrayListUnmanaged(WorldShape) = .{},
+    filters: std.ArrayListUnmanaged(Filter) = .{},
+    keys: std.ArrayListUnmanaged(f32) = .{},
+    /// Collider slots in ascending min x, kept between updates
+    order: std.ArrayListUnmanaged(u32) = .{},
+    sorted: SortedBounds = .{},
+
+    candidates: []Candidate,
+    candidate_count: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    /// Candidates grouped by kind, kind k in pairs[kind_start[k]..kind_start[k + 1]]
+    pairs: []Pair,
+    kind_start: [PairKind.count + 1]u32 = .{0} ** (PairKind.count + 1),
+    hits: []Hit,
+    overlapping: []bool,
+
+    contacts: std.ArrayListUnmanaged(Contact),
+    /// Candidate pairs past max_pairs in the last update, raise it if this is not zero
+    dropped: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+
+    const Gather = struct {
+        system: *CollisionSystem,
+        entities: []const EntityId,
+        colliders: []const ColliderComponent,
+        transforms: *ComponentStorage(TransformComponent),
+
+        fn run(self: *const Gather, start: usize, end: usize) void {
+            const s = self.system;
+            for (start..end) |slot| {
+                const collider = self.colliders[slot];
+                s.filters.items[slot] = .{ .layer = collider.layer, .mask = collider.mask };
+
+                // Colliders without a transform keep bounds that overlap nothing and sort last
+                const transform = self.transforms.get(self.entities[slot]) orelse {
+                    s.shapes.items[slot] = .{ .kind = std.meta.activeTag(collider.shape), .center = Vec3f.create(0.0, 0.0, 0.0), .half = Vec3f.create(0.0, 0.0, 0.0) };
+                    s.keys.items[slot] = std.math.inf(f32);
+                    continue;
+                };
+                const shape = WorldShape.fromShape(collider.shape, &transform.world_matrix);
+                s.shapes.items[slot] = shape;
+                s.keys.items[slot] = shape.bounds().min.x;
+            }
+        }
+    };
+
+    const Sweep = struct {
+        system: *CollisionSystem,
+        count: usize,
+
+        fn run(self: *const Sweep, start: usize, end: usize) void {
+            const s = self.system;
+            const b = &s.sorted;
+            var local: [256]Candidate = undefined;
+            var local_count: usize = 0;
+
+            for (start..end) |i| {
+                const max_x: V = @splat(b.max_x.items[i]);
+                const min_y: V = @splat(b.min_y.items[i]);
+                const max_y: V = @splat(b.max_y.items[i]);
+                const min_z: V = @splat(b.min_z.items[i]);
+                const max_z: V = @splat(b.max_z.items[i]);
+
+                var j = i + 1;
+                while (j < self.count) : (j += lanes) {
+                    const lo_x: V = b.min_x.items[j..][0..lanes].*;
+                    const overlap_x = lo_x <= max_x;
+                    const overlap_y = both(@as(V, b.max_y.items[j..][0..lanes].*) >= min_y, @as(V, b.min_y.items[j..][0..lanes].*) <= max_y);
+                    const overlap_z = both(@as(V, b.max_z.items[j..][0..lanes].*) >= min_z, @as(V, b.min_z.items[j..][0..lanes].*) <= max_z);
+                    const candidates = both(overlap_x, both(overlap_y, overlap_z));
+
+                    if (@reduce(.Or, candidates)) {
+                        const lane_hits: [lanes]bool = candidates;
+                        for (lane_hits, 0..) |hit, lane| {
+                            if (!hit) continue;
+                            const candidate = s.classify(s.order.items[i], s.order.items[j + lane]) orelse continue;
+                            local[local_count] = candidate;
+                            local_count += 1;
+                            if (local_count == local.len) {
+                                s.emit(local[0..local_count]);
+                                local_count = 0;
+                            }
+                        }
+                    }
+                    // Sorted by min x, nothing further along can overlap once a whole vector starts past max x
+                    if (b.min_x.items[j + lanes - 1] > b.max_x.items[i]) break;
+                }
+            }
+            s.emit(local[0..local_count]);
+        }
+    };
+
+    const Narrow = struct {
+        system: *CollisionSystem,
+
+        fn run(self: *const Narrow, start: usize, end: usize) void {
+            const s = self.system;
+            for (0..PairKind.count) |kind| {
+                const first = @max(start, s.kind_start[kind]);
+                const last = @min(end, s.kind_start[kind + 1]);
+                if (first >= last) continue;
+
+                const pairs = s.pairs[first..last];
+                const hits = s.hits[first..last];
+                const overlapping = s.overlapping[first..last];
+                switch (@as(PairKind, @enumFromInt(kind))) {
+                    .sphere_sphere => collision.sphereSphereBatch(s.shapes.items, pairs, hits, overlapping),
+                    .aabb_aabb => collision.aabbAabbBatch(s.shapes.items, pairs, hits, overlapping),
+                    .sphere_box => collision.sphereBoxBatch(s.shapes.items, pairs, hits, overlapping),
+                    .box_box => collision.boxBoxBatch(s.shapes.items, pairs, hits, overlapping),
+                }
+            }
+        }
+    };
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, registry: *Registry, config: CollisionConfig) !CollisionSystem {
+        try registry.registerComponent(TransformComponent);
+        try registry.registerComponent(ColliderComponent);
+
+        const candidates = try allocator.alloc(Candidate, config.max_pairs);
+        errdefer allocator.free(candidates);
+        const pairs = try allocator.alloc(Pair, config.max_pairs);
+        errdefer allocator.free(pairs);
+        const hits = try allocator.alloc(Hit, config.max_pairs);
+        errdefer allocator.free(hits);
+        const overlapping = try allocator.alloc(bool, config.max_pairs);
+        errdefer allocator.free(overlapping);
+        const contacts = try std.ArrayListUnmanaged(Contact).initCapacity(allocator, config.max_pairs);
+
+        return .{
+            .allocator = allocator,
+            .registry = registry,
+            .config = config,
+            .candidates = candidates,
+            .pairs = pairs,
+            .hits = hits,
+            .overlapping = overlapping,
+            .contacts = contacts,
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Find this frame's contacts, run after TransformSystem.update, across `jobs` when one is given
+    pub fn update(self: *CollisionSystem, jobs: ?*JobSystem) !void {
+        const zone = profiler.zone("CollisionSystem.update");
+        defer zone.end();
+
+        const colliders = try self.registry.getComponentStorage(ColliderComponent);
+        const transforms = try self.registry.getComponentStorage(TransformComponent);
+        const entities = colliders.entitySlice();
+        const count = entities.len;
+
+        self.contacts.clearRetainingCapacity();
+        self.candidate_count.store(0, .monotonic);
+        self.dropped.store(0, .monotonic);
+
+        try self.resize(count);
+        const gather = Gather{ .system = self, .entities = entities, .colliders = colliders.componentSlice(), .transforms = transforms };
+        dispatch(jobs, count, self.config.chunk_size, &gather, Gather.run);
+
+        self.sortOrder();
+        self.fillSorted();
+        const sweep = Sweep{ .system = self, .count = count };
+        dispatch(jobs, count, self.config.chunk_size, &sweep, Sweep.run);
+
+        self.groupPairs();
+        const total = self.kind_start[PairKind.count];
+        const narrow = Narrow{ .system = self };
+        dispatch(jobs, total, self.config.chunk_size, &narrow, Narrow.run);
+
+        for (self.pairs[0..total], self.hits[0..total], self.overlapping[0..total]) |pair, hit, does_overlap| {
+            if (!does_overlap) continue;
+            self.contacts.appendAssumeCapacity(.{ .a = entities[pair.a], .b = entities[pair.b], .normal = hit.normal, .depth = hit.depth });
+        }
+    }
+
+
+    /// Contacts found by the last update, valid until the next one
+    pub fn contactSlice(self: *const CollisionSystem) []const Contact {
+        return self.contacts.items;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *CollisionSystem) void {
+        self.shapes.deinit(self.allocator);
+        self.filters.deinit(self.allocator);
+        self.keys.deinit(self.allocator);
+        self.order.deinit(self.allocator);
+        for (self.sorted.lists()) |list| list.deinit(self.allocator);
+        self.allocator.free(self.candidates);
+        self.allocator.free(self.pairs);
+        self.allocator.free(self.hits);
+        self.allocator.free(self.overlapping);
+        self.contacts.deinit(self.allocator);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn dispatch(jobs: ?*JobSystem, count: usize, chunk_size: usize, context: anytype, comptime func: fn (@TypeOf(context), usize, usize) void) void {
+        if (jobs) |job_system| {
+            job_system.parallelFor(count, chunk_size, context, func);
+        } else {
+            func(context, 0, count);
+        }
+    }
+
+
+    /// Size the per-slot lists, the order restarts from scratch when colliders came or went
+    fn resize(self: *CollisionSystem, count: usize) !void {
+        try self.shapes.resize(self.allocator, count);
+        try self.filters.resize(self.allocator, count);
+        try self.keys.resize(self.allocator, count);
+        for (self.sorted.lists()) |list| try list.resize(self.allocator, count + lanes);
+
+        if (self.order.items.len != count) {
+            try self.order.resize(self.allocator, count);
+            for (self.order.items, 0..) |*slot, index| slot.* = @intCast(index);
+        }
+    }
+
+
+    /// Insertion sort of last update's order, close to linear while bodies keep their neighbours
+    /// A rebuilt order is far from sorted, so it takes a full sort instead
+    fn sortOrder(self: *CollisionSystem) void {
+        const keys = self.keys.items;
+        const order = self.order.items;
+
+        var shifts: usize = 0;
+        for (1..order.len) |i| {
+            const slot = order[i];
+            const key = keys[slot];
+            var j = i;
+            while (j > 0 and keys[order[j - 1]] > key) : (j -= 1) {
+                order[j] = order[j - 1];
+            }
+            order[j] = slot;
+            shifts += i - j;
+
+            // Too far from sorted to finish by insertion
+            if (shifts > order.len * 8) {
+                std.sort.pdq(u32, order, keys, lessKey);
+                return;
+            }
+        }
+    }
+
+
+    fn lessKey(keys: []const f32, a: u32, b: u32) bool {
+        return keys[a] < keys[b];
+    }
+
+
+    fn fillSorted(self: *CollisionSystem) void {
+        const b = &self.sorted;
+        for (self.order.items, 0..) |slot, i| {
+            const bounds = self.shapes.items[slot].bounds();
+            const missing = std.math.isInf(self.keys.items[slot]);
+            b.min_x.items[i] = if (missing) std.math.inf(f32) else bounds.min.x;
+            b.max_x.items[i] = if (missing) -std.math.inf(f32) else bounds.max.x;
+            b.min_y.items[i] = bounds.min.y;
+            b.max_y.items[i] = bounds.max.y;
+            b.min_z.items[i] = bounds.min.z;
+            b.max_z.items[i] = bounds.max.z;
+        }
+
+        // Padding the sweep may load past the end, it overlaps nothing
+        const count = self.order.items.len;
+        for (count..count + lanes) |i| {
+            b.min_x.items[i] = std.math.inf(f32);
+            b.max_x.items[i] = -std.math.inf(f32);
+            b.min_y.items[i] = std.math.inf(f32);
+            b.max_y.items[i] = -std.math.inf(f32);
+            b.min_z.items[i] = std.math.inf(f32);
+            b.max_z.items[i] = -std.math.inf(f32);
+        }
+    }
+
+
+    /// Candidate for two slots whose bounds overlap, null when their filters keep them apart
+    fn classify(self: *const CollisionSystem, slot_a: u32, slot_b: u32) ?Candidate {
+        const fa = self.filters.items[slot_a];
+        const fb = self.filters.items[slot_b];
+        if ((fa.layer & fb.mask) == 0 or (fb.layer & fa.mask) == 0) return null;
+
+        const kind_a = self.shapes.items[slot_a].kind;
+        const kind_b = self.shapes.items[slot_b].kind;
+        const kind = PairKind.of(kind_a, kind_b);
+        // Sphere-box tests take the sphere first
+        if (kind == .sphere_box and kind_a != .sphere) {
+            return .{ .pair = .{ .a = slot_b, .b = slot_a }, .kind = kind };
+        }
+        return .{ .pair = .{ .a = slot_a, .b = slot_b }, .kind = kind };
+    }
+
+
+    /// Append a worker's candidates, what does not fit is counted as dropped
+    fn emit(self: *CollisionSystem, batch: []const Candidate) void {
+        if (batch.len == 0) return;
+        const first = self.candidate_count.fetchAdd(@intCast(batch.len), .monotonic);
+        const capacity = self.candidates.len;
+        if (first >= capacity) {
+            _ = self.dropped.fetchAdd(@intCast(batch.len), .monotonic);
+            return;
+        }
+        const fits = @min(batch.len, capacity - first);
+        @memcpy(self.candidates[first..][0..fits], batch[0..fits]);
+        if (fits < batch.len) _ = self.dropped.fetchAdd(@intCast(batch.len - fits), .monotonic);
+    }
+
+
+    /// Counting sort of the candidates by kind, so each batched test runs over one contiguous range
+    fn groupPairs(self: *CollisionSystem) void {
+        const total = @min(self.candidate_count.load(.monotonic), self.candidates.len);
+        const candidates = self.candidates[0..total];
+
+        var counts = [_]u32{0} ** PairKind.count;
+        for (candidates) |candidate| counts[@intFromEnum(candidate.kind)] += 1;
+
+        var cursor: [PairKind.count]u32 = undefined;
+        var offset: u32 = 0;
+        for (counts, 0..) |kind_count, kind| {
+            self.kind_start[kind] = offset;
+            cursor[kind] = offset;
+            offset += kind_count;
+        }
+        self.kind_start[PairKind.count] = offset;
+
+        for (candidates) |candidate| {
+            const kind = @intFromEnum(candidate.kind);
+            self.pairs[cursor[kind]] = candidate.pair;
+            cursor[kind] += 1;
+        }
+    }
+
+
+    inline fn both(a: @Vector(lanes, bool), b: @Vector(lanes, bool)) @Vector(lanes, bool) {
+        return @select(bool, a, b, @as(@Vector(lanes, bool), @splat(false)));
+    }
+};
@@ -0,0 +1,283 @@
+// ecs/systems/compaction_system.zig
+const std = @import("std");
+
+const ecs = @import("../ecs.zig");
+const Registry = ecs.Registry;
+const EntityId = ecs.EntityId;
+const EcsError = ecs.EcsError;
+const ComponentStorage = ecs.ComponentStorage;
+const Group = ecs.Group;
+const jobs_module = @import("../../core/jobs.zig");
+const JobSystem = jobs_module.JobSystem;
+const Counter = jobs_module.Counter;
+const morton3 = @import("../../math/misc.zig").morton3;
+
+const TransformComponent = @import("../components/transform_component.zig").TransformComponent;
+
+
+pub const CompactionConfig = struct {
+    /// Main thread time per update spent moving components, checked every few moves
+    budget_ns: u64 = 250 * std.time.ns_per_us,
+    /// Updates between the end of one pass and the start of the next
+    interval: u32 = 60,
+};
+
+
+pub const CompactionStats = struct {
+    /// Passes completed over all storages
+    passes: u64 = 0,
+    /// Components moved by the current or last pass
+    moved: u64 = 0,
+    /// Entities of the current pass not placed, because they left or a swap-remove moved them
+    skipped: u64 = 0,
+};
+
+
+/// Reorders dense storages, or the members of owning groups, in Morton order of the entities' world
+/// positions, so systems walking them in slot order touch neighbors in space one after another
+/// Spawn and despawn churn leaves storages in random order, as remove moves the last slot into the
+/// hole. A pass gathers the Morton codes of one storage, sorts them on a worker and then swaps the
+/// components into place a few at a time under the per-update budget. ComponentStorage.swapSlots keeps
+/// the sparse entries and ticks in step, so entity ids and change detection are unaffected
+/// Changes between updates only make the result less sorted, the next pass catches up
+pub const CompactionSystem = struct {
+    const Self = @This();
+
+    /// Moves between budget checks
+    const check_interval = 64;
+
+    /// A storage or group, type erased
+    const Target = struct {
+        context: *anyopaque,
+        /// Entities in slot order
+        entities: *const fn (context: *anyopaque) []const EntityId,
+        /// Swap `entity` into `slot`, false when it is gone or already sits before the slot
+        place: *const fn (context: *anyopaque, entity: EntityId, slot: u32) bool,
+    };
+
+    const Key = struct {
+        code: u64,
+        entity: EntityId,
+
+        fn lessThan(_: void, a: Key, b: Key) bool {
+            return a.code < b.code;
+        }
+    };
+
+    allocator: std.mem.Allocator,
+    registry: *Registry,
+    jobs: ?*JobSystem,
+    config: CompactionConfig,
+
+    targets: std.ArrayList(Target),
+    /// Target of the current pass
+    target_index: usize = 0,
+    state: enum { idle, sorting, moving } = .idle,
+    /// Entities of the current target in the order they are placed, sorted by the worker
+    keys: std.ArrayList(Key),
+    sort_counter: Counter = .{},
+    /// Next key to place and the slot it goes to
+    cursor: usize = 0,
+    next_slot: u32 = 0,
+    idle_updates: u32 = 0,
+    stats: CompactionStats = .{},
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Sort passes run on `jobs` when given, on the main thread otherwise
+    pub fn init(allocator: std.mem.Allocator, registry: *Registry, jobs: ?*JobSystem, config: CompactionConfig) !Self {
+        try registry.registerComponent(TransformComponent);
+        return .{
+            .allocator = allocator,
+            .registry = registry,
+            .jobs = jobs,
+            .config = config,
+            .targets = std.ArrayList(Target).init(allocator),
+            .keys = std.ArrayList(Key).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Keep the storage of `T` in Morton order, fails when an owning group holds it, see trackGroup
+    /// No owning group may be created on the storage afterwards
+    pub fn track(self: *Self, comptime T: type) !void {
+        const storage = try self.registry.getComponentStorage(T);
+        if (storage.owned) return EcsError.StorageOwnedByGroup;
+
+        const Adapter = struct {
+            fn entities(context: *anyopaque) []const EntityId {
+                const s: *ComponentStorage(T) = @alignCast(@ptrCast(context));
+                return s.entitySlice();
+            }
+
+            fn place(context: *anyopaque, entity: EntityId, slot: u32) bool {
+                const s: *ComponentStorage(T) = @alignCast(@ptrCast(context));
+                const index = s.indexOf(entity) orelse return false;
+                if (index < slot) return false;
+                s.swapSlots(index, slot);
+                return true;
+            }
+        };
+        try self.targets.append(.{ .context = storage, .entities = Adapter.entities, .place = Adapter.place });
+    }
+
+
+    /// Keep the members of the owning group of `A` and `B` in Morton order, both storages move together
+    pub fn trackGroup(self: *Self, comptime A: type, comptime B: type) !void {
+        const owning = try self.registry.group(A, B);
+
+        const Adapter = struct {
+            fn entities(context: *anyopaque) []const EntityId {
+                const g: *Group(A, B) = @alignCast(@ptrCast(context));
+                return g.entitySlice();
+            }
+
+            /// Members sit in the same slot of both storages
+            fn place(context: *anyopaque, entity: EntityId, slot: u32) bool {
+                const g: *Group(A, B) = @alignCast(@ptrCast(context));
+                const index = g.a.indexOf(entity) orelse return false;
+                if (index < slot or index >= g.len) return false;
+                g.a.swapSlots(index, slot);
+                g.b.swapSlots(index, slot);
+                return true;
+            }
+        };
+        try self.targets.append(.{ .context = owning, .entities = Adapter.entities, .place = Adapter.place });
+    }
+
+
+    /// Advance the current pass within the budget, starting the next one once the interval passed
+    pub fn update(self: *Self) !void {
+        if (self.targets.items.len == 0) return;
+
+        switch (self.state) {
+            .idle => {
+                self.idle_updates += 1;
+                if (self.idle_updates < self.config.interval) return;
+                try self.beginPass();
+            },
+            .sorting => {
+                if (!self.sort_counter.isDone()) return;
+                self.state = .moving;
+            },
+            .moving => {},
+        }
+        if (self.state == .moving) self.moveWithinBudget();
+    }
+
+
+    pub fn getStats(self: *const Self) CompactionStats {
+        return self.stats;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Waits for a sort still running on the workers
+    pub fn deinit(self: *Self) void {
+        if (self.jobs) |pool| pool.wait(&self.sort_counter);
+        self.targets.deinit();
+        self.keys.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Gather the codes of the next target and hand their sort to a worker
+    fn beginPass(self: *Self) !void {
+        self.target_index = (self.target_index + 1) % self.targets.items.len;
+        const target = self.targets.items[self.target_index];
+        const entities = target.entities(target.context);
+        const transforms = try self.registry.getComponentStorage(TransformComponent);
+
+        self.idle_updates = 0;
+        self.cursor = 0;
+        self.next_slot = 0;
+        self.stats.moved = 0;
+        self.stats.skipped = 0;
+        self.keys.clearRetainingCapacity();
+        if (entities.len < 2) return;
+        try self.keys.ensureTotalCapacity(entities.len);
+
+        // Codes are quantized over the bounds of the storage's own entities
+        var low = [3]f32{ std.math.inf(f32), std.math.inf(f32), std.math.inf(f32) };
+        var high = [3]f32{ -std.math.inf(f32), -std.math.inf(f32), -std.math.inf(f32) };
+        for (entities) |entity| {
+            const transform = transforms.get(entity) orelse continue;
+            const p = transform.world_matrix.translation();
+            for (&low, &high, [3]f32{ p.x, p.y, p.z }) |*l, *h, v| {
+                l.* = @min(l.*, v);
+                h.* = @max(h.*, v);
+            }
+        }
+
+        const cells: f32 = @floatFromInt(std.math.maxInt(u21));
+        var scale: [3]f32 = undefined;
+        for (&scale, low, high) |*s, l, h| s.* = if (h > l) cells / (h - l) else 0.0;
+
+        for (entities) |entity| {
+            // Entities without a transform go to the end
+            const code = if (transforms.get(entity)) |transform| blk: {
+                const p = transform.world_matrix.translation();
+                break :blk morton3(
+                    @intFromFloat((p.x - low[0]) * scale[0]),
+                    @intFromFloat((p.y - low[1]) * scale[1]),
+                    @intFromFloat((p.z - low[2]) * scale[2]),
+                );
+            } else std.math.maxInt(u64);
+            self.keys.appendAssumeCapacity(.{ .code = code, .entity = entity });
+        }
+
+        if (self.jobs) |pool| {
+            self.state = .sorting;
+            pool.spawn(&self.sort_counter, sortKeys, .{self.keys.items}) catch sortKeys(self.keys.items);
+        } else {
+            sortKeys(self.keys.items);
+            self.state = .moving;
+        }
+    }
+
+
+    fn sortKeys(keys: []Key) void {
+        std.sort.pdq(Key, keys, {}, Key.lessThan);
+    }
+
+
+    /// Swap the sorted entities into consecutive slots until the budget runs out or the pass ends
+    fn moveWithinBudget(self: *Self) void {
+        const target = self.targets.items[self.target_index];
+        var timer = std.time.Timer.start() catch null;
+
+        // Removes since the sort may have shrunk the target, the slots past its end are gone
+        const slots = target.entities(target.context).len;
+        while (self.cursor < self.keys.items.len and self.next_slot < slots) {
+            const key = self.keys.items[self.cursor];
+            self.cursor += 1;
+            if (target.place(target.context, key.entity, self.next_slot)) {
+                self.next_slot += 1;
+                self.stats.moved += 1;
+            } else {
+                self.stats.skipped += 1;
+            }
+
+            if (self.cursor % check_interval != 0) continue;
+            if (timer) |*t| {
+                if (t.read() >= self.config.budget_ns) return;
+            }
+        }
+
+        self.stats.passes += 1;
+        self.state = .idle;
+    }
+};
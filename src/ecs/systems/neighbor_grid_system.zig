@@ -0,0 +1,369 @@
+// ecs/systems/neighbor_grid_system.zig
+const std = @import("std");
+
+const Registry = @import("../ecs.zig").Registry;
+const EntityId = @import("../ecs.zig").EntityId;
+const ComponentStorage = @import("../ecs.zig").ComponentStorage;
+const JobSystem = @import("../../core/jobs.zig").JobSystem;
+const profiler = @import("../../core/profiler.zig");
+const Vec3f = @import("../../math/vector.zig").Vec3f;
+
+const TransformComponent = @import("../components/transform_component.zig").TransformComponent;
+
+pub const NeighborGridConfig = struct {
+    /// Edge of a cell, around the usual query radius works best
+    cell_size: f32 = 2.0,
+    /// Bin on the x-z plane and ignore heights, for agents walking on the ground
+    planar: bool = false,
+    /// Members per gather and scatter job
+    chunk_size: u32 = 4096,
+};
+
+/// Member found by nearest, closest first
+pub const Neighbor = struct {
+    entity: EntityId,
+    distance_sq: f32,
+};
+
+/// Uniform hash grid over the world positions of every entity with a `Member` component and a
+/// transform, rebuilt from scratch each update for agents that all move, such as boids or crowds
+/// Pass TransformComponent itself to bin every transform. The build is a counting sort: one parallel
+/// pass hashes each member's cell and counts it, a prefix sum turns the counts into bucket starts and a
+/// second parallel pass scatters entities and positions into them, so members of a cell sit next to
+/// each other. Buckets are a power of two of at least twice the members. Cells that hash to the same
+/// bucket share it, queries test each entry's cell. Queries only read and may run on any number of
+/// threads between updates
+pub fn NeighborGrid(comptime Member: type) type {
+    return struct {
+        const Self = @This();
+
+        const Cell = [3]i32;
+        /// Keeps cell coordinates of far away or non-finite positions in range
+        const cell_limit: f32 = 1 << 30;
+        /// Bucket of a member without a transform, left out of the grid
+        const no_bucket = std.math.maxInt(u32);
+
+        allocator: std.mem.Allocator,
+        registry: *Registry,
+        config: NeighborGridConfig,
+        inv_cell_size: f32,
+
+        /// Per member slot, filled by the gather pass
+        slot_positions: std.ArrayListUnmanaged(Vec3f) = .{},
+        slot_buckets: std.ArrayListUnmanaged(u32) = .{},
+        /// Members per bucket, then the scatter cursor of each bucket
+        counts: std.ArrayListUnmanaged(std.atomic.Value(u32)) = .{},
+        /// Bucket b holds entries starts[b]..starts[b + 1]
+        starts: std.ArrayListUnmanaged(u32) = .{},
+        /// Entries in bucket order
+        entities: std.ArrayListUnmanaged(EntityId) = .{},
+        positions: std.ArrayListUnmanaged(Vec3f) = .{},
+        bucket_mask: u32 = 0,
+
+        /// Cells covering every member, bounds the rings nearest searches
+        low_cell: Cell = .{ 0, 0, 0 },
+        high_cell: Cell = .{ 0, 0, 0 },
+        bounds_lock: std.Thread.Mutex = .{},
+
+        const Gather = struct {
+            grid: *Self,
+            entities: []const EntityId,
+            transforms: *ComponentStorage(TransformComponent),
+
+            fn run(self: *const Gather, start: usize, end: usize) void {
+                const g = self.grid;
+                var low = Cell{ std.math.maxInt(i32), std.math.maxInt(i32), std.math.maxInt(i32) };
+                var high = Cell{ std.math.minInt(i32), std.math.minInt(i32), std.math.minInt(i32) };
+
+                for (start..end) |slot| {
+                    const transform = self.transforms.get(self.entities[slot]) orelse {
+                        g.slot_buckets.items[slot] = no_bucket;
+                        continue;
+                    };
+                    const position = transform.world_matrix.translation();
+                    const cell = g.cellOf(position);
+                    const bucket = g.bucketOf(cell);
+                    g.slot_positions.items[slot] = position;
+                    g.slot_buckets.items[slot] = bucket;
+                    _ = g.counts.items[bucket].fetchAdd(1, .monotonic);
+
+                    for (&low, &high, cell) |*l, *h, v| {
+                        l.* = @min(l.*, v);
+                        h.* = @max(h.*, v);
+                    }
+                }
+
+                if (start == end) return;
+                g.bounds_lock.lock();
+                defer g.bounds_lock.unlock();
+                for (&g.low_cell, &g.high_cell, low, high) |*l, *h, chunk_low, chunk_high| {
+                    l.* = @min(l.*, chunk_low);
+                    h.* = @max(h.*, chunk_high);
+                }
+            }
+        };
+
+        const Scatter = struct {
+            grid: *Self,
+            entities: []const EntityId,
+
+            fn run(self: *const Scatter, start: usize, end: usize) void {
+                const g = self.grid;
+                for (start..end) |slot| {
+                    const bucket = g.slot_buckets.items[slot];
+                    if (bucket == no_bucket) continue;
+                    const index = g.counts.items[bucket].fetchAdd(1, .monotonic);
+                    g.entities.items[index] = self.entities[slot];
+                    g.positions.items[index] = g.slot_positions.items[slot];
+                }
+            }
+        };
+
+
+        // ============================================================
+        // Public API: Creation Functions
+        // ============================================================
+
+        pub fn init(allocator: std.mem.Allocator, registry: *Registry, config: NeighborGridConfig) !Self {
+            try registry.registerComponent(TransformComponent);
+            try registry.registerComponent(Member);
+            return .{
+                .allocator = allocator,
+                .registry = registry,
+                .config = config,
+                .inv_cell_size = 1.0 / config.cell_size,
+            };
+        }
+
+
+        // ============================================================
+        // Public API: Operational Functions
+        // ============================================================
+
+        /// Rebin every member, run after TransformSystem.update, across `jobs` when one is given
+        /// Entries within a bucket come in no fixed order when jobs share the scatter
+        pub fn update(self: *Self, jobs: ?*JobSystem) !void {
+            const zone = profiler.zone("NeighborGrid.update");
+            defer zone.end();
+
+            const members = try self.registry.getComponentStorage(Member);
+            const transforms = try self.registry.getComponentStorage(TransformComponent);
+            const entities = members.entitySlice();
+
+            try self.resize(entities.len);
+            self.low_cell = .{ std.math.maxInt(i32), std.math.maxInt(i32), std.math.maxInt(i32) };
+            self.high_cell = .{ std.math.minInt(i32), std.math.minInt(i32), std.math.minInt(i32) };
+
+            const gather = Gather{ .grid = self, .entities = entities, .transforms = transforms };
+            dispatch(jobs, entities.len, self.config.chunk_size, &gather, Gather.run);
+
+            // Counts become bucket starts and, for the scatter, cursors
+            var offset: u32 = 0;
+            for (self.counts.items, self.starts.items[0..self.counts.items.len]) |*bucket_count, *start| {
+                start.* = offset;
+                offset += bucket_count.raw;
+                bucket_count.raw = start.*;
+            }
+            self.starts.items[self.counts.items.len] = offset;
+            self.entities.items.len = offset;
+            self.positions.items.len = offset;
+
+            const scatter = Scatter{ .grid = self, .entities = entities };
+            dispatch(jobs, entities.len, self.config.chunk_size, &scatter, Scatter.run);
+        }
+
+
+        /// Members in the grid as of the last update
+        pub fn count(self: *const Self) usize {
+            return self.entities.items.len;
+        }
+
+
+        /// Members within `radius` of `center`, as many as fit in `out`, in no particular order
+        /// A member standing at `center` is part of the result
+        pub fn queryRadius(self: *const Self, center: Vec3f, radius: f32, out: []EntityId) []EntityId {
+            if (self.count() == 0 or out.len == 0) return out[0..0];
+            const radius_sq = radius * radius;
+            const low = self.cellOf(Vec3f.create(center.x - radius, center.y - radius, center.z - radius));
+            const high = self.cellOf(Vec3f.create(center.x + radius, center.y + radius, center.z + radius));
+
+            var found: usize = 0;
+            // Past as many cells as buckets, one walk over all entries is cheaper than the cells
+            if (cellCount(low, high) > self.counts.items.len) {
+                for (self.positions.items, self.entities.items) |position, entity| {
+                    if (self.distanceSq(center, position) > radius_sq) continue;
+                    out[found] = entity;
+                    found += 1;
+                    if (found == out.len) break;
+                }
+                return out[0..found];
+            }
+
+            var z = low[2];
+            while (z <= high[2]) : (z += 1) {
+                var y = low[1];
+                while (y <= high[1]) : (y += 1) {
+                    var x = low[0];
+                    while (x <= high[0]) : (x += 1) {
+                        const cell = Cell{ x, y, z };
+                        const bucket = self.bucketOf(cell);
+                        for (self.starts.items[bucket]..self.starts.items[bucket + 1]) |i| {
+                            const position = self.positions.items[i];
+                            if (self.distanceSq(center, position) > radius_sq) continue;
+                            // Another cell of the same bucket, found when its own cell is walked
+                            if (!std.mem.eql(i32, &self.cellOf(position), &cell)) continue;
+                            out[found] = self.entities.items[i];
+                            found += 1;
+                            if (found == out.len) return out;
+                        }
+                    }
+                }
+            }
+            return out[0..found];
+        }
+
+
+        /// The out.len members nearest to `center` within `max_radius`, closest first
+        /// Walks rings of cells outward and stops once no unwalked cell can hold anything closer
+        pub fn nearest(self: *const Self, center: Vec3f, max_radius: f32, out: []Neighbor) []Neighbor {
+            if (self.count() == 0 or out.len == 0) return out[0..0];
+            const max_sq = max_radius * max_radius;
+            const origin = self.cellOf(center);
+
+            // No member lies beyond the ring reaching the far corner of the grid's cells
+            var rings: i64 = 0;
+            for (origin, self.low_cell, self.high_cell) |o, l, h| {
+                rings = @max(rings, @max(@as(i64, o) - l, @as(i64, h) - o));
+            }
+            const radius_rings = @min(@ceil(max_radius * self.inv_cell_size), cell_limit);
+            rings = @min(rings, @as(i64, @intFromFloat(radius_rings)));
+
+            var found: usize = 0;
+            var ring: i32 = 0;
+            while (ring <= rings) : (ring += 1) {
+                const height: i32 = if (self.config.planar) 0 else ring;
+                var dz: i32 = -ring;
+                while (dz <= ring) : (dz += 1) {
+                    var dy: i32 = -height;
+                    while (dy <= height) : (dy += 1) {
+                        // Rows on a face of the ring's cube are walked whole, the others only at their ends
+                        const whole = @abs(dz) == ring or @abs(dy) == ring;
+                        var dx: i32 = -ring;
+                        while (dx <= ring) : (dx += if (whole) 1 else 2 * ring) {
+                            const cell = Cell{ origin[0] + dx, origin[1] + dy, origin[2] + dz };
+                            found = self.gatherCell(cell, center, max_sq, out, found);
+                        }
+                    }
+                }
+
+                // The center may sit anywhere in its cell, so the next ring is at least `ring` cells away
+                if (found == out.len) {
+                    const reach = @as(f32, @floatFromInt(ring)) * self.config.cell_size;
+                    if (out[found - 1].distance_sq <= reach * reach) break;
+                }
+            }
+            return out[0..found];
+        }
+
+
+        // ============================================================
+        // Public API: Destruction Function
+        // ============================================================
+
+        pub fn deinit(self: *Self) void {
+            self.slot_positions.deinit(self.allocator);
+            self.slot_buckets.deinit(self.allocator);
+            self.counts.deinit(self.allocator);
+            self.starts.deinit(self.allocator);
+            self.entities.deinit(self.allocator);
+            self.positions.deinit(self.allocator);
+        }
+
+
+        // ============================================================
+        // Private: Helper Functions
+        // ============================================================
+
+        fn dispatch(jobs: ?*JobSystem, total: usize, chunk_size: usize, context: anytype, comptime func: fn (@TypeOf(context), usize, usize) void) void {
+            if (jobs) |job_system| {
+                job_system.parallelFor(total, chunk_size, context, func);
+            } else {
+                func(context, 0, total);
+            }
+        }
+
+
+        /// Size the per-slot lists and entries for `members` and clear the bucket counts
+        fn resize(self: *Self, members: usize) !void {
+            try self.slot_positions.resize(self.allocator, members);
+            try self.slot_buckets.resize(self.allocator, members);
+            try self.entities.ensureTotalCapacity(self.allocator, members);
+            try self.positions.ensureTotalCapacity(self.allocator, members);
+            self.entities.items.len = members;
+            self.positions.items.len = members;
+
+            const buckets = std.math.ceilPowerOfTwo(usize, @max(members * 2, 64)) catch return error.OutOfMemory;
+            try self.counts.resize(self.allocator, buckets);
+            try self.starts.resize(self.allocator, buckets + 1);
+            @memset(self.counts.items, std.atomic.Value(u32).init(0));
+            self.bucket_mask = @intCast(buckets - 1);
+        }
+
+
+        fn cellOf(self: *const Self, position: Vec3f) Cell {
+            const y: i32 = if (self.config.planar) 0 else self.coordinate(position.y);
+            return .{ self.coordinate(position.x), y, self.coordinate(position.z) };
+        }
+
+
+        fn coordinate(self: *const Self, value: f32) i32 {
+            const scaled = @floor(value * self.inv_cell_size);
+            if (std.math.isNan(scaled)) return 0;
+            return @intFromFloat(std.math.clamp(scaled, -cell_limit, cell_limit));
+        }
+
+
+        fn bucketOf(self: *const Self, cell: Cell) u32 {
+            const x: u32 = @bitCast(cell[0]);
+            const y: u32 = @bitCast(cell[1]);
+            const z: u32 = @bitCast(cell[2]);
+            return ((x *% 73856093) ^ (y *% 19349663) ^ (z *% 83492791)) & self.bucket_mask;
+        }
+
+
+        fn cellCount(low: Cell, high: Cell) u64 {
+            var cells: u64 = 1;
+            for (low, high) |l, h| cells *|= @intCast(@as(i64, h) - l + 1);
+            return cells;
+        }
+
+
+        fn distanceSq(self: *const Self, a: Vec3f, b: Vec3f) f32 {
+            const dx = a.x - b.x;
+            const dy = if (self.config.planar) 0.0 else a.y - b.y;
+            const dz = a.z - b.z;
+            return dx * dx + dy * dy + dz * dz;
+        }
+
+
+        /// Offer the members of `cell` to the sorted `out[0..found]`, returns the new length
+        fn gatherCell(self: *const Self, cell: Cell, center: Vec3f, max_sq: f32, out: []Neighbor, found: usize) usize {
+            const bucket = self.bucketOf(cell);
+            var length = found;
+            for (self.starts.items[bucket]..self.starts.items[bucket + 1]) |i| {
+                const position = self.positions.items[i];
+                const distance_sq = self.distanceSq(center, position);
+                if (distance_sq > max_sq) continue;
+                if (length == out.len and distance_sq >= out[length - 1].distance_sq) continue;
+                if (!std.mem.eql(i32, &self.cellOf(position), &cell)) continue;
+
+                // Insertion keeps the list short and sorted, the farthest falls off a full one
+                var slot = if (length == out.len) length - 1 else length;
+                if (length < out.len) length += 1;
+                while (slot > 0 and out[slot - 1].distance_sq > distance_sq) : (slot -= 1) out[slot] = out[slot - 1];
+                out[slot] = .{ .entity = self.entities.items[i], .distance_sq = distance_sq };
+            }
+            return length;
+        }
+    };
+}
@@ -1,44 +1,394 @@
 // ecs/systems/render_system.zig
-const Renderer = @import("../../renderer/renderer.zig").Renderer;
+const std = @import("std");
+const c = @import("../../bindings/c.zig");
+
+const Camera = @import("../../renderer/camera.zig").Camera;
+const Model = @import("../../renderer/model.zig").Model;
+const RenderQueue = @import("../../renderer/render_queue.zig").RenderQueue;
+const RenderBundle = @import("../../renderer/render_bundle.zig").RenderBundle;
+const RenderPacket = @import("../../renderer/render_thread.zig").RenderPacket;
+const RenderView = @import("../../renderer/renderer.zig").RenderView;
+const max_views = @import("../../renderer/shader.zig").max_views;
+const TextureStreamer = @import("../../renderer/texture_streamer.zig").TextureStreamer;
 const Registry = @import("../ecs.zig").Registry;
+const EntityId = @import("../ecs.zig").EntityId;
+const SpatialSystem = @import("spatial_system.zig").SpatialSystem;
+
+const Affine3x4 = @import("../../math/affine.zig").Affine3x4;
+const Frustum = @import("../../math/bounds.zig").Frustum;
+const BoundingBox = @import("../../math/bounds.zig").BoundingBox;
 
-const TransformComponent = @import("../components/transform_component.zigg").TransformComponent;
+const TransformComponent = @import("../components/transform_component.zig").TransformComponent;
 const ModelComponent = @import("../components/model_component.zig").ModelComponent;
 
 const EcsError = @import("../ecs.zig").EcsError;
 
 pub const RenderSystem = struct {
+    const Renderable = struct {
+        transform: *const TransformComponent,
+        model: *const ModelComponent,
+    };
+
+    /// Entities drawing the same level of the same model share one instanced batch
+    const BatchKey = struct {
+        model: *Model,
+        lod: u8,
+    };
+
+    /// Entity drawn outside the batches, under its occlusion query
+    const OccludedDraw = struct {
+        entity: EntityId,
+        model: *Model,
+        lod: u8,
+        world_matrix: Affine3x4,
+        bounds: BoundingBox,
+    };
+
+    const OcclusionQuery = struct {
+        query: c.GLuint,
+        /// Issued at least once, so it has a result to condition draws on
+        issued: bool = false,
+        /// Drawn this frame, queries of entities that stopped drawing are deleted
+        used: bool = false,
+    };
+
+    /// Default fraction by which a projected size has to pass a LOD threshold to switch levels
+    pub const default_lod_hysteresis: f32 = 0.1;
+
+    allocator: std.mem.Allocator,
     registry: *Registry,
-    renderer: *Renderer,
+    camera: *Camera,
+    /// Cameras drawn side by side in one multi-view submission instead of `camera` alone, up to max_views
+    /// Entities are kept when any of them sees them, `camera` still picks the levels of detail
+    views: []const *Camera = &.{},
+
+    /// World matrices of the visible entities drawing each model, lists are reused between frames
+    batches: std.AutoArrayHashMap(BatchKey, std.ArrayList(Affine3x4)),
+    /// Every batch's draws, sorted by state before submission
+    queue: RenderQueue,
+    /// Draw TransformComponent.relative_matrix instead of render_matrix, for worlds using double precision
+    /// origins. Run TransformSystem.updateCameraRelative with the camera's origin first. The spatial tree
+    /// holds world space bounds, so culling then tests every entity
+    camera_relative: bool = false,
+    /// Static models without levels of detail or occlusion queries, opaque and instanced, are drawn from this
+    /// bundle by update instead of being batched every frame. It is recorded whenever it is not valid, call
+    /// RenderBundle.invalidate after adding, removing, moving or hiding static entities. With camera_relative
+    /// that includes every move of the camera's origin. record and multi-view updates batch them as usual
+    bundle: ?*RenderBundle = null,
+    /// Static entities pushed here while the bundle is recorded, reused between recordings
+    bundle_queue: RenderQueue,
+    /// Culls through the tree instead of testing every entity when set, update it before this system
+    spatial: ?*SpatialSystem = null,
+    /// Entities the spatial query returned this frame
+    visible: std.ArrayList(EntityId),
+    /// LOD each entity index was drawn with last frame, the starting point of the next selection
+    lods: std.ArrayList(u8),
+    lod_hysteresis: f32 = default_lod_hysteresis,
+    /// Receives the on-screen size of every drawn material texture when set, e.g. ResourceManager.textureStreamer
+    texture_streamer: ?*TextureStreamer = null,
+    /// Pixel height of the render target, turns projected sizes into texel demand for streaming
+    viewport_height: f32 = 1080.0,
+    /// Entities with ModelComponent.occlusion_query drawn this frame
+    occluded: std.ArrayList(OccludedDraw),
+    /// Query of every entity drawn under one, created and deleted on the GL thread by update
+    occlusion_queries: std.AutoArrayHashMap(EntityId, OcclusionQuery),
 
-    pub fn init(registry: *Registry, renderer: *Renderer) RenderSystem {
+    pub fn init(allocator: std.mem.Allocator, registry: *Registry, camera: *Camera) RenderSystem {
         return .{
+            .allocator = allocator,
             .registry = registry,
-            .renderer = renderer,
+            .camera = camera,
+            .batches = std.AutoArrayHashMap(BatchKey, std.ArrayList(Affine3x4)).init(allocator),
+            .queue = RenderQueue.init(allocator),
+            .bundle_queue = RenderQueue.init(allocator),
+            .visible = std.ArrayList(EntityId).init(allocator),
+            .lods = std.ArrayList(u8).init(allocator),
+            .occluded = std.ArrayList(OccludedDraw).init(allocator),
+            .occlusion_queries = std.AutoArrayHashMap(EntityId, OcclusionQuery).init(allocator),
         };
     }
 
+    /// Draw every visible model, run TransformSystem.update first so world matrices are current
+    /// Models are drawn at their render matrix, blended between fixed steps when TransformSystem.interpolate ran
+    /// Entities whose model bounds lie outside the camera frustum are skipped before batching
+    /// Entities sharing a model are drawn together with one instanced draw per mesh-material pair,
+    /// and the draws are ordered by shader, material and mesh so shared state is bound once
+    /// Models with LOD levels draw the level matching their projected size per entity
+    /// Models flagged for occlusion queries are drawn on their own, conditional on last frame's query
     pub fn update(self: *RenderSystem) !void {
-        // Query for entities with all required components
-        var query = try self.registry.query(struct {
-            transform: *TransformComponent,
-            model: *ModelComponent,
-        });
-        defer query.deinit();
-
-        while (try query.next()) |components| {
-            // Skip if not visible
-            if (!components.model.visible) continue;
-
-            // Update transform matrices
-            components.transform.updateMatrix();
-            //const model = components.model.model;
-
-            // Draw the model using current transform
-            try self.renderer.drawModel(
-                components.model.model, 
-                &components.transform.world_matrix,
-            );
+        self.queue.clear();
+        if (self.views.len > 0) return self.updateViews();
+
+        try self.collect(&self.queue, true, self.bundle != null);
+        try self.updateOcclusionQueries(&self.queue);
+        try self.camera.drawQueue(&self.queue);
+        if (self.bundle) |bundle| try self.drawBundle(bundle);
+    }
+
+    /// Like update, but records the draws and the camera into `packet` for a RenderThread instead of drawing
+    /// Queries need the GL thread, so models flagged for them are batched like the others
+    pub fn record(self: *RenderSystem, packet: *RenderPacket) !void {
+        packet.setCamera(self.camera);
+        try self.collect(&packet.queue, false, false);
+    }
+
+    pub fn deinit(self: *RenderSystem) void {
+        for (self.batches.values()) |*list| list.deinit();
+        self.batches.deinit();
+        self.queue.deinit();
+        self.bundle_queue.deinit();
+        self.visible.deinit();
+        self.lods.deinit();
+        self.occluded.deinit();
+        for (self.occlusion_queries.values()) |*state| c.glDeleteQueries(1, &state.query);
+        self.occlusion_queries.deinit();
+    }
+
+    /// Every view in one submission, occlusion queries are left to single view updates
+    fn updateViews(self: *RenderSystem) !void {
+        std.debug.assert(self.views.len <= max_views);
+        try self.collect(&self.queue, false, false);
+
+        var views: [max_views]RenderView = undefined;
+        for (self.views, 0..) |camera, index| {
+            views[index] = .{
+                .view_matrix = camera.view_matrix,
+                .projection_matrix = camera.projection_matrix,
+                .position = camera.position,
+            };
+        }
+        try self.camera.active_renderer.drawQueueViews(&self.queue, views[0..self.views.len]);
+    }
+
+    /// Cull and batch the renderables and push every batch onto `queue`
+    /// With `occlusion` the flagged models are set aside in `occluded` instead, with `bundled` the models
+    /// the bundle draws are skipped
+    fn collect(self: *RenderSystem, queue: *RenderQueue, occlusion: bool, bundled: bool) !void {
+        self.resetBatches();
+        self.occluded.clearRetainingCapacity();
+
+        var frustums: [max_views]Frustum = undefined;
+        frustums[0] = self.camera.getFrustum();
+        var frustum_count: usize = 1;
+        if (self.views.len > 0) {
+            for (self.views, 0..) |camera, index| frustums[index] = camera.getFrustum();
+            frustum_count = self.views.len;
+        }
+
+        if (self.spatial != null and !self.camera_relative) {
+            try self.collectFromSpatial(self.spatial.?, frustums[0..frustum_count], occlusion, bundled);
+        } else {
+            try self.collectLinear(frustums[0..frustum_count], occlusion, bundled);
+        }
+
+        var iter = self.batches.iterator();
+        while (iter.next()) |entry| {
+            const matrices = entry.value_ptr.items;
+            if (matrices.len == 0) continue;
+            const key = entry.key_ptr.*;
+            try queue.pushModelLod(key.model, key.lod, matrices, self.viewDepth(&matrices[0]));
+        }
+    }
+
+    /// Test every renderable against the frustums, keeping it when any of them contains it
+    /// With a Transform-Model group in the registry the two storages are walked side by side
+    fn collectLinear(self: *RenderSystem, frustums: []const Frustum, occlusion: bool, bundled: bool) !void {
+        if (self.registry.getGroup(TransformComponent, ModelComponent)) |group| {
+            for (group.entitySlice(), group.components(TransformComponent), group.components(ModelComponent)) |entity, *transform, *model| {
+                if (!model.visible or model.batched) continue;
+                if (bundled and isBundled(model)) continue;
+
+                const matrix = self.drawMatrix(transform);
+                const bounds = model.model.bounds.transformedAffine(matrix);
+                if (!anyIntersects(frustums, bounds)) continue;
+
+                try self.addToBatch(entity, model.model, matrix, bounds, occlusion and model.occlusion_query);
+            }
+            return;
+        }
+
+        // Persistent query, its entity list is maintained by the registry between frames
+        const query = try self.registry.cachedQuery(Renderable);
+
+        query.reset();
+        while (query.next()) |components| {
+            // Skip if not visible, or drawn by a StaticBatchSystem
+            if (!components.model.visible or components.model.batched) continue;
+            if (bundled and isBundled(components.model)) continue;
+
+            const matrix = self.drawMatrix(components.transform);
+            const bounds = components.model.model.bounds.transformedAffine(matrix);
+            if (!anyIntersects(frustums, bounds)) continue;
+
+            const occluded = occlusion and components.model.occlusion_query;
+            try self.addToBatch(query.lastEntity(), components.model.model, matrix, bounds, occluded);
+        }
+    }
+
+    /// Only visit the entities the spatial tree finds in the frustum, it skips invisible models already
+    /// Several frustums are queried one after the other, entities seen by more than one are visited once
+    fn collectFromSpatial(self: *RenderSystem, spatial: *SpatialSystem, frustums: []const Frustum, occlusion: bool, bundled: bool) !void {
+        const transforms = try self.registry.getComponentStorage(TransformComponent);
+        const models = try self.registry.getComponentStorage(ModelComponent);
+
+        self.visible.clearRetainingCapacity();
+        for (frustums) |*frustum| try spatial.queryFrustum(frustum, &self.visible);
+        if (frustums.len > 1) {
+            std.sort.pdq(EntityId, self.visible.items, {}, entityLessThan);
+            var kept: usize = 0;
+            for (self.visible.items) |entity| {
+                if (kept > 0 and self.visible.items[kept - 1].index == entity.index) continue;
+                self.visible.items[kept] = entity;
+                kept += 1;
+            }
+            self.visible.shrinkRetainingCapacity(kept);
+        }
+
+        for (self.visible.items) |entity| {
+            const transform = transforms.get(entity) orelse continue;
+            const model = models.get(entity) orelse continue;
+            if (model.batched or (bundled and isBundled(model))) continue;
+            const bounds = model.model.bounds.transformedAffine(&transform.render_matrix);
+            try self.addToBatch(entity, model.model, &transform.render_matrix, bounds, occlusion and model.occlusion_query);
+        }
+    }
+
+    /// Record the bundle if it went stale, then draw it unless it is entirely outside the view
+    fn drawBundle(self: *RenderSystem, bundle: *RenderBundle) !void {
+        if (!bundle.valid) {
+            self.bundle_queue.clear();
+            const query = try self.registry.cachedQuery(Renderable);
+            query.reset();
+            while (query.next()) |components| {
+                if (!components.model.visible or components.model.batched or !isBundled(components.model)) continue;
+                try self.bundle_queue.pushModel(components.model.model, &.{self.drawMatrix(components.transform).*}, 0);
+            }
+            try bundle.record(&self.bundle_queue);
+            self.bundle_queue.clear();
+        }
+
+        const bounds = bundle.bounds orelse return;
+        if (!self.camera.getFrustum().intersectsBox(bounds)) return;
+        try self.camera.active_renderer.drawBundle(bundle, &self.camera.view_matrix, &self.camera.projection_matrix);
+    }
+
+    /// Models the bundle can hold: static, a single level, no query, and only opaque instanced materials
+    fn isBundled(model: *const ModelComponent) bool {
+        if (!model.static or model.occlusion_query or model.model.lods.items.len > 0) return false;
+        for (model.model.getLodPairs(0)) |pair| {
+            if (pair.material.color[3] < 1.0 or !pair.material.shader.has(.instanced)) return false;
+        }
+        return true;
+    }
+
+    fn drawMatrix(self: *const RenderSystem, transform: *const TransformComponent) *const Affine3x4 {
+        return if (self.camera_relative) &transform.relative_matrix else &transform.render_matrix;
+    }
+
+    fn anyIntersects(frustums: []const Frustum, bounds: BoundingBox) bool {
+        for (frustums) |*frustum| {
+            if (frustum.intersectsBox(bounds)) return true;
+        }
+        return false;
+    }
+
+    fn entityLessThan(_: void, a: EntityId, b: EntityId) bool {
+        return a.index < b.index;
+    }
+
+    /// `occluded` entities skip the batches and go to `occluded`
+    fn addToBatch(self: *RenderSystem, entity: EntityId, model: *Model, world_matrix: *const Affine3x4, bounds: BoundingBox, occluded: bool) !void {
+        const lod = if (model.lods.items.len == 0) 0 else try self.selectLod(entity, model, bounds);
+        if (self.texture_streamer) |streamer| self.requestTextures(streamer, model, lod, bounds);
+        if (occluded) {
+            try self.occluded.append(.{
+                .entity = entity,
+                .model = model,
+                .lod = lod,
+                .world_matrix = world_matrix.*,
+                .bounds = bounds,
+            });
+            return;
+        }
+        const batch = try self.batches.getOrPut(.{ .model = model, .lod = lod });
+        if (!batch.found_existing) batch.value_ptr.* = std.ArrayList(Affine3x4).init(self.allocator);
+        try batch.value_ptr.append(world_matrix.*);
+    }
+
+    /// Push every occluded entity under its query, creating queries for new ones and deleting unused ones
+    fn updateOcclusionQueries(self: *RenderSystem, queue: *RenderQueue) !void {
+        const eye = self.camera.position;
+        for (self.occluded.items) |draw| {
+            const entry = try self.occlusion_queries.getOrPut(draw.entity);
+            if (!entry.found_existing) {
+                entry.value_ptr.* = .{ .query = 0 };
+                c.glGenQueries(1, &entry.value_ptr.query);
+            }
+            const state = entry.value_ptr;
+
+            // The near plane clips the faces of a box the eye is in, its query would find nothing
+            const margin = draw.bounds.expanded(self.camera.near);
+            const inside = margin.contains(.{ .min = eye, .max = eye });
+            try queue.pushModelOccluded(draw.model, draw.lod, draw.world_matrix, draw.bounds, state.query, state.issued and !inside, self.viewDepth(&draw.world_matrix));
+            state.issued = true;
+            state.used = true;
+        }
+
+        var i = self.occlusion_queries.count();
+        while (i > 0) {
+            i -= 1;
+            const state = &self.occlusion_queries.values()[i];
+            if (state.used) {
+                state.used = false;
+            } else {
+                c.glDeleteQueries(1, &state.query);
+                self.occlusion_queries.swapRemoveAt(i);
+            }
+        }
+    }
+
+    /// Level of detail from the projected size of the world bounds, remembered for the next frame
+    fn selectLod(self: *RenderSystem, entity: EntityId, model: *const Model, bounds: BoundingBox) !u8 {
+        if (entity.index >= self.lods.items.len) {
+            try self.lods.appendNTimes(0, entity.index + 1 - self.lods.items.len);
+        }
+
+        const size = self.camera.screenSize(bounds.center(), bounds.radius());
+        const previous = self.lods.items[entity.index];
+        const lod: u8 = @intCast(@min(model.selectLod(size, previous, self.lod_hysteresis), std.math.maxInt(u8)));
+        self.lods.items[entity.index] = lod;
+        return lod;
+    }
+
+    /// Report the projected size of the entity as the texel demand of each of its textures
+    /// Assumes each texture spans the model once, tiled textures get coarser levels than they could use
+    fn requestTextures(self: *RenderSystem, streamer: *TextureStreamer, model: *const Model, lod: u8, bounds: BoundingBox) void {
+        const pixels = self.camera.screenSize(bounds.center(), bounds.radius()) * self.viewport_height;
+        for (model.getLodPairs(lod)) |pair| {
+            if (pair.material.texture) |texture| streamer.request(texture, pixels);
+        }
+    }
+
+    /// Distance from the camera to a world matrix's origin over the far plane distance
+    fn viewDepth(self: *const RenderSystem, world_matrix: *const Affine3x4) f32 {
+        const dx = world_matrix.data[3] - self.camera.position.x;
+        const dy = world_matrix.data[7] - self.camera.position.y;
+        const dz = world_matrix.data[11] - self.camera.position.z;
+        return @sqrt(dx * dx + dy * dy + dz * dz) / self.camera.far;
+    }
+
+    /// Empty every batch, dropping the ones that stayed empty for a whole frame
+    fn resetBatches(self: *RenderSystem) void {
+        var i = self.batches.count();
+        while (i > 0) {
+            i -= 1;
+            const list = &self.batches.values()[i];
+            if (list.items.len == 0) {
+                list.deinit();
+                self.batches.swapRemoveAt(i);
+            } else {
+                list.clearRetainingCapacity();
+            }
         }
     }
 };
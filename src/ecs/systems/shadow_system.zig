@@ -0,0 +1,121 @@
+// ecs/systems/shadow_system.zig
+const std = @import("std");
+
+const Camera = @import("../../renderer/camera.zig").Camera;
+const Model = @import("../../renderer/model.zig").Model;
+const RenderQueue = @import("../../renderer/render_queue.zig").RenderQueue;
+const ShadowCascades = @import("../../renderer/shadow_cascades.zig").ShadowCascades;
+const Registry = @import("../ecs.zig").Registry;
+const EntityId = @import("../ecs.zig").EntityId;
+const SpatialSystem = @import("spatial_system.zig").SpatialSystem;
+
+const Affine3x4 = @import("../../math/affine.zig").Affine3x4;
+const Vec3f = @import("../../math/vector.zig").Vec3f;
+const Frustum = @import("../../math/bounds.zig").Frustum;
+
+const TransformComponent = @import("../components/transform_component.zig").TransformComponent;
+const ModelComponent = @import("../components/model_component.zig").ModelComponent;
+
+pub const ShadowSystem = struct {
+    const Caster = struct {
+        transform: *const TransformComponent,
+        model: *const ModelComponent,
+    };
+
+    const BatchKey = struct {
+        model: *Model,
+        lod: u8,
+    };
+
+    allocator: std.mem.Allocator,
+    registry: *Registry,
+    camera: *Camera,
+    shadows: *ShadowCascades,
+
+    /// World matrices of the casters of the cascade being drawn, lists are reused between cascades
+    batches: std.AutoArrayHashMap(BatchKey, std.ArrayList(Affine3x4)),
+    queue: RenderQueue,
+    /// Culls casters through the tree instead of testing every entity when set, update it before this system
+    spatial: ?*SpatialSystem = null,
+    /// Entities the spatial query returned for the current cascade
+    casters: std.ArrayList(EntityId),
+
+    pub fn init(allocator: std.mem.Allocator, registry: *Registry, camera: *Camera, shadows: *ShadowCascades) ShadowSystem {
+        return .{
+            .allocator = allocator,
+            .registry = registry,
+            .camera = camera,
+            .shadows = shadows,
+            .batches = std.AutoArrayHashMap(BatchKey, std.ArrayList(Affine3x4)).init(allocator),
+            .queue = RenderQueue.init(allocator),
+            .casters = std.ArrayList(EntityId).init(allocator),
+        };
+    }
+
+    /// Fit the cascades to the camera and render the ones that are due, before the passes sampling them
+    /// Casters are culled against each cascade's light volume, which reaches caster_distance toward the light
+    /// Models with LOD levels draw one level coarser per cascade, the distant cascades need little detail
+    pub fn update(self: *ShadowSystem, light_direction: Vec3f) !void {
+        self.shadows.fit(self.camera, light_direction);
+        defer self.shadows.finish();
+
+        const renderer = self.camera.active_renderer;
+        for (self.shadows.cascadeSlice(), 0..) |*cascade, index| {
+            if (!cascade.needs_render) continue;
+
+            self.queue.clear();
+            try self.collect(&cascade.frustum, @intCast(index));
+
+            self.shadows.beginCascade(index);
+            defer self.shadows.endCascade(index);
+            try renderer.drawShadowCasters(&self.queue, &cascade.view, &cascade.projection);
+        }
+    }
+
+    pub fn deinit(self: *ShadowSystem) void {
+        for (self.batches.values()) |*list| list.deinit();
+        self.batches.deinit();
+        self.queue.deinit();
+        self.casters.deinit();
+    }
+
+    fn collect(self: *ShadowSystem, frustum: *const Frustum, cascade: u8) !void {
+        for (self.batches.values()) |*list| list.clearRetainingCapacity();
+
+        if (self.spatial) |spatial| {
+            const transforms = try self.registry.getComponentStorage(TransformComponent);
+            const models = try self.registry.getComponentStorage(ModelComponent);
+
+            self.casters.clearRetainingCapacity();
+            try spatial.queryFrustum(frustum, &self.casters);
+            for (self.casters.items) |entity| {
+                const transform = transforms.get(entity) orelse continue;
+                const model = models.get(entity) orelse continue;
+                try self.addToBatch(model.model, &transform.render_matrix, cascade);
+            }
+        } else {
+            const query = try self.registry.cachedQuery(Caster);
+            query.reset();
+            while (query.next()) |components| {
+                if (!components.model.visible) continue;
+                const bounds = components.model.model.bounds.transformedAffine(&components.transform.render_matrix);
+                if (!frustum.intersectsBox(bounds)) continue;
+                try self.addToBatch(components.model.model, &components.transform.render_matrix, cascade);
+            }
+        }
+
+        var iter = self.batches.iterator();
+        while (iter.next()) |entry| {
+            const matrices = entry.value_ptr.items;
+            if (matrices.len == 0) continue;
+            try self.queue.pushModelLod(entry.key_ptr.model, entry.key_ptr.lod, matrices, 0.0);
+        }
+    }
+
+    fn addToBatch(self: *ShadowSystem, model: *Model, world_matrix: *const Affine3x4, cascade: u8) !void {
+        const lod: u8 = @intCast(@min(cascade, model.lods.items.len));
+        const batch = try self.batches.getOrPut(.{ .model = model, .lod = lod });
+        if (!batch.found_existing) batch.value_ptr.* = std.ArrayList(Affine3x4).init(self.allocator);
+        try batch.value_ptr.append(world_matrix.*);
+    }
+};
@@ -0,0 +1,298 @@
+// ecs/systems/spatial_system.zig
+const std = @import("std");
+
+const Registry = @import("../ecs.zig").Registry;
+const EntityId = @import("../ecs.zig").EntityId;
+
+const AabbTree = @import("../../math/aabb_tree.zig").AabbTree;
+const bounds = @import("../../math/bounds.zig");
+const BoundingBox = bounds.BoundingBox;
+const Frustum = bounds.Frustum;
+const Ray = bounds.Ray;
+const Vec3f = @import("../../math/vector.zig").Vec3f;
+const Affine3x4 = @import("../../math/affine.zig").Affine3x4;
+const Model = @import("../../renderer/model.zig").Model;
+const Mesh = @import("../../renderer/mesh.zig").Mesh;
+
+const TransformComponent = @import("../components/transform_component.zig").TransformComponent;
+const ModelComponent = @import("../components/model_component.zig").ModelComponent;
+
+/// Keeps the world bounds of every visible model entity in an AABB tree
+/// Serves frustum culling, picking and overlap queries without touching every entity
+pub const SpatialSystem = struct {
+    const no_proxy = std.math.maxInt(u32);
+
+    /// Default fattening of tree leaves in world units, movement within it costs no reinsert
+    pub const default_margin: f32 = 0.5;
+
+    const TreeHit = AabbTree(EntityId).RayHit;
+
+    /// Closest entity hit by a ray
+    pub const RayHit = struct {
+        entity: EntityId,
+        distance: f32,
+        /// Mesh and triangle pick hit, null for box hits and meshes with neither a picking BVH nor a CPU copy
+        mesh: ?*Mesh = null,
+        triangle: u32 = 0,
+    };
+
+    allocator: std.mem.Allocator,
+    registry: *Registry,
+
+    tree: AabbTree(EntityId),
+    /// Tree proxy of each entity index, `no_proxy` if the entity is not in the tree
+    proxies: std.ArrayList(u32),
+    /// Proxy scratch list for the queries
+    results: std.ArrayList(u32),
+    /// Box hit scratch list for pick
+    ray_hits: std.ArrayList(TreeHit),
+    /// Tick returned by the last update, writes stamped after it are synced by the next one
+    last_tick: u32 = 0,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, registry: *Registry, margin: f32) !SpatialSystem {
+        try registry.registerComponent(TransformComponent);
+        try registry.registerComponent(ModelComponent);
+
+        return .{
+            .allocator = allocator,
+            .registry = registry,
+            .tree = AabbTree(EntityId).init(allocator, margin),
+            .proxies = std.ArrayList(u32).init(allocator),
+            .results = std.ArrayList(u32).init(allocator),
+            .ray_hits = std.ArrayList(TreeHit).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Bring the tree up to date, run after TransformSystem.update
+    /// Only transforms and model components written since the last update are visited,
+    /// found by a linear scan of their changed ticks
+    pub fn update(self: *SpatialSystem) !void {
+        const since = self.last_tick;
+        self.last_tick = self.registry.advanceTick();
+
+        const transforms = try self.registry.getComponentStorage(TransformComponent);
+        const models = try self.registry.getComponentStorage(ModelComponent);
+
+        // New components are stamped changed when added, so additions are found here as well
+        for (transforms.changedTickSlice(), transforms.entitySlice()) |tick, entity| {
+            if (tick > since) try self.sync(entity);
+        }
+        for (models.changedTickSlice(), models.entitySlice()) |tick, entity| {
+            if (tick > since) try self.sync(entity);
+        }
+    }
+
+
+    /// Drop an entity right away, e.g. before destroying it mid-frame
+    pub fn remove(self: *SpatialSystem, entity: EntityId) void {
+        const proxy = self.proxyOf(entity) orelse return;
+        self.removeProxy(proxy);
+    }
+
+
+    /// Append every entity whose bounds may be visible through `frustum`
+    pub fn queryFrustum(self: *SpatialSystem, frustum: *const Frustum, out: *std.ArrayList(EntityId)) !void {
+        self.results.clearRetainingCapacity();
+        try self.tree.queryFrustum(frustum, &self.results);
+        try self.collect(out);
+    }
+
+
+    /// Append every entity whose bounds overlap `box`
+    pub fn queryBox(self: *SpatialSystem, box: BoundingBox, out: *std.ArrayList(EntityId)) !void {
+        self.results.clearRetainingCapacity();
+        try self.tree.queryBox(box, &self.results);
+        try self.collect(out);
+    }
+
+
+    /// Append every entity whose bounds overlap the sphere
+    pub fn querySphere(self: *SpatialSystem, center: Vec3f, radius: f32, out: *std.ArrayList(EntityId)) !void {
+        self.results.clearRetainingCapacity();
+        try self.tree.querySphere(center, radius, &self.results);
+        try self.collect(out);
+    }
+
+
+    /// Closest entity whose bounds `ray` hits within `max_distance`
+    pub fn raycast(self: *SpatialSystem, ray: Ray, max_distance: f32) !?RayHit {
+        while (try self.tree.raycast(ray, max_distance)) |hit| {
+            if (self.isTracked(hit.data)) return .{ .entity = hit.data, .distance = hit.distance };
+
+            // Drop the stale leaf so the next cast can find what lies behind it
+            self.removeProxy(hit.proxy);
+        }
+        return null;
+    }
+
+
+    /// Closest entity `ray` hits within `max_distance`, exact to the triangle for meshes with a picking BVH or CPU copy
+    /// Boxes are visited by entry distance and the walk stops at the first one starting beyond the closest hit,
+    /// meshes without a BVH count as hit where the ray enters their bounds
+    pub fn pick(self: *SpatialSystem, ray: Ray, max_distance: f32) !?RayHit {
+        const transforms = try self.registry.getComponentStorage(TransformComponent);
+        const models = try self.registry.getComponentStorage(ModelComponent);
+
+        self.ray_hits.clearRetainingCapacity();
+        try self.tree.queryRay(ray, max_distance, &self.ray_hits);
+        std.sort.pdq(TreeHit, self.ray_hits.items, {}, isCloser);
+
+        var best: ?RayHit = null;
+        var limit = max_distance;
+        for (self.ray_hits.items) |candidate| {
+            if (candidate.distance >= limit) break;
+            const entity = candidate.data;
+            if (!self.isTracked(entity)) {
+                self.removeProxy(candidate.proxy);
+                continue;
+            }
+
+            const world = &transforms.get(entity).?.world_matrix;
+            if (try pickModel(models.get(entity).?.model, world, ray, limit)) |hit| {
+                best = .{ .entity = entity, .distance = hit.distance, .mesh = hit.mesh, .triangle = hit.triangle };
+                limit = hit.distance;
+            }
+        }
+        return best;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *SpatialSystem) void {
+        self.tree.deinit();
+        self.proxies.deinit();
+        self.results.deinit();
+        self.ray_hits.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Insert, move or remove the leaf of one entity to match its components
+    fn sync(self: *SpatialSystem, entity: EntityId) !void {
+        const transforms = try self.registry.getComponentStorage(TransformComponent);
+        const models = try self.registry.getComponentStorage(ModelComponent);
+
+        // A proxy left behind by an earlier entity with the same index is dropped first
+        if (self.proxyAt(entity.index)) |proxy| {
+            const owner = self.tree.getData(proxy);
+            if (owner.generation != entity.generation) self.removeProxy(proxy);
+        }
+
+        const transform = transforms.get(entity);
+        const model = models.get(entity);
+        if (transform == null or model == null or !model.?.visible) {
+            self.remove(entity);
+            return;
+        }
+
+        const box = model.?.model.bounds.transformedAffine(&transform.?.world_matrix);
+        if (self.proxyOf(entity)) |proxy| {
+            _ = try self.tree.move(proxy, box);
+            return;
+        }
+
+        if (entity.index >= self.proxies.items.len) {
+            try self.proxies.appendNTimes(no_proxy, entity.index + 1 - self.proxies.items.len);
+        }
+        self.proxies.items[entity.index] = try self.tree.insert(box, entity);
+    }
+
+
+    /// Translate `results` to entities, dropping proxies whose entity no longer qualifies
+    fn collect(self: *SpatialSystem, out: *std.ArrayList(EntityId)) !void {
+        try out.ensureUnusedCapacity(self.results.items.len);
+        for (self.results.items) |proxy| {
+            const entity = self.tree.getData(proxy);
+            if (self.isTracked(entity)) {
+                out.appendAssumeCapacity(entity);
+            } else {
+                self.removeProxy(proxy);
+            }
+        }
+    }
+
+
+    /// Entity is alive and still has both components, destruction and removal are only noticed here
+    fn isTracked(self: *SpatialSystem, entity: EntityId) bool {
+        if (!self.registry.isValidEntity(entity)) return false;
+        const transforms = self.registry.getComponentStorage(TransformComponent) catch return false;
+        const models = self.registry.getComponentStorage(ModelComponent) catch return false;
+        return transforms.contains(entity) and models.contains(entity);
+    }
+
+
+    fn isCloser(_: void, a: TreeHit, b: TreeHit) bool {
+        return a.distance < b.distance;
+    }
+
+
+    const MeshHit = struct {
+        distance: f32,
+        mesh: ?*Mesh,
+        triangle: u32,
+    };
+
+
+    /// Closest mesh of a model hit nearer than `limit`, the ray is cast in model space
+    /// World matrices are affine, so model-space distances are world distances times one scale along the ray
+    /// Retained meshes build their picking BVH here on the first pick after an update
+    fn pickModel(model: *const Model, world: *const Affine3x4, ray: Ray, limit: f32) !?MeshHit {
+        const inverse = world.inverse() orelse return null;
+        const local_direction = inverse.transformDirection(ray.direction);
+        const scale = local_direction.length();
+        if (scale == 0.0) return null;
+        const local_ray = Ray.init(inverse.transformPoint(ray.origin), local_direction);
+
+        var best: ?MeshHit = null;
+        var local_limit = limit * scale;
+        for (model.pairs.items) |pair| {
+            const mesh = pair.mesh;
+            if (try mesh.pickingBvh()) |bvh| {
+                const hit = bvh.raycast(local_ray, local_limit) orelse continue;
+                best = .{ .distance = hit.distance / scale, .mesh = mesh, .triangle = hit.triangle };
+                local_limit = hit.distance;
+            } else {
+                const distance = mesh.bounds.intersectRay(local_ray, local_limit) orelse continue;
+                best = .{ .distance = distance / scale, .mesh = null, .triangle = 0 };
+                local_limit = distance;
+            }
+        }
+        return best;
+    }
+
+
+    fn proxyAt(self: *const SpatialSystem, index: u32) ?u32 {
+        if (index >= self.proxies.items.len) return null;
+        const proxy = self.proxies.items[index];
+        return if (proxy == no_proxy) null else proxy;
+    }
+
+
+    fn proxyOf(self: *const SpatialSystem, entity: EntityId) ?u32 {
+        const proxy = self.proxyAt(entity.index) orelse return null;
+        return if (self.tree.getData(proxy).generation == entity.generation) proxy else null;
+    }
+
+
+    fn removeProxy(self: *SpatialSystem, proxy: u32) void {
+        const entity = self.tree.getData(proxy);
+        if (self.proxyAt(entity.index) == proxy) self.proxies.items[entity.index] = no_proxy;
+        self.tree.remove(proxy);
+    }
+};
@@ -0,0 +1,317 @@
+// ecs/systems/static_batch_system.zig
+const std = @import("std");
+
+const Camera = @import("../../renderer/camera.zig").Camera;
+const Mesh = @import("../../renderer/mesh.zig").Mesh;
+const MeshData = @import("../../renderer/mesh.zig").MeshData;
+const IndexRange = @import("../../renderer/mesh.zig").IndexRange;
+const getFloatsPerVertex = @import("../../renderer/mesh.zig").getFloatsPerVertex;
+const Material = @import("../../renderer/material.zig").Material;
+const Registry = @import("../ecs.zig").Registry;
+
+const Vec3f = @import("../../math/vector.zig").Vec3f;
+const Affine3x4 = @import("../../math/affine.zig").Affine3x4;
+const bounds = @import("../../math/bounds.zig");
+const BoundingBox = bounds.BoundingBox;
+
+const TransformComponent = @import("../components/transform_component.zig").TransformComponent;
+const ModelComponent = @import("../components/model_component.zig").ModelComponent;
+
+/// Merges the meshes of entities whose ModelComponent is `static` into one mesh per material and
+/// vertex layout, with their world matrices baked into the vertices
+/// Each merged mesh is split into chunks of the geometry in one grid cell, the chunks in view are
+/// drawn with one call per run of consecutive chunks
+pub const StaticBatchSystem = struct {
+    const Self = @This();
+
+    /// Default edge length of the grid cells geometry is chunked by, in world units
+    pub const default_cell_size: f32 = 32.0;
+
+    const Renderable = struct {
+        transform: *const TransformComponent,
+        model: *ModelComponent,
+    };
+
+    /// Meshes can only be merged when they share the material and the vertex layout
+    const BatchKey = struct {
+        material: *Material,
+        package_size: u4,
+    };
+
+    /// One mesh-material pair of a static entity, waiting to be merged
+    const Source = struct {
+        batch: u32,
+        cell: [3]i32,
+        mesh: *Mesh,
+        world: Affine3x4,
+
+        fn lessThan(_: void, a: Source, b: Source) bool {
+            if (a.batch != b.batch) return a.batch < b.batch;
+            for (a.cell, b.cell) |ca, cb| {
+                if (ca != cb) return ca < cb;
+            }
+            return false;
+        }
+    };
+
+    const Batch = struct {
+        mesh: *Mesh,
+        material: *Material,
+        /// Index ranges of the grid cells, in index buffer order
+        chunks: std.ArrayList(IndexRange),
+        /// World bounds of every chunk
+        chunk_bounds: std.ArrayList(BoundingBox),
+    };
+
+    allocator: std.mem.Allocator,
+    registry: *Registry,
+    camera: *Camera,
+
+    batches: std.ArrayList(Batch),
+    /// Edge length of the culling cells, set before build
+    cell_size: f32 = default_cell_size,
+    /// Visibility mask of the chunks of the batch being drawn, reused between frames
+    visible: std.ArrayList(u64),
+    /// Visible chunks with neighbours joined, reused between frames
+    ranges: std.ArrayList(IndexRange),
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, registry: *Registry, camera: *Camera) Self {
+        return .{
+            .allocator = allocator,
+            .registry = registry,
+            .camera = camera,
+            .batches = std.ArrayList(Batch).init(allocator),
+            .visible = std.ArrayList(u64).init(allocator),
+            .ranges = std.ArrayList(IndexRange).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Merge every static entity not batched yet, run once after loading a level and TransformSystem.update
+    /// Merged entities are marked `batched` and skipped by RenderSystem, moving them later has no visible effect
+    /// Only full detail is merged. Entities with skinned or compact meshes stay as they are, their data can't be read back
+    pub fn build(self: *Self) !void {
+        var sources = std.ArrayList(Source).init(self.allocator);
+        defer sources.deinit();
+        var keys = std.AutoArrayHashMap(BatchKey, u32).init(self.allocator);
+        defer keys.deinit();
+        var merged = std.ArrayList(*ModelComponent).init(self.allocator);
+        defer merged.deinit();
+
+        var query = try self.registry.query(Renderable);
+        while (try query.next()) |components| {
+            const model = components.model;
+            if (!model.static or model.batched or !canMerge(model)) continue;
+
+            const world = &components.transform.world_matrix;
+            for (model.model.pairs.items) |pair| {
+                const key = try keys.getOrPut(.{ .material = pair.material, .package_size = pair.mesh.package_size });
+                if (!key.found_existing) key.value_ptr.* = @intCast(keys.count() - 1);
+
+                const center = pair.mesh.bounds.transformedAffine(world).center();
+                try sources.append(.{
+                    .batch = key.value_ptr.*,
+                    .cell = .{ self.cellOf(center.x), self.cellOf(center.y), self.cellOf(center.z) },
+                    .mesh = pair.mesh,
+                    .world = world.*,
+                });
+            }
+            try merged.append(model);
+        }
+        if (sources.items.len == 0) return;
+
+        // Grouped by batch, and within one by cell so every chunk is a single index range
+        std.mem.sort(Source, sources.items, {}, Source.lessThan);
+
+        // Shared meshes are read back once
+        var cache = std.AutoHashMap(*Mesh, MeshData).init(self.allocator);
+        defer {
+            var iter = cache.valueIterator();
+            while (iter.next()) |data| data.deinit();
+            cache.deinit();
+        }
+
+        var start: usize = 0;
+        while (start < sources.items.len) {
+            var end = start + 1;
+            while (end < sources.items.len and sources.items[end].batch == sources.items[start].batch) end += 1;
+
+            try self.appendBatch(keys.keys()[sources.items[start].batch], sources.items[start..end], &cache);
+            start = end;
+        }
+
+        for (merged.items) |model| model.batched = true;
+    }
+
+
+    /// Draw the chunks in the camera frustum, call next to RenderSystem.update
+    pub fn update(self: *Self) !void {
+        const frustum = self.camera.getFrustum();
+
+        for (self.batches.items) |*batch| {
+            try self.visible.resize(bounds.maskWords(batch.chunks.items.len));
+            if (frustum.cullBoxes(batch.chunk_bounds.items, self.visible.items) == 0) continue;
+
+            self.ranges.clearRetainingCapacity();
+            for (batch.chunks.items, 0..) |chunk, i| {
+                if (!bounds.maskIsSet(self.visible.items, i)) continue;
+
+                if (self.ranges.items.len > 0) {
+                    const last = &self.ranges.items[self.ranges.items.len - 1];
+                    if (last.first + last.count == chunk.first) {
+                        last.count += chunk.count;
+                        continue;
+                    }
+                }
+                try self.ranges.append(chunk);
+            }
+            try self.camera.drawMeshRanges(batch.mesh, batch.material, self.ranges.items);
+        }
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Free the merged meshes, entities stay marked `batched`
+    pub fn deinit(self: *Self) void {
+        for (self.batches.items) |*batch| {
+            _ = batch.mesh.release();
+            _ = batch.material.release();
+            batch.chunks.deinit();
+            batch.chunk_bounds.deinit();
+        }
+        self.batches.deinit();
+        self.visible.deinit();
+        self.ranges.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn canMerge(model: *const ModelComponent) bool {
+        for (model.model.pairs.items) |pair| {
+            if (pair.mesh.vertex_format != .float or pair.mesh.skin_vbo != 0) return false;
+        }
+        return model.model.pairs.items.len > 0;
+    }
+
+
+    fn cellOf(self: *const Self, coordinate: f32) i32 {
+        return @intFromFloat(std.math.clamp(@floor(coordinate / self.cell_size), -1e9, 1e9));
+    }
+
+
+    /// Bake the sources of one batch into world space and upload them as one mesh
+    fn appendBatch(self: *Self, key: BatchKey, sources: []const Source, cache: *std.AutoHashMap(*Mesh, MeshData)) !void {
+        const floats_per_vertex = getFloatsPerVertex(key.package_size);
+        // Package sizes 6 and 8 carry a normal right after the position
+        const has_normal = key.package_size == 6 or key.package_size == 8;
+
+        var vertices = std.ArrayList(f32).init(self.allocator);
+        defer vertices.deinit();
+        var indices = std.ArrayList(u32).init(self.allocator);
+        defer indices.deinit();
+
+        var chunks = std.ArrayList(IndexRange).init(self.allocator);
+        errdefer chunks.deinit();
+        var chunk_bounds = std.ArrayList(BoundingBox).init(self.allocator);
+        errdefer chunk_bounds.deinit();
+
+        for (sources, 0..) |*source, i| {
+            const cached = try cache.getOrPut(source.mesh);
+            if (!cached.found_existing) {
+                cached.value_ptr.* = source.mesh.readBack(self.allocator) catch |e| {
+                    cache.removeByPtr(cached.key_ptr);
+                    return e;
+                };
+            }
+            const data = cached.value_ptr;
+
+            const new_chunk = i == 0 or !std.mem.eql(i32, &source.cell, &sources[i - 1].cell);
+            if (new_chunk) {
+                try chunks.append(.{ .first = @intCast(indices.items.len), .count = 0 });
+                try chunk_bounds.append(BoundingBox.empty);
+            }
+
+            // Normals go through the inverse transpose so non-uniform scales keep them perpendicular
+            const inverse = source.world.inverse() orelse source.world;
+            const base: u32 = @intCast(vertices.items.len / floats_per_vertex);
+            const first_new = vertices.items.len;
+            try vertices.appendSlice(data.vertices);
+
+            var v = first_new;
+            while (v < vertices.items.len) : (v += floats_per_vertex) {
+                const vertex = vertices.items[v..][0..floats_per_vertex];
+                const position = source.world.transformPoint(.{ .x = vertex[0], .y = vertex[1], .z = vertex[2] });
+                vertex[0..3].* = .{ position.x, position.y, position.z };
+
+                if (has_normal) {
+                    const normal = transformNormal(&inverse, .{ .x = vertex[3], .y = vertex[4], .z = vertex[5] });
+                    vertex[3..6].* = .{ normal.x, normal.y, normal.z };
+                }
+            }
+
+            // A mirroring matrix turns the triangles inside out, swap two corners to keep them front facing
+            const mirrored = determinant(&source.world) < 0;
+            const first_index = indices.items.len;
+            try indices.ensureUnusedCapacity(data.indices.len);
+            for (data.indices) |index| indices.appendAssumeCapacity(base + index);
+            if (mirrored) {
+                var t = first_index;
+                while (t + 3 <= indices.items.len) : (t += 3) {
+                    std.mem.swap(u32, &indices.items[t + 1], &indices.items[t + 2]);
+                }
+            }
+
+            const chunk = &chunks.items[chunks.items.len - 1];
+            chunk.count += @intCast(data.indices.len);
+            const chunk_box = &chunk_bounds.items[chunk_bounds.items.len - 1];
+            chunk_box.* = chunk_box.merge(source.mesh.bounds.transformedAffine(&source.world));
+        }
+
+        const mesh = try Mesh.create(self.allocator, vertices.items, indices.items, key.package_size);
+        errdefer _ = mesh.release();
+
+        key.material.addRef();
+        errdefer _ = key.material.release();
+        try self.batches.append(.{
+            .mesh = mesh,
+            .material = key.material,
+            .chunks = chunks,
+            .chunk_bounds = chunk_bounds,
+        });
+    }
+
+
+    /// transpose(inverse) * normal, from the rows of the already inverted matrix
+    fn transformNormal(inverse: *const Affine3x4, normal: Vec3f) Vec3f {
+        const m = &inverse.data;
+        const result = Vec3f{
+            .x = m[0] * normal.x + m[4] * normal.y + m[8] * normal.z,
+            .y = m[1] * normal.x + m[5] * normal.y + m[9] * normal.z,
+            .z = m[2] * normal.x + m[6] * normal.y + m[10] * normal.z,
+        };
+        return result.normalize();
+    }
+
+
+    fn determinant(world: *const Affine3x4) f32 {
+        const m = &world.data;
+        return m[0] * (m[5] * m[10] - m[6] * m[9]) -
+            m[1] * (m[4] * m[10] - m[6] * m[8]) +
+            m[2] * (m[4] * m[9] - m[5] * m[8]);
+    }
+};
@@ -0,0 +1,487 @@
+// ecs/systems/transform_system.zig
+const std = @import("std");
+
+const Registry = @import("../ecs.zig").Registry;
+const EntityId = @import("../ecs.zig").EntityId;
+
+const TransformComponent = @import("../components/transform_component.zig").TransformComponent;
+const ParentComponent = @import("../components/parent_component.zig").ParentComponent;
+const Affine3x4 = @import("../../math/affine.zig").Affine3x4;
+const Vec3d = @import("../../math/vector.zig").Vec3d;
+const JobSystem = @import("../../core/jobs.zig").JobSystem;
+
+/// Keeps the TransformComponent storage sorted depth-first so every parent comes before its
+/// children, then propagates world matrices in one linear pass
+/// While a group owns the storage its order is the group's, the pass then follows a separate parents-first order
+/// When most of a large hierarchy changed, the pass instead runs level by level through the
+/// batched hierarchy kernel, splitting wide levels across `jobs` if set
+pub const TransformSystem = struct {
+    const no_parent = std.math.maxInt(u32);
+    /// Fewer transforms than this always take the incremental pass, gathering them costs more than it saves
+    const bulk_min_count = 1024;
+    /// Transforms per job when a level is split across the job system
+    const level_chunk = 4096;
+
+    allocator: std.mem.Allocator,
+    registry: *Registry,
+
+    /// Entity in each storage slot at the last sort, used to detect adds, removes and swaps
+    sorted_entities: std.ArrayList(EntityId),
+    /// Storage slot of each slot's parent, `no_parent` for roots
+    parent_slots: std.ArrayList(u32),
+    /// Slots parents first when a group owns the storage and it can't be sorted, empty while it is sorted
+    walk_order: std.ArrayList(u32),
+    /// Slots whose world matrix was rebuilt during the current update
+    changed: std.DynamicBitSetUnmanaged = .{},
+    /// Slots whose render matrix was blended during the current interpolate
+    blended: std.DynamicBitSetUnmanaged = .{},
+    /// ParentComponent count at the last sort
+    parent_count: usize = 0,
+    /// Set by setParent/clearParent to force a sort on the next update
+    needs_sort: bool = true,
+    /// Optional pool for the bulk propagation, levels wider than two chunks are split across it
+    jobs: ?*JobSystem = null,
+
+    /// Slots in breadth-first order, so every level of the hierarchy is one contiguous run
+    level_order: std.ArrayList(u32),
+    /// Position in level_order of each entry's parent, -1 for roots
+    level_parents: std.ArrayList(i32),
+    /// Start of every level in level_order, followed by the total count
+    level_starts: std.ArrayList(u32),
+    /// Local and world matrices gathered in level order for the bulk propagation
+    bulk_locals: std.ArrayList(Affine3x4),
+    bulk_worlds: std.ArrayList(Affine3x4),
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, registry: *Registry) !TransformSystem {
+        try registry.registerComponent(TransformComponent);
+        try registry.registerComponent(ParentComponent);
+
+        return .{
+            .allocator = allocator,
+            .registry = registry,
+            .sorted_entities = std.ArrayList(EntityId).init(allocator),
+            .parent_slots = std.ArrayList(u32).init(allocator),
+            .walk_order = std.ArrayList(u32).init(allocator),
+            .level_order = std.ArrayList(u32).init(allocator),
+            .level_parents = std.ArrayList(i32).init(allocator),
+            .level_starts = std.ArrayList(u32).init(allocator),
+            .bulk_locals = std.ArrayList(Affine3x4).init(allocator),
+            .bulk_worlds = std.ArrayList(Affine3x4).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Attach `child` to `parent`, the child's transform becomes relative to the parent's
+    pub fn setParent(self: *TransformSystem, child: EntityId, parent: EntityId) !void {
+        if (self.registry.getComponent(child, ParentComponent)) |component| {
+            component.parent = parent;
+        } else {
+            try self.registry.addComponent(child, ParentComponent{ .parent = parent });
+        }
+        self.markChildMoved(child);
+    }
+
+
+    /// Detach `child` from its parent, making it a root
+    pub fn clearParent(self: *TransformSystem, child: EntityId) !void {
+        try self.registry.removeComponent(child, ParentComponent);
+        self.markChildMoved(child);
+    }
+
+
+    /// Rebuild dirty local matrices and propagate world matrices to changed subtrees
+    /// Run once per frame, after gameplay updates and before rendering
+    pub fn update(self: *TransformSystem) !void {
+        const transforms = try self.registry.getComponentStorage(TransformComponent);
+        const parents = try self.registry.getComponentStorage(ParentComponent);
+
+        if (self.needs_sort or self.orderChanged(transforms.entitySlice(), parents.len())) {
+            try self.sort();
+        }
+
+        const items = transforms.componentSlice();
+        try self.changed.resize(self.allocator, items.len, false);
+        self.changed.unsetAll();
+
+        // Local matrices first, `changed` then marks the slots whose world matrix has to be rebuilt
+        var dirty_count: usize = 0;
+        for (items, 0..) |*transform, slot| {
+            if (!transform.dirty) continue;
+            transform.local_matrix = transform.toMatrix();
+            transform.dirty = false;
+            self.changed.set(slot);
+            dirty_count += 1;
+        }
+
+        // After a sort or a mass move nearly every world matrix changes, rebuild them all in one go
+        if (items.len >= bulk_min_count and dirty_count * 2 >= items.len) {
+            try self.propagateAll(items);
+            self.changed.setRangeValue(.{ .start = 0, .end = items.len }, true);
+            for (0..items.len) |slot| {
+                transforms.markChanged(@intCast(slot));
+            }
+            return;
+        }
+
+        // Parents are always walked first, so their world matrix is final when a child is reached
+        for (0..items.len) |step| {
+            const slot = self.walkSlot(step);
+            const transform = &items[slot];
+            const parent_slot = self.parent_slots.items[slot];
+            const has_parent = parent_slot != no_parent;
+            const parent_changed = has_parent and self.changed.isSet(parent_slot);
+
+            if (!self.changed.isSet(slot) and !parent_changed) continue;
+
+            if (has_parent) {
+                transform.world_matrix.multiplyInto(&items[parent_slot].world_matrix, &transform.local_matrix);
+                transform.world_origin = items[parent_slot].world_origin;
+            } else {
+                transform.world_matrix = transform.local_matrix;
+                transform.world_origin = transform.origin;
+            }
+            transform.render_matrix = transform.world_matrix;
+            self.changed.set(slot);
+            transforms.markChanged(@intCast(slot));
+        }
+    }
+
+
+    /// Store every transform's state as the start of a fixed simulation step, call before the step runs
+    pub fn beginFixedStep(self: *TransformSystem) !void {
+        const transforms = try self.registry.getComponentStorage(TransformComponent);
+        for (transforms.componentSlice()) |*transform| {
+            transform.storePrevious();
+        }
+    }
+
+
+    /// Blend render matrices `alpha` of the way from the state at the last beginFixedStep to the
+    /// current one, children on top of their parent's blended matrix. Run after update, with
+    /// Time.getFixedAlpha, so the simulation can step slower than the display refreshes
+    /// Transforms that didn't move during the step, anywhere up their hierarchy, keep their world matrix
+    pub fn interpolate(self: *TransformSystem, alpha: f32) !void {
+        const transforms = try self.registry.getComponentStorage(TransformComponent);
+        const parents = try self.registry.getComponentStorage(ParentComponent);
+
+        // The parent slots have to describe the current order
+        if (self.needs_sort or self.orderChanged(transforms.entitySlice(), parents.len())) {
+            try self.update();
+        }
+
+        const items = transforms.componentSlice();
+        try self.blended.resize(self.allocator, items.len, false);
+        self.blended.unsetAll();
+
+        for (0..items.len) |step| {
+            const slot = self.walkSlot(step);
+            const transform = &items[slot];
+            const parent_slot = self.parent_slots.items[slot];
+            const has_parent = parent_slot != no_parent;
+            const parent_blended = has_parent and self.blended.isSet(parent_slot);
+
+            if (!transform.isMoving() and !parent_blended) {
+                transform.render_matrix = transform.world_matrix;
+                continue;
+            }
+
+            const local = transform.interpolatedLocal(alpha);
+            if (has_parent) {
+                transform.render_matrix.multiplyInto(&items[parent_slot].render_matrix, &local);
+            } else {
+                transform.render_matrix = local;
+            }
+            self.blended.set(slot);
+        }
+    }
+
+
+    /// Write every relative_matrix: the render matrix with its translation moved from its world origin to
+    /// `camera_origin`, e.g. Camera.origin. The origins are subtracted in f64 before rounding, so objects near
+    /// the camera stay precise anywhere in a large world without shifting it. Run after update and interpolate,
+    /// before a RenderSystem with camera_relative set. Split across `jobs` for large counts
+    pub fn updateCameraRelative(self: *TransformSystem, camera_origin: Vec3d) !void {
+        const transforms = try self.registry.getComponentStorage(TransformComponent);
+        const items = transforms.componentSlice();
+        const pass = RelativePass{ .items = items, .camera_origin = camera_origin };
+        if (self.jobs) |jobs| {
+            if (items.len >= 2 * level_chunk) return jobs.parallelFor(items.len, level_chunk, &pass, RelativePass.run);
+        }
+        pass.run(0, items.len);
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *TransformSystem) void {
+        self.sorted_entities.deinit();
+        self.parent_slots.deinit();
+        self.walk_order.deinit();
+        self.level_order.deinit();
+        self.level_parents.deinit();
+        self.level_starts.deinit();
+        self.bulk_locals.deinit();
+        self.bulk_worlds.deinit();
+        self.changed.deinit(self.allocator);
+        self.blended.deinit(self.allocator);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn markChildMoved(self: *TransformSystem, child: EntityId) void {
+        self.needs_sort = true;
+        if (self.registry.getComponent(child, TransformComponent)) |transform| {
+            transform.markDirty();
+        }
+    }
+
+
+    /// Slot visited at `step` of a parents-first walk
+    inline fn walkSlot(self: *const TransformSystem, step: usize) usize {
+        return if (self.walk_order.items.len == 0) step else self.walk_order.items[step];
+    }
+
+
+    /// True when the storage no longer matches the order from the last sort
+    fn orderChanged(self: *TransformSystem, entities: []const EntityId, parent_count: usize) bool {
+        if (entities.len != self.sorted_entities.items.len or parent_count != self.parent_count) return true;
+
+        for (entities, self.sorted_entities.items) |current, sorted| {
+            if (current.index != sorted.index or current.generation != sorted.generation) return true;
+        }
+        return false;
+    }
+
+
+    /// Reorder the transform storage depth-first and rebuild the parent slot table
+    fn sort(self: *TransformSystem) !void {
+        const transforms = try self.registry.getComponentStorage(TransformComponent);
+        const parents = try self.registry.getComponentStorage(ParentComponent);
+        const entities = transforms.entitySlice();
+        const count: u32 = @intCast(entities.len);
+
+        // Parent slot in the current (unsorted) order
+        const old_parent = try self.allocator.alloc(u32, count);
+        defer self.allocator.free(old_parent);
+
+        for (entities, old_parent) |entity, *slot| {
+            slot.* = no_parent;
+            const parent = parents.getUnchecked(entity) orelse continue;
+
+            // indexOf rejects parents that were destroyed since the handle was stored
+            slot.* = transforms.indexOf(parent.parent) orelse continue;
+        }
+
+        // Children as singly linked lists
+        const first_child = try self.allocator.alloc(u32, count);
+        defer self.allocator.free(first_child);
+        const next_sibling = try self.allocator.alloc(u32, count);
+        defer self.allocator.free(next_sibling);
+        @memset(first_child, no_parent);
+
+        var i: u32 = count;
+        while (i > 0) {
+            i -= 1;
+            const parent = old_parent[i];
+            if (parent == no_parent) continue;
+            next_sibling[i] = first_child[parent];
+            first_child[parent] = i;
+        }
+
+        // Depth-first walk from every root
+        const order = try self.allocator.alloc(u32, count);
+        defer self.allocator.free(order);
+        const new_slot = try self.allocator.alloc(u32, count);
+        defer self.allocator.free(new_slot);
+        @memset(new_slot, no_parent);
+
+        var stack = std.ArrayList(u32).init(self.allocator);
+        defer stack.deinit();
+
+        var written: u32 = 0;
+        for (0..count) |root_index| {
+            const root: u32 = @intCast(root_index);
+            if (old_parent[root] != no_parent) continue;
+            written = try visit(root, first_child, next_sibling, order, new_slot, written, &stack);
+        }
+
+        // Anything left over is part of a cycle, break it by treating the node as a root
+        for (0..count) |node_index| {
+            const node: u32 = @intCast(node_index);
+            if (new_slot[node] != no_parent) continue;
+            old_parent[node] = no_parent;
+            written = try visit(node, first_child, next_sibling, order, new_slot, written, &stack);
+        }
+
+        // Record the sorted state
+        try self.parent_slots.resize(count);
+        if (transforms.owned) {
+            // The group decides the storage order, keep it and walk the sorted order instead
+            @memcpy(self.parent_slots.items, old_parent);
+            try self.walk_order.resize(count);
+            @memcpy(self.walk_order.items, order);
+        } else {
+            try transforms.reorder(order);
+            for (order, 0..) |old, slot| {
+                const parent = old_parent[old];
+                self.parent_slots.items[slot] = if (parent == no_parent) no_parent else new_slot[parent];
+            }
+            self.walk_order.clearRetainingCapacity();
+        }
+        try self.sorted_entities.resize(count);
+        @memcpy(self.sorted_entities.items, transforms.entitySlice());
+        try self.buildLevels();
+
+        // Slots moved, so every world matrix has to be rebuilt against its new parent slot
+        for (transforms.componentSlice()) |*transform| {
+            transform.markDirty();
+        }
+
+        self.parent_count = parents.len();
+        self.needs_sort = false;
+    }
+
+
+    /// Breadth-first order of the sorted slots for the bulk propagation
+    fn buildLevels(self: *TransformSystem) !void {
+        const parent_slots = self.parent_slots.items;
+        const count = parent_slots.len;
+
+        // Parents are walked first, so one pass gives every depth
+        const depth = try self.allocator.alloc(u32, count);
+        defer self.allocator.free(depth);
+        var max_depth: u32 = 0;
+        for (0..count) |step| {
+            const slot = self.walkSlot(step);
+            const parent_slot = parent_slots[slot];
+            depth[slot] = if (parent_slot == no_parent) 0 else depth[parent_slot] + 1;
+            max_depth = @max(max_depth, depth[slot]);
+        }
+
+        // Counting sort by depth, stable so siblings stay next to each other
+        const level_count: usize = if (count == 0) 0 else max_depth + 1;
+        try self.level_starts.resize(level_count + 1);
+        const starts = self.level_starts.items;
+        @memset(starts, 0);
+        for (depth) |d| starts[d + 1] += 1;
+        for (1..starts.len) |level| starts[level] += starts[level - 1];
+
+        const position = try self.allocator.alloc(u32, count);
+        defer self.allocator.free(position);
+        const next = try self.allocator.dupe(u32, starts[0..level_count]);
+        defer self.allocator.free(next);
+
+        try self.level_order.resize(count);
+        for (depth, 0..) |d, slot| {
+            position[slot] = next[d];
+            self.level_order.items[next[d]] = @intCast(slot);
+            next[d] += 1;
+        }
+
+        try self.level_parents.resize(count);
+        for (self.level_order.items, self.level_parents.items) |slot, *parent| {
+            const parent_slot = parent_slots[slot];
+            parent.* = if (parent_slot == no_parent) -1 else @intCast(position[parent_slot]);
+        }
+    }
+
+
+    /// Rebuild every world and render matrix from the local matrices, level by level
+    fn propagateAll(self: *TransformSystem, items: []TransformComponent) !void {
+        try self.bulk_locals.resize(items.len);
+        try self.bulk_worlds.resize(items.len);
+        for (self.level_order.items, self.bulk_locals.items) |slot, *local| {
+            local.* = items[slot].local_matrix;
+        }
+
+        const pass = LevelPass{
+            .locals = self.bulk_locals.items,
+            .parents = self.level_parents.items,
+            .worlds = self.bulk_worlds.items,
+        };
+        const starts = self.level_starts.items;
+        for (starts[0 .. starts.len - 1], starts[1..]) |begin, end| {
+            // Parents are all in earlier levels, so the entries of one level are independent
+            if (self.jobs) |jobs| {
+                if (end - begin >= 2 * level_chunk) {
+                    const level = LevelPass{ .locals = pass.locals, .parents = pass.parents, .worlds = pass.worlds, .begin = begin };
+                    jobs.parallelFor(end - begin, level_chunk, &level, LevelPass.run);
+                    continue;
+                }
+            }
+            Affine3x4.multiplyHierarchyRange(pass.locals, pass.parents, pass.worlds, begin, end);
+        }
+
+        // Parents come first in level order, their world origin is set when a child needs it
+        for (self.level_order.items, self.bulk_worlds.items) |slot, world| {
+            items[slot].world_matrix = world;
+            items[slot].render_matrix = world;
+            const parent_slot = self.parent_slots.items[slot];
+            items[slot].world_origin = if (parent_slot == no_parent) items[slot].origin else items[parent_slot].world_origin;
+        }
+    }
+
+
+    /// Camera relative matrices of a range of transforms, run in chunks by JobSystem.parallelFor
+    const RelativePass = struct {
+        items: []TransformComponent,
+        camera_origin: Vec3d,
+
+        fn run(pass: *const RelativePass, start: usize, end: usize) void {
+            for (pass.items[start..end]) |*transform| {
+                const offset = transform.world_origin.subtract(pass.camera_origin).toVec3f();
+                transform.relative_matrix = transform.render_matrix;
+                transform.relative_matrix.data[3] += offset.x;
+                transform.relative_matrix.data[7] += offset.y;
+                transform.relative_matrix.data[11] += offset.z;
+            }
+        }
+    };
+
+
+    /// One level of the bulk propagation, run in chunks by JobSystem.parallelFor
+    const LevelPass = struct {
+        locals: []const Affine3x4,
+        parents: []const i32,
+        worlds: []Affine3x4,
+        begin: usize = 0,
+
+        fn run(pass: *const LevelPass, start: usize, end: usize) void {
+            Affine3x4.multiplyHierarchyRange(pass.locals, pass.parents, pass.worlds, pass.begin + start, pass.begin + end);
+        }
+    };
+
+
+    /// Append `root` and its not yet visited descendants to `order`, returns the new count
+    fn visit(root: u32, first_child: []const u32, next_sibling: []const u32, order: []u32, new_slot: []u32, start: u32, stack: *std.ArrayList(u32)) !u32 {
+        var written = start;
+        try stack.append(root);
+
+        while (stack.pop()) |node| {
+            if (new_slot[node] != no_parent) continue;
+            new_slot[node] = written;
+            order[written] = node;
+            written += 1;
+
+            var child = first_child[node];
+            while (child != no_parent) : (child = next_sibling[child]) {
+                try stack.append(child);
+            }
+        }
+        return written;
+    }
+};
@@ -0,0 +1,304 @@
+// ecs/systems/world_partition_system.zig
+const std = @import("std");
+
+const Registry = @import("../ecs.zig").Registry;
+const EntityId = @import("../ecs.zig").EntityId;
+const EcsError = @import("../ecs.zig").EcsError;
+
+const Camera = @import("../../renderer/camera.zig").Camera;
+const resource_loader = @import("../../renderer/resource_loader.zig");
+const ResourceLoader = resource_loader.ResourceLoader;
+const LoadFuture = resource_loader.LoadFuture;
+const LoadPriority = resource_loader.LoadPriority;
+const Vec3f = @import("../../math/vector.zig").Vec3f;
+const JobSystem = @import("../../core/jobs.zig").JobSystem;
+const lz4 = @import("../../core/lz4.zig");
+
+const TransformComponent = @import("../components/transform_component.zig").TransformComponent;
+
+
+pub const WorldPartitionConfig = struct {
+    /// Edge length of the square cells the x/z plane is split into, in world units
+    cell_size: f32 = 64.0,
+    /// Cells whose center is this close to the camera are loaded
+    load_radius: f32 = 192.0,
+    /// Loaded cells farther away than this are unloaded, above load_radius so cells on the edge don't flicker
+    unload_radius: f32 = 256.0,
+    /// Directory of the cell snapshots, one cell_<x>_<z>.ecs file per cell that has content
+    directory: []const u8,
+    /// Registers every component type and tag cells hold, on each staging registry before its snapshot loads
+    setup: *const fn (*Registry) anyerror!void,
+    priority: LoadPriority = .prefetch,
+    /// bake writes the cells as lz4 streams, loads read either kind of file
+    compress: bool = true,
+};
+
+
+/// Streams level content in and out of the registry by distance to the camera
+/// bake splits a level into one ECS snapshot per grid cell. update loads the cells coming into range
+/// through the ResourceLoader, each into a staging registry on a worker, then moves a finished cell's
+/// entities over with one bulk add per storage and destroys the entities of cells out of range in one batch
+/// Only pointer-free components survive the snapshots, cells refer to models and textures by plain handles
+/// that gameplay code resolves, e.g. in an on_add hook. The allocator must be thread safe
+pub const WorldPartitionSystem = struct {
+    const Self = @This();
+
+    const CellCoord = [2]i32;
+
+    const Cell = struct {
+        state: enum { loading, loaded, failed },
+        /// Filled by the loader's worker, null once its entities moved into the registry
+        staging: ?*Registry,
+        future: LoadFuture = .{},
+        /// Entities of the cell in the registry
+        entities: std.ArrayList(EntityId),
+        /// The loader's job system, compressed cells decode their blocks on it
+        job_system: *JobSystem,
+    };
+
+    allocator: std.mem.Allocator,
+    registry: *Registry,
+    camera: *Camera,
+    loader: *ResourceLoader,
+    config: WorldPartitionConfig,
+
+    /// Cells requested, loaded or failed, the loader's workers hold pointers to loading ones
+    cells: std.AutoHashMap(CellCoord, *Cell),
+    /// Cells to drop this update, reused between frames
+    leaving: std.ArrayList(CellCoord),
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, registry: *Registry, camera: *Camera, loader: *ResourceLoader, config: WorldPartitionConfig) Self {
+        return .{
+            .allocator = allocator,
+            .registry = registry,
+            .camera = camera,
+            .loader = loader,
+            .config = config,
+            .cells = std.AutoHashMap(CellCoord, *Cell).init(allocator),
+            .leaving = std.ArrayList(CellCoord).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Write one snapshot per cell with the entities whose TransformComponent position lies in it
+    /// Entities are copied, `registry` stays as it is. Components with a deinit function need a `clone`
+    pub fn bake(allocator: std.mem.Allocator, registry: *Registry, config: WorldPartitionConfig) !void {
+        var cells = std.AutoHashMap(CellCoord, *Registry).init(allocator);
+        defer {
+            var iter = cells.valueIterator();
+            while (iter.next()) |cell| cell.*.release();
+            cells.deinit();
+        }
+
+        const transforms = try registry.getComponentStorage(TransformComponent);
+        for (transforms.entitySlice(), transforms.componentSlice()) |entity, *transform| {
+            const entry = try cells.getOrPut(cellOf(config.cell_size, transform.position));
+            if (!entry.found_existing) {
+                entry.value_ptr.* = Registry.create(allocator) catch |e| {
+                    cells.removeByPtr(entry.key_ptr);
+                    return e;
+                };
+                try config.setup(entry.value_ptr.*);
+            }
+            _ = try registry.copyEntityTo(entry.value_ptr.*, entity);
+        }
+
+        try std.fs.cwd().makePath(config.directory);
+        var iter = cells.iterator();
+        while (iter.next()) |entry| {
+            const path = try cellPath(allocator, config.directory, entry.key_ptr.*);
+            defer allocator.free(path);
+
+            const file = try std.fs.cwd().createFile(path, .{});
+            defer file.close();
+            if (!config.compress) {
+                var buffered = std.io.bufferedWriter(file.writer());
+                try entry.value_ptr.*.saveSnapshot(buffered.writer().any());
+                try buffered.flush();
+                continue;
+            }
+
+            var snapshot = std.ArrayList(u8).init(allocator);
+            defer snapshot.deinit();
+            try entry.value_ptr.*.saveSnapshot(snapshot.writer().any());
+            const stream = try lz4.compressStream(allocator, snapshot.items, null);
+            defer allocator.free(stream);
+            try file.writeAll(stream);
+        }
+    }
+
+
+    /// Merge the cells that finished loading, unload the ones out of range and request the ones coming
+    /// into range. Call once per frame after ResourceLoader.update, which completes the loads
+    pub fn update(self: *Self) !void {
+        const eye = self.camera.position;
+        self.leaving.clearRetainingCapacity();
+
+        var iter = self.cells.iterator();
+        while (iter.next()) |entry| {
+            const cell = entry.value_ptr.*;
+            const far = self.distanceTo(entry.key_ptr.*, eye) > self.config.unload_radius;
+
+            if (cell.state == .loading) {
+                if (!cell.future.isReady()) continue;
+                if (cell.future.result == .failed) {
+                    std.debug.print("World cell {any} failed to load: {s}\n", .{ entry.key_ptr.*, @errorName(cell.future.result.failed) });
+                    cell.state = .failed;
+                } else if (!far) {
+                    try cell.staging.?.moveAllTo(self.registry, &cell.entities);
+                    cell.state = .loaded;
+                }
+                cell.staging.?.release();
+                cell.staging = null;
+            }
+
+            if (far) try self.leaving.append(entry.key_ptr.*);
+        }
+
+        for (self.leaving.items) |coord| {
+            const cell = self.cells.fetchRemove(coord).?.value;
+            // Gameplay may have destroyed some already
+            var kept: usize = 0;
+            for (cell.entities.items) |entity| {
+                if (!self.registry.isValidEntity(entity)) continue;
+                cell.entities.items[kept] = entity;
+                kept += 1;
+            }
+            try self.registry.destroyEntities(cell.entities.items[0..kept]);
+            cell.entities.deinit();
+            self.allocator.destroy(cell);
+        }
+
+        const center = cellOf(self.config.cell_size, eye);
+        const reach: i32 = @intFromFloat(@ceil(self.config.load_radius / self.config.cell_size));
+        var z = center[1] - reach;
+        while (z <= center[1] + reach) : (z += 1) {
+            var x = center[0] - reach;
+            while (x <= center[0] + reach) : (x += 1) {
+                const coord = CellCoord{ x, z };
+                if (self.distanceTo(coord, eye) > self.config.load_radius or self.cells.contains(coord)) continue;
+                try self.requestCell(coord);
+            }
+        }
+    }
+
+
+    /// Cells whose entities are in the registry
+    pub fn loadedCount(self: *const Self) usize {
+        var count: usize = 0;
+        var iter = self.cells.valueIterator();
+        while (iter.next()) |cell| {
+            if (cell.*.state == .loaded) count += 1;
+        }
+        return count;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Call after ResourceLoader.deinit, which finishes or cancels the loads still writing into cells
+    /// Entities of loaded cells stay in the registry
+    pub fn deinit(self: *Self) void {
+        var iter = self.cells.valueIterator();
+        while (iter.next()) |cell| {
+            if (cell.*.staging) |staging| staging.release();
+            cell.*.entities.deinit();
+            self.allocator.destroy(cell.*);
+        }
+        self.cells.deinit();
+        self.leaving.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn requestCell(self: *Self, coord: CellCoord) !void {
+        try self.cells.ensureUnusedCapacity(1);
+
+        const cell = try self.allocator.create(Cell);
+        errdefer self.allocator.destroy(cell);
+        const staging = try Registry.create(self.allocator);
+        errdefer staging.release();
+        try self.config.setup(staging);
+        cell.* = .{
+            .state = .loading,
+            .staging = staging,
+            .entities = std.ArrayList(EntityId).init(self.allocator),
+            .job_system = self.loader.pool,
+        };
+
+        const path = try cellPath(self.allocator, self.config.directory, coord);
+        defer self.allocator.free(path);
+        try self.loader.loadCustom(path, path, .{ .func = decodeCell, .context = cell }, .{
+            .priority = self.config.priority,
+            .future = &cell.future,
+        });
+        self.cells.putAssumeCapacity(coord, cell);
+    }
+
+
+    /// Loader worker side, a cell without a file is simply empty
+    /// A compressed cell is read window by window while the job system decodes the previous window
+    fn decodeCell(context: ?*anyopaque, path: [:0]const u8) anyerror!void {
+        const cell: *Cell = @ptrCast(@alignCast(context.?));
+        const file = std.fs.cwd().openFile(path, .{}) catch |e| switch (e) {
+            error.FileNotFound => return,
+            else => return e,
+        };
+        defer file.close();
+
+        var magic: [lz4.StreamHeader.magic.len]u8 = undefined;
+        const magic_len = try file.readAll(&magic);
+        try file.seekTo(0);
+        if (!lz4.isStream(magic[0..magic_len])) {
+            var buffered = std.io.bufferedReader(file.reader());
+            return cell.staging.?.loadSnapshot(buffered.reader().any());
+        }
+
+        // The system's allocator, thread safe as init requires
+        const allocator = cell.entities.allocator;
+        var reader = try lz4.StreamReader.open(allocator, file);
+        defer reader.deinit();
+        const snapshot = try allocator.alloc(u8, std.math.cast(usize, reader.header.raw_size) orelse return EcsError.InvalidSnapshot);
+        defer allocator.free(snapshot);
+        try reader.readInto(snapshot, cell.job_system, lz4.default_window_size);
+
+        var stream = std.io.fixedBufferStream(snapshot);
+        try cell.staging.?.loadSnapshot(stream.reader().any());
+    }
+
+
+    fn cellOf(cell_size: f32, position: Vec3f) CellCoord {
+        return .{
+            @intFromFloat(std.math.clamp(@floor(position.x / cell_size), -1e9, 1e9)),
+            @intFromFloat(std.math.clamp(@floor(position.z / cell_size), -1e9, 1e9)),
+        };
+    }
+
+
+    /// Distance from `eye` to the cell center on the x/z plane
+    fn distanceTo(self: *const Self, coord: CellCoord, eye: Vec3f) f32 {
+        const size = self.config.cell_size;
+        const dx = (@as(f32, @floatFromInt(coord[0])) + 0.5) * size - eye.x;
+        const dz = (@as(f32, @floatFromInt(coord[1])) + 0.5) * size - eye.z;
+        return @sqrt(dx * dx + dz * dz);
+    }
+
+
+    fn cellPath(allocator: std.mem.Allocator, directory: []const u8, coord: CellCoord) ![]u8 {
+        return std.fmt.allocPrint(allocator, "{s}/cell_{d}_{d}.ecs", .{ directory, coord[0], coord[1] });
+    }
+};
@@ -0,0 +1,451 @@
+// math/aabb_tree.zig - dynamic bounding volume hierarchy
+
+const std = @import("std");
+
+const Vec3f = @import("vector.zig").Vec3f;
+const bounds = @import("bounds.zig");
+const BoundingBox = bounds.BoundingBox;
+const Frustum = bounds.Frustum;
+const Ray = bounds.Ray;
+
+// ============================================================
+// Public API: AABB Tree
+// ============================================================
+
+/// Dynamic AABB tree in the style of Box2D's b2DynamicTree
+/// Leaves store a fattened box, so objects moving a little stay in place and only a real move reinserts them
+/// Inserts pick the sibling by surface area cost and rotations keep the tree height balanced,
+/// which keeps frustum, box, sphere and ray queries logarithmic in the number of objects
+pub fn AabbTree(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        pub const null_node = std.math.maxInt(u32);
+
+        const Node = struct {
+            /// Fattened box for leaves, union of the children for inner nodes
+            box: BoundingBox,
+            /// Exact box of a leaf, queries test leaves against it
+            tight: BoundingBox,
+            /// Parent, or the next free node while on the free list
+            parent: u32,
+            child1: u32 = null_node,
+            child2: u32 = null_node,
+            /// 0 for leaves, -1 for free nodes
+            height: i32,
+            data: T = undefined,
+
+            fn isLeaf(self: Node) bool {
+                return self.child1 == null_node;
+            }
+        };
+
+        /// Closest leaf hit by a ray
+        pub const RayHit = struct {
+            proxy: u32,
+            data: T,
+            distance: f32,
+        };
+
+        allocator: std.mem.Allocator,
+        nodes: std.ArrayList(Node),
+        root: u32 = null_node,
+        free_list: u32 = null_node,
+        /// Leaves are this much larger than their object on every side
+        margin: f32,
+        /// Traversal stack shared by the queries
+        stack: std.ArrayList(u32),
+
+
+        // ============================================================
+        // Public API: Creation Functions
+        // ============================================================
+
+        pub fn init(allocator: std.mem.Allocator, margin: f32) Self {
+            return .{
+                .allocator = allocator,
+                .nodes = std.ArrayList(Node).init(allocator),
+                .margin = margin,
+                .stack = std.ArrayList(u32).init(allocator),
+            };
+        }
+
+
+        // ============================================================
+        // Public API: Operational Functions
+        // ============================================================
+
+        /// Add an object, returns the proxy that identifies it for move and remove
+        pub fn insert(self: *Self, box: BoundingBox, data: T) !u32 {
+            const proxy = try self.allocateNode();
+            const node = &self.nodes.items[proxy];
+            node.box = box.expanded(self.margin);
+            node.tight = box;
+            node.height = 0;
+            node.data = data;
+
+            try self.insertLeaf(proxy);
+            return proxy;
+        }
+
+
+        pub fn remove(self: *Self, proxy: u32) void {
+            std.debug.assert(self.nodes.items[proxy].isLeaf());
+            self.removeLeaf(proxy);
+            self.freeNode(proxy);
+        }
+
+
+        /// Update an object's box, returns true when it left its fat box and was reinserted
+        pub fn move(self: *Self, proxy: u32, box: BoundingBox) !bool {
+            const node = &self.nodes.items[proxy];
+            std.debug.assert(node.isLeaf());
+
+            node.tight = box;
+            if (node.box.contains(box)) return false;
+
+            self.removeLeaf(proxy);
+            self.nodes.items[proxy].box = box.expanded(self.margin);
+            try self.insertLeaf(proxy);
+            return true;
+        }
+
+
+        pub fn getData(self: *const Self, proxy: u32) T {
+            return self.nodes.items[proxy].data;
+        }
+
+
+        pub fn getBox(self: *const Self, proxy: u32) BoundingBox {
+            return self.nodes.items[proxy].tight;
+        }
+
+
+        /// Height of the tree, 0 for a single leaf
+        pub fn height(self: *const Self) i32 {
+            if (self.root == null_node) return 0;
+            return self.nodes.items[self.root].height;
+        }
+
+
+        /// Append the proxy of every object whose box may be visible through `frustum`
+        /// Subtrees fully inside the frustum are taken without testing their leaves
+        pub fn queryFrustum(self: *Self, frustum: *const Frustum, out: *std.ArrayList(u32)) !void {
+            try self.pushRoot();
+            while (self.stack.pop()) |index| {
+                const node = &self.nodes.items[index];
+                const box = if (node.isLeaf()) node.tight else node.box;
+                switch (frustum.classifyBox(box)) {
+                    .outside => {},
+                    .inside => try self.appendLeaves(index, out),
+                    .intersecting => {
+                        if (node.isLeaf()) {
+                            try out.append(index);
+                        } else {
+                            try self.stack.append(node.child1);
+                            try self.stack.append(node.child2);
+                        }
+                    },
+                }
+            }
+        }
+
+
+        /// Append the proxy of every object whose box overlaps `box`
+        pub fn queryBox(self: *Self, box: BoundingBox, out: *std.ArrayList(u32)) !void {
+            try self.pushRoot();
+            while (self.stack.pop()) |index| {
+                const node = &self.nodes.items[index];
+                if (node.isLeaf()) {
+                    if (node.tight.overlaps(box)) try out.append(index);
+                } else if (node.box.overlaps(box)) {
+                    try self.stack.append(node.child1);
+                    try self.stack.append(node.child2);
+                }
+            }
+        }
+
+
+        /// Append the proxy of every object whose box overlaps the sphere
+        pub fn querySphere(self: *Self, center: Vec3f, radius: f32, out: *std.ArrayList(u32)) !void {
+            try self.pushRoot();
+            while (self.stack.pop()) |index| {
+                const node = &self.nodes.items[index];
+                if (node.isLeaf()) {
+                    if (node.tight.overlapsSphere(center, radius)) try out.append(index);
+                } else if (node.box.overlapsSphere(center, radius)) {
+                    try self.stack.append(node.child1);
+                    try self.stack.append(node.child2);
+                }
+            }
+        }
+
+
+        /// Closest object box hit by `ray` within `max_distance`
+        /// Subtrees that start beyond the closest hit so far are skipped
+        pub fn raycast(self: *Self, ray: Ray, max_distance: f32) !?RayHit {
+            var best: ?RayHit = null;
+            var limit = max_distance;
+
+            try self.pushRoot();
+            while (self.stack.pop()) |index| {
+                const node = &self.nodes.items[index];
+                if (node.isLeaf()) {
+                    const distance = node.tight.intersectRay(ray, limit) orelse continue;
+                    best = .{ .proxy = index, .data = node.data, .distance = distance };
+                    limit = distance;
+                } else if (node.box.intersectRay(ray, limit) != null) {
+                    try self.stack.append(node.child1);
+                    try self.stack.append(node.child2);
+                }
+            }
+            return best;
+        }
+
+
+        /// Append every object box `ray` hits within `max_distance`, in no particular order
+        /// For callers that refine the box hits, e.g. against triangles, and need more than the closest
+        pub fn queryRay(self: *Self, ray: Ray, max_distance: f32, out: *std.ArrayList(RayHit)) !void {
+            try self.pushRoot();
+            while (self.stack.pop()) |index| {
+                const node = &self.nodes.items[index];
+                if (node.isLeaf()) {
+                    const distance = node.tight.intersectRay(ray, max_distance) orelse continue;
+                    try out.append(.{ .proxy = index, .data = node.data, .distance = distance });
+                } else if (node.box.intersectRay(ray, max_distance) != null) {
+                    try self.stack.append(node.child1);
+                    try self.stack.append(node.child2);
+                }
+            }
+        }
+
+
+        /// Drop every object, keeping the memory
+        pub fn clear(self: *Self) void {
+            self.nodes.clearRetainingCapacity();
+            self.root = null_node;
+            self.free_list = null_node;
+        }
+
+
+        // ============================================================
+        // Public API: Destruction Function
+        // ============================================================
+
+        pub fn deinit(self: *Self) void {
+            self.nodes.deinit();
+            self.stack.deinit();
+        }
+
+
+        // ============================================================
+        // Private: Helper Functions
+        // ============================================================
+
+        fn allocateNode(self: *Self) !u32 {
+            if (self.free_list != null_node) {
+                const index = self.free_list;
+                self.free_list = self.nodes.items[index].parent;
+                self.nodes.items[index] = .{ .box = undefined, .tight = undefined, .parent = null_node, .height = 0 };
+                return index;
+            }
+
+            const index: u32 = @intCast(self.nodes.items.len);
+            try self.nodes.append(.{ .box = undefined, .tight = undefined, .parent = null_node, .height = 0 });
+            return index;
+        }
+
+
+        fn freeNode(self: *Self, index: u32) void {
+            const node = &self.nodes.items[index];
+            node.parent = self.free_list;
+            node.child1 = null_node;
+            node.child2 = null_node;
+            node.height = -1;
+            self.free_list = index;
+        }
+
+
+        fn pushRoot(self: *Self) !void {
+            self.stack.clearRetainingCapacity();
+            if (self.root != null_node) try self.stack.append(self.root);
+        }
+
+
+        /// Append every leaf below `start` without testing it, uses the stack above its current top
+        fn appendLeaves(self: *Self, start: u32, out: *std.ArrayList(u32)) !void {
+            const base = self.stack.items.len;
+            try self.stack.append(start);
+            while (self.stack.items.len > base) {
+                const index = self.stack.pop().?;
+                const node = &self.nodes.items[index];
+                if (node.isLeaf()) {
+                    try out.append(index);
+                } else {
+                    try self.stack.append(node.child1);
+                    try self.stack.append(node.child2);
+                }
+            }
+        }
+
+
+        fn insertLeaf(self: *Self, leaf: u32) !void {
+            if (self.root == null_node) {
+                self.root = leaf;
+                self.nodes.items[leaf].parent = null_node;
+                return;
+            }
+
+            // The new parent may grow the node list, so no node pointers are held across it
+            const sibling = self.findSibling(self.nodes.items[leaf].box);
+            const new_parent = try self.allocateNode();
+
+            const nodes = self.nodes.items;
+            const old_parent = nodes[sibling].parent;
+            nodes[new_parent] = .{
+                .box = nodes[leaf].box.merge(nodes[sibling].box),
+                .tight = undefined,
+                .parent = old_parent,
+                .child1 = sibling,
+                .child2 = leaf,
+                .height = nodes[sibling].height + 1,
+            };
+
+            if (old_parent != null_node) {
+                if (nodes[old_parent].child1 == sibling) nodes[old_parent].child1 = new_parent else nodes[old_parent].child2 = new_parent;
+            } else {
+                self.root = new_parent;
+            }
+            nodes[sibling].parent = new_parent;
+            nodes[leaf].parent = new_parent;
+
+            self.refit(nodes[leaf].parent);
+        }
+
+
+        /// Descend to the node whose pairing with `box` adds the least surface area
+        fn findSibling(self: *const Self, box: BoundingBox) u32 {
+            const nodes = self.nodes.items;
+            var index = self.root;
+
+            while (!nodes[index].isLeaf()) {
+                const node = nodes[index];
+                const area = node.box.surfaceArea();
+                const combined_area = node.box.merge(box).surfaceArea();
+
+                // Cost of pairing with this node, and the growth every deeper choice pays on top
+                const cost = 2.0 * combined_area;
+                const inheritance = 2.0 * (combined_area - area);
+
+                const cost1 = self.descendCost(node.child1, box) + inheritance;
+                const cost2 = self.descendCost(node.child2, box) + inheritance;
+
+                if (cost < cost1 and cost < cost2) break;
+                index = if (cost1 < cost2) node.child1 else node.child2;
+            }
+            return index;
+        }
+
+
+        fn descendCost(self: *const Self, index: u32, box: BoundingBox) f32 {
+            const node = self.nodes.items[index];
+            const merged_area = node.box.merge(box).surfaceArea();
+            return if (node.isLeaf()) merged_area else merged_area - node.box.surfaceArea();
+        }
+
+
+        fn removeLeaf(self: *Self, leaf: u32) void {
+            if (leaf == self.root) {
+                self.root = null_node;
+                return;
+            }
+
+            const nodes = self.nodes.items;
+            const parent = nodes[leaf].parent;
+            const grand_parent = nodes[parent].parent;
+            const sibling = if (nodes[parent].child1 == leaf) nodes[parent].child2 else nodes[parent].child1;
+
+            if (grand_parent != null_node) {
+                if (nodes[grand_parent].child1 == parent) nodes[grand_parent].child1 = sibling else nodes[grand_parent].child2 = sibling;
+                nodes[sibling].parent = grand_parent;
+                self.freeNode(parent);
+                self.refit(grand_parent);
+            } else {
+                self.root = sibling;
+                nodes[sibling].parent = null_node;
+                self.freeNode(parent);
+            }
+        }
+
+
+        /// Rebalance and recompute boxes and heights from `start` up to the root
+        fn refit(self: *Self, start: u32) void {
+            var index = start;
+            while (index != null_node) {
+                index = self.balance(index);
+
+                const nodes = self.nodes.items;
+                const child1 = nodes[index].child1;
+                const child2 = nodes[index].child2;
+                nodes[index].height = 1 + @max(nodes[child1].height, nodes[child2].height);
+                nodes[index].box = nodes[child1].box.merge(nodes[child2].box);
+
+                index = nodes[index].parent;
+            }
+        }
+
+
+        /// Rotate the taller grandchild of `a` up when its children differ in height by more than one
+        /// Returns the node that now sits where `a` was
+        fn balance(self: *Self, a: u32) u32 {
+            const nodes = self.nodes.items;
+            if (nodes[a].isLeaf() or nodes[a].height < 2) return a;
+
+            const b = nodes[a].child1;
+            const c = nodes[a].child2;
+            const difference = nodes[c].height - nodes[b].height;
+
+            if (difference > 1) {
+                self.rotateUp(a, c, .second);
+                return c;
+            }
+            if (difference < -1) {
+                self.rotateUp(a, b, .first);
+                return b;
+            }
+            return a;
+        }
+
+
+        /// Make `child` of `a` the parent of `a`, `a` keeps the shorter grandchild
+        fn rotateUp(self: *Self, a: u32, child: u32, comptime side: enum { first, second }) void {
+            const nodes = self.nodes.items;
+            const other = if (side == .first) nodes[a].child2 else nodes[a].child1;
+            const f = nodes[child].child1;
+            const g = nodes[child].child2;
+
+            // Put `child` where `a` was
+            nodes[child].child1 = a;
+            nodes[child].parent = nodes[a].parent;
+            nodes[a].parent = child;
+
+            const parent = nodes[child].parent;
+            if (parent != null_node) {
+                if (nodes[parent].child1 == a) nodes[parent].child1 = child else nodes[parent].child2 = child;
+            } else {
+                self.root = child;
+            }
+
+            // The taller grandchild stays with `child`, the other one replaces `child` under `a`
+            const keep, const give = if (nodes[f].height > nodes[g].height) .{ f, g } else .{ g, f };
+            nodes[child].child2 = keep;
+            if (side == .first) nodes[a].child1 = give else nodes[a].child2 = give;
+            nodes[give].parent = a;
+
+            nodes[a].box = nodes[other].box.merge(nodes[give].box);
+            nodes[a].height = 1 + @max(nodes[other].height, nodes[give].height);
+            nodes[child].box = nodes[a].box.merge(nodes[keep].box);
+            nodes[child].height = 1 + @max(nodes[a].height, nodes[keep].height);
+        }
+    };
+}
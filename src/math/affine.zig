@@ -0,0 +1,141 @@
+// math/affine.zig - 3x4 affine matrices for transforms and instance data
+
+const eigen = @cImport({
+    @cInclude("Eigen/eigen_wrapper.h");
+});
+
+const std = @import("std");
+const backend = @import("backend.zig").active;
+const Vec3f = @import("vector.zig").Vec3f;
+const Quatf = @import("quaternion.zig").Quatf;
+const Mat4f = @import("matrix.zig").Mat4f;
+
+const V4 = @Vector(4, f32);
+
+// ============================================================
+// Public API: Affine3x4 Implementations
+// ============================================================
+
+/// Top three rows of a 4x4 matrix whose bottom row is (0, 0, 0, 1), 48 bytes instead of 64
+/// Row-major, so every row is one vec4: the layout of the instance attributes and of the Eigen wrapper's kernels
+pub const Affine3x4 = struct {
+    data: [12]f32 align(16),
+
+    pub inline fn identity() Affine3x4 {
+        return .{ .data = .{
+            1, 0, 0, 0,
+            0, 1, 0, 0,
+            0, 0, 1, 0,
+        } };
+    }
+
+    /// Build a translation * rotation * scale matrix, same as Mat4f.compose
+    pub fn compose(translation: Vec3f, rotation: Quatf, scl: Vec3f) Affine3x4 {
+        const q = rotation;
+        const xx = q.x * q.x;
+        const yy = q.y * q.y;
+        const zz = q.z * q.z;
+        const xy = q.x * q.y;
+        const xz = q.x * q.z;
+        const yz = q.y * q.z;
+        const wx = q.w * q.x;
+        const wy = q.w * q.y;
+        const wz = q.w * q.z;
+
+        return .{ .data = .{
+            (1 - 2 * (yy + zz)) * scl.x, 2 * (xy - wz) * scl.y, 2 * (xz + wy) * scl.z, translation.x,
+            2 * (xy + wz) * scl.x, (1 - 2 * (xx + zz)) * scl.y, 2 * (yz - wx) * scl.z, translation.y,
+            2 * (xz - wy) * scl.x, 2 * (yz + wx) * scl.y, (1 - 2 * (xx + yy)) * scl.z, translation.z,
+        } };
+    }
+
+    /// Drop the bottom row of a column-major 4x4, which has to be (0, 0, 0, 1)
+    pub fn fromMat4(mat: *const Mat4f) Affine3x4 {
+        const m = &mat.data;
+        return .{ .data = .{
+            m[0], m[4], m[8], m[12],
+            m[1], m[5], m[9], m[13],
+            m[2], m[6], m[10], m[14],
+        } };
+    }
+
+    /// Expand to a column-major 4x4, e.g. for a `model` uniform
+    pub fn toMat4(self: *const Affine3x4) Mat4f {
+        const m = &self.data;
+        return .{ .data = .{
+            m[0], m[4], m[8], 0,
+            m[1], m[5], m[9], 0,
+            m[2], m[6], m[10], 0,
+            m[3], m[7], m[11], 1,
+        } };
+    }
+
+    /// Multiply two matrices to get a new one
+    pub inline fn multiply(a: Affine3x4, b: Affine3x4) Affine3x4 {
+        var result: Affine3x4 = undefined;
+        backend.affineMultiply(&a, &b, &result);
+        return result;
+    }
+
+    /// Multiply two matrices into `out`, which may be `a` or `b`
+    pub inline fn multiplyInto(out: *Affine3x4, a: *const Affine3x4, b: *const Affine3x4) void {
+        backend.affineMultiply(a, b, out);
+    }
+
+    /// Null if the upper 3x3 is singular
+    pub inline fn inverse(mat: *const Affine3x4) ?Affine3x4 {
+        var result: Affine3x4 = undefined;
+        if (!backend.affineInverse(mat, &result)) return null;
+        return result;
+    }
+
+    pub inline fn transformPoint(mat: *const Affine3x4, point: Vec3f) Vec3f {
+        const p = V4{ point.x, point.y, point.z, 1 };
+        return .{
+            .x = @reduce(.Add, mat.row(0) * p),
+            .y = @reduce(.Add, mat.row(1) * p),
+            .z = @reduce(.Add, mat.row(2) * p),
+        };
+    }
+
+    /// Ignores the translation
+    pub inline fn transformDirection(mat: *const Affine3x4, dir: Vec3f) Vec3f {
+        const d = V4{ dir.x, dir.y, dir.z, 0 };
+        return .{
+            .x = @reduce(.Add, mat.row(0) * d),
+            .y = @reduce(.Add, mat.row(1) * d),
+            .z = @reduce(.Add, mat.row(2) * d),
+        };
+    }
+
+    pub inline fn translation(mat: *const Affine3x4) Vec3f {
+        return .{ .x = mat.data[3], .y = mat.data[7], .z = mat.data[11] };
+    }
+
+    pub inline fn row(mat: *const Affine3x4, comptime i: usize) V4 {
+        return mat.data[i * 4 ..][0..4].*;
+    }
+
+
+    // Batched kernels - one C call for a whole slice, like the Mat4f ones
+
+    /// out[i] = a[i] * b[i] for every pair, `out` must not alias either input
+    pub fn multiplyBatch(a: []const Affine3x4, b: []const Affine3x4, out: []Affine3x4) void {
+        std.debug.assert(a.len == b.len and a.len == out.len);
+        eigen.affine3x4MultiplyBatch(@ptrCast(a.ptr), @ptrCast(b.ptr), @ptrCast(out.ptr), a.len);
+    }
+
+    /// worlds[i] = worlds[parents[i]] * locals[i], or locals[i] where parents[i] is negative
+    /// Parents have to come before their children, `worlds` must not alias `locals`
+    pub fn multiplyHierarchy(locals: []const Affine3x4, parents: []const i32, worlds: []Affine3x4) void {
+        std.debug.assert(locals.len == parents.len and locals.len == worlds.len);
+        eigen.affine3x4MultiplyHierarchy(@ptrCast(locals.ptr), parents.ptr, @ptrCast(worlds.ptr), locals.len);
+    }
+
+    /// multiplyHierarchy for elements begin..end only, their parents have to be final already
+    /// Lets one level of a breadth-first order be split across threads
+    pub fn multiplyHierarchyRange(locals: []const Affine3x4, parents: []const i32, worlds: []Affine3x4, begin: usize, end: usize) void {
+        std.debug.assert(locals.len == parents.len and locals.len == worlds.len and begin <= end and end <= locals.len);
+        eigen.affine3x4MultiplyHierarchyRange(@ptrCast(locals.ptr), parents.ptr, @ptrCast(worlds.ptr), begin, end);
+    }
+};
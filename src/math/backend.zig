@@ -0,0 +1,20 @@
+// math/backend.zig - comptime selection of the math implementation
+
+const build_options = @import("build_options");
+
+/// Available math backends
+/// native: inlinable @Vector(4, f32) code, visible to the Zig optimizer
+/// eigen: calls into the Eigen C++ wrapper
+pub const Backend = enum { native, eigen };
+
+pub const native = @import("backend/native.zig");
+pub const eigen = @import("backend/eigen.zig");
+
+/// Selected with `zig build -Deigen-math=true`, defaults to native
+pub const selected: Backend = if (build_options.eigen_math) .eigen else .native;
+
+/// The implementation Vec*f and Mat4f forward to
+pub const active = switch (selected) {
+    .native => native,
+    .eigen => eigen,
+};
@@ -0,0 +1,180 @@
+// math/backend/eigen.zig - math backend that forwards to the Eigen C++ wrapper
+
+const eigen = @cImport({
+    @cInclude("Eigen/eigen_wrapper.h");
+});
+
+const eigen_interface = @import("../eigen.zig");
+
+const Vec2f = @import("../vector.zig").Vec2f;
+const Vec3f = @import("../vector.zig").Vec3f;
+const Vec4f = @import("../vector.zig").Vec4f;
+const Mat3f = @import("../matrix.zig").Mat3f;
+const Mat4f = @import("../matrix.zig").Mat4f;
+const Affine3x4 = @import("../affine.zig").Affine3x4;
+
+
+
+// ============================================================
+// Public API: Vec2 Implementations
+// ============================================================
+
+pub inline fn vec2Normalize(v: Vec2f) Vec2f {
+    return eigen_interface.fromEigenVec2f(eigen.vec2fNormalize(eigen_interface.toEigenVec2f(v)));
+}
+
+pub inline fn vec2Length(v: Vec2f) f32 {
+    return eigen.vec2fLength(eigen_interface.toEigenVec2f(v));
+}
+
+pub inline fn vec2LengthSquared(v: Vec2f) f32 {
+    return eigen.vec2fLengthSquared(eigen_interface.toEigenVec2f(v));
+}
+
+pub inline fn vec2Distance(a: Vec2f, b: Vec2f) f32 {
+    return eigen.vec2fDistance(eigen_interface.toEigenVec2f(a), eigen_interface.toEigenVec2f(b));
+}
+
+
+
+
+// ============================================================
+// Public API: Vec3 Implementations
+// ============================================================
+
+pub inline fn vec3Add(a: Vec3f, b: Vec3f) Vec3f {
+    return eigen_interface.fromEigenVec3f(eigen.vec3fAdd(eigen_interface.toEigenVec3f(a), eigen_interface.toEigenVec3f(b)));
+}
+
+pub inline fn vec3Subtract(a: Vec3f, b: Vec3f) Vec3f {
+    return eigen_interface.fromEigenVec3f(eigen.vec3fSubtract(eigen_interface.toEigenVec3f(a), eigen_interface.toEigenVec3f(b)));
+}
+
+pub inline fn vec3Scale(v: Vec3f, scalar: f32) Vec3f {
+    return eigen_interface.fromEigenVec3f(eigen.vec3fScale(eigen_interface.toEigenVec3f(v), scalar));
+}
+
+pub inline fn vec3Cross(a: Vec3f, b: Vec3f) Vec3f {
+    return eigen_interface.fromEigenVec3f(eigen.vec3fCross(eigen_interface.toEigenVec3f(a), eigen_interface.toEigenVec3f(b)));
+}
+
+pub inline fn vec3Normalize(v: Vec3f) Vec3f {
+    return eigen_interface.fromEigenVec3f(eigen.vec3fNormalize(eigen_interface.toEigenVec3f(v)));
+}
+
+pub inline fn vec3Dot(a: Vec3f, b: Vec3f) f32 {
+    return eigen.vec3fDot(eigen_interface.toEigenVec3f(a), eigen_interface.toEigenVec3f(b));
+}
+
+pub inline fn vec3Length(v: Vec3f) f32 {
+    return eigen.vec3fLength(eigen_interface.toEigenVec3f(v));
+}
+
+pub inline fn vec3LengthSquared(v: Vec3f) f32 {
+    return eigen.vec3fLengthSquared(eigen_interface.toEigenVec3f(v));
+}
+
+pub inline fn vec3Distance(a: Vec3f, b: Vec3f) f32 {
+    return eigen.vec3fDistance(eigen_interface.toEigenVec3f(a), eigen_interface.toEigenVec3f(b));
+}
+
+pub inline fn vec3Slerp(a: Vec3f, b: Vec3f, t: f32) Vec3f {
+    return eigen_interface.fromEigenVec3f(eigen.vec3fSlerp(eigen_interface.toEigenVec3f(a), eigen_interface.toEigenVec3f(b), t));
+}
+
+
+
+
+// ============================================================
+// Public API: Vec4 Implementations
+// ============================================================
+
+pub inline fn vec4Add(a: Vec4f, b: Vec4f) Vec4f {
+    return eigen_interface.fromEigenVec4f(eigen.vec4fAdd(eigen_interface.toEigenVec4f(a), eigen_interface.toEigenVec4f(b)));
+}
+
+pub inline fn vec4Subtract(a: Vec4f, b: Vec4f) Vec4f {
+    return eigen_interface.fromEigenVec4f(eigen.vec4fSubtract(eigen_interface.toEigenVec4f(a), eigen_interface.toEigenVec4f(b)));
+}
+
+pub inline fn vec4Scale(v: Vec4f, scalar: f32) Vec4f {
+    return eigen_interface.fromEigenVec4f(eigen.vec4fScale(eigen_interface.toEigenVec4f(v), scalar));
+}
+
+pub inline fn vec4Normalize(v: Vec4f) Vec4f {
+    return eigen_interface.fromEigenVec4f(eigen.vec4fNormalize(eigen_interface.toEigenVec4f(v)));
+}
+
+pub inline fn vec4Dot(a: Vec4f, b: Vec4f) f32 {
+    return eigen.vec4fDot(eigen_interface.toEigenVec4f(a), eigen_interface.toEigenVec4f(b));
+}
+
+pub inline fn vec4Length(v: Vec4f) f32 {
+    return eigen.vec4fLength(eigen_interface.toEigenVec4f(v));
+}
+
+pub inline fn vec4LengthSquared(v: Vec4f) f32 {
+    return eigen.vec4fLengthSquared(eigen_interface.toEigenVec4f(v));
+}
+
+
+
+
+// ============================================================
+// Public API: Mat4 Implementations
+// ============================================================
+
+pub inline fn mat4Identity(out: *Mat4f) void {
+    eigen.mat4fIdentity(&out.data);
+}
+
+pub inline fn mat4Multiply(a: *const Mat4f, b: *const Mat4f, out: *Mat4f) void {
+    eigen.mat4fMultiply(&a.data, &b.data, &out.data);
+}
+
+pub inline fn mat4LookAt(eye: Vec3f, center: Vec3f, up: Vec3f, out: *Mat4f) void {
+    eigen.mat4fLookAt(eigen_interface.toEigenVec3f(eye), eigen_interface.toEigenVec3f(center), eigen_interface.toEigenVec3f(up), &out.data);
+}
+
+pub inline fn mat4Perspective(fov: f32, aspect: f32, near: f32, far: f32, out: *Mat4f) void {
+    eigen.mat4fPerspective(fov, aspect, near, far, &out.data);
+}
+
+pub inline fn mat4Ortho(left: f32, right: f32, bottom: f32, top: f32, near: f32, far: f32, out: *Mat4f) void {
+    eigen.mat4fOrtho(left, right, bottom, top, near, far, &out.data);
+}
+
+pub inline fn mat4TransformPoint(mat: *const Mat4f, point: Vec3f) Vec3f {
+    return eigen_interface.fromEigenVec3f(eigen.mat4fTransformPoint(&mat.data, eigen_interface.toEigenVec3f(point)));
+}
+
+pub inline fn mat4TransformDirection(mat: *const Mat4f, dir: Vec3f) Vec3f {
+    return eigen_interface.fromEigenVec3f(eigen.mat4fTransformDirection(&mat.data, eigen_interface.toEigenVec3f(dir)));
+}
+
+pub inline fn mat4Inverse(mat: *const Mat4f, out: *Mat4f) bool {
+    return eigen.mat4fInverse(&mat.data, &out.data) != 0;
+}
+
+pub inline fn mat4AffineInverse(mat: *const Mat4f, out: *Mat4f) bool {
+    return eigen.mat4fAffineInverse(&mat.data, &out.data) != 0;
+}
+
+pub inline fn mat4NormalMatrix(mat: *const Mat4f, out: *Mat3f) void {
+    eigen.mat4fNormalMatrix(&mat.data, &out.data);
+}
+
+
+
+
+// ============================================================
+// Public API: Affine 3x4 Implementations
+// ============================================================
+
+pub inline fn affineMultiply(a: *const Affine3x4, b: *const Affine3x4, out: *Affine3x4) void {
+    eigen.affine3x4Multiply(&a.data, &b.data, &out.data);
+}
+
+pub inline fn affineInverse(mat: *const Affine3x4, out: *Affine3x4) bool {
+    return eigen.affine3x4Inverse(&mat.data, &out.data) != 0;
+}
@@ -0,0 +1,444 @@
+// math/backend/native.zig - pure Zig math backend built on @Vector(4, f32)
+
+const std = @import("std");
+const math = std.math;
+
+const Vec2f = @import("../vector.zig").Vec2f;
+const Vec3f = @import("../vector.zig").Vec3f;
+const Vec4f = @import("../vector.zig").Vec4f;
+const Mat3f = @import("../matrix.zig").Mat3f;
+const Mat4f = @import("../matrix.zig").Mat4f;
+const Affine3x4 = @import("../affine.zig").Affine3x4;
+
+const V4 = @Vector(4, f32);
+
+
+
+// ============================================================
+// Private Helpers: Lane Conversion
+// ============================================================
+
+// Vec3f is widened with w = 0 so the extra lane never affects dot products or lengths
+inline fn load3(v: Vec3f) V4 {
+    return .{ v.x, v.y, v.z, 0 };
+}
+
+inline fn store3(v: V4) Vec3f {
+    return .{ .x = v[0], .y = v[1], .z = v[2] };
+}
+
+inline fn load4(v: Vec4f) V4 {
+    return .{ v.x, v.y, v.z, v.w };
+}
+
+inline fn store4(v: V4) Vec4f {
+    return .{ .x = v[0], .y = v[1], .z = v[2], .w = v[3] };
+}
+
+inline fn column(m: *const Mat4f, comptime i: usize) V4 {
+    return m.data[i * 4 ..][0..4].*;
+}
+
+/// Upper 3x3 column with the w lane cleared
+inline fn column3(m: *const Mat4f, comptime i: usize) V4 {
+    return .{ m.data[i * 4], m.data[i * 4 + 1], m.data[i * 4 + 2], 0 };
+}
+
+inline fn splat(s: f32) V4 {
+    return @splat(s);
+}
+
+/// Normalize like Eigen's normalized(): a zero vector is returned unchanged
+inline fn normalizeLanes(v: V4) V4 {
+    const len_sq = @reduce(.Add, v * v);
+    if (len_sq <= 0) return v;
+    return v * splat(1.0 / @sqrt(len_sq));
+}
+
+inline fn cross3(a: V4, b: V4) V4 {
+    const yzx = [4]i32{ 1, 2, 0, 3 };
+    const zxy = [4]i32{ 2, 0, 1, 3 };
+    return @shuffle(f32, a, undefined, yzx) * @shuffle(f32, b, undefined, zxy) -
+        @shuffle(f32, a, undefined, zxy) * @shuffle(f32, b, undefined, yzx);
+}
+
+
+
+
+// ============================================================
+// Public API: Vec2 Implementations
+// ============================================================
+
+pub inline fn vec2Normalize(v: Vec2f) Vec2f {
+    const len_sq = v.x * v.x + v.y * v.y;
+    if (len_sq <= 0) return v;
+    const inv_len = 1.0 / @sqrt(len_sq);
+    return .{ .x = v.x * inv_len, .y = v.y * inv_len };
+}
+
+pub inline fn vec2Length(v: Vec2f) f32 {
+    return @sqrt(v.x * v.x + v.y * v.y);
+}
+
+pub inline fn vec2LengthSquared(v: Vec2f) f32 {
+    return v.x * v.x + v.y * v.y;
+}
+
+pub inline fn vec2Distance(a: Vec2f, b: Vec2f) f32 {
+    return vec2Length(.{ .x = a.x - b.x, .y = a.y - b.y });
+}
+
+
+
+
+// ============================================================
+// Public API: Vec3 Implementations
+// ============================================================
+
+pub inline fn vec3Add(a: Vec3f, b: Vec3f) Vec3f {
+    return store3(load3(a) + load3(b));
+}
+
+pub inline fn vec3Subtract(a: Vec3f, b: Vec3f) Vec3f {
+    return store3(load3(a) - load3(b));
+}
+
+pub inline fn vec3Scale(v: Vec3f, scalar: f32) Vec3f {
+    return store3(load3(v) * splat(scalar));
+}
+
+pub inline fn vec3Cross(a: Vec3f, b: Vec3f) Vec3f {
+    return store3(cross3(load3(a), load3(b)));
+}
+
+pub inline fn vec3Normalize(v: Vec3f) Vec3f {
+    return store3(normalizeLanes(load3(v)));
+}
+
+pub inline fn vec3Dot(a: Vec3f, b: Vec3f) f32 {
+    return @reduce(.Add, load3(a) * load3(b));
+}
+
+pub inline fn vec3Length(v: Vec3f) f32 {
+    return @sqrt(vec3LengthSquared(v));
+}
+
+pub inline fn vec3LengthSquared(v: Vec3f) f32 {
+    const lanes = load3(v);
+    return @reduce(.Add, lanes * lanes);
+}
+
+pub inline fn vec3Distance(a: Vec3f, b: Vec3f) f32 {
+    return vec3Length(vec3Subtract(a, b));
+}
+
+/// Spherical interpolation that also interpolates the magnitude, same as the Eigen version
+pub fn vec3Slerp(a: Vec3f, b: Vec3f, t: f32) Vec3f {
+    const va = load3(a);
+    const vb = load3(b);
+
+    const mag_a = @sqrt(@reduce(.Add, va * va));
+    const mag_b = @sqrt(@reduce(.Add, vb * vb));
+
+    const va_norm = normalizeLanes(va);
+    const vb_norm = normalizeLanes(vb);
+    const dotp = math.clamp(@reduce(.Add, va_norm * vb_norm), -1.0, 1.0);
+
+    // Nearly parallel, fall back to linear interpolation
+    if (dotp > 0.9995) {
+        return store3(va + splat(t) * (vb - va));
+    }
+
+    const theta = math.acos(dotp) * t;
+    const relative = normalizeLanes(vb_norm - va_norm * splat(dotp));
+    const result = va_norm * splat(@cos(theta)) + relative * splat(@sin(theta));
+
+    const mag = mag_a + t * (mag_b - mag_a);
+    return store3(normalizeLanes(result) * splat(mag));
+}
+
+
+
+
+// ============================================================
+// Public API: Vec4 Implementations
+// ============================================================
+
+pub inline fn vec4Add(a: Vec4f, b: Vec4f) Vec4f {
+    return store4(load4(a) + load4(b));
+}
+
+pub inline fn vec4Subtract(a: Vec4f, b: Vec4f) Vec4f {
+    return store4(load4(a) - load4(b));
+}
+
+pub inline fn vec4Scale(v: Vec4f, scalar: f32) Vec4f {
+    return store4(load4(v) * splat(scalar));
+}
+
+pub inline fn vec4Normalize(v: Vec4f) Vec4f {
+    return store4(normalizeLanes(load4(v)));
+}
+
+pub inline fn vec4Dot(a: Vec4f, b: Vec4f) f32 {
+    return @reduce(.Add, load4(a) * load4(b));
+}
+
+pub inline fn vec4Length(v: Vec4f) f32 {
+    return @sqrt(vec4LengthSquared(v));
+}
+
+pub inline fn vec4LengthSquared(v: Vec4f) f32 {
+    const lanes = load4(v);
+    return @reduce(.Add, lanes * lanes);
+}
+
+
+
+
+// ============================================================
+// Public API: Mat4 Implementations
+// ============================================================
+
+pub inline fn mat4Identity(out: *Mat4f) void {
+    out.data = .{
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1,
+    };
+}
+
+/// out = a * b, column by column. `out` may alias either input
+pub inline fn mat4Multiply(a: *const Mat4f, b: *const Mat4f, out: *Mat4f) void {
+    const a0 = column(a, 0);
+    const a1 = column(a, 1);
+    const a2 = column(a, 2);
+    const a3 = column(a, 3);
+
+    var result: [16]f32 align(16) = undefined;
+    inline for (0..4) |j| {
+        const b_col = column(b, j);
+        const col = a0 * splat(b_col[0]) + a1 * splat(b_col[1]) + a2 * splat(b_col[2]) + a3 * splat(b_col[3]);
+        result[j * 4 ..][0..4].* = col;
+    }
+    out.data = result;
+}
+
+pub inline fn mat4LookAt(eye: Vec3f, center: Vec3f, up: Vec3f, out: *Mat4f) void {
+    const e = load3(eye);
+    const f = normalizeLanes(load3(center) - e); // forward
+    const s = normalizeLanes(cross3(f, load3(up))); // right
+    const u = cross3(s, f); // up
+
+    // Rows are the camera basis, storage is column-major
+    out.data = .{
+        s[0], u[0], -f[0], 0,
+        s[1], u[1], -f[1], 0,
+        s[2], u[2], -f[2], 0,
+        -@reduce(.Add, s * e), -@reduce(.Add, u * e), @reduce(.Add, f * e), 1,
+    };
+}
+
+pub inline fn mat4Perspective(fov: f32, aspect: f32, near: f32, far: f32, out: *Mat4f) void {
+    const tan_half_fov = @tan(fov / 2.0);
+    const range = far - near;
+
+    out.data = .{
+        1.0 / (aspect * tan_half_fov), 0, 0, 0,
+        0, 1.0 / tan_half_fov, 0, 0,
+        0, 0, -(far + near) / range, -1,
+        0, 0, -(2.0 * far * near) / range, 0,
+    };
+}
+
+pub inline fn mat4Ortho(left: f32, right: f32, bottom: f32, top: f32, near: f32, far: f32, out: *Mat4f) void {
+    const width = right - left;
+    const height = top - bottom;
+    const depth = far - near;
+
+    out.data = .{
+        2.0 / width, 0, 0, 0,
+        0, 2.0 / height, 0, 0,
+        0, 0, -2.0 / depth, 0,
+        -(right + left) / width, -(top + bottom) / height, -(far + near) / depth, 1,
+    };
+}
+
+pub inline fn mat4TransformPoint(mat: *const Mat4f, point: Vec3f) Vec3f {
+    var result = column(mat, 0) * splat(point.x) + column(mat, 1) * splat(point.y) +
+        column(mat, 2) * splat(point.z) + column(mat, 3);
+
+    // Perspective division if needed
+    if (result[3] != 1.0 and result[3] != 0.0) {
+        result /= splat(result[3]);
+    }
+    return store3(result);
+}
+
+pub inline fn mat4TransformDirection(mat: *const Mat4f, dir: Vec3f) Vec3f {
+    return store3(column(mat, 0) * splat(dir.x) + column(mat, 1) * splat(dir.y) + column(mat, 2) * splat(dir.z));
+}
+
+/// General 4x4 inverse by 2x2 sub-determinants, returns false if the matrix is singular
+pub fn mat4Inverse(mat: *const Mat4f, out: *Mat4f) bool {
+    const m = &mat.data;
+
+    // a(row, col) over column-major storage
+    const a = struct {
+        inline fn at(d: *const [16]f32, comptime r: usize, comptime col: usize) f32 {
+            return d[col * 4 + r];
+        }
+    }.at;
+
+    const s0 = a(m, 0, 0) * a(m, 1, 1) - a(m, 1, 0) * a(m, 0, 1);
+    const s1 = a(m, 0, 0) * a(m, 1, 2) - a(m, 1, 0) * a(m, 0, 2);
+    const s2 = a(m, 0, 0) * a(m, 1, 3) - a(m, 1, 0) * a(m, 0, 3);
+    const s3 = a(m, 0, 1) * a(m, 1, 2) - a(m, 1, 1) * a(m, 0, 2);
+    const s4 = a(m, 0, 1) * a(m, 1, 3) - a(m, 1, 1) * a(m, 0, 3);
+    const s5 = a(m, 0, 2) * a(m, 1, 3) - a(m, 1, 2) * a(m, 0, 3);
+
+    const c5 = a(m, 2, 2) * a(m, 3, 3) - a(m, 3, 2) * a(m, 2, 3);
+    const c4 = a(m, 2, 1) * a(m, 3, 3) - a(m, 3, 1) * a(m, 2, 3);
+    const c3 = a(m, 2, 1) * a(m, 3, 2) - a(m, 3, 1) * a(m, 2, 2);
+    const c2 = a(m, 2, 0) * a(m, 3, 3) - a(m, 3, 0) * a(m, 2, 3);
+    const c1 = a(m, 2, 0) * a(m, 3, 2) - a(m, 3, 0) * a(m, 2, 2);
+    const c0 = a(m, 2, 0) * a(m, 3, 1) - a(m, 3, 0) * a(m, 2, 1);
+
+    const det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (det == 0) return false;
+    const d = 1.0 / det;
+
+    // Built into a local first so `out` may alias `mat`
+    const result: [16]f32 align(16) = .{
+        (a(m, 1, 1) * c5 - a(m, 1, 2) * c4 + a(m, 1, 3) * c3) * d,
+        (-a(m, 1, 0) * c5 + a(m, 1, 2) * c2 - a(m, 1, 3) * c1) * d,
+        (a(m, 1, 0) * c4 - a(m, 1, 1) * c2 + a(m, 1, 3) * c0) * d,
+        (-a(m, 1, 0) * c3 + a(m, 1, 1) * c1 - a(m, 1, 2) * c0) * d,
+
+        (-a(m, 0, 1) * c5 + a(m, 0, 2) * c4 - a(m, 0, 3) * c3) * d,
+        (a(m, 0, 0) * c5 - a(m, 0, 2) * c2 + a(m, 0, 3) * c1) * d,
+        (-a(m, 0, 0) * c4 + a(m, 0, 1) * c2 - a(m, 0, 3) * c0) * d,
+        (a(m, 0, 0) * c3 - a(m, 0, 1) * c1 + a(m, 0, 2) * c0) * d,
+
+        (a(m, 3, 1) * s5 - a(m, 3, 2) * s4 + a(m, 3, 3) * s3) * d,
+        (-a(m, 3, 0) * s5 + a(m, 3, 2) * s2 - a(m, 3, 3) * s1) * d,
+        (a(m, 3, 0) * s4 - a(m, 3, 1) * s2 + a(m, 3, 3) * s0) * d,
+        (-a(m, 3, 0) * s3 + a(m, 3, 1) * s1 - a(m, 3, 2) * s0) * d,
+
+        (-a(m, 2, 1) * s5 + a(m, 2, 2) * s4 - a(m, 2, 3) * s3) * d,
+        (a(m, 2, 0) * s5 - a(m, 2, 2) * s2 + a(m, 2, 3) * s1) * d,
+        (-a(m, 2, 0) * s4 + a(m, 2, 1) * s2 - a(m, 2, 3) * s0) * d,
+        (a(m, 2, 0) * s3 - a(m, 2, 1) * s1 + a(m, 2, 2) * s0) * d,
+    };
+    out.data = result;
+    return true;
+}
+
+/// Inverse of a matrix whose bottom row is (0, 0, 0, 1), returns false if the upper 3x3 is singular
+pub inline fn mat4AffineInverse(mat: *const Mat4f, out: *Mat4f) bool {
+    const c0 = column3(mat, 0);
+    const c1 = column3(mat, 1);
+    const c2 = column3(mat, 2);
+    const t = column3(mat, 3);
+
+    // Rows of the 3x3 inverse are the cofactor columns divided by the determinant
+    const r0 = cross3(c1, c2);
+    const r1 = cross3(c2, c0);
+    const r2 = cross3(c0, c1);
+    const det = @reduce(.Add, c0 * r0);
+    if (det == 0) return false;
+
+    const d = splat(1.0 / det);
+    const x = r0 * d;
+    const y = r1 * d;
+    const z = r2 * d;
+
+    out.data = .{
+        x[0], y[0], z[0], 0,
+        x[1], y[1], z[1], 0,
+        x[2], y[2], z[2], 0,
+        -@reduce(.Add, x * t), -@reduce(.Add, y * t), -@reduce(.Add, z * t), 1,
+    };
+    return true;
+}
+
+/// Inverse-transpose of the upper 3x3, falls back to the cofactor matrix when singular
+pub inline fn mat4NormalMatrix(mat: *const Mat4f, out: *Mat3f) void {
+    const c0 = column3(mat, 0);
+    const c1 = column3(mat, 1);
+    const c2 = column3(mat, 2);
+
+    var x = cross3(c1, c2);
+    var y = cross3(c2, c0);
+    var z = cross3(c0, c1);
+
+    const det = @reduce(.Add, c0 * x);
+    if (det != 0) {
+        const d = splat(1.0 / det);
+        x *= d;
+        y *= d;
+        z *= d;
+    }
+
+    out.data = .{
+        x[0], x[1], x[2],
+        y[0], y[1], y[2],
+        z[0], z[1], z[2],
+    };
+}
+
+
+
+
+// ============================================================
+// Public API: Affine 3x4 Implementations
+// ============================================================
+
+inline fn row(m: *const Affine3x4, comptime i: usize) V4 {
+    return m.data[i * 4 ..][0..4].*;
+}
+
+/// out = a * b row by row, the implicit bottom rows only add a's translation. `out` may alias either input
+pub inline fn affineMultiply(a: *const Affine3x4, b: *const Affine3x4, out: *Affine3x4) void {
+    const b0 = row(b, 0);
+    const b1 = row(b, 1);
+    const b2 = row(b, 2);
+
+    var result: [12]f32 align(16) = undefined;
+    inline for (0..3) |i| {
+        const a_row = row(a, i);
+        const r = splat(a_row[0]) * b0 + splat(a_row[1]) * b1 + splat(a_row[2]) * b2 + V4{ 0, 0, 0, a_row[3] };
+        result[i * 4 ..][0..4].* = r;
+    }
+    out.data = result;
+}
+
+/// Inverse of the rotation-scale part with the translation moved into the new space
+/// Returns false if the upper 3x3 is singular
+pub inline fn affineInverse(mat: *const Affine3x4, out: *Affine3x4) bool {
+    const mask = V4{ 1, 1, 1, 0 };
+    const r0 = row(mat, 0) * mask;
+    const r1 = row(mat, 1) * mask;
+    const r2 = row(mat, 2) * mask;
+
+    // Columns of the inverse are crosses of the rows divided by the determinant
+    const x = cross3(r1, r2);
+    const y = cross3(r2, r0);
+    const z = cross3(r0, r1);
+    const det = @reduce(.Add, r0 * x);
+    if (det == 0) return false;
+
+    const d = splat(1.0 / det);
+    const ix = x * d;
+    const iy = y * d;
+    const iz = z * d;
+    const t = -(ix * splat(mat.data[3]) + iy * splat(mat.data[7]) + iz * splat(mat.data[11]));
+
+    out.data = .{
+        ix[0], iy[0], iz[0], t[0],
+        ix[1], iy[1], iz[1], t[1],
+        ix[2], iy[2], iz[2], t[2],
+    };
+    return true;
+}
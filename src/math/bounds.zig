@@ -0,0 +1,438 @@
+// math/bounds.zig - bounding volumes and view frustum tests
+
+const std = @import("std");
+
+const Vec3f = @import("vector.zig").Vec3f;
+const Mat4f = @import("matrix.zig").Mat4f;
+const Affine3x4 = @import("affine.zig").Affine3x4;
+
+const V4 = @Vector(4, f32);
+const V8 = @Vector(8, f32);
+
+/// Volumes tested per step by the batched culling kernels: 16 with AVX-512, 8 with AVX, 4 with SSE or NEON
+pub const cull_lanes = std.simd.suggestVectorLength(f32) orelse 4;
+const VL = @Vector(cull_lanes, f32);
+const LaneMask = std.meta.Int(.unsigned, cull_lanes);
+
+comptime {
+    if (64 % cull_lanes != 0) @compileError("the bits of one culling step have to stay within a mask word");
+}
+
+// ============================================================
+// Public API: Bounding Box
+// ============================================================
+
+/// Axis-aligned bounding box
+pub const BoundingBox = extern struct {
+    min: Vec3f,
+    max: Vec3f,
+
+    /// Contains nothing, merging anything into it yields that thing
+    pub const empty = BoundingBox{
+        .min = .{ .x = std.math.inf(f32), .y = std.math.inf(f32), .z = std.math.inf(f32) },
+        .max = .{ .x = -std.math.inf(f32), .y = -std.math.inf(f32), .z = -std.math.inf(f32) },
+    };
+
+    /// Bounds of interleaved vertex data whose first three floats per vertex are the position
+    pub fn fromVertices(data: []const f32, floats_per_vertex: usize) BoundingBox {
+        std.debug.assert(floats_per_vertex >= 3);
+
+        var result = empty;
+        var i: usize = 0;
+        while (i + 3 <= data.len) : (i += floats_per_vertex) {
+            result = result.include(.{ .x = data[i], .y = data[i + 1], .z = data[i + 2] });
+        }
+        return result;
+    }
+
+    pub fn isEmpty(self: BoundingBox) bool {
+        return self.min.x > self.max.x or self.min.y > self.max.y or self.min.z > self.max.z;
+    }
+
+    pub fn include(self: BoundingBox, point: Vec3f) BoundingBox {
+        return .{
+            .min = .{ .x = @min(self.min.x, point.x), .y = @min(self.min.y, point.y), .z = @min(self.min.z, point.z) },
+            .max = .{ .x = @max(self.max.x, point.x), .y = @max(self.max.y, point.y), .z = @max(self.max.z, point.z) },
+        };
+    }
+
+    pub fn merge(a: BoundingBox, b: BoundingBox) BoundingBox {
+        return a.include(b.min).include(b.max);
+    }
+
+    pub fn center(self: BoundingBox) Vec3f {
+        return .{
+            .x = (self.min.x + self.max.x) * 0.5,
+            .y = (self.min.y + self.max.y) * 0.5,
+            .z = (self.min.z + self.max.z) * 0.5,
+        };
+    }
+
+    pub fn halfExtents(self: BoundingBox) Vec3f {
+        return .{
+            .x = (self.max.x - self.min.x) * 0.5,
+            .y = (self.max.y - self.min.y) * 0.5,
+            .z = (self.max.z - self.min.z) * 0.5,
+        };
+    }
+
+    /// Radius of the sphere around `center` that contains the box
+    pub fn radius(self: BoundingBox) f32 {
+        return self.halfExtents().length();
+    }
+
+    pub fn surfaceArea(self: BoundingBox) f32 {
+        const dx = self.max.x - self.min.x;
+        const dy = self.max.y - self.min.y;
+        const dz = self.max.z - self.min.z;
+        return 2.0 * (dx * dy + dy * dz + dz * dx);
+    }
+
+    /// Grow every side by `margin`
+    pub fn expanded(self: BoundingBox, margin: f32) BoundingBox {
+        return .{
+            .min = .{ .x = self.min.x - margin, .y = self.min.y - margin, .z = self.min.z - margin },
+            .max = .{ .x = self.max.x + margin, .y = self.max.y + margin, .z = self.max.z + margin },
+        };
+    }
+
+    /// True when `other` lies completely inside this box
+    pub fn contains(self: BoundingBox, other: BoundingBox) bool {
+        return self.min.x <= other.min.x and self.min.y <= other.min.y and self.min.z <= other.min.z and
+            self.max.x >= other.max.x and self.max.y >= other.max.y and self.max.z >= other.max.z;
+    }
+
+    pub fn overlaps(a: BoundingBox, b: BoundingBox) bool {
+        return a.min.x <= b.max.x and a.max.x >= b.min.x and
+            a.min.y <= b.max.y and a.max.y >= b.min.y and
+            a.min.z <= b.max.z and a.max.z >= b.min.z;
+    }
+
+    pub fn overlapsSphere(self: BoundingBox, sphere_center: Vec3f, sphere_radius: f32) bool {
+        // Distance from the center to the closest point of the box
+        const dx = sphere_center.x - std.math.clamp(sphere_center.x, self.min.x, self.max.x);
+        const dy = sphere_center.y - std.math.clamp(sphere_center.y, self.min.y, self.max.y);
+        const dz = sphere_center.z - std.math.clamp(sphere_center.z, self.min.z, self.max.z);
+        return dx * dx + dy * dy + dz * dz <= sphere_radius * sphere_radius;
+    }
+
+    /// Distance along `ray` to where it enters the box, 0 when it starts inside, null on a miss
+    pub fn intersectRay(self: BoundingBox, ray: Ray, max_distance: f32) ?f32 {
+        const origin = [3]f32{ ray.origin.x, ray.origin.y, ray.origin.z };
+        const inv_dir = [3]f32{ ray.inv_direction.x, ray.inv_direction.y, ray.inv_direction.z };
+        const lo = [3]f32{ self.min.x, self.min.y, self.min.z };
+        const hi = [3]f32{ self.max.x, self.max.y, self.max.z };
+
+        // Slab test, infinite inverse directions sort themselves out through min/max
+        var t_enter: f32 = 0.0;
+        var t_exit: f32 = max_distance;
+        for (0..3) |axis| {
+            const t0 = (lo[axis] - origin[axis]) * inv_dir[axis];
+            const t1 = (hi[axis] - origin[axis]) * inv_dir[axis];
+            t_enter = @max(t_enter, @min(t0, t1));
+            t_exit = @min(t_exit, @max(t0, t1));
+        }
+        return if (t_enter <= t_exit) t_enter else null;
+    }
+
+    /// Box around this box after `world` moves it, tight for rotations, scales and translations
+    pub fn transformed(self: BoundingBox, world: *const Mat4f) BoundingBox {
+        if (self.isEmpty()) return self;
+
+        const c = self.center();
+        const e = self.halfExtents();
+        const col0: V4 = world.data[0..4].*;
+        const col1: V4 = world.data[4..8].*;
+        const col2: V4 = world.data[8..12].*;
+        const col3: V4 = world.data[12..16].*;
+
+        const new_center = col0 * splat(c.x) + col1 * splat(c.y) + col2 * splat(c.z) + col3;
+        const new_extent = @abs(col0) * splat(e.x) + @abs(col1) * splat(e.y) + @abs(col2) * splat(e.z);
+
+        const lo = new_center - new_extent;
+        const hi = new_center + new_extent;
+        return .{
+            .min = .{ .x = lo[0], .y = lo[1], .z = lo[2] },
+            .max = .{ .x = hi[0], .y = hi[1], .z = hi[2] },
+        };
+    }
+
+    /// transformed for an affine 3x4 matrix, one row per output axis
+    pub fn transformedAffine(self: BoundingBox, world: *const Affine3x4) BoundingBox {
+        if (self.isEmpty()) return self;
+
+        const c = self.center();
+        const e = self.halfExtents();
+        const center4 = V4{ c.x, c.y, c.z, 1 };
+        const extent4 = V4{ e.x, e.y, e.z, 0 };
+
+        var lo: V4 = undefined;
+        var hi: V4 = undefined;
+        inline for (0..3) |i| {
+            const r = world.row(i);
+            const new_center = @reduce(.Add, r * center4);
+            const new_extent = @reduce(.Add, @abs(r) * extent4);
+            lo[i] = new_center - new_extent;
+            hi[i] = new_center + new_extent;
+        }
+        return .{
+            .min = .{ .x = lo[0], .y = lo[1], .z = lo[2] },
+            .max = .{ .x = hi[0], .y = hi[1], .z = hi[2] },
+        };
+    }
+};
+
+
+
+
+// ============================================================
+// Public API: Bounding Sphere
+// ============================================================
+
+pub const Sphere = extern struct {
+    center: Vec3f,
+    radius: f32,
+
+    pub fn fromBox(box: BoundingBox) Sphere {
+        return .{ .center = box.center(), .radius = box.radius() };
+    }
+};
+
+
+
+
+// ============================================================
+// Public API: Ray
+// ============================================================
+
+/// Half-line with a unit direction, the inverse is cached for slab tests
+pub const Ray = struct {
+    origin: Vec3f,
+    direction: Vec3f,
+    inv_direction: Vec3f,
+
+    pub fn init(origin: Vec3f, direction: Vec3f) Ray {
+        const dir = direction.normalize();
+        return .{
+            .origin = origin,
+            .direction = dir,
+            .inv_direction = .{ .x = 1.0 / dir.x, .y = 1.0 / dir.y, .z = 1.0 / dir.z },
+        };
+    }
+
+    pub fn at(self: Ray, distance: f32) Vec3f {
+        return self.origin.add(self.direction.scale(distance));
+    }
+};
+
+
+
+
+// ============================================================
+// Public API: Frustum
+// ============================================================
+
+/// Where a volume lies relative to a frustum
+pub const Containment = enum { outside, intersecting, inside };
+
+
+/// The six planes of a view-projection matrix, normals point inwards
+/// Stored as plane components across lanes so one box is tested against all planes at once
+pub const Frustum = struct {
+    /// Lanes 6 and 7 hold a plane every point is inside of
+    nx: V8,
+    ny: V8,
+    nz: V8,
+    d: V8,
+
+    /// Extract the planes of a column-major view-projection matrix (Gribb-Hartmann)
+    pub fn fromMatrix(view_projection: *const Mat4f) Frustum {
+        const m = &view_projection.data;
+        const row = struct {
+            fn get(data: *const [16]f32, i: usize) V4 {
+                return .{ data[i], data[4 + i], data[8 + i], data[12 + i] };
+            }
+        }.get;
+
+        const r0 = row(m, 0);
+        const r1 = row(m, 1);
+        const r2 = row(m, 2);
+        const r3 = row(m, 3);
+        const planes = [6]V4{ r3 + r0, r3 - r0, r3 + r1, r3 - r1, r3 + r2, r3 - r2 };
+
+        var result = Frustum{
+            .nx = @splat(0),
+            .ny = @splat(0),
+            .nz = @splat(0),
+            .d = @splat(1),
+        };
+        for (planes, 0..) |plane, i| {
+            const len = @sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+            const inv = if (len > 0) 1.0 / len else 0.0;
+            result.nx[i] = plane[0] * inv;
+            result.ny[i] = plane[1] * inv;
+            result.nz[i] = plane[2] * inv;
+            result.d[i] = plane[3] * inv;
+        }
+        return result;
+    }
+
+    /// False only when the box lies fully outside one plane, boxes near corners may pass
+    pub fn intersectsBox(self: *const Frustum, box: BoundingBox) bool {
+        const distance, const reach = self.boxDistances(box);
+        return !@reduce(.Or, distance + reach < splat8(0));
+    }
+
+    /// Like intersectsBox, but also tells whether the box is inside every plane
+    pub fn classifyBox(self: *const Frustum, box: BoundingBox) Containment {
+        const distance, const reach = self.boxDistances(box);
+        if (@reduce(.Or, distance + reach < splat8(0))) return .outside;
+        if (@reduce(.And, distance - reach >= splat8(0))) return .inside;
+        return .intersecting;
+    }
+
+    pub fn intersectsSphere(self: *const Frustum, sphere_center: Vec3f, sphere_radius: f32) bool {
+        const distance = self.nx * splat8(sphere_center.x) + self.ny * splat8(sphere_center.y) +
+            self.nz * splat8(sphere_center.z) + self.d;
+        return !@reduce(.Or, distance < splat8(-sphere_radius));
+    }
+
+    pub fn containsPoint(self: *const Frustum, point: Vec3f) bool {
+        return self.intersectsSphere(point, 0);
+    }
+
+    /// Batched intersectsBox, bit `i % 64` of `visible[i / 64]` is set when boxes[i] may be visible
+    /// `visible` needs maskWords(boxes.len) words, all of them are overwritten. Returns the visible count
+    pub fn cullBoxes(self: *const Frustum, boxes: []const BoundingBox, visible: []u64) usize {
+        const words = maskWords(boxes.len);
+        std.debug.assert(visible.len >= words);
+        @memset(visible[0..words], 0);
+
+        var count: usize = 0;
+        var start: usize = 0;
+        while (start < boxes.len) : (start += cull_lanes) {
+            const n = @min(cull_lanes, boxes.len - start);
+
+            // Transpose to one box per lane, a short last step repeats its final box
+            var lo_x: VL = undefined;
+            var lo_y: VL = undefined;
+            var lo_z: VL = undefined;
+            var hi_x: VL = undefined;
+            var hi_y: VL = undefined;
+            var hi_z: VL = undefined;
+            inline for (0..cull_lanes) |lane| {
+                const box = &boxes[start + @min(lane, n - 1)];
+                lo_x[lane] = box.min.x;
+                lo_y[lane] = box.min.y;
+                lo_z[lane] = box.min.z;
+                hi_x[lane] = box.max.x;
+                hi_y[lane] = box.max.y;
+                hi_z[lane] = box.max.z;
+            }
+            const half: VL = @splat(0.5);
+            const cx = (lo_x + hi_x) * half;
+            const cy = (lo_y + hi_y) * half;
+            const cz = (lo_z + hi_z) * half;
+            const ex = (hi_x - lo_x) * half;
+            const ey = (hi_y - lo_y) * half;
+            const ez = (hi_z - lo_z) * half;
+
+            var outside: LaneMask = 0;
+            inline for (0..6) |i| {
+                const nx: VL = @splat(self.nx[i]);
+                const ny: VL = @splat(self.ny[i]);
+                const nz: VL = @splat(self.nz[i]);
+                const distance = nx * cx + ny * cy + nz * cz + @as(VL, @splat(self.d[i]));
+                const reach = @abs(nx) * ex + @abs(ny) * ey + @abs(nz) * ez;
+                outside |= @as(LaneMask, @bitCast(distance + reach < @as(VL, @splat(0))));
+            }
+            count += storeMask(visible, start, n, ~outside);
+        }
+        return count;
+    }
+
+
+    /// Batched intersectsSphere with the same output as cullBoxes
+    pub fn cullSpheres(self: *const Frustum, spheres: []const Sphere, visible: []u64) usize {
+        const words = maskWords(spheres.len);
+        std.debug.assert(visible.len >= words);
+        @memset(visible[0..words], 0);
+
+        var count: usize = 0;
+        var start: usize = 0;
+        while (start < spheres.len) : (start += cull_lanes) {
+            const n = @min(cull_lanes, spheres.len - start);
+
+            var x: VL = undefined;
+            var y: VL = undefined;
+            var z: VL = undefined;
+            var r: VL = undefined;
+            inline for (0..cull_lanes) |lane| {
+                const sphere = &spheres[start + @min(lane, n - 1)];
+                x[lane] = sphere.center.x;
+                y[lane] = sphere.center.y;
+                z[lane] = sphere.center.z;
+                r[lane] = sphere.radius;
+            }
+
+            var outside: LaneMask = 0;
+            inline for (0..6) |i| {
+                const distance = @as(VL, @splat(self.nx[i])) * x + @as(VL, @splat(self.ny[i])) * y +
+                    @as(VL, @splat(self.nz[i])) * z + @as(VL, @splat(self.d[i]));
+                outside |= @as(LaneMask, @bitCast(distance < -r));
+            }
+            count += storeMask(visible, start, n, ~outside);
+        }
+        return count;
+    }
+
+
+    /// Plane `index` as (normal, distance), e.g. for upload to a shader
+    pub fn plane(self: *const Frustum, index: usize) [4]f32 {
+        std.debug.assert(index < 6);
+        return .{ self.nx[index], self.ny[index], self.nz[index], self.d[index] };
+    }
+
+    /// Signed distance of the box center and projected radius of the box, per plane
+    fn boxDistances(self: *const Frustum, box: BoundingBox) struct { V8, V8 } {
+        const c = box.center();
+        const e = box.halfExtents();
+
+        const distance = self.nx * splat8(c.x) + self.ny * splat8(c.y) + self.nz * splat8(c.z) + self.d;
+        const reach = @abs(self.nx) * splat8(e.x) + @abs(self.ny) * splat8(e.y) + @abs(self.nz) * splat8(e.z);
+        return .{ distance, reach };
+    }
+};
+
+
+/// Words of a cullBoxes/cullSpheres mask for `count` volumes
+pub fn maskWords(count: usize) usize {
+    return (count + 63) / 64;
+}
+
+
+pub fn maskIsSet(visible: []const u64, index: usize) bool {
+    return (visible[index / 64] >> @intCast(index % 64)) & 1 != 0;
+}
+
+
+// ============================================================
+// Private Helpers
+// ============================================================
+
+/// Or the first `n` bits of `bits` into the mask at `start`, returns how many were set
+inline fn storeMask(visible: []u64, start: usize, n: usize, bits: LaneMask) usize {
+    const valid: LaneMask = if (n == cull_lanes) ~@as(LaneMask, 0) else (@as(LaneMask, 1) << @intCast(n)) - 1;
+    const set = bits & valid;
+    visible[start / 64] |= @as(u64, set) << @intCast(start % 64);
+    return @popCount(set);
+}
+
+
+inline fn splat(v: f32) V4 {
+    return @splat(v);
+}
+
+inline fn splat8(v: f32) V8 {
+    return @splat(v);
+}
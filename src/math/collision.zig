@@ -0,0 +1,486 @@
+// math/collision.zig - collision shapes and overlap tests, scalar and batched over SIMD lanes
+
+const std = @import("std");
+
+const Vec3f = @import("vector.zig").Vec3f;
+const Affine3x4 = @import("affine.zig").Affine3x4;
+const BoundingBox = @import("bounds.zig").BoundingBox;
+
+/// f32 lanes per batched test
+pub const lanes = std.simd.suggestVectorLength(f32) orelse 8;
+const V = @Vector(lanes, f32);
+
+const identity_axes = [3]Vec3f{
+    .{ .x = 1.0, .y = 0.0, .z = 0.0 },
+    .{ .x = 0.0, .y = 1.0, .z = 0.0 },
+    .{ .x = 0.0, .y = 0.0, .z = 1.0 },
+};
+
+// ============================================================
+// Public API: Shapes
+// ============================================================
+
+pub const ShapeKind = enum(u8) { sphere, aabb, obb };
+
+/// Collision shape in the local space of its transform
+pub const Shape = union(ShapeKind) {
+    /// Radius, scaled by the largest axis scale
+    sphere: f32,
+    /// Half extents, stays axis aligned and grows to enclose the rotated box
+    aabb: Vec3f,
+    /// Half extents along the transform's axes
+    obb: Vec3f,
+};
+
+
+/// A shape placed in the world, AABBs and spheres keep the identity axes
+pub const WorldShape = struct {
+    kind: ShapeKind,
+    center: Vec3f,
+    /// Half extents along `axes`, the radius in every component for spheres
+    half: Vec3f,
+    axes: [3]Vec3f = identity_axes,
+
+    pub fn fromShape(shape: Shape, world: *const Affine3x4) WorldShape {
+        const m = &world.data;
+        const center = world.translation();
+        const columns = [3]Vec3f{
+            Vec3f.create(m[0], m[4], m[8]),
+            Vec3f.create(m[1], m[5], m[9]),
+            Vec3f.create(m[2], m[6], m[10]),
+        };
+        const scales = [3]f32{ columns[0].length(), columns[1].length(), columns[2].length() };
+
+        switch (shape) {
+            .sphere => |radius| {
+                const r = radius * @max(scales[0], @max(scales[1], scales[2]));
+                return .{ .kind = .sphere, .center = center, .half = Vec3f.create(r, r, r) };
+            },
+            .aabb => |half| {
+                // Each world extent is the box's extents projected onto that world axis
+                const h = [3]f32{ half.x, half.y, half.z };
+                var extent = [3]f32{ 0.0, 0.0, 0.0 };
+                for (columns, h) |column, component| {
+                    extent[0] += @abs(column.x) * component;
+                    extent[1] += @abs(column.y) * component;
+                    extent[2] += @abs(column.z) * component;
+                }
+                return .{ .kind = .aabb, .center = center, .half = Vec3f.create(extent[0], extent[1], extent[2]) };
+            },
+            .obb => |half| {
+                var axes = identity_axes;
+                for (&axes, columns, scales) |*axis, column, s| {
+                    if (s > 0.0) axis.* = column.scale(1.0 / s);
+                }
+                return .{
+                    .kind = .obb,
+                    .center = center,
+                    .half = Vec3f.create(half.x * scales[0], half.y * scales[1], half.z * scales[2]),
+                    .axes = axes,
+                };
+            },
+        }
+    }
+
+
+    /// Axis-aligned bounds for the broadphase
+    pub fn bounds(self: WorldShape) BoundingBox {
+        const h = [3]f32{ self.half.x, self.half.y, self.half.z };
+        var extent = [3]f32{ 0.0, 0.0, 0.0 };
+        for (self.axes, h) |axis, component| {
+            extent[0] += @abs(axis.x) * component;
+            extent[1] += @abs(axis.y) * component;
+            extent[2] += @abs(axis.z) * component;
+        }
+        const e = Vec3f.create(extent[0], extent[1], extent[2]);
+        return .{ .min = self.center.subtract(e), .max = self.center.add(e) };
+    }
+};
+
+
+/// Penetration of two overlapping shapes, `normal` points from the first toward the second
+pub const Hit = struct {
+    normal: Vec3f,
+    depth: f32,
+};
+
+
+/// Indices of two shapes a broadphase found overlapping
+pub const Pair = struct {
+    a: u32,
+    b: u32,
+};
+
+
+/// Which batched test a pair goes through
+pub const PairKind = enum(u8) {
+    sphere_sphere,
+    aabb_aabb,
+    /// The sphere is always `a`
+    sphere_box,
+    box_box,
+
+    pub const count = @typeInfo(PairKind).@"enum".fields.len;
+
+    pub fn of(a: ShapeKind, b: ShapeKind) PairKind {
+        if (a == .sphere and b == .sphere) return .sphere_sphere;
+        if (a == .aabb and b == .aabb) return .aabb_aabb;
+        if (a == .sphere or b == .sphere) return .sphere_box;
+        return .box_box;
+    }
+};
+
+
+// ============================================================
+// Public API: Scalar Tests
+// ============================================================
+
+/// Overlap of any two shapes, null when they are apart
+pub fn overlap(a: WorldShape, b: WorldShape) ?Hit {
+    return switch (PairKind.of(a.kind, b.kind)) {
+        .sphere_sphere => sphereSphere(a, b),
+        .aabb_aabb => aabbAabb(a, b),
+        .sphere_box => if (a.kind == .sphere) sphereBox(a, b) else flip(sphereBox(b, a)),
+        .box_box => boxBox(a, b),
+    };
+}
+
+
+pub fn sphereSphere(a: WorldShape, b: WorldShape) ?Hit {
+    const d = b.center.subtract(a.center);
+    const dist = d.length();
+    const depth = a.half.x + b.half.x - dist;
+    if (depth <= 0.0) return null;
+    return .{ .normal = if (dist > 1e-6) d.scale(1.0 / dist) else Vec3f.create(0.0, 1.0, 0.0), .depth = depth };
+}
+
+
+pub fn aabbAabb(a: WorldShape, b: WorldShape) ?Hit {
+    const d = [3]f32{ b.center.x - a.center.x, b.center.y - a.center.y, b.center.z - a.center.z };
+    const ha = [3]f32{ a.half.x, a.half.y, a.half.z };
+    const hb = [3]f32{ b.half.x, b.half.y, b.half.z };
+
+    var best: ?Hit = null;
+    for (0..3) |axis| {
+        const depth = ha[axis] + hb[axis] - @abs(d[axis]);
+        if (depth <= 0.0) return null;
+        if (best == null or depth < best.?.depth) {
+            best = .{ .normal = identity_axes[axis].scale(signOf(d[axis])), .depth = depth };
+        }
+    }
+    return best;
+}
+
+
+/// `sphere` against an AABB or OBB
+pub fn sphereBox(sphere: WorldShape, box: WorldShape) ?Hit {
+    const radius = sphere.half.x;
+    const h = [3]f32{ box.half.x, box.half.y, box.half.z };
+    const offset = sphere.center.subtract(box.center);
+
+    var closest = box.center;
+    var local: [3]f32 = undefined;
+    for (box.axes, h, 0..) |axis, half, k| {
+        local[k] = offset.dot(axis);
+        closest = closest.add(axis.scale(std.math.clamp(local[k], -half, half)));
+    }
+
+    const d = closest.subtract(sphere.center);
+    const dist_sq = d.lengthSquared();
+    if (dist_sq >= radius * radius) return null;
+    if (dist_sq > 1e-12) {
+        const dist = @sqrt(dist_sq);
+        return .{ .normal = d.scale(1.0 / dist), .depth = radius - dist };
+    }
+
+    // Center inside the box, leave through the nearest face
+    var axis_index: usize = 0;
+    var face_depth = h[0] - @abs(local[0]);
+    for (1..3) |k| {
+        const depth = h[k] - @abs(local[k]);
+        if (depth < face_depth) {
+            face_depth = depth;
+            axis_index = k;
+        }
+    }
+    return .{ .normal = box.axes[axis_index].scale(-signOf(local[axis_index])), .depth = radius + face_depth };
+}
+
+
+/// Separating axis test of two boxes, either may be an AABB
+pub fn boxBox(a: WorldShape, b: WorldShape) ?Hit {
+    const t = b.center.subtract(a.center);
+    const ha = [3]f32{ a.half.x, a.half.y, a.half.z };
+    const hb = [3]f32{ b.half.x, b.half.y, b.half.z };
+
+    var best = Hit{ .normal = Vec3f.create(0.0, 1.0, 0.0), .depth = std.math.inf(f32) };
+
+    // Face normals of both boxes, then the cross products of every edge pair
+    for (a.axes) |axis| {
+        if (!separationOn(axis, t, a.axes, ha, b.axes, hb, &best)) return null;
+    }
+    for (b.axes) |axis| {
+        if (!separationOn(axis, t, a.axes, ha, b.axes, hb, &best)) return null;
+    }
+    for (a.axes) |edge_a| {
+        for (b.axes) |edge_b| {
+            const axis = edge_a.cross(edge_b);
+            const len = axis.length();
+            // Parallel edges, the face axes already cover them
+            if (len < 1e-5) continue;
+            if (!separationOn(axis.scale(1.0 / len), t, a.axes, ha, b.axes, hb, &best)) return null;
+        }
+    }
+    return best;
+}
+
+
+// ============================================================
+// Public API: Batched Tests
+// ============================================================
+// Each tests `pairs` of one PairKind `lanes` at a time, writing hits[i] and overlapping[i] for pair i
+
+pub fn sphereSphereBatch(shapes: []const WorldShape, pairs: []const Pair, hits: []Hit, overlapping: []bool) void {
+    std.debug.assert(hits.len == pairs.len and overlapping.len == pairs.len);
+    var i: usize = 0;
+    while (i < pairs.len) : (i += lanes) {
+        const n = @min(lanes, pairs.len - i);
+        const a = Gathered.load(shapes, pairs[i..][0..n], .a);
+        const b = Gathered.load(shapes, pairs[i..][0..n], .b);
+
+        const dx = b.cx - a.cx;
+        const dy = b.cy - a.cy;
+        const dz = b.cz - a.cz;
+        const dist = @sqrt(dx * dx + dy * dy + dz * dz);
+        const depth = a.hx + b.hx - dist;
+        const apart = dist <= splat(1e-6);
+        const inv = @select(f32, apart, splat(0.0), splat(1.0) / @select(f32, apart, splat(1.0), dist));
+
+        store(hits[i..][0..n], overlapping[i..][0..n], .{
+            dx * inv,
+            @select(f32, apart, splat(1.0), dy * inv),
+            dz * inv,
+        }, depth);
+    }
+}
+
+
+pub fn aabbAabbBatch(shapes: []const WorldShape, pairs: []const Pair, hits: []Hit, overlapping: []bool) void {
+    std.debug.assert(hits.len == pairs.len and overlapping.len == pairs.len);
+    var i: usize = 0;
+    while (i < pairs.len) : (i += lanes) {
+        const n = @min(lanes, pairs.len - i);
+        const a = Gathered.load(shapes, pairs[i..][0..n], .a);
+        const b = Gathered.load(shapes, pairs[i..][0..n], .b);
+
+        const dx = b.cx - a.cx;
+        const dy = b.cy - a.cy;
+        const dz = b.cz - a.cz;
+        const px = a.hx + b.hx - @abs(dx);
+        const py = a.hy + b.hy - @abs(dy);
+        const pz = a.hz + b.hz - @abs(dz);
+
+        // Least penetrating axis, separated lanes end up with a depth <= 0
+        const x_least = both(px <= py, px <= pz);
+        const y_least = both(not(x_least), py <= pz);
+        const z_least = both(not(x_least), not(y_least));
+        const depth = @select(f32, x_least, px, @select(f32, y_least, py, pz));
+        const separated = either(either(px <= splat(0.0), py <= splat(0.0)), pz <= splat(0.0));
+
+        store(hits[i..][0..n], overlapping[i..][0..n], .{
+            @select(f32, x_least, signsOf(dx), splat(0.0)),
+            @select(f32, y_least, signsOf(dy), splat(0.0)),
+            @select(f32, z_least, signsOf(dz), splat(0.0)),
+        }, @select(f32, separated, splat(0.0), depth));
+    }
+}
+
+
+/// `a` of every pair is the sphere
+pub fn sphereBoxBatch(shapes: []const WorldShape, pairs: []const Pair, hits: []Hit, overlapping: []bool) void {
+    std.debug.assert(hits.len == pairs.len and overlapping.len == pairs.len);
+    var i: usize = 0;
+    while (i < pairs.len) : (i += lanes) {
+        const n = @min(lanes, pairs.len - i);
+        const s = Gathered.load(shapes, pairs[i..][0..n], .a);
+        const b = Gathered.load(shapes, pairs[i..][0..n], .b);
+        const radius = s.hx;
+
+        const ox = s.cx - b.cx;
+        const oy = s.cy - b.cy;
+        const oz = s.cz - b.cz;
+        const halves = [3]V{ b.hx, b.hy, b.hz };
+
+        // Closest point on the box, built up from the clamped local coordinates
+        var qx = b.cx;
+        var qy = b.cy;
+        var qz = b.cz;
+        var local: [3]V = undefined;
+        var face_depth: [3]V = undefined;
+        for (0..3) |k| {
+            local[k] = ox * b.ax[k] + oy * b.ay[k] + oz * b.az[k];
+            const clamped = @max(-halves[k], @min(halves[k], local[k]));
+            qx += b.ax[k] * clamped;
+            qy += b.ay[k] * clamped;
+            qz += b.az[k] * clamped;
+            face_depth[k] = halves[k] - @abs(local[k]);
+        }
+
+        const dx = qx - s.cx;
+        const dy = qy - s.cy;
+        const dz = qz - s.cz;
+        const dist_sq = dx * dx + dy * dy + dz * dz;
+        const inside = dist_sq <= splat(1e-12);
+        const dist = @sqrt(@select(f32, inside, splat(1.0), dist_sq));
+
+        // Centers inside the box leave through the nearest face
+        const x_least = both(face_depth[0] <= face_depth[1], face_depth[0] <= face_depth[2]);
+        const y_least = both(not(x_least), face_depth[1] <= face_depth[2]);
+        const face = @select(f32, x_least, face_depth[0], @select(f32, y_least, face_depth[1], face_depth[2]));
+        var face_normal: [3]V = undefined;
+        for (&face_normal, [3][3]V{ b.ax, b.ay, b.az }) |*component, axis_components| {
+            const x_part = axis_components[0] * signsOf(local[0]);
+            const y_part = axis_components[1] * signsOf(local[1]);
+            const z_part = axis_components[2] * signsOf(local[2]);
+            component.* = -@select(f32, x_least, x_part, @select(f32, y_least, y_part, z_part));
+        }
+
+        store(hits[i..][0..n], overlapping[i..][0..n], .{
+            @select(f32, inside, face_normal[0], dx / dist),
+            @select(f32, inside, face_normal[1], dy / dist),
+            @select(f32, inside, face_normal[2], dz / dist),
+        }, @select(f32, inside, radius + face, radius - @sqrt(dist_sq)));
+    }
+}
+
+
+/// Boxes take the full separating axis test, one pair at a time
+pub fn boxBoxBatch(shapes: []const WorldShape, pairs: []const Pair, hits: []Hit, overlapping: []bool) void {
+    std.debug.assert(hits.len == pairs.len and overlapping.len == pairs.len);
+    for (pairs, hits, overlapping) |pair, *hit, *does_overlap| {
+        const result = boxBox(shapes[pair.a], shapes[pair.b]);
+        does_overlap.* = result != null;
+        if (result) |found| hit.* = found;
+    }
+}
+
+
+// ============================================================
+// Private: Helper Functions
+// ============================================================
+
+/// Centers, half extents and axes of up to `lanes` shapes, one lane each
+/// Unused lanes hold a unit sphere at the origin and are never stored
+const Gathered = struct {
+    cx: V,
+    cy: V,
+    cz: V,
+    hx: V,
+    hy: V,
+    hz: V,
+    /// x, y and z components of each of the three axes
+    ax: [3]V,
+    ay: [3]V,
+    az: [3]V,
+
+    fn load(shapes: []const WorldShape, pairs: []const Pair, comptime side: enum { a, b }) Gathered {
+        var fields: [15][lanes]f32 = undefined;
+        for (&fields) |*field| field.* = @splat(0.0);
+        for (pairs, 0..) |pair, lane| {
+            const shape = shapes[if (side == .a) pair.a else pair.b];
+            fields[0][lane] = shape.center.x;
+            fields[1][lane] = shape.center.y;
+            fields[2][lane] = shape.center.z;
+            fields[3][lane] = shape.half.x;
+            fields[4][lane] = shape.half.y;
+            fields[5][lane] = shape.half.z;
+            for (shape.axes, 0..) |axis, k| {
+                fields[6 + k][lane] = axis.x;
+                fields[9 + k][lane] = axis.y;
+                fields[12 + k][lane] = axis.z;
+            }
+        }
+        return .{
+            .cx = fields[0],
+            .cy = fields[1],
+            .cz = fields[2],
+            .hx = fields[3],
+            .hy = fields[4],
+            .hz = fields[5],
+            .ax = .{ fields[6], fields[7], fields[8] },
+            .ay = .{ fields[9], fields[10], fields[11] },
+            .az = .{ fields[12], fields[13], fields[14] },
+        };
+    }
+};
+
+
+/// Write the first hits.len lanes, lanes with a depth <= 0 do not overlap
+fn store(hits: []Hit, overlapping: []bool, normal: [3]V, depth: V) void {
+    const nx: [lanes]f32 = normal[0];
+    const ny: [lanes]f32 = normal[1];
+    const nz: [lanes]f32 = normal[2];
+    const depths: [lanes]f32 = depth;
+    for (hits, overlapping, 0..) |*hit, *does_overlap, lane| {
+        does_overlap.* = depths[lane] > 0.0;
+        hit.* = .{ .normal = Vec3f.create(nx[lane], ny[lane], nz[lane]), .depth = depths[lane] };
+    }
+}
+
+
+/// Project both boxes onto `axis` and keep it in `best` if it is the shallowest overlap so far
+/// Returns false when the axis separates them
+fn separationOn(axis: Vec3f, t: Vec3f, axes_a: [3]Vec3f, ha: [3]f32, axes_b: [3]Vec3f, hb: [3]f32, best: *Hit) bool {
+    var ra: f32 = 0.0;
+    var rb: f32 = 0.0;
+    for (0..3) |k| {
+        ra += ha[k] * @abs(axes_a[k].dot(axis));
+        rb += hb[k] * @abs(axes_b[k].dot(axis));
+    }
+    const d = t.dot(axis);
+    const depth = ra + rb - @abs(d);
+    if (depth <= 0.0) return false;
+    if (depth < best.depth) best.* = .{ .normal = axis.scale(signOf(d)), .depth = depth };
+    return true;
+}
+
+
+fn flip(hit: ?Hit) ?Hit {
+    const found = hit orelse return null;
+    return .{ .normal = found.normal.scale(-1.0), .depth = found.depth };
+}
+
+
+inline fn signOf(value: f32) f32 {
+    return if (value < 0.0) -1.0 else 1.0;
+}
+
+
+inline fn signsOf(values: V) V {
+    return @select(f32, values < splat(0.0), splat(-1.0), splat(1.0));
+}
+
+
+inline fn splat(value: f32) V {
+    return @splat(value);
+}
+
+
+// Lane-wise logic on comparison masks
+const Mask = @Vector(lanes, bool);
+const all_true: Mask = @splat(true);
+const all_false: Mask = @splat(false);
+
+inline fn both(a: Mask, b: Mask) Mask {
+    return @select(bool, a, b, all_false);
+}
+
+
+inline fn either(a: Mask, b: Mask) Mask {
+    return @select(bool, a, all_true, b);
+}
+
+
+inline fn not(a: Mask) Mask {
+    return @select(bool, a, all_false, all_true);
+}
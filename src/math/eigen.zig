@@ -7,7 +7,6 @@ const eigen = @cImport({
 const Vec2f = @import("vector.zig").Vec2f;
 const Vec3f = @import("vector.zig").Vec3f;
 const Vec4f = @import("vector.zig").Vec4f;
-const Mat4f = @import("matrix.zig").Mat4f;
 
 
 
@@ -42,15 +41,5 @@ pub inline fn fromEigenVec4f(v: eigen.Vec4f) Vec4f {
     return Vec4f{ .x = v.x, .y = v.y, .z = v.z, .w = v.w };
 }
 
-// Mat4f conversions
-pub inline fn toEigenMat4f(m: Mat4f) eigen.Mat4f {
-    var result: eigen.Mat4f = undefined;
-    @memcpy(&result.data, &m.data);
-    return result;
-}
-
-pub inline fn fromEigenMat4f(m: eigen.Mat4f) Mat4f {
-    var result: Mat4f = undefined;
-    @memcpy(&result.data, &m.data);
-    return result;
-}
\ No newline at end of file
+// Mat4f needs no conversion: its 16-byte aligned column-major data is passed
+// by pointer and mapped in place on the C side
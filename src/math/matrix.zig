@@ -4,27 +4,57 @@ const eigen = @cImport({
     @cInclude("Eigen/eigen_wrapper.h");
 });
 
-const eigen_interface = @import("eigen.zig");
+const std = @import("std");
+const backend = @import("backend.zig").active;
 const Vec3f = @import("vector.zig").Vec3f;
+const Quatf = @import("quaternion.zig").Quatf;
+
+// ============================================================
+// Public API: Mat3 Implementations
+// ============================================================
+
+pub const Mat3f = struct {
+    /// Column-major storage, matches a GLSL mat3 uniform
+    data: [9]f32,
+
+    pub fn identity() Mat3f {
+        return .{ .data = .{
+            1, 0, 0,
+            0, 1, 0,
+            0, 0, 1,
+        } };
+    }
+};
+
+
+
 
 // ============================================================
 // Public API: Mat4 Implementations
 // ============================================================
 
 pub const Mat4f = struct {  
-    data: [16]f32,
+    /// Column-major storage, aligned so the C side can map it directly as an Eigen::Matrix4f
+    data: [16]f32 align(16),
 
-    // Eigen-dependent functions - wrappers around C functions
+    // Backend functions - native @Vector code by default, Eigen when selected (see backend.zig)
+    // Matrices are passed by pointer, the Eigen backend maps them in place without copying
     pub inline fn identity() Mat4f {
-        return eigen_interface.fromEigenMat4f(eigen.mat4fIdentity());
+        var result: Mat4f = undefined;
+        backend.mat4Identity(&result);
+        return result;
     }
     
     /// Multiply two matrices to get a new one
     pub inline fn multiply(a: Mat4f, b: Mat4f) Mat4f {
-        const eigen_a = eigen_interface.toEigenMat4f(a);
-        const eigen_b = eigen_interface.toEigenMat4f(b);
-        const result = eigen.mat4fMultiply(eigen_a, eigen_b);
-        return eigen_interface.fromEigenMat4f(result);
+        var result: Mat4f = undefined;
+        backend.mat4Multiply(&a, &b, &result);
+        return result;
+    }
+
+    /// Multiply two matrices into `out`, which may be `a` or `b`
+    pub inline fn multiplyInto(out: *Mat4f, a: *const Mat4f, b: *const Mat4f) void {
+        backend.mat4Multiply(a, b, out);
     }
 
     /// Create a look-at view matrix
@@ -32,11 +62,14 @@ pub const Mat4f = struct {
     /// Center: The point the camera is looking at
     /// Up: The up direction vector
     pub inline fn lookAt(eye: Vec3f, center: Vec3f, up: Vec3f) Mat4f {
-        const eigen_eye = eigen_interface.toEigenVec3f(eye);
-        const eigen_center = eigen_interface.toEigenVec3f(center);
-        const eigen_up = eigen_interface.toEigenVec3f(up);
-        const result = eigen.mat4fLookAt(eigen_eye, eigen_center, eigen_up);
-        return eigen_interface.fromEigenMat4f(result);
+        var result: Mat4f = undefined;
+        lookAtInto(&result, eye, center, up);
+        return result;
+    }
+
+    /// Write a look-at view matrix into `out`
+    pub inline fn lookAtInto(out: *Mat4f, eye: Vec3f, center: Vec3f, up: Vec3f) void {
+        backend.mat4LookAt(eye, center, up, out);
     }
     
     /// Create a perspective projection matrix
@@ -45,8 +78,14 @@ pub const Mat4f = struct {
     /// near: Distance to near plane
     /// far: Distance to far plane
     pub inline fn perspective(fov: f32, aspect: f32, near: f32, far: f32) Mat4f {
-        const result = eigen.mat4fPerspective(fov, aspect, near, far);
-        return eigen_interface.fromEigenMat4f(result);
+        var result: Mat4f = undefined;
+        perspectiveInto(&result, fov, aspect, near, far);
+        return result;
+    }
+
+    /// Write a perspective projection matrix into `out`
+    pub inline fn perspectiveInto(out: *Mat4f, fov: f32, aspect: f32, near: f32, far: f32) void {
+        backend.mat4Perspective(fov, aspect, near, far, out);
     }
     
     /// Create an orthographic projection matrix
@@ -54,25 +93,149 @@ pub const Mat4f = struct {
     /// bottom, top: Bottom and top boundaries
     /// near, far: Near and far plane distances
     pub inline fn ortho(left: f32, right: f32, bottom: f32, top: f32, near: f32, far: f32) Mat4f {
-        const result = eigen.mat4fOrtho(left, right, bottom, top, near, far);
-        return eigen_interface.fromEigenMat4f(result);
+        var result: Mat4f = undefined;
+        orthoInto(&result, left, right, bottom, top, near, far);
+        return result;
+    }
+
+    /// Write an orthographic projection matrix into `out`
+    pub inline fn orthoInto(out: *Mat4f, left: f32, right: f32, bottom: f32, top: f32, near: f32, far: f32) void {
+        backend.mat4Ortho(left, right, bottom, top, near, far, out);
     }
     
+    /// Build a translation * rotation * scale matrix, no trig is needed for the rotation
+    pub fn compose(translation: Vec3f, rotation: Quatf, scl: Vec3f) Mat4f {
+        const q = rotation;
+        const xx = q.x * q.x;
+        const yy = q.y * q.y;
+        const zz = q.z * q.z;
+        const xy = q.x * q.y;
+        const xz = q.x * q.z;
+        const yz = q.y * q.z;
+        const wx = q.w * q.x;
+        const wy = q.w * q.y;
+        const wz = q.w * q.z;
+
+        return .{ .data = .{
+            (1 - 2 * (yy + zz)) * scl.x, 2 * (xy + wz) * scl.x, 2 * (xz - wy) * scl.x, 0,
+            2 * (xy - wz) * scl.y, (1 - 2 * (xx + zz)) * scl.y, 2 * (yz + wx) * scl.y, 0,
+            2 * (xz + wy) * scl.z, 2 * (yz - wx) * scl.z, (1 - 2 * (xx + yy)) * scl.z, 0,
+            translation.x, translation.y, translation.z, 1,
+        } };
+    }
+
     /// Transform a point by this matrix
     /// This performs perspective division if needed
-    pub inline fn transformPoint(mat: Mat4f, point: Vec3f) Vec3f {
-        const eigen_mat = eigen_interface.toEigenMat4f(mat);
-        const eigen_point = eigen_interface.toEigenVec3f(point);
-        const result = eigen.mat4fTransformPoint(eigen_mat, eigen_point);
-        return eigen_interface.fromEigenVec3f(result);
+    pub inline fn transformPoint(mat: *const Mat4f, point: Vec3f) Vec3f {
+        return backend.mat4TransformPoint(mat, point);
     }
     
     /// Transform a direction vector by this matrix
     /// No perspective division is performed (w=0)
-    pub inline fn transformDirection(mat: Mat4f, dir: Vec3f) Vec3f {
-        const eigen_mat = eigen_interface.toEigenMat4f(mat);
-        const eigen_dir = eigen_interface.toEigenVec3f(dir);
-        const result = eigen.mat4fTransformDirection(eigen_mat, eigen_dir);
-        return eigen_interface.fromEigenVec3f(result);
+    pub inline fn transformDirection(mat: *const Mat4f, dir: Vec3f) Vec3f {
+        return backend.mat4TransformDirection(mat, dir);
+    }
+
+
+    /// Invert a general 4x4 matrix, null if it is singular
+    pub inline fn inverse(mat: *const Mat4f) ?Mat4f {
+        var result: Mat4f = undefined;
+        if (!backend.mat4Inverse(mat, &result)) return null;
+        return result;
+    }
+
+    /// Faster inverse for affine matrices (bottom row 0, 0, 0, 1) such as model and view matrices
+    /// Null if the upper 3x3 is singular
+    pub inline fn affineInverse(mat: *const Mat4f) ?Mat4f {
+        var result: Mat4f = undefined;
+        if (!backend.mat4AffineInverse(mat, &result)) return null;
+        return result;
+    }
+
+    /// Inverse-transpose of the upper 3x3, used to transform normals
+    pub inline fn normalMatrix(mat: *const Mat4f) Mat3f {
+        var result: Mat3f = undefined;
+        backend.mat4NormalMatrix(mat, &result);
+        return result;
+    }
+
+
+    // Batched kernels - one C call for a whole slice of points
+    // These always use the Eigen wrapper, the call overhead is amortized over the batch
+
+    /// Transform many points stored as separate x/y/z slices (SoA) in a single call
+    /// Output slices may alias the inputs, all slices must have the same length
+    pub fn transformPoints(mat: *const Mat4f, xs: []const f32, ys: []const f32, zs: []const f32, out_xs: []f32, out_ys: []f32, out_zs: []f32) void {
+        assertSameLength(xs.len, .{ ys.len, zs.len, out_xs.len, out_ys.len, out_zs.len });
+        eigen.mat4fTransformPoints(&mat.data, xs.ptr, ys.ptr, zs.ptr, out_xs.ptr, out_ys.ptr, out_zs.ptr, xs.len);
+    }
+
+    /// Transform many direction vectors stored as separate x/y/z slices (SoA) in a single call
+    /// No perspective division is performed (w=0)
+    pub fn transformDirections(mat: *const Mat4f, xs: []const f32, ys: []const f32, zs: []const f32, out_xs: []f32, out_ys: []f32, out_zs: []f32) void {
+        assertSameLength(xs.len, .{ ys.len, zs.len, out_xs.len, out_ys.len, out_zs.len });
+        eigen.mat4fTransformDirections(&mat.data, xs.ptr, ys.ptr, zs.ptr, out_xs.ptr, out_ys.ptr, out_zs.ptr, xs.len);
+    }
+
+    /// Transform a slice of points in place or into `out` (AoS)
+    pub fn transformPointSlice(mat: *const Mat4f, points: []const Vec3f, out: []Vec3f) void {
+        std.debug.assert(points.len == out.len);
+        eigen.mat4fTransformPointsAoS(&mat.data, @ptrCast(points.ptr), @ptrCast(out.ptr), points.len);
+    }
+
+    /// Transform a slice of direction vectors in place or into `out` (AoS)
+    pub fn transformDirectionSlice(mat: *const Mat4f, dirs: []const Vec3f, out: []Vec3f) void {
+        std.debug.assert(dirs.len == out.len);
+        eigen.mat4fTransformDirectionsAoS(&mat.data, @ptrCast(dirs.ptr), @ptrCast(out.ptr), dirs.len);
+    }
+
+
+    /// Compute a normal matrix for every matrix in `mats`, e.g. per-instance data
+    pub fn normalMatrices(mats: []const Mat4f, out: []Mat3f) void {
+        std.debug.assert(mats.len == out.len);
+        eigen.mat4fNormalMatrices(@ptrCast(mats.ptr), @ptrCast(out.ptr), mats.len);
+    }
+
+
+    /// out[i] = a[i] * b[i] for every pair, e.g. joint model matrices times their inverse bind matrices
+    /// `out` must not alias either input
+    pub fn multiplyBatch(a: []const Mat4f, b: []const Mat4f, out: []Mat4f) void {
+        assertSameLength(a.len, .{ b.len, out.len });
+        eigen.mat4fMultiplyBatch(@ptrCast(a.ptr), @ptrCast(b.ptr), @ptrCast(out.ptr), a.len);
+    }
+
+    /// worlds[i] = worlds[parents[i]] * locals[i], or locals[i] where parents[i] is negative
+    /// Parents have to come before their children, `worlds` must not alias `locals`
+    pub fn multiplyHierarchy(locals: []const Mat4f, parents: []const i32, worlds: []Mat4f) void {
+        assertSameLength(locals.len, .{ parents.len, worlds.len });
+        eigen.mat4fMultiplyHierarchy(@ptrCast(locals.ptr), parents.ptr, @ptrCast(worlds.ptr), locals.len);
+    }
+};
+
+
+/// Instruction set level the batched kernels run at, picked by CPUID the first time one is called
+pub const KernelLevel = enum(c_int) {
+    /// Eigen as compiled, SSE2 on the default x86-64 target
+    baseline = 0,
+    avx2 = 1,
+    avx512 = 2,
+};
+
+
+pub fn batchKernelLevel() KernelLevel {
+    return @enumFromInt(eigen.mathKernelLevel());
+}
+
+
+/// Force a level, e.g. to benchmark them against each other, clamped to what the CPU supports
+pub fn setBatchKernelLevel(level: KernelLevel) KernelLevel {
+    return @enumFromInt(eigen.mathSetKernelLevel(@intCast(@intFromEnum(level))));
+}
+
+
+/// Debug check that every slice handed to a batched kernel has the same length
+inline fn assertSameLength(len: usize, others: anytype) void {
+    inline for (others) |other| {
+        std.debug.assert(other == len);
     }
-};
\ No newline at end of file
+}
\ No newline at end of file
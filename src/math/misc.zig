@@ -27,4 +27,19 @@ pub fn smoothstepf(edge0: f32, edge1: f32, x: f32) f32 {
     const t = clampf((x - edge0) / (edge1 - edge0), 0.0, 1.0);
     // Evaluate polynomial: 3t² - 2t³
     return t * t * (3.0 - 2.0 * t);
-}
\ No newline at end of file
+}
+/// Interleave the bits of three 21 bit coordinates, x lowest, so points close in space get close codes
+pub fn morton3(x: u21, y: u21, z: u21) u64 {
+    return spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2);
+}
+
+/// Move bit i of `value` to bit 3i
+fn spreadBits(value: u21) u64 {
+    var v: u64 = value;
+    v = (v | (v << 32)) & 0x1f00000000ffff;
+    v = (v | (v << 16)) & 0x1f0000ff0000ff;
+    v = (v | (v << 8)) & 0x100f00f00f00f00f;
+    v = (v | (v << 4)) & 0x10c30c30c30c30c3;
+    v = (v | (v << 2)) & 0x1249249249249249;
+    return v;
+}
@@ -0,0 +1,327 @@
+// math/noise.zig - SIMD lattice noise, fBm and heightfield normals
+
+const std = @import("std");
+
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+const Vec3f = @import("vector.zig").Vec3f;
+
+/// Samples evaluated per call of the lane functions
+pub const lanes = std.simd.suggestVectorLength(f32) orelse 8;
+pub const V = @Vector(lanes, f32);
+const I = @Vector(lanes, i32);
+const U = @Vector(lanes, u32);
+
+/// Rows of a heightfield per job
+const rows_per_job = 16;
+
+
+pub const NoiseKind = enum {
+    /// Random heights on the square lattice, smoothly interpolated. Cheapest, blocky with few octaves
+    value,
+    /// Random gradients on the square lattice
+    perlin,
+    /// Random gradients on a triangular lattice, three corners per sample instead of four and fewer axis-aligned artifacts
+    simplex,
+};
+
+
+/// Octaves of noise summed with rising frequency and falling amplitude
+pub const FbmConfig = struct {
+    kind: NoiseKind = .simplex,
+    /// Lattice cells per unit of input in the first octave
+    frequency: f32 = 1.0 / 256.0,
+    octaves: u32 = 6,
+    /// Frequency factor from one octave to the next
+    lacunarity: f32 = 2.0,
+    /// Amplitude factor from one octave to the next
+    gain: f32 = 0.5,
+    seed: u32 = 0,
+};
+
+
+// ============================================================
+// Public API: Noise
+// ============================================================
+
+/// Noise of `kind` at `lanes` points, roughly in [-1, 1]
+pub fn noise2(kind: NoiseKind, x: V, y: V, seed: u32) V {
+    return switch (kind) {
+        .value => value2(x, y, seed),
+        .perlin => perlin2(x, y, seed),
+        .simplex => simplex2(x, y, seed),
+    };
+}
+
+
+pub fn value2(x: V, y: V, seed: u32) V {
+    const fx = @floor(x);
+    const fy = @floor(y);
+    const xi: I = @intFromFloat(fx);
+    const yi: I = @intFromFloat(fy);
+    const u = fade(x - fx);
+    const v = fade(y - fy);
+
+    const one: I = @splat(1);
+    const v00 = lattice(hash(xi, yi, seed));
+    const v10 = lattice(hash(xi +% one, yi, seed));
+    const v01 = lattice(hash(xi, yi +% one, seed));
+    const v11 = lattice(hash(xi +% one, yi +% one, seed));
+    return lerp(lerp(v00, v10, u), lerp(v01, v11, u), v);
+}
+
+
+pub fn perlin2(x: V, y: V, seed: u32) V {
+    const fx = @floor(x);
+    const fy = @floor(y);
+    const xi: I = @intFromFloat(fx);
+    const yi: I = @intFromFloat(fy);
+    const dx = x - fx;
+    const dy = y - fy;
+
+    const one: I = @splat(1);
+    const n00 = gradient(hash(xi, yi, seed), dx, dy);
+    const n10 = gradient(hash(xi +% one, yi, seed), dx - splat(1.0), dy);
+    const n01 = gradient(hash(xi, yi +% one, seed), dx, dy - splat(1.0));
+    const n11 = gradient(hash(xi +% one, yi +% one, seed), dx - splat(1.0), dy - splat(1.0));
+    const u = fade(dx);
+    return lerp(lerp(n00, n10, u), lerp(n01, n11, u), fade(dy));
+}
+
+
+pub fn simplex2(x: V, y: V, seed: u32) V {
+    const skew = 0.5 * (@sqrt(3.0) - 1.0);
+    const unskew = (3.0 - @sqrt(3.0)) / 6.0;
+
+    // Cell of the skewed lattice and the offset from its first corner
+    const s = (x + y) * splat(skew);
+    const fi = @floor(x + s);
+    const fj = @floor(y + s);
+    const t = (fi + fj) * splat(unskew);
+    const x0 = x - (fi - t);
+    const y0 = y - (fj - t);
+
+    // The middle corner is a step along x in the lower triangle, along y in the upper
+    const lower = x0 > y0;
+    const i1 = @select(f32, lower, splat(1.0), splat(0.0));
+    const j1 = splat(1.0) - i1;
+    const x1 = x0 - i1 + splat(unskew);
+    const y1 = y0 - j1 + splat(unskew);
+    const x2 = x0 - splat(1.0 - 2.0 * unskew);
+    const y2 = y0 - splat(1.0 - 2.0 * unskew);
+
+    const ii: I = @intFromFloat(fi);
+    const jj: I = @intFromFloat(fj);
+    const ii1: I = @intFromFloat(i1);
+    const jj1: I = @intFromFloat(j1);
+    const one: I = @splat(1);
+    const n0 = corner(hash(ii, jj, seed), x0, y0);
+    const n1 = corner(hash(ii +% ii1, jj +% jj1, seed), x1, y1);
+    const n2 = corner(hash(ii +% one, jj +% one, seed), x2, y2);
+    return (n0 + n1 + n2) * splat(70.0);
+}
+
+
+/// Sum of `config.octaves` octaves, divided by the sum of their amplitudes so it stays roughly in [-1, 1]
+pub fn fbm2(x: V, y: V, config: FbmConfig) V {
+    return switch (config.kind) {
+        inline else => |kind| fbmOf(kind, x, y, config),
+    };
+}
+
+
+// ============================================================
+// Public API: Heightfields
+// ============================================================
+
+/// Fill `heights`, `width` x `depth` samples row by row along x, with fBm at the sample coordinates
+/// Rows are spread across `jobs` when given, the calling thread takes part
+pub fn fillHeightmap(jobs: ?*JobSystem, heights: []f32, width: u32, depth: u32, config: FbmConfig) void {
+    std.debug.assert(heights.len == @as(usize, width) * depth);
+    const context = HeightKernel{ .heights = heights, .width = width, .config = config };
+    runRows(jobs, depth, &context, HeightKernel.run);
+}
+
+
+/// Unit normals of a heightfield laid out like fillHeightmap, from central differences clamped at the edges
+/// Matches Heightmap.normal for the same spacing and height scale, `normals` holds one per sample
+pub fn heightfieldNormals(jobs: ?*JobSystem, heights: []const f32, width: u32, depth: u32, spacing: f32, height_scale: f32, normals: []Vec3f) void {
+    std.debug.assert(heights.len == @as(usize, width) * depth and normals.len == heights.len);
+    const context = NormalKernel{
+        .heights = heights,
+        .normals = normals,
+        .width = width,
+        .depth = depth,
+        .spacing = spacing,
+        .height_scale = height_scale,
+    };
+    runRows(jobs, depth, &context, NormalKernel.run);
+}
+
+
+// ============================================================
+// Private: Helper Functions
+// ============================================================
+
+const HeightKernel = struct {
+    heights: []f32,
+    width: u32,
+    config: FbmConfig,
+
+    fn run(self: *const HeightKernel, first_row: usize, end_row: usize) void {
+        const offsets = std.simd.iota(f32, lanes);
+        for (first_row..end_row) |z| {
+            const row = self.heights[z * self.width ..][0..self.width];
+            const y: V = @splat(@floatFromInt(z));
+
+            var x: usize = 0;
+            while (x < row.len) : (x += lanes) {
+                const values: [lanes]f32 = fbm2(offsets + splat(@floatFromInt(x)), y, self.config);
+                const count = @min(lanes, row.len - x);
+                @memcpy(row[x..][0..count], values[0..count]);
+            }
+        }
+    }
+};
+
+
+const NormalKernel = struct {
+    heights: []const f32,
+    normals: []Vec3f,
+    width: u32,
+    depth: u32,
+    spacing: f32,
+    height_scale: f32,
+
+    fn run(self: *const NormalKernel, first_row: usize, end_row: usize) void {
+        const w: usize = self.width;
+        const scale = splat(self.height_scale);
+        const ny = splat(2.0 * self.spacing);
+
+        for (first_row..end_row) |z| {
+            const row = self.heights[z * w ..][0..w];
+            const above = self.heights[(z -| 1) * w ..][0..w];
+            const below = self.heights[@min(z + 1, self.depth - 1) * w ..][0..w];
+            const out = self.normals[z * w ..][0..w];
+
+            // Columns with both horizontal neighbours inside the row load them as plain vectors
+            out[0] = self.normalAt(row, above, below, 0);
+            var x: usize = 1;
+            while (x + lanes < w) : (x += lanes) {
+                const left: V = row[x - 1 ..][0..lanes].*;
+                const right: V = row[x + 1 ..][0..lanes].*;
+                const north: V = above[x..][0..lanes].*;
+                const south: V = below[x..][0..lanes].*;
+                const nx = (left - right) * scale;
+                const nz = (north - south) * scale;
+                const inverse_length = splat(1.0) / @sqrt(nx * nx + ny * ny + nz * nz);
+
+                const xs: [lanes]f32 = nx * inverse_length;
+                const ys: [lanes]f32 = ny * inverse_length;
+                const zs: [lanes]f32 = nz * inverse_length;
+                for (out[x..][0..lanes], xs, ys, zs) |*normal, nx_i, ny_i, nz_i| {
+                    normal.* = .{ .x = nx_i, .y = ny_i, .z = nz_i };
+                }
+            }
+            while (x < w) : (x += 1) out[x] = self.normalAt(row, above, below, x);
+        }
+    }
+
+
+    fn normalAt(self: *const NormalKernel, row: []const f32, above: []const f32, below: []const f32, x: usize) Vec3f {
+        const left = row[x -| 1];
+        const right = row[@min(x + 1, row.len - 1)];
+        return Vec3f.normalize(.{
+            .x = (left - right) * self.height_scale,
+            .y = 2.0 * self.spacing,
+            .z = (above[x] - below[x]) * self.height_scale,
+        });
+    }
+};
+
+
+fn runRows(jobs: ?*JobSystem, rows: usize, kernel: anytype, comptime func: fn (@TypeOf(kernel), usize, usize) void) void {
+    if (jobs) |job_system| {
+        job_system.parallelFor(rows, rows_per_job, kernel, func);
+    } else {
+        func(kernel, 0, rows);
+    }
+}
+
+
+fn fbmOf(comptime kind: NoiseKind, x: V, y: V, config: FbmConfig) V {
+    var sum: V = @splat(0.0);
+    var amplitude: f32 = 1.0;
+    var total: f32 = 0.0;
+    var frequency = config.frequency;
+    for (0..config.octaves) |octave| {
+        // Every octave gets its own lattice, or their features would line up at the origin
+        const seed = config.seed +% @as(u32, @intCast(octave)) *% 0x9e3779b9;
+        sum += noise2(kind, x * splat(frequency), y * splat(frequency), seed) * splat(amplitude);
+        total += amplitude;
+        amplitude *= config.gain;
+        frequency *= config.lacunarity;
+    }
+    return if (total > 0.0) sum / splat(total) else sum;
+}
+
+
+/// Contribution of one simplex corner, falling to zero at distance sqrt(0.5)
+fn corner(h: U, x: V, y: V) V {
+    const t = @max(splat(0.5) - x * x - y * y, splat(0.0));
+    const t2 = t * t;
+    return t2 * t2 * gradient(h, x, y);
+}
+
+
+/// Dot product of the offset with one of the four diagonal gradients picked by `h`
+fn gradient(h: U, x: V, y: V) V {
+    const zero: U = @splat(0);
+    const flip_x = (h & @as(U, @splat(1))) != zero;
+    const flip_y = (h & @as(U, @splat(2))) != zero;
+    return @select(f32, flip_x, -x, x) + @select(f32, flip_y, -y, y);
+}
+
+
+/// Lattice value in [-1, 1] from the top 24 bits of a hash
+fn lattice(h: U) V {
+    const bits: V = @floatFromInt(h >> shift(8));
+    return bits * splat(2.0 / 16777215.0) - splat(1.0);
+}
+
+
+/// Integer hash of lattice points, a multiply-xorshift mix of both coordinates and the seed
+fn hash(x: I, y: I, seed: u32) U {
+    var h = @as(U, @bitCast(x)) *% splatU(0x8da6b343) ^ @as(U, @bitCast(y)) *% splatU(0xd8163841) ^ splatU(seed *% 0xcb1ab31f);
+    h ^= h >> shift(16);
+    h *%= splatU(0x7feb352d);
+    h ^= h >> shift(15);
+    h *%= splatU(0x846ca68b);
+    h ^= h >> shift(16);
+    return h;
+}
+
+
+/// Quintic smootherstep, its first and second derivatives vanish on the lattice
+fn fade(t: V) V {
+    return t * t * t * (t * (t * splat(6.0) - splat(15.0)) + splat(10.0));
+}
+
+
+fn lerp(a: V, b: V, t: V) V {
+    return a + t * (b - a);
+}
+
+
+fn splat(value: f32) V {
+    return @splat(value);
+}
+
+
+fn splatU(value: u32) U {
+    return @splat(value);
+}
+
+
+fn shift(comptime bits: u5) @Vector(lanes, u5) {
+    return @splat(bits);
+}
@@ -0,0 +1,120 @@
+// math/quaternion.zig - quaternion rotations
+
+const math = @import("std").math;
+
+const Vec3f = @import("vector.zig").Vec3f;
+
+const V4 = @Vector(4, f32);
+
+
+
+// ============================================================
+// Public API: Quaternion Implementations
+// ============================================================
+
+/// Unit quaternion rotation, stored as (x, y, z) vector part and w scalar part
+pub const Quatf = extern struct {
+    x: f32,
+    y: f32,
+    z: f32,
+    w: f32,
+
+    // Creation functions - the only place trig is needed
+
+    pub fn identity() Quatf {
+        return .{ .x = 0, .y = 0, .z = 0, .w = 1 };
+    }
+
+    /// Rotation of `angle` radians around a normalized axis
+    pub fn fromAxisAngle(axis: Vec3f, angle: f32) Quatf {
+        const half = angle * 0.5;
+        const s = @sin(half);
+        return .{ .x = axis.x * s, .y = axis.y * s, .z = axis.z * s, .w = @cos(half) };
+    }
+
+    /// Rotation from Euler angles in radians, same convention as the old transform matrices (Rx * Ry * Rz)
+    pub fn fromEuler(x: f32, y: f32, z: f32) Quatf {
+        const qx = fromAxisAngle(.{ .x = 1, .y = 0, .z = 0 }, x);
+        const qy = fromAxisAngle(.{ .x = 0, .y = 1, .z = 0 }, y);
+        const qz = fromAxisAngle(.{ .x = 0, .y = 0, .z = 1 }, z);
+        return qx.multiply(qy).multiply(qz);
+    }
+
+
+    // Pure Zig implementations
+
+    /// Hamilton product, the result applies `b` first and then `a`
+    pub fn multiply(a: Quatf, b: Quatf) Quatf {
+        return .{
+            .x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+            .y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+            .z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+            .w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+        };
+    }
+
+    /// Inverse rotation for unit quaternions
+    pub fn conjugate(q: Quatf) Quatf {
+        return .{ .x = -q.x, .y = -q.y, .z = -q.z, .w = q.w };
+    }
+
+    pub fn dot(a: Quatf, b: Quatf) f32 {
+        return @reduce(.Add, lanes(a) * lanes(b));
+    }
+
+    pub fn normalize(q: Quatf) Quatf {
+        const l = lanes(q);
+        const len_sq = @reduce(.Add, l * l);
+        if (len_sq <= 0) return identity();
+        return fromLanes(l * @as(V4, @splat(1.0 / @sqrt(len_sq))));
+    }
+
+    /// Rotate a vector, v' = v + 2w(u x v) + 2u x (u x v)
+    pub fn rotateVec3(q: Quatf, v: Vec3f) Vec3f {
+        const u = Vec3f{ .x = q.x, .y = q.y, .z = q.z };
+        const t = Vec3f.scale(Vec3f.cross(u, v), 2.0);
+        return Vec3f.add(Vec3f.add(v, Vec3f.scale(t, q.w)), Vec3f.cross(u, t));
+    }
+
+    /// Normalized linear interpolation, cheaper than slerp and fine for small steps
+    pub fn nlerp(a: Quatf, b: Quatf, t: f32) Quatf {
+        // Take the short way around
+        const lb = if (dot(a, b) < 0) -lanes(b) else lanes(b);
+        const la = lanes(a);
+        return normalize(fromLanes(la + (lb - la) * @as(V4, @splat(t))));
+    }
+
+    /// Spherical linear interpolation with constant angular velocity
+    pub fn slerp(a: Quatf, b: Quatf, t: f32) Quatf {
+        var cos_theta = dot(a, b);
+        var lb = lanes(b);
+
+        // Take the short way around
+        if (cos_theta < 0) {
+            cos_theta = -cos_theta;
+            lb = -lb;
+        }
+
+        // Nearly parallel, fall back to nlerp
+        if (cos_theta > 0.9995) {
+            return nlerp(a, fromLanes(lb), t);
+        }
+
+        const theta = math.acos(cos_theta);
+        const inv_sin = 1.0 / @sin(theta);
+        const wa: V4 = @splat(@sin((1.0 - t) * theta) * inv_sin);
+        const wb: V4 = @splat(@sin(t * theta) * inv_sin);
+        return fromLanes(lanes(a) * wa + lb * wb);
+    }
+
+
+    // Helpers
+
+    inline fn lanes(q: Quatf) V4 {
+        return .{ q.x, q.y, q.z, q.w };
+    }
+
+    inline fn fromLanes(v: V4) Quatf {
+        return .{ .x = v[0], .y = v[1], .z = v[2], .w = v[3] };
+    }
+};
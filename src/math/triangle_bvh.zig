@@ -0,0 +1,395 @@
+// math/triangle_bvh.zig - static triangle hierarchy for precise ray casts against mesh data
+
+const std = @import("std");
+
+const Vec3f = @import("vector.zig").Vec3f;
+const bounds = @import("bounds.zig");
+const BoundingBox = bounds.BoundingBox;
+const Ray = bounds.Ray;
+
+// ============================================================
+// Public API: Triangle BVH
+// ============================================================
+
+/// Bounding volume hierarchy over the triangles of one mesh, built once from a CPU copy of its data
+/// Every leaf holds up to `lanes` triangles as one packet of vertex and edge components,
+/// so a ray is tested against the whole leaf with one Möller-Trumbore pass over SIMD lanes
+pub const TriangleBvh = struct {
+    const Self = @This();
+
+    /// Triangles per leaf and per ray test
+    pub const lanes = std.simd.suggestVectorLength(f32) orelse 8;
+    const V = @Vector(lanes, f32);
+    const Mask = @Vector(lanes, bool);
+
+    /// Deep enough for any tree over 2^32 triangles, see sah_depth
+    const max_depth = 64;
+    /// Splits below this depth fall back to the median, which bounds the depth SAH alone does not
+    const sah_depth = 32;
+    /// Centroid bins per axis the SAH split candidates are taken from
+    const bin_count = 12;
+
+    const Node = struct {
+        box: BoundingBox,
+        /// Packet of a leaf, or the first of the two adjacent children of an inner node
+        first: u32,
+        /// Triangles of a leaf, 0 for inner nodes
+        count: u32,
+    };
+
+    /// First vertex and both edges of up to `lanes` triangles, unused lanes are degenerate and never hit
+    const Packet = struct {
+        v0: [3]V,
+        e1: [3]V,
+        e2: [3]V,
+        /// Index of each lane's triangle in the source index list
+        triangles: [lanes]u32,
+    };
+
+    /// Closest triangle hit by a ray
+    pub const RayHit = struct {
+        distance: f32,
+        /// Position of the triangle in the index list divided by three
+        triangle: u32,
+        /// Barycentric weights of the second and third vertex at the hit
+        u: f32,
+        v: f32,
+    };
+
+    allocator: std.mem.Allocator,
+    nodes: []Node,
+    packets: []Packet,
+    triangle_count: usize,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Build over interleaved vertex data whose first three floats per vertex are the position
+    /// Splits by the surface area heuristic over binned centroids, one linear pass per node and axis
+    pub fn build(allocator: std.mem.Allocator, data: []const f32, floats_per_vertex: usize, indices: []const u32) !Self {
+        std.debug.assert(floats_per_vertex >= 3 and indices.len % 3 == 0);
+        const triangle_count = indices.len / 3;
+
+        var arena_state = std.heap.ArenaAllocator.init(allocator);
+        defer arena_state.deinit();
+        const arena = arena_state.allocator();
+
+        const order = try arena.alloc(u32, triangle_count);
+        const centroids = try arena.alloc(Vec3f, triangle_count);
+        const boxes = try arena.alloc(BoundingBox, triangle_count);
+        for (order, centroids, boxes, 0..) |*slot, *centroid, *box, triangle| {
+            slot.* = @intCast(triangle);
+            box.* = BoundingBox.empty;
+            for (0..3) |corner| box.* = box.include(vertex(data, floats_per_vertex, indices[triangle * 3 + corner]));
+            centroid.* = box.center();
+        }
+
+        var nodes = std.ArrayList(Node).init(allocator);
+        errdefer nodes.deinit();
+        var packets = std.ArrayList(Packet).init(allocator);
+        errdefer packets.deinit();
+
+        const Range = struct { node: u32, start: usize, end: usize, depth: u32 };
+        var pending = std.ArrayList(Range).init(arena);
+        try nodes.append(undefined);
+        try pending.append(.{ .node = 0, .start = 0, .end = triangle_count, .depth = 0 });
+
+        while (pending.pop()) |range| {
+            const members = order[range.start..range.end];
+            var box = BoundingBox.empty;
+            var centroid_box = BoundingBox.empty;
+            for (members) |triangle| {
+                box = box.merge(boxes[triangle]);
+                centroid_box = centroid_box.include(centroids[triangle]);
+            }
+
+            if (members.len <= lanes) {
+                nodes.items[range.node] = .{ .box = box, .first = @intCast(packets.items.len), .count = @intCast(members.len) };
+                try packets.append(makePacket(data, floats_per_vertex, indices, members));
+                continue;
+            }
+
+            const split = if (range.depth < sah_depth) sahSplit(members, centroids, boxes, centroid_box) else null;
+            const left_count = split orelse medianSplit(members, centroids, centroid_box);
+
+            const first: u32 = @intCast(nodes.items.len);
+            try nodes.appendNTimes(undefined, 2);
+            nodes.items[range.node] = .{ .box = box, .first = first, .count = 0 };
+
+            const middle = range.start + left_count;
+            try pending.append(.{ .node = first, .start = range.start, .end = middle, .depth = range.depth + 1 });
+            try pending.append(.{ .node = first + 1, .start = middle, .end = range.end, .depth = range.depth + 1 });
+        }
+
+        const owned_nodes = try nodes.toOwnedSlice();
+        errdefer allocator.free(owned_nodes);
+        return .{
+            .allocator = allocator,
+            .nodes = owned_nodes,
+            .packets = try packets.toOwnedSlice(),
+            .triangle_count = triangle_count,
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Closest triangle `ray` hits within `max_distance`, from either side
+    /// Children are visited nearest first and skipped once they start beyond the closest hit
+    pub fn raycast(self: *const Self, ray: Ray, max_distance: f32) ?RayHit {
+        if (self.triangle_count == 0) return null;
+
+        var best: ?RayHit = null;
+        var limit = max_distance;
+        var stack: [max_depth]u32 = undefined;
+        var depth: usize = 0;
+        if (self.nodes[0].box.intersectRay(ray, limit) == null) return null;
+        stack[0] = 0;
+        depth = 1;
+
+        while (depth > 0) {
+            depth -= 1;
+            const node = self.nodes[stack[depth]];
+            if (node.count > 0) {
+                if (testPacket(&self.packets[node.first], ray, limit)) |hit| {
+                    best = hit;
+                    limit = hit.distance;
+                }
+                continue;
+            }
+
+            const near_distance = self.nodes[node.first].box.intersectRay(ray, limit);
+            const far_distance = self.nodes[node.first + 1].box.intersectRay(ray, limit);
+            var near_child = node.first;
+            var far_child = node.first + 1;
+            var near_hit = near_distance;
+            var far_hit = far_distance;
+            if (near_hit == null or (far_hit != null and far_hit.? < near_hit.?)) {
+                std.mem.swap(u32, &near_child, &far_child);
+                std.mem.swap(?f32, &near_hit, &far_hit);
+            }
+            // The nearer child is pushed last so it pops first
+            if (far_hit != null) {
+                stack[depth] = far_child;
+                depth += 1;
+            }
+            if (near_hit != null) {
+                stack[depth] = near_child;
+                depth += 1;
+            }
+        }
+        return best;
+    }
+
+
+    /// System memory of the hierarchy and its triangle packets
+    pub fn byteSize(self: *const Self) usize {
+        return self.nodes.len * @sizeOf(Node) + self.packets.len * @sizeOf(Packet);
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.allocator.free(self.nodes);
+        self.allocator.free(self.packets);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    const Bin = struct {
+        box: BoundingBox = BoundingBox.empty,
+        count: usize = 0,
+    };
+
+
+    /// Partition `members` at the cheapest bin boundary of any axis, returning the size of the left side
+    /// Null when no boundary separates the centroids, e.g. when they all coincide
+    fn sahSplit(members: []u32, centroids: []const Vec3f, boxes: []const BoundingBox, centroid_box: BoundingBox) ?usize {
+        const extent = centroid_box.max.subtract(centroid_box.min);
+        const extents = [3]f32{ extent.x, extent.y, extent.z };
+
+        var best_cost = std.math.inf(f32);
+        var best_axis: u2 = 0;
+        var best_boundary: usize = 0;
+        for (0..3) |axis_index| {
+            const axis: u2 = @intCast(axis_index);
+            if (extents[axis] <= 0.0) continue;
+
+            var bins = [_]Bin{.{}} ** bin_count;
+            for (members) |triangle| {
+                const bin = &bins[binOf(centroids[triangle], centroid_box, extents, axis)];
+                bin.box = bin.box.merge(boxes[triangle]);
+                bin.count += 1;
+            }
+
+            // Right side areas by sweeping from the end, then the left side meets them going forward
+            var right_cost: [bin_count]f32 = undefined;
+            var right = Bin{};
+            var boundary: usize = bin_count - 1;
+            while (boundary > 0) : (boundary -= 1) {
+                right.box = right.box.merge(bins[boundary].box);
+                right.count += bins[boundary].count;
+                right_cost[boundary] = right.box.surfaceArea() * @as(f32, @floatFromInt(right.count));
+            }
+
+            var left = Bin{};
+            for (1..bin_count) |split| {
+                left.box = left.box.merge(bins[split - 1].box);
+                left.count += bins[split - 1].count;
+                if (left.count == 0 or left.count == members.len) continue;
+
+                const cost = left.box.surfaceArea() * @as(f32, @floatFromInt(left.count)) + right_cost[split];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_boundary = split;
+                }
+            }
+        }
+        if (best_boundary == 0) return null;
+
+        // In place partition, triangles in bins below the boundary go left
+        var left_count: usize = 0;
+        for (members, 0..) |triangle, i| {
+            if (binOf(centroids[triangle], centroid_box, extents, best_axis) < best_boundary) {
+                std.mem.swap(u32, &members[i], &members[left_count]);
+                left_count += 1;
+            }
+        }
+        return left_count;
+    }
+
+
+    /// Sort `members` along the longest centroid axis and split in half
+    fn medianSplit(members: []u32, centroids: []const Vec3f, centroid_box: BoundingBox) usize {
+        const extent = centroid_box.max.subtract(centroid_box.min);
+        const axis: u2 = if (extent.x >= extent.y and extent.x >= extent.z) 0 else if (extent.y >= extent.z) 1 else 2;
+        std.sort.pdq(u32, members, CentroidOrder{ .centroids = centroids, .axis = axis }, CentroidOrder.lessThan);
+        return members.len / 2;
+    }
+
+
+    fn binOf(centroid: Vec3f, centroid_box: BoundingBox, extents: [3]f32, axis: u2) usize {
+        const value = axisOf(centroid, axis) - axisOf(centroid_box.min, axis);
+        const bin: usize = @intFromFloat(value / extents[axis] * @as(f32, bin_count));
+        return @min(bin, bin_count - 1);
+    }
+
+
+    fn axisOf(v: Vec3f, axis: u2) f32 {
+        return switch (axis) {
+            0 => v.x,
+            1 => v.y,
+            else => v.z,
+        };
+    }
+
+
+    const CentroidOrder = struct {
+        centroids: []const Vec3f,
+        axis: u2,
+
+        fn lessThan(self: CentroidOrder, a: u32, b: u32) bool {
+            return axisOf(self.centroids[a], self.axis) < axisOf(self.centroids[b], self.axis);
+        }
+    };
+
+
+    fn vertex(data: []const f32, floats_per_vertex: usize, index: u32) Vec3f {
+        const position = data[@as(usize, index) * floats_per_vertex ..][0..3];
+        return Vec3f.create(position[0], position[1], position[2]);
+    }
+
+
+    fn makePacket(data: []const f32, floats_per_vertex: usize, indices: []const u32, triangles: []const u32) Packet {
+        var components: [9][lanes]f32 = undefined;
+        for (&components) |*component| component.* = @splat(0.0);
+        var packet = Packet{ .v0 = undefined, .e1 = undefined, .e2 = undefined, .triangles = @splat(0) };
+
+        for (triangles, 0..) |triangle, lane| {
+            const p0 = vertex(data, floats_per_vertex, indices[triangle * 3]);
+            const e1 = vertex(data, floats_per_vertex, indices[triangle * 3 + 1]).subtract(p0);
+            const e2 = vertex(data, floats_per_vertex, indices[triangle * 3 + 2]).subtract(p0);
+            for ([9]f32{ p0.x, p0.y, p0.z, e1.x, e1.y, e1.z, e2.x, e2.y, e2.z }, 0..) |value, component| {
+                components[component][lane] = value;
+            }
+            packet.triangles[lane] = triangle;
+        }
+
+        for (0..3) |k| {
+            packet.v0[k] = components[k];
+            packet.e1[k] = components[3 + k];
+            packet.e2[k] = components[6 + k];
+        }
+        return packet;
+    }
+
+
+    /// Möller-Trumbore against every lane of a packet, the closest hit nearer than `limit`
+    fn testPacket(packet: *const Packet, ray: Ray, limit: f32) ?RayHit {
+        const dx: V = @splat(ray.direction.x);
+        const dy: V = @splat(ray.direction.y);
+        const dz: V = @splat(ray.direction.z);
+        const e1 = packet.e1;
+        const e2 = packet.e2;
+
+        // p = d x e2, det = e1 . p
+        const px = dy * e2[2] - dz * e2[1];
+        const py = dz * e2[0] - dx * e2[2];
+        const pz = dx * e2[1] - dy * e2[0];
+        const det = e1[0] * px + e1[1] * py + e1[2] * pz;
+        const parallel = @abs(det) < splat(1e-9);
+        const inv_det = splat(1.0) / @select(f32, parallel, splat(1.0), det);
+
+        const tx = splat(ray.origin.x) - packet.v0[0];
+        const ty = splat(ray.origin.y) - packet.v0[1];
+        const tz = splat(ray.origin.z) - packet.v0[2];
+        const u = (tx * px + ty * py + tz * pz) * inv_det;
+
+        // q = t x e1
+        const qx = ty * e1[2] - tz * e1[1];
+        const qy = tz * e1[0] - tx * e1[2];
+        const qz = tx * e1[1] - ty * e1[0];
+        const v = (dx * qx + dy * qy + dz * qz) * inv_det;
+        const t = (e2[0] * qx + e2[1] * qy + e2[2] * qz) * inv_det;
+
+        var hit = not(parallel);
+        hit = both(hit, u >= splat(0.0));
+        hit = both(hit, v >= splat(0.0));
+        hit = both(hit, u + v <= splat(1.0));
+        hit = both(hit, t > splat(1e-6));
+        hit = both(hit, t < splat(limit));
+        if (!@reduce(.Or, hit)) return null;
+
+        const distances: [lanes]f32 = @select(f32, hit, t, splat(std.math.inf(f32)));
+        const lane = std.mem.indexOfMin(f32, &distances);
+        const us: [lanes]f32 = u;
+        const vs: [lanes]f32 = v;
+        return .{ .distance = distances[lane], .triangle = packet.triangles[lane], .u = us[lane], .v = vs[lane] };
+    }
+
+
+    inline fn splat(value: f32) V {
+        return @splat(value);
+    }
+
+
+    inline fn both(a: Mask, b: Mask) Mask {
+        return @select(bool, a, b, @as(Mask, @splat(false)));
+    }
+
+
+    inline fn not(a: Mask) Mask {
+        return @select(bool, a, @as(Mask, @splat(false)), @as(Mask, @splat(true)));
+    }
+};
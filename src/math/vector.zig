@@ -1,11 +1,7 @@
 // math/vector.zig - vector functionalities
 
-const eigen = @cImport({
-    @cInclude("Eigen/eigen_wrapper.h");
-});
-
 const math = @import("std").math;
-const eigen_interface = @import("eigen.zig");
+const backend = @import("backend.zig").active;
 
 const Mat4f = @import("matrix.zig").Mat4f;
 const misc = @import("misc.zig");
@@ -14,7 +10,7 @@ const misc = @import("misc.zig");
 // Public API: Vec2 Implementations
 // ============================================================
 
-pub const Vec2f = struct {
+pub const Vec2f = extern struct {
     x: f32,
     y: f32,
 
@@ -66,27 +62,21 @@ pub const Vec2f = struct {
 
 
 
-    // Eigen based functions - they benefit from its optimizations
+    // Backend functions - native @Vector code by default, Eigen when selected (see backend.zig)
     pub inline fn normalize(v: Vec2f) Vec2f {
-        const eigen_v = eigen_interface.toEigenVec2f(v);
-        const result = eigen.vec2fNormalize(eigen_v);
-        return eigen_interface.fromEigenVec2f(result);
+        return backend.vec2Normalize(v);
     }
 
     pub inline fn length(v: Vec2f) f32 {
-        const eigen_v = eigen_interface.toEigenVec2f(v);
-        return eigen.vec2fLength(eigen_v);
+        return backend.vec2Length(v);
     }
 
     pub inline fn lengthSquared(v: Vec2f) f32 {
-        const eigen_v = eigen_interface.toEigenVec2f(v);
-        return eigen.vec2fLengthSquared(eigen_v);
+        return backend.vec2LengthSquared(v);
     }
     
     pub inline fn distance(a: Vec2f, b: Vec2f) f32 {
-        const eigen_a = eigen_interface.toEigenVec2f(a);
-        const eigen_b = eigen_interface.toEigenVec2f(b);
-        return eigen.vec2fDistance(eigen_a, eigen_b);
+        return backend.vec2Distance(a, b);
     }
 
     
@@ -99,7 +89,7 @@ pub const Vec2f = struct {
 // Public API: Vec3 Implementations
 // ============================================================
 
-pub const Vec3f = struct {
+pub const Vec3f = extern struct {
     x: f32,
     y: f32,
     z: f32,
@@ -132,71 +122,92 @@ pub const Vec3f = struct {
 
 
 
-    // Eigen based functions - they benefit from its optimizations
+    // Backend functions - native @Vector code by default, Eigen when selected (see backend.zig)
     pub inline fn add(a: Vec3f, b: Vec3f) Vec3f {
-        const eigen_a = eigen_interface.toEigenVec3f(a);
-        const eigen_b = eigen_interface.toEigenVec3f(b);
-        const result = eigen.vec3fAdd(eigen_a, eigen_b);
-        return eigen_interface.fromEigenVec3f(result);
+        return backend.vec3Add(a, b);
     }
 
     pub inline fn subtract(a: Vec3f, b: Vec3f) Vec3f {
-        const eigen_a = eigen_interface.toEigenVec3f(a);
-        const eigen_b = eigen_interface.toEigenVec3f(b);
-        const result = eigen.vec3fSubtract(eigen_a, eigen_b);
-        return eigen_interface.fromEigenVec3f(result);
+        return backend.vec3Subtract(a, b);
     }
     
     pub inline fn scale(v: Vec3f, scalar: f32) Vec3f {
-        const eigen_v = eigen_interface.toEigenVec3f(v);
-        const result = eigen.vec3fScale(eigen_v, scalar);
-        return eigen_interface.fromEigenVec3f(result);
+        return backend.vec3Scale(v, scalar);
     }
 
     pub inline fn cross(a: Vec3f, b: Vec3f) Vec3f {
-        const eigen_a = eigen_interface.toEigenVec3f(a);
-        const eigen_b = eigen_interface.toEigenVec3f(b);
-        const result = eigen.vec3fCross(eigen_a, eigen_b);
-        return eigen_interface.fromEigenVec3f(result);
+        return backend.vec3Cross(a, b);
     }
 
     pub inline fn normalize(v: Vec3f) Vec3f {
-        const eigen_v = eigen_interface.toEigenVec3f(v);
-        const result = eigen.vec3fNormalize(eigen_v);
-        return eigen_interface.fromEigenVec3f(result);
+        return backend.vec3Normalize(v);
     }
 
     pub inline fn dot(a: Vec3f, b: Vec3f) f32 {
-        const eigen_a = eigen_interface.toEigenVec3f(a);
-        const eigen_b = eigen_interface.toEigenVec3f(b);
-        return eigen.vec3fDot(eigen_a, eigen_b);
+        return backend.vec3Dot(a, b);
     }
 
     pub inline fn length(v: Vec3f) f32 {
-        const eigen_v = eigen_interface.toEigenVec3f(v);
-        return eigen.vec3fLength(eigen_v);
+        return backend.vec3Length(v);
     }
 
     pub inline fn lengthSquared(v: Vec3f) f32 {
-        const eigen_v = eigen_interface.toEigenVec3f(v);
-        return eigen.vec3fLengthSquared(eigen_v);
+        return backend.vec3LengthSquared(v);
     }
 
     pub inline fn distance(a: Vec3f, b: Vec3f) f32 {
-        const eigen_a = eigen_interface.toEigenVec3f(a);
-        const eigen_b = eigen_interface.toEigenVec3f(b);
-        const diff = eigen.vec3fSubtract(eigen_a, eigen_b);
-        return eigen.vec3fLength(diff);
+        return backend.vec3Distance(a, b);
     }
 
-    // Dependent on a lot of Eigen function
-
     /// Function to perform spherical linear interpolation between two 3D vectors
     pub inline fn slerp(a: Vec3f, b: Vec3f, t: f32) Vec3f {
-        const eigen_a = eigen_interface.toEigenVec3f(a);
-        const eigen_b = eigen_interface.toEigenVec3f(b);
-        const result = eigen.vec3fSlerp(eigen_a, eigen_b, t);
-        return eigen_interface.fromEigenVec3f(result);
+        return backend.vec3Slerp(a, b, t);
+    }
+};
+
+
+
+
+/// Double precision position for large worlds, only stored and subtracted
+/// Differences of nearby positions are exact enough to turn into a Vec3f for rendering and physics
+pub const Vec3d = extern struct {
+    x: f64,
+    y: f64,
+    z: f64,
+
+    pub fn create(x: f64, y: f64, z: f64) Vec3d {
+        return .{ .x = x, .y = y, .z = z };
+    }
+
+    pub fn zero() Vec3d {
+        return .{ .x = 0, .y = 0, .z = 0 };
+    }
+
+    pub fn fromVec3f(v: Vec3f) Vec3d {
+        return .{ .x = v.x, .y = v.y, .z = v.z };
+    }
+
+    /// Rounds to f32, meant for offsets between positions rather than positions themselves
+    pub fn toVec3f(v: Vec3d) Vec3f {
+        return .{ .x = @floatCast(v.x), .y = @floatCast(v.y), .z = @floatCast(v.z) };
+    }
+
+    pub fn add(a: Vec3d, b: Vec3d) Vec3d {
+        return .{ .x = a.x + b.x, .y = a.y + b.y, .z = a.z + b.z };
+    }
+
+    /// `a` plus a single precision offset, e.g. an origin plus a local position
+    pub fn addOffset(a: Vec3d, offset: Vec3f) Vec3d {
+        return .{ .x = a.x + offset.x, .y = a.y + offset.y, .z = a.z + offset.z };
+    }
+
+    pub fn subtract(a: Vec3d, b: Vec3d) Vec3d {
+        return .{ .x = a.x - b.x, .y = a.y - b.y, .z = a.z - b.z };
+    }
+
+    pub fn distance(a: Vec3d, b: Vec3d) f64 {
+        const d = a.subtract(b);
+        return @sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
     }
 };
 
@@ -207,7 +218,7 @@ pub const Vec3f = struct {
 // Public API: Vec4 Implementations
 // ============================================================
 
-pub const Vec4f = struct {
+pub const Vec4f = extern struct {
     x: f32,
     y: f32,
     z: f32,
@@ -251,46 +262,32 @@ pub const Vec4f = struct {
 
 
 
-    // Eigen based functions - they benefit from its optimizations
+    // Backend functions - native @Vector code by default, Eigen when selected (see backend.zig)
     pub inline fn add(a: Vec4f, b: Vec4f) Vec4f {
-        const eigen_a = eigen_interface.toEigenVec4f(a);
-        const eigen_b = eigen_interface.toEigenVec4f(b);
-        const result = eigen.vec4fAdd(eigen_a, eigen_b);
-        return eigen_interface.fromEigenVec4f(result);
+        return backend.vec4Add(a, b);
     }
 
     pub inline fn subtract(a: Vec4f, b: Vec4f) Vec4f {
-        const eigen_a = eigen_interface.toEigenVec4f(a);
-        const eigen_b = eigen_interface.toEigenVec4f(b);
-        const result = eigen.vec4fSubtract(eigen_a, eigen_b);
-        return eigen_interface.fromEigenVec4f(result);
+        return backend.vec4Subtract(a, b);
     }
 
     pub inline fn scale(v: Vec4f, scalar: f32) Vec4f {
-        const eigen_v = eigen_interface.toEigenVec4f(v);
-        const result = eigen.vec4fScale(eigen_v, scalar);
-        return eigen_interface.fromEigenVec4f(result);
+        return backend.vec4Scale(v, scalar);
     }
 
     pub inline fn normalize(v: Vec4f) Vec4f {
-        const eigen_v = eigen_interface.toEigenVec4f(v);
-        const result = eigen.vec4fNormalize(eigen_v);
-        return eigen_interface.fromEigenVec4f(result);
+        return backend.vec4Normalize(v);
     }
 
     pub inline fn dot(a: Vec4f, b: Vec4f) f32 {
-        const eigen_a = eigen_interface.toEigenVec4f(a);
-        const eigen_b = eigen_interface.toEigenVec4f(b);
-        return eigen.vec4fDot(eigen_a, eigen_b);
+        return backend.vec4Dot(a, b);
     }
 
     pub inline fn length(v: Vec4f) f32 {
-        const eigen_v = eigen_interface.toEigenVec4f(v);
-        return eigen.vec4fLength(eigen_v);
+        return backend.vec4Length(v);
     }
 
     pub inline fn lengthSquared(v: Vec4f) f32 {
-        const eigen_v = eigen_interface.toEigenVec4f(v);
-        return eigen.vec4fLengthSquared(eigen_v);
+        return backend.vec4LengthSquared(v);
     }
 };
\ No newline at end of file
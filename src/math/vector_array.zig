@@ -0,0 +1,227 @@
+// math/vector_array.zig - kernels over many vectors at once, in separate component arrays or interleaved
+
+const std = @import("std");
+
+/// Floats per @Vector step, one AVX register or two NEON ones
+const lanes = 8;
+const V = @Vector(lanes, f32);
+
+
+// ============================================================
+// Public API: Views
+// ============================================================
+
+/// View of `len` vectors of `n` floats, component c of vector i at components[c][i * stride]
+/// Separate arrays per component (SoA) have a stride of 1 and run the kernels' @Vector loops.
+/// Interleaved vectors (AoS) are strided, 3 floats for Vec3f, 4 for Vec4f or the size of a struct
+/// holding the vector as a field, and take the element loop. Kernels read inputs through the view only
+pub fn VecSlice(comptime n: usize) type {
+    return struct {
+        const Self = @This();
+
+        pub const dimensions = n;
+
+        components: [n][*]f32,
+        /// Floats from one vector to the next
+        stride: usize,
+        len: usize,
+
+
+        /// One array per component, all of the same length
+        pub fn soa(arrays: [n][]f32) Self {
+            var components: [n][*]f32 = undefined;
+            for (&components, arrays) |*component, array| {
+                std.debug.assert(array.len == arrays[0].len);
+                component.* = array.ptr;
+            }
+            return .{ .components = components, .stride = 1, .len = arrays[0].len };
+        }
+
+
+        /// Vectors of n floats laid out one after another, e.g. []Vec3f for n = 3 or []Vec4f for n = 4
+        pub fn aos(comptime T: type, items: []T) Self {
+            comptime std.debug.assert(@sizeOf(T) == n * @sizeOf(f32));
+            return strided(@ptrCast(@alignCast(items.ptr)), n, items.len);
+        }
+
+
+        /// The vector field `name` of every item, such as the velocities of a slice of particles
+        pub fn field(comptime T: type, items: []T, comptime name: []const u8) Self {
+            comptime {
+                std.debug.assert(@sizeOf(@FieldType(T, name)) == n * @sizeOf(f32));
+                std.debug.assert(@sizeOf(T) % @sizeOf(f32) == 0 and @offsetOf(T, name) % @sizeOf(f32) == 0);
+            }
+            const bytes: [*]u8 = @ptrCast(items.ptr);
+            return strided(@ptrCast(@alignCast(bytes + @offsetOf(T, name))), @sizeOf(T) / @sizeOf(f32), items.len);
+        }
+
+
+        /// Vectors start..end, for splitting a kernel across jobs
+        pub fn slice(self: Self, start: usize, end: usize) Self {
+            std.debug.assert(start <= end and end <= self.len);
+            var result = self;
+            for (&result.components) |*component| component.* += start * self.stride;
+            result.len = end - start;
+            return result;
+        }
+
+
+        pub fn get(self: Self, index: usize) [n]f32 {
+            var value: [n]f32 = undefined;
+            for (&value, self.components) |*v, component| v.* = component[index * self.stride];
+            return value;
+        }
+
+
+        pub fn set(self: Self, index: usize, value: [n]f32) void {
+            for (value, self.components) |v, component| component[index * self.stride] = v;
+        }
+
+
+        fn strided(base: [*]f32, stride: usize, len: usize) Self {
+            var components: [n][*]f32 = undefined;
+            for (&components, 0..) |*component, c| component.* = base + c;
+            return .{ .components = components, .stride = stride, .len = len };
+        }
+    };
+}
+
+pub const Vec2Slice = VecSlice(2);
+pub const Vec3Slice = VecSlice(3);
+pub const Vec4Slice = VecSlice(4);
+
+
+// ============================================================
+// Public API: Kernels
+// ============================================================
+
+/// y += a * x, e.g. positions += dt * velocities
+pub fn axpy(y: anytype, a: f32, x: @TypeOf(y)) void {
+    std.debug.assert(x.len == y.len);
+    const va: V = @splat(a);
+    for (y.components, x.components) |yc, xc| {
+        var i: usize = 0;
+        if (y.stride == 1 and x.stride == 1) {
+            while (i + lanes <= y.len) : (i += lanes) store(yc, i, @mulAdd(V, va, load(xc, i), load(yc, i)));
+        }
+        while (i < y.len) : (i += 1) yc[i * y.stride] += a * xc[i * x.stride];
+    }
+}
+
+
+/// v *= s
+pub fn scaleMany(v: anytype, s: f32) void {
+    const vs: V = @splat(s);
+    for (v.components) |vc| {
+        var i: usize = 0;
+        if (v.stride == 1) {
+            while (i + lanes <= v.len) : (i += lanes) store(vc, i, load(vc, i) * vs);
+        }
+        while (i < v.len) : (i += 1) vc[i * v.stride] *= s;
+    }
+}
+
+
+/// Scale every vector to unit length, zero vectors stay zero
+pub fn normalizeMany(v: anytype) void {
+    const n = @TypeOf(v).dimensions;
+    var i: usize = 0;
+    if (v.stride == 1) {
+        const zero: V = @splat(0.0);
+        const one: V = @splat(1.0);
+        while (i + lanes <= v.len) : (i += lanes) {
+            var c: [n]V = undefined;
+            var length_sq = zero;
+            inline for (0..n) |k| {
+                c[k] = load(v.components[k], i);
+                length_sq = @mulAdd(V, c[k], c[k], length_sq);
+            }
+            const scale = @select(f32, length_sq > zero, one / @sqrt(length_sq), zero);
+            inline for (0..n) |k| store(v.components[k], i, c[k] * scale);
+        }
+    }
+    while (i < v.len) : (i += 1) {
+        const value = v.get(i);
+        var length_sq: f32 = 0.0;
+        for (value) |c| length_sq += c * c;
+        const scale: f32 = if (length_sq > 0.0) 1.0 / @sqrt(length_sq) else 0.0;
+        for (v.components) |component| component[i * v.stride] *= scale;
+    }
+}
+
+
+/// out[i] = dot(a[i], b[i])
+pub fn dotMany(a: anytype, b: @TypeOf(a), out: []f32) void {
+    const n = @TypeOf(a).dimensions;
+    std.debug.assert(a.len == b.len and out.len >= a.len);
+    var i: usize = 0;
+    if (a.stride == 1 and b.stride == 1) {
+        while (i + lanes <= a.len) : (i += lanes) {
+            var sum: V = @splat(0.0);
+            inline for (0..n) |k| sum = @mulAdd(V, load(a.components[k], i), load(b.components[k], i), sum);
+            store(out.ptr, i, sum);
+        }
+    }
+    while (i < a.len) : (i += 1) {
+        var sum: f32 = 0.0;
+        for (a.get(i), b.get(i)) |x, y| sum += x * y;
+        out[i] = sum;
+    }
+}
+
+
+/// out[i] = |a[i] - b[i]|², compare against a squared radius to skip the root
+pub fn distanceSqMany(a: anytype, b: @TypeOf(a), out: []f32) void {
+    const n = @TypeOf(a).dimensions;
+    std.debug.assert(a.len == b.len and out.len >= a.len);
+    var i: usize = 0;
+    if (a.stride == 1 and b.stride == 1) {
+        while (i + lanes <= a.len) : (i += lanes) {
+            var sum: V = @splat(0.0);
+            inline for (0..n) |k| {
+                const d = load(a.components[k], i) - load(b.components[k], i);
+                sum = @mulAdd(V, d, d, sum);
+            }
+            store(out.ptr, i, sum);
+        }
+    }
+    while (i < a.len) : (i += 1) {
+        var sum: f32 = 0.0;
+        for (a.get(i), b.get(i)) |x, y| sum += (x - y) * (x - y);
+        out[i] = sum;
+    }
+}
+
+
+/// out = a + (b - a) * t, `out` may be `a` or `b`
+pub fn lerpMany(out: anytype, a: @TypeOf(out), b: @TypeOf(out), t: f32) void {
+    std.debug.assert(a.len == out.len and b.len == out.len);
+    const vt: V = @splat(t);
+    for (out.components, a.components, b.components) |oc, ac, bc| {
+        var i: usize = 0;
+        if (out.stride == 1 and a.stride == 1 and b.stride == 1) {
+            while (i + lanes <= out.len) : (i += lanes) {
+                const from = load(ac, i);
+                store(oc, i, @mulAdd(V, load(bc, i) - from, vt, from));
+            }
+        }
+        while (i < out.len) : (i += 1) {
+            const from = ac[i * a.stride];
+            oc[i * out.stride] = from + (bc[i * b.stride] - from) * t;
+        }
+    }
+}
+
+
+// ============================================================
+// Private: Helper Functions
+// ============================================================
+
+inline fn load(ptr: [*]const f32, index: usize) V {
+    return ptr[index..][0..lanes].*;
+}
+
+
+inline fn store(ptr: [*]f32, index: usize, value: V) void {
+    ptr[index..][0..lanes].* = value;
+}
@@ -0,0 +1,232 @@
+// graphics/animation.zig - skeletons, clips and pose evaluation for skinned meshes
+const std = @import("std");
+
+const Mat4f = @import("../math/matrix.zig").Mat4f;
+const Vec3f = @import("../math/vector.zig").Vec3f;
+const Quatf = @import("../math/quaternion.zig").Quatf;
+
+
+pub const AnimationError = error{
+    /// A joint's parent does not come before it
+    InvalidHierarchy,
+    /// Slices handed in disagree on the joint or key count
+    InvalidJointCount,
+    /// Key times are not ascending
+    InvalidKeyframes,
+};
+
+
+/// Local transform of one joint relative to its parent
+pub const JointTransform = struct {
+    translation: Vec3f = .{ .x = 0.0, .y = 0.0, .z = 0.0 },
+    rotation: Quatf = Quatf.identity(),
+    scale: Vec3f = .{ .x = 1.0, .y = 1.0, .z = 1.0 },
+
+    pub fn toMatrix(self: JointTransform) Mat4f {
+        return Mat4f.compose(self.translation, self.rotation, self.scale);
+    }
+
+
+    /// Translation and scale blend linearly, rotation takes the shorter way round
+    pub fn lerp(a: JointTransform, b: JointTransform, t: f32) JointTransform {
+        return .{
+            .translation = a.translation.lerp(b.translation, t),
+            .rotation = a.rotation.nlerp(b.rotation, t),
+            .scale = a.scale.lerp(b.scale, t),
+        };
+    }
+};
+
+
+/// Joint hierarchy of a skinned mesh, ordered so every parent comes before its children
+/// Palette index i of a SkinVertex refers to joint i
+pub const Skeleton = struct {
+    pub const no_parent = std.math.maxInt(u16);
+
+    allocator: std.mem.Allocator,
+    parents: []u16,
+    /// Mesh space to joint space at bind time
+    inverse_bind: []Mat4f,
+    /// Pose of joints a clip has no keys for
+    rest_pose: []JointTransform,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Copies the slices, fails with InvalidHierarchy unless each parent precedes its child
+    pub fn init(allocator: std.mem.Allocator, parents: []const u16, inverse_bind: []const Mat4f, rest_pose: []const JointTransform) !Skeleton {
+        if (inverse_bind.len != parents.len or rest_pose.len != parents.len) return AnimationError.InvalidJointCount;
+        for (parents, 0..) |parent, joint| {
+            if (parent != no_parent and parent >= joint) return AnimationError.InvalidHierarchy;
+        }
+
+        const owned_parents = try allocator.dupe(u16, parents);
+        errdefer allocator.free(owned_parents);
+        const owned_inverse_bind = try allocator.dupe(Mat4f, inverse_bind);
+        errdefer allocator.free(owned_inverse_bind);
+        const owned_rest_pose = try allocator.dupe(JointTransform, rest_pose);
+
+        return .{
+            .allocator = allocator,
+            .parents = owned_parents,
+            .inverse_bind = owned_inverse_bind,
+            .rest_pose = owned_rest_pose,
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    pub fn jointCount(self: *const Skeleton) usize {
+        return self.parents.len;
+    }
+
+
+    /// Skinning matrices of `pose`, joint model matrix times inverse bind matrix
+    /// `model` is scratch of one matrix per joint, it holds the joint model matrices afterwards
+    /// The hierarchy walk is serial, the inverse bind products go through one batched multiply
+    pub fn computeSkinMatrices(self: *const Skeleton, pose: []const JointTransform, model: []Mat4f, out: []Mat4f) void {
+        std.debug.assert(pose.len == self.parents.len and model.len == pose.len and out.len == pose.len);
+        for (pose, self.parents, 0..) |joint, parent, index| {
+            const local = joint.toMatrix();
+            if (parent == no_parent) {
+                model[index] = local;
+            } else {
+                model[index].multiplyInto(&model[parent], &local);
+            }
+        }
+        Mat4f.multiplyBatch(model, self.inverse_bind, out);
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Skeleton) void {
+        self.allocator.free(self.parents);
+        self.allocator.free(self.inverse_bind);
+        self.allocator.free(self.rest_pose);
+    }
+};
+
+
+/// Keyframed local transforms of the joints of one skeleton
+/// Each joint has its own track, tracks without keys leave the joint at its rest pose
+pub const AnimationClip = struct {
+    pub const Track = struct {
+        /// Ascending, in seconds
+        times: []f32 = &.{},
+        keys: []JointTransform = &.{},
+    };
+
+    allocator: std.mem.Allocator,
+    /// Length in seconds, the playback time wraps or clamps at it
+    duration: f32,
+    looping: bool = true,
+    tracks: []Track,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// An empty clip for `joint_count` joints, fill it with setTrack
+    pub fn init(allocator: std.mem.Allocator, joint_count: usize, duration: f32) !AnimationClip {
+        const tracks = try allocator.alloc(Track, joint_count);
+        @memset(tracks, .{});
+        return .{ .allocator = allocator, .duration = duration, .tracks = tracks };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Copy the keys of one joint, replacing the ones it had
+    pub fn setTrack(self: *AnimationClip, joint: usize, times: []const f32, keys: []const JointTransform) !void {
+        if (times.len != keys.len or joint >= self.tracks.len) return AnimationError.InvalidJointCount;
+        for (1..times.len) |i| {
+            if (times[i] < times[i - 1]) return AnimationError.InvalidKeyframes;
+        }
+
+        const owned_times = try self.allocator.dupe(f32, times);
+        errdefer self.allocator.free(owned_times);
+        const owned_keys = try self.allocator.dupe(JointTransform, keys);
+
+        self.freeTrack(&self.tracks[joint]);
+        self.tracks[joint] = .{ .times = owned_times, .keys = owned_keys };
+    }
+
+
+    /// Playback time of `time` after wrapping or clamping to the clip
+    pub fn wrapTime(self: *const AnimationClip, time: f32) f32 {
+        if (self.duration <= 0.0) return 0.0;
+        if (self.looping) return @mod(time, self.duration);
+        return std.math.clamp(time, 0.0, self.duration);
+    }
+
+
+    /// Local pose at `time`, interpolated between the two surrounding keys of every track
+    pub fn sample(self: *const AnimationClip, skeleton: *const Skeleton, time: f32, out: []JointTransform) void {
+        std.debug.assert(out.len == skeleton.jointCount() and self.tracks.len == out.len);
+        const t = self.wrapTime(time);
+        for (self.tracks, skeleton.rest_pose, out) |track, rest, *joint| {
+            joint.* = sampleTrack(track, t) orelse rest;
+        }
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *AnimationClip) void {
+        for (self.tracks) |*track| self.freeTrack(track);
+        self.allocator.free(self.tracks);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn freeTrack(self: *AnimationClip, track: *Track) void {
+        self.allocator.free(track.times);
+        self.allocator.free(track.keys);
+        track.* = .{};
+    }
+
+
+    fn sampleTrack(track: Track, time: f32) ?JointTransform {
+        const times = track.times;
+        if (times.len == 0) return null;
+        if (time <= times[0]) return track.keys[0];
+        if (time >= times[times.len - 1]) return track.keys[times.len - 1];
+
+        // First key after `time`, the one before it starts the segment
+        var low: usize = 1;
+        var high: usize = times.len - 1;
+        while (low < high) {
+            const mid = low + (high - low) / 2;
+            if (times[mid] <= time) low = mid + 1 else high = mid;
+        }
+        const next = low;
+        const span = times[next] - times[next - 1];
+        const t = if (span > 0.0) (time - times[next - 1]) / span else 0.0;
+        return JointTransform.lerp(track.keys[next - 1], track.keys[next], t);
+    }
+};
+
+
+/// Blend `b` over `a` by `weight` per joint into `out`, which may alias `a`
+pub fn blendPoses(a: []const JointTransform, b: []const JointTransform, weight: f32, out: []JointTransform) void {
+    std.debug.assert(a.len == b.len and out.len == a.len);
+    for (a, b, out) |from, to, *joint| {
+        joint.* = JointTransform.lerp(from, to, weight);
+    }
+}
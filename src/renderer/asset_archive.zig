@@ -0,0 +1,509 @@
+// graphics/asset_archive.zig
+const std = @import("std");
+const builtin = @import("builtin");
+const c = @import("../bindings/c.zig");
+
+const mesh_module = @import("mesh.zig");
+const Mesh = mesh_module.Mesh;
+const EncodedMesh = mesh_module.EncodedMesh;
+const IndexType = mesh_module.IndexType;
+const VertexFormat = mesh_module.VertexFormat;
+const Texture = @import("texture.zig").Texture;
+const texture_container = @import("texture_container.zig");
+const CompressedImage = texture_container.CompressedImage;
+const BoundingBox = @import("../math/bounds.zig").BoundingBox;
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+const lz4 = @import("../core/lz4.zig");
+
+
+pub const AssetArchiveError = error{
+    /// Wrong magic or version, or a table reaching past the end of the file
+    InvalidArchive,
+    AssetNotFound,
+    /// The asset exists but is of another kind than requested
+    WrongAssetKind,
+};
+
+
+pub const AssetKind = enum(u32) {
+    mesh = 1,
+    texture = 2,
+    /// Raw bytes, e.g. GLSL sources checked at cook time
+    source = 3,
+};
+
+
+/// How a blob is stored, compressed ones are an lz4 stream of independently decodable blocks
+pub const Compression = enum(u32) {
+    none = 0,
+    lz4 = 1,
+};
+
+
+/// Mesh blob: the vertex bytes in the VBO layout, then the index bytes, both aligned
+pub const MeshInfo = extern struct {
+    package_size: u32,
+    vertex_format: u32,
+    index_type: u32,
+    padding: u32 = 0,
+    vertex_bytes: u64,
+    index_bytes: u64,
+    bounds: BoundingBox,
+};
+
+
+/// Texture blob: the stored mip levels back to back, largest first
+pub const TextureInfo = extern struct {
+    /// GL internal format for glCompressedTexImage2D
+    format: u32,
+    width: u32,
+    height: u32,
+    level_count: u32,
+};
+
+
+/// Packed, pre-cooked assets read straight from a memory mapping
+/// The file starts with a header and a table of contents, followed by the asset names and the
+/// blobs at `blob_alignment`. Meshes are stored in their VBO and EBO layout and textures as block
+/// compressed mip chains, so loading hands slices of the mapping to glBufferData and
+/// glCompressedTexImage2D without decoding or copying. Blobs written compressed are decoded block by
+/// block on the job system instead, which beats reading them raw wherever the disk is the bottleneck
+/// Write archives with ArchiveWriter
+pub const AssetArchive = struct {
+    const Self = @This();
+
+    pub const magic = [4]u8{ 'Z', 'P', 'A', 'K' };
+    pub const version = 2;
+    /// Version 1 archives read as they are, the field holding the compression was padding there and zero
+    pub const min_version = 1;
+    /// Offset alignment of every blob
+    pub const blob_alignment = 256;
+
+    pub const Header = extern struct {
+        magic: [4]u8 = magic,
+        version: u32 = version,
+        entry_count: u32,
+        /// Offset of the name bytes, the table of contents follows the header directly
+        names_offset: u32,
+    };
+
+    pub const Entry = extern struct {
+        name_offset: u32,
+        name_len: u32,
+        kind: AssetKind,
+        compression: Compression = .none,
+        data_offset: u64,
+        data_size: u64,
+        info: extern union {
+            mesh: MeshInfo,
+            texture: TextureInfo,
+        },
+    };
+
+    allocator: std.mem.Allocator,
+    /// Mapped file on POSIX, one read of the whole file on Windows
+    bytes: []align(std.heap.page_size_min) const u8,
+    entries: []const Entry,
+    /// Name to entry index, the keys are slices of the mapping
+    lookup: std.StringHashMap(u32),
+    /// Decodes compressed blobs in parallel when set, on the calling thread otherwise
+    job_system: ?*JobSystem = null,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Map `path` and check its tables once, the blobs are not touched until an asset is created
+    pub fn open(allocator: std.mem.Allocator, path: []const u8) !*Self {
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+
+        const bytes = try mapFile(allocator, path);
+        errdefer unmapFile(allocator, bytes);
+
+        if (bytes.len < @sizeOf(Header)) return AssetArchiveError.InvalidArchive;
+        const header = std.mem.bytesAsValue(Header, bytes[0..@sizeOf(Header)]);
+        if (!std.mem.eql(u8, &header.magic, &magic) or header.version < min_version or header.version > version) {
+            return AssetArchiveError.InvalidArchive;
+        }
+
+        const toc_end = @sizeOf(Header) + @as(usize, header.entry_count) * @sizeOf(Entry);
+        if (toc_end > bytes.len or header.names_offset > bytes.len) return AssetArchiveError.InvalidArchive;
+        const entries: []const Entry = @alignCast(std.mem.bytesAsSlice(Entry, bytes[@sizeOf(Header)..toc_end]));
+
+        self.* = .{
+            .allocator = allocator,
+            .bytes = bytes,
+            .entries = entries,
+            .lookup = std.StringHashMap(u32).init(allocator),
+        };
+        errdefer self.lookup.deinit();
+
+        try self.lookup.ensureTotalCapacity(header.entry_count);
+        for (entries, 0..) |entry, i| {
+            const name_start = @as(usize, header.names_offset) + entry.name_offset;
+            if (name_start + entry.name_len > bytes.len or entry.data_offset + entry.data_size > bytes.len) {
+                return AssetArchiveError.InvalidArchive;
+            }
+            self.lookup.putAssumeCapacity(bytes[name_start..][0..entry.name_len], @intCast(i));
+        }
+        return self;
+    }
+
+
+    /// Upload the mesh `name`, in the argument order ResourceCollection.createResource calls with
+    pub fn createMesh(allocator: std.mem.Allocator, self: *const Self, name: []const u8) !*Mesh {
+        const entry = try self.find(name, .mesh);
+        const info = entry.info.mesh;
+
+        const blob = try self.decodedBlob(entry);
+        defer self.releaseBlob(entry, blob);
+        const index_start = std.mem.alignForward(usize, info.vertex_bytes, blob_alignment);
+        if (index_start + info.index_bytes > blob.len) return AssetArchiveError.InvalidArchive;
+
+        return Mesh.createFromEncoded(
+            allocator,
+            blob[0..info.vertex_bytes],
+            blob[index_start..][0..info.index_bytes],
+            std.meta.intToEnum(IndexType, info.index_type) catch return AssetArchiveError.InvalidArchive,
+            std.math.cast(u4, info.package_size) orelse return AssetArchiveError.InvalidArchive,
+            std.meta.intToEnum(VertexFormat, info.vertex_format) catch return AssetArchiveError.InvalidArchive,
+            info.bounds,
+        );
+    }
+
+
+    /// Upload the compressed texture `name` with its stored mips, argument order as createMesh
+    pub fn createTexture(allocator: std.mem.Allocator, self: *const Self, name: []const u8) !*Texture {
+        const entry = try self.find(name, .texture);
+        const info = entry.info.texture;
+        if (info.width == 0 or info.height == 0 or info.level_count == 0 or info.level_count > CompressedImage.max_levels) {
+            return AssetArchiveError.InvalidArchive;
+        }
+
+        const blob = try self.decodedBlob(entry);
+        defer self.releaseBlob(entry, blob);
+        var image = CompressedImage{ .format = info.format };
+        const block_bytes = texture_container.blockBytes(info.format);
+
+        var cursor: usize = 0;
+        for (0..info.level_count) |level| {
+            const w = @max(info.width >> @intCast(level), 1);
+            const h = @max(info.height >> @intCast(level), 1);
+            const size = texture_container.levelSize(w, h, block_bytes);
+            if (cursor + size > blob.len) return AssetArchiveError.InvalidArchive;
+
+            image.levels[level] = .{ .width = w, .height = h, .data = blob[cursor..][0..size] };
+            image.level_count += 1;
+            cursor += size;
+        }
+        return Texture.createCompressed(allocator, &image);
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Bytes of the source asset `name`, a slice of the mapping valid until close
+    pub fn sourceBytes(self: *const Self, name: []const u8) ![]const u8 {
+        const entry = try self.find(name, .source);
+        // ArchiveWriter stores sources as they are, so this slice never needs an owner
+        if (entry.compression != .none) return AssetArchiveError.InvalidArchive;
+        return self.blob(entry);
+    }
+
+
+    /// Bytes the blob of `name` decodes to, to size the destination of decodeInto
+    pub fn decodedSize(self: *const Self, name: []const u8) !usize {
+        const index = self.lookup.get(name) orelse return AssetArchiveError.AssetNotFound;
+        const entry = &self.entries[index];
+        if (entry.compression == .none) return self.blob(entry).len;
+        return std.math.cast(usize, try lz4.streamRawSize(self.blob(entry))) orelse AssetArchiveError.InvalidArchive;
+    }
+
+
+    /// Decode the blob of `name` straight into `dest` of decodedSize bytes, e.g. a mapped staging buffer
+    pub fn decodeInto(self: *const Self, name: []const u8, dest: []u8) !void {
+        const index = self.lookup.get(name) orelse return AssetArchiveError.AssetNotFound;
+        const entry = &self.entries[index];
+        switch (entry.compression) {
+            .none => {
+                if (dest.len != entry.data_size) return AssetArchiveError.InvalidArchive;
+                @memcpy(dest, self.blob(entry));
+            },
+            .lz4 => try lz4.decompressStream(self.blob(entry), dest, self.job_system),
+        }
+    }
+
+
+    pub fn contains(self: *const Self, name: []const u8) bool {
+        return self.lookup.contains(name);
+    }
+
+
+    pub fn kindOf(self: *const Self, name: []const u8) ?AssetKind {
+        const index = self.lookup.get(name) orelse return null;
+        return self.entries[index].kind;
+    }
+
+
+    /// Name of the entry at `index`, in table of contents order
+    pub fn nameAt(self: *const Self, index: usize) []const u8 {
+        const header = std.mem.bytesAsValue(Header, self.bytes[0..@sizeOf(Header)]);
+        const entry = self.entries[index];
+        return self.bytes[@as(usize, header.names_offset) + entry.name_offset ..][0..entry.name_len];
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Unmap the file, assets created from it keep their GPU copies
+    pub fn close(self: *Self) void {
+        self.lookup.deinit();
+        unmapFile(self.allocator, self.bytes);
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn find(self: *const Self, name: []const u8, kind: AssetKind) !*const Entry {
+        const index = self.lookup.get(name) orelse return AssetArchiveError.AssetNotFound;
+        const entry = &self.entries[index];
+        if (entry.kind != kind) return AssetArchiveError.WrongAssetKind;
+        return entry;
+    }
+
+
+    fn blob(self: *const Self, entry: *const Entry) []const u8 {
+        return self.bytes[entry.data_offset..][0..entry.data_size];
+    }
+
+
+    /// The blob as stored, or decoded into an allocation for compressed entries, see releaseBlob
+    fn decodedBlob(self: *const Self, entry: *const Entry) ![]const u8 {
+        if (entry.compression == .none) return self.blob(entry);
+
+        const stream = self.blob(entry);
+        const size = std.math.cast(usize, try lz4.streamRawSize(stream)) orelse return AssetArchiveError.InvalidArchive;
+        const bytes = try self.allocator.alloc(u8, size);
+        errdefer self.allocator.free(bytes);
+        try lz4.decompressStream(stream, bytes, self.job_system);
+        return bytes;
+    }
+
+
+    fn releaseBlob(self: *const Self, entry: *const Entry, bytes: []const u8) void {
+        if (entry.compression != .none) self.allocator.free(bytes);
+    }
+
+
+    /// Windows has no std mmap, the file is read in one call into a page aligned buffer instead
+    fn mapFile(allocator: std.mem.Allocator, path: []const u8) ![]align(std.heap.page_size_min) const u8 {
+        const file = try std.fs.cwd().openFile(path, .{});
+        defer file.close();
+        const size: usize = @intCast(try file.getEndPos());
+        if (size == 0) return AssetArchiveError.InvalidArchive;
+
+        if (builtin.os.tag == .windows) {
+            const buffer = try allocator.alignedAlloc(u8, std.heap.page_size_min, size);
+            errdefer allocator.free(buffer);
+            if (try file.readAll(buffer) != size) return AssetArchiveError.InvalidArchive;
+            return buffer;
+        }
+        return std.posix.mmap(null, size, std.posix.PROT.READ, .{ .TYPE = .PRIVATE }, file.handle, 0);
+    }
+
+
+    fn unmapFile(allocator: std.mem.Allocator, bytes: []align(std.heap.page_size_min) const u8) void {
+        if (builtin.os.tag == .windows) {
+            allocator.free(bytes);
+        } else {
+            std.posix.munmap(bytes);
+        }
+    }
+};
+
+
+/// Builds an AssetArchive file, the cooking side of the format
+/// Added data is copied, so sources can be freed right after each add
+pub const ArchiveWriter = struct {
+    const Self = @This();
+    const Entry = AssetArchive.Entry;
+
+    allocator: std.mem.Allocator,
+    entries: std.ArrayList(Entry),
+    names: std.ArrayList(u8),
+    /// Blob bytes, offsets in the entries are relative to the blob section until write
+    blobs: std.ArrayList(u8),
+    /// Compression of the mesh and texture blobs added from now on, blobs that don't shrink stay stored
+    /// Sources are always stored, sourceBytes hands out slices of the mapping
+    compression: Compression = .none,
+    /// Compresses blocks in parallel when set
+    job_system: ?*JobSystem = null,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator) Self {
+        return .{
+            .allocator = allocator,
+            .entries = std.ArrayList(Entry).init(allocator),
+            .names = std.ArrayList(u8).init(allocator),
+            .blobs = std.ArrayList(u8).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Store a mesh in the layout Mesh.createFromEncoded uploads
+    pub fn addMesh(self: *Self, name: []const u8, mesh: *const EncodedMesh) !void {
+        const start = try self.beginBlob();
+        try self.blobs.appendSlice(mesh.vertices);
+        try self.pad();
+        try self.blobs.appendSlice(mesh.indices);
+
+        const compression = try self.compressFrom(start);
+        try self.addEntry(name, .mesh, start, compression, .{ .mesh = .{
+            .package_size = mesh.package_size,
+            .vertex_format = @intFromEnum(mesh.vertex_format),
+            .index_type = @intFromEnum(mesh.index_type),
+            .vertex_bytes = mesh.vertices.len,
+            .index_bytes = mesh.indices.len,
+            .bounds = mesh.bounds,
+        } });
+    }
+
+
+    /// Store a block compressed image with its mip chain, e.g. one parsed from a DDS or KTX2 file
+    pub fn addTexture(self: *Self, name: []const u8, image: *const CompressedImage) !void {
+        const levels = image.mipLevels();
+        if (levels.len == 0) return AssetArchiveError.InvalidArchive;
+
+        const start = try self.beginBlob();
+        for (levels) |level| try self.blobs.appendSlice(level.data);
+
+        const compression = try self.compressFrom(start);
+        try self.addEntry(name, .texture, start, compression, .{ .texture = .{
+            .format = image.format,
+            .width = levels[0].width,
+            .height = levels[0].height,
+            .level_count = @intCast(levels.len),
+        } });
+    }
+
+
+    /// Store raw bytes, read back with AssetArchive.sourceBytes
+    pub fn addSource(self: *Self, name: []const u8, bytes: []const u8) !void {
+        const start = try self.beginBlob();
+        try self.blobs.appendSlice(bytes);
+        try self.addEntry(name, .source, start, .none, .{ .texture = std.mem.zeroes(TextureInfo) });
+    }
+
+
+    /// Copy every entry of `archive` as it is, compressed or not, e.g. to assemble a build from cached pieces
+    pub fn appendArchive(self: *Self, archive: *const AssetArchive) !void {
+        for (archive.entries, 0..) |entry, i| {
+            const start = try self.beginBlob();
+            try self.blobs.appendSlice(archive.blob(&entry));
+            // Blob internals like the mesh index offset are relative to the blob start, which stays aligned
+            try self.addEntry(archive.nameAt(i), entry.kind, start, entry.compression, entry.info);
+        }
+    }
+
+
+    /// Write the header, the table of contents, the names and the blobs to `path`
+    pub fn write(self: *Self, path: []const u8) !void {
+        const toc_end = @sizeOf(AssetArchive.Header) + self.entries.items.len * @sizeOf(Entry);
+        const blobs_offset = std.mem.alignForward(usize, toc_end + self.names.items.len, AssetArchive.blob_alignment);
+
+        const header = AssetArchive.Header{
+            .entry_count = @intCast(self.entries.items.len),
+            .names_offset = @intCast(toc_end),
+        };
+
+        const file = try std.fs.cwd().createFile(path, .{});
+        defer file.close();
+        var buffered = std.io.bufferedWriter(file.writer());
+        const writer = buffered.writer();
+
+        try writer.writeAll(std.mem.asBytes(&header));
+        for (self.entries.items) |entry| {
+            var placed = entry;
+            placed.data_offset += blobs_offset;
+            try writer.writeAll(std.mem.asBytes(&placed));
+        }
+        try writer.writeAll(self.names.items);
+        try writer.writeByteNTimes(0, blobs_offset - toc_end - self.names.items.len);
+        try writer.writeAll(self.blobs.items);
+        try buffered.flush();
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.entries.deinit();
+        self.names.deinit();
+        self.blobs.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Pad the blob section to the alignment and return the offset of the next blob
+    fn beginBlob(self: *Self) !usize {
+        try self.pad();
+        return self.blobs.items.len;
+    }
+
+
+    fn pad(self: *Self) !void {
+        const aligned = std.mem.alignForward(usize, self.blobs.items.len, AssetArchive.blob_alignment);
+        try self.blobs.appendNTimes(0, aligned - self.blobs.items.len);
+    }
+
+
+    /// Replace the blob from `start` with its lz4 stream if compression is on and it comes out smaller
+    fn compressFrom(self: *Self, start: usize) !Compression {
+        if (self.compression == .none) return .none;
+
+        const raw_size = self.blobs.items.len - start;
+        const stream = try lz4.compressStream(self.allocator, self.blobs.items[start..], self.job_system);
+        defer self.allocator.free(stream);
+        if (stream.len >= raw_size) return .none;
+
+        self.blobs.shrinkRetainingCapacity(start);
+        try self.blobs.appendSlice(stream);
+        return .lz4;
+    }
+
+
+    fn addEntry(self: *Self, name: []const u8, kind: AssetKind, start: usize, compression: Compression, info: @FieldType(Entry, "info")) !void {
+        try self.entries.append(.{
+            .name_offset = @intCast(self.names.items.len),
+            .name_len = @intCast(name.len),
+            .kind = kind,
+            .compression = compression,
+            .data_offset = start,
+            .data_size = self.blobs.items.len - start,
+            .info = info,
+        });
+        try self.names.appendSlice(name);
+    }
+};
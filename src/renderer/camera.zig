@@ -5,17 +5,29 @@ const c = @import("../bindings/c.zig");
 const Renderer = @import("renderer.zig").Renderer;
 const Model = @import("model.zig").Model;
 const Mesh = @import("mesh.zig").Mesh;
+const IndexRange = @import("mesh.zig").IndexRange;
 const Material = @import("material.zig").Material;
+const RenderQueue = @import("render_queue.zig").RenderQueue;
+const GpuCuller = @import("gpu_culling.zig").GpuCuller;
+const HiZBuffer = @import("hiz_buffer.zig").HiZBuffer;
 
 const Vec2f = @import("../math/vector.zig").Vec2f;
 const Vec3f = @import("../math/vector.zig").Vec3f;
+const Vec3d = @import("../math/vector.zig").Vec3d;
 const Mat4f = @import("../math/matrix.zig").Mat4f;
+const Affine3x4 = @import("../math/affine.zig").Affine3x4;
+const BoundingBox = @import("../math/bounds.zig").BoundingBox;
+const Frustum = @import("../math/bounds.zig").Frustum;
+const Ray = @import("../math/bounds.zig").Ray;
 
 /// Camera implementation supporting both perspective and orthographic projections.
 /// Handles view and projection matrix calculations for 3D rendering.
 pub const Camera = struct {
     active_renderer: *Renderer,
 
+    /// Double precision point position and target are relative to, zero in worlds that fit in f32
+    /// TransformSystem.updateCameraRelative moves entities into this frame for drawing
+    origin: Vec3d = Vec3d.zero(),
     position: Vec3f = .{ .x = 0.0, .y = 0.0, .z = 0.0 },
     target: Vec3f = .{ .x = 0.0, .y = 0.0, .z = -1.0 },
     up: Vec3f = .{ .x = 0.0, .y = 1.0, .z = 0.0 },
@@ -23,6 +35,15 @@ pub const Camera = struct {
 
     view_matrix: Mat4f,
     projection_matrix: Mat4f,
+    /// projection_matrix before the jitter is added
+    unjittered_projection: Mat4f = Mat4f.identity(),
+    /// Sub-pixel NDC offset updateProjection shifts the projection by, set by applySceneJitter
+    jitter: [2]f32 = .{ 0.0, 0.0 },
+    /// Projection times view, kept in step by updateViewMatrix and updateProjection
+    /// Code writing view_matrix or projection_matrix directly has to call one of them afterwards
+    view_projection: Mat4f = Mat4f.identity(),
+    /// Planes of view_projection, refreshed with it
+    frustum: Frustum = undefined,
 
     near: f32,
     far: f32,
@@ -69,7 +90,9 @@ pub const Camera = struct {
     /// Initialize an orthographic camera with the given parameters
     pub fn initOrthographic(renderer_ptr: *Renderer, left: f32, right: f32, bottom: f32, top: f32, near: f32, far: f32) Camera {
         var camera = Camera{
-            .active_renderer = renderer_ptr, 
+            .active_renderer = renderer_ptr,
+            .view_matrix = Mat4f.identity(),
+            .projection_matrix = Mat4f.identity(),
             .near = near,
             .far = far,
             .camera_type = .{
@@ -91,23 +114,80 @@ pub const Camera = struct {
     // Public API: Operational Functions
     // ============================================================
     
+    /// Write this camera's matrices and position to the renderer's camera block
+    /// Draws through the camera do this implicitly, and the upload is skipped when nothing changed
+    pub fn uploadFrameData(self: *Camera) void {
+        self.active_renderer.setCamera(&self.view_matrix, &self.projection_matrix, self.position);
+    }
+
+
     /// Draw a model from the camera perspective
     pub fn drawModel(self: *Camera, model: *Model, model_matrix: *Mat4f) !void {
+        self.uploadFrameData();
         try self.active_renderer.drawModel(model, model_matrix, &self.view_matrix, &self.projection_matrix);
     }
 
 
+    /// Draw a model once per world matrix from the camera perspective
+    pub fn drawModelInstanced(self: *Camera, model: *Model, world_matrices: []const Affine3x4) !void {
+        self.uploadFrameData();
+        try self.active_renderer.drawModelInstanced(model, world_matrices, &self.view_matrix, &self.projection_matrix);
+    }
+
+
+    /// Sort and draw a render queue from the camera perspective
+    pub fn drawQueue(self: *Camera, queue: *RenderQueue) !void {
+        self.uploadFrameData();
+        try self.active_renderer.drawQueue(queue, &self.view_matrix, &self.projection_matrix);
+    }
+
+
+    /// Cull a GpuCuller scene against this camera and draw what survives
+    pub fn drawCulled(self: *Camera, culler: *GpuCuller) !void {
+        self.uploadFrameData();
+        const frustum = self.getFrustum();
+        culler.cull(&frustum, self.position);
+        try self.active_renderer.drawCulled(culler, &self.view_matrix, &self.projection_matrix);
+    }
+
+
+    /// Draw `occluders` into the depth target of `hiz` and rebuild its pyramid
+    /// Queue only large, cheap geometry, e.g. building blocks and terrain
+    pub fn drawOccluders(self: *Camera, hiz: *HiZBuffer, occluders: *RenderQueue) !void {
+        hiz.beginOccluders();
+        defer hiz.endOccluders();
+        try self.drawQueue(occluders);
+    }
+
+
+    /// Like drawCulled, but also skips instances hidden behind the occluders last drawn into `hiz`
+    pub fn drawCulledOccluded(self: *Camera, culler: *GpuCuller, hiz: *const HiZBuffer) !void {
+        self.uploadFrameData();
+        culler.cullOccluded(&self.frustum, self.position, &self.view_projection, hiz);
+        try self.active_renderer.drawCulled(culler, &self.view_matrix, &self.projection_matrix);
+    }
+
+
     pub fn drawMesh(self: *Camera, mesh: *Mesh, material: *Material, model_matrix: *Mat4f) !void {
+        self.uploadFrameData();
         try self.active_renderer.drawMesh(mesh, material, model_matrix, &self.view_matrix, &self.projection_matrix);
     }
 
 
+    /// Draw parts of a mesh whose vertices are already in world space
+    pub fn drawMeshRanges(self: *Camera, mesh: *Mesh, material: *Material, ranges: []const IndexRange) !void {
+        self.uploadFrameData();
+        var model_matrix = Mat4f.identity();
+        try self.active_renderer.drawMeshRanges(mesh, material, ranges, &model_matrix, &self.view_matrix, &self.projection_matrix);
+    }
+
+
     /// Update the projection matrix based on camera type
     pub fn updateProjection(self: *Camera) void {
 
         switch (self.camera_type) {
             .perspective => |*persp| {
-                self.projection_matrix = Mat4f.perspective(
+                self.projection_matrix.perspectiveInto(
                     persp.fov,
                     persp.aspect,
                     self.near,
@@ -115,7 +195,7 @@ pub const Camera = struct {
                 );
             },
             .orthographic => |*ortho| {
-                self.projection_matrix = Mat4f.ortho(
+                self.projection_matrix.orthoInto(
                     ortho.left,
                     ortho.right,
                     ortho.bottom,
@@ -125,32 +205,95 @@ pub const Camera = struct {
                 );
             },
         }
+
+        // Translating clip space by jitter * w moves every projected point by the same NDC offset
+        self.unjittered_projection = self.projection_matrix;
+        if (self.jitter[0] != 0.0 or self.jitter[1] != 0.0) {
+            for (0..4) |column| {
+                const w = self.projection_matrix.data[column * 4 + 3];
+                self.projection_matrix.data[column * 4] += self.jitter[0] * w;
+                self.projection_matrix.data[column * 4 + 1] += self.jitter[1] * w;
+            }
+        }
+        self.refreshViewProjection();
     }
 
 
-    pub fn worldToScreen(self: Camera, point: Vec3f) Vec2f {
-        const M = self.getViewProjectionMatrix().data;
-        const v = point;
+    /// Jitter the projection for the renderer's temporal upscaling, after beginScene and before drawing
+    /// Resets the jitter without it. The view must be final for the frame when this is called
+    pub fn applySceneJitter(self: *Camera) void {
+        self.jitter = .{ 0.0, 0.0 };
+        self.updateProjection();
+        self.jitter = self.active_renderer.temporalJitter(&self.view_matrix, &self.unjittered_projection);
+        if (self.jitter[0] != 0.0 or self.jitter[1] != 0.0) self.updateProjection();
+    }
 
-        const x = M[0]*v.x + M[4]*v.y + M[8]*v.z + M[12];
-        const y = M[1]*v.x + M[5]*v.y + M[9]*v.z + M[13];
-        const w = M[3]*v.x + M[7]*v.y + M[11]*v.z + M[15];
 
-        if (w == 0) return .{};
+    /// Project a world-space point to normalized device coordinates, zero for points on the camera plane
+    pub fn worldToScreen(self: *const Camera, point: Vec3f) Vec2f {
+        return projectPoint(&self.view_projection.data, point);
+    }
 
-        return .{
-            .x = x/w,
-            .y = y/w,
-        };
+
+    /// worldToScreen for every point of `points`, `out` needs at least as many elements
+    pub fn worldToScreenMany(self: *const Camera, points: []const Vec3f, out: []Vec2f) void {
+        std.debug.assert(out.len >= points.len);
+        const M = &self.view_projection.data;
+        for (points, out[0..points.len]) |point, *screen| {
+            screen.* = projectPoint(M, point);
+        }
     }
 
 
-    /// Return wether point
-    pub fn inView(self: Camera, point: Vec3f) bool {
-        _ = self;
-        const pos = worldToScreen(point);
-        return (@abs(pos.x) <= 1 and @abs(pos.y) < 1);
-    } 
+    /// Return whether a world-space point is inside the view frustum
+    pub fn inView(self: *const Camera, point: Vec3f) bool {
+        return self.frustum.containsPoint(point);
+    }
+
+
+    /// Return whether any part of a world-space box may be visible
+    pub fn boxInView(self: *const Camera, box: BoundingBox) bool {
+        return self.frustum.intersectsBox(box);
+    }
+
+
+    /// The planes of the current view-projection matrix, cached until the view or projection changes
+    pub fn getFrustum(self: *const Camera) Frustum {
+        return self.frustum;
+    }
+
+
+    /// Projected diameter of a bounding sphere over the viewport height, 1 fills the screen vertically
+    /// Spheres around the camera count as filling it
+    pub fn screenSize(self: *const Camera, center: Vec3f, radius: f32) f32 {
+        switch (self.camera_type) {
+            .perspective => |persp| {
+                const distance = center.distance(self.position);
+                if (distance <= radius) return std.math.inf(f32);
+                return radius / (distance * @tan(persp.fov * 0.5));
+            },
+            .orthographic => |ortho| return 2.0 * radius / @abs(ortho.top - ortho.bottom),
+        }
+    }
+
+
+    /// World-space ray through a point in normalized device coordinates, -1 to 1 on both axes
+    pub fn screenRay(self: *const Camera, ndc_x: f32, ndc_y: f32) Ray {
+        const inverse = self.view_projection.inverse() orelse return Ray.init(self.position, self.forward);
+
+        const near_point = inverse.transformPoint(.{ .x = ndc_x, .y = ndc_y, .z = -1.0 });
+        const far_point = inverse.transformPoint(.{ .x = ndc_x, .y = ndc_y, .z = 1.0 });
+        return Ray.init(near_point, far_point.subtract(near_point));
+    }
+
+
+    /// World-space ray through a pixel of a viewport, with the origin at its top left like cursor coordinates
+    pub fn screenToRay(self: *const Camera, pixel_x: f32, pixel_y: f32, viewport_width: f32, viewport_height: f32) Ray {
+        const ndc_x = 2.0 * pixel_x / viewport_width - 1.0;
+        const ndc_y = 1.0 - 2.0 * pixel_y / viewport_height;
+        return self.screenRay(ndc_x, ndc_y);
+    }
+
 
     /// Get the forward direction vector
     pub fn getForwardVector(self: *const Camera) Vec3f {
@@ -165,6 +308,22 @@ pub const Camera = struct {
     }
 
 
+    /// Move the camera to a double precision world position, keeping its view direction
+    /// The origin goes along and position stays at zero, so the view matrix has no large translation
+    pub fn setWorldPosition(self: *Camera, position: Vec3d) void {
+        self.target = self.target.subtract(self.position);
+        self.position = Vec3f.create(0, 0, 0);
+        self.origin = position;
+        self.updateViewMatrix();
+    }
+
+
+    /// Double precision world position of the camera
+    pub fn worldPosition(self: *const Camera) Vec3d {
+        return self.origin.addOffset(self.position);
+    }
+
+
     /// Set the camera target and update the view matrix
     pub fn lookAt(self: *Camera, target: Vec3f) void {
         self.target = target;
@@ -179,17 +338,18 @@ pub const Camera = struct {
         self.forward = Vec3f.normalize(Vec3f.subtract(self.target, self.position));
         
         // Create the view matrix
-        self.view_matrix = Mat4f.lookAt(
+        self.view_matrix.lookAtInto(
             self.position,
             self.target,
             self.up,
         );
+        self.refreshViewProjection();
     }
 
 
     /// Get the combined view-projection matrix
-    pub fn getViewProjectionMatrix(self: *Camera) Mat4f {
-        return self.projection_matrix.multiply(self.view_matrix);
+    pub fn getViewProjectionMatrix(self: *const Camera) Mat4f {
+        return self.view_projection;
     }
 
 
@@ -212,6 +372,31 @@ pub const Camera = struct {
         self.updateProjection();
     }
 
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn refreshViewProjection(self: *Camera) void {
+        self.view_projection.multiplyInto(&self.projection_matrix, &self.view_matrix);
+        self.frustum = Frustum.fromMatrix(&self.view_projection);
+    }
+
+
+    fn projectPoint(M: *const [16]f32, v: Vec3f) Vec2f {
+        const x = M[0]*v.x + M[4]*v.y + M[8]*v.z + M[12];
+        const y = M[1]*v.x + M[5]*v.y + M[9]*v.z + M[13];
+        const w = M[3]*v.x + M[7]*v.y + M[11]*v.z + M[15];
+
+        if (w == 0) return .{};
+
+        return .{
+            .x = x/w,
+            .y = y/w,
+        };
+    }
+
+
     /// Debug information printing - only included in debug builds
     pub fn debugInfo(self: *const Camera) void {
         if (@import("builtin").mode == .Debug) {
@@ -290,7 +475,43 @@ pub const CameraMouseController = struct {
 
         self.last_x = x_pos;
         self.last_y = y_pos;
+        self.turn(delta_x, delta_y, delta_time);
+    }
+
+
+    /// Turn by cursor motion that arrived after handleMouseMovement, e.g. from Input.latchMotion right
+    /// before rendering, so the frame shows the newest mouse position. The motion counts as seen,
+    /// the next handleMouseMovement only turns by what comes after it
+    pub fn applyMouseDelta(self: *CameraMouseController, delta_x: f32, delta_y: f32, delta_time: f32) void {
+        if (self.first_mouse or (delta_x == 0 and delta_y == 0)) return;
+        self.last_x += delta_x;
+        self.last_y += delta_y;
+        self.turn(delta_x, -delta_y, delta_time);
+    }
+
+    /// World-space ray under the last cursor position, for picking with SpatialSystem.raycast or pick
+    pub fn cursorRay(self: *const CameraMouseController, window_width: u32, window_height: u32) Ray {
+        const width: f32 = @floatFromInt(window_width);
+        const height: f32 = @floatFromInt(window_height);
+        return self.camera.screenToRay(self.last_x, self.last_y, width, height);
+    }
+
+    /// Debug information for mouse controller - only included in debug builds
+    pub fn debugMouseInfo(self: *const CameraMouseController) void {
+        if (comptime @import("builtin").mode == .Debug) {
+            std.debug.print("\nMouse Controller Debug:\n", .{});
+            std.debug.print("Yaw: {d:.2}, Pitch: {d:.2}\n", .{ self.yaw, self.pitch });
+            std.debug.print("Last mouse pos: ({d:.2}, {d:.2})\n", .{ self.last_x, self.last_y });
+        }
+    }
+
 
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Yaw and pitch by a cursor offset, y up, and aim the camera along them
+    fn turn(self: *CameraMouseController, delta_x: f32, delta_y: f32, delta_time: f32) void {
         // Apply sensitivity after clamping
         const x_offset = std.math.clamp(delta_x, -max_delta, max_delta) * self.mouse_sensitivity * delta_time;
         const y_offset = std.math.clamp(delta_y, -max_delta, max_delta) * self.mouse_sensitivity * delta_time;
@@ -323,13 +544,4 @@ pub const CameraMouseController = struct {
         
         self.camera.updateViewMatrix();
     }
-
-    /// Debug information for mouse controller - only included in debug builds
-    pub fn debugMouseInfo(self: *const CameraMouseController) void {
-        if (comptime @import("builtin").mode == .Debug) {
-            std.debug.print("\nMouse Controller Debug:\n", .{});
-            std.debug.print("Yaw: {d:.2}, Pitch: {d:.2}\n", .{ self.yaw, self.pitch });
-            std.debug.print("Last mouse pos: ({d:.2}, {d:.2})\n", .{ self.last_x, self.last_y });
-        }
-    }
 };
\ No newline at end of file
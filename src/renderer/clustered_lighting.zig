@@ -0,0 +1,381 @@
+// graphics/clustered_lighting.zig - point lights binned into view space clusters for forward shading
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+
+const Shader = @import("shader.zig").Shader;
+const camera_block_glsl = @import("shader.zig").camera_block_glsl;
+const instance_glsl = @import("shader.zig").instance_glsl;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const Camera = @import("camera.zig").Camera;
+const profiler = @import("../core/profiler.zig");
+
+const Mat4f = @import("../math/matrix.zig").Mat4f;
+
+
+pub const ClusteredLightingError = error{
+    /// Compute shaders and storage buffers are missing, see gl_ext.hasGpuCulling
+    Unsupported,
+};
+
+
+/// One point light, std430 layout of the Lights buffer
+pub const PointLight = extern struct {
+    /// World space
+    position: [3]f32,
+    /// Distance at which the light has faded to nothing, also the extent it is binned with
+    radius: f32,
+    color: [3]f32 = .{ 1.0, 1.0, 1.0 },
+    intensity: f32 = 1.0,
+};
+
+
+pub const ClusteredLightingConfig = struct {
+    /// Clusters across, down and deep, the depth slices are spaced exponentially
+    grid: [3]u32 = .{ 16, 9, 24 },
+    /// Light index capacity per cluster on average, clusters past the total run out of lights
+    average_lights_per_cluster: u32 = 32,
+    ambient: [3]f32 = .{ 0.03, 0.03, 0.03 },
+};
+
+
+/// std140 layout of the ClusterBlock uniform block
+const ClusterBlock = extern struct {
+    /// Grid size and the light count
+    grid: [4]u32,
+    /// Near and far plane, then the scale and bias turning log(view depth) into a slice
+    depth: [4]f32,
+    /// Viewport size in pixels
+    screen: [4]f32,
+    ambient: [4]f32,
+};
+
+
+/// Clustered forward lighting
+/// The view frustum is split into a grid of froxels, tiles on screen and exponential slices in depth.
+/// Every frame update transforms the lights into view space and a compute pass gives each cluster the
+/// lights whose sphere touches its bounds, packed into one index list. Fragment shaders look up their
+/// cluster from gl_FragCoord and view depth and only loop over its lights, so the cost follows the lights
+/// reaching a pixel rather than the total count
+///
+/// Shaders get the lookup by prepending `lighting_glsl` and calling `clusteredLighting`, createShader
+/// returns a lit color shader for meshes with normals
+pub const ClusteredLighting = struct {
+    const Self = @This();
+
+    /// Storage buffer bindings, after those of GpuCuller and MaterialTable
+    pub const lights_binding = 6;
+    pub const clusters_binding = 7;
+    pub const indices_binding = 8;
+    const counter_binding = 9;
+    /// Uniform block binding of ClusterBlock, after the camera block
+    pub const cluster_block_binding = 1;
+
+    /// Lights one cluster keeps, the rest of them are dropped for that cluster
+    pub const max_lights_per_cluster = 256;
+    const workgroup_size = 64;
+
+    /// Buffers and lookup for any fragment shader, view space position and normal in
+    /// clusteredLightingWith takes the light that isn't clustered, e.g. from BakedLighting's probes, in place of the ambient
+    pub const lighting_glsl =
+        \\struct PointLight { vec4 positionRadius; vec4 colorIntensity; };
+        \\layout (std430, binding = 6) readonly buffer Lights { PointLight lights[]; };
+        \\layout (std430, binding = 7) readonly buffer Clusters { uvec2 clusters[]; };
+        \\layout (std430, binding = 8) readonly buffer LightIndices { uint lightIndices[]; };
+        \\layout (std140) uniform ClusterBlock {
+        \\    uvec4 clusterGrid;
+        \\    vec4 clusterDepth;
+        \\    vec4 clusterScreen;
+        \\    vec4 clusterAmbient;
+        \\};
+        \\uint clusterIndexAt(vec3 viewPos) {
+        \\    uvec2 tile = min(uvec2(gl_FragCoord.xy / clusterScreen.xy * vec2(clusterGrid.xy)), clusterGrid.xy - 1u);
+        \\    uint slice = min(uint(max(log(-viewPos.z) * clusterDepth.z + clusterDepth.w, 0.0)), clusterGrid.z - 1u);
+        \\    return tile.x + (tile.y + slice * clusterGrid.y) * clusterGrid.x;
+        \\}
+        \\vec3 clusteredLightingWith(vec3 viewPos, vec3 viewNormal, vec3 albedo, vec3 indirect) {
+        \\    uvec2 range = clusters[clusterIndexAt(viewPos)];
+        \\    vec3 n = normalize(viewNormal);
+        \\    vec3 result = indirect;
+        \\    for (uint i = 0u; i < range.y; i++) {
+        \\        PointLight light = lights[lightIndices[range.x + i]];
+        \\        vec3 toLight = light.positionRadius.xyz - viewPos;
+        \\        float dist = length(toLight);
+        \\        float falloff = clamp(1.0 - dist / light.positionRadius.w, 0.0, 1.0);
+        \\        float diffuse = max(dot(n, toLight / max(dist, 1e-4)), 0.0);
+        \\        result += albedo * light.colorIntensity.rgb * (light.colorIntensity.w * diffuse * falloff * falloff);
+        \\    }
+        \\    return result;
+        \\}
+        \\vec3 clusteredLighting(vec3 viewPos, vec3 viewNormal, vec3 albedo) {
+        \\    return clusteredLightingWith(viewPos, viewNormal, albedo, clusterAmbient.rgb * albedo);
+        \\}
+        \\
+    ;
+
+    /// One workgroup per cluster: bounds from the inverse projection, then every thread tests a share of the lights
+    const assign_source = std.fmt.comptimePrint(
+        \\#version 430 core
+        \\layout (local_size_x = {d}) in;
+        \\struct PointLight {{ vec4 positionRadius; vec4 colorIntensity; }};
+        \\layout (std430, binding = 6) readonly buffer Lights {{ PointLight lights[]; }};
+        \\layout (std430, binding = 7) writeonly buffer Clusters {{ uvec2 clusters[]; }};
+        \\layout (std430, binding = 8) writeonly buffer LightIndices {{ uint lightIndices[]; }};
+        \\layout (std430, binding = 9) buffer LightCounter {{ uint indexCount; }};
+        \\layout (std140) uniform ClusterBlock {{
+        \\    uvec4 clusterGrid;
+        \\    vec4 clusterDepth;
+        \\    vec4 clusterScreen;
+        \\    vec4 clusterAmbient;
+        \\}};
+        \\uniform mat4 inverseProjection;
+        \\uniform uint indexCapacity;
+        \\shared vec3 boundsMin;
+        \\shared vec3 boundsMax;
+        \\shared uint localCount;
+        \\shared uint localOffset;
+        \\shared uint localIndices[{d}];
+        \\vec3 viewAt(vec2 ndc, float viewZ) {{
+        \\    vec4 p = inverseProjection * vec4(ndc, -1.0, 1.0);
+        \\    p /= p.w;
+        \\    return p.xyz * (viewZ / p.z);
+        \\}}
+        \\float sliceDepth(uint slice) {{
+        \\    return -clusterDepth.x * pow(clusterDepth.y / clusterDepth.x, float(slice) / float(clusterGrid.z));
+        \\}}
+        \\void main() {{
+        \\    uvec3 cluster = gl_WorkGroupID;
+        \\    uint clusterIndex = cluster.x + (cluster.y + cluster.z * clusterGrid.y) * clusterGrid.x;
+        \\    if (gl_LocalInvocationIndex == 0u) {{
+        \\        vec2 ndcMin = vec2(cluster.xy) / vec2(clusterGrid.xy) * 2.0 - 1.0;
+        \\        vec2 ndcMax = vec2(cluster.xy + 1u) / vec2(clusterGrid.xy) * 2.0 - 1.0;
+        \\        float nearZ = sliceDepth(cluster.z);
+        \\        float farZ = sliceDepth(cluster.z + 1u);
+        \\        vec3 a = viewAt(ndcMin, nearZ);
+        \\        vec3 b = viewAt(ndcMax, nearZ);
+        \\        vec3 c = viewAt(ndcMin, farZ);
+        \\        vec3 d = viewAt(ndcMax, farZ);
+        \\        boundsMin = min(min(a, b), min(c, d));
+        \\        boundsMax = max(max(a, b), max(c, d));
+        \\        localCount = 0u;
+        \\    }}
+        \\    barrier();
+        \\    for (uint i = gl_LocalInvocationIndex; i < clusterGrid.w; i += {d}u) {{
+        \\        vec4 light = lights[i].positionRadius;
+        \\        vec3 offset = clamp(light.xyz, boundsMin, boundsMax) - light.xyz;
+        \\        if (dot(offset, offset) <= light.w * light.w) {{
+        \\            uint slot = atomicAdd(localCount, 1u);
+        \\            if (slot < {d}u) localIndices[slot] = i;
+        \\        }}
+        \\    }}
+        \\    barrier();
+        \\    if (gl_LocalInvocationIndex == 0u) {{
+        \\        uint count = min(localCount, {d}u);
+        \\        uint offset = atomicAdd(indexCount, count);
+        \\        count = offset >= indexCapacity ? 0u : min(count, indexCapacity - offset);
+        \\        clusters[clusterIndex] = uvec2(offset, count);
+        \\        localOffset = offset;
+        \\        localCount = count;
+        \\    }}
+        \\    barrier();
+        \\    for (uint i = gl_LocalInvocationIndex; i < localCount; i += {d}u) {{
+        \\        lightIndices[localOffset + i] = localIndices[i];
+        \\    }}
+        \\}}
+        \\
+    , .{ workgroup_size, max_lights_per_cluster, workgroup_size, max_lights_per_cluster, max_lights_per_cluster, workgroup_size });
+
+    const lit_vertex_source = "#version 430 core\n" ++ camera_block_glsl ++ instance_glsl ++
+        \\layout (location=0) in vec3 aPos;
+        \\layout (location=1) in vec3 aNormal;
+        \\uniform mat4 model;
+        \\uniform bool instanced;
+        \\out vec3 ViewPos;
+        \\out vec3 ViewNormal;
+        \\invariant gl_Position;
+        \\void main() {
+        \\    mat4 world = instanced ? instanceModel() : model;
+        \\    vec4 viewPos = view * world * vec4(aPos, 1.0);
+        \\    ViewPos = viewPos.xyz;
+        \\    ViewNormal = mat3(view * world) * aNormal;
+        \\    gl_Position = viewProjection * world * vec4(aPos, 1.0);
+        \\}
+    ;
+
+    const lit_fragment_source = "#version 430 core\n" ++ lighting_glsl ++
+        \\in vec3 ViewPos;
+        \\in vec3 ViewNormal;
+        \\uniform vec4 color;
+        \\out vec4 FragColor;
+        \\void main() {
+        \\    FragColor = vec4(clusteredLighting(ViewPos, ViewNormal, color.rgb), color.a);
+        \\}
+    ;
+
+    allocator: std.mem.Allocator,
+    config: ClusteredLightingConfig,
+
+    program: c.GLuint,
+    inverse_projection_location: c.GLint,
+    capacity_location: c.GLint,
+
+    light_buffer: c.GLuint,
+    cluster_buffer: c.GLuint,
+    index_buffer: c.GLuint,
+    counter_buffer: c.GLuint,
+    block_buffer: c.GLuint,
+
+    /// Lights of the last update, in view space
+    view_lights: std.ArrayList(PointLight),
+    index_capacity: u32,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, config: ClusteredLightingConfig) !Self {
+        if (!gl_ext.hasGpuCulling()) return ClusteredLightingError.Unsupported;
+
+        const program = try Shader.createComputeProgram(assign_source);
+        errdefer c.glDeleteProgram(program);
+
+        var buffers: [5]c.GLuint = undefined;
+        c.glGenBuffers(buffers.len, &buffers);
+        err.checkGLError("glGenBuffers for ClusteredLighting");
+
+        const cluster_count = config.grid[0] * config.grid[1] * config.grid[2];
+        const index_capacity = cluster_count * config.average_lights_per_cluster;
+        uploadStorage(buffers[1], cluster_count * 2 * @sizeOf(u32), null, c.GL_DYNAMIC_COPY);
+        uploadStorage(buffers[2], index_capacity * @sizeOf(u32), null, c.GL_DYNAMIC_COPY);
+        uploadStorage(buffers[3], @sizeOf(u32), null, c.GL_DYNAMIC_COPY);
+
+        c.glBindBuffer(c.GL_UNIFORM_BUFFER, buffers[4]);
+        c.glBufferData(c.GL_UNIFORM_BUFFER, @sizeOf(ClusterBlock), null, c.GL_DYNAMIC_DRAW);
+        err.checkGLError("ClusteredLighting: cluster block");
+
+        // The compute pass reads the grid from the block too
+        bindClusterBlock(program);
+
+        return .{
+            .allocator = allocator,
+            .config = config,
+            .program = program,
+            .inverse_projection_location = c.glGetUniformLocation(program, "inverseProjection"),
+            .capacity_location = c.glGetUniformLocation(program, "indexCapacity"),
+            .light_buffer = buffers[0],
+            .cluster_buffer = buffers[1],
+            .index_buffer = buffers[2],
+            .counter_buffer = buffers[3],
+            .block_buffer = buffers[4],
+            .view_lights = std.ArrayList(PointLight).init(allocator),
+            .index_capacity = index_capacity,
+        };
+    }
+
+
+    /// Lit color shader for meshes with normals at location 1, `color` is the albedo
+    pub fn createShader(allocator: std.mem.Allocator) !*Shader {
+        const shader = try Shader.create(allocator, lit_vertex_source, lit_fragment_source);
+        bindClusterBlock(shader.program);
+        return shader;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    pub fn isSupported() bool {
+        return gl_ext.hasGpuCulling();
+    }
+
+
+    /// Bin `lights` into the clusters of `camera`, with a `width` x `height` viewport, before drawing lit geometry
+    /// Leaves the buffers bound for the draws of the frame
+    pub fn update(self: *Self, lights: []const PointLight, camera: *const Camera, width: u32, height: u32) !void {
+        const zone = profiler.zone("ClusteredLighting.update");
+        defer zone.end();
+
+        // View space once here, the assignment and every fragment work in it
+        try self.view_lights.resize(lights.len);
+        for (self.view_lights.items, lights) |*view_light, light| {
+            const position = camera.view_matrix.transformPoint(.{ .x = light.position[0], .y = light.position[1], .z = light.position[2] });
+            view_light.* = light;
+            view_light.position = .{ position.x, position.y, position.z };
+        }
+        uploadStorage(self.light_buffer, @max(lights.len, 1) * @sizeOf(PointLight), if (lights.len > 0) self.view_lights.items.ptr else null, c.GL_STREAM_DRAW);
+
+        const near = camera.near;
+        const far = camera.far;
+        const log_ratio = @log(far / near);
+        const slices: f32 = @floatFromInt(self.config.grid[2]);
+        const block = ClusterBlock{
+            .grid = .{ self.config.grid[0], self.config.grid[1], self.config.grid[2], @intCast(lights.len) },
+            .depth = .{ near, far, slices / log_ratio, -slices * @log(near) / log_ratio },
+            .screen = .{ @floatFromInt(@max(width, 1)), @floatFromInt(@max(height, 1)), 0.0, 0.0 },
+            .ambient = .{ self.config.ambient[0], self.config.ambient[1], self.config.ambient[2], 0.0 },
+        };
+        const state = GLStateCache.current();
+        state.bufferSubData(c.GL_UNIFORM_BUFFER, self.block_buffer, 0, std.mem.asBytes(&block));
+
+        const zero: u32 = 0;
+        state.bufferSubData(gl_ext.GL_SHADER_STORAGE_BUFFER, self.counter_buffer, 0, std.mem.asBytes(&zero));
+
+        const inverse_projection = camera.projection_matrix.inverse() orelse Mat4f.identity();
+        GLStateCache.current().useProgram(self.program);
+        c.glUniformMatrix4fv(self.inverse_projection_location, 1, c.GL_FALSE, &inverse_projection.data);
+        c.glUniform1ui(self.capacity_location, self.index_capacity);
+
+        self.bind();
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, counter_binding, self.counter_buffer);
+        gl_ext.dispatchCompute.?(self.config.grid[0], self.config.grid[1], self.config.grid[2]);
+
+        // Fragment shaders read the cluster ranges and index lists next
+        gl_ext.memoryBarrier.?(gl_ext.GL_SHADER_STORAGE_BARRIER_BIT);
+        err.checkGLError("ClusteredLighting.update");
+    }
+
+
+    /// Bind the light buffers and cluster block, again needed only if something else took their bindings
+    pub fn bind(self: *const Self) void {
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, lights_binding, self.light_buffer);
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, clusters_binding, self.cluster_buffer);
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, indices_binding, self.index_buffer);
+        c.glBindBufferBase(c.GL_UNIFORM_BUFFER, cluster_block_binding, self.block_buffer);
+    }
+
+
+    /// Point the ClusterBlock of a custom shader built on lighting_glsl at its binding
+    pub fn bindClusterBlock(program: c.GLuint) void {
+        const block_index = c.glGetUniformBlockIndex(program, "ClusterBlock");
+        if (block_index != c.GL_INVALID_INDEX) c.glUniformBlockBinding(program, block_index, cluster_block_binding);
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        GLStateCache.current().forgetProgram(self.program);
+        c.glDeleteProgram(self.program);
+        const buffers = [_]c.GLuint{ self.light_buffer, self.cluster_buffer, self.index_buffer, self.counter_buffer, self.block_buffer };
+        c.glDeleteBuffers(buffers.len, &buffers);
+        err.checkGLError("ClusteredLighting cleanup");
+
+        self.view_lights.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn uploadStorage(buffer: c.GLuint, size: usize, data: ?*const anyopaque, usage: c.GLenum) void {
+        c.glBindBuffer(gl_ext.GL_SHADER_STORAGE_BUFFER, buffer);
+        c.glBufferData(gl_ext.GL_SHADER_STORAGE_BUFFER, @intCast(size), data, usage);
+        err.checkGLError("ClusteredLighting: glBufferData");
+    }
+};
@@ -0,0 +1,387 @@
+// graphics/cpu_particle_system.zig - SoA particles simulated with SIMD on the CPU
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const Shader = @import("shader.zig").Shader;
+const camera_block_glsl = @import("shader.zig").camera_block_glsl;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const DynamicBuffer = @import("dynamic_buffer.zig").DynamicBuffer;
+const Camera = @import("camera.zig").Camera;
+const ParticleEmitter = @import("particle_system.zig").ParticleEmitter;
+const ParticleSystem = @import("particle_system.zig").ParticleSystem;
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+const render_stats = @import("render_stats.zig");
+const profiler = @import("../core/profiler.zig");
+
+const Vec3f = @import("../math/vector.zig").Vec3f;
+
+
+pub const CpuParticleSystemConfig = struct {
+    /// Particles alive at once, emission beyond it is dropped
+    capacity: u32 = 1 << 18,
+    gravity: [3]f32 = .{ 0.0, -9.81, 0.0 },
+    /// Fraction of velocity lost per second
+    drag: f32 = 0.0,
+    /// Add the particles onto the scene, otherwise alpha blend them
+    additive: bool = true,
+    /// Particles per job when a JobSystem is passed to update, kept a multiple of the vector width
+    chunk_size: u32 = 16384,
+    seed: u64 = 0x5eed,
+};
+
+
+/// Per-instance data of one drawn particle
+const ParticleInstance = extern struct {
+    position: [3]f32,
+    size: f32,
+    /// RGBA8, normalized in the shader
+    color: [4]u8,
+};
+
+
+/// Particles for drivers without compute shaders, with the same emitters as ParticleSystem
+/// Every attribute is its own array, so integration runs over whole @Vector lanes of positions, velocities and
+/// lifetimes, chunks of them in parallel on a JobSystem. Dead particles are swapped out by the last live one,
+/// then the live ones are written as instances into a DynamicBuffer and drawn as camera facing quads in one call
+/// No ECS entity exists per particle
+pub const CpuParticleSystem = struct {
+    const Self = @This();
+
+    /// f32 lanes per kernel step
+    pub const lanes = std.simd.suggestVectorLength(f32) orelse 8;
+    const V = @Vector(lanes, f32);
+
+    allocator: std.mem.Allocator,
+    config: CpuParticleSystemConfig,
+    prng: std.Random.DefaultPrng,
+
+    /// Live particles, the first `count` entries of every array
+    count: usize = 0,
+    position_x: []f32,
+    position_y: []f32,
+    position_z: []f32,
+    velocity_x: []f32,
+    velocity_y: []f32,
+    velocity_z: []f32,
+    /// Seconds left
+    life: []f32,
+    max_life: []f32,
+    size_start: []f32,
+    size_end: []f32,
+    color_start: [][4]u8,
+    color_end: [][4]u8,
+
+    /// Instances of the live particles of the last update
+    instances: []ParticleInstance,
+    vertices: DynamicBuffer,
+    shader: *Shader,
+    vao: c.GLuint = 0,
+
+    const draw_vertex_source = "#version 330 core\n" ++ camera_block_glsl ++
+        \\layout (location=0) in vec4 aPositionSize;
+        \\layout (location=1) in vec4 aColor;
+        \\out vec2 Corner;
+        \\out vec4 Color;
+        \\const vec2 corners[6] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0), vec2(-1.0, -1.0));
+        \\void main() {
+        \\    vec2 corner = corners[gl_VertexID];
+        \\    vec3 right = vec3(view[0][0], view[1][0], view[2][0]);
+        \\    vec3 up = vec3(view[0][1], view[1][1], view[2][1]);
+        \\    vec3 world = aPositionSize.xyz + (right * corner.x + up * corner.y) * aPositionSize.w * 0.5;
+        \\    gl_Position = viewProjection * vec4(world, 1.0);
+        \\    Corner = corner;
+        \\    Color = aColor;
+        \\}
+    ;
+
+    const draw_fragment_source =
+        \\#version 330 core
+        \\in vec2 Corner;
+        \\in vec4 Color;
+        \\out vec4 FragColor;
+        \\uniform bool additive;
+        \\void main() {
+        \\    float alpha = Color.a * (1.0 - smoothstep(0.5, 1.0, length(Corner)));
+        \\    if (alpha <= 0.0) discard;
+        \\    FragColor = additive ? vec4(Color.rgb * alpha, 1.0) : vec4(Color.rgb, alpha);
+        \\}
+    ;
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, config: CpuParticleSystemConfig) !Self {
+        const capacity: usize = config.capacity;
+        var self: Self = undefined;
+        self.allocator = allocator;
+        self.config = config;
+        self.config.chunk_size = @max(std.mem.alignForward(u32, config.chunk_size, lanes), lanes);
+        self.prng = std.Random.DefaultPrng.init(config.seed);
+        self.count = 0;
+        self.vao = 0;
+
+        // Empty first, so a failed allocation frees only what exists
+        inline for (float_fields) |name| @field(self, name) = &.{};
+        self.color_start = &.{};
+        self.color_end = &.{};
+        self.instances = &.{};
+        errdefer self.freeArrays();
+
+        inline for (float_fields) |name| @field(self, name) = try allocator.alloc(f32, capacity);
+        self.color_start = try allocator.alloc([4]u8, capacity);
+        self.color_end = try allocator.alloc([4]u8, capacity);
+        self.instances = try allocator.alloc(ParticleInstance, capacity);
+
+        self.shader = try Shader.create(allocator, draw_vertex_source, draw_fragment_source);
+        errdefer _ = self.shader.release();
+        self.vertices = try DynamicBuffer.init(capacity * @sizeOf(ParticleInstance));
+        errdefer self.vertices.deinit();
+
+        const state = GLStateCache.current();
+        c.glGenVertexArrays(1, &self.vao);
+        state.bindVertexArray(self.vao);
+        state.bindArrayBuffer(self.vertices.buffer);
+        c.glEnableVertexAttribArray(0);
+        c.glVertexAttribDivisor(0, 1);
+        c.glEnableVertexAttribArray(1);
+        c.glVertexAttribDivisor(1, 1);
+
+        state.useProgram(self.shader.program);
+        c.glUniform1i(c.glGetUniformLocation(self.shader.program, "additive"), @intFromBool(config.additive));
+        err.checkGLError("CpuParticleSystem setup");
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Age and move every particle by `delta` seconds, drop the dead ones and emit from `emitters`
+    /// Integration and instance building run across `jobs` when one is given
+    pub fn update(self: *Self, delta: f32, emitters: []ParticleEmitter, jobs: ?*JobSystem) void {
+        const zone = profiler.zone("CpuParticleSystem.update");
+        defer zone.end();
+
+        const kernel = Kernel{ .system = self, .delta = delta };
+        self.run(jobs, &kernel, Kernel.integrate);
+        self.removeDead();
+        for (emitters) |*emitter| {
+            const free: u32 = @intCast(self.config.capacity - self.count);
+            self.emit(emitter, emitter.advance(delta, free));
+        }
+        self.run(jobs, &kernel, Kernel.buildInstances);
+    }
+
+
+    /// Draw every live particle as a camera facing quad, after the opaque geometry
+    /// Depth is tested but not written, so particles never hide each other
+    pub fn draw(self: *Self, camera: *Camera) !void {
+        if (self.count == 0) return;
+        camera.uploadFrameData();
+
+        self.vertices.beginFrame();
+        defer self.vertices.endFrame();
+        const offset = try self.vertices.write(std.mem.sliceAsBytes(self.instances[0..self.count]), @alignOf(ParticleInstance));
+
+        const state = GLStateCache.current();
+        const saved_cull_face = state.cull_face;
+        state.useProgram(self.shader.program);
+        state.bindVertexArray(self.vao);
+        state.bindArrayBuffer(self.vertices.buffer);
+        // No base instance before GL 4.2, so the instance attributes point at this frame's data instead
+        const stride: c.GLsizei = @sizeOf(ParticleInstance);
+        c.glVertexAttribPointer(0, 4, c.GL_FLOAT, c.GL_FALSE, stride, @ptrFromInt(offset + @offsetOf(ParticleInstance, "position")));
+        c.glVertexAttribPointer(1, 4, c.GL_UNSIGNED_BYTE, c.GL_TRUE, stride, @ptrFromInt(offset + @offsetOf(ParticleInstance, "color")));
+
+        state.setDepthMask(false);
+        state.setCullFace(false);
+        c.glEnable(c.GL_BLEND);
+        if (self.config.additive) c.glBlendFunc(c.GL_ONE, c.GL_ONE) else c.glBlendFunc(c.GL_SRC_ALPHA, c.GL_ONE_MINUS_SRC_ALPHA);
+
+        c.glDrawArraysInstanced(c.GL_TRIANGLES, 0, 6, @intCast(self.count));
+        err.checkGLError("CpuParticleSystem.draw: glDrawArraysInstanced");
+        render_stats.countDraw(6, self.count);
+
+        c.glDisable(c.GL_BLEND);
+        state.setDepthMask(true);
+        if (saved_cull_face) |enabled| state.setCullFace(enabled);
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        GLStateCache.current().forgetVertexArray(self.vao);
+        c.glDeleteVertexArrays(1, &self.vao);
+        err.checkGLError("CpuParticleSystem cleanup");
+        self.vertices.deinit();
+        _ = self.shader.release();
+
+        self.freeArrays();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    const float_fields = .{ "position_x", "position_y", "position_z", "velocity_x", "velocity_y", "velocity_z", "life", "max_life", "size_start", "size_end" };
+
+
+    /// Range kernels over the live particles, chunks start on whole vectors
+    const Kernel = struct {
+        system: *Self,
+        delta: f32,
+
+        fn integrate(self: *const Kernel, start: usize, end: usize) void {
+            const s = self.system;
+            const gravity = s.config.gravity;
+            const damping = @max(1.0 - s.config.drag * self.delta, 0.0);
+            const dt: V = @splat(self.delta);
+            const damp: V = @splat(damping);
+            const gravity_x: V = @splat(gravity[0] * self.delta);
+            const gravity_y: V = @splat(gravity[1] * self.delta);
+            const gravity_z: V = @splat(gravity[2] * self.delta);
+
+            var i = start;
+            while (i + lanes <= end) : (i += lanes) {
+                const vx = (@as(V, s.velocity_x[i..][0..lanes].*) + gravity_x) * damp;
+                const vy = (@as(V, s.velocity_y[i..][0..lanes].*) + gravity_y) * damp;
+                const vz = (@as(V, s.velocity_z[i..][0..lanes].*) + gravity_z) * damp;
+                s.velocity_x[i..][0..lanes].* = vx;
+                s.velocity_y[i..][0..lanes].* = vy;
+                s.velocity_z[i..][0..lanes].* = vz;
+                s.position_x[i..][0..lanes].* = @as(V, s.position_x[i..][0..lanes].*) + vx * dt;
+                s.position_y[i..][0..lanes].* = @as(V, s.position_y[i..][0..lanes].*) + vy * dt;
+                s.position_z[i..][0..lanes].* = @as(V, s.position_z[i..][0..lanes].*) + vz * dt;
+                s.life[i..][0..lanes].* = @as(V, s.life[i..][0..lanes].*) - dt;
+            }
+            while (i < end) : (i += 1) {
+                s.velocity_x[i] = (s.velocity_x[i] + gravity[0] * self.delta) * damping;
+                s.velocity_y[i] = (s.velocity_y[i] + gravity[1] * self.delta) * damping;
+                s.velocity_z[i] = (s.velocity_z[i] + gravity[2] * self.delta) * damping;
+                s.position_x[i] += s.velocity_x[i] * self.delta;
+                s.position_y[i] += s.velocity_y[i] * self.delta;
+                s.position_z[i] += s.velocity_z[i] * self.delta;
+                s.life[i] -= self.delta;
+            }
+        }
+
+        fn buildInstances(self: *const Kernel, start: usize, end: usize) void {
+            const s = self.system;
+            const one: V = @splat(1.0);
+
+            var i = start;
+            while (i + lanes <= end) : (i += lanes) {
+                const age = one - @as(V, s.life[i..][0..lanes].*) / @as(V, s.max_life[i..][0..lanes].*);
+                const size_start: V = s.size_start[i..][0..lanes].*;
+                const size: [lanes]f32 = size_start + (@as(V, s.size_end[i..][0..lanes].*) - size_start) * age;
+                const ages: [lanes]f32 = age;
+                for (0..lanes) |lane| s.writeInstance(i + lane, size[lane], ages[lane]);
+            }
+            while (i < end) : (i += 1) {
+                const age = 1.0 - s.life[i] / s.max_life[i];
+                s.writeInstance(i, s.size_start[i] + (s.size_end[i] - s.size_start[i]) * age, age);
+            }
+        }
+    };
+
+
+    fn freeArrays(self: *Self) void {
+        inline for (float_fields) |name| self.allocator.free(@field(self, name));
+        self.allocator.free(self.color_start);
+        self.allocator.free(self.color_end);
+        self.allocator.free(self.instances);
+    }
+
+
+    fn run(self: *Self, jobs: ?*JobSystem, kernel: *const Kernel, comptime func: fn (*const Kernel, usize, usize) void) void {
+        if (jobs) |job_system| {
+            job_system.parallelFor(self.count, self.config.chunk_size, kernel, func);
+        } else {
+            func(kernel, 0, self.count);
+        }
+    }
+
+
+    fn writeInstance(self: *Self, i: usize, size: f32, age: f32) void {
+        var color: [4]u8 = undefined;
+        for (&color, self.color_start[i], self.color_end[i]) |*channel, from, to| {
+            const blended = @as(f32, @floatFromInt(from)) + (@as(f32, @floatFromInt(to)) - @as(f32, @floatFromInt(from))) * age;
+            channel.* = @intFromFloat(std.math.clamp(@round(blended), 0.0, 255.0));
+        }
+        self.instances[i] = .{
+            .position = .{ self.position_x[i], self.position_y[i], self.position_z[i] },
+            .size = size,
+            .color = color,
+        };
+    }
+
+
+    /// Swap every dead particle with the last live one
+    fn removeDead(self: *Self) void {
+        var i: usize = 0;
+        while (i < self.count) {
+            if (self.life[i] > 0.0) {
+                i += 1;
+                continue;
+            }
+            self.count -= 1;
+            const last = self.count;
+            inline for (float_fields) |name| @field(self, name)[i] = @field(self, name)[last];
+            self.color_start[i] = self.color_start[last];
+            self.color_end[i] = self.color_end[last];
+        }
+    }
+
+
+    /// Append `count` particles from `emitter` behind the live ones
+    fn emit(self: *Self, emitter: *const ParticleEmitter, count: u32) void {
+        const random = self.prng.random();
+        const axis = Vec3f.create(emitter.direction[0], emitter.direction[1], emitter.direction[2]).normalize();
+        const helper = if (@abs(axis.y) < 0.99) Vec3f.create(0.0, 1.0, 0.0) else Vec3f.create(1.0, 0.0, 0.0);
+        const tangent = axis.cross(helper).normalize();
+        const bitangent = axis.cross(tangent);
+        const color_start = unpack(ParticleSystem.packColor(emitter.color_start));
+        const color_end = unpack(ParticleSystem.packColor(emitter.color_end));
+
+        for (0..count) |_| {
+            const i = self.count;
+            self.count += 1;
+
+            const cos_theta = std.math.lerp(1.0, @cos(emitter.spread), random.float(f32));
+            const sin_theta = @sqrt(@max(1.0 - cos_theta * cos_theta, 0.0));
+            const phi = std.math.tau * random.float(f32);
+            const speed = std.math.lerp(emitter.speed[0], emitter.speed[1], random.float(f32));
+            const life = std.math.lerp(emitter.lifetime[0], emitter.lifetime[1], random.float(f32));
+            const velocity = axis.scale(cos_theta)
+                .add(tangent.scale(@cos(phi) * sin_theta))
+                .add(bitangent.scale(@sin(phi) * sin_theta))
+                .scale(speed);
+
+            self.position_x[i] = emitter.position[0];
+            self.position_y[i] = emitter.position[1];
+            self.position_z[i] = emitter.position[2];
+            self.velocity_x[i] = velocity.x;
+            self.velocity_y[i] = velocity.y;
+            self.velocity_z[i] = velocity.z;
+            self.life[i] = life;
+            self.max_life[i] = life;
+            self.size_start[i] = emitter.size[0];
+            self.size_end[i] = emitter.size[1];
+            self.color_start[i] = color_start;
+            self.color_end[i] = color_end;
+        }
+    }
+
+
+    fn unpack(color: u32) [4]u8 {
+        return @bitCast(std.mem.nativeToLittle(u32, color));
+    }
+};
@@ -0,0 +1,294 @@
+// graphics/debug_draw.zig - immediate-mode lines and shapes for debugging
+const std = @import("std");
+const build_options = @import("build_options");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const DynamicBuffer = @import("dynamic_buffer.zig").DynamicBuffer;
+const Shader = @import("shader.zig").Shader;
+const render_stats = @import("render_stats.zig");
+
+const Mat4f = @import("../math/matrix.zig").Mat4f;
+const Vec3f = @import("../math/vector.zig").Vec3f;
+const BoundingBox = @import("../math/bounds.zig").BoundingBox;
+
+
+/// Kept with `-Ddebug-draw`, on by default in Debug builds, otherwise every DebugDraw function is empty
+pub const enabled = build_options.debug_draw;
+
+
+pub const DebugDrawConfig = struct {
+    /// Line vertices a frame holds, two per segment, further lines are dropped
+    max_line_vertices: u32 = 1 << 18,
+    /// Triangle vertices a frame holds, three per triangle, further triangles are dropped
+    max_triangle_vertices: u32 = 1 << 16,
+    /// Segments of each circle of a sphere
+    sphere_segments: u32 = 24,
+    /// Hide shapes behind scene geometry, off draws them on top of everything
+    depth_test: bool = true,
+};
+
+
+const DebugVertex = extern struct {
+    position: [3]f32,
+    /// RGBA8, normalized in the shader
+    color: [4]u8,
+};
+
+
+/// Collects lines and triangles from anywhere during a frame and draws each kind with one call in flush
+/// Vertices stream through a DynamicBuffer, so nothing here allocates GL objects per shape,
+/// thousands of boxes for bounds, cull results or the spatial tree cost two draws
+pub const DebugDraw = struct {
+    const Self = @This();
+
+    config: DebugDrawConfig,
+    shader: ?*Shader = null,
+    vao: c.GLuint = 0,
+    vertices: ?DynamicBuffer = null,
+    lines: std.ArrayList(DebugVertex),
+    triangles: std.ArrayList(DebugVertex),
+    /// Primitives that did not fit since the last flush, read it before flushing
+    dropped: u32 = 0,
+
+    const vertex_source =
+        \\#version 330 core
+        \\layout (location=0) in vec3 aPos;
+        \\layout (location=1) in vec4 aColor;
+        \\out vec4 Color;
+        \\uniform mat4 projection;
+        \\void main() {
+        \\    gl_Position = projection * vec4(aPos, 1.0);
+        \\    Color = aColor;
+        \\}
+    ;
+    const fragment_source =
+        \\#version 330 core
+        \\in vec4 Color;
+        \\out vec4 FragColor;
+        \\void main() {
+        \\    FragColor = Color;
+        \\}
+    ;
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, config: DebugDrawConfig) !Self {
+        var self = Self{
+            .config = config,
+            .lines = std.ArrayList(DebugVertex).init(allocator),
+            .triangles = std.ArrayList(DebugVertex).init(allocator),
+        };
+        if (!enabled) return self;
+        errdefer self.deinit();
+
+        try self.lines.ensureTotalCapacityPrecise(config.max_line_vertices);
+        try self.triangles.ensureTotalCapacityPrecise(config.max_triangle_vertices);
+        self.shader = try Shader.create(allocator, vertex_source, fragment_source);
+        self.vertices = try DynamicBuffer.init(@as(usize, config.max_line_vertices + config.max_triangle_vertices) * @sizeOf(DebugVertex));
+        self.vertices.?.beginFrame();
+
+        const state = GLStateCache.current();
+        c.glGenVertexArrays(1, &self.vao);
+        state.bindVertexArray(self.vao);
+        state.bindArrayBuffer(self.vertices.?.buffer);
+        const stride: c.GLsizei = @sizeOf(DebugVertex);
+        c.glVertexAttribPointer(0, 3, c.GL_FLOAT, c.GL_FALSE, stride, @ptrFromInt(@offsetOf(DebugVertex, "position")));
+        c.glEnableVertexAttribArray(0);
+        c.glVertexAttribPointer(1, 4, c.GL_UNSIGNED_BYTE, c.GL_TRUE, stride, @ptrFromInt(@offsetOf(DebugVertex, "color")));
+        c.glEnableVertexAttribArray(1);
+        err.checkGLError("DebugDraw setup");
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    pub fn line(self: *Self, from: Vec3f, to: Vec3f, color: [4]f32) void {
+        if (!enabled) return;
+        if (self.lines.items.len + 2 > self.lines.capacity) {
+            self.dropped += 1;
+            return;
+        }
+        const packed_color = packColor(color);
+        self.lines.appendAssumeCapacity(.{ .position = .{ from.x, from.y, from.z }, .color = packed_color });
+        self.lines.appendAssumeCapacity(.{ .position = .{ to.x, to.y, to.z }, .color = packed_color });
+    }
+
+
+    /// Filled, both sides visible
+    pub fn triangle(self: *Self, p0: Vec3f, p1: Vec3f, p2: Vec3f, color: [4]f32) void {
+        if (!enabled) return;
+        if (self.triangles.items.len + 3 > self.triangles.capacity) {
+            self.dropped += 1;
+            return;
+        }
+        const packed_color = packColor(color);
+        for ([3]Vec3f{ p0, p1, p2 }) |corner| {
+            self.triangles.appendAssumeCapacity(.{ .position = .{ corner.x, corner.y, corner.z }, .color = packed_color });
+        }
+    }
+
+
+    /// The twelve edges of an axis-aligned box
+    pub fn box(self: *Self, bounds: BoundingBox, color: [4]f32) void {
+        if (!enabled or bounds.isEmpty()) return;
+        var corners: [8]Vec3f = undefined;
+        for (&corners, 0..) |*corner, i| {
+            corner.* = .{
+                .x = if (i & 1 == 0) bounds.min.x else bounds.max.x,
+                .y = if (i & 2 == 0) bounds.min.y else bounds.max.y,
+                .z = if (i & 4 == 0) bounds.min.z else bounds.max.z,
+            };
+        }
+        self.edges(&corners, color);
+    }
+
+
+    /// Edges of the volume a view-projection matrix sees, e.g. a camera or a shadow cascade
+    pub fn frustum(self: *Self, view_projection: *const Mat4f, color: [4]f32) void {
+        if (!enabled) return;
+        const inverse = view_projection.inverse() orelse return;
+        var corners: [8]Vec3f = undefined;
+        for (&corners, 0..) |*corner, i| {
+            const x: f32 = if (i & 1 == 0) -1.0 else 1.0;
+            const y: f32 = if (i & 2 == 0) -1.0 else 1.0;
+            const z: f32 = if (i & 4 == 0) -1.0 else 1.0;
+            corner.* = inverse.transformPoint(.{ .x = x, .y = y, .z = z });
+        }
+        self.edges(&corners, color);
+    }
+
+
+    /// Three great circles, one around each axis
+    pub fn sphere(self: *Self, center: Vec3f, radius: f32, color: [4]f32) void {
+        if (!enabled) return;
+        const segments = self.config.sphere_segments;
+        const step = std.math.tau / @as(f32, @floatFromInt(segments));
+        for (0..3) |axis| {
+            var previous = circlePoint(center, radius, axis, 0.0);
+            for (1..segments + 1) |i| {
+                const point = circlePoint(center, radius, axis, step * @as(f32, @floatFromInt(i)));
+                self.line(previous, point, color);
+                previous = point;
+            }
+        }
+    }
+
+
+    /// Red, green and blue lines along the x, y and z axes of a world matrix
+    pub fn axes(self: *Self, world: *const Mat4f, size: f32) void {
+        if (!enabled) return;
+        const origin = world.transformPoint(.{ .x = 0.0, .y = 0.0, .z = 0.0 });
+        self.line(origin, world.transformPoint(.{ .x = size, .y = 0.0, .z = 0.0 }), .{ 1.0, 0.0, 0.0, 1.0 });
+        self.line(origin, world.transformPoint(.{ .x = 0.0, .y = size, .z = 0.0 }), .{ 0.0, 1.0, 0.0, 1.0 });
+        self.line(origin, world.transformPoint(.{ .x = 0.0, .y = 0.0, .z = size }), .{ 0.0, 0.0, 1.0, 1.0 });
+    }
+
+
+    /// Draw everything collected this frame through `view_projection` and start the next frame
+    pub fn flush(self: *Self, view_projection: *const Mat4f) !void {
+        if (!enabled) return;
+        defer {
+            self.lines.clearRetainingCapacity();
+            self.triangles.clearRetainingCapacity();
+            self.dropped = 0;
+        }
+        if (self.lines.items.len == 0 and self.triangles.items.len == 0) return;
+
+        const vertices = &self.vertices.?;
+        const shader = self.shader.?;
+        const state = GLStateCache.current();
+        const saved_depth_test = state.depth_test;
+        const saved_cull_face = state.cull_face;
+
+        state.useProgram(shader.program);
+        shader.setMat4(.projection, &view_projection.data);
+        state.bindVertexArray(self.vao);
+        state.setDepthTest(self.config.depth_test);
+        state.setCullFace(false);
+        c.glEnable(c.GL_BLEND);
+        c.glBlendFunc(c.GL_SRC_ALPHA, c.GL_ONE_MINUS_SRC_ALPHA);
+
+        try drawVertices(vertices, self.triangles.items, c.GL_TRIANGLES);
+        try drawVertices(vertices, self.lines.items, c.GL_LINES);
+
+        c.glDisable(c.GL_BLEND);
+        if (saved_depth_test) |enabled_test| state.setDepthTest(enabled_test);
+        if (saved_cull_face) |enabled_cull| state.setCullFace(enabled_cull);
+
+        vertices.endFrame();
+        vertices.beginFrame();
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.lines.deinit();
+        self.triangles.deinit();
+        if (!enabled) return;
+
+        if (self.vao != 0) {
+            GLStateCache.current().forgetVertexArray(self.vao);
+            c.glDeleteVertexArrays(1, &self.vao);
+        }
+        if (self.vertices) |*vertices| vertices.deinit();
+        if (self.shader) |shader| _ = shader.release();
+        err.checkGLError("DebugDraw cleanup");
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Twelve edges of a box-shaped volume, corner bits are x, y and z
+    fn edges(self: *Self, corners: *const [8]Vec3f, color: [4]f32) void {
+        const pairs = [12][2]u3{
+            .{ 0, 1 }, .{ 2, 3 }, .{ 4, 5 }, .{ 6, 7 },
+            .{ 0, 2 }, .{ 1, 3 }, .{ 4, 6 }, .{ 5, 7 },
+            .{ 0, 4 }, .{ 1, 5 }, .{ 2, 6 }, .{ 3, 7 },
+        };
+        for (pairs) |pair| self.line(corners[pair[0]], corners[pair[1]], color);
+    }
+
+
+    /// One draw of `items`, the whole buffer region is whole vertices so offsets fall on vertex boundaries
+    fn drawVertices(vertices: *DynamicBuffer, items: []const DebugVertex, mode: c.GLenum) !void {
+        if (items.len == 0) return;
+        const offset = try vertices.write(std.mem.sliceAsBytes(items), @alignOf(DebugVertex));
+        std.debug.assert(offset % @sizeOf(DebugVertex) == 0);
+        c.glDrawArrays(mode, @intCast(offset / @sizeOf(DebugVertex)), @intCast(items.len));
+        err.checkGLError("DebugDraw: glDrawArrays");
+        render_stats.countDraw(if (mode == c.GL_TRIANGLES) items.len else 0, 1);
+    }
+
+
+    fn circlePoint(center: Vec3f, radius: f32, axis: usize, angle: f32) Vec3f {
+        const a = @cos(angle) * radius;
+        const b = @sin(angle) * radius;
+        return switch (axis) {
+            0 => .{ .x = center.x, .y = center.y + a, .z = center.z + b },
+            1 => .{ .x = center.x + a, .y = center.y, .z = center.z + b },
+            else => .{ .x = center.x + a, .y = center.y + b, .z = center.z },
+        };
+    }
+
+
+    fn packColor(color: [4]f32) [4]u8 {
+        var result: [4]u8 = undefined;
+        for (color, 0..) |channel, i| {
+            result[i] = @intFromFloat(@round(std.math.clamp(channel, 0.0, 1.0) * 255.0));
+        }
+        return result;
+    }
+};
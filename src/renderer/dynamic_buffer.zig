@@ -0,0 +1,144 @@
+// graphics/dynamic_buffer.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const render_stats = @import("render_stats.zig");
+
+
+pub const DynamicBufferError = error{
+    /// The data does not fit in what is left of the current frame's region
+    OutOfSpace,
+    /// The driver refused the persistent mapping
+    MapFailed,
+};
+
+
+/// Ring of per-frame regions for data rewritten every frame, e.g. streamed vertices or per-draw uniforms
+/// With ARB_buffer_storage the buffer is mapped once and written directly, without it writes use glBufferSubData
+/// Every region is fenced when its frame ends, so the CPU never overwrites data the GPU still reads
+pub const DynamicBuffer = struct {
+    const Self = @This();
+
+    /// Frames in flight, the CPU writes one region while the GPU reads the others
+    pub const region_count = 3;
+
+    /// Longest wait for a region before giving up on the fence, in nanoseconds
+    const fence_timeout_ns = std.time.ns_per_s;
+
+    buffer: c.GLuint,
+    region_size: usize,
+    /// Persistent coherent mapping of the whole buffer, null when falling back to glBufferSubData
+    mapped: ?[*]u8,
+
+    /// Region written this frame and the next free byte in it
+    region: usize = 0,
+    offset: usize = 0,
+    fences: [region_count]c.GLsync = .{null} ** region_count,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Allocate `region_count` regions of `region_size` bytes
+    pub fn init(region_size: usize) !Self {
+        var buffer: c.GLuint = 0;
+        c.glGenBuffers(1, &buffer);
+        err.checkGLError("glGenBuffers for DynamicBuffer");
+        errdefer c.glDeleteBuffers(1, &buffer);
+
+        const total_size: c.GLsizeiptr = @intCast(region_size * region_count);
+        GLStateCache.current().bindArrayBuffer(buffer);
+
+        var mapped: ?[*]u8 = null;
+        if (gl_ext.bufferStorage) |bufferStorage| {
+            const flags = c.GL_MAP_WRITE_BIT | gl_ext.GL_MAP_PERSISTENT_BIT | gl_ext.GL_MAP_COHERENT_BIT;
+            bufferStorage(c.GL_ARRAY_BUFFER, total_size, null, flags);
+            mapped = @ptrCast(c.glMapBufferRange(c.GL_ARRAY_BUFFER, 0, total_size, flags));
+            err.checkGLError("DynamicBuffer: persistent map");
+            if (mapped == null) return DynamicBufferError.MapFailed;
+        } else {
+            c.glBufferData(c.GL_ARRAY_BUFFER, total_size, null, c.GL_STREAM_DRAW);
+            err.checkGLError("DynamicBuffer: glBufferData");
+        }
+
+        return .{
+            .buffer = buffer,
+            .region_size = region_size,
+            .mapped = mapped,
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Move to the next region, waiting until the GPU is done with the frame that last used it
+    pub fn beginFrame(self: *Self) void {
+        self.region = (self.region + 1) % region_count;
+        self.offset = 0;
+
+        if (self.fences[self.region]) |fence| {
+            _ = c.glClientWaitSync(fence, c.GL_SYNC_FLUSH_COMMANDS_BIT, fence_timeout_ns);
+            c.glDeleteSync(fence);
+            self.fences[self.region] = null;
+        }
+    }
+
+
+    /// Fence the current region, call after the last draw reading this frame's data
+    pub fn endFrame(self: *Self) void {
+        if (self.fences[self.region]) |fence| c.glDeleteSync(fence);
+        self.fences[self.region] = c.glFenceSync(c.GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+
+    /// Copy `data` into the current region, returns its byte offset in `buffer`
+    pub fn write(self: *Self, data: []const u8, alignment: usize) !usize {
+        const start = std.mem.alignForward(usize, self.offset, alignment);
+        if (start + data.len > self.region_size) return DynamicBufferError.OutOfSpace;
+
+        const buffer_offset = self.region * self.region_size + start;
+        if (self.mapped) |mapped| {
+            @memcpy(mapped[buffer_offset..][0..data.len], data);
+        } else {
+            GLStateCache.current().bufferSubData(c.GL_ARRAY_BUFFER, self.buffer, buffer_offset, data);
+        }
+
+        render_stats.countUpload(data.len);
+        self.offset = start + data.len;
+        return buffer_offset;
+    }
+
+
+    /// Bytes left in the current region
+    pub fn remaining(self: *const Self) usize {
+        return self.region_size - self.offset;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        for (&self.fences) |*fence| {
+            if (fence.*) |sync| c.glDeleteSync(sync);
+            fence.* = null;
+        }
+
+        const state = GLStateCache.current();
+        if (self.mapped != null) {
+            state.bindArrayBuffer(self.buffer);
+            _ = c.glUnmapBuffer(c.GL_ARRAY_BUFFER);
+        }
+
+        state.forgetBuffer(self.buffer);
+        c.glDeleteBuffers(1, &self.buffer);
+        err.checkGLError("DynamicBuffer cleanup");
+    }
+};
@@ -0,0 +1,409 @@
+// graphics/font.zig - signed distance field text
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+
+const SpriteBatch = @import("sprite_batch.zig").SpriteBatch;
+const Texture = @import("texture.zig").Texture;
+const image_decode = @import("image_decode.zig");
+const UvRect = @import("texture_atlas.zig").UvRect;
+const DecodeCallback = @import("resource_loader.zig").DecodeCallback;
+
+
+pub const FontError = error{
+    /// The glyph sheet can't be split into the configured grid
+    InvalidGlyphSheet,
+    FontLoadFailed,
+};
+
+
+/// Layout of a glyph sheet, an image of white glyphs on black in a grid of equal cells, row by row from the top
+pub const FontConfig = struct {
+    columns: u32 = 16,
+    rows: u32 = 6,
+    /// Character of the top left cell, the others follow in reading order
+    first_char: u8 = 32,
+    /// Edge length of a glyph in the baked atlas, in pixels
+    glyph_size: u32 = 32,
+    /// Distance in atlas pixels over which the field goes from fully inside to fully outside
+    /// Larger values allow bigger outlines and glows at the cost of precision
+    spread: f32 = 4.0,
+    /// Advance every glyph by a whole cell instead of by its ink width
+    monospace: bool = false,
+};
+
+
+/// Placement of one glyph, in fractions of the cell the text size sets
+pub const Glyph = struct {
+    uv: UvRect,
+    /// Empty space left of the ink, the pen is moved back by it so glyphs sit next to each other
+    left: f32,
+    /// Pen movement after the glyph
+    advance: f32,
+};
+
+
+/// Distance field glyph atlas on the CPU, baked once and uploaded by Font.init
+/// Texels hold 0.5 on the glyph outline, rising inside and falling outside up to `spread` pixels away,
+/// so glyphs stay sharp when scaled well past the size they were baked at
+pub const FontAtlas = struct {
+    const Self = @This();
+
+    /// Advance of cells without ink, the space character
+    const blank_advance = 0.35;
+    /// Gap added after the ink of every glyph
+    const spacing = 0.08;
+
+    allocator: std.mem.Allocator,
+    width: u32,
+    height: u32,
+    /// One distance per texel, bottom row first like GL textures
+    distances: []u8,
+    glyphs: []Glyph,
+    config: FontConfig,
+
+
+    /// Bakes an atlas on a ResourceLoader worker, pass `callback()` to ResourceLoader.loadCustom
+    /// `atlas` holds the result once the load's future is ready and didn't fail
+    pub const Bake = struct {
+        allocator: std.mem.Allocator,
+        config: FontConfig,
+        atlas: ?FontAtlas = null,
+
+        pub fn callback(self: *Bake) DecodeCallback {
+            return .{ .func = run, .context = self };
+        }
+
+
+        fn run(context: ?*anyopaque, path: [:0]const u8) anyerror!void {
+            const self: *Bake = @ptrCast(@alignCast(context.?));
+            self.atlas = try FontAtlas.bakeFile(self.allocator, path, self.config);
+        }
+    };
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Bake the glyph sheet image at `path`, read as grayscale
+    /// Only CPU work, safe on any thread while no other thread loads images through stb_image
+    pub fn bakeFile(allocator: std.mem.Allocator, path: []const u8, config: FontConfig) !Self {
+        c.stbi_set_flip_vertically_on_load(1);
+        const image = image_decode.decodeFile(path, 1) catch |decode_err| {
+            std.debug.print("STBI loading failed for {s}: {s}\n", .{ path, image_decode.failureReason(decode_err) });
+            return FontError.FontLoadFailed;
+        };
+        return bakeSheet(allocator, image.pixels, image.width, image.height, config);
+    }
+
+
+    /// Bake a glyph sheet of `width` x `height` coverage values, bottom row first, above 127 is inside a glyph
+    pub fn bakeSheet(allocator: std.mem.Allocator, coverage: []const u8, width: u32, height: u32, config: FontConfig) !Self {
+        if (config.columns == 0 or config.rows == 0 or config.glyph_size == 0) return FontError.InvalidGlyphSheet;
+        const cell_w = width / config.columns;
+        const cell_h = height / config.rows;
+        if (cell_w < config.glyph_size or cell_h < config.glyph_size or coverage.len < width * height) {
+            return FontError.InvalidGlyphSheet;
+        }
+
+        var self = Self{
+            .allocator = allocator,
+            .width = config.columns * config.glyph_size,
+            .height = config.rows * config.glyph_size,
+            .distances = &.{},
+            .glyphs = &.{},
+            .config = config,
+        };
+        errdefer self.deinit();
+        self.distances = try allocator.alloc(u8, @as(usize, self.width) * self.height);
+        self.glyphs = try allocator.alloc(Glyph, @as(usize, config.columns) * config.rows);
+
+        // Scratch of one source cell: both squared distance grids and the 1D transform's buffers
+        const cell_len = @as(usize, cell_w) * cell_h;
+        const line_len = @max(cell_w, cell_h);
+        const scratch = try allocator.alloc(f32, cell_len * 2 + line_len * 3 + 1);
+        defer allocator.free(scratch);
+        const hull = try allocator.alloc(usize, line_len);
+        defer allocator.free(hull);
+        var grid = DistanceGrid{
+            .to_inside = scratch[0..cell_len],
+            .to_outside = scratch[cell_len .. cell_len * 2],
+            .line = scratch[cell_len * 2 ..][0..line_len],
+            .result = scratch[cell_len * 2 + line_len ..][0..line_len],
+            .bounds = scratch[cell_len * 2 + line_len * 2 ..][0 .. line_len + 1],
+            .hull = hull,
+            .width = cell_w,
+            .height = cell_h,
+        };
+
+        const scale = @as(f32, @floatFromInt(cell_w)) / @as(f32, @floatFromInt(config.glyph_size));
+        const spread = config.spread * scale;
+
+        for (0..config.rows) |row| {
+            // Sheet rows count from the top, the buffers are bottom row first
+            const flipped: u32 = config.rows - 1 - @as(u32, @intCast(row));
+            for (0..config.columns) |column| {
+                const col: u32 = @intCast(column);
+                const ink = grid.load(coverage, width, col * cell_w, flipped * cell_h);
+                grid.transform();
+                self.writeCell(&grid, col, flipped, spread);
+
+                const glyph = &self.glyphs[row * config.columns + column];
+                glyph.uv = .{
+                    .u0 = @as(f32, @floatFromInt(col)) / @as(f32, @floatFromInt(config.columns)),
+                    .v0 = @as(f32, @floatFromInt(flipped)) / @as(f32, @floatFromInt(config.rows)),
+                    .u1 = @as(f32, @floatFromInt(col + 1)) / @as(f32, @floatFromInt(config.columns)),
+                    .v1 = @as(f32, @floatFromInt(flipped + 1)) / @as(f32, @floatFromInt(config.rows)),
+                };
+                const cell_width: f32 = @floatFromInt(cell_w);
+                if (config.monospace) {
+                    glyph.left = 0.0;
+                    glyph.advance = 1.0;
+                } else if (ink) |columns| {
+                    glyph.left = @as(f32, @floatFromInt(columns[0])) / cell_width;
+                    glyph.advance = @as(f32, @floatFromInt(columns[1] - columns[0] + 1)) / cell_width + spacing;
+                } else {
+                    glyph.left = 0.0;
+                    glyph.advance = blank_advance;
+                }
+            }
+        }
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.allocator.free(self.distances);
+        self.allocator.free(self.glyphs);
+        self.distances = &.{};
+        self.glyphs = &.{};
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Average the signed distances of the source texels under each atlas texel of a cell
+    fn writeCell(self: *Self, grid: *const DistanceGrid, column: u32, row: u32, spread: f32) void {
+        const size = self.config.glyph_size;
+        for (0..size) |y| {
+            const y0 = y * grid.height / size;
+            const y1 = @max((y + 1) * grid.height / size, y0 + 1);
+            for (0..size) |x| {
+                const x0 = x * grid.width / size;
+                const x1 = @max((x + 1) * grid.width / size, x0 + 1);
+
+                var sum: f32 = 0.0;
+                for (y0..y1) |sy| {
+                    for (x0..x1) |sx| {
+                        const i = sy * grid.width + sx;
+                        sum += @sqrt(grid.to_inside[i]) - @sqrt(grid.to_outside[i]);
+                    }
+                }
+                const signed = sum / @as(f32, @floatFromInt((y1 - y0) * (x1 - x0)));
+                const value = std.math.clamp(0.5 - signed / spread * 0.5, 0.0, 1.0);
+
+                const out = (row * size + y) * self.width + column * size + x;
+                self.distances[out] = @intFromFloat(@round(value * 255.0));
+            }
+        }
+    }
+};
+
+
+/// Exact squared Euclidean distances within one cell, after Felzenszwalb and Huttenlocher:
+/// a 1D lower envelope of parabolas over every column, then over every row of the result
+const DistanceGrid = struct {
+    const far = 1e20;
+
+    /// Squared distance to the nearest inside texel, 0 inside
+    to_inside: []f32,
+    /// Squared distance to the nearest outside texel, 0 outside
+    to_outside: []f32,
+    line: []f32,
+    result: []f32,
+    bounds: []f32,
+    hull: []usize,
+    width: u32,
+    height: u32,
+
+    /// Seed both grids from the cell at `x`, `y` of the sheet, returns the first and last column with ink
+    fn load(self: *DistanceGrid, coverage: []const u8, stride: u32, x: u32, y: u32) ?[2]u32 {
+        var ink: ?[2]u32 = null;
+        for (0..self.height) |cy| {
+            for (0..self.width) |cx| {
+                const inside = coverage[(y + cy) * stride + x + cx] > 127;
+                const i = cy * self.width + cx;
+                self.to_inside[i] = if (inside) 0.0 else far;
+                self.to_outside[i] = if (inside) far else 0.0;
+                if (inside) {
+                    const col: u32 = @intCast(cx);
+                    ink = if (ink) |range| .{ @min(range[0], col), @max(range[1], col) } else .{ col, col };
+                }
+            }
+        }
+        return ink;
+    }
+
+
+    fn transform(self: *DistanceGrid) void {
+        for ([_][]f32{ self.to_inside, self.to_outside }) |values| {
+            for (0..self.width) |x| self.pass(values, x, self.width, self.height);
+            for (0..self.height) |y| self.pass(values, y * self.width, 1, self.width);
+        }
+    }
+
+
+    /// Transform the `count` values `step` apart from `first` in place
+    fn pass(self: *DistanceGrid, values: []f32, first: usize, step: usize, count: usize) void {
+        const f = self.line[0..count];
+        for (f, 0..) |*value, i| value.* = values[first + i * step];
+
+        const v = self.hull;
+        const z = self.bounds;
+        var k: usize = 0;
+        v[0] = 0;
+        z[0] = -std.math.inf(f32);
+        z[1] = std.math.inf(f32);
+        for (1..count) |q| {
+            // Where the parabola from q overtakes the last one of the envelope, dropping those it hides
+            var s = intersect(f, q, v[k]);
+            while (s <= z[k]) {
+                k -= 1;
+                s = intersect(f, q, v[k]);
+            }
+            k += 1;
+            v[k] = q;
+            z[k] = s;
+            z[k + 1] = std.math.inf(f32);
+        }
+
+        k = 0;
+        for (self.result[0..count], 0..) |*out, q| {
+            const qf: f32 = @floatFromInt(q);
+            while (z[k + 1] < qf) k += 1;
+            const d = qf - @as(f32, @floatFromInt(v[k]));
+            out.* = d * d + f[v[k]];
+        }
+        for (self.result[0..count], 0..) |value, i| values[first + i * step] = value;
+    }
+
+
+    fn intersect(f: []const f32, q: usize, p: usize) f32 {
+        const qf: f32 = @floatFromInt(q);
+        const pf: f32 = @floatFromInt(p);
+        return ((f[q] + qf * qf) - (f[p] + pf * pf)) / (2.0 * qf - 2.0 * pf);
+    }
+};
+
+
+/// A baked atlas on the GPU, strings are laid out into quads of a SpriteBatch
+/// Text of one font is a run of quads on one texture, so it draws in one call as long as nothing else
+/// is batched in between
+pub const Font = struct {
+    const Self = @This();
+
+    allocator: std.mem.Allocator,
+    texture: *Texture,
+    glyphs: []Glyph,
+    config: FontConfig,
+    /// Distance between baselines, in multiples of the text size
+    line_height: f32 = 1.0,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Upload `atlas`, which can be deinitialized afterwards. Call on the GL thread
+    pub fn init(allocator: std.mem.Allocator, atlas: *const FontAtlas) !Self {
+        const glyphs = try allocator.dupe(Glyph, atlas.glyphs);
+        errdefer allocator.free(glyphs);
+
+        // White texels carrying the distance in alpha, the sprite batch's texture format
+        const pixels = try allocator.alloc([4]u8, atlas.distances.len);
+        defer allocator.free(pixels);
+        for (pixels, atlas.distances) |*pixel, distance| pixel.* = .{ 255, 255, 255, distance };
+
+        const texture = try Texture.createRGBA(allocator, @intCast(atlas.width), @intCast(atlas.height), @ptrCast(pixels.ptr));
+        texture.setSampler(.{ .filter = .trilinear, .wrap = .clamp_to_edge });
+        return .{
+            .allocator = allocator,
+            .texture = texture,
+            .glyphs = glyphs,
+            .config = atlas.config,
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Queue the quads of `text` with its first line's bottom left corner at `position`, `size` units tall
+    /// Lines go down, toward negative y, assuming a y-up projection like Mat4f.ortho. Characters outside
+    /// the sheet are skipped
+    pub fn drawText(self: *const Self, batch: *SpriteBatch, text: []const u8, position: [2]f32, size: f32, color: [4]f32) !void {
+        var pen = position;
+        for (text) |char| {
+            if (char == '\n') {
+                pen = .{ position[0], pen[1] - size * self.line_height };
+                continue;
+            }
+            const glyph = self.glyph(char) orelse continue;
+            try batch.drawDistanceField(self.texture, .{
+                .position = .{ pen[0] - glyph.left * size, pen[1] },
+                .size = .{ size, size },
+                .origin = .{ 0.0, 0.0 },
+                .uv = glyph.uv,
+                .color = color,
+            });
+            pen[0] += glyph.advance * size;
+        }
+    }
+
+
+    /// Width of the longest line and height of all lines of `text` at `size`
+    pub fn measure(self: *const Self, text: []const u8, size: f32) [2]f32 {
+        var width: f32 = 0.0;
+        var line: f32 = 0.0;
+        var lines: f32 = 1.0;
+        for (text) |char| {
+            if (char == '\n') {
+                width = @max(width, line);
+                line = 0.0;
+                lines += 1.0;
+                continue;
+            }
+            if (self.glyph(char)) |glyph| line += glyph.advance * size;
+        }
+        return .{ @max(width, line), size + (lines - 1.0) * size * self.line_height };
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        _ = self.texture.release();
+        self.allocator.free(self.glyphs);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn glyph(self: *const Self, char: u8) ?Glyph {
+        if (char < self.config.first_char) return null;
+        const index = char - self.config.first_char;
+        if (index >= self.glyphs.len) return null;
+        return self.glyphs[index];
+    }
+};
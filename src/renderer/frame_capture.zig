@@ -0,0 +1,319 @@
+// graphics/frame_capture.zig - asynchronous framebuffer readback
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const profiler = @import("../core/profiler.zig");
+
+
+pub const FrameCaptureError = error{
+    /// The driver could not map a finished read
+    MapFailed,
+};
+
+
+pub const FrameCaptureConfig = struct {
+    /// Pixel buffers read into round robin, a capture is mapped once the fence of its read signaled,
+    /// at the latest when its buffer comes round again ring_size captures later
+    ring_size: u32 = 3,
+    /// Captured frames the encoder may fall behind by, captures beyond it are dropped instead of waited for
+    max_queued_frames: u32 = 4,
+};
+
+
+/// One frame read back, owned by the capture and reused once the encoder returns
+pub const CapturedFrame = struct {
+    /// Tightly packed RGBA8 rows, bottom row first
+    pixels: []u8 = &.{},
+    width: u32 = 0,
+    height: u32 = 0,
+    /// Sequence number of the capture call, gaps are dropped frames
+    index: u64 = 0,
+};
+
+
+/// Called on the encoder thread for every frame in capture order, e.g. to write it or feed a video encoder
+/// The pixels are only valid during the call
+pub const FrameEncoder = struct {
+    func: *const fn (context: ?*anyopaque, frame: *const CapturedFrame) void,
+    context: ?*anyopaque = null,
+};
+
+
+/// Reads frames back through a ring of pixel pack buffers and hands them to an encoder thread
+/// glReadPixels into client memory waits for the GPU to finish the frame. Into a buffer object it only queues
+/// a copy, which capture fences and maps a few frames later when it is long done, so continuous capture
+/// costs a memcpy per frame on the GL thread
+pub const FrameCapture = struct {
+    const Self = @This();
+
+    const Slot = struct {
+        buffer: c.GLuint = 0,
+        /// Bytes allocated for `buffer`
+        capacity: usize = 0,
+        /// Signals once the read is done, null while the slot is free
+        fence: c.GLsync = null,
+        width: u32 = 0,
+        height: u32 = 0,
+        index: u64 = 0,
+    };
+
+    allocator: std.mem.Allocator,
+    config: FrameCaptureConfig,
+    encoder: FrameEncoder,
+
+    slots: []Slot,
+    /// Slot the next capture reads into, the oldest read in flight when it is busy
+    next_slot: usize = 0,
+    captures: u64 = 0,
+    /// Captures without a free frame for them when their read completed
+    dropped: u64 = 0,
+
+    /// Guards the frame lists, the condition is signaled on every change to them and to `running`
+    mutex: std.Thread.Mutex = .{},
+    condition: std.Thread.Condition = .{},
+    frames: []CapturedFrame,
+    /// Indices into `frames`
+    free_frames: std.ArrayList(usize),
+    /// Indices into `frames` waiting for the encoder, oldest first
+    queued_frames: std.ArrayList(usize),
+    running: bool = true,
+
+    thread: std.Thread = undefined,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Create the pixel buffers and start the encoder thread, call on the GL thread
+    pub fn create(allocator: std.mem.Allocator, encoder: FrameEncoder, config: FrameCaptureConfig) !*Self {
+        std.debug.assert(config.ring_size > 0 and config.max_queued_frames > 0);
+
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+
+        const slots = try allocator.alloc(Slot, config.ring_size);
+        errdefer allocator.free(slots);
+        @memset(slots, .{});
+        const frames = try allocator.alloc(CapturedFrame, config.max_queued_frames);
+        errdefer allocator.free(frames);
+        @memset(frames, .{});
+
+        var free_frames = try std.ArrayList(usize).initCapacity(allocator, frames.len);
+        errdefer free_frames.deinit();
+        for (0..frames.len) |i| free_frames.appendAssumeCapacity(i);
+        var queued_frames = try std.ArrayList(usize).initCapacity(allocator, frames.len);
+        errdefer queued_frames.deinit();
+
+        self.* = .{
+            .allocator = allocator,
+            .config = config,
+            .encoder = encoder,
+            .slots = slots,
+            .frames = frames,
+            .free_frames = free_frames,
+            .queued_frames = queued_frames,
+        };
+
+        for (slots) |*slot| c.glGenBuffers(1, &slot.buffer);
+        errdefer for (slots) |*slot| c.glDeleteBuffers(1, &slot.buffer);
+        err.checkGLError("FrameCapture setup");
+
+        self.thread = try std.Thread.spawn(.{}, encodeMain, .{self});
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Queue a read of `width` x `height` pixels of `framebuffer`'s color, e.g. gl.default_framebuffer with the
+    /// window's framebuffer size before swapBuffers. Reads that finished since are handed to the encoder
+    /// Only waits on the GPU when the ring is too short for its latency
+    pub fn capture(self: *Self, framebuffer: c.GLuint, width: u32, height: u32) !void {
+        const zone = profiler.zone("FrameCapture.capture");
+        defer zone.end();
+
+        try self.collect(false);
+
+        const slot = &self.slots[self.next_slot];
+        // The oldest read is still in flight, finish it to reuse its buffer
+        if (slot.fence != null) try self.finishSlot(slot);
+
+        const size = @as(usize, width) * height * 4;
+        c.glBindBuffer(c.GL_PIXEL_PACK_BUFFER, slot.buffer);
+        defer c.glBindBuffer(c.GL_PIXEL_PACK_BUFFER, 0);
+        if (size > slot.capacity) {
+            c.glBufferData(c.GL_PIXEL_PACK_BUFFER, @intCast(size), null, c.GL_STREAM_READ);
+            slot.capacity = size;
+        }
+
+        c.glBindFramebuffer(c.GL_READ_FRAMEBUFFER, framebuffer);
+        c.glPixelStorei(c.GL_PACK_ALIGNMENT, 1);
+        // With a pack buffer bound the pointer is an offset into it and the call returns at once
+        c.glReadPixels(0, 0, @intCast(width), @intCast(height), c.GL_RGBA, c.GL_UNSIGNED_BYTE, null);
+        err.checkGLError("FrameCapture: glReadPixels");
+
+        slot.* = .{
+            .buffer = slot.buffer,
+            .capacity = slot.capacity,
+            .fence = c.glFenceSync(c.GL_SYNC_GPU_COMMANDS_COMPLETE, 0),
+            .width = width,
+            .height = height,
+            .index = self.captures,
+        };
+        self.captures += 1;
+        self.next_slot = (self.next_slot + 1) % self.slots.len;
+    }
+
+
+    /// Hand the reads already done to the encoder without capturing, e.g. on frames that aren't recorded
+    pub fn update(self: *Self) !void {
+        try self.collect(false);
+    }
+
+
+    /// Wait for every read in flight and hand it to the encoder, at the end of a recording
+    pub fn flush(self: *Self) !void {
+        try self.collect(true);
+    }
+
+
+    /// Frames handed to the encoder and not encoded yet
+    pub fn queuedCount(self: *Self) usize {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        return self.queued_frames.items.len;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Encode what is in flight, stop the encoder thread once it caught up and free everything
+    /// Call on the GL thread
+    pub fn release(self: *Self) void {
+        self.flush() catch |e| std.debug.print("FrameCapture: dropping reads in flight: {s}\n", .{@errorName(e)});
+
+        {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            self.running = false;
+            self.condition.broadcast();
+        }
+        self.thread.join();
+
+        for (self.slots) |*slot| {
+            if (slot.fence) |fence| c.glDeleteSync(fence);
+            c.glDeleteBuffers(1, &slot.buffer);
+        }
+        err.checkGLError("FrameCapture cleanup");
+        for (self.frames) |frame| self.allocator.free(frame.pixels);
+
+        self.free_frames.deinit();
+        self.queued_frames.deinit();
+        self.allocator.free(self.frames);
+        self.allocator.free(self.slots);
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Finish the reads in flight oldest first, stopping at the first one not done unless `wait` is set
+    fn collect(self: *Self, wait: bool) !void {
+        for (0..self.slots.len) |offset| {
+            const slot = &self.slots[(self.next_slot + offset) % self.slots.len];
+            if (slot.fence == null) continue;
+            if (!wait and !isSignaled(slot.fence)) return;
+            try self.finishSlot(slot);
+        }
+    }
+
+
+    /// Copy the read of `slot` into a free frame and queue it for the encoder, then free the slot
+    /// Waits for the read when it isn't done yet
+    fn finishSlot(self: *Self, slot: *Slot) !void {
+        const fence = slot.fence.?;
+        _ = c.glClientWaitSync(fence, c.GL_SYNC_FLUSH_COMMANDS_BIT, std.math.maxInt(u64));
+        c.glDeleteSync(fence);
+        slot.fence = null;
+
+        const frame_index = blk: {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            break :blk self.free_frames.pop();
+        } orelse {
+            // The encoder is behind, losing a frame beats stalling the game
+            self.dropped += 1;
+            return;
+        };
+        // Not reachable from the encoder thread while off both lists
+        const frame = &self.frames[frame_index];
+        errdefer self.releaseFrame(frame_index);
+
+        const size = @as(usize, slot.width) * slot.height * 4;
+        if (frame.pixels.len < size) {
+            self.allocator.free(frame.pixels);
+            frame.pixels = &.{};
+            frame.pixels = try self.allocator.alloc(u8, size);
+        }
+
+        c.glBindBuffer(c.GL_PIXEL_PACK_BUFFER, slot.buffer);
+        defer c.glBindBuffer(c.GL_PIXEL_PACK_BUFFER, 0);
+        const mapped: ?[*]const u8 = @ptrCast(c.glMapBufferRange(c.GL_PIXEL_PACK_BUFFER, 0, @intCast(size), c.GL_MAP_READ_BIT));
+        if (mapped == null) {
+            err.checkGLError("FrameCapture: glMapBufferRange");
+            return FrameCaptureError.MapFailed;
+        }
+        @memcpy(frame.pixels[0..size], mapped.?[0..size]);
+        _ = c.glUnmapBuffer(c.GL_PIXEL_PACK_BUFFER);
+
+        frame.width = slot.width;
+        frame.height = slot.height;
+        frame.index = slot.index;
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.queued_frames.appendAssumeCapacity(frame_index);
+        self.condition.broadcast();
+    }
+
+
+    fn releaseFrame(self: *Self, frame_index: usize) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.free_frames.appendAssumeCapacity(frame_index);
+        self.condition.broadcast();
+    }
+
+
+    fn isSignaled(fence: c.GLsync) bool {
+        const status = c.glClientWaitSync(fence, 0, 0);
+        return status == c.GL_ALREADY_SIGNALED or status == c.GL_CONDITION_SATISFIED;
+    }
+
+
+    /// Encoder thread, runs until release and the queue is empty
+    fn encodeMain(self: *Self) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        while (true) {
+            while (self.running and self.queued_frames.items.len == 0) self.condition.wait(&self.mutex);
+            if (self.queued_frames.items.len == 0) return;
+
+            const frame_index = self.queued_frames.orderedRemove(0);
+            self.mutex.unlock();
+            self.encoder.func(self.encoder.context, &self.frames[frame_index]);
+            self.mutex.lock();
+
+            self.free_frames.appendAssumeCapacity(frame_index);
+            self.condition.broadcast();
+        }
+    }
+};
@@ -0,0 +1,709 @@
+// graphics/frame_graph.zig - declarative render passes with culling, transient aliasing and barrier placement
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const Renderer = @import("renderer.zig").Renderer;
+const profiler = @import("../core/profiler.zig");
+
+
+pub const FrameGraphError = error{
+    /// More color attachments than max_color_attachments, or two depth attachments, written by one pass
+    TooManyAttachments,
+    /// A pass or resource id that was not returned since the last reset
+    InvalidHandle,
+    /// The attachments a pass writes form an incomplete framebuffer
+    IncompleteFramebuffer,
+};
+
+
+pub const ResourceId = u16;
+pub const PassId = u16;
+
+pub const max_color_attachments = 4;
+
+
+pub const TextureDesc = struct {
+    width: u32,
+    height: u32,
+    /// Internal format, depth formats attach as the depth attachment
+    format: c.GLenum = c.GL_RGBA8,
+};
+
+
+pub const BufferDesc = struct {
+    size: usize,
+};
+
+
+/// Transient resources with equal descriptions and disjoint lifetimes share one GL object
+pub const ResourceDesc = union(enum) {
+    texture: TextureDesc,
+    buffer: BufferDesc,
+
+    fn eql(a: ResourceDesc, b: ResourceDesc) bool {
+        return switch (a) {
+            .texture => |ta| switch (b) {
+                .texture => |tb| std.meta.eql(ta, tb),
+                .buffer => false,
+            },
+            .buffer => |ba| switch (b) {
+                .buffer => |bb| ba.size == bb.size,
+                .texture => false,
+            },
+        };
+    }
+};
+
+
+/// How a pass touches a resource, decides the framebuffer it draws to and the barriers before it
+pub const Access = enum {
+    /// Rendered into, bound as a framebuffer attachment
+    attachment,
+    /// Read through a sampler
+    sampled,
+    /// Image load and store
+    storage_image,
+    /// Shader storage buffer
+    storage_buffer,
+    uniform,
+    vertex,
+    index,
+    /// Draw or dispatch indirect arguments
+    indirect,
+    /// Copies, uploads and readbacks
+    transfer,
+
+    /// glMemoryBarrier bits that make earlier shader stores visible to this access
+    fn barrierBits(self: Access) c.GLbitfield {
+        return switch (self) {
+            .attachment => GL_FRAMEBUFFER_BARRIER_BIT,
+            .sampled => GL_TEXTURE_FETCH_BARRIER_BIT,
+            .storage_image => GL_SHADER_IMAGE_ACCESS_BARRIER_BIT,
+            .storage_buffer => gl_ext.GL_SHADER_STORAGE_BARRIER_BIT,
+            .uniform => GL_UNIFORM_BARRIER_BIT,
+            .vertex => gl_ext.GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT,
+            .index => GL_ELEMENT_ARRAY_BARRIER_BIT,
+            .indirect => gl_ext.GL_COMMAND_BARRIER_BIT,
+            .transfer => GL_TEXTURE_UPDATE_BARRIER_BIT | gl_ext.GL_BUFFER_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT,
+        };
+    }
+
+
+    /// Writes through these go around the framebuffer and need a barrier before anything reads them
+    fn isShaderStore(self: Access) bool {
+        return self == .storage_image or self == .storage_buffer;
+    }
+};
+
+// ARB_shader_image_load_store barrier bits not in gl_ext
+const GL_ELEMENT_ARRAY_BARRIER_BIT = 0x00000002;
+const GL_UNIFORM_BARRIER_BIT = 0x00000004;
+const GL_TEXTURE_FETCH_BARRIER_BIT = 0x00000008;
+const GL_SHADER_IMAGE_ACCESS_BARRIER_BIT = 0x00000020;
+const GL_PIXEL_BUFFER_BARRIER_BIT = 0x00000080;
+const GL_TEXTURE_UPDATE_BARRIER_BIT = 0x00000100;
+const GL_FRAMEBUFFER_BARRIER_BIT = 0x00000400;
+
+
+/// Handed to every pass while it runs
+pub const PassContext = struct {
+    graph: *const FrameGraph,
+    pass: PassId,
+
+    /// GL texture behind `id`, valid for this frame only
+    pub fn texture(self: *const PassContext, id: ResourceId) c.GLuint {
+        return self.graph.resources.items[id].handle;
+    }
+
+
+    /// GL buffer behind `id`, valid for this frame only
+    pub fn buffer(self: *const PassContext, id: ResourceId) c.GLuint {
+        return self.graph.resources.items[id].handle;
+    }
+};
+
+
+/// Counts of the last compile
+pub const FrameGraphStats = struct {
+    live_passes: u32 = 0,
+    culled_passes: u32 = 0,
+    transient_resources: u32 = 0,
+    /// GL objects backing the transient resources, fewer than transient_resources when they alias
+    physical_resources: u32 = 0,
+    barriers: u32 = 0,
+};
+
+
+const Resource = struct {
+    name: []const u8,
+    desc: ResourceDesc,
+    /// GL name, given by importTexture or importBuffer, or assigned by compile
+    handle: c.GLuint = 0,
+    imported: bool,
+    /// Live passes using it, set by compile
+    first_pass: ?PassId = null,
+    last_pass: PassId = 0,
+    /// Shader stores not yet covered by a barrier, and the barrier bits issued since the last store
+    dirty: bool = false,
+    issued: c.GLbitfield = 0,
+};
+
+
+const Pass = struct {
+    name: [:0]const u8,
+    context: *anyopaque,
+    run_fn: *const fn (*anyopaque, *const PassContext) anyerror!void,
+    /// Runs even when nothing reads what it writes, e.g. a pass presenting to the window
+    side_effect: bool = false,
+    /// Set by compile
+    live: bool = false,
+    barriers: c.GLbitfield = 0,
+    framebuffer: ?c.GLuint = null,
+    viewport: [2]u32 = .{ 0, 0 },
+    /// Range of the pass in the sorted accesses, set by compile
+    first_access: u32 = 0,
+    access_end: u32 = 0,
+};
+
+
+const ResourceAccess = struct {
+    pass: PassId,
+    resource: ResourceId,
+    access: Access,
+    write: bool,
+};
+
+
+/// GL object backing transient resources, kept across frames
+const Physical = struct {
+    desc: ResourceDesc,
+    handle: c.GLuint,
+    /// Last pass of the resource holding it during this compile, null while free
+    busy_until: ?PassId = null,
+    /// Resource holding it most recently, its barrier state carries over to the next one
+    occupant: ?ResourceId = null,
+    last_used_frame: u64,
+};
+
+
+/// Framebuffer attachments of one pass, color first and depth last, 0 for unused slots
+const AttachmentSet = [max_color_attachments + 1]c.GLuint;
+
+
+/// Passes declare what they read and write, compile orders nothing but decides the rest:
+/// passes no side effect or imported resource depends on are culled, transient textures and buffers with
+/// equal descriptions and disjoint lifetimes share one GL object, framebuffers are built from the attachments
+/// each pass writes, and a glMemoryBarrier goes before a pass only when it touches something a shader stored to
+///
+/// Passes run in the order they were added. Rebuild the graph every frame between reset and execute,
+/// the GL objects and framebuffers stay cached across frames
+pub const FrameGraph = struct {
+    const Self = @This();
+
+    /// Frames a physical resource may go unused before it is deleted
+    pub const release_after_frames = 8;
+
+    allocator: std.mem.Allocator,
+    resources: std.ArrayList(Resource),
+    passes: std.ArrayList(Pass),
+    accesses: std.ArrayList(ResourceAccess),
+
+    physical: std.ArrayList(Physical),
+    framebuffers: std.AutoHashMapUnmanaged(AttachmentSet, c.GLuint) = .{},
+
+    frame: u64 = 0,
+    compiled: bool = false,
+    stats: FrameGraphStats = .{},
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator) Self {
+        return .{
+            .allocator = allocator,
+            .resources = std.ArrayList(Resource).init(allocator),
+            .passes = std.ArrayList(Pass).init(allocator),
+            .accesses = std.ArrayList(ResourceAccess).init(allocator),
+            .physical = std.ArrayList(Physical).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Drop the passes and resources of the last frame, GL objects stay for reuse
+    pub fn reset(self: *Self) void {
+        self.resources.clearRetainingCapacity();
+        self.passes.clearRetainingCapacity();
+        self.accesses.clearRetainingCapacity();
+        self.compiled = false;
+        self.frame += 1;
+    }
+
+
+    /// Texture allocated by the graph, alive from the first live pass using it to the last
+    pub fn createTexture(self: *Self, name: []const u8, desc: TextureDesc) !ResourceId {
+        return self.addResource(.{ .name = name, .desc = .{ .texture = desc }, .imported = false });
+    }
+
+
+    /// Buffer allocated by the graph, alive from the first live pass using it to the last
+    pub fn createBuffer(self: *Self, name: []const u8, desc: BufferDesc) !ResourceId {
+        return self.addResource(.{ .name = name, .desc = .{ .buffer = desc }, .imported = false });
+    }
+
+
+    /// Texture owned elsewhere, passes writing it are never culled
+    /// Texture 0 stands for the window, a pass writing it as attachment draws to the default framebuffer
+    pub fn importTexture(self: *Self, name: []const u8, texture: c.GLuint, desc: TextureDesc) !ResourceId {
+        return self.addResource(.{ .name = name, .desc = .{ .texture = desc }, .handle = texture, .imported = true });
+    }
+
+
+    /// Buffer owned elsewhere, passes writing it are never culled
+    pub fn importBuffer(self: *Self, name: []const u8, buffer: c.GLuint, desc: BufferDesc) !ResourceId {
+        return self.addResource(.{ .name = name, .desc = .{ .buffer = desc }, .handle = buffer, .imported = true });
+    }
+
+
+    /// Add a pass, `run_fn` is called as `run_fn(context, pass_context)` by execute
+    pub fn addPass(self: *Self, name: [:0]const u8, context: anytype, comptime run_fn: anytype) !PassId {
+        const Context = @TypeOf(context);
+        const id: PassId = @intCast(self.passes.items.len);
+        try self.passes.append(.{
+            .name = name,
+            .context = @ptrCast(@constCast(context)),
+            .run_fn = struct {
+                fn runFn(ptr: *anyopaque, pass_context: *const PassContext) anyerror!void {
+                    return run_fn(@as(Context, @ptrCast(@alignCast(ptr))), pass_context);
+                }
+            }.runFn,
+        });
+        self.compiled = false;
+        return id;
+    }
+
+
+    /// Keep `pass` even when nothing reads what it writes
+    pub fn setSideEffect(self: *Self, pass: PassId) void {
+        self.passes.items[pass].side_effect = true;
+    }
+
+
+    pub fn read(self: *Self, pass: PassId, resource: ResourceId, access: Access) !void {
+        try self.addAccess(pass, resource, access, false);
+    }
+
+
+    pub fn write(self: *Self, pass: PassId, resource: ResourceId, access: Access) !void {
+        try self.addAccess(pass, resource, access, true);
+    }
+
+
+    /// Cull, alias, build framebuffers and place barriers, execute compiles when this wasn't called
+    pub fn compile(self: *Self) !void {
+        const zone = profiler.zone("FrameGraph.compile");
+        defer zone.end();
+
+        // Group the accesses by pass, keeping their declared order inside each pass
+        std.sort.insertion(ResourceAccess, self.accesses.items, {}, struct {
+            fn lessThan(_: void, a: ResourceAccess, b: ResourceAccess) bool {
+                return a.pass < b.pass;
+            }
+        }.lessThan);
+        var cursor: u32 = 0;
+        for (self.passes.items, 0..) |*pass, index| {
+            pass.first_access = cursor;
+            while (cursor < self.accesses.items.len and self.accesses.items[cursor].pass == index) cursor += 1;
+            pass.access_end = cursor;
+        }
+
+        self.stats = .{};
+        try self.cullPasses();
+        self.computeLifetimes();
+        try self.allocatePhysical();
+        self.placeBarriers();
+        try self.buildFramebuffers();
+        self.releaseUnused();
+
+        self.stats.physical_resources = @intCast(self.physical.items.len);
+        self.compiled = true;
+    }
+
+
+    /// Run the live passes in order, each inside a GPU scope of `renderer` when one is given
+    /// Leaves the default framebuffer bound
+    pub fn execute(self: *Self, renderer: ?*Renderer) !void {
+        if (!self.compiled) try self.compile();
+        const zone = profiler.zone("FrameGraph.execute");
+        defer zone.end();
+
+        const state = GLStateCache.current();
+        for (self.passes.items, 0..) |*pass, index| {
+            if (!pass.live) continue;
+
+            if (pass.barriers != 0) {
+                if (gl_ext.memoryBarrier) |memoryBarrier| memoryBarrier(pass.barriers);
+            }
+            if (pass.framebuffer) |framebuffer| {
+                c.glBindFramebuffer(c.GL_FRAMEBUFFER, framebuffer);
+                state.setViewport(0, 0, @intCast(pass.viewport[0]), @intCast(pass.viewport[1]));
+            }
+
+            if (renderer) |r| r.beginGpuScope(pass.name);
+            defer if (renderer) |r| r.endGpuScope();
+
+            const pass_context = PassContext{ .graph = self, .pass = @intCast(index) };
+            try pass.run_fn(pass.context, &pass_context);
+        }
+
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+        err.checkGLError("FrameGraph.execute");
+    }
+
+
+    /// Counts of the last compile
+    pub fn frameStats(self: *const Self) FrameGraphStats {
+        return self.stats;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.deleteFramebuffers();
+        self.framebuffers.deinit(self.allocator);
+        for (self.physical.items) |*physical| deletePhysical(physical);
+        self.physical.deinit();
+        self.accesses.deinit();
+        self.passes.deinit();
+        self.resources.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn addResource(self: *Self, resource: Resource) !ResourceId {
+        const id: ResourceId = @intCast(self.resources.items.len);
+        try self.resources.append(resource);
+        self.compiled = false;
+        return id;
+    }
+
+
+    fn addAccess(self: *Self, pass: PassId, resource: ResourceId, access: Access, is_write: bool) !void {
+        if (pass >= self.passes.items.len or resource >= self.resources.items.len) return FrameGraphError.InvalidHandle;
+        try self.accesses.append(.{ .pass = pass, .resource = resource, .access = access, .write = is_write });
+        self.compiled = false;
+    }
+
+
+    fn passAccesses(self: *const Self, pass: *const Pass) []const ResourceAccess {
+        return self.accesses.items[pass.first_access..pass.access_end];
+    }
+
+
+    /// Walk back from the last pass: a pass lives when it has a side effect, writes an imported resource,
+    /// or writes something a later live pass reads
+    fn cullPasses(self: *Self) !void {
+        var needed = try std.DynamicBitSetUnmanaged.initEmpty(self.allocator, self.resources.items.len);
+        defer needed.deinit(self.allocator);
+
+        var index = self.passes.items.len;
+        while (index > 0) {
+            index -= 1;
+            const pass = &self.passes.items[index];
+            pass.live = pass.side_effect;
+            for (self.passAccesses(pass)) |access| {
+                if (access.write and (self.resources.items[access.resource].imported or needed.isSet(access.resource))) pass.live = true;
+            }
+
+            if (!pass.live) {
+                self.stats.culled_passes += 1;
+                continue;
+            }
+            self.stats.live_passes += 1;
+            for (self.passAccesses(pass)) |access| {
+                if (!access.write) needed.set(access.resource);
+            }
+        }
+    }
+
+
+    fn computeLifetimes(self: *Self) void {
+        for (self.resources.items) |*resource| {
+            resource.first_pass = null;
+            resource.last_pass = 0;
+        }
+        for (self.passes.items, 0..) |*pass, index| {
+            if (!pass.live) continue;
+            for (self.passAccesses(pass)) |access| {
+                const resource = &self.resources.items[access.resource];
+                if (resource.first_pass == null) resource.first_pass = @intCast(index);
+                resource.last_pass = @intCast(index);
+            }
+        }
+    }
+
+
+    /// Hand every transient resource a physical object that is free by its first pass, creating one if none is
+    fn allocatePhysical(self: *Self) !void {
+        for (self.physical.items) |*physical| {
+            physical.busy_until = null;
+            physical.occupant = null;
+        }
+        for (self.resources.items) |*resource| {
+            if (resource.imported) continue;
+            resource.handle = 0;
+            resource.dirty = false;
+            resource.issued = 0;
+        }
+
+        // Resources are visited by first pass, so a physical freed by an earlier lifetime is reused
+        for (self.passes.items, 0..) |*pass, index| {
+            if (!pass.live) continue;
+            for (self.passAccesses(pass)) |access| {
+                const resource = &self.resources.items[access.resource];
+                if (resource.imported or resource.first_pass.? != index or resource.handle != 0) continue;
+
+                const physical = try self.acquirePhysical(resource.desc, @intCast(index));
+                resource.handle = physical.handle;
+                physical.busy_until = resource.last_pass;
+                if (physical.occupant) |previous| {
+                    resource.dirty = self.resources.items[previous].dirty;
+                    resource.issued = self.resources.items[previous].issued;
+                }
+                physical.occupant = access.resource;
+                self.stats.transient_resources += 1;
+            }
+        }
+    }
+
+
+    fn acquirePhysical(self: *Self, desc: ResourceDesc, pass: PassId) !*Physical {
+        for (self.physical.items) |*physical| {
+            if (!physical.desc.eql(desc)) continue;
+            if (physical.busy_until) |busy_until| {
+                if (busy_until >= pass) continue;
+            }
+            physical.last_used_frame = self.frame;
+            return physical;
+        }
+
+        const physical = try self.physical.addOne();
+        physical.* = .{ .desc = desc, .handle = createPhysical(desc), .last_used_frame = self.frame };
+        return physical;
+    }
+
+
+    /// A barrier is global, so the bits a pass issues cover everything stored to before it
+    fn placeBarriers(self: *Self) void {
+        for (self.passes.items) |*pass| {
+            pass.barriers = 0;
+            if (!pass.live) continue;
+
+            for (self.passAccesses(pass)) |access| {
+                const resource = &self.resources.items[access.resource];
+                const bits = access.access.barrierBits();
+                if (resource.dirty and (resource.issued & bits) != bits) pass.barriers |= bits;
+            }
+
+            if (pass.barriers != 0) {
+                self.stats.barriers += 1;
+                for (self.resources.items) |*resource| {
+                    if (resource.dirty) resource.issued |= pass.barriers;
+                }
+            }
+
+            for (self.passAccesses(pass)) |access| {
+                if (!access.write or !access.access.isShaderStore()) continue;
+                const resource = &self.resources.items[access.resource];
+                resource.dirty = true;
+                resource.issued = 0;
+            }
+        }
+    }
+
+
+    /// Framebuffer of the textures each live pass writes as attachment, cached by attachment set
+    fn buildFramebuffers(self: *Self) !void {
+        for (self.passes.items) |*pass| {
+            pass.framebuffer = null;
+            if (!pass.live) continue;
+
+            var attachments: AttachmentSet = .{0} ** (max_color_attachments + 1);
+            var color_count: usize = 0;
+            var depth_format: ?c.GLenum = null;
+            var to_window = false;
+            for (self.passAccesses(pass)) |access| {
+                if (!access.write or access.access != .attachment) continue;
+                const resource = &self.resources.items[access.resource];
+                const desc = switch (resource.desc) {
+                    .texture => |texture| texture,
+                    .buffer => continue,
+                };
+                pass.viewport = .{ desc.width, desc.height };
+
+                if (resource.imported and resource.handle == 0) {
+                    to_window = true;
+                } else if (isDepthFormat(desc.format)) {
+                    if (depth_format != null) return FrameGraphError.TooManyAttachments;
+                    attachments[max_color_attachments] = resource.handle;
+                    depth_format = desc.format;
+                } else {
+                    if (color_count == max_color_attachments) return FrameGraphError.TooManyAttachments;
+                    attachments[color_count] = resource.handle;
+                    color_count += 1;
+                }
+            }
+
+            if (to_window) {
+                pass.framebuffer = err.default_framebuffer;
+            } else if (color_count > 0 or depth_format != null) {
+                pass.framebuffer = try self.framebufferFor(attachments, color_count, depth_format);
+            }
+        }
+    }
+
+
+    fn framebufferFor(self: *Self, attachments: AttachmentSet, color_count: usize, depth_format: ?c.GLenum) !c.GLuint {
+        const entry = try self.framebuffers.getOrPut(self.allocator, attachments);
+        if (entry.found_existing) return entry.value_ptr.*;
+        errdefer _ = self.framebuffers.remove(attachments);
+
+        var framebuffer: c.GLuint = 0;
+        c.glGenFramebuffers(1, &framebuffer);
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, framebuffer);
+
+        var draw_buffers: [max_color_attachments]c.GLenum = undefined;
+        for (attachments[0..color_count], 0..) |texture, slot| {
+            const attachment: c.GLenum = c.GL_COLOR_ATTACHMENT0 + @as(c.GLenum, @intCast(slot));
+            c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, attachment, c.GL_TEXTURE_2D, texture, 0);
+            draw_buffers[slot] = attachment;
+        }
+        if (color_count > 0) {
+            c.glDrawBuffers(@intCast(color_count), &draw_buffers);
+        } else {
+            c.glDrawBuffer(c.GL_NONE);
+            c.glReadBuffer(c.GL_NONE);
+        }
+
+        if (depth_format) |format| {
+            c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, depthAttachmentOf(format), c.GL_TEXTURE_2D, attachments[max_color_attachments], 0);
+        }
+
+        const status = c.glCheckFramebufferStatus(c.GL_FRAMEBUFFER);
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+        if (status != c.GL_FRAMEBUFFER_COMPLETE) {
+            c.glDeleteFramebuffers(1, &framebuffer);
+            return FrameGraphError.IncompleteFramebuffer;
+        }
+
+        entry.value_ptr.* = framebuffer;
+        return framebuffer;
+    }
+
+
+    /// Delete physical objects unused for release_after_frames, with every cached framebuffer using them
+    fn releaseUnused(self: *Self) void {
+        var index: usize = 0;
+        var released = false;
+        while (index < self.physical.items.len) {
+            const physical = &self.physical.items[index];
+            if (self.frame - physical.last_used_frame <= release_after_frames) {
+                index += 1;
+                continue;
+            }
+            deletePhysical(physical);
+            _ = self.physical.swapRemove(index);
+            released = true;
+        }
+        if (released) self.deleteFramebuffers();
+    }
+
+
+    fn deleteFramebuffers(self: *Self) void {
+        var iterator = self.framebuffers.valueIterator();
+        while (iterator.next()) |framebuffer| c.glDeleteFramebuffers(1, framebuffer);
+        self.framebuffers.clearRetainingCapacity();
+    }
+
+
+    fn createPhysical(desc: ResourceDesc) c.GLuint {
+        var handle: c.GLuint = 0;
+        switch (desc) {
+            .texture => |texture| {
+                const format, const data_type = pixelTransfer(texture.format);
+                c.glGenTextures(1, &handle);
+                GLStateCache.current().bindTexture2D(0, handle);
+                c.glTexImage2D(c.GL_TEXTURE_2D, 0, @intCast(texture.format), @intCast(texture.width), @intCast(texture.height), 0, format, data_type, null);
+                c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_LINEAR);
+                c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_LINEAR);
+                c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
+                c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
+            },
+            .buffer => |buffer| {
+                c.glGenBuffers(1, &handle);
+                GLStateCache.current().bindArrayBuffer(handle);
+                c.glBufferData(c.GL_ARRAY_BUFFER, @intCast(buffer.size), null, c.GL_DYNAMIC_COPY);
+            },
+        }
+        err.checkGLError("FrameGraph: create transient resource");
+        return handle;
+    }
+
+
+    fn deletePhysical(physical: *Physical) void {
+        const state = GLStateCache.current();
+        switch (physical.desc) {
+            .texture => {
+                state.forgetTexture(physical.handle);
+                c.glDeleteTextures(1, &physical.handle);
+            },
+            .buffer => {
+                state.forgetBuffer(physical.handle);
+                c.glDeleteBuffers(1, &physical.handle);
+            },
+        }
+    }
+
+
+    fn isDepthFormat(format: c.GLenum) bool {
+        return switch (format) {
+            c.GL_DEPTH_COMPONENT16, c.GL_DEPTH_COMPONENT24, c.GL_DEPTH_COMPONENT32, c.GL_DEPTH_COMPONENT32F, c.GL_DEPTH24_STENCIL8, c.GL_DEPTH32F_STENCIL8 => true,
+            else => false,
+        };
+    }
+
+
+    fn depthAttachmentOf(format: c.GLenum) c.GLenum {
+        return switch (format) {
+            c.GL_DEPTH24_STENCIL8, c.GL_DEPTH32F_STENCIL8 => c.GL_DEPTH_STENCIL_ATTACHMENT,
+            else => c.GL_DEPTH_ATTACHMENT,
+        };
+    }
+
+
+    /// Format and type glTexImage2D accepts for allocating `internal_format` without data
+    fn pixelTransfer(internal_format: c.GLenum) struct { c.GLenum, c.GLenum } {
+        return switch (internal_format) {
+            c.GL_DEPTH24_STENCIL8 => .{ c.GL_DEPTH_STENCIL, c.GL_UNSIGNED_INT_24_8 },
+            c.GL_DEPTH32F_STENCIL8 => .{ c.GL_DEPTH_STENCIL, c.GL_FLOAT_32_UNSIGNED_INT_24_8_REV },
+            c.GL_DEPTH_COMPONENT16, c.GL_DEPTH_COMPONENT24, c.GL_DEPTH_COMPONENT32, c.GL_DEPTH_COMPONENT32F => .{ c.GL_DEPTH_COMPONENT, c.GL_FLOAT },
+            c.GL_R8, c.GL_R16F, c.GL_R32F => .{ c.GL_RED, c.GL_FLOAT },
+            c.GL_RG8, c.GL_RG16F, c.GL_RG32F => .{ c.GL_RG, c.GL_FLOAT },
+            else => .{ c.GL_RGBA, c.GL_FLOAT },
+        };
+    }
+};
@@ -0,0 +1,628 @@
+// graphics/geometry_pool.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const mesh_module = @import("mesh.zig");
+const Mesh = mesh_module.Mesh;
+const MeshError = mesh_module.MeshError;
+const VertexLayout = mesh_module.VertexLayout;
+const InstanceSource = mesh_module.InstanceSource;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const BoundingBox = @import("../math/bounds.zig").BoundingBox;
+
+
+/// Shared vertex and index buffers for many meshes, one section per vertex layout
+/// Meshes of a section share its VAO and draw with glDrawElementsBaseVertex, so switching
+/// between them costs no VAO, VBO or EBO bind and instanced batches of a section stay on one attribute setup
+/// The pool has to outlive every mesh created from it
+/// Sections store f32 attributes and u32 indices, so meshes of any size share one index type per section
+pub const GeometryPool = struct {
+    const Self = @This();
+
+    /// Package sizes with a section, in section order
+    pub const package_sizes = [_]u4{ 3, 5, 6, 7, 8 };
+
+    /// Contiguous buffers of one vertex layout, sub-allocated into mesh ranges
+    pub const Section = struct {
+        package_size: u4,
+        layout: VertexLayout,
+
+        vao: c.GLuint,
+        vbo: c.GLuint,
+        ebo: c.GLuint,
+        /// In vertices and in indices
+        vertices: RangeList,
+        indices: RangeList,
+        /// Instance attribute source of the shared VAO
+        instance_source: InstanceSource = .{},
+        /// Live meshes of the section, the ones compaction may move
+        meshes: std.AutoArrayHashMapUnmanaged(*Mesh, void) = .{},
+
+
+        /// Give the ranges of `mesh` back to the section, called when a pooled mesh is released
+        pub fn free(self: *Section, mesh: *Mesh) void {
+            _ = self.meshes.swapRemove(mesh);
+            self.vertices.free(mesh.base_vertex, self.vertexCount(mesh)) catch {};
+            self.indices.free(mesh.first_index, @intCast(mesh.index_count)) catch {};
+        }
+
+
+        fn vertexCount(self: *const Section, mesh: *const Mesh) u32 {
+            const floats_per_vertex = mesh_module.getFloatsPerVertex(self.package_size);
+            return @intCast(mesh.vertex_bytes / (floats_per_vertex * @sizeOf(f32)));
+        }
+
+
+        /// Bytes per vertex
+        pub fn stride(self: *const Section) usize {
+            return self.layout.stride;
+        }
+    };
+
+    /// Vertex and index ranges taken from a section for a mesh whose data is written afterwards
+    pub const Reservation = struct {
+        section: *Section,
+        base_vertex: u32,
+        first_index: u32,
+        vertex_count: u32,
+        index_count: u32,
+    };
+
+    allocator: std.mem.Allocator,
+    /// Capacities of newly created sections, in vertices and indices
+    initial_vertex_capacity: u32,
+    initial_index_capacity: u32,
+    /// Created once a mesh of the layout is added
+    sections: [package_sizes.len]?Section = .{null} ** package_sizes.len,
+    /// Meshes moved by compact so far
+    relocations: u64 = 0,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Heap-allocated so the sections meshes point at stay in place
+    pub fn create(allocator: std.mem.Allocator, initial_vertex_capacity: u32, initial_index_capacity: u32) !*Self {
+        const pool = try allocator.create(Self);
+        pool.* = .{
+            .allocator = allocator,
+            .initial_vertex_capacity = @max(initial_vertex_capacity, 1),
+            .initial_index_capacity = @max(initial_index_capacity, 1),
+        };
+        return pool;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Add a mesh to the section of its layout, growing the section when it is full
+    /// The mesh is released like any other, which hands its ranges back to the pool
+    pub fn createMesh(self: *Self, data: []const f32, indices: []const u32, package_size: u4) !*Mesh {
+        const floats_per_vertex = mesh_module.getFloatsPerVertex(package_size);
+
+        // Validate input data length
+        if (data.len % floats_per_vertex != 0) return MeshError.InvalidVertexData;
+
+        const reservation = try self.reserve(package_size, @intCast(data.len / floats_per_vertex), @intCast(indices.len));
+        errdefer self.cancelReservation(reservation);
+        const section = reservation.section;
+
+        const state = GLStateCache.current();
+        if (reservation.vertex_count > 0) {
+            state.bindArrayBuffer(section.vbo);
+            c.glBufferSubData(
+                c.GL_ARRAY_BUFFER,
+                @intCast(reservation.base_vertex * section.stride()),
+                @intCast(data.len * @sizeOf(f32)),
+                data.ptr,
+            );
+        }
+        if (reservation.index_count > 0) {
+            // The element buffer binding belongs to the VAO
+            state.bindVertexArray(section.vao);
+            c.glBufferSubData(
+                c.GL_ELEMENT_ARRAY_BUFFER,
+                @intCast(reservation.first_index * @sizeOf(u32)),
+                @intCast(indices.len * @sizeOf(u32)),
+                indices.ptr,
+            );
+        }
+        err.checkGLError("GeometryPool.createMesh: glBufferSubData");
+
+        return self.createReservedMesh(reservation, BoundingBox.fromVertices(data, floats_per_vertex));
+    }
+
+
+    /// Take vertex and index ranges for a mesh without writing them, growing the section when it is full
+    /// Fill them through the section's buffers, e.g. with a MeshBuilder, then call createReservedMesh
+    /// Adding meshes can grow the section and move its buffers, so fill a reservation before the next one
+    pub fn reserve(self: *Self, package_size: u4, vertex_count: u32, index_count: u32) !Reservation {
+        const section = try self.getSection(package_size);
+
+        const base_vertex = try self.allocRange(section, .vertices, vertex_count);
+        errdefer section.vertices.free(base_vertex, vertex_count) catch {};
+        const first_index = try self.allocRange(section, .indices, index_count);
+
+        return .{
+            .section = section,
+            .base_vertex = base_vertex,
+            .first_index = first_index,
+            .vertex_count = vertex_count,
+            .index_count = index_count,
+        };
+    }
+
+
+    /// Mesh drawing the ranges of `reservation`, whose u32 indices count from its base vertex
+    /// On error the reservation stays taken, hand it back with cancelReservation
+    pub fn createReservedMesh(self: *Self, reservation: Reservation, bounds: BoundingBox) !*Mesh {
+        const section = reservation.section;
+        try section.meshes.ensureUnusedCapacity(self.allocator, 1);
+        const mesh_ptr = try self.allocator.create(Mesh);
+        const vertex_bytes = @as(usize, reservation.vertex_count) * section.stride();
+
+        mesh_ptr.* = .{
+            .vao = section.vao,
+            .vbo = 0,
+            .ebo = 0,
+            .index_count = reservation.index_count,
+            .section = section,
+            .base_vertex = reservation.base_vertex,
+            .first_index = reservation.first_index,
+            .bounds = bounds,
+            .package_size = section.package_size,
+            .vertex_bytes = vertex_bytes,
+            .vertex_capacity = vertex_bytes,
+            .index_capacity = @as(usize, reservation.index_count) * @sizeOf(u32),
+            .ref_count = std.atomic.Value(u32).init(1),
+            .allocator = self.allocator,
+        };
+        section.meshes.putAssumeCapacity(mesh_ptr, {});
+        return mesh_ptr;
+    }
+
+
+    /// Give the ranges of a reservation that never became a mesh back to its section
+    pub fn cancelReservation(self: *Self, reservation: Reservation) void {
+        _ = self;
+        reservation.section.vertices.free(reservation.base_vertex, reservation.vertex_count) catch {};
+        reservation.section.indices.free(reservation.first_index, reservation.index_count) catch {};
+    }
+
+
+    /// Move meshes into the lowest holes below them until `budget_bytes` were copied, then shrink
+    /// buffers whose used part fell under a quarter of their capacity, so streaming levels in and
+    /// out does not keep doubling them. Copies stay on the GPU with glCopyBufferSubData and queue
+    /// behind the frame's draws; a moved mesh gets its new base vertex or first index right away
+    /// Call between frames on the GL thread. Draw lists recorded with mesh offsets, such as
+    /// RenderBundle and GpuCuller.buildCommands, have to be recorded again once relocations changed
+    /// Returns the bytes copied
+    pub fn compact(self: *Self, budget_bytes: usize) !usize {
+        var copied: usize = 0;
+        for (&self.sections) |*slot| {
+            const section = if (slot.*) |*s| s else continue;
+            for ([_]RangeKind{ .vertices, .indices }) |kind| {
+                if (copied < budget_bytes) copied += try self.compactRanges(section, kind, budget_bytes - copied);
+                self.shrink(section, kind);
+            }
+        }
+        return copied;
+    }
+
+
+    /// Meshes moved by compact so far, a change means recorded mesh offsets are stale
+    pub fn relocationCount(self: *const Self) u64 {
+        return self.relocations;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Free the shared buffers, every mesh of the pool has to be released before
+    pub fn destroy(self: *Self) void {
+        const state = GLStateCache.current();
+        for (&self.sections) |*slot| {
+            if (slot.*) |*section| {
+                state.forgetVertexArray(section.vao);
+                state.forgetBuffer(section.vbo);
+
+                c.glDeleteVertexArrays(1, &section.vao);
+                const buffers = [_]c.GLuint{ section.vbo, section.ebo };
+                c.glDeleteBuffers(buffers.len, &buffers);
+
+                section.vertices.deinit();
+                section.indices.deinit();
+                section.meshes.deinit(self.allocator);
+            }
+            slot.* = null;
+        }
+        err.checkGLError("GeometryPool cleanup");
+
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    const RangeKind = enum { vertices, indices };
+
+
+    fn sectionIndex(package_size: u4) ?usize {
+        return std.mem.indexOfScalar(u4, &package_sizes, package_size);
+    }
+
+
+    /// Section of `package_size`, creating its VAO and buffers on first use
+    fn getSection(self: *Self, package_size: u4) !*Section {
+        const layout = try mesh_module.getLayoutFromPackageSize(package_size);
+        const index = sectionIndex(package_size) orelse return MeshError.InvalidPackageSize;
+        if (self.sections[index]) |*section| return section;
+
+        var vao: c.GLuint = undefined;
+        var buffers: [2]c.GLuint = undefined;
+        c.glGenVertexArrays(1, &vao);
+        c.glGenBuffers(buffers.len, &buffers);
+        err.checkGLError("glGenVertexArrays and glGenBuffers for GeometryPool");
+
+        const state = GLStateCache.current();
+        state.bindVertexArray(vao);
+
+        state.bindArrayBuffer(buffers[0]);
+        c.glBufferData(c.GL_ARRAY_BUFFER, @intCast(self.initial_vertex_capacity * layout.stride), null, c.GL_STATIC_DRAW);
+        mesh_module.setupVertexAttributes(layout, 0);
+
+        c.glBindBuffer(c.GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+        c.glBufferData(c.GL_ELEMENT_ARRAY_BUFFER, @intCast(self.initial_index_capacity * @sizeOf(u32)), null, c.GL_STATIC_DRAW);
+        err.checkGLError("GeometryPool: section storage");
+
+        state.bindVertexArray(0);
+
+        self.sections[index] = .{
+            .package_size = package_size,
+            .layout = layout,
+            .vao = vao,
+            .vbo = buffers[0],
+            .ebo = buffers[1],
+            .vertices = RangeList.init(self.allocator, self.initial_vertex_capacity),
+            .indices = RangeList.init(self.allocator, self.initial_index_capacity),
+        };
+        return &self.sections[index].?;
+    }
+
+
+    /// First element of a free range of `count`, doubling the section's buffer until it fits
+    fn allocRange(self: *Self, section: *Section, kind: RangeKind, count: u32) !u32 {
+        const ranges = switch (kind) {
+            .vertices => &section.vertices,
+            .indices => &section.indices,
+        };
+        if (try ranges.alloc(count)) |start| return start;
+
+        var capacity = ranges.capacity;
+        while (capacity - ranges.end < count) capacity *= 2;
+        reallocate(section, kind, capacity);
+        ranges.capacity = capacity;
+
+        return (try ranges.alloc(count)).?;
+    }
+
+
+    /// Move the highest meshes of one range list of `section` down into free ranges, highest first so
+    /// the top of the buffer drains, until `budget_bytes` were copied. Returns the bytes copied
+    fn compactRanges(self: *Self, section: *Section, kind: RangeKind, budget_bytes: usize) !usize {
+        const ranges = switch (kind) {
+            .vertices => &section.vertices,
+            .indices => &section.indices,
+        };
+        if (ranges.free_ranges.items.len == 0) return 0;
+
+        const element_size = switch (kind) {
+            .vertices => section.stride(),
+            .indices => @sizeOf(u32),
+        };
+        const buffer = switch (kind) {
+            .vertices => section.vbo,
+            .indices => section.ebo,
+        };
+
+        // Only meshes above the lowest hole can move down
+        const lowest_hole = ranges.free_ranges.items[0].start;
+        var candidates = std.ArrayList(*Mesh).init(self.allocator);
+        defer candidates.deinit();
+        for (section.meshes.keys()) |mesh| {
+            if (rangeOf(section, mesh, kind).start > lowest_hole) try candidates.append(mesh);
+        }
+        const Order = struct {
+            section: *Section,
+            kind: RangeKind,
+
+            fn higher(order: @This(), a: *Mesh, b: *Mesh) bool {
+                return rangeOf(order.section, a, order.kind).start > rangeOf(order.section, b, order.kind).start;
+            }
+        };
+        std.sort.pdq(*Mesh, candidates.items, Order{ .section = section, .kind = kind }, Order.higher);
+
+        c.glBindBuffer(c.GL_COPY_READ_BUFFER, buffer);
+        c.glBindBuffer(c.GL_COPY_WRITE_BUFFER, buffer);
+        defer {
+            c.glBindBuffer(c.GL_COPY_READ_BUFFER, 0);
+            c.glBindBuffer(c.GL_COPY_WRITE_BUFFER, 0);
+        }
+
+        var copied: usize = 0;
+        for (candidates.items) |mesh| {
+            if (copied >= budget_bytes) break;
+            const range = rangeOf(section, mesh, kind);
+            if (range.count == 0) continue;
+            const hole = ranges.lowestFit(range.count, range.start) orelse continue;
+            const start = try ranges.take(hole, range.count);
+
+            // The hole lies below the mesh, so source and destination never overlap
+            const bytes = @as(usize, range.count) * element_size;
+            c.glCopyBufferSubData(
+                c.GL_COPY_READ_BUFFER,
+                c.GL_COPY_WRITE_BUFFER,
+                @intCast(@as(usize, range.start) * element_size),
+                @intCast(@as(usize, start) * element_size),
+                @intCast(bytes),
+            );
+            // Indices count from the base vertex, so moving vertices leaves the index data as it is
+            switch (kind) {
+                .vertices => mesh.base_vertex = start,
+                .indices => mesh.first_index = start,
+            }
+            ranges.free(range.start, range.count) catch {};
+            copied += bytes;
+            self.relocations += 1;
+        }
+        err.checkGLError("GeometryPool: compact section");
+        return copied;
+    }
+
+
+    fn rangeOf(section: *const Section, mesh: *const Mesh, kind: RangeKind) RangeList.Range {
+        return switch (kind) {
+            .vertices => .{ .start = mesh.base_vertex, .count = section.vertexCount(mesh) },
+            .indices => .{ .start = mesh.first_index, .count = @intCast(mesh.index_count) },
+        };
+    }
+
+
+    /// Halve a buffer's capacity while its used part stays under a quarter of it, down to the initial one
+    fn shrink(self: *Self, section: *Section, kind: RangeKind) void {
+        const ranges = switch (kind) {
+            .vertices => &section.vertices,
+            .indices => &section.indices,
+        };
+        const initial = switch (kind) {
+            .vertices => self.initial_vertex_capacity,
+            .indices => self.initial_index_capacity,
+        };
+
+        var capacity = ranges.capacity;
+        while (capacity / 2 >= initial and ranges.end < capacity / 4) capacity /= 2;
+        if (capacity == ranges.capacity) return;
+        reallocate(section, kind, capacity);
+        ranges.capacity = capacity;
+    }
+
+
+    /// Move a section's VBO or EBO to a buffer of `capacity`, copying the used part on the GPU
+    fn reallocate(section: *Section, kind: RangeKind, capacity: u32) void {
+        const element_size = switch (kind) {
+            .vertices => section.stride(),
+            .indices => @sizeOf(u32),
+        };
+        const old_buffer = switch (kind) {
+            .vertices => section.vbo,
+            .indices => section.ebo,
+        };
+        const used = switch (kind) {
+            .vertices => section.vertices.end,
+            .indices => section.indices.end,
+        };
+
+        var new_buffer: c.GLuint = undefined;
+        c.glGenBuffers(1, &new_buffer);
+
+        c.glBindBuffer(c.GL_COPY_READ_BUFFER, old_buffer);
+        c.glBindBuffer(c.GL_COPY_WRITE_BUFFER, new_buffer);
+        c.glBufferData(c.GL_COPY_WRITE_BUFFER, @intCast(capacity * element_size), null, c.GL_STATIC_DRAW);
+        c.glCopyBufferSubData(c.GL_COPY_READ_BUFFER, c.GL_COPY_WRITE_BUFFER, 0, 0, @intCast(used * element_size));
+        c.glBindBuffer(c.GL_COPY_READ_BUFFER, 0);
+        c.glBindBuffer(c.GL_COPY_WRITE_BUFFER, 0);
+        err.checkGLError("GeometryPool: reallocate section");
+
+        // Point the shared VAO at the new storage
+        const state = GLStateCache.current();
+        state.bindVertexArray(section.vao);
+        switch (kind) {
+            .vertices => {
+                state.bindArrayBuffer(new_buffer);
+                mesh_module.setupVertexAttributes(section.layout, 0);
+                // The reset above also disabled the instance attributes
+                section.instance_source = .{};
+                section.vbo = new_buffer;
+            },
+            .indices => {
+                c.glBindBuffer(c.GL_ELEMENT_ARRAY_BUFFER, new_buffer);
+                section.ebo = new_buffer;
+            },
+        }
+        state.bindVertexArray(0);
+
+        state.forgetBuffer(old_buffer);
+        c.glDeleteBuffers(1, &old_buffer);
+        err.checkGLError("GeometryPool: replace section buffer");
+    }
+};
+
+
+/// Allocator of element ranges in a buffer of `capacity` elements, free ranges bucketed by size class
+/// A request takes the front of a range from the smallest class above its own, so it fits without
+/// a look at the range; only ranges of its own class are walked. Freed ranges are kept sorted as
+/// well and merged with their neighbours, a range ending at the top lowers it
+const RangeList = struct {
+    const Range = struct {
+        start: u32,
+        count: u32,
+    };
+
+    /// One class per highest set bit of a range's count
+    const class_count = 32;
+
+    allocator: std.mem.Allocator,
+    /// Sorted by start, for merging and for compaction to find the lowest hole
+    free_ranges: std.ArrayList(Range),
+    /// Starts of the free ranges of each class, unordered
+    classes: [class_count]std.ArrayListUnmanaged(u32) = .{std.ArrayListUnmanaged(u32){}} ** class_count,
+    /// Bit k set while class k holds a range
+    class_mask: u32 = 0,
+    /// Elements below `end` are allocated or in `free_ranges`, everything above is free
+    end: u32 = 0,
+    capacity: u32,
+    /// Elements handed out and not freed
+    used: u32 = 0,
+
+
+    fn init(allocator: std.mem.Allocator, capacity: u32) RangeList {
+        return .{
+            .allocator = allocator,
+            .free_ranges = std.ArrayList(Range).init(allocator),
+            .capacity = capacity,
+        };
+    }
+
+
+    /// Start of a range of `count` elements, null when it does not fit the capacity
+    fn alloc(self: *RangeList, count: u32) !?u32 {
+        if (count == 0) return 0;
+
+        // Any range of a larger class fits, one of the count's own class might not
+        const class = classOf(count);
+        const larger = if (class == class_count - 1) 0 else self.class_mask & (~@as(u32, 0) << (class + 1));
+        if (larger != 0) {
+            const starts = self.classes[@ctz(larger)].items;
+            return try self.take(self.lowerBound(starts[starts.len - 1]), count);
+        }
+        for (self.classes[class].items) |start| {
+            const index = self.lowerBound(start);
+            if (self.free_ranges.items[index].count >= count) return try self.take(index, count);
+        }
+
+        if (self.capacity - self.end < count) return null;
+        const start = self.end;
+        self.end += count;
+        self.used += count;
+        return start;
+    }
+
+
+    fn free(self: *RangeList, start: u32, count: u32) !void {
+        if (count == 0) return;
+        self.used -= count;
+
+        // Insertion point keeping the list sorted by start
+        var i = self.lowerBound(start);
+
+        var merged = Range{ .start = start, .count = count };
+        if (i > 0) {
+            const prev = self.free_ranges.items[i - 1];
+            if (prev.start + prev.count == start) {
+                self.unclassify(prev);
+                merged = .{ .start = prev.start, .count = prev.count + count };
+                i -= 1;
+                _ = self.free_ranges.orderedRemove(i);
+            }
+        }
+        if (i < self.free_ranges.items.len) {
+            const next = self.free_ranges.items[i];
+            if (merged.start + merged.count == next.start) {
+                self.unclassify(next);
+                merged.count += next.count;
+                _ = self.free_ranges.orderedRemove(i);
+            }
+        }
+
+        if (merged.start + merged.count == self.end) {
+            self.end = merged.start;
+            return;
+        }
+        try self.free_ranges.insert(i, merged);
+        try self.classify(merged);
+    }
+
+
+    /// Index of the lowest free range of at least `count` elements starting below `limit`
+    fn lowestFit(self: *const RangeList, count: u32, limit: u32) ?usize {
+        for (self.free_ranges.items, 0..) |range, i| {
+            if (range.start >= limit) return null;
+            if (range.count >= count) return i;
+        }
+        return null;
+    }
+
+
+    /// Allocate the front of free range `index`, which holds at least `count` elements
+    fn take(self: *RangeList, index: usize, count: u32) !u32 {
+        const range = &self.free_ranges.items[index];
+        const start = range.start;
+        self.unclassify(range.*);
+        self.used += count;
+        if (range.count == count) {
+            _ = self.free_ranges.orderedRemove(index);
+        } else {
+            range.start += count;
+            range.count -= count;
+            try self.classify(range.*);
+        }
+        return start;
+    }
+
+
+    fn deinit(self: *RangeList) void {
+        self.free_ranges.deinit();
+        for (&self.classes) |*class| class.deinit(self.allocator);
+    }
+
+
+    fn classOf(count: u32) u5 {
+        return @intCast(31 - @clz(count));
+    }
+
+
+    /// Index of the first free range starting at or after `start`
+    fn lowerBound(self: *const RangeList, start: u32) usize {
+        var low: usize = 0;
+        var high = self.free_ranges.items.len;
+        while (low < high) {
+            const mid = (low + high) / 2;
+            if (self.free_ranges.items[mid].start < start) low = mid + 1 else high = mid;
+        }
+        return low;
+    }
+
+
+    fn classify(self: *RangeList, range: Range) !void {
+        const class = classOf(range.count);
+        try self.classes[class].append(self.allocator, range.start);
+        self.class_mask |= @as(u32, 1) << class;
+    }
+
+
+    fn unclassify(self: *RangeList, range: Range) void {
+        const class = classOf(range.count);
+        const starts = &self.classes[class];
+        const index = std.mem.indexOfScalar(u32, starts.items, range.start) orelse return;
+        _ = starts.swapRemove(index);
+        if (starts.items.len == 0) self.class_mask &= ~(@as(u32, 1) << class);
+    }
+};
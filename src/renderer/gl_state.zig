@@ -0,0 +1,431 @@
+// graphics/gl_state.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+const render_stats = @import("render_stats.zig");
+
+
+/// Blending setups of the engine's passes
+pub const BlendMode = enum {
+    off,
+    /// Straight alpha over what is already drawn, for back to front transparency
+    alpha,
+    /// Colors add up and alpha multiplies the destination by 1 - alpha, the accumulation of weighted blended OIT
+    weighted_blended,
+};
+
+
+/// Shadow copy of the GL state the engine touches, every setter skips the GL call when nothing changes
+/// A null field means the state is unknown and the next setter always reaches GL
+pub const GLStateCache = struct {
+    const Self = @This();
+
+    pub const max_texture_units = 16;
+
+    program: ?c.GLuint = null,
+    vertex_array: ?c.GLuint = null,
+    array_buffer: ?c.GLuint = null,
+    active_texture_unit: ?u32 = null,
+    /// GL_TEXTURE_2D binding of each unit
+    textures: [max_texture_units]?c.GLuint = .{null} ** max_texture_units,
+    /// GL_TEXTURE_2D_ARRAY binding of each unit
+    texture_arrays: [max_texture_units]?c.GLuint = .{null} ** max_texture_units,
+    /// Sampler object of each unit, 0 samples with the texture's own parameters
+    samplers: [max_texture_units]?c.GLuint = .{null} ** max_texture_units,
+
+    blend: ?BlendMode = null,
+    depth_test: ?bool = null,
+    depth_func: ?c.GLenum = null,
+    depth_mask: ?bool = null,
+    color_mask: ?bool = null,
+    cull_face: ?bool = null,
+    cull_face_mode: ?c.GLenum = null,
+    front_face: ?c.GLenum = null,
+    polygon_mode: ?c.GLenum = null,
+    viewport: ?[4]c.GLint = null,
+    clear_color: ?[4]f32 = null,
+
+    /// Cache of the renderer that owns the current GL context, set by Renderer.create
+    /// Resources bind through it so the renderer's view of the state stays correct
+    threadlocal var active: ?*Self = null;
+    /// Used while no renderer exists, e.g. when resources are created first
+    threadlocal var fallback: Self = .{};
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// The cache every GL binding on this thread should go through
+    pub fn current() *Self {
+        return active orelse &fallback;
+    }
+
+
+    /// Route bindings made on this thread through `cache`, or back to the fallback when null
+    pub fn makeCurrent(cache: ?*Self) void {
+        active = cache;
+    }
+
+
+    /// Forget everything, call after code outside the engine touched GL state
+    pub fn invalidate(self: *Self) void {
+        self.* = .{};
+    }
+
+
+    pub fn useProgram(self: *Self, program: c.GLuint) void {
+        if (self.program == program) return;
+        c.glUseProgram(program);
+        err.checkGLError("glUseProgram");
+        render_stats.countProgramBind();
+        self.program = program;
+    }
+
+
+    pub fn bindVertexArray(self: *Self, vao: c.GLuint) void {
+        if (self.vertex_array == vao) return;
+        c.glBindVertexArray(vao);
+        err.checkGLError("glBindVertexArray");
+        render_stats.countVertexArrayBind();
+        self.vertex_array = vao;
+    }
+
+
+    pub fn bindArrayBuffer(self: *Self, buffer: c.GLuint) void {
+        if (self.array_buffer == buffer) return;
+        c.glBindBuffer(c.GL_ARRAY_BUFFER, buffer);
+        err.checkGLError("glBindBuffer");
+        self.array_buffer = buffer;
+    }
+
+
+    /// Overwrite part of `buffer` by name with direct state access, so no binding changes
+    /// Without it `buffer` is bound to `target`, array buffers through the cache. Element buffers
+    /// can't go through here on that path, their binding belongs to the bound VAO
+    pub fn bufferSubData(self: *Self, target: c.GLenum, buffer: c.GLuint, offset: usize, bytes: []const u8) void {
+        if (gl_ext.namedBufferSubData) |namedBufferSubData| {
+            namedBufferSubData(buffer, @intCast(offset), @intCast(bytes.len), bytes.ptr);
+        } else {
+            std.debug.assert(target != c.GL_ELEMENT_ARRAY_BUFFER);
+            if (target == c.GL_ARRAY_BUFFER) self.bindArrayBuffer(buffer) else c.glBindBuffer(target, buffer);
+            c.glBufferSubData(target, @intCast(offset), @intCast(bytes.len), bytes.ptr);
+        }
+        err.checkGLError("bufferSubData");
+    }
+
+
+    pub fn activeTexture(self: *Self, unit: u32) void {
+        if (self.active_texture_unit == unit) return;
+        c.glActiveTexture(c.GL_TEXTURE0 + unit);
+        err.checkGLError("glActiveTexture");
+        self.active_texture_unit = unit;
+    }
+
+
+    /// Bind a 2D texture to `unit`, leaves `unit` active
+    pub fn bindTexture2D(self: *Self, unit: u32, texture: c.GLuint) void {
+        std.debug.assert(unit < max_texture_units);
+
+        self.activeTexture(unit);
+        if (self.textures[unit] == texture) return;
+        c.glBindTexture(c.GL_TEXTURE_2D, texture);
+        err.checkGLError("glBindTexture");
+        render_stats.countTextureBind();
+        self.textures[unit] = texture;
+    }
+
+
+    /// Bind a 2D array texture to `unit`, leaves `unit` active
+    pub fn bindTexture2DArray(self: *Self, unit: u32, texture: c.GLuint) void {
+        std.debug.assert(unit < max_texture_units);
+
+        self.activeTexture(unit);
+        if (self.texture_arrays[unit] == texture) return;
+        c.glBindTexture(c.GL_TEXTURE_2D_ARRAY, texture);
+        err.checkGLError("glBindTexture");
+        render_stats.countTextureBind();
+        self.texture_arrays[unit] = texture;
+    }
+
+
+    /// Bind a sampler object to `unit`, 0 returns the unit to the bound texture's parameters
+    pub fn bindSampler(self: *Self, unit: u32, sampler: c.GLuint) void {
+        std.debug.assert(unit < max_texture_units);
+
+        if (self.samplers[unit] == sampler) return;
+        c.glBindSampler(unit, sampler);
+        err.checkGLError("glBindSampler");
+        self.samplers[unit] = sampler;
+    }
+
+
+    pub fn setBlend(self: *Self, mode: BlendMode) void {
+        if (self.blend == mode) return;
+        switch (mode) {
+            .off => c.glDisable(c.GL_BLEND),
+            .alpha => {
+                c.glEnable(c.GL_BLEND);
+                c.glBlendFunc(c.GL_SRC_ALPHA, c.GL_ONE_MINUS_SRC_ALPHA);
+            },
+            .weighted_blended => {
+                c.glEnable(c.GL_BLEND);
+                c.glBlendFuncSeparate(c.GL_ONE, c.GL_ONE, c.GL_ZERO, c.GL_ONE_MINUS_SRC_ALPHA);
+            },
+        }
+        err.checkGLError("setBlend");
+        self.blend = mode;
+    }
+
+
+    pub fn setDepthTest(self: *Self, enabled: bool) void {
+        if (self.depth_test == enabled) return;
+        if (enabled) c.glEnable(c.GL_DEPTH_TEST) else c.glDisable(c.GL_DEPTH_TEST);
+        err.checkGLError("setDepthTest");
+        self.depth_test = enabled;
+    }
+
+
+    pub fn setDepthFunc(self: *Self, func: c.GLenum) void {
+        if (self.depth_func == func) return;
+        c.glDepthFunc(func);
+        err.checkGLError("glDepthFunc");
+        self.depth_func = func;
+    }
+
+
+    pub fn setDepthMask(self: *Self, enabled: bool) void {
+        if (self.depth_mask == enabled) return;
+        c.glDepthMask(if (enabled) c.GL_TRUE else c.GL_FALSE);
+        err.checkGLError("glDepthMask");
+        self.depth_mask = enabled;
+    }
+
+
+    /// Writes to all four color channels, or none
+    pub fn setColorMask(self: *Self, enabled: bool) void {
+        if (self.color_mask == enabled) return;
+        const mask: c.GLboolean = if (enabled) c.GL_TRUE else c.GL_FALSE;
+        c.glColorMask(mask, mask, mask, mask);
+        err.checkGLError("glColorMask");
+        self.color_mask = enabled;
+    }
+
+
+    pub fn setCullFace(self: *Self, enabled: bool) void {
+        if (self.cull_face == enabled) return;
+        if (enabled) c.glEnable(c.GL_CULL_FACE) else c.glDisable(c.GL_CULL_FACE);
+        err.checkGLError("setCullFace");
+        self.cull_face = enabled;
+    }
+
+
+    pub fn setCullFaceMode(self: *Self, mode: c.GLenum) void {
+        if (self.cull_face_mode == mode) return;
+        c.glCullFace(mode);
+        err.checkGLError("glCullFace");
+        self.cull_face_mode = mode;
+    }
+
+
+    pub fn setFrontFace(self: *Self, winding: c.GLenum) void {
+        if (self.front_face == winding) return;
+        c.glFrontFace(winding);
+        err.checkGLError("glFrontFace");
+        self.front_face = winding;
+    }
+
+
+    pub fn setPolygonMode(self: *Self, mode: c.GLenum) void {
+        if (self.polygon_mode == mode) return;
+        c.glPolygonMode(c.GL_FRONT_AND_BACK, mode);
+        err.checkGLError("glPolygonMode");
+        self.polygon_mode = mode;
+    }
+
+
+    pub fn setViewport(self: *Self, x: i32, y: i32, width: i32, height: i32) void {
+        const viewport = [4]c.GLint{ x, y, width, height };
+        if (self.viewport) |cached| {
+            if (std.mem.eql(c.GLint, &cached, &viewport)) return;
+        }
+        c.glViewport(x, y, width, height);
+        err.checkGLError("glViewport");
+        self.viewport = viewport;
+    }
+
+
+    pub fn setClearColor(self: *Self, color: [4]f32) void {
+        if (self.clear_color) |cached| {
+            if (std.mem.eql(f32, &cached, &color)) return;
+        }
+        c.glClearColor(color[0], color[1], color[2], color[3]);
+        err.checkGLError("glClearColor");
+        self.clear_color = color;
+    }
+
+
+    // ============================================================
+    // Public API: Deletion Hooks
+    // ============================================================
+    // Call before deleting objects, GL reverts bindings of deleted names and may hand the name out again
+
+    pub fn forgetProgram(self: *Self, program: c.GLuint) void {
+        if (self.program == program) self.program = null;
+    }
+
+
+    pub fn forgetVertexArray(self: *Self, vao: c.GLuint) void {
+        if (self.vertex_array == vao) self.vertex_array = null;
+    }
+
+
+    pub fn forgetBuffer(self: *Self, buffer: c.GLuint) void {
+        if (self.array_buffer == buffer) self.array_buffer = null;
+    }
+
+
+    pub fn forgetTexture(self: *Self, texture: c.GLuint) void {
+        for (&self.textures, &self.texture_arrays) |*bound, *bound_array| {
+            if (bound.* == texture) bound.* = null;
+            if (bound_array.* == texture) bound_array.* = null;
+        }
+    }
+
+
+    pub fn forgetSampler(self: *Self, sampler: c.GLuint) void {
+        for (&self.samplers) |*bound| {
+            if (bound.* == sampler) bound.* = null;
+        }
+    }
+};
+
+
+/// GL names gathered while the batch is open on this thread, deleted with one glDelete* call per
+/// object type when it closes. Tearing down a level or the resource manager otherwise pays a GL call
+/// and an error check for every buffer, vertex array and texture of every resource
+/// Resources delete through the functions below, which go straight to GL while no batch is open.
+/// Callers still forget the names in GLStateCache at once, only the deletion waits
+pub const DeletionBatch = struct {
+    const Self = @This();
+
+    allocator: std.mem.Allocator,
+    vertex_arrays: std.ArrayListUnmanaged(c.GLuint) = .{},
+    buffers: std.ArrayListUnmanaged(c.GLuint) = .{},
+    textures: std.ArrayListUnmanaged(c.GLuint) = .{},
+    /// Programs have no plural delete, they only skip the error check per object
+    programs: std.ArrayListUnmanaged(c.GLuint) = .{},
+
+    threadlocal var open: ?*Self = null;
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator) Self {
+        return .{ .allocator = allocator };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Collect deletions made on this thread until end, batches don't nest
+    pub fn begin(self: *Self) void {
+        std.debug.assert(open == null);
+        open = self;
+    }
+
+
+    /// Stop collecting and delete everything gathered
+    pub fn end(self: *Self) void {
+        std.debug.assert(open == self);
+        open = null;
+        self.flush();
+    }
+
+
+    /// Delete the gathered names, the batch stays open if it was
+    pub fn flush(self: *Self) void {
+        const total = self.vertex_arrays.items.len + self.buffers.items.len + self.textures.items.len + self.programs.items.len;
+        if (total == 0) return;
+
+        if (self.vertex_arrays.items.len > 0) c.glDeleteVertexArrays(@intCast(self.vertex_arrays.items.len), self.vertex_arrays.items.ptr);
+        if (self.buffers.items.len > 0) c.glDeleteBuffers(@intCast(self.buffers.items.len), self.buffers.items.ptr);
+        if (self.textures.items.len > 0) c.glDeleteTextures(@intCast(self.textures.items.len), self.textures.items.ptr);
+        for (self.programs.items) |program| c.glDeleteProgram(program);
+        err.checkGLError("DeletionBatch.flush");
+
+        self.vertex_arrays.clearRetainingCapacity();
+        self.buffers.clearRetainingCapacity();
+        self.textures.clearRetainingCapacity();
+        self.programs.clearRetainingCapacity();
+    }
+
+
+    /// Delete `names` now, or when the batch open on this thread closes. Zero names are skipped
+    pub fn deleteVertexArrays(names: []const c.GLuint) void {
+        if (!deferInto(.vertex_arrays, names)) {
+            c.glDeleteVertexArrays(@intCast(names.len), names.ptr);
+            err.checkGLError("glDeleteVertexArrays");
+        }
+    }
+
+
+    pub fn deleteBuffers(names: []const c.GLuint) void {
+        if (!deferInto(.buffers, names)) {
+            c.glDeleteBuffers(@intCast(names.len), names.ptr);
+            err.checkGLError("glDeleteBuffers");
+        }
+    }
+
+
+    pub fn deleteTextures(names: []const c.GLuint) void {
+        if (!deferInto(.textures, names)) {
+            c.glDeleteTextures(@intCast(names.len), names.ptr);
+            err.checkGLError("glDeleteTextures");
+        }
+    }
+
+
+    pub fn deleteProgram(program: c.GLuint) void {
+        if (!deferInto(.programs, &.{program})) {
+            c.glDeleteProgram(program);
+            err.checkGLError("glDeleteProgram");
+        }
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Deletes what is still gathered
+    pub fn deinit(self: *Self) void {
+        if (open == self) open = null;
+        self.flush();
+        self.vertex_arrays.deinit(self.allocator);
+        self.buffers.deinit(self.allocator);
+        self.textures.deinit(self.allocator);
+        self.programs.deinit(self.allocator);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Append to the open batch, false when none is open or it can't grow and the caller deletes at once
+    fn deferInto(comptime field: std.meta.FieldEnum(Self), names: []const c.GLuint) bool {
+        const batch = open orelse return false;
+        const list = &@field(batch, @tagName(field));
+        list.ensureUnusedCapacity(batch.allocator, names.len) catch return false;
+        for (names) |name| {
+            if (name != 0) list.appendAssumeCapacity(name);
+        }
+        return true;
+    }
+};
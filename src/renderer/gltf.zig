@@ -0,0 +1,481 @@
+// graphics/gltf.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+
+const mesh_module = @import("mesh.zig");
+const Mesh = mesh_module.Mesh;
+const IndexType = mesh_module.IndexType;
+const Texture = @import("texture.zig").Texture;
+const image_decode = @import("image_decode.zig");
+const BoundingBox = @import("../math/bounds.zig").BoundingBox;
+
+
+pub const GltfError = error{
+    /// Not a binary glTF 2.0 file, or a chunk reaching past the end of it
+    InvalidGlb,
+    /// External buffers, non-triangle primitives or a component type this importer doesn't read
+    UnsupportedGltf,
+    /// An accessor reaching past its buffer view or of the wrong type for its attribute
+    InvalidAccessor,
+    ImageLoadFailed,
+};
+
+
+// glTF accessor component types
+const component_byte = 5120;
+const component_unsigned_byte = 5121;
+const component_short = 5122;
+const component_unsigned_short = 5123;
+const component_unsigned_int = 5125;
+const component_float = 5126;
+
+const mode_triangles = 4;
+
+
+/// The part of the glTF JSON the importer reads, everything else is skipped
+const Json = struct {
+    const BufferView = struct {
+        buffer: u32 = 0,
+        byteOffset: u64 = 0,
+        byteLength: u64,
+        byteStride: ?u32 = null,
+    };
+
+    const Accessor = struct {
+        bufferView: ?u32 = null,
+        byteOffset: u64 = 0,
+        componentType: u32,
+        normalized: bool = false,
+        count: u32,
+        type: []const u8,
+        min: ?[]const f32 = null,
+        max: ?[]const f32 = null,
+    };
+
+    const Attributes = struct {
+        POSITION: ?u32 = null,
+        NORMAL: ?u32 = null,
+        TEXCOORD_0: ?u32 = null,
+        COLOR_0: ?u32 = null,
+    };
+
+    const Primitive = struct {
+        attributes: Attributes,
+        indices: ?u32 = null,
+        material: ?u32 = null,
+        mode: u32 = mode_triangles,
+    };
+
+    const MeshEntry = struct {
+        primitives: []const Primitive,
+    };
+
+    const TextureInfo = struct {
+        index: u32,
+    };
+
+    const Pbr = struct {
+        baseColorFactor: [4]f32 = .{ 1, 1, 1, 1 },
+        baseColorTexture: ?TextureInfo = null,
+    };
+
+    const Material = struct {
+        pbrMetallicRoughness: Pbr = .{},
+    };
+
+    const TextureEntry = struct {
+        source: ?u32 = null,
+    };
+
+    const Image = struct {
+        bufferView: ?u32 = null,
+        uri: ?[]const u8 = null,
+    };
+
+    const Buffer = struct {
+        byteLength: u64,
+        uri: ?[]const u8 = null,
+    };
+
+    buffers: []const Buffer = &.{},
+    bufferViews: []const BufferView = &.{},
+    accessors: []const Accessor = &.{},
+    meshes: []const MeshEntry = &.{},
+    materials: []const Material = &.{},
+    textures: []const TextureEntry = &.{},
+    images: []const Image = &.{},
+};
+
+
+/// A binary glTF 2.0 file (.glb) held in memory while its meshes, materials and images are created
+/// Vertex attributes map onto the VertexLayout of their package size: position, then normal,
+/// texture coordinates or color. A primitive whose attributes already sit interleaved in one
+/// float buffer view with the layout's stride and offsets is uploaded straight from the file,
+/// others are gathered into one interleaved array. Node transforms are not applied, every mesh
+/// is imported in its own space, see ResourceManager.loadGltf
+pub const GltfDocument = struct {
+    const Self = @This();
+
+    const glb_magic = 0x46546C67; // "glTF"
+    const chunk_json = 0x4E4F534A;
+    const chunk_bin = 0x004E4942;
+
+    allocator: std.mem.Allocator,
+    /// The whole file, slices of it are uploaded directly
+    bytes: []align(4) u8,
+    bin: []const u8,
+    json: std.json.Parsed(Json),
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn open(allocator: std.mem.Allocator, path: []const u8) !*Self {
+        const bytes = try std.fs.cwd().readFileAllocOptions(allocator, path, std.math.maxInt(u32), null, 4, null);
+        errdefer allocator.free(bytes);
+
+        if (bytes.len < 20 or readU32(bytes, 0) != glb_magic or readU32(bytes, 4) != 2) return GltfError.InvalidGlb;
+
+        // JSON chunk first, the optional BIN chunk right after it
+        const json_length = readU32(bytes, 12);
+        if (readU32(bytes, 16) != chunk_json or 20 + @as(usize, json_length) > bytes.len) return GltfError.InvalidGlb;
+        const json_bytes = bytes[20..][0..json_length];
+
+        var bin: []const u8 = &.{};
+        const bin_header = std.mem.alignForward(usize, 20 + json_length, 4);
+        if (bin_header + 8 <= bytes.len and readU32(bytes, bin_header + 4) == chunk_bin) {
+            const bin_length = readU32(bytes, bin_header);
+            if (bin_header + 8 + @as(usize, bin_length) > bytes.len) return GltfError.InvalidGlb;
+            bin = bytes[bin_header + 8 ..][0..bin_length];
+        }
+
+        const json = try std.json.parseFromSlice(Json, allocator, json_bytes, .{ .ignore_unknown_fields = true });
+        errdefer json.deinit();
+        for (json.value.buffers, 0..) |buffer, i| {
+            // Only the GLB-stored buffer 0 is read, external files would need another read each
+            if (i > 0 or buffer.uri != null) return GltfError.UnsupportedGltf;
+        }
+
+        const self = try allocator.create(Self);
+        self.* = .{
+            .allocator = allocator,
+            .bytes = bytes,
+            .bin = bin,
+            .json = json,
+        };
+        return self;
+    }
+
+
+    /// Upload one primitive of one mesh, in the argument order ResourceCollection.createResource calls with
+    pub fn createMesh(allocator: std.mem.Allocator, self: *const Self, mesh_index: usize, primitive_index: usize) !*Mesh {
+        const primitive = self.json.value.meshes[mesh_index].primitives[primitive_index];
+        if (primitive.mode != mode_triangles) return GltfError.UnsupportedGltf;
+
+        const attributes = primitive.attributes;
+        const position = try self.accessor(attributes.POSITION orelse return GltfError.InvalidAccessor);
+        if (position.componentType != component_float or !std.mem.eql(u8, position.type, "VEC3")) return GltfError.InvalidAccessor;
+
+        // Color only has a layout of its own, next to normals or UVs it is dropped
+        var sources: [3]?u32 = .{ attributes.POSITION, null, null };
+        var package_size: u4 = 3;
+        if (attributes.NORMAL != null or attributes.TEXCOORD_0 != null) {
+            if (attributes.NORMAL) |normal| {
+                sources[1] = normal;
+                package_size += 3;
+            }
+            if (attributes.TEXCOORD_0) |tex_coord| {
+                sources[2] = tex_coord;
+                package_size += 2;
+            }
+        } else if (attributes.COLOR_0) |color| {
+            sources[1] = color;
+            package_size = 7;
+        }
+
+        const bounds = self.positionBounds(position);
+
+        if (try self.interleavedVertices(sources, package_size, position.count)) |vertex_bytes| {
+            if (primitive.indices) |index_accessor| {
+                if (try self.directIndices(index_accessor)) |direct| {
+                    return Mesh.createFromEncoded(allocator, vertex_bytes, direct.bytes, direct.index_type, package_size, .float, bounds);
+                }
+            }
+        }
+
+        // Gather path, one interleaved f32 array and u32 indices
+        const floats_per_vertex = mesh_module.getFloatsPerVertex(package_size);
+        const vertices = try allocator.alloc(f32, @as(usize, position.count) * floats_per_vertex);
+        defer allocator.free(vertices);
+
+        var offset: usize = 0;
+        for (sources, [_]usize{ 3, if (package_size == 7) 4 else 3, 2 }) |source, components| {
+            const index = source orelse continue;
+            try self.gather(index, components, vertices, offset, floats_per_vertex, position.count);
+            offset += components;
+        }
+
+        const indices = try self.readIndices(allocator, primitive.indices, position.count);
+        defer allocator.free(indices);
+        return Mesh.create(allocator, vertices, indices, package_size);
+    }
+
+
+    /// Decode the embedded image `image_index` into an RGBA texture, argument order as createMesh
+    /// glTF puts UV (0, 0) at the top left, so the rows are uploaded top first without the usual flip
+    pub fn createTexture(allocator: std.mem.Allocator, self: *const Self, image_index: usize) !*Texture {
+        const image = self.json.value.images[image_index];
+        const view_index = image.bufferView orelse return GltfError.UnsupportedGltf;
+        const encoded = try self.viewBytes(view_index);
+
+        c.stbi_set_flip_vertically_on_load(0);
+        const image = image_decode.decodeMemory(encoded, 4) catch |decode_err| {
+            std.debug.print("STBI loading failed for glTF image {d}: {s}\n", .{ image_index, image_decode.failureReason(decode_err) });
+            return GltfError.ImageLoadFailed;
+        };
+        return Texture.createRGBA(allocator, @intCast(image.width), @intCast(image.height), image.pixels.ptr);
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    pub fn meshCount(self: *const Self) usize {
+        return self.json.value.meshes.len;
+    }
+
+
+    pub fn primitiveCount(self: *const Self, mesh_index: usize) usize {
+        return self.json.value.meshes[mesh_index].primitives.len;
+    }
+
+
+    pub fn primitiveMaterial(self: *const Self, mesh_index: usize, primitive_index: usize) ?u32 {
+        return self.json.value.meshes[mesh_index].primitives[primitive_index].material;
+    }
+
+
+    pub fn materialCount(self: *const Self) usize {
+        return self.json.value.materials.len;
+    }
+
+
+    pub fn imageCount(self: *const Self) usize {
+        return self.json.value.images.len;
+    }
+
+
+    pub fn materialColor(self: *const Self, material_index: usize) [4]f32 {
+        return self.json.value.materials[material_index].pbrMetallicRoughness.baseColorFactor;
+    }
+
+
+    /// Image of the material's base color texture, if it has one
+    pub fn materialImage(self: *const Self, material_index: usize) ?u32 {
+        const info = self.json.value.materials[material_index].pbrMetallicRoughness.baseColorTexture orelse return null;
+        if (info.index >= self.json.value.textures.len) return null;
+        return self.json.value.textures[info.index].source;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn close(self: *Self) void {
+        self.json.deinit();
+        self.allocator.free(self.bytes);
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn readU32(bytes: []const u8, offset: usize) u32 {
+        return std.mem.readInt(u32, bytes[offset..][0..4], .little);
+    }
+
+
+    fn readF32(bytes: []const u8, offset: usize) f32 {
+        return @bitCast(readU32(bytes, offset));
+    }
+
+
+    fn accessor(self: *const Self, index: u32) !Json.Accessor {
+        if (index >= self.json.value.accessors.len) return GltfError.InvalidAccessor;
+        return self.json.value.accessors[index];
+    }
+
+
+    fn viewBytes(self: *const Self, index: u32) ![]const u8 {
+        if (index >= self.json.value.bufferViews.len) return GltfError.InvalidAccessor;
+        const view = self.json.value.bufferViews[index];
+        if (view.byteOffset + view.byteLength > self.bin.len) return GltfError.InvalidAccessor;
+        return self.bin[view.byteOffset..][0..view.byteLength];
+    }
+
+
+    fn componentSize(component_type: u32) !usize {
+        return switch (component_type) {
+            component_byte, component_unsigned_byte => 1,
+            component_short, component_unsigned_short => 2,
+            component_unsigned_int, component_float => 4,
+            else => GltfError.UnsupportedGltf,
+        };
+    }
+
+
+    fn componentCount(accessor_type: []const u8) !usize {
+        const counts = .{ .{ "SCALAR", 1 }, .{ "VEC2", 2 }, .{ "VEC3", 3 }, .{ "VEC4", 4 } };
+        inline for (counts) |entry| {
+            if (std.mem.eql(u8, accessor_type, entry[0])) return entry[1];
+        }
+        return GltfError.UnsupportedGltf;
+    }
+
+
+    /// POSITION min and max are required by the spec, computed only for files that skip them
+    fn positionBounds(self: *const Self, position: Json.Accessor) BoundingBox {
+        if (position.min) |min| {
+            if (position.max) |max| {
+                if (min.len == 3 and max.len == 3) {
+                    return .{ .min = .{ .x = min[0], .y = min[1], .z = min[2] }, .max = .{ .x = max[0], .y = max[1], .z = max[2] } };
+                }
+            }
+        }
+
+        var bounds = BoundingBox.empty;
+        const view = self.accessorView(position, 12) catch return bounds;
+        for (0..position.count) |v| {
+            const at = view.offset + v * view.stride;
+            bounds = bounds.include(.{ .x = readF32(view.bytes, at), .y = readF32(view.bytes, at + 4), .z = readF32(view.bytes, at + 8) });
+        }
+        return bounds;
+    }
+
+
+    const AccessorView = struct {
+        bytes: []const u8,
+        /// Of the first element inside `bytes`
+        offset: usize,
+        stride: usize,
+    };
+
+
+    fn accessorView(self: *const Self, source: Json.Accessor, element_size: usize) !AccessorView {
+        const view_index = source.bufferView orelse return GltfError.UnsupportedGltf;
+        const bytes = try self.viewBytes(view_index);
+        const stride: usize = self.json.value.bufferViews[view_index].byteStride orelse element_size;
+        if (source.count > 0 and source.byteOffset + (source.count - 1) * stride + element_size > bytes.len) return GltfError.InvalidAccessor;
+        return .{ .bytes = bytes, .offset = source.byteOffset, .stride = stride };
+    }
+
+
+    /// The vertex bytes as they are in the file, when every attribute is plain f32 at the layout's offset
+    fn interleavedVertices(self: *const Self, sources: [3]?u32, package_size: u4, count: u32) !?[]const u8 {
+        const layout = try mesh_module.getLayoutFromPackageSize(package_size);
+        const first = try self.accessor(sources[0].?);
+        const view_index = first.bufferView orelse return null;
+        if (self.json.value.bufferViews[view_index].byteStride != layout.stride) return null;
+
+        var attribute: usize = 0;
+        for (sources) |source| {
+            const index = source orelse continue;
+            const entry = try self.accessor(index);
+            if (entry.bufferView != view_index or entry.componentType != component_float or entry.count != count) return null;
+            const attribute_type = layout.descriptors[attribute].attribute_type;
+            if (try componentCount(entry.type) != mesh_module.VertexLayout.getAttributeSize(attribute_type)) return null;
+            if (entry.byteOffset != first.byteOffset + layout.getAttributeOffset(attribute)) return null;
+            attribute += 1;
+        }
+
+        const bytes = try self.viewBytes(view_index);
+        const length = @as(usize, count) * layout.stride;
+        if (first.byteOffset + length > bytes.len) return null;
+        return bytes[first.byteOffset..][0..length];
+    }
+
+
+    const DirectIndices = struct {
+        bytes: []const u8,
+        index_type: IndexType,
+    };
+
+
+    /// Tightly packed u16 or u32 indices, which the EBO takes as they are
+    fn directIndices(self: *const Self, index: u32) !?DirectIndices {
+        const entry = try self.accessor(index);
+        const index_type: IndexType = switch (entry.componentType) {
+            component_unsigned_short => .u16,
+            component_unsigned_int => .u32,
+            else => return null,
+        };
+        const view_index = entry.bufferView orelse return null;
+        if (self.json.value.bufferViews[view_index].byteStride != null) return null;
+
+        const bytes = try self.viewBytes(view_index);
+        const length = @as(usize, entry.count) * index_type.size();
+        if (entry.byteOffset + length > bytes.len) return GltfError.InvalidAccessor;
+        return .{ .bytes = bytes[entry.byteOffset..][0..length], .index_type = index_type };
+    }
+
+
+    /// Write `components` floats of accessor `index` for every vertex into the interleaved array
+    /// Normalized integer UVs and colors are converted, VEC3 colors get an alpha of 1
+    fn gather(self: *const Self, index: u32, components: usize, out: []f32, offset: usize, floats_per_vertex: usize, count: u32) !void {
+        const entry = try self.accessor(index);
+        if (entry.count != count) return GltfError.InvalidAccessor;
+
+        const source_components = try componentCount(entry.type);
+        // Only a four component color may come as VEC3
+        if (source_components != components and !(components == 4 and source_components == 3)) return GltfError.InvalidAccessor;
+        const size = try componentSize(entry.componentType);
+        const view = try self.accessorView(entry, size * source_components);
+
+        for (0..count) |v| {
+            const dst = out[v * floats_per_vertex + offset ..][0..components];
+            dst[components - 1] = 1.0;
+            for (0..source_components) |i| {
+                const at = view.offset + v * view.stride + i * size;
+                dst[i] = switch (entry.componentType) {
+                    component_float => readF32(view.bytes, at),
+                    component_unsigned_byte => @as(f32, @floatFromInt(view.bytes[at])) / 255.0,
+                    component_unsigned_short => @as(f32, @floatFromInt(std.mem.readInt(u16, view.bytes[at..][0..2], .little))) / 65535.0,
+                    else => return GltfError.UnsupportedGltf,
+                };
+            }
+        }
+    }
+
+
+    /// Indices as u32, a 0..count sequence for primitives without an index accessor
+    fn readIndices(self: *const Self, allocator: std.mem.Allocator, index: ?u32, vertex_count: u32) ![]u32 {
+        const accessor_index = index orelse {
+            const indices = try allocator.alloc(u32, vertex_count);
+            for (indices, 0..) |*out, i| out.* = @intCast(i);
+            return indices;
+        };
+
+        const entry = try self.accessor(accessor_index);
+        const size = try componentSize(entry.componentType);
+        const view = try self.accessorView(entry, size);
+
+        const indices = try allocator.alloc(u32, entry.count);
+        errdefer allocator.free(indices);
+        for (indices, 0..) |*out, i| {
+            const at = view.offset + i * view.stride;
+            out.* = switch (entry.componentType) {
+                component_unsigned_byte => view.bytes[at],
+                component_unsigned_short => std.mem.readInt(u16, view.bytes[at..][0..2], .little),
+                component_unsigned_int => readU32(view.bytes, at),
+                else => return GltfError.UnsupportedGltf,
+            };
+            if (out.* >= vertex_count) return GltfError.InvalidAccessor;
+        }
+        return indices;
+    }
+};
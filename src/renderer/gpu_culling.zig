@@ -0,0 +1,508 @@
+// graphics/gpu_culling.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+
+const Mesh = @import("mesh.zig").Mesh;
+const meshlet_module = @import("meshlet.zig");
+const Meshlet = meshlet_module.Meshlet;
+const Material = @import("material.zig").Material;
+const MaterialTable = @import("material_table.zig").MaterialTable;
+const Shader = @import("shader.zig").Shader;
+const render_queue = @import("render_queue.zig");
+const RenderQueue = render_queue.RenderQueue;
+const DrawItem = render_queue.DrawItem;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const render_stats = @import("render_stats.zig");
+const HiZBuffer = @import("hiz_buffer.zig").HiZBuffer;
+const vertex_puller = @import("vertex_puller.zig");
+const VertexPuller = vertex_puller.VertexPuller;
+const PulledDraw = vertex_puller.PulledDraw;
+
+const Frustum = @import("../math/bounds.zig").Frustum;
+const Mat4f = @import("../math/matrix.zig").Mat4f;
+const Affine3x4 = @import("../math/affine.zig").Affine3x4;
+const Vec3f = @import("../math/vector.zig").Vec3f;
+
+
+pub const GpuCullingError = error{
+    /// The driver lacks compute shaders, storage buffers or multi-draw indirect
+    Unsupported,
+    /// Every material needs a shader with the instanced path, culled matrices arrive as instance attributes
+    ShaderNotInstanced,
+    /// buildWithMaterials got an item whose material the table doesn't hold
+    MaterialNotInTable,
+};
+
+
+/// Record layout read by glMultiDrawElementsIndirect
+pub const DrawElementsIndirectCommand = extern struct {
+    count: u32,
+    instance_count: u32,
+    first_index: u32,
+    base_vertex: i32,
+    base_instance: u32,
+};
+
+
+/// std430 layout of one entry of the culling shader's Instances buffer
+const GpuInstance = extern struct {
+    /// Rows of the affine world matrix
+    world: [12]f32,
+    box_min: [3]f32,
+    /// Command the instance is drawn by
+    command: u32,
+    box_max: [3]f32,
+    /// Index into the MaterialTable, 0 without one
+    material: u32 = 0,
+    /// Normal cone axis and cutoff, Meshlet.cone_cutoff
+    cone: [4]f32,
+};
+
+
+/// Outcome of one cull, counted by the culling shader
+pub const CullStats = extern struct {
+    frustum_culled: u32 = 0,
+    occlusion_culled: u32 = 0,
+    visible: u32 = 0,
+    /// Meshlets facing away from the camera as a whole
+    backface_culled: u32 = 0,
+};
+
+
+/// Consecutive commands drawn with one glMultiDrawElementsIndirect call
+const Batch = struct {
+    mesh: *Mesh,
+    material: *Material,
+    first_command: u32,
+    command_count: u32,
+};
+
+
+/// Frustum culling of a static scene on the GPU
+/// A compute shader tests every instance's bounds, appends the visible world matrices to a buffer
+/// the vertex shaders read as instance attributes, and counts them into indirect draw commands
+/// Renderer.drawCulled then submits one glMultiDrawElementsIndirect per VAO-material batch
+/// Meshes with meshlets get one command per meshlet, which is also rejected when it faces away
+/// Built with a MaterialTable, batches only break on VAO changes and every instance carries its material index
+/// Built with a VertexPuller, the whole scene is one batch drawn by one multi-draw whatever the layouts
+pub const GpuCuller = struct {
+    const Self = @This();
+
+    const workgroup_size = 64;
+
+    /// Storage buffer bindings used by the culling shader
+    const instances_binding = 0;
+    const commands_binding = 1;
+    const visible_binding = 2;
+    const stats_binding = 3;
+    const visible_materials_binding = 5;
+
+    /// Texture unit the culling shader samples the Hi-Z pyramid from
+    const hiz_unit = 0;
+
+    const cull_source =
+        \\#version 430 core
+        \\layout(local_size_x = 64) in;
+        \\struct Instance { vec4 world[3]; vec4 boxMin; vec4 boxMax; vec4 cone; };
+        \\struct DrawCommand { uint count; uint instanceCount; uint firstIndex; int baseVertex; uint baseInstance; };
+        \\layout(std430, binding = 0) readonly buffer Instances { Instance instances[]; };
+        \\layout(std430, binding = 1) buffer Commands { DrawCommand commands[]; };
+        \\layout(std430, binding = 2) writeonly buffer Visible { vec4 visibleRows[]; };
+        \\layout(std430, binding = 3) buffer Stats { uint frustumCulled; uint occlusionCulled; uint visibleCount; uint backfaceCulled; };
+        \\layout(std430, binding = 5) writeonly buffer VisibleMaterials { uint visibleMaterials[]; };
+        \\uniform vec4 planes[6];
+        \\uniform uint instanceTotal;
+        \\uniform bool occlusion;
+        \\uniform mat4 cullViewProjection;
+        \\uniform vec3 viewPosition;
+        \\uniform bool coneCulling;
+        \\uniform sampler2D hiz;
+        \\uniform int hizLevels;
+        \\bool occluded(vec3 center, vec3 extent) {
+        \\    vec2 rectMin = vec2(1.0);
+        \\    vec2 rectMax = vec2(0.0);
+        \\    float nearest = 1.0;
+        \\    for (int i = 0; i < 8; ++i) {
+        \\        vec3 corner = center + extent * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        \\        vec4 clip = cullViewProjection * vec4(corner, 1.0);
+        \\        if (clip.w <= 0.0) return false;
+        \\        vec3 ndc = clip.xyz / clip.w;
+        \\        rectMin = min(rectMin, ndc.xy * 0.5 + 0.5);
+        \\        rectMax = max(rectMax, ndc.xy * 0.5 + 0.5);
+        \\        nearest = min(nearest, ndc.z * 0.5 + 0.5);
+        \\    }
+        \\    rectMin = clamp(rectMin, 0.0, 1.0);
+        \\    rectMax = clamp(rectMax, 0.0, 1.0);
+        \\    vec2 span = (rectMax - rectMin) * vec2(textureSize(hiz, 0));
+        \\    int level = clamp(int(ceil(log2(max(max(span.x, span.y), 1.0)))), 0, hizLevels - 1);
+        \\    ivec2 size = textureSize(hiz, level);
+        \\    ivec2 lo = min(ivec2(rectMin * vec2(size)), size - 1);
+        \\    ivec2 hi = min(ivec2(rectMax * vec2(size)), size - 1);
+        \\    float farthest = max(max(texelFetch(hiz, lo, level).r, texelFetch(hiz, ivec2(hi.x, lo.y), level).r),
+        \\                         max(texelFetch(hiz, ivec2(lo.x, hi.y), level).r, texelFetch(hiz, hi, level).r));
+        \\    return nearest > farthest;
+        \\}
+        \\void main() {
+        \\    uint id = gl_GlobalInvocationID.x;
+        \\    if (id >= instanceTotal) return;
+        \\    Instance inst = instances[id];
+        \\    mat4 world = mat4(transpose(mat3x4(inst.world[0], inst.world[1], inst.world[2])));
+        \\    vec3 center = (world * vec4((inst.boxMin.xyz + inst.boxMax.xyz) * 0.5, 1.0)).xyz;
+        \\    mat3 spread = mat3(abs(world[0].xyz), abs(world[1].xyz), abs(world[2].xyz));
+        \\    vec3 extent = spread * ((inst.boxMax.xyz - inst.boxMin.xyz) * 0.5);
+        \\    for (int i = 0; i < 6; ++i) {
+        \\        if (dot(planes[i].xyz, center) + planes[i].w + dot(abs(planes[i].xyz), extent) < 0.0) {
+        \\            atomicAdd(frustumCulled, 1u);
+        \\            return;
+        \\        }
+        \\    }
+        \\    if (coneCulling && inst.cone.w <= 1.0) {
+        \\        vec3 axis = normalize(mat3(world) * inst.cone.xyz);
+        \\        vec3 view = center - viewPosition;
+        \\        if (dot(view, axis) >= inst.cone.w * length(view) + length(extent)) {
+        \\            atomicAdd(backfaceCulled, 1u);
+        \\            return;
+        \\        }
+        \\    }
+        \\    if (occlusion && occluded(center, extent)) {
+        \\        atomicAdd(occlusionCulled, 1u);
+        \\        return;
+        \\    }
+        \\    atomicAdd(visibleCount, 1u);
+        \\    uint command = floatBitsToUint(inst.boxMin.w);
+        \\    uint slot = atomicAdd(commands[command].instanceCount, 1u);
+        \\    uint visible = (commands[command].baseInstance + slot) * 3u;
+        \\    visibleRows[visible] = inst.world[0];
+        \\    visibleRows[visible + 1u] = inst.world[1];
+        \\    visibleRows[visible + 2u] = inst.world[2];
+        \\    visibleMaterials[commands[command].baseInstance + slot] = floatBitsToUint(inst.boxMax.w);
+        \\}
+    ;
+
+    allocator: std.mem.Allocator,
+
+    program: c.GLuint,
+    planes_location: c.GLint,
+    total_location: c.GLint,
+    occlusion_location: c.GLint,
+    view_projection_location: c.GLint,
+    levels_location: c.GLint,
+    view_position_location: c.GLint,
+    cone_location: c.GLint,
+
+    instance_buffer: c.GLuint,
+    /// Indirect commands, written by the culling shader and read as GL_DRAW_INDIRECT_BUFFER
+    command_buffer: c.GLuint,
+    /// Culled world matrices, bound as the instance attribute source
+    visible_buffer: c.GLuint,
+    /// CullStats of the last cull, read back lazily by the next one
+    stats_buffer: c.GLuint,
+    /// Material index of every culled matrix, bound as an integer instance attribute
+    visible_material_buffer: c.GLuint,
+    /// Table the last build indexed materials with, null when drawn per material
+    material_table: ?*MaterialTable = null,
+    /// Puller the last build was made for, null when drawn through the mesh VAOs
+    puller: ?*VertexPuller = null,
+
+    /// Commands with zero instances, uploaded before every cull to reset the counts
+    commands: std.ArrayList(DrawElementsIndirectCommand),
+    batches: std.ArrayList(Batch),
+    instance_count: u32 = 0,
+    /// Counts of the previous cull, one frame behind so reading them never waits on the current one
+    stats: CullStats = .{},
+    /// A cull has been dispatched since the last build, so stats_buffer holds counts
+    stats_pending: bool = false,
+    /// Reject meshlets facing away from the camera, turn off when back faces are drawn
+    /// The test assumes uniformly scaled instances
+    cone_culling: bool = true,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator) !Self {
+        if (!isSupported()) return GpuCullingError.Unsupported;
+
+        const program = try Shader.createComputeProgram(cull_source);
+        errdefer c.glDeleteProgram(program);
+
+        var buffers: [5]c.GLuint = undefined;
+        c.glGenBuffers(buffers.len, &buffers);
+        err.checkGLError("glGenBuffers for GpuCuller");
+
+        uploadStorage(buffers[3], @sizeOf(CullStats), null, c.GL_DYNAMIC_READ);
+
+        GLStateCache.current().useProgram(program);
+        c.glUniform1i(c.glGetUniformLocation(program, "hiz"), hiz_unit);
+
+        return .{
+            .allocator = allocator,
+            .program = program,
+            .planes_location = c.glGetUniformLocation(program, "planes"),
+            .total_location = c.glGetUniformLocation(program, "instanceTotal"),
+            .occlusion_location = c.glGetUniformLocation(program, "occlusion"),
+            .view_projection_location = c.glGetUniformLocation(program, "cullViewProjection"),
+            .levels_location = c.glGetUniformLocation(program, "hizLevels"),
+            .view_position_location = c.glGetUniformLocation(program, "viewPosition"),
+            .cone_location = c.glGetUniformLocation(program, "coneCulling"),
+            .instance_buffer = buffers[0],
+            .command_buffer = buffers[1],
+            .visible_buffer = buffers[2],
+            .stats_buffer = buffers[3],
+            .visible_material_buffer = buffers[4],
+            .commands = std.ArrayList(DrawElementsIndirectCommand).init(allocator),
+            .batches = std.ArrayList(Batch).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    pub fn isSupported() bool {
+        return gl_ext.hasGpuCulling();
+    }
+
+
+    /// Upload a scene once, every queued item becomes one indirect command, or one per meshlet
+    /// Items sharing mesh and material end up adjacent after sorting and share one multi-draw
+    pub fn build(self: *Self, queue: *RenderQueue) !void {
+        try queue.sort();
+        self.material_table = null;
+        self.puller = null;
+        try self.buildCommands(queue);
+    }
+
+
+    /// Like build, with every material drawn through `table`, items are grouped by VAO alone
+    /// The table must hold every queued material and outlive the builds using it
+    pub fn buildWithMaterials(self: *Self, queue: *RenderQueue, table: *MaterialTable) !void {
+        try queue.sort();
+        // Stable, so the items of one VAO keep their material order
+        std.sort.block(DrawItem, queue.items.items, {}, vaoLessThan);
+        self.material_table = table;
+        self.puller = null;
+        try self.buildCommands(queue);
+    }
+
+
+    /// Like buildWithMaterials with vertices fetched by `puller`, every item must be a mesh of its GeometryPool
+    /// and its material in its table. The commands are drawn as arrays, so they don't depend on a bound EBO
+    pub fn buildPulled(self: *Self, queue: *RenderQueue, puller: *VertexPuller) !void {
+        try queue.sort();
+        self.material_table = puller.table;
+        self.puller = puller;
+        try self.buildCommands(queue);
+    }
+
+
+    /// Cull every instance against `frustum`, the commands are ready once the next draw reads them
+    /// `view_position` is the camera position the meshlet cone test looks from
+    pub fn cull(self: *Self, frustum: *const Frustum, view_position: Vec3f) void {
+        if (self.instance_count == 0) return;
+
+        self.begin(frustum, view_position);
+        c.glUniform1i(self.occlusion_location, 0);
+        self.dispatch();
+    }
+
+
+    /// Like cull, then also reject instances hidden behind the occluders in `hiz`
+    /// `view_projection` has to be the matrix the occluders were drawn with
+    pub fn cullOccluded(self: *Self, frustum: *const Frustum, view_position: Vec3f, view_projection: *const Mat4f, hiz: *const HiZBuffer) void {
+        if (self.instance_count == 0) return;
+
+        self.begin(frustum, view_position);
+        c.glUniform1i(self.occlusion_location, 1);
+        c.glUniformMatrix4fv(self.view_projection_location, 1, c.GL_FALSE, &view_projection.data);
+        c.glUniform1i(self.levels_location, @intCast(hiz.levels));
+        GLStateCache.current().bindTexture2D(hiz_unit, hiz.pyramid);
+        // The pyramid is read with its own nearest filtering, not a material's sampler
+        GLStateCache.current().bindSampler(hiz_unit, 0);
+        self.dispatch();
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        const state = GLStateCache.current();
+        state.forgetProgram(self.program);
+        state.forgetBuffer(self.visible_buffer);
+        state.forgetBuffer(self.visible_material_buffer);
+
+        c.glDeleteProgram(self.program);
+        const buffers = [_]c.GLuint{ self.instance_buffer, self.command_buffer, self.visible_buffer, self.stats_buffer, self.visible_material_buffer };
+        c.glDeleteBuffers(buffers.len, &buffers);
+        err.checkGLError("GpuCuller cleanup");
+
+        self.commands.deinit();
+        self.batches.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Commands, instances and batches of the sorted `queue`, material indices from material_table if set
+    fn buildCommands(self: *Self, queue: *RenderQueue) !void {
+        self.commands.clearRetainingCapacity();
+        self.batches.clearRetainingCapacity();
+
+        // Pairs of one model share their matrices in the queue, but each command culls and counts
+        // its own copy, so every command gets a private range of instances and visible slots
+        var instances = std.ArrayList(GpuInstance).init(self.allocator);
+        defer instances.deinit();
+        var draws = std.ArrayList(PulledDraw).init(self.allocator);
+        defer draws.deinit();
+
+        for (queue.items.items) |item| {
+            // The table's shader replaces the material shaders
+            var material_index: u32 = 0;
+            if (self.material_table) |table| {
+                material_index = table.indexOf(item.material) orelse return GpuCullingError.MaterialNotInTable;
+            } else if (!item.material.shader.has(.instanced)) {
+                return GpuCullingError.ShaderNotInstanced;
+            }
+            const section = if (self.puller) |puller| try puller.sectionOf(item.mesh) else 0;
+
+            // Meshes without meshlets are culled as one range that never fails the cone test
+            const whole = [1]Meshlet{.{
+                .first_index = 0,
+                .index_count = @intCast(item.mesh.index_count),
+                .bounds = item.mesh.bounds,
+                .cone_axis = .{ .x = 0, .y = 0, .z = 0 },
+                .cone_cutoff = meshlet_module.no_cone_cutoff,
+            }};
+            const ranges: []const Meshlet = if (item.mesh.meshlets.len > 0) item.mesh.meshlets else &whole;
+
+            for (ranges) |range| {
+                const command: u32 = @intCast(self.commands.items.len);
+                const base_instance: u32 = @intCast(instances.items.len);
+                try self.commands.append(.{
+                    .count = range.index_count,
+                    .instance_count = 0,
+                    .first_index = item.mesh.first_index + range.first_index,
+                    // Array draws read the first four fields, their base instance sits where base_vertex is
+                    .base_vertex = if (self.puller != null) @intCast(base_instance) else @intCast(item.mesh.base_vertex),
+                    .base_instance = base_instance,
+                });
+                if (self.puller != null) {
+                    try draws.append(.{
+                        .section = section,
+                        .base_vertex = @intCast(item.mesh.base_vertex),
+                        .material = material_index,
+                    });
+                }
+
+                const bounds = range.bounds;
+                const axis = range.cone_axis;
+                // TRS items are expanded here, the culled buffer only holds matrices
+                try instances.ensureUnusedCapacity(item.instance_count);
+                for (0..item.instance_count) |index| {
+                    const matrix = queue.instanceMatrix(item, index);
+                    instances.appendAssumeCapacity(.{
+                        .world = matrix.data,
+                        .box_min = .{ bounds.min.x, bounds.min.y, bounds.min.z },
+                        .command = command,
+                        .box_max = .{ bounds.max.x, bounds.max.y, bounds.max.z },
+                        // Pulled draws find the material through their command
+                        .material = if (self.puller != null) command else material_index,
+                        .cone = .{ axis.x, axis.y, axis.z, range.cone_cutoff },
+                    });
+                }
+
+                if (self.batches.items.len > 0) {
+                    const last = &self.batches.items[self.batches.items.len - 1];
+                    // Meshes of one GeometryPool section share their VAO and draw in the same multi-draw
+                    const same_material = self.material_table != null or last.material == item.material;
+                    if ((self.puller != null or last.mesh.vao == item.mesh.vao) and same_material) {
+                        last.command_count += 1;
+                        continue;
+                    }
+                }
+                try self.batches.append(.{
+                    .mesh = item.mesh,
+                    .material = item.material,
+                    .first_command = command,
+                    .command_count = 1,
+                });
+            }
+        }
+
+        self.instance_count = @intCast(instances.items.len);
+        self.stats = .{};
+        self.stats_pending = false;
+
+        uploadStorage(self.instance_buffer, instances.items.len * @sizeOf(GpuInstance), instances.items.ptr, c.GL_STATIC_DRAW);
+        uploadStorage(self.command_buffer, self.commands.items.len * @sizeOf(DrawElementsIndirectCommand), self.commands.items.ptr, c.GL_DYNAMIC_DRAW);
+        // Written by the culling shader only
+        uploadStorage(self.visible_buffer, instances.items.len * @sizeOf(Affine3x4), null, c.GL_DYNAMIC_COPY);
+        uploadStorage(self.visible_material_buffer, instances.items.len * @sizeOf(u32), null, c.GL_DYNAMIC_COPY);
+        if (self.puller) |puller| puller.uploadDraws(draws.items);
+    }
+
+
+    fn vaoLessThan(_: void, a: DrawItem, b: DrawItem) bool {
+        return a.mesh.vao < b.mesh.vao;
+    }
+
+
+    /// Collect the previous counts, reset commands and counters and set the frustum and cone uniforms
+    fn begin(self: *Self, frustum: *const Frustum, view_position: Vec3f) void {
+        // Reading the previous cull's counts waits at most for last frame's dispatch
+        c.glBindBuffer(gl_ext.GL_SHADER_STORAGE_BUFFER, self.stats_buffer);
+        if (self.stats_pending) {
+            c.glGetBufferSubData(gl_ext.GL_SHADER_STORAGE_BUFFER, 0, @sizeOf(CullStats), &self.stats);
+        }
+        const zero = CullStats{};
+        c.glBufferSubData(gl_ext.GL_SHADER_STORAGE_BUFFER, 0, @sizeOf(CullStats), &zero);
+
+        // Reset the instance counts of the previous cull
+        c.glBindBuffer(gl_ext.GL_SHADER_STORAGE_BUFFER, self.command_buffer);
+        const command_bytes = std.mem.sliceAsBytes(self.commands.items);
+        c.glBufferSubData(gl_ext.GL_SHADER_STORAGE_BUFFER, 0, @intCast(command_bytes.len), command_bytes.ptr);
+        render_stats.countUpload(@sizeOf(CullStats) + command_bytes.len);
+
+        var planes: [6][4]f32 = undefined;
+        for (&planes, 0..) |*plane, i| plane.* = frustum.plane(i);
+
+        GLStateCache.current().useProgram(self.program);
+        c.glUniform4fv(self.planes_location, planes.len, &planes[0]);
+        c.glUniform1ui(self.total_location, self.instance_count);
+        c.glUniform3f(self.view_position_location, view_position.x, view_position.y, view_position.z);
+        c.glUniform1i(self.cone_location, @intFromBool(self.cone_culling));
+    }
+
+
+    fn dispatch(self: *Self) void {
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, instances_binding, self.instance_buffer);
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, commands_binding, self.command_buffer);
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, visible_binding, self.visible_buffer);
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, stats_binding, self.stats_buffer);
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, visible_materials_binding, self.visible_material_buffer);
+
+        const groups = std.math.divCeil(u32, self.instance_count, workgroup_size) catch unreachable;
+        gl_ext.dispatchCompute.?(groups, 1, 1);
+
+        // Draws read the commands as indirect parameters and the matrices as vertex attributes,
+        // the next cull reads the counters back
+        gl_ext.memoryBarrier.?(gl_ext.GL_COMMAND_BARRIER_BIT | gl_ext.GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | gl_ext.GL_BUFFER_UPDATE_BARRIER_BIT);
+        err.checkGLError("GpuCuller.dispatch");
+        self.stats_pending = true;
+    }
+
+
+    fn uploadStorage(buffer: c.GLuint, size: usize, data: ?*const anyopaque, usage: c.GLenum) void {
+        c.glBindBuffer(gl_ext.GL_SHADER_STORAGE_BUFFER, buffer);
+        c.glBufferData(gl_ext.GL_SHADER_STORAGE_BUFFER, @intCast(size), data, usage);
+        err.checkGLError("GpuCuller: glBufferData");
+    }
+};
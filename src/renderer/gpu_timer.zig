@@ -0,0 +1,202 @@
+// graphics/gpu_timer.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const profiler = @import("../core/profiler.zig");
+const monotonicNs = @import("../core/time.zig").monotonicNs;
+
+
+/// GPU time one scope took in a resolved frame
+pub const GpuTiming = struct {
+    name: [:0]const u8,
+    /// Nesting depth, 0 for scopes opened outside any other
+    depth: u8,
+    duration_ns: u64,
+};
+
+
+/// Named GPU timing scopes from GL_TIMESTAMP queries
+/// Every scope writes a timestamp when it begins and ends. The queries of a frame are read back
+/// `frames_in_flight - 1` frames later, by which point the GPU has long finished them, so reading
+/// never stalls. A frame whose results still aren't there when its queries come up for reuse is dropped
+pub const GpuTimer = struct {
+    const Self = @This();
+
+    pub const frames_in_flight = 4;
+    /// Scopes recorded per frame, later ones in the same frame are ignored
+    pub const max_scopes = 32;
+    const max_depth = 16;
+    /// Open scope that ran past max_scopes, its end writes nothing
+    const dropped_scope = std.math.maxInt(u8);
+
+    const Frame = struct {
+        /// Begin and end timestamp of each scope
+        queries: [max_scopes * 2]c.GLuint = undefined,
+        names: [max_scopes][:0]const u8 = undefined,
+        depths: [max_scopes]u8 = undefined,
+        count: usize = 0,
+        /// Query written last, the frame is done once it is available
+        last_query: c.GLuint = 0,
+    };
+
+    frames: [frames_in_flight]Frame = [_]Frame{.{}} ** frames_in_flight,
+    /// Frame the scopes are recorded into
+    current: usize = 0,
+    /// Scope indices of the open scopes, innermost last
+    open: [max_depth]u8 = undefined,
+    open_count: usize = 0,
+    /// Scopes nested deeper than max_depth, they record nothing
+    overflow_depth: usize = 0,
+
+    /// Scopes of the latest resolved frame
+    results: [max_scopes]GpuTiming = undefined,
+    result_count: usize = 0,
+    /// Frames whose results weren't available in time
+    dropped_frames: u64 = 0,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init() Self {
+        var self = Self{};
+        for (&self.frames) |*frame| {
+            c.glGenQueries(frame.queries.len, &frame.queries);
+        }
+        err.checkGLError("GpuTimer: glGenQueries");
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Open a scope, `name` must stay valid until the frame is resolved
+    pub fn begin(self: *Self, name: [:0]const u8) void {
+        if (self.open_count == max_depth) {
+            self.overflow_depth += 1;
+            return;
+        }
+
+        const frame = &self.frames[self.current];
+        if (frame.count == max_scopes) {
+            self.open[self.open_count] = dropped_scope;
+            self.open_count += 1;
+            return;
+        }
+
+        const index = frame.count;
+        frame.names[index] = name;
+        frame.depths[index] = @intCast(self.open_count);
+        frame.count += 1;
+        frame.last_query = frame.queries[index * 2];
+        c.glQueryCounter(frame.last_query, c.GL_TIMESTAMP);
+        err.checkGLError("GpuTimer.begin: glQueryCounter");
+
+        self.open[self.open_count] = @intCast(index);
+        self.open_count += 1;
+    }
+
+
+    /// Close the innermost open scope
+    pub fn end(self: *Self) void {
+        if (self.overflow_depth > 0) {
+            self.overflow_depth -= 1;
+            return;
+        }
+        if (self.open_count == 0) return;
+        self.open_count -= 1;
+
+        const index = self.open[self.open_count];
+        if (index == dropped_scope) return;
+        const frame = &self.frames[self.current];
+        frame.last_query = frame.queries[@as(usize, index) * 2 + 1];
+        c.glQueryCounter(frame.last_query, c.GL_TIMESTAMP);
+        err.checkGLError("GpuTimer.end: glQueryCounter");
+    }
+
+
+    /// Close the frame and resolve the oldest one, its scopes become timings() and, when the
+    /// profiler is enabled, slices on its GPU track. Scopes still open are closed first
+    pub fn endFrame(self: *Self) void {
+        self.overflow_depth = 0;
+        while (self.open_count > 0) self.end();
+
+        self.current = (self.current + 1) % frames_in_flight;
+        self.resolve(&self.frames[self.current]);
+    }
+
+
+    /// Scopes of the latest resolved frame, `frames_in_flight - 1` frames behind
+    pub fn timings(self: *const Self) []const GpuTiming {
+        return self.results[0..self.result_count];
+    }
+
+
+    /// Summed duration of the outermost scopes of the latest resolved frame
+    pub fn frameTime(self: *const Self) u64 {
+        var total: u64 = 0;
+        for (self.timings()) |timing| {
+            if (timing.depth == 0) total += timing.duration_ns;
+        }
+        return total;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        for (&self.frames) |*frame| {
+            c.glDeleteQueries(frame.queries.len, &frame.queries);
+        }
+        err.checkGLError("GpuTimer: glDeleteQueries");
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Read back `frame` and empty it for reuse
+    fn resolve(self: *Self, frame: *Frame) void {
+        defer frame.count = 0;
+        if (frame.count == 0) return;
+
+        // Timestamps complete in order, once the last one is there all of them are
+        var available: c.GLint = 0;
+        c.glGetQueryObjectiv(frame.last_query, c.GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == 0) {
+            self.dropped_frames += 1;
+            return;
+        }
+
+        // GPU and CPU clocks differ, shift the timestamps onto the profiler's clock
+        var gpu_now: c.GLint64 = 0;
+        if (profiler.enabled) c.glGetInteger64v(c.GL_TIMESTAMP, &gpu_now);
+        const cpu_now: i128 = monotonicNs();
+
+        for (0..frame.count) |i| {
+            var start: c.GLuint64 = 0;
+            var end_time: c.GLuint64 = 0;
+            c.glGetQueryObjectui64v(frame.queries[i * 2], c.GL_QUERY_RESULT, &start);
+            c.glGetQueryObjectui64v(frame.queries[i * 2 + 1], c.GL_QUERY_RESULT, &end_time);
+
+            self.results[i] = .{ .name = frame.names[i], .depth = frame.depths[i], .duration_ns = end_time -| start };
+            if (profiler.enabled) {
+                const offset = cpu_now - gpu_now;
+                profiler.recordGpuZone(frame.names[i].ptr, clampTime(@as(i128, start) + offset), clampTime(@as(i128, end_time) + offset));
+            }
+        }
+        self.result_count = frame.count;
+        err.checkGLError("GpuTimer: glGetQueryObjectui64v");
+    }
+
+
+    fn clampTime(ns: i128) u64 {
+        return @intCast(std.math.clamp(ns, 0, std.math.maxInt(u64)));
+    }
+};
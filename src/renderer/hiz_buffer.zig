@@ -0,0 +1,268 @@
+// graphics/hiz_buffer.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const Shader = @import("shader.zig").Shader;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+
+
+pub const HiZError = error{
+    /// The depth or pyramid framebuffer is incomplete
+    IncompleteFramebuffer,
+};
+
+
+/// Hierarchical depth buffer for occlusion culling
+/// Occluders are drawn into a low-resolution depth target, then every mip level of the pyramid stores
+/// the farthest depth of the 2x2 texels below it, so one fetch bounds the depth of a whole screen region
+/// A box whose nearest depth lies behind the farthest depth of the pyramid texels it covers is hidden
+pub const HiZBuffer = struct {
+    const Self = @This();
+
+    pub const max_levels = 16;
+
+    /// Fullscreen triangle reducing the level below into the bound one
+    /// Level 0 copies the occluder depth, odd sizes fold their last row and column into the last texel
+    const reduce_vertex =
+        \\#version 330 core
+        \\void main() {
+        \\    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        \\    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+        \\}
+    ;
+    const reduce_fragment =
+        \\#version 330 core
+        \\uniform sampler2D source;
+        \\uniform bool copyLevel;
+        \\out float depth;
+        \\void main() {
+        \\    ivec2 dst = ivec2(gl_FragCoord.xy);
+        \\    if (copyLevel) { depth = texelFetch(source, dst, 0).r; return; }
+        \\    ivec2 size = textureSize(source, 0);
+        \\    ivec2 last = size - 1;
+        \\    ivec2 src = dst * 2;
+        \\    int right = min(src.x + 1, last.x);
+        \\    int top = min(src.y + 1, last.y);
+        \\    float d = max(max(texelFetch(source, src, 0).r, texelFetch(source, ivec2(right, src.y), 0).r),
+        \\                  max(texelFetch(source, ivec2(src.x, top), 0).r, texelFetch(source, ivec2(right, top), 0).r));
+        \\    bool extraX = (size.x & 1) == 1 && src.x + 2 == last.x;
+        \\    bool extraY = (size.y & 1) == 1 && src.y + 2 == last.y;
+        \\    if (extraX) d = max(d, max(texelFetch(source, ivec2(last.x, src.y), 0).r, texelFetch(source, ivec2(last.x, top), 0).r));
+        \\    if (extraY) d = max(d, max(texelFetch(source, ivec2(src.x, last.y), 0).r, texelFetch(source, ivec2(right, last.y), 0).r));
+        \\    if (extraX && extraY) d = max(d, texelFetch(source, last, 0).r);
+        \\    depth = d;
+        \\}
+    ;
+
+    width: u32,
+    height: u32,
+    levels: u32,
+
+    /// DEPTH_COMPONENT32F target of the occluder pass
+    depth_texture: c.GLuint,
+    depth_fbo: c.GLuint,
+    /// R32F with a full mip chain, one framebuffer per level
+    pyramid: c.GLuint,
+    level_fbos: [max_levels]c.GLuint = .{0} ** max_levels,
+
+    program: c.GLuint,
+    copy_location: c.GLint,
+    /// Attribute-less VAO for the fullscreen triangle
+    vao: c.GLuint,
+
+    /// Viewport in use before beginOccluders
+    saved_viewport: ?[4]c.GLint = null,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Pyramid of `width` x `height` at level 0, a fraction of the window size is plenty
+    pub fn init(width: u32, height: u32) !Self {
+        const program = try Shader.createProgram(reduce_vertex, reduce_fragment);
+
+        const levels: u32 = @min(@as(u32, std.math.log2_int(u32, @max(@max(width, height), 1))) + 1, max_levels);
+
+        var self = Self{
+            .width = @max(width, 1),
+            .height = @max(height, 1),
+            .levels = levels,
+            .depth_texture = 0,
+            .depth_fbo = 0,
+            .pyramid = 0,
+            .program = program,
+            .copy_location = c.glGetUniformLocation(program, "copyLevel"),
+            .vao = 0,
+        };
+        // Also deletes the program, names not generated yet are 0 and ignored
+        errdefer self.deinit();
+
+        c.glGenVertexArrays(1, &self.vao);
+
+        const state = GLStateCache.current();
+        state.useProgram(program);
+        c.glUniform1i(c.glGetUniformLocation(program, "source"), 0);
+
+        // Occluder depth target
+        c.glGenTextures(1, &self.depth_texture);
+        state.bindTexture2D(0, self.depth_texture);
+        c.glTexImage2D(c.GL_TEXTURE_2D, 0, c.GL_DEPTH_COMPONENT32F, @intCast(self.width), @intCast(self.height), 0, c.GL_DEPTH_COMPONENT, c.GL_FLOAT, null);
+        setNearestClamp();
+
+        c.glGenFramebuffers(1, &self.depth_fbo);
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.depth_fbo);
+        c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_DEPTH_ATTACHMENT, c.GL_TEXTURE_2D, self.depth_texture, 0);
+        c.glDrawBuffer(c.GL_NONE);
+        c.glReadBuffer(c.GL_NONE);
+        try checkFramebuffer();
+
+        // Pyramid, every level allocated up front
+        c.glGenTextures(1, &self.pyramid);
+        state.bindTexture2D(0, self.pyramid);
+        for (0..levels) |level| {
+            const w, const h = self.levelSize(@intCast(level));
+            c.glTexImage2D(c.GL_TEXTURE_2D, @intCast(level), c.GL_R32F, @intCast(w), @intCast(h), 0, c.GL_RED, c.GL_FLOAT, null);
+        }
+        setNearestClamp();
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_NEAREST_MIPMAP_NEAREST);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAX_LEVEL, @intCast(levels - 1));
+
+        c.glGenFramebuffers(@intCast(levels), &self.level_fbos);
+        for (self.level_fbos[0..levels], 0..) |fbo, level| {
+            c.glBindFramebuffer(c.GL_FRAMEBUFFER, fbo);
+            c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_COLOR_ATTACHMENT0, c.GL_TEXTURE_2D, self.pyramid, @intCast(level));
+            try checkFramebuffer();
+        }
+
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, 0);
+        err.checkGLError("HiZBuffer setup");
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Redirect drawing into the occluder depth target, draw the large occluders next
+    /// Color output is discarded, depth testing and face culling stay as configured
+    pub fn beginOccluders(self: *Self) void {
+        const state = GLStateCache.current();
+        self.saved_viewport = state.viewport;
+
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.depth_fbo);
+        state.setViewport(0, 0, @intCast(self.width), @intCast(self.height));
+        c.glClear(c.GL_DEPTH_BUFFER_BIT);
+        err.checkGLError("HiZBuffer.beginOccluders");
+    }
+
+
+    /// Build the pyramid from the occluder depth and return to gl.default_framebuffer
+    pub fn endOccluders(self: *Self) void {
+        self.build();
+
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+        if (self.saved_viewport) |viewport| {
+            GLStateCache.current().setViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        }
+        self.saved_viewport = null;
+    }
+
+
+    /// Width and height of mip `level`
+    pub fn levelSize(self: *const Self, level: u32) struct { u32, u32 } {
+        return .{ @max(self.width >> @intCast(level), 1), @max(self.height >> @intCast(level), 1) };
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        const state = GLStateCache.current();
+        state.forgetProgram(self.program);
+        state.forgetVertexArray(self.vao);
+        state.forgetTexture(self.depth_texture);
+        state.forgetTexture(self.pyramid);
+
+        c.glDeleteProgram(self.program);
+        c.glDeleteVertexArrays(1, &self.vao);
+        const textures = [_]c.GLuint{ self.depth_texture, self.pyramid };
+        c.glDeleteTextures(textures.len, &textures);
+        c.glDeleteFramebuffers(1, &self.depth_fbo);
+        c.glDeleteFramebuffers(@intCast(self.levels), &self.level_fbos);
+        err.checkGLError("HiZBuffer cleanup");
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Reduce the occluder depth into every pyramid level
+    fn build(self: *Self) void {
+        const state = GLStateCache.current();
+
+        // The fullscreen triangle must not be culled, depth tested or drawn as lines
+        const depth_test = state.depth_test;
+        const cull_face = state.cull_face;
+        const polygon_mode = state.polygon_mode;
+        state.setDepthTest(false);
+        state.setCullFace(false);
+        state.setPolygonMode(c.GL_FILL);
+
+        state.useProgram(self.program);
+        state.bindVertexArray(self.vao);
+        // A material's sampler left on the unit would override the level clamping below
+        state.bindSampler(0, 0);
+
+        // Level 0 copies the occluder depth
+        c.glUniform1i(self.copy_location, 1);
+        state.bindTexture2D(0, self.depth_texture);
+        self.drawLevel(0);
+
+        // Each level reads only the one below, base and max level keep it out of its own feedback loop
+        c.glUniform1i(self.copy_location, 0);
+        state.bindTexture2D(0, self.pyramid);
+        for (1..self.levels) |level| {
+            c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_BASE_LEVEL, @intCast(level - 1));
+            c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAX_LEVEL, @intCast(level - 1));
+            self.drawLevel(@intCast(level));
+        }
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_BASE_LEVEL, 0);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAX_LEVEL, @intCast(self.levels - 1));
+        err.checkGLError("HiZBuffer.build");
+
+        if (depth_test) |enabled| state.setDepthTest(enabled);
+        if (cull_face) |enabled| state.setCullFace(enabled);
+        if (polygon_mode) |mode| state.setPolygonMode(mode);
+    }
+
+
+    fn drawLevel(self: *Self, level: u32) void {
+        const w, const h = self.levelSize(level);
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.level_fbos[level]);
+        GLStateCache.current().setViewport(0, 0, @intCast(w), @intCast(h));
+        c.glDrawArrays(c.GL_TRIANGLES, 0, 3);
+    }
+
+
+    /// Filtering and wrapping for texelFetch-only textures, assumes the texture is bound
+    fn setNearestClamp() void {
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_NEAREST);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_NEAREST);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
+    }
+
+
+    fn checkFramebuffer() !void {
+        if (c.glCheckFramebufferStatus(c.GL_FRAMEBUFFER) != c.GL_FRAMEBUFFER_COMPLETE) {
+            c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+            return HiZError.IncompleteFramebuffer;
+        }
+    }
+};
@@ -0,0 +1,161 @@
+// graphics/image_decode.zig - stb_image decoding from memory into per-thread scratch memory
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+
+
+pub const ImageDecodeError = error{
+    DecodeFailed,
+    /// The image is larger than stb_image takes
+    ImageTooLarge,
+};
+
+
+/// Pixels of a decoded image, rows as stb_image returns them, `channels` bytes per pixel
+/// Lives in the decoding thread's scratch until that thread decodes the next image
+pub const DecodedImage = struct {
+    pixels: []u8,
+    width: u32,
+    height: u32,
+    channels: u32,
+};
+
+
+// ============================================================
+// Public API: Decoding
+// ============================================================
+
+/// Decode the image file at `path` to `channels` per pixel, 0 keeps the file's own count
+/// The file bytes, stb_image's working memory and the pixels all come from this thread's scratch arena,
+/// which keeps its memory from one image to the next, so a load allocates nothing once it has grown.
+/// Upload or copy the pixels before the next decode on the same thread
+pub fn decodeFile(path: []const u8, channels: u32) !DecodedImage {
+    resetScratch();
+    const file = try std.fs.cwd().openFile(path, .{});
+    defer file.close();
+    const bytes = try file.readToEndAlloc(scratch.allocator(), std.math.maxInt(c_int));
+    return decodeInScratch(bytes, channels);
+}
+
+
+/// Decode an encoded image held in memory, e.g. one embedded in a glTF buffer, see decodeFile
+pub fn decodeMemory(bytes: []const u8, channels: u32) !DecodedImage {
+    resetScratch();
+    return decodeInScratch(bytes, channels);
+}
+
+
+/// What went wrong in a failed decode, stb_image's reason or the file error
+pub fn failureReason(decode_err: anyerror) []const u8 {
+    if (decode_err == ImageDecodeError.DecodeFailed) {
+        if (c.stbi_failure_reason()) |reason| return std.mem.span(reason);
+    }
+    return @errorName(decode_err);
+}
+
+
+/// Give this thread's scratch memory back, for threads that decoded a large image once and live on
+pub fn releaseThreadScratch() void {
+    scratch.deinit();
+    scratch = .{ .child_allocator = std.heap.page_allocator, .state = .{} };
+}
+
+
+// ============================================================
+// Private: Helper Functions
+// ============================================================
+
+/// Keeps stb_image.c's STBI_MALLOC pointed at the scratch while set, Zig decoders don't nest
+threadlocal var scratch_active: bool = false;
+threadlocal var scratch = std.heap.ArenaAllocator{ .child_allocator = std.heap.page_allocator, .state = .{} };
+
+
+fn resetScratch() void {
+    _ = scratch.reset(.retain_capacity);
+}
+
+
+fn decodeInScratch(bytes: []const u8, channels: u32) !DecodedImage {
+    if (bytes.len > std.math.maxInt(c_int)) return ImageDecodeError.ImageTooLarge;
+    scratch_active = true;
+    defer scratch_active = false;
+
+    var w: c_int = 0;
+    var h: c_int = 0;
+    var n: c_int = 0;
+    const data = c.stbi_load_from_memory(bytes.ptr, @intCast(bytes.len), &w, &h, &n, @intCast(channels)) orelse return ImageDecodeError.DecodeFailed;
+    if (w <= 0 or h <= 0) return ImageDecodeError.DecodeFailed;
+
+    const actual_channels: u32 = if (channels != 0) channels else @intCast(n);
+    const size = @as(usize, @intCast(w)) * @as(usize, @intCast(h)) * actual_channels;
+    return .{ .pixels = data[0..size], .width = @intCast(w), .height = @intCast(h), .channels = actual_channels };
+}
+
+
+/// In front of every allocation stb_image makes, so free and realloc know where it came from
+const Header = extern struct {
+    size: usize,
+    scratch: usize,
+};
+
+const header_size = @sizeOf(Header);
+const alignment = 16;
+
+comptime {
+    std.debug.assert(header_size % alignment == 0);
+}
+
+
+fn headerOf(ptr: *anyopaque) *Header {
+    return @ptrFromInt(@intFromPtr(ptr) - header_size);
+}
+
+
+fn payload(header: *Header) *anyopaque {
+    return @ptrFromInt(@intFromPtr(header) + header_size);
+}
+
+
+/// STBI_MALLOC of stb_image.c built with ZUNE_STBI_SCRATCH, scratch while decoding through this file, malloc otherwise
+/// Scratch frees are free, the arena is reset by the next decode
+export fn zune_stbi_malloc(size: usize) ?*anyopaque {
+    const memory: [*]align(alignment) u8 = if (scratch_active)
+        (scratch.allocator().alignedAlloc(u8, alignment, header_size + size) catch return null).ptr
+    else
+        @alignCast(@as([*]u8, @ptrCast(std.c.malloc(header_size + size) orelse return null)));
+    const header: *Header = @ptrCast(memory);
+    header.* = .{ .size = size, .scratch = @intFromBool(scratch_active) };
+    return payload(header);
+}
+
+
+/// An allocation keeps its origin when it grows, the last scratch allocation grows in place
+export fn zune_stbi_realloc(ptr: ?*anyopaque, new_size: usize) ?*anyopaque {
+    const old = ptr orelse return zune_stbi_malloc(new_size);
+    const header = headerOf(old);
+
+    if (header.scratch == 0) {
+        const grown: *Header = @alignCast(@ptrCast(std.c.realloc(header, header_size + new_size) orelse return null));
+        grown.size = new_size;
+        return payload(grown);
+    }
+
+    const arena = scratch.allocator();
+    const block: []align(alignment) u8 = @as([*]align(alignment) u8, @ptrCast(header))[0 .. header_size + header.size];
+    if (arena.resize(block, header_size + new_size)) {
+        header.size = new_size;
+        return old;
+    }
+    const moved = arena.alignedAlloc(u8, alignment, header_size + new_size) catch return null;
+    const moved_header: *Header = @ptrCast(moved.ptr);
+    moved_header.* = .{ .size = new_size, .scratch = 1 };
+    const kept = @min(header.size, new_size);
+    @memcpy(@as([*]u8, @ptrCast(payload(moved_header)))[0..kept], @as([*]const u8, @ptrCast(old))[0..kept]);
+    return payload(moved_header);
+}
+
+
+export fn zune_stbi_free(ptr: ?*anyopaque) void {
+    const old = ptr orelse return;
+    const header = headerOf(old);
+    if (header.scratch == 0) std.c.free(header);
+}
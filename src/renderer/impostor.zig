@@ -0,0 +1,247 @@
+// graphics/impostor.zig - image based far LOD of models
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const Material = @import("material.zig").Material;
+const Mesh = @import("mesh.zig").Mesh;
+const Model = @import("model.zig").Model;
+const Renderer = @import("renderer.zig").Renderer;
+const shader_module = @import("shader.zig");
+const Shader = shader_module.Shader;
+const camera_block_glsl = shader_module.camera_block_glsl;
+const instance_glsl = shader_module.instance_glsl;
+const Texture = @import("texture.zig").Texture;
+const material_block_glsl = @import("material_buffer.zig").material_block_glsl;
+
+const Mat4f = @import("../math/matrix.zig").Mat4f;
+const Vec3f = @import("../math/vector.zig").Vec3f;
+
+
+pub const ImpostorError = error{
+    /// The model has no geometry to bake
+    EmptyModel,
+    /// The atlas framebuffer is incomplete
+    IncompleteFramebuffer,
+};
+
+
+pub const ImpostorConfig = struct {
+    /// Views around the model's vertical axis, the atlas columns
+    azimuth_views: u32 = 8,
+    /// Rows of views from the horizon up to max_elevation, the atlas rows
+    elevation_views: u32 = 3,
+    /// Elevation of the top row, in radians below pi / 2. Cameras below the horizon see the bottom row
+    max_elevation: f32 = 1.2,
+    /// Edge length of one view in the atlas, in pixels
+    view_size: u32 = 128,
+    /// Atlas alpha below which the impostor is cut out
+    alpha_cutoff: f32 = 0.5,
+};
+
+
+/// Pictures of a model from a grid of directions, drawn as a camera facing quad showing the nearest one
+/// bake renders the full detail level into an atlas once, addToModel appends it as the coarsest LOD, so the
+/// render system selects it like any other level and draws every far instance in one instanced call
+/// The model is baked unlit with its materials as they are, and instances should be scaled uniformly
+pub const Impostor = struct {
+    const Self = @This();
+
+    allocator: std.mem.Allocator,
+    config: ImpostorConfig,
+    /// Color and alpha of every view, with mipmaps
+    texture: *Texture,
+    /// Quad spanning [-0.5, 0.5], turned toward the camera by the shader
+    mesh: *Mesh,
+    /// Owns the impostor's shader, which holds its bounds and grid as uniforms
+    material: *Material,
+
+    const vertex_source = "#version 330 core\n" ++ camera_block_glsl ++ instance_glsl ++
+        \\layout (location=0) in vec3 aPos;
+        \\layout (location=1) in vec2 aTexCoord;
+        \\out vec2 TexCoord;
+        \\uniform mat4 model;
+        \\uniform bool instanced;
+        \\uniform vec4 impostorBounds;
+        \\// Views around, rows up, top row elevation, alpha cutoff
+        \\uniform vec4 impostorGrid;
+        \\void main() {
+        \\    mat4 world = instanced ? instanceModel() : model;
+        \\    vec3 center = (world * vec4(impostorBounds.xyz, 1.0)).xyz;
+        \\    float radius = impostorBounds.w * length(world[0].xyz);
+        \\
+        \\    // The baked view closest to the direction of the eye, in object space
+        \\    vec3 toEye = normalize(transpose(mat3(world)) * (cameraPosition.xyz - center));
+        \\    float azimuth = atan(toEye.z, toEye.x) / 6.28318531;
+        \\    float column = mod(floor(azimuth * impostorGrid.x + 0.5), impostorGrid.x);
+        \\    float elevation = asin(clamp(toEye.y, -1.0, 1.0)) / impostorGrid.z;
+        \\    float row = clamp(floor(elevation * (impostorGrid.y - 1.0) + 0.5), 0.0, impostorGrid.y - 1.0);
+        \\
+        \\    vec3 right = vec3(view[0][0], view[1][0], view[2][0]);
+        \\    vec3 up = vec3(view[0][1], view[1][1], view[2][1]);
+        \\    vec3 position = center + (right * aPos.x + up * aPos.y) * 2.0 * radius;
+        \\    gl_Position = viewProjection * vec4(position, 1.0);
+        \\    TexCoord = (vec2(column, row) + aTexCoord) / impostorGrid.xy;
+        \\}
+    ;
+    const fragment_source = "#version 330 core\n" ++ material_block_glsl ++
+        \\in vec2 TexCoord;
+        \\layout (location = 0) out vec4 FragColor;
+        \\uniform sampler2D texSampler;
+        \\uniform vec4 impostorGrid;
+        \\uniform bool depthPass;
+        \\void main() {
+        \\    vec4 texel = texture(texSampler, TexCoord);
+        \\    if (texel.a < impostorGrid.w) discard;
+        \\    if (depthPass) return;
+        \\    // Views were drawn over transparent black, undo the darkening of the blended edges
+        \\    FragColor = vec4(texel.rgb / max(texel.a, 1e-4), 1.0) * materialColor();
+        \\}
+    ;
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Render the full detail level of `model` into a new atlas, call on the GL thread outside a frame's passes
+    pub fn bake(allocator: std.mem.Allocator, renderer: *Renderer, model: *Model, config: ImpostorConfig) !Self {
+        std.debug.assert(config.azimuth_views > 0 and config.elevation_views > 0 and config.view_size > 0);
+        std.debug.assert(config.max_elevation < std.math.pi / 2.0);
+        if (model.pairs.items.len == 0 or model.bounds.isEmpty()) return ImpostorError.EmptyModel;
+
+        const width: i32 = @intCast(config.azimuth_views * config.view_size);
+        const height: i32 = @intCast(config.elevation_views * config.view_size);
+        const atlas = try Texture.createStorage(width, height);
+        var atlas_owned = true;
+        defer if (atlas_owned) {
+            GLStateCache.current().forgetTexture(atlas);
+            c.glDeleteTextures(1, &atlas);
+        };
+        try renderViews(renderer, model, config, atlas, width, height);
+
+        Texture.buildMipmaps(atlas, width, height);
+        const state = GLStateCache.current();
+
+        const texture = try Texture.createFromId(allocator, atlas, width, height);
+        atlas_owned = false;
+        errdefer _ = texture.release();
+        texture.setSampler(.{ .filter = .trilinear, .wrap = .clamp_to_edge });
+
+        const shader = try Shader.create(allocator, vertex_source, fragment_source);
+        defer _ = shader.release();
+        const center = model.bounds.center();
+        state.useProgram(shader.program);
+        try shader.setUniformVec4("impostorBounds", .{ center.x, center.y, center.z, model.bounds.radius() });
+        try shader.setUniformVec4("impostorGrid", .{
+            @floatFromInt(config.azimuth_views),
+            @floatFromInt(config.elevation_views),
+            config.max_elevation,
+            config.alpha_cutoff,
+        });
+
+        const material = try Material.create(allocator, shader, .{ 1.0, 1.0, 1.0, 1.0 }, texture);
+        errdefer _ = material.release();
+        const mesh = try Mesh.createQuad(allocator);
+        // The shader grows the quad to the model's size, culling and LOD selection keep using its bounds
+        mesh.bounds = model.bounds;
+
+        return .{
+            .allocator = allocator,
+            .config = config,
+            .texture = texture,
+            .mesh = mesh,
+            .material = material,
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Append the impostor to `model` as a new coarsest level, used below `max_screen_size`
+    /// The model takes its own references, the impostor can be deinitialized afterwards
+    pub fn addToModel(self: *const Self, model: *Model, max_screen_size: f32) !usize {
+        const lod = try model.addLod(max_screen_size);
+        try model.addLodMeshMaterial(lod, self.mesh, self.material);
+        return lod;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        _ = self.material.release();
+        _ = self.mesh.release();
+        _ = self.texture.release();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Draw the model once per view into its cell of `atlas`, with an orthographic camera fitting its bounds
+    fn renderViews(renderer: *Renderer, model: *Model, config: ImpostorConfig, atlas: c.GLuint, width: i32, height: i32) !void {
+        const state = GLStateCache.current();
+        const saved_viewport = state.viewport;
+        const saved_clear = state.clear_color orelse renderer.config.clear_color;
+        const saved_depth_test = state.depth_test orelse true;
+
+        var fbo: c.GLuint = 0;
+        var depth: c.GLuint = 0;
+        c.glGenRenderbuffers(1, &depth);
+        c.glBindRenderbuffer(c.GL_RENDERBUFFER, depth);
+        c.glRenderbufferStorage(c.GL_RENDERBUFFER, c.GL_DEPTH24_STENCIL8, width, height);
+        c.glBindRenderbuffer(c.GL_RENDERBUFFER, 0);
+        c.glGenFramebuffers(1, &fbo);
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, fbo);
+        c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_COLOR_ATTACHMENT0, c.GL_TEXTURE_2D, atlas, 0);
+        c.glFramebufferRenderbuffer(c.GL_FRAMEBUFFER, c.GL_DEPTH_STENCIL_ATTACHMENT, c.GL_RENDERBUFFER, depth);
+        defer {
+            c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+            c.glDeleteFramebuffers(1, &fbo);
+            c.glDeleteRenderbuffers(1, &depth);
+            if (saved_viewport) |viewport| state.setViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            state.setClearColor(saved_clear);
+            state.setDepthTest(saved_depth_test);
+            err.checkGLError("Impostor: bake cleanup");
+        }
+        if (c.glCheckFramebufferStatus(c.GL_FRAMEBUFFER) != c.GL_FRAMEBUFFER_COMPLETE) {
+            return ImpostorError.IncompleteFramebuffer;
+        }
+
+        state.setViewport(0, 0, width, height);
+        state.setClearColor(.{ 0.0, 0.0, 0.0, 0.0 });
+        state.setColorMask(true);
+        state.setDepthMask(true);
+        state.setDepthTest(true);
+        c.glClear(c.GL_COLOR_BUFFER_BIT | c.GL_DEPTH_BUFFER_BIT);
+
+        const center = model.bounds.center();
+        const radius = model.bounds.radius();
+        var projection = Mat4f.ortho(-radius, radius, -radius, radius, radius * 0.5, radius * 3.5);
+        var identity = Mat4f.identity();
+        const size: i32 = @intCast(config.view_size);
+        const rows_above = @as(f32, @floatFromInt(@max(config.elevation_views, 2) - 1));
+
+        for (0..config.elevation_views) |row| {
+            // Same spacing the shader rounds the eye direction to
+            const elevation = @as(f32, @floatFromInt(row)) / rows_above * config.max_elevation;
+            for (0..config.azimuth_views) |column| {
+                const azimuth = @as(f32, @floatFromInt(column)) / @as(f32, @floatFromInt(config.azimuth_views)) * std.math.tau;
+                const direction = Vec3f.create(@cos(elevation) * @cos(azimuth), @sin(elevation), @cos(elevation) * @sin(azimuth));
+                const eye = center.add(direction.scale(radius * 2.0));
+                var view_matrix = Mat4f.lookAt(eye, center, Vec3f.create(0.0, 1.0, 0.0));
+
+                state.setViewport(@as(i32, @intCast(column)) * size, @as(i32, @intCast(row)) * size, size, size);
+                try renderer.drawModel(model, &identity, &view_matrix, &projection);
+            }
+        }
+        err.checkGLError("Impostor: bake");
+    }
+};
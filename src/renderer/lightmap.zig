@@ -0,0 +1,435 @@
+// graphics/lightmap.zig - baked lightmaps and irradiance probes, the runtime side of lightmap_baker.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const mesh_module = @import("mesh.zig");
+const Mesh = mesh_module.Mesh;
+const PackedNormal = mesh_module.PackedNormal;
+const Shader = @import("shader.zig").Shader;
+const camera_block_glsl = @import("shader.zig").camera_block_glsl;
+const instance_glsl = @import("shader.zig").instance_glsl;
+const ClusteredLighting = @import("clustered_lighting.zig").ClusteredLighting;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const asset_archive = @import("asset_archive.zig");
+const AssetArchive = asset_archive.AssetArchive;
+const ArchiveWriter = asset_archive.ArchiveWriter;
+
+const Vec3f = @import("../math/vector.zig").Vec3f;
+
+
+pub const LightmapError = error{
+    /// A baked blob is shorter than its header says or misaligned
+    InvalidBakeData,
+};
+
+
+/// Vertex of lightmapped static geometry as the baker writes it, 24 bytes
+/// Charts of the lightmap don't share vertices, so the baker splits vertices along chart borders
+pub const LightmappedVertex = extern struct {
+    position: [3]f32,
+    normal: PackedNormal,
+    uv: [2]f16,
+    /// Normalized across the whole lightmap, its own texels per surface point
+    lightmap_uv: [2]u16,
+};
+
+
+/// Irradiance at one probe as L1 spherical harmonics, per color channel the constant term and the
+/// gradient along x, y and z, already convolved with the cosine lobe. A surface facing `n` receives
+/// max(c[0] + c[1] n.x + c[2] n.y + c[3] n.z, 0), the same quantity a lightmap texel stores
+pub const IrradianceProbe = extern struct {
+    red: [4]f32 = .{ 0.0, 0.0, 0.0, 0.0 },
+    green: [4]f32 = .{ 0.0, 0.0, 0.0, 0.0 },
+    blue: [4]f32 = .{ 0.0, 0.0, 0.0, 0.0 },
+
+
+    /// `irradiance` is what a surface facing the light head on gets, from the unit `direction` toward it
+    /// L1 keeps the clamped cosine as 1/4 + 1/2 cos, exact for a uniform sky and smooth for one light
+    pub fn addLight(self: *IrradianceProbe, direction: Vec3f, irradiance: [3]f32) void {
+        for ([_]*[4]f32{ &self.red, &self.green, &self.blue }, irradiance) |channel, value| {
+            channel[0] += 0.25 * value;
+            channel[1] += 0.5 * value * direction.x;
+            channel[2] += 0.5 * value * direction.y;
+            channel[3] += 0.5 * value * direction.z;
+        }
+    }
+
+
+    /// Light arriving the same from every direction
+    pub fn addAmbient(self: *IrradianceProbe, ambient: [3]f32) void {
+        self.red[0] += ambient[0];
+        self.green[0] += ambient[1];
+        self.blue[0] += ambient[2];
+    }
+
+
+    pub fn evaluate(self: IrradianceProbe, normal: Vec3f) [3]f32 {
+        var result: [3]f32 = undefined;
+        for (&result, [_][4]f32{ self.red, self.green, self.blue }) |*out, channel| {
+            out.* = @max(channel[0] + channel[1] * normal.x + channel[2] * normal.y + channel[3] * normal.z, 0.0);
+        }
+        return result;
+    }
+};
+
+
+/// Probes on a regular grid covering the static geometry, x varies fastest
+/// Moving objects interpolate the eight probes around them, so they pick up the baked lights too
+pub const ProbeGrid = struct {
+    /// World position of the first probe
+    origin: [3]f32,
+    spacing: f32,
+    counts: [3]u32,
+    probes: []const IrradianceProbe,
+
+    pub fn index(self: ProbeGrid, x: u32, y: u32, z: u32) usize {
+        return x + (@as(usize, y) + @as(usize, z) * self.counts[1]) * self.counts[0];
+    }
+
+
+    pub fn positionOf(self: ProbeGrid, x: u32, y: u32, z: u32) Vec3f {
+        return Vec3f.create(
+            self.origin[0] + @as(f32, @floatFromInt(x)) * self.spacing,
+            self.origin[1] + @as(f32, @floatFromInt(y)) * self.spacing,
+            self.origin[2] + @as(f32, @floatFromInt(z)) * self.spacing,
+        );
+    }
+};
+
+
+/// Lightmap texels, irradiance in linear RGB, alpha 0 on the texels no chart reaches
+pub const LightmapImage = struct {
+    width: u32,
+    height: u32,
+    texels: []const [4]f16,
+};
+
+
+/// Archive names of the bake outputs, the geometry goes under the names the scene gave it
+pub const lightmap_name = "lighting/lightmap";
+pub const probes_name = "lighting/probes";
+
+
+const LightmapHeader = extern struct {
+    width: u32,
+    height: u32,
+};
+
+const ProbeHeader = extern struct {
+    origin: [3]f32,
+    spacing: f32,
+    counts: [3]u32,
+    _pad: u32 = 0,
+};
+
+const GeometryHeader = extern struct {
+    vertex_count: u32,
+    index_count: u32,
+};
+
+
+// ============================================================
+// Public API: Archive Entries
+// ============================================================
+
+pub fn addLightmap(writer: *ArchiveWriter, allocator: std.mem.Allocator, image: LightmapImage) !void {
+    const header = LightmapHeader{ .width = image.width, .height = image.height };
+    try addBlob(writer, allocator, lightmap_name, std.mem.asBytes(&header), std.mem.sliceAsBytes(image.texels), &.{});
+}
+
+
+pub fn addProbes(writer: *ArchiveWriter, allocator: std.mem.Allocator, grid: ProbeGrid) !void {
+    const header = ProbeHeader{ .origin = grid.origin, .spacing = grid.spacing, .counts = grid.counts };
+    try addBlob(writer, allocator, probes_name, std.mem.asBytes(&header), std.mem.sliceAsBytes(grid.probes), &.{});
+}
+
+
+/// Vertices and u32 indices of one lightmapped mesh, read back by BakedLighting.createMesh
+pub fn addLightmappedGeometry(writer: *ArchiveWriter, allocator: std.mem.Allocator, name: []const u8, vertices: []const LightmappedVertex, indices: []const u32) !void {
+    const header = GeometryHeader{ .vertex_count = @intCast(vertices.len), .index_count = @intCast(indices.len) };
+    try addBlob(writer, allocator, name, std.mem.asBytes(&header), std.mem.sliceAsBytes(vertices), std.mem.sliceAsBytes(indices));
+}
+
+
+/// Static lighting on the GPU: the lightmap for static surfaces and the probe grid for everything that moves
+/// Baked lights are left out of ClusteredLighting.update, its clusters then only hold the dynamic ones.
+/// Static geometry drawn with createLightmappedShader costs one texture fetch for all of its lighting, moving
+/// objects drawn with createProbeLitShader get the baked lights from the probes and the dynamic ones from the clusters
+pub const BakedLighting = struct {
+    const Self = @This();
+
+    /// Texture units, below the shadow cascades' one so materials keep the low units
+    pub const lightmap_unit = GLStateCache.max_texture_units - 2;
+    /// One 3D texture per color channel, holding that channel's four coefficients
+    pub const probe_units = [3]u32{ lightmap_unit - 3, lightmap_unit - 2, lightmap_unit - 1 };
+
+    /// Irradiance of a static surface at its lightmap coordinates
+    pub const lightmap_glsl =
+        \\uniform sampler2D lightmap;
+        \\vec3 bakedIrradiance(vec2 lightmapUV) {
+        \\    return texture(lightmap, lightmapUV).rgb;
+        \\}
+        \\
+    ;
+
+    /// Irradiance from the probe grid at a world position and normal, trilinear between the probes
+    pub const probe_glsl =
+        \\uniform sampler3D probeRed;
+        \\uniform sampler3D probeGreen;
+        \\uniform sampler3D probeBlue;
+        \\uniform vec3 probeOrigin;
+        \\uniform vec3 probeSpacing;
+        \\uniform vec3 probeCounts;
+        \\vec3 probeIrradiance(vec3 worldPos, vec3 worldNormal) {
+        \\    vec3 coord = ((worldPos - probeOrigin) / probeSpacing + 0.5) / probeCounts;
+        \\    vec4 n = vec4(1.0, normalize(worldNormal));
+        \\    return max(vec3(dot(texture(probeRed, coord), n), dot(texture(probeGreen, coord), n), dot(texture(probeBlue, coord), n)), 0.0);
+        \\}
+        \\
+    ;
+
+    const lightmapped_vertex_source = "#version 330 core\n" ++ camera_block_glsl ++ instance_glsl ++ std.fmt.comptimePrint(
+        \\layout (location=0) in vec3 aPos;
+        \\layout (location={d}) in vec2 aLightmapUV;
+        \\uniform mat4 model;
+        \\uniform bool instanced;
+        \\out vec2 LightmapUV;
+        \\invariant gl_Position;
+        \\void main() {{
+        \\    mat4 world = instanced ? instanceModel() : model;
+        \\    LightmapUV = aLightmapUV;
+        \\    gl_Position = viewProjection * world * vec4(aPos, 1.0);
+        \\}}
+    , .{mesh_module.lightmap_uv_location});
+
+    const lightmapped_fragment_source = "#version 330 core\n" ++ lightmap_glsl ++
+        \\in vec2 LightmapUV;
+        \\uniform vec4 color;
+        \\out vec4 FragColor;
+        \\void main() {
+        \\    FragColor = vec4(color.rgb * bakedIrradiance(LightmapUV), color.a);
+        \\}
+    ;
+
+    const probe_lit_vertex_source = "#version 430 core\n" ++ camera_block_glsl ++ instance_glsl ++
+        \\layout (location=0) in vec3 aPos;
+        \\layout (location=1) in vec3 aNormal;
+        \\uniform mat4 model;
+        \\uniform bool instanced;
+        \\out vec3 WorldPos;
+        \\out vec3 WorldNormal;
+        \\out vec3 ViewPos;
+        \\out vec3 ViewNormal;
+        \\invariant gl_Position;
+        \\void main() {
+        \\    mat4 world = instanced ? instanceModel() : model;
+        \\    vec4 worldPos = world * vec4(aPos, 1.0);
+        \\    WorldPos = worldPos.xyz;
+        \\    WorldNormal = mat3(world) * aNormal;
+        \\    ViewPos = (view * worldPos).xyz;
+        \\    ViewNormal = mat3(view) * WorldNormal;
+        \\    gl_Position = viewProjection * worldPos;
+        \\}
+    ;
+
+    const probe_lit_fragment_source = "#version 430 core\n" ++ ClusteredLighting.lighting_glsl ++ probe_glsl ++
+        \\in vec3 WorldPos;
+        \\in vec3 WorldNormal;
+        \\in vec3 ViewPos;
+        \\in vec3 ViewNormal;
+        \\uniform vec4 color;
+        \\out vec4 FragColor;
+        \\void main() {
+        \\    vec3 indirect = color.rgb * probeIrradiance(WorldPos, WorldNormal);
+        \\    FragColor = vec4(clusteredLightingWith(ViewPos, ViewNormal, color.rgb, indirect), color.a);
+        \\}
+    ;
+
+    lightmap_texture: c.GLuint = 0,
+    probe_textures: [3]c.GLuint = .{ 0, 0, 0 },
+    probe_origin: [3]f32 = .{ 0.0, 0.0, 0.0 },
+    probe_spacing: f32 = 1.0,
+    probe_counts: [3]u32 = .{ 1, 1, 1 },
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Upload a bake, probes are optional and a missing grid lights moving objects with black
+    /// `allocator` only holds the probe channels while they upload
+    pub fn init(allocator: std.mem.Allocator, image: LightmapImage, grid: ?ProbeGrid) !Self {
+        var self = Self{};
+        errdefer self.deinit();
+
+        c.glGenTextures(1, &self.lightmap_texture);
+        GLStateCache.current().bindTexture2D(lightmap_unit, self.lightmap_texture);
+        c.glTexImage2D(c.GL_TEXTURE_2D, 0, c.GL_RGBA16F, @intCast(image.width), @intCast(image.height), 0, c.GL_RGBA, c.GL_HALF_FLOAT, image.texels.ptr);
+        // Charts are padded, but mips would blend neighbors across the padding
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_LINEAR);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_LINEAR);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
+        err.checkGLError("BakedLighting: lightmap");
+
+        const black = [_]IrradianceProbe{.{}};
+        const probes = grid orelse ProbeGrid{ .origin = .{ 0.0, 0.0, 0.0 }, .spacing = 1.0, .counts = .{ 1, 1, 1 }, .probes = &black };
+        self.probe_origin = probes.origin;
+        self.probe_spacing = probes.spacing;
+        self.probe_counts = probes.counts;
+
+        // Probes keep the channels side by side, each texture takes one of them
+        const values = try allocator.alloc([4]f32, probes.probes.len);
+        defer allocator.free(values);
+        c.glGenTextures(3, &self.probe_textures);
+        for (self.probe_textures, probe_units, 0..) |texture, unit, channel| {
+            GLStateCache.current().activeTexture(unit);
+            c.glBindTexture(c.GL_TEXTURE_3D, texture);
+            for (values, probes.probes) |*value, probe| value.* = switch (channel) {
+                0 => probe.red,
+                1 => probe.green,
+                else => probe.blue,
+            };
+            c.glTexImage3D(c.GL_TEXTURE_3D, 0, c.GL_RGBA16F, @intCast(probes.counts[0]), @intCast(probes.counts[1]), @intCast(probes.counts[2]), 0, c.GL_RGBA, c.GL_FLOAT, values.ptr);
+            c.glTexParameteri(c.GL_TEXTURE_3D, c.GL_TEXTURE_MIN_FILTER, c.GL_LINEAR);
+            c.glTexParameteri(c.GL_TEXTURE_3D, c.GL_TEXTURE_MAG_FILTER, c.GL_LINEAR);
+            c.glTexParameteri(c.GL_TEXTURE_3D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
+            c.glTexParameteri(c.GL_TEXTURE_3D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
+            c.glTexParameteri(c.GL_TEXTURE_3D, c.GL_TEXTURE_WRAP_R, c.GL_CLAMP_TO_EDGE);
+        }
+        err.checkGLError("BakedLighting: probes");
+        return self;
+    }
+
+
+    /// Upload the lightmap and probes stored in `archive`
+    pub fn load(allocator: std.mem.Allocator, archive: *const AssetArchive) !Self {
+        const lightmap_bytes = try archive.sourceBytes(lightmap_name);
+        const lightmap_header = try readHeader(LightmapHeader, lightmap_bytes);
+        const texels = try readSlice([4]f16, lightmap_bytes[@sizeOf(LightmapHeader)..], @as(usize, lightmap_header.width) * lightmap_header.height);
+
+        var grid: ?ProbeGrid = null;
+        if (archive.contains(probes_name)) {
+            const probe_bytes = try archive.sourceBytes(probes_name);
+            const probe_header = try readHeader(ProbeHeader, probe_bytes);
+            const count = @as(usize, probe_header.counts[0]) * probe_header.counts[1] * probe_header.counts[2];
+            grid = .{
+                .origin = probe_header.origin,
+                .spacing = probe_header.spacing,
+                .counts = probe_header.counts,
+                .probes = try readSlice(IrradianceProbe, probe_bytes[@sizeOf(ProbeHeader)..], count),
+            };
+        }
+
+        const image = LightmapImage{ .width = lightmap_header.width, .height = lightmap_header.height, .texels = texels };
+        return init(allocator, image, grid);
+    }
+
+
+    /// Lightmapped mesh `name` of a bake, its vertices are LightmappedVertex
+    pub fn createMesh(allocator: std.mem.Allocator, archive: *const AssetArchive, name: []const u8) !*Mesh {
+        const bytes = try archive.sourceBytes(name);
+        const header = try readHeader(GeometryHeader, bytes);
+        const vertex_bytes = bytes[@sizeOf(GeometryHeader)..];
+        const vertices = try readSlice(LightmappedVertex, vertex_bytes, header.vertex_count);
+        const indices = try readSlice(u32, vertex_bytes[@as(usize, header.vertex_count) * @sizeOf(LightmappedVertex) ..], header.index_count);
+        return Mesh.createTyped(allocator, LightmappedVertex, vertices, indices);
+    }
+
+
+    /// Static surfaces lit by the lightmap alone, `color` is the albedo
+    /// The mesh needs lightmap UVs, e.g. one from createMesh
+    pub fn createLightmappedShader(self: *const Self, allocator: std.mem.Allocator) !*Shader {
+        const shader = try Shader.create(allocator, lightmapped_vertex_source, lightmapped_fragment_source);
+        self.setupShader(shader.program);
+        return shader;
+    }
+
+
+    /// Moving objects with normals, baked lights from the probes and dynamic ones through ClusteredLighting
+    pub fn createProbeLitShader(self: *const Self, allocator: std.mem.Allocator) !*Shader {
+        const shader = try Shader.create(allocator, probe_lit_vertex_source, probe_lit_fragment_source);
+        ClusteredLighting.bindClusterBlock(shader.program);
+        self.setupShader(shader.program);
+        return shader;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Bind the lightmap and probe textures for the draws sampling them
+    pub fn bind(self: *const Self) void {
+        const state = GLStateCache.current();
+        state.bindTexture2D(lightmap_unit, self.lightmap_texture);
+        state.bindSampler(lightmap_unit, 0);
+        for (self.probe_textures, probe_units) |texture, unit| {
+            state.activeTexture(unit);
+            c.glBindTexture(c.GL_TEXTURE_3D, texture);
+            state.bindSampler(unit, 0);
+        }
+        err.checkGLError("BakedLighting.bind");
+    }
+
+
+    /// Point the samplers of a shader built on lightmap_glsl or probe_glsl at their units and give it the grid
+    pub fn setupShader(self: *const Self, program: c.GLuint) void {
+        GLStateCache.current().useProgram(program);
+        c.glUniform1i(c.glGetUniformLocation(program, "lightmap"), lightmap_unit);
+        for ([_][*:0]const u8{ "probeRed", "probeGreen", "probeBlue" }, probe_units) |uniform, unit| {
+            c.glUniform1i(c.glGetUniformLocation(program, uniform), @intCast(unit));
+        }
+        c.glUniform3f(c.glGetUniformLocation(program, "probeOrigin"), self.probe_origin[0], self.probe_origin[1], self.probe_origin[2]);
+        c.glUniform3f(c.glGetUniformLocation(program, "probeSpacing"), self.probe_spacing, self.probe_spacing, self.probe_spacing);
+        c.glUniform3f(
+            c.glGetUniformLocation(program, "probeCounts"),
+            @floatFromInt(self.probe_counts[0]),
+            @floatFromInt(self.probe_counts[1]),
+            @floatFromInt(self.probe_counts[2]),
+        );
+        err.checkGLError("BakedLighting.setupShader");
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        const state = GLStateCache.current();
+        state.forgetTexture(self.lightmap_texture);
+        c.glDeleteTextures(1, &self.lightmap_texture);
+        c.glDeleteTextures(3, &self.probe_textures);
+        err.checkGLError("BakedLighting cleanup");
+        self.* = .{};
+    }
+};
+
+
+// ============================================================
+// Private: Helper Functions
+// ============================================================
+
+/// One source entry of a header and up to two arrays, each array starting at a multiple of four bytes
+fn addBlob(writer: *ArchiveWriter, allocator: std.mem.Allocator, name: []const u8, header: []const u8, first: []const u8, second: []const u8) !void {
+    const bytes = try std.mem.concat(allocator, u8, &.{ header, first, second });
+    defer allocator.free(bytes);
+    try writer.addSource(name, bytes);
+}
+
+
+fn readHeader(comptime H: type, bytes: []const u8) !H {
+    if (bytes.len < @sizeOf(H)) return LightmapError.InvalidBakeData;
+    return std.mem.bytesToValue(H, bytes[0..@sizeOf(H)]);
+}
+
+
+/// `count` items at the start of `bytes`, in place, archive blobs are aligned far enough for them
+fn readSlice(comptime T: type, bytes: []const u8, count: usize) ![]const T {
+    if (bytes.len < count * @sizeOf(T)) return LightmapError.InvalidBakeData;
+    if (!std.mem.isAligned(@intFromPtr(bytes.ptr), @alignOf(T))) return LightmapError.InvalidBakeData;
+    const items: [*]const T = @alignCast(@ptrCast(bytes.ptr));
+    return items[0..count];
+}
@@ -0,0 +1,761 @@
+// graphics/lightmap_baker.zig - offline bake of static lighting into a lightmap and an irradiance probe grid
+const std = @import("std");
+
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+const lightmap = @import("lightmap.zig");
+const LightmappedVertex = lightmap.LightmappedVertex;
+const IrradianceProbe = lightmap.IrradianceProbe;
+const ProbeGrid = lightmap.ProbeGrid;
+const LightmapImage = lightmap.LightmapImage;
+const PackedNormal = @import("mesh.zig").PackedNormal;
+const PointLight = @import("clustered_lighting.zig").PointLight;
+
+const Vec3f = @import("../math/vector.zig").Vec3f;
+const Mat3f = @import("../math/matrix.zig").Mat3f;
+const Mat4f = @import("../math/matrix.zig").Mat4f;
+const bounds = @import("../math/bounds.zig");
+const BoundingBox = bounds.BoundingBox;
+const Ray = bounds.Ray;
+const TriangleBvh = @import("../math/triangle_bvh.zig").TriangleBvh;
+
+
+pub const BakeError = error{
+    /// Baking needs vertex normals, package size 6 or 8
+    MissingNormals,
+    InvalidVertexData,
+    /// The charts don't fit the lightmap even at min_texels_per_unit
+    LightmapFull,
+};
+
+
+pub const BakeConfig = struct {
+    /// Width and height of the lightmap
+    lightmap_size: u32 = 1024,
+    /// Texel density the charts start at, lowered step by step until all of them fit
+    texels_per_unit: f32 = 8.0,
+    min_texels_per_unit: f32 = 0.25,
+    /// Texels around every chart, filled from its edge so filtering never reaches an empty one
+    padding: u32 = 2,
+    /// Light arriving from every direction, e.g. the sky, on top of the baked lights
+    ambient: [3]f32 = .{ 0.03, 0.03, 0.03 },
+    /// Distance between irradiance probes, 0 bakes none
+    probe_spacing: f32 = 2.0,
+    /// Probes along the longest axis at most, the spacing grows past it
+    max_probes_per_axis: u32 = 64,
+    /// Shadow rays start this far off the surface, against shadow acne
+    shadow_bias: f32 = 0.01,
+};
+
+
+/// A static mesh placed in the level, interleaved vertices in object space
+pub const BakeInstance = struct {
+    /// Name the lightmapped mesh is stored under
+    name: []const u8,
+    vertices: []const f32,
+    /// 6 or 8, positions and normals and maybe texture coordinates
+    package_size: u4,
+    indices: []const u32,
+    world: Mat4f,
+};
+
+
+/// Lightmapped version of one instance, still in object space and drawn with the instance's world matrix
+pub const BakedMesh = struct {
+    /// The instance's name, not owned
+    name: []const u8,
+    vertices: []LightmappedVertex,
+    indices: []u32,
+};
+
+
+/// Everything one bake produced, owned until deinit
+pub const BakeResult = struct {
+    allocator: std.mem.Allocator,
+    size: u32,
+    texels: [][4]f16,
+    /// One per instance, in their order
+    meshes: []BakedMesh,
+    probe_origin: [3]f32 = .{ 0.0, 0.0, 0.0 },
+    probe_spacing: f32 = 0.0,
+    probe_counts: [3]u32 = .{ 0, 0, 0 },
+    probes: []IrradianceProbe = &.{},
+    /// Density the charts fit at
+    texels_per_unit: f32,
+
+    pub fn image(self: *const BakeResult) LightmapImage {
+        return .{ .width = self.size, .height = self.size, .texels = self.texels };
+    }
+
+
+    /// Null when the config asked for no probes
+    pub fn probeGrid(self: *const BakeResult) ?ProbeGrid {
+        if (self.probes.len == 0) return null;
+        return .{ .origin = self.probe_origin, .spacing = self.probe_spacing, .counts = self.probe_counts, .probes = self.probes };
+    }
+
+
+    pub fn deinit(self: *BakeResult) void {
+        for (self.meshes) |mesh| {
+            self.allocator.free(mesh.vertices);
+            self.allocator.free(mesh.indices);
+        }
+        self.allocator.free(self.meshes);
+        self.allocator.free(self.texels);
+        self.allocator.free(self.probes);
+    }
+};
+
+
+/// Bake the direct light of `lights` onto `instances`, with shadows between all of them, and sample it
+/// on a grid of probes around them. Texels and probes are lit on `jobs` when given
+///
+/// Every instance is cut into charts, connected triangles whose normals point along the same axis, each
+/// projected onto the plane of that axis at a common texel density and packed into the lightmap in rows.
+/// The texels a chart covers get a world position and normal, and their irradiance is the sum over the
+/// lights of the falloff ClusteredLighting uses, times a shadow ray through a TriangleBvh of the scene.
+/// Charts are then grown into their padding. Texels and probes store irradiance without the albedo
+pub fn bakeLighting(allocator: std.mem.Allocator, jobs: ?*JobSystem, instances: []const BakeInstance, lights: []const PointLight, config: BakeConfig) !BakeResult {
+    var baker = try Baker.init(allocator, instances, lights, config);
+    defer baker.deinit();
+
+    try baker.buildCharts();
+    try baker.pack();
+    const meshes = try baker.rasterize();
+    errdefer {
+        for (meshes) |mesh| {
+            allocator.free(mesh.vertices);
+            allocator.free(mesh.indices);
+        }
+        allocator.free(meshes);
+    }
+
+    runRange(jobs, baker.size, 16, &baker, Baker.lightRows);
+    try baker.dilate();
+
+    var result = BakeResult{
+        .allocator = allocator,
+        .size = baker.size,
+        .texels = baker.texels,
+        .meshes = meshes,
+        .texels_per_unit = baker.density,
+    };
+    baker.texels = &.{};
+    errdefer allocator.free(result.texels);
+
+    if (config.probe_spacing > 0.0) {
+        try baker.placeProbes();
+        runRange(jobs, baker.probes.len, 64, &baker, Baker.lightProbes);
+        result.probe_origin = baker.probe_origin;
+        result.probe_spacing = baker.probe_spacing;
+        result.probe_counts = baker.probe_counts;
+        result.probes = baker.probes;
+        baker.probes = &.{};
+    }
+    return result;
+}
+
+
+// ============================================================
+// Private: Baker
+// ============================================================
+
+/// Triangles of one instance sharing edges and the dominant axis of their normals
+const Chart = struct {
+    instance: u32,
+    /// Axis the chart is projected along
+    axis: u2,
+    /// Range of its triangles in Baker.chart_triangles
+    first: u32,
+    count: u32,
+    /// Projected bounds in world units
+    min: [2]f32 = .{ std.math.inf(f32), std.math.inf(f32) },
+    max: [2]f32 = .{ -std.math.inf(f32), -std.math.inf(f32) },
+    /// Placement in texels, padding included
+    x: u32 = 0,
+    y: u32 = 0,
+};
+
+
+const Baker = struct {
+    allocator: std.mem.Allocator,
+    instances: []const BakeInstance,
+    lights: []const PointLight,
+    config: BakeConfig,
+
+    /// First vertex and triangle of each instance in the scene wide arrays
+    vertex_base: []u32,
+    triangle_base: []u32,
+    world_positions: []f32,
+    world_normals: []Vec3f,
+    world_indices: []u32,
+    bvh: TriangleBvh,
+    scene_bounds: BoundingBox,
+
+    charts: std.ArrayListUnmanaged(Chart) = .{},
+    /// Scene wide triangle indices grouped by chart
+    chart_triangles: []u32 = &.{},
+
+    size: u32,
+    density: f32 = 0.0,
+    texel_positions: []Vec3f = &.{},
+    texel_normals: []Vec3f = &.{},
+    covered: []bool = &.{},
+    texels: [][4]f16 = &.{},
+
+    probe_origin: [3]f32 = .{ 0.0, 0.0, 0.0 },
+    probe_spacing: f32 = 0.0,
+    probe_counts: [3]u32 = .{ 0, 0, 0 },
+    probes: []IrradianceProbe = &.{},
+
+
+    /// Scene wide world space copies of the instances and the hierarchy shadow rays are traced through
+    fn init(allocator: std.mem.Allocator, instances: []const BakeInstance, lights: []const PointLight, config: BakeConfig) !Baker {
+        const vertex_base = try allocator.alloc(u32, instances.len + 1);
+        errdefer allocator.free(vertex_base);
+        const triangle_base = try allocator.alloc(u32, instances.len + 1);
+        errdefer allocator.free(triangle_base);
+
+        vertex_base[0] = 0;
+        triangle_base[0] = 0;
+        for (instances, 0..) |instance, i| {
+            if (instance.package_size != 6 and instance.package_size != 8) return BakeError.MissingNormals;
+            if (instance.vertices.len % instance.package_size != 0 or instance.indices.len % 3 != 0) return BakeError.InvalidVertexData;
+            vertex_base[i + 1] = vertex_base[i] + @as(u32, @intCast(instance.vertices.len / instance.package_size));
+            triangle_base[i + 1] = triangle_base[i] + @as(u32, @intCast(instance.indices.len / 3));
+        }
+
+        const world_positions = try allocator.alloc(f32, @as(usize, vertex_base[instances.len]) * 3);
+        errdefer allocator.free(world_positions);
+        const world_normals = try allocator.alloc(Vec3f, vertex_base[instances.len]);
+        errdefer allocator.free(world_normals);
+        const world_indices = try allocator.alloc(u32, @as(usize, triangle_base[instances.len]) * 3);
+        errdefer allocator.free(world_indices);
+
+        var scene_bounds = BoundingBox.empty;
+        for (instances, 0..) |instance, i| {
+            const stride: usize = instance.package_size;
+            const normal_matrix = instance.world.normalMatrix();
+            for (0..instance.vertices.len / stride) |v| {
+                const data = instance.vertices[v * stride ..];
+                const position = instance.world.transformPoint(Vec3f.create(data[0], data[1], data[2]));
+                const index = vertex_base[i] + v;
+                @memcpy(world_positions[index * 3 ..][0..3], &[3]f32{ position.x, position.y, position.z });
+                world_normals[index] = transformNormal(normal_matrix, Vec3f.create(data[3], data[4], data[5]));
+                scene_bounds = scene_bounds.include(position);
+            }
+            for (instance.indices, 0..) |local, k| {
+                if (local >= vertex_base[i + 1] - vertex_base[i]) return BakeError.InvalidVertexData;
+                world_indices[triangle_base[i] * 3 + k] = vertex_base[i] + local;
+            }
+        }
+
+        const bvh = try TriangleBvh.build(allocator, world_positions, 3, world_indices);
+        const size = @max(config.lightmap_size, 1);
+        return .{
+            .allocator = allocator,
+            .instances = instances,
+            .lights = lights,
+            .config = config,
+            .vertex_base = vertex_base,
+            .triangle_base = triangle_base,
+            .world_positions = world_positions,
+            .world_normals = world_normals,
+            .world_indices = world_indices,
+            .bvh = bvh,
+            .scene_bounds = scene_bounds,
+            .size = size,
+        };
+    }
+
+
+    fn deinit(self: *Baker) void {
+        self.bvh.deinit();
+        self.allocator.free(self.vertex_base);
+        self.allocator.free(self.triangle_base);
+        self.allocator.free(self.world_positions);
+        self.allocator.free(self.world_normals);
+        self.allocator.free(self.world_indices);
+        self.charts.deinit(self.allocator);
+        self.allocator.free(self.chart_triangles);
+        self.allocator.free(self.texel_positions);
+        self.allocator.free(self.texel_normals);
+        self.allocator.free(self.covered);
+        self.allocator.free(self.texels);
+        self.allocator.free(self.probes);
+    }
+
+
+    // ============================================================
+    // Charts
+    // ============================================================
+
+    /// Join triangles of an instance across shared edges when their normals point along the same axis
+    /// Normals within one axis' 6th of the sphere never fold back in the projection, so a chart
+    /// holds no overlapping triangles unless the surface itself curls over
+    fn buildCharts(self: *Baker) !void {
+        const triangle_count = self.triangle_base[self.instances.len];
+        const parents = try self.allocator.alloc(u32, triangle_count);
+        defer self.allocator.free(parents);
+        const keys = try self.allocator.alloc(u3, triangle_count);
+        defer self.allocator.free(keys);
+        const chart_of = try self.allocator.alloc(u32, triangle_count);
+        defer self.allocator.free(chart_of);
+
+        var edges = std.AutoHashMap(u64, u32).init(self.allocator);
+        defer edges.deinit();
+        var roots = std.AutoHashMap(u32, u32).init(self.allocator);
+        defer roots.deinit();
+
+        for (0..self.instances.len) |instance| {
+            edges.clearRetainingCapacity();
+            roots.clearRetainingCapacity();
+            const first = self.triangle_base[instance];
+            const last = self.triangle_base[instance + 1];
+
+            for (first..last) |t| {
+                parents[t] = @intCast(t);
+                keys[t] = axisKey(self.faceNormal(@intCast(t)));
+                const corners = self.world_indices[t * 3 ..][0..3];
+                for (0..3) |k| {
+                    const a = corners[k];
+                    const b = corners[(k + 1) % 3];
+                    const edge = (@as(u64, @min(a, b)) << 32) | @max(a, b);
+                    const entry = try edges.getOrPut(edge);
+                    if (!entry.found_existing) {
+                        entry.value_ptr.* = @intCast(t);
+                    } else if (keys[entry.value_ptr.*] == keys[t]) {
+                        unite(parents, entry.value_ptr.*, @intCast(t));
+                    }
+                }
+            }
+
+            for (first..last) |t| {
+                const root = find(parents, @intCast(t));
+                const entry = try roots.getOrPut(root);
+                if (!entry.found_existing) {
+                    entry.value_ptr.* = @intCast(self.charts.items.len);
+                    try self.charts.append(self.allocator, .{ .instance = @intCast(instance), .axis = @intCast(keys[t] >> 1), .first = 0, .count = 0 });
+                }
+                chart_of[t] = entry.value_ptr.*;
+                self.charts.items[entry.value_ptr.*].count += 1;
+            }
+        }
+
+        // Triangles grouped by chart, then the projected bounds of every chart
+        var offset: u32 = 0;
+        for (self.charts.items) |*chart| {
+            chart.first = offset;
+            offset += chart.count;
+            chart.count = 0;
+        }
+        self.chart_triangles = try self.allocator.alloc(u32, triangle_count);
+        for (0..triangle_count) |t| {
+            const chart = &self.charts.items[chart_of[t]];
+            self.chart_triangles[chart.first + chart.count] = @intCast(t);
+            chart.count += 1;
+        }
+        for (self.charts.items) |*chart| {
+            for (self.chart_triangles[chart.first..][0..chart.count]) |t| {
+                for (self.world_indices[t * 3 ..][0..3]) |vertex| {
+                    const uv = project(self.worldPosition(vertex), chart.axis);
+                    for (0..2) |a| {
+                        chart.min[a] = @min(chart.min[a], uv[a]);
+                        chart.max[a] = @max(chart.max[a], uv[a]);
+                    }
+                }
+            }
+        }
+    }
+
+
+    /// Rows of charts, tallest first, lowering the density until they fit
+    fn pack(self: *Baker) !void {
+        const order = try self.allocator.alloc(u32, self.charts.items.len);
+        defer self.allocator.free(order);
+        for (order, 0..) |*index, i| index.* = @intCast(i);
+        std.sort.pdq(u32, order, @as([]const Chart, self.charts.items), struct {
+            fn taller(charts: []const Chart, a: u32, b: u32) bool {
+                return charts[a].max[1] - charts[a].min[1] > charts[b].max[1] - charts[b].min[1];
+            }
+        }.taller);
+
+        var density = self.config.texels_per_unit;
+        while (density >= self.config.min_texels_per_unit) : (density *= 0.8) {
+            if (self.tryPack(order, density)) {
+                self.density = density;
+                return;
+            }
+        }
+        return BakeError.LightmapFull;
+    }
+
+
+    fn tryPack(self: *Baker, order: []const u32, density: f32) bool {
+        var x: u32 = 0;
+        var y: u32 = 0;
+        var row_height: u32 = 0;
+        for (order) |index| {
+            const chart = &self.charts.items[index];
+            const width = self.chartTexels(chart.max[0] - chart.min[0], density);
+            const height = self.chartTexels(chart.max[1] - chart.min[1], density);
+            if (width > self.size) return false;
+            if (x + width > self.size) {
+                y += row_height;
+                x = 0;
+                row_height = 0;
+            }
+            if (y + height > self.size) return false;
+            chart.x = x;
+            chart.y = y;
+            x += width;
+            row_height = @max(row_height, height);
+        }
+        return true;
+    }
+
+
+    /// Texels a chart of `extent` world units takes, one more than the extent covers so its edges sit
+    /// on texel centers, and the padding on both sides
+    fn chartTexels(self: *const Baker, extent: f32, density: f32) u32 {
+        const texels: u32 = @intFromFloat(@min(@ceil(extent * density), @as(f32, @floatFromInt(self.size))));
+        return texels + 1 + 2 * self.config.padding;
+    }
+
+
+    // ============================================================
+    // Texels
+    // ============================================================
+
+    /// Write the lightmapped meshes and give every texel a chart covers its world position and normal
+    fn rasterize(self: *Baker) ![]BakedMesh {
+        const texel_count = @as(usize, self.size) * self.size;
+        self.texel_positions = try self.allocator.alloc(Vec3f, texel_count);
+        self.texel_normals = try self.allocator.alloc(Vec3f, texel_count);
+        self.covered = try self.allocator.alloc(bool, texel_count);
+        @memset(self.covered, false);
+        self.texels = try self.allocator.alloc([4]f16, texel_count);
+        @memset(self.texels, .{ 0.0, 0.0, 0.0, 0.0 });
+
+        const meshes = try self.allocator.alloc(BakedMesh, self.instances.len);
+        var built: usize = 0;
+        errdefer {
+            for (meshes[0..built]) |mesh| {
+                self.allocator.free(mesh.vertices);
+                self.allocator.free(mesh.indices);
+            }
+            self.allocator.free(meshes);
+        }
+
+        var vertices = std.ArrayList(LightmappedVertex).init(self.allocator);
+        defer vertices.deinit();
+        var indices = std.ArrayList(u32).init(self.allocator);
+        defer indices.deinit();
+        var remap = std.AutoHashMap(u64, u32).init(self.allocator);
+        defer remap.deinit();
+
+        var chart_index: usize = 0;
+        for (self.instances, 0..) |instance, i| {
+            vertices.clearRetainingCapacity();
+            indices.clearRetainingCapacity();
+            remap.clearRetainingCapacity();
+
+            // Charts were made instance by instance, so this instance's ones come next
+            while (chart_index < self.charts.items.len and self.charts.items[chart_index].instance == i) : (chart_index += 1) {
+                const chart = self.charts.items[chart_index];
+                for (self.chart_triangles[chart.first..][0..chart.count]) |t| {
+                    var texel_corners: [3][2]f32 = undefined;
+                    const corners = self.world_indices[t * 3 ..][0..3];
+                    for (corners, &texel_corners) |vertex, *texel| {
+                        texel.* = self.texelOf(chart, vertex);
+                        const key = (@as(u64, chart_index) << 32) | vertex;
+                        const entry = try remap.getOrPut(key);
+                        if (!entry.found_existing) {
+                            entry.value_ptr.* = @intCast(vertices.items.len);
+                            try vertices.append(self.lightmappedVertex(instance, vertex - self.vertex_base[i], texel.*));
+                        }
+                        try indices.append(entry.value_ptr.*);
+                    }
+                    self.rasterizeTriangle(texel_corners, corners.*);
+                }
+            }
+
+            const mesh_vertices = try vertices.toOwnedSlice();
+            errdefer self.allocator.free(mesh_vertices);
+            meshes[i] = .{ .name = instance.name, .vertices = mesh_vertices, .indices = try indices.toOwnedSlice() };
+            built += 1;
+        }
+        return meshes;
+    }
+
+
+    /// Lightmap position of a scene vertex in `chart`, in texels
+    fn texelOf(self: *const Baker, chart: Chart, vertex: u32) [2]f32 {
+        const uv = project(self.worldPosition(vertex), chart.axis);
+        const padding: f32 = @floatFromInt(self.config.padding);
+        return .{
+            @as(f32, @floatFromInt(chart.x)) + padding + 0.5 + (uv[0] - chart.min[0]) * self.density,
+            @as(f32, @floatFromInt(chart.y)) + padding + 0.5 + (uv[1] - chart.min[1]) * self.density,
+        };
+    }
+
+
+    fn lightmappedVertex(self: *const Baker, instance: BakeInstance, local: u32, texel: [2]f32) LightmappedVertex {
+        const stride: usize = instance.package_size;
+        const data = instance.vertices[local * stride ..][0..stride];
+        const size: f32 = @floatFromInt(self.size);
+        return .{
+            .position = data[0..3].*,
+            .normal = PackedNormal.init(Vec3f.create(data[3], data[4], data[5])),
+            .uv = if (stride == 8) .{ @floatCast(data[6]), @floatCast(data[7]) } else .{ 0.0, 0.0 },
+            .lightmap_uv = .{ unorm16(texel[0] / size), unorm16(texel[1] / size) },
+        };
+    }
+
+
+    /// Texels whose centers lie in the triangle, with the position and normal interpolated there
+    fn rasterizeTriangle(self: *Baker, texel: [3][2]f32, vertices: [3]u32) void {
+        const area = edgeFunction(texel[0], texel[1], texel[2]);
+        if (@abs(area) < 1e-8) return;
+        const size: f32 = @floatFromInt(self.size);
+        const x0: u32 = @intFromFloat(std.math.clamp(@floor(@min(texel[0][0], texel[1][0], texel[2][0])), 0.0, size));
+        const x1: u32 = @intFromFloat(std.math.clamp(@ceil(@max(texel[0][0], texel[1][0], texel[2][0])), 0.0, size));
+        const y0: u32 = @intFromFloat(std.math.clamp(@floor(@min(texel[0][1], texel[1][1], texel[2][1])), 0.0, size));
+        const y1: u32 = @intFromFloat(std.math.clamp(@ceil(@max(texel[0][1], texel[1][1], texel[2][1])), 0.0, size));
+        const positions = [3]Vec3f{ self.worldPosition(vertices[0]), self.worldPosition(vertices[1]), self.worldPosition(vertices[2]) };
+        const normals = [3]Vec3f{ self.world_normals[vertices[0]], self.world_normals[vertices[1]], self.world_normals[vertices[2]] };
+
+        const tolerance = -1e-4;
+        for (y0..y1) |y| {
+            for (x0..x1) |x| {
+                const center = [2]f32{ @as(f32, @floatFromInt(x)) + 0.5, @as(f32, @floatFromInt(y)) + 0.5 };
+                const w0 = edgeFunction(texel[1], texel[2], center) / area;
+                const w1 = edgeFunction(texel[2], texel[0], center) / area;
+                const w2 = 1.0 - w0 - w1;
+                if (w0 < tolerance or w1 < tolerance or w2 < tolerance) continue;
+
+                const index = y * self.size + x;
+                self.texel_positions[index] = positions[0].scale(w0).add(positions[1].scale(w1)).add(positions[2].scale(w2));
+                self.texel_normals[index] = normals[0].scale(w0).add(normals[1].scale(w1)).add(normals[2].scale(w2)).normalize();
+                self.covered[index] = true;
+            }
+        }
+    }
+
+
+    /// Job over lightmap rows start..end
+    fn lightRows(self: *Baker, start: usize, end: usize) void {
+        for (start * self.size..end * self.size) |index| {
+            if (!self.covered[index]) continue;
+            const irradiance = self.surfaceIrradiance(self.texel_positions[index], self.texel_normals[index]);
+            self.texels[index] = .{ @floatCast(irradiance[0]), @floatCast(irradiance[1]), @floatCast(irradiance[2]), 1.0 };
+        }
+    }
+
+
+    /// Grow the charts into their padding one ring of texels per pass, each new texel the mean of its covered neighbors
+    fn dilate(self: *Baker) !void {
+        const next = try self.allocator.dupe(bool, self.covered);
+        defer self.allocator.free(next);
+
+        const size: i64 = self.size;
+        for (0..self.config.padding) |_| {
+            for (0..self.size) |y| {
+                for (0..self.size) |x| {
+                    const index = y * self.size + x;
+                    if (self.covered[index]) continue;
+
+                    var sum = [3]f32{ 0.0, 0.0, 0.0 };
+                    var count: f32 = 0.0;
+                    for ([_]i64{ -1, 0, 1 }) |dy| {
+                        for ([_]i64{ -1, 0, 1 }) |dx| {
+                            const nx = @as(i64, @intCast(x)) + dx;
+                            const ny = @as(i64, @intCast(y)) + dy;
+                            if (nx < 0 or ny < 0 or nx >= size or ny >= size) continue;
+                            const neighbor: usize = @intCast(ny * size + nx);
+                            if (!self.covered[neighbor]) continue;
+                            for (&sum, self.texels[neighbor][0..3]) |*s, value| s.* += @as(f32, value);
+                            count += 1.0;
+                        }
+                    }
+                    if (count == 0.0) continue;
+                    self.texels[index] = .{ @floatCast(sum[0] / count), @floatCast(sum[1] / count), @floatCast(sum[2] / count), 1.0 };
+                    next[index] = true;
+                }
+            }
+            @memcpy(self.covered, next);
+        }
+    }
+
+
+    // ============================================================
+    // Probes
+    // ============================================================
+
+    /// Grid over the scene bounds, the spacing widened so no axis takes more than max_probes_per_axis
+    fn placeProbes(self: *Baker) !void {
+        const low = self.scene_bounds.min;
+        const high = self.scene_bounds.max;
+        const extent = [3]f32{ high.x - low.x, high.y - low.y, high.z - low.z };
+        const max_intervals: f32 = @floatFromInt(@max(self.config.max_probes_per_axis, 2) - 1);
+        const spacing = @max(self.config.probe_spacing, @max(extent[0], extent[1], extent[2]) / max_intervals);
+
+        var count: usize = 1;
+        for (&self.probe_counts, extent) |*axis_count, axis_extent| {
+            axis_count.* = @as(u32, @intFromFloat(@ceil(axis_extent / spacing))) + 1;
+            count *= axis_count.*;
+        }
+        self.probe_origin = .{ low.x, low.y, low.z };
+        self.probe_spacing = spacing;
+        self.probes = try self.allocator.alloc(IrradianceProbe, count);
+        @memset(self.probes, .{});
+    }
+
+
+    /// Job over probes start..end
+    fn lightProbes(self: *Baker, start: usize, end: usize) void {
+        const grid = ProbeGrid{ .origin = self.probe_origin, .spacing = self.probe_spacing, .counts = self.probe_counts, .probes = self.probes };
+        for (start..end) |index| {
+            const x: u32 = @intCast(index % self.probe_counts[0]);
+            const y: u32 = @intCast(index / self.probe_counts[0] % self.probe_counts[1]);
+            const z: u32 = @intCast(index / self.probe_counts[0] / self.probe_counts[1]);
+            const position = grid.positionOf(x, y, z);
+
+            const probe = &self.probes[index];
+            probe.addAmbient(self.config.ambient);
+            for (self.lights) |light| {
+                const direction, const distance, const falloff = lightAt(light, position) orelse continue;
+                if (self.occluded(position, direction, distance)) continue;
+                const strength = light.intensity * falloff;
+                probe.addLight(direction, .{ light.color[0] * strength, light.color[1] * strength, light.color[2] * strength });
+            }
+        }
+    }
+
+
+    // ============================================================
+    // Lighting
+    // ============================================================
+
+    /// Irradiance the diffuse term of ClusteredLighting would give, shadowed, plus the ambient
+    fn surfaceIrradiance(self: *const Baker, position: Vec3f, normal: Vec3f) [3]f32 {
+        var result = self.config.ambient;
+        const origin = position.add(normal.scale(self.config.shadow_bias));
+        for (self.lights) |light| {
+            const direction, const distance, const falloff = lightAt(light, origin) orelse continue;
+            const diffuse = normal.dot(direction);
+            if (diffuse <= 0.0) continue;
+            if (self.occluded(origin, direction, distance)) continue;
+            const strength = light.intensity * diffuse * falloff;
+            for (&result, light.color) |*channel, color| channel.* += color * strength;
+        }
+        return result;
+    }
+
+
+    /// Anything on the segment from `origin` along the unit `direction` for `distance`, the first bias skipped
+    fn occluded(self: *const Baker, origin: Vec3f, direction: Vec3f, distance: f32) bool {
+        const bias = self.config.shadow_bias;
+        if (distance <= bias) return false;
+        return self.bvh.raycast(Ray.init(origin.add(direction.scale(bias)), direction), distance - bias) != null;
+    }
+
+
+    fn faceNormal(self: *const Baker, triangle: u32) Vec3f {
+        const corners = self.world_indices[triangle * 3 ..][0..3];
+        const a = self.worldPosition(corners[0]);
+        return self.worldPosition(corners[1]).subtract(a).cross(self.worldPosition(corners[2]).subtract(a));
+    }
+
+
+    fn worldPosition(self: *const Baker, vertex: u32) Vec3f {
+        const p = self.world_positions[@as(usize, vertex) * 3 ..][0..3];
+        return Vec3f.create(p[0], p[1], p[2]);
+    }
+};
+
+
+// ============================================================
+// Private: Helper Functions
+// ============================================================
+
+/// Direction toward the light, its distance and the squared falloff, null out of its reach
+fn lightAt(light: PointLight, position: Vec3f) ?struct { Vec3f, f32, f32 } {
+    const to_light = Vec3f.create(light.position[0], light.position[1], light.position[2]).subtract(position);
+    const distance = to_light.length();
+    if (distance >= light.radius or distance <= 0.0) return null;
+    const falloff = 1.0 - distance / light.radius;
+    return .{ to_light.scale(1.0 / distance), distance, falloff * falloff };
+}
+
+
+/// `func(context, start, end)` over 0..count, split across `jobs` when given
+fn runRange(jobs: ?*JobSystem, count: usize, chunk_size: usize, context: *Baker, comptime func: fn (*Baker, usize, usize) void) void {
+    if (jobs) |pool| {
+        pool.parallelFor(count, chunk_size, context, func);
+    } else {
+        func(context, 0, count);
+    }
+}
+
+
+/// Dominant axis of a normal in the upper bits and its sign in the lowest
+fn axisKey(normal: Vec3f) u3 {
+    const magnitudes = [3]f32{ @abs(normal.x), @abs(normal.y), @abs(normal.z) };
+    const components = [3]f32{ normal.x, normal.y, normal.z };
+    var axis: u3 = 0;
+    if (magnitudes[1] > magnitudes[axis]) axis = 1;
+    if (magnitudes[2] > magnitudes[axis]) axis = 2;
+    return axis * 2 + @intFromBool(components[axis] < 0.0);
+}
+
+
+/// Coordinates in the plane across `axis`
+fn project(position: Vec3f, axis: u2) [2]f32 {
+    return switch (axis) {
+        0 => .{ position.y, position.z },
+        1 => .{ position.x, position.z },
+        else => .{ position.x, position.y },
+    };
+}
+
+
+fn transformNormal(matrix: Mat3f, normal: Vec3f) Vec3f {
+    const m = matrix.data;
+    return Vec3f.create(
+        m[0] * normal.x + m[3] * normal.y + m[6] * normal.z,
+        m[1] * normal.x + m[4] * normal.y + m[7] * normal.z,
+        m[2] * normal.x + m[5] * normal.y + m[8] * normal.z,
+    ).normalize();
+}
+
+
+/// Twice the signed area of the triangle a, b, p
+fn edgeFunction(a: [2]f32, b: [2]f32, p: [2]f32) f32 {
+    return (b[0] - a[0]) * (p[1] - a[1]) - (b[1] - a[1]) * (p[0] - a[0]);
+}
+
+
+fn unorm16(value: f32) u16 {
+    return @intFromFloat(@round(std.math.clamp(value, 0.0, 1.0) * 65535.0));
+}
+
+
+fn find(parents: []u32, triangle: u32) u32 {
+    var root = triangle;
+    while (parents[root] != root) root = parents[root];
+    // Point the whole path at the root, later finds take one step
+    var node = triangle;
+    while (parents[node] != root) {
+        const next = parents[node];
+        parents[node] = root;
+        node = next;
+    }
+    return root;
+}
+
+
+fn unite(parents: []u32, a: u32, b: u32) void {
+    const root_a = find(parents, a);
+    const root_b = find(parents, b);
+    if (root_a != root_b) parents[@max(root_a, root_b)] = @min(root_a, root_b);
+}
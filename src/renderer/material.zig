@@ -3,15 +3,20 @@ const std = @import("std");
 const c = @import("../bindings/c.zig");
 
 const err = @import("../core/gl.zig");
+const GLStateCache = @import("gl_state.zig").GLStateCache;
 
 const Shader = @import("shader.zig").Shader;
 const Texture = @import("texture.zig").Texture;
+const MaterialBuffer = @import("material_buffer.zig").MaterialBuffer;
 
 
 pub const Material = struct {
     shader: *Shader,
+    /// Change it through setColor, which keeps the material's record in step
     color: [4]f32,
     texture: ?*Texture,
+    /// Record in the shared MaterialBuffer, null when the buffer was full and the `color` uniform is set instead
+    slot: ?u32 = null,
 
     ref_count: std.atomic.Value(u32),
     allocator: std.mem.Allocator,
@@ -23,6 +28,9 @@ pub const Material = struct {
 
     /// Create a new material pointer.
     pub fn create(allocator: std.mem.Allocator, shader: *Shader, color: [4]f32, texture: ?*Texture) !*Material {
+        // First use of a shader from Shader.createDeferred
+        try shader.resolve();
+
         const material_ptr = try allocator.create(Material);
         errdefer allocator.destroy(material_ptr);
 
@@ -36,6 +44,7 @@ pub const Material = struct {
             .shader = shader,
             .color = color,
             .texture = texture,
+            .slot = MaterialBuffer.shared().allocate(.{ .color = color }),
         };
         return material_ptr;
     }
@@ -51,16 +60,37 @@ pub const Material = struct {
 
     /// Uses the material for rendering.
     pub fn use(self: *Material) !void {
-        c.glUseProgram(self.shader.program);
-        err.checkGLError("glUseProgram");
+        GLStateCache.current().useProgram(self.shader.program);
+
+        try self.apply();
+    }
+
 
-        // Set material-specific uniforms
-        try self.shader.setUniformVec4("color", self.color);
+    pub fn setColor(self: *Material, color: [4]f32) void {
+        self.color = color;
+        if (self.slot) |slot| MaterialBuffer.shared().write(slot, .{ .color = color });
+    }
+
+
+    /// Set the material uniforms and texture, assumes its shader program is already in use
+    /// Shaders reading the material block only get the record index, the rest comes from the shared buffer
+    pub fn apply(self: *Material) !void {
+        if (self.shader.has(.material_index)) {
+            MaterialBuffer.shared().flush();
+            if (self.slot) |slot| {
+                self.shader.setInt(.material_index, @intCast(slot));
+            } else {
+                self.shader.setInt(.material_index, -1);
+                self.shader.setVec4(.color, self.color);
+            }
+        } else if (self.shader.has(.color)) {
+            self.shader.setVec4(.color, self.color);
+        }
 
         // If a texture is provided, bind it and update the sampler uniform.
         if (self.texture) |tex| {
             tex.bind(0);
-            try self.shader.setUniformInt("texSampler", 0);
+            self.shader.setInt(.tex_sampler, 0);
         }
     }
 
@@ -79,6 +109,7 @@ pub const Material = struct {
         
             _ = self.shader.release();
             if (self.texture) |tex| _ = tex.release();
+            if (self.slot) |slot| MaterialBuffer.shared().release(slot);
             
             self.allocator.destroy(self);
         }
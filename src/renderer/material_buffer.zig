@@ -0,0 +1,116 @@
+// graphics/material_buffer.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const render_stats = @import("render_stats.zig");
+
+
+/// Uniform block binding of the material records, next to the camera block
+pub const material_block_binding = 1;
+
+/// Records in the block, 16 KiB of them: the smallest uniform block size GL 3.3 guarantees
+pub const max_materials = 16384 / @sizeOf(MaterialRecord);
+
+/// std140 declaration of the material records, shaders that include it get the block bound automatically
+/// Materials set `materialIndex` to their record, or to -1 with the `color` uniform when the buffer is full
+pub const material_block_glsl = std.fmt.comptimePrint(
+    \\struct MaterialRecord {{ vec4 color; }};
+    \\layout (std140) uniform MaterialBlock {{ MaterialRecord materialRecords[{d}]; }};
+    \\uniform int materialIndex;
+    \\uniform vec4 color;
+    \\vec4 materialColor() {{ return materialIndex >= 0 ? materialRecords[materialIndex].color : color; }}
+    \\
+, .{max_materials});
+
+
+/// std140 layout of one material, grows with the parameters of Material
+pub const MaterialRecord = extern struct {
+    color: [4]f32,
+};
+
+
+/// Parameters of every material in one uniform buffer, so a material switch only sets its index
+/// Records are written by Material.create and Material.setColor and uploaded before the next draw
+/// reading them, as one range covering every record changed since the last upload
+pub const MaterialBuffer = struct {
+    const Self = @This();
+
+    ubo: c.GLuint = 0,
+    /// CPU copy of the block, uploads are cut from it
+    records: [max_materials]MaterialRecord = undefined,
+    /// Slots available to allocate
+    free: std.StaticBitSet(max_materials) = std.StaticBitSet(max_materials).initFull(),
+    /// Records changed since the last upload, empty when dirty_begin >= dirty_end
+    dirty_begin: u32 = max_materials,
+    dirty_end: u32 = 0,
+
+    /// Buffers belong to the GL context, which is per thread like the state cache
+    threadlocal var shared_buffer: Self = .{};
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// The buffer of the GL context current on this thread
+    pub fn shared() *Self {
+        return &shared_buffer;
+    }
+
+
+    /// Claim a record holding `record`, null when every slot is taken
+    pub fn allocate(self: *Self, record: MaterialRecord) ?u32 {
+        const slot: u32 = @intCast(self.free.findFirstSet() orelse return null);
+        self.free.unset(slot);
+        self.write(slot, record);
+        return slot;
+    }
+
+
+    /// Give a slot back, its record is left as it is until the slot is taken again
+    pub fn release(self: *Self, slot: u32) void {
+        std.debug.assert(!self.free.isSet(slot));
+        self.free.set(slot);
+    }
+
+
+    pub fn write(self: *Self, slot: u32, record: MaterialRecord) void {
+        self.records[slot] = record;
+        self.dirty_begin = @min(self.dirty_begin, slot);
+        self.dirty_end = @max(self.dirty_end, slot + 1);
+    }
+
+
+    /// Upload the changed records and keep the block bound, cheap when nothing changed
+    pub fn flush(self: *Self) void {
+        if (self.ubo == 0) {
+            c.glGenBuffers(1, &self.ubo);
+            c.glBindBuffer(c.GL_UNIFORM_BUFFER, self.ubo);
+            c.glBufferData(c.GL_UNIFORM_BUFFER, @sizeOf(@TypeOf(self.records)), null, c.GL_DYNAMIC_DRAW);
+            c.glBindBufferBase(c.GL_UNIFORM_BUFFER, material_block_binding, self.ubo);
+            err.checkGLError("MaterialBuffer: glBufferData");
+        }
+        if (self.dirty_begin >= self.dirty_end) return;
+
+        const bytes = std.mem.sliceAsBytes(self.records[self.dirty_begin..self.dirty_end]);
+        GLStateCache.current().bufferSubData(c.GL_UNIFORM_BUFFER, self.ubo, self.dirty_begin * @sizeOf(MaterialRecord), bytes);
+        render_stats.countUpload(bytes.len);
+
+        self.dirty_begin = max_materials;
+        self.dirty_end = 0;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Delete the buffer, the records stay and are uploaded again by the next flush
+    pub fn deinit(self: *Self) void {
+        if (self.ubo != 0) c.glDeleteBuffers(1, &self.ubo);
+        self.ubo = 0;
+        self.dirty_begin = 0;
+        self.dirty_end = max_materials;
+    }
+};
@@ -0,0 +1,294 @@
+// graphics/material_table.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+
+const Material = @import("material.zig").Material;
+const Texture = @import("texture.zig").Texture;
+const TextureArray = @import("texture_atlas.zig").TextureArray;
+const Shader = @import("shader.zig").Shader;
+const camera_block_glsl = @import("shader.zig").camera_block_glsl;
+const instance_glsl = @import("shader.zig").instance_glsl;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const SamplerCache = @import("sampler_cache.zig").SamplerCache;
+
+
+pub const MaterialTableError = error{
+    /// Storage buffers are missing, the table is only read by the GPU culling draws
+    Unsupported,
+    /// Without bindless textures every material texture is copied into one array, so they must share a size
+    MixedTextureSizes,
+    /// Textures still waiting on a TextureLoader would be baked in as their placeholder
+    TexturePending,
+};
+
+
+/// How material shaders reach the textures
+pub const MaterialTableMode = enum {
+    /// ARB_bindless_texture, each material stores a resident handle
+    bindless,
+    /// One GL_TEXTURE_2D_ARRAY holding a copy of every texture, each material stores its layer
+    texture_array,
+};
+
+
+/// std430 layout of one entry of the Materials buffer
+const GpuMaterial = extern struct {
+    color: [4]f32,
+    /// Bindless handle as a uvec2, low word first
+    handle: [2]u32 = .{ 0, 0 },
+    /// Layer in the texture array or 0 with a handle, -1 for untextured materials
+    layer: i32 = -1,
+    padding: u32 = 0,
+};
+
+
+/// Every material of a scene in one storage buffer, read per instance by a shared shader
+/// GpuCuller.buildWithMaterials tags each instance with its material index, so draws of different
+/// materials on the same VAO go into one multi-draw with no texture or uniform changes between them
+/// Build it after the textures finished loading, later texture changes are not picked up
+pub const MaterialTable = struct {
+    const Self = @This();
+
+    /// Storage buffer binding of the Materials buffer
+    pub const materials_binding = 4;
+    /// Texture unit of the array in the texture_array mode
+    pub const array_unit = 0;
+
+    const vertex_source = "#version 430 core\n" ++ camera_block_glsl ++ instance_glsl ++
+        \\layout (location=0) in vec3 aPos;
+        \\layout (location=1) in vec2 aTexCoord;
+        \\layout (location=7) in uint aMaterial;
+        \\out vec2 TexCoord;
+        \\flat out uint Material;
+        \\void main() {
+        \\    gl_Position = viewProjection * instanceModel() * vec4(aPos, 1.0);
+        \\    TexCoord = aTexCoord;
+        \\    Material = aMaterial;
+        \\}
+    ;
+
+    const material_glsl =
+        \\struct MaterialData { vec4 color; uvec2 handle; int layer; uint padding; };
+        \\layout (std430, binding = 4) readonly buffer Materials { MaterialData materials[]; };
+        \\in vec2 TexCoord;
+        \\flat in uint Material;
+        \\out vec4 FragColor;
+        \\
+    ;
+
+    const bindless_fragment_source = "#version 430 core\n#extension GL_ARB_bindless_texture : require\n" ++ material_glsl ++
+        \\void main() {
+        \\    MaterialData m = materials[Material];
+        \\    vec4 texel = m.layer >= 0 ? texture(sampler2D(m.handle), TexCoord) : vec4(1.0);
+        \\    FragColor = texel * m.color;
+        \\}
+    ;
+
+    const array_fragment_source = "#version 430 core\n" ++ material_glsl ++
+        \\uniform sampler2DArray materialTextures;
+        \\void main() {
+        \\    MaterialData m = materials[Material];
+        \\    vec4 texel = m.layer >= 0 ? texture(materialTextures, vec3(TexCoord, float(m.layer))) : vec4(1.0);
+        \\    FragColor = texel * m.color;
+        \\}
+    ;
+
+    allocator: std.mem.Allocator,
+    mode: MaterialTableMode,
+    /// Index of every material in the buffer, each holds a reference
+    indices: std.AutoHashMap(*Material, u32),
+    /// Resident handles, made non-resident by deinit
+    handles: std.ArrayList(u64),
+    /// Copies of the material textures in the texture_array mode
+    array: ?*TextureArray = null,
+
+    buffer: c.GLuint,
+    /// Shared by every draw reading the table
+    shader: *Shader,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Upload `materials`, bindless when the driver allows it and through an array texture otherwise
+    /// Duplicates share one entry, the material colors and textures are copied as they are now
+    pub fn create(allocator: std.mem.Allocator, materials: []const *Material) !*Self {
+        if (!gl_ext.hasGpuCulling()) return MaterialTableError.Unsupported;
+
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+
+        const mode: MaterialTableMode = if (gl_ext.hasBindlessTextures()) .bindless else .texture_array;
+        const shader = try Shader.create(allocator, vertex_source, if (mode == .bindless) bindless_fragment_source else array_fragment_source);
+        errdefer _ = shader.release();
+
+        self.* = .{
+            .allocator = allocator,
+            .mode = mode,
+            .indices = std.AutoHashMap(*Material, u32).init(allocator),
+            .handles = std.ArrayList(u64).init(allocator),
+            .buffer = 0,
+            .shader = shader,
+        };
+        errdefer self.releaseContents();
+
+        var entries = std.ArrayList(GpuMaterial).init(allocator);
+        defer entries.deinit();
+
+        // Textured materials in entry order, turned into handles or array layers below
+        var textures = std.ArrayList(*Texture).init(allocator);
+        defer textures.deinit();
+        var texture_slots = std.AutoHashMap(*Texture, u32).init(allocator);
+        defer texture_slots.deinit();
+
+        for (materials) |material| {
+            const entry = try self.indices.getOrPut(material);
+            if (entry.found_existing) continue;
+            entry.value_ptr.* = @intCast(entries.items.len);
+            material.addRef();
+
+            var gpu = GpuMaterial{ .color = material.color };
+            if (material.texture) |texture| {
+                if (texture.pending) return MaterialTableError.TexturePending;
+                const slot = try texture_slots.getOrPut(texture);
+                if (!slot.found_existing) {
+                    slot.value_ptr.* = @intCast(textures.items.len);
+                    try textures.append(texture);
+                }
+                gpu.layer = @intCast(slot.value_ptr.*);
+            }
+            try entries.append(gpu);
+        }
+
+        switch (mode) {
+            .bindless => try self.makeResident(textures.items, entries.items),
+            .texture_array => try self.copyIntoArray(textures.items),
+        }
+
+        c.glGenBuffers(1, &self.buffer);
+        c.glBindBuffer(gl_ext.GL_SHADER_STORAGE_BUFFER, self.buffer);
+        const bytes = std.mem.sliceAsBytes(entries.items);
+        c.glBufferData(gl_ext.GL_SHADER_STORAGE_BUFFER, @intCast(bytes.len), bytes.ptr, c.GL_STATIC_DRAW);
+        err.checkGLError("MaterialTable: glBufferData");
+
+        if (mode == .texture_array) {
+            GLStateCache.current().useProgram(shader.program);
+            try shader.setUniformInt("materialTextures", array_unit);
+        }
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Buffer index of `material`, null if it was not part of create
+    pub fn indexOf(self: *const Self, material: *Material) ?u32 {
+        return self.indices.get(material);
+    }
+
+
+    pub fn materialCount(self: *const Self) usize {
+        return self.indices.count();
+    }
+
+
+    /// Fragment stage of the table's shader, for programs that feed it TexCoord and Material their own way
+    pub fn fragmentSource(self: *const Self) []const u8 {
+        return if (self.mode == .bindless) bindless_fragment_source else array_fragment_source;
+    }
+
+
+    /// Bind the table's program, its storage buffer and, in the texture_array mode, the array
+    pub fn bind(self: *Self) void {
+        GLStateCache.current().useProgram(self.shader.program);
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, materials_binding, self.buffer);
+        if (self.array) |array| array.bind(array_unit);
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn destroy(self: *Self) void {
+        self.releaseContents();
+        _ = self.shader.release();
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Resident handles with each texture's shared sampler, stored into the entries in place of the texture slot
+    fn makeResident(self: *Self, textures: []const *Texture, entries: []GpuMaterial) !void {
+        try self.handles.ensureTotalCapacity(textures.len);
+        for (textures) |texture| {
+            const sampler = SamplerCache.shared().get(texture.sampler);
+            const handle = if (sampler != 0) gl_ext.getTextureSamplerHandle.?(texture.id, sampler) else gl_ext.getTextureHandle.?(texture.id);
+            gl_ext.makeTextureHandleResident.?(handle);
+            self.handles.appendAssumeCapacity(handle);
+        }
+        err.checkGLError("MaterialTable: glMakeTextureHandleResidentARB");
+
+        for (entries) |*entry| {
+            if (entry.layer < 0) continue;
+            const handle = self.handles.items[@intCast(entry.layer)];
+            entry.handle = .{ @truncate(handle), @truncate(handle >> 32) };
+            entry.layer = 0;
+        }
+    }
+
+
+    /// Read level 0 of every texture back and upload the copies as the layers of one array
+    fn copyIntoArray(self: *Self, textures: []const *Texture) !void {
+        if (textures.len == 0) return;
+
+        const width = textures[0].width;
+        const height = textures[0].height;
+        for (textures) |texture| {
+            if (texture.width != width or texture.height != height) return MaterialTableError.MixedTextureSizes;
+        }
+
+        const layer_size: usize = @as(usize, @intCast(width)) * @as(usize, @intCast(height)) * 4;
+        const pixels = try self.allocator.alloc(u8, layer_size * textures.len);
+        defer self.allocator.free(pixels);
+        const layers = try self.allocator.alloc([]const u8, textures.len);
+        defer self.allocator.free(layers);
+
+        for (textures, 0..) |texture, i| {
+            const layer = pixels[i * layer_size ..][0..layer_size];
+            GLStateCache.current().bindTexture2D(0, texture.id);
+            c.glGetTexImage(c.GL_TEXTURE_2D, 0, c.GL_RGBA, c.GL_UNSIGNED_BYTE, layer.ptr);
+            layers[i] = layer;
+        }
+        err.checkGLError("MaterialTable: glGetTexImage");
+
+        const array = try TextureArray.create(self.allocator, @intCast(width), @intCast(height), layers);
+        array.setSampler(textures[0].sampler);
+        self.array = array;
+    }
+
+
+    /// Everything but the shader and the struct itself, safe on a partly created table
+    fn releaseContents(self: *Self) void {
+        for (self.handles.items) |handle| gl_ext.makeTextureHandleNonResident.?(handle);
+        self.handles.deinit();
+
+        if (self.array) |array| array.destroy();
+        self.array = null;
+
+        if (self.buffer != 0) c.glDeleteBuffers(1, &self.buffer);
+        self.buffer = 0;
+
+        var materials = self.indices.keyIterator();
+        while (materials.next()) |material| _ = material.*.release();
+        self.indices.deinit();
+    }
+};
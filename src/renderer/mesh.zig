@@ -3,21 +3,322 @@
 const std = @import("std");
 const c = @import("../bindings/c.zig");
 const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const DeletionBatch = @import("gl_state.zig").DeletionBatch;
+const render_stats = @import("render_stats.zig");
+const DynamicBuffer = @import("dynamic_buffer.zig").DynamicBuffer;
+const BoundingBox = @import("../math/bounds.zig").BoundingBox;
+const Affine3x4 = @import("../math/affine.zig").Affine3x4;
+const vector = @import("../math/vector.zig");
+const Vec2f = vector.Vec2f;
+const Vec3f = vector.Vec3f;
+const Vec4f = vector.Vec4f;
+const Quatf = @import("../math/quaternion.zig").Quatf;
+const GeometryPool = @import("geometry_pool.zig").GeometryPool;
+const mesh_optimizer = @import("mesh_optimizer.zig");
+const meshlet_module = @import("meshlet.zig");
+const Meshlet = meshlet_module.Meshlet;
+const TriangleBvh = @import("../math/triangle_bvh.zig").TriangleBvh;
 
 
 /// Error types for mesh operations
 pub const MeshError = error{
     InvalidPackageSize,
     InvalidVertexData,
+    /// A partial update reaches past the data currently in the buffer
+    RangeOutOfBounds,
+    /// Pooled meshes keep their vertex count, index count and layout, and can't be streamed
+    PooledMesh,
+    /// A partial index update of a 16-bit index buffer holds an index above 65535
+    IndexOutOfRange,
+    /// Only meshes stored as f32 can be read back, compact attributes don't survive the round trip
+    UnreadableFormat,
+    /// Meshes from createTyped take vertices of their own struct only, through updateTyped
+    TypedVertices,
+};
+
+
+/// How vertex attributes are stored in the VBO, input data is always f32
+pub const VertexFormat = enum {
+    /// Every attribute as f32
+    float,
+    /// Positions f32, normals GL_INT_2_10_10_10_REV, texture coordinates half floats, colors normalized u8
+    compact,
+    /// Laid out by the vertex struct given to Mesh.createTyped
+    typed,
+};
+
+
+/// Normal packed as GL_INT_2_10_10_10_REV like the compact layouts store it, for createTyped vertex structs
+pub const PackedNormal = extern struct {
+    bits: u32,
+
+    pub fn init(normal: Vec3f) PackedNormal {
+        return .{ .bits = packSnorm10(normal.x) | (packSnorm10(normal.y) << 10) | (packSnorm10(normal.z) << 20) };
+    }
+};
+
+
+/// Element type of an index buffer, picked per mesh from its largest index
+pub const IndexType = enum {
+    u16,
+    u32,
+
+    /// Smallest type holding every index
+    pub fn fit(indices: []const u32) IndexType {
+        for (indices) |index| {
+            if (index > std.math.maxInt(u16)) return .u32;
+        }
+        return .u16;
+    }
+
+    pub fn size(self: IndexType) usize {
+        return switch (self) {
+            .u16 => @sizeOf(u16),
+            .u32 => @sizeOf(u32),
+        };
+    }
+
+    pub fn toGLConstant(self: IndexType) c.GLenum {
+        return switch (self) {
+            .u16 => c.GL_UNSIGNED_SHORT,
+            .u32 => c.GL_UNSIGNED_INT,
+        };
+    }
+};
+
+
+/// First vertex attribute location of the per-instance world matrix, its three affine rows take 3 to 5
+/// Location 6 stays free so the attributes after it keep their numbers
+pub const instance_matrix_location = 3;
+/// Vertex attribute location of the per-instance material index read by MaterialTable.shader
+pub const instance_material_location = 7;
+/// Vertex attribute locations of the joint indices and weights of skinned meshes, past the instance attributes
+pub const skin_joints_location = 8;
+pub const skin_weights_location = 9;
+/// Vertex attribute location of the second UV channel baked lightmaps are addressed with, past the skin attributes
+pub const lightmap_uv_location = 10;
+
+
+/// Skinning data of one vertex, kept in a second buffer next to the VBO as the package sizes have no room for it
+pub const SkinVertex = extern struct {
+    /// Palette indices of up to four joints
+    joints: [4]u8,
+    /// Unorm8 weights of those joints, summing to 255
+    weights: [4]u8,
+
+    /// Quantize float weights, renormalizing them so no influence is lost to rounding
+    pub fn fromWeights(joints: [4]u8, weights: [4]f32) SkinVertex {
+        var total: f32 = 0.0;
+        for (weights) |weight| total += @max(weight, 0.0);
+        if (total <= 0.0) return .{ .joints = joints, .weights = .{ 255, 0, 0, 0 } };
+
+        var result = SkinVertex{ .joints = joints, .weights = undefined };
+        var sum: u32 = 0;
+        var largest: usize = 0;
+        for (weights, 0..) |weight, i| {
+            result.weights[i] = @intFromFloat(@round(@max(weight, 0.0) / total * 255.0));
+            sum += result.weights[i];
+            if (weights[i] > weights[largest]) largest = i;
+        }
+        // Rounding error goes to the strongest influence
+        const corrected = @as(i32, result.weights[largest]) + 255 - @as(i32, @intCast(sum));
+        result.weights[largest] = @intCast(std.math.clamp(corrected, 0, 255));
+        return result;
+    }
+};
+
+
+/// Layout of the per-instance transforms an instanced draw reads
+pub const InstanceFormat = enum(u1) {
+    /// Affine3x4 world matrices, 48 bytes
+    affine,
+    /// TrsInstance, 32 bytes, turned into a matrix by instanceModel() in the vertex shader
+    trs,
+};
+
+
+/// Position, rotation and uniform scale of one instance, for crowds whose matrices would only be built to be uploaded
+/// Non-uniform scales and parented transforms need Affine3x4 instances
+pub const TrsInstance = extern struct {
+    position: Vec3f,
+    scale: f32 = 1.0,
+    /// Unit quaternion
+    rotation: Quatf = Quatf.identity(),
+
+    pub fn init(position: Vec3f, rotation: Quatf, scale: f32) TrsInstance {
+        return .{ .position = position, .scale = scale, .rotation = rotation };
+    }
+
+    /// The matrix the vertex shader builds, for draws that take a model uniform instead
+    pub fn toAffine(self: TrsInstance) Affine3x4 {
+        return Affine3x4.compose(self.position, self.rotation, Vec3f.create(self.scale, self.scale, self.scale));
+    }
+};
+
+
+/// Instance buffer, first instance and layout a VAO's instance attributes point at, buffer 0 if none
+/// Lives with whoever owns the VAO, pooled meshes share the one of their pool section
+pub const InstanceSource = struct {
+    buffer: c.GLuint = 0,
+    offset: usize = 0,
+    format: InstanceFormat = .affine,
+    /// Instances drawn per attribute value, the view count of multi-view draws
+    divisor: u32 = 1,
+};
+
+
+/// Interleaved vertex and index data produced on the CPU, e.g. by mesh_optimizer or mesh_simplifier
+/// Owned by the caller
+/// Part of a mesh's index buffer, counted from the mesh's first index
+pub const IndexRange = struct {
+    first: u32,
+    count: u32,
+};
+
+
+pub const MeshData = struct {
+    vertices: []f32,
+    indices: []u32,
+    allocator: std.mem.Allocator,
+
+    pub fn deinit(self: *MeshData) void {
+        self.allocator.free(self.vertices);
+        self.allocator.free(self.indices);
+    }
+};
+
+
+/// Positions packed as xyz and the indices of a mesh, the CPU copy retained meshes keep
+/// Owned by the mesh, which passes its allocator in
+pub const CpuGeometry = struct {
+    positions: []f32,
+    indices: []u32,
+
+    pub fn vertexCount(self: CpuGeometry) usize {
+        return self.positions.len / 3;
+    }
+
+
+    pub fn byteSize(self: CpuGeometry) usize {
+        return self.positions.len * @sizeOf(f32) + self.indices.len * @sizeOf(u32);
+    }
+
+
+    /// Copy the positions of interleaved `data` from `first_vertex` on, resizing to its vertex count when `whole`
+    fn setPositions(self: *CpuGeometry, allocator: std.mem.Allocator, first_vertex: usize, data: []const f32, floats_per_vertex: usize, whole: bool) !void {
+        const count = data.len / floats_per_vertex;
+        if (whole) self.positions = try allocator.realloc(self.positions, count * 3);
+        for (self.positions[first_vertex * 3 ..][0 .. count * 3], 0..) |*position, i| {
+            position.* = data[i / 3 * floats_per_vertex + i % 3];
+        }
+    }
+
+
+    fn setIndices(self: *CpuGeometry, allocator: std.mem.Allocator, first_index: usize, indices: []const u32, whole: bool) !void {
+        if (whole) self.indices = try allocator.realloc(self.indices, indices.len);
+        @memcpy(self.indices[first_index..][0..indices.len], indices);
+    }
+
+
+    fn deinit(self: *CpuGeometry, allocator: std.mem.Allocator) void {
+        allocator.free(self.positions);
+        allocator.free(self.indices);
+    }
+};
+
+
+/// Vertex and index bytes exactly as a Mesh stores them in its VBO and EBO, e.g. for an AssetArchive
+/// Owned by the caller
+pub const EncodedMesh = struct {
+    vertices: []u8,
+    indices: []u8,
+    index_type: IndexType,
+    package_size: u4,
+    vertex_format: VertexFormat,
+    bounds: BoundingBox,
+    allocator: std.mem.Allocator,
+
+    /// Encode f32 vertex data and indices the way createInternal uploads them
+    pub fn init(allocator: std.mem.Allocator, data: []const f32, indices: []const u32, package_size: u4, vertex_format: VertexFormat) !EncodedMesh {
+        const floats_per_vertex = getFloatsPerVertex(package_size);
+        if (data.len % floats_per_vertex != 0) return MeshError.InvalidVertexData;
+
+        const vertices = try encodeVertices(allocator, data, package_size, vertex_format);
+        defer vertices.deinit(allocator);
+        const vertex_copy = try allocator.dupe(u8, vertices.bytes);
+        errdefer allocator.free(vertex_copy);
+
+        const index_type = IndexType.fit(indices);
+        const encoded_indices = try encodeIndices(allocator, indices, index_type);
+        defer encoded_indices.deinit(allocator);
+        const index_copy = try allocator.dupe(u8, encoded_indices.bytes);
+
+        return .{
+            .vertices = vertex_copy,
+            .indices = index_copy,
+            .index_type = index_type,
+            .package_size = package_size,
+            .vertex_format = vertex_format,
+            .bounds = BoundingBox.fromVertices(data, floats_per_vertex),
+            .allocator = allocator,
+        };
+    }
+
+    pub fn deinit(self: *EncodedMesh) void {
+        self.allocator.free(self.vertices);
+        self.allocator.free(self.indices);
+    }
 };
 
 
 /// Represents a 3D mesh with vertex and index buffers
+/// Either owns its VAO, VBO and EBO, or is a range of a GeometryPool section whose VAO it shares
 pub const Mesh = struct {
     vao: c.GLuint,
+    /// 0 for pooled meshes, their data lives in the section's buffers
     vbo: c.GLuint,
     ebo: c.GLuint,
     index_count: usize,
+    /// Pool section holding the data, null when the mesh owns its buffers
+    section: ?*GeometryPool.Section = null,
+    /// First vertex and first index of the mesh in the section's buffers
+    base_vertex: u32 = 0,
+    first_index: u32 = 0,
+    /// Object-space bounds of the vertex positions, kept up to date by every vertex update
+    bounds: BoundingBox,
+    /// Package size of the vertex data and the bytes of it in the VBO
+    package_size: u4,
+    vertex_bytes: usize,
+    /// Storage of the attributes in the VBO and of the indices in the EBO
+    vertex_format: VertexFormat = .float,
+    index_type: IndexType = .u32,
+    /// Allocated sizes of the VBO and EBO in bytes, data that fits is uploaded without reallocating
+    vertex_capacity: usize,
+    index_capacity: usize,
+    /// False after streamVertexData until the attributes point back at the VBO
+    attributes_on_vbo: bool = true,
+    /// Instance attribute source of the owned VAO, unused by pooled meshes
+    instance_source: InstanceSource = .{},
+    /// SkinVertex buffer of meshes created by createSkinned, 0 otherwise
+    skin_vbo: c.GLuint = 0,
+    skin_bytes: usize = 0,
+    /// Tightly packed f32 positions and the VAO reading only them, for depth-only passes, 0 unless
+    /// added by addPositionStream. Vertex updates keep the stream in step
+    position_vbo: c.GLuint = 0,
+    position_capacity: usize = 0,
+    depth_vao: c.GLuint = 0,
+    depth_instance_source: InstanceSource = .{},
+    /// Clusters GpuCuller culls one by one, empty unless created by createClustered
+    /// They describe the data they were built from, so every vertex or index update drops them
+    meshlets: []Meshlet = &.{},
+    /// Packed positions and the indices, null unless kept by createRetained or retainCpuCopy
+    /// Updates keep it in step with the buffers, so picking and collision can read the mesh without a reload
+    cpu_copy: ?CpuGeometry = null,
+    /// Triangle hierarchy for precise picking, built by pickingBvh from the CPU copy or given by buildPickingBvh
+    /// Dropped by vertex and index updates like the meshlets, a retained mesh rebuilds it on the next pick
+    picking_bvh: ?TriangleBvh = null,
 
     ref_count: std.atomic.Value(u32),
     allocator: std.mem.Allocator,
@@ -36,11 +337,167 @@ pub const Mesh = struct {
         if (data.len % floats_per_vertex != 0) return MeshError.InvalidVertexData;
 
         // Call createInternal directly since data is already properly formatted
-        return createInternal(allocator, data, indices, layout);
+        return createInternal(allocator, data, indices, layout, package_size, .float);
+    }
+
+
+    /// Like create, but packs the attributes into the compact vertex format on upload
+    /// Shaders see the same floats, normals and colors arrive normalized
+    pub fn createCompact(allocator: std.mem.Allocator, data: []const f32, indices: []const u32, package_size: u4) !*Mesh {
+        const layout = try getLayoutForFormat(package_size, .compact);
+        const floats_per_vertex = getFloatsPerVertex(package_size);
+
+        // Validate input data length
+        if (data.len % floats_per_vertex != 0) return MeshError.InvalidVertexData;
+
+        return createInternal(allocator, data, indices, layout, package_size, .compact);
+    }
+
+
+    /// Upload `vertices` as they are, in a layout derived from `V` at compile time
+    /// V is an extern struct with a `position` of three f32 and optionally a `normal`, `uv` or `tex_coord`
+    /// and `color`, in any order. Those may be f32, f16 or normalized 8 and 16 bit integer arrays, or a
+    /// PackedNormal, and fields named from an underscore are padding. The attribute set picks the package
+    /// size, and with it the shaders, as it does for create. A `lightmap_uv` goes to lightmap_uv_location
+    /// and leaves the package size alone. f32 vertex updates and readBack are refused
+    pub fn createTyped(allocator: std.mem.Allocator, comptime V: type, vertices: []const V, indices: []const u32) !*Mesh {
+        const layout = comptime VertexLayout.fromVertex(V);
+        const index_type = IndexType.fit(indices);
+        const encoded_indices = try encodeIndices(allocator, indices, index_type);
+        defer encoded_indices.deinit(allocator);
+
+        const bytes = std.mem.sliceAsBytes(vertices);
+        return uploadNew(allocator, bytes, encoded_indices.bytes, indices.len, index_type, layout, comptime typedPackageSize(V), .typed, typedBounds(V, vertices));
+    }
+
+
+    /// Like create, but welds duplicate vertices and reorders triangles and vertices for the
+    /// vertex cache and fetch first, worth it for imported meshes that are drawn often
+    pub fn createOptimized(allocator: std.mem.Allocator, data: []const f32, indices: []const u32, package_size: u4) !*Mesh {
+        var optimized = try mesh_optimizer.optimize(allocator, data, indices, package_size);
+        defer optimized.deinit();
+
+        return create(allocator, optimized.vertices, optimized.indices, package_size);
+    }
+
+
+    /// Like create, but splits the triangles into meshlets GpuCuller frustum- and backface-culls
+    /// individually, for large meshes like terrain that are only ever partly in view
+    pub fn createClustered(allocator: std.mem.Allocator, data: []const f32, indices: []const u32, package_size: u4) !*Mesh {
+        const clustered = try meshlet_module.buildMeshlets(allocator, data, indices, package_size);
+        errdefer allocator.free(clustered.meshlets);
+        defer allocator.free(clustered.indices);
+
+        const mesh = try create(allocator, data, clustered.indices, package_size);
+        mesh.meshlets = clustered.meshlets;
+        return mesh;
+    }
+
+
+    /// Like create, but keeps a CPU copy of the positions and indices, see retainCpuCopy
+    pub fn createRetained(allocator: std.mem.Allocator, data: []const f32, indices: []const u32, package_size: u4) !*Mesh {
+        const mesh = try create(allocator, data, indices, package_size);
+        errdefer _ = mesh.release();
+
+        try mesh.retainCpuCopy(data, indices);
+        return mesh;
+    }
+
+
+    /// Like createRetained, with the picking BVH built up front rather than on the first pick
+    pub fn createPickable(allocator: std.mem.Allocator, data: []const f32, indices: []const u32, package_size: u4) !*Mesh {
+        const mesh = try createRetained(allocator, data, indices, package_size);
+        errdefer _ = mesh.release();
+
+        _ = try mesh.pickingBvh();
+        return mesh;
+    }
+
+
+    /// Upload vertex and index bytes already in the VBO and EBO layout, with no conversion or copy
+    /// `bounds` is taken as given, the positions may not be f32 in the source
+    pub fn createFromEncoded(allocator: std.mem.Allocator, vertex_bytes: []const u8, index_bytes: []const u8, index_type: IndexType,
+        package_size: u4, vertex_format: VertexFormat, bounds: BoundingBox) !*Mesh {
+        const layout = try getLayoutForFormat(package_size, vertex_format);
+        if (vertex_bytes.len % layout.stride != 0 or index_bytes.len % index_type.size() != 0) return MeshError.InvalidVertexData;
+
+        return uploadNew(allocator, vertex_bytes, index_bytes, index_bytes.len / index_type.size(), index_type, layout, package_size, vertex_format, bounds);
+    }
+
+
+    /// Take over a VBO of `vertex_count` f32 vertices of `package_size` and an EBO of `index_count` indices,
+    /// e.g. filled through mapped memory by a MeshBuilder. Only the VAO is created, nothing is copied
+    pub fn createFromBuffers(allocator: std.mem.Allocator, vbo: c.GLuint, ebo: c.GLuint, vertex_count: usize, index_count: usize,
+        index_type: IndexType, package_size: u4, bounds: BoundingBox) !*Mesh {
+        const layout = try getLayoutFromPackageSize(package_size);
+        const mesh_ptr = try allocator.create(Mesh);
+        errdefer allocator.destroy(mesh_ptr);
+
+        var vao: c.GLuint = 0;
+        c.glGenVertexArrays(1, &vao);
+        err.checkGLError("glGenVertexArrays for vao");
+
+        const state = GLStateCache.current();
+        state.bindVertexArray(vao);
+        state.bindArrayBuffer(vbo);
+        c.glBindBuffer(c.GL_ELEMENT_ARRAY_BUFFER, ebo);
+        setupVertexAttributesInternal(layout);
+        state.bindVertexArray(0);
+
+        const vertex_bytes = vertex_count * layout.stride;
+        const index_bytes = index_count * index_type.size();
+        mesh_ptr.* = .{
+            .vao = vao,
+            .vbo = vbo,
+            .ebo = ebo,
+            .index_count = index_count,
+            .bounds = bounds,
+            .package_size = package_size,
+            .vertex_bytes = vertex_bytes,
+            .index_type = index_type,
+            .vertex_capacity = vertex_bytes,
+            .index_capacity = index_bytes,
+            .ref_count = std.atomic.Value(u32).init(1),
+            .allocator = allocator,
+        };
+        return mesh_ptr;
+    }
+
+
+    /// Like create, with a separate position stream for depth-only passes, see addPositionStream
+    /// Worth it for meshes drawn into a depth prepass or shadow maps, at 12 more bytes per vertex
+    pub fn createWithPositionStream(allocator: std.mem.Allocator, data: []const f32, indices: []const u32, package_size: u4) !*Mesh {
+        const mesh = try create(allocator, data, indices, package_size);
+        errdefer _ = mesh.release();
+
+        try mesh.addPositionStream(data);
+        return mesh;
     }
 
 
     /// Creates a quad mesh (assumes 5 floats per vertex: pos and tex coords)
+    /// Like create, with one SkinVertex per vertex read at skin_joints_location and skin_weights_location
+    /// The skin stream is separate from the VBO, so vertex updates keep it as long as the vertex count stays
+    pub fn createSkinned(allocator: std.mem.Allocator, data: []const f32, indices: []const u32, package_size: u4, skin: []const SkinVertex) !*Mesh {
+        if (data.len != skin.len * getFloatsPerVertex(package_size)) return MeshError.InvalidVertexData;
+        const mesh = try create(allocator, data, indices, package_size);
+        errdefer _ = mesh.release();
+
+        const state = GLStateCache.current();
+        c.glGenBuffers(1, &mesh.skin_vbo);
+        state.bindVertexArray(mesh.vao);
+        state.bindArrayBuffer(mesh.skin_vbo);
+        const bytes = std.mem.sliceAsBytes(skin);
+        c.glBufferData(c.GL_ARRAY_BUFFER, @intCast(bytes.len), bytes.ptr, c.GL_STATIC_DRAW);
+        err.checkGLError("createSkinned: glBufferData");
+        mesh.skin_bytes = bytes.len;
+
+        setupSkinAttributes(VertexLayout.Skin());
+        state.bindVertexArray(0);
+        return mesh;
+    }
+
+
     pub fn createQuad(allocator: std.mem.Allocator) !*Mesh {
         // Quad vertices: contains positions (x,y,z) and tex coords (u,v)
         const vertices = [_]f32{
@@ -130,15 +587,231 @@ pub const Mesh = struct {
 
     /// Binds the mesh's VAO for rendering
     pub fn bind(self: *Mesh) void {
-        c.glBindVertexArray(self.vao);
-        err.checkGLError("glBindVertexArray");
+        GLStateCache.current().bindVertexArray(self.vao);
     }
 
 
     /// Draws the mesh using the current shader
     pub fn draw(self: *Mesh) void {
-        c.glDrawElements(c.GL_TRIANGLES, @intCast(self.index_count), c.GL_UNSIGNED_INT, null);
+        const index_type = self.index_type.toGLConstant();
+        if (self.section != null) {
+            c.glDrawElementsBaseVertex(c.GL_TRIANGLES, @intCast(self.index_count), index_type, self.indexOffset(), @intCast(self.base_vertex));
+            err.checkGLError("glDrawElementsBaseVertex");
+            render_stats.countDraw(self.index_count, 1);
+            return;
+        }
+        c.glDrawElements(c.GL_TRIANGLES, @intCast(self.index_count), index_type, null);
         err.checkGLError("glDrawElements");
+        render_stats.countDraw(self.index_count, 1);
+    }
+
+
+    /// Draws `index_count` indices from `first_index` on, counted from the mesh's own first index
+    pub fn drawRange(self: *Mesh, first_index: usize, index_count: usize) void {
+        std.debug.assert(first_index + index_count <= self.index_count);
+        const index_type = self.index_type.toGLConstant();
+        const offset: ?*const anyopaque = @ptrFromInt((self.first_index + first_index) * self.index_type.size());
+        if (self.section != null) {
+            c.glDrawElementsBaseVertex(c.GL_TRIANGLES, @intCast(index_count), index_type, offset, @intCast(self.base_vertex));
+        } else {
+            c.glDrawElements(c.GL_TRIANGLES, @intCast(index_count), index_type, offset);
+        }
+        err.checkGLError("Mesh.drawRange");
+        render_stats.countDraw(index_count, 1);
+    }
+
+
+    /// Bind the VAO of depth-only passes, the position stream when the mesh has one and the full VAO otherwise
+    pub fn bindDepth(self: *Mesh) void {
+        GLStateCache.current().bindVertexArray(if (self.depth_vao != 0) self.depth_vao else self.vao);
+    }
+
+
+    /// Binds the VAO with its instance matrix attributes sourced from `buffer`, starting at matrix `first_instance`
+    pub fn bindInstanced(self: *Mesh, buffer: c.GLuint, first_instance: usize) void {
+        self.bind();
+        self.setInstanceSource(buffer, first_instance);
+    }
+
+
+    /// Point the instance matrix attributes at the Affine3x4 matrices in `buffer`, assumes the VAO is bound
+    /// The attribute setup is stored in the VAO, so it only happens when the source changes
+    pub fn setInstanceSource(self: *Mesh, buffer: c.GLuint, first_instance: usize) void {
+        self.setInstanceSourceFormat(buffer, first_instance, .affine);
+    }
+
+
+    /// Like setInstanceSource for the TrsInstances in `buffer`
+    /// The shader has to be told through its `trsInstances` uniform, Renderer draws do that per item
+    pub fn setTrsInstanceSource(self: *Mesh, buffer: c.GLuint, first_instance: usize) void {
+        self.setInstanceSourceFormat(buffer, first_instance, .trs);
+    }
+
+
+    pub fn setInstanceSourceFormat(self: *Mesh, buffer: c.GLuint, first_instance: usize, format: InstanceFormat) void {
+        self.setInstanceSourceViews(buffer, first_instance, format, 1);
+    }
+
+
+    /// Like setInstanceSourceFormat with every instance repeated for `views` consecutive instance IDs
+    pub fn setInstanceSourceViews(self: *Mesh, buffer: c.GLuint, first_instance: usize, format: InstanceFormat, views: u32) void {
+        const source = if (self.section) |section| &section.instance_source else &self.instance_source;
+        pointInstanceAttributes(source, buffer, first_instance, format, views);
+    }
+
+
+    /// Like setInstanceSourceFormat for the VAO bindDepth binds
+    pub fn setDepthInstanceSourceFormat(self: *Mesh, buffer: c.GLuint, first_instance: usize, format: InstanceFormat) void {
+        if (self.depth_vao == 0) return self.setInstanceSourceFormat(buffer, first_instance, format);
+        pointInstanceAttributes(&self.depth_instance_source, buffer, first_instance, format, 1);
+    }
+
+
+    /// Give the mesh a second copy of its positions in a buffer of their own, with a VAO reading only that
+    /// Depth-only passes bind it through bindDepth and fetch 12 bytes per vertex instead of the whole
+    /// interleaved vertex. `data` is the vertex data last uploaded, in the mesh's package size
+    pub fn addPositionStream(self: *Mesh, data: []const f32) !void {
+        // The section's buffers are shared, and so is its VAO
+        if (self.section != null) return MeshError.PooledMesh;
+        const floats_per_vertex = getFloatsPerVertex(self.package_size);
+        if (data.len % floats_per_vertex != 0) return MeshError.InvalidVertexData;
+
+        const state = GLStateCache.current();
+        if (self.depth_vao == 0) {
+            c.glGenVertexArrays(1, &self.depth_vao);
+            c.glGenBuffers(1, &self.position_vbo);
+            err.checkGLError("addPositionStream: gen");
+
+            state.bindVertexArray(self.depth_vao);
+            state.bindArrayBuffer(self.position_vbo);
+            c.glBindBuffer(c.GL_ELEMENT_ARRAY_BUFFER, self.ebo);
+            c.glVertexAttribPointer(0, 3, c.GL_FLOAT, c.GL_FALSE, 3 * @sizeOf(f32), null);
+            c.glEnableVertexAttribArray(0);
+            err.checkGLError("addPositionStream: attributes");
+            state.bindVertexArray(0);
+        }
+        try self.uploadPositions(0, data, floats_per_vertex, true);
+    }
+
+
+    /// Point the instance material index attribute at `buffer`, one u32 per instance, assumes the VAO is bound
+    /// Only MaterialTable draws read it, every batch sets it again as it's a single attribute
+    pub fn setMaterialSource(self: *Mesh, buffer: c.GLuint) void {
+        _ = self;
+        GLStateCache.current().bindArrayBuffer(buffer);
+        c.glVertexAttribIPointer(instance_material_location, 1, c.GL_UNSIGNED_INT, @sizeOf(u32), null);
+        c.glEnableVertexAttribArray(instance_material_location);
+        c.glVertexAttribDivisor(instance_material_location, 1);
+        err.checkGLError("setMaterialSource: instance attribute");
+    }
+
+
+    /// Draws `instance_count` instances of the mesh using the current shader
+    pub fn drawInstanced(self: *Mesh, instance_count: usize) void {
+        const index_type = self.index_type.toGLConstant();
+        if (self.section != null) {
+            c.glDrawElementsInstancedBaseVertex(c.GL_TRIANGLES, @intCast(self.index_count), index_type, self.indexOffset(), @intCast(instance_count), @intCast(self.base_vertex));
+            err.checkGLError("glDrawElementsInstancedBaseVertex");
+            render_stats.countDraw(self.index_count, instance_count);
+            return;
+        }
+        c.glDrawElementsInstanced(c.GL_TRIANGLES, @intCast(self.index_count), index_type, null, @intCast(instance_count));
+        err.checkGLError("glDrawElementsInstanced");
+        render_stats.countDraw(self.index_count, instance_count);
+    }
+
+
+    /// Video memory of the vertex and index data, only the used part of a pool section counts
+    pub fn residentBytes(self: *const Mesh) usize {
+        if (self.section != null) return self.vertex_bytes + self.index_count * self.index_type.size();
+        return self.vertex_capacity + self.index_capacity + self.skin_bytes + self.position_capacity;
+    }
+
+
+    /// System memory of the mesh, the vertex data itself only lives on the GPU
+    pub fn cpuBytes(self: *const Mesh) usize {
+        const copy_bytes = if (self.cpu_copy) |copy| copy.byteSize() else 0;
+        const bvh_bytes = if (self.picking_bvh) |*bvh| bvh.byteSize() else 0;
+        return @sizeOf(Mesh) + self.meshlets.len * @sizeOf(Meshlet) + copy_bytes + bvh_bytes;
+    }
+
+
+    /// Keep a copy of the positions of `data` and of `indices`, the data last uploaded
+    /// Costs 12 bytes per vertex and 4 per index, meshes that never call this keep nothing
+    pub fn retainCpuCopy(self: *Mesh, data: []const f32, indices: []const u32) !void {
+        const floats_per_vertex = getFloatsPerVertex(self.package_size);
+        if (data.len % floats_per_vertex != 0) return MeshError.InvalidVertexData;
+
+        var copy = CpuGeometry{ .positions = &.{}, .indices = &.{} };
+        errdefer copy.deinit(self.allocator);
+        try copy.setPositions(self.allocator, 0, data, floats_per_vertex, true);
+        try copy.setIndices(self.allocator, 0, indices, true);
+
+        self.releaseCpuCopy();
+        self.cpu_copy = copy;
+    }
+
+
+    /// Free the CPU copy and the picking BVH built from it
+    pub fn releaseCpuCopy(self: *Mesh) void {
+        if (self.cpu_copy) |*copy| copy.deinit(self.allocator);
+        self.cpu_copy = null;
+        self.dropPickingBvh();
+    }
+
+
+    /// Read the vertex data and the indices back from video memory in the form create takes them
+    /// Stalls until the GPU is done writing the buffers, meant for load-time work like StaticBatch
+    pub fn readBack(self: *Mesh, allocator: std.mem.Allocator) !MeshData {
+        if (self.vertex_format != .float) return MeshError.UnreadableFormat;
+
+        const vbo = if (self.section) |section| section.vbo else self.vbo;
+        const ebo = if (self.section) |section| section.ebo else self.ebo;
+        const vertex_offset = @as(usize, self.base_vertex) * getFloatsPerVertex(self.package_size) * @sizeOf(f32);
+        const index_offset = @as(usize, self.first_index) * self.index_type.size();
+
+        const vertices = try allocator.alloc(f32, self.vertex_bytes / @sizeOf(f32));
+        errdefer allocator.free(vertices);
+        const indices = try allocator.alloc(u32, self.index_count);
+        errdefer allocator.free(indices);
+
+        // The copy target leaves the cached array buffer and the VAO's element buffer alone
+        c.glBindBuffer(c.GL_COPY_READ_BUFFER, vbo);
+        c.glGetBufferSubData(c.GL_COPY_READ_BUFFER, @intCast(vertex_offset), @intCast(self.vertex_bytes), vertices.ptr);
+        c.glBindBuffer(c.GL_COPY_READ_BUFFER, ebo);
+        switch (self.index_type) {
+            .u32 => c.glGetBufferSubData(c.GL_COPY_READ_BUFFER, @intCast(index_offset), @intCast(indices.len * @sizeOf(u32)), indices.ptr),
+            .u16 => {
+                // Read into the back half, then widen front to back so no index is overwritten before it's read
+                const narrow = std.mem.bytesAsSlice(u16, std.mem.sliceAsBytes(indices)[indices.len * @sizeOf(u16) ..]);
+                c.glGetBufferSubData(c.GL_COPY_READ_BUFFER, @intCast(index_offset), @intCast(indices.len * @sizeOf(u16)), narrow.ptr);
+                for (indices, 0..) |*index, i| index.* = narrow[i];
+            },
+        }
+        c.glBindBuffer(c.GL_COPY_READ_BUFFER, 0);
+        err.checkGLError("Mesh.readBack");
+
+        return .{ .vertices = vertices, .indices = indices, .allocator = allocator };
+    }
+
+
+    /// Picking BVH of the mesh, built from the CPU copy on first use after creation or an update
+    /// Null when the mesh has neither a BVH nor a CPU copy to build one from
+    pub fn pickingBvh(self: *Mesh) !?*const TriangleBvh {
+        if (self.picking_bvh == null) {
+            const copy = self.cpu_copy orelse return null;
+            self.picking_bvh = try TriangleBvh.build(self.allocator, copy.positions, 3, copy.indices);
+        }
+        return &self.picking_bvh.?;
+    }
+
+
+    /// Build the picking BVH from the data last uploaded, replacing any earlier one
+    /// For meshes without a CPU copy, whose callers still hold the data and indices
+    pub fn buildPickingBvh(self: *Mesh, data: []const f32, indices: []const u32) !void {
+        const bvh = try TriangleBvh.build(self.allocator, data, getFloatsPerVertex(self.package_size), indices);
+        self.dropPickingBvh();
+        self.picking_bvh = bvh;
     }
     
 
@@ -148,84 +821,225 @@ pub const Mesh = struct {
 
     /// Updates the vertex data of an existing mesh
     /// This will replace all vertex data while keeping the same VAO and VBO
+    /// Data that fits the VBO orphans and refills it, and an unchanged layout keeps the attribute setup
     pub fn updateVertexData(self: *Mesh, data: []const f32, package_size: u4) !void {
-        const layout = try getLayoutFromPackageSize(package_size);
+        const layout = try getLayoutForFormat(package_size, self.vertex_format);
         const floats_per_vertex = getFloatsPerVertex(package_size);
 
         // Validate input data length
         if (data.len % floats_per_vertex != 0) return MeshError.InvalidVertexData;
+        self.dropDerivedData();
 
-        // Bind the VAO and update buffers
-        c.glBindVertexArray(self.vao);
-        err.checkGLError("updateVertexData: bind VAO");
+        if (self.section != null) {
+            try self.checkPooledVertices(data, package_size);
+            try self.updateVertexRange(0, data);
+            self.bounds = BoundingBox.fromVertices(data, floats_per_vertex);
+            return;
+        }
+        try self.retainPositions(0, data, floats_per_vertex, true);
+        try self.uploadPositions(0, data, floats_per_vertex, true);
 
-        // Update vertex buffer
-        c.glBindBuffer(c.GL_ARRAY_BUFFER, self.vbo);
-        err.checkGLError("updateVertexData: bind VBO");
-        c.glBufferData(c.GL_ARRAY_BUFFER, @intCast(data.len * @sizeOf(f32)), data.ptr, c.GL_STATIC_DRAW);
-        err.checkGLError("updateVertexData: glBufferData for vertices");
+        const encoded = try encodeVertices(self.allocator, data, package_size, self.vertex_format);
+        defer encoded.deinit(self.allocator);
 
-        // Set up vertex attributes
-        setupVertexAttributes(layout);
+        // Bind the VAO and update buffers
+        const state = GLStateCache.current();
+        state.bindVertexArray(self.vao);
+        state.bindArrayBuffer(self.vbo);
+        self.uploadVertices(encoded.bytes);
+        self.bounds = BoundingBox.fromVertices(data, floats_per_vertex);
 
-        // Make sure EBO is still bound to VAO
-        c.glBindBuffer(c.GL_ELEMENT_ARRAY_BUFFER, self.ebo);
-        err.checkGLError("updateVertexData: rebind EBO");
+        self.setVertexLayout(layout, package_size);
 
         // Unbind everything
         unbindBuffers();
     }
 
 
+    /// Replace the vertices of a mesh from createTyped, `V` has to give the same attributes as its own struct
+    pub fn updateTyped(self: *Mesh, comptime V: type, vertices: []const V) !void {
+        if (self.vertex_format != .typed or self.package_size != comptime typedPackageSize(V)) return MeshError.TypedVertices;
+        self.dropDerivedData();
+
+        // The CPU copy and the position stream hold packed f32 positions
+        if (self.cpu_copy != null or self.position_vbo != 0) {
+            const positions = try self.allocator.alloc(f32, vertices.len * 3);
+            defer self.allocator.free(positions);
+            for (vertices, 0..) |vertex, i| positions[i * 3 ..][0..3].* = @bitCast(vertex.position);
+            try self.retainPositions(0, positions, 3, true);
+            try self.uploadPositions(0, positions, 3, true);
+        }
+
+        const state = GLStateCache.current();
+        state.bindVertexArray(self.vao);
+        state.bindArrayBuffer(self.vbo);
+        self.uploadVertices(std.mem.sliceAsBytes(vertices));
+        self.bounds = typedBounds(V, vertices);
+
+        self.setVertexLayout(comptime VertexLayout.fromVertex(V), self.package_size);
+
+        unbindBuffers();
+    }
+
+
+    /// Overwrite vertices starting at `first_vertex` in place, the rest of the VBO is left untouched
+    /// `data` uses the mesh's current package size and must not reach past its last vertex
+    /// The bounds only grow, call Model.updateBounds afterwards for models using this mesh
+    pub fn updateVertexRange(self: *Mesh, first_vertex: usize, data: []const f32) !void {
+        const floats_per_vertex = getFloatsPerVertex(self.package_size);
+        if (data.len % floats_per_vertex != 0) return MeshError.InvalidVertexData;
+
+        const stride = (try getLayoutForFormat(self.package_size, self.vertex_format)).stride;
+        const offset = first_vertex * stride;
+        const size = data.len / floats_per_vertex * stride;
+        if (offset + size > self.vertex_bytes) return MeshError.RangeOutOfBounds;
+        if (size == 0) return;
+        self.dropDerivedData();
+        try self.retainPositions(first_vertex, data, floats_per_vertex, false);
+        try self.uploadPositions(first_vertex, data, floats_per_vertex, false);
+
+        const encoded = try encodeVertices(self.allocator, data, self.package_size, self.vertex_format);
+        defer encoded.deinit(self.allocator);
+
+        // Pooled meshes start `base_vertex` vertices into the section's buffer
+        const buffer = if (self.section) |section| section.vbo else self.vbo;
+        const base = self.base_vertex * stride;
+
+        GLStateCache.current().bufferSubData(c.GL_ARRAY_BUFFER, buffer, base + offset, encoded.bytes[0..size]);
+        render_stats.countUpload(size);
+
+        self.bounds = self.bounds.merge(BoundingBox.fromVertices(data, floats_per_vertex));
+    }
+
+
+    /// Stream this frame's vertex data through `stream` instead of respecifying the mesh's own VBO
+    /// The attributes point into the stream's current region until the next update, indices stay in the EBO
+    /// Streamed data is always read as f32, also for compact meshes
+    pub fn streamVertexData(self: *Mesh, stream: *DynamicBuffer, data: []const f32, package_size: u4) !void {
+        const layout = try getLayoutFromPackageSize(package_size);
+        const floats_per_vertex = getFloatsPerVertex(package_size);
+
+        // Validate input data length
+        if (data.len % floats_per_vertex != 0) return MeshError.InvalidVertexData;
+
+        // The section's VAO is shared, re-pointing it would move every other mesh in it
+        if (self.section != null) return MeshError.PooledMesh;
+
+        const offset = try stream.write(std.mem.sliceAsBytes(data), @sizeOf(f32));
+        self.bounds = BoundingBox.fromVertices(data, floats_per_vertex);
+        if (self.cpu_copy != null) {
+            self.dropPickingBvh();
+            try self.retainPositions(0, data, floats_per_vertex, true);
+        }
+        try self.uploadPositions(0, data, floats_per_vertex, true);
+
+        const state = GLStateCache.current();
+        state.bindVertexArray(self.vao);
+        state.bindArrayBuffer(stream.buffer);
+
+        // Set up vertex attributes, this also disables the instance attributes
+        setupVertexAttributes(layout, offset);
+        self.instance_source = .{};
+        self.attributes_on_vbo = false;
+    }
+
+
     /// Updates the index data of an existing mesh
     pub fn updateIndexData(self: *Mesh, indices: []const u32) !void {
+        self.dropDerivedData();
+
+        if (self.section != null) {
+            if (indices.len != self.index_count) return MeshError.PooledMesh;
+            return self.updateIndexRange(0, indices);
+        }
+        try self.retainIndices(0, indices, true);
+
         // Bind the VAO to ensure we're updating the correct buffer
-        c.glBindVertexArray(self.vao);
-        err.checkGLError("updateIndexData: bind VAO");
+        GLStateCache.current().bindVertexArray(self.vao);
+
+        const index_type = IndexType.fit(indices);
+        const encoded = try encodeIndices(self.allocator, indices, index_type);
+        defer encoded.deinit(self.allocator);
 
         // Update element buffer
         c.glBindBuffer(c.GL_ELEMENT_ARRAY_BUFFER, self.ebo);
         err.checkGLError("updateIndexData: bind EBO");
-        c.glBufferData(c.GL_ELEMENT_ARRAY_BUFFER, @intCast(indices.len * @sizeOf(u32)), indices.ptr, c.GL_STATIC_DRAW);
-        err.checkGLError("updateIndexData: glBufferData for indices");
-
-        // Update index count
-        self.index_count = indices.len;
+        self.uploadIndices(encoded.bytes, indices.len, index_type);
 
         // Unbind everything
         unbindBuffers();
     }
 
 
+    /// Overwrite indices starting at `first_index` in place, must not reach past the last index
+    pub fn updateIndexRange(self: *Mesh, first_index: usize, indices: []const u32) !void {
+        if (first_index + indices.len > self.index_count) return MeshError.RangeOutOfBounds;
+        if (indices.len == 0) return;
+
+        // The buffer keeps its index type, a full updateIndexData is needed to widen it
+        if (self.index_type == .u16 and IndexType.fit(indices) == .u32) return MeshError.IndexOutOfRange;
+        self.dropDerivedData();
+        try self.retainIndices(first_index, indices, false);
+
+        const encoded = try encodeIndices(self.allocator, indices, self.index_type);
+        defer encoded.deinit(self.allocator);
+
+        const offset = (self.first_index + first_index) * self.index_type.size();
+        if (gl_ext.namedBufferSubData != null) {
+            const ebo = if (self.section) |section| section.ebo else self.ebo;
+            GLStateCache.current().bufferSubData(c.GL_ELEMENT_ARRAY_BUFFER, ebo, offset, encoded.bytes);
+        } else {
+            // The element buffer binding belongs to the VAO, so a pooled mesh reaches its section's EBO
+            GLStateCache.current().bindVertexArray(self.vao);
+            c.glBufferSubData(c.GL_ELEMENT_ARRAY_BUFFER, @intCast(offset), @intCast(encoded.bytes.len), encoded.bytes.ptr);
+            err.checkGLError("updateIndexRange: glBufferSubData");
+        }
+        render_stats.countUpload(encoded.bytes.len);
+    }
+
+
     /// Updates both vertex and index data of an existing mesh
     pub fn updateMesh(self: *Mesh, data: []const f32, indices: []const u32, package_size: u4) !void {
-        const layout = try getLayoutFromPackageSize(package_size);
+        const layout = try getLayoutForFormat(package_size, self.vertex_format);
         const floats_per_vertex = getFloatsPerVertex(package_size);
 
         // Validate input data length
         if (data.len % floats_per_vertex != 0) return MeshError.InvalidVertexData;
+        self.dropDerivedData();
+
+        if (self.section != null) {
+            try self.checkPooledVertices(data, package_size);
+            if (indices.len != self.index_count) return MeshError.PooledMesh;
+            try self.updateVertexRange(0, data);
+            try self.updateIndexRange(0, indices);
+            self.bounds = BoundingBox.fromVertices(data, floats_per_vertex);
+            return;
+        }
+        try self.retainPositions(0, data, floats_per_vertex, true);
+        try self.retainIndices(0, indices, true);
+        try self.uploadPositions(0, data, floats_per_vertex, true);
+
+        const vertices = try encodeVertices(self.allocator, data, package_size, self.vertex_format);
+        defer vertices.deinit(self.allocator);
+        const index_type = IndexType.fit(indices);
+        const encoded_indices = try encodeIndices(self.allocator, indices, index_type);
+        defer encoded_indices.deinit(self.allocator);
 
         // Single VAO bind/unbind for the entire operation
-        c.glBindVertexArray(self.vao);
-        err.checkGLError("updateMesh: bind VAO");
+        const state = GLStateCache.current();
+        state.bindVertexArray(self.vao);
         
         // Update vertex buffer
-        c.glBindBuffer(c.GL_ARRAY_BUFFER, self.vbo);
-        err.checkGLError("updateMesh: bind VBO");
-        c.glBufferData(c.GL_ARRAY_BUFFER, @intCast(data.len * @sizeOf(f32)), data.ptr, c.GL_STATIC_DRAW);
-        err.checkGLError("updateMesh: glBufferData for vertices");
+        state.bindArrayBuffer(self.vbo);
+        self.uploadVertices(vertices.bytes);
+        self.bounds = BoundingBox.fromVertices(data, floats_per_vertex);
 
-        // Set up vertex attributes
-        setupVertexAttributes(layout);
+        self.setVertexLayout(layout, package_size);
 
         // Update index buffer
         c.glBindBuffer(c.GL_ELEMENT_ARRAY_BUFFER, self.ebo);
         err.checkGLError("updateMesh: bind EBO");
-        c.glBufferData(c.GL_ELEMENT_ARRAY_BUFFER, @intCast(indices.len * @sizeOf(u32)), indices.ptr, c.GL_STATIC_DRAW);
-        err.checkGLError("updateMesh: glBufferData for indices");
-
-        // Update index count
-        self.index_count = indices.len;
+        self.uploadIndices(encoded_indices.bytes, indices.len, index_type);
 
         // Unbind everything
         unbindBuffers();
@@ -255,7 +1069,21 @@ pub const Mesh = struct {
     // Private Helper Functions
     // ============================================================
 
-    fn createInternal(allocator: std.mem.Allocator, vertex_data: []const f32, indices: []const u32, layout: VertexLayout) !*Mesh {
+    fn createInternal(allocator: std.mem.Allocator, vertex_data: []const f32, indices: []const u32, layout: VertexLayout, package_size: u4, vertex_format: VertexFormat) !*Mesh {
+        const vertices = try encodeVertices(allocator, vertex_data, package_size, vertex_format);
+        defer vertices.deinit(allocator);
+        const index_type = IndexType.fit(indices);
+        const encoded_indices = try encodeIndices(allocator, indices, index_type);
+        defer encoded_indices.deinit(allocator);
+
+        const bounds = BoundingBox.fromVertices(vertex_data, getFloatsPerVertex(package_size));
+        return uploadNew(allocator, vertices.bytes, encoded_indices.bytes, indices.len, index_type, layout, package_size, vertex_format, bounds);
+    }
+
+
+    /// Create the VAO, VBO and EBO of a new mesh from encoded bytes
+    fn uploadNew(allocator: std.mem.Allocator, vertex_bytes: []const u8, index_bytes: []const u8, index_count: usize, index_type: IndexType,
+        layout: VertexLayout, package_size: u4, vertex_format: VertexFormat, bounds: BoundingBox) !*Mesh {
         const mesh_ptr = try allocator.create(Mesh);
         errdefer allocator.destroy(mesh_ptr);
 
@@ -274,29 +1102,37 @@ pub const Mesh = struct {
         err.checkGLError("glGenBuffers for ebo");
 
         // Set up VAO
-        c.glBindVertexArray(vao);
+        const state = GLStateCache.current();
+        state.bindVertexArray(vao);
 
         // Vertex buffer
-        c.glBindBuffer(c.GL_ARRAY_BUFFER, vbo);
-        c.glBufferData(c.GL_ARRAY_BUFFER, @intCast(vertex_data.len * @sizeOf(f32)), vertex_data.ptr, c.GL_STATIC_DRAW);
+        state.bindArrayBuffer(vbo);
+        c.glBufferData(c.GL_ARRAY_BUFFER, @intCast(vertex_bytes.len), vertex_bytes.ptr, c.GL_STATIC_DRAW);
         err.checkGLError("glBufferData for vertices");
 
         // Element buffer
         c.glBindBuffer(c.GL_ELEMENT_ARRAY_BUFFER, ebo);
-        c.glBufferData(c.GL_ELEMENT_ARRAY_BUFFER, @intCast(indices.len * @sizeOf(u32)), indices.ptr, c.GL_STATIC_DRAW);
+        c.glBufferData(c.GL_ELEMENT_ARRAY_BUFFER, @intCast(index_bytes.len), index_bytes.ptr, c.GL_STATIC_DRAW);
         err.checkGLError("glBufferData for indices");
 
         // Set up vertex attributes based on layout
         setupVertexAttributesInternal(layout);
 
-        c.glBindVertexArray(0); // Unbind VAO
+        state.bindVertexArray(0); // Unbind VAO
 
         // Initialize the mesh
         mesh_ptr.* = .{
             .vao = vao,
             .vbo = vbo,
             .ebo = ebo,
-            .index_count = indices.len,
+            .index_count = index_count,
+            .bounds = bounds,
+            .package_size = package_size,
+            .vertex_bytes = vertex_bytes.len,
+            .vertex_format = vertex_format,
+            .index_type = index_type,
+            .vertex_capacity = vertex_bytes.len,
+            .index_capacity = index_bytes.len,
             .ref_count = std.atomic.Value(u32).init(1),
             .allocator = allocator,
         };
@@ -305,12 +1141,114 @@ pub const Mesh = struct {
     }
 
 
+    /// Byte offset of the first index in the bound EBO, as glDrawElements takes it
+    fn indexOffset(self: *const Mesh) ?*const anyopaque {
+        return @ptrFromInt(@as(usize, self.first_index) * self.index_type.size());
+    }
+
+
+    /// Full replacements of pooled meshes have to match the range they were allocated
+    fn checkPooledVertices(self: *const Mesh, data: []const f32, package_size: u4) !void {
+        if (package_size != self.package_size or data.len * @sizeOf(f32) != self.vertex_bytes) {
+            return MeshError.PooledMesh;
+        }
+    }
+
+
+    /// Replace the VBO contents with encoded vertices, assumes the VBO is bound
+    fn uploadVertices(self: *Mesh, bytes: []const u8) void {
+        uploadBuffer(c.GL_ARRAY_BUFFER, &self.vertex_capacity, bytes);
+        self.vertex_bytes = bytes.len;
+    }
+
+
+    /// Replace the EBO contents with `count` indices of `index_type`, assumes the VAO is bound
+    fn uploadIndices(self: *Mesh, bytes: []const u8, count: usize, index_type: IndexType) void {
+        uploadBuffer(c.GL_ELEMENT_ARRAY_BUFFER, &self.index_capacity, bytes);
+        self.index_count = count;
+        self.index_type = index_type;
+    }
+
+
+    /// Point the attributes at the VBO unless they already describe `layout` there
+    /// Assumes the VAO and VBO are bound
+    fn setVertexLayout(self: *Mesh, layout: VertexLayout, package_size: u4) void {
+        if (self.attributes_on_vbo and self.package_size == package_size) return;
+
+        // Set up vertex attributes, this also disables the instance attributes
+        setupVertexAttributes(layout, 0);
+        self.instance_source = .{};
+        self.attributes_on_vbo = true;
+        self.package_size = package_size;
+    }
+
+
+    /// Meshlets and the picking BVH no longer match once vertices or indices change
+    fn dropDerivedData(self: *Mesh) void {
+        self.allocator.free(self.meshlets);
+        self.meshlets = &.{};
+        self.dropPickingBvh();
+    }
+
+
+    fn dropPickingBvh(self: *Mesh) void {
+        if (self.picking_bvh) |*bvh| bvh.deinit();
+        self.picking_bvh = null;
+    }
+
+
+    /// Mirror a vertex update into the CPU copy, if the mesh keeps one
+    fn retainPositions(self: *Mesh, first_vertex: usize, data: []const f32, floats_per_vertex: usize, whole: bool) !void {
+        if (self.cpu_copy) |*copy| try copy.setPositions(self.allocator, first_vertex, data, floats_per_vertex, whole);
+    }
+
+
+    /// Mirror a vertex update into the position stream, if the mesh has one
+    fn uploadPositions(self: *Mesh, first_vertex: usize, data: []const f32, floats_per_vertex: usize, whole: bool) !void {
+        if (self.position_vbo == 0) return;
+
+        const count = data.len / floats_per_vertex;
+        const positions = try self.allocator.alloc(f32, count * 3);
+        defer self.allocator.free(positions);
+        for (0..count) |vertex| positions[vertex * 3 ..][0..3].* = data[vertex * floats_per_vertex ..][0..3].*;
+        const bytes = std.mem.sliceAsBytes(positions);
+
+        const state = GLStateCache.current();
+        if (whole) {
+            state.bindArrayBuffer(self.position_vbo);
+            uploadBuffer(c.GL_ARRAY_BUFFER, &self.position_capacity, bytes);
+            return;
+        }
+        state.bufferSubData(c.GL_ARRAY_BUFFER, self.position_vbo, first_vertex * 3 * @sizeOf(f32), bytes);
+        render_stats.countUpload(bytes.len);
+    }
+
+
+    /// Mirror an index update into the CPU copy, if the mesh keeps one
+    fn retainIndices(self: *Mesh, first_index: usize, indices: []const u32, whole: bool) !void {
+        if (self.cpu_copy) |*copy| try copy.setIndices(self.allocator, first_index, indices, whole);
+    }
+
+
     // Clean up OpenGL resources
+
+
     fn deinit(self: *Mesh) void {
-        c.glDeleteVertexArrays(1, &self.vao);
-        c.glDeleteBuffers(1, &self.vbo);
-        c.glDeleteBuffers(1, &self.ebo);
-        err.checkGLError("Mesh cleanup");
+        self.dropDerivedData();
+        self.releaseCpuCopy();
+        if (self.section) |section| {
+            section.free(self);
+            return;
+        }
+
+        // One call per object type, GL skips the zero names of absent skin and depth objects
+        const vertex_arrays = [_]c.GLuint{ self.vao, self.depth_vao };
+        const buffers = [_]c.GLuint{ self.vbo, self.ebo, self.skin_vbo, self.position_vbo };
+        const state = GLStateCache.current();
+        for (vertex_arrays) |vao| state.forgetVertexArray(vao);
+        for (buffers) |buffer| state.forgetBuffer(buffer);
+        DeletionBatch.deleteVertexArrays(&vertex_arrays);
+        DeletionBatch.deleteBuffers(&buffers);
     }
 };
 
@@ -328,7 +1266,7 @@ pub const VertexLayout = struct {
     pub fn init(descriptors: []const VertexAttributeDescriptor) VertexLayout {
         var stride: usize = 0;
         for (descriptors) |desc| {
-            stride += getAttributeSize(desc.attribute_type) * @sizeOf(f32);
+            stride += desc.byteSize();
         }
         return .{ .descriptors = descriptors, .stride = stride };
     }
@@ -344,6 +1282,10 @@ pub const VertexLayout = struct {
             .Position => 3,
             .TexCoord => 2,
             .Normal => 3,
+            .Color => 4,
+            .Joints => 4,
+            .Weights => 4,
+            .LightmapUV => 2,
         };
     }
 
@@ -353,9 +1295,19 @@ pub const VertexLayout = struct {
         var offset: usize = 0;
         var i: usize = 0;
         while (i < attr_index) : (i += 1) {
-            offset += getAttributeSize(self.descriptors[i].attribute_type) * @sizeOf(f32);
+            offset = self.descriptors[i].offsetAfter(offset) + self.descriptors[i].byteSize();
         }
-        return offset;
+        return self.descriptors[attr_index].offsetAfter(offset);
+    }
+
+
+    // ============================================================
+    // Public API: Layouts From Vertex Structs
+    // ============================================================
+
+    /// Attributes of the fields of `V` in location order, at the fields' offsets, see Mesh.createTyped
+    pub fn fromVertex(comptime V: type) VertexLayout {
+        return .{ .descriptors = comptime typedDescriptors(V), .stride = @sizeOf(V) };
     }
 
 
@@ -393,13 +1345,124 @@ pub const VertexLayout = struct {
             .{ .attribute_type = .Position, .data_type = c.GL_FLOAT },
         });
     }
+
+
+    pub fn PosColor() VertexLayout {
+        return init(&.{
+            .{ .attribute_type = .Position, .data_type = c.GL_FLOAT },
+            .{ .attribute_type = .Color, .data_type = c.GL_FLOAT },
+        });
+    }
+
+
+    // ============================================================
+    // Public API: Compact Vertex Layouts
+    // ============================================================
+    // Same attributes and locations as above, 20, 16, 16 and 16 bytes per vertex instead of 32, 24, 20 and 28
+
+    pub fn PosNormTexCompact() VertexLayout {
+        return init(&.{
+            .{ .attribute_type = .Position, .data_type = c.GL_FLOAT },
+            .{ .attribute_type = .Normal, .data_type = c.GL_INT_2_10_10_10_REV },
+            .{ .attribute_type = .TexCoord, .data_type = c.GL_HALF_FLOAT },
+        });
+    }
+
+
+    pub fn PosNormCompact() VertexLayout {
+        return init(&.{
+            .{ .attribute_type = .Position, .data_type = c.GL_FLOAT },
+            .{ .attribute_type = .Normal, .data_type = c.GL_INT_2_10_10_10_REV },
+        });
+    }
+
+
+    pub fn PosTexCompact() VertexLayout {
+        return init(&.{
+            .{ .attribute_type = .Position, .data_type = c.GL_FLOAT },
+            .{ .attribute_type = .TexCoord, .data_type = c.GL_HALF_FLOAT },
+        });
+    }
+
+
+    pub fn PosColorCompact() VertexLayout {
+        return init(&.{
+            .{ .attribute_type = .Position, .data_type = c.GL_FLOAT },
+            .{ .attribute_type = .Color, .data_type = c.GL_UNSIGNED_BYTE },
+        });
+    }
+
+
+    // ============================================================
+    // Public API: Skinning Layout
+    // ============================================================
+    // The SkinVertex stream, joint indices as u8x4 integers and weights as unorm8x4
+
+    pub fn Skin() VertexLayout {
+        return init(&.{
+            .{ .attribute_type = .Joints, .data_type = c.GL_UNSIGNED_BYTE },
+            .{ .attribute_type = .Weights, .data_type = c.GL_UNSIGNED_BYTE },
+        });
+    }
 };
 
 
 /// Descriptor for a vertex attribute
 pub const VertexAttributeDescriptor = struct {
     attribute_type: AttributeType,
+    /// GL_FLOAT, GL_HALF_FLOAT, GL_INT_2_10_10_10_REV, GL_UNSIGNED_BYTE,
+    /// or GL_BYTE, GL_SHORT and GL_UNSIGNED_SHORT of typed layouts
     data_type: c.GLenum,
+    /// Byte offset in the vertex, null to follow the previous attribute
+    offset: ?usize = null,
+
+    /// Bytes the attribute takes per vertex
+    pub fn byteSize(self: VertexAttributeDescriptor) usize {
+        const components = VertexLayout.getAttributeSize(self.attribute_type);
+        return switch (self.data_type) {
+            c.GL_HALF_FLOAT, c.GL_SHORT, c.GL_UNSIGNED_SHORT => components * @sizeOf(u16),
+            c.GL_UNSIGNED_BYTE, c.GL_BYTE => components,
+            // Three components and two padding bits in one word
+            c.GL_INT_2_10_10_10_REV => @sizeOf(u32),
+            else => components * @sizeOf(f32),
+        };
+    }
+
+
+    /// Components as glVertexAttribPointer takes them, packed formats are always four wide
+    pub fn glComponentCount(self: VertexAttributeDescriptor) c.GLint {
+        if (self.data_type == c.GL_INT_2_10_10_10_REV) return 4;
+        return @intCast(VertexLayout.getAttributeSize(self.attribute_type));
+    }
+
+
+    /// Integer formats are read as normalized floats, except joint indices
+    pub fn isNormalized(self: VertexAttributeDescriptor) bool {
+        if (self.isInteger()) return false;
+        return switch (self.data_type) {
+            c.GL_INT_2_10_10_10_REV, c.GL_UNSIGNED_BYTE, c.GL_BYTE, c.GL_SHORT, c.GL_UNSIGNED_SHORT => true,
+            else => false,
+        };
+    }
+
+
+    /// Offset of the attribute in the vertex, when the previous one ended at `previous_end`
+    pub fn offsetAfter(self: VertexAttributeDescriptor, previous_end: usize) usize {
+        return self.offset orelse previous_end;
+    }
+
+
+    /// Joint indices reach the shader as a uvec4 through glVertexAttribIPointer
+    pub fn isInteger(self: VertexAttributeDescriptor) bool {
+        return self.attribute_type == .Joints;
+    }
+
+
+    /// Location of the attribute as descriptor `index` of its layout, lightmap UVs sit at a fixed one
+    pub fn location(self: VertexAttributeDescriptor, index: usize) c.GLuint {
+        if (self.attribute_type == .LightmapUV) return lightmap_uv_location;
+        return @intCast(index);
+    }
 };
 
 
@@ -408,6 +1471,11 @@ pub const AttributeType = enum {
     Position,
     TexCoord,
     Normal,
+    Color,
+    Joints,
+    Weights,
+    /// Second texture coordinates, unique per surface point, see lightmap.zig
+    LightmapUV,
 };
 
 
@@ -417,51 +1485,240 @@ pub const AttributeType = enum {
 
 
 /// Converts a package size to a vertex layout
-fn getLayoutFromPackageSize(package_size: u4) !VertexLayout {
+pub fn getLayoutFromPackageSize(package_size: u4) !VertexLayout {
     return switch (package_size) {
         3 => VertexLayout.Pos(),
         5 => VertexLayout.PosTex(),
         6 => VertexLayout.PosNorm(),
+        7 => VertexLayout.PosColor(),
         8 => VertexLayout.PosNormTex(),
         else => return MeshError.InvalidPackageSize,
     };
 }
 
 
+/// Layout of a package size stored in `format`
+pub fn getLayoutForFormat(package_size: u4, format: VertexFormat) !VertexLayout {
+    switch (format) {
+        .float => return getLayoutFromPackageSize(package_size),
+        // Only the vertex struct knows its layout
+        .typed => return MeshError.TypedVertices,
+        .compact => {},
+    }
+    return switch (package_size) {
+        3 => VertexLayout.Pos(),
+        5 => VertexLayout.PosTexCompact(),
+        6 => VertexLayout.PosNormCompact(),
+        7 => VertexLayout.PosColorCompact(),
+        8 => VertexLayout.PosNormTexCompact(),
+        else => return MeshError.InvalidPackageSize,
+    };
+}
+
+
 /// Gets the number of floats per vertex from the package size
-fn getFloatsPerVertex(package_size: u4) usize {
+pub fn getFloatsPerVertex(package_size: u4) usize {
     return switch (package_size) {
-        3, 5, 6, 8 => package_size,
+        3, 5, 6, 7, 8 => package_size,
         else => 0,
     };
 }
 
 
-/// Sets up vertex attributes based on the layout
+/// Attributes of a createTyped vertex struct in location order, the order of the package layouts
+fn typedDescriptors(comptime V: type) []const VertexAttributeDescriptor {
+    comptime {
+        const info = @typeInfo(V);
+        if (info != .@"struct" or info.@"struct".layout != .@"extern") {
+            @compileError(@typeName(V) ++ " has to be an extern struct, so its field offsets are fixed");
+        }
+
+        var result: []const VertexAttributeDescriptor = &.{};
+        for ([_]AttributeType{ .Position, .Normal, .TexCoord, .Color, .LightmapUV }) |attribute| {
+            var found = false;
+            for (info.@"struct".fields) |field| {
+                const field_attribute = attributeOfField(field.name) orelse continue;
+                if (field_attribute != attribute) continue;
+                if (found) @compileError(@typeName(V) ++ " has two fields for the " ++ @tagName(attribute) ++ " attribute");
+                found = true;
+                result = result ++ [_]VertexAttributeDescriptor{.{
+                    .attribute_type = attribute,
+                    .data_type = fieldDataType(field.type, attribute),
+                    .offset = @offsetOf(V, field.name),
+                }};
+            }
+        }
+        if (result.len == 0 or result[0].attribute_type != .Position or result[0].data_type != c.GL_FLOAT) {
+            @compileError(@typeName(V) ++ " needs a `position` of three f32");
+        }
+        return result;
+    }
+}
+
+
+/// Package size of the attribute set of a createTyped vertex struct
+fn typedPackageSize(comptime V: type) u4 {
+    comptime {
+        var normal = false;
+        var tex_coord = false;
+        var color = false;
+        for (typedDescriptors(V)) |desc| switch (desc.attribute_type) {
+            .Normal => normal = true,
+            .TexCoord => tex_coord = true,
+            .Color => color = true,
+            else => {},
+        };
+        if (color) {
+            if (normal or tex_coord) @compileError("no package size has colors with normals or texture coordinates");
+            return 7;
+        }
+        return if (normal and tex_coord) 8 else if (normal) 6 else if (tex_coord) 5 else 3;
+    }
+}
+
+
+/// Attribute a vertex field feeds by its name, null for padding named from an underscore
+fn attributeOfField(comptime name: []const u8) ?AttributeType {
+    if (name[0] == '_') return null;
+    if (std.mem.eql(u8, name, "position")) return .Position;
+    if (std.mem.eql(u8, name, "normal")) return .Normal;
+    if (std.mem.eql(u8, name, "uv") or std.mem.eql(u8, name, "tex_coord")) return .TexCoord;
+    if (std.mem.eql(u8, name, "color")) return .Color;
+    if (std.mem.eql(u8, name, "lightmap_uv")) return .LightmapUV;
+    @compileError("vertex field `" ++ name ++ "` feeds no attribute, name padding from an underscore");
+}
+
+
+/// GL type of a vertex field, whose component count has to match its attribute's
+fn fieldDataType(comptime F: type, comptime attribute: AttributeType) c.GLenum {
+    if (F == PackedNormal) {
+        if (attribute != .Normal) @compileError("PackedNormal only holds normals");
+        return c.GL_INT_2_10_10_10_REV;
+    }
+
+    const Element, const length = switch (@typeInfo(F)) {
+        .array => |array| .{ array.child, array.len },
+        else => if (F == Vec2f) .{ f32, 2 } else if (F == Vec3f) .{ f32, 3 } else if (F == Vec4f) .{ f32, 4 } else {
+            @compileError("vertex field type " ++ @typeName(F) ++ " is no array or math vector");
+        },
+    };
+    // Integer normals may carry a fourth component as padding, the shader reads three
+    const padded_normal = attribute == .Normal and length == 4 and Element != f32 and Element != f16;
+    if (length != VertexLayout.getAttributeSize(attribute) and !padded_normal) {
+        @compileError("vertex field type " ++ @typeName(F) ++ " has the wrong component count for " ++ @tagName(attribute));
+    }
+    return switch (Element) {
+        f32 => c.GL_FLOAT,
+        f16 => c.GL_HALF_FLOAT,
+        u8 => c.GL_UNSIGNED_BYTE,
+        i8 => c.GL_BYTE,
+        u16 => c.GL_UNSIGNED_SHORT,
+        i16 => c.GL_SHORT,
+        else => @compileError("vertex components are f32, f16 or 8 and 16 bit integers, not " ++ @typeName(Element)),
+    };
+}
+
+
+fn typedBounds(comptime V: type, vertices: []const V) BoundingBox {
+    var bounds = BoundingBox.empty;
+    for (vertices) |vertex| {
+        const position: [3]f32 = @bitCast(vertex.position);
+        bounds = bounds.include(.{ .x = position[0], .y = position[1], .z = position[2] });
+    }
+    return bounds;
+}
+
+
+/// Bytes ready for upload, `owned` when they had to be converted
+const Encoded = struct {
+    bytes: []const u8,
+    owned: bool,
+
+    fn deinit(self: Encoded, allocator: std.mem.Allocator) void {
+        if (self.owned) allocator.free(self.bytes);
+    }
+};
+
+
+/// f32 vertex data as stored in `format`, float data is passed through without copying
+fn encodeVertices(allocator: std.mem.Allocator, data: []const f32, package_size: u4, format: VertexFormat) !Encoded {
+    if (format == .float) return .{ .bytes = std.mem.sliceAsBytes(data), .owned = false };
+
+    const layout = try getLayoutForFormat(package_size, format);
+    const floats_per_vertex = getFloatsPerVertex(package_size);
+    const vertex_count = data.len / floats_per_vertex;
+
+    const bytes = try allocator.alloc(u8, vertex_count * layout.stride);
+    for (0..vertex_count) |v| {
+        var src = data[v * floats_per_vertex ..][0..floats_per_vertex];
+        var dst = bytes[v * layout.stride ..][0..layout.stride];
+
+        for (layout.descriptors) |desc| {
+            const components = VertexLayout.getAttributeSize(desc.attribute_type);
+            const values = src[0..components];
+            switch (desc.data_type) {
+                c.GL_HALF_FLOAT => for (values, 0..) |value, i| {
+                    const half: f16 = @floatCast(value);
+                    @memcpy(dst[i * 2 ..][0..2], std.mem.asBytes(&half));
+                },
+                c.GL_UNSIGNED_BYTE => for (values, 0..) |value, i| {
+                    dst[i] = @intFromFloat(@round(std.math.clamp(value, 0.0, 1.0) * 255.0));
+                },
+                c.GL_INT_2_10_10_10_REV => {
+                    const packed_normal = packSnorm10(values[0]) | (packSnorm10(values[1]) << 10) | (packSnorm10(values[2]) << 20);
+                    @memcpy(dst[0..4], std.mem.asBytes(&packed_normal));
+                },
+                else => @memcpy(dst[0 .. components * 4], std.mem.sliceAsBytes(values)),
+            }
+            src = src[components..];
+            dst = dst[desc.byteSize()..];
+        }
+    }
+    return .{ .bytes = bytes, .owned = true };
+}
+
+
+/// Signed normalized 10-bit field of GL_INT_2_10_10_10_REV
+fn packSnorm10(value: f32) u32 {
+    const scaled: i32 = @intFromFloat(@round(std.math.clamp(value, -1.0, 1.0) * 511.0));
+    return @as(u32, @bitCast(scaled)) & 0x3FF;
+}
+
+
+/// Indices as stored in `index_type`, u32 indices are passed through without copying
+fn encodeIndices(allocator: std.mem.Allocator, indices: []const u32, index_type: IndexType) !Encoded {
+    if (index_type == .u32) return .{ .bytes = std.mem.sliceAsBytes(indices), .owned = false };
+
+    const narrow = try allocator.alloc(u16, indices.len);
+    for (narrow, indices) |*out, index| out.* = @intCast(index);
+    return .{ .bytes = std.mem.sliceAsBytes(narrow), .owned = true };
+}
+
+
+/// Sets up vertex attributes based on the layout, with the first vertex at byte `base_offset`
 /// Assumes VAO and VBO are already bound
-fn setupVertexAttributes(layout: VertexLayout) void {
+pub fn setupVertexAttributes(layout: VertexLayout, base_offset: usize) void {
     // Reset all attributes first
     resetVertexAttributes();
     
     // Set up new vertex attributes
     var offset: usize = 0;
     for (layout.descriptors, 0..) |desc, index| {
-        const attr_size: c.GLint = @intCast(VertexLayout.getAttributeSize(desc.attribute_type));
-
+        offset = desc.offsetAfter(offset);
         c.glVertexAttribPointer(
-            @intCast(index),
-            attr_size,
+            desc.location(index),
+            desc.glComponentCount(),
             desc.data_type,
-            c.GL_FALSE,
+            if (desc.isNormalized()) c.GL_TRUE else c.GL_FALSE,
             @intCast(layout.stride),
-            @ptrFromInt(offset),
+            @ptrFromInt(base_offset + offset),
         );
         err.checkGLError("setupVertexAttributes: glVertexAttribPointer");
 
-        c.glEnableVertexAttribArray(@intCast(index));
+        c.glEnableVertexAttribArray(desc.location(index));
         err.checkGLError("setupVertexAttributes: glEnableVertexAttribArray");
 
-        offset += @as(usize, @intCast(attr_size)) * @sizeOf(f32);
+        offset += desc.byteSize();
     }
 }
 
@@ -470,23 +1727,89 @@ fn setupVertexAttributes(layout: VertexLayout) void {
 fn setupVertexAttributesInternal(layout: VertexLayout) void {
     var offset: usize = 0;
     for (layout.descriptors, 0..) |desc, i| {
-        const size: c.GLint = @intCast(VertexLayout.getAttributeSize(desc.attribute_type));
-
+        offset = desc.offsetAfter(offset);
         c.glVertexAttribPointer(
-            @intCast(i),
-            size,
+            desc.location(i),
+            desc.glComponentCount(),
             desc.data_type,
-            c.GL_FALSE,
+            if (desc.isNormalized()) c.GL_TRUE else c.GL_FALSE,
             @intCast(layout.stride),
             @ptrFromInt(offset),
         );
         err.checkGLError("glVertexAttribPointer");
 
-        c.glEnableVertexAttribArray(@intCast(i));
+        c.glEnableVertexAttribArray(desc.location(i));
         err.checkGLError("glEnableVertexAttribArray");
 
-        offset += @intCast(size * @sizeOf(f32));
+        offset += desc.byteSize();
+    }
+}
+
+
+/// Points the skin attributes at the bound buffer from skin_joints_location on
+/// Assumes VAO and skin buffer are already bound, resetVertexAttributes leaves these locations alone
+fn setupSkinAttributes(layout: VertexLayout) void {
+    var offset: usize = 0;
+    for (layout.descriptors, 0..) |desc, i| {
+        const location: c.GLuint = @intCast(skin_joints_location + i);
+        if (desc.isInteger()) {
+            c.glVertexAttribIPointer(location, desc.glComponentCount(), desc.data_type, @intCast(layout.stride), @ptrFromInt(offset));
+        } else {
+            c.glVertexAttribPointer(location, desc.glComponentCount(), desc.data_type, c.GL_TRUE, @intCast(layout.stride), @ptrFromInt(offset));
+        }
+        c.glEnableVertexAttribArray(location);
+        offset += desc.byteSize();
     }
+    err.checkGLError("setupSkinAttributes");
+}
+
+
+/// Point the instance attributes of the bound VAO at `buffer`, skipped when `source` says they already are
+/// The attribute setup is stored in the VAO, `source` records it
+pub fn pointInstanceAttributes(source: *InstanceSource, buffer: c.GLuint, first_instance: usize, format: InstanceFormat, divisor: u32) void {
+    if (source.buffer == buffer and source.offset == first_instance and source.format == format and source.divisor == divisor) return;
+
+    // Both layouts are made of vec4s, TRS leaves the third one at its default
+    const stride: usize = switch (format) {
+        .affine => @sizeOf(Affine3x4),
+        .trs => @sizeOf(TrsInstance),
+    };
+    const vec4_count = stride / (4 * @sizeOf(f32));
+
+    GLStateCache.current().bindArrayBuffer(buffer);
+    for (0..3) |slot| {
+        const location: c.GLuint = @intCast(instance_matrix_location + slot);
+        if (slot >= vec4_count) {
+            c.glDisableVertexAttribArray(location);
+            continue;
+        }
+        const offset = first_instance * stride + slot * 4 * @sizeOf(f32);
+        c.glVertexAttribPointer(location, 4, c.GL_FLOAT, c.GL_FALSE, @intCast(stride), @ptrFromInt(offset));
+        c.glEnableVertexAttribArray(location);
+        c.glVertexAttribDivisor(location, divisor);
+    }
+    err.checkGLError("setInstanceSource: instance attributes");
+
+    source.* = .{ .buffer = buffer, .offset = first_instance, .format = format, .divisor = divisor };
+}
+
+
+/// Replace the contents of the buffer bound to `target`
+/// Data that fits orphans the old storage and fills the new one with glBufferSubData, so the driver
+/// neither waits for draws still reading it nor reallocates, only growing respecifies the buffer
+fn uploadBuffer(target: c.GLenum, capacity: *usize, bytes: []const u8) void {
+    render_stats.countUpload(bytes.len);
+    if (bytes.len > capacity.*) {
+        c.glBufferData(target, @intCast(bytes.len), bytes.ptr, c.GL_DYNAMIC_DRAW);
+        err.checkGLError("uploadBuffer: glBufferData");
+        capacity.* = bytes.len;
+        return;
+    }
+    if (bytes.len == 0) return;
+
+    c.glBufferData(target, @intCast(capacity.*), null, c.GL_DYNAMIC_DRAW);
+    c.glBufferSubData(target, 0, @intCast(bytes.len), bytes.ptr);
+    err.checkGLError("uploadBuffer: orphan and glBufferSubData");
 }
 
 
@@ -497,12 +1820,14 @@ fn resetVertexAttributes() void {
     while (attr_index < MAX_ATTRIBS) : (attr_index += 1) {
         c.glDisableVertexAttribArray(attr_index);
     }
+    c.glDisableVertexAttribArray(lightmap_uv_location);
 }
 
 
 /// Unbinds all buffers
 fn unbindBuffers() void {
-    c.glBindVertexArray(0);
-    c.glBindBuffer(c.GL_ARRAY_BUFFER, 0);
+    const state = GLStateCache.current();
+    state.bindVertexArray(0);
+    state.bindArrayBuffer(0);
     c.glBindBuffer(c.GL_ELEMENT_ARRAY_BUFFER, 0);
 }
@@ -0,0 +1,255 @@
+// graphics/mesh_builder.zig - procedural meshes written straight into mapped buffers
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const mesh_module = @import("mesh.zig");
+const Mesh = mesh_module.Mesh;
+const MeshError = mesh_module.MeshError;
+const IndexType = mesh_module.IndexType;
+const GeometryPool = @import("geometry_pool.zig").GeometryPool;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const BoundingBox = @import("../math/bounds.zig").BoundingBox;
+const Vec3f = @import("../math/vector.zig").Vec3f;
+
+
+pub const MeshBuilderError = error{
+    /// The driver could not map the storage
+    MapFailed,
+    /// The driver lost the mapped contents before commit, e.g. on a video mode change
+    ContentsLost,
+};
+
+
+/// Reserves GPU storage for a mesh of known size and maps it, so generators write vertices and indices
+/// in place instead of building arrays that are then copied into the buffers
+/// begin allocates a VBO and an EBO of their own, beginPooled takes ranges of a GeometryPool section
+/// The mapping is plain memory, a worker thread may fill it while the GL thread goes on. begin, commit
+/// and cancel run on the GL thread. Mapped memory may be write-combined, write each value once and
+/// never read it back, bounds are tracked as vertices are set
+pub const MeshBuilder = struct {
+    const Self = @This();
+
+    const Target = union(enum) {
+        buffers: struct { vbo: c.GLuint, ebo: c.GLuint },
+        pool: struct { pool: *GeometryPool, reservation: GeometryPool.Reservation },
+    };
+
+    allocator: std.mem.Allocator,
+    package_size: u4,
+    floats_per_vertex: usize,
+    /// Every float of every reserved vertex, interleaved as the package size lays them out
+    vertices: []f32,
+    /// Mapped index storage, u16 when every index fits and the storage isn't pooled
+    index_bytes: []u8,
+    index_type: IndexType,
+    /// Positions of the vertices set so far, or as given with includeBounds
+    bounds: BoundingBox = BoundingBox.empty,
+    target: Target,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Map new storage for `vertex_count` vertices of `package_size` and `index_count` indices
+    pub fn begin(allocator: std.mem.Allocator, package_size: u4, vertex_count: u32, index_count: u32) !Self {
+        const floats_per_vertex = mesh_module.getFloatsPerVertex(package_size);
+        if (floats_per_vertex == 0) return MeshError.InvalidPackageSize;
+        const index_type: IndexType = if (vertex_count <= std.math.maxInt(u16) + 1) .u16 else .u32;
+
+        var buffers: [2]c.GLuint = .{ 0, 0 };
+        c.glGenBuffers(buffers.len, &buffers);
+        errdefer deleteBuffers(&buffers);
+
+        const vertex_bytes = @as(usize, vertex_count) * floats_per_vertex * @sizeOf(f32);
+        const index_bytes = @as(usize, index_count) * index_type.size();
+        const vertices = try mapNew(buffers[0], vertex_bytes);
+        errdefer unmap(buffers[0]) catch {};
+        const indices = try mapNew(buffers[1], index_bytes);
+
+        return .{
+            .allocator = allocator,
+            .package_size = package_size,
+            .floats_per_vertex = floats_per_vertex,
+            .vertices = @alignCast(std.mem.bytesAsSlice(f32, vertices)),
+            .index_bytes = indices,
+            .index_type = index_type,
+            .target = .{ .buffers = .{ .vbo = buffers[0], .ebo = buffers[1] } },
+        };
+    }
+
+
+    /// Reserve ranges of `pool` and map them, the mesh shares the section's buffers and VAO
+    /// A section's buffers map once at a time, commit or cancel before building the next mesh of the same layout
+    /// and don't add meshes to the pool meanwhile, growing a section would move its buffers
+    pub fn beginPooled(pool: *GeometryPool, package_size: u4, vertex_count: u32, index_count: u32) !Self {
+        const reservation = try pool.reserve(package_size, vertex_count, index_count);
+        errdefer pool.cancelReservation(reservation);
+        const section = reservation.section;
+
+        const vertex_offset = @as(usize, reservation.base_vertex) * section.stride();
+        const index_offset = @as(usize, reservation.first_index) * @sizeOf(u32);
+        const vertices = try mapRange(section.vbo, vertex_offset, @as(usize, vertex_count) * section.stride());
+        errdefer unmap(section.vbo) catch {};
+        const indices = try mapRange(section.ebo, index_offset, @as(usize, index_count) * @sizeOf(u32));
+
+        return .{
+            .allocator = pool.allocator,
+            .package_size = package_size,
+            .floats_per_vertex = mesh_module.getFloatsPerVertex(package_size),
+            .vertices = @alignCast(std.mem.bytesAsSlice(f32, vertices)),
+            .index_bytes = indices,
+            .index_type = .u32,
+            .target = .{ .pool = .{ .pool = pool, .reservation = reservation } },
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    pub fn vertexCount(self: *const Self) usize {
+        return self.vertices.len / self.floats_per_vertex;
+    }
+
+
+    pub fn indexCount(self: *const Self) usize {
+        return self.index_bytes.len / self.index_type.size();
+    }
+
+
+    /// Write vertex `index`, `values` holding floats_per_vertex floats that start with the position
+    pub fn setVertex(self: *Self, index: usize, values: []const f32) void {
+        std.debug.assert(values.len == self.floats_per_vertex);
+        @memcpy(self.vertices[index * self.floats_per_vertex ..][0..self.floats_per_vertex], values);
+        self.bounds = self.bounds.include(.{ .x = values[0], .y = values[1], .z = values[2] });
+    }
+
+
+    /// Grow the bounds by a position written into `vertices` directly
+    pub fn includeBounds(self: *Self, position: Vec3f) void {
+        self.bounds = self.bounds.include(position);
+    }
+
+
+    /// Write index `index`, a vertex number below vertexCount
+    pub fn setIndex(self: *Self, index: usize, value: u32) void {
+        std.debug.assert(value < self.vertexCount());
+        switch (self.index_type) {
+            .u16 => std.mem.writeInt(u16, self.index_bytes[index * 2 ..][0..2], @intCast(value), .little),
+            .u32 => std.mem.writeInt(u32, self.index_bytes[index * 4 ..][0..4], value, .little),
+        }
+    }
+
+
+    /// Write `values` from index `first` on, e.g. a topology shared by many meshes
+    pub fn setIndices(self: *Self, first: usize, values: []const u32) void {
+        if (self.index_type == .u32) {
+            @memcpy(self.index_bytes[first * 4 ..][0 .. values.len * 4], std.mem.sliceAsBytes(values));
+            return;
+        }
+        for (values, first..) |value, index| self.setIndex(index, value);
+    }
+
+
+    /// Unmap the storage and return the drawable mesh, every vertex and index has to be written
+    /// The builder is spent either way
+    pub fn commit(self: *Self) !*Mesh {
+        const bounds = self.bounds;
+        switch (self.target) {
+            .buffers => |buffers| {
+                var owned = [2]c.GLuint{ buffers.vbo, buffers.ebo };
+                errdefer deleteBuffers(&owned);
+                const vertices_kept = unmap(buffers.vbo);
+                const indices_kept = unmap(buffers.ebo);
+                try vertices_kept;
+                try indices_kept;
+                return Mesh.createFromBuffers(self.allocator, buffers.vbo, buffers.ebo, self.vertexCount(), self.indexCount(), self.index_type, self.package_size, bounds);
+            },
+            .pool => |target| {
+                const section = target.reservation.section;
+                errdefer target.pool.cancelReservation(target.reservation);
+                const vertices_kept = unmap(section.vbo);
+                const indices_kept = unmap(section.ebo);
+                try vertices_kept;
+                try indices_kept;
+                return target.pool.createReservedMesh(target.reservation, bounds);
+            },
+        }
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Unmap and drop the storage without making a mesh of it
+    pub fn cancel(self: *Self) void {
+        switch (self.target) {
+            .buffers => |buffers| {
+                var owned = [2]c.GLuint{ buffers.vbo, buffers.ebo };
+                deleteBuffers(&owned);
+            },
+            .pool => |target| {
+                unmap(target.reservation.section.vbo) catch {};
+                unmap(target.reservation.section.ebo) catch {};
+                target.pool.cancelReservation(target.reservation);
+            },
+        }
+        self.vertices = &.{};
+        self.index_bytes = &.{};
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Allocate `size` bytes for `buffer` and map all of them for writing
+    /// The copy write target leaves the array buffer and the bound VAO's element buffer alone
+    fn mapNew(buffer: c.GLuint, size: usize) ![]u8 {
+        c.glBindBuffer(c.GL_COPY_WRITE_BUFFER, buffer);
+        c.glBufferData(c.GL_COPY_WRITE_BUFFER, @intCast(size), null, c.GL_STATIC_DRAW);
+        return mapRange(buffer, 0, size);
+    }
+
+
+    fn mapRange(buffer: c.GLuint, offset: usize, size: usize) ![]u8 {
+        if (size == 0) return &.{};
+        c.glBindBuffer(c.GL_COPY_WRITE_BUFFER, buffer);
+        const mapped: ?[*]u8 = @ptrCast(c.glMapBufferRange(
+            c.GL_COPY_WRITE_BUFFER,
+            @intCast(offset),
+            @intCast(size),
+            c.GL_MAP_WRITE_BIT | c.GL_MAP_INVALIDATE_RANGE_BIT,
+        ));
+        c.glBindBuffer(c.GL_COPY_WRITE_BUFFER, 0);
+        if (mapped == null) {
+            err.checkGLError("MeshBuilder: glMapBufferRange");
+            return MeshBuilderError.MapFailed;
+        }
+        return mapped.?[0..size];
+    }
+
+
+    /// Unmap `buffer` if it is mapped, empty ranges never were
+    fn unmap(buffer: c.GLuint) !void {
+        c.glBindBuffer(c.GL_COPY_WRITE_BUFFER, buffer);
+        defer c.glBindBuffer(c.GL_COPY_WRITE_BUFFER, 0);
+        var mapped: c.GLint = c.GL_FALSE;
+        c.glGetBufferParameteriv(c.GL_COPY_WRITE_BUFFER, c.GL_BUFFER_MAPPED, &mapped);
+        if (mapped == c.GL_FALSE) return;
+        if (c.glUnmapBuffer(c.GL_COPY_WRITE_BUFFER) == c.GL_FALSE) return MeshBuilderError.ContentsLost;
+    }
+
+
+    /// Deleting a mapped buffer unmaps it
+    fn deleteBuffers(buffers: *[2]c.GLuint) void {
+        const state = GLStateCache.current();
+        for (buffers) |buffer| state.forgetBuffer(buffer);
+        c.glDeleteBuffers(buffers.len, buffers);
+        err.checkGLError("MeshBuilder: glDeleteBuffers");
+    }
+};
@@ -0,0 +1,234 @@
+// graphics/mesh_optimizer.zig
+const std = @import("std");
+
+const mesh_module = @import("mesh.zig");
+const MeshError = mesh_module.MeshError;
+const MeshData = mesh_module.MeshData;
+
+
+/// Entries of the post-transform cache the reordering targets, small enough for any GPU
+pub const default_cache_size = 16;
+
+
+/// Weld duplicate vertices, reorder triangles for the post-transform vertex cache,
+/// then reorder vertices by first use so fetches walk the VBO forwards
+/// Run before upload, e.g. through Mesh.createOptimized, the result draws the same triangles
+pub fn optimize(allocator: std.mem.Allocator, data: []const f32, indices: []const u32, package_size: u4) !MeshData {
+    const floats_per_vertex = mesh_module.getFloatsPerVertex(package_size);
+    if (floats_per_vertex == 0) return MeshError.InvalidPackageSize;
+
+    // Validate input data length
+    if (data.len % floats_per_vertex != 0 or indices.len % 3 != 0) return MeshError.InvalidVertexData;
+    const vertex_count = data.len / floats_per_vertex;
+    for (indices) |index| {
+        if (index >= vertex_count) return MeshError.InvalidVertexData;
+    }
+
+    const welded = try allocator.alloc(u32, indices.len);
+    defer allocator.free(welded);
+    try weldVertices(allocator, data, indices, floats_per_vertex, welded);
+
+    const ordered = try allocator.alloc(u32, indices.len);
+    errdefer allocator.free(ordered);
+    try optimizeVertexCache(allocator, welded, vertex_count, default_cache_size, ordered);
+
+    const vertices = try optimizeVertexFetch(allocator, data, ordered, floats_per_vertex);
+    return .{ .vertices = vertices, .indices = ordered, .allocator = allocator };
+}
+
+
+/// Write `indices` to `out` with every vertex replaced by the first bitwise identical one
+pub fn weldVertices(allocator: std.mem.Allocator, data: []const f32, indices: []const u32, floats_per_vertex: usize, out: []u32) !void {
+    std.debug.assert(out.len == indices.len);
+
+    const context = WeldContext{ .data = data, .floats_per_vertex = floats_per_vertex };
+    var firsts = std.HashMapUnmanaged(u32, void, WeldContext, std.hash_map.default_max_load_percentage){};
+    defer firsts.deinit(allocator);
+
+    for (indices, out) |index, *welded| {
+        const entry = try firsts.getOrPutContext(allocator, index, context);
+        welded.* = entry.key_ptr.*;
+    }
+}
+
+
+/// Tipsify (Sander, Nehab and Barczak 2007): fan around a vertex still in the cache whenever
+/// possible and fall back to recently used vertices at dead ends, linear in the triangle count
+pub fn optimizeVertexCache(allocator: std.mem.Allocator, indices: []const u32, vertex_count: usize, cache_size: u32, out: []u32) !void {
+    std.debug.assert(out.len == indices.len);
+    const triangle_count = indices.len / 3;
+    if (triangle_count == 0) return;
+
+    // Triangles around each vertex, as ranges of `adjacency`
+    const live = try allocator.alloc(u32, vertex_count);
+    defer allocator.free(live);
+    const offsets = try allocator.alloc(u32, vertex_count + 1);
+    defer allocator.free(offsets);
+    const adjacency = try allocator.alloc(u32, indices.len);
+    defer allocator.free(adjacency);
+
+    @memset(live, 0);
+    for (indices) |index| live[index] += 1;
+    offsets[0] = 0;
+    for (live, 0..) |count, v| offsets[v + 1] = offsets[v] + count;
+    {
+        const fill = try allocator.dupe(u32, offsets[0..vertex_count]);
+        defer allocator.free(fill);
+        for (indices, 0..) |index, i| {
+            adjacency[fill[index]] = @intCast(i / 3);
+            fill[index] += 1;
+        }
+    }
+
+    const cache_time = try allocator.alloc(u32, vertex_count);
+    defer allocator.free(cache_time);
+    @memset(cache_time, 0);
+    const emitted = try allocator.alloc(bool, triangle_count);
+    defer allocator.free(emitted);
+    @memset(emitted, false);
+
+    var dead_end = std.ArrayList(u32).init(allocator);
+    defer dead_end.deinit();
+    var candidates = std.ArrayList(u32).init(allocator);
+    defer candidates.deinit();
+
+    var written: usize = 0;
+    var time: u32 = cache_size + 1;
+    var cursor: u32 = 0;
+    var fan: ?u32 = 0;
+
+    while (fan) |f| {
+        candidates.clearRetainingCapacity();
+
+        for (adjacency[offsets[f]..offsets[f + 1]]) |triangle| {
+            if (emitted[triangle]) continue;
+            emitted[triangle] = true;
+
+            for (indices[triangle * 3 ..][0..3]) |v| {
+                out[written] = v;
+                written += 1;
+                try dead_end.append(v);
+                try candidates.append(v);
+                live[v] -= 1;
+
+                // Not in the cache any more, using it pushes it back in
+                if (time - cache_time[v] > cache_size) {
+                    cache_time[v] = time;
+                    time += 1;
+                }
+            }
+        }
+
+        fan = nextFanVertex(candidates.items, live, cache_time, time, cache_size) orelse
+            skipDeadEnd(&dead_end, live, &cursor);
+    }
+    std.debug.assert(written == triangle_count * 3);
+}
+
+
+/// Reorder vertices by their first use in `indices` and rewrite `indices` in place
+/// Vertices no triangle references are dropped, returns the reordered vertex data
+pub fn optimizeVertexFetch(allocator: std.mem.Allocator, data: []const f32, indices: []u32, floats_per_vertex: usize) ![]f32 {
+    const vertex_count = data.len / floats_per_vertex;
+    const unused = std.math.maxInt(u32);
+
+    const remap = try allocator.alloc(u32, vertex_count);
+    defer allocator.free(remap);
+    @memset(remap, unused);
+
+    var next: u32 = 0;
+    for (indices) |*index| {
+        if (remap[index.*] == unused) {
+            remap[index.*] = next;
+            next += 1;
+        }
+        index.* = remap[index.*];
+    }
+
+    const vertices = try allocator.alloc(f32, @as(usize, next) * floats_per_vertex);
+    for (remap, 0..) |target, source| {
+        if (target == unused) continue;
+        @memcpy(
+            vertices[target * floats_per_vertex ..][0..floats_per_vertex],
+            data[source * floats_per_vertex ..][0..floats_per_vertex],
+        );
+    }
+    return vertices;
+}
+
+
+/// Vertices transformed per triangle by a FIFO cache of `cache_size`, 0.5 is ideal and 3 is no reuse
+pub fn averageCacheMissRatio(allocator: std.mem.Allocator, indices: []const u32, vertex_count: usize, cache_size: u32) !f32 {
+    if (indices.len < 3) return 0.0;
+
+    // Time each vertex entered the cache, a vertex is cached while fewer than cache_size entered after it
+    const entered = try allocator.alloc(u32, vertex_count);
+    defer allocator.free(entered);
+    @memset(entered, 0);
+
+    var misses: u32 = 0;
+    for (indices) |index| {
+        if (entered[index] == 0 or misses + 1 - entered[index] > cache_size) {
+            misses += 1;
+            entered[index] = misses;
+        }
+    }
+    return @as(f32, @floatFromInt(misses)) / @as(f32, @floatFromInt(indices.len / 3));
+}
+
+
+// ============================================================
+// Private: Helper Functions
+// ============================================================
+
+/// Hashes and compares vertices by their bytes
+const WeldContext = struct {
+    data: []const f32,
+    floats_per_vertex: usize,
+
+    fn bytes(self: WeldContext, vertex: u32) []const u8 {
+        return std.mem.sliceAsBytes(self.data[vertex * self.floats_per_vertex ..][0..self.floats_per_vertex]);
+    }
+
+    pub fn hash(self: WeldContext, vertex: u32) u64 {
+        return std.hash.Wyhash.hash(0, self.bytes(vertex));
+    }
+
+    pub fn eql(self: WeldContext, a: u32, b: u32) bool {
+        return std.mem.eql(u8, self.bytes(a), self.bytes(b));
+    }
+};
+
+
+/// Candidate with triangles left that stays in the cache longest after fanning around it
+fn nextFanVertex(candidates: []const u32, live: []const u32, cache_time: []const u32, time: u32, cache_size: u32) ?u32 {
+    var best: ?u32 = null;
+    var best_priority: i64 = -1;
+
+    for (candidates) |v| {
+        if (live[v] == 0) continue;
+
+        // Fanning emits up to two new vertices per remaining triangle, it has to fit in the cache
+        var priority: i64 = 0;
+        const age: i64 = time - cache_time[v];
+        if (age + 2 * @as(i64, live[v]) <= cache_size) priority = age;
+
+        if (priority > best_priority) {
+            best_priority = priority;
+            best = v;
+        }
+    }
+    return best;
+}
+
+
+/// Most recent vertex with triangles left, then the next such vertex in input order
+fn skipDeadEnd(dead_end: *std.ArrayList(u32), live: []const u32, cursor: *u32) ?u32 {
+    while (dead_end.pop()) |v| {
+        if (live[v] > 0) return v;
+    }
+    while (cursor.* < live.len) : (cursor.* += 1) {
+        if (live[cursor.*] > 0) return cursor.*;
+    }
+    return null;
+}
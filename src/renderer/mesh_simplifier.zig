@@ -0,0 +1,105 @@
+// graphics/mesh_simplifier.zig
+const std = @import("std");
+
+const mesh_module = @import("mesh.zig");
+const MeshError = mesh_module.MeshError;
+const MeshData = mesh_module.MeshData;
+const BoundingBox = @import("../math/bounds.zig").BoundingBox;
+
+
+/// Reduce interleaved vertex data by vertex clustering, e.g. at load time to generate LOD levels
+/// The bounds are split into a grid with `resolution` cells along their longest axis, every cell
+/// collapses into one vertex averaging its attributes, and triangles that collapse are dropped
+/// Cheap and robust against any topology, but texture seams inside a cell are averaged away
+pub fn simplify(allocator: std.mem.Allocator, data: []const f32, indices: []const u32, package_size: u4, resolution: u32) !MeshData {
+    const layout = try mesh_module.getLayoutFromPackageSize(package_size);
+    const floats_per_vertex = mesh_module.getFloatsPerVertex(package_size);
+
+    // Validate input data length
+    if (data.len % floats_per_vertex != 0) return MeshError.InvalidVertexData;
+    const vertex_count = data.len / floats_per_vertex;
+
+    const bounds = BoundingBox.fromVertices(data, floats_per_vertex);
+    const extents = [3]f32{ bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z };
+    const longest = @max(extents[0], @max(extents[1], extents[2]));
+    const cell_size = if (longest > 0) longest / @as(f32, @floatFromInt(@max(resolution, 1))) else 1.0;
+    const origin = [3]f32{ bounds.min.x, bounds.min.y, bounds.min.z };
+
+    // Cluster of every source vertex
+    const remap = try allocator.alloc(u32, vertex_count);
+    defer allocator.free(remap);
+
+    var clusters = std.AutoHashMap(u64, u32).init(allocator);
+    defer clusters.deinit();
+
+    var sums = std.ArrayList(f32).init(allocator);
+    defer sums.deinit();
+    var counts = std.ArrayList(u32).init(allocator);
+    defer counts.deinit();
+
+    for (0..vertex_count) |v| {
+        const vertex = data[v * floats_per_vertex ..][0..floats_per_vertex];
+
+        var key: u64 = 0;
+        for (0..3) |axis| {
+            const cell: u64 = @intFromFloat(@max((vertex[axis] - origin[axis]) / cell_size, 0.0));
+            key |= @min(cell, 0x1FFFFF) << @intCast(axis * 21);
+        }
+
+        const entry = try clusters.getOrPut(key);
+        if (!entry.found_existing) {
+            entry.value_ptr.* = @intCast(counts.items.len);
+            try counts.append(0);
+            try sums.appendNTimes(0, floats_per_vertex);
+        }
+
+        const cluster = entry.value_ptr.*;
+        remap[v] = cluster;
+        counts.items[cluster] += 1;
+        for (sums.items[cluster * floats_per_vertex ..][0..floats_per_vertex], vertex) |*sum, value| sum.* += value;
+    }
+
+    // Average every cluster, normals are renormalized after averaging
+    const normal_offset: ?usize = for (layout.descriptors, 0..) |desc, i| {
+        if (desc.attribute_type == .Normal) break layout.getAttributeOffset(i) / @sizeOf(f32);
+    } else null;
+
+    const vertices = try allocator.alloc(f32, sums.items.len);
+    errdefer allocator.free(vertices);
+    for (counts.items, 0..) |count, cluster| {
+        const inv_count = 1.0 / @as(f32, @floatFromInt(count));
+        const out = vertices[cluster * floats_per_vertex ..][0..floats_per_vertex];
+        for (out, sums.items[cluster * floats_per_vertex ..][0..floats_per_vertex]) |*value, sum| value.* = sum * inv_count;
+
+        if (normal_offset) |offset| {
+            const n = out[offset..][0..3];
+            const len = @sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (len > 0) {
+                for (n) |*component| component.* /= len;
+            }
+        }
+    }
+
+    // Keep the triangles whose corners still land in three different clusters
+    var out_indices = try std.ArrayList(u32).initCapacity(allocator, indices.len);
+    errdefer out_indices.deinit();
+
+    for (indices) |index| {
+        if (index >= vertex_count) return MeshError.InvalidVertexData;
+    }
+
+    var i: usize = 0;
+    while (i + 3 <= indices.len) : (i += 3) {
+        const a = remap[indices[i]];
+        const b = remap[indices[i + 1]];
+        const c = remap[indices[i + 2]];
+        if (a == b or b == c or a == c) continue;
+        out_indices.appendSliceAssumeCapacity(&.{ a, b, c });
+    }
+
+    return .{
+        .vertices = vertices,
+        .indices = try out_indices.toOwnedSlice(),
+        .allocator = allocator,
+    };
+}
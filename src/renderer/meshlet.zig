@@ -0,0 +1,198 @@
+// graphics/meshlet.zig
+const std = @import("std");
+
+const mesh_module = @import("mesh.zig");
+const MeshError = mesh_module.MeshError;
+const BoundingBox = @import("../math/bounds.zig").BoundingBox;
+const Vec3f = @import("../math/vector.zig").Vec3f;
+
+
+/// Limits of one meshlet, small enough that culling one rejects little visible geometry
+pub const max_meshlet_vertices = 64;
+pub const max_meshlet_triangles = 124;
+
+/// Cone cutoff of meshlets whose triangles face too many ways to ever be back-facing as a whole
+pub const no_cone_cutoff: f32 = 2.0;
+
+
+/// Contiguous range of a mesh's indices with its own culling bounds
+pub const Meshlet = struct {
+    /// Range of the mesh's indices, relative to Mesh.first_index
+    first_index: u32,
+    index_count: u32,
+    /// Object-space bounds of the vertices the range references
+    bounds: BoundingBox,
+    /// Every triangle faces away from a viewer looking along a direction within acos(cone_cutoff)
+    /// of the axis, no_cone_cutoff when no such direction exists
+    cone_axis: Vec3f,
+    cone_cutoff: f32,
+};
+
+
+/// Indices reordered so every meshlet is contiguous, and the meshlets, owned by the caller
+pub const MeshletData = struct {
+    indices: []u32,
+    meshlets: []Meshlet,
+    allocator: std.mem.Allocator,
+
+    pub fn deinit(self: *MeshletData) void {
+        self.allocator.free(self.indices);
+        self.allocator.free(self.meshlets);
+    }
+};
+
+
+/// Split a triangle list into meshlets of connected triangles, e.g. for terrain and other large meshes
+/// Each meshlet grows breadth first from its first triangle through shared vertices, so it stays
+/// compact, until it reaches max_meshlet_triangles or max_meshlet_vertices
+pub fn buildMeshlets(allocator: std.mem.Allocator, data: []const f32, indices: []const u32, package_size: u4) !MeshletData {
+    const floats_per_vertex = mesh_module.getFloatsPerVertex(package_size);
+    if (floats_per_vertex == 0) return MeshError.InvalidPackageSize;
+
+    // Validate input data length
+    if (data.len % floats_per_vertex != 0 or indices.len % 3 != 0) return MeshError.InvalidVertexData;
+    const vertex_count = data.len / floats_per_vertex;
+    for (indices) |index| {
+        if (index >= vertex_count) return MeshError.InvalidVertexData;
+    }
+    const triangle_count = indices.len / 3;
+
+    // Triangles around each vertex, as ranges of `adjacency`
+    const offsets = try allocator.alloc(u32, vertex_count + 1);
+    defer allocator.free(offsets);
+    const adjacency = try allocator.alloc(u32, indices.len);
+    defer allocator.free(adjacency);
+
+    @memset(offsets, 0);
+    for (indices) |index| offsets[index + 1] += 1;
+    for (1..offsets.len) |v| offsets[v] += offsets[v - 1];
+    {
+        const fill = try allocator.dupe(u32, offsets[0..vertex_count]);
+        defer allocator.free(fill);
+        for (indices, 0..) |index, i| {
+            adjacency[fill[index]] = @intCast(i / 3);
+            fill[index] += 1;
+        }
+    }
+
+    const emitted = try allocator.alloc(bool, triangle_count);
+    defer allocator.free(emitted);
+    @memset(emitted, false);
+    // Meshlet a vertex was last counted in
+    const vertex_meshlet = try allocator.alloc(u32, vertex_count);
+    defer allocator.free(vertex_meshlet);
+    @memset(vertex_meshlet, std.math.maxInt(u32));
+
+    var frontier = std.ArrayList(u32).init(allocator);
+    defer frontier.deinit();
+
+    var out_indices = try std.ArrayList(u32).initCapacity(allocator, indices.len);
+    errdefer out_indices.deinit();
+    var meshlets = std.ArrayList(Meshlet).init(allocator);
+    errdefer meshlets.deinit();
+
+    var seed: u32 = 0;
+    while (seed < triangle_count) : (seed += 1) {
+        if (emitted[seed]) continue;
+
+        const meshlet: u32 = @intCast(meshlets.items.len);
+        const first_index: u32 = @intCast(out_indices.items.len);
+        var vertex_total: u32 = 0;
+        var triangle_total: u32 = 0;
+
+        frontier.clearRetainingCapacity();
+        try frontier.append(seed);
+
+        var head: usize = 0;
+        while (head < frontier.items.len and triangle_total < max_meshlet_triangles) : (head += 1) {
+            const triangle = frontier.items[head];
+            if (emitted[triangle]) continue;
+
+            const corners = indices[triangle * 3 ..][0..3];
+            var new_vertices: u32 = 0;
+            for (corners) |v| {
+                if (vertex_meshlet[v] != meshlet) new_vertices += 1;
+            }
+            if (vertex_total + new_vertices > max_meshlet_vertices) continue;
+
+            emitted[triangle] = true;
+            triangle_total += 1;
+            out_indices.appendSliceAssumeCapacity(corners);
+
+            for (corners) |v| {
+                if (vertex_meshlet[v] != meshlet) {
+                    vertex_meshlet[v] = meshlet;
+                    vertex_total += 1;
+                }
+                for (adjacency[offsets[v]..offsets[v + 1]]) |neighbour| {
+                    if (!emitted[neighbour]) try frontier.append(neighbour);
+                }
+            }
+        }
+
+        try meshlets.append(describe(data, floats_per_vertex, out_indices.items[first_index..], first_index));
+    }
+
+    const meshlet_slice = try meshlets.toOwnedSlice();
+    errdefer allocator.free(meshlet_slice);
+    return .{
+        .indices = try out_indices.toOwnedSlice(),
+        .meshlets = meshlet_slice,
+        .allocator = allocator,
+    };
+}
+
+
+// ============================================================
+// Private: Helper Functions
+// ============================================================
+
+/// Bounds and normal cone of the triangles in `indices`
+fn describe(data: []const f32, floats_per_vertex: usize, indices: []const u32, first_index: u32) Meshlet {
+    var bounds = BoundingBox.empty;
+    var normal_sum = Vec3f{ .x = 0, .y = 0, .z = 0 };
+
+    var i: usize = 0;
+    while (i < indices.len) : (i += 3) {
+        const a = position(data, floats_per_vertex, indices[i]);
+        const b = position(data, floats_per_vertex, indices[i + 1]);
+        const c = position(data, floats_per_vertex, indices[i + 2]);
+        bounds = bounds.include(a).include(b).include(c);
+
+        // Counter-clockwise triangles face along the cross product
+        const normal = b.subtract(a).cross(c.subtract(a));
+        if (normal.lengthSquared() > 0) normal_sum = normal_sum.add(normal.normalize());
+    }
+
+    var result = Meshlet{
+        .first_index = first_index,
+        .index_count = @intCast(indices.len),
+        .bounds = bounds,
+        .cone_axis = .{ .x = 0, .y = 0, .z = 0 },
+        .cone_cutoff = no_cone_cutoff,
+    };
+    if (normal_sum.lengthSquared() == 0) return result;
+
+    // Widest angle between a triangle and the average facing
+    const axis = normal_sum.normalize();
+    var min_dot: f32 = 1.0;
+    i = 0;
+    while (i < indices.len) : (i += 3) {
+        const a = position(data, floats_per_vertex, indices[i]);
+        const b = position(data, floats_per_vertex, indices[i + 1]);
+        const c = position(data, floats_per_vertex, indices[i + 2]);
+        const normal = b.subtract(a).cross(c.subtract(a));
+        if (normal.lengthSquared() > 0) min_dot = @min(min_dot, normal.normalize().dot(axis));
+    }
+
+    // Every triangle faces away from views closer than 90 degrees minus that angle to the axis
+    result.cone_axis = axis;
+    if (min_dot > 0) result.cone_cutoff = @sqrt(1.0 - min_dot * min_dot);
+    return result;
+}
+
+
+fn position(data: []const f32, floats_per_vertex: usize, vertex: u32) Vec3f {
+    const p = data[vertex * floats_per_vertex ..][0..3];
+    return .{ .x = p[0], .y = p[1], .z = p[2] };
+}
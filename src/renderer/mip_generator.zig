@@ -0,0 +1,200 @@
+// graphics/mip_generator.zig - compute shader mip chains
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+
+const Shader = @import("shader.zig").Shader;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+
+
+/// How the texels of a texture are averaged
+pub const MipColorSpace = enum {
+    /// Values are averaged as stored, e.g. HDR render targets, normal maps and masks
+    linear,
+    /// 8-bit colors hold sRGB encoded values, they are decoded, averaged and encoded again
+    srgb,
+};
+
+
+/// Builds mip chains with a compute shader, four levels per dispatch
+/// Every thread of an 8x8 group averages 2x2 texels of the source level, the group then keeps reducing its
+/// tile in shared memory down to one texel, so the chain costs one dispatch per four levels instead of a
+/// driver-defined glGenerateMipmap, and sRGB colors are filtered in linear space
+/// Falls back to glGenerateMipmap without image load/store or for other formats than RGBA8 and RGBA16F
+pub const MipGenerator = struct {
+    const Self = @This();
+
+    pub const levels_per_dispatch = 4;
+    const group_size = 8;
+
+    rgba8_program: c.GLuint = 0,
+    rgba16f_program: c.GLuint = 0,
+    /// A program failed to build, every chain takes the fallback from then on
+    failed: bool = false,
+
+    /// Programs belong to the GL context, which is per thread like the state cache
+    threadlocal var shared_generator: Self = .{};
+
+    const rgba8_source = computeSource("rgba8");
+    const rgba16f_source = computeSource("rgba16f");
+
+    fn computeSource(comptime format: []const u8) []const u8 {
+        return "#version 430 core\n" ++
+            "layout (" ++ format ++ ", binding = 0) readonly uniform image2D source;\n" ++
+            "layout (" ++ format ++ ", binding = 1) writeonly uniform image2D levels[4];\n" ++
+            \\layout (local_size_x = 8, local_size_y = 8) in;
+            \\// Levels below the source written by this dispatch, 1 to 4
+            \\uniform int levelCount;
+            \\uniform bool srgb;
+            \\shared vec4 tile[8][8];
+            \\vec4 toLinear(vec4 color) {
+            \\    if (!srgb) return color;
+            \\    vec3 low = color.rgb / 12.92;
+            \\    vec3 high = pow((color.rgb + 0.055) / 1.055, vec3(2.4));
+            \\    return vec4(mix(high, low, lessThanEqual(color.rgb, vec3(0.04045))), color.a);
+            \\}
+            \\vec4 fromLinear(vec4 color) {
+            \\    if (!srgb) return color;
+            \\    vec3 low = color.rgb * 12.92;
+            \\    vec3 high = 1.055 * pow(color.rgb, vec3(1.0 / 2.4)) - 0.055;
+            \\    return vec4(mix(high, low, lessThanEqual(color.rgb, vec3(0.0031308))), color.a);
+            \\}
+            \\// Odd sizes repeat their last row and column
+            \\vec4 fetch(ivec2 texel) {
+            \\    return toLinear(imageLoad(source, min(texel, imageSize(source) - 1)));
+            \\}
+            \\void main() {
+            \\    ivec2 local = ivec2(gl_LocalInvocationID.xy);
+            \\    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+            \\    ivec2 src = texel * 2;
+            \\    vec4 color = 0.25 * (fetch(src) + fetch(src + ivec2(1, 0)) + fetch(src + ivec2(0, 1)) + fetch(src + ivec2(1, 1)));
+            \\    // Stores outside a level are discarded, so groups on the edges need no bounds checks
+            \\    imageStore(levels[0], texel, fromLinear(color));
+            \\    tile[local.y][local.x] = color;
+            \\    for (int level = 1; level < levelCount; level++) {
+            \\        memoryBarrierShared();
+            \\        barrier();
+            \\        int step = 1 << level;
+            \\        int reach = step >> 1;
+            \\        bool writes = (local.x & (step - 1)) == 0 && (local.y & (step - 1)) == 0;
+            \\        if (writes) {
+            \\            color = 0.25 * (color + tile[local.y][local.x + reach] + tile[local.y + reach][local.x] + tile[local.y + reach][local.x + reach]);
+            \\            imageStore(levels[level], texel >> level, fromLinear(color));
+            \\        }
+            \\        memoryBarrierShared();
+            \\        barrier();
+            \\        if (writes) tile[local.y][local.x] = color;
+            \\    }
+            \\}
+        ;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// The generator of the GL context current on this thread
+    pub fn shared() *Self {
+        return &shared_generator;
+    }
+
+
+    /// Compute shaders with image load and store
+    pub fn isSupported() bool {
+        return gl_ext.dispatchCompute != null and gl_ext.memoryBarrier != null and gl_ext.bindImageTexture != null;
+    }
+
+
+    /// Fill levels 1 to `levels` - 1 of `texture` from level 0, every level must already be allocated
+    /// `internal_format` is that of the texture, `width` x `height` the size of level 0
+    /// Leaves the texture bound to unit 0 when it falls back to glGenerateMipmap
+    pub fn generate(self: *Self, texture: c.GLuint, internal_format: c.GLenum, width: i32, height: i32, levels: i32, color_space: MipColorSpace) void {
+        if (levels <= 1) return;
+        const program = self.programFor(internal_format) orelse return fallback(texture);
+
+        const state = GLStateCache.current();
+        state.useProgram(program);
+        c.glUniform1i(c.glGetUniformLocation(program, "srgb"), @intFromBool(color_space == .srgb));
+        const count_location = c.glGetUniformLocation(program, "levelCount");
+
+        const bindImageTexture = gl_ext.bindImageTexture.?;
+        var base: i32 = 0;
+        while (base + 1 < levels) : (base += levels_per_dispatch) {
+            const count = @min(levels - 1 - base, levels_per_dispatch);
+            bindImageTexture(0, texture, base, c.GL_FALSE, 0, c.GL_READ_ONLY, internal_format);
+            for (0..levels_per_dispatch) |i| {
+                // Units past the chain are never written, they just need a valid image
+                const level = base + 1 + @min(@as(i32, @intCast(i)), count - 1);
+                bindImageTexture(@intCast(1 + i), texture, level, c.GL_FALSE, 0, c.GL_WRITE_ONLY, internal_format);
+            }
+            c.glUniform1i(count_location, count);
+
+            const w: u32 = @intCast(@max(width >> @intCast(base + 1), 1));
+            const h: u32 = @intCast(@max(height >> @intCast(base + 1), 1));
+            gl_ext.dispatchCompute.?(groupCount(w), groupCount(h), 1);
+            // The next dispatch reads the last level of this one
+            gl_ext.memoryBarrier.?(gl_ext.GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+        gl_ext.memoryBarrier.?(gl_ext.GL_TEXTURE_FETCH_BARRIER_BIT);
+        err.checkGLError("MipGenerator.generate");
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Delete the programs, the next chain builds them again
+    pub fn deinit(self: *Self) void {
+        const state = GLStateCache.current();
+        for ([_]c.GLuint{ self.rgba8_program, self.rgba16f_program }) |program| {
+            if (program == 0) continue;
+            state.forgetProgram(program);
+            c.glDeleteProgram(program);
+        }
+        err.checkGLError("MipGenerator cleanup");
+        self.* = .{};
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Program for images of `internal_format`, built on first use, null when the fallback has to do
+    fn programFor(self: *Self, internal_format: c.GLenum) ?c.GLuint {
+        if (self.failed or !isSupported()) return null;
+        const slot = switch (internal_format) {
+            c.GL_RGBA8 => &self.rgba8_program,
+            c.GL_RGBA16F => &self.rgba16f_program,
+            else => return null,
+        };
+        if (slot.* == 0) {
+            const source = if (internal_format == c.GL_RGBA8) rgba8_source else rgba16f_source;
+            slot.* = Shader.createComputeProgram(source) catch |e| {
+                std.debug.print("MipGenerator: falling back to glGenerateMipmap: {s}\n", .{@errorName(e)});
+                self.failed = true;
+                return null;
+            };
+        }
+        return slot.*;
+    }
+
+
+    fn fallback(texture: c.GLuint) void {
+        if (gl_ext.generateTextureMipmap) |generateTextureMipmap| {
+            generateTextureMipmap(texture);
+        } else {
+            GLStateCache.current().bindTexture2D(0, texture);
+            c.glGenerateMipmap(c.GL_TEXTURE_2D);
+        }
+        err.checkGLError("MipGenerator: glGenerateMipmap");
+    }
+
+
+    fn groupCount(size: u32) u32 {
+        return (size + group_size - 1) / group_size;
+    }
+};
@@ -3,6 +3,7 @@ const std = @import("std");
 
 const Mesh = @import("mesh.zig").Mesh;
 const Material = @import("material.zig").Material;
+const BoundingBox = @import("../math/bounds.zig").BoundingBox;
 
 
 pub const ModelError = error{
@@ -10,6 +11,8 @@ pub const ModelError = error{
     InvalidIndex,
     MeshNotFound,
     MaterialNotFound,
+    /// LOD thresholds have to shrink with every coarser level
+    InvalidLodThreshold,
 };
 
 
@@ -19,8 +22,21 @@ pub const MeshMaterialPair = struct {
 }; 
 
 
+/// Coarser version of a model, drawn while its projected size is below `max_screen_size`
+pub const LodLevel = struct {
+    pairs: std.ArrayList(MeshMaterialPair),
+    /// Bounding sphere diameter over the viewport height, see Camera.screenSize
+    max_screen_size: f32,
+};
+
+
 pub const Model = struct {
+    /// Full detail, LOD 0
     pairs: std.ArrayList(MeshMaterialPair),
+    /// LOD 1 onwards, each coarser than the one before
+    lods: std.ArrayList(LodLevel),
+    /// Object-space bounds of every mesh, used for culling
+    bounds: BoundingBox = BoundingBox.empty,
 
     ref_count: std.atomic.Value(u32),
     allocator: std.mem.Allocator,
@@ -37,6 +53,7 @@ pub const Model = struct {
 
         model_ptr.* = .{
             .pairs = std.ArrayList(MeshMaterialPair).init(allocator),
+            .lods = std.ArrayList(LodLevel).init(allocator),
             .allocator = allocator,
             .ref_count = std.atomic.Value(u32).init(1),
         };
@@ -57,6 +74,69 @@ pub const Model = struct {
         mesh.addRef();
         material.addRef();
         try self.pairs.append(.{ .mesh = mesh, .material = material });
+        self.bounds = self.bounds.merge(mesh.bounds);
+    }
+
+
+    /// Append a coarser level used below `max_screen_size`, returns its LOD index
+    pub fn addLod(self: *Model, max_screen_size: f32) !usize {
+        if (self.lods.items.len > 0 and max_screen_size >= self.lods.items[self.lods.items.len - 1].max_screen_size) {
+            return ModelError.InvalidLodThreshold;
+        }
+        try self.lods.append(.{
+            .pairs = std.ArrayList(MeshMaterialPair).init(self.allocator),
+            .max_screen_size = max_screen_size,
+        });
+        return self.lods.items.len;
+    }
+
+
+    pub fn addLodMeshMaterial(self: *Model, lod: usize, mesh: *Mesh, material: *Material) !void {
+        if (lod == 0) return self.addMeshMaterial(mesh, material);
+        if (lod > self.lods.items.len) return ModelError.InvalidIndex;
+
+        mesh.addRef();
+        material.addRef();
+        try self.lods.items[lod - 1].pairs.append(.{ .mesh = mesh, .material = material });
+        self.bounds = self.bounds.merge(mesh.bounds);
+    }
+
+
+    /// Pairs drawn at `lod`, clamped to the coarsest level
+    pub fn getLodPairs(self: *const Model, lod: usize) []const MeshMaterialPair {
+        if (lod == 0 or self.lods.items.len == 0) return self.pairs.items;
+        return self.lods.items[@min(lod, self.lods.items.len) - 1].pairs.items;
+    }
+
+
+    /// Number of levels including full detail
+    pub fn getLodCount(self: *const Model) usize {
+        return self.lods.items.len + 1;
+    }
+
+
+    /// LOD for a projected size, starting from the one drawn last frame
+    /// A level only changes once the size passes its threshold by `hysteresis`, a fraction of it,
+    /// so objects hovering around a threshold don't flip between levels every frame
+    pub fn selectLod(self: *const Model, screen_size: f32, current: usize, hysteresis: f32) usize {
+        const levels = self.lods.items;
+        var lod = @min(current, levels.len);
+
+        // Coarser while the size is clearly below the next level's threshold
+        while (lod < levels.len and screen_size < levels[lod].max_screen_size * (1.0 - hysteresis)) lod += 1;
+        // Finer while the size is clearly above the current level's threshold
+        while (lod > 0 and screen_size >= levels[lod - 1].max_screen_size * (1.0 + hysteresis)) lod -= 1;
+        return lod;
+    }
+
+
+    /// Recompute the bounds, call after updating the vertex data of one of the meshes
+    pub fn updateBounds(self: *Model) void {
+        self.bounds = BoundingBox.empty;
+        for (self.pairs.items) |pair| self.bounds = self.bounds.merge(pair.mesh.bounds);
+        for (self.lods.items) |level| {
+            for (level.pairs.items) |pair| self.bounds = self.bounds.merge(pair.mesh.bounds);
+        }
     }
 
 
@@ -83,6 +163,16 @@ pub const Model = struct {
             }
 
             self.pairs.deinit();
+
+            for (self.lods.items) |*level| {
+                for (level.pairs.items) |pair| {
+                    _ = pair.mesh.release();
+                    _ = pair.material.release();
+                }
+                level.pairs.deinit();
+            }
+            self.lods.deinit();
+
             self.allocator.destroy(self);
         }
         return prev;
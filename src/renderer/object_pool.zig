@@ -0,0 +1,164 @@
+// graphics/object_pool.zig
+const std = @import("std");
+
+
+/// Fixed-size allocation of T objects from contiguous chunks, for the structs of one resource type
+/// allocator() hands out a std.mem.Allocator that serves every allocation of exactly @sizeOf(T)
+/// bytes from the pool and passes everything else on to the child allocator, so create functions
+/// that take an allocator put their object in the pool without changing, and their own internal
+/// allocations still go to the general-purpose heap. Objects created one after another sit next to
+/// each other in memory and freed ones are reused before a new chunk is allocated
+/// Pooled allocations and frees lock a mutex, resources are created by loader threads and their last
+/// reference may go on any thread
+pub fn ObjectPool(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        pub const objects_per_chunk = 64;
+
+        const FreeNode = struct {
+            next: ?*FreeNode,
+        };
+
+        /// Freed objects hold the free list link, so an object is never smaller than one
+        const object_size = std.mem.alignForward(usize, @max(@sizeOf(T), @sizeOf(FreeNode)), object_alignment);
+        const object_alignment = @max(@alignOf(T), @alignOf(FreeNode));
+        const chunk_size = objects_per_chunk * object_size;
+        const Chunk = []align(object_alignment) u8;
+
+        child_allocator: std.mem.Allocator,
+        chunks: std.ArrayListUnmanaged(Chunk) = .{},
+        free_list: ?*FreeNode = null,
+        /// Objects handed out and not freed yet
+        live_count: usize = 0,
+        /// Guards the chunks and the free list
+        mutex: std.Thread.Mutex = .{},
+
+        const vtable = std.mem.Allocator.VTable{
+            .alloc = alloc,
+            .resize = resize,
+            .remap = remap,
+            .free = free,
+        };
+
+
+        // ============================================================
+        // Public API: Creation Functions
+        // ============================================================
+
+        pub fn init(child_allocator: std.mem.Allocator) Self {
+            return .{ .child_allocator = child_allocator };
+        }
+
+
+        // ============================================================
+        // Public API: Operational Functions
+        // ============================================================
+
+        /// Allocator backed by the pool, the pool must not move while anything allocated from it lives
+        pub fn allocator(self: *Self) std.mem.Allocator {
+            return .{ .ptr = self, .vtable = &vtable };
+        }
+
+
+        /// Objects currently allocated from the pool
+        pub fn liveCount(self: *const Self) usize {
+            return self.live_count;
+        }
+
+
+        /// Bytes of all chunks, live and free objects together
+        pub fn capacityBytes(self: *const Self) usize {
+            return self.chunks.items.len * chunk_size;
+        }
+
+
+        // ============================================================
+        // Public API: Destruction Function
+        // ============================================================
+
+        /// Frees the chunks, unless objects are still live, whose memory is then left allocated
+        /// so a late release through an outside reference doesn't touch freed memory
+        pub fn deinit(self: *Self) void {
+            if (self.live_count > 0) {
+                std.log.warn("ObjectPool({s}): {d} objects still live at deinit, leaking their chunks", .{ @typeName(T), self.live_count });
+                self.chunks.deinit(self.child_allocator);
+                return;
+            }
+            for (self.chunks.items) |chunk| self.child_allocator.free(chunk);
+            self.chunks.deinit(self.child_allocator);
+            self.free_list = null;
+        }
+
+
+        // ============================================================
+        // Private: Helper Functions
+        // ============================================================
+
+        fn isPooled(len: usize, alignment: std.mem.Alignment) bool {
+            return len == @sizeOf(T) and alignment.toByteUnits() <= object_alignment;
+        }
+
+
+        /// Add a chunk, its objects enter the free list lowest address first
+        fn grow(self: *Self) bool {
+            self.chunks.ensureUnusedCapacity(self.child_allocator, 1) catch return false;
+            const chunk = self.child_allocator.alignedAlloc(u8, object_alignment, chunk_size) catch return false;
+            self.chunks.appendAssumeCapacity(chunk);
+
+            var i: usize = objects_per_chunk;
+            while (i > 0) {
+                i -= 1;
+                const node: *FreeNode = @alignCast(@ptrCast(chunk[i * object_size ..].ptr));
+                node.next = self.free_list;
+                self.free_list = node;
+            }
+            return true;
+        }
+
+
+        fn alloc(ctx: *anyopaque, len: usize, alignment: std.mem.Alignment, ret_addr: usize) ?[*]u8 {
+            const self: *Self = @alignCast(@ptrCast(ctx));
+            if (!isPooled(len, alignment)) return self.child_allocator.rawAlloc(len, alignment, ret_addr);
+
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            if (self.free_list == null and !self.grow()) return null;
+            const node = self.free_list.?;
+            self.free_list = node.next;
+            self.live_count += 1;
+            return @ptrCast(node);
+        }
+
+
+        /// Pooled objects keep their size, and nothing may grow or shrink into the pooled size in
+        /// place, because the free would then hand a child allocation to the pool
+        fn resize(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) bool {
+            const self: *Self = @alignCast(@ptrCast(ctx));
+            if (isPooled(memory.len, alignment)) return new_len == memory.len;
+            if (isPooled(new_len, alignment)) return false;
+            return self.child_allocator.rawResize(memory, alignment, new_len, ret_addr);
+        }
+
+
+        fn remap(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) ?[*]u8 {
+            const self: *Self = @alignCast(@ptrCast(ctx));
+            if (isPooled(memory.len, alignment)) return if (new_len == memory.len) memory.ptr else null;
+            if (isPooled(new_len, alignment)) return null;
+            return self.child_allocator.rawRemap(memory, alignment, new_len, ret_addr);
+        }
+
+
+        fn free(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, ret_addr: usize) void {
+            const self: *Self = @alignCast(@ptrCast(ctx));
+            if (!isPooled(memory.len, alignment)) return self.child_allocator.rawFree(memory, alignment, ret_addr);
+
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            const node: *FreeNode = @alignCast(@ptrCast(memory.ptr));
+            node.next = self.free_list;
+            self.free_list = node;
+            self.live_count -= 1;
+        }
+    };
+}
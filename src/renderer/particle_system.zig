@@ -0,0 +1,453 @@
+// graphics/particle_system.zig - particles simulated and drawn entirely on the GPU
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+
+const Shader = @import("shader.zig").Shader;
+const camera_block_glsl = @import("shader.zig").camera_block_glsl;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const Camera = @import("camera.zig").Camera;
+const render_stats = @import("render_stats.zig");
+const profiler = @import("../core/profiler.zig");
+
+
+pub const ParticleSystemError = error{
+    /// Compute shaders, storage buffers or indirect draws are missing, see ParticleSystem.isSupported
+    Unsupported,
+};
+
+
+pub const ParticleSystemConfig = struct {
+    /// Particles alive at once, emission beyond it is dropped on the GPU
+    capacity: u32 = 1 << 20,
+    gravity: [3]f32 = .{ 0.0, -9.81, 0.0 },
+    /// Fraction of velocity lost per second
+    drag: f32 = 0.0,
+    /// Add the particles onto the scene, otherwise alpha blend them
+    additive: bool = true,
+};
+
+
+/// Source of new particles, update advances `accumulated` so fractional rates work at any frame rate
+pub const ParticleEmitter = struct {
+    position: [3]f32,
+    /// Particles per second
+    rate: f32,
+    /// Center of the emission cone
+    direction: [3]f32 = .{ 0.0, 1.0, 0.0 },
+    /// Half angle of the cone in radians, pi emits in every direction
+    spread: f32 = 0.3,
+    /// Ranges picked from uniformly per particle
+    speed: [2]f32 = .{ 1.0, 2.0 },
+    lifetime: [2]f32 = .{ 1.0, 2.0 },
+    /// Size at birth and at death
+    size: [2]f32 = .{ 0.1, 0.0 },
+    color_start: [4]f32 = .{ 1.0, 1.0, 1.0, 1.0 },
+    color_end: [4]f32 = .{ 1.0, 1.0, 1.0, 0.0 },
+    /// Particles owed from earlier frames, below one
+    accumulated: f32 = 0.0,
+    /// Particles emitted on the next update on top of the rate, then cleared
+    burst: u32 = 0,
+
+    /// Particles due after `delta` seconds, at most `limit`, consuming the burst
+    pub fn advance(self: *ParticleEmitter, delta: f32, limit: u32) u32 {
+        self.accumulated += self.rate * delta;
+        const whole = @floor(self.accumulated);
+        self.accumulated -= whole;
+        const count = @min(@as(u64, @intFromFloat(whole)) + self.burst, limit);
+        self.burst = 0;
+        return @intCast(count);
+    }
+};
+
+
+/// std430 layout of one particle
+const Particle = extern struct {
+    /// xyz position, w remaining life
+    position_life: [4]f32,
+    /// xyz velocity, w total life
+    velocity_max_life: [4]f32,
+    color_start: u32,
+    color_end: u32,
+    size_start: f32,
+    size_end: f32,
+};
+
+
+/// Layout of glDrawArraysIndirect's command, the instance count is the alive count
+const DrawArraysIndirectCommand = extern struct {
+    count: u32,
+    instance_count: u32,
+    first: u32,
+    base_instance: u32,
+};
+
+
+/// Particles kept in two storage buffers that swap roles every update
+/// The simulation pass integrates every particle of one buffer and appends the survivors to the other through
+/// an atomic counter, which packs the live particles without a separate compaction pass. Emission passes append
+/// new particles to the same buffer. The counter is the instance count of an indirect draw, each particle drawn
+/// as a camera facing quad, so the CPU never learns how many particles there are
+pub const ParticleSystem = struct {
+    const Self = @This();
+
+    /// Storage bindings, after the clustered lighting buffers
+    pub const particles_in_binding = 10;
+    pub const particles_out_binding = 11;
+    pub const count_in_binding = 12;
+    pub const count_out_binding = 13;
+
+    const simulate_workgroup_size = 256;
+    const emit_workgroup_size = 64;
+
+    const particle_glsl =
+        \\struct Particle {
+        \\    vec4 positionLife;
+        \\    vec4 velocityMaxLife;
+        \\    uint colorStart;
+        \\    uint colorEnd;
+        \\    float sizeStart;
+        \\    float sizeEnd;
+        \\};
+        \\struct DrawCommand { uint count; uint instanceCount; uint first; uint baseInstance; };
+        \\
+    ;
+
+    const storage_glsl = std.fmt.comptimePrint(
+        \\layout(std430, binding = {d}) readonly buffer ParticlesIn {{ Particle particlesIn[]; }};
+        \\layout(std430, binding = {d}) writeonly buffer ParticlesOut {{ Particle particlesOut[]; }};
+        \\layout(std430, binding = {d}) readonly buffer CountIn {{ DrawCommand countIn; }};
+        \\layout(std430, binding = {d}) buffer CountOut {{ DrawCommand countOut; }};
+        \\
+    , .{ particles_in_binding, particles_out_binding, count_in_binding, count_out_binding });
+
+    const simulate_source = "#version 430 core\n" ++ particle_glsl ++ storage_glsl ++ std.fmt.comptimePrint(
+        \\layout(local_size_x = {d}) in;
+        \\uniform float deltaTime;
+        \\uniform vec3 gravity;
+        \\uniform float drag;
+        \\void main() {{
+        \\    uint i = gl_GlobalInvocationID.x;
+        \\    if (i >= countIn.instanceCount) return;
+        \\    Particle p = particlesIn[i];
+        \\    p.positionLife.w -= deltaTime;
+        \\    if (p.positionLife.w <= 0.0) return;
+        \\    vec3 velocity = (p.velocityMaxLife.xyz + gravity * deltaTime) * max(1.0 - drag * deltaTime, 0.0);
+        \\    p.velocityMaxLife.xyz = velocity;
+        \\    p.positionLife.xyz += velocity * deltaTime;
+        \\    particlesOut[atomicAdd(countOut.instanceCount, 1u)] = p;
+        \\}}
+    , .{simulate_workgroup_size});
+
+    const emit_source = "#version 430 core\n" ++ particle_glsl ++ storage_glsl ++ std.fmt.comptimePrint(
+        \\layout(local_size_x = {d}) in;
+        \\uniform uint emitCount;
+        \\uniform uint capacity;
+        \\uniform uint seed;
+        \\uniform vec3 origin;
+        \\uniform vec3 direction;
+        \\uniform float spread;
+        \\uniform vec2 speed;
+        \\uniform vec2 lifetime;
+        \\uniform vec2 size;
+        \\uniform uint colorStart;
+        \\uniform uint colorEnd;
+        \\uint hash(uint x) {{
+        \\    x ^= x >> 16; x *= 0x7feb352du;
+        \\    x ^= x >> 15; x *= 0x846ca68bu;
+        \\    x ^= x >> 16;
+        \\    return x;
+        \\}}
+        \\float random(inout uint state) {{
+        \\    state = hash(state);
+        \\    return float(state) / 4294967295.0;
+        \\}}
+        \\void main() {{
+        \\    uint i = gl_GlobalInvocationID.x;
+        \\    if (i >= emitCount) return;
+        \\    uint slot = atomicAdd(countOut.instanceCount, 1u);
+        \\    // Full, give the slot back, the count never drops below the capacity once it reached it
+        \\    if (slot >= capacity) {{
+        \\        atomicAdd(countOut.instanceCount, 0xFFFFFFFFu);
+        \\        return;
+        \\    }}
+        \\    uint state = hash(seed ^ hash(i));
+        \\    float cosTheta = mix(1.0, cos(spread), random(state));
+        \\    float sinTheta = sqrt(max(1.0 - cosTheta * cosTheta, 0.0));
+        \\    float phi = 6.28318530718 * random(state);
+        \\    vec3 axis = normalize(direction);
+        \\    vec3 tangent = normalize(cross(axis, abs(axis.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+        \\    vec3 bitangent = cross(axis, tangent);
+        \\    vec3 dir = axis * cosTheta + (tangent * cos(phi) + bitangent * sin(phi)) * sinTheta;
+        \\    float life = mix(lifetime.x, lifetime.y, random(state));
+        \\    Particle p;
+        \\    p.positionLife = vec4(origin, life);
+        \\    p.velocityMaxLife = vec4(dir * mix(speed.x, speed.y, random(state)), life);
+        \\    p.colorStart = colorStart;
+        \\    p.colorEnd = colorEnd;
+        \\    p.sizeStart = size.x;
+        \\    p.sizeEnd = size.y;
+        \\    particlesOut[slot] = p;
+        \\}}
+    , .{emit_workgroup_size});
+
+    const draw_vertex_source = "#version 430 core\n" ++ camera_block_glsl ++ particle_glsl ++ std.fmt.comptimePrint(
+        \\layout(std430, binding = {d}) readonly buffer Particles {{ Particle particles[]; }};
+        \\out vec2 Corner;
+        \\out vec4 Color;
+        \\const vec2 corners[6] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0), vec2(-1.0, -1.0));
+        \\void main() {{
+        \\    Particle p = particles[gl_InstanceID];
+        \\    float age = 1.0 - p.positionLife.w / p.velocityMaxLife.w;
+        \\    vec2 corner = corners[gl_VertexID];
+        \\    float halfSize = mix(p.sizeStart, p.sizeEnd, age) * 0.5;
+        \\    vec3 right = vec3(view[0][0], view[1][0], view[2][0]);
+        \\    vec3 up = vec3(view[0][1], view[1][1], view[2][1]);
+        \\    vec3 world = p.positionLife.xyz + (right * corner.x + up * corner.y) * halfSize;
+        \\    gl_Position = viewProjection * vec4(world, 1.0);
+        \\    Corner = corner;
+        \\    Color = mix(unpackUnorm4x8(p.colorStart), unpackUnorm4x8(p.colorEnd), age);
+        \\}}
+    , .{particles_in_binding});
+
+    const draw_fragment_source =
+        \\#version 430 core
+        \\in vec2 Corner;
+        \\in vec4 Color;
+        \\out vec4 FragColor;
+        \\uniform bool additive;
+        \\void main() {
+        \\    float alpha = Color.a * (1.0 - smoothstep(0.5, 1.0, length(Corner)));
+        \\    if (alpha <= 0.0) discard;
+        \\    FragColor = additive ? vec4(Color.rgb * alpha, 1.0) : vec4(Color.rgb, alpha);
+        \\}
+    ;
+
+    config: ParticleSystemConfig,
+    simulate_program: c.GLuint,
+    emit_program: c.GLuint,
+    draw_shader: *Shader,
+    /// Core profiles need a VAO bound to draw, the vertices come from gl_VertexID
+    empty_vao: c.GLuint,
+
+    particle_buffers: [2]c.GLuint,
+    /// Indirect draw command of each particle buffer, holding its alive count
+    command_buffers: [2]c.GLuint,
+    /// Buffer the last update wrote, the one drawn
+    current: u1 = 0,
+    /// Varies the random streams of the emission passes
+    seed: u32 = 0x9e3779b9,
+
+    simulate_locations: struct { delta_time: c.GLint, gravity: c.GLint, drag: c.GLint },
+    emit_locations: struct {
+        emit_count: c.GLint,
+        capacity: c.GLint,
+        seed: c.GLint,
+        origin: c.GLint,
+        direction: c.GLint,
+        spread: c.GLint,
+        speed: c.GLint,
+        lifetime: c.GLint,
+        size: c.GLint,
+        color_start: c.GLint,
+        color_end: c.GLint,
+    },
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, config: ParticleSystemConfig) !Self {
+        if (!isSupported()) return ParticleSystemError.Unsupported;
+
+        const simulate_program = try Shader.createComputeProgram(simulate_source);
+        errdefer c.glDeleteProgram(simulate_program);
+        const emit_program = try Shader.createComputeProgram(emit_source);
+        errdefer c.glDeleteProgram(emit_program);
+        const draw_shader = try Shader.create(allocator, draw_vertex_source, draw_fragment_source);
+        errdefer _ = draw_shader.release();
+
+        var self = Self{
+            .config = config,
+            .simulate_program = simulate_program,
+            .emit_program = emit_program,
+            .draw_shader = draw_shader,
+            .empty_vao = 0,
+            .particle_buffers = undefined,
+            .command_buffers = undefined,
+            .simulate_locations = .{
+                .delta_time = c.glGetUniformLocation(simulate_program, "deltaTime"),
+                .gravity = c.glGetUniformLocation(simulate_program, "gravity"),
+                .drag = c.glGetUniformLocation(simulate_program, "drag"),
+            },
+            .emit_locations = .{
+                .emit_count = c.glGetUniformLocation(emit_program, "emitCount"),
+                .capacity = c.glGetUniformLocation(emit_program, "capacity"),
+                .seed = c.glGetUniformLocation(emit_program, "seed"),
+                .origin = c.glGetUniformLocation(emit_program, "origin"),
+                .direction = c.glGetUniformLocation(emit_program, "direction"),
+                .spread = c.glGetUniformLocation(emit_program, "spread"),
+                .speed = c.glGetUniformLocation(emit_program, "speed"),
+                .lifetime = c.glGetUniformLocation(emit_program, "lifetime"),
+                .size = c.glGetUniformLocation(emit_program, "size"),
+                .color_start = c.glGetUniformLocation(emit_program, "colorStart"),
+                .color_end = c.glGetUniformLocation(emit_program, "colorEnd"),
+            },
+        };
+
+        c.glGenVertexArrays(1, &self.empty_vao);
+        c.glGenBuffers(2, &self.particle_buffers);
+        c.glGenBuffers(2, &self.command_buffers);
+        err.checkGLError("glGenBuffers for ParticleSystem");
+
+        const empty = DrawArraysIndirectCommand{ .count = 6, .instance_count = 0, .first = 0, .base_instance = 0 };
+        for (self.particle_buffers, self.command_buffers) |particles, command| {
+            uploadStorage(particles, @as(usize, config.capacity) * @sizeOf(Particle), null, c.GL_DYNAMIC_COPY);
+            uploadStorage(command, @sizeOf(DrawArraysIndirectCommand), &empty, c.GL_DYNAMIC_COPY);
+        }
+
+        GLStateCache.current().useProgram(draw_shader.program);
+        c.glUniform1i(c.glGetUniformLocation(draw_shader.program, "additive"), @intFromBool(config.additive));
+        err.checkGLError("ParticleSystem setup");
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    pub fn isSupported() bool {
+        return gl_ext.hasGpuCulling() and gl_ext.drawArraysIndirect != null;
+    }
+
+
+    /// Age and move every particle by `delta` seconds, drop the dead ones and emit from `emitters`
+    pub fn update(self: *Self, delta: f32, emitters: []ParticleEmitter) void {
+        const zone = profiler.zone("ParticleSystem.update");
+        defer zone.end();
+
+        const source = self.current;
+        const target = source ^ 1;
+        const state = GLStateCache.current();
+
+        // Survivors and new particles are counted into the target from zero
+        const zero: u32 = 0;
+        c.glBindBuffer(gl_ext.GL_SHADER_STORAGE_BUFFER, self.command_buffers[target]);
+        c.glBufferSubData(gl_ext.GL_SHADER_STORAGE_BUFFER, @offsetOf(DrawArraysIndirectCommand, "instance_count"), @sizeOf(u32), &zero);
+
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, particles_in_binding, self.particle_buffers[source]);
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, particles_out_binding, self.particle_buffers[target]);
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, count_in_binding, self.command_buffers[source]);
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, count_out_binding, self.command_buffers[target]);
+
+        // Every slot gets a thread, the ones past the alive count return at once
+        state.useProgram(self.simulate_program);
+        c.glUniform1f(self.simulate_locations.delta_time, delta);
+        c.glUniform3fv(self.simulate_locations.gravity, 1, &self.config.gravity);
+        c.glUniform1f(self.simulate_locations.drag, self.config.drag);
+        gl_ext.dispatchCompute.?(groupCount(self.config.capacity, simulate_workgroup_size), 1, 1);
+
+        state.useProgram(self.emit_program);
+        c.glUniform1ui(self.emit_locations.capacity, self.config.capacity);
+        for (emitters) |*emitter| {
+            const count = emitter.advance(delta, self.config.capacity);
+            if (count == 0) continue;
+
+            self.seed = self.seed *% 0x2c1b3c6d +% 0x297a2d39;
+            c.glUniform1ui(self.emit_locations.emit_count, count);
+            c.glUniform1ui(self.emit_locations.seed, self.seed);
+            c.glUniform3fv(self.emit_locations.origin, 1, &emitter.position);
+            c.glUniform3fv(self.emit_locations.direction, 1, &emitter.direction);
+            c.glUniform1f(self.emit_locations.spread, emitter.spread);
+            c.glUniform2fv(self.emit_locations.speed, 1, &emitter.speed);
+            c.glUniform2fv(self.emit_locations.lifetime, 1, &emitter.lifetime);
+            c.glUniform2fv(self.emit_locations.size, 1, &emitter.size);
+            c.glUniform1ui(self.emit_locations.color_start, packColor(emitter.color_start));
+            c.glUniform1ui(self.emit_locations.color_end, packColor(emitter.color_end));
+            // Emission appends behind the survivors, so it has to see all of their counter increments
+            gl_ext.memoryBarrier.?(gl_ext.GL_SHADER_STORAGE_BARRIER_BIT);
+            gl_ext.dispatchCompute.?(groupCount(count, emit_workgroup_size), 1, 1);
+        }
+
+        // The draw reads the count as its command and the particles from its vertex shader
+        gl_ext.memoryBarrier.?(gl_ext.GL_COMMAND_BARRIER_BIT | gl_ext.GL_SHADER_STORAGE_BARRIER_BIT);
+        err.checkGLError("ParticleSystem.update");
+        self.current = target;
+    }
+
+
+    /// Draw every live particle as a camera facing quad, after the opaque geometry
+    /// Depth is tested but not written, so particles never hide each other
+    pub fn draw(self: *Self, camera: *Camera) void {
+        camera.uploadFrameData();
+        const state = GLStateCache.current();
+        const saved_cull_face = state.cull_face;
+
+        state.useProgram(self.draw_shader.program);
+        state.bindVertexArray(self.empty_vao);
+        state.setDepthMask(false);
+        state.setCullFace(false);
+        c.glEnable(c.GL_BLEND);
+        if (self.config.additive) c.glBlendFunc(c.GL_ONE, c.GL_ONE) else c.glBlendFunc(c.GL_SRC_ALPHA, c.GL_ONE_MINUS_SRC_ALPHA);
+
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, particles_in_binding, self.particle_buffers[self.current]);
+        c.glBindBuffer(gl_ext.GL_DRAW_INDIRECT_BUFFER, self.command_buffers[self.current]);
+        gl_ext.drawArraysIndirect.?(c.GL_TRIANGLES, null);
+        err.checkGLError("ParticleSystem.draw: glDrawArraysIndirect");
+        render_stats.countIndirectDraw();
+
+        c.glDisable(c.GL_BLEND);
+        state.setDepthMask(true);
+        if (saved_cull_face) |enabled| state.setCullFace(enabled);
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        const state = GLStateCache.current();
+        state.forgetProgram(self.simulate_program);
+        state.forgetProgram(self.emit_program);
+        state.forgetVertexArray(self.empty_vao);
+        c.glDeleteProgram(self.simulate_program);
+        c.glDeleteProgram(self.emit_program);
+        c.glDeleteVertexArrays(1, &self.empty_vao);
+        c.glDeleteBuffers(2, &self.particle_buffers);
+        c.glDeleteBuffers(2, &self.command_buffers);
+        err.checkGLError("ParticleSystem cleanup");
+
+        _ = self.draw_shader.release();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn groupCount(count: u32, workgroup_size: u32) u32 {
+        return @max((count + workgroup_size - 1) / workgroup_size, 1);
+    }
+
+
+    /// RGBA8 in the order unpackUnorm4x8 reads it, red in the low byte
+    pub fn packColor(color: [4]f32) u32 {
+        var result: u32 = 0;
+        for (color, 0..) |channel, i| {
+            const byte: u32 = @intFromFloat(@round(std.math.clamp(channel, 0.0, 1.0) * 255.0));
+            result |= byte << @intCast(i * 8);
+        }
+        return result;
+    }
+
+
+    fn uploadStorage(buffer: c.GLuint, size: usize, data: ?*const anyopaque, usage: c.GLenum) void {
+        c.glBindBuffer(gl_ext.GL_SHADER_STORAGE_BUFFER, buffer);
+        c.glBufferData(gl_ext.GL_SHADER_STORAGE_BUFFER, @intCast(size), data, usage);
+        err.checkGLError("ParticleSystem: glBufferData");
+    }
+};
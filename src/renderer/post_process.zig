@@ -0,0 +1,510 @@
+// graphics/post_process.zig - HDR bloom, auto exposure and tonemapping
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+const monotonicNs = @import("../core/time.zig").monotonicNs;
+
+const Shader = @import("shader.zig").Shader;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const Renderer = @import("renderer.zig").Renderer;
+
+
+pub const PostProcessError = error{
+    /// The driver lacks compute shaders or image load/store
+    Unsupported,
+};
+
+
+pub const PostProcessConfig = struct {
+    /// Levels of the bloom pyramid below half resolution, more spread the glow wider
+    bloom_levels: u32 = 6,
+    /// Brightness above which pixels glow, in scene units after exposure is left out
+    bloom_threshold: f32 = 1.0,
+    /// Width of the soft transition around the threshold
+    bloom_knee: f32 = 0.5,
+    /// Weight of the glow added back to the scene, 0 skips the bloom passes
+    bloom_intensity: f32 = 0.05,
+    /// Exposure from the scene's average luminance, fixed `exposure` otherwise
+    auto_exposure: bool = true,
+    exposure: f32 = 1.0,
+    /// Average luminance auto exposure maps to middle grey
+    key_value: f32 = 0.18,
+    /// Log2 luminance range the histogram covers, darker and brighter texels go into its end bins
+    min_log_luminance: f32 = -10.0,
+    max_log_luminance: f32 = 6.0,
+    /// Bounds of the auto exposure
+    min_exposure: f32 = 0.05,
+    max_exposure: f32 = 20.0,
+    /// How fast the exposure follows the scene, per second
+    adaptation_rate: f32 = 1.5,
+    /// Encode the tonemapped colors for a display without an sRGB framebuffer
+    encode_srgb: bool = true,
+};
+
+
+/// Post effects of an HDR scene target, merged into four kinds of pass
+/// One compute dispatch bins the scene's luminance into a histogram in shared memory and another reduces it
+/// to an exposure, kept in a storage buffer so it never comes back to the CPU. Bloom is a compute pyramid,
+/// thresholded while taking the first 13-tap downsample and added up level by level on the way back with a
+/// tent filter. A single fullscreen pass then applies exposure and bloom and tonemaps into the bound framebuffer
+/// Renderer.endScene runs it with post_process set, every stage in its own GPU timer scope
+pub const PostProcess = struct {
+    const Self = @This();
+
+    const histogram_bins = 256;
+    const histogram_group = 16;
+    const bloom_group = 8;
+    const scene_unit = 0;
+    const bloom_unit = 1;
+    const histogram_binding = 0;
+    const exposure_binding = 1;
+
+    const histogram_source =
+        \\#version 430 core
+        \\layout (local_size_x = 16, local_size_y = 16) in;
+        \\layout (std430, binding = 0) buffer Histogram { uint bins[256]; };
+        \\uniform sampler2D scene;
+        \\uniform ivec2 region;
+        \\// Log2 of the darkest luminance binned and the span of the range
+        \\uniform vec2 luminanceRange;
+        \\shared uint localBins[256];
+        \\void main() {
+        \\    localBins[gl_LocalInvocationIndex] = 0u;
+        \\    barrier();
+        \\    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+        \\    if (all(lessThan(texel, region))) {
+        \\        float luminance = dot(texelFetch(scene, texel, 0).rgb, vec3(0.2126, 0.7152, 0.0722));
+        \\        // Bin 0 holds black texels, they would drag the average down to nothing
+        \\        uint bin = 0u;
+        \\        if (luminance > 1e-5) {
+        \\            float position = clamp((log2(luminance) - luminanceRange.x) / luminanceRange.y, 0.0, 1.0);
+        \\            bin = uint(position * 254.0 + 1.0);
+        \\        }
+        \\        atomicAdd(localBins[bin], 1u);
+        \\    }
+        \\    barrier();
+        \\    uint count = localBins[gl_LocalInvocationIndex];
+        \\    if (count != 0u) atomicAdd(bins[gl_LocalInvocationIndex], count);
+        \\}
+    ;
+
+    const exposure_source =
+        \\#version 430 core
+        \\layout (local_size_x = 256) in;
+        \\layout (std430, binding = 0) buffer Histogram { uint bins[256]; };
+        \\layout (std430, binding = 1) buffer Exposure { float averageLuminance; float exposure; };
+        \\uniform vec2 luminanceRange;
+        \\uniform float pixelCount;
+        \\// Share of the new luminance blended in this frame
+        \\uniform float adaptation;
+        \\uniform float keyValue;
+        \\uniform vec2 exposureLimits;
+        \\shared float weighted[256];
+        \\void main() {
+        \\    uint i = gl_LocalInvocationIndex;
+        \\    uint count = bins[i];
+        \\    weighted[i] = float(count) * float(i);
+        \\    // Cleared for the next frame's histogram
+        \\    bins[i] = 0u;
+        \\    barrier();
+        \\    for (uint stride = 128u; stride > 0u; stride >>= 1u) {
+        \\        if (i < stride) weighted[i] += weighted[i + stride];
+        \\        barrier();
+        \\    }
+        \\    if (i == 0u) {
+        \\        // The black texels of bin 0 count toward neither the sum nor the texels averaged
+        \\        float lit = max(pixelCount - float(count), 1.0);
+        \\        float bin = weighted[0] / lit;
+        \\        float luminance = exp2(max(bin - 1.0, 0.0) / 254.0 * luminanceRange.y + luminanceRange.x);
+        \\        averageLuminance = mix(averageLuminance, luminance, adaptation);
+        \\        exposure = clamp(keyValue / max(averageLuminance, 1e-5), exposureLimits.x, exposureLimits.y);
+        \\    }
+        \\}
+    ;
+
+    /// 13-tap downsample into `target` from a level twice its size, thresholded when reading the scene
+    const downsample_source =
+        \\#version 430 core
+        \\layout (local_size_x = 8, local_size_y = 8) in;
+        \\layout (rgba16f, binding = 0) writeonly uniform image2D target;
+        \\uniform sampler2D source;
+        \\uniform float sourceLod;
+        \\uniform vec2 sourceTexel;
+        \\// Part of the source holding the scene, reads stay inside it
+        \\uniform vec2 uvScale;
+        \\uniform bool prefilter;
+        \\// Threshold and knee
+        \\uniform vec2 threshold;
+        \\vec3 tap(vec2 uv, vec2 offset) {
+        \\    return textureLod(source, min(uv + offset * sourceTexel, uvScale - 0.5 * sourceTexel), sourceLod).rgb;
+        \\}
+        \\void main() {
+        \\    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+        \\    ivec2 size = imageSize(target);
+        \\    if (any(greaterThanEqual(texel, size))) return;
+        \\    vec2 uv = (vec2(texel) + 0.5) / vec2(size) * uvScale;
+        \\    vec3 color = tap(uv, vec2(0.0)) * 0.125;
+        \\    color += (tap(uv, vec2(-2.0, 2.0)) + tap(uv, vec2(2.0, 2.0)) + tap(uv, vec2(-2.0, -2.0)) + tap(uv, vec2(2.0, -2.0))) * 0.03125;
+        \\    color += (tap(uv, vec2(0.0, 2.0)) + tap(uv, vec2(-2.0, 0.0)) + tap(uv, vec2(2.0, 0.0)) + tap(uv, vec2(0.0, -2.0))) * 0.0625;
+        \\    color += (tap(uv, vec2(-1.0, 1.0)) + tap(uv, vec2(1.0, 1.0)) + tap(uv, vec2(-1.0, -1.0)) + tap(uv, vec2(1.0, -1.0))) * 0.125;
+        \\    if (prefilter) {
+        \\        float brightness = max(color.r, max(color.g, color.b));
+        \\        float soft = clamp(brightness - threshold.x + threshold.y, 0.0, 2.0 * threshold.y);
+        \\        soft = soft * soft / (4.0 * threshold.y + 1e-5);
+        \\        color *= max(soft, brightness - threshold.x) / max(brightness, 1e-5);
+        \\    }
+        \\    imageStore(target, texel, vec4(color, 1.0));
+        \\}
+    ;
+
+    /// Add the tent filtered level below to `target`, the pyramid adds up toward level 0
+    const upsample_source =
+        \\#version 430 core
+        \\layout (local_size_x = 8, local_size_y = 8) in;
+        \\layout (rgba16f, binding = 0) uniform image2D target;
+        \\uniform sampler2D source;
+        \\uniform float sourceLod;
+        \\uniform vec2 sourceTexel;
+        \\vec3 tap(vec2 uv, vec2 offset) {
+        \\    return textureLod(source, uv + offset * sourceTexel, sourceLod).rgb;
+        \\}
+        \\void main() {
+        \\    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+        \\    ivec2 size = imageSize(target);
+        \\    if (any(greaterThanEqual(texel, size))) return;
+        \\    vec2 uv = (vec2(texel) + 0.5) / vec2(size);
+        \\    vec3 color = tap(uv, vec2(0.0)) * 4.0;
+        \\    color += (tap(uv, vec2(0.0, 1.0)) + tap(uv, vec2(-1.0, 0.0)) + tap(uv, vec2(1.0, 0.0)) + tap(uv, vec2(0.0, -1.0))) * 2.0;
+        \\    color += tap(uv, vec2(-1.0, 1.0)) + tap(uv, vec2(1.0, 1.0)) + tap(uv, vec2(-1.0, -1.0)) + tap(uv, vec2(1.0, -1.0));
+        \\    imageStore(target, texel, imageLoad(target, texel) + vec4(color / 16.0, 0.0));
+        \\}
+    ;
+
+    const composite_vertex =
+        \\#version 430 core
+        \\out vec2 uv;
+        \\void main() {
+        \\    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        \\    uv = corner;
+        \\    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+        \\}
+    ;
+    const composite_fragment =
+        \\#version 430 core
+        \\in vec2 uv;
+        \\out vec4 FragColor;
+        \\layout (std430, binding = 1) readonly buffer Exposure { float averageLuminance; float exposure; };
+        \\uniform sampler2D scene;
+        \\uniform sampler2D bloom;
+        \\uniform vec2 uvScale;
+        \\uniform float bloomIntensity;
+        \\// Used instead of the buffer's exposure when above 0
+        \\uniform float fixedExposure;
+        \\uniform bool encodeSrgb;
+        \\// Narkowicz's fit of the ACES filmic curve
+        \\vec3 tonemap(vec3 x) {
+        \\    return clamp(x * (2.51 * x + 0.03) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+        \\}
+        \\void main() {
+        \\    vec2 sceneUv = uv * uvScale;
+        \\    vec3 color = texture(scene, sceneUv).rgb;
+        \\    if (bloomIntensity > 0.0) color += textureLod(bloom, uv, 0.0).rgb * bloomIntensity;
+        \\    color = tonemap(color * (fixedExposure > 0.0 ? fixedExposure : exposure));
+        \\    if (encodeSrgb) color = mix(1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055, color * 12.92, lessThanEqual(color, vec3(0.0031308)));
+        \\    FragColor = vec4(color, 1.0);
+        \\}
+    ;
+
+    config: PostProcessConfig,
+
+    histogram_program: c.GLuint = 0,
+    exposure_program: c.GLuint = 0,
+    downsample_program: c.GLuint = 0,
+    upsample_program: c.GLuint = 0,
+    composite_program: c.GLuint = 0,
+    /// Attribute-less VAO for the fullscreen triangle
+    vao: c.GLuint = 0,
+
+    /// Bins of the current frame, zeroed again by the exposure pass
+    histogram_buffer: c.GLuint = 0,
+    /// Adapted average luminance and the exposure derived from it
+    exposure_buffer: c.GLuint = 0,
+
+    /// RGBA16F pyramid at half the target size holding the scene region stretched over it, 0 until resize
+    bloom_texture: c.GLuint = 0,
+    bloom_size: [2]u32 = .{ 0, 0 },
+    bloom_levels: u32 = 0,
+
+    /// Time of the last apply, for the exposure adaptation
+    last_apply_ns: u64 = 0,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(config: PostProcessConfig) !Self {
+        if (!isSupported()) return PostProcessError.Unsupported;
+
+        var self = Self{ .config = config };
+        // Names not created yet are 0 and ignored
+        errdefer self.deinit();
+
+        self.histogram_program = try Shader.createComputeProgram(histogram_source);
+        self.exposure_program = try Shader.createComputeProgram(exposure_source);
+        self.downsample_program = try Shader.createComputeProgram(downsample_source);
+        self.upsample_program = try Shader.createComputeProgram(upsample_source);
+        self.composite_program = try Shader.createProgram(composite_vertex, composite_fragment);
+
+        const state = GLStateCache.current();
+        state.useProgram(self.histogram_program);
+        c.glUniform1i(c.glGetUniformLocation(self.histogram_program, "scene"), scene_unit);
+        state.useProgram(self.downsample_program);
+        c.glUniform1i(c.glGetUniformLocation(self.downsample_program, "source"), scene_unit);
+        state.useProgram(self.upsample_program);
+        c.glUniform1i(c.glGetUniformLocation(self.upsample_program, "source"), bloom_unit);
+        state.useProgram(self.composite_program);
+        c.glUniform1i(c.glGetUniformLocation(self.composite_program, "scene"), scene_unit);
+        c.glUniform1i(c.glGetUniformLocation(self.composite_program, "bloom"), bloom_unit);
+
+        c.glGenVertexArrays(1, &self.vao);
+
+        var buffers: [2]c.GLuint = undefined;
+        c.glGenBuffers(buffers.len, &buffers);
+        self.histogram_buffer = buffers[0];
+        self.exposure_buffer = buffers[1];
+
+        const zeros = [_]u32{0} ** histogram_bins;
+        c.glBindBuffer(gl_ext.GL_SHADER_STORAGE_BUFFER, self.histogram_buffer);
+        c.glBufferData(gl_ext.GL_SHADER_STORAGE_BUFFER, @sizeOf(@TypeOf(zeros)), &zeros, c.GL_DYNAMIC_COPY);
+        // Start out exposed for middle grey
+        const exposure = [2]f32{ config.key_value, 1.0 };
+        c.glBindBuffer(gl_ext.GL_SHADER_STORAGE_BUFFER, self.exposure_buffer);
+        c.glBufferData(gl_ext.GL_SHADER_STORAGE_BUFFER, @sizeOf(@TypeOf(exposure)), &exposure, c.GL_DYNAMIC_COPY);
+        c.glBindBuffer(gl_ext.GL_SHADER_STORAGE_BUFFER, 0);
+
+        err.checkGLError("PostProcess setup");
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Compute shaders, storage buffers and image load/store
+    pub fn isSupported() bool {
+        return gl_ext.dispatchCompute != null and gl_ext.memoryBarrier != null and gl_ext.bindImageTexture != null;
+    }
+
+
+    /// Size the bloom pyramid for a scene target of `width` x `height`, nothing happens when it is unchanged
+    pub fn resize(self: *Self, width: u32, height: u32) void {
+        const w = @max(width / 2, 1);
+        const h = @max(height / 2, 1);
+        if (self.bloom_texture != 0 and w == self.bloom_size[0] and h == self.bloom_size[1]) return;
+
+        const state = GLStateCache.current();
+        if (self.bloom_texture != 0) {
+            state.forgetTexture(self.bloom_texture);
+            c.glDeleteTextures(1, &self.bloom_texture);
+        }
+
+        const full_chain = @as(u32, std.math.log2_int(u32, @max(w, h))) + 1;
+        self.bloom_levels = @max(@min(self.config.bloom_levels, full_chain), 1);
+        self.bloom_size = .{ w, h };
+
+        c.glGenTextures(1, &self.bloom_texture);
+        state.bindTexture2D(0, self.bloom_texture);
+        for (0..self.bloom_levels) |level| {
+            const level_w, const level_h = self.bloomLevelSize(@intCast(level));
+            c.glTexImage2D(c.GL_TEXTURE_2D, @intCast(level), c.GL_RGBA16F, @intCast(level_w), @intCast(level_h), 0, c.GL_RGBA, c.GL_FLOAT, null);
+        }
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAX_LEVEL, @intCast(self.bloom_levels - 1));
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_LINEAR_MIPMAP_NEAREST);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_LINEAR);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
+        err.checkGLError("PostProcess.resize");
+    }
+
+
+    /// Run every stage on the lower left `region` of `scene`, a linear filtered RGBA16F texture of
+    /// `scene_size` sized for with resize, and tonemap it over the bound framebuffer's viewport
+    pub fn apply(self: *Self, renderer: *Renderer, scene: c.GLuint, scene_size: [2]u32, region: [2]u32) void {
+        std.debug.assert(self.bloom_texture != 0);
+        const state = GLStateCache.current();
+        const uv_scale = [2]f32{
+            @as(f32, @floatFromInt(region[0])) / @as(f32, @floatFromInt(scene_size[0])),
+            @as(f32, @floatFromInt(region[1])) / @as(f32, @floatFromInt(scene_size[1])),
+        };
+
+        // Material samplers left on the units would override the pyramid's level filtering
+        state.bindTexture2D(scene_unit, scene);
+        state.bindSampler(scene_unit, 0);
+        state.bindTexture2D(bloom_unit, self.bloom_texture);
+        state.bindSampler(bloom_unit, 0);
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, histogram_binding, self.histogram_buffer);
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, exposure_binding, self.exposure_buffer);
+
+        if (self.config.auto_exposure) self.updateExposure(renderer, region);
+        if (self.config.bloom_intensity > 0.0) self.updateBloom(renderer, scene_size, uv_scale);
+
+        renderer.beginGpuScope("Tonemap");
+        defer renderer.endGpuScope();
+
+        // The fullscreen triangle must not be culled, depth tested, blended or drawn as lines
+        const depth_test = state.depth_test;
+        const cull_face = state.cull_face;
+        const polygon_mode = state.polygon_mode;
+        state.setDepthTest(false);
+        state.setCullFace(false);
+        state.setPolygonMode(c.GL_FILL);
+        state.setBlend(.off);
+        defer {
+            if (depth_test) |enabled| state.setDepthTest(enabled);
+            if (cull_face) |enabled| state.setCullFace(enabled);
+            if (polygon_mode) |mode| state.setPolygonMode(mode);
+        }
+
+        const program = self.composite_program;
+        state.useProgram(program);
+        c.glUniform2f(c.glGetUniformLocation(program, "uvScale"), uv_scale[0], uv_scale[1]);
+        c.glUniform1f(c.glGetUniformLocation(program, "bloomIntensity"), self.config.bloom_intensity);
+        c.glUniform1f(c.glGetUniformLocation(program, "fixedExposure"), if (self.config.auto_exposure) 0.0 else self.config.exposure);
+        c.glUniform1i(c.glGetUniformLocation(program, "encodeSrgb"), @intFromBool(self.config.encode_srgb));
+        state.bindVertexArray(self.vao);
+        c.glDrawArrays(c.GL_TRIANGLES, 0, 3);
+        err.checkGLError("PostProcess.apply");
+    }
+
+
+    /// Width and height of bloom pyramid `level`
+    pub fn bloomLevelSize(self: *const Self, level: u32) struct { u32, u32 } {
+        return .{ @max(self.bloom_size[0] >> @intCast(level), 1), @max(self.bloom_size[1] >> @intCast(level), 1) };
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        const state = GLStateCache.current();
+        const programs = [_]c.GLuint{ self.histogram_program, self.exposure_program, self.downsample_program, self.upsample_program, self.composite_program };
+        for (programs) |program| {
+            state.forgetProgram(program);
+            c.glDeleteProgram(program);
+        }
+        state.forgetVertexArray(self.vao);
+        c.glDeleteVertexArrays(1, &self.vao);
+        const buffers = [_]c.GLuint{ self.histogram_buffer, self.exposure_buffer };
+        c.glDeleteBuffers(buffers.len, &buffers);
+        state.forgetTexture(self.bloom_texture);
+        c.glDeleteTextures(1, &self.bloom_texture);
+        err.checkGLError("PostProcess cleanup");
+
+        const config = self.config;
+        self.* = .{ .config = config };
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Histogram of the region, then its reduction to the adapted exposure, both stay on the GPU
+    fn updateExposure(self: *Self, renderer: *Renderer, region: [2]u32) void {
+        renderer.beginGpuScope("Exposure");
+        defer renderer.endGpuScope();
+        const state = GLStateCache.current();
+        const range = [2]f32{ self.config.min_log_luminance, self.config.max_log_luminance - self.config.min_log_luminance };
+
+        state.useProgram(self.histogram_program);
+        c.glUniform2i(c.glGetUniformLocation(self.histogram_program, "region"), @intCast(region[0]), @intCast(region[1]));
+        c.glUniform2f(c.glGetUniformLocation(self.histogram_program, "luminanceRange"), range[0], range[1]);
+        gl_ext.dispatchCompute.?(groupCount(region[0], histogram_group), groupCount(region[1], histogram_group), 1);
+        gl_ext.memoryBarrier.?(gl_ext.GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // The first frame takes the scene's luminance as it is
+        const now = monotonicNs();
+        const seconds = if (self.last_apply_ns == 0) std.math.inf(f32) else @as(f32, @floatFromInt(now -| self.last_apply_ns)) / std.time.ns_per_s;
+        self.last_apply_ns = now;
+        const adaptation = 1.0 - @exp(-seconds * self.config.adaptation_rate);
+
+        const program = self.exposure_program;
+        state.useProgram(program);
+        c.glUniform2f(c.glGetUniformLocation(program, "luminanceRange"), range[0], range[1]);
+        c.glUniform1f(c.glGetUniformLocation(program, "pixelCount"), @floatFromInt(@as(u64, region[0]) * region[1]));
+        c.glUniform1f(c.glGetUniformLocation(program, "adaptation"), adaptation);
+        c.glUniform1f(c.glGetUniformLocation(program, "keyValue"), self.config.key_value);
+        c.glUniform2f(c.glGetUniformLocation(program, "exposureLimits"), self.config.min_exposure, self.config.max_exposure);
+        gl_ext.dispatchCompute.?(1, 1, 1);
+        gl_ext.memoryBarrier.?(gl_ext.GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+
+    /// Downsample the scene through the pyramid, then add every level into the one above it
+    fn updateBloom(self: *Self, renderer: *Renderer, scene_size: [2]u32, uv_scale: [2]f32) void {
+        renderer.beginGpuScope("Bloom");
+        defer renderer.endGpuScope();
+        const state = GLStateCache.current();
+        const bindImageTexture = gl_ext.bindImageTexture.?;
+        // Images written by one dispatch are sampled or loaded by the next
+        const barriers = gl_ext.GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | gl_ext.GL_TEXTURE_FETCH_BARRIER_BIT;
+
+        var program = self.downsample_program;
+        state.useProgram(program);
+        const lod_location = c.glGetUniformLocation(program, "sourceLod");
+        const texel_location = c.glGetUniformLocation(program, "sourceTexel");
+        const uv_location = c.glGetUniformLocation(program, "uvScale");
+        const prefilter_location = c.glGetUniformLocation(program, "prefilter");
+        const source_location = c.glGetUniformLocation(program, "source");
+        c.glUniform2f(c.glGetUniformLocation(program, "threshold"), self.config.bloom_threshold, @max(self.config.bloom_knee, 1e-4));
+
+        for (0..self.bloom_levels) |level| {
+            const w, const h = self.bloomLevelSize(@intCast(level));
+            if (level == 0) {
+                // Thresholded while reading the scene, so bright pixels alone enter the pyramid
+                c.glUniform1i(source_location, scene_unit);
+                c.glUniform1f(lod_location, 0.0);
+                c.glUniform2f(texel_location, 1.0 / @as(f32, @floatFromInt(scene_size[0])), 1.0 / @as(f32, @floatFromInt(scene_size[1])));
+                c.glUniform2f(uv_location, uv_scale[0], uv_scale[1]);
+                c.glUniform1i(prefilter_location, 1);
+            } else {
+                const source_w, const source_h = self.bloomLevelSize(@intCast(level - 1));
+                c.glUniform1i(source_location, bloom_unit);
+                c.glUniform1f(lod_location, @floatFromInt(level - 1));
+                c.glUniform2f(texel_location, 1.0 / @as(f32, @floatFromInt(source_w)), 1.0 / @as(f32, @floatFromInt(source_h)));
+                // Level 0 stretched the scene region over the whole pyramid
+                if (level == 1) c.glUniform2f(uv_location, 1.0, 1.0);
+                c.glUniform1i(prefilter_location, 0);
+            }
+            bindImageTexture(0, self.bloom_texture, @intCast(level), c.GL_FALSE, 0, c.GL_WRITE_ONLY, c.GL_RGBA16F);
+            gl_ext.dispatchCompute.?(groupCount(w, bloom_group), groupCount(h, bloom_group), 1);
+            gl_ext.memoryBarrier.?(barriers);
+        }
+
+        program = self.upsample_program;
+        state.useProgram(program);
+        const up_lod_location = c.glGetUniformLocation(program, "sourceLod");
+        const up_texel_location = c.glGetUniformLocation(program, "sourceTexel");
+        var level = self.bloom_levels;
+        while (level > 1) {
+            level -= 1;
+            const w, const h = self.bloomLevelSize(level - 1);
+            const source_w, const source_h = self.bloomLevelSize(level);
+            c.glUniform1f(up_lod_location, @floatFromInt(level));
+            c.glUniform2f(up_texel_location, 1.0 / @as(f32, @floatFromInt(source_w)), 1.0 / @as(f32, @floatFromInt(source_h)));
+            bindImageTexture(0, self.bloom_texture, @intCast(level - 1), c.GL_FALSE, 0, c.GL_READ_WRITE, c.GL_RGBA16F);
+            gl_ext.dispatchCompute.?(groupCount(w, bloom_group), groupCount(h, bloom_group), 1);
+            gl_ext.memoryBarrier.?(barriers);
+        }
+    }
+
+
+    fn groupCount(size: u32, group: u32) u32 {
+        return (size + group - 1) / group;
+    }
+};
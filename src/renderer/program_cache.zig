@@ -0,0 +1,143 @@
+// graphics/program_cache.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+
+
+/// On-disk cache of linked program binaries, one file per source pair
+/// Keys mix in the GL vendor, renderer and version, so a driver change never loads a stale binary
+pub const ProgramCache = struct {
+    const Self = @This();
+
+    /// Binary format, then the binary itself
+    const Header = extern struct {
+        format: u32,
+        length: u32,
+    };
+
+    allocator: std.mem.Allocator,
+    dir: std.fs.Dir,
+    /// Hash of the driver strings, the seed of every key
+    driver_hash: u64,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Open or create the cache directory, requires a current GL context
+    pub fn init(allocator: std.mem.Allocator, path: []const u8) !Self {
+        var dir = try std.fs.cwd().makeOpenPath(path, .{});
+        errdefer dir.close();
+
+        var hasher = std.hash.Wyhash.init(0);
+        for ([_]c.GLenum{ c.GL_VENDOR, c.GL_RENDERER, c.GL_VERSION }) |name| {
+            const value = c.glGetString(name) orelse continue;
+            hasher.update(std.mem.span(value));
+            hasher.update(&.{0});
+        }
+
+        return .{
+            .allocator = allocator,
+            .dir = dir,
+            .driver_hash = hasher.final(),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// False when the driver has no ARB_get_program_binary, every load then misses and store does nothing
+    pub fn isSupported(self: *const Self) bool {
+        _ = self;
+        return gl_ext.hasProgramBinary();
+    }
+
+
+    pub fn key(self: *const Self, vertex_source: []const u8, fragment_source: []const u8) u64 {
+        var hasher = std.hash.Wyhash.init(self.driver_hash);
+        hasher.update(vertex_source);
+        hasher.update(&.{0});
+        hasher.update(fragment_source);
+        return hasher.final();
+    }
+
+
+    /// Create a program from the cached binary, null if there is none or the driver rejects it
+    pub fn load(self: *Self, program_key: u64) ?c.GLuint {
+        if (!self.isSupported()) return null;
+
+        var name_buffer: [32]u8 = undefined;
+        const file = self.dir.openFile(fileName(&name_buffer, program_key), .{}) catch return null;
+        defer file.close();
+
+        const header = file.reader().readStruct(Header) catch return null;
+        const binary = self.allocator.alloc(u8, header.length) catch return null;
+        defer self.allocator.free(binary);
+        if ((file.readAll(binary) catch return null) != binary.len) return null;
+
+        const program = c.glCreateProgram();
+        if (program == 0) return null;
+
+        gl_ext.programBinary.?(program, header.format, binary.ptr, @intCast(binary.len));
+
+        var link_status: c.GLint = c.GL_FALSE;
+        c.glGetProgramiv(program, c.GL_LINK_STATUS, &link_status);
+
+        // Drain the error a rejected binary may raise, the caller recompiles from source
+        _ = c.glGetError();
+
+        if (link_status == c.GL_FALSE) {
+            c.glDeleteProgram(program);
+            return null;
+        }
+        return program;
+    }
+
+
+    /// Write the binary of a program linked with the retrievable hint
+    pub fn store(self: *Self, program_key: u64, program: c.GLuint) !void {
+        if (!self.isSupported()) return;
+
+        var length: c.GLint = 0;
+        c.glGetProgramiv(program, gl_ext.GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return error.ProgramBinaryUnavailable;
+
+        const binary = try self.allocator.alloc(u8, @intCast(length));
+        defer self.allocator.free(binary);
+
+        var written: c.GLsizei = 0;
+        var format: c.GLenum = 0;
+        gl_ext.getProgramBinary.?(program, length, &written, &format, binary.ptr);
+        err.checkGLError("glGetProgramBinary");
+
+        var name_buffer: [32]u8 = undefined;
+        const file = try self.dir.createFile(fileName(&name_buffer, program_key), .{});
+        defer file.close();
+
+        const header = Header{ .format = format, .length = @intCast(written) };
+        try file.writeAll(std.mem.asBytes(&header));
+        try file.writeAll(binary[0..@intCast(written)]);
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.dir.close();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn fileName(buffer: *[32]u8, program_key: u64) []const u8 {
+        return std.fmt.bufPrint(buffer, "{x:0>16}.bin", .{program_key}) catch unreachable;
+    }
+};
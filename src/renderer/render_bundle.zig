@@ -0,0 +1,182 @@
+// graphics/render_bundle.zig - retained, pre-sorted draw lists for geometry that doesn't change
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+
+const render_queue = @import("render_queue.zig");
+const RenderQueue = render_queue.RenderQueue;
+const RenderPass = render_queue.RenderPass;
+const DrawElementsIndirectCommand = @import("gpu_culling.zig").DrawElementsIndirectCommand;
+const Mesh = @import("mesh.zig").Mesh;
+const Material = @import("material.zig").Material;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+
+const Affine3x4 = @import("../math/affine.zig").Affine3x4;
+const BoundingBox = @import("../math/bounds.zig").BoundingBox;
+
+
+pub const RenderBundleError = error{
+    /// Blending order depends on the view, transparent items are drawn from a RenderQueue every frame
+    TransparentItem,
+    /// Every material needs a shader with the instanced path, the instances are attributes of the bundle's buffer
+    ShaderNotInstanced,
+};
+
+
+/// A sorted list of draws recorded once, with its instances and indirect commands kept in video memory
+/// Renderer.drawBundle then submits it with one multi-draw per run of items sharing material and VAO,
+/// uploading nothing, until the content changes and it is recorded again. Meant for static scenery that
+/// would otherwise go through the same queue, sort and upload every frame
+pub const RenderBundle = struct {
+    const Self = @This();
+
+    pub const Batch = struct {
+        /// First mesh of the run, every mesh of it shares this VAO
+        mesh: *Mesh,
+        material: *Material,
+        first_command: u32,
+        command_count: u32,
+    };
+
+    /// One command per recorded item, matching `meshes`
+    pub const Command = DrawElementsIndirectCommand;
+
+    allocator: std.mem.Allocator,
+    /// Affine3x4 world matrices of every item, TRS instances expanded
+    instance_buffer: c.GLuint,
+    /// `commands` as GL_DRAW_INDIRECT_BUFFER
+    command_buffer: c.GLuint,
+    commands: std.ArrayList(Command),
+    /// Mesh of every command, drawn one by one where multi-draw indirect is missing
+    meshes: std.ArrayList(*Mesh),
+    batches: std.ArrayList(Batch),
+    instance_count: u32 = 0,
+    /// World bounds of everything recorded, for skipping the whole bundle outside the view
+    bounds: ?BoundingBox = null,
+    /// False until recorded and after invalidate
+    valid: bool = false,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn create(allocator: std.mem.Allocator) !*Self {
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+
+        var buffers: [2]c.GLuint = undefined;
+        c.glGenBuffers(buffers.len, &buffers);
+        err.checkGLError("glGenBuffers for RenderBundle");
+
+        self.* = .{
+            .allocator = allocator,
+            .instance_buffer = buffers[0],
+            .command_buffer = buffers[1],
+            .commands = std.ArrayList(Command).init(allocator),
+            .meshes = std.ArrayList(*Mesh).init(allocator),
+            .batches = std.ArrayList(Batch).init(allocator),
+        };
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Replace the bundle's content with the opaque items of `queue`, sorted by state, and upload it
+    /// The queue can be cleared or reused afterwards, the meshes and materials must outlive the recording
+    pub fn record(self: *Self, queue: *RenderQueue) !void {
+        try queue.sort();
+        self.commands.clearRetainingCapacity();
+        self.meshes.clearRetainingCapacity();
+        self.batches.clearRetainingCapacity();
+        self.bounds = null;
+        self.valid = false;
+
+        var instances = std.ArrayList(Affine3x4).init(self.allocator);
+        defer instances.deinit();
+
+        for (queue.items.items) |item| {
+            if (item.key >> 60 == @intFromEnum(RenderPass.transparent)) return RenderBundleError.TransparentItem;
+            if (!item.material.shader.has(.instanced)) return RenderBundleError.ShaderNotInstanced;
+
+            const command: u32 = @intCast(self.commands.items.len);
+            const base_instance: u32 = @intCast(instances.items.len);
+            try self.commands.append(.{
+                .count = @intCast(item.mesh.index_count),
+                .instance_count = item.instance_count,
+                .first_index = item.mesh.first_index,
+                .base_vertex = @intCast(item.mesh.base_vertex),
+                .base_instance = base_instance,
+            });
+            try self.meshes.append(item.mesh);
+
+            try instances.ensureUnusedCapacity(item.instance_count);
+            for (0..item.instance_count) |index| {
+                const matrix = queue.instanceMatrix(item, index);
+                instances.appendAssumeCapacity(matrix);
+                const world = item.mesh.bounds.transformedAffine(&matrix);
+                self.bounds = if (self.bounds) |bounds| bounds.merge(world) else world;
+            }
+
+            if (self.batches.items.len > 0) {
+                const last = &self.batches.items[self.batches.items.len - 1];
+                // Meshes of one GeometryPool section share their VAO and draw in the same multi-draw
+                if (last.mesh.vao == item.mesh.vao and last.material == item.material) {
+                    last.command_count += 1;
+                    continue;
+                }
+            }
+            try self.batches.append(.{
+                .mesh = item.mesh,
+                .material = item.material,
+                .first_command = command,
+                .command_count = 1,
+            });
+        }
+
+        self.instance_count = @intCast(instances.items.len);
+        GLStateCache.current().bindArrayBuffer(self.instance_buffer);
+        c.glBufferData(c.GL_ARRAY_BUFFER, @intCast(instances.items.len * @sizeOf(Affine3x4)), instances.items.ptr, c.GL_STATIC_DRAW);
+        if (gl_ext.multiDrawElementsIndirect != null) {
+            c.glBindBuffer(gl_ext.GL_DRAW_INDIRECT_BUFFER, self.command_buffer);
+            c.glBufferData(gl_ext.GL_DRAW_INDIRECT_BUFFER, @intCast(self.commands.items.len * @sizeOf(Command)), self.commands.items.ptr, c.GL_STATIC_DRAW);
+            c.glBindBuffer(gl_ext.GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+        err.checkGLError("RenderBundle: glBufferData");
+        self.valid = true;
+    }
+
+
+    /// Mark the content stale, e.g. after a static entity moved, the bundle draws nothing until recorded again
+    pub fn invalidate(self: *Self) void {
+        self.valid = false;
+    }
+
+
+    /// True when drawBundle has nothing to draw
+    pub fn isEmpty(self: *const Self) bool {
+        return !self.valid or self.batches.items.len == 0;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn release(self: *Self) void {
+        const state = GLStateCache.current();
+        state.forgetBuffer(self.instance_buffer);
+        const buffers = [_]c.GLuint{ self.instance_buffer, self.command_buffer };
+        c.glDeleteBuffers(buffers.len, &buffers);
+        err.checkGLError("RenderBundle cleanup");
+
+        self.commands.deinit();
+        self.meshes.deinit();
+        self.batches.deinit();
+        self.allocator.destroy(self);
+    }
+};
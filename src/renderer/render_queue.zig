@@ -0,0 +1,466 @@
+// graphics/render_queue.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+const Model = @import("model.zig").Model;
+const mesh_module = @import("mesh.zig");
+const Mesh = mesh_module.Mesh;
+const InstanceFormat = mesh_module.InstanceFormat;
+const TrsInstance = mesh_module.TrsInstance;
+const Material = @import("material.zig").Material;
+
+const Affine3x4 = @import("../math/affine.zig").Affine3x4;
+const BoundingBox = @import("../math/bounds.zig").BoundingBox;
+const Vec3f = @import("../math/vector.zig").Vec3f;
+
+
+/// Draw passes in submission order
+pub const RenderPass = enum(u4) {
+    /// Sorted front to back
+    opaque_pass = 0,
+    /// Sorted back to front, drawn after everything opaque
+    transparent = 1,
+};
+
+
+/// One instanced draw of a mesh-material pair
+pub const DrawItem = struct {
+    /// Packed as pass:4 | shader:16 | material:16 | mesh:16 | depth:12, most significant first
+    /// Transparent items move depth right after the pass so blending stays back to front,
+    /// sortForView replaces it with the distance of their instance to the eye
+    key: u64,
+    mesh: *Mesh,
+    material: *Material,
+    /// Range of world matrices in RenderQueue.matrices, or of RenderQueue.trs_instances for TRS items
+    first_instance: u32,
+    instance_count: u32,
+    instance_format: InstanceFormat = .affine,
+    /// Occlusion query of the previous frame, the GPU skips the draw when it found no samples. 0 draws always
+    occlusion_query: c.GLuint = 0,
+};
+
+
+/// Bounding box an occlusion query is issued against once the opaque items are drawn
+pub const OcclusionTest = struct {
+    query: c.GLuint,
+    /// World matrix in RenderQueue.matrices scaling a unit cube to the box
+    box_instance: u32,
+};
+
+
+/// Collects draws for a frame and orders them so consecutive draws share as much GL state as possible
+/// Renderer.drawQueue submits the sorted items and skips program, material and mesh binds that change nothing
+pub const RenderQueue = struct {
+    const Self = @This();
+
+    const depth_bits = 12;
+    const max_depth = (1 << depth_bits) - 1;
+
+    allocator: std.mem.Allocator,
+    items: std.ArrayList(DrawItem),
+    /// World matrices of every item, uploaded to the instance buffer in one go at 48 bytes each
+    matrices: std.ArrayList(Affine3x4),
+    /// Instances of the items pushed with pushModelTrs, uploaded to their own buffer
+    trs_instances: std.ArrayList(TrsInstance),
+    /// Radix sort scratch space
+    scratch: std.ArrayList(DrawItem),
+    /// Transparent items split into one per instance by sortForView, reused between frames
+    split: std.ArrayList(DrawItem),
+    /// Queries of the items pushed with pushModelOccluded, issued by Renderer.drawQueue
+    occlusion_tests: std.ArrayList(OcclusionTest),
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator) Self {
+        return .{
+            .allocator = allocator,
+            .items = std.ArrayList(DrawItem).init(allocator),
+            .matrices = std.ArrayList(Affine3x4).init(allocator),
+            .trs_instances = std.ArrayList(TrsInstance).init(allocator),
+            .scratch = std.ArrayList(DrawItem).init(allocator),
+            .split = std.ArrayList(DrawItem).init(allocator),
+            .occlusion_tests = std.ArrayList(OcclusionTest).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Queue every mesh-material pair of `model` once per world matrix
+    /// `depth` is the normalized view distance of the group, 0 at the camera and 1 at the far plane
+    pub fn pushModel(self: *Self, model: *Model, world_matrices: []const Affine3x4, depth: f32) !void {
+        return self.pushModelLod(model, 0, world_matrices, depth);
+    }
+
+
+    /// Like pushModel, with the pairs of level of detail `lod`
+    pub fn pushModelLod(self: *Self, model: *Model, lod: usize, world_matrices: []const Affine3x4, depth: f32) !void {
+        if (world_matrices.len == 0) return;
+
+        const pairs = model.getLodPairs(lod);
+        const first: u32 = @intCast(self.matrices.items.len);
+        try self.matrices.appendSlice(world_matrices);
+
+        try self.items.ensureUnusedCapacity(pairs.len);
+        for (pairs) |pair| {
+            self.items.appendAssumeCapacity(.{
+                .key = makeKey(passOf(pair.material), pair.mesh, pair.material, depth),
+                .mesh = pair.mesh,
+                .material = pair.material,
+                .first_instance = first,
+                .instance_count = @intCast(world_matrices.len),
+            });
+        }
+    }
+
+
+    /// Like pushModelLod with compact instances the vertex shader turns into matrices, 32 bytes each instead of 48
+    /// Shaders drawing them need instance_glsl, ones without an instanced path get the matrices built on the CPU
+    pub fn pushModelTrs(self: *Self, model: *Model, lod: usize, instances: []const TrsInstance, depth: f32) !void {
+        if (instances.len == 0) return;
+
+        const pairs = model.getLodPairs(lod);
+        const first: u32 = @intCast(self.trs_instances.items.len);
+        try self.trs_instances.appendSlice(instances);
+
+        try self.items.ensureUnusedCapacity(pairs.len);
+        for (pairs) |pair| {
+            self.items.appendAssumeCapacity(.{
+                .key = makeKey(passOf(pair.material), pair.mesh, pair.material, depth),
+                .mesh = pair.mesh,
+                .material = pair.material,
+                .first_instance = first,
+                .instance_count = @intCast(instances.len),
+                .instance_format = .trs,
+            });
+        }
+    }
+
+
+    /// Like pushModelLod for a single instance whose draws are conditional on `query`, which is then
+    /// issued again against `bounds` for the next frame. `conditional` is false while the query holds
+    /// no result yet, or when the eye is inside the box and its faces would be clipped
+    pub fn pushModelOccluded(self: *Self, model: *Model, lod: usize, world_matrix: Affine3x4, bounds: BoundingBox, query: c.GLuint, conditional: bool, depth: f32) !void {
+        try self.occlusion_tests.ensureUnusedCapacity(1);
+        const first_item = self.items.items.len;
+        try self.pushModelLod(model, lod, &.{world_matrix}, depth);
+        if (conditional) {
+            for (self.items.items[first_item..]) |*item| item.occlusion_query = query;
+        }
+
+        // The box mesh spans [-0.5, 0.5]
+        const box_center = bounds.center();
+        const half = bounds.halfExtents();
+        const box = Affine3x4{ .data = .{
+            half.x * 2.0, 0.0,          0.0,          box_center.x,
+            0.0,          half.y * 2.0, 0.0,          box_center.y,
+            0.0,          0.0,          half.z * 2.0, box_center.z,
+        } };
+        try self.matrices.append(box);
+        self.occlusion_tests.appendAssumeCapacity(.{
+            .query = query,
+            .box_instance = @intCast(self.matrices.items.len - 1),
+        });
+    }
+
+
+    /// World matrix of instance `index` of `item`, whichever format it was queued in
+    pub fn instanceMatrix(self: *const Self, item: DrawItem, index: usize) Affine3x4 {
+        const slot = item.first_instance + index;
+        return switch (item.instance_format) {
+            .affine => self.matrices.items[slot],
+            .trs => self.trs_instances.items[slot].toAffine(),
+        };
+    }
+
+
+    /// Queue a single mesh-material pair once per world matrix, for geometry that has no Model
+    pub fn pushMesh(self: *Self, mesh: *Mesh, material: *Material, world_matrices: []const Affine3x4, depth: f32) !void {
+        if (world_matrices.len == 0) return;
+
+        const first: u32 = @intCast(self.matrices.items.len);
+        try self.matrices.appendSlice(world_matrices);
+        try self.items.append(.{
+            .key = makeKey(passOf(material), mesh, material, depth),
+            .mesh = mesh,
+            .material = material,
+            .first_instance = first,
+            .instance_count = @intCast(world_matrices.len),
+        });
+    }
+
+
+    /// Append the items, instances and occlusion tests of `other`, their instance ranges moved past ours
+    pub fn appendQueue(self: *Self, other: *const Self) !void {
+        const matrix_base: u32 = @intCast(self.matrices.items.len);
+        const trs_base: u32 = @intCast(self.trs_instances.items.len);
+        try self.items.ensureUnusedCapacity(other.items.items.len);
+        try self.occlusion_tests.ensureUnusedCapacity(other.occlusion_tests.items.len);
+        try self.matrices.appendSlice(other.matrices.items);
+        try self.trs_instances.appendSlice(other.trs_instances.items);
+
+        for (other.items.items) |item| {
+            var moved = item;
+            moved.first_instance += switch (item.instance_format) {
+                .affine => matrix_base,
+                .trs => trs_base,
+            };
+            self.items.appendAssumeCapacity(moved);
+        }
+        for (other.occlusion_tests.items) |occlusion_test| {
+            self.occlusion_tests.appendAssumeCapacity(.{
+                .query = occlusion_test.query,
+                .box_instance = occlusion_test.box_instance + matrix_base,
+            });
+        }
+    }
+
+
+    /// Order the items by key with an LSD radix sort, 8 bits per pass
+    /// Passes where every key has the same byte are skipped
+    pub fn sort(self: *Self) !void {
+        try self.radixSort(self.items.items);
+    }
+
+
+    /// Like sort, then transparent items are split into one per instance and ordered back to front by the
+    /// distance of each instance to `eye`, so instances of different items blend in the right order
+    /// Neighbours left with the same mesh, material and instance format are joined again, their instances
+    /// copied to the end of the instance lists. Call once per view, every call appends another copy
+    pub fn sortForView(self: *Self, eye: Vec3f) !void {
+        try self.sort();
+
+        const first_transparent = self.firstTransparent();
+        if (first_transparent == self.items.items.len) return;
+
+        self.split.clearRetainingCapacity();
+        for (self.items.items[first_transparent..]) |item| {
+            try self.split.ensureUnusedCapacity(item.instance_count);
+            for (0..item.instance_count) |index| {
+                const slot = item.first_instance + @as(u32, @intCast(index));
+                const position = switch (item.instance_format) {
+                    .affine => self.matrices.items[slot].translation(),
+                    .trs => self.trs_instances.items[slot].position,
+                };
+
+                var single = item;
+                single.key = makeViewKey(item.material, position.subtract(eye).lengthSquared());
+                single.first_instance = slot;
+                single.instance_count = 1;
+                self.split.appendAssumeCapacity(single);
+            }
+        }
+        try self.radixSort(self.split.items);
+
+        self.items.shrinkRetainingCapacity(first_transparent);
+        const split = self.split.items;
+        var start: usize = 0;
+        while (start < split.len) {
+            const head = split[start];
+            var end = start + 1;
+            while (end < split.len and split[end].mesh == head.mesh and split[end].material == head.material and
+                split[end].instance_format == head.instance_format) end += 1;
+
+            var joined = head;
+            joined.instance_count = @intCast(end - start);
+            if (end - start > 1) switch (head.instance_format) {
+                .affine => {
+                    joined.first_instance = @intCast(self.matrices.items.len);
+                    try self.matrices.ensureUnusedCapacity(end - start);
+                    for (split[start..end]) |single| self.matrices.appendAssumeCapacity(self.matrices.items[single.first_instance]);
+                },
+                .trs => {
+                    joined.first_instance = @intCast(self.trs_instances.items.len);
+                    try self.trs_instances.ensureUnusedCapacity(end - start);
+                    for (split[start..end]) |single| self.trs_instances.appendAssumeCapacity(self.trs_instances.items[single.first_instance]);
+                },
+            };
+            try self.items.append(joined);
+            start = end;
+        }
+    }
+
+
+    /// Index of the first transparent item of the sorted items, the item count when there is none
+    pub fn firstTransparent(self: *const Self) usize {
+        for (self.items.items, 0..) |item, i| {
+            if (item.key >> 60 == @intFromEnum(RenderPass.transparent)) return i;
+        }
+        return self.items.items.len;
+    }
+
+
+    /// Drop every item and matrix, keeping the memory for the next frame
+    pub fn clear(self: *Self) void {
+        self.items.clearRetainingCapacity();
+        self.matrices.clearRetainingCapacity();
+        self.trs_instances.clearRetainingCapacity();
+        self.occlusion_tests.clearRetainingCapacity();
+    }
+
+
+    pub fn isEmpty(self: *const Self) bool {
+        return self.items.items.len == 0;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.items.deinit();
+        self.matrices.deinit();
+        self.trs_instances.deinit();
+        self.scratch.deinit();
+        self.split.deinit();
+        self.occlusion_tests.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn passOf(material: *const Material) RenderPass {
+        return if (material.color[3] < 1.0) .transparent else .opaque_pass;
+    }
+
+
+    /// Shader, material and mesh fields are folded pointers, a collision only costs a redundant bind
+    fn makeKey(pass: RenderPass, mesh: *const Mesh, material: *const Material, depth: f32) u64 {
+        const quantized: u64 = @intFromFloat(std.math.clamp(depth, 0.0, 1.0) * max_depth);
+        const state = (@as(u64, foldPointer(material.shader)) << 32) |
+            (@as(u64, foldPointer(material)) << 16) |
+            foldPointer(mesh);
+
+        const pass_bits = @as(u64, @intFromEnum(pass)) << 60;
+        return switch (pass) {
+            .opaque_pass => pass_bits | (state << depth_bits) | quantized,
+            .transparent => pass_bits | ((max_depth - quantized) << 48) | state,
+        };
+    }
+
+
+    /// Sort `items` by key, using the scratch list as the second buffer
+    fn radixSort(self: *Self, items: []DrawItem) !void {
+        const count = items.len;
+        if (count < 2) return;
+
+        try self.scratch.resize(count);
+        var src = items;
+        var dst = self.scratch.items;
+
+        var shift: u6 = 0;
+        while (true) : (shift += 8) {
+            var counts = [_]usize{0} ** 256;
+            for (src) |item| counts[byteAt(item.key, shift)] += 1;
+
+            if (counts[byteAt(src[0].key, shift)] != count) {
+                // Prefix sums give the first output slot of each byte value
+                var total: usize = 0;
+                for (&counts) |*slot| {
+                    const bucket = slot.*;
+                    slot.* = total;
+                    total += bucket;
+                }
+
+                for (src) |item| {
+                    const bucket = byteAt(item.key, shift);
+                    dst[counts[bucket]] = item;
+                    counts[bucket] += 1;
+                }
+                std.mem.swap([]DrawItem, &src, &dst);
+            }
+
+            if (shift == 56) break;
+        }
+
+        if (src.ptr != items.ptr) @memcpy(items, src);
+    }
+
+
+    /// Distance keys of single transparent instances, ties broken by material so they join up again
+    /// Squared distances are positive floats, whose bits order like the values, inverted for back to front
+    fn makeViewKey(material: *const Material, distance_squared: f32) u64 {
+        const pass_bits = @as(u64, @intFromEnum(RenderPass.transparent)) << 60;
+        const far_first: u32 = ~@as(u32, @bitCast(@max(distance_squared, 0.0)));
+        return pass_bits | (@as(u64, far_first) << 16) | foldPointer(material);
+    }
+
+
+    fn foldPointer(ptr: *const anyopaque) u16 {
+        const address: u64 = @intFromPtr(ptr) >> 4;
+        return @truncate(address ^ (address >> 16) ^ (address >> 32));
+    }
+
+
+    fn byteAt(key: u64, shift: u6) u8 {
+        return @truncate(key >> shift);
+    }
+};
+
+
+/// One RenderQueue per job system worker, so culling and LOD jobs record draws in parallel without locking
+/// Each job pushes into local(), then mergeInto joins them into the queue the GL thread sorts and submits.
+/// Merging goes in slot order, the sort makes the result independent of which worker recorded what
+pub const ParallelRenderQueue = struct {
+    const Self = @This();
+
+    /// Slot 0 for threads outside the pool, then one per worker
+    queues: []RenderQueue,
+    pool: *const JobSystem,
+    allocator: std.mem.Allocator,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// `allocator` must be thread safe, every worker grows its own queue with it
+    pub fn init(allocator: std.mem.Allocator, pool: *const JobSystem) !Self {
+        const queues = try allocator.alloc(RenderQueue, pool.workerCount() + 1);
+        for (queues) |*queue| queue.* = RenderQueue.init(allocator);
+        return .{
+            .queues = queues,
+            .pool = pool,
+            .allocator = allocator,
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Queue of the calling thread, only that thread may push into it until the next mergeInto
+    pub fn local(self: *Self) *RenderQueue {
+        const slot = if (self.pool.currentWorkerIndex()) |index| index + 1 else 0;
+        return &self.queues[slot];
+    }
+
+
+    /// Append every worker's draws to `target` and clear them, once the recording jobs are done
+    pub fn mergeInto(self: *Self, target: *RenderQueue) !void {
+        for (self.queues) |*queue| {
+            try target.appendQueue(queue);
+            queue.clear();
+        }
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        for (self.queues) |*queue| queue.deinit();
+        self.allocator.free(self.queues);
+    }
+};
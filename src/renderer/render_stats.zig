@@ -0,0 +1,100 @@
+// graphics/render_stats.zig
+const std = @import("std");
+const build_options = @import("build_options");
+
+
+/// Counting is compiled in with `-Drender-stats=true`, otherwise every count function is empty
+pub const enabled = build_options.render_stats;
+
+
+/// What one frame sent to GL
+pub const RenderStats = struct {
+    draw_calls: u32 = 0,
+    /// Instances of direct draws, GPU culled multi-draws decide theirs on the GPU and add none
+    instances: u64 = 0,
+    /// Triangles of direct draws, like instances
+    triangles: u64 = 0,
+    program_binds: u32 = 0,
+    vertex_array_binds: u32 = 0,
+    /// Texture and texture array binds that reached GL
+    texture_binds: u32 = 0,
+    uniform_uploads: u32 = 0,
+    /// Bytes written into buffers with glBufferData and glBufferSubData
+    upload_bytes: u64 = 0,
+
+    /// One line summary, e.g. for a window title or the console
+    pub fn format(self: RenderStats, comptime _: []const u8, _: std.fmt.FormatOptions, writer: anytype) !void {
+        try writer.print("draws {d}, instances {d}, triangles {d}, programs {d}, vaos {d}, textures {d}, uniforms {d}, uploads {d} B", .{
+            self.draw_calls,
+            self.instances,
+            self.triangles,
+            self.program_binds,
+            self.vertex_array_binds,
+            self.texture_binds,
+            self.uniform_uploads,
+            self.upload_bytes,
+        });
+    }
+};
+
+
+/// Counters of the frame being drawn on this thread, the one owning the GL context
+threadlocal var frame: RenderStats = .{};
+
+
+// ============================================================
+// Public API: Operational Functions
+// ============================================================
+
+/// Counts of the frame so far
+pub fn current() RenderStats {
+    return frame;
+}
+
+
+/// Counts of the frame that just ended, and start counting the next one from zero
+pub fn endFrame() RenderStats {
+    const finished = frame;
+    frame = .{};
+    return finished;
+}
+
+
+pub inline fn countDraw(index_count: usize, instance_count: usize) void {
+    if (!enabled) return;
+    frame.draw_calls += 1;
+    frame.instances += instance_count;
+    frame.triangles += index_count / 3 * instance_count;
+}
+
+
+/// A draw whose instance and triangle counts never reach the CPU, e.g. indirect
+pub inline fn countIndirectDraw() void {
+    if (!enabled) return;
+    frame.draw_calls += 1;
+}
+
+
+pub inline fn countProgramBind() void {
+    if (enabled) frame.program_binds += 1;
+}
+
+
+pub inline fn countVertexArrayBind() void {
+    if (enabled) frame.vertex_array_binds += 1;
+}
+
+
+pub inline fn countTextureBind() void {
+    if (enabled) frame.texture_binds += 1;
+}
+
+
+pub inline fn countUniformUpload() void {
+    if (enabled) frame.uniform_uploads += 1;
+}
+
+
+pub inline fn countUpload(bytes: usize) void {
+    if (enabled) frame.upload_bytes += bytes;
+}
@@ -0,0 +1,335 @@
+// graphics/render_target.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const MipGenerator = @import("mip_generator.zig").MipGenerator;
+
+
+pub const RenderTargetError = error{
+    /// The framebuffer or its multisampled twin is incomplete
+    IncompleteFramebuffer,
+};
+
+
+pub const RenderTargetConfig = struct {
+    width: u32,
+    height: u32,
+    /// Internal format of the color attachment
+    color_format: c.GLenum = c.GL_RGBA8,
+    /// Add a DEPTH24_STENCIL8 attachment
+    depth: bool = true,
+    /// Make the depth attachment a texture shaders can sample, see depthTexture. Ignored with samples
+    sampled_depth: bool = false,
+    /// Multisampled rendering resolved into the color texture, 0 renders into the texture directly
+    samples: u8 = 0,
+    /// Allocate a full mip chain for the color texture, filled by generateMipmaps
+    mipmaps: bool = false,
+};
+
+
+/// Offscreen framebuffer with a sampled color texture and an optional depth attachment
+/// With samples above 0 drawing goes to multisampled renderbuffers, resolve blits them into the texture
+/// Draws may cover only the lower left `width` x `height` region, resolve and blitToScreen take that region,
+/// so a scene rendered at a lower resolution needs no reallocation when its scale changes
+pub const RenderTarget = struct {
+    const Self = @This();
+
+    config: RenderTargetConfig,
+
+    /// Single sampled framebuffer holding color_texture, drawn into unless multisampled
+    fbo: c.GLuint = 0,
+    color_texture: c.GLuint = 0,
+    /// Depth of `fbo`, 0 when multisampled or without depth
+    depth_renderbuffer: c.GLuint = 0,
+    /// Depth of `fbo` instead of the renderbuffer with sampled_depth
+    depth_texture: c.GLuint = 0,
+
+    /// Multisampled framebuffer and its color and depth renderbuffers, all 0 without samples
+    msaa_fbo: c.GLuint = 0,
+    msaa_color: c.GLuint = 0,
+    msaa_depth: c.GLuint = 0,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(config: RenderTargetConfig) !Self {
+        var self = Self{ .config = config };
+        self.config.width = @max(config.width, 1);
+        self.config.height = @max(config.height, 1);
+        errdefer self.deinit();
+        try self.createAttachments();
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Reallocate the attachments at a new size, nothing happens when it is unchanged
+    pub fn resize(self: *Self, width: u32, height: u32) !void {
+        const w = @max(width, 1);
+        const h = @max(height, 1);
+        if (w == self.config.width and h == self.config.height) return;
+
+        self.destroyAttachments();
+        self.config.width = w;
+        self.config.height = h;
+        try self.createAttachments();
+    }
+
+
+    /// Draw into the target, the viewport covers all of it
+    pub fn bind(self: *const Self) void {
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.drawFramebuffer());
+        GLStateCache.current().setViewport(0, 0, @intCast(self.config.width), @intCast(self.config.height));
+    }
+
+
+    /// Framebuffer draws go to, the multisampled one when there is one
+    pub fn drawFramebuffer(self: *const Self) c.GLuint {
+        return if (self.msaa_fbo != 0) self.msaa_fbo else self.fbo;
+    }
+
+
+    /// Resolve the lower left `width` x `height` samples into color_texture, does nothing without samples
+    pub fn resolve(self: *const Self, width: u32, height: u32) void {
+        if (self.msaa_fbo == 0) return;
+        const w: c.GLint = @intCast(@min(width, self.config.width));
+        const h: c.GLint = @intCast(@min(height, self.config.height));
+
+        c.glBindFramebuffer(c.GL_READ_FRAMEBUFFER, self.msaa_fbo);
+        c.glBindFramebuffer(c.GL_DRAW_FRAMEBUFFER, self.fbo);
+        c.glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, c.GL_COLOR_BUFFER_BIT, c.GL_NEAREST);
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+        err.checkGLError("RenderTarget.resolve");
+    }
+
+
+    /// Resolve the lower left `src_width` x `src_height` region and stretch it over the default framebuffer
+    /// Filters linearly when the sizes differ, leaves the default framebuffer bound
+    pub fn blitToScreen(self: *const Self, src_width: u32, src_height: u32, dst_width: u32, dst_height: u32) void {
+        self.resolve(src_width, src_height);
+        const w: c.GLint = @intCast(@min(src_width, self.config.width));
+        const h: c.GLint = @intCast(@min(src_height, self.config.height));
+        const filter: c.GLenum = if (w == dst_width and h == dst_height) c.GL_NEAREST else c.GL_LINEAR;
+
+        c.glBindFramebuffer(c.GL_READ_FRAMEBUFFER, self.fbo);
+        c.glBindFramebuffer(c.GL_DRAW_FRAMEBUFFER, err.default_framebuffer);
+        c.glBlitFramebuffer(0, 0, w, h, 0, 0, @intCast(dst_width), @intCast(dst_height), c.GL_COLOR_BUFFER_BIT, filter);
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+        err.checkGLError("RenderTarget.blitToScreen");
+    }
+
+
+    /// Rebuild the color texture's mip chain from the whole of level 0, after drawing or resolving
+    /// Averages the stored values, render targets hold linear colors
+    pub fn generateMipmaps(self: *const Self) void {
+        if (!self.config.mipmaps) return;
+        MipGenerator.shared().generate(
+            self.color_texture,
+            self.config.color_format,
+            @intCast(self.config.width),
+            @intCast(self.config.height),
+            self.levelCount(),
+            .linear,
+        );
+    }
+
+
+    pub fn colorTexture(self: *const Self) c.GLuint {
+        return self.color_texture;
+    }
+
+
+    /// The sampled depth with sampled_depth set and no samples, 0 otherwise
+    pub fn depthTexture(self: *const Self) c.GLuint {
+        return self.depth_texture;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.destroyAttachments();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn createAttachments(self: *Self) !void {
+        const w: c.GLsizei = @intCast(self.config.width);
+        const h: c.GLsizei = @intCast(self.config.height);
+        const multisampled = self.config.samples > 0;
+
+        // Sampled color, linear so a blit or a shader can upscale it
+        c.glGenTextures(1, &self.color_texture);
+        GLStateCache.current().bindTexture2D(0, self.color_texture);
+        const levels = self.levelCount();
+        for (0..@intCast(levels)) |level| {
+            const level_w = @max(w >> @intCast(level), 1);
+            const level_h = @max(h >> @intCast(level), 1);
+            c.glTexImage2D(c.GL_TEXTURE_2D, @intCast(level), @intCast(self.config.color_format), level_w, level_h, 0, c.GL_RGBA, c.GL_UNSIGNED_BYTE, null);
+        }
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAX_LEVEL, levels - 1);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, if (levels > 1) c.GL_LINEAR_MIPMAP_LINEAR else c.GL_LINEAR);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_LINEAR);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
+
+        c.glGenFramebuffers(1, &self.fbo);
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.fbo);
+        c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_COLOR_ATTACHMENT0, c.GL_TEXTURE_2D, self.color_texture, 0);
+        if (self.config.depth and !multisampled and self.config.sampled_depth) {
+            c.glGenTextures(1, &self.depth_texture);
+            GLStateCache.current().bindTexture2D(0, self.depth_texture);
+            c.glTexImage2D(c.GL_TEXTURE_2D, 0, c.GL_DEPTH24_STENCIL8, w, h, 0, c.GL_DEPTH_STENCIL, c.GL_UNSIGNED_INT_24_8, null);
+            c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_NEAREST);
+            c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_NEAREST);
+            c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
+            c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
+            c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_DEPTH_STENCIL_ATTACHMENT, c.GL_TEXTURE_2D, self.depth_texture, 0);
+        } else if (self.config.depth and !multisampled) {
+            self.depth_renderbuffer = createRenderbuffer(0, c.GL_DEPTH24_STENCIL8, w, h);
+            c.glFramebufferRenderbuffer(c.GL_FRAMEBUFFER, c.GL_DEPTH_STENCIL_ATTACHMENT, c.GL_RENDERBUFFER, self.depth_renderbuffer);
+        }
+        try checkFramebuffer();
+
+        if (multisampled) {
+            const samples = self.config.samples;
+            c.glGenFramebuffers(1, &self.msaa_fbo);
+            c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.msaa_fbo);
+            self.msaa_color = createRenderbuffer(samples, self.config.color_format, w, h);
+            c.glFramebufferRenderbuffer(c.GL_FRAMEBUFFER, c.GL_COLOR_ATTACHMENT0, c.GL_RENDERBUFFER, self.msaa_color);
+            if (self.config.depth) {
+                self.msaa_depth = createRenderbuffer(samples, c.GL_DEPTH24_STENCIL8, w, h);
+                c.glFramebufferRenderbuffer(c.GL_FRAMEBUFFER, c.GL_DEPTH_STENCIL_ATTACHMENT, c.GL_RENDERBUFFER, self.msaa_depth);
+            }
+            try checkFramebuffer();
+        }
+
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+        err.checkGLError("RenderTarget setup");
+    }
+
+
+    /// Names that were never generated are 0 and ignored by the delete calls
+    fn destroyAttachments(self: *Self) void {
+        const state = GLStateCache.current();
+        state.forgetTexture(self.color_texture);
+        state.forgetTexture(self.depth_texture);
+        const textures = [_]c.GLuint{ self.color_texture, self.depth_texture };
+        c.glDeleteTextures(textures.len, &textures);
+        c.glDeleteFramebuffers(1, &self.fbo);
+        c.glDeleteFramebuffers(1, &self.msaa_fbo);
+        const renderbuffers = [_]c.GLuint{ self.depth_renderbuffer, self.msaa_color, self.msaa_depth };
+        c.glDeleteRenderbuffers(renderbuffers.len, &renderbuffers);
+        err.checkGLError("RenderTarget: delete attachments");
+
+        const config = self.config;
+        self.* = .{ .config = config };
+    }
+
+
+    /// Levels of the color texture, the full chain with mipmaps and 1 without
+    fn levelCount(self: *const Self) i32 {
+        if (!self.config.mipmaps) return 1;
+        return @as(i32, std.math.log2_int(u32, @max(self.config.width, self.config.height))) + 1;
+    }
+
+
+    /// Allocate a renderbuffer, multisampled when `samples` is above 0
+    fn createRenderbuffer(samples: u8, format: c.GLenum, width: c.GLsizei, height: c.GLsizei) c.GLuint {
+        var renderbuffer: c.GLuint = 0;
+        c.glGenRenderbuffers(1, &renderbuffer);
+        c.glBindRenderbuffer(c.GL_RENDERBUFFER, renderbuffer);
+        if (samples > 0) {
+            c.glRenderbufferStorageMultisample(c.GL_RENDERBUFFER, samples, format, width, height);
+        } else {
+            c.glRenderbufferStorage(c.GL_RENDERBUFFER, format, width, height);
+        }
+        c.glBindRenderbuffer(c.GL_RENDERBUFFER, 0);
+        return renderbuffer;
+    }
+
+
+    fn checkFramebuffer() !void {
+        if (c.glCheckFramebufferStatus(c.GL_FRAMEBUFFER) != c.GL_FRAMEBUFFER_COMPLETE) {
+            c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+            return RenderTargetError.IncompleteFramebuffer;
+        }
+    }
+};
+
+
+/// Picks the render scale of the scene from its GPU time
+/// The time is smoothed first, then the scale drops one step while it runs over the budget and rises one
+/// step while it stays well under it, the gap between the two thresholds keeps the scale from oscillating
+pub const DynamicResolution = struct {
+    const Self = @This();
+
+    /// GPU time budget of a frame, 16.6 ms holds 60 fps
+    target_frame_ns: u64 = 16_600_000,
+    min_scale: f32 = 0.5,
+    max_scale: f32 = 1.0,
+    /// Scale change per adjustment
+    step: f32 = 0.05,
+    /// Frames between adjustments, so a change shows up in the timings before the next one
+    interval: u32 = 8,
+
+    scale: f32 = 1.0,
+    /// Moving average of the GPU frame time
+    smoothed_ns: f32 = 0.0,
+    frames_since_change: u32 = 0,
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Feed the GPU time of a frame, 0 means no timing was available and is ignored
+    pub fn update(self: *Self, gpu_frame_ns: u64) void {
+        if (gpu_frame_ns == 0) return;
+
+        const frame_ns: f32 = @floatFromInt(gpu_frame_ns);
+        self.smoothed_ns = if (self.smoothed_ns == 0.0) frame_ns else self.smoothed_ns * 0.9 + frame_ns * 0.1;
+
+        self.frames_since_change +|= 1;
+        if (self.frames_since_change < self.interval) return;
+
+        const target: f32 = @floatFromInt(self.target_frame_ns);
+        const previous = self.scale;
+        if (self.smoothed_ns > target) {
+            self.scale = @max(self.scale - self.step, self.min_scale);
+        } else if (self.smoothed_ns < target * 0.8) {
+            self.scale = @min(self.scale + self.step, self.max_scale);
+        }
+        if (self.scale != previous) self.frames_since_change = 0;
+    }
+
+
+    /// `width` x `height` at the current scale, at least one pixel each
+    pub fn scaledSize(self: *const Self, width: u32, height: u32) [2]u32 {
+        return scaledSize(width, height, self.scale);
+    }
+};
+
+
+/// `width` x `height` times `scale`, rounded and at least one pixel each
+pub fn scaledSize(width: u32, height: u32, scale: f32) [2]u32 {
+    return .{ scaleDimension(width, scale), scaleDimension(height, scale) };
+}
+
+
+fn scaleDimension(size: u32, scale: f32) u32 {
+    const scaled: u32 = @intFromFloat(@round(@as(f32, @floatFromInt(size)) * scale));
+    return @max(scaled, 1);
+}
@@ -0,0 +1,230 @@
+// graphics/render_thread.zig
+const std = @import("std");
+
+const Window = @import("../core/window.zig").Window;
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+const profiler = @import("../core/profiler.zig");
+const Renderer = @import("renderer.zig").Renderer;
+const RenderQueue = @import("render_queue.zig").RenderQueue;
+const Camera = @import("camera.zig").Camera;
+
+const Mat4f = @import("../math/matrix.zig").Mat4f;
+const Vec3f = @import("../math/vector.zig").Vec3f;
+
+
+/// Everything the render thread needs to draw one frame, filled by the simulation
+/// Holds pointers to meshes and materials, so resources drawn in a frame stay alive until the
+/// render thread is done with it, see RenderThread.flush
+pub const RenderPacket = struct {
+    view_matrix: Mat4f = Mat4f.identity(),
+    projection_matrix: Mat4f = Mat4f.identity(),
+    camera_position: Vec3f = .{ .x = 0.0, .y = 0.0, .z = 0.0 },
+    /// Sorted and drawn on the render thread, emptied when the packet comes back to the simulation
+    queue: RenderQueue,
+    /// Clear color and depth before drawing
+    clear: bool = true,
+
+    /// Copy the matrices and position of `camera`, they are drawn with no matter how it moves afterwards
+    pub fn setCamera(self: *RenderPacket, camera: *const Camera) void {
+        self.view_matrix = camera.view_matrix;
+        self.projection_matrix = camera.projection_matrix;
+        self.camera_position = camera.position;
+    }
+};
+
+
+pub const RenderThreadConfig = struct {
+    /// Main thread jobs of this system run on the render thread after each frame's draws, so GL work
+    /// such as resource creation can be queued with spawnMain while the context lives there
+    jobs: ?*JobSystem = null,
+    /// Time per frame spent on those jobs, at least one runs if any is queued
+    gl_job_budget_ns: u64 = 2 * std.time.ns_per_ms,
+};
+
+
+/// Draws on its own thread, which owns the GL context of the window while it runs
+/// The simulation records frame N into one packet while the render thread draws frame N-1 from the
+/// other and swaps buffers, so the CPU frame time is the longer of the two instead of their sum.
+/// The simulation runs at most one frame ahead: beginFrame blocks until the packet is free again
+/// Window.pollEvents stays on the thread that created the window, GLFW requires it
+pub const RenderThread = struct {
+    const Self = @This();
+
+    allocator: std.mem.Allocator,
+    window: *Window,
+    renderer: *Renderer,
+    config: RenderThreadConfig,
+
+    packets: [2]RenderPacket,
+    /// Packet the simulation records into, simulation thread only
+    write_index: u1 = 0,
+
+    /// Guards the fields below, the condition is signaled on every change
+    mutex: std.Thread.Mutex = .{},
+    condition: std.Thread.Condition = .{},
+    /// Packet handed over and not picked up yet
+    submitted: ?u1 = null,
+    /// Packet the render thread is drawing
+    drawing: ?u1 = null,
+    running: bool = true,
+    /// First error a frame's draws hit, reported by the next submitFrame
+    draw_error: ?anyerror = null,
+    frames_drawn: u64 = 0,
+
+    thread: std.Thread = undefined,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Move the GL context of `window` to a new render thread drawing with `renderer`
+    /// No GL calls may be made from the calling thread until release
+    pub fn create(allocator: std.mem.Allocator, window: *Window, renderer: *Renderer, config: RenderThreadConfig) !*Self {
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+        self.* = .{
+            .allocator = allocator,
+            .window = window,
+            .renderer = renderer,
+            .config = config,
+            .packets = .{
+                .{ .queue = RenderQueue.init(allocator) },
+                .{ .queue = RenderQueue.init(allocator) },
+            },
+        };
+        errdefer for (&self.packets) |*packet| packet.queue.deinit();
+
+        // A context can only be current on one thread at a time
+        window.releaseContext();
+        errdefer window.makeContextCurrent();
+        self.thread = try std.Thread.spawn(.{}, renderMain, .{self});
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Empty packet to record the next frame into, waits while the render thread still draws from it
+    pub fn beginFrame(self: *Self) *RenderPacket {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        while (self.drawing == self.write_index or self.submitted == self.write_index) {
+            self.condition.wait(&self.mutex);
+        }
+
+        const packet = &self.packets[self.write_index];
+        packet.queue.clear();
+        return packet;
+    }
+
+
+    /// Hand the packet from beginFrame to the render thread, waits while the previous one was not picked up
+    /// Returns the error an earlier frame's draws failed with, once
+    pub fn submitFrame(self: *Self) !void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        while (self.submitted != null) self.condition.wait(&self.mutex);
+
+        self.submitted = self.write_index;
+        self.write_index +%= 1;
+        self.condition.broadcast();
+
+        if (self.draw_error) |draw_error| {
+            self.draw_error = null;
+            return draw_error;
+        }
+    }
+
+
+    /// Wait until every submitted frame is drawn, after which nothing refers to released resources
+    pub fn flush(self: *Self) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        while (self.submitted != null or self.drawing != null) self.condition.wait(&self.mutex);
+    }
+
+
+    /// Frames drawn and swapped so far
+    pub fn framesDrawn(self: *Self) u64 {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        return self.frames_drawn;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Draws the frame already submitted, stops the thread and makes the context current on the calling thread again
+    pub fn release(self: *Self) void {
+        {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            self.running = false;
+            self.condition.broadcast();
+        }
+        self.thread.join();
+        self.window.makeContextCurrent();
+
+        if (self.draw_error) |draw_error| {
+            std.log.err("RenderThread: frame failed to draw: {s}", .{@errorName(draw_error)});
+        }
+        for (&self.packets) |*packet| packet.queue.deinit();
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn renderMain(self: *Self) void {
+        self.window.makeContextCurrent();
+        defer self.window.releaseContext();
+        profiler.setThreadName("Render");
+
+        while (self.takePacket()) |index| {
+            self.drawPacket(&self.packets[index]) catch |e| {
+                self.mutex.lock();
+                defer self.mutex.unlock();
+                if (self.draw_error == null) self.draw_error = e;
+            };
+
+            if (self.config.jobs) |jobs| _ = jobs.runMainThreadJobs(self.config.gl_job_budget_ns);
+            self.window.swapBuffers();
+            self.renderer.endFrame();
+            profiler.frameMark();
+
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            self.drawing = null;
+            self.frames_drawn += 1;
+            self.condition.broadcast();
+        }
+    }
+
+
+    /// Next submitted packet, null once stopped with nothing left to draw
+    fn takePacket(self: *Self) ?u1 {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        while (self.submitted == null and self.running) self.condition.wait(&self.mutex);
+
+        const index = self.submitted orelse return null;
+        self.submitted = null;
+        self.drawing = index;
+        self.condition.broadcast();
+        return index;
+    }
+
+
+    fn drawPacket(self: *Self, packet: *RenderPacket) !void {
+        if (packet.clear) self.renderer.clear();
+        self.renderer.setCamera(&packet.view_matrix, &packet.projection_matrix, packet.camera_position);
+        try self.renderer.drawQueue(&packet.queue, &packet.view_matrix, &packet.projection_matrix);
+    }
+};
@@ -4,10 +4,60 @@ const c = @import("../bindings/c.zig");
 const err = @import("../core/gl.zig");
 
 const Model = @import("model.zig").Model;
+const camera_block_binding = @import("shader.zig").camera_block_binding;
+const max_views = @import("shader.zig").max_views;
 const Mesh = @import("mesh.zig").Mesh;
 const Material = @import("material.zig").Material;
+const Shader = @import("shader.zig").Shader;
+const RenderQueue = @import("render_queue.zig").RenderQueue;
+const DrawItem = @import("render_queue.zig").DrawItem;
+const InstanceFormat = @import("mesh.zig").InstanceFormat;
+const TrsInstance = @import("mesh.zig").TrsInstance;
+const IndexRange = @import("mesh.zig").IndexRange;
+const GpuCuller = @import("gpu_culling.zig").GpuCuller;
+const DrawElementsIndirectCommand = @import("gpu_culling.zig").DrawElementsIndirectCommand;
+const CullStats = @import("gpu_culling.zig").CullStats;
+const RenderBundle = @import("render_bundle.zig").RenderBundle;
+const gl_ext = @import("../core/gl_ext.zig");
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const FrameArena = @import("../core/frame_arena.zig").FrameArena;
+const profiler = @import("../core/profiler.zig");
+const GpuTimer = @import("gpu_timer.zig").GpuTimer;
+const GpuTiming = @import("gpu_timer.zig").GpuTiming;
+const render_stats = @import("render_stats.zig");
+const RenderTarget = @import("render_target.zig").RenderTarget;
+const DynamicResolution = @import("render_target.zig").DynamicResolution;
+const scaledSize = @import("render_target.zig").scaledSize;
+const RenderStats = render_stats.RenderStats;
+const TransparencyMode = @import("transparency.zig").TransparencyMode;
+const WeightedBlendedTarget = @import("transparency.zig").WeightedBlendedTarget;
+const PostProcess = @import("post_process.zig").PostProcess;
+const PostProcessConfig = @import("post_process.zig").PostProcessConfig;
+const TemporalUpscaler = @import("temporal_upscale.zig").TemporalUpscaler;
+const TemporalUpscaleConfig = @import("temporal_upscale.zig").TemporalUpscaleConfig;
 
 const Mat4f = @import("../math/matrix.zig").Mat4f;
+const Affine3x4 = @import("../math/affine.zig").Affine3x4;
+const Vec3f = @import("../math/vector.zig").Vec3f;
+
+
+/// std140 layout of the CameraBlock uniform block declared in shader.zig
+pub const CameraBlock = extern struct {
+    view: [16]f32,
+    projection: [16]f32,
+    view_projection: [16]f32,
+    position: [4]f32,
+    /// Per view of the last drawQueueViews, the first holds view_projection otherwise
+    view_projections: [max_views][16]f32,
+};
+
+
+/// One camera of a multi-view submission
+pub const RenderView = struct {
+    view_matrix: Mat4f,
+    projection_matrix: Mat4f,
+    position: Vec3f,
+};
 
 
 /// Configuration struct for renderer initialization
@@ -17,6 +67,11 @@ pub const RendererConfig = struct {
     polygon_mode: PolygonMode = .fill,
 
     depth_function: DepthFunc = .less,
+    /// drawQueue and drawCulled lay down depth with a position-only shader first, then shade with GL_EQUAL
+    /// and depth writes off, so every pixel runs its fragment shader once. Transparent items are left out of it
+    depth_prepass: bool = false,
+    /// Blending of the transparent items of drawQueue, drawn after the opaque ones without writing depth
+    transparency: TransparencyMode = .sorted,
     cull_face_mode: CullFaceMode = .back, 
     front_face_winding: FrontFaceWinding = .ccw,
     
@@ -27,6 +82,43 @@ pub const RendererConfig = struct {
         width: i32,
         height: i32,
     } = null,
+
+    /// Time GPU scopes with timestamp queries, see beginGpuScope
+    gpu_timing: bool = false,
+
+    /// Render the scene between beginScene and endScene offscreen and upscale it to the window
+    scene_scaling: ?SceneScaling = null,
+    /// Render the scene into an RGBA16F target and bloom, expose and tonemap it into the window in endScene
+    /// Needs compute shaders, with scene_scaling the upscale happens in the tonemap pass
+    post_process: ?PostProcessConfig = null,
+};
+
+
+/// Offscreen scene rendering at a fraction of the window resolution
+pub const SceneScaling = struct {
+    /// Render scale while `dynamic` is off
+    scale: f32 = 1.0,
+    /// MSAA samples of the scene target, 0 for none
+    samples: u8 = 0,
+    /// Adjust the scale from the GPU time of each frame, turns on gpu_timing
+    dynamic: ?DynamicResolution = null,
+    /// Reconstruct the window resolution image from jittered frames instead of stretching the scene,
+    /// cameras need Camera.applySceneJitter each frame. Replaces MSAA, `samples` is ignored
+    temporal: ?TemporalUpscaleConfig = null,
+};
+
+
+/// Which items of a range Renderer.drawItems draws
+const ItemFilter = enum {
+    every,
+    /// Items whose shader has transparency_glsl, into the weighted blended targets
+    weighted_blended,
+    /// Items whose shader lacks it, drawn sorted after the weighted blended ones
+    not_weighted_blended,
+    /// Instanced items whose shader has multiview_glsl, every view in one draw
+    multiview,
+    /// The others, drawn once per view
+    not_multiview,
 };
 
 
@@ -35,6 +127,51 @@ pub const Renderer = struct {
 
     config: RendererConfig,
 
+    /// Tracked GL state, binds that would change nothing are skipped
+    state: GLStateCache = .{},
+
+    /// Streamed world matrices for instanced draws
+    instance_vbo: c.GLuint = 0,
+    /// Streamed TrsInstances of the queue items pushed with pushModelTrs
+    trs_instance_vbo: c.GLuint = 0,
+
+    /// Per-frame camera data shared by every shader through `camera_block_binding`
+    camera_ubo: c.GLuint = 0,
+    /// Contents of camera_ubo, null until the first upload
+    camera_block: ?CameraBlock = null,
+    /// Views the multi-view pass of drawQueueViews draws at once, 1 outside it
+    view_count: u32 = 1,
+
+    /// Visible and culled instance counts of the last GPU cull drawn, one frame behind
+    cull_stats: CullStats = .{},
+
+    /// Transient render lists, command buffers and strings, freed in bulk by endFrame
+    frame_arena: FrameArena,
+
+    /// GPU timing scopes, null unless enabled in the config
+    gpu_timer: ?GpuTimer = null,
+
+    /// Counts of the last finished frame, all zero unless built with -Drender-stats=true
+    stats: RenderStats = .{},
+
+    /// Position-only shader of the depth prepass, created while depth_prepass is on
+    depth_shader: ?*Shader = null,
+    /// Unit cube occlusion queries are drawn with, created by the first queue with tests
+    occlusion_box: ?*Mesh = null,
+
+    /// Accumulation targets of weighted blended transparency, created on first use
+    oit_target: ?WeightedBlendedTarget = null,
+
+    /// Offscreen target of the scene, created by the first beginScene with scene_scaling or post_process set
+    scene_target: ?RenderTarget = null,
+    /// Post effects of the scene target, created by the first beginScene with post_process set
+    post_process: ?PostProcess = null,
+    /// Reconstruction of the scene target at window size, created by the first beginScene with scene_scaling.temporal
+    temporal: ?TemporalUpscaler = null,
+    /// Window size and render size of the open scene
+    scene_window_size: [2]u32 = .{ 0, 0 },
+    scene_size: [2]u32 = .{ 0, 0 },
+
 
     // ============================================================
     // Public API: Creation Functions
@@ -46,9 +183,27 @@ pub const Renderer = struct {
         render_ptr.* = .{
             .allocator = allocator,
             .config = config,
+            .frame_arena = FrameArena.init(allocator),
         };
         
+        // Meshes, textures and materials bind through this renderer's cache from now on
+        GLStateCache.makeCurrent(&render_ptr.state);
+
+        c.glGenBuffers(1, &render_ptr.instance_vbo);
+        c.glGenBuffers(1, &render_ptr.trs_instance_vbo);
+        err.checkGLError("glGenBuffers for instance_vbo");
+
+        c.glGenBuffers(1, &render_ptr.camera_ubo);
+        c.glBindBuffer(c.GL_UNIFORM_BUFFER, render_ptr.camera_ubo);
+        c.glBufferData(c.GL_UNIFORM_BUFFER, @sizeOf(CameraBlock), null, c.GL_DYNAMIC_DRAW);
+        c.glBindBufferBase(c.GL_UNIFORM_BUFFER, camera_block_binding, render_ptr.camera_ubo);
+        err.checkGLError("camera_ubo setup");
+
+        const dynamic_scaling = if (config.scene_scaling) |scaling| scaling.dynamic != null else false;
+        if (config.gpu_timing or dynamic_scaling) render_ptr.gpu_timer = GpuTimer.init();
+
         // Apply initial configuration
+        try render_ptr.setDepthPrepass(config.depth_prepass);
         try render_ptr.applyConfig();
         
         return render_ptr;
@@ -82,11 +237,157 @@ pub const Renderer = struct {
     }
 
 
+    /// Allocator for data that lives until the end of the next frame, nothing needs freeing
+    pub fn frameAllocator(self: *Renderer) std.mem.Allocator {
+        return self.frame_arena.allocator();
+    }
+
+
+    /// Close the frame, frees what the frame before it took from frameAllocator and resolves GPU timings
+    pub fn endFrame(self: *Renderer) void {
+        self.stats = render_stats.endFrame();
+        self.frame_arena.endFrame();
+        if (self.gpu_timer) |*timer| {
+            timer.endFrame();
+            if (self.config.scene_scaling) |*scaling| {
+                if (scaling.dynamic) |*dynamic| dynamic.update(timer.frameTime());
+            }
+        }
+    }
+
+
+    /// Start drawing the 3D scene of a `window_width` x `window_height` window
+    /// With scene_scaling the scene goes to an offscreen target at the scaled size, otherwise straight to the window
+    /// The camera aspect stays the window's, both sides scale alike
+    pub fn beginScene(self: *Renderer, window_width: u32, window_height: u32) !void {
+        self.beginGpuScope("Scene");
+        self.scene_window_size = .{ window_width, window_height };
+        self.scene_size = self.scene_window_size;
+
+        if (self.config.scene_scaling == null and self.config.post_process == null) {
+            self.setViewport(0, 0, @intCast(window_width), @intCast(window_height));
+            return;
+        }
+        const scaling = self.config.scene_scaling orelse SceneScaling{};
+
+        // Allocated at the largest scale the scene can reach, a scale change only shrinks the viewport
+        const max_scale = if (scaling.dynamic) |dynamic| dynamic.max_scale else scaling.scale;
+        const full_width, const full_height = scaledSize(window_width, window_height, max_scale);
+        if (self.scene_target) |*target| {
+            try target.resize(full_width, full_height);
+        } else {
+            self.scene_target = try RenderTarget.init(.{
+                .width = full_width,
+                .height = full_height,
+                .samples = if (scaling.temporal != null) 0 else scaling.samples,
+                .sampled_depth = scaling.temporal != null,
+                .color_format = if (self.config.post_process != null) c.GL_RGBA16F else c.GL_RGBA8,
+            });
+        }
+        if (scaling.temporal) |config| {
+            if (self.temporal == null) self.temporal = try TemporalUpscaler.init(config);
+            try self.temporal.?.resize(window_width, window_height);
+        }
+        if (self.config.post_process) |config| {
+            if (self.post_process == null) self.post_process = try PostProcess.init(config);
+            // After temporal upscaling the effects run on the window sized output
+            if (self.temporal != null) {
+                self.post_process.?.resize(window_width, window_height);
+            } else {
+                self.post_process.?.resize(full_width, full_height);
+            }
+        }
+
+        const width, const height = scaledSize(window_width, window_height, self.sceneScale());
+        self.scene_size = .{ @min(width, full_width), @min(height, full_height) };
+        self.scene_target.?.bind();
+        self.setViewport(0, 0, @intCast(self.scene_size[0]), @intCast(self.scene_size[1]));
+    }
+
+
+    /// Finish the scene, upscaling it into the window when it was drawn offscreen
+    /// Leaves the default framebuffer bound with a viewport over the whole window, for UI drawn at full resolution
+    pub fn endScene(self: *Renderer) void {
+        defer self.endGpuScope();
+        const window_width, const window_height = self.scene_window_size;
+
+        if (self.scene_target) |*target| {
+            if (self.temporal) |*temporal| {
+                const size = [2]u32{ target.config.width, target.config.height };
+                const output = temporal.resolve(self, target.colorTexture(), target.depthTexture(), size, self.scene_size);
+                if (self.post_process) |*post| {
+                    c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+                    self.setViewport(0, 0, @intCast(window_width), @intCast(window_height));
+                    post.apply(self, output, temporal.size, temporal.size);
+                } else {
+                    temporal.blitToScreen();
+                }
+            } else if (self.post_process) |*post| {
+                target.resolve(self.scene_size[0], self.scene_size[1]);
+                c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+                self.setViewport(0, 0, @intCast(window_width), @intCast(window_height));
+                const size = [2]u32{ target.config.width, target.config.height };
+                post.apply(self, target.colorTexture(), size, self.scene_size);
+            } else if (self.config.scene_scaling != null) {
+                target.blitToScreen(self.scene_size[0], self.scene_size[1], window_width, window_height);
+            }
+        }
+        self.setViewport(0, 0, @intCast(window_width), @intCast(window_height));
+    }
+
+
+    /// NDC jitter the camera of the open scene draws with, recording its unjittered matrices for the
+    /// temporal upscaling, zero without it. Called by Camera.applySceneJitter
+    pub fn temporalJitter(self: *Renderer, view_matrix: *const Mat4f, projection_matrix: *const Mat4f) [2]f32 {
+        const temporal = if (self.temporal) |*temporal| temporal else return .{ 0.0, 0.0 };
+        return temporal.beginFrame(view_matrix, projection_matrix, self.scene_size);
+    }
+
+
+    /// Render scale of the scene, 1 without scene_scaling
+    pub fn sceneScale(self: *const Renderer) f32 {
+        const scaling = self.config.scene_scaling orelse return 1.0;
+        if (scaling.dynamic) |dynamic| return dynamic.scale;
+        return scaling.scale;
+    }
+
+
+    /// Draw calls, binds and uploads of the last frame closed with endFrame
+    pub fn frameStats(self: *const Renderer) RenderStats {
+        return self.stats;
+    }
+
+
+    /// Open a named GPU timing scope, e.g. around a shadow or UI pass, scopes nest
+    /// Does nothing unless gpu_timing is enabled
+    pub fn beginGpuScope(self: *Renderer, name: [:0]const u8) void {
+        if (self.gpu_timer) |*timer| timer.begin(name);
+    }
+
+
+    pub fn endGpuScope(self: *Renderer) void {
+        if (self.gpu_timer) |*timer| timer.end();
+    }
+
+
+    /// GPU time of each scope of a frame a few frames back, empty unless gpu_timing is enabled
+    pub fn gpuTimings(self: *const Renderer) []const GpuTiming {
+        if (self.gpu_timer) |*timer| return timer.timings();
+        return &.{};
+    }
+
+
+    /// Turn the depth prepass of drawQueue and drawCulled on or off, the shader is created on first use
+    pub fn setDepthPrepass(self: *Renderer, enabled: bool) !void {
+        if (enabled and self.depth_shader == null) self.depth_shader = try Shader.createDepthShader(self.allocator);
+        self.config.depth_prepass = enabled;
+    }
+
+
     /// Set the polygon rendering mode
     pub fn setPolygonMode(self: *Renderer, mode: PolygonMode) void {
         self.config.polygon_mode = mode;
-        c.glPolygonMode(c.GL_FRONT_AND_BACK, mode.toGLConstant());
-        err.checkGLError("setPolygonMode");
+        self.state.setPolygonMode(mode.toGLConstant());
     }
 
 
@@ -94,14 +395,8 @@ pub const Renderer = struct {
     pub fn setDepthFunc(self: *Renderer, func: DepthFunc) void {
         self.config.depth_function = func;
 
-        if (func != .none) {
-            c.glEnable(c.GL_DEPTH_TEST);
-            c.glDepthFunc(func.toGLConstant());
-        } else {
-            c.glDisable(c.GL_DEPTH_TEST);
-        }
-
-        err.checkGLError("setDepthFunc");
+        self.state.setDepthTest(func != .none);
+        if (func != .none) self.state.setDepthFunc(func.toGLConstant());
     }
 
 
@@ -109,26 +404,21 @@ pub const Renderer = struct {
     pub fn setCullFaceMode(self: *Renderer, mode: CullFaceMode) void {
         self.config.cull_face_mode = mode;
 
-        if (mode != .none) {
-            c.glEnable(c.GL_CULL_FACE);
-            c.glCullFace(mode.toGLConstant());
-        } else {
-            c.glDisable(c.GL_CULL_FACE);
-        }
-        err.checkGLError("setCullFaceMode");
+        self.state.setCullFace(mode != .none);
+        if (mode != .none) self.state.setCullFaceMode(mode.toGLConstant());
     }
 
 
     /// Set the front face winding order
     pub fn setFrontFaceWinding(self: *Renderer, winding: FrontFaceWinding) void {
         self.config.front_face_winding = winding;
-        c.glFrontFace(winding.toGLConstant());
-        err.checkGLError("setFrontFaceWinding");
+        self.state.setFrontFace(winding.toGLConstant());
     }
 
 
     pub fn clear(self: *Renderer) void {
-        _ = self;
+        self.beginGpuScope("Clear");
+        defer self.endGpuScope();
         c.glClear(c.GL_COLOR_BUFFER_BIT | c.GL_DEPTH_BUFFER_BIT);
         err.checkGLError("glClear");
     }
@@ -136,45 +426,107 @@ pub const Renderer = struct {
 
     pub fn setClearColor(self: *Renderer, color: [4]f32) void {
         self.config.clear_color = color;
-        c.glClearColor(color[0], color[1], color[2], color[3]);
-        err.checkGLError("glClearColor");
+        self.state.setClearColor(color);
     }
 
 
     pub fn setViewport(self: *Renderer, x: i32, y: i32, width: i32, height: i32) void {
-        _ = self;
-        c.glViewport(x, y, width, height);
-        err.checkGLError("glViewport");
+        self.state.setViewport(x, y, width, height);
+    }
+
+
+    /// Write the camera block, skipped when the matrices match the last upload
+    /// Camera calls this with its position, the draw functions call it with one derived from the view matrix
+    pub fn setCamera(self: *Renderer, view_matrix: *const Mat4f, projection_matrix: *const Mat4f, position: Vec3f) void {
+        if (self.camera_block) |block| {
+            if (std.mem.eql(f32, &block.view, &view_matrix.data) and std.mem.eql(f32, &block.projection, &projection_matrix.data)) return;
+        }
+
+        var view_projection: Mat4f = undefined;
+        view_projection.multiplyInto(projection_matrix, view_matrix);
+
+        var block = CameraBlock{
+            .view = view_matrix.data,
+            .projection = projection_matrix.data,
+            .view_projection = view_projection.data,
+            .position = .{ position.x, position.y, position.z, 1.0 },
+            .view_projections = undefined,
+        };
+        @memset(&block.view_projections, Mat4f.identity().data);
+        block.view_projections[0] = view_projection.data;
+        self.uploadCameraBlock(&block);
+    }
+
+
+    /// Like setCamera with the first of `views`, plus the view-projection of each for multiview_glsl
+    pub fn setCameraViews(self: *Renderer, views: []const RenderView) void {
+        std.debug.assert(views.len > 0 and views.len <= max_views);
+        const first = &views[0];
+        var block = CameraBlock{
+            .view = first.view_matrix.data,
+            .projection = first.projection_matrix.data,
+            .view_projection = undefined,
+            .position = .{ first.position.x, first.position.y, first.position.z, 1.0 },
+            .view_projections = undefined,
+        };
+        for (&block.view_projections, 0..) |*slot, index| {
+            if (index >= views.len) {
+                slot.* = Mat4f.identity().data;
+                continue;
+            }
+            var view_projection: Mat4f = undefined;
+            view_projection.multiplyInto(&views[index].projection_matrix, &views[index].view_matrix);
+            slot.* = view_projection.data;
+        }
+        block.view_projection = block.view_projections[0];
+        self.uploadCameraBlock(&block);
     }
 
 
     // Updated draw function to accept Mesh
     pub fn drawMesh(self: *Renderer, mesh: *Mesh, material: *Material, model_matrix: *Mat4f, view_matrix: *Mat4f, projection_matrix: *Mat4f) !void {
-        _ = self;
+        const zone = profiler.zone("Renderer.drawMesh");
+        defer zone.end();
 
-        try material.use();
+        try self.prepareMeshDraw(mesh, material, model_matrix, view_matrix, projection_matrix);
+        mesh.draw(); // Draw Mesh
+    }
 
-        if (material.shader.uniform_cache.contains("model")) {
-            const model_matrix_cnst = &model_matrix.data;
-            try material.shader.setUniformMat4("model", model_matrix_cnst);
-        }
-        if (material.shader.uniform_cache.contains("view")) {
-            const view_matrix_cnst = &view_matrix.data;
-            try material.shader.setUniformMat4("view", view_matrix_cnst);
-        }
-        if (material.shader.uniform_cache.contains("projection")) {
-            const projection_matrix_cnst = &projection_matrix.data;
-            try material.shader.setUniformMat4("projection", projection_matrix_cnst);
+
+    /// Draw parts of `mesh` with one call per range, e.g. the visible chunks of a StaticBatch
+    pub fn drawMeshRanges(self: *Renderer, mesh: *Mesh, material: *Material, ranges: []const IndexRange, model_matrix: *Mat4f, view_matrix: *Mat4f, projection_matrix: *Mat4f) !void {
+        if (ranges.len == 0) return;
+        const zone = profiler.zone("Renderer.drawMeshRanges");
+        defer zone.end();
+
+        try self.prepareMeshDraw(mesh, material, model_matrix, view_matrix, projection_matrix);
+        for (ranges) |range| {
+            mesh.drawRange(range.first, range.count);
         }
+    }
 
-        mesh.bind(); // Bind Mesh
 
-        // (Optional) If you need to retrieve the current program, do it correctly:
-        var current_program_id: c.GLint = 0;
-        c.glGetIntegerv(c.GL_CURRENT_PROGRAM, &current_program_id);
-        err.checkGLError("glGetIntegerv");
+    /// Program, material, matrices and VAO of a non-instanced draw
+    fn prepareMeshDraw(self: *Renderer, mesh: *Mesh, material: *Material, model_matrix: *Mat4f, view_matrix: *Mat4f, projection_matrix: *Mat4f) !void {
+        self.setCamera(view_matrix, projection_matrix, cameraPosition(view_matrix));
 
-        mesh.draw(); // Draw Mesh
+        self.state.useProgram(material.shader.program);
+        try material.apply();
+
+        if (material.shader.has(.instanced)) {
+            material.shader.setInt(.instanced, 0);
+        }
+        if (material.shader.has(.model)) {
+            material.shader.setMat4(.model, &model_matrix.data);
+        }
+        if (material.shader.has(.view)) {
+            material.shader.setMat4(.view, &view_matrix.data);
+        }
+        if (material.shader.has(.projection)) {
+            material.shader.setMat4(.projection, &projection_matrix.data);
+        }
+
+        self.state.bindVertexArray(mesh.vao); // Bind Mesh
     }
 
 
@@ -189,13 +541,636 @@ pub const Renderer = struct {
     }
 
 
+    /// Draw `model` once per world matrix, with one instanced draw call per mesh-material pair
+    /// Pairs whose shader has no `instanced` uniform fall back to one drawMesh per matrix
+    pub fn drawModelInstanced(self: *Renderer, model: *Model, world_matrices: []const Affine3x4, view_matrix: *Mat4f, projection_matrix: *Mat4f) !void {
+        if (world_matrices.len == 0) return;
+
+        // Upload once, every pair reads the same matrices
+        self.setCamera(view_matrix, projection_matrix, cameraPosition(view_matrix));
+        self.uploadInstances(world_matrices);
+
+        for (model.pairs.items) |pair| {
+            const shader = pair.material.shader;
+
+            if (!shader.has(.instanced)) {
+                for (world_matrices) |*matrix| {
+                    var model_matrix = matrix.toMat4();
+                    try self.drawMesh(pair.mesh, pair.material, &model_matrix, view_matrix, projection_matrix);
+                }
+                continue;
+            }
+
+            self.state.useProgram(shader.program);
+            try pair.material.apply();
+            shader.setInt(.instanced, 1);
+            // A queue may have left the program reading TRS instances
+            if (shader.has(.trs_instances)) shader.setInt(.trs_instances, 0);
+
+            if (shader.has(.view)) {
+                shader.setMat4(.view, &view_matrix.data);
+            }
+            if (shader.has(.projection)) {
+                shader.setMat4(.projection, &projection_matrix.data);
+            }
+
+            pair.mesh.bindInstanced(self.instance_vbo, 0);
+            pair.mesh.drawInstanced(world_matrices.len);
+        }
+    }
+
+
+    /// Sort and draw every queued item, only switching program, material and mesh when the next item needs it
+    /// Transparent items come last, blended as config.transparency says
+    pub fn drawQueue(self: *Renderer, queue: *RenderQueue, view_matrix: *Mat4f, projection_matrix: *Mat4f) !void {
+        if (queue.isEmpty()) return;
+        const zone = profiler.zone("Renderer.drawQueue");
+        defer zone.end();
+        self.beginGpuScope("Queue");
+        defer self.endGpuScope();
+
+        const eye = cameraPosition(view_matrix);
+        try queue.sortForView(eye);
+        self.setCamera(view_matrix, projection_matrix, eye);
+        self.uploadQueueInstances(queue);
+
+        if (self.config.depth_prepass) try self.drawQueueDepth(queue, "Depth prepass", false);
+
+        const items = queue.items.items;
+        const first_transparent = queue.firstTransparent();
+        {
+            self.beginColorPass();
+            defer self.endColorPass();
+            try self.drawItems(queue, items[0..first_transparent], view_matrix, projection_matrix, .every);
+        }
+        // Against the finished opaque depth, read by next frame's draws
+        if (queue.occlusion_tests.items.len > 0) try self.issueOcclusionTests(queue);
+        if (first_transparent < items.len) {
+            try self.drawTransparent(queue, items[first_transparent..], view_matrix, projection_matrix);
+        }
+    }
+
+
+    /// Draw a queue once for every view, side by side in equal columns of the current viewport, e.g. both eyes
+    /// of a headset or the players of a split-screen. Each view's projection should match its column's aspect
+    /// Instanced items whose shader has multiview_glsl draw all views in one submission, the rest and the
+    /// transparent items are drawn per view. Skips the depth prepass and occlusion tests
+    pub fn drawQueueViews(self: *Renderer, queue: *RenderQueue, views: []RenderView) !void {
+        std.debug.assert(views.len > 0 and views.len <= max_views);
+        if (queue.isEmpty()) return;
+        const zone = profiler.zone("Renderer.drawQueueViews");
+        defer zone.end();
+        self.beginGpuScope("Multi-view queue");
+        defer self.endGpuScope();
+
+        try queue.sortForView(views[0].position);
+        self.uploadQueueInstances(queue);
+
+        var viewport: [4]c.GLint = .{ 0, 0, 0, 0 };
+        if (self.state.viewport) |cached| viewport = cached else c.glGetIntegerv(c.GL_VIEWPORT, &viewport);
+        defer self.state.setViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+        const items = queue.items.items;
+        const first_transparent = queue.firstTransparent();
+        {
+            self.setCameraViews(views);
+            self.view_count = @intCast(views.len);
+            c.glEnable(c.GL_CLIP_DISTANCE0);
+            c.glEnable(c.GL_CLIP_DISTANCE1);
+            defer {
+                c.glDisable(c.GL_CLIP_DISTANCE0);
+                c.glDisable(c.GL_CLIP_DISTANCE1);
+                self.view_count = 1;
+            }
+            try self.drawItems(queue, items[0..first_transparent], &views[0].view_matrix, &views[0].projection_matrix, .multiview);
+        }
+
+        const column_width = @divTrunc(viewport[2], @as(c.GLint, @intCast(views.len)));
+        for (views, 0..) |*view, index| {
+            self.state.setViewport(viewport[0] + column_width * @as(c.GLint, @intCast(index)), viewport[1], column_width, viewport[3]);
+            self.setCamera(&view.view_matrix, &view.projection_matrix, view.position);
+            try self.drawItems(queue, items[0..first_transparent], &view.view_matrix, &view.projection_matrix, .not_multiview);
+            if (first_transparent < items.len) {
+                try self.drawTransparent(queue, items[first_transparent..], &view.view_matrix, &view.projection_matrix);
+            }
+        }
+    }
+
+
+    /// Depth of every queued item from a light's view into the bound framebuffer, e.g. a shadow cascade
+    pub fn drawShadowCasters(self: *Renderer, queue: *RenderQueue, view_matrix: *Mat4f, projection_matrix: *Mat4f) !void {
+        if (queue.isEmpty()) return;
+        const zone = profiler.zone("Renderer.drawShadowCasters");
+        defer zone.end();
+        if (self.depth_shader == null) self.depth_shader = try Shader.createDepthShader(self.allocator);
+
+        try queue.sort();
+        self.setCamera(view_matrix, projection_matrix, cameraPosition(view_matrix));
+        self.uploadQueueInstances(queue);
+        try self.drawQueueDepth(queue, "Shadow casters", true);
+    }
+
+    /// Draw what the last GpuCuller.cull left visible, one multi-draw per VAO-material batch, or per VAO with a MaterialTable
+    /// A pulled build is a single multi-draw. The instance counts never come back to the CPU
+    pub fn drawCulled(self: *Renderer, culler: *GpuCuller, view_matrix: *Mat4f, projection_matrix: *Mat4f) !void {
+        self.beginGpuScope("Culled");
+        defer self.endGpuScope();
+        self.setCamera(view_matrix, projection_matrix, cameraPosition(view_matrix));
+        self.cull_stats = culler.stats;
+        c.glBindBuffer(gl_ext.GL_DRAW_INDIRECT_BUFFER, culler.command_buffer);
+
+        if (self.config.depth_prepass) self.drawCulledDepth(culler);
+        self.beginColorPass();
+        defer self.endColorPass();
+
+        // Every layout in one call, the puller's VAO has no vertex attributes to switch
+        if (culler.puller) |puller| {
+            puller.bind(culler.visible_buffer, culler.visible_material_buffer);
+            drawPulled(culler);
+            c.glBindBuffer(gl_ext.GL_DRAW_INDIRECT_BUFFER, 0);
+            return;
+        }
+
+        // One shader and buffer for every material, the batches differ only in their VAO
+        if (culler.material_table) |table| {
+            table.bind();
+            for (culler.batches.items) |batch| {
+                batch.mesh.bindInstanced(culler.visible_buffer, 0);
+                batch.mesh.setMaterialSource(culler.visible_material_buffer);
+
+                const offset = batch.first_command * @sizeOf(DrawElementsIndirectCommand);
+                gl_ext.multiDrawElementsIndirect.?(c.GL_TRIANGLES, batch.mesh.index_type.toGLConstant(), @ptrFromInt(offset), @intCast(batch.command_count), 0);
+                err.checkGLError("glMultiDrawElementsIndirect");
+                render_stats.countIndirectDraw();
+            }
+            c.glBindBuffer(gl_ext.GL_DRAW_INDIRECT_BUFFER, 0);
+            return;
+        }
+
+        var current_shader: ?*Shader = null;
+        for (culler.batches.items) |batch| {
+            const shader = batch.material.shader;
+            if (shader != current_shader) {
+                self.state.useProgram(shader.program);
+                shader.setInt(.instanced, 1);
+                if (shader.has(.trs_instances)) shader.setInt(.trs_instances, 0);
+                if (shader.has(.view)) {
+                    shader.setMat4(.view, &view_matrix.data);
+                }
+                if (shader.has(.projection)) {
+                    shader.setMat4(.projection, &projection_matrix.data);
+                }
+                current_shader = shader;
+            }
+            try batch.material.apply();
+
+            // base_instance of each command offsets into the culled matrices
+            batch.mesh.bindInstanced(culler.visible_buffer, 0);
+
+            const offset = batch.first_command * @sizeOf(DrawElementsIndirectCommand);
+            gl_ext.multiDrawElementsIndirect.?(c.GL_TRIANGLES, batch.mesh.index_type.toGLConstant(), @ptrFromInt(offset), @intCast(batch.command_count), 0);
+            err.checkGLError("glMultiDrawElementsIndirect");
+            render_stats.countIndirectDraw();
+        }
+
+        c.glBindBuffer(gl_ext.GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+
+    /// Draw a recorded RenderBundle from its own buffers, one multi-draw per batch, uploading nothing
+    /// Without multi-draw indirect every recorded item is one instanced draw from the same buffers
+    pub fn drawBundle(self: *Renderer, bundle: *const RenderBundle, view_matrix: *Mat4f, projection_matrix: *Mat4f) !void {
+        if (bundle.isEmpty()) return;
+        const zone = profiler.zone("Renderer.drawBundle");
+        defer zone.end();
+        self.beginGpuScope("Bundle");
+        defer self.endGpuScope();
+        self.setCamera(view_matrix, projection_matrix, cameraPosition(view_matrix));
+
+        const indirect = gl_ext.multiDrawElementsIndirect != null;
+        if (indirect) c.glBindBuffer(gl_ext.GL_DRAW_INDIRECT_BUFFER, bundle.command_buffer);
+        defer if (indirect) c.glBindBuffer(gl_ext.GL_DRAW_INDIRECT_BUFFER, 0);
+
+        if (self.config.depth_prepass) try self.drawBundleDepth(bundle, indirect);
+        self.beginColorPass();
+        defer self.endColorPass();
+
+        var current_shader: ?*Shader = null;
+        for (bundle.batches.items) |batch| {
+            const shader = batch.material.shader;
+            if (shader != current_shader) {
+                self.state.useProgram(shader.program);
+                shader.setInt(.instanced, 1);
+                if (shader.has(.trs_instances)) shader.setInt(.trs_instances, 0);
+                if (shader.has(.view)) {
+                    shader.setMat4(.view, &view_matrix.data);
+                }
+                if (shader.has(.projection)) {
+                    shader.setMat4(.projection, &projection_matrix.data);
+                }
+                current_shader = shader;
+            }
+            try batch.material.apply();
+
+            batch.mesh.bind();
+            drawBundleBatch(bundle, batch, indirect, false);
+        }
+    }
+
+
     // ============================================================
     // Public API: Destruction Function
     // ============================================================
 
     pub fn release(self: *Renderer) void {
+        self.state.forgetBuffer(self.instance_vbo);
+        self.state.forgetBuffer(self.trs_instance_vbo);
+        c.glDeleteBuffers(1, &self.instance_vbo);
+        c.glDeleteBuffers(1, &self.trs_instance_vbo);
+        err.checkGLError("glDeleteBuffers for instance_vbo");
+
+        c.glDeleteBuffers(1, &self.camera_ubo);
+        err.checkGLError("glDeleteBuffers for camera_ubo");
+
+        if (self.gpu_timer) |*timer| timer.deinit();
+        if (self.scene_target) |*target| target.deinit();
+        if (self.post_process) |*post| post.deinit();
+        if (self.temporal) |*temporal| temporal.deinit();
+        if (self.oit_target) |*target| target.deinit();
+        if (self.depth_shader) |shader| _ = shader.release();
+        if (self.occlusion_box) |box| _ = box.release();
+
+        if (GLStateCache.current() == &self.state) GLStateCache.makeCurrent(null);
+        self.frame_arena.deinit();
         self.allocator.destroy(self);
     }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Draw `items` of the sorted queue with the current depth and blend state
+    fn drawItems(self: *Renderer, queue: *RenderQueue, items: []const DrawItem, view_matrix: *Mat4f, projection_matrix: *Mat4f, filter: ItemFilter) !void {
+        const views: u32 = if (filter == .multiview) self.view_count else 1;
+        var current_shader: ?*Shader = null;
+        var current_material: ?*Material = null;
+        var current_mesh: ?*Mesh = null;
+        var current_format: ?InstanceFormat = null;
+
+        // oitPass stays with the program, so it is set back before moving on to the next one
+        const oit = filter == .weighted_blended;
+        defer if (oit) {
+            if (current_shader) |shader| shader.setInt(.oit_pass, 0);
+        }
+
+        for (items) |item| {
+            const shader = item.material.shader;
+            switch (filter) {
+                .every => {},
+                .weighted_blended => if (!shader.has(.oit_pass)) continue,
+                .not_weighted_blended => if (shader.has(.oit_pass)) continue,
+                .multiview => if (!isMultiview(shader)) continue,
+                .not_multiview => if (isMultiview(shader)) continue,
+            }
+
+            // Uniforms stay with the program, so view and projection are set once per program
+            if (shader != current_shader) {
+                if (oit) {
+                    if (current_shader) |previous| previous.setInt(.oit_pass, 0);
+                }
+                self.state.useProgram(shader.program);
+                if (oit) shader.setInt(.oit_pass, 1);
+
+                if (shader.has(.instanced)) {
+                    shader.setInt(.instanced, 1);
+                }
+                if (shader.has(.view)) {
+                    shader.setMat4(.view, &view_matrix.data);
+                }
+                if (shader.has(.projection)) {
+                    shader.setMat4(.projection, &projection_matrix.data);
+                }
+                if (shader.has(.view_count)) {
+                    shader.setInt(.view_count, @intCast(views));
+                }
+
+                current_shader = shader;
+                current_material = null;
+                current_format = null;
+            }
+
+            if (item.material != current_material) {
+                try item.material.apply();
+                current_material = item.material;
+            }
+
+            if (item.mesh != current_mesh) {
+                self.state.bindVertexArray(item.mesh.vao);
+                current_mesh = item.mesh;
+            }
+
+            // No wait, while the result is still on its way the item is drawn
+            const conditional = item.occlusion_query != 0;
+            if (conditional) c.glBeginConditionalRender(item.occlusion_query, c.GL_QUERY_NO_WAIT);
+            defer if (conditional) c.glEndConditionalRender();
+
+            // Shaders without an instanced path get one draw per matrix
+            if (!shader.has(.instanced)) {
+                for (0..item.instance_count) |index| {
+                    if (shader.has(.model)) {
+                        const model_matrix = queue.instanceMatrix(item, index).toMat4();
+                        shader.setMat4(.model, &model_matrix.data);
+                    }
+                    item.mesh.draw();
+                }
+                continue;
+            }
+
+            self.setItemInstances(shader, item, &current_format, false, views);
+            item.mesh.drawInstanced(item.instance_count * views);
+        }
+    }
+
+
+    fn isMultiview(shader: *const Shader) bool {
+        return shader.has(.view_count) and shader.has(.instanced);
+    }
+
+
+    /// Transparent items tested against the opaque depth without writing their own, blended as configured
+    /// Leaves blending off and depth writes on
+    fn drawTransparent(self: *Renderer, queue: *RenderQueue, items: []const DrawItem, view_matrix: *Mat4f, projection_matrix: *Mat4f) !void {
+        self.beginGpuScope("Transparent");
+        defer self.endGpuScope();
+        self.state.setDepthMask(false);
+        defer {
+            self.state.setBlend(.off);
+            self.state.setDepthMask(true);
+        }
+
+        if (self.config.transparency == .weighted_blended) {
+            var viewport: [4]c.GLint = .{ 0, 0, 0, 0 };
+            if (self.state.viewport) |cached| viewport = cached else c.glGetIntegerv(c.GL_VIEWPORT, &viewport);
+            const width: u32 = @intCast(viewport[0] + viewport[2]);
+            const height: u32 = @intCast(viewport[1] + viewport[3]);
+
+            if (self.oit_target == null) self.oit_target = try WeightedBlendedTarget.init(width, height);
+            const target = &self.oit_target.?;
+            try target.begin(width, height);
+            try self.drawItems(queue, items, view_matrix, projection_matrix, .weighted_blended);
+            target.end();
+
+            // Shaders without the weighted blended output still need their order
+            try self.drawItems(queue, items, view_matrix, projection_matrix, .not_weighted_blended);
+            return;
+        }
+
+        self.state.setBlend(.alpha);
+        try self.drawItems(queue, items, view_matrix, projection_matrix, .every);
+    }
+
+
+    /// Depth only, every queued item instanced from the matrices drawQueue uploaded
+    /// Transparent items are skipped unless `include_transparent`, they don't hide what is behind them
+    /// Items whose shader declares `depthPass` place their vertices themselves, e.g. impostors, and are drawn
+    /// with their own program and material while it is set
+    fn drawQueueDepth(self: *Renderer, queue: *RenderQueue, scope: [:0]const u8, include_transparent: bool) !void {
+        self.beginGpuScope(scope);
+        defer self.endGpuScope();
+        self.beginDepthPass();
+        defer self.state.setColorMask(true);
+
+        const items = if (include_transparent) queue.items.items else queue.items.items[0..queue.firstTransparent()];
+        const shader = self.depth_shader.?;
+        var current_mesh: ?*Mesh = null;
+        var current_format: ?InstanceFormat = null;
+        for (items) |item| {
+            if (item.material.shader.has(.depth_pass)) {
+                // Reads the full vertex, not only the position stream
+                self.state.bindVertexArray(item.mesh.vao);
+                current_mesh = null;
+                try self.drawOwnDepth(item);
+                continue;
+            }
+            if (item.mesh != current_mesh) {
+                item.mesh.bindDepth();
+                current_mesh = item.mesh;
+            }
+            self.setItemInstances(shader, item, &current_format, true, 1);
+            if (item.occlusion_query != 0) c.glBeginConditionalRender(item.occlusion_query, c.GL_QUERY_NO_WAIT);
+            item.mesh.drawInstanced(item.instance_count);
+            if (item.occlusion_query != 0) c.glEndConditionalRender();
+        }
+    }
+
+
+    /// One item of a depth pass through its own shader, the depth shader is in use again afterwards
+    fn drawOwnDepth(self: *Renderer, item: DrawItem) !void {
+        const shader = item.material.shader;
+        self.state.useProgram(shader.program);
+        defer self.state.useProgram(self.depth_shader.?.program);
+
+        shader.setInt(.depth_pass, 1);
+        defer shader.setInt(.depth_pass, 0);
+        if (shader.has(.instanced)) shader.setInt(.instanced, 1);
+        try item.material.apply();
+
+        var format: ?InstanceFormat = null;
+        self.setItemInstances(shader, item, &format, false, 1);
+        item.mesh.drawInstanced(item.instance_count);
+    }
+
+
+    /// Depth only, the culled commands re-issued per batch, assumes the command buffer is bound
+    fn drawCulledDepth(self: *Renderer, culler: *GpuCuller) void {
+        self.beginGpuScope("Depth prepass");
+        defer self.endGpuScope();
+        self.beginDepthPass();
+        defer self.state.setColorMask(true);
+
+        // The pulling program writes color too, the mask drops it
+        if (culler.puller) |puller| {
+            puller.bind(culler.visible_buffer, culler.visible_material_buffer);
+            drawPulled(culler);
+            return;
+        }
+        for (culler.batches.items) |batch| {
+            batch.mesh.bindDepth();
+            batch.mesh.setDepthInstanceSourceFormat(culler.visible_buffer, 0, .affine);
+            const offset = batch.first_command * @sizeOf(DrawElementsIndirectCommand);
+            gl_ext.multiDrawElementsIndirect.?(c.GL_TRIANGLES, batch.mesh.index_type.toGLConstant(), @ptrFromInt(offset), @intCast(batch.command_count), 0);
+            err.checkGLError("depth prepass: glMultiDrawElementsIndirect");
+            render_stats.countIndirectDraw();
+        }
+    }
+
+
+    /// Depth only, the bundle's batches through the depth shader
+    fn drawBundleDepth(self: *Renderer, bundle: *const RenderBundle, indirect: bool) !void {
+        if (self.depth_shader == null) self.depth_shader = try Shader.createDepthShader(self.allocator);
+        self.beginGpuScope("Bundle depth prepass");
+        defer self.endGpuScope();
+        self.beginDepthPass();
+        defer self.state.setColorMask(true);
+
+        for (bundle.batches.items) |batch| {
+            batch.mesh.bindDepth();
+            drawBundleBatch(bundle, batch, indirect, true);
+        }
+    }
+
+
+    /// The commands of one batch, assumes its VAO and the bundle's command buffer are bound
+    /// base_instance of each command offsets into the bundle's matrices
+    fn drawBundleBatch(bundle: *const RenderBundle, batch: RenderBundle.Batch, indirect: bool, depth_only: bool) void {
+        if (indirect) {
+            if (depth_only) {
+                batch.mesh.setDepthInstanceSourceFormat(bundle.instance_buffer, 0, .affine);
+            } else {
+                batch.mesh.setInstanceSource(bundle.instance_buffer, 0);
+            }
+            const offset = batch.first_command * @sizeOf(RenderBundle.Command);
+            gl_ext.multiDrawElementsIndirect.?(c.GL_TRIANGLES, batch.mesh.index_type.toGLConstant(), @ptrFromInt(offset), @intCast(batch.command_count), 0);
+            err.checkGLError("drawBundle: glMultiDrawElementsIndirect");
+            render_stats.countIndirectDraw();
+            return;
+        }
+
+        const first = batch.first_command;
+        for (bundle.commands.items[first..][0..batch.command_count], bundle.meshes.items[first..][0..batch.command_count]) |command, mesh| {
+            if (depth_only) {
+                mesh.setDepthInstanceSourceFormat(bundle.instance_buffer, command.base_instance, .affine);
+            } else {
+                mesh.setInstanceSource(bundle.instance_buffer, command.base_instance);
+            }
+            mesh.drawInstanced(command.instance_count);
+        }
+    }
+
+
+    /// Draw the box of every occlusion test of `queue` into its query, without writing color or depth
+    fn issueOcclusionTests(self: *Renderer, queue: *RenderQueue) !void {
+        self.beginGpuScope("Occlusion tests");
+        defer self.endGpuScope();
+        if (self.depth_shader == null) self.depth_shader = try Shader.createDepthShader(self.allocator);
+        if (self.occlusion_box == null) self.occlusion_box = try Mesh.createCube(self.allocator);
+        const box = self.occlusion_box.?;
+
+        self.beginDepthPass();
+        self.state.setDepthMask(false);
+        defer {
+            self.state.setColorMask(true);
+            self.state.setDepthMask(true);
+        }
+
+        box.bind();
+        for (queue.occlusion_tests.items) |test_box| {
+            box.setInstanceSource(self.instance_vbo, test_box.box_instance);
+            c.glBeginQuery(gl_ext.occlusion_query_target, test_box.query);
+            box.drawInstanced(1);
+            c.glEndQuery(gl_ext.occlusion_query_target);
+        }
+        err.checkGLError("issueOcclusionTests");
+    }
+
+
+    /// Every command of a pulled build as arrays, assumes the puller and the command buffer are bound
+    fn drawPulled(culler: *GpuCuller) void {
+        gl_ext.multiDrawArraysIndirect.?(c.GL_TRIANGLES, null, @intCast(culler.commands.items.len), @sizeOf(DrawElementsIndirectCommand));
+        err.checkGLError("glMultiDrawArraysIndirect");
+        render_stats.countIndirectDraw();
+    }
+
+
+    /// Depth shader bound, color writes off and depth writes on with the configured test
+    fn beginDepthPass(self: *Renderer) void {
+        const shader = self.depth_shader.?;
+        self.state.useProgram(shader.program);
+        shader.setInt(.instanced, 1);
+        if (shader.has(.trs_instances)) shader.setInt(.trs_instances, 0);
+        self.state.setColorMask(false);
+        self.state.setDepthMask(true);
+        self.setDepthFunc(self.config.depth_function);
+    }
+
+
+    /// After a prepass only fragments matching the laid down depth shade, and depth stays as it is
+    fn beginColorPass(self: *Renderer) void {
+        if (!self.config.depth_prepass) return;
+        self.state.setDepthFunc(c.GL_EQUAL);
+        self.state.setDepthMask(false);
+    }
+
+
+    fn endColorPass(self: *Renderer) void {
+        if (!self.config.depth_prepass) return;
+        self.state.setDepthMask(true);
+        if (self.config.depth_function != .none) self.state.setDepthFunc(self.config.depth_function.toGLConstant());
+    }
+
+
+    fn uploadCameraBlock(self: *Renderer, block: *const CameraBlock) void {
+        self.state.bufferSubData(c.GL_UNIFORM_BUFFER, self.camera_ubo, 0, std.mem.asBytes(block));
+        render_stats.countUpload(@sizeOf(CameraBlock));
+        self.camera_block = block.*;
+    }
+
+
+    /// Stream world matrices into the instance buffer, orphaning last frame's storage
+    fn uploadInstances(self: *Renderer, world_matrices: []const Affine3x4) void {
+        comptime std.debug.assert(@sizeOf(Affine3x4) == 12 * @sizeOf(f32));
+
+        self.state.bindArrayBuffer(self.instance_vbo);
+        c.glBufferData(c.GL_ARRAY_BUFFER, @intCast(world_matrices.len * @sizeOf(Affine3x4)), world_matrices.ptr, c.GL_STREAM_DRAW);
+        err.checkGLError("uploadInstances: glBufferData");
+        render_stats.countUpload(world_matrices.len * @sizeOf(Affine3x4));
+    }
+
+
+    /// Stream both instance lists of a queue, the TRS buffer is left alone when no item uses it
+    fn uploadQueueInstances(self: *Renderer, queue: *const RenderQueue) void {
+        self.uploadInstances(queue.matrices.items);
+
+        const instances = queue.trs_instances.items;
+        if (instances.len == 0) return;
+        self.state.bindArrayBuffer(self.trs_instance_vbo);
+        c.glBufferData(c.GL_ARRAY_BUFFER, @intCast(instances.len * @sizeOf(TrsInstance)), instances.ptr, c.GL_STREAM_DRAW);
+        err.checkGLError("uploadQueueInstances: glBufferData");
+        render_stats.countUpload(instances.len * @sizeOf(TrsInstance));
+    }
+
+
+    /// Point the bound VAO at the instances of `item` and switch the shader's instance layout when it changes
+    /// `current_format` is what the shader was last set to, null after a program change
+    /// `depth_only` when the VAO bound is the one of bindDepth, `views` repeats every instance for a multi-view draw
+    fn setItemInstances(self: *Renderer, shader: *Shader, item: DrawItem, current_format: *?InstanceFormat, depth_only: bool, views: u32) void {
+        if (current_format.* != item.instance_format) {
+            if (shader.has(.trs_instances)) shader.setInt(.trs_instances, @intFromBool(item.instance_format == .trs));
+            current_format.* = item.instance_format;
+        }
+        const buffer = switch (item.instance_format) {
+            .affine => self.instance_vbo,
+            .trs => self.trs_instance_vbo,
+        };
+        if (depth_only) {
+            item.mesh.setDepthInstanceSourceFormat(buffer, item.first_instance, item.instance_format);
+        } else {
+            item.mesh.setInstanceSourceViews(buffer, item.first_instance, item.instance_format, views);
+        }
+    }
+
+
+    /// Eye position of a rigid view matrix, -R^T * t
+    fn cameraPosition(view_matrix: *const Mat4f) Vec3f {
+        const m = &view_matrix.data;
+        const t = [3]f32{ m[12], m[13], m[14] };
+        return .{
+            .x = -(m[0] * t[0] + m[1] * t[1] + m[2] * t[2]),
+            .y = -(m[4] * t[0] + m[5] * t[1] + m[6] * t[2]),
+            .z = -(m[8] * t[0] + m[9] * t[1] + m[10] * t[2]),
+        };
+    }
 };
 
 
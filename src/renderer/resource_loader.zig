@@ -0,0 +1,495 @@
+// graphics/resource_loader.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+const async_io = @import("../core/async_io.zig");
+const AsyncIo = async_io.AsyncIo;
+const AsyncIoConfig = async_io.AsyncIoConfig;
+const profiler = @import("../core/profiler.zig");
+const SharedContext = @import("../core/window.zig").SharedContext;
+
+const ResourceManager = @import("resource_manager.zig").ResourceManager;
+const Model = @import("model.zig").Model;
+const Texture = @import("texture.zig").Texture;
+const GltfDocument = @import("gltf.zig").GltfDocument;
+
+
+pub const LoadError = error{
+    /// The loader was shut down before the request finished
+    LoadCancelled,
+    ImageLoadFailed,
+};
+
+
+/// Order requests are decoded and finished in, first come first served within one priority
+pub const LoadPriority = enum(u8) {
+    /// Needed for the current frame
+    immediate = 0,
+    high = 1,
+    normal = 2,
+    /// Streaming ahead, e.g. the next area of a level, runs after everything else
+    prefetch = 3,
+};
+
+
+/// What a request produced, the resource carries the reference the synchronous create would return
+pub const LoadResult = union(enum) {
+    model: *Model,
+    texture: *Texture,
+    /// A loadCustom request whose decode function succeeded, what it produced is the caller's
+    custom,
+    failed: anyerror,
+};
+
+
+/// Called on the GL thread from update once the request finished
+pub const LoadCallback = struct {
+    func: *const fn (context: ?*anyopaque, name: []const u8, result: LoadResult) void,
+    context: ?*anyopaque = null,
+};
+
+
+/// Completion of one request, owned by the caller and kept alive until it is ready
+pub const LoadFuture = struct {
+    ready: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+    result: LoadResult = .{ .failed = LoadError.LoadCancelled },
+
+    pub fn isReady(self: *const LoadFuture) bool {
+        return self.ready.load(.acquire);
+    }
+
+
+    /// The result once ready, null while the request is in flight
+    pub fn get(self: *const LoadFuture) ?LoadResult {
+        if (!self.isReady()) return null;
+        return self.result;
+    }
+};
+
+
+/// Worker side of a loadCustom request, reads `path` into whatever the context points at
+/// Runs on a pool worker, so it may not touch GL or anything the main thread uses meanwhile
+pub const DecodeCallback = struct {
+    func: *const fn (context: ?*anyopaque, path: [:0]const u8) anyerror!void,
+    context: ?*anyopaque = null,
+};
+
+
+pub const LoadOptions = struct {
+    priority: LoadPriority = .normal,
+    callback: ?LoadCallback = null,
+    future: ?*LoadFuture = null,
+
+    /// Signal the callback and the future, on the GL thread
+    pub fn complete(self: LoadOptions, name: []const u8, result: LoadResult) void {
+        if (self.future) |future| {
+            future.result = result;
+            future.ready.store(true, .release);
+        }
+        if (self.callback) |callback| callback.func(callback.context, name, result);
+    }
+};
+
+
+/// Prioritized background loading of files into ResourceManager resources
+/// Workers of the pool read and decode, always taking the most urgent queued request, and the
+/// GL objects are created from the decoded data on the GL thread inside update, which also runs
+/// the completion callbacks and fills the futures. Queueing prefetch requests for upcoming areas
+/// keeps the current one rendering without hitches
+/// With an upload context, texture pixels are also uploaded on a thread of their own, so update only
+/// wraps finished texture names and the GL thread never pays for glTexSubImage2D or mipmap generation
+/// With async I/O, texture files are read with many reads in flight and decoded from memory as they arrive
+pub const ResourceLoader = struct {
+    const Self = @This();
+
+    /// Thread safe, workers read and parse files with it
+    const worker_allocator = std.heap.page_allocator;
+
+    const Kind = enum {
+        texture,
+        model,
+        custom,
+    };
+
+    /// One request, owned by the loader until finished
+    const Job = struct {
+        kind: Kind,
+        /// Resource name, the path for textures
+        name: []u8,
+        path: [:0]u8,
+        options: LoadOptions,
+        /// Submission order, keeps requests of one priority first come first served
+        sequence: u64,
+
+        // Decoded by the worker
+        decode_error: ?anyerror = null,
+        width: i32 = 0,
+        height: i32 = 0,
+        /// RGBA pixels from stbi_load
+        pixels: ?[*]u8 = null,
+        document: ?*GltfDocument = null,
+        decode: ?DecodeCallback = null,
+
+        // Uploaded by the upload thread
+        texture_id: c.GLuint = 0,
+        /// Signals once the upload is complete on the GPU, the GL thread waits on it before use
+        fence: c.GLsync = null,
+    };
+
+    const JobQueue = std.PriorityQueue(*Job, void, compareJobs);
+
+    allocator: std.mem.Allocator,
+    pool: *JobSystem,
+    /// Every worker task spawned and not yet finished
+    wait_group: std.Thread.WaitGroup = .{},
+
+    /// Both queues are shared with the workers
+    mutex: std.Thread.Mutex = .{},
+    queued: JobQueue,
+    decoded: JobQueue,
+    /// Decoded textures waiting for the upload thread, empty without an upload context
+    uploads: JobQueue,
+    /// Signaled when an upload is queued or the upload thread should stop
+    upload_condition: std.Thread.Condition = .{},
+    stopping: bool = false,
+    upload_thread: ?std.Thread = null,
+    /// Overlapped texture file reads, off until enableAsyncIo
+    io: AsyncIo = .{},
+    /// Requests submitted and not finished yet, main thread only
+    pending_count: usize = 0,
+    next_sequence: u64 = 0,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// The loader must not move while requests run
+    pub fn init(allocator: std.mem.Allocator, pool: *JobSystem) Self {
+        return .{
+            .allocator = allocator,
+            .pool = pool,
+            .queued = JobQueue.init(allocator, {}),
+            .decoded = JobQueue.init(allocator, {}),
+            .uploads = JobQueue.init(allocator, {}),
+        };
+    }
+
+
+    /// Upload decoded textures on a thread that makes `context` current, until deinit
+    /// `context` is owned by the caller, shares the GL thread's objects and outlives the loader.
+    /// Call before the first load. Models are still finished on the GL thread, as vertex arrays aren't shared
+    pub fn enableUploadContext(self: *Self, context: *SharedContext) !void {
+        std.debug.assert(self.upload_thread == null);
+        self.upload_thread = try std.Thread.spawn(.{}, uploadMain, .{ self, context });
+    }
+
+
+    /// Read texture files through AsyncIo instead of one blocking stbi_load per worker, call before the first load
+    pub fn enableAsyncIo(self: *Self, config: AsyncIoConfig) !void {
+        try self.io.start(worker_allocator, config);
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Decode the image at `path` in the background, finished as the Texture named `path`
+    pub fn loadTexture(self: *Self, path: []const u8, options: LoadOptions) !void {
+        // The flag is global, every decode uses the same value
+        c.stbi_set_flip_vertically_on_load(1);
+        try self.submit(.texture, path, path, null, options);
+    }
+
+
+    /// Read and parse the glTF file at `path` in the background, finished as the Model `name`
+    pub fn loadModel(self: *Self, name: []const u8, path: []const u8, options: LoadOptions) !void {
+        try self.submit(.model, name, path, null, options);
+    }
+
+
+    /// Run `decode` on the file at `path` in the background, for data that isn't a ResourceManager resource
+    /// The request is prioritized and completed like the others, with a `custom` result
+    pub fn loadCustom(self: *Self, name: []const u8, path: []const u8, decode: DecodeCallback, options: LoadOptions) !void {
+        try self.submit(.custom, name, path, decode, options);
+    }
+
+
+    /// Create the resources of decoded requests until `budget_ns` nanoseconds have passed,
+    /// at least one if any is ready, most urgent first. Call once per frame on the GL thread,
+    /// returns the number of requests completed
+    pub fn update(self: *Self, resources: *ResourceManager, budget_ns: u64) usize {
+        const zone = profiler.zone("ResourceLoader.update");
+        defer zone.end();
+        const start = std.time.nanoTimestamp();
+        var completed: usize = 0;
+        while (true) {
+            const job = blk: {
+                self.mutex.lock();
+                defer self.mutex.unlock();
+                break :blk self.decoded.removeOrNull() orelse return completed;
+            };
+
+            const result = finish(resources, job) catch |e| LoadResult{ .failed = e };
+            if (result == .failed) {
+                std.debug.print("Background load of {s} failed: {s}\n", .{ job.path, @errorName(result.failed) });
+            }
+            job.options.complete(job.name, result);
+            self.freeJob(job);
+            completed += 1;
+
+            if (std.time.nanoTimestamp() - start >= budget_ns) return completed;
+        }
+    }
+
+
+    /// Requests submitted and not completed yet
+    pub fn pendingCount(self: *const Self) usize {
+        return self.pending_count;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Waits for the running decodes and drops every unfinished request
+    /// Their futures turn ready with LoadCancelled, callbacks are not called
+    pub fn deinit(self: *Self) void {
+        // Drain the queue first so the remaining worker tasks find nothing to decode
+        {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            while (self.queued.removeOrNull()) |job| self.cancel(job);
+        }
+        self.pool.waitAndWork(&self.wait_group);
+        // Reads in flight still spawn their decodes, queued ones are reported as cancelled
+        if (self.io.thread != null) {
+            self.io.stop();
+            self.pool.waitAndWork(&self.wait_group);
+        }
+
+        if (self.upload_thread) |thread| {
+            {
+                self.mutex.lock();
+                defer self.mutex.unlock();
+                while (self.uploads.removeOrNull()) |job| self.cancel(job);
+                self.stopping = true;
+            }
+            self.upload_condition.signal();
+            thread.join();
+            self.upload_thread = null;
+        }
+
+        while (self.decoded.removeOrNull()) |job| self.cancel(job);
+        self.queued.deinit();
+        self.decoded.deinit();
+        self.uploads.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn compareJobs(_: void, a: *Job, b: *Job) std.math.Order {
+        const by_priority = std.math.order(@intFromEnum(a.options.priority), @intFromEnum(b.options.priority));
+        if (by_priority != .eq) return by_priority;
+        return std.math.order(a.sequence, b.sequence);
+    }
+
+
+    fn submit(self: *Self, kind: Kind, name: []const u8, path: []const u8, decode: ?DecodeCallback, options: LoadOptions) !void {
+        const owned_name = try self.allocator.dupe(u8, name);
+        errdefer self.allocator.free(owned_name);
+        const owned_path = try self.allocator.dupeZ(u8, path);
+        errdefer self.allocator.free(owned_path);
+        const job = try self.allocator.create(Job);
+        errdefer self.allocator.destroy(job);
+        job.* = .{
+            .kind = kind,
+            .name = owned_name,
+            .path = owned_path,
+            .decode = decode,
+            .options = options,
+            .sequence = self.next_sequence,
+        };
+
+        {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            // Reserve the decoded slot now so a worker never fails to report a finished job
+            try self.decoded.ensureTotalCapacity(self.pending_count + 1);
+            if (self.upload_thread != null) try self.uploads.ensureTotalCapacity(self.pending_count + 1);
+            try self.queued.add(job);
+        }
+
+        self.next_sequence += 1;
+        self.pending_count += 1;
+        self.pool.spawnWg(&self.wait_group, decodeNext, .{self});
+    }
+
+
+    /// Worker entry, decodes whichever queued request is most urgent right now rather than the one
+    /// this task was spawned for, so late high priority requests overtake queued prefetches
+    fn decodeNext(self: *Self) void {
+        const job = blk: {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            break :blk self.queued.removeOrNull() orelse return;
+        };
+        const zone = profiler.zone("ResourceLoader.decode");
+        defer zone.end();
+
+        switch (job.kind) {
+            .texture => {
+                if (self.io.thread != null) {
+                    // The decode follows once the bytes are in, see textureRead
+                    if (self.io.read(job.path, @intFromPtr(job), .{ .func = textureRead, .context = self })) |_| return else |e| {
+                        job.decode_error = e;
+                    }
+                } else {
+                    var channels: i32 = 0;
+                    job.pixels = c.stbi_load(job.path.ptr, &job.width, &job.height, &channels, 4);
+                    if (job.pixels == null) job.decode_error = LoadError.ImageLoadFailed;
+                }
+            },
+            .model => {
+                job.document = GltfDocument.open(worker_allocator, job.path) catch |e| blk: {
+                    job.decode_error = e;
+                    break :blk null;
+                };
+            },
+            .custom => {
+                const decode = job.decode.?;
+                decode.func(decode.context, job.path) catch |e| {
+                    job.decode_error = e;
+                };
+            },
+        }
+        self.deliver(job);
+    }
+
+
+    /// AsyncIo completion, runs on the I/O thread and leaves the decode to a worker
+    fn textureRead(context: ?*anyopaque, user_data: usize, result: anyerror!async_io.ReadBuffer) void {
+        const self: *Self = @alignCast(@ptrCast(context.?));
+        const job: *Job = @ptrFromInt(user_data);
+        const buffer = result catch |e| {
+            job.decode_error = e;
+            return self.deliver(job);
+        };
+        self.pool.spawnWg(&self.wait_group, decodeTextureBytes, .{ self, job, buffer });
+    }
+
+
+    fn decodeTextureBytes(self: *Self, job: *Job, buffer: async_io.ReadBuffer) void {
+        const zone = profiler.zone("ResourceLoader.decode");
+        defer zone.end();
+        defer self.io.release(buffer);
+
+        var channels: i32 = 0;
+        job.pixels = c.stbi_load_from_memory(buffer.bytes.ptr, @intCast(buffer.bytes.len), &job.width, &job.height, &channels, 4);
+        if (job.pixels == null) job.decode_error = LoadError.ImageLoadFailed;
+        self.deliver(job);
+    }
+
+
+    /// Hand a decoded job to the upload thread, or to update
+    fn deliver(self: *Self, job: *Job) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.upload_thread != null and job.pixels != null) {
+            self.uploads.add(job) catch unreachable;
+            self.upload_condition.signal();
+        } else {
+            self.decoded.add(job) catch unreachable;
+        }
+    }
+
+
+    /// Upload thread entry, turns decoded pixels into fenced texture names until deinit
+    fn uploadMain(self: *Self, context: *SharedContext) void {
+        context.makeCurrent();
+        defer context.releaseCurrent();
+
+        while (true) {
+            const job = blk: {
+                self.mutex.lock();
+                defer self.mutex.unlock();
+                while (self.uploads.count() == 0 and !self.stopping) self.upload_condition.wait(&self.mutex);
+                break :blk self.uploads.removeOrNull() orelse return;
+            };
+            const zone = profiler.zone("ResourceLoader.upload");
+            defer zone.end();
+
+            if (Texture.createFilled(job.width, job.height, job.pixels.?)) |id| {
+                job.texture_id = id;
+                job.fence = c.glFenceSync(c.GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            } else |e| {
+                job.decode_error = e;
+            }
+            // The fence has to reach the GPU before another context can wait on it
+            c.glFlush();
+            c.stbi_image_free(job.pixels.?);
+            job.pixels = null;
+
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            self.decoded.add(job) catch unreachable;
+        }
+    }
+
+
+    /// GL side of a request, creates the resources from what the worker decoded
+    fn finish(resources: *ResourceManager, job: *Job) !LoadResult {
+        if (job.decode_error) |decode_error| return decode_error;
+
+        // A server side wait, the GL thread queues its draws behind the upload without blocking
+        if (job.fence) |fence| {
+            c.glWaitSync(fence, 0, c.GL_TIMEOUT_IGNORED);
+            c.glDeleteSync(fence);
+            job.fence = null;
+        }
+
+        return switch (job.kind) {
+            .texture => .{ .texture = if (job.texture_id != 0)
+                try resources.textures.createResource(job.name, adoptUpload, .{job})
+            else
+                try resources.textures.createResource(job.name, Texture.createRGBA, .{ job.width, job.height, job.pixels.? }) },
+            .model => .{ .model = try resources.createModelFromGltf(job.name, job.document.?) },
+            .custom => .custom,
+        };
+    }
+
+
+    /// Wrap the uploaded name, the Texture owns it from here on
+    fn adoptUpload(allocator: std.mem.Allocator, job: *Job) !*Texture {
+        const texture = try Texture.createFromId(allocator, job.texture_id, job.width, job.height);
+        job.texture_id = 0;
+        return texture;
+    }
+
+
+    fn cancel(self: *Self, job: *Job) void {
+        if (job.options.future) |future| {
+            future.result = .{ .failed = LoadError.LoadCancelled };
+            future.ready.store(true, .release);
+        }
+        self.freeJob(job);
+    }
+
+
+    fn freeJob(self: *Self, job: *Job) void {
+        if (job.pixels) |pixels| c.stbi_image_free(pixels);
+        if (job.document) |document| document.close();
+        // Names still here were uploaded but never wrapped, e.g. the resource already existed
+        if (job.fence) |fence| c.glDeleteSync(fence);
+        if (job.texture_id != 0) c.glDeleteTextures(1, &job.texture_id);
+        self.allocator.free(job.name);
+        self.allocator.free(job.path);
+        self.allocator.destroy(job);
+        self.pending_count -= 1;
+    }
+};
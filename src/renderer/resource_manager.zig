@@ -1,13 +1,36 @@
 // graphics/resource_manager.zig
 
 const std = @import("std");
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+const profiler = @import("../core/profiler.zig");
+const SharedContext = @import("../core/window.zig").SharedContext;
 
 const Model = @import("model.zig").Model;
 const Mesh = @import("mesh.zig").Mesh;
 const VertexLayout = @import("mesh.zig").VertexLayout;
 const Material = @import("material.zig").Material;
 const Texture = @import("texture.zig").Texture;
+const TextureLoader = @import("texture_loader.zig").TextureLoader;
+const SamplerCache = @import("sampler_cache.zig").SamplerCache;
+const MipGenerator = @import("mip_generator.zig").MipGenerator;
+const MaterialBuffer = @import("material_buffer.zig").MaterialBuffer;
+const texture_streamer = @import("texture_streamer.zig");
+const TextureStreamer = texture_streamer.TextureStreamer;
+const StreamingStats = texture_streamer.StreamingStats;
 const Shader = @import("shader.zig").Shader;
+const ProgramCache = @import("program_cache.zig").ProgramCache;
+const AssetArchive = @import("asset_archive.zig").AssetArchive;
+const GltfDocument = @import("gltf.zig").GltfDocument;
+const ObjectPool = @import("object_pool.zig").ObjectPool;
+const DeletionBatch = @import("gl_state.zig").DeletionBatch;
+const resource_loader = @import("resource_loader.zig");
+const ResourceLoader = resource_loader.ResourceLoader;
+const LoadOptions = resource_loader.LoadOptions;
+const AsyncIoConfig = @import("../core/async_io.zig").AsyncIoConfig;
+const ShaderReloader = @import("shader_reloader.zig").ShaderReloader;
+const shader_variants = @import("shader_variants.zig");
+const ShaderVariants = shader_variants.ShaderVariants;
+const ShaderFeatures = shader_variants.ShaderFeatures;
 
 
 pub const ResourceError = error{
@@ -15,6 +38,8 @@ pub const ResourceError = error{
     ResourceAllocationFailed,
     InvalidResourceType,
     ResourceAlreadyExists,
+    /// The handle's resource was released, its slot may hold another one by now
+    StaleHandle,
 };
 
 
@@ -27,9 +52,93 @@ pub const ResourceType = enum {
 };
 
 
-const ResourceRefInfo = struct {
+/// Generational reference into a ResourceCollection(T), compared by value and cheap to copy
+/// Each resource type gets its own handle type, so handles can't be mixed up
+pub fn Handle(comptime T: type) type {
+    return extern struct {
+        const Self = @This();
+        pub const Resource = T;
+
+        index: u32 = 0,
+        /// Zero never names a live resource
+        generation: u32 = 0,
+
+        pub const invalid = Self{};
+
+        pub fn eql(self: Self, other: Self) bool {
+            return self.index == other.index and self.generation == other.generation;
+        }
+    };
+}
+
+
+/// Reuse of released resources by a ResourceCollection's warm cache
+pub const CacheStats = struct {
+    /// Creates answered from the warm list
+    hits: usize = 0,
+    /// Creates that had to build the resource while the cache was on
+    misses: usize = 0,
+    /// Warm resources destroyed to stay within the budget
+    evictions: usize = 0,
+    warm_count: usize = 0,
+    warm_bytes: usize = 0,
+    budget_bytes: usize = 0,
+};
+
+
+/// Warm cache budget of each collection in bytes, 0 leaves that cache off
+pub const ResidencyBudget = struct {
+    models: usize = 0,
+    meshes: usize = 0,
+    materials: usize = 0,
+    textures: usize = 0,
+    shaders: usize = 0,
+};
+
+
+pub const ResourceRefInfo = struct {
     name: []u8,                     // Resource identifier
     ref_count: u32,                 // Reference count before cleanup
+    gpu_bytes: usize = 0,           // Video memory of the resource
+    cpu_bytes: usize = 0,           // System memory of the resource
+};
+
+
+/// Memory of the live resources of one type
+pub const TypeMemory = struct {
+    count: usize = 0,
+    gpu_bytes: usize = 0,
+    cpu_bytes: usize = 0,
+    /// Names sharing the resource of another name with identical content
+    aliases: usize = 0,
+    /// Memory the aliases would take as resources of their own
+    deduplicated_bytes: usize = 0,
+};
+
+
+/// Memory of everything a ResourceManager holds, cheap enough to build every frame for an overlay
+/// Warm cache entries are included, they stay resident until evicted
+pub const MemoryStats = struct {
+    models: TypeMemory = .{},
+    meshes: TypeMemory = .{},
+    materials: TypeMemory = .{},
+    textures: TypeMemory = .{},
+    shaders: TypeMemory = .{},
+
+    pub fn totalGpuBytes(self: MemoryStats) usize {
+        return self.models.gpu_bytes + self.meshes.gpu_bytes + self.materials.gpu_bytes + self.textures.gpu_bytes + self.shaders.gpu_bytes;
+    }
+
+
+    pub fn totalCpuBytes(self: MemoryStats) usize {
+        return self.models.cpu_bytes + self.meshes.cpu_bytes + self.materials.cpu_bytes + self.textures.cpu_bytes + self.shaders.cpu_bytes;
+    }
+
+
+    /// Memory saved by content deduplication, see ResourceManager.enableContentDedup
+    pub fn totalDeduplicatedBytes(self: MemoryStats) usize {
+        return self.models.deduplicated_bytes + self.meshes.deduplicated_bytes + self.materials.deduplicated_bytes + self.textures.deduplicated_bytes + self.shaders.deduplicated_bytes;
+    }
 };
 
 
@@ -45,6 +154,8 @@ pub const DebugConfig = struct {
     show_ref_counts: bool = true,
     // Controls if cleanup summary should be printed
     show_cleanup_summary: bool = true,
+    // Controls if warm cache hits and misses are printed with the summary
+    show_cache_stats: bool = true,
     
     // Controls which resource types to show debug info for
     show_models: bool = true,
@@ -70,6 +181,30 @@ pub const ResourceManager = struct {
     textures: ResourceCollection(Texture),
     shaders: ResourceCollection(Shader),
 
+    // Program binaries of shaders created from source, off until enableProgramCache
+    program_cache: ?ProgramCache = null,
+
+    // Background texture decoding, off until enableAsyncTextures
+    texture_loader: ?TextureLoader = null,
+
+    // Prioritized background loads of whole resources, off until enableBackgroundLoading
+    resource_loader: ?ResourceLoader = null,
+
+    // Mip level residency of streamed textures under a video memory budget, off until enableTextureStreaming
+    texture_streamer: ?TextureStreamer = null,
+
+    // Recompiles shaders from createShaderFromFiles when their files change, off until enableShaderHotReload
+    shader_reloader: ?ShaderReloader = null,
+
+    // Set between beginShaderBatch and finishShaderBatch, shaders from source are only submitted
+    defer_shader_compiles: bool = false,
+
+    // Textures and meshes with identical content share one GPU object, off until enableContentDedup
+    content_dedup: bool = false,
+
+    // Permutations of the built-in shader by feature bits, compiled on first use
+    shader_variants: ShaderVariants,
+
     // Debug configuration
     debug_config: DebugConfig,
 
@@ -91,6 +226,7 @@ pub const ResourceManager = struct {
             .materials = ResourceCollection(Material).init(allocator),
             .textures = ResourceCollection(Texture).init(allocator),
             .shaders = ResourceCollection(Shader).init(allocator),
+            .shader_variants = ShaderVariants.initDefault(allocator),
         };
 
         if (resource_manager_ptr.debug_config.enabled) {
@@ -101,6 +237,67 @@ pub const ResourceManager = struct {
     }   
 
 
+    /// Cache linked shader programs in `path`, createShader, autoCreateShader and shaderVariant load them instead of compiling
+    pub fn enableProgramCache(self: *ResourceManager, path: []const u8) !void {
+        if (self.program_cache) |*cache| cache.deinit();
+        self.program_cache = null;
+        self.shader_variants.program_cache = null;
+        self.program_cache = try ProgramCache.init(self.allocator, path);
+        self.shader_variants.program_cache = &self.program_cache.?;
+    }
+
+
+    /// Decode textures created by createTextureAsync on the workers of `pool`
+    /// A `staging_size` above 0 uploads them through pixel buffer regions of that many bytes per frame
+    pub fn enableAsyncTextures(self: *ResourceManager, pool: *JobSystem, staging_size: usize) !void {
+        if (self.texture_loader) |*loader| loader.deinit();
+        self.texture_loader = TextureLoader.init(self.allocator, pool);
+        if (staging_size > 0) try self.texture_loader.?.enableStaging(staging_size);
+    }
+
+
+    /// Run loadTextureInBackground and loadModelInBackground on the workers of `pool`
+    pub fn enableBackgroundLoading(self: *ResourceManager, pool: *JobSystem) void {
+        if (self.resource_loader) |*loader| loader.deinit();
+        self.resource_loader = ResourceLoader.init(self.allocator, pool);
+    }
+
+
+    /// Upload background texture loads through `context` on a thread of their own, see Window.createSharedContext
+    /// Does nothing before enableBackgroundLoading
+    pub fn enableUploadContext(self: *ResourceManager, context: *SharedContext) !void {
+        const loader = if (self.resource_loader) |*active| active else return;
+        try loader.enableUploadContext(context);
+    }
+
+
+    /// Read background texture loads with many files in flight, through IOCP or io_uring, see AsyncIo
+    /// Does nothing before enableBackgroundLoading
+    pub fn enableAsyncIo(self: *ResourceManager, config: AsyncIoConfig) !void {
+        const loader = if (self.resource_loader) |*active| active else return;
+        try loader.enableAsyncIo(config);
+    }
+
+
+    /// Keep released resources around for reuse within `budget`, so re-entering an area skips the disk
+    /// Calling again changes the budgets, lowering one evicts right away
+    pub fn enableResidencyCache(self: *ResourceManager, budget: ResidencyBudget) void {
+        self.models.setWarmBudget(budget.models);
+        self.meshes.setWarmBudget(budget.meshes);
+        self.materials.setWarmBudget(budget.materials);
+        self.textures.setWarmBudget(budget.textures);
+        self.shaders.setWarmBudget(budget.shaders);
+    }
+
+
+    /// Hash file bytes and vertex data as textures and meshes are created, so a new name whose content
+    /// matches an existing resource shares it instead of uploading a copy, see MemoryStats.totalDeduplicatedBytes
+    /// Costs an extra read of every texture file loaded synchronously, async and streamed loads are not hashed
+    pub fn enableContentDedup(self: *ResourceManager, enabled: bool) void {
+        self.content_dedup = enabled;
+    }
+
+
     // ============================================================
     // Public API: Resource Manipulation Functions
     // ============================================================
@@ -133,15 +330,134 @@ pub const ResourceManager = struct {
         }
         return try self.models.releaseResource(name);
     }
+
+    /// Import a binary glTF file as a Model, or return existing
+    /// Every primitive becomes a Mesh "name#meshM.P" paired with its Material "name#materialN",
+    /// embedded images become Textures "name#imageN" and materials pick their shader variant.
+    /// Node transforms are not applied, the meshes keep the coordinates of their own space
+    pub fn loadGltf(self: *ResourceManager, name: []const u8, path: []const u8) !*Model {
+        if (self.models.getResource(name)) |existing| {
+            existing.addRef();
+            return existing;
+        }
+        if (self.debug_config.show_res_creation and self.debug_config.show_models){
+            std.debug.print("[RS]: Importing glTF Model: \"{s}\" from {s}\n", .{name, path});
+        }
+        const zone = profiler.zone("ResourceManager.loadGltf");
+        defer zone.end();
+
+        const document = try GltfDocument.open(self.allocator, path);
+        defer document.close();
+        return self.createModelFromGltf(name, document);
+    }
+
+    /// loadGltf on an opened document, or return existing
+    pub fn createModelFromGltf(self: *ResourceManager, name: []const u8, document: *const GltfDocument) !*Model {
+        if (self.models.getResource(name)) |existing| {
+            existing.addRef();
+            return existing;
+        }
+
+        const model = try self.createModel(name);
+        errdefer self.releaseModel(name) catch {};
+
+        var resource_name = std.ArrayList(u8).init(self.allocator);
+        defer resource_name.deinit();
+
+        // Materials first, each one loading the image it samples
+        const materials = try self.allocator.alloc(*Material, document.materialCount());
+        defer self.allocator.free(materials);
+        for (materials, 0..) |*material, i| {
+            var texture: ?*Texture = null;
+            if (document.materialImage(i)) |image| {
+                resource_name.clearRetainingCapacity();
+                try resource_name.writer().print("{s}#image{d}", .{name, image});
+                texture = try self.textures.createResource(resource_name.items, GltfDocument.createTexture, .{document, image});
+            }
+
+            resource_name.clearRetainingCapacity();
+            try resource_name.writer().print("{s}#material{d}", .{name, i});
+            material.* = try self.createVariantMaterial(resource_name.items, document.materialColor(i), texture);
+        }
+
+        for (0..document.meshCount()) |mesh_index| {
+            for (0..document.primitiveCount(mesh_index)) |primitive_index| {
+                resource_name.clearRetainingCapacity();
+                try resource_name.writer().print("{s}#mesh{d}.{d}", .{name, mesh_index, primitive_index});
+                const mesh = try self.meshes.createResource(resource_name.items, GltfDocument.createMesh, .{document, mesh_index, primitive_index});
+
+                const material_index = document.primitiveMaterial(mesh_index, primitive_index);
+                const material = if (material_index != null and material_index.? < materials.len)
+                    materials[material_index.?]
+                else blk: {
+                    resource_name.clearRetainingCapacity();
+                    try resource_name.writer().print("{s}#material", .{name});
+                    break :blk try self.createVariantMaterial(resource_name.items, .{ 1, 1, 1, 1 }, null);
+                };
+                try model.addMeshMaterial(mesh, material);
+            }
+        }
+        return model;
+    }
   
   
     
+    /// Import the glTF file at `path` as the Model `name` on a worker, completed by updateBackgroundLoads
+    /// Completes at once without enableBackgroundLoading
+    pub fn loadModelInBackground(self: *ResourceManager, name: []const u8, path: []const u8, options: LoadOptions) !void {
+        const loader = if (self.resource_loader) |*active| active else {
+            const result: resource_loader.LoadResult = if (self.loadGltf(name, path)) |model| .{ .model = model } else |e| .{ .failed = e };
+            options.complete(name, result);
+            return;
+        };
+
+        if (self.debug_config.show_res_creation and self.debug_config.show_models){
+            std.debug.print("[RS]: Queueing Model: \"{s}\" from {s}\n", .{name, path});
+        }
+        try loader.loadModel(name, path, options);
+    }
+
+    /// Create the GL objects of background loads decoded since the last call, spending about `budget_ns`
+    /// nanoseconds, and signal their completions. Call once per frame, returns the number completed
+    pub fn updateBackgroundLoads(self: *ResourceManager, budget_ns: u64) usize {
+        const loader = if (self.resource_loader) |*active| active else return 0;
+        return loader.update(self, budget_ns);
+    }
+  
     /// Create a Mesh with the given parameters
     pub fn createMesh(self: *ResourceManager, name: []const u8, data: []const f32, indices: []const u32, package_size: u4) !*Mesh {
         if (self.debug_config.show_res_creation and self.debug_config.show_meshes){
             std.debug.print("[RS]: Creating Mesh: \"{s}\"\n", .{name});
         }
-        return try self.meshes.createResource(name, Mesh.create, .{data, indices, package_size});
+        const hash = self.meshContentHash(.plain, data, indices, package_size);
+        return try self.meshes.createHashedResource(name, hash, Mesh.create, .{data, indices, package_size});
+    }
+
+    /// Create the Mesh stored as `name` in `archive`, or return existing
+    /// The blobs go to the GPU straight from the mapping, the archive can be closed afterwards
+    pub fn createMeshFromArchive(self: *ResourceManager, archive: *const AssetArchive, name: []const u8) !*Mesh {
+        if (self.debug_config.show_res_creation and self.debug_config.show_meshes){
+            std.debug.print("[RS]: Creating Archived Mesh: \"{s}\"\n", .{name});
+        }
+        return try self.meshes.createResource(name, AssetArchive.createMesh, .{archive, name});
+    }
+
+    /// Create a Mesh whose data is welded and reordered for the vertex cache and fetch, for imported meshes
+    pub fn createOptimizedMesh(self: *ResourceManager, name: []const u8, data: []const f32, indices: []const u32, package_size: u4) !*Mesh {
+        if (self.debug_config.show_res_creation and self.debug_config.show_meshes){
+            std.debug.print("[RS]: Creating Optimized Mesh: \"{s}\"\n", .{name});
+        }
+        const hash = self.meshContentHash(.optimized, data, indices, package_size);
+        return try self.meshes.createHashedResource(name, hash, Mesh.createOptimized, .{data, indices, package_size});
+    }
+
+    /// Create a Mesh split into meshlets that the GpuCuller culls individually, for terrain and other large meshes
+    pub fn createClusteredMesh(self: *ResourceManager, name: []const u8, data: []const f32, indices: []const u32, package_size: u4) !*Mesh {
+        if (self.debug_config.show_res_creation and self.debug_config.show_meshes){
+            std.debug.print("[RS]: Creating Clustered Mesh: \"{s}\"\n", .{name});
+        }
+        const hash = self.meshContentHash(.clustered, data, indices, package_size);
+        return try self.meshes.createHashedResource(name, hash, Mesh.createClustered, .{data, indices, package_size});
     }
 
     /// Create a Mesh with a generated name
@@ -153,7 +469,8 @@ pub const ResourceManager = struct {
             std.debug.print("[RS]: AutoGenerating Mesh: \"{s}\"\n", .{name});
         }
 
-        return try self.meshes.createResource(name, Mesh.create, .{data, indices, package_size});
+        const hash = self.meshContentHash(.plain, data, indices, package_size);
+        return try self.meshes.createHashedResource(name, hash, Mesh.create, .{data, indices, package_size});
     }
 
     pub fn createCubeMesh(self: *ResourceManager, name: []const u8) !*Mesh {
@@ -196,6 +513,12 @@ pub const ResourceManager = struct {
         return try self.materials.createResource(name, Material.create, .{shader, color, texture});
     }
 
+    /// Create a Material on the built-in shader variant its texture needs, or return existing
+    pub fn createVariantMaterial(self: *ResourceManager, name: []const u8, color: [4]f32, texture: ?*Texture) !*Material {
+        const shader = try self.shaderVariant(ShaderFeatures.forMaterial(texture));
+        return self.createMaterial(name, shader, color, texture);
+    }
+
     /// Release a reference to a Material
     pub fn releaseMaterial(self: *ResourceManager, name: []const u8) !void {
         if (self.debug_config.show_res_release and self.debug_config.show_materials){
@@ -213,7 +536,93 @@ pub const ResourceManager = struct {
             std.debug.print("[RS]: Creating Texture: \"{s}\"\n", .{path});
         }
 
-        return try self.textures.createResource(path, Texture.createFromFile, .{path});
+        const hash = if (self.textures.handleOf(path) == null) try self.fileContentHash(path) else null;
+        return try self.textures.createHashedResource(path, hash, Texture.createFromFile, .{path});
+    }
+
+    /// Return a placeholder Texture at once and load `path` into it in the background, or return existing
+    /// The image shows up once uploadTextures picks it up, loads synchronously without enableAsyncTextures
+    pub fn createTextureAsync(self: *ResourceManager, path: []const u8) !*Texture {
+        const loader = if (self.texture_loader) |*active| active else return self.createTexture(path);
+
+        if (self.debug_config.show_res_creation and self.debug_config.show_textures){
+            std.debug.print("[RS]: Creating Texture Async: \"{s}\"\n", .{path});
+        }
+
+        const exists = self.textures.handleOf(path) != null;
+        const texture = try self.textures.createResource(path, Texture.createPlaceholder, .{});
+        if (!exists) {
+            errdefer self.textures.releaseResource(path) catch {};
+            try loader.load(texture, path);
+        }
+        return texture;
+    }
+
+    /// Decode `path` on a worker into a Texture named `path`, completed by updateBackgroundLoads
+    /// Unlike createTextureAsync there is no placeholder, the resource exists once the load completes
+    pub fn loadTextureInBackground(self: *ResourceManager, path: []const u8, options: LoadOptions) !void {
+        const loader = if (self.resource_loader) |*active| active else {
+            const result: resource_loader.LoadResult = if (self.createTexture(path)) |texture| .{ .texture = texture } else |e| .{ .failed = e };
+            options.complete(path, result);
+            return;
+        };
+
+        if (self.debug_config.show_res_creation and self.debug_config.show_textures){
+            std.debug.print("[RS]: Queueing Texture: \"{s}\"\n", .{path});
+        }
+        try loader.loadTexture(path, options);
+    }
+
+    /// Create the compressed Texture stored as `name` in `archive`, or return existing
+    pub fn createTextureFromArchive(self: *ResourceManager, archive: *const AssetArchive, name: []const u8) !*Texture {
+        if (self.debug_config.show_res_creation and self.debug_config.show_textures){
+            std.debug.print("[RS]: Creating Archived Texture: \"{s}\"\n", .{name});
+        }
+
+        return try self.textures.createResource(name, AssetArchive.createTexture, .{archive, name});
+    }
+
+    /// Keep the levels of textures from createStreamedTexture within `budget_bytes` of video memory
+    pub fn enableTextureStreaming(self: *ResourceManager, budget_bytes: usize) void {
+        if (self.texture_streamer) |*streamer| {
+            streamer.budget_bytes = budget_bytes;
+            return;
+        }
+        self.texture_streamer = TextureStreamer.init(self.allocator, budget_bytes);
+    }
+
+    /// Load `path` with only its coarse mips resident, or return existing
+    /// Finer levels arrive through updateTextureStreaming, loads fully without enableTextureStreaming
+    pub fn createStreamedTexture(self: *ResourceManager, path: []const u8) !*Texture {
+        const streamer = if (self.texture_streamer) |*active| active else return self.createTexture(path);
+
+        if (self.debug_config.show_res_creation and self.debug_config.show_textures){
+            std.debug.print("[RS]: Creating Streamed Texture: \"{s}\"\n", .{path});
+        }
+
+        return try self.textures.createResource(path, TextureStreamer.createTexture, .{ streamer, path });
+    }
+
+    /// The streamer draws report their texture usage to, e.g. RenderSystem.texture_streamer
+    pub fn textureStreamer(self: *ResourceManager) ?*TextureStreamer {
+        return if (self.texture_streamer) |*streamer| streamer else null;
+    }
+
+    /// Move streamed textures towards the levels requested since the last call, once per frame
+    pub fn updateTextureStreaming(self: *ResourceManager) !void {
+        if (self.texture_streamer) |*streamer| try streamer.update();
+    }
+
+    /// Residency after the last updateTextureStreaming, all zero without streaming
+    pub fn streamingStats(self: *const ResourceManager) StreamingStats {
+        return if (self.texture_streamer) |streamer| streamer.getStats() else .{};
+    }
+
+    /// Upload textures decoded since the last call, spending about `budget_ns` nanoseconds
+    /// Call once per frame, returns the number of textures that received their image
+    pub fn uploadTextures(self: *ResourceManager, budget_ns: u64) usize {
+        const loader = if (self.texture_loader) |*active| active else return 0;
+        return loader.uploadFinished(budget_ns);
     }
 
     /// Create a Texture with a generated name
@@ -225,7 +634,8 @@ pub const ResourceManager = struct {
             std.debug.print("[RS]: AutoGenerate Texture: \"{s}\"\n", .{name});
         }
 
-        return try self.textures.createResource(name, Texture.createFromFile, .{path});
+        const hash = try self.fileContentHash(path);
+        return try self.textures.createHashedResource(name, hash, Texture.createFromFile, .{path});
     }
 
     /// Release a reference to a Texture
@@ -245,6 +655,13 @@ pub const ResourceManager = struct {
             std.debug.print("[RS]: Create Shader: \"{s}\"\n", .{name});
         }
 
+        const cache: ?*ProgramCache = if (self.program_cache) |*active| active else null;
+        if (self.defer_shader_compiles) {
+            return try self.shaders.createResource(name, Shader.createDeferred, .{cache, vertex_source, fragment_source});
+        }
+        if (cache) |active| {
+            return try self.shaders.createResource(name, Shader.createCached, .{active, vertex_source, fragment_source});
+        }
         return try self.shaders.createResource(name, Shader.create, .{vertex_source, fragment_source});
     }
 
@@ -257,9 +674,87 @@ pub const ResourceManager = struct {
             std.debug.print("[RS]: AutoGenerate Shader: \"{s}\"\n", .{name});
         }
 
+        const cache: ?*ProgramCache = if (self.program_cache) |*active| active else null;
+        if (self.defer_shader_compiles) {
+            return try self.shaders.createResource(name, Shader.createDeferred, .{cache, vertex_source, fragment_source});
+        }
+        if (cache) |active| {
+            return try self.shaders.createResource(name, Shader.createCached, .{active, vertex_source, fragment_source});
+        }
         return try self.shaders.createResource(name, Shader.create, .{vertex_source, fragment_source});
     }
 
+    /// Only submit the compiles of createShader and autoCreateShader until finishShaderBatch
+    /// so the driver can build the whole set in parallel, each shader is checked on first use
+    pub fn beginShaderBatch(self: *ResourceManager) void {
+        self.defer_shader_compiles = true;
+    }
+
+    /// Stop deferring and resolve every shader still compiling, returns the first link error
+    /// after all of them were waited on
+    pub fn finishShaderBatch(self: *ResourceManager) !void {
+        self.defer_shader_compiles = false;
+
+        var first_error: ?anyerror = null;
+        self.shaders.lock.lockShared();
+        defer self.shaders.lock.unlockShared();
+        for (self.shaders.slots.items) |slot| {
+            const shader = slot.resource orelse continue;
+            shader.resolve() catch |resolve_err| {
+                if (first_error == null) first_error = resolve_err;
+            };
+        }
+        if (first_error) |resolve_err| return resolve_err;
+    }
+
+    /// Create a Shader from two source files, or return existing
+    /// After enableShaderHotReload edits to either file are picked up by updateShaderReload
+    pub fn createShaderFromFiles(self: *ResourceManager, name: []const u8, vertex_path: []const u8, fragment_path: []const u8) !*Shader {
+        if (self.debug_config.show_res_creation and self.debug_config.show_shaders){
+            std.debug.print("[RS]: Create Shader: \"{s}\" from \"{s}\", \"{s}\"\n", .{name, vertex_path, fragment_path});
+        }
+
+        const existed = self.shaders.getResource(name) != null;
+        const shader = try self.shaders.createResource(name, Shader.createFromFiles, .{vertex_path, fragment_path});
+        if (!existed) {
+            if (self.shader_reloader) |*reloader| try reloader.watch(shader, vertex_path, fragment_path);
+        }
+        return shader;
+    }
+
+    /// Watch the files of shaders created by createShaderFromFiles from now on
+    /// The reloader lives inside the manager, which must not move while it runs
+    pub fn enableShaderHotReload(self: *ResourceManager) !void {
+        if (self.shader_reloader != null) return;
+        self.shader_reloader = ShaderReloader.init(self.allocator);
+        errdefer {
+            self.shader_reloader.?.deinit();
+            self.shader_reloader = null;
+        }
+        try self.shader_reloader.?.start(ShaderReloader.default_poll_interval_ms);
+    }
+
+    /// Compile edited shaders and swap in the ones that finished linking, once per frame
+    /// Returns the number of shaders that got a new program
+    pub fn updateShaderReload(self: *ResourceManager) usize {
+        const reloader = if (self.shader_reloader) |*active| active else return 0;
+        return reloader.update();
+    }
+
+    /// Variant of the built-in shader with `features`, compiled on first use and owned by the manager
+    pub fn shaderVariant(self: *ResourceManager, features: ShaderFeatures) !*Shader {
+        if (self.debug_config.show_res_creation and self.debug_config.show_shaders and self.shader_variants.variants[features.index()] == null){
+            std.debug.print("[RS]: Compile Shader Variant: {b:0>3}\n", .{features.index()});
+        }
+
+        return self.shader_variants.get(features);
+    }
+
+    /// Compile the listed variants now with their compiles overlapping, e.g. during startup
+    pub fn precompileShaderVariants(self: *ResourceManager, features: []const ShaderFeatures) !void {
+        try self.shader_variants.precompile(features);
+    }
+
     pub fn createColorShader(self: *ResourceManager, name: []const u8) !*Shader {
         if (self.debug_config.show_res_creation and self.debug_config.show_shaders){
             std.debug.print("[RS]: Create Shader: \"{s}\"\n", .{name});
@@ -287,6 +782,23 @@ pub const ResourceManager = struct {
 
 
 
+    /// Handle of a resource created under `name`, look it up once at load time and keep the handle
+    pub fn handleOf(self: *ResourceManager, comptime T: type, name: []const u8) ?Handle(T) {
+        return self.collection(T).handleOf(name);
+    }
+
+    /// Resource behind `handle`, null when it was released since
+    pub fn get(self: *ResourceManager, comptime T: type, handle: Handle(T)) ?*T {
+        return self.collection(T).get(handle);
+    }
+
+    /// Release a reference through a handle, ResourceError.StaleHandle if it is already gone
+    pub fn releaseHandle(self: *ResourceManager, comptime T: type, handle: Handle(T)) !void {
+        return self.collection(T).releaseHandle(handle);
+    }
+
+
+
     /// Clean up all resources and print debug info about remaining resources
     pub fn releaseAll(self: *ResourceManager) !void {
         
@@ -305,6 +817,7 @@ pub const ResourceManager = struct {
             if (self.debug_config.show_textures) self.printRefCounts(.Texture, try self.textures.collectRefInfo());
             if (self.debug_config.show_shaders) self.printRefCounts(.Shader, try self.shaders.collectRefInfo());
         }
+        if (self.debug_config.enabled and self.debug_config.show_cache_stats) self.printCacheStats();
         
         // IMPORTANT: We release resources in REVERSE order of dependencies:
         // 1. Models (depend on Materials and Meshes)
@@ -313,12 +826,29 @@ pub const ResourceManager = struct {
         // 4. Textures (no dependencies)
         // 5. Shaders (no dependencies)
         
-        // Clean up resources in order of dependencies
+        // Pending loads and the streamer hold texture references, drop them first
+        if (self.texture_loader) |*loader| loader.deinit();
+        if (self.resource_loader) |*loader| loader.deinit();
+        if (self.texture_streamer) |*streamer| streamer.deinit();
+        // The reloader holds shader references and its watcher thread reads the watch list
+        if (self.shader_reloader) |*reloader| reloader.deinit();
+        // Materials hold their own references, the variants' ones go with the other shaders
+        self.shader_variants.deinit();
+
+        // Clean up resources in order of dependencies, their GL objects go in a few calls at the end
+        var deletions = DeletionBatch.init(self.allocator);
+        defer deletions.deinit();
+        deletions.begin();
         total_models = self.models.releaseAll();
         total_materials = self.materials.releaseAll();
         total_meshes = self.meshes.releaseAll();
         total_textures = self.textures.releaseAll();
         total_shaders = self.shaders.releaseAll();
+        deletions.end();
+        // Samplers outlive any single texture, drop them with the last one
+        SamplerCache.shared().deinit();
+        MaterialBuffer.shared().deinit();
+        MipGenerator.shared().deinit();
         
         // Deinit the collections
         self.models.deinit();
@@ -326,6 +856,7 @@ pub const ResourceManager = struct {
         self.meshes.deinit();
         self.textures.deinit();
         self.shaders.deinit();
+        if (self.program_cache) |*cache| cache.deinit();
         
         // Print summary of resource counts if enabled
         if (self.debug_config.enabled and self.debug_config.show_cleanup_summary) {
@@ -349,9 +880,106 @@ pub const ResourceManager = struct {
     // ============================================================
     // Private Helper Functions
     // ============================================================
+
+    fn collection(self: *ResourceManager, comptime T: type) *ResourceCollection(T) {
+        return switch (T) {
+            Model => &self.models,
+            Mesh => &self.meshes,
+            Material => &self.materials,
+            Texture => &self.textures,
+            Shader => &self.shaders,
+            else => @compileError("ResourceManager holds no " ++ @typeName(T)),
+        };
+    }
+
     
 
     /// Print reference count information for a specific type of resource
+    /// Memory per resource type, without allocating
+    pub fn memoryStats(self: *ResourceManager) MemoryStats {
+        return .{
+            .models = self.models.memoryUsage(),
+            .meshes = self.meshes.memoryUsage(),
+            .materials = self.materials.memoryUsage(),
+            .textures = self.textures.memoryUsage(),
+            .shaders = self.shaders.memoryUsage(),
+        };
+    }
+
+    /// Every live resource of `res_type` with its memory, largest first, to find what dominates a budget
+    /// Free the result with freeRefInfo
+    pub fn collectMemoryInfo(self: *ResourceManager, res_type: ResourceType) ![]ResourceRefInfo {
+        const refs = switch (res_type) {
+            .Model => try self.models.collectRefInfo(),
+            .Mesh => try self.meshes.collectRefInfo(),
+            .Material => try self.materials.collectRefInfo(),
+            .Texture => try self.textures.collectRefInfo(),
+            .Shader => try self.shaders.collectRefInfo(),
+        };
+        std.mem.sort(ResourceRefInfo, refs, {}, largerFirst);
+        return refs;
+    }
+
+    pub fn freeRefInfo(self: *ResourceManager, refs: []ResourceRefInfo) void {
+        for (refs) |ref_info| self.allocator.free(ref_info.name);
+        self.allocator.free(refs);
+    }
+
+    /// Print the warm cache counters of every collection with a budget, filtered like the other debug output
+    pub fn printCacheStats(self: *ResourceManager) void {
+        if (self.debug_config.show_models) printCollectionCache(.Model, self.models.cacheStats());
+        if (self.debug_config.show_meshes) printCollectionCache(.Mesh, self.meshes.cacheStats());
+        if (self.debug_config.show_materials) printCollectionCache(.Material, self.materials.cacheStats());
+        if (self.debug_config.show_textures) printCollectionCache(.Texture, self.textures.cacheStats());
+        if (self.debug_config.show_shaders) printCollectionCache(.Shader, self.shaders.cacheStats());
+    }
+
+
+    fn printCollectionCache(res_type: ResourceType, stats: CacheStats) void {
+        if (stats.budget_bytes == 0 and stats.hits + stats.misses == 0) return;
+        std.debug.print("[RS]: {s} cache - Hits: {d}, Misses: {d}, Evictions: {d}, Warm: {d} ({d} of {d} bytes)\n", .{
+            @tagName(res_type), stats.hits, stats.misses, stats.evictions, stats.warm_count, stats.warm_bytes, stats.budget_bytes,
+        });
+    }
+
+
+    /// Variants of a mesh built from the same data, which must not stand in for each other
+    const MeshBuild = enum(u8) { plain, optimized, clustered };
+
+
+    fn meshContentHash(self: *const ResourceManager, build: MeshBuild, data: []const f32, indices: []const u32, package_size: u4) ?u64 {
+        if (!self.content_dedup) return null;
+        var hasher = std.hash.Wyhash.init(@intFromEnum(build));
+        hasher.update(&.{ package_size });
+        hasher.update(std.mem.sliceAsBytes(data));
+        hasher.update(std.mem.asBytes(&data.len));
+        hasher.update(std.mem.sliceAsBytes(indices));
+        return hasher.final();
+    }
+
+
+    /// Hash of the bytes of the file at `path`, read in blocks so nothing is allocated
+    fn fileContentHash(self: *const ResourceManager, path: []const u8) !?u64 {
+        if (!self.content_dedup) return null;
+        const file = try std.fs.cwd().openFile(path, .{});
+        defer file.close();
+
+        var hasher = std.hash.Wyhash.init(0);
+        var block: [64 * 1024]u8 = undefined;
+        while (true) {
+            const read = try file.read(&block);
+            if (read == 0) break;
+            hasher.update(block[0..read]);
+        }
+        return hasher.final();
+    }
+
+
+    fn largerFirst(_: void, a: ResourceRefInfo, b: ResourceRefInfo) bool {
+        return a.gpu_bytes + a.cpu_bytes > b.gpu_bytes + b.cpu_bytes;
+    }
+
+
     fn printRefCounts(self: *ResourceManager, res_type: ResourceType, refs: []ResourceRefInfo) void {
         std.debug.print("\n[RS] {s} Reference Counts Before Cleanup\n", .{@tagName(res_type)});
         
@@ -363,7 +991,7 @@ pub const ResourceManager = struct {
 
         var total_refs: u32 = 0;
         for (refs) |ref_info| {
-            std.debug.print("[RS] {s} - Refs: {d}\n", .{ref_info.name, ref_info.ref_count});
+            std.debug.print("[RS] {s} - Refs: {d}, GPU: {d} bytes, CPU: {d} bytes\n", .{ref_info.name, ref_info.ref_count, ref_info.gpu_bytes, ref_info.cpu_bytes});
             total_refs += ref_info.ref_count;
             self.allocator.free(ref_info.name); // Free the duplicated ID string
         }
@@ -379,14 +1007,61 @@ pub const ResourceManager = struct {
 
 
 /// A generic collection for managing resources of any type with reference counting
+/// Resources live in a slot array addressed by generational handles, names are only looked up
+/// when a resource is created or released by name
+/// Thread safe: loader threads may create, look up and release while the GL thread renders, as far as
+/// the create functions themselves may run on the calling thread
 pub fn ResourceCollection(comptime T: type) type {
     return struct {
         const Self = @This();
-        
-        allocator: std.mem.Allocator,
-        resources: std.StringHashMap(*T),
 
-        next_id: u32 = 1,
+        const no_slot = std.math.maxInt(u32);
+
+        const Slot = struct {
+            /// Null while the slot is free
+            resource: ?*T,
+            generation: u32,
+            /// Owned, also the key in `names`
+            name: []u8,
+            /// Unreferenced and kept in the warm list, the list holds the last reference
+            warm: bool = false,
+            /// Neighbours in the warm list, towards the least and the most recently released
+            warm_prev: u32 = no_slot,
+            warm_next: u32 = no_slot,
+            /// Memory counted against the budget when the resource turned warm
+            warm_size: usize = 0,
+            /// Hash of the content the resource was created from, key in `contents`
+            content_hash: ?u64 = null,
+            /// Further owned names in `names` that found the same content, dropped with the resource
+            aliases: std.ArrayListUnmanaged([]u8) = .{},
+        };
+
+        allocator: std.mem.Allocator,
+        slots: std.ArrayList(Slot),
+        /// Indices of free slots, reused before the array grows
+        free_slots: std.ArrayList(u32),
+        names: std.StringHashMap(u32),
+        /// Slot of every live resource, so release by pointer needs no scan
+        indices: std.AutoHashMap(*T, u32),
+        /// Slot of every resource created with a content hash
+        contents: std.AutoHashMap(u64, u32),
+        /// The resource structs themselves, passed to the create functions as their allocator
+        /// Keeps T objects contiguous, the collection must not move once it holds resources
+        pool: ObjectPool(T),
+
+        next_id: std.atomic.Value(u32) = std.atomic.Value(u32).init(1),
+        /// Guards everything above and the warm list below, shared by lookups and taken whole by changes
+        /// One per collection, so loaders of different resource types never wait on each other
+        lock: std.Thread.RwLock = .{},
+
+        /// Unreferenced resources kept for reuse, least recently released first
+        /// Off while the budget is 0, then the last release destroys at once
+        warm_budget: usize = 0,
+        warm_bytes: usize = 0,
+        warm_count: usize = 0,
+        warm_head: u32 = no_slot,
+        warm_tail: u32 = no_slot,
+        cache_stats: CacheStats = .{},
 
 
         // ============================================================
@@ -396,7 +1071,12 @@ pub fn ResourceCollection(comptime T: type) type {
         pub fn init(allocator: std.mem.Allocator) Self {
             return Self{
                 .allocator = allocator,
-                .resources = std.StringHashMap(*T).init(allocator),
+                .slots = std.ArrayList(Slot).init(allocator),
+                .free_slots = std.ArrayList(u32).init(allocator),
+                .names = std.StringHashMap(u32).init(allocator),
+                .indices = std.AutoHashMap(*T, u32).init(allocator),
+                .contents = std.AutoHashMap(u64, u32).init(allocator),
+                .pool = ObjectPool(T).init(allocator),
             };
         }
 
@@ -409,111 +1089,194 @@ pub fn ResourceCollection(comptime T: type) type {
         /// If the resource already exists, increments its reference count and returns it
         /// Otherwise, creates a new resource using provided create function
         pub fn createResource( self: *Self, name: []const u8, createFunc: anytype, args: anytype ) !*T {
+            return (try self.createShared(name, null, createFunc, args)).resource;
+        }
 
-            // Check if resource already exists
-            if (self.resources.get(name)) |existing| {
-                existing.addRef();
-                return existing;
-            }
-            
-            // Duplicate the name for storage
-            const owned_name = try self.allocator.dupe(u8, name);
-            errdefer self.allocator.free(owned_name);
-            
-            // Create the resource
-            const resource = try @call(.auto, createFunc, .{self.allocator} ++ args);
-            errdefer _ = resource.release();
-            
-            // Add to the hash map
-            try self.resources.put(owned_name, resource);
 
-            return resource;
+        /// Same as createResource, returning the handle to keep instead of the pointer
+        pub fn createHandle(self: *Self, name: []const u8, createFunc: anytype, args: anytype) !Handle(T) {
+            return self.createHashedHandle(name, null, createFunc, args);
+        }
+
+
+        /// Same as createResource, except that a new name whose `content_hash` matches a resource created
+        /// under another name gets a reference to that one instead of creating a copy
+        /// The name stays an alias of the resource until its last reference is gone
+        pub fn createHashedResource(self: *Self, name: []const u8, content_hash: ?u64, createFunc: anytype, args: anytype) !*T {
+            return (try self.createShared(name, content_hash, createFunc, args)).resource;
+        }
+
+
+        pub fn createHashedHandle(self: *Self, name: []const u8, content_hash: ?u64, createFunc: anytype, args: anytype) !Handle(T) {
+            return (try self.createShared(name, content_hash, createFunc, args)).handle;
+        }
+
+
+        /// The resource behind `handle`, null once it was released
+        /// A single array index under a shared lock, the per-frame way to reach a resource
+        pub fn get(self: *Self, handle: Handle(T)) ?*T {
+            self.lock.lockShared();
+            defer self.lock.unlockShared();
+            if (handle.index >= self.slots.items.len) return null;
+            const slot = self.slots.items[handle.index];
+            if (slot.generation != handle.generation or slot.warm) return null;
+            return slot.resource;
+        }
+
+
+        /// Handle of the resource with `name`, for turning names into handles at load time
+        /// Warm resources keep their handle, it works again once createResource brings them back
+        pub fn handleOf(self: *Self, name: []const u8) ?Handle(T) {
+            self.lock.lockShared();
+            defer self.lock.unlockShared();
+            const index = self.names.get(name) orelse return null;
+            return .{ .index = index, .generation = self.slots.items[index].generation };
+        }
+
+
+        /// Release a reference through a handle, a handle whose resource is gone is reported as stale
+        pub fn releaseHandle(self: *Self, handle: Handle(T)) !void {
+            self.lock.lock();
+            defer self.lock.unlock();
+            if (handle.index >= self.slots.items.len) return ResourceError.StaleHandle;
+            const slot = self.slots.items[handle.index];
+            if (slot.generation != handle.generation or slot.warm or slot.resource == null) return ResourceError.StaleHandle;
+            self.releaseSlot(handle.index);
         }
 
 
         /// Release a reference to a resource by name
         /// If the reference count reaches zero, the resource is removed from the collection
         pub fn releaseResource(self: *Self, name: []const u8) !void {
-            const entry = self.resources.getEntry(name) orelse return ResourceError.ResourceNotFound;
-            const resource = entry.value_ptr.*;
-            const prev = resource.release();
-            
-            // If this was the last reference, remove from the hashmap and free the key
-            if (prev == 1) {
-                const key = entry.key_ptr.*;
-                _ = self.resources.remove(name);
-                self.allocator.free(key);
-            }
+            self.lock.lock();
+            defer self.lock.unlock();
+            const index = self.names.get(name) orelse return ResourceError.ResourceNotFound;
+            if (self.slots.items[index].warm) return ResourceError.ResourceNotFound;
+            self.releaseSlot(index);
         }
 
 
         /// Release a reference to a resource by pointer.
-        /// This iterates over the collection to find the matching resource.
         pub fn releaseResourceByPtr(self: *Self, resource_ptr: *T) !void {
-            var found: bool = false;
-            var iter = self.resources.iterator();
-            while (iter.next()) |entry| {
-                if (entry.value_ptr.* == resource_ptr) {
-                    found = true;
-                    const prev = resource_ptr.release();
-                    if (prev == 1) {
-                        // Remove from hashmap and free the key.
-                        const key = entry.key_ptr.*;
-                        _ = self.resources.remove(key);
-                        self.allocator.free(key);
-                    }
-                    break;
-                }
-            }
-            if (!found) {
-                return ResourceError.ResourceNotFound;
-            }
+            self.lock.lock();
+            defer self.lock.unlock();
+            const index = self.indices.get(resource_ptr) orelse return ResourceError.ResourceNotFound;
+            if (self.slots.items[index].warm) return ResourceError.ResourceNotFound;
+            self.releaseSlot(index);
         }
 
 
-        /// Get a resource by name (doesn't increment reference count)
+        /// Get a resource by name (doesn't increment reference count), warm resources count as released
         pub fn getResource(self: *Self, name: []const u8) ?*T {
-            return self.resources.get(name);
+            self.lock.lockShared();
+            defer self.lock.unlockShared();
+            const index = self.names.get(name) orelse return null;
+            const slot = self.slots.items[index];
+            return if (slot.warm) null else slot.resource;
+        }
+
+
+        /// Number of live resources, the warm ones not included
+        pub fn count(self: *Self) usize {
+            self.lock.lockShared();
+            defer self.lock.unlockShared();
+            return self.indices.count() - self.warm_count;
         }
-        
+
+
+        /// Keep resources whose last reference is released for reuse, up to `budget_bytes` of them,
+        /// evicting the least recently released beyond it. 0 turns the cache off and empties it
+        /// Sizes are the resource's video and system memory together
+        pub fn setWarmBudget(self: *Self, budget_bytes: usize) void {
+            self.lock.lock();
+            defer self.lock.unlock();
+            self.warm_budget = budget_bytes;
+            self.evictOverBudget();
+        }
+
+
+        /// Count and memory of the resources in the collection, warm ones included
+        pub fn memoryUsage(self: *Self) TypeMemory {
+            self.lock.lockShared();
+            defer self.lock.unlockShared();
+            var usage = TypeMemory{};
+            for (self.slots.items) |slot| {
+                const resource = slot.resource orelse continue;
+                const gpu_bytes = gpuBytes(resource);
+                const cpu_bytes = cpuBytes(resource);
+                usage.count += 1;
+                usage.gpu_bytes += gpu_bytes;
+                usage.cpu_bytes += cpu_bytes;
+                usage.aliases += slot.aliases.items.len;
+                usage.deduplicated_bytes += slot.aliases.items.len * (gpu_bytes + cpu_bytes);
+            }
+            return usage;
+        }
+
+
+        /// Hits, misses and evictions of the warm cache so far
+        pub fn cacheStats(self: *Self) CacheStats {
+            self.lock.lockShared();
+            defer self.lock.unlockShared();
+            var stats = self.cache_stats;
+            stats.warm_count = self.warm_count;
+            stats.warm_bytes = self.warm_bytes;
+            stats.budget_bytes = self.warm_budget;
+            return stats;
+        }
+
 
         /// Collects reference information for all resources in this collection
         pub fn collectRefInfo(self: *Self) ![]ResourceRefInfo {
-            var ref_info_list = try self.allocator.alloc(ResourceRefInfo, self.resources.count());
-
-            // Create a mutable iterator
-            var iter = self.resources.iterator();
+            self.lock.lockShared();
+            defer self.lock.unlockShared();
+            var ref_info_list = try self.allocator.alloc(ResourceRefInfo, self.indices.count() - self.warm_count);
             var i: usize = 0;
 
-            while (iter.next()) |entry| {
-                const resource = entry.value_ptr.*;
-                const name = try self.allocator.dupe(u8, entry.key_ptr.*);
+            for (self.slots.items) |slot| {
+                if (slot.warm) continue;
+                const resource = slot.resource orelse continue;
+                const name = try self.allocator.dupe(u8, slot.name);
                 errdefer self.allocator.free(name);
-                
+
                 ref_info_list[i] = .{
                     .name = name,
                     .ref_count = resource.ref_count.load(.monotonic),
+                    .gpu_bytes = gpuBytes(resource),
+                    .cpu_bytes = cpuBytes(resource),
                 };
-                
+
                 i += 1;
             }
 
             return ref_info_list;
         }
 
-        
+
         /// Releases all resources in this collection
         pub fn releaseAll(self: *Self) usize {
-            var count: usize = 0;
-            var iter = self.resources.iterator();
-            while (iter.next()) |entry| {
-                const resource = entry.value_ptr.*;
-                count += 1;
-                
+            self.lock.lock();
+            defer self.lock.unlock();
+            var released: usize = 0;
+            for (self.slots.items) |*slot| {
+                const resource = slot.resource orelse continue;
+                released += 1;
+
                 _ = resource.release();
-                self.allocator.free(entry.key_ptr.*);
+                self.allocator.free(slot.name);
+                self.freeAliases(slot);
+                slot.resource = null;
+                slot.name = &.{};
+                slot.warm = false;
             }
-            return count;
+            self.names.clearRetainingCapacity();
+            self.indices.clearRetainingCapacity();
+            self.contents.clearRetainingCapacity();
+            self.warm_head = no_slot;
+            self.warm_tail = no_slot;
+            self.warm_count = 0;
+            self.warm_bytes = 0;
+            return released;
         }
 
 
@@ -522,7 +1285,12 @@ pub fn ResourceCollection(comptime T: type) type {
         // ============================================================
 
         pub fn deinit(self: *Self) void {
-            self.resources.deinit();
+            self.slots.deinit();
+            self.free_slots.deinit();
+            self.names.deinit();
+            self.indices.deinit();
+            self.contents.deinit();
+            self.pool.deinit();
         }
 
 
@@ -530,17 +1298,202 @@ pub fn ResourceCollection(comptime T: type) type {
         // Private Helper Functions
         // ============================================================
 
+        /// Drop one reference, freeing the slot and invalidating its handles on the last one
+        /// With a warm budget the last reference moves to the warm list instead
+        fn releaseSlot(self: *Self, index: u32) void {
+            const slot = &self.slots.items[index];
+            if (self.warm_budget > 0 and slot.resource.?.ref_count.load(.monotonic) == 1) {
+                self.linkWarm(index);
+                self.evictOverBudget();
+                return;
+            }
+
+            const prev = slot.resource.?.release();
+            if (prev != 1) return;
+            self.freeSlot(index);
+        }
+
+
+        const Created = struct {
+            handle: Handle(T),
+            resource: *T,
+        };
+
+
+        /// Look up or create under the lock, running createFunc without it
+        /// Two threads creating the same name both build it, the later one drops its copy and takes the first
+        fn createShared(self: *Self, name: []const u8, content_hash: ?u64, createFunc: anytype, args: anytype) !Created {
+            {
+                self.lock.lock();
+                defer self.lock.unlock();
+                if (try self.findLocked(name, content_hash)) |existing| return existing;
+                if (self.warm_budget > 0) self.cache_stats.misses += 1;
+            }
+
+            // Lookups and creates go on meanwhile, the pool allocator locks itself
+            const resource = try @call(.auto, createFunc, .{self.pool.allocator()} ++ args);
+            errdefer _ = resource.release();
+            const owned_name = try self.allocator.dupe(u8, name);
+            errdefer self.allocator.free(owned_name);
+
+            const created = blk: {
+                self.lock.lock();
+                defer self.lock.unlock();
+                break :blk try self.insertLocked(owned_name, content_hash, resource);
+            };
+            if (created.resource != resource) {
+                self.allocator.free(owned_name);
+                _ = resource.release();
+            }
+            return created;
+        }
+
+
+        /// A new reference to the resource named `name` or holding the content of `content_hash`, with an alias
+        /// for `name` in the latter case. Null when there is none
+        fn findLocked(self: *Self, name: []const u8, content_hash: ?u64) !?Created {
+            if (self.names.get(name)) |index| {
+                if (self.slots.items[index].warm) self.cache_stats.hits += 1;
+                self.acquireSlot(index);
+                return self.createdAt(index);
+            }
+
+            const hash = content_hash orelse return null;
+            const index = self.contents.get(hash) orelse return null;
+            const slot = &self.slots.items[index];
+            const alias = try self.allocator.dupe(u8, name);
+            errdefer self.allocator.free(alias);
+            try slot.aliases.append(self.allocator, alias);
+            errdefer _ = slot.aliases.pop();
+            try self.names.put(alias, index);
+            self.acquireSlot(index);
+            return self.createdAt(index);
+        }
+
+
+        /// Store `resource` under `owned_name`, unless another thread stored the name or content first
+        fn insertLocked(self: *Self, owned_name: []u8, content_hash: ?u64, resource: *T) !Created {
+            if (try self.findLocked(owned_name, content_hash)) |existing| return existing;
+
+            try self.slots.ensureUnusedCapacity(1);
+            try self.names.ensureUnusedCapacity(1);
+            try self.indices.ensureUnusedCapacity(1);
+            if (content_hash != null) try self.contents.ensureUnusedCapacity(1);
+
+            const index: u32 = self.free_slots.pop() orelse blk: {
+                self.slots.appendAssumeCapacity(.{ .resource = null, .generation = 1, .name = &.{} });
+                break :blk @intCast(self.slots.items.len - 1);
+            };
+            const slot = &self.slots.items[index];
+            slot.resource = resource;
+            slot.name = owned_name;
+            slot.content_hash = content_hash;
+            self.names.putAssumeCapacity(owned_name, index);
+            self.indices.putAssumeCapacity(resource, index);
+            if (content_hash) |hash| self.contents.putAssumeCapacity(hash, index);
+            return self.createdAt(index);
+        }
+
+
+        fn createdAt(self: *const Self, index: u32) Created {
+            const slot = self.slots.items[index];
+            return .{ .handle = .{ .index = index, .generation = slot.generation }, .resource = slot.resource.? };
+        }
+
+
+        /// Take a reference to the resource in `index`, the warm list's reference becomes the caller's
+        fn acquireSlot(self: *Self, index: u32) void {
+            const slot = &self.slots.items[index];
+            if (slot.warm) {
+                self.unlinkWarm(index);
+            } else {
+                slot.resource.?.addRef();
+            }
+        }
+
+
+        fn freeSlot(self: *Self, index: u32) void {
+            const slot = &self.slots.items[index];
+            _ = self.names.remove(slot.name);
+            _ = self.indices.remove(slot.resource.?);
+            if (slot.content_hash) |hash| _ = self.contents.remove(hash);
+            for (slot.aliases.items) |alias| _ = self.names.remove(alias);
+            self.freeAliases(slot);
+            self.allocator.free(slot.name);
+            slot.resource = null;
+            slot.name = &.{};
+            // Zero is never a live generation, so a zeroed handle is always stale
+            slot.generation +%= 1;
+            if (slot.generation == 0) slot.generation = 1;
+            // Without room the slot is only lost for reuse
+            self.free_slots.append(index) catch {};
+        }
+
+
+        fn freeAliases(self: *Self, slot: *Slot) void {
+            for (slot.aliases.items) |alias| self.allocator.free(alias);
+            slot.aliases.clearAndFree(self.allocator);
+            slot.content_hash = null;
+        }
+
+
+        /// Video memory from the resource's residentBytes, none for types without
+        fn gpuBytes(resource: *const T) usize {
+            if (@hasDecl(T, "residentBytes")) return resource.residentBytes();
+            return 0;
+        }
+
+
+        /// System memory from the resource's cpuBytes, its struct size for types without
+        fn cpuBytes(resource: *const T) usize {
+            if (@hasDecl(T, "cpuBytes")) return resource.cpuBytes();
+            return @sizeOf(T);
+        }
+
+
+        /// Append to the most recently released end
+        fn linkWarm(self: *Self, index: u32) void {
+            const slot = &self.slots.items[index];
+            slot.warm = true;
+            slot.warm_prev = self.warm_tail;
+            slot.warm_next = no_slot;
+            if (self.warm_tail != no_slot) self.slots.items[self.warm_tail].warm_next = index else self.warm_head = index;
+            self.warm_tail = index;
+            self.warm_count += 1;
+            slot.warm_size = gpuBytes(slot.resource.?) + cpuBytes(slot.resource.?);
+            self.warm_bytes += slot.warm_size;
+        }
+
+
+        fn unlinkWarm(self: *Self, index: u32) void {
+            const slot = &self.slots.items[index];
+            if (slot.warm_prev != no_slot) self.slots.items[slot.warm_prev].warm_next = slot.warm_next else self.warm_head = slot.warm_next;
+            if (slot.warm_next != no_slot) self.slots.items[slot.warm_next].warm_prev = slot.warm_prev else self.warm_tail = slot.warm_prev;
+            slot.warm = false;
+            slot.warm_prev = no_slot;
+            slot.warm_next = no_slot;
+            self.warm_count -= 1;
+            self.warm_bytes -= slot.warm_size;
+        }
+
+
+        /// Destroy the least recently released warm resources until the rest fits the budget
+        fn evictOverBudget(self: *Self) void {
+            while (self.warm_bytes > self.warm_budget and self.warm_head != no_slot) {
+                const index = self.warm_head;
+                self.unlinkWarm(index);
+                _ = self.slots.items[index].resource.?.release();
+                self.freeSlot(index);
+                self.cache_stats.evictions += 1;
+            }
+        }
+
+
         /// Generate a unique name for a resource widh a prefix
         pub fn generateUniqueName(self: *Self, prefix: []const u8) ![]const u8 {
 
-            // Allocate the formatted string dynamically
-            const tmp_name = try std.fmt.allocPrint(self.allocator, "{s}{d}", .{ prefix, self.next_id });
-            defer self.allocator.free(tmp_name); // Make sure the temporary allocation is freed.
-
-            // Duplicate the string to get an good sized allocation.
-            const name = try self.allocator.dupe(u8, tmp_name);
-            self.next_id += 1;
-            return name;
+            // allocPrint sizes the string exactly, one allocation that the caller frees
+            return std.fmt.allocPrint(self.allocator, "{s}{d}", .{ prefix, self.next_id.fetchAdd(1, .monotonic) });
         }
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,124 @@
+// graphics/sampler_cache.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+
+
+pub const SamplerFilter = enum(u2) {
+    nearest,
+    bilinear,
+    /// Linear within and between mip levels
+    trilinear,
+};
+
+
+pub const SamplerWrap = enum(u2) {
+    repeat,
+    mirrored_repeat,
+    clamp_to_edge,
+};
+
+
+/// Sampling state of a texture, equal descriptions share one GL sampler object
+pub const SamplerDesc = struct {
+    filter: SamplerFilter = .trilinear,
+    wrap: SamplerWrap = .repeat,
+    /// Maximum anisotropy, 1 disables it, clamped to what the driver supports
+    anisotropy: u8 = 1,
+};
+
+
+/// Sampler objects keyed by SamplerDesc, created on first use and kept until deinit
+/// Textures only store their description, so thousands of them share a handful of samplers
+/// and no texture ever sets filter or wrap parameters of its own
+pub const SamplerCache = struct {
+    const Self = @This();
+
+    pub const max_samplers = 32;
+
+    descs: [max_samplers]SamplerDesc = undefined,
+    samplers: [max_samplers]c.GLuint = undefined,
+    count: usize = 0,
+
+    /// Samplers belong to the GL context, which is per thread like the state cache
+    threadlocal var shared_cache: Self = .{};
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// The cache of the GL context current on this thread
+    pub fn shared() *Self {
+        return &shared_cache;
+    }
+
+
+    /// Sampler object for `desc`, 0 (the texture's own state) when the cache is full or GL fails
+    pub fn get(self: *Self, desc: SamplerDesc) c.GLuint {
+        for (self.descs[0..self.count], self.samplers[0..self.count]) |cached, sampler| {
+            if (std.meta.eql(cached, desc)) return sampler;
+        }
+        if (self.count == max_samplers) return 0;
+
+        const sampler = create(desc);
+        if (sampler == 0) return 0;
+        self.descs[self.count] = desc;
+        self.samplers[self.count] = sampler;
+        self.count += 1;
+        return sampler;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Delete every sampler, textures bound afterwards create them again
+    pub fn deinit(self: *Self) void {
+        for (self.samplers[0..self.count]) |sampler| GLStateCache.current().forgetSampler(sampler);
+        if (self.count > 0) {
+            c.glDeleteSamplers(@intCast(self.count), &self.samplers);
+            err.checkGLError("glDeleteSamplers");
+        }
+        self.count = 0;
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn create(desc: SamplerDesc) c.GLuint {
+        var sampler: c.GLuint = 0;
+        c.glGenSamplers(1, &sampler);
+        if (sampler == 0) return 0;
+
+        const min_filter: c.GLint = switch (desc.filter) {
+            .nearest => c.GL_NEAREST_MIPMAP_NEAREST,
+            .bilinear => c.GL_LINEAR_MIPMAP_NEAREST,
+            .trilinear => c.GL_LINEAR_MIPMAP_LINEAR,
+        };
+        const mag_filter: c.GLint = if (desc.filter == .nearest) c.GL_NEAREST else c.GL_LINEAR;
+        const wrap: c.GLint = switch (desc.wrap) {
+            .repeat => c.GL_REPEAT,
+            .mirrored_repeat => c.GL_MIRRORED_REPEAT,
+            .clamp_to_edge => c.GL_CLAMP_TO_EDGE,
+        };
+
+        c.glSamplerParameteri(sampler, c.GL_TEXTURE_MIN_FILTER, min_filter);
+        c.glSamplerParameteri(sampler, c.GL_TEXTURE_MAG_FILTER, mag_filter);
+        c.glSamplerParameteri(sampler, c.GL_TEXTURE_WRAP_S, wrap);
+        c.glSamplerParameteri(sampler, c.GL_TEXTURE_WRAP_T, wrap);
+
+        if (desc.anisotropy > 1 and gl_ext.max_anisotropy > 1.0) {
+            const anisotropy = @min(@as(f32, @floatFromInt(desc.anisotropy)), gl_ext.max_anisotropy);
+            c.glSamplerParameterf(sampler, gl_ext.GL_TEXTURE_MAX_ANISOTROPY, anisotropy);
+        }
+
+        err.checkGLError("SamplerCache: glSamplerParameteri");
+        return sampler;
+    }
+};
@@ -2,23 +2,140 @@
 const std = @import("std");
 const c = @import("../bindings/c.zig");
 const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const DeletionBatch = @import("gl_state.zig").DeletionBatch;
+const ProgramCache = @import("program_cache.zig").ProgramCache;
+const render_stats = @import("render_stats.zig");
+const material_buffer = @import("material_buffer.zig");
+const material_block_glsl = material_buffer.material_block_glsl;
+const transparency_glsl = @import("transparency.zig").transparency_glsl;
 
 
 const Vec4f = @import("../math/vector.zig").Vec4f;
+const Mat3f = @import("../math/matrix.zig").Mat3f;
 const Mat4f = @import("../math/matrix.zig").Mat4f;
 
 // We need StringHashMap for uniform caching
 const StringHashMap = std.StringHashMap;
 
+
+/// Uniform block binding of the per-frame camera data written by Renderer.setCamera
+pub const camera_block_binding = 0;
+
+/// Views a multi-view pass draws at once, the length of viewProjections in the camera block
+pub const max_views = 4;
+
+/// std140 declaration of the camera block, shaders that include it get it bound automatically
+pub const camera_block_glsl =
+    \\layout (std140) uniform CameraBlock {
+    \\    mat4 view;
+    \\    mat4 projection;
+    \\    mat4 viewProjection;
+    \\    vec4 cameraPosition;
+    \\    mat4 viewProjections[4];
+    \\};
+    \\
+;
+
+/// Instanced stereo for Renderer.drawQueueViews, needs camera_block_glsl and the instanced path
+/// Every instance is drawn once per view, the instance attributes repeat for each. applyMultiview moves
+/// gl_Position into the column of the view, and clips it at the column edges, when `viewCount` is above one
+/// Call it after writing gl_Position as usual, single view passes keep that value
+pub const multiview_glsl =
+    \\uniform int viewCount;
+    \\void applyMultiview(mat4 world, vec4 position) {
+    \\    gl_ClipDistance[0] = 1.0;
+    \\    gl_ClipDistance[1] = 1.0;
+    \\    if (viewCount <= 1) return;
+    \\    int v = gl_InstanceID % viewCount;
+    \\    float width = 1.0 / float(viewCount);
+    \\    float center = (2.0 * float(v) + 1.0) * width - 1.0;
+    \\    vec4 clip = viewProjections[v] * world * position;
+    \\    clip.x = clip.x * width + center * clip.w;
+    \\    gl_ClipDistance[0] = clip.x - (center - width) * clip.w;
+    \\    gl_ClipDistance[1] = (center + width) * clip.w - clip.x;
+    \\    gl_Position = clip;
+    \\}
+    \\
+;
+
+/// Per-instance world matrix, expanded by instanceModel() from the three affine rows Mesh.setInstanceSource points at
+/// With `trsInstances` set the first two attributes hold a TrsInstance and the matrix is built here instead of on the CPU
+pub const instance_glsl =
+    \\layout (location=3) in vec4 aInstanceRows[3];
+    \\uniform bool trsInstances;
+    \\mat4 instanceModel() {
+    \\    if (trsInstances) {
+    \\        vec4 q = aInstanceRows[1];
+    \\        float s = aInstanceRows[0].w;
+    \\        vec3 q2 = q.xyz * 2.0;
+    \\        vec3 d = q.xyz * q2;
+    \\        float xy = q.x * q2.y, xz = q.x * q2.z, yz = q.y * q2.z;
+    \\        vec3 w = q.w * q2;
+    \\        return mat4(
+    \\            vec4(1.0 - d.y - d.z, xy + w.z, xz - w.y, 0.0) * s,
+    \\            vec4(xy - w.z, 1.0 - d.x - d.z, yz + w.x, 0.0) * s,
+    \\            vec4(xz + w.y, yz - w.x, 1.0 - d.x - d.y, 0.0) * s,
+    \\            vec4(aInstanceRows[0].xyz, 1.0));
+    \\    }
+    \\    return mat4(transpose(mat3x4(aInstanceRows[0], aInstanceRows[1], aInstanceRows[2])));
+    \\}
+    \\
+;
+
+
 pub const Shader = struct {
     program: c.GLuint,
+    /// Every active uniform, filled by reflection when the program is linked, keys are owned
     uniform_cache: std.StringHashMap(UniformInfo),
+    /// Location of every handle, builtins first, -1 when the program has no such uniform
+    locations: std.ArrayList(c.GLint),
+    /// Size of the linked program's binary, the closest measure of its driver memory
+    /// 0 without ARB_get_program_binary
+    gpu_bytes: usize = 0,
 
     ref_count: std.atomic.Value(u32),
     allocator: std.mem.Allocator,
 
-    pub const UniformType = enum { Mat4, Vec4, Texture2D };
-    pub const UniformInfo = struct { location: c.GLint, type: UniformType };
+    /// Link still running for shaders from createDeferred, finished by resolve
+    pending: ?PendingProgram = null,
+    /// Cache resolve stores the binary of the pending program in, under `pending_key`
+    pending_cache: ?*ProgramCache = null,
+    pending_key: u64 = 0,
+
+    pub const UniformType = enum { Float, Int, Bool, Vec2, Vec3, Vec4, Mat3, Mat4, Texture2D, Other };
+    pub const UniformInfo = struct {
+        location: c.GLint,
+        type: UniformType,
+        /// Element count, 1 unless the uniform is an array
+        size: u32,
+        /// Uniform block holding the uniform, null for default block uniforms
+        block_index: ?u32,
+        handle: UniformHandle,
+    };
+
+    /// Index into `locations`, the named values are resolved when the program is linked
+    pub const UniformHandle = enum(u16) {
+        model,
+        view,
+        projection,
+        color,
+        tex_sampler,
+        instanced,
+        trs_instances,
+        material_index,
+        oit_pass,
+        depth_pass,
+        view_count,
+        _,
+    };
+
+    /// GLSL names of the builtin handles, in declaration order
+    const builtin_names = [_][:0]const u8{ "model", "view", "projection", "color", "texSampler", "instanced", "trsInstances", "materialIndex", "oitPass", "depthPass", "viewCount" };
+
+    /// Largest shader source file createFromFiles reads
+    pub const max_source_size = 1 << 20;
 
 
     // ============================================================
@@ -26,61 +143,71 @@ pub const Shader = struct {
     // ============================================================
 
     pub fn create(allocator: std.mem.Allocator, vertex_source: []const u8, fragment_source: []const u8) !*Shader {
-        const vertex_shader = try compileShader(vertex_source, c.GL_VERTEX_SHADER);
-        errdefer c.glDeleteShader(vertex_shader);
-        
-        const fragment_shader = try compileShader(fragment_source, c.GL_FRAGMENT_SHADER);
-        errdefer c.glDeleteShader(fragment_shader);
+        const program = try linkProgram(vertex_source, fragment_source, false);
+        errdefer c.glDeleteProgram(program);
 
-        const program = c.glCreateProgram();
-        if (program == 0) {
-            return error.ShaderProgramCreationFailed;
+        return fromProgram(allocator, program);
+    }
+
+
+    /// Read both stages from files, see ShaderReloader to pick up later edits
+    pub fn createFromFiles(allocator: std.mem.Allocator, vertex_path: []const u8, fragment_path: []const u8) !*Shader {
+        const vertex_source = try std.fs.cwd().readFileAlloc(allocator, vertex_path, max_source_size);
+        defer allocator.free(vertex_source);
+        const fragment_source = try std.fs.cwd().readFileAlloc(allocator, fragment_path, max_source_size);
+        defer allocator.free(fragment_source);
+
+        return create(allocator, vertex_source, fragment_source);
+    }
+
+
+    /// Create a shader through a program binary cache, only compiling from source when no usable binary exists
+    /// A binary the driver rejects, e.g. after a driver update, is replaced by a fresh compile
+    pub fn createCached(allocator: std.mem.Allocator, cache: *ProgramCache, vertex_source: []const u8, fragment_source: []const u8) !*Shader {
+        const key = cache.key(vertex_source, fragment_source);
+
+        if (cache.load(key)) |program| {
+            errdefer c.glDeleteProgram(program);
+            return fromProgram(allocator, program);
         }
+
+        const program = try linkProgram(vertex_source, fragment_source, cache.isSupported());
         errdefer c.glDeleteProgram(program);
 
-        c.glAttachShader(program, vertex_shader);
-        c.glAttachShader(program, fragment_shader);
+        cache.store(key, program) catch |store_err| {
+            std.log.warn("Could not store program binary: {s}", .{@errorName(store_err)});
+        };
 
-        defer {
-            c.glDetachShader(program, vertex_shader);
-            c.glDetachShader(program, fragment_shader);
-            c.glDeleteShader(vertex_shader);
-            c.glDeleteShader(fragment_shader);
-        }
+        return fromProgram(allocator, program);
+    }
 
-        c.glLinkProgram(program);
 
-        var link_status: c.GLint = undefined;
-        c.glGetProgramiv(program, c.GL_LINK_STATUS, &link_status);
-        if (link_status == c.GL_FALSE) {
-            var info_log: [512]u8 = undefined;
-            var length: c.GLsizei = undefined;
-            c.glGetProgramInfoLog(program, 512, &length, &info_log);
-            if (length > 0) {
-                const usize_length: usize = @intCast(length);
-                std.debug.print("[Error] Shader program linking error: {s}\n", .{info_log[0..usize_length]});
+    /// Submit the compile and link and return at once, the status is only checked by resolve
+    /// Submitting a whole shader set before resolving any lets KHR_parallel_shader_compile build them
+    /// side by side. Material.create resolves its shader, anything else must call resolve before use
+    pub fn createDeferred(allocator: std.mem.Allocator, cache: ?*ProgramCache, vertex_source: []const u8, fragment_source: []const u8) !*Shader {
+        var key: u64 = 0;
+        if (cache) |program_cache| {
+            key = program_cache.key(vertex_source, fragment_source);
+            if (program_cache.load(key)) |program| {
+                errdefer c.glDeleteProgram(program);
+                return fromProgram(allocator, program);
             }
-            return error.ShaderProgramLinkFailed;
-        }
-
-        // Add validation
-        c.glValidateProgram(program);
-        var validate_status: c.GLint = undefined;
-        c.glGetProgramiv(program, c.GL_VALIDATE_STATUS, &validate_status);
-        if (validate_status == c.GL_FALSE) {
-            return error.ShaderProgramValidationFailed;
         }
 
         const shader_ptr = try allocator.create(Shader);
-        errdefer allocator.destroy(shader_ptr);
+        const pending = beginProgram(vertex_source, fragment_source, if (cache) |program_cache| program_cache.isSupported() else false);
 
         shader_ptr.* = .{
-            .program = program,
+            .program = pending.program,
             .uniform_cache = std.StringHashMap(UniformInfo).init(allocator),
+            .locations = std.ArrayList(c.GLint).init(allocator),
             .ref_count = std.atomic.Value(u32).init(1),
             .allocator = allocator,
+            .pending = pending,
+            .pending_cache = cache,
+            .pending_key = key,
         };
-
         return shader_ptr;
     }
 
@@ -89,28 +216,45 @@ pub const Shader = struct {
     pub fn createColorShader(allocator: std.mem.Allocator) !*Shader {
 
         // Color Shader (no texture)
-        const color_vert = 
-            \\#version 330 core
+        const color_vert = "#version 330 core\n" ++ camera_block_glsl ++ instance_glsl ++ multiview_glsl ++
             \\layout (location=0) in vec3 aPos;
             \\uniform mat4 model;
-            \\uniform mat4 view;
-            \\uniform mat4 projection;
+            \\uniform bool instanced;
+            \\invariant gl_Position;
             \\void main() {
-            \\    gl_Position = projection * view * model * vec4(aPos, 1.0);
+            \\    mat4 world = instanced ? instanceModel() : model;
+            \\    gl_Position = viewProjection * world * vec4(aPos, 1.0);
+            \\    applyMultiview(world, vec4(aPos, 1.0));
             \\}
         ;
-        const color_frag = 
-            \\#version 330 core
-            \\out vec4 FragColor;
-            \\uniform vec4 color;
-            \\void main() { FragColor = color; }
+        const color_frag = "#version 330 core\n" ++ material_block_glsl ++ transparency_glsl ++
+            \\layout (location = 0) out vec4 FragColor;
+            \\void main() { FragColor = outputColor(materialColor()); }
         ;
-        var color_shader = try Shader.create(allocator, color_vert, color_frag);
-        errdefer _ = color_shader.release(); 
+        // Every uniform it uses is a builtin, resolved by create
+        const color_shader = try Shader.create(allocator, color_vert, color_frag);
+        return color_shader;
+    }
 
-        try color_shader.cacheUniforms(&.{ "model", "view", "projection", "color" });
 
-        return color_shader;
+    /// Position-only shader of the depth prepass, writes nothing but depth
+    /// gl_Position is invariant like in the builtin shaders, so the color pass can test with GL_EQUAL
+    pub fn createDepthShader(allocator: std.mem.Allocator) !*Shader {
+        const depth_vert = "#version 330 core\n" ++ camera_block_glsl ++ instance_glsl ++
+            \\layout (location=0) in vec3 aPos;
+            \\uniform mat4 model;
+            \\uniform bool instanced;
+            \\invariant gl_Position;
+            \\void main() {
+            \\    mat4 world = instanced ? instanceModel() : model;
+            \\    gl_Position = viewProjection * world * vec4(aPos, 1.0);
+            \\}
+        ;
+        const depth_frag =
+            \\#version 330 core
+            \\void main() {}
+        ;
+        return Shader.create(allocator, depth_vert, depth_frag);
     }
 
 
@@ -118,33 +262,95 @@ pub const Shader = struct {
     pub fn createTextureShader(allocator: std.mem.Allocator) !*Shader {
 
         // Textured Shader
-        const txtr_vert = 
-            \\#version 330 core
+        const txtr_vert = "#version 330 core\n" ++ camera_block_glsl ++ instance_glsl ++ multiview_glsl ++
             \\layout (location=0) in vec3 aPos;
             \\layout (location=1) in vec2 aTexCoord;
             \\out vec2 TexCoord;
-            \\uniform mat4 model; uniform mat4 view; uniform mat4 projection;
+            \\uniform mat4 model;
+            \\uniform bool instanced;
+            \\invariant gl_Position;
             \\void main() {
-            \\    gl_Position = projection * view * model * vec4(aPos, 1.0);
+            \\    mat4 world = instanced ? instanceModel() : model;
+            \\    gl_Position = viewProjection * world * vec4(aPos, 1.0);
+            \\    applyMultiview(world, vec4(aPos, 1.0));
             \\    TexCoord = aTexCoord;
             \\}
         ;
-        const txtr_frag = 
-            \\#version 330 core
+        const txtr_frag = "#version 330 core\n" ++ material_block_glsl ++ transparency_glsl ++
             \\in vec2 TexCoord;
-            \\out vec4 FragColor;
-            \\uniform vec4 color;
+            \\layout (location = 0) out vec4 FragColor;
             \\uniform sampler2D texSampler;
             \\void main() {
-            \\    FragColor = texture(texSampler, TexCoord) * color;
+            \\    FragColor = outputColor(texture(texSampler, TexCoord) * materialColor());
             \\}
         ;
-        var textured_shader = try Shader.create(allocator, txtr_vert, txtr_frag);
-        errdefer _ = textured_shader.release(); 
+        const textured_shader = try Shader.create(allocator, txtr_vert, txtr_frag);
+        return textured_shader;
+    }
 
-        try textured_shader.cacheUniforms(&.{ "model", "view", "projection", "color", "texSampler" });
 
-        return textured_shader;
+    /// Wrap a program linked elsewhere, e.g. a finished PendingProgram, takes ownership on success
+    pub fn createFromProgram(allocator: std.mem.Allocator, program: c.GLuint) !*Shader {
+        return fromProgram(allocator, program);
+    }
+
+
+    /// Submit both compiles and the link without waiting on any of them
+    /// With KHR_parallel_shader_compile they run on driver threads, poll PendingProgram.isComplete
+    pub fn beginProgram(vertex_source: []const u8, fragment_source: []const u8, retrievable: bool) PendingProgram {
+        const pending = PendingProgram{
+            .program = c.glCreateProgram(),
+            .vertex = submitShader(vertex_source, c.GL_VERTEX_SHADER),
+            .fragment = submitShader(fragment_source, c.GL_FRAGMENT_SHADER),
+        };
+        if (retrievable) {
+            gl_ext.programParameteri.?(pending.program, gl_ext.GL_PROGRAM_BINARY_RETRIEVABLE_HINT, c.GL_TRUE);
+        }
+        c.glAttachShader(pending.program, pending.vertex);
+        c.glAttachShader(pending.program, pending.fragment);
+        c.glLinkProgram(pending.program);
+        err.checkGLError("Shader.beginProgram: glLinkProgram");
+        return pending;
+    }
+
+
+    /// Compile and link a program without uniform reflection, for engine-internal passes
+    /// The caller owns the returned program
+    pub fn createProgram(vertex_source: []const u8, fragment_source: []const u8) !c.GLuint {
+        return linkProgram(vertex_source, fragment_source, false);
+    }
+
+
+    /// Compile and link a compute-only program, the caller owns the returned program
+    /// Needs ARB_compute_shader, see gl_ext.hasGpuCulling
+    pub fn createComputeProgram(compute_source: []const u8) !c.GLuint {
+        const compute_shader = try compileShader(compute_source, gl_ext.GL_COMPUTE_SHADER);
+        defer c.glDeleteShader(compute_shader);
+
+        const program = c.glCreateProgram();
+        if (program == 0) {
+            return error.ShaderProgramCreationFailed;
+        }
+        errdefer c.glDeleteProgram(program);
+
+        c.glAttachShader(program, compute_shader);
+        defer c.glDetachShader(program, compute_shader);
+        c.glLinkProgram(program);
+
+        var link_status: c.GLint = undefined;
+        c.glGetProgramiv(program, c.GL_LINK_STATUS, &link_status);
+        if (link_status == c.GL_FALSE) {
+            var info_log: [512]u8 = undefined;
+            var length: c.GLsizei = undefined;
+            c.glGetProgramInfoLog(program, 512, &length, &info_log);
+            if (length > 0) {
+                const usize_length: usize = @intCast(length);
+                std.debug.print("[Error] Compute program linking error: {s}\n", .{info_log[0..usize_length]});
+            }
+            return error.ShaderProgramLinkFailed;
+        }
+
+        return program;
     }
 
 
@@ -156,43 +362,181 @@ pub const Shader = struct {
         _ = self.ref_count.fetchAdd(1, .monotonic);
     }
 
-    pub fn cacheUniforms(self: *Shader, names: []const []const u8) !void {
-        for (names) |name| {
-            const t: UniformType = if (std.mem.eql(u8, name, "texSampler")) .Texture2D else .Mat4;
-            try self.cacheUniform(name, t);
+
+    pub fn residentBytes(self: *const Shader) usize {
+        return self.gpu_bytes;
+    }
+
+
+    /// System memory of the shader and its uniform reflection
+    pub fn cpuBytes(self: *const Shader) usize {
+        var total: usize = @sizeOf(Shader) + self.locations.capacity * @sizeOf(c.GLint);
+        total += self.uniform_cache.capacity() * (@sizeOf([]const u8) + @sizeOf(UniformInfo));
+        var keys = self.uniform_cache.keyIterator();
+        while (keys.next()) |key| total += key.len;
+        return total;
+    }
+
+
+    /// Wait for the link of a createDeferred shader, print its logs on failure and reflect its uniforms
+    /// Does nothing for shaders that are already linked
+    pub fn resolve(self: *Shader) !void {
+        const pending = self.pending orelse return;
+        self.pending = null;
+
+        self.program = pending.finish() catch |link_err| {
+            self.program = 0;
+            return link_err;
+        };
+
+        if (self.pending_cache) |cache| {
+            cache.store(self.pending_key, self.program) catch |store_err| {
+                std.log.warn("Could not store program binary: {s}", .{@errorName(store_err)});
+            };
+            self.pending_cache = null;
         }
+
+        bindUniformBlocks(self.program);
+
+        c.glValidateProgram(self.program);
+        var validate_status: c.GLint = undefined;
+        c.glGetProgramiv(self.program, c.GL_VALIDATE_STATUS, &validate_status);
+        if (validate_status == c.GL_FALSE) {
+            return error.ShaderProgramValidationFailed;
+        }
+
+        try self.reflectUniforms();
     }
 
 
+    /// True when resolve would not wait, for polling e.g. behind a loading screen
+    pub fn isReady(self: *const Shader) bool {
+        const pending = self.pending orelse return true;
+        return pending.isComplete();
+    }
+
     /// Sets an integer uniform (for sampler uniforms, etc.)
     pub fn setUniformInt(self: *Shader, name: []const u8, value: i32) !void {
         const uniform = self.uniform_cache.get(name) orelse return error.UniformNotFound;
-        c.glUniform1i(uniform.location, value);
+        self.setInt(uniform.handle, value);
+    }
+
+
+    /// Handle of a uniform declared by the program, look it up once and keep it
+    /// Arrays are found by their bare name, e.g. "lights" for "lights[0]"
+    pub fn getUniformHandle(self: *const Shader, name: []const u8) !UniformHandle {
+        const uniform = self.uniform_cache.get(name) orelse return error.UniformNotFound;
+        return uniform.handle;
+    }
+
+
+    /// Reflected location, type, array size and block of a uniform
+    pub fn getUniformInfo(self: *const Shader, name: []const u8) ?UniformInfo {
+        return self.uniform_cache.get(name);
+    }
+
+
+    /// True when the program declares the uniform behind `handle`
+    pub fn has(self: *const Shader, handle: UniformHandle) bool {
+        std.debug.assert(self.pending == null);
+        return self.locations.items[@intFromEnum(handle)] != -1;
+    }
+
+
+    /// The setters write the program by name where the driver can, so it need not be in use
+    /// On plain 3.3 they write the program in use, which has to be this one
+    pub fn setInt(self: *Shader, handle: UniformHandle, value: i32) void {
+        const location = self.locations.items[@intFromEnum(handle)];
+        if (gl_ext.programUniform1i) |programUniform1i| {
+            programUniform1i(self.program, location, value);
+        } else {
+            c.glUniform1i(location, value);
+        }
         err.checkGLError("glUniform1i");
+        render_stats.countUniformUpload();
     }
 
 
-    pub fn cacheUniform(self: *Shader, name: []const u8, uniform_type: UniformType) !void {
-        const location = c.glGetUniformLocation(self.program, name.ptr);
-        err.checkGLError("glGetUniformLocation"); // Add error check
-        try self.uniform_cache.put(name, .{ .location = location, .type = uniform_type });
+    pub fn setMat3(self: *Shader, handle: UniformHandle, value: *const [9]f32) void {
+        const location = self.locations.items[@intFromEnum(handle)];
+        if (gl_ext.programUniformMatrix3fv) |programUniformMatrix3fv| {
+            programUniformMatrix3fv(self.program, location, 1, c.GL_FALSE, value);
+        } else {
+            c.glUniformMatrix3fv(location, 1, c.GL_FALSE, value);
+        }
+        err.checkGLError("glUniformMatrix3fv");
+        render_stats.countUniformUpload();
+    }
+
+
+    pub fn setMat4(self: *Shader, handle: UniformHandle, value: *const [16]f32) void {
+        const location = self.locations.items[@intFromEnum(handle)];
+        if (gl_ext.programUniformMatrix4fv) |programUniformMatrix4fv| {
+            programUniformMatrix4fv(self.program, location, 1, c.GL_FALSE, value);
+        } else {
+            c.glUniformMatrix4fv(location, 1, c.GL_FALSE, value);
+        }
+        err.checkGLError("glUniformMatrix4fv");
+        render_stats.countUniformUpload();
+    }
+
+
+    pub fn setVec4(self: *Shader, handle: UniformHandle, value: [4]f32) void {
+        const location = self.locations.items[@intFromEnum(handle)];
+        if (gl_ext.programUniform4fv) |programUniform4fv| {
+            programUniform4fv(self.program, location, 1, &value);
+        } else {
+            c.glUniform4fv(location, 1, &value[0]);
+        }
+        err.checkGLError("glUniform4fv");
+        render_stats.countUniformUpload();
     }
 
 
     pub fn setUniformMat4(self: *Shader, name: []const u8, value: *const [16]f32) !void {
         const uniform = self.uniform_cache.get(name) orelse return error.UniformNotFound;
-        c.glUniformMatrix4fv(uniform.location, 1, c.GL_FALSE, value);
-        err.checkGLError("glUniformMatrix4fv"); // Add error check
+        self.setMat4(uniform.handle, value);
+    }
+
+
+    pub fn setUniformMat3(self: *Shader, name: []const u8, value: *const [9]f32) !void {
+        const uniform = self.uniform_cache.get(name) orelse return error.UniformNotFound;
+        self.setMat3(uniform.handle, value);
     }
 
 
     pub fn setUniformVec4(self: *Shader, name: []const u8, value: [4]f32) !void {
         const uniform = self.uniform_cache.get(name) orelse return error.UniformNotFound;
-        c.glUniform4fv(uniform.location, 1, &value[0]);
-        err.checkGLError("glUniform4fv"); // Add error check
+        self.setVec4(uniform.handle, value);
     }
 
     
+    /// Switch to `program`, a successfully linked replacement, and delete the current one
+    /// Builtin handles stay valid, handles of other uniforms have to be looked up again
+    pub fn replaceProgram(self: *Shader, program: c.GLuint) !void {
+        bindUniformBlocks(program);
+
+        var fresh = Shader{
+            .program = program,
+            .uniform_cache = std.StringHashMap(UniformInfo).init(self.allocator),
+            .locations = std.ArrayList(c.GLint).init(self.allocator),
+            .ref_count = std.atomic.Value(u32).init(1),
+            .allocator = self.allocator,
+        };
+        errdefer fresh.deinitUniforms();
+        try fresh.reflectUniforms();
+
+        GLStateCache.current().forgetProgram(self.program);
+        c.glDeleteProgram(self.program);
+        err.checkGLError("Shader.replaceProgram: glDeleteProgram");
+        self.deinitUniforms();
+
+        self.program = program;
+        self.uniform_cache = fresh.uniform_cache;
+        self.locations = fresh.locations;
+    }
+
+
     // ============================================================
     // Public API: Destruction Function
     // ============================================================
@@ -205,10 +549,14 @@ pub const Shader = struct {
             @panic("Double release of Shader detected"); // already freed
 
         } else if (prev == 1) {
-            c.glDeleteProgram(self.program);
-            err.checkGLError("glDeleteProgram");
+            if (self.pending) |pending| {
+                pending.discard();
+            } else {
+                GLStateCache.current().forgetProgram(self.program);
+                DeletionBatch.deleteProgram(self.program);
+            }
 
-            self.uniform_cache.deinit();
+            self.deinitUniforms();
             self.allocator.destroy(self);
         }
         return prev;
@@ -219,6 +567,193 @@ pub const Shader = struct {
     // Private Helper Functions
     // ============================================================
 
+    /// Compile both stages and link them, `retrievable` keeps the binary available for glGetProgramBinary
+    fn linkProgram(vertex_source: []const u8, fragment_source: []const u8, retrievable: bool) !c.GLuint {
+        const vertex_shader = try compileShader(vertex_source, c.GL_VERTEX_SHADER);
+        defer c.glDeleteShader(vertex_shader);
+        
+        const fragment_shader = try compileShader(fragment_source, c.GL_FRAGMENT_SHADER);
+        defer c.glDeleteShader(fragment_shader);
+
+        const program = c.glCreateProgram();
+        if (program == 0) {
+            return error.ShaderProgramCreationFailed;
+        }
+        errdefer c.glDeleteProgram(program);
+
+        if (retrievable) {
+            gl_ext.programParameteri.?(program, gl_ext.GL_PROGRAM_BINARY_RETRIEVABLE_HINT, c.GL_TRUE);
+        }
+
+        c.glAttachShader(program, vertex_shader);
+        c.glAttachShader(program, fragment_shader);
+
+        defer {
+            c.glDetachShader(program, vertex_shader);
+            c.glDetachShader(program, fragment_shader);
+        }
+
+        c.glLinkProgram(program);
+
+        var link_status: c.GLint = undefined;
+        c.glGetProgramiv(program, c.GL_LINK_STATUS, &link_status);
+        if (link_status == c.GL_FALSE) {
+            var info_log: [512]u8 = undefined;
+            var length: c.GLsizei = undefined;
+            c.glGetProgramInfoLog(program, 512, &length, &info_log);
+            if (length > 0) {
+                const usize_length: usize = @intCast(length);
+                std.debug.print("[Error] Shader program linking error: {s}\n", .{info_log[0..usize_length]});
+            }
+            return error.ShaderProgramLinkFailed;
+        }
+
+        return program;
+    }
+
+
+    /// Wrap a linked program, takes ownership of `program` on success
+    fn fromProgram(allocator: std.mem.Allocator, program: c.GLuint) !*Shader {
+        bindUniformBlocks(program);
+
+        // Add validation
+        c.glValidateProgram(program);
+        var validate_status: c.GLint = undefined;
+        c.glGetProgramiv(program, c.GL_VALIDATE_STATUS, &validate_status);
+        if (validate_status == c.GL_FALSE) {
+            return error.ShaderProgramValidationFailed;
+        }
+
+        const shader_ptr = try allocator.create(Shader);
+        errdefer allocator.destroy(shader_ptr);
+
+        shader_ptr.* = .{
+            .program = program,
+            .uniform_cache = std.StringHashMap(UniformInfo).init(allocator),
+            .locations = std.ArrayList(c.GLint).init(allocator),
+            .ref_count = std.atomic.Value(u32).init(1),
+            .allocator = allocator,
+        };
+        errdefer shader_ptr.deinitUniforms();
+
+        try shader_ptr.reflectUniforms();
+
+        return shader_ptr;
+    }
+
+
+    /// Point the camera and material blocks at their shared bindings
+    fn bindUniformBlocks(program: c.GLuint) void {
+        const camera_block = c.glGetUniformBlockIndex(program, "CameraBlock");
+        if (camera_block != c.GL_INVALID_INDEX) {
+            c.glUniformBlockBinding(program, camera_block, camera_block_binding);
+            err.checkGLError("glUniformBlockBinding");
+        }
+        const material_block = c.glGetUniformBlockIndex(program, "MaterialBlock");
+        if (material_block != c.GL_INVALID_INDEX) {
+            c.glUniformBlockBinding(program, material_block, material_buffer.material_block_binding);
+            err.checkGLError("glUniformBlockBinding");
+        }
+    }
+
+
+    /// Introspect every active uniform once, so no lookup after link ever reaches GL
+    fn reflectUniforms(self: *Shader) !void {
+        self.gpu_bytes = 0;
+        if (gl_ext.hasProgramBinary()) {
+            var binary_length: c.GLint = 0;
+            c.glGetProgramiv(self.program, gl_ext.GL_PROGRAM_BINARY_LENGTH, &binary_length);
+            self.gpu_bytes = @intCast(@max(binary_length, 0));
+        }
+
+        // Builtin slots come first and stay -1 unless the program declares them
+        try self.locations.appendNTimes(-1, builtin_names.len);
+
+        var count: c.GLint = 0;
+        var max_length: c.GLint = 0;
+        c.glGetProgramiv(self.program, c.GL_ACTIVE_UNIFORMS, &count);
+        c.glGetProgramiv(self.program, c.GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+        const name_buffer = try self.allocator.alloc(u8, @intCast(@max(max_length, 1)));
+        defer self.allocator.free(name_buffer);
+
+        for (0..@intCast(count)) |i| {
+            const index: c.GLuint = @intCast(i);
+
+            var length: c.GLsizei = 0;
+            var size: c.GLint = 0;
+            var gl_type: c.GLenum = 0;
+            c.glGetActiveUniform(self.program, index, @intCast(name_buffer.len), &length, &size, &gl_type, name_buffer.ptr);
+
+            var block_index: c.GLint = -1;
+            c.glGetActiveUniformsiv(self.program, 1, &index, c.GL_UNIFORM_BLOCK_INDEX, &block_index);
+
+            // Block members have no location
+            const full_name = name_buffer[0..@intCast(length)];
+            const location = if (block_index == -1) c.glGetUniformLocation(self.program, full_name.ptr) else -1;
+
+            const bare_name = if (std.mem.endsWith(u8, full_name, "[0]")) full_name[0 .. full_name.len - 3] else full_name;
+            const name = try self.allocator.dupe(u8, bare_name);
+            errdefer self.allocator.free(name);
+
+            const handle: UniformHandle = for (builtin_names, 0..) |builtin, slot| {
+                if (std.mem.eql(u8, builtin, name)) {
+                    self.locations.items[slot] = location;
+                    break @enumFromInt(slot);
+                }
+            } else blk: {
+                try self.locations.append(location);
+                break :blk @enumFromInt(self.locations.items.len - 1);
+            };
+
+            try self.uniform_cache.put(name, .{
+                .location = location,
+                .type = uniformType(gl_type),
+                .size = @intCast(size),
+                .block_index = if (block_index == -1) null else @intCast(block_index),
+                .handle = handle,
+            });
+        }
+        err.checkGLError("reflectUniforms");
+    }
+
+
+    fn deinitUniforms(self: *Shader) void {
+        var names = self.uniform_cache.keyIterator();
+        while (names.next()) |name| self.allocator.free(name.*);
+
+        self.uniform_cache.deinit();
+        self.locations.deinit();
+    }
+
+
+    fn uniformType(gl_type: c.GLenum) UniformType {
+        return switch (gl_type) {
+            c.GL_FLOAT => .Float,
+            c.GL_INT => .Int,
+            c.GL_BOOL => .Bool,
+            c.GL_FLOAT_VEC2 => .Vec2,
+            c.GL_FLOAT_VEC3 => .Vec3,
+            c.GL_FLOAT_VEC4 => .Vec4,
+            c.GL_FLOAT_MAT3 => .Mat3,
+            c.GL_FLOAT_MAT4 => .Mat4,
+            c.GL_SAMPLER_2D => .Texture2D,
+            else => .Other,
+        };
+    }
+
+
+    /// Queue a compile, its status is only read by PendingProgram.finish
+    fn submitShader(source: []const u8, shader_type: c.GLenum) c.GLuint {
+        const shader = c.glCreateShader(shader_type);
+        const source_ptr: ?[*]const u8 = source.ptr;
+        const source_len: ?*const c.GLint = @ptrCast(&@as(c.GLint, @intCast(source.len)));
+        c.glShaderSource(shader, 1, &source_ptr, source_len);
+        c.glCompileShader(shader);
+        return shader;
+    }
+
+
     // Function for shader compilation
     fn compileShader(source: []const u8, shader_type: c.GLenum) !c.GLuint {
         const shader = c.glCreateShader(shader_type);
@@ -255,4 +790,61 @@ pub const Shader = struct {
 
         return shader;
     }
-};
\ No newline at end of file
+};
+
+
+/// A program from Shader.beginProgram whose compile and link may still be running
+pub const PendingProgram = struct {
+    program: c.GLuint,
+    vertex: c.GLuint,
+    fragment: c.GLuint,
+
+    /// True once the link finished, without parallel compile the link is done by the first query
+    pub fn isComplete(self: PendingProgram) bool {
+        if (!gl_ext.hasParallelShaderCompile()) return true;
+
+        var done: c.GLint = c.GL_FALSE;
+        c.glGetProgramiv(self.program, gl_ext.GL_COMPLETION_STATUS, &done);
+        return done == c.GL_TRUE;
+    }
+
+
+    /// The linked program, owned by the caller. A failed link prints the logs and frees everything
+    pub fn finish(self: PendingProgram) !c.GLuint {
+        var linked: c.GLint = c.GL_FALSE;
+        c.glGetProgramiv(self.program, c.GL_LINK_STATUS, &linked);
+        if (linked == c.GL_FALSE) {
+            printLog(self.vertex, false);
+            printLog(self.fragment, false);
+            printLog(self.program, true);
+            self.discard();
+            return error.ShaderProgramLinkFailed;
+        }
+
+        c.glDetachShader(self.program, self.vertex);
+        c.glDetachShader(self.program, self.fragment);
+        c.glDeleteShader(self.vertex);
+        c.glDeleteShader(self.fragment);
+        return self.program;
+    }
+
+
+    /// Drop the program whether or not it finished
+    pub fn discard(self: PendingProgram) void {
+        c.glDeleteShader(self.vertex);
+        c.glDeleteShader(self.fragment);
+        c.glDeleteProgram(self.program);
+    }
+
+
+    fn printLog(object: c.GLuint, is_program: bool) void {
+        var info_log: [512]u8 = undefined;
+        var length: c.GLsizei = 0;
+        if (is_program) {
+            c.glGetProgramInfoLog(object, info_log.len, &length, &info_log);
+        } else {
+            c.glGetShaderInfoLog(object, info_log.len, &length, &info_log);
+        }
+        if (length > 0) std.debug.print("[Error] Shader program: {s}\n", .{info_log[0..@intCast(length)]});
+    }
+};
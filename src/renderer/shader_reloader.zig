@@ -0,0 +1,198 @@
+// graphics/shader_reloader.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+
+const Shader = @import("shader.zig").Shader;
+const PendingProgram = @import("shader.zig").PendingProgram;
+
+
+/// Recompiles file-backed shaders when their sources change, without stalling the frame
+/// A watcher thread polls the modification times, update starts the compile on the main thread
+/// and swaps the program in once it linked. With KHR_parallel_shader_compile the driver compiles
+/// on its own threads and update only polls GL_COMPLETION_STATUS, otherwise the link finishes
+/// inside the update that started it. A failing edit prints its log and keeps the old program
+pub const ShaderReloader = struct {
+    const Self = @This();
+
+    pub const default_poll_interval_ms = 250;
+
+    const Watch = struct {
+        /// Holds a reference until the reloader is deinitialized
+        shader: *Shader,
+        vertex_path: []u8,
+        fragment_path: []u8,
+        /// Modification times last seen by the watcher thread
+        vertex_mtime: i128,
+        fragment_mtime: i128,
+        /// Set by the watcher thread, taken by update
+        changed: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+        /// Compile in flight, owned until it is swapped in or fails
+        build: ?PendingProgram = null,
+    };
+
+    allocator: std.mem.Allocator,
+    /// The watcher thread walks the list while holding the mutex
+    mutex: std.Thread.Mutex = .{},
+    watches: std.ArrayList(*Watch),
+
+    thread: ?std.Thread = null,
+    running: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+    poll_interval_ms: u64 = default_poll_interval_ms,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator) Self {
+        return .{
+            .allocator = allocator,
+            .watches = std.ArrayList(*Watch).init(allocator),
+        };
+    }
+
+
+    /// Start the watcher thread, the reloader must not move until deinit
+    pub fn start(self: *Self, poll_interval_ms: u64) !void {
+        if (self.thread != null) return;
+        self.poll_interval_ms = poll_interval_ms;
+
+        // Let the driver pick its compiler thread count
+        if (gl_ext.maxShaderCompilerThreads) |maxThreads| maxThreads(0xFFFFFFFF);
+
+        self.running.store(true, .release);
+        self.thread = try std.Thread.spawn(.{}, run, .{self});
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Reload `shader` from these files whenever either changes
+    pub fn watch(self: *Self, shader: *Shader, vertex_path: []const u8, fragment_path: []const u8) !void {
+        const entry = try self.allocator.create(Watch);
+        errdefer self.allocator.destroy(entry);
+        const vertex_copy = try self.allocator.dupe(u8, vertex_path);
+        errdefer self.allocator.free(vertex_copy);
+        const fragment_copy = try self.allocator.dupe(u8, fragment_path);
+        errdefer self.allocator.free(fragment_copy);
+
+        entry.* = .{
+            .shader = shader,
+            .vertex_path = vertex_copy,
+            .fragment_path = fragment_copy,
+            .vertex_mtime = modifiedTime(vertex_path),
+            .fragment_mtime = modifiedTime(fragment_path),
+        };
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        try self.watches.append(entry);
+        shader.addRef();
+    }
+
+
+    /// Start compiles for changed files and swap in the ones that finished, call once per frame
+    /// Returns the number of shaders that got a new program
+    pub fn update(self: *Self) usize {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        var swapped: usize = 0;
+        for (self.watches.items) |entry| {
+            // An edit during a compile restarts it with the newer sources
+            if (entry.changed.swap(false, .acq_rel)) {
+                if (entry.build) |build| build.discard();
+                entry.build = self.startBuild(entry) catch |e| blk: {
+                    std.debug.print("Shader reload of {s} failed: {s}\n", .{ entry.fragment_path, @errorName(e) });
+                    break :blk null;
+                };
+            }
+
+            const build = entry.build orelse continue;
+            if (!build.isComplete()) continue;
+            entry.build = null;
+            if (finishBuild(entry.shader, build)) swapped += 1;
+        }
+        return swapped;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Stop the watcher, drop compiles in flight and release the shader references
+    pub fn deinit(self: *Self) void {
+        if (self.thread) |thread| {
+            self.running.store(false, .release);
+            thread.join();
+            self.thread = null;
+        }
+
+        for (self.watches.items) |entry| {
+            if (entry.build) |build| build.discard();
+            _ = entry.shader.release();
+            self.allocator.free(entry.vertex_path);
+            self.allocator.free(entry.fragment_path);
+            self.allocator.destroy(entry);
+        }
+        self.watches.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Watcher thread, only stats files and flags the watches, GL stays on the main thread
+    fn run(self: *Self) void {
+        while (self.running.load(.acquire)) {
+            std.time.sleep(self.poll_interval_ms * std.time.ns_per_ms);
+
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            for (self.watches.items) |entry| {
+                const vertex_mtime = modifiedTime(entry.vertex_path);
+                const fragment_mtime = modifiedTime(entry.fragment_path);
+                if (vertex_mtime == entry.vertex_mtime and fragment_mtime == entry.fragment_mtime) continue;
+
+                entry.vertex_mtime = vertex_mtime;
+                entry.fragment_mtime = fragment_mtime;
+                entry.changed.store(true, .release);
+            }
+        }
+    }
+
+
+    /// 0 while the file is missing, e.g. in the middle of an editor's atomic save
+    fn modifiedTime(path: []const u8) i128 {
+        const stat = std.fs.cwd().statFile(path) catch return 0;
+        return stat.mtime;
+    }
+
+
+    /// Queue both compiles and the link without waiting on any of them
+    fn startBuild(self: *Self, entry: *const Watch) !PendingProgram {
+        const vertex_source = try std.fs.cwd().readFileAlloc(self.allocator, entry.vertex_path, Shader.max_source_size);
+        defer self.allocator.free(vertex_source);
+        const fragment_source = try std.fs.cwd().readFileAlloc(self.allocator, entry.fragment_path, Shader.max_source_size);
+        defer self.allocator.free(fragment_source);
+
+        return Shader.beginProgram(vertex_source, fragment_source, false);
+    }
+
+
+    /// Hand a linked program to `shader`, a failed link already printed its logs. Consumes `build`
+    fn finishBuild(shader: *Shader, build: PendingProgram) bool {
+        const program = build.finish() catch return false;
+        shader.replaceProgram(program) catch |e| {
+            std.debug.print("Shader reload could not reflect the new program: {s}\n", .{@errorName(e)});
+            c.glDeleteProgram(program);
+            return false;
+        };
+        return true;
+    }
+};
@@ -0,0 +1,242 @@
+// graphics/shader_variants.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+
+const shader_module = @import("shader.zig");
+const Shader = shader_module.Shader;
+const PendingProgram = shader_module.PendingProgram;
+const camera_block_glsl = shader_module.camera_block_glsl;
+const instance_glsl = shader_module.instance_glsl;
+const ProgramCache = @import("program_cache.zig").ProgramCache;
+const Texture = @import("texture.zig").Texture;
+
+
+/// Vertex attribute locations the SKINNED variants read, four joint indices and their weights
+/// Integer joints need glVertexAttribIPointer, none of the built-in vertex layouts provide them yet
+pub const skin_joints_location = 8;
+pub const skin_weights_location = 9;
+/// Size of the `joints` matrix array of the SKINNED variants
+pub const max_skin_joints = 64;
+
+
+/// Feature keys of a variant, each one a #define in front of the shared source
+/// The bits are the cache index, so a lookup never builds a string
+pub const ShaderFeatures = packed struct(u8) {
+    /// TEXTURED: sample texSampler with the mesh UVs
+    textured: bool = false,
+    /// INSTANCED: declare the per-instance matrix and the `instanced` switch Renderer draws batches with
+    instanced: bool = false,
+    /// SKINNED: blend up to four `joints` matrices per vertex
+    skinned: bool = false,
+    _padding: u5 = 0,
+
+    pub const count = 3;
+    pub const variant_count = 1 << count;
+
+    pub fn index(self: ShaderFeatures) usize {
+        return @as(u8, @bitCast(self));
+    }
+
+
+    /// Variant for a material with or without `texture`, drawable both alone and in instanced batches
+    pub fn forMaterial(texture: ?*Texture) ShaderFeatures {
+        return .{ .textured = texture != null, .instanced = true };
+    }
+};
+
+
+/// Defines of each feature bit, in field order
+const feature_defines = [ShaderFeatures.count][]const u8{
+    "#define TEXTURED 1\n",
+    "#define INSTANCED 1\n",
+    "#define SKINNED 1\n",
+};
+
+
+/// Every permutation of one vertex and fragment source, compiled on first use and kept by feature bits
+/// The sources start after the #version line, which the variants get together with their defines
+pub const ShaderVariants = struct {
+    const Self = @This();
+
+    pub const version_line = "#version 330 core\n";
+
+    /// The source behind createColorShader and createTextureShader, with a skinned path added
+    pub const default_vertex_source = camera_block_glsl ++ instance_glsl ++
+        \\layout (location=0) in vec3 aPos;
+        \\#ifdef TEXTURED
+        \\layout (location=1) in vec2 aTexCoord;
+        \\out vec2 TexCoord;
+        \\#endif
+        \\#ifdef INSTANCED
+        \\uniform bool instanced;
+        \\#endif
+        \\#ifdef SKINNED
+        \\layout (location=8) in uvec4 aJoints;
+        \\layout (location=9) in vec4 aWeights;
+        \\uniform mat4 joints[64];
+        \\#endif
+        \\uniform mat4 model;
+        \\void main() {
+        \\#ifdef INSTANCED
+        \\    mat4 world = instanced ? instanceModel() : model;
+        \\#else
+        \\    mat4 world = model;
+        \\#endif
+        \\#ifdef SKINNED
+        \\    world = world * (aWeights.x * joints[aJoints.x] + aWeights.y * joints[aJoints.y] +
+        \\                     aWeights.z * joints[aJoints.z] + aWeights.w * joints[aJoints.w]);
+        \\#endif
+        \\    gl_Position = viewProjection * world * vec4(aPos, 1.0);
+        \\#ifdef TEXTURED
+        \\    TexCoord = aTexCoord;
+        \\#endif
+        \\}
+    ;
+
+    pub const default_fragment_source =
+        \\out vec4 FragColor;
+        \\uniform vec4 color;
+        \\#ifdef TEXTURED
+        \\in vec2 TexCoord;
+        \\uniform sampler2D texSampler;
+        \\#endif
+        \\void main() {
+        \\#ifdef TEXTURED
+        \\    FragColor = texture(texSampler, TexCoord) * color;
+        \\#else
+        \\    FragColor = color;
+        \\#endif
+        \\}
+    ;
+
+    allocator: std.mem.Allocator,
+    /// Borrowed, must outlive the variants
+    vertex_source: []const u8,
+    fragment_source: []const u8,
+    /// Binary cache the variants are loaded from and stored to, if any
+    program_cache: ?*ProgramCache = null,
+
+    /// One reference each, released by deinit
+    variants: [ShaderFeatures.variant_count]?*Shader = [_]?*Shader{null} ** ShaderFeatures.variant_count,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, vertex_source: []const u8, fragment_source: []const u8) Self {
+        return .{
+            .allocator = allocator,
+            .vertex_source = vertex_source,
+            .fragment_source = fragment_source,
+        };
+    }
+
+
+    /// Variants of the built-in color and texture shaders
+    pub fn initDefault(allocator: std.mem.Allocator) Self {
+        return init(allocator, default_vertex_source, default_fragment_source);
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// The variant with `features`, compiled now if this is its first use
+    /// The returned shader is borrowed, Material.create takes its own reference
+    pub fn get(self: *Self, features: ShaderFeatures) !*Shader {
+        if (self.variants[features.index()]) |shader| return shader;
+
+        const vertex = try self.expand(self.vertex_source, features);
+        defer self.allocator.free(vertex);
+        const fragment = try self.expand(self.fragment_source, features);
+        defer self.allocator.free(fragment);
+
+        const shader = if (self.program_cache) |cache|
+            try Shader.createCached(self.allocator, cache, vertex, fragment)
+        else
+            try Shader.create(self.allocator, vertex, fragment);
+        self.variants[features.index()] = shader;
+        return shader;
+    }
+
+
+    /// Compile every listed variant up front, e.g. behind a loading screen
+    /// All compiles are submitted before the first is waited on, so with KHR_parallel_shader_compile
+    /// they build side by side on the driver's threads
+    pub fn precompile(self: *Self, features: []const ShaderFeatures) !void {
+        var pending: [ShaderFeatures.variant_count]?PendingProgram = [_]?PendingProgram{null} ** ShaderFeatures.variant_count;
+        var keys: [ShaderFeatures.variant_count]u64 = undefined;
+        defer for (pending) |entry| {
+            if (entry) |program| program.discard();
+        };
+
+        for (features) |feature| {
+            const slot = feature.index();
+            if (self.variants[slot] != null or pending[slot] != null) continue;
+
+            const vertex = try self.expand(self.vertex_source, feature);
+            defer self.allocator.free(vertex);
+            const fragment = try self.expand(self.fragment_source, feature);
+            defer self.allocator.free(fragment);
+
+            if (self.program_cache) |cache| {
+                keys[slot] = cache.key(vertex, fragment);
+                if (cache.load(keys[slot])) |program| {
+                    errdefer c.glDeleteProgram(program);
+                    self.variants[slot] = try Shader.createFromProgram(self.allocator, program);
+                    continue;
+                }
+                pending[slot] = Shader.beginProgram(vertex, fragment, cache.isSupported());
+            } else {
+                pending[slot] = Shader.beginProgram(vertex, fragment, false);
+            }
+        }
+
+        for (&pending, 0..) |*entry, slot| {
+            const build = entry.* orelse continue;
+            entry.* = null;
+
+            const program = try build.finish();
+            errdefer c.glDeleteProgram(program);
+            if (self.program_cache) |cache| {
+                cache.store(keys[slot], program) catch |store_err| {
+                    std.log.warn("Could not store program binary: {s}", .{@errorName(store_err)});
+                };
+            }
+            self.variants[slot] = try Shader.createFromProgram(self.allocator, program);
+        }
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        for (&self.variants) |*variant| {
+            if (variant.*) |shader| _ = shader.release();
+            variant.* = null;
+        }
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// `source` behind the version line and the defines of `features`
+    fn expand(self: *Self, source: []const u8, features: ShaderFeatures) ![]u8 {
+        var text = std.ArrayList(u8).init(self.allocator);
+        errdefer text.deinit();
+
+        try text.appendSlice(version_line);
+        const bits: u8 = @bitCast(features);
+        for (feature_defines, 0..) |define, bit| {
+            if (bits & (@as(u8, 1) << @intCast(bit)) != 0) try text.appendSlice(define);
+        }
+        try text.appendSlice(source);
+        return text.toOwnedSlice();
+    }
+};
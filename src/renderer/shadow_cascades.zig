@@ -0,0 +1,371 @@
+// graphics/shadow_cascades.zig - cascaded shadow maps of a directional light
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const Camera = @import("camera.zig").Camera;
+
+const Mat4f = @import("../math/matrix.zig").Mat4f;
+const Vec3f = @import("../math/vector.zig").Vec3f;
+const Frustum = @import("../math/bounds.zig").Frustum;
+
+
+pub const ShadowCascadesError = error{
+    /// A cascade layer framebuffer is incomplete
+    IncompleteFramebuffer,
+};
+
+
+pub const max_cascades = 4;
+
+
+pub const ShadowCascadesConfig = struct {
+    cascade_count: u32 = 4,
+    /// Width and height of every cascade layer
+    resolution: u32 = 2048,
+    /// Split distances from uniform at 0 to logarithmic at 1
+    split_lambda: f32 = 0.75,
+    /// Farthest shadowed distance, the camera far plane when null
+    max_distance: ?f32 = null,
+    /// Frames between re-renders of each cascade, 0 renders only when invalidated or the view leaves it
+    update_intervals: [max_cascades]u32 = .{ 1, 1, 2, 4 },
+    /// Extra radius every cascade is fitted with, a cached cascade stays valid while the view slice stays inside
+    cache_margin: f32 = 0.15,
+    /// How far behind a cascade, toward the light, casters are still drawn into it
+    caster_distance: f32 = 200.0,
+    /// Depth compared against is moved toward the light by this much
+    depth_bias: f32 = 0.0005,
+    /// glPolygonOffset while rendering casters
+    slope_bias: f32 = 2.0,
+    constant_bias: f32 = 4.0,
+};
+
+
+/// One cascade, the matrices are those it was last rendered with
+pub const Cascade = struct {
+    view: Mat4f = Mat4f.identity(),
+    projection: Mat4f = Mat4f.identity(),
+    view_projection: Mat4f = Mat4f.identity(),
+    /// Bounds of the light volume, cull casters against it
+    frustum: Frustum = undefined,
+    /// View-space distance the cascade covers up to
+    split_far: f32 = 0.0,
+    /// Bounding sphere of the rendered light volume, world space
+    center: Vec3f = .{ .x = 0.0, .y = 0.0, .z = 0.0 },
+    radius: f32 = 0.0,
+    frames_since_render: u32 = 0,
+    rendered: bool = false,
+    /// Set by fit when the cascade has to be rendered this frame
+    needs_render: bool = false,
+};
+
+
+/// std140 layout of the ShadowBlock uniform block
+const ShadowBlock = extern struct {
+    matrices: [max_cascades][16]f32,
+    /// split_far of every cascade
+    splits: [4]f32,
+    /// Cascade count, depth bias, texel size, unused
+    params: [4]f32,
+};
+
+
+/// Shadow maps of a directional light, one depth layer per slice of the camera frustum
+/// Each slice is wrapped in a bounding sphere, so a cascade keeps its size while the camera turns, and the
+/// light view is snapped to whole texels so the shadow edges don't shimmer when the camera moves
+/// Distant cascades re-render at their update interval or when the camera slice leaves the cached volume,
+/// call invalidate when static casters move. Between re-renders shading keeps using the last matrices
+///
+/// Per frame: fit, then for every cascade with needs_render set draw the casters between beginCascade and
+/// endCascade, then finish. Shaders prepend `shadow_glsl` and call shadowFactor
+pub const ShadowCascades = struct {
+    const Self = @This();
+
+    /// Uniform block binding of ShadowBlock, after the camera and cluster blocks
+    pub const shadow_block_binding = 2;
+    /// Texture unit the cascades are sampled from, the last one so materials never take it
+    pub const shadow_texture_unit = GLStateCache.max_texture_units - 1;
+
+    /// Cascade selection and 3x3 PCF, world position and positive view depth in
+    pub const shadow_glsl =
+        \\layout (std140) uniform ShadowBlock {
+        \\    mat4 shadowMatrices[4];
+        \\    vec4 shadowSplits;
+        \\    vec4 shadowParams;
+        \\};
+        \\uniform sampler2DArrayShadow shadowMap;
+        \\float shadowFactor(vec3 worldPos, float viewDepth) {
+        \\    int count = int(shadowParams.x);
+        \\    int cascade = 0;
+        \\    for (int i = 0; i < count - 1; i++) {
+        \\        if (viewDepth > shadowSplits[i]) cascade = i + 1;
+        \\    }
+        \\    if (count == 0 || viewDepth > shadowSplits[count - 1]) return 1.0;
+        \\    vec4 p = shadowMatrices[cascade] * vec4(worldPos, 1.0);
+        \\    vec3 uv = p.xyz / p.w * 0.5 + 0.5;
+        \\    if (uv.z > 1.0) return 1.0;
+        \\    float lit = 0.0;
+        \\    for (int x = -1; x <= 1; x++) {
+        \\        for (int y = -1; y <= 1; y++) {
+        \\            vec2 offset = vec2(x, y) * shadowParams.z;
+        \\            lit += texture(shadowMap, vec4(uv.xy + offset, float(cascade), uv.z - shadowParams.y));
+        \\        }
+        \\    }
+        \\    return lit / 9.0;
+        \\}
+        \\
+    ;
+
+    config: ShadowCascadesConfig,
+    cascades: [max_cascades]Cascade = .{Cascade{}} ** max_cascades,
+
+    /// DEPTH_COMPONENT32F array, one layer per cascade, compared on sampling
+    depth_array: c.GLuint = 0,
+    layer_fbos: [max_cascades]c.GLuint = .{0} ** max_cascades,
+    block_buffer: c.GLuint = 0,
+
+    /// Viewport in use before the first beginCascade
+    saved_viewport: ?[4]c.GLint = null,
+    /// Set by invalidate, every cascade renders at the next fit
+    invalidated: bool = true,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(config: ShadowCascadesConfig) !Self {
+        var self = Self{ .config = config };
+        self.config.cascade_count = std.math.clamp(config.cascade_count, 1, max_cascades);
+        errdefer self.deinit();
+
+        const size: c.GLsizei = @intCast(config.resolution);
+        const count: c.GLsizei = @intCast(self.config.cascade_count);
+
+        c.glGenTextures(1, &self.depth_array);
+        GLStateCache.current().bindTexture2DArray(shadow_texture_unit, self.depth_array);
+        c.glTexImage3D(c.GL_TEXTURE_2D_ARRAY, 0, c.GL_DEPTH_COMPONENT32F, size, size, count, 0, c.GL_DEPTH_COMPONENT, c.GL_FLOAT, null);
+        // Linear comparison filtering gives 2x2 PCF on top of the shader taps
+        c.glTexParameteri(c.GL_TEXTURE_2D_ARRAY, c.GL_TEXTURE_MIN_FILTER, c.GL_LINEAR);
+        c.glTexParameteri(c.GL_TEXTURE_2D_ARRAY, c.GL_TEXTURE_MAG_FILTER, c.GL_LINEAR);
+        c.glTexParameteri(c.GL_TEXTURE_2D_ARRAY, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
+        c.glTexParameteri(c.GL_TEXTURE_2D_ARRAY, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
+        c.glTexParameteri(c.GL_TEXTURE_2D_ARRAY, c.GL_TEXTURE_COMPARE_MODE, c.GL_COMPARE_REF_TO_TEXTURE);
+        c.glTexParameteri(c.GL_TEXTURE_2D_ARRAY, c.GL_TEXTURE_COMPARE_FUNC, c.GL_LEQUAL);
+
+        c.glGenFramebuffers(count, &self.layer_fbos);
+        for (self.layer_fbos[0..self.config.cascade_count], 0..) |fbo, layer| {
+            c.glBindFramebuffer(c.GL_FRAMEBUFFER, fbo);
+            c.glFramebufferTextureLayer(c.GL_FRAMEBUFFER, c.GL_DEPTH_ATTACHMENT, self.depth_array, 0, @intCast(layer));
+            c.glDrawBuffer(c.GL_NONE);
+            c.glReadBuffer(c.GL_NONE);
+            if (c.glCheckFramebufferStatus(c.GL_FRAMEBUFFER) != c.GL_FRAMEBUFFER_COMPLETE) {
+                c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+                return ShadowCascadesError.IncompleteFramebuffer;
+            }
+        }
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+
+        c.glGenBuffers(1, &self.block_buffer);
+        c.glBindBuffer(c.GL_UNIFORM_BUFFER, self.block_buffer);
+        c.glBufferData(c.GL_UNIFORM_BUFFER, @sizeOf(ShadowBlock), null, c.GL_DYNAMIC_DRAW);
+        err.checkGLError("ShadowCascades setup");
+
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Fit every cascade to its slice of `camera` for a light shining along `light_direction`
+    /// Sets needs_render on the cascades that are due, the others keep their cached maps
+    pub fn fit(self: *Self, camera: *const Camera, light_direction: Vec3f) void {
+        const count = self.config.cascade_count;
+        const near = camera.near;
+        const far = self.config.max_distance orelse camera.far;
+
+        // Corner rays of the camera frustum, from the near to the far plane
+        const inverse_view_projection = camera.getViewProjectionMatrix().inverse() orelse Mat4f.identity();
+        var near_corners: [4]Vec3f = undefined;
+        var far_corners: [4]Vec3f = undefined;
+        for (0..4) |i| {
+            const x: f32 = if (i & 1 == 0) -1.0 else 1.0;
+            const y: f32 = if (i & 2 == 0) -1.0 else 1.0;
+            near_corners[i] = unproject(&inverse_view_projection, x, y, -1.0);
+            far_corners[i] = unproject(&inverse_view_projection, x, y, 1.0);
+        }
+
+        const forward = light_direction.normalize();
+        var split_near = near;
+        for (self.cascades[0..count], 0..) |*cascade, index| {
+            const split_far = splitDistance(near, far, self.config.split_lambda, index + 1, count);
+            defer split_near = split_far;
+
+            // Bounding sphere of the slice, depth along a corner ray is linear between the planes
+            var corners: [8]Vec3f = undefined;
+            const t_near = (split_near - near) / (camera.far - near);
+            const t_far = (split_far - near) / (camera.far - near);
+            for (0..4) |i| {
+                corners[i] = near_corners[i].lerp(far_corners[i], t_near);
+                corners[i + 4] = near_corners[i].lerp(far_corners[i], t_far);
+            }
+            var center = Vec3f{ .x = 0.0, .y = 0.0, .z = 0.0 };
+            for (corners) |corner| center = center.add(corner);
+            center = center.scale(1.0 / 8.0);
+            var radius: f32 = 0.0;
+            for (corners) |corner| radius = @max(radius, corner.distance(center));
+            // Rounded up, so the texel size only changes on big jumps
+            radius = @ceil(radius * (1.0 + self.config.cache_margin) * 16.0) / 16.0;
+
+            cascade.frames_since_render +|= 1;
+            const interval = self.config.update_intervals[index];
+            const inside = cascade.rendered and center.distance(cascade.center) + radius <= cascade.radius + 1e-3 and
+                radius >= cascade.radius * (1.0 - self.config.cache_margin);
+            const due = interval != 0 and cascade.frames_since_render >= interval;
+            cascade.needs_render = self.invalidated or !inside or due;
+            if (!cascade.needs_render) continue;
+
+            self.fitCascade(cascade, center, radius, forward);
+            cascade.split_far = split_far;
+        }
+        self.invalidated = false;
+    }
+
+
+    /// Render every cascade at the next fit, e.g. after static casters moved
+    pub fn invalidate(self: *Self) void {
+        self.invalidated = true;
+    }
+
+
+    /// Cascades fit set needs_render on, in order
+    pub fn cascadeSlice(self: *Self) []Cascade {
+        return self.cascades[0..self.config.cascade_count];
+    }
+
+
+    /// Draw into cascade `index`, cleared, with the casters' depth pushed away by the slope bias
+    pub fn beginCascade(self: *Self, index: usize) void {
+        const state = GLStateCache.current();
+        if (self.saved_viewport == null) self.saved_viewport = state.viewport;
+
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.layer_fbos[index]);
+        state.setViewport(0, 0, @intCast(self.config.resolution), @intCast(self.config.resolution));
+        state.setDepthMask(true);
+        c.glClear(c.GL_DEPTH_BUFFER_BIT);
+        c.glEnable(c.GL_POLYGON_OFFSET_FILL);
+        c.glPolygonOffset(self.config.slope_bias, self.config.constant_bias);
+    }
+
+
+    pub fn endCascade(self: *Self, index: usize) void {
+        c.glDisable(c.GL_POLYGON_OFFSET_FILL);
+        const cascade = &self.cascades[index];
+        cascade.rendered = true;
+        cascade.needs_render = false;
+        cascade.frames_since_render = 0;
+    }
+
+
+    /// Back to the default framebuffer and the viewport before the cascades, upload the matrices shading uses
+    pub fn finish(self: *Self) void {
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+        if (self.saved_viewport) |viewport| {
+            GLStateCache.current().setViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            self.saved_viewport = null;
+        }
+
+        var block = ShadowBlock{
+            .matrices = undefined,
+            .splits = .{ 0.0, 0.0, 0.0, 0.0 },
+            .params = .{ @floatFromInt(self.config.cascade_count), self.config.depth_bias, 1.0 / @as(f32, @floatFromInt(self.config.resolution)), 0.0 },
+        };
+        for (self.cascades, 0..) |cascade, index| {
+            block.matrices[index] = cascade.view_projection.data;
+            block.splits[index] = cascade.split_far;
+        }
+        GLStateCache.current().bufferSubData(c.GL_UNIFORM_BUFFER, self.block_buffer, 0, std.mem.asBytes(&block));
+    }
+
+
+    /// Bind the cascades and the shadow block for the draws sampling them
+    pub fn bind(self: *const Self) void {
+        const state = GLStateCache.current();
+        state.bindTexture2DArray(shadow_texture_unit, self.depth_array);
+        // Comparison happens with the texture's own parameters
+        state.bindSampler(shadow_texture_unit, 0);
+        c.glBindBufferBase(c.GL_UNIFORM_BUFFER, shadow_block_binding, self.block_buffer);
+    }
+
+
+    /// Point the shadow block and sampler of a shader built on shadow_glsl at their bindings
+    pub fn setupShader(program: c.GLuint) void {
+        const block_index = c.glGetUniformBlockIndex(program, "ShadowBlock");
+        if (block_index != c.GL_INVALID_INDEX) c.glUniformBlockBinding(program, block_index, shadow_block_binding);
+        GLStateCache.current().useProgram(program);
+        c.glUniform1i(c.glGetUniformLocation(program, "shadowMap"), shadow_texture_unit);
+        err.checkGLError("ShadowCascades.setupShader");
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        GLStateCache.current().forgetTexture(self.depth_array);
+        c.glDeleteTextures(1, &self.depth_array);
+        c.glDeleteFramebuffers(max_cascades, &self.layer_fbos);
+        c.glDeleteBuffers(1, &self.block_buffer);
+        err.checkGLError("ShadowCascades cleanup");
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Orthographic light volume around the sphere, its center snapped to whole shadow map texels
+    fn fitCascade(self: *Self, cascade: *Cascade, center: Vec3f, radius: f32, forward: Vec3f) void {
+        const world_up = if (@abs(forward.y) > 0.99) Vec3f{ .x = 0.0, .y = 0.0, .z = 1.0 } else Vec3f{ .x = 0.0, .y = 1.0, .z = 0.0 };
+        const right = forward.cross(world_up).normalize();
+        const up = right.cross(forward);
+
+        const texel = 2.0 * radius / @as(f32, @floatFromInt(self.config.resolution));
+        const snapped_x = @floor(center.dot(right) / texel) * texel;
+        const snapped_y = @floor(center.dot(up) / texel) * texel;
+        const snapped = right.scale(snapped_x).add(up.scale(snapped_y)).add(forward.scale(center.dot(forward)));
+
+        const back = radius + self.config.caster_distance;
+        const eye = snapped.subtract(forward.scale(back));
+        cascade.view = Mat4f.lookAt(eye, snapped, up);
+        cascade.projection = Mat4f.ortho(-radius, radius, -radius, radius, 0.0, back + radius);
+        cascade.view_projection.multiplyInto(&cascade.projection, &cascade.view);
+        cascade.frustum = Frustum.fromMatrix(&cascade.view_projection);
+        cascade.center = center;
+        cascade.radius = radius;
+    }
+
+
+    /// Practical split scheme, a blend of the uniform and logarithmic distances
+    fn splitDistance(near: f32, far: f32, lambda: f32, index: usize, count: u32) f32 {
+        const fraction = @as(f32, @floatFromInt(index)) / @as(f32, @floatFromInt(count));
+        const logarithmic = near * std.math.pow(f32, far / near, fraction);
+        const uniform = near + (far - near) * fraction;
+        return std.math.lerp(uniform, logarithmic, lambda);
+    }
+
+
+    fn unproject(inverse_view_projection: *const Mat4f, x: f32, y: f32, z: f32) Vec3f {
+        const m = &inverse_view_projection.data;
+        const w = m[3] * x + m[7] * y + m[11] * z + m[15];
+        return .{
+            .x = (m[0] * x + m[4] * y + m[8] * z + m[12]) / w,
+            .y = (m[1] * x + m[5] * y + m[9] * z + m[13]) / w,
+            .z = (m[2] * x + m[6] * y + m[10] * z + m[14]) / w,
+        };
+    }
+};
@@ -0,0 +1,163 @@
+// graphics/skinning.zig - joint palettes streamed to vertex shader skinning
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const DynamicBuffer = @import("dynamic_buffer.zig").DynamicBuffer;
+const Shader = @import("shader.zig").Shader;
+const camera_block_glsl = @import("shader.zig").camera_block_glsl;
+const instance_glsl = @import("shader.zig").instance_glsl;
+const mesh = @import("mesh.zig");
+
+const Mat4f = @import("../math/matrix.zig").Mat4f;
+
+
+pub const SkinningError = error{
+    /// A palette has more joints than JointBlock holds
+    TooManyJoints,
+};
+
+
+pub const SkinningConfig = struct {
+    /// Bytes of palettes one frame holds, a palette takes 64 bytes per joint plus alignment
+    bytes_per_frame: usize = 1 << 21,
+};
+
+
+/// Where one uploaded palette lives in the current frame's region
+pub const SkinPalette = struct {
+    offset: usize,
+    joint_count: u32,
+};
+
+
+/// Streams the skinning matrices of every animated mesh into one buffer per frame, each palette bound
+/// as a range of it to JointBlock before its draws, so no skinned draw allocates or respecifies a buffer
+///
+/// Per frame: beginFrame, write one palette per skinned instance, then bind each before drawing it, endFrame
+pub const SkinningBuffer = struct {
+    const Self = @This();
+
+    /// Joints one palette holds, 8 KiB of matrices, half the smallest uniform block GL guarantees
+    pub const max_joints = 128;
+    /// Uniform block binding of JointBlock, after the camera, cluster and shadow blocks
+    pub const joint_block_binding = 3;
+
+    /// JointBlock and the linear blend skinning matrix of a vertex, for vertex shaders to include
+    /// aJoints and aWeights read the SkinVertex stream of Mesh.createSkinned
+    pub const skinning_glsl = std.fmt.comptimePrint(
+        \\layout (std140) uniform JointBlock {{
+        \\    mat4 joints[{d}];
+        \\}};
+        \\layout (location={d}) in uvec4 aJoints;
+        \\layout (location={d}) in vec4 aWeights;
+        \\mat4 skinMatrix() {{
+        \\    return joints[aJoints.x] * aWeights.x + joints[aJoints.y] * aWeights.y +
+        \\           joints[aJoints.z] * aWeights.z + joints[aJoints.w] * aWeights.w;
+        \\}}
+        \\
+    , .{ max_joints, mesh.skin_joints_location, mesh.skin_weights_location });
+
+    const block_bytes = max_joints * @sizeOf(Mat4f);
+
+    palettes: DynamicBuffer,
+    /// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, every palette starts on it
+    alignment: usize,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(config: SkinningConfig) !Self {
+        var alignment: c.GLint = 256;
+        c.glGetIntegerv(c.GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        return .{
+            .palettes = try DynamicBuffer.init(@max(config.bytes_per_frame, block_bytes)),
+            .alignment = @intCast(@max(alignment, 16)),
+        };
+    }
+
+
+    /// Textured shader skinning by the bound palette, with the same instanced and model uniforms as the builtins
+    pub fn createSkinnedShader(allocator: std.mem.Allocator) !*Shader {
+        const skinned_vert = "#version 330 core\n" ++ camera_block_glsl ++ instance_glsl ++ skinning_glsl ++
+            \\layout (location=0) in vec3 aPos;
+            \\layout (location=1) in vec2 aTexCoord;
+            \\out vec2 TexCoord;
+            \\uniform mat4 model;
+            \\uniform bool instanced;
+            \\invariant gl_Position;
+            \\void main() {
+            \\    mat4 world = instanced ? instanceModel() : model;
+            \\    gl_Position = viewProjection * world * skinMatrix() * vec4(aPos, 1.0);
+            \\    TexCoord = aTexCoord;
+            \\}
+        ;
+        const skinned_frag =
+            \\#version 330 core
+            \\in vec2 TexCoord;
+            \\out vec4 FragColor;
+            \\uniform vec4 color;
+            \\uniform sampler2D texSampler;
+            \\void main() {
+            \\    FragColor = texture(texSampler, TexCoord) * color;
+            \\}
+        ;
+        const shader = try Shader.create(allocator, skinned_vert, skinned_frag);
+        setupShader(shader.program);
+        return shader;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Start a frame of palettes, waits until the GPU is done with the region it reuses
+    pub fn beginFrame(self: *Self) void {
+        self.palettes.beginFrame();
+    }
+
+
+    /// Upload one palette of skinning matrices, valid until endFrame
+    pub fn write(self: *Self, matrices: []const Mat4f) !SkinPalette {
+        if (matrices.len > max_joints) return SkinningError.TooManyJoints;
+        const offset = try self.palettes.write(std.mem.sliceAsBytes(matrices), self.alignment);
+        return .{ .offset = offset, .joint_count = @intCast(matrices.len) };
+    }
+
+
+    /// Bind `palette` to JointBlock for the following draws
+    pub fn bind(self: *const Self, palette: SkinPalette) void {
+        // The range covers the whole block where the buffer allows, joints past the palette are never indexed
+        const buffer_bytes = self.palettes.region_size * DynamicBuffer.region_count;
+        const size = @min(block_bytes, buffer_bytes - palette.offset);
+        c.glBindBufferRange(c.GL_UNIFORM_BUFFER, joint_block_binding, self.palettes.buffer, @intCast(palette.offset), @intCast(size));
+        err.checkGLError("SkinningBuffer: glBindBufferRange");
+    }
+
+
+    /// Fence this frame's region, call after the last skinned draw
+    pub fn endFrame(self: *Self) void {
+        self.palettes.endFrame();
+    }
+
+
+    /// Point the JointBlock of a program at its binding, for skinned shaders built elsewhere
+    pub fn setupShader(program: c.GLuint) void {
+        const block_index = c.glGetUniformBlockIndex(program, "JointBlock");
+        if (block_index == c.GL_INVALID_INDEX) return;
+        c.glUniformBlockBinding(program, block_index, joint_block_binding);
+        err.checkGLError("SkinningBuffer: glUniformBlockBinding");
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.palettes.deinit();
+    }
+};
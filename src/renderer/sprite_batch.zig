@@ -0,0 +1,319 @@
+// graphics/sprite_batch.zig - streamed quads for 2D content
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const DynamicBuffer = @import("dynamic_buffer.zig").DynamicBuffer;
+const Shader = @import("shader.zig").Shader;
+const Texture = @import("texture.zig").Texture;
+const UvRect = @import("texture_atlas.zig").UvRect;
+const render_stats = @import("render_stats.zig");
+
+const Mat4f = @import("../math/matrix.zig").Mat4f;
+
+
+pub const SpriteBatchConfig = struct {
+    /// Quads one draw holds, filling up flushes early
+    max_sprites_per_flush: u32 = 16384,
+    /// Quads all flushes of a frame hold together, the size of each streaming region
+    max_sprites_per_frame: u32 = 131072,
+};
+
+
+/// One quad, in the units of the projection passed to begin
+pub const Sprite = struct {
+    position: [2]f32,
+    size: [2]f32,
+    /// Counter-clockwise, in radians, around `origin`
+    rotation: f32 = 0.0,
+    /// Pivot of the rotation and the point at `position`, as a fraction of the size
+    origin: [2]f32 = .{ 0.5, 0.5 },
+    uv: UvRect = .{ .u0 = 0.0, .v0 = 0.0, .u1 = 1.0, .v1 = 1.0 },
+    color: [4]f32 = .{ 1.0, 1.0, 1.0, 1.0 },
+};
+
+
+const SpriteVertex = extern struct {
+    position: [2]f32,
+    uv: [2]f32,
+    /// RGBA8, normalized in the shader
+    color: [4]u8,
+};
+
+
+/// Collects quads on the CPU and streams them through a DynamicBuffer, one draw per run of the same texture
+/// and shader. Sprites keep submission order, so sort by texture or pack them into a TextureAtlas for long runs
+/// Drawing is alpha blended with depth testing and face culling off, end restores both
+///
+/// Per frame: begin with a projection, e.g. Mat4f.ortho over the window, draw every sprite, then end
+pub const SpriteBatch = struct {
+    const Self = @This();
+
+    allocator: std.mem.Allocator,
+    config: SpriteBatchConfig,
+    shader: *Shader,
+    /// Thresholds the alpha of distance field textures instead of multiplying it, see Font
+    distance_field_shader: *Shader,
+    /// Sprites drawn without a texture sample this 1x1 white one, so they show their color only
+    white: *Texture,
+
+    vao: c.GLuint = 0,
+    /// Static quad indices, each flush draws a prefix of them from its own base vertex
+    index_buffer: c.GLuint = 0,
+    vertices: DynamicBuffer,
+    /// Quads since the last flush
+    pending: std.ArrayList(SpriteVertex),
+    texture: ?*Texture = null,
+    /// The pending quads sample a distance field
+    distance_field: bool = false,
+    projection: Mat4f = Mat4f.identity(),
+    drawing: bool = false,
+
+    /// State end puts back
+    saved_depth_test: ?bool = null,
+    saved_cull_face: ?bool = null,
+
+    const vertex_source =
+        \\#version 330 core
+        \\layout (location=0) in vec2 aPos;
+        \\layout (location=1) in vec2 aTexCoord;
+        \\layout (location=2) in vec4 aColor;
+        \\out vec2 TexCoord;
+        \\out vec4 Color;
+        \\uniform mat4 projection;
+        \\void main() {
+        \\    gl_Position = projection * vec4(aPos, 0.0, 1.0);
+        \\    TexCoord = aTexCoord;
+        \\    Color = aColor;
+        \\}
+    ;
+    const fragment_source =
+        \\#version 330 core
+        \\in vec2 TexCoord;
+        \\in vec4 Color;
+        \\out vec4 FragColor;
+        \\uniform sampler2D texSampler;
+        \\void main() {
+        \\    FragColor = texture(texSampler, TexCoord) * Color;
+        \\}
+    ;
+    /// Edge at 0.5, antialiased over about one screen pixel whatever the scale
+    const distance_field_fragment_source =
+        \\#version 330 core
+        \\in vec2 TexCoord;
+        \\in vec4 Color;
+        \\out vec4 FragColor;
+        \\uniform sampler2D texSampler;
+        \\void main() {
+        \\    float distance = texture(texSampler, TexCoord).a;
+        \\    float width = max(fwidth(distance), 1e-4);
+        \\    FragColor = vec4(Color.rgb, Color.a * smoothstep(0.5 - width, 0.5 + width, distance));
+        \\}
+    ;
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(allocator: std.mem.Allocator, config: SpriteBatchConfig) !Self {
+        const shader = try Shader.create(allocator, vertex_source, fragment_source);
+        errdefer _ = shader.release();
+        const distance_field_shader = try Shader.create(allocator, vertex_source, distance_field_fragment_source);
+        errdefer _ = distance_field_shader.release();
+        const white_pixel = [4]u8{ 255, 255, 255, 255 };
+        const white = try Texture.createRGBA(allocator, 1, 1, &white_pixel);
+        errdefer _ = white.release();
+
+        var vertices = try DynamicBuffer.init(@as(usize, config.max_sprites_per_frame) * 4 * @sizeOf(SpriteVertex));
+        errdefer vertices.deinit();
+        var pending = try std.ArrayList(SpriteVertex).initCapacity(allocator, @as(usize, config.max_sprites_per_flush) * 4);
+        errdefer pending.deinit();
+
+        var self = Self{
+            .allocator = allocator,
+            .config = config,
+            .shader = shader,
+            .distance_field_shader = distance_field_shader,
+            .white = white,
+            .vertices = vertices,
+            .pending = pending,
+        };
+
+        // Two triangles per quad, counter-clockwise like the rest of the meshes
+        const indices = try allocator.alloc(u32, @as(usize, config.max_sprites_per_flush) * 6);
+        defer allocator.free(indices);
+        for (0..config.max_sprites_per_flush) |quad| {
+            const first: u32 = @intCast(quad * 4);
+            indices[quad * 6 ..][0..6].* = .{ first, first + 1, first + 2, first + 2, first + 3, first };
+        }
+
+        const state = GLStateCache.current();
+        c.glGenVertexArrays(1, &self.vao);
+        state.bindVertexArray(self.vao);
+        c.glGenBuffers(1, &self.index_buffer);
+        c.glBindBuffer(c.GL_ELEMENT_ARRAY_BUFFER, self.index_buffer);
+        c.glBufferData(c.GL_ELEMENT_ARRAY_BUFFER, @intCast(indices.len * @sizeOf(u32)), indices.ptr, c.GL_STATIC_DRAW);
+
+        state.bindArrayBuffer(self.vertices.buffer);
+        const stride: c.GLsizei = @sizeOf(SpriteVertex);
+        c.glVertexAttribPointer(0, 2, c.GL_FLOAT, c.GL_FALSE, stride, @ptrFromInt(@offsetOf(SpriteVertex, "position")));
+        c.glEnableVertexAttribArray(0);
+        c.glVertexAttribPointer(1, 2, c.GL_FLOAT, c.GL_FALSE, stride, @ptrFromInt(@offsetOf(SpriteVertex, "uv")));
+        c.glEnableVertexAttribArray(1);
+        c.glVertexAttribPointer(2, 4, c.GL_UNSIGNED_BYTE, c.GL_TRUE, stride, @ptrFromInt(@offsetOf(SpriteVertex, "color")));
+        c.glEnableVertexAttribArray(2);
+        err.checkGLError("SpriteBatch setup");
+
+        for ([_]*Shader{ shader, distance_field_shader }) |program| {
+            state.useProgram(program.program);
+            program.setInt(.tex_sampler, 0);
+        }
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Start a frame of sprites drawn through `projection`
+    pub fn begin(self: *Self, projection: *const Mat4f) void {
+        std.debug.assert(!self.drawing);
+        self.vertices.beginFrame();
+        self.projection = projection.*;
+        self.texture = null;
+        self.distance_field = false;
+        self.drawing = true;
+
+        const state = GLStateCache.current();
+        self.saved_depth_test = state.depth_test;
+        self.saved_cull_face = state.cull_face;
+    }
+
+
+    /// Queue one sprite, sampling `texture` or plain white when null
+    /// Fails with OutOfSpace once the frame holds more than max_sprites_per_frame sprites
+    pub fn draw(self: *Self, texture: ?*Texture, sprite: Sprite) !void {
+        try self.queue(texture orelse self.white, false, sprite);
+    }
+
+
+    /// Queue one sprite whose texture holds a distance field in alpha, drawn opaque above 0.5 and
+    /// transparent below with a smooth edge. Color tints it, like for draw
+    pub fn drawDistanceField(self: *Self, texture: *Texture, sprite: Sprite) !void {
+        try self.queue(texture, true, sprite);
+    }
+
+
+    /// Draw what is queued and close the frame, restoring depth testing and culling
+    pub fn end(self: *Self) !void {
+        std.debug.assert(self.drawing);
+        defer self.drawing = false;
+        defer self.vertices.endFrame();
+        try self.flush();
+
+        const state = GLStateCache.current();
+        state.setBlend(.off);
+        if (self.saved_depth_test) |enabled| state.setDepthTest(enabled);
+        if (self.saved_cull_face) |enabled| state.setCullFace(enabled);
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        const state = GLStateCache.current();
+        state.forgetVertexArray(self.vao);
+        c.glDeleteVertexArrays(1, &self.vao);
+        c.glDeleteBuffers(1, &self.index_buffer);
+        err.checkGLError("SpriteBatch cleanup");
+
+        self.vertices.deinit();
+        self.pending.deinit();
+        _ = self.white.release();
+        _ = self.distance_field_shader.release();
+        _ = self.shader.release();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn queue(self: *Self, texture: *Texture, distance_field: bool, sprite: Sprite) !void {
+        std.debug.assert(self.drawing);
+        if (texture != self.texture or distance_field != self.distance_field or
+            self.pending.items.len == @as(usize, self.config.max_sprites_per_flush) * 4)
+        {
+            try self.flush();
+            self.texture = texture;
+            self.distance_field = distance_field;
+        }
+
+        const w = sprite.size[0];
+        const h = sprite.size[1];
+        const left = -sprite.origin[0] * w;
+        const bottom = -sprite.origin[1] * h;
+        const corners = [4][2]f32{ .{ left, bottom }, .{ left + w, bottom }, .{ left + w, bottom + h }, .{ left, bottom + h } };
+        const uvs = [4][2]f32{
+            .{ sprite.uv.u0, sprite.uv.v0 },
+            .{ sprite.uv.u1, sprite.uv.v0 },
+            .{ sprite.uv.u1, sprite.uv.v1 },
+            .{ sprite.uv.u0, sprite.uv.v1 },
+        };
+        const color = packColor(sprite.color);
+        const cos = @cos(sprite.rotation);
+        const sin = @sin(sprite.rotation);
+
+        for (corners, uvs) |corner, uv| {
+            self.pending.appendAssumeCapacity(.{
+                .position = .{
+                    sprite.position[0] + corner[0] * cos - corner[1] * sin,
+                    sprite.position[1] + corner[0] * sin + corner[1] * cos,
+                },
+                .uv = uv,
+                .color = color,
+            });
+        }
+    }
+
+
+    /// One draw of every pending quad with the current texture and shader
+    fn flush(self: *Self) !void {
+        if (self.pending.items.len == 0) return;
+        defer self.pending.clearRetainingCapacity();
+
+        // Regions hold whole vertices and every write is whole vertices, so offsets fall on vertex boundaries
+        const offset = try self.vertices.write(std.mem.sliceAsBytes(self.pending.items), @alignOf(SpriteVertex));
+        std.debug.assert(offset % @sizeOf(SpriteVertex) == 0);
+        const base_vertex = offset / @sizeOf(SpriteVertex);
+        const index_count = self.pending.items.len / 4 * 6;
+
+        const state = GLStateCache.current();
+        const shader = if (self.distance_field) self.distance_field_shader else self.shader;
+        state.useProgram(shader.program);
+        shader.setMat4(.projection, &self.projection.data);
+        state.bindVertexArray(self.vao);
+        self.texture.?.bind(0);
+        state.setDepthTest(false);
+        state.setCullFace(false);
+        state.setBlend(.alpha);
+
+        c.glDrawElementsBaseVertex(c.GL_TRIANGLES, @intCast(index_count), c.GL_UNSIGNED_INT, null, @intCast(base_vertex));
+        err.checkGLError("SpriteBatch: glDrawElementsBaseVertex");
+        render_stats.countDraw(index_count, 1);
+    }
+
+
+    fn packColor(color: [4]f32) [4]u8 {
+        var result: [4]u8 = undefined;
+        for (color, 0..) |channel, i| {
+            result[i] = @intFromFloat(@round(std.math.clamp(channel, 0.0, 1.0) * 255.0));
+        }
+        return result;
+    }
+};
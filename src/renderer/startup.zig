@@ -0,0 +1,240 @@
+// graphics/startup.zig - engine bootstrap overlapping window creation with asset preload
+const std = @import("std");
+
+const window_module = @import("../core/window.zig");
+const Window = window_module.Window;
+const WindowConfig = window_module.WindowConfig;
+const SharedContext = window_module.SharedContext;
+const jobs = @import("../core/jobs.zig");
+const JobSystem = jobs.JobSystem;
+const JobSystemOptions = jobs.JobSystemOptions;
+const AsyncIoConfig = @import("../core/async_io.zig").AsyncIoConfig;
+const resource_manager = @import("resource_manager.zig");
+const ResourceManager = resource_manager.ResourceManager;
+const DebugConfig = resource_manager.DebugConfig;
+const Shader = @import("shader.zig").Shader;
+
+
+/// A shader compiled during startup from two source files, read on a worker while the window opens
+pub const ShaderPreload = struct {
+    name: []const u8,
+    vertex_path: []const u8,
+    fragment_path: []const u8,
+};
+
+
+/// A glTF file imported during startup as the Model `name`
+pub const ModelPreload = struct {
+    name: []const u8,
+    path: []const u8,
+};
+
+
+pub const StartupConfig = struct {
+    window: WindowConfig,
+    jobs: JobSystemOptions = .{},
+    resources: ?DebugConfig = null,
+    /// Texture files decoded on the workers from the first moment, named by their path
+    textures: []const []const u8 = &.{},
+    models: []const ModelPreload = &.{},
+    shaders: []const ShaderPreload = &.{},
+    /// Read the texture files through AsyncIo, many in flight at once
+    async_io: ?AsyncIoConfig = null,
+    /// Upload the preloaded textures from a shared context on a thread of its own
+    upload_context: bool = false,
+    /// Return only once every preload is a resource, otherwise they complete through
+    /// ResourceManager.updateBackgroundLoads in the first frames
+    wait_for_preloads: bool = true,
+};
+
+
+/// Nanoseconds since Startup.create began, each phase ends where the next starts
+pub const StartupTimings = struct {
+    /// Workers started, resource manager created and every preload queued
+    queued_ns: u64 = 0,
+    /// GLFW, window, GL context and loader, while the workers already read and decode
+    window_ns: u64 = 0,
+    /// Shader sources read and their compiles handed to the driver
+    shaders_submitted_ns: u64 = 0,
+    /// Preloads created and every shader linked, the end of Startup.create
+    ready_ns: u64 = 0,
+    /// The first frame swapped, set by frameSubmitted, 0 until then
+    first_frame_ns: u64 = 0,
+};
+
+
+/// Owns the job system, window and resource manager of an application and creates them in an
+/// order that keeps the CPUs busy: the workers start first and read and decode every preloaded
+/// texture, model and shader source while the main thread creates the window and GL context,
+/// which GLFW only allows there. The shaders are then compiled as one batch the driver builds in
+/// parallel, and the decoded assets are uploaded while it does
+pub const Startup = struct {
+    const Self = @This();
+
+    /// Thread safe, used by the workers reading shader sources
+    const worker_allocator = std.heap.page_allocator;
+
+    /// Sources of one ShaderPreload, filled by a worker
+    const ShaderSources = struct {
+        preload: ShaderPreload,
+        vertex: ?[]u8 = null,
+        fragment: ?[]u8 = null,
+        read_error: ?anyerror = null,
+    };
+
+    allocator: std.mem.Allocator,
+    jobs: *JobSystem,
+    window: *Window,
+    resources: *ResourceManager,
+    upload_context: ?SharedContext = null,
+    timings: StartupTimings = .{},
+    start_ns: i128,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Start the workers, queue the preloads, open the window and compile the shaders
+    /// The window's context is current on the calling thread when it returns
+    pub fn create(allocator: std.mem.Allocator, config: StartupConfig) !*Self {
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+        self.* = .{
+            .allocator = allocator,
+            .jobs = undefined,
+            .window = undefined,
+            .resources = undefined,
+            .start_ns = std.time.nanoTimestamp(),
+        };
+
+        self.jobs = try allocator.create(JobSystem);
+        errdefer allocator.destroy(self.jobs);
+        try self.jobs.init(allocator, config.jobs);
+        errdefer self.jobs.deinit();
+
+        const sources = try allocator.alloc(ShaderSources, config.shaders.len);
+        defer allocator.free(sources);
+        for (sources, config.shaders) |*source, preload| source.* = .{ .preload = preload };
+        var source_reads: std.Thread.WaitGroup = .{};
+        defer {
+            // Also on errors, the workers must be done with `sources` before it is freed
+            self.jobs.waitAndWork(&source_reads);
+            for (sources) |source| freeSources(source);
+        }
+        for (sources) |*source| self.jobs.spawnWg(&source_reads, readSources, .{source});
+
+        // Nothing here touches GL, the loader only reads and decodes until it is updated
+        var has_window = false;
+        self.resources = try ResourceManager.create(allocator, config.resources);
+        errdefer if (!has_window) self.resources.releaseAll() catch {};
+        self.resources.enableBackgroundLoading(self.jobs);
+        if (config.async_io) |io_config| try self.resources.enableAsyncIo(io_config);
+        for (config.textures) |path| try self.resources.loadTextureInBackground(path, .{});
+        for (config.models) |model| try self.resources.loadModelInBackground(model.name, model.path, .{});
+        self.timings.queued_ns = self.elapsedNs();
+
+        self.window = try Window.create(allocator, config.window);
+        errdefer self.window.release();
+        self.timings.window_ns = self.elapsedNs();
+
+        // From here on GL objects exist, they go before the window and the upload context after the loader
+        has_window = true;
+        errdefer {
+            self.resources.releaseAll() catch {};
+            if (self.upload_context) |*context| context.destroy();
+        }
+        if (config.upload_context) {
+            self.upload_context = try self.window.createSharedContext();
+            try self.resources.enableUploadContext(&self.upload_context.?);
+        }
+
+        // Submitted all at once, the driver links the batch while the GL thread uploads textures
+        self.resources.beginShaderBatch();
+        self.jobs.waitAndWork(&source_reads);
+        for (sources) |source| {
+            if (source.read_error) |read_error| {
+                std.debug.print("Reading shader {s} failed: {s}\n", .{ source.preload.name, @errorName(read_error) });
+                return read_error;
+            }
+            _ = try self.resources.createShader(source.preload.name, source.vertex.?, source.fragment.?);
+        }
+        self.timings.shaders_submitted_ns = self.elapsedNs();
+
+        if (config.wait_for_preloads) {
+            while (self.resources.resource_loader.?.pendingCount() > 0) {
+                if (self.resources.updateBackgroundLoads(std.math.maxInt(u64)) == 0) std.time.sleep(100 * std.time.ns_per_us);
+            }
+        }
+        try self.resources.finishShaderBatch();
+        self.timings.ready_ns = self.elapsedNs();
+
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Call after each swapBuffers, the first call records the time to first frame
+    pub fn frameSubmitted(self: *Self) void {
+        if (self.timings.first_frame_ns != 0) return;
+        self.timings.first_frame_ns = self.elapsedNs();
+    }
+
+
+    pub fn printTimings(self: *const Self) void {
+        const ms = std.time.ns_per_ms;
+        std.debug.print("[Startup]: queued {d}ms, window {d}ms, shaders submitted {d}ms, ready {d}ms, first frame {d}ms\n", .{
+            self.timings.queued_ns / ms,
+            self.timings.window_ns / ms,
+            self.timings.shaders_submitted_ns / ms,
+            self.timings.ready_ns / ms,
+            self.timings.first_frame_ns / ms,
+        });
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Release the resources, then the window and the workers, on the thread that created them
+    pub fn deinit(self: *Self) void {
+        self.resources.releaseAll() catch {};
+        if (self.upload_context) |*context| context.destroy();
+        self.window.release();
+        self.jobs.deinit();
+        self.allocator.destroy(self.jobs);
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn readSources(source: *ShaderSources) void {
+        const cwd = std.fs.cwd();
+        source.vertex = cwd.readFileAlloc(worker_allocator, source.preload.vertex_path, Shader.max_source_size) catch |read_error| {
+            source.read_error = read_error;
+            return;
+        };
+        source.fragment = cwd.readFileAlloc(worker_allocator, source.preload.fragment_path, Shader.max_source_size) catch |read_error| {
+            source.read_error = read_error;
+            return;
+        };
+    }
+
+
+    fn freeSources(source: ShaderSources) void {
+        if (source.vertex) |bytes| worker_allocator.free(bytes);
+        if (source.fragment) |bytes| worker_allocator.free(bytes);
+    }
+
+
+    fn elapsedNs(self: *const Self) u64 {
+        return @intCast(@max(0, std.time.nanoTimestamp() - self.start_ns));
+    }
+};
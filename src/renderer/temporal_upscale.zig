@@ -0,0 +1,311 @@
+// graphics/temporal_upscale.zig - full resolution frames reconstructed from jittered low resolution ones
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const Shader = @import("shader.zig").Shader;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const RenderTargetError = @import("render_target.zig").RenderTargetError;
+const Renderer = @import("renderer.zig").Renderer;
+
+const Mat4f = @import("../math/matrix.zig").Mat4f;
+
+
+pub const TemporalUpscaleConfig = struct {
+    /// Share of the new frame in an output pixel its sample lands on, lower converges smoother and trails longer
+    blend: f32 = 0.1,
+    /// Jitter positions cycled through at full resolution, scaled up by the output pixels per rendered one
+    jitter_phases: u32 = 8,
+};
+
+
+/// Temporal reconstruction of a scene drawn at a fraction of the output resolution
+/// Each frame's projection is shifted by a sub-pixel Halton offset, so over a few frames the rendered
+/// samples cover every output pixel. The resolve pass reprojects last frame's output through the depth
+/// buffer and both frames' view-projections, clamps it to the new samples' 3x3 neighborhood to reject
+/// what disoccluded or changed, and blends the new sample in by how close it lands to the pixel
+/// Motion comes from the camera only, objects moving on their own are held back by the neighborhood clamp
+pub const TemporalUpscaler = struct {
+    const Self = @This();
+
+    const color_unit = 0;
+    const depth_unit = 1;
+    const history_unit = 2;
+    const max_phases = 64;
+
+    const vertex_source =
+        \\#version 330 core
+        \\out vec2 uv;
+        \\void main() {
+        \\    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        \\    uv = corner;
+        \\    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+        \\}
+    ;
+    const fragment_source =
+        \\#version 330 core
+        \\in vec2 uv;
+        \\out vec4 FragColor;
+        \\uniform sampler2D color;
+        \\uniform sampler2D depth;
+        \\uniform sampler2D history;
+        \\// Rendered region in pixels and as a share of the scene target
+        \\uniform vec2 renderSize;
+        \\uniform vec2 uvScale;
+        \\// NDC offset the scene was drawn with
+        \\uniform vec2 jitter;
+        \\// Last frame's view-projection times the inverse of this one's, both without jitter
+        \\uniform mat4 reprojection;
+        \\uniform float blend;
+        \\uniform bool historyValid;
+        \\void main() {
+        \\    // Position in rendered pixels of the point the output pixel shows, the jitter moved the image
+        \\    vec2 position = (uv + jitter * 0.5) * renderSize;
+        \\    ivec2 center = clamp(ivec2(position), ivec2(0), ivec2(renderSize) - 1);
+        \\    vec3 current = texelFetch(color, center, 0).rgb;
+        \\    vec3 low = current;
+        \\    vec3 high = current;
+        \\    for (int y = -1; y <= 1; y++) {
+        \\        for (int x = -1; x <= 1; x++) {
+        \\            vec3 neighbor = texelFetch(color, clamp(center + ivec2(x, y), ivec2(0), ivec2(renderSize) - 1), 0).rgb;
+        \\            low = min(low, neighbor);
+        \\            high = max(high, neighbor);
+        \\        }
+        \\    }
+        \\    float z = texelFetch(depth, center, 0).r;
+        \\    vec4 previous = reprojection * vec4(uv * 2.0 - 1.0, z * 2.0 - 1.0, 1.0);
+        \\    vec2 previousUv = previous.xy / previous.w * 0.5 + 0.5;
+        \\    if (!historyValid || any(lessThan(previousUv, vec2(0.0))) || any(greaterThan(previousUv, vec2(1.0)))) {
+        \\        FragColor = vec4(texture(color, (uv + jitter * 0.5) * uvScale).rgb, 1.0);
+        \\        return;
+        \\    }
+        \\    vec3 past = clamp(texture(history, previousUv).rgb, low, high);
+        \\    // Distance from the sample to the pixel center in rendered pixels, far samples count less
+        \\    vec2 offset = position - vec2(center) - 0.5;
+        \\    float weight = blend * mix(0.2, 1.0, exp(-4.0 * dot(offset, offset)));
+        \\    FragColor = vec4(mix(past, current, weight), 1.0);
+        \\}
+    ;
+
+    config: TemporalUpscaleConfig,
+
+    program: c.GLuint = 0,
+    /// Attribute-less VAO for the fullscreen triangle
+    vao: c.GLuint = 0,
+
+    /// RGBA16F outputs at full resolution, written in turn, the other is the history
+    history: [2]c.GLuint = .{ 0, 0 },
+    framebuffers: [2]c.GLuint = .{ 0, 0 },
+    size: [2]u32 = .{ 0, 0 },
+    /// Output written by the last resolve
+    current: u1 = 0,
+    /// False until a resolve filled the history, and after resize or invalidate
+    history_valid: bool = false,
+
+    frame_index: u32 = 0,
+    /// NDC offset of this frame's projection, from beginFrame
+    jitter: [2]f32 = .{ 0.0, 0.0 },
+    /// Unjittered view-projections of this frame and the one before
+    view_projection: Mat4f = Mat4f.identity(),
+    previous_view_projection: Mat4f = Mat4f.identity(),
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(config: TemporalUpscaleConfig) !Self {
+        var self = Self{ .config = config };
+        // Names not created yet are 0 and ignored
+        errdefer self.deinit();
+
+        self.program = try Shader.createProgram(vertex_source, fragment_source);
+        const state = GLStateCache.current();
+        state.useProgram(self.program);
+        c.glUniform1i(c.glGetUniformLocation(self.program, "color"), color_unit);
+        c.glUniform1i(c.glGetUniformLocation(self.program, "depth"), depth_unit);
+        c.glUniform1i(c.glGetUniformLocation(self.program, "history"), history_unit);
+        c.glGenVertexArrays(1, &self.vao);
+        err.checkGLError("TemporalUpscaler setup");
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Size the outputs for a `width` x `height` window, nothing happens when it is unchanged
+    pub fn resize(self: *Self, width: u32, height: u32) !void {
+        const w = @max(width, 1);
+        const h = @max(height, 1);
+        if (self.history[0] != 0 and w == self.size[0] and h == self.size[1]) return;
+
+        self.destroyOutputs();
+        self.size = .{ w, h };
+        self.history_valid = false;
+
+        const state = GLStateCache.current();
+        c.glGenTextures(self.history.len, &self.history);
+        c.glGenFramebuffers(self.framebuffers.len, &self.framebuffers);
+        for (self.history, self.framebuffers) |texture, framebuffer| {
+            state.bindTexture2D(0, texture);
+            c.glTexImage2D(c.GL_TEXTURE_2D, 0, c.GL_RGBA16F, @intCast(w), @intCast(h), 0, c.GL_RGBA, c.GL_FLOAT, null);
+            c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_LINEAR);
+            c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_LINEAR);
+            c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
+            c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
+
+            c.glBindFramebuffer(c.GL_FRAMEBUFFER, framebuffer);
+            c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_COLOR_ATTACHMENT0, c.GL_TEXTURE_2D, texture, 0);
+            const status = c.glCheckFramebufferStatus(c.GL_FRAMEBUFFER);
+            c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+            if (status != c.GL_FRAMEBUFFER_COMPLETE) return RenderTargetError.IncompleteFramebuffer;
+        }
+        err.checkGLError("TemporalUpscaler.resize");
+    }
+
+
+    /// Record the camera of the frame about to be drawn at `render_size` and return its NDC jitter
+    /// `projection` is the unjittered one, the caller draws with it offset by the result
+    pub fn beginFrame(self: *Self, view: *const Mat4f, projection: *const Mat4f, render_size: [2]u32) [2]f32 {
+        self.previous_view_projection = self.view_projection;
+        self.view_projection.multiplyInto(projection, view);
+
+        // Fewer rendered pixels per output pixel need more positions to cover each of them
+        const ratio = @as(f32, @floatFromInt(self.size[0])) / @as(f32, @floatFromInt(@max(render_size[0], 1)));
+        const phases = std.math.clamp(@as(u32, @intFromFloat(@ceil(@as(f32, @floatFromInt(self.config.jitter_phases)) * ratio * ratio))), 1, max_phases);
+        const index = self.frame_index % phases + 1;
+        self.frame_index +%= 1;
+
+        self.jitter = .{
+            (halton(index, 2) - 0.5) * 2.0 / @as(f32, @floatFromInt(@max(render_size[0], 1))),
+            (halton(index, 3) - 0.5) * 2.0 / @as(f32, @floatFromInt(@max(render_size[1], 1))),
+        };
+        return self.jitter;
+    }
+
+
+    /// Reconstruct the full resolution frame from the lower left `region` of the scene target's `color`
+    /// and `depth` of `target_size`, into the next output, and return that output's texture
+    /// Leaves the output's framebuffer bound with a viewport over it
+    pub fn resolve(self: *Self, renderer: *Renderer, color: c.GLuint, depth: c.GLuint, target_size: [2]u32, region: [2]u32) c.GLuint {
+        renderer.beginGpuScope("Temporal upscale");
+        defer renderer.endGpuScope();
+        std.debug.assert(self.history[0] != 0);
+
+        const state = GLStateCache.current();
+        const next = self.current +% 1;
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.framebuffers[next]);
+        state.setViewport(0, 0, @intCast(self.size[0]), @intCast(self.size[1]));
+
+        state.bindTexture2D(color_unit, color);
+        state.bindSampler(color_unit, 0);
+        state.bindTexture2D(depth_unit, depth);
+        state.bindSampler(depth_unit, 0);
+        state.bindTexture2D(history_unit, self.history[self.current]);
+        state.bindSampler(history_unit, 0);
+
+        // The fullscreen triangle must not be culled, depth tested, blended or drawn as lines
+        const depth_test = state.depth_test;
+        const cull_face = state.cull_face;
+        const polygon_mode = state.polygon_mode;
+        state.setDepthTest(false);
+        state.setCullFace(false);
+        state.setPolygonMode(c.GL_FILL);
+        state.setBlend(.off);
+        defer {
+            if (depth_test) |enabled| state.setDepthTest(enabled);
+            if (cull_face) |enabled| state.setCullFace(enabled);
+            if (polygon_mode) |mode| state.setPolygonMode(mode);
+        }
+
+        // A singular view-projection only happens with a degenerate camera, the history is dropped then
+        var reprojection = Mat4f.identity();
+        const inverse = self.view_projection.inverse();
+        if (inverse) |*current_inverse| reprojection.multiplyInto(&self.previous_view_projection, current_inverse);
+
+        const program = self.program;
+        state.useProgram(program);
+        c.glUniform2f(c.glGetUniformLocation(program, "renderSize"), @floatFromInt(region[0]), @floatFromInt(region[1]));
+        c.glUniform2f(
+            c.glGetUniformLocation(program, "uvScale"),
+            @as(f32, @floatFromInt(region[0])) / @as(f32, @floatFromInt(target_size[0])),
+            @as(f32, @floatFromInt(region[1])) / @as(f32, @floatFromInt(target_size[1])),
+        );
+        c.glUniform2f(c.glGetUniformLocation(program, "jitter"), self.jitter[0], self.jitter[1]);
+        c.glUniformMatrix4fv(c.glGetUniformLocation(program, "reprojection"), 1, c.GL_FALSE, &reprojection.data);
+        c.glUniform1f(c.glGetUniformLocation(program, "blend"), self.config.blend);
+        c.glUniform1i(c.glGetUniformLocation(program, "historyValid"), @intFromBool(self.history_valid and inverse != null));
+        state.bindVertexArray(self.vao);
+        c.glDrawArrays(c.GL_TRIANGLES, 0, 3);
+        err.checkGLError("TemporalUpscaler.resolve");
+
+        self.current = next;
+        self.history_valid = true;
+        return self.history[next];
+    }
+
+
+    /// Copy the last output over the default framebuffer of the same size, leaves it bound
+    pub fn blitToScreen(self: *const Self) void {
+        const w: c.GLint = @intCast(self.size[0]);
+        const h: c.GLint = @intCast(self.size[1]);
+        c.glBindFramebuffer(c.GL_READ_FRAMEBUFFER, self.framebuffers[self.current]);
+        c.glBindFramebuffer(c.GL_DRAW_FRAMEBUFFER, err.default_framebuffer);
+        c.glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, c.GL_COLOR_BUFFER_BIT, c.GL_NEAREST);
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+        err.checkGLError("TemporalUpscaler.blitToScreen");
+    }
+
+
+    /// Drop the history, e.g. on a camera cut, the next frame starts over from its own samples
+    pub fn invalidate(self: *Self) void {
+        self.history_valid = false;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        const state = GLStateCache.current();
+        state.forgetProgram(self.program);
+        c.glDeleteProgram(self.program);
+        state.forgetVertexArray(self.vao);
+        c.glDeleteVertexArrays(1, &self.vao);
+        self.destroyOutputs();
+        err.checkGLError("TemporalUpscaler cleanup");
+
+        const config = self.config;
+        self.* = .{ .config = config };
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn destroyOutputs(self: *Self) void {
+        const state = GLStateCache.current();
+        for (self.history) |texture| state.forgetTexture(texture);
+        c.glDeleteTextures(self.history.len, &self.history);
+        c.glDeleteFramebuffers(self.framebuffers.len, &self.framebuffers);
+        self.history = .{ 0, 0 };
+        self.framebuffers = .{ 0, 0 };
+    }
+
+
+    /// Element `index` of the Halton sequence in `base`, in [0, 1)
+    fn halton(index: u32, base: u32) f32 {
+        var result: f32 = 0.0;
+        var fraction: f32 = 1.0;
+        var i = index;
+        while (i > 0) : (i /= base) {
+            fraction /= @floatFromInt(base);
+            result += fraction * @as(f32, @floatFromInt(i % base));
+        }
+        return result;
+    }
+};
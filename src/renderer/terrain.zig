@@ -0,0 +1,493 @@
+// graphics/terrain.zig
+const std = @import("std");
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+
+const Mesh = @import("mesh.zig").Mesh;
+const MeshBuilder = @import("mesh_builder.zig").MeshBuilder;
+const Material = @import("material.zig").Material;
+const RenderQueue = @import("render_queue.zig").RenderQueue;
+const Camera = @import("camera.zig").Camera;
+
+const Vec3f = @import("../math/vector.zig").Vec3f;
+const Affine3x4 = @import("../math/affine.zig").Affine3x4;
+
+
+pub const TerrainError = error{
+    /// Fewer than 2x2 samples, or not width * depth of them or of the normals
+    InvalidHeightmap,
+    /// The chunk size is not divisible by 1 << (lod_count - 1), or lod_count is out of range
+    InvalidChunkSize,
+};
+
+
+/// Height samples on a regular grid, row by row along x, rows ordered along z
+pub const Heightmap = struct {
+    heights: []const f32,
+    /// Samples along x and z
+    width: u32,
+    depth: u32,
+    /// World distance between neighbouring samples
+    spacing: f32 = 1.0,
+    height_scale: f32 = 1.0,
+    /// One per sample from noise.heightfieldNormals, normal computes them one at a time while empty
+    normals: []const Vec3f = &.{},
+
+
+    /// Scaled height, coordinates clamped to the map
+    pub fn sample(self: *const Heightmap, x: i64, z: i64) f32 {
+        const cx: usize = @intCast(std.math.clamp(x, 0, @as(i64, self.width) - 1));
+        const cz: usize = @intCast(std.math.clamp(z, 0, @as(i64, self.depth) - 1));
+        return self.heights[cz * self.width + cx] * self.height_scale;
+    }
+
+
+    /// Surface normal at a sample from central differences, or the precomputed one
+    pub fn normal(self: *const Heightmap, x: i64, z: i64) Vec3f {
+        if (self.normals.len != 0) {
+            const cx: usize = @intCast(std.math.clamp(x, 0, @as(i64, self.width) - 1));
+            const cz: usize = @intCast(std.math.clamp(z, 0, @as(i64, self.depth) - 1));
+            return self.normals[cz * self.width + cx];
+        }
+        const dx = self.sample(x - 1, z) - self.sample(x + 1, z);
+        const dz = self.sample(x, z - 1) - self.sample(x, z + 1);
+        return Vec3f.normalize(.{ .x = dx, .y = 2.0 * self.spacing, .z = dz });
+    }
+};
+
+
+pub const TerrainConfig = struct {
+    /// Grid cells along one chunk side, divisible by 1 << (lod_count - 1)
+    chunk_cells: u32 = 64,
+    /// Levels of detail, each halves the grid resolution of the one before
+    lod_count: u8 = 4,
+    /// Chunks closer to the camera than this use level 0, every further multiple one level coarser
+    lod_distance: f32 = 128.0,
+    /// Chunks are loaded within this distance of the camera and unloaded one chunk beyond it
+    view_radius: f32 = 512.0,
+    /// Edges hang this far down as skirts, hiding the cracks between neighbours of different levels
+    skirt_depth: f32 = 4.0,
+    /// Chunk meshes created or rebuilt per update, bounds the upload cost of one frame
+    max_uploads_per_update: u32 = 4,
+    /// Chunks built by the workers at the same time
+    max_jobs_in_flight: u32 = 8,
+};
+
+
+/// Heightmap terrain split into square chunks that are built on worker threads as the camera moves
+/// Only chunks within the view radius live on the GPU, each at a level of detail chosen by distance
+/// Every level shares one index list, the workers only generate positions, normals and texture coordinates
+/// Chunk meshes use the PosNormTex layout in world space, draw them with pushVisible
+pub const Terrain = struct {
+    const Self = @This();
+
+    pub const max_lod_count = 8;
+
+    const package_size = 8;
+    const floats_per_vertex = 8;
+
+    const ChunkCoord = struct { x: u32, z: u32 };
+
+    const Chunk = struct {
+        mesh: ?*Mesh = null,
+        /// Level of the current mesh
+        lod: u8 = 0,
+        /// Build of the chunk in flight, at most one
+        job: ?*Job = null,
+    };
+
+    /// Mesh of one chunk at one level, mapped on the GL thread and filled in by a worker
+    const Job = struct {
+        heightmap: *const Heightmap,
+        config: TerrainConfig,
+        coord: ChunkCoord,
+        lod: u8,
+
+        /// Indices are written when the job starts, the worker writes the vertices. Null once committed
+        builder: ?MeshBuilder,
+        /// Set by the worker once it is done with the job, the builder is only committed after it
+        done: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+    };
+
+    allocator: std.mem.Allocator,
+    pool: *JobSystem,
+    /// Every job spawned and not yet finished
+    wait_group: std.Thread.WaitGroup = .{},
+
+    heightmap: Heightmap,
+    material: *Material,
+    config: TerrainConfig,
+
+    /// Chunks along x and z
+    chunks_x: u32,
+    chunks_z: u32,
+    chunks: std.AutoHashMap(ChunkCoord, Chunk),
+    /// Builds of chunks unloaded while their job was running, freed once the job finishes
+    orphaned: std.ArrayList(*Job),
+    jobs_in_flight: u32 = 0,
+
+    /// Triangle list of one chunk at every level, grid first, skirts after
+    lod_indices: [max_lod_count][]u32 = .{&.{}} ** max_lod_count,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Workers of `pool` write chunk vertices straight into mapped buffers, they don't allocate
+    /// The terrain keeps a reference to `material` and borrows the heights and normals, they have to outlive it
+    pub fn create(allocator: std.mem.Allocator, pool: *JobSystem, heightmap: Heightmap, material: *Material, config: TerrainConfig) !*Self {
+        if (heightmap.width < 2 or heightmap.depth < 2) return TerrainError.InvalidHeightmap;
+        if (heightmap.heights.len != @as(usize, heightmap.width) * heightmap.depth) return TerrainError.InvalidHeightmap;
+        if (heightmap.normals.len != 0 and heightmap.normals.len != heightmap.heights.len) return TerrainError.InvalidHeightmap;
+        if (config.lod_count == 0 or config.lod_count > max_lod_count) return TerrainError.InvalidChunkSize;
+        if (config.chunk_cells == 0 or config.chunk_cells % (@as(u32, 1) << @intCast(config.lod_count - 1)) != 0) {
+            return TerrainError.InvalidChunkSize;
+        }
+
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+
+        self.* = .{
+            .allocator = allocator,
+            .pool = pool,
+            .heightmap = heightmap,
+            .material = material,
+            .config = config,
+            .chunks_x = std.math.divCeil(u32, heightmap.width - 1, config.chunk_cells) catch unreachable,
+            .chunks_z = std.math.divCeil(u32, heightmap.depth - 1, config.chunk_cells) catch unreachable,
+            .chunks = std.AutoHashMap(ChunkCoord, Chunk).init(allocator),
+            .orphaned = std.ArrayList(*Job).init(allocator),
+        };
+        errdefer self.freeIndices();
+
+        for (self.lod_indices[0..config.lod_count], 0..) |*indices, lod| {
+            indices.* = try buildIndices(allocator, self.verticesPerSide(@intCast(lod)));
+        }
+
+        material.addRef();
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Upload finished chunks, unload far ones and start builds for missing or wrongly detailed ones
+    /// Call once per frame on the thread owning the GL context
+    pub fn update(self: *Self, camera_position: Vec3f) !void {
+        try self.collectJobs();
+        try self.unloadFar(camera_position);
+        try self.requestChunks(camera_position);
+    }
+
+
+    /// Queue every loaded chunk inside the camera's frustum
+    pub fn pushVisible(self: *Self, queue: *RenderQueue, camera: *const Camera) !void {
+        const frustum = camera.getFrustum();
+        const world = [1]Affine3x4{Affine3x4.identity()};
+
+        var it = self.chunks.valueIterator();
+        while (it.next()) |chunk| {
+            const mesh = chunk.mesh orelse continue;
+            if (!frustum.intersectsBox(mesh.bounds)) continue;
+
+            const depth = mesh.bounds.center().distance(camera.position) / camera.far;
+            try queue.pushMesh(mesh, self.material, &world, depth);
+        }
+    }
+
+
+    /// Chunks with a mesh on the GPU
+    pub fn loadedChunkCount(self: *const Self) usize {
+        var count: usize = 0;
+        var it = self.chunks.valueIterator();
+        while (it.next()) |chunk| {
+            if (chunk.mesh != null) count += 1;
+        }
+        return count;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Waits for the running builds, then frees every chunk
+    pub fn destroy(self: *Self) void {
+        self.pool.waitAndWork(&self.wait_group);
+
+        var it = self.chunks.valueIterator();
+        while (it.next()) |chunk| {
+            if (chunk.job) |job| self.freeJob(job);
+            if (chunk.mesh) |mesh| _ = mesh.release();
+        }
+        for (self.orphaned.items) |job| self.freeJob(job);
+
+        self.chunks.deinit();
+        self.orphaned.deinit();
+        self.freeIndices();
+        _ = self.material.release();
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn verticesPerSide(self: *const Self, lod: u8) u32 {
+        return (self.config.chunk_cells >> @intCast(lod)) + 1;
+    }
+
+
+    /// Level a chunk should have at `distance` from the camera
+    fn lodFor(self: *const Self, distance: f32) u8 {
+        const level: u32 = @intFromFloat(@max(distance / self.config.lod_distance, 0.0));
+        return @intCast(@min(level, self.config.lod_count - 1));
+    }
+
+
+    /// Horizontal distance from the camera to the centre of a chunk
+    fn chunkDistance(self: *const Self, coord: ChunkCoord, camera_position: Vec3f) f32 {
+        const size = @as(f32, @floatFromInt(self.config.chunk_cells)) * self.heightmap.spacing;
+        const cx = (@as(f32, @floatFromInt(coord.x)) + 0.5) * size;
+        const cz = (@as(f32, @floatFromInt(coord.z)) + 0.5) * size;
+        return @sqrt((cx - camera_position.x) * (cx - camera_position.x) + (cz - camera_position.z) * (cz - camera_position.z));
+    }
+
+
+    /// Commit finished builds up to the per-update limit and free finished orphans
+    fn collectJobs(self: *Self) !void {
+        var i: usize = 0;
+        while (i < self.orphaned.items.len) {
+            const job = self.orphaned.items[i];
+            if (!job.done.load(.acquire)) {
+                i += 1;
+                continue;
+            }
+            self.freeJob(job);
+            _ = self.orphaned.swapRemove(i);
+        }
+
+        var uploads: u32 = 0;
+        var it = self.chunks.valueIterator();
+        while (it.next()) |chunk| {
+            const job = chunk.job orelse continue;
+            if (!job.done.load(.acquire)) continue;
+
+            if (uploads == self.config.max_uploads_per_update) continue;
+            uploads += 1;
+
+            // The builder is spent even when commit fails, the chunk is requested again by the next update
+            var builder = job.builder.?;
+            job.builder = null;
+            chunk.job = null;
+            self.freeJob(job);
+
+            const mesh = try builder.commit();
+            if (chunk.mesh) |old| _ = old.release();
+            chunk.mesh = mesh;
+            chunk.lod = job.lod;
+        }
+    }
+
+
+    /// Drop chunks more than one chunk beyond the view radius, their running builds become orphans
+    fn unloadFar(self: *Self, camera_position: Vec3f) !void {
+        const size = @as(f32, @floatFromInt(self.config.chunk_cells)) * self.heightmap.spacing;
+        const limit = self.config.view_radius + size;
+
+        var far = std.ArrayList(ChunkCoord).init(self.allocator);
+        defer far.deinit();
+
+        var it = self.chunks.iterator();
+        while (it.next()) |entry| {
+            if (self.chunkDistance(entry.key_ptr.*, camera_position) > limit) try far.append(entry.key_ptr.*);
+        }
+
+        try self.orphaned.ensureUnusedCapacity(far.items.len);
+        for (far.items) |coord| {
+            const chunk = self.chunks.fetchRemove(coord).?.value;
+            if (chunk.job) |job| self.orphaned.appendAssumeCapacity(job);
+            if (chunk.mesh) |mesh| _ = mesh.release();
+        }
+    }
+
+
+    /// Start builds for chunks in the view radius that are missing or at the wrong level, nearest first
+    fn requestChunks(self: *Self, camera_position: Vec3f) !void {
+        if (self.jobs_in_flight >= self.config.max_jobs_in_flight) return;
+
+        const Request = struct { coord: ChunkCoord, distance: f32 };
+        var requests = std.ArrayList(Request).init(self.allocator);
+        defer requests.deinit();
+
+        // Chunks whose square overlaps the view radius
+        const size = @as(f32, @floatFromInt(self.config.chunk_cells)) * self.heightmap.spacing;
+        const range_x = self.chunkRange(camera_position.x, size, self.chunks_x);
+        const range_z = self.chunkRange(camera_position.z, size, self.chunks_z);
+
+        for (range_z[0]..range_z[1]) |z| {
+            for (range_x[0]..range_x[1]) |x| {
+                const coord = ChunkCoord{ .x = @intCast(x), .z = @intCast(z) };
+                const distance = self.chunkDistance(coord, camera_position);
+                if (distance > self.config.view_radius) continue;
+
+                if (self.chunks.get(coord)) |chunk| {
+                    if (chunk.job != null) continue;
+                    if (chunk.mesh != null and chunk.lod == self.lodFor(distance)) continue;
+                }
+                try requests.append(.{ .coord = coord, .distance = distance });
+            }
+        }
+
+        std.mem.sort(Request, requests.items, {}, struct {
+            fn lessThan(_: void, a: Request, b: Request) bool {
+                return a.distance < b.distance;
+            }
+        }.lessThan);
+
+        for (requests.items) |request| {
+            if (self.jobs_in_flight >= self.config.max_jobs_in_flight) break;
+
+            const entry = try self.chunks.getOrPut(request.coord);
+            if (!entry.found_existing) entry.value_ptr.* = .{};
+
+            const lod = self.lodFor(request.distance);
+            const indices = self.lod_indices[lod];
+            const n = self.verticesPerSide(lod);
+            var builder = try MeshBuilder.begin(self.allocator, package_size, n * n + 4 * (n - 1), @intCast(indices.len));
+            errdefer builder.cancel();
+            builder.setIndices(0, indices);
+
+            const job = try self.allocator.create(Job);
+            job.* = .{
+                .heightmap = &self.heightmap,
+                .config = self.config,
+                .coord = request.coord,
+                .lod = lod,
+                .builder = builder,
+            };
+            entry.value_ptr.job = job;
+            self.jobs_in_flight += 1;
+            self.pool.spawnWg(&self.wait_group, buildChunk, .{job});
+        }
+    }
+
+
+    /// First and one past the last chunk index along an axis within the view radius of `center`
+    fn chunkRange(self: *const Self, center: f32, size: f32, count: u32) [2]usize {
+        const lo = @floor((center - self.config.view_radius) / size);
+        const hi = @floor((center + self.config.view_radius) / size) + 1;
+        const max: f32 = @floatFromInt(count);
+        return .{
+            @intFromFloat(std.math.clamp(lo, 0, max)),
+            @intFromFloat(std.math.clamp(hi, 0, max)),
+        };
+    }
+
+
+    /// Only once the worker is done with the job, unfinished builds are cancelled
+    fn freeJob(self: *Self, job: *Job) void {
+        if (job.builder) |*builder| builder.cancel();
+        self.allocator.destroy(job);
+        self.jobs_in_flight -= 1;
+    }
+
+
+    fn freeIndices(self: *Self) void {
+        for (&self.lod_indices) |*indices| {
+            self.allocator.free(indices.*);
+            indices.* = &.{};
+        }
+    }
+
+
+    /// Worker entry, generates the grid and skirt vertices of one chunk into its mapped buffer
+    /// Grid vertices row by row, then one skirt vertex below every edge vertex in boundary order
+    fn buildChunk(job: *Job) void {
+        defer job.done.store(true, .release);
+        const builder = &job.builder.?;
+        const n = (job.config.chunk_cells >> @intCast(job.lod)) + 1;
+
+        for (0..n) |j| {
+            for (0..n) |i| {
+                builder.setVertex(j * n + i, &gridVertex(job, @intCast(i), @intCast(j)));
+            }
+        }
+
+        // Skirt vertices repeat their edge vertex moved down, computed again as mapped memory is not read back
+        for (0..4 * (n - 1)) |k| {
+            const top = boundaryVertex(n, @intCast(k));
+            var skirt = gridVertex(job, top % n, top / n);
+            skirt[1] -= job.config.skirt_depth;
+            builder.setVertex(n * n + k, &skirt);
+        }
+    }
+
+
+    /// Vertex of grid column `i` and row `j` of the job's chunk
+    /// Samples past the map edge clamp to it, their triangles collapse to nothing
+    fn gridVertex(job: *const Job, i: u32, j: u32) [floats_per_vertex]f32 {
+        const map = job.heightmap;
+        const step: i64 = @as(i64, 1) << @intCast(job.lod);
+        const x0: i64 = @as(i64, job.coord.x) * job.config.chunk_cells;
+        const z0: i64 = @as(i64, job.coord.z) * job.config.chunk_cells;
+
+        const sx = @min(x0 + @as(i64, i) * step, map.width - 1);
+        const sz = @min(z0 + @as(i64, j) * step, map.depth - 1);
+        const normal = map.normal(sx, sz);
+        const fx: f32 = @floatFromInt(sx);
+        const fz: f32 = @floatFromInt(sz);
+        const inv_width = 1.0 / @as(f32, @floatFromInt(map.width - 1));
+        const inv_depth = 1.0 / @as(f32, @floatFromInt(map.depth - 1));
+
+        return .{
+            fx * map.spacing, map.sample(sx, sz), fz * map.spacing,
+            normal.x,         normal.y,           normal.z,
+            fx * inv_width,   fz * inv_depth,
+        };
+    }
+
+
+    /// Grid vertex `k` steps along the boundary, counter-clockwise seen from above: +x, +z, -x, -z
+    fn boundaryVertex(n: u32, k: u32) u32 {
+        const edge = n - 1;
+        const side = k / edge;
+        const t = k % edge;
+        return switch (side) {
+            0 => t,
+            1 => t * n + edge,
+            2 => edge * n + (edge - t),
+            else => (edge - t) * n,
+        };
+    }
+
+
+    /// Two counter-clockwise triangles per grid cell, then a quad facing outwards per skirt segment
+    fn buildIndices(allocator: std.mem.Allocator, n: u32) ![]u32 {
+        const ring = 4 * (n - 1);
+        var indices = try std.ArrayList(u32).initCapacity(allocator, (n - 1) * (n - 1) * 6 + ring * 6);
+        errdefer indices.deinit();
+
+        for (0..n - 1) |j| {
+            for (0..n - 1) |i| {
+                const a: u32 = @intCast(j * n + i);
+                const b = a + n;
+                indices.appendSliceAssumeCapacity(&.{ a, b, a + 1, a + 1, b, b + 1 });
+            }
+        }
+
+        const skirt_base = n * n;
+        for (0..ring) |k| {
+            const next: u32 = @intCast((k + 1) % ring);
+            const t0 = boundaryVertex(n, @intCast(k));
+            const t1 = boundaryVertex(n, next);
+            const b0 = skirt_base + @as(u32, @intCast(k));
+            const b1 = skirt_base + next;
+            indices.appendSliceAssumeCapacity(&.{ t0, t1, b0, t1, b1, b0 });
+        }
+        return indices.toOwnedSlice();
+    }
+};
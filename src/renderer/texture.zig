@@ -3,11 +3,23 @@
 const std = @import("std");
 const c = @import("../bindings/c.zig");
 const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const DeletionBatch = @import("gl_state.zig").DeletionBatch;
+const sampler_cache = @import("sampler_cache.zig");
+const SamplerCache = sampler_cache.SamplerCache;
+const SamplerDesc = sampler_cache.SamplerDesc;
+const texture_container = @import("texture_container.zig");
+const CompressedImage = texture_container.CompressedImage;
+const MipGenerator = @import("mip_generator.zig").MipGenerator;
+const image_decode = @import("image_decode.zig");
 
 pub const TextureError = error{
     TextureLoadFailed,
     InvalidTextureData,
     InvalidTextureFormat,
+    /// The driver can't sample the block format of a compressed texture
+    UnsupportedCompression,
     OpenGLError,
 };
 
@@ -16,6 +28,12 @@ pub const Texture = struct {
     width: i32,
     height: i32,
     channels: i32,
+    /// Holds a 1x1 placeholder until a TextureLoader uploads the decoded image
+    pending: bool = false,
+    /// Filtering and wrapping, bound as a shared sampler object next to the texture
+    sampler: SamplerDesc = .{},
+    /// Video memory of every level, recorded by each upload
+    gpu_bytes: usize = 0,
 
     ref_count: std.atomic.Value(u32),
     allocator: std.mem.Allocator,
@@ -26,8 +44,10 @@ pub const Texture = struct {
     // Public API: Creation Functions
     // ============================================================
 
-    // In your Texture.createFromFile function
+    /// Load an image file, .dds and .ktx2 files upload their compressed mip chain as stored
     pub fn createFromFile(allocator: std.mem.Allocator, path: []const u8) !*Texture {
+        if (texture_container.isContainerPath(path)) return createFromContainerFile(allocator, path);
+
         // Check if file exists first
         const file = try std.fs.cwd().openFile(path, .{});
         file.close();
@@ -45,21 +65,193 @@ pub const Texture = struct {
     }
 
 
+    /// Load a DDS or KTX2 file holding a BC or ASTC format, without decoding or generating mipmaps
+    pub fn createFromContainerFile(allocator: std.mem.Allocator, path: []const u8) !*Texture {
+        const bytes = try std.fs.cwd().readFileAlloc(allocator, path, std.math.maxInt(u32));
+        defer allocator.free(bytes);
+
+        const image = try texture_container.parse(bytes);
+        return createCompressed(allocator, &image);
+    }
+
+
+    /// Upload the stored mip chain of `image` with glCompressedTexImage2D
+    /// Containers are expected bottom row first, the GL convention the texconv tool writes them in
+    pub fn createCompressed(allocator: std.mem.Allocator, image: *const CompressedImage) !*Texture {
+        const texture_ptr = try allocator.create(Texture);
+        errdefer allocator.destroy(texture_ptr);
+
+        const id = try uploadCompressed(image);
+        texture_ptr.* = .{
+            .id = id,
+            .width = @intCast(image.levels[0].width),
+            .height = @intCast(image.levels[0].height),
+            .channels = 4,
+            .gpu_bytes = compressedBytes(image),
+            .allocator = allocator,
+            .ref_count = std.atomic.Value(u32).init(1),
+        };
+        return texture_ptr;
+    }
+
+
+    /// Texture of `width` x `height` RGBA pixels, rows bottom first, with generated mipmaps
+    pub fn createRGBA(allocator: std.mem.Allocator, width: i32, height: i32, pixels: [*]const u8) !*Texture {
+        if (width <= 0 or height <= 0) return TextureError.InvalidTextureData;
+
+        const texture_ptr = try allocator.create(Texture);
+        errdefer allocator.destroy(texture_ptr);
+
+        texture_ptr.* = .{
+            .id = try createFromPixels(width, height, pixels),
+            .width = width,
+            .height = height,
+            .channels = 4,
+            .gpu_bytes = rgbaChainBytes(width, height),
+            .allocator = allocator,
+            .ref_count = std.atomic.Value(u32).init(1),
+        };
+        return texture_ptr;
+    }
+
+
+    /// Take ownership of `id`, a complete RGBA texture of `width` x `height`, e.g. filled after createStorage
+    pub fn createFromId(allocator: std.mem.Allocator, id: c.GLuint, width: i32, height: i32) !*Texture {
+        const texture_ptr = try allocator.create(Texture);
+        texture_ptr.* = .{
+            .id = id,
+            .width = width,
+            .height = height,
+            .channels = 4,
+            .gpu_bytes = rgbaChainBytes(width, height),
+            .allocator = allocator,
+            .ref_count = std.atomic.Value(u32).init(1),
+        };
+        return texture_ptr;
+    }
+
+
+    /// Texture showing a single white texel, filled in later by a TextureLoader
+    /// Materials can bind it right away, the upload swaps the image in behind the same Texture
+    pub fn createPlaceholder(allocator: std.mem.Allocator) !*Texture {
+        const texture_ptr = try allocator.create(Texture);
+        errdefer allocator.destroy(texture_ptr);
+
+        const white = [4]u8{ 255, 255, 255, 255 };
+        const texture_id = try createFromPixels(1, 1, &white);
+
+        texture_ptr.* = .{
+            .id = texture_id,
+            .width = 1,
+            .height = 1,
+            .channels = 4,
+            .pending = true,
+            .gpu_bytes = rgbaChainBytes(1, 1),
+            .allocator = allocator,
+            .ref_count = std.atomic.Value(u32).init(1),
+        };
+        return texture_ptr;
+    }
+
+
+    /// Texture name with uninitialized RGBA8 storage for the full mip chain, to be filled in pieces
+    /// with glTexSubImage2D, e.g. from a pixel buffer, then handed to adopt. Leaves it bound to unit 0
+    pub fn createStorage(width: i32, height: i32) !c.GLuint {
+        if (width <= 0 or height <= 0) return TextureError.InvalidTextureData;
+        return allocateStorage(c.GL_RGBA8, mipCount(width, height), width, height);
+    }
+
+
+    /// Complete texture name holding `width` x `height` RGBA pixels and their mipmaps, with no Texture around it
+    /// For uploads from a shared context whose thread can't create resources, createFromId wraps it later
+    pub fn createFilled(width: i32, height: i32, pixels: [*]const u8) !c.GLuint {
+        if (width <= 0 or height <= 0) return TextureError.InvalidTextureData;
+        return createFromPixels(width, height, pixels);
+    }
+
+
     // ============================================================
     // Public API: Operational Functions
     // ============================================================
 
+    /// Replace the contents with `width` x `height` RGBA pixels and rebuild the mipmaps
+    /// Storage is immutable, so the pixels go into a new texture name that replaces the current one
+    pub fn uploadRGBA(self: *Texture, width: i32, height: i32, pixels: [*]const u8) !void {
+        if (width <= 0 or height <= 0) return TextureError.InvalidTextureData;
+
+        const id = try createFromPixels(width, height, pixels);
+        self.adopt(id, width, height);
+    }
+
+
+    /// Rebuild the mip chain from level 0, e.g. after drawing into it or patching it with glTexSubImage2D
+    /// Only for uncompressed textures, compressed ones keep the levels they were uploaded with
+    pub fn generateMipmaps(self: *Texture) void {
+        buildMipmaps(self.id, self.width, self.height);
+    }
+
+
+    /// Fill the mip chain of `id`, RGBA8 storage of `width` x `height` from createStorage or createFilled,
+    /// from its level 0. Colors are averaged in linear space, through MipGenerator where compute shaders exist
+    pub fn buildMipmaps(id: c.GLuint, width: i32, height: i32) void {
+        MipGenerator.shared().generate(id, c.GL_RGBA8, width, height, mipCount(width, height), .srgb);
+    }
+
+
+    /// Take over `id`, a complete texture of `width` x `height` with mipmaps, and delete the current name
+    /// Used when uploads went into a separate texture so the old contents stayed visible meanwhile
+    pub fn adopt(self: *Texture, id: c.GLuint, width: i32, height: i32) void {
+        GLStateCache.current().forgetTexture(self.id);
+        c.glDeleteTextures(1, &self.id);
+        err.checkGLError("Texture.adopt: glDeleteTextures");
+
+        self.id = id;
+        self.width = width;
+        self.height = height;
+        self.channels = 4;
+        self.pending = false;
+        self.gpu_bytes = rgbaChainBytes(width, height);
+    }
+
+
+    /// Replace the contents with the compressed mip chain of `image`, e.g. in a placeholder
+    pub fn uploadCompressedImage(self: *Texture, image: *const CompressedImage) !void {
+        const id = try uploadCompressed(image);
+        self.adopt(id, @intCast(image.levels[0].width), @intCast(image.levels[0].height));
+        self.gpu_bytes = compressedBytes(image);
+    }
+
+
     pub fn addRef(self: *Texture) void {
         _ = self.ref_count.fetchAdd(1, .monotonic);
     }
 
 
-    /// Binds the texture to a specified texture unit.
+    /// Sample with `desc` from the next bind on, the GL sampler is shared with every texture using it
+    pub fn setSampler(self: *Texture, desc: SamplerDesc) void {
+        self.sampler = desc;
+    }
+
+
+    /// Binds the texture and its sampler to a specified texture unit.
     pub fn bind(self: *Texture, textureUnit: c_int) void {
-        const texture_unit = c.GL_TEXTURE0 + textureUnit;
-        c.glActiveTexture(@intCast(texture_unit));
-        c.glBindTexture(c.GL_TEXTURE_2D, self.id);
-        err.checkGLError("glBindTexture");
+        const unit: u32 = @intCast(textureUnit);
+        const state = GLStateCache.current();
+        state.bindTexture2D(unit, self.id);
+        state.bindSampler(unit, SamplerCache.shared().get(self.sampler));
+    }
+
+
+    /// Video memory of the texture's levels
+    pub fn residentBytes(self: *const Texture) usize {
+        return self.gpu_bytes;
+    }
+
+
+    /// System memory held by the texture, the pixels only live on the GPU
+    pub fn cpuBytes(self: *const Texture) usize {
+        _ = self;
+        return @sizeOf(Texture);
     }
 
 
@@ -84,8 +276,8 @@ pub const Texture = struct {
             @panic("Double release of Texture detected"); // already freed
 
         } else if (prev == 1) {
-            c.glDeleteTextures(1, &self.id);
-            err.checkGLError("glDeleteTextures");
+            GLStateCache.current().forgetTexture(self.id);
+            DeletionBatch.deleteTextures(&.{self.id});
 
             // Free the Texture struct allocated by the allocator.
             self.allocator.destroy(self);
@@ -99,76 +291,103 @@ pub const Texture = struct {
     // ============================================================
 
 
-    /// Loads a texture from file using stb_image.
-    /// - path: a null-terminated string containing the file path.
+    /// Loads a texture from file using stb_image, decoded in the thread's scratch memory and uploaded from there
     fn initFromFile(allocator: std.mem.Allocator, path: []const u8) !Texture {
         std.debug.print("Attempting to load texture from path: {s}\n", .{path});
 
-        // Create a null-terminated copy of the path
-        const c_path = try allocator.dupeZ(u8, path);
-        defer allocator.free(c_path);
-
-        var w: i32 = 0;
-        var h: i32 = 0;
-        var n: i32 = 0;
-        
         c.stbi_set_flip_vertically_on_load(1);
 
         // Force image to load with 4 channels (RGBA)
-        const data = c.stbi_load(c_path.ptr, &w, &h, &n, 4);
-        if (data == null) {
-            const err_msg = c.stbi_failure_reason();
-            std.debug.print("STBI loading failed: {s}\n", .{err_msg});
+        const image = image_decode.decodeFile(path, 4) catch |decode_err| {
+            std.debug.print("STBI loading failed: {s}\n", .{image_decode.failureReason(decode_err)});
             return TextureError.TextureLoadFailed;
-        }
-        defer c.stbi_image_free(data);
+        };
+        const w: i32 = @intCast(image.width);
+        const h: i32 = @intCast(image.height);
+
+        const texture_id = try createFromPixels(w, h, image.pixels.ptr);
+
+        return Texture{
+            .id = texture_id,
+            .width = w,
+            .height = h,
+            .channels = 4,  // forcing RGBA
+            .gpu_bytes = rgbaChainBytes(w, h),
+            .allocator = allocator,
+            .ref_count = std.atomic.Value(u32).init(1),
+        };
+    }
 
-        // Validate dimensions
-        if (w <= 0 or h <= 0) {
-            std.debug.print("Invalid texture dimensions: {}x{}\n", .{ w, h });
-            return TextureError.InvalidTextureData;
+
+    /// Bytes of an RGBA8 texture with its full mip chain
+    fn rgbaChainBytes(width: i32, height: i32) usize {
+        var total: usize = 0;
+        for (0..@intCast(mipCount(width, height))) |level| {
+            const w: usize = @intCast(@max(width >> @intCast(level), 1));
+            const h: usize = @intCast(@max(height >> @intCast(level), 1));
+            total += w * h * 4;
         }
+        return total;
+    }
 
-        // Generate and bind texture first
+
+    fn compressedBytes(image: *const CompressedImage) usize {
+        var total: usize = 0;
+        for (image.mipLevels()) |level| total += level.data.len;
+        return total;
+    }
+
+
+    /// Levels of a full mip chain down to 1x1
+    fn mipCount(width: i32, height: i32) i32 {
+        const largest: u32 = @intCast(@max(width, height));
+        return @as(i32, std.math.log2_int(u32, largest)) + 1;
+    }
+
+
+    /// New texture name with `levels` levels of `internal_format`, left bound to unit 0
+    /// Immutable glTexStorage2D storage when the driver has it. Otherwise RGBA8 defines every level
+    /// with glTexImage2D and compressed levels are defined by their upload, MAX_LEVEL caps the chain either way
+    fn allocateStorage(internal_format: c.GLenum, levels: i32, width: i32, height: i32) !c.GLuint {
         var texture_id: c.GLuint = undefined;
         c.glGenTextures(1, &texture_id);
-
-        // Check if texture was created successfully
-        if (texture_id == 0) {
-            return TextureError.OpenGLError;
+        if (texture_id == 0) return TextureError.OpenGLError;
+        errdefer c.glDeleteTextures(1, &texture_id);
+
+        errdefer GLStateCache.current().forgetTexture(texture_id);
+        GLStateCache.current().bindTexture2D(0, texture_id);
+
+        if (gl_ext.texStorage2D) |texStorage2D| {
+            texStorage2D(c.GL_TEXTURE_2D, levels, internal_format, width, height);
+        } else {
+            c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAX_LEVEL, levels - 1);
+            if (internal_format == c.GL_RGBA8) {
+                for (0..@intCast(levels)) |level| {
+                    const w = @max(width >> @intCast(level), 1);
+                    const h = @max(height >> @intCast(level), 1);
+                    c.glTexImage2D(c.GL_TEXTURE_2D, @intCast(level), c.GL_RGBA8, w, h, 0, c.GL_RGBA, c.GL_UNSIGNED_BYTE, null);
+                }
+            }
         }
-        errdefer c.glDeleteTextures(1, &texture_id);  // Clean up if anything fails after this point
 
-        // Bind the texture and verify binding
-        c.glBindTexture(c.GL_TEXTURE_2D, texture_id);
-        if (c.glGetError() != c.GL_NO_ERROR) {
+        const openglerr = c.glGetError();
+        if (openglerr != c.GL_NO_ERROR) {
+            std.debug.print("OpenGL error allocating texture storage: 0x{x}\n", .{openglerr});
             return TextureError.OpenGLError;
         }
+        return texture_id;
+    }
 
-        // Set wrapping parameters
-        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_REPEAT);
-        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_REPEAT);
-        
-        // Set filtering parameters
-        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_LINEAR_MIPMAP_LINEAR);
-        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_LINEAR);
-
-        // We're now forcing RGBA format
-        const format = c.GL_RGBA;
-        const internal_format = c.GL_RGBA8;
-
-        // Upload the texture data with error checking
-        c.glTexImage2D(
-            c.GL_TEXTURE_2D,
-            0,
-            @intCast(internal_format),
-            w,
-            h,
-            0,
-            format,
-            c.GL_UNSIGNED_BYTE,
-            data,
-        );
+
+    /// New RGBA8 texture name holding `data` in level 0 and the mipmaps generated from it
+    fn createFromPixels(w: i32, h: i32, data: [*]const u8) !c.GLuint {
+        if (gl_ext.hasDirectStateAccess()) return createFromPixelsByName(w, h, data);
+
+        const texture_id = try allocateStorage(c.GL_RGBA8, mipCount(w, h), w, h);
+        errdefer c.glDeleteTextures(1, &texture_id);
+        errdefer GLStateCache.current().forgetTexture(texture_id);
+
+        c.glTexSubImage2D(c.GL_TEXTURE_2D, 0, 0, 0, w, h, c.GL_RGBA, c.GL_UNSIGNED_BYTE, data);
 
         // Check for upload errors
         const openglerr = c.glGetError();
@@ -177,19 +396,77 @@ pub const Texture = struct {
             return TextureError.OpenGLError;
         }
 
-        // Generate mipmaps with error checking
-        c.glGenerateMipmap(c.GL_TEXTURE_2D);
+        buildMipmaps(texture_id, w, h);
         if (c.glGetError() != c.GL_NO_ERROR) {
             return TextureError.OpenGLError;
         }
+        return texture_id;
+    }
 
-        return Texture{
-            .id = texture_id,
-            .width = w,
-            .height = h,
-            .channels = 4,  // forcing RGBA
-            .allocator = allocator,
-            .ref_count = std.atomic.Value(u32).init(1),
-        };
+
+    /// createFromPixels through direct state access, nothing gets bound until the texture is drawn with
+    fn createFromPixelsByName(w: i32, h: i32, data: [*]const u8) !c.GLuint {
+        var texture_id: c.GLuint = 0;
+        gl_ext.createTextures.?(c.GL_TEXTURE_2D, 1, @ptrCast(&texture_id));
+        if (texture_id == 0) return TextureError.OpenGLError;
+        errdefer c.glDeleteTextures(1, &texture_id);
+
+        gl_ext.textureStorage2D.?(texture_id, mipCount(w, h), c.GL_RGBA8, w, h);
+        gl_ext.textureSubImage2D.?(texture_id, 0, 0, 0, w, h, c.GL_RGBA, c.GL_UNSIGNED_BYTE, data);
+        buildMipmaps(texture_id, w, h);
+
+        const openglerr = c.glGetError();
+        if (openglerr != c.GL_NO_ERROR) {
+            std.debug.print("OpenGL error during texture upload: 0x{x}\n", .{openglerr});
+            return TextureError.OpenGLError;
+        }
+        return texture_id;
+    }
+
+
+    /// New texture name holding every stored level of `image`
+    /// Only the stored levels are allocated, so a chain that stops early never samples missing ones
+    fn uploadCompressed(image: *const CompressedImage) !c.GLuint {
+        if (image.level_count == 0) return TextureError.InvalidTextureData;
+        if (!gl_ext.supportsCompressedFormat(image.format)) return TextureError.UnsupportedCompression;
+
+        const base = image.levels[0];
+        const texture_id = try allocateStorage(image.format, @intCast(image.level_count), @intCast(base.width), @intCast(base.height));
+        errdefer c.glDeleteTextures(1, &texture_id);
+        errdefer GLStateCache.current().forgetTexture(texture_id);
+
+        for (image.mipLevels(), 0..) |level, i| {
+            if (gl_ext.texStorage2D != null) {
+                c.glCompressedTexSubImage2D(
+                    c.GL_TEXTURE_2D,
+                    @intCast(i),
+                    0,
+                    0,
+                    @intCast(level.width),
+                    @intCast(level.height),
+                    image.format,
+                    @intCast(level.data.len),
+                    level.data.ptr,
+                );
+            } else {
+                c.glCompressedTexImage2D(
+                    c.GL_TEXTURE_2D,
+                    @intCast(i),
+                    image.format,
+                    @intCast(level.width),
+                    @intCast(level.height),
+                    0,
+                    @intCast(level.data.len),
+                    level.data.ptr,
+                );
+            }
+        }
+
+        const openglerr = c.glGetError();
+        if (openglerr != c.GL_NO_ERROR) {
+            std.debug.print("OpenGL error during compressed texture upload: 0x{x}\n", .{openglerr});
+            return TextureError.OpenGLError;
+        }
+        return texture_id;
     }
 };
@@ -0,0 +1,396 @@
+// graphics/texture_atlas.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+
+const Texture = @import("texture.zig").Texture;
+const image_decode = @import("image_decode.zig");
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const sampler_cache = @import("sampler_cache.zig");
+const SamplerCache = sampler_cache.SamplerCache;
+const SamplerDesc = sampler_cache.SamplerDesc;
+
+
+pub const AtlasError = error{
+    /// No free spot is left for an image of this size
+    AtlasFull,
+    /// Empty image, pixels shorter than its size, or layers of different sizes
+    InvalidImage,
+    ImageLoadFailed,
+    OpenGLError,
+};
+
+
+/// Normalized texture coordinates of a packed image, v grows upwards like the GL texture
+pub const UvRect = struct {
+    u0: f32,
+    v0: f32,
+    u1: f32,
+    v1: f32,
+};
+
+
+/// Packs many small RGBA images into one texture with a bottom-left skyline packer
+/// Add the images at load, build once, and every material using the result shares one texture binding,
+/// so sprites and UI elements differing only in their image sort and draw together
+pub const TextureAtlas = struct {
+    const Self = @This();
+
+    /// A horizontal run of the skyline, everything below `y` is taken
+    const Segment = struct {
+        x: u32,
+        y: u32,
+        width: u32,
+    };
+
+    /// Area of one image inside the atlas, without its padding
+    const Placement = struct {
+        x: u32,
+        y: u32,
+        width: u32,
+        height: u32,
+    };
+
+    allocator: std.mem.Allocator,
+    width: u32,
+    height: u32,
+    /// Texels of edge color repeated around each image, keeps filtering and mipmaps from bleeding
+    padding: u32,
+    /// RGBA rows, bottom first
+    pixels: []u8,
+    /// Left to right, covering the full width
+    skyline: std.ArrayList(Segment),
+    placements: std.ArrayList(Placement),
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Empty `width` x `height` atlas, transparent black where nothing is packed
+    pub fn init(allocator: std.mem.Allocator, width: u32, height: u32, padding: u32) !Self {
+        if (width == 0 or height == 0) return AtlasError.InvalidImage;
+
+        const pixels = try allocator.alloc(u8, @as(usize, width) * height * 4);
+        errdefer allocator.free(pixels);
+        @memset(pixels, 0);
+
+        var skyline = std.ArrayList(Segment).init(allocator);
+        errdefer skyline.deinit();
+        try skyline.append(.{ .x = 0, .y = 0, .width = width });
+
+        return .{
+            .allocator = allocator,
+            .width = width,
+            .height = height,
+            .padding = padding,
+            .pixels = pixels,
+            .skyline = skyline,
+            .placements = std.ArrayList(Placement).init(allocator),
+        };
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Pack a `width` x `height` RGBA image, rows bottom first, and return its index for uvRect
+    pub fn add(self: *Self, width: u32, height: u32, pixels: []const u8) !usize {
+        if (width == 0 or height == 0 or pixels.len < @as(usize, width) * height * 4) return AtlasError.InvalidImage;
+
+        const padded_width = width + self.padding * 2;
+        const padded_height = height + self.padding * 2;
+
+        // Lowest spot first, leftmost among equals
+        var best_segment: ?usize = null;
+        var best_y: u32 = std.math.maxInt(u32);
+        for (0..self.skyline.items.len) |i| {
+            const y = self.fitAt(i, padded_width, padded_height) orelse continue;
+            if (y < best_y) {
+                best_y = y;
+                best_segment = i;
+            }
+        }
+        const segment = best_segment orelse return AtlasError.AtlasFull;
+        const x = self.skyline.items[segment].x;
+
+        try self.placements.ensureUnusedCapacity(1);
+        try self.raise(segment, x, best_y + padded_height, padded_width);
+
+        self.blit(x, best_y, width, height, pixels);
+        const placement = Placement{ .x = x + self.padding, .y = best_y + self.padding, .width = width, .height = height };
+        self.placements.appendAssumeCapacity(placement);
+        return self.placements.items.len - 1;
+    }
+
+
+    /// Pack an image file, flipped on load like Texture.createFromFile
+    pub fn addFile(self: *Self, path: []const u8) !usize {
+        c.stbi_set_flip_vertically_on_load(1);
+        const image = image_decode.decodeFile(path, 4) catch |decode_err| {
+            std.debug.print("STBI loading failed for {s}: {s}\n", .{ path, image_decode.failureReason(decode_err) });
+            return AtlasError.ImageLoadFailed;
+        };
+        return self.add(image.width, image.height, image.pixels);
+    }
+
+
+    /// Texture coordinates of the image `index` returned by add
+    pub fn uvRect(self: *const Self, index: usize) UvRect {
+        const placement = self.placements.items[index];
+        const inv_width = 1.0 / @as(f32, @floatFromInt(self.width));
+        const inv_height = 1.0 / @as(f32, @floatFromInt(self.height));
+        return .{
+            .u0 = @as(f32, @floatFromInt(placement.x)) * inv_width,
+            .v0 = @as(f32, @floatFromInt(placement.y)) * inv_height,
+            .u1 = @as(f32, @floatFromInt(placement.x + placement.width)) * inv_width,
+            .v1 = @as(f32, @floatFromInt(placement.y + placement.height)) * inv_height,
+        };
+    }
+
+
+    /// Upload the packed images as one texture, clamped at the edges, owned by the caller
+    /// The atlas keeps its pixels, more images can be added and built again
+    pub fn build(self: *const Self) !*Texture {
+        const texture = try Texture.createRGBA(self.allocator, @intCast(self.width), @intCast(self.height), self.pixels.ptr);
+        texture.setSampler(.{ .filter = .trilinear, .wrap = .clamp_to_edge });
+        return texture;
+    }
+
+
+    /// Fraction of the atlas covered by images and their padding
+    pub fn occupancy(self: *const Self) f32 {
+        var used: u64 = 0;
+        for (self.placements.items) |placement| {
+            used += @as(u64, placement.width + self.padding * 2) * (placement.height + self.padding * 2);
+        }
+        return @as(f32, @floatFromInt(used)) / @as(f32, @floatFromInt(@as(u64, self.width) * self.height));
+    }
+
+
+    pub fn imageCount(self: *const Self) usize {
+        return self.placements.items.len;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.allocator.free(self.pixels);
+        self.skyline.deinit();
+        self.placements.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Bottom of a `width` x `height` rectangle starting at segment `index`, null if it sticks out
+    fn fitAt(self: *const Self, index: usize, width: u32, height: u32) ?u32 {
+        const segments = self.skyline.items;
+        if (segments[index].x + width > self.width) return null;
+
+        var y: u32 = 0;
+        var remaining = width;
+        var i = index;
+        // The skyline covers the full width, so the segments never run out before `remaining` does
+        while (true) : (i += 1) {
+            y = @max(y, segments[i].y);
+            if (y + height > self.height) return null;
+            if (segments[i].width >= remaining) return y;
+            remaining -= segments[i].width;
+        }
+    }
+
+
+    /// Put a segment of `width` at height `top` in front of segment `index` and trim what it covers
+    fn raise(self: *Self, index: usize, x: u32, top: u32, width: u32) !void {
+        try self.skyline.insert(index, .{ .x = x, .y = top, .width = width });
+
+        const end = x + width;
+        const next = index + 1;
+        while (next < self.skyline.items.len) {
+            const segment = &self.skyline.items[next];
+            if (segment.x >= end) break;
+            const covered = end - segment.x;
+            if (segment.width <= covered) {
+                _ = self.skyline.orderedRemove(next);
+                continue;
+            }
+            segment.x += covered;
+            segment.width -= covered;
+            break;
+        }
+
+        // Neighbours at the same height become one segment
+        var i: usize = 0;
+        while (i + 1 < self.skyline.items.len) {
+            const items = self.skyline.items;
+            if (items[i].y == items[i + 1].y) {
+                items[i].width += items[i + 1].width;
+                _ = self.skyline.orderedRemove(i + 1);
+            } else {
+                i += 1;
+            }
+        }
+    }
+
+
+    /// Copy the image with its edge texels extended into the padding, `x`, `y` is the padded corner
+    fn blit(self: *Self, x: u32, y: u32, width: u32, height: u32, pixels: []const u8) void {
+        const padded_width = width + self.padding * 2;
+        const padded_height = height + self.padding * 2;
+
+        for (0..padded_height) |py| {
+            const sy = std.math.clamp(@as(i64, @intCast(py)) - self.padding, 0, height - 1);
+            for (0..padded_width) |px| {
+                const sx = std.math.clamp(@as(i64, @intCast(px)) - self.padding, 0, width - 1);
+                const src: usize = @intCast((sy * width + sx) * 4);
+                const dst = ((y + py) * self.width + x + px) * 4;
+                @memcpy(self.pixels[dst..][0..4], pixels[src..][0..4]);
+            }
+        }
+    }
+};
+
+
+/// Same-size RGBA images as the layers of one GL_TEXTURE_2D_ARRAY
+/// Shaders sample it with a sampler2DArray and the layer index, so draws using any layer share one binding
+pub const TextureArray = struct {
+    const Self = @This();
+
+    id: c.GLuint,
+    width: u32,
+    height: u32,
+    layer_count: u32,
+    sampler: SamplerDesc = .{},
+    allocator: std.mem.Allocator,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// One layer per entry of `layers`, each `width` x `height` RGBA pixels with rows bottom first
+    pub fn create(allocator: std.mem.Allocator, width: u32, height: u32, layers: []const []const u8) !*Self {
+        if (width == 0 or height == 0 or layers.len == 0) return AtlasError.InvalidImage;
+        for (layers) |layer| {
+            if (layer.len < @as(usize, width) * height * 4) return AtlasError.InvalidImage;
+        }
+
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+
+        var texture_id: c.GLuint = 0;
+        c.glGenTextures(1, &texture_id);
+        if (texture_id == 0) return AtlasError.OpenGLError;
+        errdefer c.glDeleteTextures(1, &texture_id);
+
+        const state = GLStateCache.current();
+        errdefer state.forgetTexture(texture_id);
+        state.bindTexture2DArray(0, texture_id);
+
+        const w: c.GLsizei = @intCast(width);
+        const h: c.GLsizei = @intCast(height);
+        const depth: c.GLsizei = @intCast(layers.len);
+        const levels: c.GLsizei = @as(c.GLsizei, std.math.log2_int(u32, @max(width, height))) + 1;
+        if (gl_ext.texStorage3D) |texStorage3D| {
+            texStorage3D(c.GL_TEXTURE_2D_ARRAY, levels, c.GL_RGBA8, w, h, depth);
+        } else {
+            c.glTexImage3D(c.GL_TEXTURE_2D_ARRAY, 0, c.GL_RGBA8, w, h, depth, 0, c.GL_RGBA, c.GL_UNSIGNED_BYTE, null);
+        }
+
+        for (layers, 0..) |layer, i| {
+            c.glTexSubImage3D(c.GL_TEXTURE_2D_ARRAY, 0, 0, 0, @intCast(i), w, h, 1, c.GL_RGBA, c.GL_UNSIGNED_BYTE, layer.ptr);
+        }
+        c.glGenerateMipmap(c.GL_TEXTURE_2D_ARRAY);
+
+        const openglerr = c.glGetError();
+        if (openglerr != c.GL_NO_ERROR) {
+            std.debug.print("OpenGL error during texture array upload: 0x{x}\n", .{openglerr});
+            return AtlasError.OpenGLError;
+        }
+
+        self.* = .{
+            .id = texture_id,
+            .width = width,
+            .height = height,
+            .layer_count = @intCast(layers.len),
+            .allocator = allocator,
+        };
+        return self;
+    }
+
+
+    /// One layer per image file in `paths`, which all have to be the same size
+    pub fn createFromFiles(allocator: std.mem.Allocator, paths: []const []const u8) !*Self {
+        if (paths.len == 0) return AtlasError.InvalidImage;
+
+        const images = try allocator.alloc([]const u8, paths.len);
+        defer allocator.free(images);
+        var loaded: usize = 0;
+        defer for (images[0..loaded]) |image| c.stbi_image_free(@constCast(image.ptr));
+
+        c.stbi_set_flip_vertically_on_load(1);
+        var width: i32 = 0;
+        var height: i32 = 0;
+        for (paths) |path| {
+            const c_path = try allocator.dupeZ(u8, path);
+            defer allocator.free(c_path);
+
+            var w: i32 = 0;
+            var h: i32 = 0;
+            var n: i32 = 0;
+            const data = c.stbi_load(c_path.ptr, &w, &h, &n, 4) orelse {
+                std.debug.print("STBI loading failed for {s}: {s}\n", .{ path, c.stbi_failure_reason() });
+                return AtlasError.ImageLoadFailed;
+            };
+            images[loaded] = data[0 .. @as(usize, @intCast(w)) * @as(usize, @intCast(h)) * 4];
+            loaded += 1;
+
+            if (loaded == 1) {
+                width = w;
+                height = h;
+            } else if (w != width or h != height) {
+                std.debug.print("Texture array layer {s} is {d}x{d}, expected {d}x{d}\n", .{ path, w, h, width, height });
+                return AtlasError.InvalidImage;
+            }
+        }
+
+        return create(allocator, @intCast(width), @intCast(height), images);
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    pub fn setSampler(self: *Self, desc: SamplerDesc) void {
+        self.sampler = desc;
+    }
+
+
+    /// Bind the array and its sampler to `unit`
+    pub fn bind(self: *Self, unit: u32) void {
+        const state = GLStateCache.current();
+        state.bindTexture2DArray(unit, self.id);
+        state.bindSampler(unit, SamplerCache.shared().get(self.sampler));
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn destroy(self: *Self) void {
+        GLStateCache.current().forgetTexture(self.id);
+        c.glDeleteTextures(1, &self.id);
+        err.checkGLError("TextureArray: glDeleteTextures");
+        self.allocator.destroy(self);
+    }
+};
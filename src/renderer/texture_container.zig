@@ -0,0 +1,218 @@
+// graphics/texture_container.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+
+
+pub const TextureContainerError = error{
+    /// Neither a DDS nor a KTX2 file, or a header field is out of range
+    InvalidContainer,
+    /// A block format, cube map, array or supercompression this loader doesn't handle
+    UnsupportedFormat,
+    /// A mip level reaches past the end of the file
+    TruncatedData,
+};
+
+
+/// One mip level inside the container bytes
+pub const MipLevel = struct {
+    width: u32,
+    height: u32,
+    data: []const u8,
+};
+
+
+/// Block-compressed 2D image with its stored mip chain, slices borrow the container bytes
+pub const CompressedImage = struct {
+    pub const max_levels = 16;
+
+    /// GL internal format for glCompressedTexImage2D
+    format: c.GLenum,
+    levels: [max_levels]MipLevel = undefined,
+    level_count: u32 = 0,
+
+    pub fn mipLevels(self: *const CompressedImage) []const MipLevel {
+        return self.levels[0..self.level_count];
+    }
+};
+
+
+/// True for file names the compressed path loads, DDS and KTX2
+pub fn isContainerPath(path: []const u8) bool {
+    const extension = std.fs.path.extension(path);
+    return std.ascii.eqlIgnoreCase(extension, ".dds") or std.ascii.eqlIgnoreCase(extension, ".ktx2");
+}
+
+
+/// Parse a DDS or KTX2 file, told apart by their magic bytes
+pub fn parse(bytes: []const u8) !CompressedImage {
+    if (std.mem.startsWith(u8, bytes, &ktx2_identifier)) return parseKtx2(bytes);
+    if (std.mem.startsWith(u8, bytes, "DDS ")) return parseDds(bytes);
+    return TextureContainerError.InvalidContainer;
+}
+
+
+/// DDS with a legacy FourCC (DXT1, DXT3, DXT5, ATI1, ATI2) or a DX10 header naming a BC format
+pub fn parseDds(bytes: []const u8) !CompressedImage {
+    if (bytes.len < 128 or !std.mem.eql(u8, bytes[0..4], "DDS ")) return TextureContainerError.InvalidContainer;
+    if (read(u32, bytes, 4) != 124) return TextureContainerError.InvalidContainer;
+
+    const height = read(u32, bytes, 12);
+    const width = read(u32, bytes, 16);
+    const mip_count = @max(read(u32, bytes, 28), 1);
+    const pixel_format_flags = read(u32, bytes, 80);
+    const four_cc = bytes[84..88];
+
+    // DDPF_FOURCC, uncompressed DDS files go through stb_image
+    if (pixel_format_flags & 0x4 == 0) return TextureContainerError.UnsupportedFormat;
+
+    var data_offset: usize = 128;
+    const format: c.GLenum = if (std.mem.eql(u8, four_cc, "DX10")) blk: {
+        if (bytes.len < 148) return TextureContainerError.InvalidContainer;
+        data_offset = 148;
+        // Only single 2D textures, TEXTURE2D is resource dimension 3
+        if (read(u32, bytes, 132) != 3 or read(u32, bytes, 140) > 1) return TextureContainerError.UnsupportedFormat;
+        break :blk try formatFromDxgi(read(u32, bytes, 128));
+    } else try formatFromFourCC(four_cc);
+
+    return buildChain(format, width, height, mip_count, bytes, data_offset);
+}
+
+
+/// KTX2 without supercompression holding a BC or ASTC 4x4 format
+pub fn parseKtx2(bytes: []const u8) !CompressedImage {
+    if (bytes.len < 80 or !std.mem.startsWith(u8, bytes, &ktx2_identifier)) return TextureContainerError.InvalidContainer;
+
+    const vk_format = read(u32, bytes, 12);
+    const width = read(u32, bytes, 20);
+    const height = read(u32, bytes, 24);
+    const depth = read(u32, bytes, 28);
+    const layer_count = read(u32, bytes, 32);
+    const face_count = read(u32, bytes, 36);
+    const level_count = @max(read(u32, bytes, 40), 1);
+    const supercompression = read(u32, bytes, 44);
+
+    if (depth > 1 or layer_count > 1 or face_count != 1) return TextureContainerError.UnsupportedFormat;
+    // Basis Universal and zstd need a transcoder
+    if (supercompression != 0) return TextureContainerError.UnsupportedFormat;
+    if (level_count > CompressedImage.max_levels or height == 0) return TextureContainerError.InvalidContainer;
+
+    var image = CompressedImage{ .format = try formatFromVulkan(vk_format) };
+    const block_bytes = blockBytes(image.format);
+
+    // The level index follows the header, level 0 is the largest
+    if (bytes.len < 80 + level_count * 24) return TextureContainerError.TruncatedData;
+    for (0..level_count) |level| {
+        const entry = 80 + level * 24;
+        const offset = read(u64, bytes, entry);
+        const length = read(u64, bytes, entry + 8);
+        if (offset + length > bytes.len) return TextureContainerError.TruncatedData;
+
+        const w = @max(width >> @intCast(level), 1);
+        const h = @max(height >> @intCast(level), 1);
+        if (length < levelSize(w, h, block_bytes)) return TextureContainerError.TruncatedData;
+
+        image.levels[level] = .{ .width = w, .height = h, .data = bytes[@intCast(offset)..][0..levelSize(w, h, block_bytes)] };
+    }
+    image.level_count = level_count;
+    return image;
+}
+
+
+/// Bytes of one 4x4 block
+pub fn blockBytes(format: c.GLenum) usize {
+    return switch (format) {
+        gl_ext.GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,
+        gl_ext.GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT,
+        gl_ext.GL_COMPRESSED_RED_RGTC1,
+        => 8,
+        else => 16,
+    };
+}
+
+
+/// Bytes of a `width` x `height` level in 4x4 blocks
+pub fn levelSize(width: u32, height: u32, block_bytes: usize) usize {
+    return @as(usize, (width + 3) / 4) * ((height + 3) / 4) * block_bytes;
+}
+
+
+// ============================================================
+// Private: Helper Functions
+// ============================================================
+
+const ktx2_identifier = [12]u8{ 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+
+fn read(comptime T: type, bytes: []const u8, offset: usize) T {
+    return std.mem.readInt(T, bytes[offset..][0..@sizeOf(T)], .little);
+}
+
+
+/// Levels stored back to back from `offset`, largest first, as DDS does
+fn buildChain(format: c.GLenum, width: u32, height: u32, mip_count: u32, bytes: []const u8, offset: usize) !CompressedImage {
+    if (width == 0 or height == 0) return TextureContainerError.InvalidContainer;
+
+    var image = CompressedImage{ .format = format };
+    const block_bytes = blockBytes(format);
+
+    var cursor = offset;
+    for (0..@min(mip_count, CompressedImage.max_levels)) |level| {
+        const w = @max(width >> @intCast(level), 1);
+        const h = @max(height >> @intCast(level), 1);
+        const size = levelSize(w, h, block_bytes);
+        if (cursor + size > bytes.len) return TextureContainerError.TruncatedData;
+
+        image.levels[level] = .{ .width = w, .height = h, .data = bytes[cursor..][0..size] };
+        image.level_count += 1;
+        cursor += size;
+        if (w == 1 and h == 1) break;
+    }
+    return image;
+}
+
+
+fn formatFromFourCC(four_cc: []const u8) !c.GLenum {
+    if (std.mem.eql(u8, four_cc, "DXT1")) return gl_ext.GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    if (std.mem.eql(u8, four_cc, "DXT3")) return gl_ext.GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+    if (std.mem.eql(u8, four_cc, "DXT5")) return gl_ext.GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    if (std.mem.eql(u8, four_cc, "ATI1") or std.mem.eql(u8, four_cc, "BC4U")) return gl_ext.GL_COMPRESSED_RED_RGTC1;
+    if (std.mem.eql(u8, four_cc, "ATI2") or std.mem.eql(u8, four_cc, "BC5U")) return gl_ext.GL_COMPRESSED_RG_RGTC2;
+    return TextureContainerError.UnsupportedFormat;
+}
+
+
+fn formatFromDxgi(dxgi: u32) !c.GLenum {
+    return switch (dxgi) {
+        71 => gl_ext.GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,
+        72 => gl_ext.GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT,
+        74 => gl_ext.GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,
+        75 => gl_ext.GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT,
+        77 => gl_ext.GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+        78 => gl_ext.GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT,
+        80 => gl_ext.GL_COMPRESSED_RED_RGTC1,
+        83 => gl_ext.GL_COMPRESSED_RG_RGTC2,
+        98 => gl_ext.GL_COMPRESSED_RGBA_BPTC_UNORM,
+        99 => gl_ext.GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM,
+        else => TextureContainerError.UnsupportedFormat,
+    };
+}
+
+
+fn formatFromVulkan(vk_format: u32) !c.GLenum {
+    return switch (vk_format) {
+        131, 133 => gl_ext.GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,
+        132, 134 => gl_ext.GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT,
+        135 => gl_ext.GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,
+        136 => gl_ext.GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT,
+        137 => gl_ext.GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+        138 => gl_ext.GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT,
+        139 => gl_ext.GL_COMPRESSED_RED_RGTC1,
+        141 => gl_ext.GL_COMPRESSED_RG_RGTC2,
+        145 => gl_ext.GL_COMPRESSED_RGBA_BPTC_UNORM,
+        146 => gl_ext.GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM,
+        157 => gl_ext.GL_COMPRESSED_RGBA_ASTC_4x4_KHR,
+        158 => gl_ext.GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR,
+        else => TextureContainerError.UnsupportedFormat,
+    };
+}
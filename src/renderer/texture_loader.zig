@@ -0,0 +1,279 @@
+// graphics/texture_loader.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+const profiler = @import("../core/profiler.zig");
+
+const Texture = @import("texture.zig").Texture;
+const texture_container = @import("texture_container.zig");
+const DynamicBuffer = @import("dynamic_buffer.zig").DynamicBuffer;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+
+
+/// Decodes image files on worker threads and uploads them into placeholder textures on the main thread
+/// load returns at once, uploadFinished drains the decoded images under a time budget every frame
+/// With a staging ring the pixels go through pixel buffer objects, so the driver copies them while the
+/// GPU keeps rendering, and images larger than one ring region arrive in bands of rows over several frames
+pub const TextureLoader = struct {
+    const Self = @This();
+
+    /// One file in flight, owned by the loader until uploaded
+    const Job = struct {
+        /// Holds a reference until the upload, releasing the texture early is fine
+        texture: *Texture,
+        path: [:0]u8,
+
+        width: i32 = 0,
+        height: i32 = 0,
+        /// RGBA pixels from stbi_load, null when decoding failed
+        pixels: ?[*]u8 = null,
+        /// Whole file of a DDS or KTX2 container, from container_allocator, uploaded as stored
+        container: ?[]u8 = null,
+
+        /// Texture the staged rows go into, handed to `texture` once complete, 0 before the first band
+        staging_texture: c.GLuint = 0,
+        rows_uploaded: i32 = 0,
+    };
+
+    /// Thread safe, workers read compressed containers with it
+    const container_allocator = std.heap.page_allocator;
+
+    allocator: std.mem.Allocator,
+    pool: *JobSystem,
+    /// Every decode spawned and not yet finished
+    wait_group: std.Thread.WaitGroup = .{},
+
+    /// Decoded jobs in completion order, pushed by workers
+    mutex: std.Thread.Mutex = .{},
+    finished: std.ArrayList(*Job),
+    /// Jobs taken off `finished` but not uploaded yet, main thread only
+    ready: std.ArrayList(*Job),
+    /// Loads started and not uploaded yet
+    pending_count: usize = 0,
+    /// Pixel buffer ring uploads are staged through, null to upload from client memory
+    staging: ?DynamicBuffer = null,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Workers only allocate container files, load reserves every slot they fill, the loader must not move while loads run
+    pub fn init(allocator: std.mem.Allocator, pool: *JobSystem) Self {
+        return .{
+            .allocator = allocator,
+            .pool = pool,
+            .finished = std.ArrayList(*Job).init(allocator),
+            .ready = std.ArrayList(*Job).init(allocator),
+        };
+    }
+
+
+    /// Stage uploads through a ring of pixel buffer regions of `region_size` bytes, about one frame's worth
+    /// Persistently mapped with ARB_buffer_storage, filled with glBufferSubData otherwise
+    pub fn enableStaging(self: *Self, region_size: usize) !void {
+        if (self.staging) |*staging| staging.deinit();
+        self.staging = null;
+        self.staging = try DynamicBuffer.init(region_size);
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Decode `path` in the background and upload it into `texture`, usually a Texture.createPlaceholder
+    pub fn load(self: *Self, texture: *Texture, path: []const u8) !void {
+        const owned_path = try self.allocator.dupeZ(u8, path);
+        errdefer self.allocator.free(owned_path);
+        const job = try self.allocator.create(Job);
+        errdefer self.allocator.destroy(job);
+        job.* = .{ .texture = texture, .path = owned_path };
+
+        // Reserve the slots now so a worker never fails to report a finished job
+        try self.ready.ensureTotalCapacity(self.pending_count + 1);
+        {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            try self.finished.ensureTotalCapacity(self.pending_count + 1);
+        }
+
+        // The flag is global, every decode uses the same value
+        c.stbi_set_flip_vertically_on_load(1);
+
+        texture.addRef();
+        self.pending_count += 1;
+        self.pool.spawnWg(&self.wait_group, decode, .{ self, job });
+    }
+
+
+    /// Upload decoded images until `budget_ns` nanoseconds have passed, at least one if any is ready
+    /// When staging, uploading also stops once the frame's ring region is full
+    /// Call once per frame on the thread owning the GL context, returns the number completed
+    pub fn uploadFinished(self: *Self, budget_ns: u64) usize {
+        const zone = profiler.zone("TextureLoader.uploadFinished");
+        defer zone.end();
+
+        {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            self.ready.appendSliceAssumeCapacity(self.finished.items);
+            self.finished.clearRetainingCapacity();
+        }
+
+        if (self.staging) |*staging| staging.beginFrame();
+        defer if (self.staging) |*staging| staging.endFrame();
+
+        const start = std.time.nanoTimestamp();
+        var uploaded: usize = 0;
+        while (uploaded < self.ready.items.len) {
+            const job = self.ready.items[uploaded];
+            if (self.staging) |*staging| {
+                // The region is full, the rest of the image follows next frame
+                if (!self.stage(staging, job)) break;
+            } else {
+                self.upload(job);
+            }
+            uploaded += 1;
+
+            if (std.time.nanoTimestamp() - start >= budget_ns) break;
+        }
+
+        // Keep the rest in completion order
+        std.mem.copyForwards(*Job, self.ready.items, self.ready.items[uploaded..]);
+        self.ready.shrinkRetainingCapacity(self.ready.items.len - uploaded);
+        return uploaded;
+    }
+
+
+    /// Loads started and not uploaded yet
+    pub fn pendingCount(self: *const Self) usize {
+        return self.pending_count;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Waits for the running decodes, drops what was not uploaded and releases the texture references
+    pub fn deinit(self: *Self) void {
+        self.pool.waitAndWork(&self.wait_group);
+
+        for (self.ready.items) |job| self.freeJob(job);
+        for (self.finished.items) |job| self.freeJob(job);
+        self.ready.deinit();
+        self.finished.deinit();
+        if (self.staging) |*staging| staging.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Worker entry, stbi_load or reading the container is the only work done off the main thread
+    fn decode(self: *Self, job: *Job) void {
+        const zone = profiler.zone("TextureLoader.decode");
+        defer zone.end();
+
+        if (texture_container.isContainerPath(job.path)) {
+            job.container = std.fs.cwd().readFileAlloc(container_allocator, job.path, std.math.maxInt(u32)) catch null;
+        } else {
+            var channels: i32 = 0;
+            job.pixels = c.stbi_load(job.path.ptr, &job.width, &job.height, &channels, 4);
+        }
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.finished.appendAssumeCapacity(job);
+    }
+
+
+    fn upload(self: *Self, job: *Job) void {
+        defer self.freeJob(job);
+
+        // Nobody else holds the texture any more, skip the upload
+        if (job.texture.ref_count.load(.monotonic) == 1) return;
+
+        // Compressed mip chains are small and go up in one piece, staged or not
+        if (job.container) |bytes| {
+            const image = texture_container.parse(bytes) catch |e| {
+                std.debug.print("Texture container {s} rejected: {s}\n", .{ job.path, @errorName(e) });
+                return;
+            };
+            job.texture.uploadCompressedImage(&image) catch |e| {
+                std.debug.print("Texture upload failed for {s}: {s}\n", .{ job.path, @errorName(e) });
+            };
+            return;
+        }
+
+        const pixels = job.pixels orelse {
+            std.debug.print("STBI loading failed for {s}, keeping the placeholder\n", .{job.path});
+            return;
+        };
+        job.texture.uploadRGBA(job.width, job.height, pixels) catch |e| {
+            std.debug.print("Texture upload failed for {s}: {s}\n", .{ job.path, @errorName(e) });
+        };
+    }
+
+
+    /// Copy as many rows of `job` as the region holds and upload them from the pixel buffer
+    /// Returns true once the job is done and freed, false when the region ran out first
+    fn stage(self: *Self, staging: *DynamicBuffer, job: *Job) bool {
+        const row_bytes: usize = @as(usize, @intCast(job.width)) * 4;
+
+        // Nobody else holds the texture any more, there is nothing to upload, or a row never fits a region
+        if (job.texture.ref_count.load(.monotonic) == 1 or job.pixels == null or row_bytes > staging.region_size) {
+            self.upload(job);
+            return true;
+        }
+        const pixels = job.pixels.?;
+
+        if (job.staging_texture == 0) {
+            job.staging_texture = Texture.createStorage(job.width, job.height) catch |e| {
+                std.debug.print("Texture upload failed for {s}: {s}\n", .{ job.path, @errorName(e) });
+                self.freeJob(job);
+                return true;
+            };
+        }
+
+        const rows_left: usize = @intCast(job.height - job.rows_uploaded);
+        const rows = @min(staging.remaining() / row_bytes, rows_left);
+        if (rows == 0) return false;
+
+        const first_byte = @as(usize, @intCast(job.rows_uploaded)) * row_bytes;
+        const offset = staging.write(pixels[first_byte..][0 .. rows * row_bytes], 4) catch return false;
+
+        // Offsets into the bound pixel unpack buffer take the place of the client pointer
+        GLStateCache.current().bindTexture2D(0, job.staging_texture);
+        c.glBindBuffer(c.GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+        c.glTexSubImage2D(c.GL_TEXTURE_2D, 0, 0, job.rows_uploaded, job.width, @intCast(rows), c.GL_RGBA, c.GL_UNSIGNED_BYTE, @ptrFromInt(offset));
+        c.glBindBuffer(c.GL_PIXEL_UNPACK_BUFFER, 0);
+        err.checkGLError("TextureLoader: glTexSubImage2D from pixel buffer");
+
+        job.rows_uploaded += @intCast(rows);
+        if (job.rows_uploaded < job.height) return false;
+
+        Texture.buildMipmaps(job.staging_texture, job.width, job.height);
+        job.texture.adopt(job.staging_texture, job.width, job.height);
+        job.staging_texture = 0;
+        self.freeJob(job);
+        return true;
+    }
+
+
+    fn freeJob(self: *Self, job: *Job) void {
+        if (job.staging_texture != 0) {
+            GLStateCache.current().forgetTexture(job.staging_texture);
+            c.glDeleteTextures(1, &job.staging_texture);
+        }
+        if (job.pixels) |pixels| c.stbi_image_free(pixels);
+        if (job.container) |bytes| container_allocator.free(bytes);
+        _ = job.texture.release();
+        self.allocator.free(job.path);
+        self.allocator.destroy(job);
+        self.pending_count -= 1;
+    }
+};
@@ -0,0 +1,326 @@
+// graphics/texture_streamer.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const Texture = @import("texture.zig").Texture;
+const image_decode = @import("image_decode.zig");
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+
+
+pub const TextureStreamerError = error{
+    ImageLoadFailed,
+    InvalidTextureData,
+};
+
+
+/// Residency of every streamed texture after the last update
+pub const StreamingStats = struct {
+    texture_count: usize = 0,
+    /// Video memory the resident levels take
+    resident_bytes: usize = 0,
+    /// Video memory the requested levels would take without a budget
+    requested_bytes: usize = 0,
+    budget_bytes: usize = 0,
+    /// Levels dropped in the last update to stay within the budget
+    evicted_levels: usize = 0,
+    /// Textures reallocated with finer levels in the last update
+    upgraded_textures: usize = 0,
+};
+
+
+/// Keeps only the mip levels a texture is drawn with in video memory
+/// Streamed textures keep their whole decoded mip chain in system memory and start out with their
+/// coarse levels. request records the finest level draws need, from the size on screen, and update
+/// reallocates each texture to its wanted chain, dropping the finest levels of the least recently
+/// used textures first while the total is over the budget
+/// Texture.width and height are the resident size, UVs are unaffected as the levels stay the same images
+pub const TextureStreamer = struct {
+    const Self = @This();
+
+    /// Levels at most this size are resident from the start
+    pub const default_initial_size = 64;
+    pub const default_max_upgrades_per_update = 4;
+
+    const Entry = struct {
+        /// Holds a reference until the streamer is deinitialized
+        texture: *Texture,
+        /// RGBA rows bottom first, level 0 is the full image
+        mips: [][]u8,
+        width: u32,
+        height: u32,
+        /// Finest level in video memory
+        resident_level: u32,
+        /// Finest level requested since the last update
+        requested_level: u32,
+        /// Update count of the last request
+        last_used: u64 = 0,
+        /// Finest level the next reallocation uploads, chosen by update
+        wanted_level: u32 = 0,
+
+        fn coarsest(self: *const Entry) u32 {
+            return @intCast(self.mips.len - 1);
+        }
+    };
+
+    allocator: std.mem.Allocator,
+    budget_bytes: usize,
+    /// Levels at most this many texels wide and high are resident when a texture is created
+    initial_size: u32 = default_initial_size,
+    /// Textures gaining levels per update, eviction is never limited
+    max_upgrades_per_update: usize = default_max_upgrades_per_update,
+
+    entries: std.ArrayList(*Entry),
+    lookup: std.AutoHashMap(*Texture, *Entry),
+    /// Number of updates so far
+    frame: u64 = 1,
+    stats: StreamingStats = .{},
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Keep the streamed textures within `budget_bytes` of video memory
+    pub fn init(allocator: std.mem.Allocator, budget_bytes: usize) Self {
+        return .{
+            .allocator = allocator,
+            .budget_bytes = budget_bytes,
+            .entries = std.ArrayList(*Entry).init(allocator),
+            .lookup = std.AutoHashMap(*Texture, *Entry).init(allocator),
+        };
+    }
+
+
+    /// Decode `path`, build its mip chain and upload the coarse levels, in the argument order
+    /// ResourceCollection.createResource calls with. The streamer keeps a reference
+    pub fn createTexture(allocator: std.mem.Allocator, self: *Self, path: []const u8) !*Texture {
+        c.stbi_set_flip_vertically_on_load(1);
+        const image = image_decode.decodeFile(path, 4) catch |decode_err| {
+            std.debug.print("STBI loading failed for {s}: {s}\n", .{ path, image_decode.failureReason(decode_err) });
+            return TextureStreamerError.ImageLoadFailed;
+        };
+
+        const width = image.width;
+        const height = image.height;
+        const mips = try buildMips(self.allocator, image.pixels, width, height);
+        errdefer freeMips(self.allocator, mips);
+
+        const entry = try self.allocator.create(Entry);
+        errdefer self.allocator.destroy(entry);
+        entry.* = .{
+            .texture = undefined,
+            .mips = mips,
+            .width = width,
+            .height = height,
+            .resident_level = 0,
+            .requested_level = 0,
+        };
+
+        var start: u32 = 0;
+        while (start < entry.coarsest() and (levelWidth(entry, start) > self.initial_size or levelHeight(entry, start) > self.initial_size)) start += 1;
+        entry.resident_level = start;
+        entry.requested_level = start;
+        entry.wanted_level = start;
+
+        const id = try upload(entry, start);
+        errdefer {
+            GLStateCache.current().forgetTexture(id);
+            c.glDeleteTextures(1, &id);
+        }
+        const texture = try Texture.createFromId(allocator, id, @intCast(levelWidth(entry, start)), @intCast(levelHeight(entry, start)));
+        errdefer allocator.destroy(texture);
+        entry.texture = texture;
+
+        try self.entries.ensureUnusedCapacity(1);
+        try self.lookup.put(texture, entry);
+        self.entries.appendAssumeCapacity(entry);
+        texture.addRef();
+        return texture;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Ask for the level a draw of `texture` covering about `screen_pixels` pixels across needs
+    /// Textures the streamer doesn't own are ignored, so every drawn material can be passed
+    pub fn request(self: *Self, texture: *Texture, screen_pixels: f32) void {
+        const entry = self.lookup.get(texture) orelse return;
+
+        const size: f32 = @floatFromInt(@max(entry.width, entry.height));
+        const ratio = size / @max(screen_pixels, 1.0);
+        const level: u32 = if (ratio <= 1.0) 0 else @intFromFloat(@min(@floor(std.math.log2(ratio)), @as(f32, @floatFromInt(entry.coarsest()))));
+
+        if (entry.last_used != self.frame) {
+            entry.requested_level = level;
+            entry.last_used = self.frame;
+        } else {
+            entry.requested_level = @min(entry.requested_level, level);
+        }
+    }
+
+
+    /// Apply the requests since the last call under the budget, call once per frame after drawing
+    pub fn update(self: *Self) !void {
+        var stats = StreamingStats{ .texture_count = self.entries.items.len, .budget_bytes = self.budget_bytes };
+
+        // Textures nobody drew this frame keep what they have until the budget needs it
+        var total: usize = 0;
+        for (self.entries.items) |entry| {
+            entry.wanted_level = if (entry.last_used == self.frame) entry.requested_level else entry.resident_level;
+            total += chainBytes(entry, entry.wanted_level);
+        }
+        stats.requested_bytes = total;
+
+        // Drop the finest wanted level of the longest unused texture, the biggest one among equals
+        while (total > self.budget_bytes) {
+            var victim: ?*Entry = null;
+            for (self.entries.items) |entry| {
+                if (entry.wanted_level == entry.coarsest()) continue;
+                const candidate = victim orelse {
+                    victim = entry;
+                    continue;
+                };
+                if (entry.last_used < candidate.last_used or
+                    (entry.last_used == candidate.last_used and entry.wanted_level < candidate.wanted_level))
+                {
+                    victim = entry;
+                }
+            }
+            const entry = victim orelse break;
+            total -= levelBytes(entry, entry.wanted_level);
+            entry.wanted_level += 1;
+            stats.evicted_levels += 1;
+        }
+
+        for (self.entries.items) |entry| {
+            if (entry.wanted_level < entry.resident_level) {
+                // Keep the coarse copy until the upgrade budget of a later frame reaches it
+                if (stats.upgraded_textures == self.max_upgrades_per_update) {
+                    entry.wanted_level = entry.resident_level;
+                } else {
+                    stats.upgraded_textures += 1;
+                }
+            }
+            if (entry.wanted_level != entry.resident_level) {
+                const id = try upload(entry, entry.wanted_level);
+                entry.texture.adopt(id, @intCast(levelWidth(entry, entry.wanted_level)), @intCast(levelHeight(entry, entry.wanted_level)));
+                entry.resident_level = entry.wanted_level;
+            }
+            stats.resident_bytes += chainBytes(entry, entry.resident_level);
+        }
+
+        self.stats = stats;
+        self.frame += 1;
+    }
+
+
+    pub fn getStats(self: *const Self) StreamingStats {
+        return self.stats;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Frees the system memory copies and releases the texture references
+    pub fn deinit(self: *Self) void {
+        for (self.entries.items) |entry| {
+            freeMips(self.allocator, entry.mips);
+            _ = entry.texture.release();
+            self.allocator.destroy(entry);
+        }
+        self.entries.deinit();
+        self.lookup.deinit();
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn levelWidth(entry: *const Entry, level: u32) u32 {
+        return @max(entry.width >> @intCast(level), 1);
+    }
+
+
+    fn levelHeight(entry: *const Entry, level: u32) u32 {
+        return @max(entry.height >> @intCast(level), 1);
+    }
+
+
+    fn levelBytes(entry: *const Entry, level: u32) usize {
+        return entry.mips[level].len;
+    }
+
+
+    /// Video memory of the chain from `first` down to 1x1
+    fn chainBytes(entry: *const Entry, first: u32) usize {
+        var total: usize = 0;
+        for (entry.mips[first..]) |mip| total += mip.len;
+        return total;
+    }
+
+
+    /// New texture name holding the levels from `first` down, from the system memory copies
+    fn upload(entry: *const Entry, first: u32) !c.GLuint {
+        const id = try Texture.createStorage(@intCast(levelWidth(entry, first)), @intCast(levelHeight(entry, first)));
+        for (entry.mips[first..], 0..) |mip, i| {
+            const level: u32 = first + @as(u32, @intCast(i));
+            c.glTexSubImage2D(c.GL_TEXTURE_2D, @intCast(i), 0, 0, @intCast(levelWidth(entry, level)), @intCast(levelHeight(entry, level)), c.GL_RGBA, c.GL_UNSIGNED_BYTE, mip.ptr);
+        }
+        err.checkGLError("TextureStreamer: glTexSubImage2D");
+        return id;
+    }
+
+
+    /// Every level down to 1x1 of an RGBA image, each box filtered from the one before
+    fn buildMips(allocator: std.mem.Allocator, pixels: []const u8, width: u32, height: u32) ![][]u8 {
+        const count = std.math.log2_int(u32, @max(width, height)) + 1;
+        const mips = try allocator.alloc([]u8, count);
+        var built: usize = 0;
+        errdefer {
+            for (mips[0..built]) |mip| allocator.free(mip);
+            allocator.free(mips);
+        }
+
+        mips[0] = try allocator.dupe(u8, pixels);
+        built = 1;
+        var w = width;
+        var h = height;
+        while (built < count) : (built += 1) {
+            const next_w = @max(w / 2, 1);
+            const next_h = @max(h / 2, 1);
+            const src = mips[built - 1];
+            const dst = try allocator.alloc(u8, @as(usize, next_w) * next_h * 4);
+
+            for (0..next_h) |y| {
+                for (0..next_w) |x| {
+                    var sum = [4]u32{ 0, 0, 0, 0 };
+                    for (0..2) |dy| {
+                        for (0..2) |dx| {
+                            // Odd sizes and 1 texel wide levels repeat their last row or column
+                            const sx = @min(x * 2 + dx, w - 1);
+                            const sy = @min(y * 2 + dy, h - 1);
+                            for (&sum, src[(sy * w + sx) * 4 ..][0..4]) |*s, v| s.* += v;
+                        }
+                    }
+                    for (dst[(y * next_w + x) * 4 ..][0..4], sum) |*d, s| d.* = @intCast((s + 2) / 4);
+                }
+            }
+            mips[built] = dst;
+            w = next_w;
+            h = next_h;
+        }
+        return mips;
+    }
+
+
+    fn freeMips(allocator: std.mem.Allocator, mips: [][]u8) void {
+        for (mips) |mip| allocator.free(mip);
+        allocator.free(mips);
+    }
+};
@@ -0,0 +1,239 @@
+// graphics/transparency.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const Shader = @import("shader.zig").Shader;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+
+
+pub const TransparencyError = error{
+    /// The accumulation framebuffer is incomplete
+    IncompleteFramebuffer,
+};
+
+
+/// How Renderer.drawQueue blends the transparent pass
+pub const TransparencyMode = enum {
+    /// Every instance drawn back to front with alpha blending, exact as long as surfaces don't intersect
+    sorted,
+    /// Weighted blended order independent transparency, no ordering but an approximation of the result
+    /// Shaders opt in with transparency_glsl, transparent items of other shaders are drawn sorted after it
+    weighted_blended,
+};
+
+
+/// Fragment shader helper of the weighted blended pass, `outputColor` turns the straight alpha color into
+/// what the bound pass expects: the color itself normally, or its weighted contribution while `oitPass` is set
+/// The weight goes to output location 1, so the color output has to be declared at location 0
+pub const transparency_glsl =
+    \\uniform bool oitPass;
+    \\layout (location = 1) out vec4 oitWeight;
+    \\vec4 outputColor(vec4 color) {
+    \\    if (!oitPass) { oitWeight = vec4(0.0); return color; }
+    \\    float w = color.a * clamp(3e3 * pow(1.0 - gl_FragCoord.z, 3.0), 1e-2, 3e3);
+    \\    oitWeight = vec4(w);
+    \\    return vec4(color.rgb * w, color.a);
+    \\}
+    \\
+;
+
+
+/// Accumulation targets of weighted blended transparency and the composite over the scene
+/// The RGBA16F accumulation sums weighted colors in rgb and multiplies 1 - alpha into its alpha, the R16F
+/// target sums the weights. Depth is copied from the framebuffer drawn into so opaque geometry still hides
+/// what is behind it, and the composite divides the color by the weights and blends it over that framebuffer
+pub const WeightedBlendedTarget = struct {
+    const Self = @This();
+
+    const composite_vertex =
+        \\#version 330 core
+        \\void main() {
+        \\    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        \\    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+        \\}
+    ;
+    const composite_fragment =
+        \\#version 330 core
+        \\uniform sampler2D accumulation;
+        \\uniform sampler2D weights;
+        \\out vec4 color;
+        \\void main() {
+        \\    ivec2 texel = ivec2(gl_FragCoord.xy);
+        \\    vec4 sum = texelFetch(accumulation, texel, 0);
+        \\    float revealage = sum.a;
+        \\    if (revealage >= 1.0) discard;
+        \\    color = vec4(sum.rgb / max(texelFetch(weights, texel, 0).r, 1e-5), 1.0 - revealage);
+        \\}
+    ;
+
+    width: u32 = 0,
+    height: u32 = 0,
+
+    fbo: c.GLuint = 0,
+    accumulation: c.GLuint = 0,
+    weights: c.GLuint = 0,
+    /// DEPTH24_STENCIL8 like RenderTarget and the default framebuffer, so the scene depth blits into it
+    depth_renderbuffer: c.GLuint = 0,
+
+    program: c.GLuint = 0,
+    /// Attribute-less VAO for the fullscreen triangle
+    vao: c.GLuint = 0,
+
+    /// Framebuffer the scene is drawn into, composited over by end
+    scene_fbo: c.GLuint = 0,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    pub fn init(width: u32, height: u32) !Self {
+        var self = Self{};
+        // Also deletes the program, names not generated yet are 0 and ignored
+        errdefer self.deinit();
+
+        self.program = try Shader.createProgram(composite_vertex, composite_fragment);
+        const state = GLStateCache.current();
+        state.useProgram(self.program);
+        c.glUniform1i(c.glGetUniformLocation(self.program, "accumulation"), 0);
+        c.glUniform1i(c.glGetUniformLocation(self.program, "weights"), 1);
+        c.glGenVertexArrays(1, &self.vao);
+
+        try self.createAttachments(width, height);
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Copy the depth of the bound framebuffer and make the accumulation targets the ones drawn into
+    /// `width` x `height` is the region of the scene drawn, the targets grow when it doesn't fit
+    pub fn begin(self: *Self, width: u32, height: u32) !void {
+        var bound: c.GLint = 0;
+        c.glGetIntegerv(c.GL_DRAW_FRAMEBUFFER_BINDING, &bound);
+        self.scene_fbo = @intCast(bound);
+
+        if (width > self.width or height > self.height) {
+            self.destroyAttachments();
+            try self.createAttachments(@max(width, self.width), @max(height, self.height));
+        }
+
+        const w: c.GLint = @intCast(width);
+        const h: c.GLint = @intCast(height);
+        c.glBindFramebuffer(c.GL_READ_FRAMEBUFFER, self.scene_fbo);
+        c.glBindFramebuffer(c.GL_DRAW_FRAMEBUFFER, self.fbo);
+        c.glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, c.GL_DEPTH_BUFFER_BIT, c.GL_NEAREST);
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.fbo);
+
+        const clear_accumulation = [4]f32{ 0, 0, 0, 1 };
+        const clear_weights = [4]f32{ 0, 0, 0, 0 };
+        GLStateCache.current().setColorMask(true);
+        c.glClearBufferfv(c.GL_COLOR, 0, &clear_accumulation);
+        c.glClearBufferfv(c.GL_COLOR, 1, &clear_weights);
+        err.checkGLError("WeightedBlendedTarget.begin");
+
+        GLStateCache.current().setBlend(.weighted_blended);
+    }
+
+
+    /// Return to the scene framebuffer and blend the accumulated layers over it
+    /// Leaves alpha blending on and the depth test as it was
+    pub fn end(self: *Self) void {
+        const state = GLStateCache.current();
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.scene_fbo);
+
+        state.setBlend(.alpha);
+        const depth_test = state.depth_test orelse true;
+        state.setDepthTest(false);
+        defer state.setDepthTest(depth_test);
+
+        state.useProgram(self.program);
+        state.bindVertexArray(self.vao);
+        state.bindTexture2D(0, self.accumulation);
+        state.bindTexture2D(1, self.weights);
+        c.glDrawArrays(c.GL_TRIANGLES, 0, 3);
+        err.checkGLError("WeightedBlendedTarget.end");
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn deinit(self: *Self) void {
+        self.destroyAttachments();
+        GLStateCache.current().forgetProgram(self.program);
+        GLStateCache.current().forgetVertexArray(self.vao);
+        c.glDeleteProgram(self.program);
+        c.glDeleteVertexArrays(1, &self.vao);
+        self.program = 0;
+        self.vao = 0;
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    fn createAttachments(self: *Self, width: u32, height: u32) !void {
+        self.width = @max(width, 1);
+        self.height = @max(height, 1);
+        const w: c.GLsizei = @intCast(self.width);
+        const h: c.GLsizei = @intCast(self.height);
+
+        self.accumulation = createTexture(c.GL_RGBA16F, c.GL_RGBA, w, h);
+        self.weights = createTexture(c.GL_R16F, c.GL_RED, w, h);
+
+        c.glGenRenderbuffers(1, &self.depth_renderbuffer);
+        c.glBindRenderbuffer(c.GL_RENDERBUFFER, self.depth_renderbuffer);
+        c.glRenderbufferStorage(c.GL_RENDERBUFFER, c.GL_DEPTH24_STENCIL8, w, h);
+        c.glBindRenderbuffer(c.GL_RENDERBUFFER, 0);
+
+        c.glGenFramebuffers(1, &self.fbo);
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.fbo);
+        c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_COLOR_ATTACHMENT0, c.GL_TEXTURE_2D, self.accumulation, 0);
+        c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_COLOR_ATTACHMENT1, c.GL_TEXTURE_2D, self.weights, 0);
+        c.glFramebufferRenderbuffer(c.GL_FRAMEBUFFER, c.GL_DEPTH_STENCIL_ATTACHMENT, c.GL_RENDERBUFFER, self.depth_renderbuffer);
+        const draw_buffers = [_]c.GLenum{ c.GL_COLOR_ATTACHMENT0, c.GL_COLOR_ATTACHMENT1 };
+        c.glDrawBuffers(draw_buffers.len, &draw_buffers);
+
+        const complete = c.glCheckFramebufferStatus(c.GL_FRAMEBUFFER) == c.GL_FRAMEBUFFER_COMPLETE;
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+        err.checkGLError("WeightedBlendedTarget setup");
+        if (!complete) return TransparencyError.IncompleteFramebuffer;
+    }
+
+
+    /// Names that were never generated are 0 and ignored by the delete calls
+    fn destroyAttachments(self: *Self) void {
+        const state = GLStateCache.current();
+        state.forgetTexture(self.accumulation);
+        state.forgetTexture(self.weights);
+        const textures = [_]c.GLuint{ self.accumulation, self.weights };
+        c.glDeleteTextures(textures.len, &textures);
+        c.glDeleteRenderbuffers(1, &self.depth_renderbuffer);
+        c.glDeleteFramebuffers(1, &self.fbo);
+        err.checkGLError("WeightedBlendedTarget: delete attachments");
+
+        self.accumulation = 0;
+        self.weights = 0;
+        self.depth_renderbuffer = 0;
+        self.fbo = 0;
+    }
+
+
+    fn createTexture(internal_format: c.GLenum, format: c.GLenum, width: c.GLsizei, height: c.GLsizei) c.GLuint {
+        var texture: c.GLuint = 0;
+        c.glGenTextures(1, &texture);
+        GLStateCache.current().bindTexture2D(0, texture);
+        c.glTexImage2D(c.GL_TEXTURE_2D, 0, @intCast(internal_format), width, height, 0, format, c.GL_HALF_FLOAT, null);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_NEAREST);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_NEAREST);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+};
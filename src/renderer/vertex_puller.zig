@@ -0,0 +1,229 @@
+// graphics/vertex_puller.zig - programmable vertex fetch from the geometry pool
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+
+const mesh_module = @import("mesh.zig");
+const Mesh = mesh_module.Mesh;
+const InstanceSource = mesh_module.InstanceSource;
+const GeometryPool = @import("geometry_pool.zig").GeometryPool;
+const MaterialTable = @import("material_table.zig").MaterialTable;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const shader_module = @import("shader.zig");
+const Shader = shader_module.Shader;
+const camera_block_glsl = shader_module.camera_block_glsl;
+const instance_glsl = shader_module.instance_glsl;
+
+
+pub const VertexPullerError = error{
+    /// The driver lacks multi-draw indirect or enough storage blocks in the vertex stage
+    Unsupported,
+    /// A mesh drawn through the puller doesn't live in its GeometryPool
+    NotPooled,
+};
+
+
+/// std430 layout of one entry of the Draws buffer, one per indirect command
+pub const PulledDraw = extern struct {
+    /// Index of the mesh's GeometryPool section
+    section: u32,
+    base_vertex: i32,
+    /// Index into the MaterialTable
+    material: u32,
+    padding: u32 = 0,
+};
+
+
+/// Draws meshes of every GeometryPool section in one multi-draw, with a single empty VAO bound
+/// The vertex shader reads indices and vertices from the section buffers bound as storage buffers, using
+/// the command's first index as gl_VertexID and its section and base vertex from the Draws buffer.
+/// Each culled instance carries its command index in place of a material index, the Draws entry holds
+/// the material. Filled by GpuCuller.buildPulled, drawn by Renderer.drawCulled
+pub const VertexPuller = struct {
+    const Self = @This();
+
+    /// Storage buffer bindings, past the culler's and the MaterialTable's
+    const draws_binding = 6;
+    const first_vertices_binding = 7;
+    const first_indices_binding = first_vertices_binding + GeometryPool.package_sizes.len;
+    const storage_blocks = 1 + 2 * GeometryPool.package_sizes.len;
+
+    comptime {
+        // The section blocks and tables of vertex_source are written out for these
+        std.debug.assert(std.mem.eql(u4, &GeometryPool.package_sizes, &.{ 3, 5, 6, 7, 8 }));
+    }
+
+    const vertex_source = "#version 430 core\n" ++ camera_block_glsl ++ instance_glsl ++
+        \\struct PulledDraw { uint section; int baseVertex; uint material; uint padding; };
+        \\layout (std430, binding = 6) readonly buffer Draws { PulledDraw draws[]; };
+        \\layout (std430, binding = 7) readonly buffer Vertices0 { float vertices0[]; };
+        \\layout (std430, binding = 8) readonly buffer Vertices1 { float vertices1[]; };
+        \\layout (std430, binding = 9) readonly buffer Vertices2 { float vertices2[]; };
+        \\layout (std430, binding = 10) readonly buffer Vertices3 { float vertices3[]; };
+        \\layout (std430, binding = 11) readonly buffer Vertices4 { float vertices4[]; };
+        \\layout (std430, binding = 12) readonly buffer Indices0 { uint indices0[]; };
+        \\layout (std430, binding = 13) readonly buffer Indices1 { uint indices1[]; };
+        \\layout (std430, binding = 14) readonly buffer Indices2 { uint indices2[]; };
+        \\layout (std430, binding = 15) readonly buffer Indices3 { uint indices3[]; };
+        \\layout (std430, binding = 16) readonly buffer Indices4 { uint indices4[]; };
+        \\layout (location=7) in uint aDraw;
+        \\out vec2 TexCoord;
+        \\flat out uint Material;
+        \\// Floats per vertex and offset of the texture coordinates of each section, -1 without them
+        \\const uint strides[5] = uint[5](3u, 5u, 6u, 7u, 8u);
+        \\const int texCoordOffsets[5] = int[5](-1, 3, -1, -1, 6);
+        \\uint fetchIndex(uint section, uint i) {
+        \\    switch (section) {
+        \\    case 0u: return indices0[i];
+        \\    case 1u: return indices1[i];
+        \\    case 2u: return indices2[i];
+        \\    case 3u: return indices3[i];
+        \\    default: return indices4[i];
+        \\    }
+        \\}
+        \\float fetch(uint section, uint i) {
+        \\    switch (section) {
+        \\    case 0u: return vertices0[i];
+        \\    case 1u: return vertices1[i];
+        \\    case 2u: return vertices2[i];
+        \\    case 3u: return vertices3[i];
+        \\    default: return vertices4[i];
+        \\    }
+        \\}
+        \\void main() {
+        \\    PulledDraw draw = draws[aDraw];
+        \\    // Array draws count gl_VertexID up from the command's first index
+        \\    uint vertex = uint(int(fetchIndex(draw.section, uint(gl_VertexID))) + draw.baseVertex);
+        \\    uint base = vertex * strides[draw.section];
+        \\    vec3 position = vec3(fetch(draw.section, base), fetch(draw.section, base + 1u), fetch(draw.section, base + 2u));
+        \\    int uv = texCoordOffsets[draw.section];
+        \\    TexCoord = uv < 0 ? vec2(0.0) : vec2(fetch(draw.section, base + uint(uv)), fetch(draw.section, base + uint(uv) + 1u));
+        \\    Material = draw.material;
+        \\    gl_Position = viewProjection * instanceModel() * vec4(position, 1.0);
+        \\}
+    ;
+
+    allocator: std.mem.Allocator,
+    pool: *GeometryPool,
+    table: *MaterialTable,
+    /// Table fragment stage behind the pulling vertex stage
+    shader: *Shader,
+    /// Holds only the instance attributes, vertices come from the storage buffers
+    vao: c.GLuint,
+    instance_source: InstanceSource = .{},
+    /// PulledDraw per command of the last GpuCuller.buildPulled
+    draw_buffer: c.GLuint,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Both `pool` and `table` must outlive the puller
+    pub fn create(allocator: std.mem.Allocator, pool: *GeometryPool, table: *MaterialTable) !*Self {
+        if (!isSupported()) return VertexPullerError.Unsupported;
+
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+
+        const shader = try Shader.create(allocator, vertex_source, table.fragmentSource());
+        errdefer _ = shader.release();
+        if (table.mode == .texture_array) {
+            GLStateCache.current().useProgram(shader.program);
+            try shader.setUniformInt("materialTextures", MaterialTable.array_unit);
+        }
+
+        var vao: c.GLuint = 0;
+        var draw_buffer: c.GLuint = 0;
+        c.glGenVertexArrays(1, &vao);
+        c.glGenBuffers(1, &draw_buffer);
+        err.checkGLError("VertexPuller setup");
+
+        self.* = .{
+            .allocator = allocator,
+            .pool = pool,
+            .table = table,
+            .shader = shader,
+            .vao = vao,
+            .draw_buffer = draw_buffer,
+        };
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Multi-draw of arrays draws, GPU culling and the vertex stage reading enough storage blocks
+    pub fn isSupported() bool {
+        if (!gl_ext.hasGpuCulling() or gl_ext.multiDrawArraysIndirect == null) return false;
+        var blocks: c.GLint = 0;
+        c.glGetIntegerv(gl_ext.GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &blocks);
+        return blocks >= storage_blocks;
+    }
+
+
+    /// Section of the pool `mesh` lives in
+    pub fn sectionOf(self: *const Self, mesh: *const Mesh) !u32 {
+        const section = mesh.section orelse return VertexPullerError.NotPooled;
+        for (&self.pool.sections, 0..) |*slot, index| {
+            if (slot.*) |*candidate| {
+                if (candidate == section) return @intCast(index);
+            }
+        }
+        return VertexPullerError.NotPooled;
+    }
+
+
+    /// Replace the Draws buffer, called by GpuCuller.buildPulled
+    pub fn uploadDraws(self: *Self, draws: []const PulledDraw) void {
+        const bytes = std.mem.sliceAsBytes(draws);
+        c.glBindBuffer(gl_ext.GL_SHADER_STORAGE_BUFFER, self.draw_buffer);
+        c.glBufferData(gl_ext.GL_SHADER_STORAGE_BUFFER, @intCast(bytes.len), bytes.ptr, c.GL_STATIC_DRAW);
+        err.checkGLError("VertexPuller: glBufferData");
+    }
+
+
+    /// Bind the program, the empty VAO sourcing instances from the culled buffers, the section buffers and the table
+    /// Sections are rebound every time, growing one replaces its buffers
+    pub fn bind(self: *Self, visible_buffer: c.GLuint, visible_draw_buffer: c.GLuint) void {
+        const state = GLStateCache.current();
+        state.useProgram(self.shader.program);
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, MaterialTable.materials_binding, self.table.buffer);
+        if (self.table.array) |array| array.bind(MaterialTable.array_unit);
+
+        state.bindVertexArray(self.vao);
+        mesh_module.pointInstanceAttributes(&self.instance_source, visible_buffer, 0, .affine, 1);
+        state.bindArrayBuffer(visible_draw_buffer);
+        c.glVertexAttribIPointer(mesh_module.instance_material_location, 1, c.GL_UNSIGNED_INT, @sizeOf(u32), null);
+        c.glEnableVertexAttribArray(mesh_module.instance_material_location);
+        c.glVertexAttribDivisor(mesh_module.instance_material_location, 1);
+
+        c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, draws_binding, self.draw_buffer);
+        // Sections not created yet are never indexed, their bindings stay whatever they were
+        for (self.pool.sections, 0..) |slot, index| {
+            const section = slot orelse continue;
+            c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, @intCast(first_vertices_binding + index), section.vbo);
+            c.glBindBufferBase(gl_ext.GL_SHADER_STORAGE_BUFFER, @intCast(first_indices_binding + index), section.ebo);
+        }
+        err.checkGLError("VertexPuller.bind");
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    pub fn destroy(self: *Self) void {
+        const state = GLStateCache.current();
+        state.forgetVertexArray(self.vao);
+        c.glDeleteVertexArrays(1, &self.vao);
+        c.glDeleteBuffers(1, &self.draw_buffer);
+        err.checkGLError("VertexPuller cleanup");
+
+        _ = self.shader.release();
+        self.allocator.destroy(self);
+    }
+};
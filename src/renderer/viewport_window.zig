@@ -0,0 +1,160 @@
+// graphics/viewport_window.zig
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+
+const window_module = @import("../core/window.zig");
+const Window = window_module.Window;
+const WindowConfig = window_module.WindowConfig;
+const Shader = @import("shader.zig").Shader;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+
+
+/// Extra window, e.g. an editor preview, showing a texture rendered in the main window's context
+/// Its context shares the main window's objects, so meshes, textures and shaders are created once.
+/// Vertex arrays and framebuffers are per context though, so scenes keep drawing in the main context
+/// into a RenderTarget and the viewport only presents its color texture with a fullscreen triangle
+pub const ViewportWindow = struct {
+    const Self = @This();
+
+    const present_vertex =
+        \\#version 330 core
+        \\out vec2 uv;
+        \\void main() {
+        \\    uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        \\    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+        \\}
+    ;
+    const present_fragment =
+        \\#version 330 core
+        \\uniform sampler2D image;
+        \\in vec2 uv;
+        \\out vec4 color;
+        \\void main() {
+        \\    color = texture(image, uv);
+        \\}
+    ;
+
+    allocator: std.mem.Allocator,
+    window: *Window,
+    /// Window whose context renders what is presented, made current again after every present
+    main: *Window,
+    /// Bindings of this window's context, the main renderer's cache knows nothing about it
+    state: GLStateCache = .{},
+    /// Attribute-less VAO of the fullscreen triangle, lives in this window's context
+    vao: c.GLuint = 0,
+    program: c.GLuint = 0,
+    /// Commands of the main context up to submit, present waits for them on the GPU
+    fence: c.GLsync = null,
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Open a window sharing the objects of `main`, whose context is current again afterwards
+    /// `config.share` is ignored. Every swap waits for the display with vsync on, so viewports usually go without
+    pub fn create(allocator: std.mem.Allocator, main: *Window, config: WindowConfig) !*Self {
+        const main_state = GLStateCache.current();
+
+        var shared_config = config;
+        shared_config.share = main;
+        const window = try Window.create(allocator, shared_config);
+        errdefer window.release();
+        defer {
+            main.makeContextCurrent();
+            GLStateCache.makeCurrent(main_state);
+        }
+
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+        self.* = .{
+            .allocator = allocator,
+            .window = window,
+            .main = main,
+        };
+
+        // Window.create left the new context current
+        GLStateCache.makeCurrent(&self.state);
+        self.program = try Shader.createProgram(present_vertex, present_fragment);
+        self.state.useProgram(self.program);
+        c.glUniform1i(c.glGetUniformLocation(self.program, "image"), 0);
+        c.glGenVertexArrays(1, &self.vao);
+        err.checkGLError("ViewportWindow setup");
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Fence the main context's commands so far, call there after rendering what present shows
+    pub fn submit(self: *Self) void {
+        if (self.fence) |fence| c.glDeleteSync(fence);
+        self.fence = c.glFenceSync(c.GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        // The fence has to reach the GPU before the other context can wait on it
+        c.glFlush();
+    }
+
+
+    /// Draw `texture` over the whole window and swap its buffers, then make the main context current again
+    /// The wait for the submitted frame happens on the GPU, the calling thread does not block on it
+    pub fn present(self: *Self, texture: c.GLuint) void {
+        const main_state = GLStateCache.current();
+        self.window.makeContextCurrent();
+        GLStateCache.makeCurrent(&self.state);
+        defer {
+            self.main.makeContextCurrent();
+            GLStateCache.makeCurrent(main_state);
+        }
+
+        if (self.fence) |fence| {
+            c.glWaitSync(fence, 0, c.GL_TIMEOUT_IGNORED);
+            c.glDeleteSync(fence);
+            self.fence = null;
+        }
+
+        var width: c_int = 0;
+        var height: c_int = 0;
+        c.glfwGetFramebufferSize(self.window.handle, &width, &height);
+        if (width == 0 or height == 0) return;
+
+        self.state.setViewport(0, 0, width, height);
+        self.state.setDepthTest(false);
+        self.state.setCullFace(false);
+        self.state.useProgram(self.program);
+        self.state.bindVertexArray(self.vao);
+        // Binding again after the wait is what makes the main context's writes visible in this one
+        self.state.forgetTexture(texture);
+        self.state.bindTexture2D(0, texture);
+        c.glDrawArrays(c.GL_TRIANGLES, 0, 3);
+        err.checkGLError("ViewportWindow.present");
+
+        self.window.swapBuffers();
+    }
+
+
+    pub fn shouldClose(self: *const Self) bool {
+        return self.window.shouldClose();
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Close the window, the main context is current again afterwards
+    pub fn release(self: *Self) void {
+        const main_state = GLStateCache.current();
+        self.window.makeContextCurrent();
+        if (self.fence) |fence| c.glDeleteSync(fence);
+        c.glDeleteVertexArrays(1, &self.vao);
+        c.glDeleteProgram(self.program);
+        self.window.release();
+
+        self.main.makeContextCurrent();
+        GLStateCache.makeCurrent(main_state);
+        self.allocator.destroy(self);
+    }
+};
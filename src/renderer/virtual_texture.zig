@@ -0,0 +1,888 @@
+// graphics/virtual_texture.zig - sparse virtual texturing with a page table over a fixed page cache
+const std = @import("std");
+const c = @import("../bindings/c.zig");
+const err = @import("../core/gl.zig");
+const gl_ext = @import("../core/gl_ext.zig");
+const profiler = @import("../core/profiler.zig");
+const JobSystem = @import("../core/jobs.zig").JobSystem;
+const image_decode = @import("image_decode.zig");
+const AssetArchive = @import("asset_archive.zig").AssetArchive;
+const GLStateCache = @import("gl_state.zig").GLStateCache;
+const Shader = @import("shader.zig").Shader;
+
+
+pub const VirtualTextureError = error{
+    InvalidConfig,
+    /// A page source produced an image of another size than the pages
+    InvalidPageData,
+    /// The driver could not map a finished feedback read
+    MapFailed,
+    OpenGLError,
+};
+
+
+pub const VirtualTextureConfig = struct {
+    /// Pages per side of the finest level, a power of two up to 4096
+    virtual_pages: u32 = 256,
+    /// Texels per page side, including `border` texels on every side copied from the neighbours for filtering
+    page_size: u32 = 128,
+    border: u32 = 4,
+    /// Cache slots per side, every page resident at once lives in one of them, at most 256
+    cache_pages: u32 = 32,
+    /// The feedback pass renders at the viewport size divided by this
+    feedback_divisor: u32 = 8,
+    /// Feedback reads in flight, one is collected once its fence signaled
+    feedback_ring_size: u32 = 3,
+    /// Pages loading on the workers at once
+    max_pages_in_flight: u32 = 32,
+    /// Pages copied into the cache per update, the rest wait for the next one
+    max_uploads_per_update: u32 = 16,
+    /// Back the cache with ARB_sparse_texture where the pages fit its page size, committing a slot's
+    /// memory only when it is first filled
+    sparse_cache: bool = true,
+};
+
+
+/// A page of one level of the virtual texture, level 0 is the finest
+pub const PageId = packed struct(u32) {
+    x: u12,
+    y: u12,
+    mip: u4,
+    _padding: u4 = 0,
+
+    fn key(self: PageId) u32 {
+        return @bitCast(self);
+    }
+
+
+    fn parent(self: PageId) PageId {
+        return .{ .x = self.x >> 1, .y = self.y >> 1, .mip = self.mip + 1 };
+    }
+};
+
+
+/// Fills one page on a worker thread, `pixels` is page_size x page_size RGBA8 texels, rows bottom first,
+/// border included. Called from several workers at once
+pub const PageSource = struct {
+    func: *const fn (context: ?*anyopaque, page: PageId, pixels: []u8) anyerror!void,
+    context: ?*anyopaque = null,
+};
+
+
+/// Pages stored as source entries "{prefix}/{mip}/{x}_{y}" of a packed archive, PNG or JPEG images of
+/// page_size texels per side sliced offline with their borders. The archive is a read only mapping,
+/// so the workers read it concurrently
+pub const ArchivePageSource = struct {
+    archive: *const AssetArchive,
+    prefix: []const u8,
+
+    pub fn source(self: *const ArchivePageSource) PageSource {
+        return .{ .func = read, .context = @constCast(self) };
+    }
+
+
+    fn read(context: ?*anyopaque, page: PageId, pixels: []u8) !void {
+        const self: *const ArchivePageSource = @alignCast(@ptrCast(context.?));
+        var name_buffer: [256]u8 = undefined;
+        const name = try std.fmt.bufPrint(&name_buffer, "{s}/{d}/{d}_{d}", .{ self.prefix, page.mip, page.x, page.y });
+
+        c.stbi_set_flip_vertically_on_load(1);
+        const image = try image_decode.decodeMemory(try self.archive.sourceBytes(name), 4);
+        if (image.pixels.len != pixels.len) return VirtualTextureError.InvalidPageData;
+        @memcpy(pixels, image.pixels);
+    }
+};
+
+
+/// Residency after the last update
+pub const VirtualTextureStats = struct {
+    resident_pages: usize = 0,
+    cache_pages: usize = 0,
+    /// Pages the last feedback read asked for that were not resident
+    missing_pages: usize = 0,
+    loading_pages: usize = 0,
+    uploaded_pages: usize = 0,
+    evicted_pages: usize = 0,
+    /// Pages whose source failed, since creation
+    failed_pages: u64 = 0,
+    /// Video memory of the cache, page table and feedback target, fixed by the config
+    video_bytes: usize = 0,
+    /// Cache memory committed so far, below the cache size while a sparse cache is not full
+    committed_cache_bytes: usize = 0,
+    sparse: bool = false,
+};
+
+
+/// A texture far larger than video memory, e.g. a unique megatexture over a whole terrain
+/// The virtual texture is a mip pyramid of fixed size pages. Only the pages drawn recently are resident, each
+/// in a slot of a cache texture whose size never changes, and a page table with one texel per page of every
+/// level tells shaders which slot holds it. Pages that are not resident point at their nearest resident
+/// ancestor, so a missing page draws blurred instead of not at all, and the coarsest page is kept resident.
+/// A low resolution feedback pass writes the page every pixel wants, update reads it back a few frames later
+/// without stalling, loads the missing pages on the workers and replaces the least recently seen ones
+///
+/// Shaders prepend `sampling_glsl` and call `virtualTexture(uv)`, the feedback shader prepends
+/// `feedback_glsl` and writes `virtualTextureFeedback(uv)`
+pub const VirtualTexture = struct {
+    const Self = @This();
+
+    /// Thread safe, used by the workers for page pixels
+    const load_allocator = std.heap.page_allocator;
+
+    /// Included by shaders sampling the virtual texture at `uv` in 0..1
+    pub const sampling_glsl =
+        \\uniform sampler2D vtPageTable;
+        \\uniform sampler2D vtCache;
+        \\// Virtual pages per side, cache pages per side, page size, border texels
+        \\uniform vec4 vtParams;
+        \\// Coarsest level, log2 of the feedback divisor
+        \\uniform vec4 vtLevels;
+        \\float virtualTextureLevel(vec2 uv, float bias) {
+        \\    vec2 texels = uv * vtParams.x * (vtParams.z - 2.0 * vtParams.w);
+        \\    vec2 dx = dFdx(texels);
+        \\    vec2 dy = dFdy(texels);
+        \\    float level = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + bias;
+        \\    return clamp(floor(level), 0.0, vtLevels.x);
+        \\}
+        \\vec4 virtualTexture(vec2 uv) {
+        \\    uv = clamp(uv, 0.0, 0.99999);
+        \\    vec4 entry = floor(textureLod(vtPageTable, uv, virtualTextureLevel(uv, 0.0)) * 255.0 + 0.5);
+        \\    if (entry.a < 1.0) return vec4(0.0);
+        \\    vec2 inPage = fract(uv * (vtParams.x / exp2(entry.b)));
+        \\    vec2 texel = entry.rg * vtParams.z + vtParams.w + inPage * (vtParams.z - 2.0 * vtParams.w);
+        \\    return textureLod(vtCache, texel / (vtParams.y * vtParams.z), 0.0);
+        \\}
+        \\
+    ;
+
+    /// Included by the feedback shader, its output is the page `uv` samples with the level bias of the
+    /// smaller target, 0 where nothing was drawn
+    pub const feedback_glsl = sampling_glsl ++
+        \\vec4 virtualTextureFeedback(vec2 uv) {
+        \\    uv = clamp(uv, 0.0, 0.99999);
+        \\    float level = virtualTextureLevel(uv, -vtLevels.y);
+        \\    vec2 page = floor(uv * (vtParams.x / exp2(level)));
+        \\    vec2 high = floor(page / 256.0);
+        \\    return vec4(page - high * 256.0, high.x + high.y * 16.0, level + 1.0) / 255.0;
+        \\}
+        \\
+    ;
+
+    const Slot = struct {
+        page: ?PageId = null,
+        last_used: u64 = 0,
+        /// The sparse memory under the slot is committed
+        committed: bool = false,
+    };
+
+    /// Page table texels as uploaded: slot x, slot y, level of the page in the slot, 255 when any is
+    const Entry = [4]u8;
+
+    /// Region of a page table level changed since its last upload, empty while min > max
+    const DirtyRect = struct {
+        min_x: u32 = std.math.maxInt(u32),
+        min_y: u32 = std.math.maxInt(u32),
+        max_x: u32 = 0,
+        max_y: u32 = 0,
+
+        fn add(self: *DirtyRect, x0: u32, y0: u32, x1: u32, y1: u32) void {
+            self.min_x = @min(self.min_x, x0);
+            self.min_y = @min(self.min_y, y0);
+            self.max_x = @max(self.max_x, x1);
+            self.max_y = @max(self.max_y, y1);
+        }
+
+
+        fn isEmpty(self: DirtyRect) bool {
+            return self.min_x > self.max_x;
+        }
+    };
+
+    const Readback = struct {
+        buffer: c.GLuint = 0,
+        capacity: usize = 0,
+        /// Signals once the read is done, null while the readback is free
+        fence: c.GLsync = null,
+        width: u32 = 0,
+        height: u32 = 0,
+    };
+
+    /// One page loading on a worker, owned by the worker until it is on `completed`
+    const PageLoad = struct {
+        owner: *Self,
+        page: PageId,
+        pixels: []u8,
+        failed: bool = false,
+    };
+
+    allocator: std.mem.Allocator,
+    config: VirtualTextureConfig,
+    jobs: *JobSystem,
+    source: PageSource,
+    levels: u32,
+
+    cache_texture: c.GLuint = 0,
+    page_table_texture: c.GLuint = 0,
+    sparse: bool = false,
+    slots: []Slot,
+    /// Slots never filled, taken before anything is evicted
+    free_slots: std.ArrayList(u32),
+    /// PageId key to slot index
+    resident: std.AutoHashMap(u32, u32),
+    /// CPU copy of every page table level, finest first
+    table: [][]Entry,
+    dirty: []DirtyRect,
+
+    feedback_framebuffer: c.GLuint = 0,
+    feedback_color: c.GLuint = 0,
+    feedback_depth: c.GLuint = 0,
+    feedback_width: u32 = 0,
+    feedback_height: u32 = 0,
+    readbacks: []Readback,
+    next_readback: usize = 0,
+    /// Pages of the collected feedback, deduplicated, reused every update
+    requested: std.AutoHashMap(u32, void),
+    missing: std.ArrayList(PageId),
+
+    /// PageId keys queued on the workers or waiting in `completed`
+    loading: std.AutoHashMap(u32, void),
+    loads: std.Thread.WaitGroup = .{},
+    /// Guards `completed`, filled by the workers
+    mutex: std.Thread.Mutex = .{},
+    completed: std.ArrayList(*PageLoad),
+
+    /// Number of updates so far
+    frame: u64 = 1,
+    stats: VirtualTextureStats = .{},
+
+
+    // ============================================================
+    // Public API: Creation Functions
+    // ============================================================
+
+    /// Create the cache, page table and feedback target and queue the coarsest page, call on the GL thread
+    /// `source` fills pages on the workers of `jobs` until deinit
+    pub fn create(allocator: std.mem.Allocator, jobs: *JobSystem, source: PageSource, config: VirtualTextureConfig) !*Self {
+        if (!std.math.isPowerOfTwo(config.virtual_pages) or config.virtual_pages > 4096 or
+            config.page_size <= 2 * config.border or config.cache_pages == 0 or config.cache_pages > 256 or
+            config.feedback_divisor == 0 or config.feedback_ring_size == 0 or config.max_pages_in_flight == 0)
+        {
+            return VirtualTextureError.InvalidConfig;
+        }
+        var max_texture_size: c.GLint = 0;
+        c.glGetIntegerv(c.GL_MAX_TEXTURE_SIZE, &max_texture_size);
+        if (@as(i64, config.cache_pages) * config.page_size > max_texture_size) return VirtualTextureError.InvalidConfig;
+
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+
+        const levels = std.math.log2_int(u32, config.virtual_pages) + 1;
+        const slots = try allocator.alloc(Slot, config.cache_pages * config.cache_pages);
+        errdefer allocator.free(slots);
+        @memset(slots, .{});
+        var free_slots = try std.ArrayList(u32).initCapacity(allocator, slots.len);
+        errdefer free_slots.deinit();
+        // Popped from the back, slot 0 is filled first
+        var i = slots.len;
+        while (i > 0) {
+            i -= 1;
+            free_slots.appendAssumeCapacity(@intCast(i));
+        }
+
+        const table = try allocator.alloc([]Entry, levels);
+        errdefer allocator.free(table);
+        var allocated_levels: usize = 0;
+        errdefer for (table[0..allocated_levels]) |level| allocator.free(level);
+        for (table, 0..) |*level, mip| {
+            const side = config.virtual_pages >> @intCast(mip);
+            level.* = try allocator.alloc(Entry, side * side);
+            @memset(level.*, .{ 0, 0, 0, 0 });
+            allocated_levels += 1;
+        }
+        const dirty = try allocator.alloc(DirtyRect, levels);
+        errdefer allocator.free(dirty);
+        @memset(dirty, .{});
+
+        const readbacks = try allocator.alloc(Readback, config.feedback_ring_size);
+        errdefer allocator.free(readbacks);
+        @memset(readbacks, .{});
+
+        self.* = .{
+            .allocator = allocator,
+            .config = config,
+            .jobs = jobs,
+            .source = source,
+            .levels = levels,
+            .slots = slots,
+            .free_slots = free_slots,
+            .resident = std.AutoHashMap(u32, u32).init(allocator),
+            .table = table,
+            .dirty = dirty,
+            .readbacks = readbacks,
+            .requested = std.AutoHashMap(u32, void).init(allocator),
+            .missing = std.ArrayList(PageId).init(allocator),
+            .loading = std.AutoHashMap(u32, void).init(allocator),
+            .completed = std.ArrayList(*PageLoad).init(allocator),
+        };
+        errdefer {
+            self.resident.deinit();
+            self.requested.deinit();
+            self.missing.deinit();
+            self.loading.deinit();
+            self.completed.deinit();
+        }
+
+        try self.resident.ensureTotalCapacity(@intCast(slots.len));
+        try self.requested.ensureTotalCapacity(@intCast(slots.len));
+        try self.loading.ensureTotalCapacity(config.max_pages_in_flight + 1);
+        try self.completed.ensureTotalCapacity(config.max_pages_in_flight + 1);
+
+        errdefer self.deleteTextures();
+        try self.createTextures();
+        for (readbacks) |*readback| c.glGenBuffers(1, &readback.buffer);
+        errdefer for (readbacks) |*readback| c.glDeleteBuffers(1, &readback.buffer);
+        c.glGenFramebuffers(1, &self.feedback_framebuffer);
+        errdefer self.deleteFeedbackTarget();
+        err.checkGLError("VirtualTexture setup");
+
+        // Everything falls back to the coarsest page, it never leaves the cache
+        self.queueLoad(self.coarsestPage());
+        return self;
+    }
+
+
+    // ============================================================
+    // Public API: Operational Functions
+    // ============================================================
+
+    /// Bind the feedback target sized for a `viewport_width` x `viewport_height` view and clear it
+    /// Draw the virtually textured geometry with the feedback shader, then call endFeedback
+    pub fn beginFeedback(self: *Self, viewport_width: u32, viewport_height: u32) !void {
+        const width = @max(viewport_width / self.config.feedback_divisor, 1);
+        const height = @max(viewport_height / self.config.feedback_divisor, 1);
+        if (width != self.feedback_width or height != self.feedback_height) try self.resizeFeedbackTarget(width, height);
+
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.feedback_framebuffer);
+        c.glViewport(0, 0, @intCast(width), @intCast(height));
+        c.glClearColor(0, 0, 0, 0);
+        c.glClear(c.GL_COLOR_BUFFER_BIT | c.GL_DEPTH_BUFFER_BIT);
+    }
+
+
+    /// Queue the read of the feedback drawn since beginFeedback and bind gl.default_framebuffer again,
+    /// the viewport is the caller's to restore. Waits on the GPU only when the ring is too short for its latency
+    pub fn endFeedback(self: *Self) !void {
+        const zone = profiler.zone("VirtualTexture.endFeedback");
+        defer zone.end();
+
+        const readback = &self.readbacks[self.next_readback];
+        // The oldest read is still in flight, take it now to reuse its buffer
+        if (readback.fence != null) try self.collectReadback(readback);
+
+        const size = @as(usize, self.feedback_width) * self.feedback_height * 4;
+        c.glBindBuffer(c.GL_PIXEL_PACK_BUFFER, readback.buffer);
+        defer c.glBindBuffer(c.GL_PIXEL_PACK_BUFFER, 0);
+        if (size > readback.capacity) {
+            c.glBufferData(c.GL_PIXEL_PACK_BUFFER, @intCast(size), null, c.GL_STREAM_READ);
+            readback.capacity = size;
+        }
+
+        c.glBindFramebuffer(c.GL_READ_FRAMEBUFFER, self.feedback_framebuffer);
+        c.glPixelStorei(c.GL_PACK_ALIGNMENT, 1);
+        c.glReadPixels(0, 0, @intCast(self.feedback_width), @intCast(self.feedback_height), c.GL_RGBA, c.GL_UNSIGNED_BYTE, null);
+        err.checkGLError("VirtualTexture: glReadPixels");
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+
+        readback.fence = c.glFenceSync(c.GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        readback.width = self.feedback_width;
+        readback.height = self.feedback_height;
+        self.next_readback = (self.next_readback + 1) % self.readbacks.len;
+    }
+
+
+    /// Take the finished feedback reads, queue the missing pages, copy loaded pages into the cache and
+    /// upload the page table, call once per frame on the GL thread
+    pub fn update(self: *Self) !void {
+        const zone = profiler.zone("VirtualTexture.update");
+        defer zone.end();
+
+        var stats = VirtualTextureStats{
+            .cache_pages = self.slots.len,
+            .failed_pages = self.stats.failed_pages,
+            .video_bytes = self.videoBytes(),
+            .sparse = self.sparse,
+        };
+
+        self.requested.clearRetainingCapacity();
+        self.missing.clearRetainingCapacity();
+        for (0..self.readbacks.len) |offset| {
+            const readback = &self.readbacks[(self.next_readback + offset) % self.readbacks.len];
+            if (readback.fence == null) continue;
+            if (!isSignaled(readback.fence)) break;
+            try self.collectReadback(readback);
+        }
+        stats.missing_pages = self.missing.items.len;
+
+        // Coarse pages first, they stand in for all the finer ones under them
+        std.mem.sort(PageId, self.missing.items, {}, coarserFirst);
+        for (self.missing.items) |page| {
+            if (self.loading.count() >= self.config.max_pages_in_flight) break;
+            self.queueLoad(page);
+        }
+
+        var uploads: [64]*PageLoad = undefined;
+        const upload_count = blk: {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            const count = @min(self.completed.items.len, self.config.max_uploads_per_update, uploads.len);
+            @memcpy(uploads[0..count], self.completed.items[0..count]);
+            std.mem.copyForwards(*PageLoad, self.completed.items, self.completed.items[count..]);
+            self.completed.shrinkRetainingCapacity(self.completed.items.len - count);
+            break :blk count;
+        };
+        for (uploads[0..upload_count]) |load| {
+            defer freeLoad(load);
+            _ = self.loading.remove(load.page.key());
+            if (load.failed) {
+                stats.failed_pages += 1;
+                continue;
+            }
+            // Every slot holds a page seen this frame, it is asked for again once one frees up
+            const slot_index = self.takeSlot(&stats) orelse continue;
+            try self.fillSlot(slot_index, load);
+            stats.uploaded_pages += 1;
+        }
+
+        try self.uploadPageTable();
+
+        stats.resident_pages = self.resident.count();
+        stats.loading_pages = self.loading.count();
+        var committed: usize = self.slots.len;
+        if (self.sparse) {
+            committed = 0;
+            for (self.slots) |slot| committed += @intFromBool(slot.committed);
+        }
+        stats.committed_cache_bytes = committed * self.pageBytes();
+        self.stats = stats;
+        self.frame += 1;
+    }
+
+
+    /// Bind the page table and cache to `page_table_unit` and `cache_unit` and set the uniforms of
+    /// sampling_glsl, for drawing and for the feedback pass, with `shader` in use
+    pub fn bind(self: *const Self, shader: *Shader, page_table_unit: u32, cache_unit: u32) !void {
+        const state = GLStateCache.current();
+        state.bindTexture2D(page_table_unit, self.page_table_texture);
+        state.bindTexture2D(cache_unit, self.cache_texture);
+        try shader.setUniformInt("vtPageTable", @intCast(page_table_unit));
+        try shader.setUniformInt("vtCache", @intCast(cache_unit));
+        try shader.setUniformVec4("vtParams", .{
+            @floatFromInt(self.config.virtual_pages),
+            @floatFromInt(self.config.cache_pages),
+            @floatFromInt(self.config.page_size),
+            @floatFromInt(self.config.border),
+        });
+        try shader.setUniformVec4("vtLevels", .{
+            @floatFromInt(self.levels - 1),
+            std.math.log2(@as(f32, @floatFromInt(self.config.feedback_divisor))),
+            0,
+            0,
+        });
+    }
+
+
+    /// Texels per side of the virtual texture's finest level, without the borders
+    pub fn virtualSize(self: *const Self) u32 {
+        return self.config.virtual_pages * (self.config.page_size - 2 * self.config.border);
+    }
+
+
+    pub fn isResident(self: *const Self, page: PageId) bool {
+        return self.resident.contains(page.key());
+    }
+
+
+    pub fn getStats(self: *const Self) VirtualTextureStats {
+        return self.stats;
+    }
+
+
+    // ============================================================
+    // Public API: Destruction Function
+    // ============================================================
+
+    /// Wait for the pages loading on the workers and delete everything, call on the GL thread
+    pub fn deinit(self: *Self) void {
+        self.jobs.waitAndWork(&self.loads);
+        for (self.completed.items) |load| freeLoad(load);
+
+        for (self.readbacks) |*readback| {
+            if (readback.fence) |fence| c.glDeleteSync(fence);
+            c.glDeleteBuffers(1, &readback.buffer);
+        }
+        self.deleteFeedbackTarget();
+        self.deleteTextures();
+        err.checkGLError("VirtualTexture cleanup");
+
+        for (self.table) |level| self.allocator.free(level);
+        self.allocator.free(self.table);
+        self.allocator.free(self.dirty);
+        self.allocator.free(self.readbacks);
+        self.allocator.free(self.slots);
+        self.free_slots.deinit();
+        self.resident.deinit();
+        self.requested.deinit();
+        self.missing.deinit();
+        self.loading.deinit();
+        self.completed.deinit();
+        self.allocator.destroy(self);
+    }
+
+
+    // ============================================================
+    // Private: Helper Functions
+    // ============================================================
+
+    /// Cache texture, sparse when the driver has it and its page size divides ours, and the page table
+    fn createTextures(self: *Self) !void {
+        const state = GLStateCache.current();
+        const cache_size: c.GLsizei = @intCast(self.config.cache_pages * self.config.page_size);
+
+        c.glGenTextures(1, &self.cache_texture);
+        state.bindTexture2D(0, self.cache_texture);
+        self.sparse = self.config.sparse_cache and self.sparsePagesFit();
+        if (self.sparse) {
+            c.glTexParameteri(c.GL_TEXTURE_2D, gl_ext.GL_TEXTURE_SPARSE_ARB, c.GL_TRUE);
+            gl_ext.texStorage2D.?(c.GL_TEXTURE_2D, 1, c.GL_RGBA8, cache_size, cache_size);
+        } else if (gl_ext.texStorage2D) |texStorage2D| {
+            texStorage2D(c.GL_TEXTURE_2D, 1, c.GL_RGBA8, cache_size, cache_size);
+        } else {
+            c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAX_LEVEL, 0);
+            c.glTexImage2D(c.GL_TEXTURE_2D, 0, c.GL_RGBA8, cache_size, cache_size, 0, c.GL_RGBA, c.GL_UNSIGNED_BYTE, null);
+        }
+        // Filtering stays inside a page thanks to its border, the cache has no mips of its own
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_LINEAR);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_LINEAR);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
+
+        c.glGenTextures(1, &self.page_table_texture);
+        state.bindTexture2D(0, self.page_table_texture);
+        const table_size: c.GLsizei = @intCast(self.config.virtual_pages);
+        if (gl_ext.texStorage2D) |texStorage2D| {
+            texStorage2D(c.GL_TEXTURE_2D, @intCast(self.levels), c.GL_RGBA8, table_size, table_size);
+        } else {
+            for (0..self.levels) |mip| {
+                const side = @max(table_size >> @intCast(mip), 1);
+                c.glTexImage2D(c.GL_TEXTURE_2D, @intCast(mip), c.GL_RGBA8, side, side, 0, c.GL_RGBA, c.GL_UNSIGNED_BYTE, null);
+            }
+        }
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAX_LEVEL, @intCast(self.levels - 1));
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_NEAREST_MIPMAP_NEAREST);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_NEAREST);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
+        for (self.dirty, 0..) |*rect, mip| {
+            const side = self.config.virtual_pages >> @intCast(mip);
+            rect.add(0, 0, side - 1, side - 1);
+        }
+        try self.uploadPageTable();
+
+        const openglerr = c.glGetError();
+        if (openglerr != c.GL_NO_ERROR) {
+            std.debug.print("OpenGL error creating virtual texture: 0x{x}\n", .{openglerr});
+            return VirtualTextureError.OpenGLError;
+        }
+    }
+
+
+    /// True when a sparse RGBA8 page of the driver tiles our pages exactly, so slots commit one by one
+    fn sparsePagesFit(self: *const Self) bool {
+        if (!gl_ext.hasSparseTextures()) return false;
+        const getInternalformativ = gl_ext.getInternalformativ.?;
+        var count: c.GLint = 0;
+        getInternalformativ(c.GL_TEXTURE_2D, c.GL_RGBA8, gl_ext.GL_NUM_VIRTUAL_PAGE_SIZES_ARB, 1, @ptrCast(&count));
+        if (count <= 0) return false;
+        // The first size is the default one, used unless VIRTUAL_PAGE_SIZE_INDEX picks another
+        var page_x: c.GLint = 0;
+        var page_y: c.GLint = 0;
+        getInternalformativ(c.GL_TEXTURE_2D, c.GL_RGBA8, gl_ext.GL_VIRTUAL_PAGE_SIZE_X_ARB, 1, @ptrCast(&page_x));
+        getInternalformativ(c.GL_TEXTURE_2D, c.GL_RGBA8, gl_ext.GL_VIRTUAL_PAGE_SIZE_Y_ARB, 1, @ptrCast(&page_y));
+        if (page_x <= 0 or page_y <= 0) return false;
+        return self.config.page_size % @as(u32, @intCast(page_x)) == 0 and self.config.page_size % @as(u32, @intCast(page_y)) == 0;
+    }
+
+
+    fn deleteTextures(self: *Self) void {
+        const state = GLStateCache.current();
+        const textures = [_]c.GLuint{ self.cache_texture, self.page_table_texture };
+        for (textures) |texture| {
+            if (texture == 0) continue;
+            state.forgetTexture(texture);
+        }
+        c.glDeleteTextures(textures.len, &textures);
+        self.cache_texture = 0;
+        self.page_table_texture = 0;
+    }
+
+
+    fn resizeFeedbackTarget(self: *Self, width: u32, height: u32) !void {
+        if (self.feedback_color == 0) c.glGenTextures(1, &self.feedback_color);
+        if (self.feedback_depth == 0) c.glGenRenderbuffers(1, &self.feedback_depth);
+
+        GLStateCache.current().bindTexture2D(0, self.feedback_color);
+        c.glTexImage2D(c.GL_TEXTURE_2D, 0, c.GL_RGBA8, @intCast(width), @intCast(height), 0, c.GL_RGBA, c.GL_UNSIGNED_BYTE, null);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_NEAREST);
+        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_NEAREST);
+        c.glBindRenderbuffer(c.GL_RENDERBUFFER, self.feedback_depth);
+        c.glRenderbufferStorage(c.GL_RENDERBUFFER, c.GL_DEPTH_COMPONENT24, @intCast(width), @intCast(height));
+        c.glBindRenderbuffer(c.GL_RENDERBUFFER, 0);
+
+        c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.feedback_framebuffer);
+        defer c.glBindFramebuffer(c.GL_FRAMEBUFFER, err.default_framebuffer);
+        c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_COLOR_ATTACHMENT0, c.GL_TEXTURE_2D, self.feedback_color, 0);
+        c.glFramebufferRenderbuffer(c.GL_FRAMEBUFFER, c.GL_DEPTH_ATTACHMENT, c.GL_RENDERBUFFER, self.feedback_depth);
+        if (c.glCheckFramebufferStatus(c.GL_FRAMEBUFFER) != c.GL_FRAMEBUFFER_COMPLETE) return VirtualTextureError.OpenGLError;
+
+        self.feedback_width = width;
+        self.feedback_height = height;
+    }
+
+
+    fn deleteFeedbackTarget(self: *Self) void {
+        if (self.feedback_color != 0) {
+            GLStateCache.current().forgetTexture(self.feedback_color);
+            c.glDeleteTextures(1, &self.feedback_color);
+        }
+        if (self.feedback_depth != 0) c.glDeleteRenderbuffers(1, &self.feedback_depth);
+        if (self.feedback_framebuffer != 0) c.glDeleteFramebuffers(1, &self.feedback_framebuffer);
+        self.feedback_color = 0;
+        self.feedback_depth = 0;
+        self.feedback_framebuffer = 0;
+    }
+
+
+    /// Map the read of `readback`, waiting for it when it isn't done, and record its pages, then free it
+    fn collectReadback(self: *Self, readback: *Readback) !void {
+        const fence = readback.fence.?;
+        _ = c.glClientWaitSync(fence, c.GL_SYNC_FLUSH_COMMANDS_BIT, std.math.maxInt(u64));
+        c.glDeleteSync(fence);
+        readback.fence = null;
+
+        const size = @as(usize, readback.width) * readback.height * 4;
+        c.glBindBuffer(c.GL_PIXEL_PACK_BUFFER, readback.buffer);
+        defer c.glBindBuffer(c.GL_PIXEL_PACK_BUFFER, 0);
+        const mapped: ?[*]const u8 = @ptrCast(c.glMapBufferRange(c.GL_PIXEL_PACK_BUFFER, 0, @intCast(size), c.GL_MAP_READ_BIT));
+        if (mapped == null) {
+            err.checkGLError("VirtualTexture: glMapBufferRange");
+            return VirtualTextureError.MapFailed;
+        }
+        defer _ = c.glUnmapBuffer(c.GL_PIXEL_PACK_BUFFER);
+
+        var texels = std.mem.window(u8, mapped.?[0..size], 4, 4);
+        var previous: u32 = 0;
+        while (texels.next()) |texel| {
+            if (texel[3] == 0 or texel[3] > self.levels) continue;
+            const packed_texel = std.mem.readInt(u32, texel[0..4], .little);
+            // Neighbouring pixels mostly want the same page
+            if (packed_texel == previous) continue;
+            previous = packed_texel;
+
+            const mip = texel[3] - 1;
+            const x = @as(u32, texel[0]) | @as(u32, texel[2] & 0x0F) << 8;
+            const y = @as(u32, texel[1]) | @as(u32, texel[2] >> 4) << 8;
+            const side = self.config.virtual_pages >> @intCast(mip);
+            if (x >= side or y >= side) continue;
+            try self.requestPage(.{ .x = @intCast(x), .y = @intCast(y), .mip = @intCast(mip) });
+        }
+    }
+
+
+    /// Mark `page` seen this frame, or queue it and its missing ancestors and keep the ancestor
+    /// standing in for them resident
+    fn requestPage(self: *Self, wanted: PageId) !void {
+        var page = wanted;
+        while (true) {
+            const entry = try self.requested.getOrPut(page.key());
+            // Seen already this update, and so were its ancestors
+            if (entry.found_existing) return;
+
+            if (self.resident.get(page.key())) |slot_index| {
+                self.slots[slot_index].last_used = self.frame;
+                return;
+            }
+            if (!self.loading.contains(page.key())) try self.missing.append(page);
+            if (page.mip == self.levels - 1) return;
+            page = page.parent();
+        }
+    }
+
+
+    fn queueLoad(self: *Self, page: PageId) void {
+        const pixels = load_allocator.alloc(u8, self.pageBytes()) catch return;
+        const load = load_allocator.create(PageLoad) catch {
+            load_allocator.free(pixels);
+            return;
+        };
+        load.* = .{ .owner = self, .page = page, .pixels = pixels };
+        // Capacity for max_pages_in_flight + the coarsest page was reserved at creation
+        self.loading.putAssumeCapacity(page.key(), {});
+        self.jobs.spawnWg(&self.loads, loadPage, .{load});
+    }
+
+
+    /// Worker job
+    fn loadPage(load: *PageLoad) void {
+        const self = load.owner;
+        self.source.func(self.source.context, load.page, load.pixels) catch |load_err| {
+            std.debug.print("VirtualTexture: loading page {d}/{d}_{d} failed: {s}\n", .{ load.page.mip, load.page.x, load.page.y, image_decode.failureReason(load_err) });
+            load.failed = true;
+        };
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.completed.appendAssumeCapacity(load);
+    }
+
+
+    fn freeLoad(load: *PageLoad) void {
+        load_allocator.free(load.pixels);
+        load_allocator.destroy(load);
+    }
+
+
+    /// A free slot, or the slot of the page seen longest ago unless that was this frame
+    fn takeSlot(self: *Self, stats: *VirtualTextureStats) ?u32 {
+        if (self.free_slots.pop()) |slot_index| return slot_index;
+
+        const pinned = self.coarsestPage().key();
+        var victim: ?u32 = null;
+        for (self.slots, 0..) |slot, slot_index| {
+            const page = slot.page orelse continue;
+            if (page.key() == pinned or slot.last_used >= self.frame) continue;
+            if (victim == null or slot.last_used < self.slots[victim.?].last_used) victim = @intCast(slot_index);
+        }
+        const slot_index = victim orelse return null;
+
+        const page = self.slots[slot_index].page.?;
+        _ = self.resident.remove(page.key());
+        self.slots[slot_index].page = null;
+        self.refreshEntries(page);
+        stats.evicted_pages += 1;
+        return slot_index;
+    }
+
+
+    fn fillSlot(self: *Self, slot_index: u32, load: *const PageLoad) !void {
+        const slot = &self.slots[slot_index];
+        const size: c.GLsizei = @intCast(self.config.page_size);
+        const x: c.GLint = @intCast(slot_index % self.config.cache_pages * self.config.page_size);
+        const y: c.GLint = @intCast(slot_index / self.config.cache_pages * self.config.page_size);
+
+        GLStateCache.current().bindTexture2D(0, self.cache_texture);
+        if (self.sparse and !slot.committed) {
+            gl_ext.texPageCommitment.?(c.GL_TEXTURE_2D, 0, x, y, 0, size, size, 1, c.GL_TRUE);
+            slot.committed = true;
+        }
+        c.glPixelStorei(c.GL_UNPACK_ALIGNMENT, 1);
+        c.glTexSubImage2D(c.GL_TEXTURE_2D, 0, x, y, size, size, c.GL_RGBA, c.GL_UNSIGNED_BYTE, load.pixels.ptr);
+        err.checkGLError("VirtualTexture: glTexSubImage2D");
+
+        slot.page = load.page;
+        slot.last_used = self.frame;
+        try self.resident.put(load.page.key(), slot_index);
+        self.refreshEntries(load.page);
+    }
+
+
+    /// Recompute the table entries of `page` and every finer page under it after it came or went
+    /// Resident pages keep their own entry, the others copy their parent's, coarse levels first.
+    /// Only `page` changed, below it an entry naming its own level is a resident page
+    fn refreshEntries(self: *Self, page: PageId) void {
+        const own_slot = self.resident.get(page.key());
+        var x0: u32 = page.x;
+        var y0: u32 = page.y;
+        var span: u32 = 1;
+        var mip: u32 = page.mip;
+        while (true) {
+            const side = self.config.virtual_pages >> @intCast(mip);
+            for (y0..y0 + span) |y| {
+                for (x0..x0 + span) |x| {
+                    const index = y * side + x;
+                    const entry = &self.table[mip][index];
+                    if (mip != page.mip and entry[3] == 255 and entry[2] == mip) continue;
+                    entry.* = if (mip == page.mip and own_slot != null)
+                        self.slotEntry(own_slot.?, mip)
+                    else if (mip + 1 < self.levels)
+                        self.table[mip + 1][(y / 2) * (side / 2) + x / 2]
+                    else
+                        .{ 0, 0, 0, 0 };
+                }
+            }
+            self.dirty[mip].add(x0, y0, x0 + span - 1, y0 + span - 1);
+
+            if (mip == 0) break;
+            mip -= 1;
+            x0 *= 2;
+            y0 *= 2;
+            span *= 2;
+        }
+    }
+
+
+    fn slotEntry(self: *const Self, slot_index: u32, mip: u32) Entry {
+        return .{ @intCast(slot_index % self.config.cache_pages), @intCast(slot_index / self.config.cache_pages), @intCast(mip), 255 };
+    }
+
+
+    /// Upload the changed rectangle of every page table level from the CPU copy
+    fn uploadPageTable(self: *Self) !void {
+        var bound = false;
+        for (self.dirty, 0..) |*rect, mip| {
+            if (rect.isEmpty()) continue;
+            if (!bound) {
+                GLStateCache.current().bindTexture2D(0, self.page_table_texture);
+                c.glPixelStorei(c.GL_UNPACK_ALIGNMENT, 1);
+                bound = true;
+            }
+            const side = self.config.virtual_pages >> @intCast(mip);
+            c.glPixelStorei(c.GL_UNPACK_ROW_LENGTH, @intCast(side));
+            const first = &self.table[mip][rect.min_y * side + rect.min_x];
+            c.glTexSubImage2D(c.GL_TEXTURE_2D, @intCast(mip), @intCast(rect.min_x), @intCast(rect.min_y), @intCast(rect.max_x - rect.min_x + 1), @intCast(rect.max_y - rect.min_y + 1), c.GL_RGBA, c.GL_UNSIGNED_BYTE, first);
+            rect.* = .{};
+        }
+        if (bound) {
+            c.glPixelStorei(c.GL_UNPACK_ROW_LENGTH, 0);
+            err.checkGLError("VirtualTexture: page table upload");
+        }
+    }
+
+
+    fn coarsestPage(self: *const Self) PageId {
+        return .{ .x = 0, .y = 0, .mip = @intCast(self.levels - 1) };
+    }
+
+
+    fn pageBytes(self: *const Self) usize {
+        return @as(usize, self.config.page_size) * self.config.page_size * 4;
+    }
+
+
+    /// Cache, every page table level and the largest feedback target so far
+    fn videoBytes(self: *const Self) usize {
+        var total = self.slots.len * self.pageBytes();
+        for (self.table) |level| total += level.len * @sizeOf(Entry);
+        total += @as(usize, self.feedback_width) * self.feedback_height * 8;
+        return total;
+    }
+
+
+    fn coarserFirst(_: void, a: PageId, b: PageId) bool {
+        return a.mip > b.mip;
+    }
+
+
+    fn isSignaled(fence: c.GLsync) bool {
+        const status = c.glClientWaitSync(fence, 0, 0);
+        return status == c.GL_ALREADY_SIGNALED or status == c.GL_CONDITION_SATISFIED;
+    }
+};
@@ -9,6 +9,18 @@ pub const core = struct {
     pub usingnamespace @import("core/window.zig");
     pub usingnamespace @import("core/time.zig");
     pub usingnamespace @import("core/input.zig");
+    pub usingnamespace @import("core/action_map.zig");
+    pub usingnamespace @import("core/input_replay.zig");
+    pub usingnamespace @import("core/frame_arena.zig");
+    pub usingnamespace @import("core/jobs.zig");
+    pub const profiler = @import("core/profiler.zig");
+    pub usingnamespace @import("core/telemetry.zig");
+    pub usingnamespace @import("core/perf_budget.zig");
+    pub usingnamespace @import("core/tracking_allocator.zig");
+    pub usingnamespace @import("core/virtual_allocator.zig");
+    pub usingnamespace @import("core/async_io.zig");
+    pub const lz4 = @import("core/lz4.zig");
+    pub usingnamespace @import("core/spsc_queue.zig");
     
 };
 
@@ -18,28 +30,111 @@ pub const graphics = struct {
     pub usingnamespace @import("renderer/camera.zig");
 
     pub usingnamespace @import("renderer/renderer.zig");
+    pub usingnamespace @import("renderer/render_queue.zig");
+    pub usingnamespace @import("renderer/render_bundle.zig");
+    pub usingnamespace @import("renderer/render_thread.zig");
+    pub usingnamespace @import("renderer/gpu_timer.zig");
+    pub usingnamespace @import("renderer/frame_capture.zig");
+    pub usingnamespace @import("renderer/render_target.zig");
+    pub usingnamespace @import("renderer/viewport_window.zig");
+    pub usingnamespace @import("renderer/frame_graph.zig");
+    pub usingnamespace @import("renderer/clustered_lighting.zig");
+    pub usingnamespace @import("renderer/shadow_cascades.zig");
+    pub usingnamespace @import("renderer/lightmap.zig");
+    pub usingnamespace @import("renderer/lightmap_baker.zig");
+    pub usingnamespace @import("renderer/sprite_batch.zig");
+    pub usingnamespace @import("renderer/font.zig");
+    pub usingnamespace @import("renderer/debug_draw.zig");
+    pub usingnamespace @import("renderer/particle_system.zig");
+    pub usingnamespace @import("renderer/cpu_particle_system.zig");
+    pub usingnamespace @import("renderer/animation.zig");
+    pub usingnamespace @import("renderer/skinning.zig");
+    pub const render_stats = @import("renderer/render_stats.zig");
+    pub usingnamespace @import("renderer/gl_state.zig");
     pub usingnamespace @import("renderer/material.zig");
+    pub usingnamespace @import("renderer/material_buffer.zig");
+    pub usingnamespace @import("renderer/transparency.zig");
     pub usingnamespace @import("renderer/shader.zig");
+    pub usingnamespace @import("renderer/program_cache.zig");
+    pub usingnamespace @import("renderer/shader_reloader.zig");
+    pub usingnamespace @import("renderer/shader_variants.zig");
     pub usingnamespace @import("renderer/texture.zig");
+    pub const image_decode = @import("renderer/image_decode.zig");
+    pub usingnamespace @import("renderer/texture_loader.zig");
+    pub usingnamespace @import("renderer/texture_container.zig");
+    pub usingnamespace @import("renderer/sampler_cache.zig");
+    pub usingnamespace @import("renderer/mip_generator.zig");
+    pub usingnamespace @import("renderer/texture_atlas.zig");
+    pub usingnamespace @import("renderer/material_table.zig");
+    pub usingnamespace @import("renderer/texture_streamer.zig");
+    pub usingnamespace @import("renderer/asset_archive.zig");
+    pub usingnamespace @import("renderer/gltf.zig");
+    pub usingnamespace @import("renderer/resource_loader.zig");
 
     pub usingnamespace @import("renderer/model.zig");
+    pub usingnamespace @import("renderer/impostor.zig");
     pub usingnamespace @import("renderer/mesh.zig");
+    pub usingnamespace @import("renderer/geometry_pool.zig");
+    pub usingnamespace @import("renderer/mesh_builder.zig");
+    pub usingnamespace @import("renderer/mesh_simplifier.zig");
+    pub usingnamespace @import("renderer/mesh_optimizer.zig");
+    pub usingnamespace @import("renderer/meshlet.zig");
+    pub usingnamespace @import("renderer/terrain.zig");
+    pub usingnamespace @import("renderer/virtual_texture.zig");
+    pub usingnamespace @import("renderer/dynamic_buffer.zig");
+    pub usingnamespace @import("renderer/gpu_culling.zig");
+    pub usingnamespace @import("renderer/vertex_puller.zig");
+    pub usingnamespace @import("renderer/hiz_buffer.zig");
+    pub usingnamespace @import("renderer/post_process.zig");
+    pub usingnamespace @import("renderer/temporal_upscale.zig");
 
     pub usingnamespace @import("renderer/resource_manager.zig");
+    pub usingnamespace @import("renderer/startup.zig");
+    pub usingnamespace @import("renderer/object_pool.zig");
+};
+
+// stb_image.c allocates through the hooks image_decode exports
+comptime {
+    _ = graphics.image_decode;
+}
+
+
+// Audio mixing and sounds
+pub const audio = struct {
+    pub usingnamespace @import("audio/mixer.zig");
+    pub usingnamespace @import("audio/sound.zig");
 };
 
 
 // Scene
 pub const ecs = struct {
     pub usingnamespace @import("ecs/ecs.zig");
+    pub usingnamespace @import("ecs/archetype.zig");
+    pub usingnamespace @import("ecs/scheduler.zig");
+    pub usingnamespace @import("ecs/command_buffer.zig");
+    pub usingnamespace @import("ecs/prefab.zig");
+    pub usingnamespace @import("ecs/events.zig");
+    pub usingnamespace @import("ecs/replication.zig");
 
     pub const components = struct {
         pub usingnamespace @import("ecs/components/transform_component.zig");
         pub usingnamespace @import("ecs/components/model_component.zig");
+        pub usingnamespace @import("ecs/components/parent_component.zig");
+        pub usingnamespace @import("ecs/components/animator_component.zig");
+        pub usingnamespace @import("ecs/components/collider_component.zig");
     };
 
     pub const systems = struct {
-        usingnamespace @import("ecs/systems/render_system.zig");
+        pub usingnamespace @import("ecs/systems/transform_system.zig");
+        pub usingnamespace @import("ecs/systems/render_system.zig");
+        pub usingnamespace @import("ecs/systems/spatial_system.zig");
+        pub usingnamespace @import("ecs/systems/shadow_system.zig");
+        pub usingnamespace @import("ecs/systems/animation_system.zig");
+        pub usingnamespace @import("ecs/systems/collision_system.zig");
+        pub usingnamespace @import("ecs/systems/static_batch_system.zig");
+        pub usingnamespace @import("ecs/systems/world_partition_system.zig");
+        pub usingnamespace @import("ecs/systems/compaction_system.zig");
+        pub usingnamespace @import("ecs/systems/neighbor_grid_system.zig");
     };
 };
 
@@ -47,9 +142,20 @@ pub const ecs = struct {
 // Math utilities
 pub const math = struct {
     pub usingnamespace @import("math/vector.zig");
+    pub usingnamespace @import("math/vector_array.zig");
     pub usingnamespace @import("math/matrix.zig");
+    pub usingnamespace @import("math/affine.zig");
+    pub usingnamespace @import("math/quaternion.zig");
+    pub usingnamespace @import("math/bounds.zig");
+    pub usingnamespace @import("math/aabb_tree.zig");
+    pub usingnamespace @import("math/triangle_bvh.zig");
+    pub const collision = @import("math/collision.zig");
+    pub const noise = @import("math/noise.zig");
 
     pub usingnamespace @import("math/misc.zig");
+
+    /// Both math backends, for benchmarking or picking one explicitly
+    pub const backends = @import("math/backend.zig");
 };
 
 
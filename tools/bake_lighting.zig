@@ -0,0 +1,142 @@
+// tools/bake_lighting.zig - bakes the static lights of a level into a lightmap and irradiance probes
+//
+//   zig build bake-lighting                                  (assets/lighting.zon -> zig-out/lighting.zpak)
+//   zig build bake-lighting -- <scene.zon> <output.zpak>
+//
+// The scene lists the static meshes as OBJ files with normals, each with a name and a placement, and the
+// lights that never move. The output archive holds every mesh with lightmap UVs under its name, for
+// BakedLighting.createMesh, plus the lightmap and the probe grid for BakedLighting.load. Lights left out
+// of the scene stay dynamic and go to ClusteredLighting at runtime.
+//
+//   .{
+//       .lightmap_size = 1024,
+//       .meshes = .{ .{ .name = "level/floor", .path = "level/floor.obj", .position = .{ 0, 0, 0 } } },
+//       .lights = .{ .{ .position = .{ 0, 4, 0 }, .radius = 12, .color = .{ 1, 0.9, 0.8 }, .intensity = 3 } },
+//   }
+const std = @import("std");
+const zune = @import("zune");
+const cook = @import("cook.zig");
+
+const gfx = zune.graphics;
+const Mat4f = zune.math.Mat4f;
+const Quatf = zune.math.Quatf;
+const Vec3f = zune.math.Vec3f;
+const JobSystem = zune.core.JobSystem;
+
+const ArchiveWriter = gfx.ArchiveWriter;
+const PointLight = gfx.PointLight;
+
+
+const SceneMesh = struct {
+    /// Archive name of the lightmapped mesh
+    name: []const u8,
+    /// OBJ file, relative to the scene file
+    path: []const u8,
+    position: [3]f32 = .{ 0.0, 0.0, 0.0 },
+    /// Euler angles in degrees, applied like Quatf.fromEuler
+    rotation: [3]f32 = .{ 0.0, 0.0, 0.0 },
+    scale: [3]f32 = .{ 1.0, 1.0, 1.0 },
+};
+
+
+const Scene = struct {
+    lightmap_size: u32 = 1024,
+    texels_per_unit: f32 = 8.0,
+    padding: u32 = 2,
+    ambient: [3]f32 = .{ 0.03, 0.03, 0.03 },
+    /// 0 bakes no probes
+    probe_spacing: f32 = 2.0,
+    meshes: []const SceneMesh,
+    lights: []const PointLight = &.{},
+};
+
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+    if (args.len != 3) {
+        std.debug.print("usage: bake-lighting <scene.zon> <output.zpak>\n", .{});
+        return error.InvalidArguments;
+    }
+
+    const source = try std.fs.cwd().readFileAllocOptions(allocator, args[1], std.math.maxInt(u32), null, @alignOf(u8), 0);
+    defer allocator.free(source);
+    const scene = std.zon.parse.fromSlice(Scene, allocator, source, null, .{}) catch |e| {
+        std.debug.print("bake-lighting: can't parse {s}: {s}\n", .{ args[1], @errorName(e) });
+        return e;
+    };
+    defer std.zon.parse.free(allocator, scene);
+
+    var scene_dir = try std.fs.cwd().openDir(std.fs.path.dirname(args[1]) orelse ".", .{});
+    defer scene_dir.close();
+
+    // Meshes are loaded up front, the bake sees the whole level at once
+    const objs = try allocator.alloc(cook.ObjMesh, scene.meshes.len);
+    var loaded: usize = 0;
+    defer {
+        for (objs[0..loaded]) |*obj| obj.data.deinit();
+        allocator.free(objs);
+    }
+    const instances = try allocator.alloc(gfx.BakeInstance, scene.meshes.len);
+    defer allocator.free(instances);
+
+    for (scene.meshes, objs, instances) |mesh, *obj, *instance| {
+        const bytes = try scene_dir.readFileAlloc(allocator, mesh.path, std.math.maxInt(u32));
+        defer allocator.free(bytes);
+        obj.* = try cook.parseObj(allocator, mesh.path, bytes);
+        loaded += 1;
+        if (obj.package_size != 6 and obj.package_size != 8) {
+            std.debug.print("bake-lighting: {s} has no normals\n", .{mesh.path});
+            return gfx.BakeError.MissingNormals;
+        }
+
+        const radians = std.math.pi / 180.0;
+        instance.* = .{
+            .name = mesh.name,
+            .vertices = obj.data.vertices,
+            .package_size = obj.package_size,
+            .indices = obj.data.indices,
+            .world = Mat4f.compose(
+                Vec3f.create(mesh.position[0], mesh.position[1], mesh.position[2]),
+                Quatf.fromEuler(mesh.rotation[0] * radians, mesh.rotation[1] * radians, mesh.rotation[2] * radians),
+                Vec3f.create(mesh.scale[0], mesh.scale[1], mesh.scale[2]),
+            ),
+        };
+    }
+
+    var jobs: JobSystem = undefined;
+    try jobs.init(allocator, .{});
+    defer jobs.deinit();
+
+    var timer = try std.time.Timer.start();
+    var result = try gfx.bakeLighting(allocator, &jobs, instances, scene.lights, .{
+        .lightmap_size = scene.lightmap_size,
+        .texels_per_unit = scene.texels_per_unit,
+        .padding = scene.padding,
+        .ambient = scene.ambient,
+        .probe_spacing = scene.probe_spacing,
+    });
+    defer result.deinit();
+
+    var output = ArchiveWriter.init(allocator);
+    defer output.deinit();
+    for (result.meshes) |mesh| try gfx.addLightmappedGeometry(&output, allocator, mesh.name, mesh.vertices, mesh.indices);
+    try gfx.addLightmap(&output, allocator, result.image());
+    if (result.probeGrid()) |grid| try gfx.addProbes(&output, allocator, grid);
+    try output.write(args[2]);
+
+    std.debug.print("bake-lighting: {d} meshes, {d} lights, {d}x{d} lightmap at {d:.2} texels per unit, {d} probes in {d} ms -> {s}\n", .{
+        result.meshes.len,
+        scene.lights.len,
+        result.size,
+        result.size,
+        result.texels_per_unit,
+        result.probes.len,
+        timer.read() / std.time.ns_per_ms,
+        args[2],
+    });
+}
@@ -0,0 +1,358 @@
+// tools/cook.zig - cooks a directory of source assets into one AssetArchive
+//
+//   zig build cook                                  (assets/ -> zig-out/assets.zpak)
+//   zig build cook -- <source dir> <output.zpak> <cache dir>
+//
+// PNG/JPG/TGA/BMP images become BC1/BC3 textures with a full mip chain, OBJ meshes are welded,
+// reordered for the vertex cache and fetch, stored in the compact vertex format and get up to three
+// simplified LODs named "<path>#lod1" and so on, GLSL files (.vert, .frag, .glsl) are checked and
+// stored as sources. Mesh and texture blobs are stored as lz4 streams. Every source is cooked into its
+// own small archive in the cache dir, named by a hash of its path and contents, so a rebuild only
+// cooks what changed.
+const std = @import("std");
+const zune = @import("zune");
+const texconv = @import("texconv.zig");
+
+const c = zune.c;
+const gfx = zune.graphics;
+
+const AssetArchive = gfx.AssetArchive;
+const ArchiveWriter = gfx.ArchiveWriter;
+const EncodedMesh = gfx.EncodedMesh;
+const MeshData = gfx.MeshData;
+const CompressedImage = gfx.CompressedImage;
+
+/// Bump when the cooked output of any asset type changes, so stale cache entries are ignored
+const cook_version = 2;
+
+/// Grid resolutions of the LODs, coarser each step
+const lod_resolutions = [_]u32{ 64, 32, 16 };
+/// A LOD that keeps more than this share of the previous triangles isn't worth storing
+const min_lod_reduction = 0.8;
+
+/// BC formats of texconv.Format as glCompressedTexImage2D takes them
+const GL_COMPRESSED_RGBA_S3TC_DXT1_EXT = 0x83F1;
+const GL_COMPRESSED_RGBA_S3TC_DXT5_EXT = 0x83F3;
+
+const SourceKind = enum { image, mesh, shader };
+
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+    if (args.len != 4) {
+        std.debug.print("usage: cook <source dir> <output.zpak> <cache dir>\n", .{});
+        return error.InvalidArguments;
+    }
+
+    var source_dir = try std.fs.cwd().openDir(args[1], .{ .iterate = true });
+    defer source_dir.close();
+    var cache_dir = try std.fs.cwd().makeOpenPath(args[3], .{});
+    defer cache_dir.close();
+
+    // Sorted paths keep the archive byte-identical between runs
+    var paths = std.ArrayList([]u8).init(allocator);
+    defer {
+        for (paths.items) |path| allocator.free(path);
+        paths.deinit();
+    }
+    var walker = try source_dir.walk(allocator);
+    defer walker.deinit();
+    while (try walker.next()) |entry| {
+        if (entry.kind != .file or kindOf(entry.path) == null) continue;
+        const path = try allocator.dupe(u8, entry.path);
+        std.mem.replaceScalar(u8, path, '\\', '/');
+        try paths.append(path);
+    }
+    std.mem.sort([]u8, paths.items, {}, lessThan);
+
+    var output = ArchiveWriter.init(allocator);
+    defer output.deinit();
+
+    var cooked: usize = 0;
+    for (paths.items) |path| {
+        const bytes = try source_dir.readFileAlloc(allocator, path, std.math.maxInt(u32));
+        defer allocator.free(bytes);
+
+        var name_buffer: [32]u8 = undefined;
+        const cache_name = cacheName(&name_buffer, path, bytes);
+
+        const cache_path = try std.fs.path.join(allocator, &.{ args[3], cache_name });
+        defer allocator.free(cache_path);
+
+        if (cache_dir.access(cache_name, .{})) |_| {} else |_| {
+            try cookSource(allocator, cache_path, path, bytes);
+            cooked += 1;
+        }
+
+        const piece = try AssetArchive.open(allocator, cache_path);
+        defer piece.close();
+        try output.appendArchive(piece);
+    }
+
+    try output.write(args[2]);
+    std.debug.print("cook: {d} sources, {d} cooked, {d} from cache -> {s}\n", .{ paths.items.len, cooked, paths.items.len - cooked, args[2] });
+}
+
+
+fn lessThan(_: void, a: []u8, b: []u8) bool {
+    return std.mem.lessThan(u8, a, b);
+}
+
+
+fn kindOf(path: []const u8) ?SourceKind {
+    const extension = std.fs.path.extension(path);
+    for ([_][]const u8{ ".png", ".jpg", ".jpeg", ".tga", ".bmp" }) |image| {
+        if (std.ascii.eqlIgnoreCase(extension, image)) return .image;
+    }
+    if (std.ascii.eqlIgnoreCase(extension, ".obj")) return .mesh;
+    for ([_][]const u8{ ".vert", ".frag", ".glsl" }) |shader| {
+        if (std.ascii.eqlIgnoreCase(extension, shader)) return .shader;
+    }
+    return null;
+}
+
+
+/// Content hash of one source, the cache file it cooks into
+fn cacheName(buffer: *[32]u8, path: []const u8, bytes: []const u8) []const u8 {
+    var hasher = std.hash.Wyhash.init(cook_version);
+    hasher.update(path);
+    hasher.update(&.{0});
+    hasher.update(bytes);
+    return std.fmt.bufPrint(buffer, "{x:0>16}.zpak", .{hasher.final()}) catch unreachable;
+}
+
+
+/// Cook one source into a single-source archive in the cache
+fn cookSource(allocator: std.mem.Allocator, cache_path: []const u8, path: []const u8, bytes: []const u8) !void {
+    var piece = ArchiveWriter.init(allocator);
+    defer piece.deinit();
+    piece.compression = .lz4;
+
+    switch (kindOf(path).?) {
+        .image => try cookImage(allocator, &piece, path, bytes),
+        .mesh => try cookMesh(allocator, &piece, path, bytes),
+        .shader => try cookShader(&piece, path, bytes),
+    }
+
+    // Write under a temporary name, an interrupted cook never leaves a truncated cache entry
+    const temp_path = try std.fmt.allocPrint(allocator, "{s}.tmp", .{cache_path});
+    defer allocator.free(temp_path);
+    try piece.write(temp_path);
+    try std.fs.cwd().rename(temp_path, cache_path);
+}
+
+
+fn cookImage(allocator: std.mem.Allocator, piece: *ArchiveWriter, path: []const u8, bytes: []const u8) !void {
+    // Flipped like Texture.createFromFile, so UVs sample the same as from the loose file
+    c.stbi_set_flip_vertically_on_load(1);
+    var width: c_int = 0;
+    var height: c_int = 0;
+    var channels: c_int = 0;
+    const data = c.stbi_load_from_memory(bytes.ptr, @intCast(bytes.len), &width, &height, &channels, 4) orelse {
+        std.debug.print("cook: can't decode {s}: {s}\n", .{ path, c.stbi_failure_reason() });
+        return error.ImageLoadFailed;
+    };
+    defer c.stbi_image_free(data);
+
+    const w: u32 = @intCast(width);
+    const h: u32 = @intCast(height);
+    var compressed = try texconv.compress(allocator, data[0 .. @as(usize, w) * h * 4], w, h);
+    defer compressed.deinit();
+
+    var image = CompressedImage{ .format = if (compressed.format == .bc1) GL_COMPRESSED_RGBA_S3TC_DXT1_EXT else GL_COMPRESSED_RGBA_S3TC_DXT5_EXT };
+    const block_bytes: usize = if (compressed.format == .bc1) 8 else 16;
+    var cursor: usize = 0;
+    for (0..@min(compressed.level_count, CompressedImage.max_levels)) |level| {
+        const level_w = @max(w >> @intCast(level), 1);
+        const level_h = @max(h >> @intCast(level), 1);
+        const size = gfx.levelSize(level_w, level_h, block_bytes);
+        image.levels[level] = .{ .width = level_w, .height = level_h, .data = compressed.bytes[cursor..][0..size] };
+        image.level_count += 1;
+        cursor += size;
+    }
+    try piece.addTexture(path, &image);
+}
+
+
+fn cookMesh(allocator: std.mem.Allocator, piece: *ArchiveWriter, path: []const u8, bytes: []const u8) !void {
+    var source = try parseObj(allocator, path, bytes);
+    defer source.data.deinit();
+
+    var lod0 = try gfx.optimize(allocator, source.data.vertices, source.data.indices, source.package_size);
+    defer lod0.deinit();
+    try addMesh(allocator, piece, path, &lod0, source.package_size);
+
+    var previous_triangles = lod0.indices.len / 3;
+    var lod_index: usize = 1;
+    for (lod_resolutions) |resolution| {
+        var simplified = try gfx.simplify(allocator, lod0.vertices, lod0.indices, source.package_size, resolution);
+        defer simplified.deinit();
+        const triangles = simplified.indices.len / 3;
+        if (triangles == 0 or @as(f32, @floatFromInt(triangles)) > min_lod_reduction * @as(f32, @floatFromInt(previous_triangles))) continue;
+
+        var optimized = try gfx.optimize(allocator, simplified.vertices, simplified.indices, source.package_size);
+        defer optimized.deinit();
+
+        var name_buffer: [std.fs.max_path_bytes + 8]u8 = undefined;
+        const name = try std.fmt.bufPrint(&name_buffer, "{s}#lod{d}", .{ path, lod_index });
+        try addMesh(allocator, piece, name, &optimized, source.package_size);
+
+        previous_triangles = triangles;
+        lod_index += 1;
+    }
+}
+
+
+fn addMesh(allocator: std.mem.Allocator, piece: *ArchiveWriter, name: []const u8, data: *const MeshData, package_size: u4) !void {
+    var encoded = try EncodedMesh.init(allocator, data.vertices, data.indices, package_size, .compact);
+    defer encoded.deinit();
+    try piece.addMesh(name, &encoded);
+}
+
+
+pub const ObjMesh = struct {
+    data: MeshData,
+    package_size: u4,
+};
+
+
+/// Positions, texture coordinates and normals of an OBJ, polygons fanned into triangles
+/// Each distinct v/vt/vn triple becomes one vertex, the package size follows what the faces reference
+pub fn parseObj(allocator: std.mem.Allocator, path: []const u8, bytes: []const u8) !ObjMesh {
+    var positions = std.ArrayList([3]f32).init(allocator);
+    defer positions.deinit();
+    var tex_coords = std.ArrayList([2]f32).init(allocator);
+    defer tex_coords.deinit();
+    var normals = std.ArrayList([3]f32).init(allocator);
+    defer normals.deinit();
+
+    const Corner = struct { v: u32, vt: ?u32, vn: ?u32 };
+    var corners = std.ArrayList(Corner).init(allocator);
+    defer corners.deinit();
+
+    var lines = std.mem.tokenizeAny(u8, bytes, "\r\n");
+    while (lines.next()) |line| {
+        var fields = std.mem.tokenizeAny(u8, line, " \t");
+        const keyword = fields.next() orelse continue;
+
+        if (std.mem.eql(u8, keyword, "v")) {
+            try positions.append(try parseFloats(3, &fields));
+        } else if (std.mem.eql(u8, keyword, "vt")) {
+            try tex_coords.append(try parseFloats(2, &fields));
+        } else if (std.mem.eql(u8, keyword, "vn")) {
+            try normals.append(try parseFloats(3, &fields));
+        } else if (std.mem.eql(u8, keyword, "f")) {
+            var polygon: [64]Corner = undefined;
+            var count: usize = 0;
+            while (fields.next()) |field| {
+                if (count == polygon.len) return error.InvalidObj;
+                var parts = std.mem.splitScalar(u8, field, '/');
+                polygon[count] = .{
+                    .v = try objIndex(parts.next(), positions.items.len) orelse return error.InvalidObj,
+                    .vt = try objIndex(parts.next(), tex_coords.items.len),
+                    .vn = try objIndex(parts.next(), normals.items.len),
+                };
+                count += 1;
+            }
+            if (count < 3) return error.InvalidObj;
+            for (1..count - 1) |i| try corners.appendSlice(&.{ polygon[0], polygon[i], polygon[i + 1] });
+        }
+    }
+    if (corners.items.len == 0) {
+        std.debug.print("cook: {s} has no faces\n", .{path});
+        return error.InvalidObj;
+    }
+
+    const has_tex = corners.items[0].vt != null;
+    const has_normals = corners.items[0].vn != null;
+    const package_size: u4 = 3 + @as(u4, if (has_normals) 3 else 0) + @as(u4, if (has_tex) 2 else 0);
+
+    var vertices = std.ArrayList(f32).init(allocator);
+    errdefer vertices.deinit();
+    var indices = std.ArrayList(u32).init(allocator);
+    errdefer indices.deinit();
+    var lookup = std.AutoHashMap(Corner, u32).init(allocator);
+    defer lookup.deinit();
+
+    for (corners.items) |corner| {
+        // Faces that disagree with the first one about vt or vn get zeros
+        const key = Corner{ .v = corner.v, .vt = if (has_tex) corner.vt orelse 0 else null, .vn = if (has_normals) corner.vn orelse 0 else null };
+        const slot = try lookup.getOrPut(key);
+        if (!slot.found_existing) {
+            slot.value_ptr.* = @intCast(vertices.items.len / package_size);
+            try vertices.appendSlice(&positions.items[key.v]);
+            if (has_normals) try vertices.appendSlice(if (normals.items.len > 0) &normals.items[key.vn.?] else &[3]f32{ 0, 0, 1 });
+            if (has_tex) try vertices.appendSlice(if (tex_coords.items.len > 0) &tex_coords.items[key.vt.?] else &[2]f32{ 0, 0 });
+        }
+        try indices.append(slot.value_ptr.*);
+    }
+
+    return .{
+        .data = .{
+            .vertices = try vertices.toOwnedSlice(),
+            .indices = try indices.toOwnedSlice(),
+            .allocator = allocator,
+        },
+        .package_size = package_size,
+    };
+}
+
+
+fn parseFloats(comptime n: usize, fields: *std.mem.TokenIterator(u8, .any)) ![n]f32 {
+    var values: [n]f32 = undefined;
+    for (&values) |*value| value.* = try std.fmt.parseFloat(f32, fields.next() orelse return error.InvalidObj);
+    return values;
+}
+
+
+/// Zero-based index of a 1-based or negative relative OBJ index, null for an empty field
+fn objIndex(field: ?[]const u8, count: usize) !?u32 {
+    const text = field orelse return null;
+    if (text.len == 0) return null;
+    const value = try std.fmt.parseInt(i64, text, 10);
+    const index: i64 = if (value < 0) @as(i64, @intCast(count)) + value else value - 1;
+    if (index < 0 or index >= count) return error.InvalidObj;
+    return @intCast(index);
+}
+
+
+/// Checks that hold without a GL context: a #version line before any code and balanced brackets
+/// Driver compiles and the program binary cache still happen at runtime, binaries are driver specific
+fn cookShader(piece: *ArchiveWriter, path: []const u8, bytes: []const u8) !void {
+    var saw_version = false;
+    var lines = std.mem.tokenizeAny(u8, bytes, "\r\n");
+    while (lines.next()) |raw| {
+        const line = std.mem.trim(u8, raw, " \t");
+        if (line.len == 0 or std.mem.startsWith(u8, line, "//")) continue;
+        saw_version = std.mem.startsWith(u8, line, "#version");
+        break;
+    }
+    if (!saw_version) {
+        std.debug.print("cook: {s} does not start with a #version line\n", .{path});
+        return error.InvalidShader;
+    }
+
+    var depth = [3]i32{ 0, 0, 0 };
+    for (bytes) |char| {
+        switch (char) {
+            '{' => depth[0] += 1,
+            '}' => depth[0] -= 1,
+            '(' => depth[1] += 1,
+            ')' => depth[1] -= 1,
+            '[' => depth[2] += 1,
+            ']' => depth[2] -= 1,
+            else => {},
+        }
+    }
+    if (!std.mem.eql(i32, &depth, &.{ 0, 0, 0 })) {
+        std.debug.print("cook: {s} has unbalanced brackets\n", .{path});
+        return error.InvalidShader;
+    }
+
+    try piece.addSource(path, bytes);
+}
@@ -0,0 +1,81 @@
+// tools/telemetry_view.zig - prints the samples a Telemetry endpoint streams, one line each
+//
+//   zig build telemetry-view -- [port]
+//
+// Listens on every interface at the port, 47800 unless given, the engine sends to 127.0.0.1 by default.
+const std = @import("std");
+const telemetry = @import("telemetry");
+const TelemetrySample = telemetry.TelemetrySample;
+
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+    const port = if (args.len > 1) try std.fmt.parseInt(u16, args[1], 10) else telemetry.default_port;
+
+    const address = try std.net.Address.parseIp("0.0.0.0", port);
+    const socket = try std.posix.socket(std.posix.AF.INET, std.posix.SOCK.DGRAM, std.posix.IPPROTO.UDP);
+    defer std.posix.close(socket);
+    try std.posix.bind(socket, &address.any, address.getOsSockLen());
+
+    const stdout = std.io.getStdOut().writer();
+    try stdout.print("listening on udp port {d}\n", .{port});
+
+    var datagram: [1024]u8 = undefined;
+    var last_frame: u64 = 0;
+    while (true) {
+        const len = try std.posix.recvfrom(socket, &datagram, 0, null, null);
+        const sample = TelemetrySample.decode(datagram[0..len]) orelse {
+            try stdout.print("ignored a datagram of {d} bytes\n", .{len});
+            continue;
+        };
+        // A lower frame number is a restarted engine
+        if (sample.frame < last_frame) try stdout.writeAll("-- restarted --\n");
+        last_frame = sample.frame;
+        try printSample(stdout, sample);
+    }
+}
+
+
+fn printSample(writer: anytype, sample: TelemetrySample) !void {
+    try writer.print("{d:>8} {d:>9.2}s | frame ms mean {d:.2} p50 {d:.2} p95 {d:.2} p99 {d:.2} max {d:.2} | hitches {d} | input ms p50 {d:.2} p99 {d:.2}", .{
+        sample.frame,
+        seconds(sample.timestamp_ns),
+        millis(sample.frame_mean_ns),
+        millis(sample.frame_p50_ns),
+        millis(sample.frame_p95_ns),
+        millis(sample.frame_p99_ns),
+        millis(sample.frame_max_ns),
+        sample.hitches,
+        millis(sample.input_latency_p50_ns),
+        millis(sample.input_latency_p99_ns),
+    });
+    try writer.print(" | draws {d} tris {d} uploads {d} KiB | entities {d} components {d} | gpu {d:.1} MiB cpu {d:.1} MiB\n", .{
+        sample.draw_calls,
+        sample.triangles,
+        sample.upload_bytes / 1024,
+        sample.entities,
+        sample.components,
+        mebibytes(sample.gpu_bytes),
+        mebibytes(sample.cpu_bytes),
+    });
+}
+
+
+fn millis(ns: u64) f64 {
+    return @as(f64, @floatFromInt(ns)) / std.time.ns_per_ms;
+}
+
+
+fn seconds(ns: u64) f64 {
+    return @as(f64, @floatFromInt(ns)) / std.time.ns_per_s;
+}
+
+
+fn mebibytes(bytes: u64) f64 {
+    return @as(f64, @floatFromInt(bytes)) / (1024.0 * 1024.0);
+}
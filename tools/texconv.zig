@@ -0,0 +1,295 @@
+// tools/texconv.zig - converts PNG/JPG/TGA images into block-compressed DDS files with a full mip chain
+//
+//   zig build texconv -- input.png output.dds
+//
+// Opaque images become BC1, images with any translucent texel BC3. Rows are flipped on load like
+// Texture.createFromFile does, so the result samples the same way as the source image did.
+const std = @import("std");
+const c = @cImport({
+    @cInclude("stb_image/stb_image.h");
+});
+
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+    if (args.len != 3) {
+        std.debug.print("usage: texconv <input image> <output.dds>\n", .{});
+        return error.InvalidArguments;
+    }
+
+    const input = try allocator.dupeZ(u8, args[1]);
+    defer allocator.free(input);
+
+    c.stbi_set_flip_vertically_on_load(1);
+    var width: c_int = 0;
+    var height: c_int = 0;
+    var channels: c_int = 0;
+    const data = c.stbi_load(input.ptr, &width, &height, &channels, 4) orelse {
+        std.debug.print("texconv: can't read {s}: {s}\n", .{ args[1], c.stbi_failure_reason() });
+        return error.LoadFailed;
+    };
+    defer c.stbi_image_free(data);
+
+    var compressed = try compress(allocator, data[0..@as(usize, @intCast(width * height * 4))], @intCast(width), @intCast(height));
+    defer compressed.deinit();
+
+    const file = try std.fs.cwd().createFile(args[2], .{});
+    defer file.close();
+    var buffered = std.io.bufferedWriter(file.writer());
+    try writeHeader(buffered.writer(), @intCast(width), @intCast(height), compressed.level_count, compressed.format);
+    try buffered.writer().writeAll(compressed.bytes);
+    try buffered.flush();
+
+    std.debug.print("texconv: {s} -> {s}, {d}x{d} {s}, {d} levels\n", .{ args[1], args[2], width, height, @tagName(compressed.format), compressed.level_count });
+}
+
+
+pub const Format = enum { bc1, bc3 };
+
+/// Block data of every level down to 1x1, largest first
+pub const Compressed = struct {
+    format: Format,
+    bytes: []u8,
+    level_count: u32,
+    allocator: std.mem.Allocator,
+
+    pub fn deinit(self: *Compressed) void {
+        self.allocator.free(self.bytes);
+    }
+};
+
+
+/// Compress RGBA8 rows into BC1, or BC3 when any texel is translucent, with a full mip chain
+/// Also used by the cook tool
+pub fn compress(allocator: std.mem.Allocator, pixels: []const u8, width: u32, height: u32) !Compressed {
+    var level = Image{ .width = width, .height = height, .pixels = pixels };
+    var alpha = false;
+    var i: usize = 3;
+    while (i < level.pixels.len) : (i += 4) {
+        if (level.pixels[i] != 255) alpha = true;
+    }
+    const format: Format = if (alpha) .bc3 else .bc1;
+
+    // Every level down to 1x1, each box filtered from the one before
+    var encoded = std.ArrayList(u8).init(allocator);
+    errdefer encoded.deinit();
+    var level_count: u32 = 0;
+    var owned: ?[]const u8 = null;
+    defer if (owned) |level_pixels| allocator.free(level_pixels);
+
+    while (true) {
+        try encodeLevel(&encoded, level, format);
+        level_count += 1;
+        if (level.width == 1 and level.height == 1) break;
+
+        const next = try downsample(allocator, level);
+        if (owned) |level_pixels| allocator.free(level_pixels);
+        owned = next.pixels;
+        level = next;
+    }
+
+    return .{
+        .format = format,
+        .bytes = try encoded.toOwnedSlice(),
+        .level_count = level_count,
+        .allocator = allocator,
+    };
+}
+
+const Image = struct {
+    width: u32,
+    height: u32,
+    /// RGBA8 rows
+    pixels: []const u8,
+
+    fn texel(self: Image, x: u32, y: u32) [4]u8 {
+        const cx = @min(x, self.width - 1);
+        const cy = @min(y, self.height - 1);
+        return self.pixels[(cy * self.width + cx) * 4 ..][0..4].*;
+    }
+};
+
+
+/// Half the size along both axes, odd sizes fold their last row and column into the last texel
+fn downsample(allocator: std.mem.Allocator, image: Image) !Image {
+    const width = @max(image.width / 2, 1);
+    const height = @max(image.height / 2, 1);
+    const pixels = try allocator.alloc(u8, width * height * 4);
+
+    for (0..height) |y| {
+        for (0..width) |x| {
+            var sum = [4]u32{ 0, 0, 0, 0 };
+            for (0..2) |dy| {
+                for (0..2) |dx| {
+                    const t = image.texel(@intCast(x * 2 + dx), @intCast(y * 2 + dy));
+                    for (&sum, t) |*s, v| s.* += v;
+                }
+            }
+            for (pixels[(y * width + x) * 4 ..][0..4], sum) |*p, s| p.* = @intCast((s + 2) / 4);
+        }
+    }
+    return .{ .width = width, .height = height, .pixels = pixels };
+}
+
+
+fn encodeLevel(out: *std.ArrayList(u8), image: Image, format: Format) !void {
+    var by: u32 = 0;
+    while (by < image.height) : (by += 4) {
+        var bx: u32 = 0;
+        while (bx < image.width) : (bx += 4) {
+            var block: [16][4]u8 = undefined;
+            for (0..16) |t| block[t] = image.texel(bx + @as(u32, @intCast(t % 4)), by + @as(u32, @intCast(t / 4)));
+
+            if (format == .bc3) try out.appendSlice(&encodeAlpha(&block));
+            try out.appendSlice(&encodeColor(&block));
+        }
+    }
+}
+
+
+/// Endpoints from the inset bounding box of the block's colors, indices by nearest palette entry
+fn encodeColor(block: *const [16][4]u8) [8]u8 {
+    var lo = [3]i32{ 255, 255, 255 };
+    var hi = [3]i32{ 0, 0, 0 };
+    for (block) |t| {
+        for (0..3) |ch| {
+            lo[ch] = @min(lo[ch], t[ch]);
+            hi[ch] = @max(hi[ch], t[ch]);
+        }
+    }
+    // Pulling the endpoints in by 1/16 of the range lowers the average error
+    for (0..3) |ch| {
+        const inset = @divTrunc(hi[ch] - lo[ch], 16);
+        lo[ch] += inset;
+        hi[ch] -= inset;
+    }
+
+    var c0 = pack565(hi);
+    var c1 = pack565(lo);
+    // BC1 decodes c0 <= c1 as the three color mode with transparent black, keep c0 above c1
+    if (c0 < c1) std.mem.swap(u16, &c0, &c1);
+
+    const palette = [4][3]i32{
+        unpack565(c0),
+        unpack565(c1),
+        mix(unpack565(c0), unpack565(c1), 2, 1),
+        mix(unpack565(c0), unpack565(c1), 1, 2),
+    };
+
+    var indices: u32 = 0;
+    if (c0 != c1) {
+        for (block, 0..) |t, i| {
+            var best: u32 = 0;
+            var best_error: i32 = std.math.maxInt(i32);
+            for (palette, 0..) |entry, p| {
+                var e: i32 = 0;
+                for (0..3) |ch| e += (entry[ch] - t[ch]) * (entry[ch] - t[ch]);
+                if (e < best_error) {
+                    best_error = e;
+                    best = @intCast(p);
+                }
+            }
+            indices |= best << @intCast(i * 2);
+        }
+    }
+
+    var result: [8]u8 = undefined;
+    std.mem.writeInt(u16, result[0..2], c0, .little);
+    std.mem.writeInt(u16, result[2..4], c1, .little);
+    std.mem.writeInt(u32, result[4..8], indices, .little);
+    return result;
+}
+
+
+/// Eight-value alpha block between the block's extremes
+fn encodeAlpha(block: *const [16][4]u8) [8]u8 {
+    var a0: i32 = 0;
+    var a1: i32 = 255;
+    for (block) |t| {
+        a0 = @max(a0, t[3]);
+        a1 = @min(a1, t[3]);
+    }
+
+    var palette: [8]i32 = undefined;
+    palette[0] = a0;
+    palette[1] = a1;
+    for (2..8) |p| {
+        const i: i32 = @intCast(p);
+        palette[p] = @divTrunc((8 - i) * a0 + (i - 1) * a1, 7);
+    }
+
+    var bits: u64 = 0;
+    if (a0 != a1) {
+        for (block, 0..) |t, i| {
+            var best: u64 = 0;
+            var best_error: i32 = std.math.maxInt(i32);
+            for (palette, 0..) |entry, p| {
+                const e: i32 = @intCast(@abs(entry - t[3]));
+                if (e < best_error) {
+                    best_error = e;
+                    best = @intCast(p);
+                }
+            }
+            bits |= best << @intCast(i * 3);
+        }
+    }
+
+    var result: [8]u8 = undefined;
+    result[0] = @intCast(a0);
+    result[1] = @intCast(a1);
+    for (0..6) |b| result[2 + b] = @truncate(bits >> @intCast(b * 8));
+    return result;
+}
+
+
+fn pack565(color: [3]i32) u16 {
+    const r: u16 = @intCast(@divTrunc(color[0] * 31 + 127, 255));
+    const g: u16 = @intCast(@divTrunc(color[1] * 63 + 127, 255));
+    const b: u16 = @intCast(@divTrunc(color[2] * 31 + 127, 255));
+    return (r << 11) | (g << 5) | b;
+}
+
+
+fn unpack565(color: u16) [3]i32 {
+    const r: i32 = (color >> 11) & 31;
+    const g: i32 = (color >> 5) & 63;
+    const b: i32 = color & 31;
+    return .{ @divTrunc(r * 255 + 15, 31), @divTrunc(g * 255 + 31, 63), @divTrunc(b * 255 + 15, 31) };
+}
+
+
+fn mix(a: [3]i32, b: [3]i32, wa: i32, wb: i32) [3]i32 {
+    var result: [3]i32 = undefined;
+    for (&result, a, b) |*r, x, y| r.* = @divTrunc(x * wa + y * wb, wa + wb);
+    return result;
+}
+
+
+/// Legacy DDS header with a DXT1 or DXT5 FourCC, what Texture.createFromContainerFile reads back
+fn writeHeader(writer: anytype, width: u32, height: u32, level_count: u32, format: Format) !void {
+    const block_bytes: u32 = if (format == .bc1) 8 else 16;
+    const linear_size = ((width + 3) / 4) * ((height + 3) / 4) * block_bytes;
+
+    var header = [_]u32{0} ** 31;
+    header[0] = 124;
+    // CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT | LINEARSIZE
+    header[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;
+    header[2] = height;
+    header[3] = width;
+    header[4] = linear_size;
+    header[6] = level_count;
+    // Pixel format: size, DDPF_FOURCC, FourCC
+    header[18] = 32;
+    header[19] = 0x4;
+    header[20] = std.mem.readInt(u32, if (format == .bc1) "DXT1" else "DXT5", .little);
+    // TEXTURE | COMPLEX | MIPMAP
+    header[26] = 0x1000 | 0x8 | 0x400000;
+
+    try writer.writeAll("DDS ");
+    for (header) |value| try writer.writeInt(u32, value, .little);
+}